@@ -74,12 +74,15 @@ public:
 class OPENRAVE_API CollisionPairInfo
 {
 public:
+    /// \brief clears the pair, keeping the memory of the names and contacts for the next collision
     inline void Reset() {
         bodyLinkGeom1Name.clear();
         bodyLinkGeom2Name.clear();
         contacts.clear();
+        environmentBodyIndex1 = environmentBodyIndex2 = 0;
+        linkIndex1 = linkIndex2 = -1;
     }
-    
+
     void SaveToJson(rapidjson::Value& rCollisionPair, rapidjson::Document::AllocatorType& alloc) const;
     void LoadFromJson(const rapidjson::Value& rCollisionPair);
 
@@ -89,9 +92,14 @@ public:
     /// \brief swaps the first and second geometries, also changes contacts
     void SwapFirstSecond();
     
+    /// \brief sets the names of the first collision, its indices become unknown
     void SetFirstCollision(const std::string& bodyname, const std::string& linkname, const std::string& geomname);
     void SetSecondCollision(const std::string& bodyname, const std::string& linkname, const std::string& geomname);
 
+    /// \brief sets the names and the indices of the first collision from its link
+    void SetFirstCollision(const KinBody::Link& link, const std::string& geomname);
+    void SetSecondCollision(const KinBody::Link& link, const std::string& geomname);
+
     /// \brief extracts the first body name
     void ExtractFirstBodyName(string_view& bodyname) const;
     void ExtractSecondBodyName(string_view& bodyname) const;
@@ -132,6 +140,12 @@ public:
     std::string bodyLinkGeom2Name; ///< "bodyname linkname geomname" for second collision
 
     std::vector<CONTACT> contacts; ///< the convention is that the normal will be "out" of pgeom1's surface. Filled if CO_UseContacts option is set.
+
+    // the indices identify the links without comparing names when merging duplicate collisions. They are not saved to json.
+    int environmentBodyIndex1 = 0; ///< KinBody::GetEnvironmentBodyIndex of the first body, 0 if unknown
+    int environmentBodyIndex2 = 0; ///< KinBody::GetEnvironmentBodyIndex of the second body, 0 if unknown
+    int linkIndex1 = -1; ///< index of the first link in its body, -1 if unknown
+    int linkIndex2 = -1; ///< index of the second link in its body, -1 if unknown
 };
 
 /// \brief Holds information about a particular collision that occured. Keep the class non-virtual to allow c++ to optimize more
@@ -169,6 +183,13 @@ public:
     // set only one collision
     int SetLinkGeomCollision(const KinBody::LinkConstPtr& plink1, const KinBody::GeometryConstPtr& pgeom1, const KinBody::LinkConstPtr& plink2, const KinBody::GeometryConstPtr& pgeom2);
 
+    /// \brief makes the contact normals of all the valid collisions face out of the first geometry of their pair, see \ref KinBody::Geometry::ValidateContactNormals
+    ///
+    /// The geometry of every pair is looked up once for all its contacts. Pairs without a geometry name use their link if it has only one geometry.
+    /// \return the number of flipped normals
+    int ValidateContactNormals(EnvironmentBase& env);
+
+    // The infos past nNumValidCollisions are kept with their names and contacts so that refilling a report that is reused does not allocate memory.
     std::vector<CollisionPairInfo> vCollisionInfos; ///< all geometry collision pairs. Set when CO_AllGeometryCollisions or CO_AllLinkCollisions or CO_AllGeometryContacts is enabled. The size of the array is not indicative of how many valid collisions there are! See nNumValidCollisions instead. Due to caching and memory constraints, should not resize this vector, instead change nNumValidCollisions
     int nNumValidCollisions = 0; ///< how many infos are valid in vCollisionInfos
     int options = 0; ///< mix of CO_X, the options that the CollisionReport was called with. It is overwritten by the options set on the collision checker writing the report
@@ -227,6 +248,14 @@ public:
     /// \brief initialize the checker with the current environment and gather all current bodies in the environment and put them in its collision space
     virtual bool InitEnvironment() = 0;
 
+    /// \brief true if several instances of the checker can run queries on the same environment concurrently from different threads while holding EnvironmentBase::GetSharedMutex shared.
+    ///
+    /// The queries of one instance are never concurrent, each thread needs its own instance which has been initialized with InitEnvironment while holding the environment lock.
+    /// Self collision queries are not concurrent safe since they update the caches of the bodies.
+    virtual bool SupportsConcurrentReadOnlyQueries() const {
+        return false;
+    }
+
     /// \brief clear/deallocate any memory associated with tracking collision data for bodies
     virtual void DestroyEnvironment() = 0;
 
@@ -283,6 +312,13 @@ public:
     /// \param[out] report [optional] collision report to be filled with data about the collision. If a body was hit, CollisionReport::plink1 contains the hit link pointer.
     virtual bool CheckCollision(const RAY& ray, CollisionReportPtr report = CollisionReportPtr()) = 0;
 
+    /// \brief Checks a batch of rays against the environment. Same results as calling \ref CheckCollision(const RAY&,CollisionReportPtr) on every ray, but checkers can share the scene traversal between the rays. CO_ActiveDOFs option is ignored.
+    ///
+    /// \param vrays the rays to check. The length of every ray is the length of its direction.
+    /// \param[out] vreports resized to the number of rays, vreports[i] is the report of vrays[i] and is valid if the ray hit. minDistance is the distance from the ray origin to the closest hit.
+    /// \return the number of rays that hit a body
+    virtual int CheckCollisionRays(const std::vector<RAY>& vrays, std::vector<CollisionReport>& vreports);
+
     /// \brief Check collision with a triangle mesh and a body in the scene.
     ///
     /// \param trimesh Holds a dynamic triangle mesh to check collision with the body.
@@ -311,6 +347,29 @@ public:
     /// \param[out] report [optional] collision report to be filled with data about the collision. If a body was hit, CollisionReport::plink1 contains the hit link pointer.
     virtual bool CheckCollision(const AABB& ab, const Transform& aabbPose, const std::vector<KinBodyConstPtr>& vbodies, CollisionReportPtr report = CollisionReportPtr()) OPENRAVE_DUMMY_IMPLEMENTATION;
 
+    /// \brief checks collision of a body and a scene for many configurations of the body at once. Attached bodies are respected. If CO_ActiveDOFs is set, will only check affected links of the body.
+    ///
+    /// Equivalent to calling pbody->SetDOFValues followed by CheckCollision(pbody) for every configuration, except that checkers can amortize the synchronization of the scene across the batch. The DOF values of pbody are restored before returning. Self-collisions are not checked and CO_Distance is ignored.
+    /// \param pbody the body to set the configurations on
+    /// \param pConfigurations configuration i starts at pConfigurations[i*dofstride] and holds pbody->GetDOF() values
+    /// \param nConfigurations number of configurations to check
+    /// \param dofstride number of values between the starts of consecutive configurations, has to be >= pbody->GetDOF()
+    /// \param[out] vresults resized to nConfigurations, vresults[i] is 1 if configuration i is in collision, 0 otherwise
+    /// \param[out] report [optional] collision report to be filled with data about the first colliding configuration.
+    /// \return true if any of the configurations is in collision
+    virtual bool CheckCollisionBatch(KinBodyPtr pbody, const dReal* pConfigurations, size_t nConfigurations, int dofstride, std::vector<uint8_t>& vresults, CollisionReportPtr report = CollisionReportPtr());
+
+    /// \brief checks collision of a body and the scene along the straight line in configuration space from vStartConfig to vEndConfig. Attached bodies move with the body.
+    ///
+    /// The base implementation discretizes the motion at pbody->GetDOFResolutions() and calls CheckCollision for every step. Checkers supporting continuous collision detection can replace the discretization by swept checks of the link motions. The DOF values of pbody are restored before returning. Self-collisions are not checked and CO_Distance is ignored.
+    /// \param pbody the body to move
+    /// \param vStartConfig the DOF values of pbody at the start of the motion
+    /// \param vEndConfig the DOF values of pbody at the end of the motion
+    /// \param interval specifies whether the start and end configurations are checked, only the bits in IT_IntervalMask are used. If the two configurations are equal and one of the ends is open, the configuration is checked once.
+    /// \param[out] report [optional] collision report to be filled with data about the collision.
+    /// \return true if the body is in collision anywhere along the motion
+    virtual bool CheckContinuousCollision(KinBodyPtr pbody, const std::vector<dReal>& vStartConfig, const std::vector<dReal>& vEndConfig, IntervalType interval, CollisionReportPtr report = CollisionReportPtr());
+
     /// \brief Checks self collision only with the links of the passed in body.
     ///
     /// Only checks KinBody::GetNonAdjacentLinks(), Links that are joined together are ignored.
@@ -44,6 +44,11 @@ using defer_lock_t     = ::std::defer_lock_t;
 using try_to_lock_t    = ::std::try_to_lock_t;
 #endif // OPENRAVE_ENVIRONMENT_RECURSIVE_LOCK
 
+/// \brief reader-writer lock of the scene structure, see \ref EnvironmentBase::GetSharedMutex
+using EnvironmentSharedMutex = ::boost::shared_mutex;
+using EnvironmentReadLock    = ::boost::shared_lock<EnvironmentSharedMutex>;
+using EnvironmentWriteLock   = ::boost::unique_lock<EnvironmentSharedMutex>;
+
 /// \brief used when adding interfaces to the environment
 enum InterfaceAddMode
 {
@@ -168,6 +173,9 @@ public:
     /// \see CollisionCheckerBase::CheckCollision(const RAY&,CollisionReportPtr)
     virtual bool CheckCollision(const RAY& ray, CollisionReportPtr report = CollisionReportPtr()) = 0;
 
+    /// \see CollisionCheckerBase::CheckCollisionRays
+    virtual int CheckCollisionRays(const std::vector<RAY>& vrays, std::vector<CollisionReport>& vreports) OPENRAVE_DUMMY_IMPLEMENTATION;
+
     /// \see CollisionCheckerBase::CheckCollision(const TriMesh&,KinBodyConstPtr, CollisionReportPtr)
     virtual bool CheckCollision(const TriMesh& trimesh, KinBodyConstPtr pbody, CollisionReportPtr report = CollisionReportPtr()) = 0;
 
@@ -235,6 +243,93 @@ public:
     ///
     /// See \ref arch_simulation for more about the simulation thread.
     virtual uint64_t GetSimulationTime() = 0;
+
+    /// \brief scheduling of the internal simulation thread
+    struct SimulationThreadOptions
+    {
+        SimulationThreadOptions() : fifoPriority(0), cpu(-1) {
+        }
+        int fifoPriority; ///< if > 0, the thread runs with SCHED_FIFO at this priority (linux only, needs the privilege to do so), otherwise with the default policy
+        int cpu; ///< if >= 0, the thread is pinned to this cpu (linux only), otherwise it can run on any cpu
+    };
+
+    /// \brief durations of the stages of the simulation steps, in microseconds
+    struct SimulationStatistics
+    {
+        enum Stage {
+            Stage_Physics = 0, ///< PhysicsEngineBase::SimulateStep
+            Stage_Bodies, ///< KinBody::SimulationStep, which also steps the controllers of the robots
+            Stage_Modules,
+            Stage_Sensors,
+            Stage_Publish, ///< UpdatePublishedBodies from the simulation thread
+            Stage_Count,
+        };
+
+        SimulationStatistics() {
+            Reset();
+        }
+
+        void Reset() {
+            numSteps = 0;
+            numOverruns = 0;
+            numSkippedSteps = 0;
+            maxLatenessUS = 0;
+            for(int istage = 0; istage < Stage_Count; ++istage) {
+                vStageTotalUS[istage] = 0;
+                vStageMaxUS[istage] = 0;
+            }
+        }
+
+        uint64_t numSteps; ///< number of calls to StepSimulation
+        uint64_t numOverruns; ///< number of real-time steps of the simulation thread that ended after the deadline of the next step
+        uint64_t numSkippedSteps; ///< number of step deadlines the simulation thread dropped to catch up after overruns
+        uint64_t maxLatenessUS; ///< maximum delay between the deadline of a real-time step and its start
+        uint64_t vStageTotalUS[Stage_Count];
+        uint64_t vStageMaxUS[Stage_Count];
+    };
+
+    /// \brief Sets the scheduling of the internal simulation thread. Applied by the thread before its next step. <b>[multi-thread safe]</b>
+    ///
+    /// In real-time mode the thread always sleeps until the absolute deadline of the next step, so adding a real-time priority and a dedicated cpu makes the period stable.
+    virtual void SetSimulationThreadOptions(const SimulationThreadOptions& options) OPENRAVE_DUMMY_IMPLEMENTATION;
+
+    /// \brief Returns the statistics of the simulation steps since the start of the environment or the last reset. Does not lock the environment. <b>[multi-thread safe]</b>
+    virtual void GetSimulationStatistics(SimulationStatistics& statistics, bool bReset=false) OPENRAVE_DUMMY_IMPLEMENTATION;
+
+    /// \brief Steps the modules and sensors whose IsSimulationStepParallelSafe is true on numThreads worker threads during \ref StepSimulation.
+    ///
+    /// The modules and sensors keep the order of the sequential step: consecutive parallel-safe ones run concurrently and finish before the next one that is not parallel-safe starts.
+    /// The first exception thrown by a step is rethrown by StepSimulation. 0 steps everything on the calling thread (default).
+    virtual void SetParallelSimulationStep(int numThreads) OPENRAVE_DUMMY_IMPLEMENTATION;
+
+    /// \brief Makes \ref StepSimulation advance the physics engine in steps of fFixedTimeStep instead of the requested step.
+    ///
+    /// The requested time is accumulated in microseconds and the physics engine is stepped as many times as it fits, so the
+    /// physics results do not depend on the jitter of the step calls. Bodies, modules and sensors still step once with the requested time.
+    /// Inputs lasting one physics step, like PhysicsEngineBase::AddJointTorque, only act on the first substep.
+    /// \param fFixedTimeStep 0 steps the physics with the requested time (default)
+    /// \param nMaxSubSteps the accumulated time exceeding this many substeps is dropped so that a slow step cannot make the next ones slower
+    virtual void SetPhysicsFixedTimeStep(dReal fFixedTimeStep, int nMaxSubSteps=16) OPENRAVE_DUMMY_IMPLEMENTATION;
+
+    /// \brief Writes the inputs the physics engine receives and every one of its steps into a binary log. <b>[multi-thread safe]</b>
+    ///
+    /// While recording, \ref GetPhysicsEngine returns an engine forwarding to the current engine. The log can be replayed with
+    /// \ref ReplayPhysicsLog in an environment holding the same bodies in the same state. Changing the physics engine stops the recording.
+    /// \throw openrave_exception if filename cannot be opened
+    virtual void StartPhysicsRecording(const std::string& filename) OPENRAVE_DUMMY_IMPLEMENTATION;
+
+    /// \brief Stops the recording started with \ref StartPhysicsRecording and closes the log. <b>[multi-thread safe]</b>
+    ///
+    /// \return the number of physics steps written in the log
+    virtual uint64_t StopPhysicsRecording() OPENRAVE_DUMMY_IMPLEMENTATION;
+
+    /// \brief Steps the physics engine with the inputs of a log written by \ref StartPhysicsRecording, as fast as possible. <b>[multi-thread safe]</b>
+    ///
+    /// Only the physics engine runs, the controllers, modules and sensors do not. The simulation time advances by the recorded steps.
+    /// Replaying with the same physics engine and settings gives the same results as the recorded run.
+    /// \return the number of physics steps replayed
+    /// \throw openrave_exception if the log cannot be read or does not match the bodies of the environment
+    virtual uint64_t ReplayPhysicsLog(const std::string& filename) OPENRAVE_DUMMY_IMPLEMENTATION;
     //@}
 
     /// \name File Loading and Parsing
@@ -480,6 +575,15 @@ public:
 
     virtual void Add(InterfaceBasePtr pinterface, bool bAnonymous, const std::string& cmdargs=std::string()) RAVE_DEPRECATED;
 
+    /** \brief Adds several bodies and robots to the environment at once. <b>[multi-thread safe]</b>
+
+        Equivalent to calling Add on every body, except that the environment is locked once, the bodies are initialized in the collision checker and physics engine after all of them are indexed, and the body callbacks are called at the end.
+        \param[in] vbodies the bodies and robots to add, none of them can be in an environment
+        \param[in] addMode One of IAM_X
+        \throw openrave_exception Throw if a body is invalid or already added, in which case none of the bodies are added
+     */
+    virtual void AddBodies(const std::vector<KinBodyPtr>& vbodies, InterfaceAddMode addMode=IAM_AllowRenaming) OPENRAVE_DUMMY_IMPLEMENTATION;
+
     /// \brief bodycallback(body, action)
     ///
     /// \param body KinBodyPtr
@@ -504,6 +608,12 @@ public:
     /// \return true if the interface was successfully removed from the environment.
     virtual bool Remove(InterfaceBasePtr obj) = 0;
 
+    /// \brief Removes several bodies and robots from the environment at once. <b>[multi-thread safe]</b>
+    ///
+    /// The bodies that are not in this environment are ignored. The body callbacks are called after all the bodies are removed.
+    /// \return the number of bodies removed
+    virtual int RemoveBodies(const std::vector<KinBodyPtr>& vbodies) OPENRAVE_DUMMY_IMPLEMENTATION;
+
     /// \brief Removes all kinbodies that match the name
     ///
     /// \param[in] name of the kinbody to remove
@@ -551,6 +661,37 @@ public:
     /// \throw openrave_exception with ORE_Timeout error code
     virtual void GetBodies(std::vector<KinBodyPtr>& bodies, uint64_t timeout=0) const = 0;
 
+    /// \brief Defers the change callbacks of all the bodies in the environment while in scope.
+    ///
+    /// Creates a \ref KinBody::ChangeCallbackCoalescer for every body in the environment at construction, so moving many
+    /// bodies calls the callbacks of every changed property of a body only once when the scope is destroyed.
+    /// Bodies added to the environment during the scope are not deferred. The environment should be locked for the lifetime of the scope.
+    class OPENRAVE_API BatchUpdateScope
+    {
+public:
+        BatchUpdateScope(EnvironmentBasePtr penv);
+        virtual ~BatchUpdateScope();
+protected:
+        std::vector< boost::shared_ptr<void> > _vcoalescers; ///< one coalescer per body, also holding the body
+    };
+
+    /** \brief Returns an estimate of the heap memory held by the environment. <b>[multi-thread safe]</b>
+
+        memoryusage is reset to the environment, with the "bodyindex" category for the lookup tables of the bodies and one child for every body, the collision checker, the physics engine, module, sensor and viewer, filled by their \ref InterfaceBase::GetMemoryUsage.
+        Trajectories are not owned by the environment, so they have to be queried separately. The interface mutex is locked for reading, the environment does not have to be locked but the bodies should not be modified concurrently.
+        \param timeout microseconds to wait before throwing an exception, if 0, will block indefinitely.
+        \throw openrave_exception with ORE_Timeout error code
+     */
+    virtual void GetMemoryUsage(MemoryUsage& memoryusage, uint64_t timeout=0) const OPENRAVE_DUMMY_IMPLEMENTATION;
+
+    /// \brief Get the bodies whose names start with prefix, sorted by name. <b>[multi-thread safe]</b>
+    ///
+    /// Uses the sorted name index of the environment, so the cost is logarithmic in the number of bodies plus the number of matches.
+    /// \param[out] bodies filled with the matching bodies
+    /// \param timeout microseconds to wait before throwing an exception, if 0, will block indefinitely.
+    /// \throw openrave_exception with ORE_Timeout error code
+    virtual void GetBodiesMatchingPrefix(const std::string& prefix, std::vector<KinBodyPtr>& bodies, uint64_t timeout=0) const OPENRAVE_DUMMY_IMPLEMENTATION;
+
     /// \brief Fill an array with all robots loaded in the environment. <b>[multi-thread safe]</b>
     ///
     /// A separate **interface mutex** is locked for reading the bodies.
@@ -560,37 +701,33 @@ public:
 
     /// \brief Retrieve published bodies, completes even if environment is locked. <b>[multi-thread safe]</b>
     ///
-    /// A separate **interface mutex** is locked for reading the modules.
+    /// The bodies are read from an immutable snapshot made by UpdatePublishedBodies, so the call never waits for the publishing thread.
     /// Note that the pbody pointer might become invalid as soon as GetPublishedBodies returns.
-    /// \param timeout microseconds to wait before throwing an exception, if 0, will block indefinitely.
-    /// \throw openrave_exception with ORE_Timeout error code
+    /// \param timeout unused since reading the snapshot never blocks, kept for compatibility
     virtual void GetPublishedBodies(std::vector<KinBody::BodyState>& vbodies, uint64_t timeout=0) = 0;
 
     /// \brief Retrieve published body of specified name, completes even if environment is locked. <b>[multi-thread safe]</b>
     ///
-    /// A separate **interface mutex** is locked for reading the modules.
+    /// The bodies are read from an immutable snapshot made by UpdatePublishedBodies, so the call never waits for the publishing thread.
     /// Note that the pbody pointer might become invalid as soon as GetPublishedBody returns.
-    /// \param timeout microseconds to wait before throwing an exception, if 0, will block indefinitely.
-    /// \throw openrave_exception with ORE_Timeout error code
+    /// \param timeout unused since reading the snapshot never blocks, kept for compatibility
     /// \return true if name matches to a published body
     virtual bool GetPublishedBody(const std::string& name, KinBody::BodyState& bodystate, uint64_t timeout=0) = 0;
 
     /// \brief Retrieve joint values of published body of specified name, completes even if environment is locked. <b>[multi-thread safe]</b>
     ///
-    /// A separate **interface mutex** is locked for reading the modules.
+    /// The bodies are read from an immutable snapshot made by UpdatePublishedBodies, so the call never waits for the publishing thread.
     /// Note that the pbody pointer might become invalid as soon as GetPublishedBodyJointValues returns.
-    /// \param timeout microseconds to wait before throwing an exception, if 0, will block indefinitely.
-    /// \throw openrave_exception with ORE_Timeout error code
+    /// \param timeout unused since reading the snapshot never blocks, kept for compatibility
     /// \return true if name matches to a published body
     virtual bool GetPublishedBodyJointValues(const std::string& name, std::vector<dReal> &jointValues, uint64_t timeout=0) = 0;
 
     /// \brief Retrieve body transform of all published bodies whose name matches prefix, completes even if environment is locked. <b>[multi-thread safe]</b>
     ///
-    /// A separate **interface mutex** is locked for reading the modules.
+    /// The bodies are read from an immutable snapshot made by UpdatePublishedBodies, so the call never waits for the publishing thread.
     /// Note that the pbody pointer might become invalid as soon as GetPublishedBody returns.
-    /// \param prefix the prefix to match to the target names.
-    /// \param timeout microseconds to wait before throwing an exception, if 0, will block indefinitely.
-    /// \throw openrave_exception with ORE_Timeout error code
+    /// \param prefix the prefix to match to the target names. The matching bodies are found with a name index built when publishing.
+    /// \param timeout unused since reading the snapshot never blocks, kept for compatibility
     virtual void GetPublishedBodyTransformsMatchingPrefix(const std::string& prefix, std::vector<std::pair<std::string, Transform> >& nameTransfPairs, uint64_t timeout = 0) = 0;
 
     /// \brief Updates the published bodies that viewers and other programs listening in on the environment see.
@@ -602,6 +739,23 @@ public:
     /// \throw openrave_exception with ORE_Timeout error code
     virtual void UpdatePublishedBodies(uint64_t timeout=0) = 0;
 
+    /// \brief Also writes every published snapshot into a named shared memory ring so that other processes on the same host can read it without serialization.
+    ///
+    /// Only the names, link transformations and dof values of the bodies are written. Only supported on POSIX systems.
+    /// \param name name of the shared memory, replacing an existing one. If empty, stops writing to shared memory.
+    /// \param numSlots number of snapshots kept in the ring
+    /// \param slotSize bytes of every snapshot, bodies that do not fit are not written
+    /// \throw openrave_exception if the shared memory cannot be created
+    virtual void SetPublishedBodiesSharedMemory(const std::string& name, uint32_t numSlots=4, uint64_t slotSize=4<<20) OPENRAVE_DUMMY_IMPLEMENTATION;
+
+    /// \brief Applies the newest snapshot that another environment wrote with \ref SetPublishedBodiesSharedMemory to the bodies of this environment.
+    ///
+    /// The bodies are matched by name and only updated when their number of links matches. A snapshot is only applied once.
+    /// \param name name of the shared memory
+    /// \return number of updated bodies, or -1 if no new snapshot was written since the last call
+    /// \throw openrave_exception if the shared memory cannot be opened
+    virtual int ApplyPublishedBodiesFromSharedMemory(const std::string& name) OPENRAVE_DUMMY_IMPLEMENTATION;
+
     /// Get the corresponding body from its unique network id
     virtual KinBodyPtr GetBodyFromEnvironmentBodyIndex(int bodyIndex) const = 0;
 
@@ -635,6 +789,23 @@ public:
     /// \param[in] selectname - name of the body used in options
     /// \throw openrave_exception Throw if failed to add anything
     virtual void TriangulateScene(TriMesh& trimesh, SelectionOptions options, const std::string& selectname) = 0;
+
+    /// \brief collision mesh of one link returned by TriangulateSceneView
+    struct TriMeshViewPart
+    {
+        TriMeshViewPart() : bodyIndex(0), linkIndex(-1) {
+        }
+        boost::shared_ptr<TriMesh const> pmesh; ///< cached collision mesh of the link in the link frame, shares the ownership of the link. Updated in place when the geometries of the link change, so read it with the environment locked.
+        Transform transform; ///< transform of the link when the view was taken, world vertices are transform*pmesh->vertices[i]
+        int bodyIndex; ///< environment body index of the body of the link
+        int linkIndex; ///< index of the link in its body
+    };
+
+    /// \brief Same selection as \ref TriangulateScene, but references the collision meshes that the links cache instead of copying and transforming their vertices. <b>[multi-thread safe]</b>
+    ///
+    /// Exporting the scene at a high rate then costs one entry per link instead of a copy of every vertex, and the meshes only change when the geometry does.
+    /// \param[out] vparts one entry per link with a non-empty collision mesh, the previous entries are removed
+    virtual void TriangulateSceneView(std::vector<TriMeshViewPart>& vparts, SelectionOptions options, const std::string& selectname) OPENRAVE_DUMMY_IMPLEMENTATION;
     //@}
 
     /// \brief Load a new module, need to Lock if calling outside simulation thread
@@ -665,6 +836,28 @@ public:
     /// is locked, the user is guaranteed that nnothing will change in the environment.
     virtual EnvironmentMutex& GetMutex() const = 0;
 
+    /// \brief Return the reader-writer mutex that lets several threads run read-only queries concurrently without holding \ref GetMutex.
+    ///
+    /// Read-only users (for example collision queries on a static scene, or viewers) hold it with EnvironmentReadLock.
+    /// The environment holds it with EnvironmentWriteLock when bodies are added or removed and when the collision checker changes.
+    /// Other code that modifies the scene (body states, geometries) while read-only users may be active has to hold it with EnvironmentWriteLock as well.
+    /// A thread holding EnvironmentReadLock must neither modify the scene nor lock \ref GetMutex, otherwise it can deadlock with a writer.
+    /// Collision queries are only safe if the checker returns true from CollisionCheckerBase::SupportsConcurrentReadOnlyQueries, and each thread has to use its own checker instance.
+    virtual EnvironmentSharedMutex& GetSharedMutex() const = 0;
+
+    /// \brief Enables recording the wait and hold times of the environment locks per acquiring call site. <b>[multi-thread safe]</b>
+    ///
+    /// Covers the environment mutex and the interface mutex locked inside the environment implementation, the statistics are shared by all the environments of the process.
+    /// Contended acquisitions are always counted, the times are measured for one out of samplingPeriod acquisitions of every thread to keep the overhead low.
+    /// \param bEnable if false, stops recording but keeps the recorded statistics
+    /// \param bReset if true, clears the recorded statistics
+    virtual void SetLockProfiling(bool bEnable, int samplingPeriod=64, bool bReset=false) OPENRAVE_DUMMY_IMPLEMENTATION;
+
+    /// \brief Writes the lock call sites with the largest total wait time, one per line. <b>[multi-thread safe]</b>
+    ///
+    /// \param numTopSites maximum number of call sites to write, if negative writes all of them
+    virtual void GetLockProfilingReport(std::ostream& os, int numTopSites=20) const OPENRAVE_DUMMY_IMPLEMENTATION;
+
     /// \name 3D plotting methods.
     /// \anchor env_plotting
     //@{
@@ -867,6 +1060,18 @@ public:
     /// \return true if can make the change, and the changes are notified. Otherwise false meaning there will be a conflict
     virtual bool NotifyKinBodyIdChanged(const std::string& oldId, const std::string& newId) = 0;
 
+    /// \brief returns a stamp that is incremented with the update stamp of every body created in this environment, and every time a body is added or removed. <b>[multi-thread safe]</b>
+    ///
+    /// Lets caches that depend on the state of all the bodies be validated without going through the bodies. \see KinBody::GetUpdateStamp
+    inline uint64_t GetBodiesUpdateStamp() const {
+        return __nBodiesUpdateStamp.load(std::memory_order_relaxed);
+    }
+
+    /// \brief called by the bodies every time their update stamp is incremented by inc, and by the environment when bodies are added or removed
+    inline void IncrementBodiesUpdateStamp(int inc=1) {
+        __nBodiesUpdateStamp.fetch_add((uint64_t)(int64_t)inc, std::memory_order_relaxed);
+    }
+
     /// \brief info structure used to initialize environment
     class OPENRAVE_API EnvironmentBaseInfo : public InfoBase
     {
@@ -882,7 +1087,8 @@ public:
         void DeserializeJSON(const rapidjson::Value& rEnvInfo, dReal fUnitScale, int options) override;
 
         /// \param vInputToBodyInfoMapping maps indices into rEnvInfo["bodies"] into indices of _vBodyInfos: rEnvInfo["bodies"][i] -> _vBodyInfos[vInputToBodyInfoMapping[i]]. This forces certain _vBodyInfos to get updated with specific input. Use -1 for no mapping
-        void DeserializeJSONWithMapping(const rapidjson::Value& rEnvInfo, dReal fUnitScale, int options, const std::vector<int>& vInputToBodyInfoMapping);
+        /// \param vPreparedBodyInfos optional infos already deserialized from rEnvInfo["bodies"][i] with the same fUnitScale and options. When the input i creates a new body info of the same type, vPreparedBodyInfos[i] is used instead of deserializing it again, so the new bodies can be deserialized concurrently beforehand.
+        void DeserializeJSONWithMapping(const rapidjson::Value& rEnvInfo, dReal fUnitScale, int options, const std::vector<int>& vInputToBodyInfoMapping, const std::vector<KinBody::KinBodyInfoPtr>& vPreparedBodyInfos=std::vector<KinBody::KinBodyInfoPtr>());
 
         std::string _description;   ///< environment description
         std::vector<std::string> _keywords;  ///< some string values for describinging the environment
@@ -942,6 +1148,7 @@ protected:
 private:
     UserDataPtr __pUserData;         ///< \see GetUserData
     int __nUniqueId;         ///< \see RaveGetEnvironmentId
+    std::atomic<uint64_t> __nBodiesUpdateStamp{0}; ///< \see GetBodiesUpdateStamp
 };
 
 } // end namespace OpenRAVE
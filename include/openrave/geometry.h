@@ -387,6 +387,69 @@ inline RaveVector<T> operator* (double f, const RaveVector<T>&left)
     return v;
 }
 
+/** \brief the arithmetic shared by RaveTransform, RaveTransformMatrix and quatMultiply
+
+    Every result element is a short chain of multiplies and adds over contiguous inputs, which GCC and clang already vectorize with
+    SSE/AVX/NEON. The results only depend on whether the compiler contracts the chains into fused multiply-adds, see OPT_DETERMINISTIC_MATH.
+ */
+namespace kernels {
+
+/// \brief q = q0*q1
+template <typename T>
+inline void QuatMultiply(const RaveVector<T>& q0, const RaveVector<T>& q1, RaveVector<T>& q)
+{
+    q.x = q0.x*q1.x - q0.y*q1.y - q0.z*q1.z - q0.w*q1.w;
+    q.y = q0.x*q1.y + q0.y*q1.x + q0.z*q1.w - q0.w*q1.z;
+    q.z = q0.x*q1.z + q0.z*q1.x + q0.w*q1.y - q0.y*q1.w;
+    q.w = q0.x*q1.w + q0.w*q1.x + q0.y*q1.z - q0.z*q1.y;
+}
+
+/// \brief v = rot*r, rot is a quaternion, v.w is 0
+template <typename T>
+inline void QuatRotate(const RaveVector<T>& rot, const RaveVector<T>& r, RaveVector<T>& v)
+{
+    T xx = 2 * rot.y * rot.y;
+    T xy = 2 * rot.y * rot.z;
+    T xz = 2 * rot.y * rot.w;
+    T xw = 2 * rot.y * rot.x;
+    T yy = 2 * rot.z * rot.z;
+    T yz = 2 * rot.z * rot.w;
+    T yw = 2 * rot.z * rot.x;
+    T zz = 2 * rot.w * rot.w;
+    T zw = 2 * rot.w * rot.x;
+
+    v.x = (1-yy-zz) * r.x + (xy-zw) * r.y + (xz+yw)*r.z;
+    v.y = (xy+zw) * r.x + (1-xx-zz) * r.y + (yz-xw)*r.z;
+    v.z = (xz-yw) * r.x + (yz+xw) * r.y + (1-xx-yy)*r.z;
+    v.w = 0;
+}
+
+/// \brief rows of t = rows of m * rows of r for 3x3 matrices with rows 4 elements long
+template <typename T>
+inline void MatrixMultiply(const T* m, const T* r, T* t)
+{
+    t[0*4+0] = m[0*4+0]*r[0*4+0]+m[0*4+1]*r[1*4+0]+m[0*4+2]*r[2*4+0];
+    t[0*4+1] = m[0*4+0]*r[0*4+1]+m[0*4+1]*r[1*4+1]+m[0*4+2]*r[2*4+1];
+    t[0*4+2] = m[0*4+0]*r[0*4+2]+m[0*4+1]*r[1*4+2]+m[0*4+2]*r[2*4+2];
+    t[1*4+0] = m[1*4+0]*r[0*4+0]+m[1*4+1]*r[1*4+0]+m[1*4+2]*r[2*4+0];
+    t[1*4+1] = m[1*4+0]*r[0*4+1]+m[1*4+1]*r[1*4+1]+m[1*4+2]*r[2*4+1];
+    t[1*4+2] = m[1*4+0]*r[0*4+2]+m[1*4+1]*r[1*4+2]+m[1*4+2]*r[2*4+2];
+    t[2*4+0] = m[2*4+0]*r[0*4+0]+m[2*4+1]*r[1*4+0]+m[2*4+2]*r[2*4+0];
+    t[2*4+1] = m[2*4+0]*r[0*4+1]+m[2*4+1]*r[1*4+1]+m[2*4+2]*r[2*4+1];
+    t[2*4+2] = m[2*4+0]*r[0*4+2]+m[2*4+1]*r[1*4+2]+m[2*4+2]*r[2*4+2];
+}
+
+/// \brief v = m*r + trans for 3x3 matrices with rows 4 elements long, v.w is untouched
+template <typename T>
+inline void MatrixTransform(const T* m, const RaveVector<T>& trans, const RaveVector<T>& r, RaveVector<T>& v)
+{
+    v.x = r.x * m[0] + r.y * m[1] + r.z * m[2] + trans.x;
+    v.y = r.x * m[4] + r.y * m[5] + r.z * m[6] + trans.y;
+    v.z = r.x * m[8] + r.y * m[9] + r.z * m[10] + trans.z;
+}
+
+} // end namespace kernels
+
 /** \brief Affine transformation parameterized with quaterions.
 
     \ingroup affine_math
@@ -428,20 +491,8 @@ public:
 
     /// transform a vector by the rotation component only
     inline RaveVector<T> rotate(const RaveVector<T>& r) const {
-        T xx = 2 * rot.y * rot.y;
-        T xy = 2 * rot.y * rot.z;
-        T xz = 2 * rot.y * rot.w;
-        T xw = 2 * rot.y * rot.x;
-        T yy = 2 * rot.z * rot.z;
-        T yz = 2 * rot.z * rot.w;
-        T yw = 2 * rot.z * rot.x;
-        T zz = 2 * rot.w * rot.w;
-        T zw = 2 * rot.w * rot.x;
-
         RaveVector<T> v;
-        v.x = (1-yy-zz) * r.x + (xy-zw) * r.y + (xz+yw)*r.z;
-        v.y = (xy+zw) * r.x + (1-xx-zz) * r.y + (yz-xw)*r.z;
-        v.z = (xz-yw) * r.x + (yz+xw) * r.y + (1-xx-yy)*r.z;
+        kernels::QuatRotate(rot, r, v);
         return v;
     }
 
@@ -449,10 +500,7 @@ public:
     inline RaveTransform<T> rotate(const RaveTransform<T>& r) const {
         RaveTransform<T> t;
         t.trans = rotate(r.trans);
-        t.rot.x = rot.x*r.rot.x - rot.y*r.rot.y - rot.z*r.rot.z - rot.w*r.rot.w;
-        t.rot.y = rot.x*r.rot.y + rot.y*r.rot.x + rot.z*r.rot.w - rot.w*r.rot.z;
-        t.rot.z = rot.x*r.rot.z + rot.z*r.rot.x + rot.w*r.rot.y - rot.y*r.rot.w;
-        t.rot.w = rot.x*r.rot.w + rot.w*r.rot.x + rot.y*r.rot.z - rot.z*r.rot.y;
+        kernels::QuatMultiply(rot, r.rot, t.rot);
 #if !defined(MATH_DISABLE_ASSERTS)
         const T l = t.rot.lengthsqr4();
         MATH_ASSERT( l > 0.99f && l < 1.01f );
@@ -466,10 +514,7 @@ public:
     inline RaveTransform<T> operator* (const RaveTransform<T>&r) const {
         RaveTransform<T> t;
         t.trans = operator*(r.trans);
-        t.rot.x = rot.x*r.rot.x - rot.y*r.rot.y - rot.z*r.rot.z - rot.w*r.rot.w;
-        t.rot.y = rot.x*r.rot.y + rot.y*r.rot.x + rot.z*r.rot.w - rot.w*r.rot.z;
-        t.rot.z = rot.x*r.rot.z + rot.z*r.rot.x + rot.w*r.rot.y - rot.y*r.rot.w;
-        t.rot.w = rot.x*r.rot.w + rot.w*r.rot.x + rot.y*r.rot.z - rot.z*r.rot.y;
+        kernels::QuatMultiply(rot, r.rot, t.rot);
 #if !defined(MATH_DISABLE_ASSERTS)
         const T l = t.rot.lengthsqr4();
         MATH_ASSERT( l > 0.99f && l < 1.01f );
@@ -578,18 +623,8 @@ public:
     /// t = this * r
     inline RaveTransformMatrix<T> operator* (const RaveTransformMatrix<T>&r) const {
         RaveTransformMatrix<T> t;
-        t.m[0*4+0] = m[0*4+0]*r.m[0*4+0]+m[0*4+1]*r.m[1*4+0]+m[0*4+2]*r.m[2*4+0];
-        t.m[0*4+1] = m[0*4+0]*r.m[0*4+1]+m[0*4+1]*r.m[1*4+1]+m[0*4+2]*r.m[2*4+1];
-        t.m[0*4+2] = m[0*4+0]*r.m[0*4+2]+m[0*4+1]*r.m[1*4+2]+m[0*4+2]*r.m[2*4+2];
-        t.m[1*4+0] = m[1*4+0]*r.m[0*4+0]+m[1*4+1]*r.m[1*4+0]+m[1*4+2]*r.m[2*4+0];
-        t.m[1*4+1] = m[1*4+0]*r.m[0*4+1]+m[1*4+1]*r.m[1*4+1]+m[1*4+2]*r.m[2*4+1];
-        t.m[1*4+2] = m[1*4+0]*r.m[0*4+2]+m[1*4+1]*r.m[1*4+2]+m[1*4+2]*r.m[2*4+2];
-        t.m[2*4+0] = m[2*4+0]*r.m[0*4+0]+m[2*4+1]*r.m[1*4+0]+m[2*4+2]*r.m[2*4+0];
-        t.m[2*4+1] = m[2*4+0]*r.m[0*4+1]+m[2*4+1]*r.m[1*4+1]+m[2*4+2]*r.m[2*4+1];
-        t.m[2*4+2] = m[2*4+0]*r.m[0*4+2]+m[2*4+1]*r.m[1*4+2]+m[2*4+2]*r.m[2*4+2];
-        t.trans[0] = r.trans[0] * m[0] + r.trans[1] * m[1] + r.trans[2] * m[2] + trans.x;
-        t.trans[1] = r.trans[0] * m[4] + r.trans[1] * m[5] + r.trans[2] * m[6] + trans.y;
-        t.trans[2] = r.trans[0] * m[8] + r.trans[1] * m[9] + r.trans[2] * m[10] + trans.z;
+        kernels::MatrixMultiply(m, r.m, t.m);
+        kernels::MatrixTransform(m, trans, r.trans, t.trans);
         return t;
     }
 
@@ -609,15 +644,7 @@ public:
 
     inline RaveTransformMatrix<T> rotate(const RaveTransformMatrix<T>& r) const {
         RaveTransformMatrix<T> t;
-        t.m[0*4+0] = m[0*4+0]*r.m[0*4+0]+m[0*4+1]*r.m[1*4+0]+m[0*4+2]*r.m[2*4+0];
-        t.m[0*4+1] = m[0*4+0]*r.m[0*4+1]+m[0*4+1]*r.m[1*4+1]+m[0*4+2]*r.m[2*4+1];
-        t.m[0*4+2] = m[0*4+0]*r.m[0*4+2]+m[0*4+1]*r.m[1*4+2]+m[0*4+2]*r.m[2*4+2];
-        t.m[1*4+0] = m[1*4+0]*r.m[0*4+0]+m[1*4+1]*r.m[1*4+0]+m[1*4+2]*r.m[2*4+0];
-        t.m[1*4+1] = m[1*4+0]*r.m[0*4+1]+m[1*4+1]*r.m[1*4+1]+m[1*4+2]*r.m[2*4+1];
-        t.m[1*4+2] = m[1*4+0]*r.m[0*4+2]+m[1*4+1]*r.m[1*4+2]+m[1*4+2]*r.m[2*4+2];
-        t.m[2*4+0] = m[2*4+0]*r.m[0*4+0]+m[2*4+1]*r.m[1*4+0]+m[2*4+2]*r.m[2*4+0];
-        t.m[2*4+1] = m[2*4+0]*r.m[0*4+1]+m[2*4+1]*r.m[1*4+1]+m[2*4+2]*r.m[2*4+1];
-        t.m[2*4+2] = m[2*4+0]*r.m[0*4+2]+m[2*4+1]*r.m[1*4+2]+m[2*4+2]*r.m[2*4+2];
+        kernels::MatrixMultiply(m, r.m, t.m);
         t.trans[0] = r.trans[0] * m[0] + r.trans[1] * m[1] + r.trans[2] * m[2];
         t.trans[1] = r.trans[0] * m[4] + r.trans[1] * m[5] + r.trans[2] * m[6];
         t.trans[2] = r.trans[0] * m[8] + r.trans[1] * m[9] + r.trans[2] * m[10];
@@ -1095,10 +1122,8 @@ std::istream& operator>>(std::istream& I, RaveTransformMatrix<U>&v)
 template <typename T>
 inline RaveVector<T> quatMultiply(const RaveVector<T>& quat0, const RaveVector<T>& quat1)
 {
-    RaveVector<T> q(quat0.x*quat1.x - quat0.y*quat1.y - quat0.z*quat1.z - quat0.w*quat1.w,
-                    quat0.x*quat1.y + quat0.y*quat1.x + quat0.z*quat1.w - quat0.w*quat1.z,
-                    quat0.x*quat1.z + quat0.z*quat1.x + quat0.w*quat1.y - quat0.y*quat1.w,
-                    quat0.x*quat1.w + quat0.w*quat1.x + quat0.y*quat1.z - quat0.z*quat1.y);
+    RaveVector<T> q;
+    kernels::QuatMultiply(quat0, quat1, q);
     // do not normalize since some quaternion math (like derivatives) do not correspond to unit quaternions
     return q;
 }
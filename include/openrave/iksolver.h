@@ -350,6 +350,19 @@ public:
     virtual bool SolveAll(const IkParameterization& param, const std::vector<dReal>& vFreeParameters, int filteroptions, std::vector<IkReturnPtr>& ikreturns);
     virtual bool SolveAll(const IkParameterization& param, const std::vector<dReal>& vFreeParameters, int filteroptions, IkFailureAccumulatorBasePtr paccumulator, std::vector<IkReturnPtr>& ikreturns);
 
+    /** \brief Solves many independent end effector poses, for example a set of grasp candidates, in one call.
+
+        Equivalent to calling \ref Solve for every pose, but the solver can share the setup of the robot, filters and collision checking
+        between the poses and solve them in parallel.
+        \param[in] vparams the poses in the manipulator base's coordinate system
+        \param[in] q0 Return solutions nearest to the given configuration q0 in terms of the joint distance. If q0 is empty, returns the first solution found
+        \param[in] filteroptions A bitmask of \ref IkFilterOptions values controlling what is checked for each ik solution.
+        \param[out] vikreturns one ik return for every pose in the same order, the action is IKRA_Success if a solution was found.
+        \param[in] numThreads maximum number of threads to solve with, solvers can ignore it.
+        \return number of poses with a solution
+     */
+    virtual int SolveBatch(const std::vector<IkParameterization>& vparams, const std::vector<dReal>& q0, int filteroptions, std::vector<IkReturnPtr>& vikreturns, int numThreads=1);
+
     /// \brief returns true if the solver supports a particular ik parameterization as input.
     virtual bool Supports(IkParameterizationType iktype) const OPENRAVE_DUMMY_IMPLEMENTATION;
 
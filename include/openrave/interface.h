@@ -105,6 +105,11 @@ struct OPENRAVE_API ReadablesContainer {
     /// \brief updates the readable interfaces. returns true if there are any changes
     virtual bool UpdateReadableInterfaces(const std::map<std::string, ReadablePtr>& newReadableInterfaces);
 
+    /// \brief returns an estimate of the bytes held by the readable interfaces <b>[multi-thread safe]</b>
+    ///
+    /// Readables are opaque, so their size is the size of their JSON serialization.
+    uint64_t GetReadablesMemoryUsage() const;
+
     boost::shared_mutex& GetReadableInterfaceMutex() const
     {
         return _mutexInterface;
@@ -205,6 +210,11 @@ public:
     /// \throw openrave_exception if command doesn't succeed
     virtual void Clone(InterfaceBaseConstPtr preference, int cloningoptions);
 
+    /// \brief adds an estimate of the heap memory held by the interface to memoryusage
+    ///
+    /// The default implementation only counts the readables in the "readables" category. Interfaces holding large data or caches override it and call the base implementation.
+    virtual void GetMemoryUsage(MemoryUsage& memoryusage) const;
+
     /// \brief return true if the command is supported
     virtual bool SupportsCommand(const std::string& cmd);
 
@@ -260,6 +270,49 @@ public:
         SendJSONCommand(cmdname, input, output, output.GetAllocator());
     }
 
+    /// \brief binary input and output of a typed command, see \ref SendTypedCommand
+    ///
+    /// The meaning of the values is defined by each command. Callers that send a command many times should keep the structures
+    /// around, so that the vectors do not have to be reallocated.
+    class OPENRAVE_API TypedCommandData
+    {
+public:
+        inline void Clear() {
+            vintvalues.resize(0);
+            vrealvalues.resize(0);
+        }
+        std::vector<int64_t> vintvalues;
+        std::vector<dReal> vrealvalues;
+    };
+
+    /// \brief The function executed for a typed command.
+    ///
+    /// \param interfacebase the interface the command is registered to
+    /// \param input input of the command
+    /// \param output output of the command, cleared before the call
+    /// \return If false, there was an error with the command, true if successful
+    typedef bool (*InterfaceTypedCommandFn)(InterfaceBase& interfacebase, const TypedCommandData& input, TypedCommandData& output);
+
+    /// \brief return true if the typed command is supported
+    virtual bool SupportsTypedCommand(const std::string& cmd);
+
+    /// \brief returns the function of a typed command, or NULL if not supported. <b>[multi-thread safe]</b>
+    ///
+    /// Calling the returned function with this interface skips looking up the command, so callers that run a command
+    /// many times, like custom ik filters, should get the function once. The function is valid as long as the interface is.
+    virtual InterfaceTypedCommandFn GetTypedCommand(const std::string& cmd);
+
+    /** \brief Similar to \ref SendCommand except the arguments are binary and are not parsed.
+
+        The command must be registered by \ref RegisterTypedCommand.
+        \param cmd command name
+        \param input input of the command
+        \param output output of the command, cleared before the command runs
+        \exception openrave_exception Throw if the command is not supported.
+        \return true if the command is successfully processed, otherwise false.
+     */
+    virtual bool SendTypedCommand(const std::string& cmd, const TypedCommandData& input, TypedCommandData& output);
+
     /** \brief serializes the interface
 
         The readable interfaces are also serialized within the tag, for example:
@@ -333,6 +386,17 @@ public:
     /// \brief Unregisters the command. <b>[multi-thread safe]</b>
     virtual void UnregisterJSONCommand(const std::string& cmdname);
 
+    /// \brief Registers a typed command and its help string. <b>[multi-thread safe]</b>
+    ///
+    /// \param cmdname - command name
+    /// \param fncmd function to execute for the command
+    /// \param strhelp - help string describing the values of the input and output, see \ref TypedCommandData.
+    /// \exception openrave_exception Throw if there exists a registered command already.
+    virtual void RegisterTypedCommand(const std::string& cmdname, InterfaceTypedCommandFn fncmd, const std::string& strhelp);
+
+    /// \brief Unregisters the typed command. <b>[multi-thread safe]</b>
+    virtual void UnregisterTypedCommand(const std::string& cmdname);
+
     virtual const char* GetHash() const = 0;
     std::string __description;     /// \see GetDescription()
     std::string __struri; ///< \see GetURI
@@ -366,6 +430,9 @@ private:
     typedef std::map<std::string, boost::shared_ptr<InterfaceJSONCommand>, CaseInsensitiveCompare> JSONCMDMAP;
     JSONCMDMAP __mapJSONCommands; ///< all registered commands
 
+    typedef std::map<std::string, std::pair<InterfaceTypedCommandFn, std::string>, CaseInsensitiveCompare> TYPEDCMDMAP;
+    TYPEDCMDMAP __mapTypedCommands; ///< all registered typed commands, the function and help string
+
 #ifdef RAVE_PRIVATE
 #ifdef _MSC_VER
     friend class Environment;
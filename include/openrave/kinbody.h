@@ -283,6 +283,41 @@ inline void EnableAllLinkStateBitMasks(std::vector<uint64_t>& linkEnableStateMas
     linkEnableStateMasks.back() = (1LU << (numLinks & 0x3f)) - 1;
 }
 
+/// \brief index of the lowest set bit of a non-zero word of a link state mask
+inline size_t GetLowestLinkStateBit(uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(word);
+#else
+    size_t ibit = 0;
+    while( !(word & 1) ) {
+        word >>= 1;
+        ++ibit;
+    }
+    return ibit;
+#endif
+}
+
+/// \brief calls fn(linkIndex) for every link below numLinks whose bit differs between two link state masks
+///
+/// The masks are compared 64 links at a time and only the differing bits are visited, so an unchanged body costs one comparison per 64 links. Missing words count as disabled.
+template <typename F>
+inline void ForEachChangedLinkStateBit(const std::vector<uint64_t>& linkEnableStateMasks0, const std::vector<uint64_t>& linkEnableStateMasks1, size_t numLinks, F fn)
+{
+    const size_t numWords = (numLinks + 63) >> 6;
+    for(size_t iword = 0; iword < numWords; ++iword) {
+        uint64_t changed = (iword < linkEnableStateMasks0.size() ? linkEnableStateMasks0[iword] : 0) ^ (iword < linkEnableStateMasks1.size() ? linkEnableStateMasks1[iword] : 0);
+        while( changed != 0 ) {
+            const size_t linkIndex = (iword << 6) + GetLowestLinkStateBit(changed);
+            if( linkIndex >= numLinks ) {
+                return;
+            }
+            fn(linkIndex);
+            changed &= changed - 1;
+        }
+    }
+}
+
 class Grabbed;
 typedef boost::shared_ptr<Grabbed> GrabbedPtr;
 typedef boost::shared_ptr<Grabbed const> GrabbedConstPtr;
@@ -651,6 +686,9 @@ public:
             return !!(_modifiedFields & field);
         }
 private:
+        /// \brief the inner empty volume relative to _t, \see ComputeInnerEmptyVolume
+        bool _ComputeInnerEmptyVolumeInGeometryFrame(Transform& tInnerEmptyVolume, Vector& abInnerEmptyExtents) const;
+
         Transform _t; ///< Local transformation of the geom primitive with respect to the link's coordinate system.
 
         uint32_t _modifiedFields = 0xffffffff; ///< a bitmap of GeometryInfoField, for supported fields, indicating which fields are touched, otherwise they can be skipped in UpdateFromInfo. By default, assume all fields are modified.
@@ -791,6 +829,11 @@ public:
             return _info._meshcollision;
         }
 
+        /// \brief returns the local collision mesh as a TriMeshCompact shared with all the geometries holding the same mesh
+        ///
+        /// Created on first use and cached until the shape stamp of the parent link changes, see \ref Link::GetGeometryShapeStamp. Not thread-safe, like the other accessors of the geometry.
+        TriMeshCompactConstPtr GetCompactCollisionMesh() const;
+
         inline const KinBody::GeometryInfo& GetInfo() const {
             return _info;
         }
@@ -816,6 +859,7 @@ public:
 
         /// \brief compute the inner empty volume in the parent link coordinate system
         ///
+        /// The volume relative to the geometry transform is cached until the shape stamp of the parent link changes, see \ref Link::GetGeometryShapeStamp. Not thread-safe, like the other accessors of the geometry.
         /// \return bool true if the geometry has a concept of empty volume nad tInnerEmptyVolume/abInnerEmptyVolume are filled
         bool ComputeInnerEmptyVolume(Transform& tInnerEmptyVolume, Vector& abInnerEmptyExtents) const;
         //@}
@@ -856,6 +900,13 @@ public:
         /// \return true if the normal is changed to face outside of the shape
         bool ValidateContactNormal(const Vector& position, Vector& normal) const;
 
+        /// \brief validates the normals of many contacts like \ref ValidateContactNormal, the world transform of the geometry is inverted once for all of them.
+        ///
+        /// \param vcontacts the contacts in the world coordinate system, their normals are flipped in place to face outside of the shape
+        /// \param tLink the world transform of the parent link
+        /// \return the number of flipped normals
+        int ValidateContactNormals(std::vector<CONTACT>& vcontacts, const Transform& tLink) const;
+
         /// \brief sets a new render filename for the geometry. This does not change the collision
         void SetRenderFilename(const std::string& renderfilename);
 
@@ -937,8 +988,19 @@ public:
         }
 
 protected:
+        /// \brief true if the normal at the position points inside of the shape, both are in the geometry coordinate system
+        bool _IsContactNormalInside(const Vector& position, const Vector& normal) const;
+
         boost::weak_ptr<Link> _parent;
         KinBody::GeometryInfo _info; ///< geometry info
+        mutable TriMeshCompactConstPtr _pCompactCollisionMesh; ///< \see GetCompactCollisionMesh
+        mutable const Link* _pCompactCollisionMeshLink = nullptr; ///< link whose shape stamp _pCompactCollisionMesh was created at
+        mutable int _nCompactCollisionMeshShapeStamp = 0;
+        mutable Transform _tInnerEmptyVolumeInGeometry; ///< \see ComputeInnerEmptyVolume, relative to the geometry transform
+        mutable Vector _vInnerEmptyExtents;
+        mutable const Link* _pInnerEmptyVolumeLink = nullptr; ///< link whose shape stamp the inner empty volume was computed at
+        mutable int _nInnerEmptyVolumeShapeStamp = 0;
+        mutable bool _bHasInnerEmptyVolume = false;
 #ifdef RAVE_PRIVATE
 #ifdef _MSC_VER
         friend class OpenRAVEXMLParser::LinkXMLReader;
@@ -962,6 +1024,9 @@ protected:
     /// \brief Describes the properties of a link used to initialize it
     class OPENRAVE_API LinkInfo : public InfoBase
     {
+        // the transform is read by every kinematics and collision update, so it is kept at the front, away from the names and the maps
+        Transform _t; ///< the current transformation of the link with respect to the world coordinate system
+
 public:
         LinkInfo() {
         };
@@ -1056,8 +1121,6 @@ public:
         }
 
 private:
-        Transform _t; ///< the current transformation of the link with respect to the world coordinate system
-
         uint32_t _modifiedFields = 0xffffffff; ///< a bitmap of LinkInfoField, for supported fields, indicating which fields are touched, otherwise they can be skipped in UpdateFromInfo. By default, assume all fields are modified.
 
         /// \brief deserializes a readable from rReadable and stores it into _mReadableInterfaces[id]
@@ -1146,6 +1209,14 @@ public:
             return _collision;
         }
 
+        /// \brief incremented every time the set of geometries of the link or the shape of one of them changes.
+        ///
+        /// Changes of only the local transforms of the geometries do not increment it, so listeners of Prop_LinkGeometry can compare it
+        /// with the stamp they last built from and only update the geometry transforms when it is the same.
+        inline int GetGeometryShapeStamp() const {
+            return _nGeometryShapeStamp;
+        }
+
         /// \brief Compute the aabb of all the geometries of the link in the link coordinate system
         AABB ComputeLocalAABB() const;
 
@@ -1424,6 +1495,12 @@ protected:
         /// \param parameterschanged if true, will
         void _Update(bool parameterschanged=true, uint32_t extraParametersChanged=0);
 
+        /// \brief Updates the cached information after only the local transforms of some geometries changed, keeps GetGeometryShapeStamp.
+        void _UpdateGeometryTransforms();
+
+        /// \brief recomputes _collision from the geometries
+        void _UpdateCollisionData();
+
         std::vector<GeometryPtr> _vGeometries;         ///< \see GetGeometries
 
         LinkInfo _info; ///< parameter information of the link
@@ -1438,6 +1515,7 @@ private:
         std::vector<int> _vRigidlyAttachedLinks;         ///< \see IsRigidlyAttached, GetRigidlyAttachedLinks
         TriMesh _collision; ///< triangles for collision checking, triangles are always the triangulation
                             ///< of the body when it is at the identity transformation
+        int _nGeometryShapeStamp = 0; ///< \see GetGeometryShapeStamp
         //@}
 #ifdef RAVE_PRIVATE
 #ifdef _MSC_VER
@@ -1544,6 +1622,10 @@ public:
         std::vector<DOFHierarchy> _vmimicdofs;         ///< all dof indices that the equations depends on. DOFHierarchy::dofindex can repeat
         OpenRAVEFunctionParserRealPtr _posfn;
         std::vector<OpenRAVEFunctionParserRealPtr > _velfns, _accelfns;         ///< the velocity and acceleration partial derivatives with respect to each of the values in _vdofformat
+
+        /// \brief if an equation is affine in the values of _vdofformat, its coefficients followed by the constant term so that it is evaluated without the function parser. Empty otherwise.
+        std::vector<dReal> _vposcoeffs;
+        std::vector< std::vector<dReal> > _vvelcoeffs, _vaccelcoeffs;         ///< affine coefficients of each of _velfns and _accelfns
         //@}
     };
     typedef boost::shared_ptr<Mimic> MimicPtr;
@@ -2183,18 +2265,19 @@ private:
         /// Sensitive variables that should not be modified.
         /// @name Private Joint Variables
         //@{
+        // the variables read by every forward kinematics update come first so that they share cache lines with _doflastsetvalues
         int dofindex;                   ///< the degree of freedom index in the body's DOF array, does not index in KinBody::_vecjoints!
         int jointindex;                 ///< the joint index into KinBody::_vecjoints
-        boost::array<dReal,3> _vcircularlowerlimit, _vcircularupperlimit;         ///< for circular joints, describes where the identification happens. this is set internally in _ComputeInternalInformation
-
-        KinBodyWeakPtr _parent;               ///< body that joint belong to
+        bool _bInitialized;
+        int8_t _nIsStatic; ///< If 1, then joint is static and shouldnot move. If 0, then joint is not static. If -1, then still unknown
         boost::array<LinkPtr,2> _attachedbodies;         ///< attached bodies. The link in [0] is computed first in the hierarchy before the other body.
         boost::array<Vector,3> _vaxes;                ///< normalized axes, this can be different from _info._vaxes and reflects how _tRight and _tLeft are computed
-        Transform _tRight, _tLeft;         ///< transforms used to get body[1]'s transformation with respect to body[0]'s: Tbody1 = Tbody0 * tLeft * JointOffsetLeft * JointRotation * JointOffsetRight * tRight
+        Transform _tLeft, _tRight;         ///< transforms used to get body[1]'s transformation with respect to body[0]'s: Tbody1 = Tbody0 * tLeft * JointOffsetLeft * JointRotation * JointOffsetRight * tRight
+
+        KinBodyWeakPtr _parent;               ///< body that joint belong to
+        boost::array<dReal,3> _vcircularlowerlimit, _vcircularupperlimit;         ///< for circular joints, describes where the identification happens. this is set internally in _ComputeInternalInformation
         Transform _tRightNoOffset, _tLeftNoOffset;         ///< same as _tLeft and _tRight except it doesn't not include the offset
         Transform _tinvRight, _tinvLeft;         ///< the inverse transformations of tRight and tLeft
-        bool _bInitialized;
-        int8_t _nIsStatic; ///< If 1, then joint is static and shouldnot move. If 0, then joint is not static. If -1, then still unknown
         //@}
 #ifdef RAVE_PRIVATE
 #ifdef _MSC_VER
@@ -2292,6 +2375,15 @@ public:
     typedef boost::shared_ptr<KinBody::BodyState> BodyStatePtr;
     typedef boost::shared_ptr<KinBody::BodyState const> BodyStateConstPtr;
 
+    /// \brief contiguous structure-of-arrays copy of the poses of all links, \see KinBody::GetLinkPoses
+    class OPENRAVE_API LinkPoses
+    {
+public:
+        std::vector<dReal> vQuaternions; ///< 4 values (w,x,y,z) per link ordered by link index
+        std::vector<dReal> vTranslations; ///< 3 values (x,y,z) per link ordered by link index
+        int updatestamp = -1; ///< \see KinBody::GetUpdateStamp when the poses were copied
+    };
+
     /// \brief Access point of the sensor system that manages the body.
     class OPENRAVE_API ManageData : public boost::enable_shared_from_this<ManageData>
     {
@@ -2503,6 +2595,54 @@ private:
 
     typedef boost::shared_ptr<KinBodyStateSaverRef> KinBodyStateSaverRefPtr;
 
+    /// \brief Saves and restores the kinbody state like \ref KinBodyStateSaverRef, but is meant to be kept and reused in inner loops.
+    ///
+    /// Only the fields requested by the options are captured, and the buffers of a previous save are reused so that saving the same body
+    /// again does not allocate. Restoring the link transformations copies them directly into the links and only triggers the
+    /// Prop_LinkTransforms callbacks if some transformation actually changed. Grabbed bodies are only released and re-grabbed if the grab
+    /// state changed. The state can only be restored to the body it was saved from, and the body has to outlive the saved state.
+    /// Nothing is restored on destruction.
+    class OPENRAVE_API ReusableKinBodyStateSaver
+    {
+public:
+        ReusableKinBodyStateSaver();
+        virtual ~ReusableKinBodyStateSaver();
+
+        /// \brief saves the state of the body, replacing any previously saved state
+        ///
+        /// \param options the parameters to save, see \ref SaveParameters
+        void Save(KinBody& body, int options = Save_LinkTransformation|Save_LinkEnable);
+
+        /// \brief restores the saved state to the body it was saved from. The state is kept, so it can be restored again.
+        ///
+        /// Does nothing if no state is saved.
+        void Restore();
+
+        /// \brief forgets the saved state, but keeps the buffers for the next save.
+        void Release();
+
+        /// \brief returns true if a state is saved
+        inline bool IsSaved() const {
+            return !!_pbody;
+        }
+
+        /// \brief returns the body the state was saved from, or null if no state is saved
+        inline KinBody* GetBody() const {
+            return _pbody;
+        }
+protected:
+        KinBody* _pbody; ///< the body of the saved state, null if none
+        int _options;         ///< saved options
+        std::vector<Transform> _vLinkTransforms;
+        std::vector<uint8_t> _vEnabledLinks;
+        std::vector<std::pair<Vector,Vector> > _vLinkVelocities;
+        std::vector<dReal> _vdoflastsetvalues;
+        std::vector<dReal> _vMaxVelocities, _vMaxAccelerations, _vMaxJerks, _vDOFWeights, _vDOFLimits[2], _vDOFResolutions;
+        std::vector<GrabbedPtr> _vGrabbedBodies;
+    };
+
+    typedef boost::shared_ptr<ReusableKinBodyStateSaver> ReusableKinBodyStateSaverPtr;
+
     virtual ~KinBody();
 
     /// return the static interface type this class points to (used for safe casting)
@@ -2838,6 +2978,12 @@ private:
     /// Knowing the dof branches allows the robot to recover the full state of the joints with SetLinkTransformations
     void GetLinkTransformations(std::vector<Transform>& transforms, std::vector<dReal>& doflastsetvalues) const;
 
+    /// \brief get the poses of all the links as contiguous quaternion and translation arrays.
+    ///
+    /// Like GetLinkTransformations, fills a buffer of the caller so that several threads can read the poses concurrently.
+    /// The arrays are only refreshed when LinkPoses::updatestamp differs from the update stamp of the body, so calling this repeatedly with the same buffer is cheap, which requires the buffer to be used with only this body. Useful for publishing or synchronizing external copies of the link poses.
+    void GetLinkPoses(LinkPoses& poses) const;
+
     /// \brief gets the enable states of all links
     void GetLinkEnableStates(std::vector<uint8_t>& enablestates) const;
 
@@ -2973,6 +3119,7 @@ private:
 
     /// \brief Sets the joint values of the robot.
     ///
+    /// Only the links downstream of the dofs whose values changed are recomputed, and if no value changed the link transforms are left untouched and no change callbacks are called.
     /// \param[in] pJointValues pointer to head of array that holds joint angles (ordered by the dof indices)
     /// \param[in] dof number of dof described by array of pJointValues.
     /// \param[in] checklimits one of \ref CheckLimitsAction and will excplicitly check the joint limits before setting the values and clamp them.
@@ -2986,6 +3133,17 @@ private:
     /// \param[in] checklimits one of \ref CheckLimitsAction and will excplicitly check the joint limits before setting the values and clamp them.
     virtual void SetDOFValues(const std::vector<dReal>& values, const Transform& transform, uint32_t checklimits = CLA_CheckLimits);
 
+    /// \brief Computes the link transforms of a configuration in precision T without changing the state of the body.
+    ///
+    /// T can be float or double. Use float for throughput-oriented queries like visibility checks or building reachability maps,
+    /// where the precision of SetDOFValues is not needed. Limits are not checked and grabbed bodies are not moved.
+    /// Links that are not connected to the root through a joint keep their current transform.
+    /// \param pdofvalues GetDOF() values
+    /// \param vlinktransforms the transforms of all the links, indexed like GetLinks()
+    /// \throw openrave_exception ORE_NotImplemented if a joint is a hinge2, spherical or trajectory joint
+    template <typename T>
+    void ComputeLinkTransformations(const T* pdofvalues, std::vector< RaveTransform<T> >& vlinktransforms) const;
+
     virtual void SetJointValues(const std::vector<dReal>& values, const Transform& transform, bool checklimits = true)
     {
         SetDOFValues(values,transform,static_cast<uint32_t>(checklimits));
@@ -3015,6 +3173,17 @@ private:
     /// \param dofindices the dof indices to compute the jacobian for. If empty, will compute for all the dofs
     virtual void ComputeJacobianTranslation(const int linkindex, const Vector& position, std::vector<dReal>& jacobian, const std::vector<int>& dofindices = {}) const;
 
+    /// \brief Computes the translation jacobians of several world positions in one pass.
+    ///
+    /// Equivalent to calling ComputeJacobianTranslation for every (linkindex, position) pair, but consecutive pairs with the same link index share the chain traversal,
+    /// and the results are written to a caller-owned buffer so that nothing is allocated unless the chain contains passive mimic joints.
+    /// \param vLinkPositions pairs of (link index, position in world space)
+    /// The output precision T can be float or double, float is enough for perception queries and halves the memory of the jacobians.
+    /// \param pjacobians output buffer of size 3*dofstride*vLinkPositions.size(), where dofstride is dofindices.size() if not empty, otherwise GetDOF(). The 3xdofstride jacobian of pair i starts at pjacobians+3*dofstride*i.
+    /// \param dofindices the dof indices to compute the jacobian for. If empty, will compute for all the dofs
+    template <typename T>
+    void ComputeJacobianTranslations(const std::vector< std::pair<int, Vector> >& vLinkPositions, T* pjacobians, const std::vector<int>& dofindices = {}) const;
+
     /// \brief calls std::vector version of ComputeJacobian internally
     virtual void CalculateJacobian(const int linkindex, const Vector& position, std::vector<dReal>& jacobian) const;
 
@@ -3104,6 +3273,33 @@ private:
      */
     virtual void ComputeInverseDynamics(std::vector<dReal>& doftorques, const std::vector<dReal>& dofaccelerations, const ForceTorqueMap& externalforcetorque=ForceTorqueMap()) const;
 
+    /// \brief buffers of the inverse dynamics computation that the caller can keep so that repeated calls do not allocate
+    struct InverseDynamicsWorkspace
+    {
+        std::vector<dReal> vDOFVelocities;
+        std::vector< std::pair<Vector, Vector> > vLinkVelocities, vLinkAccelerations, vLinkForceTorques; ///< linear, angular
+        std::vector<Vector> vLinkCOMLinearAccelerations, vLinkCOMMomentOfInertia;
+        AccelerationMap mapExternalAccelerations;
+        std::vector<std::pair<int,dReal> > vDofindexDerivativePairs;
+        std::map< std::pair<Mimic::DOFFormat, int>, dReal > mapCachedPartials;
+        std::vector<dReal> vStateDOFVelocities, vStateDOFAccelerations, vStateDOFTorques; ///< used by ComputeInverseDynamicsBatch
+    };
+
+    /// \brief Computes the inverse dynamics like \ref ComputeInverseDynamics, but reuses the buffers of workspace.
+    virtual void ComputeInverseDynamics(std::vector<dReal>& doftorques, const std::vector<dReal>& dofaccelerations, const ForceTorqueMap& externalforcetorque, InverseDynamicsWorkspace& workspace) const;
+
+    /** \brief Computes the inverse dynamics of many states of the body with one workspace.
+
+        Every quantity is stored in its own array of numstates*GetDOF() values, the values of state i start at i*GetDOF().
+        The state of the body is restored when the function returns. The base link keeps its current transform and velocity.
+        \param[out] doftorques the output torques of every state
+        \param[in] dofvalues the dof values of every state
+        \param[in] dofvelocities the dof velocities of every state. If empty, the velocities are 0
+        \param[in] dofaccelerations the dof accelerations of every state. If empty, the accelerations are 0
+        \param workspace buffers reused for all the states
+     */
+    virtual void ComputeInverseDynamicsBatch(std::vector<dReal>& doftorques, const std::vector<dReal>& dofvalues, const std::vector<dReal>& dofvelocities, const std::vector<dReal>& dofaccelerations, InverseDynamicsWorkspace& workspace);
+
     /** \brief Computes the separated inverse dynamics torque terms from the current robot position, velocity, and acceleration.
 
         torques = M(dofvalues) * dofaccel + C(dofvalues,dofvel) * dofvel + G(dofvalues)
@@ -3123,6 +3319,30 @@ private:
      */
     virtual void ComputeInverseDynamics(boost::array< std::vector<dReal>, 3>& doftorquecomponents, const std::vector<dReal>& dofaccelerations, const ForceTorqueMap& externalforcetorque=ForceTorqueMap()) const;
 
+    /** \brief Computes the joint-space inertia matrix M(dofvalues) of the current configuration.
+
+        Uses the composite rigid body algorithm, which is O(n^2) in the number of joints. Passive mimic joints contribute through their
+        partial derivatives and the rotor inertias of the electric motors are added to the diagonal. The torques of prismatic joints follow
+        the scaling of ComputeInverseDynamics. The result is cached until the update stamp of the body changes.
+        \param[out] massmatrix GetDOF()xGetDOF() row-major matrix so that torques = massmatrix * dofaccelerations + coriolis + gravity
+     */
+    virtual void ComputeMassMatrix(std::vector<dReal>& massmatrix) const;
+
+    /** \brief Computes the gravity torques G(dofvalues) of the current configuration, the same as the third component of ComputeInverseDynamics without external forces.
+
+        The result is cached until the update stamp of the body or the gravity of the physics engine changes.
+        \param[out] doftorques GetDOF() torques holding the body against gravity
+     */
+    virtual void ComputeGravityTorques(std::vector<dReal>& doftorques) const;
+
+    /** \brief Computes the Coriolis matrix C(dofvalues,dofvelocities) of the current configuration and dof velocities.
+
+        The velocity of the base link is ignored like in the second component of ComputeInverseDynamics. The derivatives of the mimic equations
+        are treated as constant, which is exact for linear mimic joints. Since velocities do not change the update stamp, the result is not cached.
+        \param[out] coriolismatrix GetDOF()xGetDOF() row-major matrix so that coriolismatrix * dofvelocities are the coriolis and centripetal torques
+     */
+    virtual void ComputeCoriolisMatrix(std::vector<dReal>& coriolismatrix) const;
+
     /** \brief Computes dynamic limits for acceleration and jerks, which are dynamically changing based on the given positions and velocities of the robot.
 
         Since not all robots supports dynamic limits, so this function should be overriden in the subclass.
@@ -3286,6 +3506,45 @@ private:
     /// \brief adds the pair of links to the adjacency list. This is
     void SetAdjacentLinks(int linkindex0, int linkindex1);
 
+    /// \brief kinematics hierarchy computed by _ComputeInternalInformation that only depends on how the links and joints are connected.
+    ///
+    /// Shared by clones and by all bodies with the same structure key, so they do not recompute it.
+    struct KinematicsHierarchy
+    {
+        std::vector<int> vstructurekey; ///< \see _GetKinematicsStructureKey
+        std::vector<std::pair<int16_t,int16_t> > vAllPairsShortestPaths;
+        std::vector<int> vTopologicallySortedJointIndicesAll;
+        std::vector<int8_t> vJointsAffectingLinks;
+        std::vector< std::vector<int> > vParentLinks; ///< Link::_vParentLinks of every link
+        std::vector< std::vector< std::pair<int16_t,int16_t> > > vClosedLoopIndices;
+    };
+
+    /// \brief link pairs that never came closer than a margin while sampling the joint space, shared by all bodies sampled with the same kinematics geometry hash, DOF limits, number of samples and margin
+    struct NeverCollidingLinkPairs
+    {
+        std::string kinematicsGeometryHash; ///< hash of the body the pairs were sampled on
+        std::vector<dReal> vLowerLimits, vUpperLimits; ///< DOF limits the configurations were sampled in
+        int numSamples = 0; ///< number of random configurations that were checked
+        dReal fMargin = 0; ///< link pairs closer than this in any sample are kept
+        std::vector<uint64_t> vPairsMask; ///< bit (i + j*(j-1)/2) is set if links i < j never collided
+    };
+
+    /// \brief samples the joint space and removes the non-adjacent link pairs that never collided from GetNonAdjacentLinks
+    ///
+    /// Link pairs are checked with the self collision checker at the current configuration and at numSamples random configurations within the DOF limits, drawn from a generator seeded with the kinematics geometry hash. Adjacent pairs are never removed, and pairs that collided or came closer than fMargin in any sample are kept. If the checker does not support CO_Distance, pairs whose bounding boxes came closer than fMargin are kept. The pairs that never collided are skipped by every subsequent self-collision check of this body, until its geometry or DOF limits change. The result is cached for the whole process keyed by GetKinematicsGeometryHash(), the DOF limits, numSamples and fMargin, so other bodies with the same kinematics, geometry and limits and clones of this body reuse it without sampling. Since the matrix is sampled, collisions in very small regions of the joint space can be missed, so use enough samples and a margin for the robot.
+    /// \param numSamples number of random configurations to check
+    /// \param bForceRecompute if true, resamples even if the process already has a result for this body
+    /// \param fMargin link pairs closer than this distance in any sample are kept
+    void ComputeNeverCollidingLinkPairs(int numSamples=10000, bool bForceRecompute=false, dReal fMargin=0.01);
+
+    /// \brief stops pruning the link pairs found by ComputeNeverCollidingLinkPairs for this body
+    void ResetNeverCollidingLinkPairs();
+
+    /// \brief return true if the non-adjacent link pairs of this body are pruned by ComputeNeverCollidingLinkPairs
+    inline bool HasNeverCollidingLinkPairs() const {
+        return !!_pNeverCollidingLinkPairs;
+    }
+
     /// \brief return if two links are adjacent links are not.
     bool AreAdjacentLinks(int linkindex0, int linkindex1) const;
 
@@ -3315,10 +3574,16 @@ private:
     /// \brief Increments the unique id that indicates the number of transformation state changes of any link. Used to check if robot state has changed.
     void IncrementUpdateStamp(const int inc=1) {
         _nUpdateStampId += inc;
+        GetEnv()->IncrementBodiesUpdateStamp(inc);
     }
 
     virtual void Clone(InterfaceBaseConstPtr preference, int cloningoptions);
 
+    /// \brief adds the memory of the links, geometries, joints and readables of the body
+    ///
+    /// Categories: "meshes" (collision meshes of the geometries and the aggregated meshes of the links), "links", "joints", "kinematics" (the caches of the body structure), "readables" (of the body, links and joints) and "sharedcompactmeshes" (\ref TriMeshCompact created by the geometries).
+    virtual void GetMemoryUsage(MemoryUsage& memoryusage) const override;
+
     /// \brief Register a callback with the interface.
     ///
     /// Everytime a static property of the interface changes, all
@@ -3328,6 +3593,19 @@ private:
     /// \param properties a mask of the \ref KinBodyProperty values that the callback should be called for when they change
     virtual UserDataPtr RegisterChangeCallback(uint32_t properties, const boost::function<void()>& callback) const;
 
+    /// \brief Coalesces the change callbacks of a body while in scope.
+    ///
+    /// The properties changed while the coalescer is alive are accumulated and the callbacks of every changed property
+    /// are called once when the outermost coalescer of the body is destroyed. Has to be used from the thread modifying the body.
+    class OPENRAVE_API ChangeCallbackCoalescer
+    {
+public:
+        ChangeCallbackCoalescer(KinBody& body);
+        virtual ~ChangeCallbackCoalescer();
+protected:
+        KinBody& _body;
+    };
+
     void Serialize(BaseXMLWriterPtr writer, int options=0) const;
 
     /// \brief A md5 hash unique to the particular kinematic and geometric structure of a KinBody.
@@ -3605,12 +3883,35 @@ protected:
     /// \param[in] externalaccelerations [optional] The external accelerations to add to each link. When doing inverse dynamics, should set the base link's acceleration to -gravity.
     virtual void _ComputeLinkAccelerations(const std::vector<dReal>& dofvelocities, const std::vector<dReal>& dofaccelerations, const std::vector< std::pair<Vector, Vector> >& linkvelocities, std::vector<std::pair<Vector,Vector> >& linkaccelerations, AccelerationMapConstPtr externalaccelerations=AccelerationMapConstPtr()) const;
 
+    struct DynamicsJoint;
+    struct CompositeInertia;
+
+    /// \brief collects the joints moving the links in topological order for the joint-space dynamics terms
+    ///
+    /// \param[out] vlinkjoints for every link, the index into vjoints of the joint moving it or -1 for root links
+    void _GetDynamicsJoints(std::vector<DynamicsJoint>& vjoints, std::vector<int>& vlinkjoints) const;
+
+    /// \brief computes the inertia of every link together with all the links below it
+    void _ComputeCompositeInertias(const std::vector<DynamicsJoint>& vjoints, std::vector<CompositeInertia>& vcomposites) const;
+
     /// \brief Called to notify the body that certain groups of parameters have been changed.
     ///
     /// This function in calls every registers calledback that is tracking the changes. It also
     /// recomputes the hashes if geometry changed.
     virtual void _PostprocessChangedParameters(uint32_t parameters);
 
+    /// \brief increments _nUpdateStampId and the bodies update stamp of the environment
+    inline void _IncrementUpdateStamp() const {
+        ++_nUpdateStampId;
+        GetEnv()->IncrementBodiesUpdateStamp();
+    }
+
+    /// \brief calls the registered callbacks of every property in parameters
+    void _CallChangeCallbacks(uint32_t parameters);
+
+    /// \brief fills vkey with the link and joint connectivity, static links and mimic dependencies that the \ref KinematicsHierarchy is computed from
+    void _GetKinematicsStructureKey(std::vector<int>& vkey) const;
+
     /// \brief Return true if two bodies should be considered as one during collision (ie one is grabbing the other)
     bool _IsAttached(const KinBody &body, std::set<KinBodyConstPtr>& setChecked) const;
 
@@ -3637,6 +3938,14 @@ protected:
     /// \brief Update transforms and velocities of the grabbed bodies
     void _UpdateGrabbedBodies();
 
+    /// \brief Update transforms and velocities of the grabbed bodies whose grabbing link moved
+    ///
+    /// \param vLinksMoved for every link index, 1 if the link moved
+    void _UpdateGrabbedBodies(const std::vector<uint8_t>& vLinksMoved);
+
+    /// \brief sets the transform and velocity of one grabbed body from its grabbing link. The transform is only set when it changed.
+    void _UpdateGrabbedBody(const Grabbed& grabbed, KinBody& grabbedBody);
+
     /// \brief removes grabbed body. cleans links from the grabbed body in _listNonCollidingLinksWhenGrabbed of other grabbed bodies.
     std::vector<GrabbedPtr>::iterator _RemoveGrabbedBody(std::vector<GrabbedPtr>::iterator itGrabbed);
 
@@ -3683,11 +3992,16 @@ protected:
 
     std::vector<GrabbedPtr> _vGrabbedBodies; ///< vector of grabbed bodies
 
-    mutable std::vector<std::list<UserDataWeakPtr> > _vlistRegisteredCallbacks; ///< callbacks to call when particular properties of the body change. _vlistRegisteredCallbacks[index] is the list of change callbacks where 1<<index is part of KinBodyProperty, this makes it easy to find out if any particular bits have callbacks. The registration/de-registration of the lists can happen at any point and does not modify the kinbody state exposed to the user, hence it is mutable.
+    typedef std::vector< boost::shared_ptr< const boost::function<void()> > > ChangeCallbackVector;
+    typedef boost::shared_ptr<const ChangeCallbackVector> ChangeCallbackVectorConstPtr;
+    mutable boost::array<ChangeCallbackVectorConstPtr, 32> _vRegisteredCallbacks; ///< callbacks to call when particular properties of the body change. _vRegisteredCallbacks[index] holds the change callbacks where 1<<index is part of KinBodyProperty, or is empty if there are none. The vectors are never modified once published: registration/de-registration copies them under the interface mutex and swaps them with boost::atomic_store, so the callbacks can be called without locking or allocating. Does not modify the kinbody state exposed to the user, hence it is mutable.
 
     mutable boost::array<std::vector<int>, 4> _vNonAdjacentLinks; ///< contains cached versions of the non-adjacent links depending on values in AdjacentOptions. Declared as mutable since data is cached.
     mutable boost::array<std::set<int>, 4> _cacheSetNonAdjacentLinks; ///< used for caching return value of GetNonAdjacentLinks.
     mutable int _nNonAdjacentLinkCache; ///< specifies what information is currently valid in the AdjacentOptions.  Declared as mutable since data is cached. If 0x80000000 (ie < 0), then everything needs to be recomputed including _setNonAdjacentLinks[0].
+
+    boost::shared_ptr<const KinematicsHierarchy> _pKinematicsHierarchy; ///< hierarchy of the last _ComputeInternalInformation, reused as long as the structure key does not change
+    boost::shared_ptr<const NeverCollidingLinkPairs> _pNeverCollidingLinkPairs; ///< if set, pairs in the mask are left out of _vNonAdjacentLinks[0] \see ComputeNeverCollidingLinkPairs
     std::vector<Transform> _vInitialLinkTransformations; ///< the initial transformations of each link specifying at least one pose where the robot is collision free
 
     mutable std::vector<int8_t> _vAttachedVisitedCache; ///< cache
@@ -3695,6 +4009,13 @@ protected:
     mutable std::vector< boost::array<dReal, 3> > _vPassiveJointValuesCache;
     mutable std::vector< boost::array<dReal, 3> > _vPassiveJointAccelerationsCache;
     mutable std::vector<uint8_t> _vLinksVisitedCache;
+    mutable std::mutex _mutexDynamicsCaches; ///< protects the caches of ComputeMassMatrix and ComputeGravityTorques, which are filled by const calls from several threads
+    mutable std::vector<dReal> _vMassMatrixCache, _vGravityTorquesCache; ///< caches for ComputeMassMatrix and ComputeGravityTorques
+    mutable int _nMassMatrixCacheStamp, _nGravityTorquesCacheStamp; ///< update stamps of the caches, -1 if not computed
+    mutable Vector _vGravityTorquesCacheGravity; ///< gravity used for _vGravityTorquesCache
+    std::vector<uint8_t> _vLinksMovedCache; ///< cache for SetDOFValues, 1 for links whose transform has to be recomputed
+    std::vector<dReal> _vPreviousDOFValuesCache; ///< cache for SetDOFValues, dof values before setting the new ones
+    bool _bForceFullKinematicsUpdate = false; ///< if true, the next SetDOFValues recomputes all the link transforms even if the values did not change. Set by Link::SetTransform
     mutable std::vector<dReal> _vTempMimicValues, _vTempMimicValues2, _vTempMimicValues3;
 
 
@@ -3707,6 +4028,8 @@ protected:
     int _environmentBodyIndex; ///< \see GetEnvironmentBodyIndex
     mutable int _nUpdateStampId; ///< \see GetUpdateStamp
     uint32_t _nParametersChanged; ///< set of parameters that changed and need callbacks
+    uint32_t _nCoalescedParametersChanged; ///< set of parameters that changed while a \ref ChangeCallbackCoalescer is alive
+    int _nChangeCallbackCoalescers; ///< number of \ref ChangeCallbackCoalescer alive for this body
     ManageDataPtr _pManageData;
     uint32_t _nHierarchyComputed; ///< 2 if the joint heirarchy and other cached information is computed. 1 if the hierarchy information is computing
     bool _bMakeJoinedLinksAdjacent; ///< if true, then automatically add adjacent links to the adjacency list so that their self-collisions are ignored.
@@ -3797,6 +4120,14 @@ public:
     ///        more than once with different input links to ignore.
     void AddMoreIgnoreLinks(const std::set<int>& setAdditionalGrabberLinksToIgnore);
 
+    /// \brief records the update stamps of the grabber and the grabbed body, called once the grab finished.
+    void RecordUpdateStamps();
+
+    /// \brief returns true if neither the grabber nor the grabbed body changed since RecordUpdateStamps, so they are still in the state saved
+    ///        when they were grabbed. Any change of the link transforms, geometries, active geometry groups or enable states increments the
+    ///        update stamps. In that case a grab of the same body with the same link, relative transform and ignored links gets the same result from ComputeListNonCollidingLinks.
+    bool IsStateUnchanged() const;
+
     // Member Variables
     KinBodyWeakPtr _pGrabbedBody; ///< the body being grabbed
     KinBody::LinkPtr _pGrabbingLink; ///< the link used for grabbing _pGrabbedBody. Its transform (as well as the transforms of other links rigidly attached to _pGrabbingLink) relative to the grabbed body remains constant until the grabbed body is released.
@@ -3809,6 +4140,7 @@ private:
     std::vector<KinBody::LinkPtr> _vAttachedToGrabbingLink; ///< vector of all links that are rigidly attached to _pGrabbingLink
     KinBody::KinBodyStateSaverPtr _pGrabberSaver; ///< statesaver that saves the snapshot of the grabber at the time Grab is called. The saved state will be used (i.e. restored) temporarily when computation of _listNonCollidingLinksWhenGrabbed is necessary.
     KinBody::KinBodyStateSaverPtr _pGrabbedSaver; ///< statesaver that saves the snapshot of the grabbed at the time Grab is called. The saved state will be used (i.e. restored) temporarily when computation of _listNonCollidingLinksWhenGrabbed is necessary.
+    int _nGrabberUpdateStamp = -1, _nGrabbedUpdateStamp = -1; ///< KinBody::GetUpdateStamp of the grabber and the grabbed body when the grab finished, see RecordUpdateStamps
 
 }; // end class Grabbed
 
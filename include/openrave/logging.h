@@ -20,7 +20,11 @@
 #ifndef OPENRAVE_LOGGING_H
 #define OPENRAVE_LOGGING_H
 
+#include <iosfwd>
 #include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #if OPENRAVE_LOG4CXX
@@ -523,6 +527,182 @@ DefineRavePrintfA(_VERBOSELEVEL)
 
 #define IS_DEBUGLEVEL(level) ((OpenRAVE::RaveGetDebugLevel()&OpenRAVE::Level_OutputMask)>=(level))
 
+/// \brief writes the message of a deferred log into the stream, see \ref RAVELOG_VERBOSE_DEFERRED
+typedef boost::function<void (std::ostream&)> RaveLogFormatFn;
+
+/** \brief Keeps the last numMessages deferred messages that were filtered out by the debug level. <b>[multi-thread safe]</b>
+
+    The messages of \ref RAVELOG_VERBOSE_DEFERRED and the like are only formatted if their level is enabled. When it is not and the
+    history is enabled, their arguments are copied into the history instead, so that they can be formatted by \ref RaveDumpLogHistory
+    once an error occurs. The history is also enabled by RaveInitialize when the OPENRAVE_LOG_HISTORY environment variable is set to its size.
+    \param numMessages size of the history, 0 disables it and removes all the kept messages
+ */
+OPENRAVE_API void RaveSetLogHistory(size_t numMessages);
+
+/// \brief true if the filtered out deferred messages are kept. <b>[multi-thread safe]</b>
+OPENRAVE_API bool RaveIsLogHistoryEnabled();
+
+/// \brief adds a message to the history, the message is only formatted when the history is written. <b>[multi-thread safe]</b>
+///
+/// \param filename, function have to outlive the history, so should be string literals
+OPENRAVE_API void RaveAddLogHistory(int level, const char* filename, int line, const char* function, const RaveLogFormatFn& formatfn);
+
+/// \brief writes the kept messages from the oldest to the newest, one per line. <b>[multi-thread safe]</b>
+OPENRAVE_API void RaveWriteLogHistory(std::ostream& o);
+
+/// \brief logs the kept messages at level as one message and removes them from the history. <b>[multi-thread safe]</b>
+OPENRAVE_API void RaveDumpLogHistory(int level=Level_Error);
+
+namespace logging_detail {
+
+inline void FormatLogArgs(boost::format&)
+{
+}
+
+template <typename T, typename... Args>
+inline void FormatLogArgs(boost::format& f, const T& arg, const Args&... args)
+{
+    f % arg;
+    FormatLogArgs(f, args...);
+}
+
+/// \brief how a deferred log argument is kept, strings are copied since the pointers can be invalidated before the history is written
+template <typename T>
+struct DeferredLogArg
+{
+    typedef typename std::decay<const T>::type type;
+};
+
+template <>
+struct DeferredLogArg<const char*>
+{
+    typedef std::string type;
+};
+
+template <>
+struct DeferredLogArg<char*>
+{
+    typedef std::string type;
+};
+
+template <std::size_t N>
+struct DeferredLogArg<char[N]>
+{
+    typedef std::string type;
+};
+
+/// \brief copies the arguments of a message and formats them with boost::format when called
+template <typename... Args>
+class DeferredLogFormatter
+{
+public:
+    DeferredLogFormatter(const char* fmt, const Args&... args) : _fmt(fmt), _args(args...) {
+    }
+
+    void operator()(std::ostream& o) const
+    {
+        try {
+            boost::format f(_fmt);
+            _Format(f, std::index_sequence_for<Args...>());
+            o << f;
+        }
+        catch(const boost::io::format_error& ex) {
+            o << "failed to format '" << _fmt << "': " << ex.what();
+        }
+    }
+
+private:
+    template <std::size_t... I>
+    void _Format(boost::format& f, std::index_sequence<I...>) const
+    {
+        FormatLogArgs(f, std::get<I>(_args)...);
+    }
+
+    const char* _fmt; ///< string literal
+    std::tuple<typename DeferredLogArg<Args>::type...> _args;
+};
+
+} // end namespace logging_detail
+
+/// \brief formats the message with boost::format taking the arguments as a list instead of with operator%
+template <typename... Args>
+inline std::string RaveFormatLog(const char* fmt, const Args&... args)
+{
+    boost::format f(fmt);
+    logging_detail::FormatLogArgs(f, args...);
+    return f.str();
+}
+
+/// \brief copies the arguments into the history without formatting them
+template <typename... Args>
+inline void RaveAddLogHistoryDeferred(int level, const char* filename, int line, const char* function, const char* fmt, const Args&... args)
+{
+    RaveAddLogHistory(level, filename, line, function, logging_detail::DeferredLogFormatter<Args...>(fmt, args...));
+}
+
+/// \brief logs the message if level is enabled, otherwise copies its arguments into the history if enabled. The arguments are only formatted when the message is written.
+#define RAVELOG_LEVEL_DEFERRED(LOGMACRO, level, ...) do { if( IS_DEBUGLEVEL(level) ) { LOGMACRO(OpenRAVE::RaveFormatLog(__VA_ARGS__)); } else if( OpenRAVE::RaveIsLogHistoryEnabled() ) { OpenRAVE::RaveAddLogHistoryDeferred(level, OpenRAVE::RaveGetSourceFilename(__FILE__), __LINE__, __FUNCTION__, __VA_ARGS__); } } while (0)
+
+/// \brief RAVELOG_VERBOSE_DEFERRED("iter=%d, dist=%f\n", iter, dist) is RAVELOG_VERBOSE_FORMAT with the arguments as a list, see \ref RaveSetLogHistory
+#define RAVELOG_INFO_DEFERRED(...) RAVELOG_LEVEL_DEFERRED(RAVELOG_INFO, OpenRAVE::Level_Info, __VA_ARGS__)
+#define RAVELOG_DEBUG_DEFERRED(...) RAVELOG_LEVEL_DEFERRED(RAVELOG_DEBUG, OpenRAVE::Level_Debug, __VA_ARGS__)
+#define RAVELOG_VERBOSE_DEFERRED(...) RAVELOG_LEVEL_DEFERRED(RAVELOG_VERBOSE, OpenRAVE::Level_Verbose, __VA_ARGS__)
+
+/** \brief Starts or stops recording the scopes of \ref OPENRAVE_TRACE_SCOPE. <b>[multi-thread safe]</b>
+
+    Every thread records its scopes into its own ring buffer of numEventsPerThread events without taking any lock, once a buffer is
+    full the oldest scopes of the thread are overwritten. Tracing is also started by RaveInitialize when the OPENRAVE_TRACE environment
+    variable is set, in which case the trace is written to the file it names by RaveDestroy.
+    \param numEventsPerThread size of the buffers of the threads that have not recorded anything yet
+ */
+OPENRAVE_API void RaveSetTracing(bool bEnable, size_t numEventsPerThread=65536);
+
+/// \brief true if the scopes are being recorded. <b>[multi-thread safe]</b>
+OPENRAVE_API bool RaveIsTracingEnabled();
+
+/** \brief Writes the recorded scopes in the Chrome trace event format, which can be opened with chrome://tracing or Perfetto. <b>[multi-thread safe]</b>
+
+    The scopes that are overwritten while writing are skipped, so stop the tracing before writing for a complete trace.
+ */
+OPENRAVE_API void RaveWriteTrace(std::ostream& o);
+
+/// \brief Removes all the recorded scopes. <b>[multi-thread safe]</b>
+OPENRAVE_API void RaveClearTrace();
+
+/// \brief records the time spent until it goes out of scope if tracing is enabled, use with \ref OPENRAVE_TRACE_SCOPE
+class OPENRAVE_API RaveTraceScope
+{
+public:
+    /// \param name has to outlive the trace, so should be a string literal
+    RaveTraceScope(const char* name) : _name(NULL), _starttime(0) {
+        if( RaveIsTracingEnabled() ) {
+            _Begin(name);
+        }
+    }
+    ~RaveTraceScope() {
+        if( !!_name ) {
+            _End();
+        }
+    }
+
+private:
+    void _Begin(const char* name);
+    void _End();
+
+    const char* _name; ///< NULL if not recording
+    uint64_t _starttime; ///< ns
+};
+
+#define OPENRAVE_TRACE_CONCAT_(a, b) a ## b
+#define OPENRAVE_TRACE_CONCAT(a, b) OPENRAVE_TRACE_CONCAT_(a, b)
+
+#ifdef OPENRAVE_DISABLE_TRACING
+#define OPENRAVE_TRACE_SCOPE(name) do {} while(0)
+#else
+/// \brief records the time until the end of the current scope with the name (a string literal) when tracing is enabled, see \ref RaveSetTracing
+#define OPENRAVE_TRACE_SCOPE(name) OpenRAVE::RaveTraceScope OPENRAVE_TRACE_CONCAT(__openravetracescope, __LINE__)(name)
+#endif
+
 }
 
 #endif
@@ -59,6 +59,13 @@ public:
         return false;
     }
 
+    /// \brief True if \ref SimulationStep can run concurrently with the steps of other sensors and modules.
+    ///
+    /// A parallel-safe step must not lock the environment or use the environment collision checker.
+    virtual bool IsSimulationStepParallelSafe() const {
+        return false;
+    }
+
     /// \brief sets the ik failure accumulator to use when running functions
     virtual void SetIkFailureAccumulator(IkFailureAccumulatorBasePtr& pIkFailureAccumulator);
     
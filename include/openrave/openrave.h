@@ -64,6 +64,7 @@
 #include <iomanip>
 #include <fstream>
 #include <sstream>
+#include <mutex>
 
 // QTBUG-22829 alternative workaround
 #ifndef Q_MOC_RUN
@@ -238,6 +239,7 @@ enum InterfaceType
 };
 
 class CollisionReport;
+class CONTACT;
 class ReadablesContainer;
 class InterfaceBase;
 class IkSolverBase;
@@ -337,6 +339,7 @@ enum CloningOptions {
     Clone_Modules = 0x0020, ///< if specified, will clone the modules attached to the environment
     Clone_PassOnMissingBodyReferences=0x00008000, ///< if specified, then will not throw an exception if a body reference is missing in the environment. For example, the grabbed body in GrabbedInfo
     Clone_IgnoreGrabbedBodies = 0x00010000, ///< if specified, then will not clone _vGrabbedBodies when cloning a KinBody/Robot.
+    Clone_ShareGeometry = 0x00020000, ///< if specified, cloned bodies share the immutable GeometryInfo objects of their geometry groups and the compact collision meshes (see KinBody::Geometry::GetCompactCollisionMesh) of their link geometries with the source body instead of deep copying them. The link geometries themselves and their TriMesh collision meshes are still copied. Groups are only ever replaced (copy-on-write), so GeometryInfo objects returned by KinBody::Link::GetGeometriesFromGroup must not be modified in place. Useful for keeping one lightweight environment snapshot per planning thread.
     Clone_All = 0xffffffff,
 };
 
@@ -661,6 +664,48 @@ private:
 };
 typedef boost::shared_ptr<StringReadable> StringReadablePtr;
 
+/// \brief readable that keeps the JSON it was loaded from and only deserializes it when it is first accessed
+///
+/// Loading bodies from JSON stores their readable interfaces this way, so the registered JSON readers only run for the readables that are used.
+/// \ref ReadablesContainer::GetReadableInterface returns the deserialized readable, code iterating over \ref ReadablesContainer::GetReadableInterfaces has to call \ref Resolve before casting.
+/// If no JSON reader is registered for the id and the JSON is not a string, the readable cannot be deserialized and serializing it writes back the JSON it was loaded from.
+class OPENRAVE_API LazyJSONReadable : public Readable
+{
+public:
+    /// \param type the interface type to find the JSON reader with, see \ref RaveCallJSONReader
+    LazyJSONReadable(InterfaceType type, const std::string& id, const rapidjson::Value& rReadable, dReal fUnitScale);
+    virtual ~LazyJSONReadable();
+
+    /// \brief returns the deserialized readable, deserializes it on the first call. <b>[multi-thread safe]</b>
+    ///
+    /// \return empty if the readable cannot be deserialized
+    ReadablePtr GetReadable() const;
+
+    /// \brief true if GetReadable was called successfully
+    bool IsDeserialized() const;
+
+    /// \brief the number of bytes of the JSON that is kept until the readable is deserialized
+    size_t GetJSONSize() const;
+
+    /// \brief returns the deserialized readable if readable is a LazyJSONReadable, otherwise readable itself
+    static ReadablePtr Resolve(const ReadablePtr& readable);
+
+    bool SerializeXML(BaseXMLWriterPtr writer, int options=0) const override;
+    bool SerializeJSON(rapidjson::Value& value, rapidjson::Document::AllocatorType& allocator, dReal fUnitScale=1.0, int options=0) const override;
+    bool operator==(const Readable& other) const override;
+    ReadablePtr CloneSelf() const override;
+
+private:
+    LazyJSONReadable(InterfaceType type, const std::string& id, const std::string& json, dReal fUnitScale);
+
+    InterfaceType _type;
+    dReal _fUnitScale; ///< the unit scale the JSON has to be deserialized with
+    mutable boost::mutex _mutex; ///< protects the members below
+    mutable std::string _json; ///< compact JSON of the readable, released once it is deserialized
+    mutable ReadablePtr _pReadable; ///< the deserialized readable
+    mutable bool _bFailedToDeserialize; ///< if true, there is no JSON reader for the readable, so GetReadable does not try again
+};
+
 /// \brief returns a string of the ik parameterization type names
 ///
 /// \param[in] alllowercase If 1, sets all characters to lower case. Otherwise can include upper case in order to match \ref IkParameterizationType definition.
@@ -752,6 +797,79 @@ protected:
         BaseXMLReaderPtr _preader;
     };
 
+    /** \brief Precomputed conversion of data from a source specification to a target specification.
+
+        Compiling matches the groups, parses their names and reads the default values of uninitialized target values from the environment once, so
+        \ref Apply only has to copy contiguous blocks, fill constants and convert rotations. Gives the same results as \ref ConvertData as long as the
+        environment state used for the default values does not change, see \ref HasEnvironmentDefaultValues.
+     */
+    class OPENRAVE_API ConversionPlan
+    {
+public:
+        ConversionPlan();
+
+        /// \brief compiles the plan, see \ref Compile
+        ConversionPlan(const ConfigurationSpecification& targetspec, const ConfigurationSpecification& sourcespec, EnvironmentBaseConstPtr penv, bool filluninitialized = true);
+
+        /** \brief compiles the conversion from sourcespec to targetspec, the arguments are the same as \ref ConvertData
+
+            \throw openrave_exception throw if groups are incompatible
+         */
+        void Compile(const ConfigurationSpecification& targetspec, const ConfigurationSpecification& sourcespec, EnvironmentBaseConstPtr penv, bool filluninitialized = true);
+
+        /// \brief converts numpoints points of the source specification at psourcedata to the target specification at ittargetdata
+        void Apply(std::vector<dReal>::iterator ittargetdata, const dReal* psourcedata, size_t numpoints) const;
+
+        /// \brief converts numpoints points of the source specification at itsourcedata to the target specification at ittargetdata
+        inline void Apply(std::vector<dReal>::iterator ittargetdata, std::vector<dReal>::const_iterator itsourcedata, size_t numpoints) const {
+            Apply(ittargetdata, &(*itsourcedata), numpoints);
+        }
+
+        /// \brief returns true if some of the default values were read from the environment when compiling
+        inline bool HasEnvironmentDefaultValues() const {
+            return _bEnvironmentDefaultValues;
+        }
+
+        inline int GetTargetDOF() const {
+            return _targetdof;
+        }
+        inline int GetSourceDOF() const {
+            return _sourcedof;
+        }
+
+protected:
+        /// \brief adds the conversion of gsource to gtarget, the offsets of the groups are ignored and targetoffset and sourceoffset are used instead
+        void _AddGroupConversion(int targetoffset, const Group& gtarget, int sourceoffset, const Group& gsource, EnvironmentBaseConstPtr penv, bool filluninitialized);
+
+        /// \brief adds the default values of a target group that has no compatible source group
+        void _AddGroupDefaultValues(int targetoffset, const Group& gtarget, EnvironmentBaseConstPtr penv);
+
+        /// \brief adds a copy of the targetindex value from sourceindex, merging with the previous copy if both are contiguous
+        void _AddCopy(int targetindex, int sourceindex);
+
+        void _Apply(std::vector<dReal>::iterator ittargetdata, size_t targetstride, const dReal* psourcedata, size_t sourcestride, size_t numpoints) const;
+
+        /// \brief a block of contiguous values that is copied
+        struct CopyBlock
+        {
+            int targetindex, sourceindex, count;
+        };
+        /// \brief rotation values that need to be converted to a different representation
+        struct RotationConversion
+        {
+            int targetindex, sourceindex;
+            boost::function< void(std::vector<dReal>::iterator, const dReal*) > converterfn;
+        };
+
+        std::vector<CopyBlock> _vcopyblocks;
+        std::vector< std::pair<int, dReal> > _vdefaultvalues; ///< target index and value
+        std::vector<RotationConversion> _vrotationconversions;
+        int _targetdof, _sourcedof;
+        bool _bEnvironmentDefaultValues;
+
+        friend class ConfigurationSpecification;
+    };
+
     ConfigurationSpecification();
     ConfigurationSpecification(const Group& g);
     ConfigurationSpecification(const ConfigurationSpecification& c);
@@ -1079,6 +1197,18 @@ protected:
      */
     static void ConvertData(std::vector<dReal>::iterator ittargetdata, const ConfigurationSpecification& targetspec, std::vector<dReal>::const_iterator itsourcedata, const ConfigurationSpecification& sourcespec, size_t numpoints, EnvironmentBaseConstPtr penv, bool filluninitialized = true);
 
+    /** \brief Converts from one specification to another.
+
+        \param ittargetdata iterator pointing to start of target group data that should be overwritten
+        \param targetspec the target configuration specification
+        \param psourcedata pointer to start of source group data that should be read
+        \param sourcespec the source configuration specification
+        \param numpoints the number of points to convert. The target and source strides are gtarget.dof and gsource.dof
+        \param penv [optional] The environment which might be needed to fill in unknown data. Assumes environment is locked.
+        \param filluninitialized If there exists target groups that cannot be initialized, then will set default values using the current environment. For example, the current joint values of the body will be used.
+     */
+    static void ConvertData(std::vector<dReal>::iterator ittargetdata, const ConfigurationSpecification& targetspec, const dReal* psourcedata, const ConfigurationSpecification& sourcespec, size_t numpoints, EnvironmentBaseConstPtr penv, bool filluninitialized = true);
+
     /// \brief gets the name of the interpolation that represents the derivative of the passed in interpolation.
     ///
     /// For example GetInterpolationDerivative("quadratic") -> "linear"
@@ -2521,6 +2651,129 @@ public:
 OPENRAVE_API std::ostream& operator<<(std::ostream& O, const TriMesh& trimesh);
 OPENRAVE_API std::istream& operator>>(std::istream& I, TriMesh& trimesh);
 
+class TriMeshCompact;
+typedef boost::shared_ptr<TriMeshCompact const> TriMeshCompactConstPtr;
+
+/** \brief Immutable and compact copy of a TriMesh, shared by everyone holding the same mesh.
+
+    The vertices are stored as 3 floats (12 bytes instead of the 32 bytes of a Vector) and the indices as 16-bit integers when all of them fit, otherwise as 32-bit integers.
+    Meshes are only created through \ref Create, which returns the existing instance when a mesh with the same compact data is still alive somewhere in the process, so the geometries of clones and of bodies loaded from the same file, and the collision and viewer backends reading them, all hold one buffer.
+    Since the vertices are rounded to float, meshes that differ by less than the float precision share the same instance.
+ */
+class OPENRAVE_API TriMeshCompact
+{
+public:
+    /// \brief returns the shared compact copy of mesh, creating it if no equal mesh is alive. Thread-safe.
+    static TriMeshCompactConstPtr Create(const TriMesh& mesh);
+
+    /// \brief number of distinct meshes currently alive in the process
+    static size_t GetNumSharedMeshes();
+
+    inline size_t GetNumVertices() const {
+        return _vertices.size()/3;
+    }
+    inline size_t GetNumIndices() const {
+        return _indices16.size() + _indices32.size();
+    }
+
+    /// \brief true if the indices are stored as 16-bit integers, see \ref GetIndices16
+    inline bool HasIndices16() const {
+        return _indices32.empty() && !_indices16.empty();
+    }
+
+    /// \brief x,y,z of every vertex
+    inline const float* GetVertices() const {
+        return _vertices.empty() ? NULL : &_vertices[0];
+    }
+
+    /// \brief the indices if \ref HasIndices16, otherwise NULL
+    inline const uint16_t* GetIndices16() const {
+        return _indices16.empty() ? NULL : &_indices16[0];
+    }
+
+    /// \brief the indices if not \ref HasIndices16, otherwise NULL
+    inline const uint32_t* GetIndices32() const {
+        return _indices32.empty() ? NULL : &_indices32[0];
+    }
+
+    inline Vector GetVertex(size_t ivertex) const {
+        const float* p = &_vertices.at(3*ivertex);
+        return Vector(p[0], p[1], p[2]);
+    }
+
+    inline int32_t GetIndex(size_t iindex) const {
+        return _indices32.empty() ? (int32_t)_indices16.at(iindex) : (int32_t)_indices32.at(iindex);
+    }
+
+    /// \brief hash of the compact data, equal meshes have equal hashes
+    inline size_t GetHash() const {
+        return _hash;
+    }
+
+    /// \brief expands the mesh back to a TriMesh
+    void GetTriMesh(TriMesh& mesh) const;
+
+    AABB ComputeAABB() const;
+
+    /// \brief bytes used by the vertex and index buffers
+    size_t GetMemoryUsage() const;
+
+    bool operator==(const TriMeshCompact& other) const {
+        return _hash == other._hash && _vertices == other._vertices && _indices16 == other._indices16 && _indices32 == other._indices32;
+    }
+    bool operator!=(const TriMeshCompact& other) const {
+        return !operator==(other);
+    }
+
+private:
+    TriMeshCompact();
+
+    std::vector<float> _vertices;
+    std::vector<uint16_t> _indices16; ///< filled if all indices are in [0, 65535]
+    std::vector<uint32_t> _indices32; ///< filled otherwise
+    size_t _hash;
+};
+
+/** \brief Estimate of the heap memory held by an object and the objects it owns, in bytes.
+
+    The bytes of the object itself are split in categories like "meshes" or "bvhs", and the owned objects are children, so the usage of an environment is a tree of its bodies, collision checker, physics engine, modules and viewers.
+    Buffers shared between several objects (like \ref TriMeshCompact or the BVH caches of the collision checkers) are put in categories prefixed with "shared", since summing them over the objects counts them several times.
+ */
+class OPENRAVE_API MemoryUsage
+{
+public:
+    MemoryUsage() {
+    }
+    MemoryUsage(const std::string& name_, const std::string& type_) : name(name_), type(type_) {
+    }
+
+    /// \brief adds bytes to a category
+    inline void Add(const std::string& category, uint64_t bytes) {
+        mapCategoryBytes[category] += bytes;
+    }
+
+    /// \brief adds a child and returns it
+    MemoryUsage& AddChild(const std::string& name, const std::string& type);
+
+    /// \brief sum of the bytes of all the categories of the object and its children
+    ///
+    /// \param bIncludeShared if false, skips the categories prefixed with "shared"
+    uint64_t GetTotal(bool bIncludeShared=true) const;
+
+    void SerializeJSON(rapidjson::Value& rMemoryUsage, rapidjson::Document::AllocatorType& allocator, int options=0) const;
+
+    std::string name; ///< name of the object
+    std::string type; ///< kind of object, e.g. "kinbody", "collisionchecker"
+    std::map<std::string, uint64_t> mapCategoryBytes; ///< bytes held by the object itself for every category
+    std::list<MemoryUsage> listChildren; ///< objects owned by the object
+};
+
+/// \brief bytes of the buffer of a vector
+template <typename T>
+inline uint64_t GetVectorMemoryUsage(const std::vector<T>& v) {
+    return v.capacity()*sizeof(T);
+}
+
 /// \brief Selects which DOFs of the affine transformation to include in the active configuration.
 enum DOFAffine
 {
@@ -2608,6 +2861,7 @@ OPENRAVE_API ConfigurationSpecification RaveGetAffineConfigurationSpecification(
 }
 
 #include <openrave/plugininfo.h>
+#include <openrave/taskscheduler.h>
 #include <openrave/interface.h>
 #include <openrave/spacesampler.h>
 #include <openrave/kinbody.h>
@@ -36,6 +36,47 @@ OPENRAVE_API void DumpMsgPack(const rapidjson::Value& value, std::vector<char>&
 OPENRAVE_API void ParseMsgPack(rapidjson::Document& d, const std::string& str);
 OPENRAVE_API void ParseMsgPack(rapidjson::Document& d, std::istream& is);
 OPENRAVE_API void ParseMsgPack(rapidjson::Document& d, const void* data, size_t size);
+
+/// \brief msgpack extension types written by MsgPackStreamWriter for numeric arrays. ParseMsgPack expands them back to json arrays.
+enum MsgPackExtensionType
+{
+    MPET_Float64Array = 1, ///< little endian 64-bit floats
+    MPET_Int32Array = 2, ///< little endian 32-bit signed integers
+};
+
+/// \brief writes msgpack values one at a time to a stream or a buffer, so large documents do not have to be built as a rapidjson document first.
+///
+/// msgpack stores the number of elements in the header of maps and arrays, so they have to be started with their final size.
+class OPENRAVE_API MsgPackStreamWriter
+{
+public:
+    MsgPackStreamWriter(std::ostream& os);
+    MsgPackStreamWriter(std::vector<char>& output);
+
+    void StartMap(uint32_t numMembers);
+    void StartArray(uint32_t numElements);
+    void WriteString(const char* str, size_t length);
+    void WriteString(const std::string& str) {
+        WriteString(str.c_str(), str.size());
+    }
+
+    /// \brief writes a whole rapidjson value
+    void WriteValue(const rapidjson::Value& value);
+
+    /// \brief writes the array as one MPET_Float64Array extension blob
+    void WriteFloat64Array(const double* values, size_t numValues);
+
+    /// \brief writes the array as one MPET_Int32Array extension blob
+    void WriteInt32Array(const int32_t* values, size_t numValues);
+
+private:
+    template <typename F>
+    void _Pack(F fn);
+
+    std::ostream* _pos; ///< if not null, the stream to write to
+    std::vector<char>* _poutput; ///< if not null, the buffer to append to
+};
+
 } // namespace MsgPack
 
 } // namespace OpenRAVE
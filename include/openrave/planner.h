@@ -24,6 +24,10 @@
 
 namespace OpenRAVE {
 
+namespace planningutils {
+class ConfigurationCollisionCache;
+}
+
 /// \brief Controls what information gets validated when calling the constraints functions in planner parameters
 ///
 /// By default, the lower 16 bits are set while the upper 16bits are zero.
@@ -118,6 +122,14 @@ public:
         _fTimeBasedSurpassMult = 1.0;
     }
 
+    /// \brief exchanges _configurations and _configurationtimes with caller-owned buffers.
+    ///
+    /// Clear keeps the capacity of the buffers, so a ConstraintFilterReturn reused across checks does not reallocate them. Callers that keep the checked configurations can take them with this function instead of copying them, and give back their own buffers (cleared) so the next check fills an already allocated arena.
+    inline void SwapCheckedConfigurations(std::vector<dReal>& configurations, std::vector<dReal>& configurationtimes) {
+        _configurations.swap(configurations);
+        _configurationtimes.swap(configurationtimes);
+    }
+
     std::vector<dReal> _configurations; ///< N*dof vector of the configurations used to check constraints. If the constraints were invalid, they stop at the first invalid constraint
     std::vector<dReal> _configurationtimes; ///< N vector of the times where each configuration was sampled at. If timeelapsed is set in the check path constraints function, then this is scaled by this time. Otherwise it is a value in [0,1] that describes the interpolation coefficient: 0 is the initial configuration, 1 is the final configuration.
 
@@ -131,6 +143,57 @@ public:
 
 typedef boost::shared_ptr<ConstraintFilterReturn> ConstraintFilterReturnPtr;
 
+/** \brief Time spent in and number of calls to the parts of planning, filled by the planners when PlannerParameters::_profile is set. <b>Not multi-thread safe.</b>
+
+    The profile is shared by the copies of the parameters, so the post-processing planners add to the profile of the planner calling them.
+    Because of that the stages can overlap, for example the smoothing time includes the constraint checking done by the smoother.
+    Planners with parallel workers add the times of all their workers, so a stage can take longer than the planning itself.
+    Times are cumulative in us, and nothing is reset between calls to PlanPath.
+ */
+class OPENRAVE_API PlannerProfile
+{
+public:
+    enum ProfileStage {
+        PPS_Sampling=0, ///< sampling of new configurations
+        PPS_NearestNeighbor=1, ///< nearest neighbor queries in the planner trees
+        PPS_ConstraintChecking=2, ///< PlannerParameters::CheckPathAllConstraints, includes the collision checking
+        PPS_IK=3, ///< inverse kinematics, including the goal samplers that solve ik
+        PPS_Smoothing=4, ///< PlanPath of the path smoothers
+        PPS_Retiming=5, ///< PlanPath of the trajectory retimers
+        PPS_Count=6,
+    };
+
+    /// \brief measures the time of one call of a stage until it goes out of scope, does nothing if profile is NULL
+    class OPENRAVE_API StageTimer
+    {
+public:
+        StageTimer(PlannerProfile* profile, ProfileStage stage);
+        ~StageTimer();
+private:
+        PlannerProfile* _profile;
+        ProfileStage _stage;
+        uint64_t _starttime;
+    };
+
+    PlannerProfile();
+
+    void Reset();
+
+    /// \brief adds the times and counts of r, used for merging the profiles of planner workers
+    void Add(const PlannerProfile& r);
+
+    void SaveToJson(rapidjson::Value& rProfile, rapidjson::Document::AllocatorType& alloc) const;
+
+    /// \brief name of the stage in the json output
+    static const char* GetStageName(ProfileStage stage);
+
+    uint64_t vStageTimeUS[PPS_Count]; ///< us, cumulative time of every stage
+    uint64_t vStageCalls[PPS_Count]; ///< number of calls of every stage, for PPS_ConstraintChecking this is the number of constraint checks
+    uint64_t numCollisionCalls; ///< number of body configurations checked for env or self collisions by planningutils::DynamicsCollisionConstraint
+};
+
+typedef boost::shared_ptr<PlannerProfile> PlannerProfilePtr;
+
 /** \brief Describes a common and serializable interface for planning parameters.
 
     The class is serializable to XML, so can be loaded from file or passed around the network.
@@ -296,6 +359,8 @@ private:
         if( !_checkpathvelocityconstraintsfn ) {
             return true;
         }
+        OPENRAVE_TRACE_SCOPE("PlannerParameters::CheckPathAllConstraints");
+        PlannerProfile::StageTimer timer(_profile.get(), PlannerProfile::PPS_ConstraintChecking);
         return _checkpathvelocityconstraintsfn(q0, q1, dq0, dq1, elapsedtime, interval, options, filterreturn);
     }
 
@@ -329,6 +394,8 @@ private:
         if( !_checkpathvelocityaccelerationconstraintsfn ) {
             return true;
         }
+        OPENRAVE_TRACE_SCOPE("PlannerParameters::CheckPathAllConstraints");
+        PlannerProfile::StageTimer timer(_profile.get(), PlannerProfile::PPS_ConstraintChecking);
         return _checkpathvelocityaccelerationconstraintsfn(q0, q1, dq0, dq1, ddq0, ddq1, elapsedtime, interval, options, filterreturn);
     }
 
@@ -481,6 +548,26 @@ private:
     /// For example, when _samplefn is set and a SpaceSampler is used as the underlying number generator, then it should be added to this list.
     std::list<SpaceSamplerBasePtr> _listInternalSamplers;
 
+    /// \brief Optional cache of the env and self collision results of configurations (see planningutils::ConfigurationCollisionCache).
+    ///
+    /// If set, planningutils::DynamicsCollisionConstraint looks up every checked configuration before checking its collisions. Like the functions, the pointer is shared by copies of the parameters.
+    boost::shared_ptr<planningutils::ConfigurationCollisionCache> _collisioncache;
+
+    /// \brief Optional profile the planners fill with the time spent in their stages (see PlannerProfile), returned in PlannerStatus::profile.
+    ///
+    /// Set to request profiling. Like the functions, the pointer is shared by copies of the parameters. Serialized as the _profile tag, which creates a new profile when set to 1.
+    PlannerProfilePtr _profile;
+
+    /// \brief If > 1, the collisions of the discretized states of a segment are checked by this many workers, each with its own clone of the environment.
+    ///
+    /// The planningutils::DynamicsCollisionConstraint created by SetConfigurationSpecification follows it, also when it is changed afterwards. Serialized as the _nparallelcollisioncheckingworkers tag.
+    int _nParallelCollisionCheckingWorkers;
+
+    /// \brief If true, the collisions of the discretized states of a segment are checked in batches with CollisionCheckerBase::CheckCollisionBatch.
+    ///
+    /// Like _nParallelCollisionCheckingWorkers, followed by the constraint created by SetConfigurationSpecification. Serialized as the _bbatchcollisionchecking tag.
+    bool _bBatchCollisionChecking;
+
 protected:
     // router to a default implementation of _checkpathconstraintsfn that calls on _checkpathvelocityconstraintsfn
     bool _CheckPathConstraintsOld(const std::vector<dReal>&q0, const std::vector<dReal>&q1, IntervalType interval, ConfigurationListPtr pvCheckedConfigurations) {
@@ -603,6 +690,7 @@ public:
     std::map< std::pair<std::string,std::string>, unsigned int > mCollidingLinksCount; // Counter for colliding body/link/geoms
     uint32_t numPlannerIterations=0; ///< number of planner iterations before failure
     uint64_t elapsedPlanningTimeUS=0; ///< us, elapsed time of the planner
+    PlannerProfilePtr profile; ///< Optional, the profile of the planner parameters if profiling was requested with PlannerParameters::_profile
 };
 
 #define OPENRAVE_PLANNER_STATUS(...) PlannerStatus(__VA_ARGS__).SetErrorOrigin(str(boost::format("[%s:%d %s] ")%OpenRAVE::RaveGetSourceFilename(__FILE__)%__LINE__%__FUNCTION__)).SetPlannerParameters(_parameters);
@@ -634,6 +722,36 @@ public:
         int _iteration;
     };
 
+    /// \brief Handle of a PlanPath running on its own thread, returned by \ref PlanPathAsync. Its methods are thread safe.
+    ///
+    /// Destroying the handle cancels the planning and waits for PlanPath to return. PlanPath runs with the environment locked, so waiting
+    /// for it with \ref Wait or \ref GetStatus while holding the environment lock deadlocks, unless it already returned.
+    class OPENRAVE_API PlanPathHandle
+    {
+public:
+        virtual ~PlanPathHandle() {
+        }
+
+        /// \brief cancels the cancellation token of the planner, PlanPath then returns with PS_Interrupted the next time the planner polls it
+        virtual void Cancel() = 0;
+
+        /// \brief true if PlanPath has returned
+        virtual bool IsDone() const = 0;
+
+        /// \brief waits until PlanPath returns. Should not be called while holding the environment lock.
+        ///
+        /// \param timeout in seconds, negative to wait forever
+        /// \return true if PlanPath has returned
+        virtual bool Wait(double timeout=-1) = 0;
+
+        /// \brief waits until PlanPath returns and returns its status. If PlanPath threw, rethrows the exception.
+        virtual PlannerStatus GetStatus() = 0;
+
+        /// \brief the progress passed to the last plan callback
+        virtual PlannerProgress GetProgress() const = 0;
+    };
+    typedef boost::shared_ptr<PlanPathHandle> PlanPathHandlePtr;
+
     PlannerBase(EnvironmentBasePtr penv);
     virtual ~PlannerBase() {
 
@@ -669,6 +787,17 @@ public:
      */
     virtual PlannerStatus PlanPath(TrajectoryBasePtr traj, int planningoptions=0) = 0;
 
+    /** \brief Starts \ref PlanPath on a new thread and returns immediately.
+
+        The thread locks the environment while planning, so concurrent plans should each use a planner of a different cloned environment.
+        The planner and traj must not be used until the handle is done. Cancellation goes through a cancellation token set on the planner and progress
+        through a plan callback, both for the duration of the planning, so a planner that never calls its callbacks cannot be cancelled.
+        \param traj The output trajectory, see \ref PlanPath
+        \param planningoptions A set of PO_X options controlling planning and stauts
+        \return the handle to poll, wait for or cancel the planning
+     */
+    virtual PlanPathHandlePtr PlanPathAsync(TrajectoryBasePtr traj, int planningoptions=0);
+
     /// \brief return the internal parameters of the planner
     virtual PlannerParametersConstPtr GetParameters() const = 0;
 
@@ -684,6 +813,23 @@ public:
      */
     virtual UserDataPtr RegisterPlanCallback(const PlanCallbackFn& callbackfn);
 
+    /** \brief sets the minimum time between two calls of the plan callbacks.
+
+        The planners report progress from their inner loops, the reports coming sooner than the period after the last call are dropped.
+        \param period in seconds, 0 (the default) to call the callbacks on every report
+     */
+    virtual void SetPlanCallbackPeriod(dReal period);
+
+    /** \brief sets the token polled by the planner to interrupt planning, PlanPath then returns with PS_Interrupted.
+
+        Interrupting through the token costs the planning loops one atomic load, so prefer it to a plan callback returning PA_Interrupt.
+        Has to be called before PlanPath, the token itself can be cancelled from any thread.
+        \param ptoken the token, null if the planner is not cancelled through a token
+     */
+    virtual void SetCancellationToken(TaskCancellationTokenPtr ptoken);
+
+    virtual TaskCancellationTokenPtr GetCancellationToken() const;
+
     /// \brief sets the ik failure accumulator to use when running functions
     virtual void SetIkFailureAccumulator(IkFailureAccumulatorBasePtr& pIkFailureAccumulator);
         
@@ -711,15 +857,31 @@ protected:
 
     /// \brief Calls the registered callbacks in order and returns immediately when an action other than PA_None is returned.
     ///
+    /// Returns PA_Interrupt if the cancellation token is cancelled. The callbacks are not called if none are registered or if the last call was
+    /// sooner than the period set with \ref SetPlanCallbackPeriod.
     /// \param progress planner progress information
     virtual PlannerAction _CallCallbacks(const PlannerProgress& progress);
 
+    /// \brief true if the cancellation token of the planner is cancelled, cheap enough to poll in the inner loops
+    inline bool _IsCancelled() const {
+        return !!__pCancellationToken && __pCancellationToken->IsCancelled();
+    }
+
+    /// \brief true if plan callbacks are registered, the planners can skip filling the progress otherwise
+    inline bool _HasCallbacks() const {
+        return __nNumRegisteredCallbacks.load(std::memory_order_relaxed) > 0;
+    }
+
 private:
     virtual const char* GetHash() const {
         return OPENRAVE_PLANNER_HASH;
     }
 
     std::list<UserDataWeakPtr> __listRegisteredCallbacks; ///< internally managed callbacks
+    std::atomic<int> __nNumRegisteredCallbacks; ///< size of __listRegisteredCallbacks, checked before walking the list
+    uint64_t __nCallbackPeriodUs; ///< minimum time between two calls of the callbacks in us, 0 to call them on every report
+    uint64_t __nLastCallbackTimeUs; ///< time the callbacks were last called in us
+    TaskCancellationTokenPtr __pCancellationToken;
     PlannerBasePtr __cachePostProcessPlanner; ///< cached version of the post process planner
 
     friend class CustomPlannerCallbackData;
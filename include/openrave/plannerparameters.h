@@ -733,12 +733,25 @@ typedef boost::shared_ptr<WorkspaceTrajectoryParameters const> WorkspaceTrajecto
 class OPENRAVE_API RRTParameters : public PlannerBase::PlannerParameters
 {
 public:
-    RRTParameters() : _minimumgoalpaths(1), _bProcessing(false) {
+    RRTParameters() : _minimumgoalpaths(1), _nearestneighbor("covertree"), _fNearestNeighborEpsilon(0), _bLazyCollisionChecking(false), _bProcessing(false) {
         _vXMLParameters.push_back("minimumgoalpaths");
+        _vXMLParameters.push_back("nearestneighbor");
+        _vXMLParameters.push_back("nearestneighborepsilon");
+        _vXMLParameters.push_back("lazycollisionchecking");
     }
 
     size_t _minimumgoalpaths; ///< minimum number of goals to connect to before exiting. the goal with the shortest path is returned.
 
+    /// \brief the nearest neighbor search of the trees. One of:
+    ///
+    /// - \b covertree - search the cover tree the nodes are stored in with _distmetricfn (default)
+    /// - \b kdtree - search a kd-tree. Only used if _distmetricfn is a weighted euclidean metric without circular joints, otherwise falls back to covertree
+    std::string _nearestneighbor;
+    dReal _fNearestNeighborEpsilon; ///< for kdtree, the returned neighbor can be (1+_fNearestNeighborEpsilon) further than the nearest neighbor. 0 for exact search
+
+    /// \brief if true, the trees only check the constraints of the new configurations when growing. The edges of a path are checked once the trees connect, and invalid edges are removed from the trees before continuing.
+    bool _bLazyCollisionChecking;
+
 protected:
     bool _bProcessing;
     virtual bool serialize(std::ostream& O, int options=0) const
@@ -747,6 +760,9 @@ protected:
             return false;
         }
         O << "<minimumgoalpaths>" << _minimumgoalpaths << "</minimumgoalpaths>" << std::endl;
+        O << "<nearestneighbor>" << _nearestneighbor << "</nearestneighbor>" << std::endl;
+        O << "<nearestneighborepsilon>" << _fNearestNeighborEpsilon << "</nearestneighborepsilon>" << std::endl;
+        O << "<lazycollisionchecking>" << _bLazyCollisionChecking << "</lazycollisionchecking>" << std::endl;
         if( !(options & 1) ) {
             O << _sExtraParameters << std::endl;
         }
@@ -764,7 +780,7 @@ protected:
         case PE_Ignore: return PE_Ignore;
         }
 
-        _bProcessing = name=="minimumgoalpaths";
+        _bProcessing = name=="minimumgoalpaths" || name=="nearestneighbor" || name=="nearestneighborepsilon" || name=="lazycollisionchecking";
         return _bProcessing ? PE_Support : PE_Pass;
     }
 
@@ -774,6 +790,15 @@ protected:
             if( name == "minimumgoalpaths") {
                 _ss >> _minimumgoalpaths;
             }
+            else if( name == "nearestneighbor" ) {
+                _ss >> _nearestneighbor;
+            }
+            else if( name == "nearestneighborepsilon" ) {
+                _ss >> _fNearestNeighborEpsilon;
+            }
+            else if( name == "lazycollisionchecking" ) {
+                _ss >> _bLazyCollisionChecking;
+            }
             else {
                 RAVELOG_WARN(str(boost::format("unknown tag %s\n")%name));
             }
@@ -25,6 +25,10 @@
 
 #include <openrave/openrave.h>
 
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+
 namespace OpenRAVE {
 
 namespace planningutils {
@@ -220,6 +224,61 @@ protected:
 
 typedef boost::shared_ptr<ActiveDOFTrajectoryRetimer> ActiveDOFTrajectoryRetimerPtr;
 
+/** \brief Keeps the initialized retiming and smoothing planners of \ref RetimeActiveDOFTrajectory and \ref SmoothActiveDOFTrajectory so they can be reused by later calls. <b>[multi-thread safe]</b>
+
+    A planner is reused when the robot, its active dofs, the planner name, the planner parameters and the limit multipliers are the same as the
+    call that initialized it, and the robot's active dof limits did not change since then. Only the trajectory changes between calls, so
+    the planner does not have to be created and InitPlan is not called again.
+    The cached planners keep their environment alive, so the cache has to be destroyed or cleared before its environments.
+ */
+class OPENRAVE_API ActiveDOFTrajectoryPlannerCache
+{
+public:
+    /// \param maxplanners maximum number of initialized planners kept, the least recently used ones are released first
+    ActiveDOFTrajectoryPlannerCache(size_t maxplanners=16);
+    virtual ~ActiveDOFTrajectoryPlannerCache() {
+    }
+
+    /// \brief same as planningutils::RetimeActiveDOFTrajectory
+    virtual PlannerStatus RetimeActiveDOFTrajectory(TrajectoryBasePtr traj, RobotBasePtr robot, bool hastimestamps=false, dReal fmaxvelmult=1, dReal fmaxaccelmult=1, const std::string& plannername="", const std::string& plannerparameters="");
+
+    /// \brief same as planningutils::SmoothActiveDOFTrajectory
+    virtual PlannerStatus SmoothActiveDOFTrajectory(TrajectoryBasePtr traj, RobotBasePtr robot, dReal fmaxvelmult=1, dReal fmaxaccelmult=1, const std::string& plannername="", const std::string& plannerparameters="");
+
+    /// \brief releases all the planners
+    virtual void Clear();
+
+    virtual size_t GetNumPlanners() const;
+
+protected:
+    struct PlannerEntry
+    {
+        RobotBasePtr robot;
+        std::vector<int> vActiveDOFIndices;
+        int nAffineDOF;
+        Vector vAffineRotationAxis;
+        std::string plannername, plannerparameters;
+        dReal fmaxvelmult, fmaxaccelmult;
+        bool hastimestamps, bsmooth;
+
+        std::vector<dReal> vlimits; ///< active dof position, velocity, acceleration and jerk limits of the robot when the planner was initialized
+        PlannerBasePtr planner;
+        PlannerBase::PlannerParametersPtr parameters;
+    };
+
+    PlannerStatus _PlanPath(TrajectoryBasePtr traj, RobotBasePtr robot, bool hastimestamps, dReal fmaxvelmult, dReal fmaxaccelmult, const std::string& plannername, bool bsmooth, const std::string& plannerparameters);
+
+    /// \brief fills _vlimitscache with the limits of the active dofs of robot, has to be called with _mutex locked
+    void _GetActiveDOFLimits(RobotBasePtr robot);
+
+    size_t _nMaxPlanners;
+    mutable std::mutex _mutex;
+    std::list<PlannerEntry> _listPlanners; ///< most recently used first
+    std::vector<dReal> _vlimitscache, _vtempcache;
+};
+
+typedef boost::shared_ptr<ActiveDOFTrajectoryPlannerCache> ActiveDOFTrajectoryPlannerCachePtr;
+
 /** \brief Retime the trajectory points consisting of affine transformation values while avoiding collisions. <b>[multi-thread safe]</b>
 
     Collision is not checked. Every waypoint in the trajectory is guaranteed to be hit.
@@ -323,9 +382,10 @@ OPENRAVE_API size_t InsertWaypointWithRetiming(int index, const std::vector<dRea
     \param dofvelocities the velocities that the inserted point should start with
     \param traj the trajectory that initially contains the input points, it is modified to contain the new re-timed data.
     \param plannername the name of the planner to use to smooth. If empty, will use the default trajectory smoother.
+    \param maxwindowwaypoints if > 0, only the last maxwindowwaypoints waypoints of the trajectory can be re-smoothed, see the overload taking a planner.
     \return the index of the first point in the original trajectory that comes after the modified trajectory.
  */
-OPENRAVE_API size_t InsertWaypointWithSmoothing(int index, const std::vector<dReal>& dofvalues, const std::vector<dReal>& dofvelocities, TrajectoryBasePtr traj, dReal fmaxvelmult=1, dReal fmaxaccelmult=1, const std::string& plannername="");
+OPENRAVE_API size_t InsertWaypointWithSmoothing(int index, const std::vector<dReal>& dofvalues, const std::vector<dReal>& dofvelocities, TrajectoryBasePtr traj, dReal fmaxvelmult=1, dReal fmaxaccelmult=1, const std::string& plannername="", int maxwindowwaypoints=0);
 
 /** \brief insert a waypoint in a timed trajectory and smooth so that the trajectory always goes through the waypoint at the specified velocity. This might change the previous trajectory. <b>[multi-thread safe]</b>
 
@@ -335,9 +395,10 @@ OPENRAVE_API size_t InsertWaypointWithSmoothing(int index, const std::vector<dRe
     \param dofvelocities the velocities that the inserted point should start with
     \param traj the trajectory that initially contains the input points, it is modified to contain the new re-timed data.
     \param planner the initialized planner to use for smoothing. \ref PlannerBase::InitPlan should already be called on it. The planner parameters should be initialized to ignore timestamps. Optionally they could be initialized to accept velocities.
+    \param maxwindowwaypoints if > 0, the new waypoint is only connected to one of the last maxwindowwaypoints waypoints of the trajectory, so at most that window is re-smoothed. The waypoint starting the window keeps its position and velocity, so the trajectory stays continuous at the window boundary. Online replanning that only modifies the tail should set it to bound the number of smoothing calls. If 0, every waypoint is considered.
     \return the index of the first point in the original trajectory that comes after the modified trajectory.
  */
-OPENRAVE_API size_t InsertWaypointWithSmoothing(int index, const std::vector<dReal>& dofvalues, const std::vector<dReal>& dofvelocities, TrajectoryBasePtr traj, PlannerBasePtr planner);
+OPENRAVE_API size_t InsertWaypointWithSmoothing(int index, const std::vector<dReal>& dofvalues, const std::vector<dReal>& dofvelocities, TrajectoryBasePtr traj, PlannerBasePtr planner, int maxwindowwaypoints=0);
 
 /// \brief convert the trajectory and all its points to a new specification
 OPENRAVE_API void ConvertTrajectorySpecification(TrajectoryBasePtr traj, const ConfigurationSpecification &spec);
@@ -383,6 +444,39 @@ OPENRAVE_API TrajectoryBasePtr GetTrajectorySegment(TrajectoryBaseConstPtr traj,
 /// \throw openrave_exception throws an exception if the trajectory data is incompatible and cannot be merged.
 OPENRAVE_API TrajectoryBasePtr MergeTrajectories(const std::list<TrajectoryBaseConstPtr>&listtrajectories);
 
+/// \brief one robot of \ref PlanPrioritizedMultiRobotTrajectory
+struct OPENRAVE_API PrioritizedRobotPlanningTask
+{
+    PrioritizedRobotPlanningTask() : fmaxvelmult(1), fmaxaccelmult(1), fStartDelay(0) {
+    }
+
+    RobotBasePtr probot; ///< the robot that moves, its collisions with the other robots of the tasks are checked through time
+    PlannerBase::PlannerParametersConstPtr parameters; ///< configuration space of the robot only with the initial and goal configurations set
+    std::string plannername; ///< if empty, uses birrt
+    std::string retimername; ///< retimes the path if the planner did not, if empty uses the retimer of the interpolation of the path
+    dReal fmaxvelmult, fmaxaccelmult; ///< passed to the retimer
+
+    TrajectoryBasePtr ptraj; ///< [out] the timed trajectory of the robot including its start delay
+    dReal fStartDelay; ///< [out] the time the robot waits at its initial configuration so that it does not hit the robots of higher priority
+};
+
+/** \brief Plans several robots in priority order so that they can all move at the same time and merges their trajectories.
+
+    The robots are planned in the order of vtasks. Every robot is planned ignoring the robots before it and avoiding the robots after it at their
+    initial configurations. Its timed trajectory is then checked through time against the trajectories of the robots before it (moving obstacles)
+    whose swept volume AABB overlaps its own, and is delayed until it does not collide. If no delay works, the robot is replanned avoiding
+    those robots at their final configurations and starts once they are done. Robots with disjoint swept volumes are never checked against each other.
+
+    Since the first pass does not depend on the other trajectories, all the robots are planned concurrently on cloned environments of the shared
+    task scheduler when bParallel is set. The environment has to be locked by the caller.
+    \param ptraj [out] the merged trajectory of all the robots
+    \param vtasks the robots in decreasing priority, their outputs are filled
+    \param fTimeStep time step of the collision checks and of the swept volumes
+    \param fMaxStartDelay the longest time a robot can wait for the robots before it before it is replanned
+    \param bParallel if true, plans the robots concurrently
+ */
+OPENRAVE_API PlannerStatus PlanPrioritizedMultiRobotTrajectory(TrajectoryBasePtr ptraj, std::vector<PrioritizedRobotPlanningTask>& vtasks, dReal fTimeStep=0.01, dReal fMaxStartDelay=10, bool bParallel=true);
+
 /** \brief represents the DH parameters for one joint
 
    T = Z_1 X_1 Z_2 X_2 ... X_n Z_n
@@ -416,6 +510,104 @@ public:
  */
 OPENRAVE_API void GetDHParameters(std::vector<DHParameter>&vparameters, KinBodyConstPtr pbody);
 
+/** \brief memoizes the env and self collision results of configurations of the planning bodies.
+
+    The configurations are quantized with the resolution of each DOF, so configurations that fall into the same cell share their result.
+    The results are kept in a bounded least-recently-used list. All the results are dropped when any body other than the checked bodies
+    (and the bodies grabbed by them) is added, removed, moved, enabled or disabled, or when the set of grabbed bodies changes. Changes to
+    the geometry or limits of the checked bodies themselves are not detected, call Reset in that case.
+
+    Set on PlannerParameters::_collisioncache so that DynamicsCollisionConstraint uses it. All functions are thread-safe.
+ **/
+class OPENRAVE_API ConfigurationCollisionCache
+{
+public:
+    struct Statistics
+    {
+        Statistics() : numhits(0), nummisses(0), numinsertions(0), numevictions(0), numinvalidations(0) {
+        }
+
+        /// \brief fraction of the lookups that returned a result
+        dReal GetHitRate() const {
+            return numhits+nummisses > 0 ? dReal(numhits)/dReal(numhits+nummisses) : dReal(0);
+        }
+
+        uint64_t numhits; ///< number of lookups that returned a result
+        uint64_t nummisses; ///< number of lookups that did not find a result
+        uint64_t numinsertions; ///< number of inserted results
+        uint64_t numevictions; ///< number of results removed because the cache was full
+        uint64_t numinvalidations; ///< number of times all the results were dropped because the environment changed
+    };
+
+    /*
+       \param listCheckBodies the bodies whose collisions are cached, should be the same as the bodies checked by the constraint
+       \param vConfigResolution the quantization step of each DOF, usually PlannerParameters::_vConfigResolution
+       \param nMaxEntries maximum number of results to keep
+     */
+    ConfigurationCollisionCache(const std::list<KinBodyPtr>& listCheckBodies, const std::vector<dReal>& vConfigResolution, size_t nMaxEntries=100000);
+    virtual ~ConfigurationCollisionCache() {
+    }
+
+    /// \brief drops all the results if the environment changed since the last call. Environment should be locked.
+    ///
+    /// Only goes through the bodies of the environment when EnvironmentBase::GetBodiesUpdateStamp changed more than the checked bodies and their grabbed bodies account for.
+    /// \return true if the results were dropped
+    virtual bool Synchronize();
+
+    /// \brief looks up the result of a configuration
+    ///
+    /// \param vconfig the configuration, has to have the same dimension as the resolution
+    /// \param collisionoptions the mask of CFO_CheckEnvCollisions and CFO_CheckSelfCollisions the configuration is checked with
+    /// \param result filled with 0 if free, otherwise with CFO_CheckEnvCollisions or CFO_CheckSelfCollisions
+    /// \return true if a result was found
+    virtual bool Find(const std::vector<dReal>& vconfig, int collisionoptions, int& result);
+
+    /// \brief stores the result of a configuration, see Find
+    virtual void Insert(const std::vector<dReal>& vconfig, int collisionoptions, int result);
+
+    /// \brief drops all the results
+    virtual void Reset();
+
+    virtual size_t GetNumEntries() const;
+
+    virtual Statistics GetStatistics() const;
+
+    virtual void ResetStatistics();
+
+    inline EnvironmentBasePtr GetEnv() const {
+        return _penv;
+    }
+
+protected:
+    typedef std::vector<int32_t> Key;
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const;
+    };
+    typedef std::list< std::pair<Key, int> > EntryList;
+
+    /// \brief quantizes vconfig into _vkeycache, has to be called with _mutex locked
+    void _ComputeKey(const std::vector<dReal>& vconfig, int collisionoptions);
+
+    EnvironmentBasePtr _penv;
+    std::list<KinBodyPtr> _listCheckBodies;
+    std::vector<dReal> _vInvResolution; ///< 1/resolution of each DOF
+    size_t _nMaxEntries;
+
+    mutable std::mutex _mutex;
+    EntryList _listEntries; ///< most recently used first
+    std::unordered_map<Key, EntryList::iterator, KeyHash> _mapEntries;
+    Key _vkeycache;
+    std::vector< std::pair<int, int> > _vEnvironmentStamps, _vEnvironmentStampsCache; ///< (body index, update stamp) of all the bodies the results depend on. For grabbed bodies the stamp is -1, for disabled bodies -2.
+    std::vector<KinBodyPtr> _vbodiescache;
+    std::vector<KinBodyPtr> _vMovingBodies, _vMovingBodiesCache; ///< the checked bodies followed by their grabbed bodies at the last Synchronize
+    std::vector<int> _vMovingBodyStamps; ///< update stamps of _vMovingBodies at the last Synchronize
+    uint64_t _nBodiesUpdateStamp; ///< EnvironmentBase::GetBodiesUpdateStamp at the last Synchronize
+    Statistics _stats;
+};
+
+typedef boost::shared_ptr<ConfigurationCollisionCache> ConfigurationCollisionCachePtr;
+
 /** \brief dynamics and collision checking with linear interpolation
 
     For any joints with maxtorque > 0, uses KinBody::ComputeInverseDynamics to check if the necessary torque exceeds the max torque. Max torque is always called via GetMaxTorque
@@ -465,7 +657,60 @@ public:
         return _report;
     }
 
+    /// \brief enables checking the env and self collisions of the discretized states of a segment concurrently.
+    ///
+    /// The states are first generated and checked for the non-collision constraints serially in the original environment. Their collisions are then checked by numworkers threads, each with its own clone of the environment (Clone_Bodies). Once a worker finds a collision, the states after it are not checked anymore and the segment is re-checked serially starting from the first colliding state, so the ConstraintFilterReturn is filled exactly like in the serial mode.
+    /// The environment of the checked bodies should be locked when calling Check.
+    /// Also set from PlannerParameters::_nParallelCollisionCheckingWorkers of the parameters of the constraint whenever it changes.
+    /// \param numworkers number of worker threads and cloned environments. If <= 1, disables the parallel mode and releases the cloned environments.
+    virtual void SetParallelCollisionChecking(int numworkers);
+
+    /// \brief re-clones the original environment into the worker environments of the parallel collision checking mode.
+    ///
+    /// Called by Check whenever the update stamps show that bodies other than the checked bodies and their grabbed bodies were added, removed, or changed,
+    /// or that the grabbed bodies, link enable states, or geometries of the checked bodies changed. Only needs to be called directly to force a re-clone.
+    virtual void SynchronizeParallelEnvironments();
+
+    /// \brief enables checking the env and self collisions of the discretized states of a segment in batches in the original environment.
+    ///
+    /// Also set from PlannerParameters::_bBatchCollisionChecking of the parameters of the constraint whenever it changes.
+    /// Like the parallel mode, the states are first generated and checked for the non-collision constraints, then their env collisions are checked with CollisionCheckerBase::CheckCollisionBatch in chunks, which lets the checker synchronize the scene once per chunk instead of once per state. Only used when there is one checked body and its transform is the same for all states, otherwise the recorded states are checked one by one. Ignored when the parallel mode is enabled.
+    virtual void SetBatchCollisionChecking(bool bBatchCollisionChecking);
+
 protected:
+    /// \brief how _CheckState treats env and self collisions while checking a segment in the parallel mode
+    enum DeferredCollisionMode
+    {
+        DCM_None = 0, ///< check collisions normally
+        DCM_Collect = 1, ///< do not check collisions, record the states of the checked bodies for the workers
+        DCM_SkipUntil = 2, ///< do not check collisions of the first _nDeferredSkipStates states since they were already checked by the workers
+    };
+
+    /// \brief follows the collision checking modes of the parameters when they change, so that the modes set directly on the constraint are kept otherwise
+    virtual void _UpdateCollisionCheckingModes(const PlannerBase::PlannerParameters& parameters);
+
+    /// \brief runs checkfn in the parallel or batch mode, checkfn should call one of the Check functions with the original arguments
+    virtual int _CheckParallel(const std::function<int()>& checkfn);
+
+    /// \brief checks collisions of the recorded states with the worker environments.
+    ///
+    /// \return the index of the first state in collision, or the number of recorded states if none are in collision
+    virtual size_t _CheckDeferredStates();
+
+    /// \brief takes recorded states from nNextState and checks them with worker iworker, lowers nFirstCollision to any state found in collision
+    virtual void _DeferredStatesWorker(size_t iworker, std::atomic<size_t>& nNextState, std::atomic<size_t>& nFirstCollision);
+
+    /// \brief checks collisions of the recorded states in the original environment with CollisionCheckerBase::CheckCollisionBatch.
+    ///
+    /// \return the index of the first state in collision, or the number of recorded states if none are in collision
+    virtual size_t _CheckDeferredStatesBatch();
+
+    /// \brief creates the worker environments if they do not exist yet, otherwise re-clones them if _HaveParallelEnvironmentsChanged
+    virtual void _InitParallelEnvironments();
+
+    /// \brief records the update stamps of the environment and the moving bodies, returns true if the scene changed since they were last recorded
+    virtual bool _HaveParallelEnvironmentsChanged();
+
     /// \brief checks an already set state
     ///
     /// \param vdofvelocities the current velocities set on the robot
@@ -477,9 +722,20 @@ protected:
     ///
     /// \param options should already be masked with _filtermask
     virtual int _SetAndCheckState(PlannerBase::PlannerParametersConstPtr params, const std::vector<dReal>& vdofvalues, const std::vector<dReal>& vdofvelocities, const std::vector<dReal>& vdofaccels, int options, ConstraintFilterReturnPtr filterreturn);
+
+    /// \brief calls _CheckState on the already set vdofvalues, looking up and storing the collision results in PlannerParameters::_collisioncache if it is set
+    ///
+    /// \param options should already be masked with _filtermask
+    virtual int _CheckStateCached(PlannerBase::PlannerParametersConstPtr params, const std::vector<dReal>& vdofvalues, const std::vector<dReal>& vdofvelocities, const std::vector<dReal>& vdofaccels, int options, ConstraintFilterReturnPtr filterreturn);
     virtual void _PrintOnFailure(const std::string& prefix);
 
+    /// \brief true if _PrintOnFailure logs the failure or keeps it in the log history
+    inline bool _IsPrintingOnFailure() const {
+        return IS_DEBUGLEVEL(Level_Verbose) || RaveIsLogHistoryEnabled();
+    }
+
     PlannerBase::PlannerParametersWeakConstPtr _parameters;
+    PlannerProfilePtr _profile; ///< PlannerParameters::_profile of the parameters during the current Check call, counts the collision calls
     std::vector<dReal> _vtempconfig, _vtempvelconfig, dQ, _vtempveldelta, _vtempacceldelta, _vtempaccelconfig, _vtempjerkconfig, _vperturbedvalues, _vcoeff2, _vcoeff1, _vprevtempconfig, _vprevtempvelconfig, _vprevtempaccelconfig, _vtempconfig2, _vdiffconfig, _vdiffvelconfig, _vdiffaccelconfig, _vstepconfig; ///< in configuration space
     std::vector<dReal> _vrawroots, _vrawcoeffs;
     std::vector<std::vector<dReal> > _valldofscoeffs, _valldofscriticalpoints, _valldofscriticalvalues;
@@ -495,8 +751,29 @@ protected:
     std::vector< std::pair<int, std::pair<dReal, dReal> > > _vtorquevalues; ///< cache for dof indices and the torque limits that the current torque should be in
     std::vector< int > _vdofindices;
     std::vector<dReal> _doftorques, _dofaccelerations; ///< in body DOF space
+    KinBody::InverseDynamicsWorkspace _inversedynamicsworkspace; ///< reused by ComputeInverseDynamics for every checked state
     boost::shared_ptr<ConfigurationSpecification::SetConfigurationStateFn> _setvelstatefn;
     std::vector<dReal> _vfulldofdynamicaccelerationlimits, _vfulldofdynamicjerklimits, _vfulldofvalues, _vfulldofvelocities; ///< in body full DOF space. the size is GetDOF().
+
+    // for parallel collision checking
+    int _nParallelWorkers; ///< if > 1, collisions of the states are checked by this many workers
+    int _nParametersParallelWorkers; ///< PlannerParameters::_nParallelCollisionCheckingWorkers the last time the modes were updated from the parameters
+    bool _bParametersBatchCollisionChecking; ///< PlannerParameters::_bBatchCollisionChecking the last time the modes were updated from the parameters
+    std::vector<EnvironmentBasePtr> _vParallelEnvs; ///< one cloned environment per worker
+    std::vector< std::vector<KinBodyPtr> > _vParallelBodies; ///< for every worker, the clones of _listCheckBodies in the same order
+    std::vector< std::vector<dReal> > _vParallelDOFValues; ///< scratch dof values for every worker
+    std::vector<KinBodyPtr> _vParallelMovingBodies, _vParallelMovingBodiesCache, _vParallelGrabbedCache; ///< the checked bodies followed by their grabbed bodies when the worker environments were last checked
+    std::vector<uint64_t> _vParallelMovingShapes, _vParallelMovingShapesCache; ///< link enable masks and geometry shape stamps of _vParallelMovingBodies
+    std::vector<int> _vParallelMovingBodyStamps; ///< update stamps of _vParallelMovingBodies
+    uint64_t _nParallelBodiesUpdateStamp; ///< EnvironmentBase::GetBodiesUpdateStamp when the worker environments were last checked
+    bool _bBatchCollisionChecking; ///< if true and _nParallelWorkers <= 1, collisions of the states are checked with _CheckDeferredStatesBatch
+    std::vector<uint8_t> _vDeferredCollisions; ///< scratch results of CheckCollisionBatch
+    DeferredCollisionMode _deferredCollisionMode;
+    size_t _nDeferredStateIndex; ///< number of states seen by _CheckState in the current DCM_SkipUntil pass
+    size_t _nDeferredSkipStates; ///< number of states to skip in DCM_SkipUntil
+    size_t _nDeferredStateStride; ///< number of values per recorded state, for every checked body 7 transform values followed by its dof values
+    std::vector<dReal> _vDeferredStates; ///< recorded states of the checked bodies, _nDeferredStateStride values per state
+    std::vector<int> _vDeferredOptions; ///< for every recorded state, the options it was checked with
 };
 
 typedef boost::shared_ptr<DynamicsCollisionConstraint> DynamicsCollisionConstraintPtr;
@@ -562,6 +839,53 @@ protected:
     ConstraintFilterReturnPtr _filterreturn;
 } RAVE_DEPRECATED;
 
+/** \brief squared weighted euclidean distance sum_i w2_i*(a_i-b_i)^2 of raw arrays, does not allocate
+
+    \tparam DOF the number of values when known at compile time so that the loop is unrolled, 0 to use dof
+    \param pweights2 the squared weights
+ */
+template <int DOF>
+inline dReal ComputeWeightedDistanceSquared(const dReal* pweights2, const dReal* a, const dReal* b, int dof=DOF)
+{
+    const int n = DOF > 0 ? DOF : dof;
+    // independent partial sums so that the compiler can vectorize the loop without reordering the floating point additions
+    dReal f0 = 0, f1 = 0, f2 = 0, f3 = 0;
+    int i = 0;
+    for(; i+4 <= n; i += 4) {
+        const dReal d0 = a[i]-b[i], d1 = a[i+1]-b[i+1], d2 = a[i+2]-b[i+2], d3 = a[i+3]-b[i+3];
+        f0 += pweights2[i]*d0*d0;
+        f1 += pweights2[i+1]*d1*d1;
+        f2 += pweights2[i+2]*d2*d2;
+        f3 += pweights2[i+3]*d3*d3;
+    }
+    for(; i < n; ++i) {
+        const dReal d = a[i]-b[i];
+        f0 += pweights2[i]*d*d;
+    }
+    return (f0+f1)+(f2+f3);
+}
+
+/// \brief weighted euclidean distance of raw arrays, dispatches to the fixed size kernels for the common robot dofs
+///
+/// \param pweights2 the squared weights
+inline dReal ComputeWeightedDistance(const dReal* pweights2, const dReal* a, const dReal* b, int dof)
+{
+    dReal f;
+    switch(dof) {
+    case 1: f = ComputeWeightedDistanceSquared<1>(pweights2, a, b); break;
+    case 2: f = ComputeWeightedDistanceSquared<2>(pweights2, a, b); break;
+    case 3: f = ComputeWeightedDistanceSquared<3>(pweights2, a, b); break;
+    case 4: f = ComputeWeightedDistanceSquared<4>(pweights2, a, b); break;
+    case 5: f = ComputeWeightedDistanceSquared<5>(pweights2, a, b); break;
+    case 6: f = ComputeWeightedDistanceSquared<6>(pweights2, a, b); break;
+    case 7: f = ComputeWeightedDistanceSquared<7>(pweights2, a, b); break;
+    case 8: f = ComputeWeightedDistanceSquared<8>(pweights2, a, b); break;
+    default: f = ComputeWeightedDistanceSquared<0>(pweights2, a, b, dof); break;
+    }
+    // std::sqrt rather than RaveSqrt so that the call is inlined
+    return std::sqrt(f);
+}
+
 /// \brief simple distance metric based on joint weights
 class OPENRAVE_API SimpleDistanceMetric
 {
@@ -116,6 +116,10 @@ public:
     typedef boost::shared_ptr<GripperInfo> GripperInfoPtr;
     typedef boost::shared_ptr<GripperInfo const> GripperInfoConstPtr;
 
+    class ManipulatorReachabilityMap;
+    typedef boost::shared_ptr<ManipulatorReachabilityMap> ManipulatorReachabilityMapPtr;
+    typedef boost::shared_ptr<ManipulatorReachabilityMap const> ManipulatorReachabilityMapConstPtr;
+
     /// \brief Defines a chain of joints for an arm and set of joints for a gripper. Simplifies operating with them.
     class OPENRAVE_API Manipulator : public boost::enable_shared_from_this<Manipulator>
     {
@@ -390,6 +394,17 @@ public:
          */
         bool CheckEndEffectorCollision(const Transform& tEE, KinBodyConstPtr pbody, CollisionReportPtr report = CollisionReportPtr()) const;
 
+        /** \brief Checks collision with only the gripper and the rest of the environment, or a specified body, for many end-effector transforms. Ignores disabled links.
+
+            Equivalent to calling CheckEndEffectorCollision for every transform, except that the gripper links are found once and are moved together with the bodies they grab, and that the transforms are restored once at the end. This way the collision checker synchronizes the robot once per transform instead of twice per gripper link.
+            \param[in] vtEE the end effector transforms
+            \param[out] vresults resized to vtEE.size(), vresults[i] is 1 if the gripper is in collision at vtEE[i], 0 otherwise
+            \param[in] pbody the body to be checked. If null, checks with the environment.
+            \param[out] report [optional] collision report of the first transform in collision
+            \return true if a collision occurred at any of the transforms
+         */
+        bool CheckEndEffectorCollisionBatch(const std::vector<Transform>& vtEE, std::vector<uint8_t>& vresults, KinBodyConstPtr pbody = KinBodyConstPtr(), CollisionReportPtr report = CollisionReportPtr()) const;
+
         /** \brief Checks self-collision with only the gripper with the rest of the robot. Ignores disabled links.
 
             \param[out] report [optional] collision report
@@ -509,6 +524,24 @@ public:
         /// This includes joint axes, joint positions, and final grasp transform. Hash is used to cache the solvers.
         const std::string& GetInverseKinematicsStructureHash(IkParameterizationType iktype) const;
 
+        /// \brief sets the reachability map used by \ref IsReachable, can be null.
+        ///
+        /// \throw openrave_exception if the map was not generated for the kinematics of this manipulator
+        void SetReachabilityMap(ManipulatorReachabilityMapConstPtr pmap);
+
+        inline ManipulatorReachabilityMapConstPtr GetReachabilityMap() const {
+            return __pReachabilityMap;
+        }
+
+        /** \brief Quickly checks from the reachability map if the ik parameterization can have solutions, without calling the ik solver.
+
+            Only the translation of the parameterization and the rotation of IKP_Transform6D are checked.
+            \param inworld if true the parameterization is in the world coordinate system, otherwise in the base link (\ref GetBase()) coordinate system
+            \return false if the pose is certainly not reachable. Returns true if there is no reachability map, if the map is for different
+            kinematics, or if the parameterization type cannot be checked.
+         */
+        bool IsReachable(const IkParameterization& ikparam, bool inworld=true) const;
+
 protected:
         /// \brief compute internal information from user-set info
         void _ComputeInternalInformation();
@@ -524,6 +557,7 @@ private:
         std::vector<int> __vgripperdofindices, __varmdofindices;
         ConfigurationSpecification __armspec; ///< reflects __varmdofindices
         mutable IkSolverBasePtr __pIkSolver;
+        ManipulatorReachabilityMapConstPtr __pReachabilityMap; ///< \see IsReachable
         mutable std::string __hashstructure, __hashkinematicsstructure;
         mutable std::map<IkParameterizationType, std::string> __maphashikstructure;
         std::vector<int> __vChuckingDirection; ///< the normal direction to move joints for the hand to grasp something. This is computed in _ComputeInternalInformation based on ManipulatorInfo and GripperInfo, and the latest recommended way to define chucking direction is to use the one in GripperInfo.
@@ -547,6 +581,100 @@ private:
     typedef boost::shared_ptr<RobotBase::Manipulator const> ManipulatorConstPtr;
     typedef boost::weak_ptr<RobotBase::Manipulator> ManipulatorWeakPtr;
 
+    /** \brief Voxelized map of the tool poses that a manipulator can reach, used to reject unreachable ik goals before calling the ik solver.
+
+        The tool poses are expressed in the coordinate system of the manipulator base link. Every voxel of the translation grid has one bit
+        for each of the sampled tool rotations, set if the rotation had an ik solution at this voxel or at one of its 26 neighbors, so that
+        the map only rejects poses that are far from every reached pose. Every voxel also stores the fraction of reachable rotations and the
+        best manipulability sqrt(det(J*J^T)) of the translation jacobian of its solutions.
+
+        The map is generated for the kinematics of the manipulator (\ref Manipulator::GetKinematicsStructureHash), does not check
+        environment collisions, and is immutable. Saved maps are memory-mapped when loaded, so loading a fine grid is cheap.
+     */
+    class OPENRAVE_API ManipulatorReachabilityMap
+    {
+public:
+        /// \brief data of one voxel, the layout is shared with the files
+        struct Voxel
+        {
+            uint64_t rotationmask; ///< bit i is set if rotation i is reachable at this voxel or one of its neighbors
+            uint8_t score; ///< fraction of the rotations reachable at this voxel, scaled to [0,255]
+            uint8_t manipulability; ///< best manipulability of the solutions at this voxel, scaled to [0,255] by \ref GetMaxManipulability
+            uint8_t padding[6];
+        };
+
+        virtual ~ManipulatorReachabilityMap();
+
+        /** \brief generates the map by calling the ik solver of the manipulator for every voxel and sampled rotation.
+
+            Self collisions are checked, environment collisions are not. The voxels are distributed over numthreads clones of the
+            environment, the environment of the manipulator is only locked while cloning.
+            \param voxelsize edge length of the voxels
+            \param numrotations number of sampled tool rotations, at most 64
+            \param numthreads number of threads, if 0 uses the number of cores
+            \throw openrave_exception if the manipulator does not have an ik solver supporting IKP_Transform6D
+         */
+        static ManipulatorReachabilityMapPtr Generate(ManipulatorConstPtr pmanip, dReal voxelsize=0.04, int numrotations=64, int numthreads=0);
+
+        /// \brief loads a map written by \ref Save by memory-mapping the file
+        ///
+        /// \throw openrave_exception if the file cannot be read or is not a reachability map
+        static ManipulatorReachabilityMapPtr Load(const std::string& filename);
+
+        /// \brief returns the filename of the map of the manipulator inside the openrave database, see \ref RaveFindDatabaseFile
+        static std::string GetDatabaseFilename(const Manipulator& manip);
+
+        /// \brief writes the map into a file
+        ///
+        /// \throw openrave_exception if the file cannot be written
+        void Save(const std::string& filename) const;
+
+        /// \brief the kinematics hash of the manipulator the map was generated for
+        inline const std::string& GetKinematicsStructureHash() const {
+            return _kinematicshash;
+        }
+
+        inline dReal GetVoxelSize() const {
+            return _fVoxelSize;
+        }
+
+        inline dReal GetMaxManipulability() const {
+            return _fMaxManipulability;
+        }
+
+        /// \brief the sampled tool rotations as quaternions in the base link coordinate system
+        inline const std::vector<Vector>& GetRotations() const {
+            return _vRotations;
+        }
+
+        /// \brief returns the voxel containing the translation in the base link coordinate system, or null if the translation is outside of the map
+        const Voxel* GetVoxel(const Vector& translation) const;
+
+        /// \brief returns false if the tool translation in the base link coordinate system is certainly not reachable with any rotation
+        bool IsReachable(const Vector& translation) const;
+
+        /// \brief returns false if the tool pose in the base link coordinate system is certainly not reachable
+        bool IsReachable(const Transform& tool) const;
+
+protected:
+        ManipulatorReachabilityMap();
+
+        /// \brief sets _fRotationRadius from _vRotations
+        void _ComputeRotationRadius();
+
+        std::string _kinematicshash;
+        dReal _fVoxelSize;
+        dReal _fMaxManipulability;
+        dReal _fRotationRadius; ///< smallest |q_i.q_j| between a sampled rotation and its nearest sampled rotation, a reached rotation at least this similar to the queried one accepts it
+        Vector _vOrigin; ///< center of the first voxel
+        int _dims[3]; ///< number of voxels along each axis
+        std::vector<Vector> _vRotations;
+        std::vector<Voxel> _vVoxels; ///< voxels of a generated map
+        const Voxel* _pVoxels; ///< points to _vVoxels or into the mapped file
+        void* _pMappedData; ///< the mapped file, null if not loaded from a file
+        uint64_t _mappedSize;
+    };
+
     /// \brief holds all user-set attached sensor information used to initialize the AttachedSensor class.
     ///
     /// This is serializable and independent of environment.
@@ -770,10 +898,20 @@ public:
 
         /// \brief have the connected body to be added to the robot kinematics. The active level has nothing to do with visibility or enabling of the links.
         ///
-        /// Can only be called when robot is not added to the environment
+        /// Can only be called when robot is not added to the environment, unless CanSetActiveWithoutReinitialize is true. In that case the links are enabled and made visible when activating, and disabled and hidden when deactivating.
         /// \return true if changed
         bool SetActive(int8_t active);
 
+        /// \brief true if the connected body is already instantiated on the robot, so switching between inactive (0) and active (1) only toggles the link enable and visible states. \see RobotBase::SetPreinstantiateConnectedBodies
+        ///
+        /// Changing to or from the unknown state (-1) changes the adjacency of the links, so it always requires the robot to be re-initialized.
+        bool CanSetActiveWithoutReinitialize(int8_t active) const;
+
+        /// \brief true if the links, joints, manipulators, sensors and gripper infos of the connected body are added to the robot
+        inline bool IsInstantiated() const {
+            return !_dummyPassiveJointName.empty();
+        }
+
         /// \brief return true
         int8_t IsActive();
 
@@ -862,6 +1000,12 @@ public:
         bool CanProvideManipulator(const std::string& resolvedManipulatorName) const;
 
 private:
+        /// \brief returns the resolved link from its cached pointer if it is still valid, otherwise searches the robot by name
+        static KinBody::LinkPtr _GetResolvedLink(const RobotBase& robot, const std::pair<std::string, RobotBase::LinkPtr>& resolvedLinkName);
+
+        /// \brief sets the enable and visible states of the instantiated links from the active state, \see CanSetActiveWithoutReinitialize
+        void _UpdateInstantiatedLinkStates(RobotBase& robot);
+
         ConnectedBodyInfo _info; ///< user specified data (to be serialized and saved), should not contain dynamically generated parameters.
 
         std::string _nameprefix; ///< the name prefix to use for all the resolved link names. Initialized regardless of the active state of the connected body.
@@ -997,6 +1141,17 @@ private:
     /// \return true if an active state changed
     virtual bool SetConnectedBodyActiveStates(const std::vector<int8_t>& activestates);
 
+    /// \brief if true, inactive connected bodies are also instantiated when the robot is initialized, with their links disabled and hidden.
+    ///
+    /// Their active state can then be toggled between 0 and 1 while the robot is in the environment, which only changes the link enable and visible states instead of re-initializing the robot. Meant for tool changers that swap tools often. The joints of the inactive connected bodies stay part of the robot DOF, and their manipulators, sensors and gripper infos stay on the robot, so use ConnectedBody::IsActive to tell them apart.
+    /// Can only be changed when the robot is not added to the environment.
+    virtual void SetPreinstantiateConnectedBodies(bool bPreinstantiate);
+
+    /// \brief \see SetPreinstantiateConnectedBodies
+    inline bool IsPreinstantiateConnectedBodies() const {
+        return _bPreinstantiateConnectedBodies;
+    }
+
     void SetName(const std::string& name) override;
 
     void SetDOFValues(const std::vector<dReal>& vJointValues, uint32_t checklimits = CLA_CheckLimits, const std::vector<int>& dofindices = std::vector<int>()) override;
@@ -1065,6 +1220,25 @@ private:
     inline const Vector& GetAffineRotationAxis() const {
         return vActvAffineRotationAxis;
     }
+
+    /// \brief data derived from one set of active DOFs, computed once per robot and reused every time the robot switches back to the same set
+    class OPENRAVE_API ActiveDOFProfile
+    {
+public:
+        std::vector<int> vDOFIndices;
+        int nAffineDOFs = 0;
+        int nId = 0; ///< unique among all the profiles the robot ever created, never reused, > 0
+        ConfigurationSpecification spec; ///< \see GetActiveConfigurationSpecification
+        std::string robotname; ///< name of the robot spec was computed with, the group names contain it
+        std::vector<uint8_t> vActiveLinks; ///< for every link, 1 if it is moved by one of the joints of vDOFIndices
+    };
+    typedef boost::shared_ptr<ActiveDOFProfile const> ActiveDOFProfileConstPtr;
+
+    /// \brief returns the profile of the current active DOFs, or null if all the DOFs are active or the kinematics are not computed yet
+    ///
+    /// Profiles are interned: switching back to a set of active DOFs that was used before returns the same profile with the same id, so listeners of Prop_RobotActiveDOFs can cache their own data per profile id.
+    /// The profiles are dropped when the kinematics of the robot change.
+    ActiveDOFProfileConstPtr GetActiveDOFProfile() const;
     virtual void SetAffineTranslationLimits(const Vector& lower, const Vector& upper);
     virtual void SetAffineRotationAxisLimits(const Vector& lower, const Vector& upper);
     virtual void SetAffineRotation3DLimits(const Vector& lower, const Vector& upper);
@@ -1405,7 +1579,17 @@ protected:
     Vector _vRotationQuatLimitStart;
     dReal _fQuatLimitMaxAngle, _fQuatMaxAngleVelocity, _fQuatAngleResolution, _fQuatAngleWeight;
 
+    /// \brief returns the interned profile of the active DOFs, creating it if necessary. Returns null if the kinematics are not computed.
+    boost::shared_ptr<ActiveDOFProfile> _GetActiveDOFProfile(const std::vector<int>& vDOFIndices, int nAffineDOFs) const;
+
+    /// \brief computes the configuration specification of a set of active DOFs
+    void _ComputeActiveConfigurationSpecification(const std::vector<int>& vDOFIndices, int nAffineDOFs, ConfigurationSpecification& spec) const;
+
     ConfigurationSpecification _activespec;
+    mutable std::vector< boost::shared_ptr<ActiveDOFProfile> > _vActiveDOFProfiles; ///< \see GetActiveDOFProfile, most recently used last
+    mutable boost::shared_ptr<ActiveDOFProfile> _pActiveDOFProfile; ///< profile of the last GetActiveDOFProfile or SetActiveDOFs, can be outdated
+    mutable int _nActiveDOFProfileIdCounter = 0;
+    bool _bPreinstantiateConnectedBodies = false; ///< \see SetPreinstantiateConnectedBodies
 
 private:
     virtual const char* GetHash() const override {
@@ -88,6 +88,7 @@ public:
             return ST_Camera;
         }
         std::vector<uint8_t> vimagedata;         ///< rgb image data, if camera only outputs in grayscale, fill each channel with the same value
+        std::vector<float> vdepthdata;         ///< depth along the optical axis of every pixel in row-major order, 0 where nothing is seen. Only filled by cameras that render depth.
         virtual bool serialize(std::ostream& O) const;
     };
 
@@ -571,6 +572,13 @@ public:
     /// Only valid if this sensor is simulation based. A sensor hooked up to a real device can ignore this call
     virtual bool SimulationStep(dReal fTimeElapsed) OPENRAVE_DUMMY_IMPLEMENTATION;
 
+    /// \brief True if \ref SimulationStep can run concurrently with the steps of other sensors and modules.
+    ///
+    /// A parallel-safe step only touches the sensor's own data: it must not lock the environment, call the environment collision checker, or publish to viewers.
+    virtual bool IsSimulationStepParallelSafe() const {
+        return false;
+    }
+
     /// \brief Returns the sensor geometry. This method is thread safe.
     ///
     /// \param type the requested sensor type to create. A sensor can support many types. If type is ST_Invalid, then returns any structure that represents the geometry.
@@ -593,6 +601,22 @@ public:
     /// psensordata->GetType() in order to return the correctly supported type.
     virtual bool GetSensorData(SensorDataPtr psensordata) = 0;
 
+    /// \brief Returns the most recent published data of the sensor without copying it.
+    ///
+    /// Sensors never modify data once it is published, new measurements are written into other buffers, so the returned data can be
+    /// read without any lock for as long as it is held. Holding it only prevents the sensor from recycling the buffer. This method is thread safe.
+    /// The default implementation copies the data into a new structure with \ref GetSensorData.
+    /// \param type the requested sensor type. If ST_Invalid, then the type most representative of this sensor.
+    /// \return the data or an empty pointer if the sensor has no data for type
+    virtual SensorDataConstPtr GetLatestSensorData(SensorType type=ST_Invalid);
+
+    /// \brief Returns the number of measurements of type published so far.
+    ///
+    /// Can be polled without locking to know whether \ref GetLatestSensorData returns new data. Sensors that do not count their measurements return 0.
+    virtual uint64_t GetSensorDataSequence(SensorType type=ST_Invalid) const {
+        return 0;
+    }
+
     /// \brief returns true if sensor supports a particular sensor type
     virtual bool Supports(SensorType type) = 0;
 
@@ -22,6 +22,7 @@
 #ifndef OPENRAVE_SENSORSYSTEM_H
 #define OPENRAVE_SENSORSYSTEM_H
 
+#include <atomic>
 #include <thread>
 
 namespace OpenRAVE {
@@ -215,13 +216,45 @@ protected:
     virtual bool EnableBody(KinBodyPtr pbody, bool bEnable);
     virtual bool SwitchBody(KinBodyPtr pbody1, KinBodyPtr pbody2);
 
+    /// \brief queues a pose of a registered body returned by a sensor. <b>[multi-thread safe]</b>
+    ///
+    /// Does not lock the environment or the system, so sensor threads can push poses at a high rate. The update thread of the system applies
+    /// all the queued poses in one environment lock every cycle, see \ref ApplyQueuedPoses.
+    /// \param bodyindex the environment body index of the registered body
+    /// \param t the pose returned by the sensor, the offsets of the registration data are applied to it
+    virtual void QueuePose(int bodyindex, const Transform& t);
+
+    /// \brief sets the queued poses in one batch, only the latest pose of every body is set. The environment has to be locked.
+    ///
+    /// Simulations that need the poses at a defined point of their step can call it there instead of waiting for the update thread.
+    /// \return the number of bodies that were set
+    virtual int ApplyQueuedPoses();
+
 protected:
     typedef std::pair<boost::shared_ptr<BodyData>, Transform > SNAPSHOT;
     typedef std::map<int,boost::shared_ptr<BodyData> > BODIES;
+
+    /// \brief pose pushed by \ref QueuePose
+    struct QueuedPose
+    {
+        int bodyindex;
+        Transform t;
+        QueuedPose* pnext; ///< the pose queued before this one
+    };
+
     virtual boost::shared_ptr<BodyData> CreateBodyData(KinBodyPtr pbody, boost::shared_ptr<XMLData const> pdata);
     virtual void _UpdateBodies(std::list<SNAPSHOT>& listbodies);
     virtual void _UpdateBodiesThread();
 
+    /// \brief sets the poses of the bodies, the environment has to be locked
+    virtual void _SetBodyPoses(std::list<SNAPSHOT>& listbodies, uint64_t curtime);
+
+    /// \brief takes all the queued poses and keeps the latest one of every enabled registered body
+    void _CollectQueuedPoses(std::list<SNAPSHOT>& listbodies);
+
+    /// \brief deletes a list of queued poses
+    static void _DeleteQueuedPoses(QueuedPose* ppose);
+
     virtual void SetRecentTransform(boost::shared_ptr<BodyData> pdata, const Transform& t) {
         pdata->tnew = t;
     }
@@ -233,6 +266,7 @@ protected:
     BODIES _mapbodies;
     std::mutex _mutex;
     uint64_t _expirationtime;     ///< expiration time in us
+    std::atomic<QueuedPose*> _pQueuedPoses; ///< lock-free stack of the poses pushed by the sensor threads, the newest one first
     bool _bShutdown;
     std::thread _threadUpdate;
 };
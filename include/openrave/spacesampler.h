@@ -102,6 +102,24 @@ public:
      */
     virtual int SampleSequence(std::vector<dReal>& samples, size_t num=1,IntervalType interval=IT_Closed) OPENRAVE_DUMMY_IMPLEMENTATION;
 
+    /** \brief sequentially sampling the next 'num' samples into a caller owned buffer
+
+        Samplers that can generate a batch without going through a std::vector should override this, the default implementation copies the result of the std::vector version.
+        \param samples array of at least num*GetNumberOfValues() values
+        \param num number of samples to return
+        \param interval the sampling intervel for each of the dimensions.
+        \return the number of samples completed or an error code. Error codes are <= 0.
+     */
+    virtual int SampleSequence(dReal* samples, size_t num, IntervalType interval=IT_Closed)
+    {
+        std::vector<dReal> vsamples;
+        int ret = SampleSequence(vsamples,num,interval);
+        if( ret > 0 ) {
+            std::copy(vsamples.begin(), vsamples.end(), samples);
+        }
+        return ret;
+    }
+
     /// \brief samples the real next value on the sequence, only valid for 1 DOF sequences.
     ///
     /// \throw openrave_exception throw if could not be sampled
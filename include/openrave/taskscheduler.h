@@ -0,0 +1,103 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2016 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+/** \file taskscheduler.h
+    \brief Shared task scheduler of the OpenRAVE runtime. This file is automatically included by openrave.h.
+
+    All the parallel features of openrave and its plugins submit their work to the one scheduler owned by the global state, so they compose without
+    each creating threads for every core.
+ */
+#ifndef OPENRAVE_TASKSCHEDULER_H
+#define OPENRAVE_TASKSCHEDULER_H
+
+#include <atomic>
+#include <functional>
+
+namespace OpenRAVE {
+
+/// \brief Cooperative cancellation flag of a group of tasks. Tasks that did not start yet are skipped once it is cancelled, running tasks can poll \ref IsCancelled.
+class OPENRAVE_API TaskCancellationToken
+{
+public:
+    TaskCancellationToken() : _bCancelled(false) {
+    }
+
+    inline void Cancel() {
+        _bCancelled.store(true, std::memory_order_release);
+    }
+
+    inline bool IsCancelled() const {
+        return _bCancelled.load(std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<bool> _bCancelled;
+};
+
+typedef boost::shared_ptr<TaskCancellationToken> TaskCancellationTokenPtr;
+
+class TaskGroupState;
+typedef boost::shared_ptr<TaskGroupState> TaskGroupStatePtr;
+
+/// \brief Tasks forked on the shared scheduler and joined with \ref Wait.
+///
+/// Wait runs the queued tasks on the calling thread while the group is not finished, so tasks can create and wait on their own groups (nested fork-join)
+/// without blocking the workers. The first exception thrown by a task cancels the group and is rethrown by Wait.
+/// The methods of one group have to be called from the thread that created it.
+class OPENRAVE_API TaskGroup
+{
+public:
+    /// \param ptoken the token to cancel the tasks with. If null, the group creates its own. Several groups can share one token.
+    TaskGroup(TaskCancellationTokenPtr ptoken=TaskCancellationTokenPtr());
+
+    /// \brief cancels and waits for the tasks that are still running, the exceptions are dropped
+    ~TaskGroup();
+
+    /// \brief queues fn on the scheduler
+    void Run(const std::function<void()>& fn);
+
+    /// \brief returns when all the tasks of the group are done, rethrows the first exception
+    void Wait();
+
+    /// \brief the tasks that did not start yet are skipped
+    void Cancel();
+
+    bool IsCancelled() const;
+
+    const TaskCancellationTokenPtr& GetCancellationToken() const;
+
+private:
+    TaskGroupStatePtr _pstate;
+};
+
+/// \brief calls fn(i) for every i in [0, num) on the shared scheduler and the calling thread, returns when all the calls are done.
+///
+/// The iterations are split in chunks so that idle workers steal the remaining ones. Rethrows the first exception of fn.
+/// \param ptoken if set and cancelled, the iterations that did not start are skipped
+OPENRAVE_API void RaveParallelFor(size_t num, const std::function<void(size_t)>& fn, TaskCancellationTokenPtr ptoken=TaskCancellationTokenPtr());
+
+/// \brief sets the number of worker threads of the shared scheduler. The threads waiting on a group also run tasks.
+///
+/// The groups already running finish on the previous scheduler. Cannot be called from a task.
+/// \param numThreads 0 to run all the tasks on the waiting threads, negative for the number of cores minus one (the default, also set with the OPENRAVE_TASK_THREADS environment variable)
+OPENRAVE_API void RaveSetTaskSchedulerNumThreads(int numThreads);
+
+/// \brief the number of worker threads of the shared scheduler
+OPENRAVE_API int RaveGetTaskSchedulerNumThreads();
+
+} // end namespace OpenRAVE
+
+#endif
@@ -35,6 +35,8 @@ enum TrajectoryInitializationOptions
 enum TrajectorySerializeOptions
 {
     TSO_SerializeAsXML = 0x8000, ///< On GenericTrajectory::serialize, if this is specified, the trajectory will serialized as XML, otherwise binary ortraj.
+    TSO_SerializeMappable = 0x4000, ///< On GenericTrajectory::serialize, write the binary format version 4 that stores the waypoints and accumulated times aligned at the end of the file, so that DeserializeFromMappedFile can sample them in place.
+    TSO_SerializeCompressed = 0x2000, ///< On GenericTrajectory::serialize, write the binary format version 5 that stores the waypoints per dof as quantized deltas compressed with zlib. The tolerance is set with the "SetCompressionTolerance" command of the trajectory, by default the values are exact. Ignored with TSO_SerializeMappable.
 };
 
 /** \brief <b>[interface]</b> Encapsulate a time-parameterized trajectories of robot configurations. <b>If not specified, method is not multi-thread safe.</b> \arch_trajectory
@@ -233,6 +235,11 @@ public:
     /// \brief return the duration of the trajectory in seconds
     virtual dReal GetDuration() const = 0;
 
+    /// \brief returns a non-cryptographic hash of the configuration specification and the waypoint data
+    ///
+    /// Two trajectories with the same specification and bitwise equal waypoints have the same hash, so it can be used as a cache key for results computed from the trajectory. The default implementation hashes the output of GetWaypoints every call, implementations can cache it until the trajectory is modified.
+    virtual uint64_t GetDataHash() const;
+
     /// \brief output the trajectory in XML format
     virtual void serialize(std::ostream& O, int options=0) const;
 
@@ -242,6 +249,11 @@ public:
     /// \brief initialize the trajectory via a raw pointer to memory
     virtual void DeserializeFromRawData(const uint8_t* pdata, size_t nDataSize);
 
+    /// \brief initialize the trajectory from a file that is memory-mapped when possible
+    ///
+    /// Files written with TSO_SerializeMappable keep their waypoints in the mapping and are only paged in when sampled. Modifying the trajectory copies the waypoints into memory first. Other formats are read normally.
+    virtual void DeserializeFromMappedFile(const std::string& filename);
+
     /// \brief Clone the contents of the given trajectory to the current trajectory.
     /// \param preference the interface whose information to clone
     /// \param cloningoptions mask of CloningOptions
@@ -249,9 +261,9 @@ public:
 
     /// \brief swap the contents of the data between the two trajectories.
     ///
-    /// \param traj the trajrectory to swap data with. this->GetXMLId() == traj->GetXMLId() has to be met.
-    /// This function is meant to be extremely fast with as few memory copies as possible.
-    virtual void Swap(TrajectoryBasePtr traj) OPENRAVE_DUMMY_IMPLEMENTATION;
+    /// \param traj the trajrectory to swap data with.
+    /// This function is meant to be extremely fast with as few memory copies as possible when both trajectories have the same implementation. Otherwise the default implementation copies the waypoints through GetWaypoints and Insert.
+    virtual void Swap(TrajectoryBasePtr traj);
 
 protected:
     inline TrajectoryBasePtr shared_trajectory() {
@@ -276,6 +288,9 @@ protected:
     template <typename T>
     void _SamplePointsInRange(std::vector<dReal>& data, RangeGenerator<T>& timeRange, const ConfigurationSpecification& spec) const;
 
+    /// \brief computes the hash returned by GetDataHash from the specification and the raw waypoint data
+    static uint64_t _ComputeDataHash(const ConfigurationSpecification& spec, const dReal* pdata, size_t nDataElements);
+
 private:
     virtual const char* GetHash() const {
         return OPENRAVE_TRAJECTORY_HASH;
@@ -284,6 +284,39 @@ OPENRAVE_API std::string GetFilenameUntilSeparator(std::istream& sinput, char se
 /// \return returns a reference to the out string
 OPENRAVE_API std::string& SearchAndReplace(std::string& out, const std::string& in, const std::vector< std::pair<std::string, std::string> >& pairs);
 
+/// \brief parses up to maxvalues whitespace separated reals from a null terminated string without going through a stream.
+///
+/// Accepts everything strtod accepts, including nan and inf.
+/// \param[out] ppend if not NULL, set to the first character that was not consumed
+/// \return the number of values written to pvalues. Stops early at the end of the string or at the first token that is not a number
+OPENRAVE_API size_t ParseReals(const char* pstr, dReal* pvalues, size_t maxvalues, const char** ppend=NULL);
+
+/// \brief parses all the whitespace separated reals of a string into vvalues, stops at the first token that is not a number
+OPENRAVE_API void ParseReals(const std::string& s, std::vector<dReal>& vvalues);
+
+/** \brief records the duration of a startup phase when the OPENRAVE_STARTUP_TRACE environment variable is set, does nothing otherwise.
+
+    The phases are recorded into the same per-thread buffers as \ref OPENRAVE_TRACE_SCOPE, and RaveDestroy writes the buffers to the file
+    named by OPENRAVE_STARTUP_TRACE in the Chrome trace event format, which can be opened with chrome://tracing or Perfetto. Scopes
+    created inside other scopes of the same thread show up as nested phases. Once the buffer of a thread is full its oldest phases
+    are overwritten, see \ref RaveSetTracing.
+ */
+class OPENRAVE_API StartupTraceScope
+{
+public:
+    /// \param category short group of the phase, should be a string literal
+    StartupTraceScope(const char* category, const std::string& name);
+    ~StartupTraceScope();
+
+    /// \brief true if OPENRAVE_STARTUP_TRACE is set, use to avoid formatting the names of the phases otherwise
+    static bool IsEnabled();
+
+private:
+    const char* _category;
+    std::string _name;
+    uint64_t _starttime; ///< ns, 0 if not recording
+};
+
 /// \brief compute the md5 hash of a string
 OPENRAVE_API std::string GetMD5HashString(const std::string& s);
 /// \brief compute the md5 hash of an array
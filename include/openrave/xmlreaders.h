@@ -31,6 +31,42 @@ namespace xmlreaders {
 
 OPENRAVE_API bool ParseXMLData(BaseXMLReader& reader, const char* buffer, int size);
 
+/// \brief the SAX events of a parsed xml document, so the document can be read again by any BaseXMLReader without parsing the text
+class OPENRAVE_API XMLEventRecording
+{
+public:
+    enum EventType
+    {
+        ET_StartElement = 0,
+        ET_EndElement = 1,
+        ET_Characters = 2,
+    };
+    struct Event
+    {
+        EventType type;
+        std::string name; ///< lower case element name for ET_StartElement and ET_EndElement, the data for ET_Characters
+        AttributesList atts; ///< lower case attribute names for ET_StartElement
+    };
+
+    /// \brief parses the xml data with libxml2 and records all its events
+    bool Record(const char* buffer, int size);
+
+    /// \brief sends the events to reader the same way ParseXMLData does, including stopping at the end element the reader returns true for
+    void Replay(BaseXMLReader& reader) const;
+
+    std::vector<Event> _vevents;
+};
+
+typedef boost::shared_ptr<XMLEventRecording const> XMLEventRecordingConstPtr;
+
+/// \brief returns the recording of the xml data, parsing it only if the same data was not recorded recently.
+///
+/// The process keeps the recordings of the last few distinct documents, keyed by the hash of their data. Meant for documents that are read repeatedly, like the planner parameters that every InitPlan copies through xml.
+OPENRAVE_API XMLEventRecordingConstPtr GetCachedXMLEventRecording(const char* buffer, int size);
+
+/// \brief same as ParseXMLData, except the events come from GetCachedXMLEventRecording
+OPENRAVE_API void ParseCachedXMLData(BaseXMLReader& reader, const char* buffer, int size);
+
 /// \brief maintains a hierarchy of classes each containing the xml attributes and data
 class OPENRAVE_API HierarchicalXMLReadable : public Readable
 {
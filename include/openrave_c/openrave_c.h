@@ -141,6 +141,47 @@ OPENRAVE_C_API int ORCEnvironmentSetViewer(void* env, const char* viewername);
 
 //@}
 
+/// \name Batched \ref EnvironmentBase methods
+///
+/// Operate on many bodies with one call and one environment lock, so that the cost of crossing the language boundary is paid once per batch instead of once per body.
+//@{
+
+/// \brief Calls \ref KinBody::SetTransform for every body
+///
+/// \param bodies numbodies body pointers
+/// \param[in] poses numbodies*7 values, the quaternion (4) and translation (3) of the world pose of every body
+OPENRAVE_C_API void ORCEnvironmentSetBodyTransforms(void* env, void** bodies, int numbodies, const OpenRAVEReal* poses);
+
+/// \brief Calls \ref KinBody::GetTransform for every body
+///
+/// \param bodies numbodies body pointers
+/// \param[out] poses numbodies*7 values, the quaternion (4) and translation (3) of the world pose of every body
+OPENRAVE_C_API void ORCEnvironmentGetBodyTransforms(void* env, void** bodies, int numbodies, OpenRAVEReal* poses);
+
+/// \brief Calls \ref KinBody::SetDOFValues for every body
+///
+/// \param bodies numbodies body pointers
+/// \param[in] values the DOF values of all bodies one after the other, the sum of \ref ORCBodyGetDOF of the bodies
+/// \return number of values read
+OPENRAVE_C_API int ORCEnvironmentSetBodyDOFValues(void* env, void** bodies, int numbodies, const OpenRAVEReal* values);
+
+/// \brief Calls \ref KinBody::GetDOFValues for every body
+///
+/// If values is NULL, only returns the number of values needed.
+/// \param bodies numbodies body pointers
+/// \param[out] values the DOF values of all bodies one after the other, the sum of \ref ORCBodyGetDOF of the bodies
+/// \return number of values written
+OPENRAVE_C_API int ORCEnvironmentGetBodyDOFValues(void* env, void** bodies, int numbodies, OpenRAVEReal* values);
+
+/// \brief Calls \ref EnvironmentBase::CheckCollision for every body against the rest of the environment
+///
+/// \param bodies numbodies body pointers
+/// \param[out] collisions if not NULL, filled with 1 for every body that is in collision and 0 otherwise
+/// \return number of bodies in collision
+OPENRAVE_C_API int ORCEnvironmentCheckCollisions(void* env, void** bodies, int numbodies, int* collisions);
+
+//@}
+
 /// \name \ref InterfaceBase methods
 //@{
 
@@ -245,6 +286,44 @@ OPENRAVE_C_API const char* ORCRobotGetName(void* robot);
 /// Have to release the module pointer with \ref ORCModuleRelease
 OPENRAVE_C_API void* ORCModuleCreate(void* env, const char* modulename);
 
+/// \name \ref TrajectoryBase methods
+//@{
+
+/// \brief Calls \ref RaveCreateTrajectory
+///
+/// Have to release the trajectory pointer with \ref ORCInterfaceRelease
+/// \param trajectorytype if NULL or empty, uses the default trajectory type
+OPENRAVE_C_API void* ORCTrajectoryCreate(void* env, const char* trajectorytype);
+
+/// \brief Calls \ref TrajectoryBase::DeserializeFromRawData
+///
+/// \param data the serialized trajectory, binary or XML
+/// \return 1 if successful, 0 otherwise
+OPENRAVE_C_API int ORCTrajectoryDeserialize(void* traj, const char* data, int size);
+
+/// \brief returns the DOF of the configuration specification of the trajectory, which is the number of values of every sampled point
+OPENRAVE_C_API int ORCTrajectoryGetDOF(void* traj);
+
+/// \brief Calls \ref TrajectoryBase::GetDuration
+OPENRAVE_C_API OpenRAVEReal ORCTrajectoryGetDuration(void* traj);
+
+/// \brief Calls \ref TrajectoryBase::SamplePoints
+///
+/// \param[in] times numtimes times to sample at
+/// \param[out] data numtimes*\ref ORCTrajectoryGetDOF values, the sampled points one after the other
+/// \return number of values written
+OPENRAVE_C_API int ORCTrajectorySamplePoints(void* traj, const OpenRAVEReal* times, int numtimes, OpenRAVEReal* data);
+
+/// \brief Calls \ref TrajectoryBase::Sample on several trajectories at the same time
+///
+/// Meant for playing back the trajectories of many bodies in lockstep.
+/// \param trajs numtrajs trajectory pointers
+/// \param[out] data the sampled point of every trajectory one after the other, the sum of \ref ORCTrajectoryGetDOF of the trajectories
+/// \return number of values written
+OPENRAVE_C_API int ORCTrajectoriesSample(void** trajs, int numtrajs, OpenRAVEReal time, OpenRAVEReal* data);
+
+//@}
+
 #ifdef __cplusplus
 }
 #endif
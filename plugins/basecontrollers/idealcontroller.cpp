@@ -17,6 +17,7 @@
 
 #include <boost/bind/bind.hpp>
 #include <boost/lexical_cast.hpp>
+#include <atomic>
 
 using namespace boost::placeholders;
 
@@ -30,7 +31,9 @@ If \ref ControllerBase::SetPath is called and the trajectory finishes, then the
 1. ControllerBase::SetPath is called.\n\n\
 2. ControllerBase::SetDesired is called.\n\n\
 3. ControllerBase::Reset is called resetting everything\n\n\
-If SetDesired is called, only joint values will be set at every timestep leaving the transformation alone.\n";
+If SetDesired is called, only joint values will be set at every timestep leaving the transformation alone.\n\n\
+In streaming mode, started with the StartStreaming command, joint targets are pushed into a fixed size queue with PushStreamTargets and every simulation step sets the next one. \
+Pushing does not lock the environment or the controller, so a hardware-synchronized thread can feed the controller at the control rate.\n";
         RegisterCommand("Pause",boost::bind(&IdealController::_Pause,this,_1,_2),
                         "pauses the controller from reacting to commands ");
         RegisterCommand("SetCheckCollisions",boost::bind(&IdealController::_SetCheckCollisions,this,_1,_2),
@@ -39,6 +42,14 @@ If SetDesired is called, only joint values will be set at every timestep leaving
                         "If set, will throw exceptions instead of print warnings. Format is:\n\n  [0/1]");
         RegisterCommand("SetEnableLogging",boost::bind(&IdealController::_SetEnableLogging,this,_1,_2),
                         "If set, will write trajectories to disk");
+        RegisterCommand("StartStreaming",boost::bind(&IdealController::_StartStreamingCommand,this,_1,_2),
+                        "Stops the trajectory and starts following streamed joint targets. Format is:\n\n  capacity\n\nwhere capacity is the number of targets the queue holds.");
+        RegisterCommand("StopStreaming",boost::bind(&IdealController::_StopStreamingCommand,this,_1,_2),
+                        "Stops following the streamed joint targets, the robot stays at the last one.");
+        RegisterCommand("PushStreamTargets",boost::bind(&IdealController::_PushStreamTargetsCommand,this,_1,_2),
+                        "Queues joint targets, one is set every simulation step. Pushes from several threads are serialized. Format is:\n\n  numtargets values...\n\nwhere every target has one value per controlled dof. Returns the number of targets queued, the others are dropped because the queue is full.");
+        RegisterCommand("GetStreamingStatistics",boost::bind(&IdealController::_GetStreamingStatisticsCommand,this,_1,_2),
+                        "Returns the statistics of the streaming since it started:\n\n  numsteps numtargets numunderruns numdropped queued meanjitterus maxjitterus\n\nwhere an underrun is a step without a queued target and the jitter is the difference between the real time between two steps and their simulation time.");
         _fCommandTime = 0;
         _fSpeed = 1;
         _nControlTransformation = 0;
@@ -95,6 +106,7 @@ If SetDesired is called, only joint values will be set at every timestep leaving
 
     virtual void Reset(int options)
     {
+        _bStreaming = false;
         _ptraj.reset();
         _vecdesired.resize(0);
         if( flog.is_open() ) {
@@ -117,6 +129,7 @@ If SetDesired is called, only joint values will be set at every timestep leaving
         }
         _fCommandTime = 0;
         _ptraj.reset();
+        _bStreaming = false;
         // do not set done to true here! let it be picked up by the simulation thread.
         // this will also let it have consistent mechanics as SetPath
         // (there's a race condition we're avoiding where a user calls SetDesired and then state savers revert the robot)
@@ -153,6 +166,7 @@ If SetDesired is called, only joint values will be set at every timestep leaving
         }
         _fCommandTime = 0;
         _bIsDone = true;
+        _bStreaming = false;
         _vecdesired.resize(0);
         _ptraj.reset();
 
@@ -260,10 +274,14 @@ If SetDesired is called, only joint values will be set at every timestep leaving
             return;
         }
         std::lock_guard<std::mutex> lock(_mutex);
+        if( _bStreaming ) {
+            _StreamingStep(fTimeElapsed);
+            return;
+        }
         TrajectoryBaseConstPtr ptraj = _ptraj; // because of multi-threading setting issues
         if( !!ptraj ) {
             RobotBasePtr probot = _probot.lock();
-            vector<dReal> sampledata;
+            std::vector<dReal>& sampledata = _vsampledata;
             ptraj->Sample(sampledata,_fCommandTime,_samplespec);
 
             // already sampled, so change the command times before before setting values
@@ -324,7 +342,8 @@ If SetDesired is called, only joint values will be set at every timestep leaving
                 }
             }
 
-            vector<dReal> vdofvalues;
+            std::vector<dReal>& vdofvalues = _vsampledofvalues;
+            vdofvalues.resize(0);
             if( _bTrajHasJoints && _dofindices.size() > 0 ) {
                 vdofvalues.resize(_dofindices.size());
                 _samplespec.ExtractJointValues(vdofvalues.begin(),sampledata.begin(), probot, _dofindices, 0);
@@ -425,6 +444,107 @@ private:
         return shared_controller();
     }
 
+    bool _StartStreamingCommand(std::ostream& os, std::istream& is)
+    {
+        int capacity = 0;
+        is >> capacity;
+        if( !is || capacity <= 0 ) {
+            return false;
+        }
+        // a thread pushing the targets of the previous streaming could write to the queue while it is resized
+        std::lock_guard<std::mutex> pushlock(_mutexPush);
+        std::lock_guard<std::mutex> lock(_mutex);
+        if( _bPause || !_probot.lock() || _dofindices.size() == 0 ) {
+            return false;
+        }
+        _bStreaming = false;
+        _ptraj.reset();
+        _vecdesired.resize(0);
+        _streamqueue.Init(capacity, _dofindices.size());
+        _vstreamtarget.resize(_dofindices.size());
+        _streamstatistics = StreamingStatistics();
+        _numStreamDropped = 0;
+        _nLastStreamStepUS = 0;
+        _fCommandTime = 0;
+        _bIsDone = false;
+        _bStreaming = true;
+        return true;
+    }
+
+    bool _StopStreamingCommand(std::ostream& os, std::istream& is)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _bStreaming = false;
+        _bIsDone = true;
+        return true;
+    }
+
+    bool _PushStreamTargetsCommand(std::ostream& os, std::istream& is)
+    {
+        int numtargets = 0;
+        is >> numtargets;
+        if( !is || numtargets < 0 ) {
+            return false;
+        }
+        // the simulation thread never takes _mutexPush, so it never waits on the pushing thread
+        std::lock_guard<std::mutex> pushlock(_mutexPush);
+        if( !_bStreaming ) {
+            return false;
+        }
+        _vpushtarget.resize(_streamqueue.GetDOF());
+        int numqueued = 0;
+        for(int itarget = 0; itarget < numtargets; ++itarget) {
+            for(size_t idof = 0; idof < _vpushtarget.size(); ++idof) {
+                is >> _vpushtarget[idof];
+            }
+            if( !is ) {
+                return false;
+            }
+            if( _streamqueue.Push(_vpushtarget.data()) ) {
+                ++numqueued;
+            }
+            else {
+                _numStreamDropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        os << numqueued;
+        return true;
+    }
+
+    bool _GetStreamingStatisticsCommand(std::ostream& os, std::istream& is)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const StreamingStatistics& stats = _streamstatistics;
+        os << stats.numSteps << " " << stats.numTargets << " " << stats.numUnderruns << " " << _numStreamDropped.load(std::memory_order_relaxed) << " " << _streamqueue.GetSize() << " "
+           << (stats.numIntervals > 0 ? stats.sumJitterUS/stats.numIntervals : 0) << " " << stats.maxJitterUS;
+        return true;
+    }
+
+    /// \brief sets the next streamed target, holds the last one if the queue is empty. _mutex has to be locked
+    void _StreamingStep(dReal fTimeElapsed)
+    {
+        const uint64_t curtime = utils::GetMicroTime();
+        if( _nLastStreamStepUS > 0 ) {
+            const double jitterUS = RaveFabs((double)(curtime - _nLastStreamStepUS) - 1e6*fTimeElapsed);
+            _streamstatistics.sumJitterUS += jitterUS;
+            _streamstatistics.maxJitterUS = max(_streamstatistics.maxJitterUS, jitterUS);
+            ++_streamstatistics.numIntervals;
+        }
+        _nLastStreamStepUS = curtime;
+        ++_streamstatistics.numSteps;
+
+        if( !_streamqueue.Pop(_vstreamtarget.data()) ) {
+            ++_streamstatistics.numUnderruns;
+            _bIsDone = true;
+            return;
+        }
+        _bIsDone = false;
+        _fCommandTime += fTimeElapsed;
+        // the first target can be far from the current values, so only check the velocity between targets
+        _SetDOFValues(_vstreamtarget, _streamstatistics.numTargets > 0 ? fTimeElapsed : 0);
+        ++_streamstatistics.numTargets;
+    }
+
     virtual void _SetJointLimits()
     {
         RobotBasePtr probot = _probot.lock();
@@ -438,8 +558,8 @@ private:
     virtual void _SetDOFValues(const std::vector<dReal>&values, dReal timeelapsed)
     {
         RobotBasePtr probot = _probot.lock();
-        
-        vector<dReal> prevvalues, curvalues, curvel;
+
+        std::vector<dReal>& prevvalues = _vprevvalues, &curvalues = _vcurvalues, &curvel = _vcurvel;
         probot->GetDOFValues(prevvalues);
         curvalues = prevvalues;
         probot->GetDOFVelocities(curvel);
@@ -459,7 +579,7 @@ private:
     {
         RobotBasePtr probot = _probot.lock();
         BOOST_ASSERT(_nControlTransformation);
-        vector<dReal> prevvalues, curvalues, curvel;
+        std::vector<dReal>& prevvalues = _vprevvalues, &curvalues = _vcurvalues, &curvel = _vcurvel;
         probot->GetDOFValues(prevvalues);
         curvalues = prevvalues;
         probot->GetDOFVelocities(curvel);
@@ -490,7 +610,8 @@ private:
             }
         }
         if( timeelapsed > 0 ) {
-            vector<dReal> vdiff = curvalues;
+            std::vector<dReal>& vdiff = _vdiffvalues;
+            vdiff = curvalues;
             probot->SubtractDOFValues(vdiff,prevvalues);
             for(size_t i = 0; i < _vupper[1].size(); ++i) {
                 if( std::isnan(vdiff.at(i)) ) {
@@ -569,6 +690,82 @@ private:
     ConfigurationSpecification _samplespec;
     boost::shared_ptr<ConfigurationSpecification::Group> _gjointvalues, _gtransform;
     std::mutex _mutex;
+
+    // buffers reused every simulation step
+    std::vector<dReal> _vsampledata, _vsampledofvalues, _vprevvalues, _vcurvalues, _vcurvel, _vdiffvalues;
+
+    /// \brief lock-free queue of joint targets with one pushing thread and SimulationStep popping
+    class StreamQueue
+    {
+    public:
+        StreamQueue() : _dof(0), _numslots(1), _head(0), _tail(0) {
+        }
+
+        /// \brief not safe while pushing or popping
+        void Init(size_t capacity, size_t dof)
+        {
+            _dof = dof;
+            _numslots = capacity+1; // one slot stays empty to tell a full queue from an empty one
+            _vtargets.resize(_numslots*_dof);
+            _head = 0;
+            _tail = 0;
+        }
+
+        bool Push(const dReal* ptarget)
+        {
+            const size_t tail = _tail.load(std::memory_order_relaxed);
+            const size_t next = (tail+1) % _numslots;
+            if( next == _head.load(std::memory_order_acquire) ) {
+                return false;
+            }
+            std::copy(ptarget, ptarget+_dof, _vtargets.begin()+tail*_dof);
+            _tail.store(next, std::memory_order_release);
+            return true;
+        }
+
+        bool Pop(dReal* ptarget)
+        {
+            const size_t head = _head.load(std::memory_order_relaxed);
+            if( head == _tail.load(std::memory_order_acquire) ) {
+                return false;
+            }
+            std::copy(_vtargets.begin()+head*_dof, _vtargets.begin()+(head+1)*_dof, ptarget);
+            _head.store((head+1) % _numslots, std::memory_order_release);
+            return true;
+        }
+
+        inline size_t GetDOF() const {
+            return _dof;
+        }
+
+        size_t GetSize() const
+        {
+            const size_t head = _head.load(std::memory_order_acquire), tail = _tail.load(std::memory_order_acquire);
+            return (tail + _numslots - head) % _numslots;
+        }
+
+    private:
+        std::vector<dReal> _vtargets; ///< _numslots targets of _dof values
+        size_t _dof, _numslots;
+        std::atomic<size_t> _head, _tail; ///< next slot to pop and to push
+    };
+
+    struct StreamingStatistics
+    {
+        StreamingStatistics() : numSteps(0), numTargets(0), numUnderruns(0), numIntervals(0), sumJitterUS(0), maxJitterUS(0) {
+        }
+        uint64_t numSteps, numTargets, numUnderruns, numIntervals;
+        double sumJitterUS, maxJitterUS;
+    };
+
+    StreamQueue _streamqueue;
+    std::vector<dReal> _vstreamtarget; ///< target popped by the simulation thread
+    std::vector<dReal> _vpushtarget; ///< target parsed by the pushing thread, protected by _mutexPush
+    std::mutex _mutexPush; ///< held while pushing targets and while initializing _streamqueue, locked before _mutex
+    StreamingStatistics _streamstatistics; ///< protected by _mutex
+    std::atomic<uint64_t> _numStreamDropped{0}; ///< targets pushed while the queue was full
+    uint64_t _nLastStreamStepUS = 0;
+    std::atomic<bool> _bStreaming{false};
 };
 
 ControllerBasePtr CreateIdealController(EnvironmentBasePtr penv, std::istream& sinput)
@@ -26,13 +26,52 @@ public:
         template <int N>
         struct COLLISIONMAP
         {
-            boost::multi_array<uint8_t,N> vfreespace;         // 1 for free space, 0 for collision
+            COLLISIONMAP() {
+                dims.fill(0);
+            }
+
+            /// \brief resizes the map and marks all cells as in collision
+            void Resize(const boost::array<size_t,N>& newdims) {
+                dims = newdims;
+                size_t numcells = 1;
+                for(int i = 0; i < N; ++i) {
+                    numcells *= dims[i];
+                }
+                vfreespace.resize(0);
+                vfreespace.resize((numcells+63)/64, 0);
+            }
+
+            /// \brief row-major index of a cell, indices have to be within dims
+            inline size_t GetCellIndex(const boost::array<int,N>& indices) const {
+                size_t index = indices[0];
+                for(int i = 1; i < N; ++i) {
+                    index = index*dims[i] + indices[i];
+                }
+                return index;
+            }
+
+            inline bool IsFree(size_t index) const {
+                return (vfreespace[index>>6]>>(index&63))&1;
+            }
+
+            inline void SetFree(size_t index, bool bFree) {
+                if( bFree ) {
+                    vfreespace[index>>6] |= uint64_t(1)<<(index&63);
+                }
+                else {
+                    vfreespace[index>>6] &= ~(uint64_t(1)<<(index&63));
+                }
+            }
+
+            std::vector<uint64_t> vfreespace;         ///< row-major cells packed 64 per word, bit is 1 for free space, 0 for collision
+            boost::array<size_t,N> dims;         ///< number of cells along every joint
             boost::array<dReal,N> fmin, fmax, fidelta;
             boost::array<string,N> jointnames;
             boost::array<int,N> jointindices;
 
             bool operator==(const COLLISIONMAP<N>& other) const {
                 return vfreespace == other.vfreespace && 
+                    dims == other.dims && 
                     fmin == other.fmin && 
                     fmax == other.fmax && 
                     fidelta == other.fidelta && 
@@ -93,7 +132,7 @@ public:
                         boost::array<size_t,2> dims={ { 0,0}};
                         stringstream ss(itatt->second);
                         ss >> dims[0] >> dims[1];
-                        pair.vfreespace.resize(dims);
+                        pair.Resize(dims);
                     }
                     else if( itatt->first == "min" ) {
                         stringstream ss(itatt->second);
@@ -120,13 +159,12 @@ public:
             if( name == "pair" ) {
                 BOOST_ASSERT(_cmdata->listmaps.size()>0);
                 XMLData::COLLISIONPAIR& pair = _cmdata->listmaps.back();
-                for(size_t i = 0; i < pair.vfreespace.shape()[0]; i++) {
-                    for(size_t j = 0; j < pair.vfreespace.shape()[1]; j++) {
-                        // have to read with an int, uint8_t gives bugs!
-                        int freespace;
-                        _ss >> freespace;
-                        pair.vfreespace[i][j] = freespace;
-                    }
+                const size_t numcells = pair.dims[0]*pair.dims[1];
+                for(size_t index = 0; index < numcells; ++index) {
+                    // have to read with an int, uint8_t gives bugs!
+                    int freespace = 0;
+                    _ss >> freespace;
+                    pair.SetFree(index, freespace != 0);
                 }
                 if( !_ss ) {
                     RAVELOG_WARN("failed to read collision pair values\n");
@@ -216,7 +254,7 @@ For joints J2xJ3, the index operation is::\n\n\
             FOREACH(itmap,cmdata->listmaps) {
                 for(size_t i = 0; i < itmap->jointnames.size(); ++i) {
                     JointPtr pjoint = GetJoint(itmap->jointnames[i]);
-                    itmap->fidelta.at(i) = (dReal)itmap->vfreespace.shape()[i]/(itmap->fmax.at(i)-itmap->fmin.at(i));
+                    itmap->fidelta.at(i) = (dReal)itmap->dims[i]/(itmap->fmax.at(i)-itmap->fmin.at(i));
                     if( !pjoint ) {
                         itmap->jointindices.at(i) = -1;
                         RAVELOG_WARN(str(boost::format("failed to find joint %s specified in collisionmap")%itmap->jointnames[i]));
@@ -237,7 +275,6 @@ For joints J2xJ3, the index operation is::\n\n\
         // check if the current joint angles fall within the allowable range
         boost::shared_ptr<XMLData> cmdata = boost::dynamic_pointer_cast<XMLData>(GetReadableInterface("collisionmap"));
         if( !!cmdata ) {
-            vector<dReal> values;
             boost::array<int,2> indices={ { 0,0}};
             FOREACHC(itmap,cmdata->listmaps) {
                 size_t i=0;
@@ -246,10 +283,9 @@ For joints J2xJ3, the index operation is::\n\n\
                     if( *itjindex < 0 ) {
                         break;
                     }
-                    GetJoints().at(*itjindex)->GetValues(values);
                     if( curmap.fmin[i] < curmap.fmax[i] ) {
-                        int index = (int)((values.at(0)-curmap.fmin[i])*curmap.fidelta[i]);
-                        if( index < 0 || index >= (int)curmap.vfreespace.shape()[i] ) {
+                        int index = (int)((GetJoints().at(*itjindex)->GetValue(0)-curmap.fmin[i])*curmap.fidelta[i]);
+                        if( index < 0 || index >= (int)curmap.dims[i] ) {
                             break;
                         }
                         indices.at(i) = index;
@@ -259,7 +295,7 @@ For joints J2xJ3, the index operation is::\n\n\
                 if( i != curmap.jointindices.size() ) {
                     continue;
                 }
-                if( !curmap.vfreespace(indices) ) {
+                if( !curmap.IsFree(curmap.GetCellIndex(indices)) ) {
                     // get all colliding links and check to make sure that at least two are enabled
                     bool bHasCollision = false;
                     FOREACHC(itjindex,curmap.jointindices) {
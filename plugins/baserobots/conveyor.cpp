@@ -44,18 +44,37 @@ public:
             _info._bIsCircular[0] = bIsCircular;
             _info._trajfollow = trajfollow;
         }
+        /// \brief copies a joint, which is a plain Joint for cloned conveyors
+        ConveyorJoint(const Joint& joint) : Joint(joint) {
+        }
 
         virtual void _ComputeJointInternalInformation(LinkPtr plink0, LinkPtr plink1, dReal currentvalue)
         {
             std::vector<dReal> vcurrentvalues(1); vcurrentvalues[0] = 0; // current values always 0
             Joint::_ComputeJointInternalInformation(plink0, plink1, Vector(), std::vector<Vector>(), vcurrentvalues);
         }
+
+        /// \brief evaluates the mimic equation of the joint, which is its time along the trajectory
+        dReal EvalTrajectoryTime(std::vector<dReal>& vdependentvalues, std::vector<dReal>& veval) const
+        {
+            const KinBody& parent = *GetParent();
+            const Mimic& mimic = *_vmimic[0];
+            vdependentvalues.resize(mimic._vdofformat.size());
+            for(size_t i = 0; i < mimic._vdofformat.size(); ++i) {
+                vdependentvalues[i] = mimic._vdofformat[i].GetJoint(parent)->GetValue(mimic._vdofformat[i].axis);
+            }
+            if( _Eval(0, 0, vdependentvalues, veval) != 0 || veval.size() == 0 ) {
+                RAVELOG_WARN_FORMAT("failed to evaluate conveyor joint %s", GetName());
+                return 0;
+            }
+            return veval[0];
+        }
     };
 
     class ConveyorInfo : public Readable
     {
 public:
-        ConveyorInfo() : Readable("conveyorjoint"), _fLinkDensity(10), _bIsCircular(true), _bCreated(false) {
+        ConveyorInfo() : Readable("conveyorjoint"), _fLinkDensity(10), _bIsCircular(true), _bBatchUpdate(false), _bCreated(false) {
         }
 
         bool SerializeXML(BaseXMLWriterPtr writer, int options=0) const override {
@@ -77,6 +96,7 @@ public:
                 _listGeometries == pOther->_listGeometries &&
                 _namebase == pOther->_namebase &&
                 _bIsCircular == pOther->_bIsCircular &&
+                _bBatchUpdate == pOther->_bBatchUpdate &&
                 _bCreated == pOther->_bCreated;
         }
 
@@ -93,6 +113,7 @@ public:
         std::list<GeometryInfo> _listGeometries; ///< geometry to attach to each child link
         std::string _namebase; ///< base name of joint
         bool _bIsCircular;
+        bool _bBatchUpdate; ///< if true, only the first child link has a joint, the other links are placed along the belt by Conveyor in one pass
 
         bool _bCreated;
     };
@@ -135,7 +156,7 @@ public:
                 return PE_Support;
             }
 
-            static boost::array<string, 6> tags = {{ "mimic_pos", "mimic_vel", "mimic_accel", "parentlink", "linkdensity", "circular" }};
+            static boost::array<string, 7> tags = {{ "mimic_pos", "mimic_vel", "mimic_accel", "parentlink", "linkdensity", "circular", "batchupdate" }};
             if( find(tags.begin(),tags.end(),name) == tags.end() ) {
                 return PE_Pass;
             }
@@ -185,6 +206,10 @@ public:
                 string s; _ss >> s;
                 _cmdata->_bIsCircular = !(s=="false" || s=="0");
             }
+            else if( name == "batchupdate" ) {
+                string s; _ss >> s;
+                _cmdata->_bBatchUpdate = !(s=="false" || s=="0");
+            }
             else if( name == "conveyorjoint" ) {
                 return true;
             }
@@ -219,7 +244,8 @@ protected:
     }
 
     Conveyor(EnvironmentBasePtr penv, std::istream& is) : RobotBase(penv) {
-        __description = ":Interface Author: Rosen Diankov\n\nParses conveyor joints as a trajectory and adds child links to form a full conveyor system. Use the <conveyorjoint> tag to specify the conveyor properties.";
+        __description = ":Interface Author: Rosen Diankov\n\nParses conveyor joints as a trajectory and adds child links to form a full conveyor system. Use the <conveyorjoint> tag to specify the conveyor properties.\n\n\
+With <batchupdate>true</batchupdate>, only the first child link is attached with a joint. The other links are kept as time offsets along the belt and are moved together every time the link transforms change, using a table of the trajectory sampled at 16 points per link spacing. This is much faster for conveyors with many links.";
     }
     virtual ~Conveyor() {
     }
@@ -248,6 +274,12 @@ protected:
         }
     }
 
+    virtual void Clone(InterfaceBaseConstPtr preference, int cloningoptions) override
+    {
+        RobotBase::Clone(preference, cloningoptions);
+        _InitBatchUpdate();
+    }
+
     virtual void _ComputeInternalInformation() override
     {
         // create extra joints for each conveyor joint
@@ -266,6 +298,10 @@ protected:
                 boost::shared_ptr<ConveyorLink> pchildlink(new ConveyorLink(str(boost::format("__moving__%s%d")%cmdata->_namebase%ichild), tparent, shared_kinbody()));
                 pchildlink->InitGeometries(cmdata->_listGeometries);
                 _veclinks.push_back(pchildlink);
+                if( cmdata->_bBatchUpdate && ichild > 0 ) {
+                    // placed by _UpdateBatchLinks
+                    continue;
+                }
 
                 boost::shared_ptr<KinBody::Mimic> mimic(new KinBody::Mimic());
                 *mimic = *cmdata->_mimic;
@@ -278,6 +314,7 @@ protected:
         }
 
         RobotBase::_ComputeInternalInformation();
+        _InitBatchUpdate();
 
         std::vector<int> dofindices(GetDOF());
         for(int i = 0; i < GetDOF(); ++i) {
@@ -290,9 +327,102 @@ protected:
     }
 
 protected:
+    /// \brief if the conveyor uses batchupdate, samples the trajectory into a table and registers _UpdateBatchLinks for link transform changes
+    void _InitBatchUpdate()
+    {
+        _batchlinkscallback.reset();
+        _vBatchLinks.resize(0);
+        _vBatchTimeOffsets.resize(0);
+        _vBatchSamples.resize(0);
+        _pBatchJoint.reset();
+        ConveyorInfoPtr cmdata = boost::dynamic_pointer_cast<ConveyorInfo>(GetReadableInterface("conveyorjoint"));
+        if( !cmdata || !cmdata->_bBatchUpdate || !cmdata->_bCreated ) {
+            return;
+        }
+        JointPtr pjoint = GetJoint(str(boost::format("__moving__%s0")%cmdata->_namebase));
+        if( !pjoint || !pjoint->IsMimic(0) ) {
+            return;
+        }
+        // private copy for evaluating the mimic equation, cloned conveyors only have plain joints
+        _pBatchJoint.reset(new ConveyorJoint(*pjoint));
+        TrajectoryBasePtr ptraj = _pBatchJoint->GetInfo()._trajfollow;
+        _fBatchDuration = ptraj->GetDuration();
+        _bBatchCircular = cmdata->_bIsCircular;
+        dReal timestep = 1.0/cmdata->_fLinkDensity;
+        for(int ichild = 1; ; ++ichild) {
+            LinkPtr plink = GetLink(str(boost::format("__moving__%s%d")%cmdata->_namebase%ichild));
+            if( !plink ) {
+                break;
+            }
+            _vBatchLinks.push_back(plink);
+            _vBatchTimeOffsets.push_back(ichild*timestep);
+        }
+
+        int numsamples = std::max(2, static_cast<int>(RaveCeil(_fBatchDuration*cmdata->_fLinkDensity*16))+1);
+        _fBatchSampleInvStep = (numsamples-1)/_fBatchDuration;
+        _vBatchSamples.resize(numsamples);
+        std::vector<dReal> vdata;
+        for(int isample = 0; isample < numsamples; ++isample) {
+            ptraj->Sample(vdata, isample/_fBatchSampleInvStep);
+            Transform& t = _vBatchSamples[isample];
+            if( !ptraj->GetConfigurationSpecification().ExtractTransform(t, vdata.begin(), KinBodyConstPtr()) ) {
+                RAVELOG_WARN_FORMAT("env=%s, trajectory sampling for conveyor %s failed", GetEnv()->GetNameId()%GetName());
+            }
+            // keep the quaternions in the same hemisphere so that neighboring samples can be interpolated
+            if( isample > 0 && t.rot.dot(_vBatchSamples[isample-1].rot) < 0 ) {
+                t.rot = -t.rot;
+            }
+        }
+        _batchlinkscallback = RegisterChangeCallback(Prop_LinkTransforms, boost::bind(&Conveyor::_UpdateBatchLinks, this));
+        _UpdateBatchLinks();
+    }
+
+    /// \brief moves all the links of the belt from the time of the first child link
+    void _UpdateBatchLinks()
+    {
+        if( _vBatchLinks.size() == 0 ) {
+            return;
+        }
+        dReal ftime = _pBatchJoint->EvalTrajectoryTime(_vBatchDependentValues, _vBatchEval);
+        Transform tleft = _pBatchJoint->GetHierarchyParentLink()->GetTransform() * _pBatchJoint->GetInternalHierarchyLeftTransform();
+        const Transform& tright = _pBatchJoint->GetInternalHierarchyRightTransform();
+        const int nlastsample = (int)_vBatchSamples.size()-1;
+        for(size_t ilink = 0; ilink < _vBatchLinks.size(); ++ilink) {
+            dReal t = ftime + _vBatchTimeOffsets[ilink];
+            if( _bBatchCircular ) {
+                t = fmod(t, _fBatchDuration);
+                if( t < 0 ) {
+                    t += _fBatchDuration;
+                }
+            }
+            else {
+                t = std::max(dReal(0), std::min(_fBatchDuration, t));
+            }
+            dReal fsample = t*_fBatchSampleInvStep;
+            int isample = std::min(static_cast<int>(fsample), nlastsample-1);
+            dReal f = fsample - isample;
+            const Transform& t0 = _vBatchSamples[isample];
+            const Transform& t1 = _vBatchSamples[isample+1];
+            Transform tjoint;
+            tjoint.trans = t0.trans + (t1.trans - t0.trans)*f;
+            tjoint.rot = t0.rot + (t1.rot - t0.rot)*f;
+            tjoint.rot.normalize4();
+            _vBatchLinks[ilink]->SetTransform(tleft * tjoint * tright);
+        }
+    }
+
     TrajectoryBaseConstPtr _trajcur;
     ControllerBasePtr _pController;
 
+    boost::shared_ptr<ConveyorJoint> _pBatchJoint; ///< copy of the joint of the first child link, its time determines the times of _vBatchLinks
+    std::vector<LinkPtr> _vBatchLinks; ///< the child links without joints
+    std::vector<dReal> _vBatchTimeOffsets; ///< time of every link of _vBatchLinks along the trajectory with respect to _pBatchJoint
+    std::vector<Transform> _vBatchSamples; ///< trajectory sampled uniformly in time
+    dReal _fBatchDuration, _fBatchSampleInvStep;
+    bool _bBatchCircular;
+    std::vector<dReal> _vBatchDependentValues, _vBatchEval;
+    UserDataPtr _batchlinkscallback;
+
     static UserDataPtr s_registeredhandle;
 };
 
@@ -1103,11 +1103,8 @@ void HaltonSampler::i4_to_halton_sequence ( int dim_num, int n, int step, int se
 //    leaped Halton subsequence, beginning with element STEP.
 //
 {
-    dReal base_inv;
-    int digit;
     int i;
     int j;
-    int *seed2;
     //
     //  Check the input.
     //
@@ -1123,35 +1120,48 @@ void HaltonSampler::i4_to_halton_sequence ( int dim_num, int n, int step, int se
     //
     //  Calculate the data.
     //
-    seed2 = new int[n];
-
+    //  The indices are kept as doubles (exact below 2^53) and the digits are peeled one
+    //  position at a time for all N elements, so that the inner loops have no data dependent
+    //  branches and can be vectorized. The digits are accumulated in the same order as the
+    //  scalar radical inverse.
+    //
+    _vhaltonindex.resize(n);
+    _vhaltonvalue.resize(n);
+    double* pindex = _vhaltonindex.data();
+    double* pvalue = _vhaltonvalue.data();
     for ( i = 0; i < dim_num; i++ )
     {
+        const double fbase = ( double ) base[i];
         for ( j = 0; j < n; j++ )
         {
-            seed2[j] = seed[i] + ( step + j ) * leap[i];
+            pindex[j] = ( double ) seed[i] + ( double ) ( step + j ) * ( double ) leap[i];
+            pvalue[j] = 0.0;
         }
 
-        for ( j = 0; j < n; j++ )
+        // the number of digits of the largest index bounds the number of passes
+        int numdigits = 0;
+        for ( double fmaxindex = pindex[n-1]; fmaxindex >= 1.0; fmaxindex = std::floor(fmaxindex / fbase) )
         {
-            r[i+j*dim_num] = 0.0;
+            numdigits++;
         }
 
-        for ( j = 0; j < n; j++ )
+        double base_inv = 1.0 / fbase;
+        for ( int idigit = 0; idigit < numdigits; idigit++ )
         {
-            base_inv = 1.0 / ( ( dReal ) base[i] );
-
-            while ( seed2[j] != 0 )
+            for ( j = 0; j < n; j++ )
             {
-                digit = seed2[j] % base[i];
-                r[i+j*dim_num] = r[i+j*dim_num] + ( ( dReal ) digit ) * base_inv;
-                base_inv = base_inv / ( ( dReal ) base[i] );
-                seed2[j] = seed2[j] / base[i];
+                const double quotient = std::floor(pindex[j] / fbase);
+                pvalue[j] += ( pindex[j] - quotient * fbase ) * base_inv;
+                pindex[j] = quotient;
             }
+            base_inv = base_inv / fbase;
         }
-    }
 
-    delete [] seed2;
+        for ( j = 0; j < n; j++ )
+        {
+            r[i+j*dim_num] = ( dReal ) pvalue[j];
+        }
+    }
 
     return;
 }
@@ -15,8 +15,10 @@
 #define SAMPLER_HALTON
 
 #include <openrave/openrave.h>
+#include <boost/bind/bind.hpp>
 using namespace OpenRAVE;
 using namespace std;
+using namespace boost::placeholders;
 
 class HaltonSampler : public SpaceSamplerBase
 {
@@ -34,19 +36,25 @@ References:\n\n\
         halton_DIM_NUM = -1;
         halton_SEED = NULL;
         halton_STEP = -1;
+        _nStreamIndex = 0;
+        RegisterCommand("SetStream",boost::bind(&HaltonSampler::_SetStreamCommand,this,_1,_2),
+                        "format: \"SetStream [index]\". Starts the sequence at element index*2^20 so that samplers used by different threads draw from disjoint blocks of the same Halton sequence. The index has to be in [0,2047] and is kept when changing the seed or dof.");
         SetSpaceDOF(1);
         SetSeed(0);
         halton_step_set (1);
     }
 
     void SetSeed(uint32_t seed) {
-        vector<int> vseed(halton_dim_num_get(),0);
+        vector<int> vseed(halton_dim_num_get(),_nStreamIndex*s_nStreamBlockSize);
         halton_seed_set ( &vseed[0] );
     }
 
     void SetSpaceDOF(int dof) {
         BOOST_ASSERT(dof > 0);
         halton_dim_num_set ( dof );
+        if( _nStreamIndex > 0 ) {
+            SetSeed(0);
+        }
     }
     int GetDOF() const {
         return halton_dim_num_get();
@@ -68,10 +76,20 @@ References:\n\n\
         }
     }
 
+    using SpaceSamplerBase::SampleSequence;
+
     int SampleSequence(std::vector<dReal>& samples, size_t num=1,IntervalType interval=IT_Closed)
     {
         samples.resize(halton_dim_num_get()*num);
-        halton_sequence(num,&samples[0]);
+        return SampleSequence(samples.data(), num, interval);
+    }
+
+    int SampleSequence(dReal* samples, size_t num, IntervalType interval=IT_Closed)
+    {
+        if( num == 0 ) {
+            return 0;
+        }
+        halton_sequence(num,samples);
         return (int)num;
     }
 
@@ -84,6 +102,20 @@ References:\n\n\
     }
 
 protected:
+    bool _SetStreamCommand(std::ostream& sout, std::istream& sinput)
+    {
+        int index = 0;
+        sinput >> index;
+        if( !sinput ) {
+            return false;
+        }
+        OPENRAVE_ASSERT_OP(index,>=,0);
+        OPENRAVE_ASSERT_OP(index,<,s_nStreamCount);
+        _nStreamIndex = index;
+        SetSeed(0);
+        return true;
+    }
+
     dReal arc_cosine ( dReal c );
     dReal atan4 ( dReal y, dReal x );
     char digit_to_ch ( int i );
@@ -120,6 +152,12 @@ protected:
     int halton_DIM_NUM;
     int *halton_SEED;
     int halton_STEP;
+
+    static const int s_nStreamBlockSize = 1<<20; ///< number of sequence elements reserved for each stream
+    static const int s_nStreamCount = 2048; ///< streams*block size has to fit in the int sequence index
+    int _nStreamIndex; ///< index of the block of the sequence this sampler draws from, set by SetStream
+
+    std::vector<double> _vhaltonindex, _vhaltonvalue; ///< scratch for i4_to_halton_sequence
 };
 
 #endif
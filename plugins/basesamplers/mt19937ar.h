@@ -46,22 +46,33 @@
 #define SAMPLER_MT19937
 
 #include <openrave/openrave.h>
+#include <boost/bind/bind.hpp>
 using namespace OpenRAVE;
 using namespace std;
+using namespace boost::placeholders;
 
 // eventually replace with http://www.math.sci.hiroshima-u.ac.jp/~m-mat/MT/SFMT/index-jp.html
 class MT19937Sampler : public SpaceSamplerBase
 {
 public:
-    MT19937Sampler(EnvironmentBasePtr penv,std::istream& sinput) : SpaceSamplerBase(penv), _dof(1)
+    MT19937Sampler(EnvironmentBasePtr penv,std::istream& sinput) : SpaceSamplerBase(penv), _dof(1), _seed(5489UL), _streamindex(0)
     {
         __description = ":Interface Author: Takuji Nishimura and Makoto Matsumoto\n\n\
 Mersenne twister sampling algorithm that is based on matrix linear recurrence over finite binary field F2. It has a period of 2^19937-1 and passes many tests for statistical uniform randomness.";
+        RegisterCommand("SetStream",boost::bind(&MT19937Sampler::_SetStreamCommand,this,_1,_2),
+                        "format: \"SetStream [index]\". Reinitializes the state from the pair (seed, index) so that samplers used by different threads with the same seed produce reproducible and uncorrelated streams. Index 0 is the regular single stream. The index is kept when changing the seed.");
         mti=N+1;
     }
 
     void SetSeed(uint32_t seed) {
-        init_genrand(seed);
+        _seed = seed;
+        if( _streamindex == 0 ) {
+            init_genrand(seed);
+        }
+        else {
+            uint32_t initkey[2] = { seed, _streamindex };
+            init_by_array(initkey, 2);
+        }
     }
 
     void SetSpaceDOF(int dof) {
@@ -98,33 +109,44 @@ Mersenne twister sampling algorithm that is based on matrix linear recurrence ov
         }
     }
 
+    using SpaceSamplerBase::SampleSequence;
+
     int SampleSequence(std::vector<dReal>& samples, size_t num=1,IntervalType interval=IT_Closed)
     {
         samples.resize(_dof*num);
+        return SampleSequence(samples.data(), num, interval);
+    }
+
+    int SampleSequence(dReal* samples, size_t num, IntervalType interval=IT_Closed)
+    {
+        dReal offset, scale;
         switch(interval) {
         case IT_Open:
-            for(size_t i = 0; i < samples.size(); ++i) {
-                samples[i] = (((dReal)genrand_int32()) + 0.5f)*(1.0f/4294967296.0f);
-            }
+            offset = 0.5f; scale = 1.0f/4294967296.0f;
             break;
         case IT_OpenStart:
-            for(size_t i = 0; i < samples.size(); ++i) {
-                samples[i] = (((dReal)genrand_int32()) + 1.0f)*(1.0f/4294967296.0f);
-            }
+            offset = 1.0f; scale = 1.0f/4294967296.0f;
             break;
         case IT_OpenEnd:
-            for(size_t i = 0; i < samples.size(); ++i) {
-                samples[i] = (dReal)genrand_int32()*(1.0f/4294967296.0f);
-            }
+            offset = 0; scale = 1.0f/4294967296.0f;
             break;
         case IT_Closed:
-            for(size_t i = 0; i < samples.size(); ++i) {
-                samples[i] = (dReal)genrand_int32()*(1.0f/4294967295.0f);
-            }
+            offset = 0; scale = 1.0f/4294967295.0f;
             break;
         default:
             throw OPENRAVE_EXCEPTION_FORMAT0("invalid interval", ORE_InvalidArguments);
         }
+        // convert one block of the state at a time so the tempered words stay in cache
+        uint32_t block[N];
+        size_t numvalues = _dof*num;
+        while(numvalues > 0) {
+            size_t count = genrand_int32_block(block, numvalues);
+            for(size_t i = 0; i < count; ++i) {
+                samples[i] = ((dReal)block[i] + offset)*scale;
+            }
+            samples += count;
+            numvalues -= count;
+        }
         return (int)num;
     }
 
@@ -149,8 +171,9 @@ Mersenne twister sampling algorithm that is based on matrix linear recurrence ov
     int SampleSequence(std::vector<uint32_t>& samples, size_t num)
     {
         samples.resize(_dof*num);
-        for(size_t i = 0; i < samples.size(); ++i) {
-            samples[i] = genrand_int32();
+        size_t offset = 0;
+        while(offset < samples.size()) {
+            offset += genrand_int32_block(&samples[offset], samples.size()-offset);
         }
         return (int)num;
     }
@@ -162,6 +185,17 @@ Mersenne twister sampling algorithm that is based on matrix linear recurrence ov
     }
 
 private:
+    bool _SetStreamCommand(std::ostream& sout, std::istream& sinput)
+    {
+        uint32_t index = 0;
+        sinput >> index;
+        if( !sinput ) {
+            return false;
+        }
+        _streamindex = index;
+        SetSeed(_seed);
+        return true;
+    }
 
     /* initializes mt[N] with a seed */
     void init_genrand(uint32_t s)
@@ -210,43 +244,65 @@ private:
         mt[0] = 0x80000000UL;     /* MSB is 1; assuring non-zero initial array */
     }
 
-    /* generates a random number on [0,0xffffffff]-interval */
-    uint32_t genrand_int32(void)
+    /* generates N words at one time */
+    void next_state(void)
     {
         uint32_t y;
+        int kk;
         /* mag01[x] = x * MATRIX_A  for x=0,1 */
 
-        if (mti >= N) {     /* generate N words at one time */
-            int kk;
-
-            if (mti == N+1)                                                                                                                                                                                                                                                                                           /* if init_genrand() has not been called, */
-                init_genrand(5489UL);                                                                                                                                                                                                                                                                                                                                                                                                      /* a default initial seed is used */
+        if (mti == N+1)   /* if init_genrand() has not been called, */
+            init_genrand(5489UL);   /* a default initial seed is used */
 
-            for (kk=0; kk<N-M; kk++) {
-                y = (mt[kk]&UPPER_MASK)|(mt[kk+1]&LOWER_MASK);
-                mt[kk] = mt[kk+M] ^ (y >> 1) ^ mag01[y & 0x1UL];
-            }
-            for (; kk<N-1; kk++) {
-                y = (mt[kk]&UPPER_MASK)|(mt[kk+1]&LOWER_MASK);
-                mt[kk] = mt[kk+(M-N)] ^ (y >> 1) ^ mag01[y & 0x1UL];
-            }
-            y = (mt[N-1]&UPPER_MASK)|(mt[0]&LOWER_MASK);
-            mt[N-1] = mt[M-1] ^ (y >> 1) ^ mag01[y & 0x1UL];
-
-            mti = 0;
+        for (kk=0; kk<N-M; kk++) {
+            y = (mt[kk]&UPPER_MASK)|(mt[kk+1]&LOWER_MASK);
+            mt[kk] = mt[kk+M] ^ (y >> 1) ^ mag01[y & 0x1UL];
         }
+        for (; kk<N-1; kk++) {
+            y = (mt[kk]&UPPER_MASK)|(mt[kk+1]&LOWER_MASK);
+            mt[kk] = mt[kk+(M-N)] ^ (y >> 1) ^ mag01[y & 0x1UL];
+        }
+        y = (mt[N-1]&UPPER_MASK)|(mt[0]&LOWER_MASK);
+        mt[N-1] = mt[M-1] ^ (y >> 1) ^ mag01[y & 0x1UL];
 
-        y = mt[mti++];
+        mti = 0;
+    }
 
-        /* Tempering */
+    static inline uint32_t temper(uint32_t y)
+    {
         y ^= (y >> 11);
         y ^= (y << 7) & 0x9d2c5680UL;
         y ^= (y << 15) & 0xefc60000UL;
         y ^= (y >> 18);
-
         return y;
     }
 
+    /* generates a random number on [0,0xffffffff]-interval */
+    uint32_t genrand_int32(void)
+    {
+        if (mti >= N) {
+            next_state();
+        }
+        return temper(mt[mti++]);
+    }
+
+    /* fills out with the next min(num, words left in the state) numbers on [0,0xffffffff]-interval,
+       the sequence is the same as calling genrand_int32 that many times. returns the number of words written */
+    size_t genrand_int32_block(uint32_t* out, size_t num)
+    {
+        if (mti >= N) {
+            next_state();
+        }
+        size_t count = std::min(num, (size_t)(N-mti));
+        const uint32_t* pstate = &mt[mti];
+        /* independent iterations, the compiler can vectorize the tempering */
+        for(size_t i = 0; i < count; ++i) {
+            out[i] = temper(pstate[i]);
+        }
+        mti += (int)count;
+        return count;
+    }
+
     /* generates a random number on [0,0x7fffffff]-interval */
     long genrand_int31(void)
     {
@@ -291,6 +347,8 @@ private:
     int mti;     /* mti==N+1 means mt[N] is not initialized */
     uint32_t mag01[2];
     int _dof;
+    uint32_t _seed; ///< last seed passed to SetSeed, needed to reinitialize the state when the stream changes
+    uint32_t _streamindex; ///< 0 for the regular sequence, otherwise mixed with the seed through init_by_array
 };
 
 #endif
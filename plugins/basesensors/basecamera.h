@@ -18,6 +18,8 @@
 
 #include <boost/lexical_cast.hpp>
 
+#include "depthrasterizer.h"
+
 class BaseCameraSensor : public SensorBase
 {
 protected:
@@ -185,6 +187,10 @@ public:
                         "Set the dimensions of the image (width,height)");
         RegisterCommand("SaveImage",boost::bind(&BaseCameraSensor::_SaveImage,this,_1,_2),
                         "Saves the next camera image to the given filename");
+        RegisterCommand("SetHeadlessDepth",boost::bind(&BaseCameraSensor::_SetHeadlessDepth,this,_1,_2),
+                        "Renders depth images in software instead of asking the viewer: enable [maxdepth]. The image data is the depth in grayscale, brighter is closer, and the depth data holds the depths.");
+        RegisterCommand("GetPointCloud",boost::bind(&BaseCameraSensor::_GetPointCloud,this,_1,_2),
+                        "Returns the points in the camera frame of the last headless depth image as 'x y z' triplets");
         _pgeom.reset(new CameraGeomData());
         _pdata.reset(new CameraSensorData());
         _bPower = false;
@@ -193,6 +199,8 @@ public:
         //_numchannels = 3;
         _bRenderGeometry = true;
         _bRenderData = false;
+        _bHeadlessDepth = false;
+        _fHeadlessMaxDepth = 10;
         _Reset();
     }
 
@@ -252,9 +260,11 @@ public:
 
     virtual void _Reset()
     {
-        _pdata->vimagedata.resize(0);
-        _pdata->__stamp = 0;
-        _vimagedata.clear(); // do not resize vector here since it might never be used and it will take up lots of memory!
+        {
+            // consumers can still hold the published data, so never clear it in place
+            std::lock_guard<std::mutex> lock(_mutexdata);
+            _pdata.reset(new CameraSensorData());
+        }
         _fTimeToImage = 0;
         _graphgeometry.reset();
         _dataviewer.reset();
@@ -269,22 +279,28 @@ public:
 
     virtual bool SimulationStep(dReal fTimeElapsed) override
     {
-        boost::shared_ptr<CameraSensorData> pdata = _pdata;
-
         _RenderGeometry();
         if(( _pgeom->width > 0) &&( _pgeom->height > 0) && _bPower) {
             _fTimeToImage -= fTimeElapsed;
             if( _fTimeToImage <= 0 ) {
                 _fTimeToImage = 1 / (float)framerate;
+                if( _bHeadlessDepth ) {
+                    boost::shared_ptr<CameraSensorData> pdata = _datapool.Acquire();
+                    if( _RenderHeadlessDepth(pdata) ) {
+                        _datapool.Publish(_pdata, pdata, _mutexdata);
+                    }
+                    return true;
+                }
                 GetEnv()->UpdatePublishedBodies();
                 if( !!GetEnv()->GetViewer() ) {
-                    _vimagedata.resize(3*_pgeom->width*_pgeom->height);
-                    if( GetEnv()->GetViewer()->GetCameraImage(_vimagedata, _pgeom->width, _pgeom->height, _trans, _pgeom->KK) ) {
-                        // copy the data
-                        std::lock_guard<std::mutex> lock(_mutexdata);
-                        pdata->vimagedata = _vimagedata;
+                    // render directly into a recycled buffer, nobody else references it so no lock is needed until it is published
+                    boost::shared_ptr<CameraSensorData> pdata = _datapool.Acquire();
+                    pdata->vimagedata.resize(3*_pgeom->width*_pgeom->height);
+                    if( GetEnv()->GetViewer()->GetCameraImage(pdata->vimagedata, _pgeom->width, _pgeom->height, _trans, _pgeom->KK) ) {
+                        pdata->vdepthdata.resize(0);
                         pdata->__stamp = GetEnv()->GetSimulationTime();
                         pdata->__trans = _trans;
+                        _datapool.Publish(_pdata, pdata, _mutexdata);
                     }
                 }
             }
@@ -322,6 +338,22 @@ public:
         return false;
     }
 
+    virtual SensorDataConstPtr GetLatestSensorData(SensorType type) override
+    {
+        if( _bPower &&( type == ST_Invalid || type == ST_Camera) ) {
+            std::lock_guard<std::mutex> lock(_mutexdata);
+            if( _pdata->vimagedata.size() > 0 ) {
+                return _pdata;
+            }
+        }
+        return SensorDataConstPtr();
+    }
+
+    virtual uint64_t GetSensorDataSequence(SensorType type) const override
+    {
+        return ( type == ST_Invalid || type == ST_Camera ) ? _datapool.GetSequence() : 0;
+    }
+
     virtual bool Supports(SensorType type) override {
         return type == ST_Camera;
     }
@@ -332,8 +364,8 @@ public:
         sinput >> _bPower;
         if( !_bPower ) {
             // should reset!
-            _pdata->vimagedata.resize(0);
-            _pdata->__stamp = 0;
+            std::lock_guard<std::mutex> lock(_mutexdata);
+            _pdata.reset(new CameraSensorData());
         }
         return !!sinput;
     }
@@ -362,6 +394,32 @@ public:
         RAVELOG_WARN("SaveImage not implemented yet\n");
         return false;
     }
+    bool _SetHeadlessDepth(ostream& sout, istream& sinput)
+    {
+        bool bHeadlessDepth = false;
+        sinput >> bHeadlessDepth;
+        if( !sinput ) {
+            return false;
+        }
+        dReal fMaxDepth = 0;
+        if( sinput >> fMaxDepth ) {
+            _fHeadlessMaxDepth = fMaxDepth;
+        }
+        _bHeadlessDepth = bHeadlessDepth;
+        return true;
+    }
+    bool _GetPointCloud(ostream& sout, istream& sinput)
+    {
+        std::vector<Vector> vpoints;
+        {
+            std::lock_guard<std::mutex> lock(_mutexdata);
+            _rasterizer.GetPointCloud(vpoints);
+        }
+        for (const Vector& point : vpoints) {
+            sout << point.x << " " << point.y << " " << point.z << " ";
+        }
+        return true;
+    }
 
     virtual void SetTransform(const Transform& trans) override
     {
@@ -384,6 +442,8 @@ public:
         _bRenderGeometry = r->_bRenderGeometry;
         _bRenderData = r->_bRenderData;
         _bPower = r->_bPower;
+        _bHeadlessDepth = r->_bHeadlessDepth;
+        _fHeadlessMaxDepth = r->_fHeadlessMaxDepth;
         _Reset();
     }
 
@@ -398,6 +458,44 @@ public:
     }
 
 protected:
+    /// \brief renders the collision meshes of the visible links with _rasterizer and fills pdata with the depth and a grayscale image of it
+    ///
+    /// \return false if the intrinsics are not set
+    bool _RenderHeadlessDepth(const boost::shared_ptr<CameraSensorData>& pdata)
+    {
+        if( _pgeom->KK.fx <= 0 || _pgeom->KK.fy <= 0 ) {
+            return false;
+        }
+        const Transform tcamerainv = _trans.inverse();
+        std::lock_guard<std::mutex> lock(_mutexdata);
+        _rasterizer.Init(_pgeom->width, _pgeom->height, _pgeom->KK, _pgeom->KK.focal_length > 0 ? _pgeom->KK.focal_length : dReal(0.01));
+        GetEnv()->GetBodies(_vbodiescache);
+        for (const KinBodyPtr& pbody : _vbodiescache) {
+            if( !pbody->IsVisible() ) {
+                continue;
+            }
+            for (const KinBody::LinkPtr& plink : pbody->GetLinks()) {
+                if( !plink->IsVisible() || plink->GetCollisionData().indices.empty() ) {
+                    continue;
+                }
+                _rasterizer.AddTriMesh(plink->GetCollisionData(), tcamerainv*plink->GetTransform());
+            }
+        }
+        _rasterizer.Render();
+
+        _rasterizer.GetDepthImage(pdata->vdepthdata);
+        pdata->vimagedata.resize(3*pdata->vdepthdata.size());
+        const float fInvMaxDepth = 1.0f/(float)_fHeadlessMaxDepth;
+        for(size_t ipixel = 0; ipixel < pdata->vdepthdata.size(); ++ipixel) {
+            const float depth = pdata->vdepthdata[ipixel];
+            const uint8_t value = depth > 0 ? (uint8_t)(255.0f*std::max(0.0f, 1.0f - depth*fInvMaxDepth)) : 0;
+            pdata->vimagedata[3*ipixel+0] = pdata->vimagedata[3*ipixel+1] = pdata->vimagedata[3*ipixel+2] = value;
+        }
+        pdata->__stamp = GetEnv()->GetSimulationTime();
+        pdata->__trans = _trans;
+        return true;
+    }
+
     void _RenderGeometry()
     {
         if( !_bRenderGeometry ) {
@@ -442,10 +540,10 @@ protected:
     }
 
     boost::shared_ptr<CameraGeomData> _pgeom;
-    boost::shared_ptr<CameraSensorData> _pdata;
+    boost::shared_ptr<CameraSensorData> _pdata; ///< published data, never modified once set, protected by _mutexdata
+    SensorDataPool<CameraSensorData> _datapool; ///< buffers the images are rendered into
 
     // more geom stuff
-    vector<uint8_t> _vimagedata;
     RaveVector<float> _vColor;
 
     Transform _trans;
@@ -460,6 +558,10 @@ protected:
 
     bool _bRenderGeometry, _bRenderData;
     bool _bPower;     ///< if true, gather data, otherwise don't
+    bool _bHeadlessDepth; ///< if true, render depth with _rasterizer instead of getting the images from the viewer
+    dReal _fHeadlessMaxDepth; ///< depth mapped to black in the grayscale image of the headless depth
+    DepthRasterizer _rasterizer; ///< protected by _mutexdata
+    std::vector<KinBodyPtr> _vbodiescache;
 
     friend class BaseCameraXMLReader;
 };
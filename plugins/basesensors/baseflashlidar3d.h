@@ -163,7 +163,6 @@ public:
 
         _pgeom.reset(new BaseFlashLidar3DGeom());
         _pdata.reset(new LaserSensorData());
-        _report.reset(new CollisionReport());
 
         _bRenderData = false;
         _bRenderGeometry = true;
@@ -230,16 +229,22 @@ public:
             GetEnv()->GetCollisionChecker()->SetCollisionOptions(CO_Distance);
             Transform t;
 
+            // fill a recycled buffer, nobody else references it so the data mutex is only needed to publish it
+            boost::shared_ptr<LaserSensorData> pdata = _datapool.Acquire();
             {
-                // Lock the data mutex and fill with the range data (get all in one timestep)
-                std::lock_guard<std::mutex> lock(_mutexdata);
+                pdata->positions.resize(1);
+                pdata->ranges.resize(_vscanbodyids.size());
+                pdata->intensity.resize(_vscanbodyids.size());
                 t = GetTransform();
-                _pdata->__trans = t;
-                _pdata->__stamp = GetEnv()->GetSimulationTime();
+                pdata->__trans = t;
+                pdata->__stamp = GetEnv()->GetSimulationTime();
 
                 r.pos = t.trans;
-                _pdata->positions.at(0) = t.trans;
+                pdata->positions.at(0) = t.trans;
 
+                // cast all the beams in one call so that the checker traverses the scene once
+                _vrays.resize(_pgeom->width*_pgeom->height);
+                _vraydirs.resize(_vrays.size());
                 for(int w = 0; w < _pgeom->width; ++w) {
                     for(int h = 0; h < _pgeom->height; ++h) {
                         Vector vdir;
@@ -250,36 +255,47 @@ public:
                         r.dir = _pgeom->max_range*vdir;
 
                         int index = w*_pgeom->height+h;
+                        _vrays[index] = r;
+                        _vraydirs[index] = vdir;
+                    }
+                }
+                GetEnv()->CheckCollisionRays(_vrays, _vreports);
+
+                for(size_t index = 0; index < _vrays.size(); ++index) {
+                    const Vector& vdir = _vraydirs[index];
+                    const CollisionReport& report = _vreports[index];
+                    if( report.IsValid() ) {
+                        pdata->ranges[index] = vdir*report.minDistance;
+                        pdata->intensity[index] = 1;
+                        // store the colliding bodies
+                        for(int icollision = 0; icollision < report.nNumValidCollisions; ++icollision) {
+                            const CollisionPairInfo& cpinfo = report.vCollisionInfos[icollision];
+                            string_view bodyname;
+                            cpinfo.ExtractFirstBodyName(bodyname);
+                            if( bodyname.empty() ) {
+                                cpinfo.ExtractSecondBodyName(bodyname);
+                            }
 
-                        if( GetEnv()->CheckCollision(r, _report)) {
-                            _pdata->ranges[index] = vdir*_report->minDistance;
-                            _pdata->intensity[index] = 1;
-                            // store the colliding bodies
-                            for(int icollision = 0; icollision < _report->nNumValidCollisions; ++icollision) {
-                                const CollisionPairInfo& cpinfo = _report->vCollisionInfos[icollision];
-                                string_view bodyname;
-                                cpinfo.ExtractFirstBodyName(bodyname);
-                                if( bodyname.empty() ) {
-                                    cpinfo.ExtractSecondBodyName(bodyname);
-                                }
-
-                                if( !bodyname.empty() ) {
-                                    KinBodyPtr pbody = GetEnv()->GetKinBody(bodyname);
-                                    if( !!pbody ) {
-                                        _databodyids[index] = pbody->GetEnvironmentBodyIndex();
-                                    }
+                            if( !bodyname.empty() ) {
+                                KinBodyPtr pbody = GetEnv()->GetKinBody(bodyname);
+                                if( !!pbody ) {
+                                    _vscanbodyids[index] = pbody->GetEnvironmentBodyIndex();
                                 }
                             }
                         }
-                        else {
-                            _databodyids[index] = 0;
-                            _pdata->ranges[index] = vdir*_pgeom->max_range;
-                            _pdata->intensity[index] = 0;
-                        }
+                    }
+                    else {
+                        _vscanbodyids[index] = 0;
+                        pdata->ranges[index] = vdir*_pgeom->max_range;
+                        pdata->intensity[index] = 0;
                     }
                 }
 
-                _report->Reset();
+                {
+                    std::lock_guard<std::mutex> lock(_mutexdata);
+                    _databodyids = _vscanbodyids;
+                }
+                _datapool.Publish(_pdata, pdata, _mutexdata);
             }
 
             GetEnv()->GetCollisionChecker()->SetCollisionOptions(0);
@@ -292,12 +308,11 @@ public:
                 vector<int> vindices;
 
                 {
-                    // Lock the data mutex and fill the arrays used for rendering
-                    std::lock_guard<std::mutex> lock(_mutexdata);
-                    N = (int)_pdata->ranges.size();
+                    // pdata is published, so it is not modified anymore
+                    N = (int)pdata->ranges.size();
                     vpoints.resize(N+1);
                     for(int i = 0; i < N; ++i)
-                        vpoints[i] = _pdata->ranges[i] + t.trans;
+                        vpoints[i] = pdata->ranges[i] + t.trans;
                     vpoints[N] = t.trans;
                 }
 
@@ -359,6 +374,20 @@ public:
         return false;
     }
 
+    virtual SensorDataConstPtr GetLatestSensorData(SensorType type)
+    {
+        if( type == ST_Invalid || type == ST_Laser ) {
+            std::lock_guard<std::mutex> lock(_mutexdata);
+            return _pdata;
+        }
+        return SensorDataConstPtr();
+    }
+
+    virtual uint64_t GetSensorDataSequence(SensorType type) const
+    {
+        return ( type == ST_Invalid || type == ST_Laser ) ? _datapool.GetSequence() : 0;
+    }
+
     virtual bool Supports(SensorType type) {
         return type == ST_Laser;
     }
@@ -409,16 +438,14 @@ protected:
         _iKK[2] = -_pgeom->KK.cx / _pgeom->KK.fx;
         _iKK[3] = -_pgeom->KK.cy / _pgeom->KK.fy;
         _listGraphicsHandles.clear();
+        // consumers can still hold the published data, so never clear it in place
+        std::lock_guard<std::mutex> lock(_mutexdata);
+        _pdata.reset(new LaserSensorData());
         _pdata->positions.resize(1);
-        _pdata->ranges.resize(_pgeom->width*_pgeom->height);
-        _pdata->intensity.resize(_pgeom->width*_pgeom->height);
+        _pdata->ranges.resize(_pgeom->width*_pgeom->height, Vector(0,0,0));
+        _pdata->intensity.resize(_pgeom->width*_pgeom->height, 0);
         _databodyids.resize(_pgeom->width*_pgeom->height);
-        FOREACH(it, _pdata->ranges) {
-            *it = Vector(0,0,0);
-        }
-        FOREACH(it, _pdata->intensity) {
-            *it = 0;
-        }
+        _vscanbodyids.resize(_pgeom->width*_pgeom->height);
     }
 
     void _RenderGeometry()
@@ -454,9 +481,13 @@ protected:
     }
 
     boost::shared_ptr<BaseFlashLidar3DGeom> _pgeom;
-    boost::shared_ptr<LaserSensorData> _pdata;
+    boost::shared_ptr<LaserSensorData> _pdata; ///< published data, never modified once set, protected by _mutexdata
+    SensorDataPool<LaserSensorData> _datapool; ///< buffers the scans are written into
     vector<int> _databodyids;     ///< if non 0, for each point in _data, specifies the body that was hit
-    CollisionReportPtr _report;
+    vector<int> _vscanbodyids; ///< bodies hit by the scan in progress, copied to _databodyids when the scan is published
+    std::vector<RAY> _vrays; ///< beams of the current scan
+    std::vector<Vector> _vraydirs; ///< unit direction of every beam of _vrays
+    std::vector<CollisionReport> _vreports; ///< result of every beam of _vrays
     // more geom stuff
     RaveVector<float> _vColor;
     dReal _iKK[4];     // inverse of KK
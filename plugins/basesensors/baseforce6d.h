@@ -144,6 +144,11 @@ public:
         return true;
     }
 
+    virtual bool IsSimulationStepParallelSafe() const override
+    {
+        return true;
+    }
+
     virtual SensorGeometryConstPtr GetSensorGeometry(SensorType type) override
     {
         if(( type == ST_Invalid) ||( type == ST_Force6D) ) {
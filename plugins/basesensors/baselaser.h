@@ -168,7 +168,6 @@ public:
         _pgeom->max_range = 100;
         _fTimeToScan = 0;
         _vColor = RaveVector<float>(0.5f,0.5f,1,1);
-        _report.reset(new CollisionReport());
         _bPower = false;
         _bRenderData = false;
         _bRenderGeometry = true;
@@ -227,28 +226,41 @@ public:
             GetEnv()->GetCollisionChecker()->SetCollisionOptions(CO_Distance);
             Transform t;
 
+            // fill a recycled buffer, nobody else references it so the data mutex is only needed to publish it
+            boost::shared_ptr<LaserSensorData> pdata = _datapool.Acquire();
             {
-                // Lock the data mutex and fill with the range data (get all in one timestep)
-                std::lock_guard<std::mutex> lock(_mutexdata);
-                _pdata->__trans = GetTransform();
-                _pdata->__stamp = GetEnv()->GetSimulationTime();
+                const size_t N = _vscanbodyids.size();
+                pdata->positions.resize(1);
+                pdata->ranges.resize(N);
+                pdata->intensity.resize(N);
+                pdata->__trans = GetTransform();
+                pdata->__stamp = GetEnv()->GetSimulationTime();
                 t = GetLaserPlaneTransform();
-                _pdata->positions.at(0) = t.trans;
-                size_t index = 0;
-                for(dReal frotangle = _pgeom->min_angle[0]; frotangle <= _pgeom->max_angle[0]; frotangle += _pgeom->resolution[0], ++index) {
-                    if( index >= _pdata->ranges.size() ) {
+                pdata->positions.at(0) = t.trans;
+                // cast all the beams in one call so that the checker traverses the scene once
+                _vrays.resize(0);
+                _vraydirs.resize(0);
+                for(dReal frotangle = _pgeom->min_angle[0]; frotangle <= _pgeom->max_angle[0]; frotangle += _pgeom->resolution[0]) {
+                    if( _vrays.size() >= pdata->ranges.size() ) {
                         break;
                     }
                     Vector vdir(t.rotate(quatRotate(quatFromAxisAngle(rotaxis, (dReal)frotangle),Vector(1,0,0))));
                     r.pos = t.trans+_pgeom->min_range*vdir;
                     r.dir = (_pgeom->max_range-_pgeom->min_range)*vdir;
-
-                    if( GetEnv()->CheckCollision(r, _report)) {
-                        _pdata->ranges[index] = vdir*(_report->minDistance+_pgeom->min_range);
-                        _pdata->intensity[index] = 1;
+                    _vrays.push_back(r);
+                    _vraydirs.push_back(vdir);
+                }
+                GetEnv()->CheckCollisionRays(_vrays, _vreports);
+
+                for(size_t index = 0; index < _vrays.size(); ++index) {
+                    const Vector& vdir = _vraydirs[index];
+                    const CollisionReport& report = _vreports[index];
+                    if( report.IsValid() ) {
+                        pdata->ranges[index] = vdir*(report.minDistance+_pgeom->min_range);
+                        pdata->intensity[index] = 1;
                         // store the colliding bodies
-                        for(int icollision = 0; icollision < _report->nNumValidCollisions; ++icollision) {
-                            const CollisionPairInfo& cpinfo = _report->vCollisionInfos[icollision];
+                        for(int icollision = 0; icollision < report.nNumValidCollisions; ++icollision) {
+                            const CollisionPairInfo& cpinfo = report.vCollisionInfos[icollision];
                             string_view bodyname;
                             cpinfo.ExtractFirstBodyName(bodyname);
                             if( bodyname.empty() ) {
@@ -258,17 +270,23 @@ public:
                             if( !bodyname.empty() ) {
                                 KinBodyPtr pbody = GetEnv()->GetKinBody(bodyname);
                                 if( !!pbody ) {
-                                    _databodyids[index] = pbody->GetEnvironmentBodyIndex();
+                                    _vscanbodyids[index] = pbody->GetEnvironmentBodyIndex();
                                 }
                             }
                         }
                     }
                     else {
-                        _databodyids[index] = 0;
-                        _pdata->ranges[index] = vdir*_pgeom->max_range;
-                        _pdata->intensity[index] = 0;
+                        _vscanbodyids[index] = 0;
+                        pdata->ranges[index] = vdir*_pgeom->max_range;
+                        pdata->intensity[index] = 0;
                     }
                 }
+
+                {
+                    std::lock_guard<std::mutex> lock(_mutexdata);
+                    _databodyids = _vscanbodyids;
+                }
+                _datapool.Publish(_pdata, pdata, _mutexdata);
             }
 
             GetEnv()->GetCollisionChecker()->SetCollisionOptions(0);
@@ -281,12 +299,11 @@ public:
                 vector<int> vindices;
 
                 {
-                    // Lock the data mutex and fill the arrays used for rendering
-                    std::lock_guard<std::mutex> lock(_mutexdata);
-                    N = (int)_pdata->ranges.size();
+                    // pdata is published, so it is not modified anymore
+                    N = (int)pdata->ranges.size();
                     vpoints.resize(N+1);
                     for(int i = 0; i < N; ++i) {
-                        vpoints[i] = _pdata->ranges[i] + t.trans;
+                        vpoints[i] = pdata->ranges[i] + t.trans;
                     }
                     vpoints[N] = t.trans;
                 }
@@ -314,8 +331,6 @@ public:
             else {
                 _listGraphicsHandles.clear();
             }
-
-            _report->Reset();
         }
 
         return true;
@@ -349,6 +364,20 @@ public:
         return false;
     }
 
+    virtual SensorDataConstPtr GetLatestSensorData(SensorType type)
+    {
+        if( type == ST_Invalid || type == ST_Laser ) {
+            std::lock_guard<std::mutex> lock(_mutexdata);
+            return _pdata;
+        }
+        return SensorDataConstPtr();
+    }
+
+    virtual uint64_t GetSensorDataSequence(SensorType type) const
+    {
+        return ( type == ST_Invalid || type == ST_Laser ) ? _datapool.GetSequence() : 0;
+    }
+
     virtual bool Supports(SensorType type) {
         return type == ST_Laser;
     }
@@ -412,16 +441,13 @@ protected:
         else {
             N = 1;
         }
+        // consumers can still hold the published data, so never clear it in place
+        _pdata.reset(new LaserSensorData());
         _pdata->positions.resize(1);
-        _pdata->ranges.resize(N);
-        _pdata->intensity.resize(N);
+        _pdata->ranges.resize(N, Vector(0,0,0));
+        _pdata->intensity.resize(N, 0);
         _databodyids.resize(N);
-        FOREACH(it, _pdata->ranges) {
-            *it = Vector(0,0,0);
-        }
-        FOREACH(it, _pdata->intensity) {
-            *it = 0;
-        }
+        _vscanbodyids.resize(N);
         _fTimeToScan = 0;
         _listGraphicsHandles.clear();
         _graphgeometry.reset();
@@ -464,9 +490,13 @@ protected:
     }
 
     boost::shared_ptr<LaserGeomData> _pgeom;
-    boost::shared_ptr<LaserSensorData> _pdata;
+    boost::shared_ptr<LaserSensorData> _pdata; ///< published data, never modified once set, protected by _mutexdata
+    SensorDataPool<LaserSensorData> _datapool; ///< buffers the scans are written into
     vector<int> _databodyids;     ///< if non 0, for each point in _data, specifies the body that was hit
-    CollisionReportPtr _report;
+    vector<int> _vscanbodyids; ///< bodies hit by the scan in progress, copied to _databodyids when the scan is published
+    std::vector<RAY> _vrays; ///< beams of the current scan
+    std::vector<Vector> _vraydirs; ///< unit direction of every beam of _vrays
+    std::vector<CollisionReport> _vreports; ///< result of every beam of _vrays
 
     // more geom stuff
     RaveVector<float> _vColor;
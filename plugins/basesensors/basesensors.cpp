@@ -15,6 +15,7 @@
 #include "basesensors.h"
 
 #include "plugindefs.h"
+#include "sensordatapool.h"
 #include "baselaser.h"
 #include "baseflashlidar3d.h"
 #include "basecamera.h"
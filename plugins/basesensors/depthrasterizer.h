@@ -0,0 +1,213 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2011 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef OPENRAVE_DEPTHRASTERIZER_H
+#define OPENRAVE_DEPTHRASTERIZER_H
+
+/// \brief software z-buffer renderer of triangle meshes for pinhole cameras, used when no viewer is available.
+///
+/// The triangles are first binned to the square tiles of the image that their screen bounding box overlaps, then every tile is rasterized
+/// on its own so that its part of the depth buffer stays in cache. The buffer holds the inverse depth, which is linear in screen space, and
+/// the pixel loops are branchless so that the compiler vectorizes them.
+class DepthRasterizer
+{
+public:
+    DepthRasterizer() : _width(0), _height(0), _numTilesX(0), _numTilesY(0), _fx(0), _fy(0), _cx(0), _cy(0), _fNear(0) {
+    }
+
+    /// \brief sets the image size and the intrinsics, and removes all the triangles
+    ///
+    /// \param fNear triangles are clipped at this distance along the optical axis
+    void Init(int width, int height, const CameraIntrinsics& KK, dReal fNear)
+    {
+        _width = width;
+        _height = height;
+        _numTilesX = (width + s_tileSize - 1)/s_tileSize;
+        _numTilesY = (height + s_tileSize - 1)/s_tileSize;
+        _fx = KK.fx;
+        _fy = KK.fy;
+        _cx = KK.cx;
+        _cy = KK.cy;
+        _fNear = fNear;
+        _vtriangles.resize(0);
+        _vtilebins.resize(_numTilesX*_numTilesY);
+        for (std::vector<int>& vbin : _vtilebins) {
+            vbin.resize(0);
+        }
+    }
+
+    /// \brief adds the triangles of a mesh, tmeshincamera transforms the mesh into the camera frame whose z axis is the optical axis
+    void AddTriMesh(const TriMesh& trimesh, const Transform& tmeshincamera)
+    {
+        _vcamerapoints.resize(trimesh.vertices.size());
+        for(size_t ivertex = 0; ivertex < trimesh.vertices.size(); ++ivertex) {
+            _vcamerapoints[ivertex] = tmeshincamera*trimesh.vertices[ivertex];
+        }
+        for(size_t iindex = 0; iindex+2 < trimesh.indices.size(); iindex += 3) {
+            _AddCameraTriangle(_vcamerapoints[trimesh.indices[iindex]], _vcamerapoints[trimesh.indices[iindex+1]], _vcamerapoints[trimesh.indices[iindex+2]]);
+        }
+    }
+
+    /// \brief rasterizes all the added triangles
+    void Render()
+    {
+        _vinvdepth.resize(_width*_height);
+        std::fill(_vinvdepth.begin(), _vinvdepth.end(), 0.0f);
+        for(int itiley = 0; itiley < _numTilesY; ++itiley) {
+            for(int itilex = 0; itilex < _numTilesX; ++itilex) {
+                const int xmin = itilex*s_tileSize, ymin = itiley*s_tileSize;
+                const int xmax = std::min(xmin + s_tileSize, _width), ymax = std::min(ymin + s_tileSize, _height);
+                for (int itriangle : _vtilebins[itiley*_numTilesX + itilex]) {
+                    _RasterizeTriangle(_vtriangles[itriangle], xmin, ymin, xmax, ymax);
+                }
+            }
+        }
+    }
+
+    /// \brief depth along the optical axis of every pixel in row-major order after Render, 0 where nothing was rendered
+    void GetDepthImage(std::vector<float>& vdepth) const
+    {
+        vdepth.resize(_vinvdepth.size());
+        for(size_t ipixel = 0; ipixel < _vinvdepth.size(); ++ipixel) {
+            vdepth[ipixel] = _vinvdepth[ipixel] > 0 ? 1.0f/_vinvdepth[ipixel] : 0.0f;
+        }
+    }
+
+    /// \brief points in the camera frame of all the rendered pixels after Render
+    void GetPointCloud(std::vector<Vector>& vpoints) const
+    {
+        vpoints.resize(0);
+        for(int y = 0; y < _height; ++y) {
+            for(int x = 0; x < _width; ++x) {
+                const float invdepth = _vinvdepth[y*_width + x];
+                if( invdepth > 0 ) {
+                    const dReal depth = 1/invdepth;
+                    vpoints.push_back(Vector(((dReal)x + 0.5 - _cx)*depth/_fx, ((dReal)y + 0.5 - _cy)*depth/_fy, depth));
+                }
+            }
+        }
+    }
+
+private:
+    /// \brief triangle projected on the image
+    struct ScreenTriangle
+    {
+        float x[3], y[3]; ///< pixel coordinates
+        float invdepth[3]; ///< inverse of the depth of every vertex
+    };
+
+    /// \brief clips the triangle at the near plane and projects the remaining polygon
+    void _AddCameraTriangle(const Vector& p0, const Vector& p1, const Vector& p2)
+    {
+        const Vector vinput[3] = { p0, p1, p2 };
+        Vector vclipped[4];
+        int numclipped = 0;
+        for(int i = 0; i < 3; ++i) {
+            const Vector& pcur = vinput[i];
+            const Vector& pnext = vinput[(i+1)%3];
+            const bool bcurinside = pcur.z >= _fNear, bnextinside = pnext.z >= _fNear;
+            if( bcurinside ) {
+                vclipped[numclipped++] = pcur;
+            }
+            if( bcurinside != bnextinside ) {
+                const dReal t = (_fNear - pcur.z)/(pnext.z - pcur.z);
+                vclipped[numclipped++] = pcur + (pnext - pcur)*t;
+            }
+        }
+        for(int i = 1; i+1 < numclipped; ++i) {
+            _AddScreenTriangle(vclipped[0], vclipped[i], vclipped[i+1]);
+        }
+    }
+
+    void _AddScreenTriangle(const Vector& p0, const Vector& p1, const Vector& p2)
+    {
+        ScreenTriangle triangle;
+        const Vector* vpoints[3] = { &p0, &p1, &p2 };
+        float xmin = 1e30f, ymin = 1e30f, xmax = -1e30f, ymax = -1e30f;
+        for(int i = 0; i < 3; ++i) {
+            const dReal invdepth = 1/vpoints[i]->z;
+            triangle.x[i] = (float)(_fx*vpoints[i]->x*invdepth + _cx);
+            triangle.y[i] = (float)(_fy*vpoints[i]->y*invdepth + _cy);
+            triangle.invdepth[i] = (float)invdepth;
+            xmin = std::min(xmin, triangle.x[i]);
+            xmax = std::max(xmax, triangle.x[i]);
+            ymin = std::min(ymin, triangle.y[i]);
+            ymax = std::max(ymax, triangle.y[i]);
+        }
+        if( xmax < 0 || ymax < 0 || xmin >= (float)_width || ymin >= (float)_height ) {
+            return;
+        }
+
+        const int itriangle = (int)_vtriangles.size();
+        _vtriangles.push_back(triangle);
+        // clamp before converting since the points close to the near plane can project far outside of the image
+        const int itilexmin = (int)std::max(0.0f, xmin)/s_tileSize, itilexmax = (int)std::min((float)(_width - 1), xmax)/s_tileSize;
+        const int itileymin = (int)std::max(0.0f, ymin)/s_tileSize, itileymax = (int)std::min((float)(_height - 1), ymax)/s_tileSize;
+        for(int itiley = itileymin; itiley <= itileymax; ++itiley) {
+            for(int itilex = itilexmin; itilex <= itilexmax; ++itilex) {
+                _vtilebins[itiley*_numTilesX + itilex].push_back(itriangle);
+            }
+        }
+    }
+
+    /// \brief rasterizes the part of the triangle inside [xmin, xmax) x [ymin, ymax) with the pixel centers sampled
+    void _RasterizeTriangle(const ScreenTriangle& triangle, int tilexmin, int tileymin, int tilexmax, int tileymax)
+    {
+        const float area = (triangle.x[1] - triangle.x[0])*(triangle.y[2] - triangle.y[0]) - (triangle.y[1] - triangle.y[0])*(triangle.x[2] - triangle.x[0]);
+        if( std::abs(area) < 1e-12f ) {
+            return;
+        }
+        const float invarea = 1/area;
+
+        // barycentric weight of vertex i is a[i]*px + b[i]*py + c[i], already divided by the area so that the sign does not depend on the winding
+        float a[3], b[3], c[3];
+        for(int i = 0; i < 3; ++i) {
+            const int i1 = (i+1)%3, i2 = (i+2)%3;
+            a[i] = (triangle.y[i1] - triangle.y[i2])*invarea;
+            b[i] = (triangle.x[i2] - triangle.x[i1])*invarea;
+            c[i] = (triangle.x[i1]*triangle.y[i2] - triangle.x[i2]*triangle.y[i1])*invarea;
+        }
+
+        const int xmin = (int)std::max((float)tilexmin, std::floor(std::min(triangle.x[0], std::min(triangle.x[1], triangle.x[2]))));
+        const int xmax = (int)std::min((float)tilexmax, std::ceil(std::max(triangle.x[0], std::max(triangle.x[1], triangle.x[2]))) + 1);
+        const int ymin = (int)std::max((float)tileymin, std::floor(std::min(triangle.y[0], std::min(triangle.y[1], triangle.y[2]))));
+        const int ymax = (int)std::min((float)tileymax, std::ceil(std::max(triangle.y[0], std::max(triangle.y[1], triangle.y[2]))) + 1);
+        for(int y = ymin; y < ymax; ++y) {
+            const float py = (float)y + 0.5f;
+            const float w0row = b[0]*py + c[0], w1row = b[1]*py + c[1], w2row = b[2]*py + c[2];
+            float* pinvdepthrow = &_vinvdepth[y*_width];
+            for(int x = xmin; x < xmax; ++x) {
+                const float px = (float)x + 0.5f;
+                const float w0 = a[0]*px + w0row, w1 = a[1]*px + w1row, w2 = a[2]*px + w2row;
+                const float invdepth = w0*triangle.invdepth[0] + w1*triangle.invdepth[1] + w2*triangle.invdepth[2];
+                const bool bvisible = w0 >= 0 && w1 >= 0 && w2 >= 0 && invdepth > pinvdepthrow[x];
+                pinvdepthrow[x] = bvisible ? invdepth : pinvdepthrow[x];
+            }
+        }
+    }
+
+    static const int s_tileSize = 64;
+
+    int _width, _height;
+    int _numTilesX, _numTilesY;
+    dReal _fx, _fy, _cx, _cy;
+    dReal _fNear;
+    std::vector<ScreenTriangle> _vtriangles;
+    std::vector< std::vector<int> > _vtilebins; ///< for every tile, the indices of the triangles of _vtriangles that can cover it
+    std::vector<Vector> _vcamerapoints; ///< cache
+    std::vector<float> _vinvdepth; ///< inverse depth of every pixel, 0 if empty
+};
+
+#endif
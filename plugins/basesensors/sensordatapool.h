@@ -0,0 +1,71 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2011 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef OPENRAVE_SENSORDATAPOOL_H
+#define OPENRAVE_SENSORDATAPOOL_H
+
+#include <atomic>
+#include <mutex>
+
+/// \brief recycles the sensor data buffers a sensor publishes, so that its vectors keep their capacity from one measurement to the next
+///
+/// The sensor fills a buffer returned by Acquire outside of its data mutex, then publishes it with Publish. Published buffers are never
+/// written again: a buffer is only recycled once the pool holds the last reference to it, that is when it is neither the published buffer
+/// nor held by a consumer of SensorBase::GetLatestSensorData. Acquire and Publish have to be called from the same thread.
+template <typename T>
+class SensorDataPool
+{
+public:
+    SensorDataPool(size_t maxbuffers=4) : _maxbuffers(maxbuffers), _sequence(0) {
+    }
+
+    /// \brief returns a buffer that nobody else references, its vectors hold the data of an older measurement
+    boost::shared_ptr<T> Acquire()
+    {
+        for(size_t ibuffer = 0; ibuffer < _vbuffers.size(); ++ibuffer) {
+            if( _vbuffers[ibuffer].use_count() == 1 ) {
+                return _vbuffers[ibuffer];
+            }
+        }
+        boost::shared_ptr<T> pbuffer(new T());
+        if( _vbuffers.size() < _maxbuffers ) {
+            _vbuffers.push_back(pbuffer);
+        }
+        // otherwise the consumers hold all the buffers, the new one is released when they are done with it
+        return pbuffer;
+    }
+
+    /// \brief sets pbuffer as the published data and increments the sequence, mutex has to protect ppublished
+    void Publish(boost::shared_ptr<T>& ppublished, const boost::shared_ptr<T>& pbuffer, std::mutex& mutex)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ppublished = pbuffer;
+        }
+        _sequence.fetch_add(1, std::memory_order_release);
+    }
+
+    /// \brief number of buffers published so far, can be read from any thread
+    uint64_t GetSequence() const {
+        return _sequence.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector< boost::shared_ptr<T> > _vbuffers;
+    size_t _maxbuffers;
+    std::atomic<uint64_t> _sequence;
+};
+
+#endif
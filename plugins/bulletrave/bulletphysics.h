@@ -16,6 +16,14 @@
 // 2013 Modifications: Theodoros Stouraitis and Praveen Ramanujam
 #include "bulletspace.h"
 
+#include <thread>
+#ifdef BULLETRAVE_HAVE_DYNAMICSWORLDMT
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <LinearMath/btThreads.h>
+#endif
+
 class BulletPhysicsEngine : public PhysicsEngineBase
 {
     class PhysicsFilterCallback : public OpenRAVEFilterCallback
@@ -120,6 +128,24 @@ public:
                     _physics->SetGravity(v);
                 }
             }
+            else if( name == "linear_sleeping_threshold" ) {
+                _ss >> _physics->_defaultdeactivation.linearthreshold;
+            }
+            else if( name == "angular_sleeping_threshold" ) {
+                _ss >> _physics->_defaultdeactivation.angularthreshold;
+            }
+            else if( name == "deactivation_time" ) {
+                _ss >> _physics->_fdeactivationtime;
+            }
+            else if( name == "broadphase" ) {
+                _ss >> _physics->_broadphasetype;
+            }
+            else if( name == "world_aabb" ) {
+                _ss >> _physics->_vworldaabbmin.x >> _physics->_vworldaabbmin.y >> _physics->_vworldaabbmin.z >> _physics->_vworldaabbmax.x >> _physics->_vworldaabbmax.y >> _physics->_vworldaabbmax.z;
+            }
+            else if( name == "numthreads" ) {
+                _ss >> _physics->_numthreads;
+            }
             else {
                 RAVELOG_ERROR("unknown field %s\n", name.c_str());
             }
@@ -142,9 +168,10 @@ public:
             }
         }
 
-        static const boost::array<string, 8>& GetTags() {
-        static const boost::array<string, 8> tags = {{"solver_iterations","margin_depth","linear_damping","rotation_damping",
-        "global_contact_force_mixing","global_friction","global_restitution","gravity" }};
+        static const boost::array<string, 14>& GetTags() {
+        static const boost::array<string, 14> tags = {{"solver_iterations","margin_depth","linear_damping","rotation_damping",
+        "global_contact_force_mixing","global_friction","global_restitution","gravity",
+        "linear_sleeping_threshold","angular_sleeping_threshold","deactivation_time","broadphase","world_aabb","numthreads" }};
             return tags;
         }
 
@@ -166,6 +193,9 @@ public:
 	stringstream ss;        
 	__description = ":Interface Authors: Max Argus, Nick Hillier, Katrina Monkley, Rosen Diankov\n\nInterface to `Bullet Physics Engine <http://bulletphysics.org/>`_\n";
         RegisterCommand("SetStaticBodyTransform",boost::bind(&BulletPhysicsEngine::SetStaticBodyTransform,this,_1,_2),"Sets the transformation of a static body manually, not allowed to use for dynamic bodies and it should be used with caution even for static bodies because it can cause instabilities in physics engine.");
+        RegisterCommand("SetBodyDeactivation",boost::bind(&BulletPhysicsEngine::_SetBodyDeactivationCommand,this,_1,_2),"Sets when a body is put to sleep: \"bodyname linearthreshold angularthreshold\". The body sleeps once its velocities stay below the thresholds for the deactivation time, negative thresholds keep it always active. The body name \"*\" sets the default of all the bodies and can be followed by the deactivation time in seconds, which bullet shares between all the bodies.");
+        RegisterCommand("SetBroadphase",boost::bind(&BulletPhysicsEngine::_SetBroadphaseCommand,this,_1,_2),"Sets the broadphase: \"dbvt\" or \"sap minx miny minz maxx maxy maxz\". Sweep and prune needs the bounds of the world. Reinitializes the simulation.");
+        RegisterCommand("SetNumThreads",boost::bind(&BulletPhysicsEngine::_SetNumThreadsCommand,this,_1,_2),"Sets the number of threads solving the constraints, 0 uses the number of hardware threads. Needs bullet with btDiscreteDynamicsWorldMt. Reinitializes the simulation.");
         _solver_iterations = 5;
         _margin_depth = 0.001;
         _linear_damping = 0.1;
@@ -177,6 +207,12 @@ public:
         
         _super_damp = 0.3; 
         _super_damp2 = 0.9;
+
+        _fdeactivationtime = 2.0;
+        _broadphasetype = "dbvt";
+        _vworldaabbmin = Vector(-10,-10,-10);
+        _vworldaabbmax = Vector(10,10,10);
+        _numthreads = 1;
           
         FOREACHC(it, PhysicsPropertiesXMLReader::GetTags()) {
             ss << "**" << *it << "**, ";
@@ -285,18 +321,52 @@ public:
          RAVELOG_VERBOSE("init bullet physics environment\n");
         _space->SetSynchronizationCallback(boost::bind(&BulletPhysicsEngine::_SyncCallback, shared_physics(),_1));
 
-        _broadphase.reset(new btDbvtBroadphase());
+        gDeactivationTime = _fdeactivationtime;
+        if( _broadphasetype == "sap" ) {
+            // sweep and prune is faster than the dynamic tree when many bodies rest inside known bounds
+            _broadphase.reset(new bt32BitAxisSweep3(BulletSpace::GetBtVector(_vworldaabbmin), BulletSpace::GetBtVector(_vworldaabbmax)));
+        }
+        else {
+            if( _broadphasetype != "dbvt" ) {
+                RAVELOG_WARN_FORMAT("unknown broadphase '%s', using dbvt", _broadphasetype);
+            }
+            _broadphase.reset(new btDbvtBroadphase());
+        }
 
         // allowes configuration of collision detection
         _collisionConfiguration.reset(new btDefaultCollisionConfiguration());
 
         // handels conves and concave collisions
         //_dispatcher = new btOpenraveDispatcher::btOpenraveDispatcher(_collisionConfiguration);
-        _dispatcher.reset(new btCollisionDispatcher(_collisionConfiguration.get()));
-        _solver.reset(new btSequentialImpulseConstraintSolver());
-        
-        // btContinuousDynamicsWorld gives a segfault for some reason
-        _dynamicsWorld.reset(new btDiscreteDynamicsWorld(_dispatcher.get(),_broadphase.get(),_solver.get(),_collisionConfiguration.get()));
+        const int numthreads = _numthreads > 0 ? _numthreads : (int)std::thread::hardware_concurrency();
+#ifdef BULLETRAVE_HAVE_DYNAMICSWORLDMT
+        if( numthreads > 1 ) {
+            // islands are solved concurrently by the task scheduler of bullet, which is process-wide
+            if( !btGetTaskScheduler() || btGetTaskScheduler()->getNumThreads() < numthreads ) {
+                btITaskScheduler* pscheduler = btCreateDefaultTaskScheduler();
+                if( !!pscheduler ) {
+                    pscheduler->setNumThreads(numthreads);
+                    btSetTaskScheduler(pscheduler);
+                }
+            }
+            _dispatcher.reset(new btCollisionDispatcherMt(_collisionConfiguration.get()));
+            _solverpool.reset(new btConstraintSolverPoolMt(numthreads));
+            _solver.reset(new btSequentialImpulseConstraintSolverMt());
+            _dynamicsWorld.reset(new btDiscreteDynamicsWorldMt(_dispatcher.get(),_broadphase.get(),_solverpool.get(),_solver.get(),_collisionConfiguration.get()));
+        }
+        else
+#else
+        if( numthreads > 1 ) {
+            RAVELOG_WARN_FORMAT("bullet was built without btDiscreteDynamicsWorldMt, solving constraints on one thread instead of %d", numthreads);
+        }
+#endif
+        {
+            _dispatcher.reset(new btCollisionDispatcher(_collisionConfiguration.get()));
+            _solver.reset(new btSequentialImpulseConstraintSolver());
+
+            // btContinuousDynamicsWorld gives a segfault for some reason
+            _dynamicsWorld.reset(new btDiscreteDynamicsWorld(_dispatcher.get(),_broadphase.get(),_solver.get(),_collisionConfiguration.get()));
+        }
         
         // Critical point when you introduce the hand in the simulation
         // the PhysicsFilterCallback() is derived from the OpenRAVEFilterCallback which is in the file bulletspace.h
@@ -354,6 +424,9 @@ public:
         _collisionConfiguration.reset();
         _broadphase.reset();
         _solver.reset();
+#ifdef BULLETRAVE_HAVE_DYNAMICSWORLDMT
+        _solverpool.reset();
+#endif
         _dispatcher.reset();
         _report.reset();
         _filterCallback.reset();
@@ -412,6 +485,9 @@ public:
              }
             }
         }
+        if( !!pinfo && !pbody->IsRobot() ) {
+            _ApplyDeactivation(pbody, pinfo);
+        }
         return !!pinfo;
     }
 
@@ -641,16 +717,30 @@ public:
         //_dynamicsWorld->applyGravity();
         _dynamicsWorld->stepSimulation(0.005,maxSubSteps); //-> reduced elapse time
 
-        vector<KinBodyPtr> vbodies;
-        GetEnv()->GetBodies(vbodies);
-        FOREACHC(itbody, vbodies) {
+        // write the transforms back only for the bodies bullet moved, one batch per body
+        GetEnv()->GetBodies(_vbodiescache);
+        FOREACHC(itbody, _vbodiescache) {
             BulletSpace::KinBodyInfoPtr pinfo = GetPhysicsInfo(*itbody);
-            FOREACH(itlink, pinfo->vlinks) {
-                Transform t = BulletSpace::GetTransform((*itlink)->_rigidbody->getCenterOfMassTransform());
-                (*itlink)->plink->SetTransform(t*(*itlink)->tlocal.inverse());
+            bool bMoved = false;
+            FOREACHC(itlink, pinfo->vlinks) {
+                if( (*itlink)->bMoved ) {
+                    bMoved = true;
+                    break;
+                }
+            }
+            if( !bMoved ) {
+                continue;
+            }
+            _vtranscache.resize(pinfo->vlinks.size());
+            for(size_t ilink = 0; ilink < pinfo->vlinks.size(); ++ilink) {
+                BulletSpace::KinBodyInfo::LINK& link = *pinfo->vlinks[ilink];
+                _vtranscache[ilink] = BulletSpace::GetTransform(link._rigidbody->getCenterOfMassTransform())*link.tlocal.inverse();
+                link.bMoved = false;
             }
+            (*itbody)->SetLinkTransformations(_vtranscache);
             pinfo->nLastStamp = (*itbody)->GetUpdateStamp();
         }
+        _vbodiescache.clear();
         //_dynamicsWorld->clearForces();
     }
 
@@ -666,12 +756,134 @@ public:
     btScalar _super_damp;
     btScalar _super_damp2;
 
+    Deactivation _defaultdeactivation;
+    std::map<std::string, Deactivation> _mapbodydeactivation; ///< body name -> deactivation overriding _defaultdeactivation
+    btScalar _fdeactivationtime; ///< seconds the velocities of a body have to stay below its thresholds before it sleeps
+    std::string _broadphasetype; ///< dbvt or sap
+    Vector _vworldaabbmin, _vworldaabbmax; ///< bounds of the sweep and prune broadphase
+    int _numthreads; ///< threads solving the constraints, 0 uses the number of hardware threads
+
 private:
+    std::vector<KinBodyPtr> _vbodiescache; ///< cache
+    std::vector<Transform> _vtranscache; ///< cache
+
     static BulletSpace::KinBodyInfoPtr GetPhysicsInfo(KinBodyConstPtr pbody)
     {
         return boost::dynamic_pointer_cast<BulletSpace::KinBodyInfo>(pbody->GetUserData("bulletphysics"));
     }
 
+    /// \brief sleeping thresholds of a body, see the SetBodyDeactivation command
+    struct Deactivation
+    {
+        Deactivation() : linearthreshold(0.8), angularthreshold(1.0) {
+        }
+        btScalar linearthreshold, angularthreshold; ///< negative keeps the body always active
+    };
+
+    void _ApplyDeactivation(KinBodyPtr pbody, BulletSpace::KinBodyInfoPtr pinfo)
+    {
+        std::map<std::string, Deactivation>::const_iterator it = _mapbodydeactivation.find(pbody->GetName());
+        const Deactivation& deactivation = it != _mapbodydeactivation.end() ? it->second : _defaultdeactivation;
+        FOREACH(itlink, pinfo->vlinks) {
+            const boost::shared_ptr<btRigidBody>& rigidbody = (*itlink)->_rigidbody;
+            if( !rigidbody || (*itlink)->plink->IsStatic() ) {
+                continue;
+            }
+            if( deactivation.linearthreshold < 0 || deactivation.angularthreshold < 0 ) {
+                rigidbody->forceActivationState(DISABLE_DEACTIVATION);
+            }
+            else {
+                if( rigidbody->getActivationState() == DISABLE_DEACTIVATION ) {
+                    rigidbody->forceActivationState(ACTIVE_TAG);
+                }
+                rigidbody->setSleepingThresholds(deactivation.linearthreshold, deactivation.angularthreshold);
+                rigidbody->setDeactivationTime(0);
+            }
+        }
+    }
+
+    bool _SetBodyDeactivationCommand(ostream& sout, istream& sinput)
+    {
+        std::string bodyname;
+        Deactivation deactivation;
+        sinput >> bodyname >> deactivation.linearthreshold >> deactivation.angularthreshold;
+        if( !sinput ) {
+            return false;
+        }
+        if( bodyname == "*" ) {
+            btScalar time = 0;
+            if( sinput >> time ) {
+                _fdeactivationtime = time;
+                gDeactivationTime = time;
+            }
+            _defaultdeactivation = deactivation;
+            _mapbodydeactivation.clear();
+        }
+        else {
+            _mapbodydeactivation[bodyname] = deactivation;
+        }
+        if( !!_dynamicsWorld ) {
+            vector<KinBodyPtr> vbodies;
+            GetEnv()->GetBodies(vbodies);
+            FOREACHC(itbody, vbodies) {
+                if( !(*itbody)->IsRobot() && (bodyname == "*" || (*itbody)->GetName() == bodyname) ) {
+                    BulletSpace::KinBodyInfoPtr pinfo = GetPhysicsInfo(*itbody);
+                    if( !!pinfo ) {
+                        _ApplyDeactivation(*itbody, pinfo);
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    bool _SetBroadphaseCommand(ostream& sout, istream& sinput)
+    {
+        std::string broadphasetype;
+        sinput >> broadphasetype;
+        if( !sinput ) {
+            return false;
+        }
+        if( broadphasetype == "sap" ) {
+            Vector vmin, vmax;
+            sinput >> vmin.x >> vmin.y >> vmin.z >> vmax.x >> vmax.y >> vmax.z;
+            if( !sinput ) {
+                RAVELOG_WARN("sap broadphase needs the world bounds\n");
+                return false;
+            }
+            _vworldaabbmin = vmin;
+            _vworldaabbmax = vmax;
+        }
+        else if( broadphasetype != "dbvt" ) {
+            return false;
+        }
+        _broadphasetype = broadphasetype;
+        _Reinitialize();
+        return true;
+    }
+
+    bool _SetNumThreadsCommand(ostream& sout, istream& sinput)
+    {
+        int numthreads = 1;
+        sinput >> numthreads;
+        if( !sinput || numthreads < 0 ) {
+            return false;
+        }
+        _numthreads = numthreads;
+        _Reinitialize();
+        return true;
+    }
+
+    /// \brief recreates the world with the current broadphase and threads if the environment is initialized
+    void _Reinitialize()
+    {
+        if( !_dynamicsWorld ) {
+            return;
+        }
+        DestroyEnvironment();
+        InitEnvironment();
+    }
+
     void _SyncCallback(BulletSpace::KinBodyInfoConstPtr pinfo)
     {
         // reset dynamics
@@ -690,6 +902,9 @@ private:
     boost::shared_ptr<btBroadphaseInterface> _broadphase;
     boost::shared_ptr<btCollisionDispatcher> _dispatcher;
     boost::shared_ptr<btConstraintSolver> _solver;
+#ifdef BULLETRAVE_HAVE_DYNAMICSWORLDMT
+    boost::shared_ptr<btConstraintSolverPoolMt> _solverpool;
+#endif
     boost::shared_ptr<btOverlapFilterCallback> _filterCallback;
 
     std::list<EnvironmentBase::CollisionCallbackFn> _listcallbacks;
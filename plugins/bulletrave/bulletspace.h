@@ -49,6 +49,8 @@ public:
         class LINK : public btMotionState
         {
 public:
+            LINK() : bMoved(false) {
+            }
             virtual ~LINK() {
             }
 
@@ -58,11 +60,10 @@ public:
                 centerOfMassWorldTrans = GetBtTransform(plink->GetTransform()*tlocal);
             }
 
+            /// \brief called by bullet for the active bodies only, the link transforms of a body are written back in one batch after the step
             virtual void setWorldTransform(const btTransform& centerOfMassWorldTrans)
             {
-                //m_graphicsWorldTrans = centerOfMassWorldTrans * m_centerOfMassOffset;
-                //RAVELOG_INFO(plink->GetName()); //This info is eats up the terminal
-                plink->SetTransform(GetTransform(centerOfMassWorldTrans)*tlocal.inverse());
+                bMoved = true;
             }
 
             boost::shared_ptr<btCollisionObject> obj;
@@ -73,6 +74,7 @@ public:
 
             KinBody::LinkPtr plink;
             Transform tlocal;     /// local offset transform to account for inertias not aligned to axes
+            bool bMoved; ///< true if the simulation moved the body since its transform was last written to plink
         };
 
         KinBodyInfo(boost::shared_ptr<btCollisionWorld> world, bool bPhysics) : _world(world), _bPhysics(bPhysics) {
@@ -441,13 +443,18 @@ private:
 
     void _Synchronize(KinBodyInfoPtr pinfo)
     {
-        vector<Transform> vtrans;
-        std::vector<int> dofbranches;
-        pinfo->pbody->GetLinkTransformations(vtrans,dofbranches);
+        pinfo->pbody->GetLinkTransformations(_vtranscache);
         pinfo->nLastStamp = pinfo->pbody->GetUpdateStamp();
-        BOOST_ASSERT( vtrans.size() == pinfo->vlinks.size() );
-        for(size_t i = 0; i < vtrans.size(); ++i) {
-            pinfo->vlinks[i]->obj->getWorldTransform() = GetBtTransform(vtrans[i]*pinfo->vlinks[i]->tlocal);
+        BOOST_ASSERT( _vtranscache.size() == pinfo->vlinks.size() );
+        for(size_t i = 0; i < _vtranscache.size(); ++i) {
+            // only touch the links that moved so that sleeping bodies stay asleep
+            const btTransform t = GetBtTransform(_vtranscache[i]*pinfo->vlinks[i]->tlocal);
+            btTransform& tworld = pinfo->vlinks[i]->obj->getWorldTransform();
+            if( tworld == t ) {
+                continue;
+            }
+            tworld = t;
+            pinfo->vlinks[i]->obj->activate();
         }
         if( !!_synccallback ) {
             _synccallback(pinfo);
@@ -473,6 +480,7 @@ private:
     boost::shared_ptr<btDiscreteDynamicsWorld> _worlddynamics;
     SynchronizeCallbackFn _synccallback;
     bool _bPhysics;
+    std::vector<Transform> _vtranscache; ///< cache
 };
 
 static KinBody::LinkPtr GetLinkFromCollision(const btCollisionObject* co) {
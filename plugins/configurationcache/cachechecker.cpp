@@ -50,6 +50,10 @@ public:
                         "save self collision cache");
         RegisterCommand("LoadCache",boost::bind(&CacheCollisionChecker::_LoadCacheCommand,this,_1,_2),
                         "load self collision cache");
+        RegisterCommand("SaveEnvCache",boost::bind(&CacheCollisionChecker::_SaveEnvCacheCommand,this,_1,_2),
+                        "save the environment collision cache to a binary file keyed by the robot and static environment hashes. [filename], by default envcache.robothash in the database directory");
+        RegisterCommand("LoadEnvCache",boost::bind(&CacheCollisionChecker::_LoadEnvCacheCommand,this,_1,_2),
+                        "load the environment collision cache if the robot and static environment hashes match. [filename], by default envcache.robothash in the database directory. outputs 1 if loaded");
         RegisterCommand("GetCacheTimes",boost::bind(&CacheCollisionChecker::_GetCacheTimesCommand,this,_1,_2),
                         "get the cache times: insert, query, collision checking, load");
         std::string collisionname="ode";
@@ -420,6 +424,18 @@ protected:
             __cachehash = "";
         }
 
+        // warm start the environment cache if it was saved with the same robot and static environment
+        if( !!_cache && _cache->GetNumNodes() == 0 ) {
+            std::string envcachefilename = RaveFindDatabaseFile(_GetEnvCacheFilename(), true);
+            if( envcachefilename.size() > 0 ) {
+                _stime = utils::GetMilliTime();
+                if( _cache->LoadCacheFile(envcachefilename) ) {
+                    _loadtime = utils::GetMilliTime()-_stime;
+                    RAVELOG_DEBUG_FORMAT("Loaded %d environment cache configurations in %d ms from %s", _cache->GetNumKnownNodes()%_loadtime%envcachefilename);
+                }
+            }
+        }
+
         RAVELOG_DEBUG_FORMAT("Now tracking robot %s", bodyname);
 
         _cachedcollisionchecks=0;
@@ -587,6 +603,36 @@ protected:
         return true;
     }
 
+    virtual bool _SaveEnvCacheCommand(std::ostream& sout, std::istream& sinput)
+    {
+        std::string filename;
+        sinput >> filename;
+        if( filename.size() == 0 ) {
+            filename = RaveFindDatabaseFile(_GetEnvCacheFilename(), false);
+        }
+        return !!_cache && _cache->SaveCacheFile(filename);
+    }
+
+    virtual bool _LoadEnvCacheCommand(std::ostream& sout, std::istream& sinput)
+    {
+        std::string filename;
+        sinput >> filename;
+        if( filename.size() == 0 ) {
+            filename = RaveFindDatabaseFile(_GetEnvCacheFilename(), true);
+        }
+        if( !_cache ) {
+            return false;
+        }
+        sout << (filename.size() > 0 && _cache->LoadCacheFile(filename));
+        return true;
+    }
+
+    /// \brief the database file name of the environment cache, the static environment hash is checked inside the file
+    std::string _GetEnvCacheFilename()
+    {
+        return std::string("envcache.") + _cache->ComputeRobotHash();
+    }
+
     RobotBasePtr GetRobot()
     {
         if( !_probot && _strRobotName.size() > 0 ) {
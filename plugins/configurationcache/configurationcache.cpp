@@ -17,6 +17,7 @@
 namespace configurationcache
 {
 OpenRAVE::CollisionCheckerBasePtr CreateCacheCollisionChecker(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
+OpenRAVE::CollisionCheckerBasePtr CreateTieredCollisionChecker(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
 OpenRAVE::SpaceSamplerBasePtr CreateConfigurationJitterer(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
 OpenRAVE::SpaceSamplerBasePtr CreateWorkspaceConfigurationJitterer(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
 }
@@ -26,6 +27,7 @@ const std::string ConfigurationCachePlugin::_pluginname = "ConfigurationCachePlu
 ConfigurationCachePlugin::ConfigurationCachePlugin()
 {
     _interfaces[OpenRAVE::PT_CollisionChecker].push_back("CacheChecker");
+    _interfaces[OpenRAVE::PT_CollisionChecker].push_back("TieredChecker");
     _interfaces[OpenRAVE::PT_SpaceSampler].push_back("ConfigurationJitterer");
     _interfaces[OpenRAVE::PT_SpaceSampler].push_back("WorkspaceConfigurationJitterer");
 }
@@ -39,6 +41,9 @@ OpenRAVE::InterfaceBasePtr ConfigurationCachePlugin::CreateInterface(OpenRAVE::I
         if( interfacename == "cachechecker") {
             return configurationcache::CreateCacheCollisionChecker(penv,sinput);
         }
+        if( interfacename == "tieredchecker") {
+            return configurationcache::CreateTieredCollisionChecker(penv,sinput);
+        }
         break;
     case OpenRAVE::PT_SpaceSampler:
         if( interfacename == "configurationjitterer" ) {
@@ -17,7 +17,10 @@
 #include <boost/lexical_cast.hpp>
 
 #include <boost/multi_array.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <algorithm>
+#include <fstream>
 
 using boost::multi_array;
 using boost::extents;
@@ -28,6 +31,48 @@ inline dReal Sqr(dReal x) {
     return x*x;
 }
 
+static const uint64_t s_CacheFileMagic = 0x45455254454843ULL; ///< "CHETREE"
+static const uint32_t s_CacheFileVersion = 1;
+
+/// \brief header of the files written by CacheTree::SaveCacheFile. It is followed by the weights, the node records, the child indices and the colliding body names.
+struct CacheFileHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t realsize; ///< sizeof(dReal)
+    int32_t statedof;
+    int32_t numnodes;
+    int32_t maxlevel, minlevel;
+    uint32_t numchildindices;
+    uint32_t numbodynames;
+    dReal base, maxdistance;
+    char robothash[64]; ///< zero padded
+    char envhash[64]; ///< zero padded
+};
+
+/// \brief fixed-size record of a node in the cache file, followed by statedof state values
+struct CacheFileNodeRecord
+{
+    int32_t level;
+    int32_t conftype;
+    int32_t robotlinkindex;
+    int32_t collidingbodyindex; ///< index into the colliding body names, -1 if not in collision
+    int32_t collidinglinkindex;
+    uint32_t childoffset; ///< index of the first child in the child indices
+    uint32_t numchildren;
+    uint8_t hasselfchild;
+    uint8_t usenn;
+    uint8_t hasaabb;
+    uint8_t padding;
+    dReal aabb[6]; ///< pos and extents
+};
+
+static void _CopyHashToHeader(char* pdest, const std::string& hash)
+{
+    std::fill(pdest, pdest+64, 0);
+    std::copy(hash.begin(), hash.begin()+std::min(hash.size(), (size_t)63), pdest);
+}
+
 CacheTreeNode::CacheTreeNode(const std::vector<dReal>& cs, Vector* plinkspheres)
 {
     std::copy(cs.begin(), cs.end(), _pcstate);
@@ -42,6 +87,7 @@ CacheTreeNode::CacheTreeNode(const std::vector<dReal>& cs, Vector* plinkspheres)
     _hasselfchild = 0;
     _usenn = 1;
     _hitcount = 0;
+    _aabb.extents.x = -1;
 }
 
 CacheTreeNode::CacheTreeNode(const dReal* pstate, int dof, Vector* plinkspheres)
@@ -54,6 +100,7 @@ CacheTreeNode::CacheTreeNode(const dReal* pstate, int dof, Vector* plinkspheres)
     _hasselfchild = 0;
     _usenn = 1;
     _hitcount = 0;
+    _aabb.extents.x = -1;
 }
 
 void CacheTreeNode::SetCollisionInfo(RobotBase& robot, CollisionReportPtr& report)
@@ -134,6 +181,7 @@ CacheTree::CacheTree(RobotBasePtr& pstaterobot, int statedof)
 
     _statedof=statedof;
     _weights.resize(_statedof, 1.0);
+    _bComputeAABBs = false;
 
     _pstaterobot = pstaterobot;
     Init(_weights, 1);
@@ -210,6 +258,20 @@ CacheTreeNodePtr CacheTree::_CreateCacheTreeNode(const std::vector<dReal>& cs, C
     newnode->id = s_CacheTreeId++;
 #endif
     newnode->SetCollisionInfo(*_pstaterobot, report);
+    if( _bComputeAABBs ) {
+        AABB ab = _pstaterobot->ComputeAABB(true);
+        Vector vmin = ab.pos - ab.extents, vmax = ab.pos + ab.extents;
+        _pstaterobot->GetGrabbed(_vgrabbedbodies);
+        FOREACHC(itgrabbed, _vgrabbedbodies) {
+            AABB abgrabbed = (*itgrabbed)->ComputeAABB(true);
+            for(int i = 0; i < 3; ++i) {
+                vmin[i] = std::min(vmin[i], abgrabbed.pos[i] - abgrabbed.extents[i]);
+                vmax[i] = std::max(vmax[i], abgrabbed.pos[i] + abgrabbed.extents[i]);
+            }
+        }
+        newnode->_aabb.pos = (vmin + vmax)*0.5;
+        newnode->_aabb.extents = (vmax - vmin)*0.5;
+    }
     return newnode;
 }
 
@@ -228,6 +290,7 @@ CacheTreeNodePtr CacheTree::_CloneCacheTreeNode(CacheTreeNodeConstPtr refnode)
 #endif
     clonenode->_conftype = refnode->_conftype;
     clonenode->_hitcount = refnode->_hitcount;
+    clonenode->_aabb = refnode->_aabb;
     if( clonenode->IsInCollision() ) {
         clonenode->_collidinglink = refnode->_collidinglink;
         //clonenode->_collidinglinktrans = refnode->_collidinglinktrans;
@@ -916,6 +979,7 @@ int CacheTree::LoadCache(std::string filename, EnvironmentBasePtr penv)
 
     for(int i = 0; i < _numnodes; ++i) {
         _vnodes[i] = _CreateCacheTreeNode(_dummycs, CollisionReportPtr());
+        _vnodes[i]->_aabb.extents.x = -1; // robot is not at the loaded configuration
     }
 
     for (int inode = 0; inode < _numnodes; ++inode)
@@ -967,6 +1031,255 @@ int CacheTree::LoadCache(std::string filename, EnvironmentBasePtr penv)
     return 1;
 }
 
+int CacheTree::SaveCacheFile(const std::string& filename, const std::string& robothash, const std::string& envhash)
+{
+    _mapNodeIndices.clear();
+    int index=0;
+    uint32_t numchildindices = 0;
+    FOREACH(itlevelnodes, _vsetLevelNodes) {
+        FOREACH(itnode, *itlevelnodes) {
+            _mapNodeIndices[*itnode] = index++;
+            numchildindices += (*itnode)->_vchildren.size();
+        }
+    }
+
+    std::vector<std::string> vbodynames;
+    std::map<std::string, int> mapbodyindices;
+    std::vector<uint8_t> vnodedata(index*(sizeof(CacheFileNodeRecord)+sizeof(dReal)*_statedof));
+    std::vector<uint32_t> vchildindices; vchildindices.reserve(numchildindices);
+    uint8_t* pnodedata = vnodedata.empty() ? NULL : &vnodedata[0];
+    FOREACH(itlevelnodes, _vsetLevelNodes) {
+        FOREACH(itnode, *itlevelnodes) {
+            CacheTreeNodePtr pnode = *itnode;
+            CacheFileNodeRecord record;
+            memset(&record, 0, sizeof(record));
+            record.level = pnode->_level;
+            record.conftype = pnode->_conftype;
+            record.robotlinkindex = pnode->_robotlinkindex;
+            record.collidingbodyindex = -1;
+            record.collidinglinkindex = -1;
+            if( pnode->_conftype == CNT_Collision && !!pnode->_collidinglink ) {
+                // note, this assumes the colliding body name does not change across environments
+                const std::string& bodyname = pnode->_collidinglink->GetParent()->GetName();
+                std::map<std::string, int>::iterator itbody = mapbodyindices.find(bodyname);
+                if( itbody == mapbodyindices.end() ) {
+                    itbody = mapbodyindices.insert(std::make_pair(bodyname, (int)vbodynames.size())).first;
+                    vbodynames.push_back(bodyname);
+                }
+                record.collidingbodyindex = itbody->second;
+                record.collidinglinkindex = pnode->_collidinglink->GetIndex();
+            }
+            record.childoffset = vchildindices.size();
+            record.numchildren = pnode->_vchildren.size();
+            record.hasselfchild = pnode->_hasselfchild;
+            record.usenn = pnode->_usenn;
+            record.hasaabb = pnode->HasAABB();
+            for(int j = 0; j < 3; ++j) {
+                record.aabb[j] = pnode->_aabb.pos[j];
+                record.aabb[3+j] = pnode->_aabb.extents[j];
+            }
+            FOREACHC(itchild, pnode->_vchildren) {
+                vchildindices.push_back(_mapNodeIndices[*itchild]);
+            }
+            memcpy(pnodedata, &record, sizeof(record));
+            memcpy(pnodedata+sizeof(record), pnode->GetConfigurationState(), sizeof(dReal)*_statedof);
+            pnodedata += sizeof(record)+sizeof(dReal)*_statedof;
+        }
+    }
+
+    CacheFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = s_CacheFileMagic;
+    header.version = s_CacheFileVersion;
+    header.realsize = sizeof(dReal);
+    header.statedof = _statedof;
+    header.numnodes = index;
+    header.maxlevel = _maxlevel;
+    header.minlevel = _minlevel;
+    header.numchildindices = vchildindices.size();
+    header.numbodynames = vbodynames.size();
+    header.base = _base;
+    header.maxdistance = _maxdistance;
+    _CopyHashToHeader(header.robothash, robothash);
+    _CopyHashToHeader(header.envhash, envhash);
+
+    std::ofstream f(filename.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    if( !f ) {
+        RAVELOG_WARN_FORMAT("failed to open cache file %s for writing", filename);
+        return 0;
+    }
+    f.write((const char*)&header, sizeof(header));
+    f.write((const char*)&_weights[0], sizeof(dReal)*_weights.size());
+    if( vnodedata.size() > 0 ) {
+        f.write((const char*)&vnodedata[0], vnodedata.size());
+    }
+    if( vchildindices.size() > 0 ) {
+        f.write((const char*)&vchildindices[0], sizeof(uint32_t)*vchildindices.size());
+    }
+    FOREACHC(itname, vbodynames) {
+        uint32_t namelength = itname->size();
+        f.write((const char*)&namelength, sizeof(namelength));
+        f.write(itname->c_str(), namelength);
+    }
+    if( !f ) {
+        RAVELOG_WARN_FORMAT("failed to write cache file %s", filename);
+        return 0;
+    }
+    RAVELOG_DEBUG_FORMAT("wrote %d cache nodes to %s", index%filename);
+    return 1;
+}
+
+int CacheTree::LoadCacheFile(const std::string& filename, const std::string& robothash, const std::string& envhash, EnvironmentBasePtr penv)
+{
+    boost::interprocess::mapped_region region;
+    try {
+        boost::interprocess::file_mapping mapping(filename.c_str(), boost::interprocess::read_only);
+        boost::interprocess::mapped_region(mapping, boost::interprocess::read_only).swap(region);
+    }
+    catch(const boost::interprocess::interprocess_exception& ex) {
+        RAVELOG_VERBOSE_FORMAT("cannot map cache file %s: %s", filename%ex.what());
+        return 0;
+    }
+
+    const uint8_t* pdata = (const uint8_t*)region.get_address();
+    const uint8_t* pend = pdata + region.get_size();
+    if( region.get_size() < sizeof(CacheFileHeader) ) {
+        RAVELOG_WARN_FORMAT("cache file %s is too small", filename);
+        return 0;
+    }
+    CacheFileHeader header;
+    memcpy(&header, pdata, sizeof(header));
+    pdata += sizeof(header);
+    if( header.magic != s_CacheFileMagic || header.version != s_CacheFileVersion || header.realsize != sizeof(dReal) ) {
+        RAVELOG_WARN_FORMAT("cache file %s has an unsupported format", filename);
+        return 0;
+    }
+    header.robothash[63] = 0;
+    header.envhash[63] = 0;
+    if( robothash != header.robothash || envhash != header.envhash ) {
+        RAVELOG_DEBUG_FORMAT("cache file %s was saved for a different robot or environment, ignoring", filename);
+        return 0;
+    }
+    if( header.statedof != _statedof || header.numnodes < 0 ) {
+        RAVELOG_WARN_FORMAT("cache file %s has %d dof, expected %d", filename%header.statedof%_statedof);
+        return 0;
+    }
+    if( header.maxlevel < header.minlevel ) {
+        RAVELOG_WARN_FORMAT("cache file %s has maxlevel %d less than minlevel %d", filename%header.maxlevel%header.minlevel);
+        return 0;
+    }
+
+    const size_t noderecordsize = sizeof(CacheFileNodeRecord)+sizeof(dReal)*_statedof;
+    const size_t numfixedbytes = sizeof(dReal)*_statedof + noderecordsize*header.numnodes + sizeof(uint32_t)*header.numchildindices;
+    if( (size_t)(pend - pdata) < numfixedbytes ) {
+        RAVELOG_WARN_FORMAT("cache file %s is truncated", filename);
+        return 0;
+    }
+
+    const uint8_t* pnoderecords = pdata + sizeof(dReal)*_statedof;
+    const uint8_t* pchildindices = pnoderecords + noderecordsize*header.numnodes;
+    for(int inode = 0; inode < header.numnodes; ++inode) {
+        CacheFileNodeRecord record;
+        memcpy(&record, pnoderecords + noderecordsize*inode, sizeof(record));
+        bool bvalid = record.childoffset + (uint64_t)record.numchildren <= header.numchildindices;
+        for(uint32_t ichild = 0; bvalid && ichild < record.numchildren; ++ichild) {
+            uint32_t childindex;
+            memcpy(&childindex, pchildindices + sizeof(uint32_t)*(record.childoffset+ichild), sizeof(childindex));
+            bvalid = childindex < (uint32_t)header.numnodes;
+        }
+        if( !bvalid || record.level < header.minlevel || record.level > header.maxlevel ) {
+            RAVELOG_WARN_FORMAT("cache file %s has invalid node %d", filename%inode);
+            return 0;
+        }
+    }
+
+    // read the body names first so that the colliding links can be resolved while creating the nodes
+    const uint8_t* pnames = pdata + numfixedbytes;
+    std::vector<KinBodyPtr> vbodies(header.numbodynames);
+    std::string bodyname;
+    for(uint32_t ibody = 0; ibody < header.numbodynames; ++ibody) {
+        uint32_t namelength;
+        if( pend - pnames < (ptrdiff_t)sizeof(namelength) ) {
+            RAVELOG_WARN_FORMAT("cache file %s is truncated", filename);
+            return 0;
+        }
+        memcpy(&namelength, pnames, sizeof(namelength));
+        pnames += sizeof(namelength);
+        if( pend - pnames < (ptrdiff_t)namelength ) {
+            RAVELOG_WARN_FORMAT("cache file %s is truncated", filename);
+            return 0;
+        }
+        bodyname.assign((const char*)pnames, namelength);
+        pnames += namelength;
+        vbodies[ibody] = penv->GetKinBody(bodyname);
+        if( !vbodies[ibody] ) {
+            RAVELOG_WARN_FORMAT("loading cache expected colliding body %s, but none found", bodyname);
+        }
+    }
+
+    Reset();
+    _weights.resize(_statedof);
+    memcpy(&_weights[0], pdata, sizeof(dReal)*_statedof);
+    _curconf.resize(_statedof, 1.0);
+    _base = header.base;
+    _fBaseInv = 1/_base;
+    _fBaseInv2 = 1/Sqr(_base);
+    _fBaseChildMult = 1/(_base-1);
+    _maxdistance = header.maxdistance;
+    _maxlevel = header.maxlevel;
+    _minlevel = header.minlevel;
+    _fMaxLevelBound = RavePow(_base, _maxlevel);
+    _vsetLevelNodes.resize(max(_EncodeLevel(_maxlevel), _EncodeLevel(_minlevel))+1);
+
+    _vnodes.resize(header.numnodes);
+    for(int inode = 0; inode < header.numnodes; ++inode) {
+        void* pmemory = _poolNodes->malloc();
+        _vnodes[inode] = new (pmemory) CacheTreeNode((const dReal*)NULL, 0, NULL);
+        // the state values follow the record
+        memcpy(_vnodes[inode]->_pcstate, pnoderecords + noderecordsize*inode + sizeof(CacheFileNodeRecord), sizeof(dReal)*_statedof);
+    }
+    int numinvalid = 0;
+    for(int inode = 0; inode < header.numnodes; ++inode) {
+        CacheFileNodeRecord record;
+        memcpy(&record, pnoderecords + noderecordsize*inode, sizeof(record));
+        CacheTreeNodePtr pnode = _vnodes[inode];
+        pnode->_level = record.level;
+        pnode->_conftype = (ConfigurationNodeType)record.conftype;
+        pnode->_robotlinkindex = record.robotlinkindex;
+        pnode->_hasselfchild = record.hasselfchild;
+        pnode->_usenn = record.usenn;
+        if( record.hasaabb ) {
+            pnode->_aabb.pos = Vector(record.aabb[0], record.aabb[1], record.aabb[2]);
+            pnode->_aabb.extents = Vector(record.aabb[3], record.aabb[4], record.aabb[5]);
+        }
+        if( pnode->_conftype == CNT_Collision ) {
+            KinBodyPtr pcollidingbody;
+            if( record.collidingbodyindex >= 0 && record.collidingbodyindex < (int)vbodies.size() ) {
+                pcollidingbody = vbodies[record.collidingbodyindex];
+            }
+            if( !!pcollidingbody && record.collidinglinkindex >= 0 && record.collidinglinkindex < (int)pcollidingbody->GetLinks().size() ) {
+                pnode->_collidinglink = pcollidingbody->GetLinks()[record.collidinglinkindex];
+            }
+            else {
+                // cannot be invalidated when the body changes, so do not trust it
+                pnode->SetType(CNT_Unknown);
+                ++numinvalid;
+            }
+        }
+        pnode->_vchildren.resize(record.numchildren);
+        for(uint32_t ichild = 0; ichild < record.numchildren; ++ichild) {
+            uint32_t childindex;
+            memcpy(&childindex, pchildindices + sizeof(uint32_t)*(record.childoffset+ichild), sizeof(childindex));
+            pnode->_vchildren[ichild] = _vnodes[childindex];
+        }
+        _vsetLevelNodes.at(_EncodeLevel(pnode->_level)).insert(pnode);
+    }
+    _numnodes = header.numnodes;
+    _vnodes.resize(0);
+    RAVELOG_DEBUG_FORMAT("loaded %d cache nodes from %s, %d collision nodes without colliding body", _numnodes%filename%numinvalid);
+    return 1;
+}
+
 int CacheTree::UpdateCollisionConfigurations(KinBodyPtr pbody)
 {
     int nremoved=0;
@@ -986,17 +1299,29 @@ int CacheTree::UpdateCollisionConfigurations(KinBodyPtr pbody)
     return nremoved;
 }
 
-int CacheTree::UpdateFreeConfigurations(KinBodyPtr pbody) //todo only remove those with overlaping linkspheres
+int CacheTree::UpdateFreeConfigurations(KinBodyPtr pbody, dReal fRotationMargin, dReal fTranslationMargin)
 {
     int nremoved=0;
     if (_numnodes > 0) {
-
+        const AABB abbody = pbody->ComputeAABB();
         FOREACH(itlevelnodes, _vsetLevelNodes) {
             FOREACH(itnode, *itlevelnodes) {
-                if (((*itnode)->GetType() == CNT_Free)) {
-                    (*itnode)->SetType(CNT_Unknown);
-                    nremoved += 1;
+                if ((*itnode)->GetType() != CNT_Free) {
+                    continue;
                 }
+                if ((*itnode)->HasAABB()) {
+                    // the configurations around the node are also assumed free, so the node covers everything the robot can reach from it
+                    AABB abnode = (*itnode)->GetAABB();
+                    const dReal fmargin = fTranslationMargin + fRotationMargin*2*RaveSqrt(abnode.extents.lengthsqr3());
+                    abnode.extents.x += fmargin;
+                    abnode.extents.y += fmargin;
+                    abnode.extents.z += fmargin;
+                    if (!geometry::CheckAABBCollision(abnode, abbody)) {
+                        continue;
+                    }
+                }
+                (*itnode)->SetType(CNT_Unknown);
+                nremoved += 1;
             }
         }
 
@@ -1217,6 +1542,8 @@ ConfigurationCache::ConfigurationCache(RobotBasePtr pstaterobot, bool envupdates
     }
 
     _cachetree.Init(_vweights, RaveSqrt(maxdistance));
+    // the env cache is only updated with bodies that are not the robot, so free nodes only have to be invalidated where these bodies are
+    _cachetree.SetComputeAABBs(_envupdates);
 
     if (IS_DEBUGLEVEL(Level_Verbose)) {
         stringstream ss; ss << std::setprecision(std::numeric_limits<OpenRAVE::dReal>::digits10+1);
@@ -1291,7 +1618,27 @@ int ConfigurationCache::UpdateCollisionConfigurations(KinBodyPtr pbody)
 
 int ConfigurationCache::UpdateFreeConfigurations(KinBodyPtr pbody)
 {
-    return _cachetree.UpdateFreeConfigurations(pbody);
+    // a configuration within _freespacethresh of a free node moves every dof i by at most _freespacethresh/weight_i from it
+    const std::vector<dReal>& vweights = _cachetree.GetWeights();
+    const int numtranslationdofs = !!(_nRobotAffineDOF & DOF_X) + !!(_nRobotAffineDOF & DOF_Y) + !!(_nRobotAffineDOF & DOF_Z);
+    dReal fRotationMargin = 0, fTranslationMargin = 0;
+    for (size_t i = 0; i < vweights.size(); ++i) {
+        if (vweights[i] <= 0) {
+            return _cachetree.RemoveFreeConfigurations();
+        }
+        bool bTranslation;
+        const int dofindex = _envupdates ? (i < _vRobotActiveIndices.size() ? _vRobotActiveIndices[i] : -1) : (int)i;
+        if (dofindex >= 0 && dofindex < _pstaterobot->GetDOF()) {
+            KinBody::JointPtr pjoint = _pstaterobot->GetJointFromDOFIndex(dofindex);
+            bTranslation = pjoint->IsPrismatic(dofindex - pjoint->GetDOFIndex());
+        }
+        else {
+            // affine dofs, the translation comes before the rotation
+            bTranslation = (int)(i - _vRobotActiveIndices.size()) < numtranslationdofs;
+        }
+        (bTranslation ? fTranslationMargin : fRotationMargin) += _freespacethresh / vweights[i];
+    }
+    return _cachetree.UpdateFreeConfigurations(pbody, fRotationMargin, fTranslationMargin);
 }
 
 int ConfigurationCache::RemoveFreeConfigurations()
@@ -1361,6 +1708,57 @@ int ConfigurationCache::CheckCollision(KinBody::LinkConstPtr& robotlink, KinBody
     return CheckCollision(conf, robotlink, collidinglink, closestdist);
 }
 
+std::string ConfigurationCache::ComputeRobotHash() const
+{
+    std::stringstream ss;
+    ss << _pstaterobot->GetKinematicsGeometryHash() << " " << _envupdates << " " << _nRobotAffineDOF << " " << _vRobotRotationAxis << " ";
+    FOREACHC(itindex, _vRobotActiveIndices) {
+        ss << *itindex << " ";
+    }
+    FOREACHC(itweight, _vweights) {
+        ss << *itweight << " ";
+    }
+    return utils::GetMD5HashString(ss.str());
+}
+
+std::string ConfigurationCache::ComputeStaticEnvironmentHash()
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(5); // small numerical differences of the poses should not change the hash
+    _penv->GetBodies(_vnewenvbodies);
+    std::vector< std::pair<std::string, KinBodyPtr> > vnamedbodies;
+    FOREACHC(itbody, _vnewenvbodies) {
+        if( *itbody != _pstaterobot && !_pstaterobot->IsGrabbing(**itbody) ) {
+            vnamedbodies.emplace_back((*itbody)->GetName(), *itbody);
+        }
+    }
+    // the body order can change across processes, so sort by name
+    std::sort(vnamedbodies.begin(), vnamedbodies.end(), [](const std::pair<std::string, KinBodyPtr>& a, const std::pair<std::string, KinBodyPtr>& b) {
+        return a.first < b.first;
+    });
+    std::vector<dReal> vdofvalues;
+    FOREACHC(itbody, vnamedbodies) {
+        const KinBody& body = *itbody->second;
+        ss << itbody->first << " " << body.GetKinematicsGeometryHash() << " " << body.IsEnabled() << " " << body.GetTransform() << " ";
+        body.GetDOFValues(vdofvalues);
+        FOREACHC(itvalue, vdofvalues) {
+            ss << *itvalue << " ";
+        }
+    }
+    _vnewenvbodies.resize(0);
+    return utils::GetMD5HashString(ss.str());
+}
+
+bool ConfigurationCache::SaveCacheFile(const std::string& filename)
+{
+    return _cachetree.SaveCacheFile(filename, ComputeRobotHash(), ComputeStaticEnvironmentHash()) == 1;
+}
+
+bool ConfigurationCache::LoadCacheFile(const std::string& filename)
+{
+    return _cachetree.LoadCacheFile(filename, ComputeRobotHash(), ComputeStaticEnvironmentHash(), _penv) == 1;
+}
+
 void ConfigurationCache::Reset()
 {
     RAVELOG_DEBUG("Resetting cache\n");
@@ -1374,11 +1772,11 @@ bool ConfigurationCache::Validate()
 
 void ConfigurationCache::_UpdateUntrackedBody(KinBodyPtr pbody)
 {
-    // body's state has changed, so remove collision space and invalidate free space.
+    // body's state has changed, so remove collision space and invalidate the free space the body now overlaps with.
     if(_envupdates) {
         RAVELOG_VERBOSE_FORMAT("%s %s","Updating untracked bodies"%pbody->GetName());
         UpdateCollisionConfigurations(pbody);
-        RemoveFreeConfigurations();
+        UpdateFreeConfigurations(pbody);
     }
 }
 
@@ -1386,8 +1784,8 @@ void ConfigurationCache::_UpdateAddRemoveBodies(KinBodyPtr pbody, int action)
 {
     if( action == 1 ) {
         if (_envupdates) {
-            // invalidate the freespace of a cache given a new body in the scene
-            if (RemoveFreeConfigurations() > 0) {
+            // invalidate the freespace of a cache that overlaps with the new body in the scene
+            if (UpdateFreeConfigurations(pbody) > 0) {
                 RAVELOG_DEBUG_FORMAT("%s %s %d","Updating add/remove bodies"%pbody->GetName()%action);
             }
             KinBodyCachedDataPtr pinfo(new KinBodyCachedData());
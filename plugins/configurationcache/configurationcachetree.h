@@ -99,6 +99,16 @@ public:
         return _usenn;
     }
 
+    /// \brief returns the AABB of the robot links and its grabbed bodies at this configuration, in world coordinates.
+    inline const AABB& GetAABB() const {
+        return _aabb;
+    }
+
+    /// \brief returns true if the AABB of the node was computed
+    inline bool HasAABB() const {
+        return _aabb.extents.x >= 0;
+    }
+
     /// \brief function used to update the hitcount for this node, TODO use this information to prune cache when it gets too big/slow
     inline int IncreaseHitCount(){
         return _hitcount++;
@@ -132,6 +142,7 @@ protected:
     uint8_t _hasselfchild; ///< if 1, then _vchildren has contains a clone of this node in the level below it.
     uint8_t _usenn; ///< if 1, then use part of the nearest neighbor search, otherwise ignore
     int _hitcount; /// number of cache hits
+    AABB _aabb; ///< see GetAABB, extents are negative if not computed
 
     // managed by pool
 #ifdef _DEBUG
@@ -252,8 +263,19 @@ public:
     /// \brief sets all collision configurations with pbody in its report to CNT_Unknown
     int UpdateCollisionConfigurations(KinBodyPtr pbody);
 
-    /// \brief sets all free configurations to CNT_Unknown, TODO, only set those that overlap with the new body
-    int UpdateFreeConfigurations(KinBodyPtr pbody);
+    /// \brief sets all free configurations whose inflated AABB overlaps with the AABB of pbody to CNT_Unknown. Free configurations without an AABB are always set to CNT_Unknown.
+    ///
+    /// The AABB of a node is inflated by fTranslationMargin + fRotationMargin times its diagonal, which has to bound how far the robot moves within the free space threshold of the node.
+    /// \param fRotationMargin sum of the largest changes of the revolute dofs within the free space threshold
+    /// \param fTranslationMargin sum of the largest changes of the prismatic dofs within the free space threshold
+    int UpdateFreeConfigurations(KinBodyPtr pbody, dReal fRotationMargin, dReal fTranslationMargin);
+
+    /// \brief if true, new nodes store the AABB of the robot links and its grabbed bodies at the current robot state (see CacheTreeNode::GetAABB)
+    ///
+    /// Should only be set when the robot is at the inserted configuration when InsertNode is called.
+    void SetComputeAABBs(bool bComputeAABBs) {
+        _bComputeAABBs = bComputeAABBs;
+    }
 
     /// \brief returns the number of configurations in the tree that are not CNT_Unknown
     int GetNumKnownNodes();
@@ -264,6 +286,21 @@ public:
     /// \brief load cache from disk
     int LoadCache(std::string filename, EnvironmentBasePtr penv);
 
+    /** \brief saves all the nodes to a binary file of fixed-size node records.
+
+        \param robothash identifies the robot and its configuration space, stored in the file
+        \param envhash identifies the environment the collisions were checked in, stored in the file
+        \return 1 if the file was written
+     */
+    int SaveCacheFile(const std::string& filename, const std::string& robothash, const std::string& envhash);
+
+    /** \brief memory-maps a file written by SaveCacheFile and replaces the tree with its nodes if the hashes match.
+
+        Collision nodes whose colliding body is not in penv are set to CNT_Unknown.
+        \return 1 if the nodes were loaded, 0 if the file does not exist, is invalid, or has different hashes. The tree is not changed in that case.
+     */
+    int LoadCacheFile(const std::string& filename, const std::string& robothash, const std::string& envhash, EnvironmentBasePtr penv);
+
 private:
     /// \brief creates new node on the pool
     CacheTreeNodePtr _CreateCacheTreeNode(const std::vector<dReal>& cs, CollisionReportPtr report);
@@ -333,6 +370,8 @@ private:
     dReal _base, _fBaseInv, _fBaseInv2, _fBaseChildMult; ///< a constant used to control the max level of traversion. _fBaseInv = 1/_base, _fBaseInv2=Sqr(_fBaseInv), _fBaseChildMult=1/(_base-1)
 
     int _statedof; ///< the state space DOF tree is configured for
+    bool _bComputeAABBs; ///< see SetComputeAABBs
+    std::vector<KinBodyPtr> _vgrabbedbodies; ///< cache for computing the AABBs
     int _maxlevel; ///< the maximum allowed levels in the tree, this is where the root node starts (inclusive)
     int _minlevel; ///< the minimum allowed levels in the tree (inclusive)
     int _numnodes; ///< the number of nodes in the current tree starting at the root at _vsetLevelNodes.at(_EncodeLevel(_maxlevel))
@@ -377,7 +416,7 @@ public:
     /// \brief removes all free configurations
     int RemoveFreeConfigurations();
 
-    /// \brief removes all free configurations, to be updated to only remove those with linkspheres that overlap with the body
+    /// \brief removes all free configurations whose robot AABB, inflated by how far the robot moves within _freespacethresh, overlaps with the AABB of pbody
     int UpdateFreeConfigurations(KinBodyPtr pbody);
 
     /// \brief determine if current configuration is whithin threshold of a collision in the cache (_collisionthresh), known to be in collision, or requires an explicit collision check
@@ -503,6 +542,20 @@ public:
         _cachetree.LoadCache(filename, penv);
     }
 
+    /// \brief hash of the robot kinematics and geometry and of the cached DOFs
+    std::string ComputeRobotHash() const;
+
+    /// \brief hash of the geometry, pose and enabled state of all the bodies that are not the robot or grabbed by it
+    std::string ComputeStaticEnvironmentHash();
+
+    /// \brief saves the cache to a binary file, keyed by ComputeRobotHash and ComputeStaticEnvironmentHash
+    bool SaveCacheFile(const std::string& filename);
+
+    /// \brief loads a file written by SaveCacheFile if the robot and static environment hashes still match
+    ///
+    /// \return true if the cache was loaded
+    bool LoadCacheFile(const std::string& filename);
+
 private:
     /// \brief called when body has changed state.
     void _UpdateUntrackedBody(KinBodyPtr pbody);
@@ -58,6 +58,8 @@ By default will sample the robot's active DOFs. Parameters part of the interface
                         "constrains the position of the manipulator around an obb: right, up, dir, pos, extents");
         RegisterCommand("SetResetIterationsOnSample",boost::bind(&ConfigurationJitterer::SetResetIterationsOnSampleCommand,this,_1,_2),
                         "sets the _bResetIterationsOnSample: whether or not to reset _nNumIterations every time Sample is called.");
+        RegisterCommand("SetCandidateBatchSize",boost::bind(&ConfigurationJitterer::SetCandidateBatchSizeCommand,this,_1,_2),
+                        "sets how many jittered candidates are collected before checking them together. The closest valid candidate of each round is returned. 1 (default) checks every candidate as soon as it is sampled.");
         RegisterCommand("SetManipulatorBias",boost::bind(&ConfigurationJitterer::SetManipulatorBiasCommand,this,_1,_2),
                         "Sets a bias on the sampling so that the manipulator has a tendency to move along vbias direction::\n\n\
   [manipname] bias_dir_x bias_dir_y bias_dir_z [nullsampleprob] [nullbiassampleprob] [deltasampleprob]\n\
@@ -129,6 +131,7 @@ By default will sample the robot's active DOFs. Parameters part of the interface
         _bSetResultOnRobot = true;
         _busebiasing = false;
         _bResetIterationsOnSample = true;
+        _nCandidateBatchSize = 1;
 
         // for selecting sampling modes
         if( samplername.size() == 0 ) {
@@ -335,6 +338,17 @@ By default will sample the robot's active DOFs. Parameters part of the interface
         return !!sinput;
     }
 
+    bool SetCandidateBatchSizeCommand(std::ostream& sout, std::istream& sinput)
+    {
+        int nCandidateBatchSize = 0;
+        sinput >> nCandidateBatchSize;
+        if( !sinput || nCandidateBatchSize < 1 ) {
+            return false;
+        }
+        _nCandidateBatchSize = nCandidateBatchSize;
+        return true;
+    }
+
     virtual int SampleSequence(std::vector<dReal>& samples, size_t num=1,IntervalType interval=IT_Closed)
     {
         samples.resize(0);
@@ -435,6 +449,7 @@ By default will sample the robot's active DOFs. Parameters part of the interface
         orjson::SetJsonValueByKey(output, "jitterPerturbation", _perturbation, alloc);
         orjson::SetJsonValueByKey(output, "jitterNeighDistThresh", _neighdistthresh, alloc);
         orjson::SetJsonValueByKey(output, "resetIterationsOnSample", _bResetIterationsOnSample, alloc);
+        orjson::SetJsonValueByKey(output, "candidateBatchSize", _nCandidateBatchSize, alloc);
         if( !!_pmanip ) {
             orjson::SetJsonValueByKey(output, "manipName", _pmanip->GetName(), alloc);
             rapidjson::Value rTransform;
@@ -481,6 +496,7 @@ By default will sample the robot's active DOFs. Parameters part of the interface
         bool bCollision = false;
         bool bConstraintFailed = false;
         bool bConstraint = !!_neighstatefn;
+        bool bCandidateValid = false;
 
         // have to test with perturbations since very small changes in angles can produce collision inconsistencies
         std::vector<dReal> perturbations;
@@ -493,6 +509,7 @@ By default will sample the robot's active DOFs. Parameters part of the interface
             perturbations.resize(1,0);
         }
         vnewdof.resize(GetDOF());
+        _vBatchCandidates.resize(0);
 
         // count of types of failures to better give user that info
         _counter.Reset();
@@ -800,96 +817,19 @@ By default will sample the robot's active DOFs. Parameters part of the interface
                 }
             }
 
-            // check perturbation
-            bCollision = false;
-            bConstraintFailed = false;
-            FOREACH(itperturbation,perturbations) {
-                // Perturbation is added to a config to make sure that the config is not too close to collision and tool
-                // direction/position constraint boundaries. So we do not use _neighstatefn to compute perturbed
-                // configurations.
-                _newdof2 = vnewdof;
-                for(size_t idof = 0; idof < _newdof2.size(); ++idof) {
-                    _newdof2[idof] += *itperturbation;
-                    if( _newdof2[idof] > _upper.at(idof) ) {
-                        _newdof2[idof] = _upper.at(idof);
-                    }
-                    else if( _newdof2[idof] < _lower.at(idof) ) {
-                        _newdof2[idof] = _lower.at(idof);
-                    }
-                }
-                _probot->SetActiveDOFValues(_newdof2);
-                if( !!_pConstraintToolDirection ) {
-                    if( !_pConstraintToolDirection->IsInConstraints(_pmanip->GetTransform()) ) {
-                        bConstraintFailed = true;
-                        _counter.nConstraintToolDirFailure++;
-                        if( IS_DEBUGLEVEL(Level_Verbose) ) {
-                            stringstream ss; ss << std::setprecision(std::numeric_limits<OpenRAVE::dReal>::digits10+1);
-                            ss << "env=" << GetEnv()->GetNameId() << ", direction constraints failed, ";
-                            for(size_t i = 0; i < _newdof2.size(); ++i ) {
-                                if( i > 0 ) {
-                                    ss << "," << _newdof2[i];
-                                }
-                                else {
-                                    ss << "colvalues=[" << _newdof2[i];
-                                }
-                            }
-                            ss << "]; cosangle=" << _pConstraintToolDirection->ComputeCosAngle(_pmanip->GetTransform()) << "; quat=[" << _pmanip->GetTransform().rot.x << ", " << _pmanip->GetTransform().rot.y << ", " << _pmanip->GetTransform().rot.z << ", " << _pmanip->GetTransform().rot.w << "]";
-                            RAVELOG_VERBOSE(ss.str());
-                        }
-                        break;
-                    }
-                }
-                if( !!_pConstraintToolPosition ) {
-                    if( !_pConstraintToolPosition->IsInConstraints(_pmanip->GetTransform()) ) {
-                        bConstraintFailed = true;
-                        _counter.nConstraintToolPositionFailure++;
-                        if( IS_DEBUGLEVEL(Level_Verbose) ) {
-                            stringstream ss; ss << std::setprecision(std::numeric_limits<OpenRAVE::dReal>::digits10+1);
-                            ss << "env=" << GetEnv()->GetNameId() << ", position constraints failed, ";
-                            for(size_t i = 0; i < _newdof2.size(); ++i ) {
-                                if( i > 0 ) {
-                                    ss << "," << _newdof2[i];
-                                }
-                                else {
-                                    ss << "colvalues=[" << _newdof2[i];
-                                }
-                            }
-                            ss << "]; trans=[" << _pmanip->GetTransform().trans.x << ", " << _pmanip->GetTransform().trans.y << ", " << _pmanip->GetTransform().trans.z << "]";
-                            RAVELOG_VERBOSE(ss.str());
-                        }
-                        break;
-                    }
-                }
-
-                if( GetEnv()->CheckCollision(_probot, _report) ) {
-                    bCollision = true;
-                    _counter.nEnvCollisionFailure++;
-                }
-                if( !bCollision && _probot->CheckSelfCollision(_report)) {
-                    bCollision = true;
-                    _counter.nSelfCollisionFailure++;
-                }
-
-                if( bCollision ) {
-                    if( IS_DEBUGLEVEL(Level_Verbose) ) {
-                        stringstream ss; ss << std::setprecision(std::numeric_limits<OpenRAVE::dReal>::digits10+1);
-                        ss << "env=" << _probot->GetEnv()->GetNameId() << ", iter=" << iter << "; collision failed, ";
-                        for(size_t i = 0; i < _newdof2.size(); ++i ) {
-                            if( i > 0 ) {
-                                ss << "," << _newdof2[i];
-                            }
-                            else {
-                                ss << "colvalues=[" << _newdof2[i];
-                            }
-                        }
-                        ss << "], report=" << _report->__str__();
-                        RAVELOG_VERBOSE(ss.str());
-                    }
-                    break;
+            if( _nCandidateBatchSize > 1 && !vnewdof.empty() ) {
+                // defer the perturbation checks so that a whole round of candidates is checked together
+                _vBatchCandidates.insert(_vBatchCandidates.end(), vnewdof.begin(), vnewdof.end());
+                if( (int)(_vBatchCandidates.size()/vnewdof.size()) < _nCandidateBatchSize && iter+1 < _maxiterations ) {
+                    continue;
                 }
+                bCandidateValid = _CheckCandidateBatch(vnewdof, perturbations, iter);
+            }
+            else {
+                bCandidateValid = _CheckCandidate(vnewdof, perturbations, iter, true);
             }
 
-            if( !bCollision && !bConstraintFailed ) {
+            if( bCandidateValid ) {
                 // the last perturbation is 0, so state is already set to the correct jittered value
                 if( IS_DEBUGLEVEL(Level_Verbose) ) {
                     _probot->GetActiveDOFValues(vnewdof);
@@ -921,6 +861,15 @@ By default will sample the robot's active DOFs. Parameters part of the interface
             }
         }
 
+        // candidates filtered out in the last iterations can leave a partial round behind
+        if( !_vBatchCandidates.empty() && _CheckCandidateBatch(vnewdof, perturbations, _maxiterations-1) ) {
+            if( _bSetResultOnRobot ) {
+                robotsaver.Release();
+            }
+            RAVELOG_DEBUG_FORMAT("env=%s, succeed on last candidate round, computation=%fs", GetEnv()->GetNameId()%(1e-9*(utils::GetNanoPerformanceTime() - starttime)));
+            return 1;
+        }
+
         RAVELOG_INFO_FORMAT("env=%s, failed iterations=%d (max=%d), computation=%fs, bConstraint=%d, neighstate=%d, constraintToolDir=%d, constraintToolPos=%d, envCollision=%d, selfCollision=%d, cachehit=%d, samesamples=%d, nLinkDistThreshRejections=%d", GetEnv()->GetNameId()%_nNumIterations%_maxiterations%(1e-9*(utils::GetNanoPerformanceTime() - starttime))%bConstraint%_counter.nNeighStateFailure%_counter.nConstraintToolDirFailure%_counter.nConstraintToolPositionFailure%_counter.nEnvCollisionFailure%_counter.nSelfCollisionFailure%_counter.nCacheHitSamples%_counter.nSameSamples%_counter.nLinkDistThreshRejections);
         //RAVELOG_WARN_FORMAT("failed iterations=%d, cachehits=%d, cache size=%d, jitter time=%fs", _maxiterations%_cachehit%cache.GetNumNodes()%(1e-9*(utils::GetNanoPerformanceTime() - starttime)));
         return 0;
@@ -928,6 +877,183 @@ By default will sample the robot's active DOFs. Parameters part of the interface
 
 protected:
 
+    /// \brief checks the jittered configuration and its perturbations against the tool constraints and collisions.
+    ///
+    /// On success the robot is left at vnewdof since the last perturbation is 0.
+    /// \param bCheckEnvCollision if false, skips the environment collision check because the caller already did it
+    /// \return true if all perturbations of vnewdof are valid
+    bool _CheckCandidate(const std::vector<dReal>& vnewdof, const std::vector<dReal>& perturbations, int iter, bool bCheckEnvCollision)
+    {
+        bool bCollision = false;
+        bool bConstraintFailed = false;
+        FOREACH(itperturbation,perturbations) {
+            // Perturbation is added to a config to make sure that the config is not too close to collision and tool
+            // direction/position constraint boundaries. So we do not use _neighstatefn to compute perturbed
+            // configurations.
+            _newdof2 = vnewdof;
+            for(size_t idof = 0; idof < _newdof2.size(); ++idof) {
+                _newdof2[idof] += *itperturbation;
+                if( _newdof2[idof] > _upper.at(idof) ) {
+                    _newdof2[idof] = _upper.at(idof);
+                }
+                else if( _newdof2[idof] < _lower.at(idof) ) {
+                    _newdof2[idof] = _lower.at(idof);
+                }
+            }
+            _probot->SetActiveDOFValues(_newdof2);
+            if( !!_pConstraintToolDirection ) {
+                if( !_pConstraintToolDirection->IsInConstraints(_pmanip->GetTransform()) ) {
+                    bConstraintFailed = true;
+                    _counter.nConstraintToolDirFailure++;
+                    if( IS_DEBUGLEVEL(Level_Verbose) ) {
+                        stringstream ss; ss << std::setprecision(std::numeric_limits<OpenRAVE::dReal>::digits10+1);
+                        ss << "env=" << GetEnv()->GetNameId() << ", direction constraints failed, ";
+                        for(size_t i = 0; i < _newdof2.size(); ++i ) {
+                            if( i > 0 ) {
+                                ss << "," << _newdof2[i];
+                            }
+                            else {
+                                ss << "colvalues=[" << _newdof2[i];
+                            }
+                        }
+                        ss << "]; cosangle=" << _pConstraintToolDirection->ComputeCosAngle(_pmanip->GetTransform()) << "; quat=[" << _pmanip->GetTransform().rot.x << ", " << _pmanip->GetTransform().rot.y << ", " << _pmanip->GetTransform().rot.z << ", " << _pmanip->GetTransform().rot.w << "]";
+                        RAVELOG_VERBOSE(ss.str());
+                    }
+                    break;
+                }
+            }
+            if( !!_pConstraintToolPosition ) {
+                if( !_pConstraintToolPosition->IsInConstraints(_pmanip->GetTransform()) ) {
+                    bConstraintFailed = true;
+                    _counter.nConstraintToolPositionFailure++;
+                    if( IS_DEBUGLEVEL(Level_Verbose) ) {
+                        stringstream ss; ss << std::setprecision(std::numeric_limits<OpenRAVE::dReal>::digits10+1);
+                        ss << "env=" << GetEnv()->GetNameId() << ", position constraints failed, ";
+                        for(size_t i = 0; i < _newdof2.size(); ++i ) {
+                            if( i > 0 ) {
+                                ss << "," << _newdof2[i];
+                            }
+                            else {
+                                ss << "colvalues=[" << _newdof2[i];
+                            }
+                        }
+                        ss << "]; trans=[" << _pmanip->GetTransform().trans.x << ", " << _pmanip->GetTransform().trans.y << ", " << _pmanip->GetTransform().trans.z << "]";
+                        RAVELOG_VERBOSE(ss.str());
+                    }
+                    break;
+                }
+            }
+
+            if( bCheckEnvCollision && GetEnv()->CheckCollision(_probot, _report) ) {
+                bCollision = true;
+                _counter.nEnvCollisionFailure++;
+            }
+            if( !bCollision && _probot->CheckSelfCollision(_report)) {
+                bCollision = true;
+                _counter.nSelfCollisionFailure++;
+            }
+
+            if( bCollision ) {
+                if( IS_DEBUGLEVEL(Level_Verbose) ) {
+                    stringstream ss; ss << std::setprecision(std::numeric_limits<OpenRAVE::dReal>::digits10+1);
+                    ss << "env=" << _probot->GetEnv()->GetNameId() << ", iter=" << iter << "; collision failed, ";
+                    for(size_t i = 0; i < _newdof2.size(); ++i ) {
+                        if( i > 0 ) {
+                            ss << "," << _newdof2[i];
+                        }
+                        else {
+                            ss << "colvalues=[" << _newdof2[i];
+                        }
+                    }
+                    ss << "], report=" << _report->__str__();
+                    RAVELOG_VERBOSE(ss.str());
+                }
+                break;
+            }
+        }
+        return !bCollision && !bConstraintFailed;
+    }
+
+    /// \brief checks a round of candidates accumulated in _vBatchCandidates and picks the valid one closest to _curdof.
+    ///
+    /// When there are no active affine dofs, the environment collisions of all candidates and their perturbations are
+    /// checked with one call to CollisionCheckerBase::CheckCollisionBatch. The remaining candidates are then checked in
+    /// order of their distance to _curdof, so the first one passing _CheckCandidate is the closest valid one.
+    /// \param[out] vnewdof the chosen candidate, the robot is set to it on success
+    /// \return true if a valid candidate was found. _vBatchCandidates is always cleared
+    bool _CheckCandidateBatch(std::vector<dReal>& vnewdof, const std::vector<dReal>& perturbations, int iter)
+    {
+        const size_t dof = vnewdof.size();
+        const size_t numcandidates = _vBatchCandidates.size()/dof;
+        _vBatchOrder.resize(0);
+        for(size_t icandidate = 0; icandidate < numcandidates; ++icandidate) {
+            dReal fdist2 = 0;
+            for(size_t idof = 0; idof < dof; ++idof) {
+                dReal f = _vBatchCandidates[icandidate*dof+idof] - _curdof[idof];
+                fdist2 += f*f;
+            }
+            _vBatchOrder.push_back(std::make_pair(fdist2, icandidate));
+        }
+
+        bool bCheckEnvCollision = true;
+        CollisionCheckerBasePtr pchecker = GetEnv()->GetCollisionChecker();
+        const size_t fulldof = _fulldof.size();
+        if( _nActiveAffineDOFs == 0 && fulldof > 0 && !!pchecker ) {
+            // batched api takes the full robot dof values, so expand every perturbed candidate from _fulldof
+            const size_t numperturbations = perturbations.size();
+            _vBatchFullConfigs.resize(numcandidates*numperturbations*fulldof);
+            for(size_t icandidate = 0; icandidate < numcandidates; ++icandidate) {
+                for(size_t iperturbation = 0; iperturbation < numperturbations; ++iperturbation) {
+                    dReal* pconfig = &_vBatchFullConfigs[(icandidate*numperturbations+iperturbation)*fulldof];
+                    std::copy(_fulldof.begin(), _fulldof.end(), pconfig);
+                    for(size_t idof = 0; idof < dof; ++idof) {
+                        dReal f = _vBatchCandidates[icandidate*dof+idof] + perturbations[iperturbation];
+                        if( f > _upper.at(idof) ) {
+                            f = _upper.at(idof);
+                        }
+                        else if( f < _lower.at(idof) ) {
+                            f = _lower.at(idof);
+                        }
+                        pconfig[_vActiveIndices.at(idof)] = f;
+                    }
+                }
+            }
+
+            pchecker->CheckCollisionBatch(_probot, &_vBatchFullConfigs[0], numcandidates*numperturbations, fulldof, _vBatchCollisionResults);
+            size_t inext = 0;
+            for(size_t iorder = 0; iorder < _vBatchOrder.size(); ++iorder) {
+                const size_t icandidate = _vBatchOrder[iorder].second;
+                bool bCollision = false;
+                for(size_t iperturbation = 0; iperturbation < numperturbations; ++iperturbation) {
+                    if( _vBatchCollisionResults[icandidate*numperturbations+iperturbation] ) {
+                        bCollision = true;
+                        break;
+                    }
+                }
+                if( bCollision ) {
+                    _counter.nEnvCollisionFailure++;
+                }
+                else {
+                    _vBatchOrder[inext++] = _vBatchOrder[iorder];
+                }
+            }
+            _vBatchOrder.resize(inext);
+            bCheckEnvCollision = false;
+        }
+
+        std::sort(_vBatchOrder.begin(), _vBatchOrder.end());
+        bool bSuccess = false;
+        FOREACHC(itorder, _vBatchOrder) {
+            std::copy(_vBatchCandidates.begin()+itorder->second*dof, _vBatchCandidates.begin()+(itorder->second+1)*dof, vnewdof.begin());
+            if( _CheckCandidate(vnewdof, perturbations, iter, bCheckEnvCollision) ) {
+                bSuccess = true;
+                break;
+            }
+        }
+        _vBatchCandidates.resize(0);
+        return bSuccess;
+    }
+
     /// \brief extracts all used bodies from the configurationspecification and computes AABBs, transforms, and limits for links
     void _InitRobotState()
     {
@@ -1155,6 +1281,12 @@ protected:
     bool _bSetResultOnRobot; ///< if true, will set the final result on the robot DOF values
     bool _busebiasing; ///< if true will bias the end effector along a certain direction using the jacobian and nullspace.
     bool _bResetIterationsOnSample; ///< if true, when Sample or SampleSequence is called, will reset the _nNumIterations to 0. O
+
+    int _nCandidateBatchSize; ///< number of candidates collected before checking them together. If 1, every candidate is checked as soon as it is sampled
+    std::vector<dReal> _vBatchCandidates; ///< active dof values of the candidates of the current round, packed
+    std::vector<dReal> _vBatchFullConfigs; ///< full robot dof values of every perturbed candidate, passed to CheckCollisionBatch
+    std::vector<uint8_t> _vBatchCollisionResults; ///< results of CheckCollisionBatch
+    std::vector< std::pair<dReal, size_t> > _vBatchOrder; ///< (squared distance to _curdof, candidate index)
 };
 
 SpaceSamplerBasePtr CreateConfigurationJitterer(EnvironmentBasePtr penv, std::istream& sinput)
@@ -202,6 +202,14 @@ public:
         return _cache->ComputeDistance(openravepy::ExtractArray<dReal>(oconfi), openravepy::ExtractArray<dReal>(oconff));
     }
 
+    bool SaveCacheFile(const std::string& filename) {
+        return _cache->SaveCacheFile(filename);
+    }
+
+    bool LoadCacheFile(const std::string& filename) {
+        return _cache->LoadCacheFile(filename);
+    }
+
 protected:
     object _pyenv;
     configurationcache::ConfigurationCachePtr _cache;
@@ -253,6 +261,8 @@ OPENRAVE_PYTHON_MODULE(openravepy_configurationcache)
     .def("GetNodeValues", &PyConfigurationCache::GetNodeValues)
     .def("FindNearestNode", &PyConfigurationCache::FindNearestNode)
     .def("ComputeDistance", &PyConfigurationCache::ComputeDistance)
+    .def("SaveCacheFile", &PyConfigurationCache::SaveCacheFile, PY_ARGS("filename") "Saves the cache to a binary file keyed by the robot and static environment hashes")
+    .def("LoadCacheFile", &PyConfigurationCache::LoadCacheFile, PY_ARGS("filename") "Loads the cache from a file written by SaveCacheFile if the robot and static environment hashes match")
 
     .def("GetCollisionThresh", &PyConfigurationCache::GetCollisionThresh)
     .def("GetFreeSpaceThresh", &PyConfigurationCache::GetFreeSpaceThresh)
@@ -0,0 +1,470 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2014 Alejandro Perez & Rosen Diankov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "openraveplugindefs.h"
+
+namespace configurationcache
+{
+
+/// \brief runs a query through a chain of collision checkers, from the cheapest to the exact one
+///
+/// Every checker except the last one has to be conservative: it can report a collision that does not exist, but never miss one.
+/// So a query is resolved as soon as one of them reports no collision, and the last checker decides the rest.
+/// The results of the body queries are also kept until the update stamp of one of the bodies of the environment changes, see EnvironmentBase::GetBodiesUpdateStamp.
+class TieredCollisionChecker : public CollisionCheckerBase
+{
+    /// \brief one checker of the chain
+    struct Tier
+    {
+        Tier() : numqueries(0), numresolved(0), querytime(0) {
+        }
+        CollisionCheckerBasePtr pchecker;
+        uint64_t numqueries; ///< number of queries that reached this tier
+        uint64_t numresolved; ///< number of queries whose result was given by this tier
+        uint64_t querytime; ///< us spent in the queries of this tier
+    };
+
+    enum QueryType
+    {
+        QT_Body = 0,
+        QT_BodyExcluded,
+        QT_BodySelf,
+    };
+
+    /// \brief result of a body query, valid while no body of the environment changes its update stamp
+    struct QueryCacheEntry
+    {
+        QueryCacheEntry() : bValid(false), options(0), envstamp(0), bodystamp(0), bCollision(false) {
+        }
+        bool bValid;
+        int options;
+        uint64_t envstamp; ///< EnvironmentBase::GetBodiesUpdateStamp
+        int bodystamp; ///< update stamp of the queried body
+        std::vector<int> vactivedofindices; ///< active dofs of the queried robot and its affine dofs at the end, only set with CO_ActiveDOFs
+        bool bCollision;
+    };
+    typedef std::map< std::pair<int, const KinBody*>, QueryCacheEntry > QueryCacheMap;
+
+public:
+    TieredCollisionChecker(EnvironmentBasePtr penv, std::istream& sinput) : CollisionCheckerBase(penv)
+    {
+        __description = "Runs the queries through a chain of collision checkers. Every checker except the last one has to be conservative, and a query is resolved by the first checker that reports no collision. Initialized with the names of the checkers, from the cheapest to the exact one.";
+        RegisterCommand("SetTiers",boost::bind(&TieredCollisionChecker::_SetTiersCommand,this,_1,_2),
+                        "set the chain of collision checkers, from the cheapest conservative one to the exact one. [checkername1 checkername2 ...]");
+        RegisterCommand("SendTierCommand",boost::bind(&TieredCollisionChecker::_SendTierCommandCommand,this,_1,_2),
+                        "send a command to one checker of the chain. [tierindex command arguments...]");
+        RegisterCommand("GetTierStatistics",boost::bind(&TieredCollisionChecker::_GetTierStatisticsCommand,this,_1,_2),
+                        "get the statistics of every tier on one line each: checkername numqueries numresolved querytime(us). The first line is the query cache: numqueries numhits");
+        RegisterCommand("ResetTierStatistics",boost::bind(&TieredCollisionChecker::_ResetTierStatisticsCommand,this,_1,_2),
+                        "reset the statistics of the tiers and of the query cache");
+        RegisterCommand("SetUseQueryCache",boost::bind(&TieredCollisionChecker::_SetUseQueryCacheCommand,this,_1,_2),
+                        "enable (1) or disable (0) keeping the results of the body queries until a body of the environment changes. Enabled by default");
+        _bUseQueryCache = true;
+        _numcachequeries = 0;
+        _numcachehits = 0;
+
+        std::vector<std::string> vcheckernames;
+        std::string checkername;
+        while( sinput >> checkername ) {
+            vcheckernames.push_back(checkername);
+        }
+        if( vcheckernames.empty() ) {
+            vcheckernames.push_back("fcl_");
+        }
+        _SetTiers(vcheckernames);
+    }
+
+    virtual ~TieredCollisionChecker() {
+    }
+
+    virtual bool SetCollisionOptions(int collisionoptions)
+    {
+        bool bSuccess = true;
+        FOREACH(ittier, _vtiers) {
+            bSuccess &= ittier->pchecker->SetCollisionOptions(collisionoptions);
+        }
+        return bSuccess;
+    }
+
+    virtual int GetCollisionOptions() const {
+        return _GetExactChecker()->GetCollisionOptions();
+    }
+
+    virtual void SetTolerance(dReal tolerance) {
+        FOREACH(ittier, _vtiers) {
+            ittier->pchecker->SetTolerance(tolerance);
+        }
+    }
+
+    virtual void SetGeometryGroup(const std::string& groupname)
+    {
+        _mapQueryCache.clear();
+        FOREACH(ittier, _vtiers) {
+            ittier->pchecker->SetGeometryGroup(groupname);
+        }
+    }
+
+    virtual const std::string& GetGeometryGroup() const
+    {
+        return _GetExactChecker()->GetGeometryGroup();
+    }
+
+    virtual bool SetBodyGeometryGroup(KinBodyConstPtr pbody, const std::string& groupname)
+    {
+        _mapQueryCache.clear();
+        bool bSuccess = true;
+        FOREACH(ittier, _vtiers) {
+            bSuccess &= ittier->pchecker->SetBodyGeometryGroup(pbody, groupname);
+        }
+        return bSuccess;
+    }
+
+    virtual const std::string& GetBodyGeometryGroup(KinBodyConstPtr pbody) const
+    {
+        return _GetExactChecker()->GetBodyGeometryGroup(pbody);
+    }
+
+    virtual bool InitEnvironment()
+    {
+        _mapQueryCache.clear();
+        bool bSuccess = true;
+        FOREACH(ittier, _vtiers) {
+            bSuccess &= ittier->pchecker->InitEnvironment();
+        }
+        return bSuccess;
+    }
+
+    virtual void DestroyEnvironment()
+    {
+        _mapQueryCache.clear();
+        FOREACH(ittier, _vtiers) {
+            ittier->pchecker->DestroyEnvironment();
+        }
+    }
+
+    virtual void Clone(InterfaceBaseConstPtr preference, int cloningoptions)
+    {
+        CollisionCheckerBase::Clone(preference, cloningoptions);
+        OPENRAVE_SHARED_PTR<TieredCollisionChecker const> clone = OPENRAVE_DYNAMIC_POINTER_CAST<TieredCollisionChecker const> (preference);
+
+        DestroyEnvironment();
+        _vtiers.resize(0);
+        FOREACHC(ittier, clone->_vtiers) {
+            Tier tier;
+            tier.pchecker = RaveCreateCollisionChecker(GetEnv(), ittier->pchecker->GetXMLId());
+            tier.pchecker->Clone(ittier->pchecker, cloningoptions);
+            tier.pchecker->InitEnvironment();
+            _vtiers.push_back(tier);
+        }
+        _bUseQueryCache = clone->_bUseQueryCache;
+    }
+
+    virtual bool InitKinBody(KinBodyPtr pbody)
+    {
+        _mapQueryCache.clear();
+        bool bSuccess = true;
+        FOREACH(ittier, _vtiers) {
+            bSuccess &= ittier->pchecker->InitKinBody(pbody);
+        }
+        return bSuccess;
+    }
+
+    virtual void RemoveKinBody(KinBodyPtr pbody)
+    {
+        _mapQueryCache.clear();
+        FOREACH(ittier, _vtiers) {
+            ittier->pchecker->RemoveKinBody(pbody);
+        }
+    }
+
+    virtual bool CheckCollision(KinBodyConstPtr pbody1, CollisionReportPtr report = CollisionReportPtr())
+    {
+        return _CheckCachedQuery(QT_Body, *pbody1, report, boost::bind(&TieredCollisionChecker::_CheckBody, this, _1, boost::cref(pbody1)));
+    }
+
+    virtual bool CheckCollision(KinBodyConstPtr pbody1, KinBodyConstPtr pbody2, CollisionReportPtr report = CollisionReportPtr())
+    {
+        return _CheckTiers(boost::bind(&TieredCollisionChecker::_CheckBodyBody, _1, boost::cref(pbody1), boost::cref(pbody2), _2), report);
+    }
+
+    virtual bool CheckCollision(KinBody::LinkConstPtr plink, CollisionReportPtr report = CollisionReportPtr())
+    {
+        return _CheckTiers(boost::bind(&TieredCollisionChecker::_CheckLink, _1, boost::cref(plink), _2), report);
+    }
+
+    virtual bool CheckCollision(KinBody::LinkConstPtr plink1, KinBody::LinkConstPtr plink2, CollisionReportPtr report = CollisionReportPtr())
+    {
+        return _CheckTiers(boost::bind(&TieredCollisionChecker::_CheckLinkLink, _1, boost::cref(plink1), boost::cref(plink2), _2), report);
+    }
+
+    virtual bool CheckCollision(KinBody::LinkConstPtr plink, KinBodyConstPtr pbody, CollisionReportPtr report = CollisionReportPtr())
+    {
+        return _CheckTiers(boost::bind(&TieredCollisionChecker::_CheckLinkBody, _1, boost::cref(plink), boost::cref(pbody), _2), report);
+    }
+
+    virtual bool CheckCollision(KinBody::LinkConstPtr plink, const std::vector<KinBodyConstPtr>& vbodyexcluded, const std::vector<KinBody::LinkConstPtr>& vlinkexcluded, CollisionReportPtr report = CollisionReportPtr())
+    {
+        return _CheckTiers(boost::bind(&TieredCollisionChecker::_CheckLinkExcluded, _1, boost::cref(plink), boost::cref(vbodyexcluded), boost::cref(vlinkexcluded), _2), report);
+    }
+
+    virtual bool CheckCollision(KinBodyConstPtr pbody, const std::vector<KinBodyConstPtr>& vbodyexcluded, const std::vector<KinBody::LinkConstPtr>& vlinkexcluded, CollisionReportPtr report = CollisionReportPtr())
+    {
+        const TierQueryFn fnquery = boost::bind(&TieredCollisionChecker::_CheckBodyExcluded, _1, boost::cref(pbody), boost::cref(vbodyexcluded), boost::cref(vlinkexcluded), _2);
+        if( vbodyexcluded.empty() && vlinkexcluded.empty() ) {
+            // the excluded lists are not part of the cache key, so only cache the queries without them
+            return _CheckCachedQuery(QT_BodyExcluded, *pbody, report, boost::bind(&TieredCollisionChecker::_CheckTiers, this, boost::cref(fnquery), _1));
+        }
+        return _CheckTiers(fnquery, report);
+    }
+
+    virtual bool CheckCollision(const RAY& ray, KinBody::LinkConstPtr plink, CollisionReportPtr report = CollisionReportPtr()) {
+        return _GetExactChecker()->CheckCollision(ray, plink, report);
+    }
+
+    virtual bool CheckCollision(const RAY& ray, KinBodyConstPtr pbody, CollisionReportPtr report = CollisionReportPtr()) {
+        return _GetExactChecker()->CheckCollision(ray, pbody, report);
+    }
+
+    virtual bool CheckCollision(const RAY& ray, CollisionReportPtr report = CollisionReportPtr()) {
+        return _GetExactChecker()->CheckCollision(ray, report);
+    }
+
+    virtual int CheckCollisionRays(const std::vector<RAY>& vrays, std::vector<CollisionReport>& vreports) {
+        return _GetExactChecker()->CheckCollisionRays(vrays, vreports);
+    }
+
+    virtual bool CheckCollision(const TriMesh& trimesh, KinBodyConstPtr pbody, CollisionReportPtr report = CollisionReportPtr()) {
+        return _GetExactChecker()->CheckCollision(trimesh, pbody, report);
+    }
+
+    virtual bool CheckCollision(const TriMesh& trimesh, CollisionReportPtr report = CollisionReportPtr()) {
+        return _GetExactChecker()->CheckCollision(trimesh, report);
+    }
+
+    virtual bool CheckCollision(const AABB& ab, const Transform& aabbPose, CollisionReportPtr report = CollisionReportPtr()) {
+        return _GetExactChecker()->CheckCollision(ab, aabbPose, report);
+    }
+
+    virtual bool CheckCollision(const AABB& ab, const Transform& aabbPose, const std::vector<KinBodyConstPtr>& vbodies, CollisionReportPtr report = CollisionReportPtr()) {
+        return _GetExactChecker()->CheckCollision(ab, aabbPose, vbodies, report);
+    }
+
+    virtual bool CheckCollisionBatch(KinBodyPtr pbody, const dReal* pConfigurations, size_t nConfigurations, int dofstride, std::vector<uint8_t>& vresults, CollisionReportPtr report = CollisionReportPtr()) {
+        return _GetExactChecker()->CheckCollisionBatch(pbody, pConfigurations, nConfigurations, dofstride, vresults, report);
+    }
+
+    virtual bool CheckContinuousCollision(KinBodyPtr pbody, const std::vector<dReal>& vStartConfig, const std::vector<dReal>& vEndConfig, IntervalType interval, CollisionReportPtr report = CollisionReportPtr()) {
+        return _GetExactChecker()->CheckContinuousCollision(pbody, vStartConfig, vEndConfig, interval, report);
+    }
+
+    virtual bool CheckStandaloneSelfCollision(KinBodyConstPtr pbody, CollisionReportPtr report = CollisionReportPtr())
+    {
+        return _CheckCachedQuery(QT_BodySelf, *pbody, report, boost::bind(&TieredCollisionChecker::_CheckBodySelf, this, _1, boost::cref(pbody)));
+    }
+
+    virtual bool CheckStandaloneSelfCollision(KinBody::LinkConstPtr plink, CollisionReportPtr report = CollisionReportPtr())
+    {
+        return _CheckTiers(boost::bind(&TieredCollisionChecker::_CheckLinkSelf, _1, boost::cref(plink), _2), report);
+    }
+
+protected:
+    typedef boost::function<bool (CollisionCheckerBase&, CollisionReportPtr)> TierQueryFn;
+
+    inline const CollisionCheckerBasePtr& _GetExactChecker() const {
+        return _vtiers.back().pchecker;
+    }
+
+    static bool _CheckBodyBody(CollisionCheckerBase& checker, const KinBodyConstPtr& pbody1, const KinBodyConstPtr& pbody2, CollisionReportPtr report) {
+        return checker.CheckCollision(pbody1, pbody2, report);
+    }
+    static bool _CheckLink(CollisionCheckerBase& checker, const KinBody::LinkConstPtr& plink, CollisionReportPtr report) {
+        return checker.CheckCollision(plink, report);
+    }
+    static bool _CheckLinkLink(CollisionCheckerBase& checker, const KinBody::LinkConstPtr& plink1, const KinBody::LinkConstPtr& plink2, CollisionReportPtr report) {
+        return checker.CheckCollision(plink1, plink2, report);
+    }
+    static bool _CheckLinkBody(CollisionCheckerBase& checker, const KinBody::LinkConstPtr& plink, const KinBodyConstPtr& pbody, CollisionReportPtr report) {
+        return checker.CheckCollision(plink, pbody, report);
+    }
+    static bool _CheckLinkExcluded(CollisionCheckerBase& checker, const KinBody::LinkConstPtr& plink, const std::vector<KinBodyConstPtr>& vbodyexcluded, const std::vector<KinBody::LinkConstPtr>& vlinkexcluded, CollisionReportPtr report) {
+        return checker.CheckCollision(plink, vbodyexcluded, vlinkexcluded, report);
+    }
+    static bool _CheckBodyExcluded(CollisionCheckerBase& checker, const KinBodyConstPtr& pbody, const std::vector<KinBodyConstPtr>& vbodyexcluded, const std::vector<KinBody::LinkConstPtr>& vlinkexcluded, CollisionReportPtr report) {
+        return checker.CheckCollision(pbody, vbodyexcluded, vlinkexcluded, report);
+    }
+    static bool _CheckLinkSelf(CollisionCheckerBase& checker, const KinBody::LinkConstPtr& plink, CollisionReportPtr report) {
+        return checker.CheckStandaloneSelfCollision(plink, report);
+    }
+
+    bool _CheckBody(CollisionReportPtr report, const KinBodyConstPtr& pbody) {
+        return _CheckTiers(boost::bind(&TieredCollisionChecker::_CheckBodyOnChecker, _1, boost::cref(pbody), _2), report);
+    }
+    bool _CheckBodySelf(CollisionReportPtr report, const KinBodyConstPtr& pbody) {
+        return _CheckTiers(boost::bind(&TieredCollisionChecker::_CheckBodySelfOnChecker, _1, boost::cref(pbody), _2), report);
+    }
+    static bool _CheckBodyOnChecker(CollisionCheckerBase& checker, const KinBodyConstPtr& pbody, CollisionReportPtr report) {
+        return checker.CheckCollision(pbody, report);
+    }
+    static bool _CheckBodySelfOnChecker(CollisionCheckerBase& checker, const KinBodyConstPtr& pbody, CollisionReportPtr report) {
+        return checker.CheckStandaloneSelfCollision(pbody, report);
+    }
+
+    /// \brief runs the query on the tiers until one of them reports no collision
+    bool _CheckTiers(const TierQueryFn& fnquery, CollisionReportPtr report)
+    {
+        // the conservative tiers cannot compute distances or contacts, so only the exact tier answers such queries
+        const bool bExactOnly = !!(_GetExactChecker()->GetCollisionOptions() & (CO_Distance|CO_Contacts|CO_AllLinkCollisions|CO_AllGeometryCollisions|CO_AllGeometryContacts));
+        for(size_t itier = bExactOnly ? _vtiers.size()-1 : 0; itier < _vtiers.size(); ++itier) {
+            Tier& tier = _vtiers[itier];
+            const bool bExact = itier+1 == _vtiers.size();
+            ++tier.numqueries;
+            const uint64_t starttime = utils::GetMicroTime();
+            // only the exact tier fills the report
+            const bool bCollision = fnquery(*tier.pchecker, bExact ? report : CollisionReportPtr());
+            tier.querytime += utils::GetMicroTime() - starttime;
+            if( bExact || !bCollision ) {
+                ++tier.numresolved;
+                if( !bExact && !!report ) {
+                    report->Reset(GetCollisionOptions());
+                }
+                return bCollision;
+            }
+        }
+        return false; // never reached, there is at least one tier
+    }
+
+    /// \brief returns the cached result of a body query if no body of the environment changed since it was computed, otherwise runs it
+    bool _CheckCachedQuery(int querytype, const KinBody& body, CollisionReportPtr report, const boost::function<bool (CollisionReportPtr)>& fnquery)
+    {
+        if( !_bUseQueryCache ) {
+            return fnquery(report);
+        }
+        ++_numcachequeries;
+        const int options = GetCollisionOptions();
+        const uint64_t envstamp = GetEnv()->GetBodiesUpdateStamp();
+        _vActiveDOFIndicesCache.resize(0);
+        if( (options & CO_ActiveDOFs) && body.IsRobot() ) {
+            const RobotBase& robot = static_cast<const RobotBase&>(body);
+            _vActiveDOFIndicesCache = robot.GetActiveDOFIndices();
+            _vActiveDOFIndicesCache.push_back(robot.GetAffineDOF());
+        }
+
+        QueryCacheEntry& entry = _mapQueryCache[std::make_pair(querytype, &body)];
+        // the collisions of the report cannot be restored, so a cached collision is only returned when no report is requested
+        if( entry.bValid && entry.options == options && entry.envstamp == envstamp && entry.bodystamp == body.GetUpdateStamp() && entry.vactivedofindices == _vActiveDOFIndicesCache && (!entry.bCollision || !report) ) {
+            ++_numcachehits;
+            if( !!report ) {
+                report->Reset(options);
+            }
+            return entry.bCollision;
+        }
+        entry.bCollision = fnquery(report);
+        entry.bValid = true;
+        entry.options = options;
+        // the query can move the bodies and restore them, so take the stamps after it
+        entry.envstamp = GetEnv()->GetBodiesUpdateStamp();
+        entry.bodystamp = body.GetUpdateStamp();
+        entry.vactivedofindices.swap(_vActiveDOFIndicesCache);
+        return entry.bCollision;
+    }
+
+    void _SetTiers(const std::vector<std::string>& vcheckernames)
+    {
+        std::vector<Tier> vtiers;
+        FOREACHC(itname, vcheckernames) {
+            Tier tier;
+            tier.pchecker = RaveCreateCollisionChecker(GetEnv(), *itname);
+            OPENRAVE_ASSERT_FORMAT(!!tier.pchecker, "tier checker %s is not valid", *itname, ORE_InvalidArguments);
+            if( _vtiers.size() > 0 ) {
+                tier.pchecker->SetCollisionOptions(GetCollisionOptions());
+            }
+            vtiers.push_back(tier);
+        }
+        _vtiers.swap(vtiers);
+        _mapQueryCache.clear();
+    }
+
+    virtual bool _SetTiersCommand(std::ostream& sout, std::istream& sinput)
+    {
+        std::vector<std::string> vcheckernames;
+        std::string checkername;
+        while( sinput >> checkername ) {
+            vcheckernames.push_back(checkername);
+        }
+        if( vcheckernames.empty() ) {
+            return false;
+        }
+        const bool bInitialized = GetEnv()->GetCollisionChecker() == shared_collisionchecker();
+        _SetTiers(vcheckernames);
+        if( bInitialized ) {
+            FOREACH(ittier, _vtiers) {
+                ittier->pchecker->InitEnvironment();
+            }
+        }
+        return true;
+    }
+
+    virtual bool _SendTierCommandCommand(std::ostream& sout, std::istream& sinput)
+    {
+        size_t itier = 0;
+        sinput >> itier;
+        if( !sinput || itier >= _vtiers.size() ) {
+            return false;
+        }
+        _mapQueryCache.clear(); // the command can change the results of the tier
+        std::stringstream scommand;
+        scommand << sinput.rdbuf();
+        return _vtiers[itier].pchecker->SendCommand(sout, scommand);
+    }
+
+    virtual bool _GetTierStatisticsCommand(std::ostream& sout, std::istream& sinput)
+    {
+        sout << _numcachequeries << " " << _numcachehits << std::endl;
+        FOREACHC(ittier, _vtiers) {
+            sout << ittier->pchecker->GetXMLId() << " " << ittier->numqueries << " " << ittier->numresolved << " " << ittier->querytime << std::endl;
+        }
+        return true;
+    }
+
+    virtual bool _ResetTierStatisticsCommand(std::ostream& sout, std::istream& sinput)
+    {
+        _numcachequeries = 0;
+        _numcachehits = 0;
+        FOREACH(ittier, _vtiers) {
+            ittier->numqueries = 0;
+            ittier->numresolved = 0;
+            ittier->querytime = 0;
+        }
+        return true;
+    }
+
+    virtual bool _SetUseQueryCacheCommand(std::ostream& sout, std::istream& sinput)
+    {
+        sinput >> _bUseQueryCache;
+        _mapQueryCache.clear();
+        return !!sinput;
+    }
+
+    std::vector<Tier> _vtiers; ///< from the cheapest to the exact checker, never empty
+    QueryCacheMap _mapQueryCache;
+    std::vector<int> _vActiveDOFIndicesCache;
+    bool _bUseQueryCache;
+    uint64_t _numcachequeries, _numcachehits;
+};
+
+CollisionCheckerBasePtr CreateTieredCollisionChecker(EnvironmentBasePtr penv, std::istream& sinput)
+{
+    return CollisionCheckerBasePtr(new TieredCollisionChecker(penv, sinput));
+}
+
+};
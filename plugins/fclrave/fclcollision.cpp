@@ -55,6 +55,7 @@ FCLCollisionChecker::CollisionCallbackData::CollisionCallbackData(boost::shared_
     , _report(report)
     , _vbodyexcluded(vbodyexcluded)
     , _vlinkexcluded(vlinkexcluded)
+    , _pvExcludedBodyMask(nullptr)
     , bselfCollision(false)
     , _bStopChecking(false)
     , _bCollision(false)
@@ -101,13 +102,42 @@ FCLCollisionChecker::FCLCollisionChecker(OpenRAVE::EnvironmentBasePtr penv, std:
     // TODO : Should we put a more reasonable arbitrary value ?
     _numMaxContacts = std::numeric_limits<int>::max();
     _nGetEnvManagerCacheClearCount = 100000;
+    _fContinuousCollisionStep = 0.1;
+    _bCoherentDistance = false;
+    _bUseSharedEnvManager = false; // opt-in with SetUseSharedEnvManager
+    _bAutoBroadphaseAlgorithm = false;
+    _bBroadphaseSwitchPending = false;
+    _runtimeStatistics.SetBroadphaseAlgorithm(_broadPhaseCollisionManagerAlgorithm, false);
+    _pvoxelobstacle = boost::make_shared<FCLVoxelObstacle>(_CreateManager());
+    _fDistanceFieldResolution = 0.02;
+    _fDistanceFieldPadding = 0.3;
+    _bDistanceFieldSampled = false;
+    _bBatchSphereApproximation = false;
     __description = ":Interface Author: Kenji Maillard\n\nFlexible Collision Library collision checker";
 
     SETUP_STATISTICS(_statistics, _userdatakey, GetEnv()->GetId());
 
     // TODO : Consider removing these which could be more harmful than anything else
-    RegisterCommand("SetBroadphaseAlgorithm", boost::bind(&FCLCollisionChecker::SetBroadphaseAlgorithmCommand, this, _1, _2), "sets the broadphase algorithm (Naive, SaP, SSaP, IntervalTree, DynamicAABBTree, DynamicAABBTree_Array)");
+    RegisterCommand("SetBroadphaseAlgorithm", boost::bind(&FCLCollisionChecker::SetBroadphaseAlgorithmCommand, this, _1, _2), "sets the broadphase algorithm (Naive, SaP, SSaP, IntervalTree, DynamicAABBTree, DynamicAABBTree_Array, Auto). Auto switches between Naive, SaP and DynamicAABBTree2 depending on the number of objects and how many of them move between queries");
     RegisterCommand("SetBVHRepresentation", boost::bind(&FCLCollisionChecker::_SetBVHRepresentation, this, _1, _2), "sets the Bouding Volume Hierarchy representation for meshes (AABB, OBB, OBBRSS, RSS, kIDS)");
+    RegisterCommand("SetUseMeshCache", boost::bind(&FCLCollisionChecker::_SetUseMeshCacheCommand, this, _1, _2), "enables (1) or disables (0) sharing the BVH models of meshes with other collision checkers of the process");
+    RegisterCommand("GetMeshCacheStatistics", boost::bind(&FCLCollisionChecker::_GetMeshCacheStatisticsCommand, this, _1, _2), "returns the number of hits, misses, bytes saved and alive entries of the process-wide BVH mesh cache");
+    RegisterCommand("SetUseConvexDecomposition", boost::bind(&FCLCollisionChecker::_SetUseConvexDecompositionCommand, this, _1, _2), "enables (1) or disables (0) colliding trimeshes as the convex pieces of their cached convex decomposition instead of their BVH, optionally followed by the number of threads and the decomposition parameters");
+    RegisterCommand("GetConvexDecompositionCacheStatistics", boost::bind(&FCLCollisionChecker::_GetConvexDecompositionCacheStatisticsCommand, this, _1, _2), "returns the number of hits, misses, entries and convex pieces of the process-wide convex decomposition cache");
+    RegisterCommand("SetStatisticsEnabled", boost::bind(&FCLCollisionChecker::_SetStatisticsEnabledCommand, this, _1, _2), "enables (1) or disables (0) recording the runtime statistics returned by GetStatistics");
+    RegisterCommand("GetStatistics", boost::bind(&FCLCollisionChecker::_GetStatisticsCommand, this, _1, _2), "returns the runtime statistics as JSON: query latencies (p50/p99/max in microseconds), narrow phase calls per geometry type pair, broadphase updates and manager cache hits");
+    RegisterCommand("ResetStatistics", boost::bind(&FCLCollisionChecker::_ResetStatisticsCommand, this, _1, _2), "resets the runtime statistics");
+    RegisterCommand("SetUseSharedEnvManager", boost::bind(&FCLCollisionChecker::_SetUseSharedEnvManagerCommand, this, _1, _2), "enables (1) or disables (0) sharing one environment broadphase manager between queries excluding different bodies");
+    RegisterCommand("SetCoherentDistance", boost::bind(&FCLCollisionChecker::_SetCoherentDistanceCommand, this, _1, _2), "enables (1) or disables (0) skipping the geometry pairs whose distance cannot have decreased below the current minimum since the last distance query");
+    RegisterCommand("SetContinuousCollisionStep", boost::bind(&FCLCollisionChecker::_SetContinuousCollisionStepCommand, this, _1, _2), "sets the maximum change of any dof between two consecutive screw motions checked by CheckContinuousCollision");
+    RegisterCommand("SetVoxelObstacleResolution", boost::bind(&FCLCollisionChecker::_SetVoxelObstacleResolutionCommand, this, _1, _2), "sets the side of the cells of the voxel obstacle, removes all its cells if it changes");
+    RegisterCommand("ClearVoxelObstacle", boost::bind(&FCLCollisionChecker::_ClearVoxelObstacleCommand, this, _1, _2), "removes all the cells of the voxel obstacle");
+    RegisterCommand("GetVoxelObstacleNumVoxels", boost::bind(&FCLCollisionChecker::_GetVoxelObstacleNumVoxelsCommand, this, _1, _2), "returns the number of occupied cells of the voxel obstacle");
+    RegisterTypedCommand("InsertVoxelObstaclePoints", &FCLCollisionChecker::_InsertVoxelObstaclePointsTypedCommand, "marks the cells of the voxel obstacle containing the points of input vrealvalues (x y z triplets) as occupied. The voxel obstacle collides with the bodies and links checked against the environment. Output vintvalues holds the number of new cells.");
+    RegisterTypedCommand("ClearVoxelObstaclePoints", &FCLCollisionChecker::_ClearVoxelObstaclePointsTypedCommand, "marks the cells of the voxel obstacle containing the points of input vrealvalues (x y z triplets) as free. Output vintvalues holds the number of removed cells.");
+    RegisterCommand("SetDistanceField", boost::bind(&FCLCollisionChecker::_SetDistanceFieldCommand, this, _1, _2), "format: resolution padding bodyname1 bodyname2 ...\n\nsamples the signed distance field of bodies that do not move. The body and link queries against the environment skip these bodies when the field shows that they cannot be touched, and the field is sampled again when one of the bodies changes. Without any body name, removes the distance field.");
+    RegisterTypedCommand("GetDistanceFieldDistances", &FCLCollisionChecker::_GetDistanceFieldDistancesTypedCommand, "for every point of input vrealvalues (x y z triplets), output vrealvalues holds the interpolated distance to the bodies of the distance field followed by the 3 values of its gradient");
+    RegisterCommand("SetBatchSphereApproximation", boost::bind(&FCLCollisionChecker::_SetBatchSphereApproximationCommand, this, _1, _2), "enables (1) or disables (0) checking the configurations of CheckCollisionBatch against the bodies of the distance field with the covering spheres of the links only. The results become conservative: a configuration is reported in collision as soon as one of its spheres can touch the field, and then does not fill the report.");
 
     RAVELOG_VERBOSE_FORMAT("FCLCollisionChecker %s created in env %d", _userdatakey%penv->GetId());
 
@@ -159,15 +189,53 @@ void FCLCollisionChecker::Clone(InterfaceBaseConstPtr preference, int cloningopt
     boost::shared_ptr<FCLCollisionChecker const> r = boost::dynamic_pointer_cast<FCLCollisionChecker const>(preference);
     // We don't clone Kinbody's specific geometry group
     _fclspace->SetGeometryGroup(r->GetGeometryGroup());
+    _fclspace->SetUseMeshCache(r->_fclspace->IsUsingMeshCache());
     _fclspace->SetBVHRepresentation(r->GetBVHRepresentation());
+    _fclspace->SetUseConvexDecomposition(r->_fclspace->IsUsingConvexDecomposition(), r->_fclspace->GetConvexDecompositionParameters(), r->_fclspace->GetConvexDecompositionThreads());
     _SetBroadphaseAlgorithm(r->GetBroadphaseAlgorithm());
+    if( r->IsAutoBroadphaseAlgorithm() ) {
+        _SetBroadphaseAlgorithm("Auto");
+    }
 
     // We don't want to clone _bIsSelfCollisionChecker since a self collision checker can be created by cloning a environment collision checker
     _options = r->_options;
     _numMaxContacts = r->_numMaxContacts;
+    _fContinuousCollisionStep = r->_fContinuousCollisionStep;
+    _bCoherentDistance = r->_bCoherentDistance;
+    _bUseSharedEnvManager = r->_bUseSharedEnvManager;
+    _runtimeStatistics.SetEnabled(r->_runtimeStatistics.IsEnabled());
+    _pvoxelobstacle->Copy(*r->_pvoxelobstacle);
+    // the distance field is sampled again from the bodies of this environment
+    _vDistanceFieldBodyNames = r->_vDistanceFieldBodyNames;
+    _fDistanceFieldResolution = r->_fDistanceFieldResolution;
+    _fDistanceFieldPadding = r->_fDistanceFieldPadding;
+    _vDistanceFieldBodies.clear();
+    _distancefield.Clear();
+    _bDistanceFieldSampled = false;
+    _bBatchSphereApproximation = r->_bBatchSphereApproximation;
     RAVELOG_VERBOSE(str(boost::format("FCL User data cloning env %d into env %d") % r->GetEnv()->GetId() % GetEnv()->GetId()));
 }
 
+void FCLCollisionChecker::GetMemoryUsage(MemoryUsage& memoryusage) const
+{
+    CollisionCheckerBase::GetMemoryUsage(memoryusage);
+    // rough size of the node and bookkeeping of one object in a broadphase manager
+    static const uint64_t s_nBroadphaseObjectBytes = 128;
+    uint64_t managerbytes = 0;
+    FOREACHC(itmanager, _bodymanagers) {
+        managerbytes += sizeof(FCLCollisionManagerInstance) + (!!itmanager->second->GetManager() ? itmanager->second->GetManager()->size()*s_nBroadphaseObjectBytes : 0);
+    }
+    FOREACHC(itmanager, _envmanagers) {
+        managerbytes += sizeof(FCLCollisionManagerInstance) + (!!itmanager->second->GetManager() ? itmanager->second->GetManager()->size()*s_nBroadphaseObjectBytes : 0);
+    }
+    memoryusage.Add("managers", managerbytes);
+    if( !!_pvoxelobstacle ) {
+        memoryusage.Add("voxelobstacle", _pvoxelobstacle->GetNumVoxels()*(sizeof(fcl::CollisionObject) + sizeof(fcl::Box) + s_nBroadphaseObjectBytes));
+    }
+    memoryusage.Add("distancefield", _distancefield.GetNumCells()*sizeof(float));
+    memoryusage.Add("sharedbvhs", FCLMeshCache::GetInstance().GetStatistics().nBytes);
+}
+
 bool FCLCollisionChecker::SetCollisionOptions(int collision_options)
 {
     _options = collision_options;
@@ -189,14 +257,34 @@ bool FCLCollisionChecker::SetBroadphaseAlgorithmCommand(ostream& sout, istream&
 
 void FCLCollisionChecker::_SetBroadphaseAlgorithm(const std::string &algorithm)
 {
+    if( algorithm == "Auto" ) {
+        if( !_bAutoBroadphaseAlgorithm ) {
+            // start monitoring from the current algorithm
+            _bAutoBroadphaseAlgorithm = true;
+            _broadphaseSelector.Reset(_broadPhaseCollisionManagerAlgorithm);
+            _runtimeStatistics.SetBroadphaseAlgorithm(_broadPhaseCollisionManagerAlgorithm, true);
+        }
+        return;
+    }
+    _bAutoBroadphaseAlgorithm = false;
+    _bBroadphaseSwitchPending = false;
+    _runtimeStatistics.SetBroadphaseAlgorithm(_broadPhaseCollisionManagerAlgorithm, false);
     if(_broadPhaseCollisionManagerAlgorithm == algorithm) {
         return;
     }
+    _ResetManagers(algorithm);
+}
+
+void FCLCollisionChecker::_ResetManagers(const std::string& algorithm)
+{
     _broadPhaseCollisionManagerAlgorithm = algorithm;
+    _runtimeStatistics.SetBroadphaseAlgorithm(algorithm, _bAutoBroadphaseAlgorithm);
 
     // clear all the current cached managers
     _bodymanagers.clear();
     _envmanagers.clear();
+    // fcl can only collide two managers of the same type
+    _pvoxelobstacle->SetManager(_CreateManager());
 }
 
 bool FCLCollisionChecker::_SetBVHRepresentation(ostream& sout, istream& sinput)
@@ -207,6 +295,370 @@ bool FCLCollisionChecker::_SetBVHRepresentation(ostream& sout, istream& sinput)
     return !!sinput;
 }
 
+bool FCLCollisionChecker::_SetUseMeshCacheCommand(ostream& sout, istream& sinput)
+{
+    bool bUseMeshCache = true;
+    sinput >> bUseMeshCache;
+    if( !sinput ) {
+        return false;
+    }
+    // only affects the geometries that are created afterwards
+    _fclspace->SetUseMeshCache(bUseMeshCache);
+    return true;
+}
+
+bool FCLCollisionChecker::_GetMeshCacheStatisticsCommand(ostream& sout, istream& sinput)
+{
+    const FCLMeshCache::Statistics statistics = FCLMeshCache::GetInstance().GetStatistics();
+    sout << statistics.nHits << " " << statistics.nMisses << " " << statistics.nBytesSaved << " " << statistics.nEntries;
+    return true;
+}
+
+bool FCLCollisionChecker::_SetUseConvexDecompositionCommand(ostream& sout, istream& sinput)
+{
+    bool bUseConvexDecomposition = true;
+    sinput >> bUseConvexDecomposition;
+    if( !sinput ) {
+        return false;
+    }
+    int numthreads = _fclspace->GetConvexDecompositionThreads();
+    ConvexDecompositionParameters params = _fclspace->GetConvexDecompositionParameters();
+    // all the trailing values are optional, read into copies since a failed extraction zeroes its target
+    int newnumthreads = 0;
+    if( sinput >> newnumthreads ) {
+        numthreads = newnumthreads;
+        ConvexDecompositionParameters newparams = params;
+        if( sinput >> newparams.nDecompositionDepth >> newparams.nMaxHullVertices >> newparams.fConcavityThresholdPercent >> newparams.fMergeThresholdPercent >> newparams.fVolumeSplitThresholdPercent ) {
+            params = newparams;
+        }
+    }
+    _fclspace->SetUseConvexDecomposition(bUseConvexDecomposition, params, numthreads);
+    return true;
+}
+
+bool FCLCollisionChecker::_GetConvexDecompositionCacheStatisticsCommand(ostream& sout, istream& sinput)
+{
+    const FCLConvexDecompositionCache::Statistics statistics = FCLConvexDecompositionCache::GetInstance().GetStatistics();
+    sout << statistics.nHits << " " << statistics.nMisses << " " << statistics.nEntries << " " << statistics.nHulls;
+    return true;
+}
+
+bool FCLCollisionChecker::_SetStatisticsEnabledCommand(ostream& sout, istream& sinput)
+{
+    bool bEnabled = true;
+    sinput >> bEnabled;
+    if( !sinput ) {
+        return false;
+    }
+    _runtimeStatistics.SetEnabled(bEnabled);
+    return true;
+}
+
+bool FCLCollisionChecker::_GetStatisticsCommand(ostream& sout, istream& sinput)
+{
+    _runtimeStatistics.WriteJSON(sout);
+    return true;
+}
+
+bool FCLCollisionChecker::_ResetStatisticsCommand(ostream& sout, istream& sinput)
+{
+    _runtimeStatistics.Reset();
+    return true;
+}
+
+bool FCLCollisionChecker::_SetUseSharedEnvManagerCommand(ostream& sout, istream& sinput)
+{
+    bool bUseSharedEnvManager = true;
+    sinput >> bUseSharedEnvManager;
+    if( !sinput ) {
+        return false;
+    }
+    _bUseSharedEnvManager = bUseSharedEnvManager;
+    return true;
+}
+
+bool FCLCollisionChecker::_SetCoherentDistanceCommand(ostream& sout, istream& sinput)
+{
+    bool bCoherentDistance = false;
+    sinput >> bCoherentDistance;
+    if( !sinput ) {
+        return false;
+    }
+    _bCoherentDistance = bCoherentDistance;
+    _coherentDistanceCache.clear();
+    return true;
+}
+
+bool FCLCollisionChecker::_SetContinuousCollisionStepCommand(ostream& sout, istream& sinput)
+{
+    OpenRAVE::dReal fStep = 0;
+    sinput >> fStep;
+    if( !sinput || fStep <= 0 ) {
+        return false;
+    }
+    _fContinuousCollisionStep = fStep;
+    return true;
+}
+
+bool FCLCollisionChecker::_SetVoxelObstacleResolutionCommand(ostream& sout, istream& sinput)
+{
+    OpenRAVE::dReal resolution = 0;
+    sinput >> resolution;
+    if( !sinput || resolution <= 0 ) {
+        return false;
+    }
+    _pvoxelobstacle->SetResolution(resolution);
+    return true;
+}
+
+bool FCLCollisionChecker::_ClearVoxelObstacleCommand(ostream& sout, istream& sinput)
+{
+    _pvoxelobstacle->Clear();
+    return true;
+}
+
+bool FCLCollisionChecker::_GetVoxelObstacleNumVoxelsCommand(ostream& sout, istream& sinput)
+{
+    sout << _pvoxelobstacle->GetNumVoxels();
+    return true;
+}
+
+bool FCLCollisionChecker::_InsertVoxelObstaclePointsTypedCommand(InterfaceBase& interfacebase, const TypedCommandData& input, TypedCommandData& output)
+{
+    if( input.vrealvalues.size() % 3 != 0 ) {
+        return false;
+    }
+    FCLCollisionChecker& checker = static_cast<FCLCollisionChecker&>(interfacebase);
+    const size_t numpoints = input.vrealvalues.size()/3;
+    output.vintvalues.push_back(numpoints > 0 ? checker._pvoxelobstacle->InsertPoints(&input.vrealvalues[0], numpoints) : 0);
+    return true;
+}
+
+bool FCLCollisionChecker::_ClearVoxelObstaclePointsTypedCommand(InterfaceBase& interfacebase, const TypedCommandData& input, TypedCommandData& output)
+{
+    if( input.vrealvalues.size() % 3 != 0 ) {
+        return false;
+    }
+    FCLCollisionChecker& checker = static_cast<FCLCollisionChecker&>(interfacebase);
+    const size_t numpoints = input.vrealvalues.size()/3;
+    output.vintvalues.push_back(numpoints > 0 ? checker._pvoxelobstacle->ClearPoints(&input.vrealvalues[0], numpoints) : 0);
+    return true;
+}
+
+bool FCLCollisionChecker::_SetDistanceFieldCommand(ostream& sout, istream& sinput)
+{
+    OpenRAVE::dReal resolution = 0, padding = 0;
+    sinput >> resolution >> padding;
+    if( !sinput || resolution <= 0 || padding < 0 ) {
+        return false;
+    }
+    _fDistanceFieldResolution = resolution;
+    _fDistanceFieldPadding = padding;
+    _vDistanceFieldBodyNames.clear();
+    std::string bodyname;
+    while( sinput >> bodyname ) {
+        _vDistanceFieldBodyNames.push_back(bodyname);
+    }
+    _vDistanceFieldBodies.clear();
+    _distancefield.Clear();
+    _bDistanceFieldSampled = false;
+    return true;
+}
+
+bool FCLCollisionChecker::_SetBatchSphereApproximationCommand(ostream& sout, istream& sinput)
+{
+    bool bBatchSphereApproximation = false;
+    sinput >> bBatchSphereApproximation;
+    if( !sinput ) {
+        return false;
+    }
+    _bBatchSphereApproximation = bBatchSphereApproximation;
+    return true;
+}
+
+bool FCLCollisionChecker::_GetDistanceFieldDistancesTypedCommand(InterfaceBase& interfacebase, const TypedCommandData& input, TypedCommandData& output)
+{
+    if( input.vrealvalues.size() % 3 != 0 ) {
+        return false;
+    }
+    FCLCollisionChecker& checker = static_cast<FCLCollisionChecker&>(interfacebase);
+    checker._fclspace->Synchronize();
+    if( !checker._UpdateDistanceField() ) {
+        return false;
+    }
+    output.vrealvalues.resize(4*(input.vrealvalues.size()/3));
+    for(size_t ipoint = 0; 3*ipoint < input.vrealvalues.size(); ++ipoint) {
+        const OpenRAVE::dReal* pxyz = &input.vrealvalues[3*ipoint];
+        Vector vgradient;
+        output.vrealvalues[4*ipoint] = checker._distancefield.GetDistance(Vector(pxyz[0], pxyz[1], pxyz[2]), &vgradient);
+        output.vrealvalues[4*ipoint+1] = vgradient.x;
+        output.vrealvalues[4*ipoint+2] = vgradient.y;
+        output.vrealvalues[4*ipoint+3] = vgradient.z;
+    }
+    return true;
+}
+
+bool FCLCollisionChecker::_UpdateDistanceField()
+{
+    if( _vDistanceFieldBodyNames.empty() ) {
+        return false;
+    }
+    if( _bDistanceFieldSampled ) {
+        bool bChanged = false;
+        FOREACHC(itfieldbody, _vDistanceFieldBodies) {
+            const KinBodyConstPtr pbody = itfieldbody->pbody.lock();
+            const FCLSpace::FCLKinBodyInfoPtr pinfo = itfieldbody->pinfo.lock();
+            if( !pbody || !pinfo || _fclspace->GetInfo(*pbody) != pinfo || pbody->GetUpdateStamp() != itfieldbody->nUpdateStamp || pinfo->nGeometryUpdateStamp != itfieldbody->nGeometryUpdateStamp ) {
+                bChanged = true;
+                break;
+            }
+        }
+        if( !bChanged ) {
+            return !_distancefield.IsEmpty();
+        }
+    }
+
+    // all the links are sampled, even the disabled ones, so that enabling a link cannot make the field wrong
+    _vDistanceFieldBodies.clear();
+    _vDistanceFieldObjectsCache.clear();
+    for (const KinBodyConstPtr& pbody : _fclspace->GetEnvBodies()) {
+        if( !pbody || find(_vDistanceFieldBodyNames.begin(), _vDistanceFieldBodyNames.end(), pbody->GetName()) == _vDistanceFieldBodyNames.end() ) {
+            continue;
+        }
+        const FCLSpace::FCLKinBodyInfoPtr& pinfo = _fclspace->GetInfo(*pbody);
+        if( !pinfo ) {
+            continue;
+        }
+        DistanceFieldBody fieldbody;
+        fieldbody.pbody = pbody;
+        fieldbody.pinfo = pinfo;
+        fieldbody.nUpdateStamp = pbody->GetUpdateStamp();
+        fieldbody.nGeometryUpdateStamp = pinfo->nGeometryUpdateStamp;
+        _vDistanceFieldBodies.push_back(fieldbody);
+        FOREACHC(itlink, pinfo->vlinks) {
+            FOREACHC(itgeompair, (*itlink)->vgeoms) {
+                _vDistanceFieldObjectsCache.push_back(itgeompair->second.get());
+            }
+        }
+    }
+    const uint64_t starttime = OpenRAVE::utils::GetMicroTime();
+    _bDistanceFieldSampled = true;
+    try {
+        _distancefield.Build(_vDistanceFieldObjectsCache, _fDistanceFieldResolution, _fDistanceFieldPadding);
+    }
+    catch(const OpenRAVE::openrave_exception& ex) {
+        // the queries fall back to checking the bodies until one of them changes
+        RAVELOG_WARN_FORMAT("env=%s, failed to sample the distance field: %s", GetEnv()->GetNameId()%ex.what());
+        _distancefield.Clear();
+    }
+    RAVELOG_DEBUG_FORMAT("env=%s, sampled the distance field of %d bodies (%d geometries) in %d[us]", GetEnv()->GetNameId()%_vDistanceFieldBodies.size()%_vDistanceFieldObjectsCache.size()%(OpenRAVE::utils::GetMicroTime() - starttime));
+    return !_distancefield.IsEmpty();
+}
+
+bool FCLCollisionChecker::_IsAwayFromDistanceField(FCLSpace::FCLKinBodyInfo::LinkInfo& linkinfo)
+{
+    const CollisionObjectPtr& plinkbv = linkinfo.linkBV.second;
+    if( !plinkbv ) {
+        return true; // no geometry
+    }
+    const fcl::AABB& ab = plinkbv->getAABB();
+    if( _distancefield.GetLowerBoundDistance(ConvertVectorFromFCL(ab.center())) > 0.5*(ab.max_ - ab.min_).length() ) {
+        return true;
+    }
+    const KinBody::LinkPtr plink = linkinfo.GetLink();
+    if( !plink ) {
+        return false;
+    }
+    const Transform& tlink = plink->GetTransform();
+    const std::vector<Vector>& vspheres = linkinfo.GetCoveringSpheres();
+    if( vspheres.empty() ) {
+        return false;
+    }
+    FOREACHC(itsphere, vspheres) {
+        if( _distancefield.GetLowerBoundDistance(tlink*(*itsphere)) <= itsphere->w ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FCLCollisionChecker::_AreSpheresAwayFromDistanceField(const std::vector<int>& vattachedBodyIndices)
+{
+    const std::vector<KinBodyConstPtr>& venvbodies = _fclspace->GetEnvBodies();
+    FOREACHC(itindex, vattachedBodyIndices) {
+        if( *itindex < 0 || *itindex >= (int)venvbodies.size() || !venvbodies[*itindex] ) {
+            continue;
+        }
+        const FCLSpace::FCLKinBodyInfoPtr& pinfo = _fclspace->GetInfo(*venvbodies[*itindex]);
+        if( !pinfo ) {
+            continue;
+        }
+        FOREACHC(itlink, pinfo->vlinks) {
+            const KinBody::LinkPtr plink = (*itlink)->GetLink();
+            if( !(*itlink)->linkBV.second || !plink || !plink->IsEnabled() ) {
+                continue;
+            }
+            const std::vector<Vector>& vspheres = (*itlink)->GetCoveringSpheres();
+            if( vspheres.empty() ) {
+                return false;
+            }
+            const Transform& tlink = plink->GetTransform();
+            FOREACHC(itsphere, vspheres) {
+                if( _distancefield.GetLowerBoundDistance(tlink*(*itsphere)) <= itsphere->w ) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+const std::vector<KinBodyConstPtr>& FCLCollisionChecker::_GetDistanceFieldExcludedBodies(const std::vector<int>& vattachedBodyIndices, const std::vector<KinBodyConstPtr>& vbodyexcluded)
+{
+    // the distance queries need the distance to the bodies of the field
+    if( (_options & OpenRAVE::CO_Distance) || !_UpdateDistanceField() ) {
+        return vbodyexcluded;
+    }
+    const std::vector<KinBodyConstPtr>& venvbodies = _fclspace->GetEnvBodies();
+    FOREACHC(itindex, vattachedBodyIndices) {
+        if( *itindex < 0 || *itindex >= (int)venvbodies.size() || !venvbodies[*itindex] ) {
+            continue;
+        }
+        const FCLSpace::FCLKinBodyInfoPtr& pinfo = _fclspace->GetInfo(*venvbodies[*itindex]);
+        if( !pinfo ) {
+            continue;
+        }
+        FOREACHC(itlink, pinfo->vlinks) {
+            if( !_IsAwayFromDistanceField(**itlink) ) {
+                return vbodyexcluded;
+            }
+        }
+    }
+    _vDistanceFieldExcludedBodiesCache = vbodyexcluded;
+    FOREACHC(itfieldbody, _vDistanceFieldBodies) {
+        const KinBodyConstPtr pbody = itfieldbody->pbody.lock();
+        if( !!pbody ) {
+            _vDistanceFieldExcludedBodiesCache.push_back(pbody);
+        }
+    }
+    return _vDistanceFieldExcludedBodiesCache;
+}
+
+const std::vector<KinBodyConstPtr>& FCLCollisionChecker::_GetDistanceFieldExcludedBodies(FCLSpace::FCLKinBodyInfo::LinkInfo& linkinfo, const std::vector<KinBodyConstPtr>& vbodyexcluded)
+{
+    if( (_options & OpenRAVE::CO_Distance) || !_UpdateDistanceField() || !_IsAwayFromDistanceField(linkinfo) ) {
+        return vbodyexcluded;
+    }
+    _vDistanceFieldExcludedBodiesCache = vbodyexcluded;
+    FOREACHC(itfieldbody, _vDistanceFieldBodies) {
+        const KinBodyConstPtr pbody = itfieldbody->pbody.lock();
+        if( !!pbody ) {
+            _vDistanceFieldExcludedBodiesCache.push_back(pbody);
+        }
+    }
+    return _vDistanceFieldExcludedBodiesCache;
+}
+
 bool FCLCollisionChecker::InitEnvironment()
 {
     RAVELOG_VERBOSE(str(boost::format("FCL User data initializing %s in env %d") % _userdatakey % GetEnv()->GetId()));
@@ -224,6 +676,7 @@ void FCLCollisionChecker::DestroyEnvironment()
 {
     RAVELOG_VERBOSE(str(boost::format("FCL User data destroying %s in env %d") % _userdatakey % GetEnv()->GetId()));
     _fclspace->DestroyEnvironment();
+    _coherentDistanceCache.clear();
 }
 
 bool FCLCollisionChecker::InitKinBody(OpenRAVE::KinBodyPtr pbody)
@@ -232,6 +685,8 @@ bool FCLCollisionChecker::InitKinBody(OpenRAVE::KinBodyPtr pbody)
     FCLSpace::FCLKinBodyInfoPtr pinfo = _fclspace->GetInfo(*pbody);
     if( !pinfo || pinfo->GetBody() != pbody ) {
         pinfo = _fclspace->InitKinBody(pbody);
+        // new collision objects can reuse the addresses of deleted ones
+        _coherentDistanceCache.clear();
     }
     return !pinfo;
 }
@@ -241,8 +696,8 @@ void FCLCollisionChecker::RemoveKinBody(OpenRAVE::KinBodyPtr pbody)
     const OpenRAVE::KinBody& body = *pbody;
 
     // remove body from all the managers
-    _bodymanagers.erase(std::make_pair(pbody.get(), (int)0));
-    _bodymanagers.erase(std::make_pair(pbody.get(), (int)1));
+    // including the managers of all the active DOF profiles of the body
+    _bodymanagers.erase(_bodymanagers.lower_bound(std::make_pair(pbody.get(), std::numeric_limits<int>::min())), _bodymanagers.upper_bound(std::make_pair(pbody.get(), std::numeric_limits<int>::max())));
     for (BODYMANAGERSMAP::iterator it = _bodymanagers.begin();
          it != _bodymanagers.end(); ++it) {
         it->second->RemoveBody(body);
@@ -273,14 +728,19 @@ void FCLCollisionChecker::RemoveKinBody(OpenRAVE::KinBodyPtr pbody)
 
 bool FCLCollisionChecker::CheckCollision(KinBodyConstPtr pbody1, CollisionReportPtr report)
 {
+    OPENRAVE_TRACE_SCOPE("FCLCollisionChecker::CheckCollision");
     START_TIMING_OPT(_statistics, "Body/Env",_options,pbody1->IsRobot());
+    FCLRuntimeStatistics::QueryTiming runtimetiming(_runtimeStatistics, FCLRuntimeStatistics::QT_BodyEnv);
     // TODO : tailor this case when stuff become stable enough
     return CheckCollision(pbody1, std::vector<KinBodyConstPtr>(), std::vector<LinkConstPtr>(), report);
 }
 
 bool FCLCollisionChecker::CheckCollision(KinBodyConstPtr pbody1, KinBodyConstPtr pbody2, CollisionReportPtr report)
 {
+    OPENRAVE_TRACE_SCOPE("FCLCollisionChecker::CheckCollision");
     START_TIMING_OPT(_statistics, "Body/Body",_options,(pbody1->IsRobot() || pbody2->IsRobot()));
+    FCLRuntimeStatistics::QueryTiming runtimetiming(_runtimeStatistics, FCLRuntimeStatistics::QT_BodyBody);
+    _UpdateAutoBroadphaseAlgorithm();
     if( !!report ) {
         report->Reset(_options);
     }
@@ -324,14 +784,18 @@ bool FCLCollisionChecker::CheckCollision(KinBodyConstPtr pbody1, KinBodyConstPtr
 
 bool FCLCollisionChecker::CheckCollision(LinkConstPtr plink,CollisionReportPtr report)
 {
+    OPENRAVE_TRACE_SCOPE("FCLCollisionChecker::CheckCollision");
     START_TIMING_OPT(_statistics, "Link/Env",_options,false);
+    FCLRuntimeStatistics::QueryTiming runtimetiming(_runtimeStatistics, FCLRuntimeStatistics::QT_LinkEnv);
     // TODO : tailor this case when stuff become stable enough
     return CheckCollision(plink, std::vector<KinBodyConstPtr>(), std::vector<LinkConstPtr>(), report);
 }
 
 bool FCLCollisionChecker::CheckCollision(LinkConstPtr plink1, LinkConstPtr plink2, CollisionReportPtr report)
 {
+    OPENRAVE_TRACE_SCOPE("FCLCollisionChecker::CheckCollision");
     START_TIMING_OPT(_statistics, "Link/Link",_options,false);
+    FCLRuntimeStatistics::QueryTiming runtimetiming(_runtimeStatistics, FCLRuntimeStatistics::QT_LinkLink);
     if( !!report ) {
         report->Reset(_options);
     }
@@ -381,7 +845,10 @@ bool FCLCollisionChecker::CheckCollision(LinkConstPtr plink1, LinkConstPtr plink
 
 bool FCLCollisionChecker::CheckCollision(LinkConstPtr plink, KinBodyConstPtr pbody,CollisionReportPtr report)
 {
+    OPENRAVE_TRACE_SCOPE("FCLCollisionChecker::CheckCollision");
     START_TIMING_OPT(_statistics, "Link/Body",_options,pbody->IsRobot());
+    FCLRuntimeStatistics::QueryTiming runtimetiming(_runtimeStatistics, FCLRuntimeStatistics::QT_LinkBody);
+    _UpdateAutoBroadphaseAlgorithm();
 
     if( !!report ) {
         report->Reset(_options);
@@ -428,6 +895,8 @@ bool FCLCollisionChecker::CheckCollision(LinkConstPtr plink, KinBodyConstPtr pbo
 
 bool FCLCollisionChecker::CheckCollision(LinkConstPtr plink, std::vector<KinBodyConstPtr> const &vbodyexcluded, std::vector<LinkConstPtr> const &vlinkexcluded, CollisionReportPtr report)
 {
+    OPENRAVE_TRACE_SCOPE("FCLCollisionChecker::CheckCollision");
+    _UpdateAutoBroadphaseAlgorithm();
     if( !!report ) {
         report->Reset(_options);
     }
@@ -446,7 +915,8 @@ bool FCLCollisionChecker::CheckCollision(LinkConstPtr plink, std::vector<KinBody
     plink->GetParent()->GetAttachedEnvironmentBodyIndices(_attachedBodyIndicesCache);
     FCLCollisionManagerInstance& envManager = _GetEnvManager(_attachedBodyIndicesCache);
 
-    CollisionCallbackData query(shared_checker(), report, vbodyexcluded, vlinkexcluded);
+    CollisionCallbackData query(shared_checker(), report, _GetDistanceFieldExcludedBodies(*_fclspace->GetLinkInfo(*plink), vbodyexcluded), vlinkexcluded);
+    query._pvExcludedBodyMask = &_vSharedEnvExcludedBodyMask;
     if( _options & OpenRAVE::CO_Distance ) {
         if(!report) {
             throw openrave_exception("FCLCollision - ERROR: YOU MUST PASS IN A CollisionReport STRUCT TO MEASURE DISTANCE!\n");
@@ -458,11 +928,14 @@ bool FCLCollisionChecker::CheckCollision(LinkConstPtr plink, std::vector<KinBody
     boost::shared_ptr<void> onexit((void*) 0, boost::bind(&FCLCollisionChecker::_PrintCollisionManagerInstanceLE, this, boost::ref(*plink), boost::ref(envManager)));
 #endif
     envManager.GetManager()->collide(pcollLink.get(), &query, &FCLCollisionChecker::CheckNarrowPhaseCollision);
+    _CheckVoxelObstacle(pcollLink.get(), query);
     return query._bCollision;
 }
 
 bool FCLCollisionChecker::CheckCollision(KinBodyConstPtr pbody, std::vector<KinBodyConstPtr> const &vbodyexcluded, std::vector<LinkConstPtr> const &vlinkexcluded, CollisionReportPtr report)
 {
+    OPENRAVE_TRACE_SCOPE("FCLCollisionChecker::CheckCollision");
+    _UpdateAutoBroadphaseAlgorithm();
     if( !!report ) {
         report->Reset(_options);
     }
@@ -478,7 +951,8 @@ bool FCLCollisionChecker::CheckCollision(KinBodyConstPtr pbody, std::vector<KinB
     pbody->GetAttachedEnvironmentBodyIndices(attachedBodyIndices);
     FCLCollisionManagerInstance& envManager = _GetEnvManager(attachedBodyIndices);
 
-    CollisionCallbackData query(shared_checker(), report, vbodyexcluded, vlinkexcluded);
+    CollisionCallbackData query(shared_checker(), report, _GetDistanceFieldExcludedBodies(attachedBodyIndices, vbodyexcluded), vlinkexcluded);
+    query._pvExcludedBodyMask = &_vSharedEnvExcludedBodyMask;
     if( _options & OpenRAVE::CO_Distance ) {
         if(!report) {
             throw openrave_exception("FCLCollision - ERROR: YOU MUST PASS IN A CollisionReport STRUCT TO MEASURE DISTANCE!\n");
@@ -490,30 +964,475 @@ bool FCLCollisionChecker::CheckCollision(KinBodyConstPtr pbody, std::vector<KinB
     boost::shared_ptr<void> onexit((void*) 0, boost::bind(&FCLCollisionChecker::_PrintCollisionManagerInstanceBE, this, boost::ref(*pbody), boost::ref(bodyManager), boost::ref(envManager)));
 #endif
     envManager.GetManager()->collide(bodyManager.GetManager().get(), &query, &FCLCollisionChecker::CheckNarrowPhaseCollision);
+    _CheckVoxelObstacle(bodyManager.GetManager().get(), query);
 
     return query._bCollision;
 }
 
+bool FCLCollisionChecker::CheckCollisionBatch(KinBodyPtr pbody, const OpenRAVE::dReal* pConfigurations, size_t nConfigurations, int dofstride, std::vector<uint8_t>& vresults, CollisionReportPtr report)
+{
+    START_TIMING_OPT(_statistics, "BodyBatch/Env",_options,pbody->IsRobot());
+    FCLRuntimeStatistics::QueryTiming runtimetiming(_runtimeStatistics, FCLRuntimeStatistics::QT_BodyBatchEnv);
+    _UpdateAutoBroadphaseAlgorithm();
+    const int dof = pbody->GetDOF();
+    OPENRAVE_ASSERT_OP_FORMAT(dofstride, >=, dof, "body %s has %d dofs, so the configuration stride is too small", pbody->GetName()%dof, OpenRAVE::ORE_InvalidArguments);
+    vresults.resize(nConfigurations);
+    std::fill(vresults.begin(), vresults.end(), 0);
+    if( !!report ) {
+        report->Reset(_options);
+    }
+
+    if( nConfigurations == 0 || (pbody->GetLinks().size() == 0) || !_IsEnabled(*pbody) ) {
+        return false;
+    }
+
+    KinBody::KinBodyStateSaverRef saver(*pbody, KinBody::Save_LinkTransformation);
+
+    // only pbody and its attached bodies move inside the batch, so the rest of the scene and the environment manager are synchronized once
+    _fclspace->Synchronize();
+    pbody->GetAttachedEnvironmentBodyIndices(_attachedBodyIndicesCache);
+    FCLCollisionManagerInstance& envManager = _GetEnvManager(_attachedBodyIndicesCache);
+    FCLCollisionManagerInstance& bodyManager = _GetBodyManager(pbody, !!(_options & OpenRAVE::CO_ActiveDOFs));
+#ifdef FCLRAVE_CHECKPARENTLESS
+    boost::shared_ptr<void> onexit((void*) 0, boost::bind(&FCLCollisionChecker::_PrintCollisionManagerInstanceBE, this, boost::ref(*pbody), boost::ref(bodyManager), boost::ref(envManager)));
+#endif
+
+    // with the sphere approximation, the configurations are first checked against the distance field from the link transforms alone. When the field holds all the other enabled bodies, the fcl objects are not even synchronized.
+    const bool bSphereApproximation = _bBatchSphereApproximation && !(_options & OpenRAVE::CO_Distance) && _UpdateDistanceField();
+    bool bDistanceFieldOnly = bSphereApproximation && _pvoxelobstacle->IsEmpty();
+    if( bDistanceFieldOnly ) {
+        const std::vector<KinBodyConstPtr>& venvbodies = _fclspace->GetEnvBodies();
+        for(int ibody = 0; ibody < (int)venvbodies.size() && bDistanceFieldOnly; ++ibody) {
+            const KinBodyConstPtr& potherbody = venvbodies[ibody];
+            if( !potherbody || !_IsEnabled(*potherbody) || find(_attachedBodyIndicesCache.begin(), _attachedBodyIndicesCache.end(), ibody) != _attachedBodyIndicesCache.end() ) {
+                continue;
+            }
+            bool bInField = false;
+            FOREACHC(itfieldbody, _vDistanceFieldBodies) {
+                if( itfieldbody->pbody.lock() == potherbody ) {
+                    bInField = true;
+                    break;
+                }
+            }
+            bDistanceFieldOnly = bInField;
+        }
+    }
+
+    const std::vector<KinBodyConstPtr> vbodyexcluded;
+    const std::vector<LinkConstPtr> vlinkexcluded;
+    bool bAnyCollision = false;
+    for(size_t iconfig = 0; iconfig < nConfigurations; ++iconfig) {
+        pbody->SetDOFValues(pConfigurations + iconfig*dofstride, dof, KinBody::CLA_Nothing);
+        if( bSphereApproximation ) {
+            if( !_AreSpheresAwayFromDistanceField(_attachedBodyIndicesCache) ) {
+                vresults[iconfig] = 1;
+                bAnyCollision = true;
+                continue;
+            }
+            if( bDistanceFieldOnly ) {
+                continue;
+            }
+        }
+        _fclspace->SynchronizeWithAttached(*pbody);
+        bodyManager.Synchronize();
+
+        // only the first colliding configuration fills the report
+        CollisionCallbackData query(shared_checker(), bAnyCollision ? CollisionReportPtr() : report, _GetDistanceFieldExcludedBodies(_attachedBodyIndicesCache, vbodyexcluded), vlinkexcluded);
+        query._pvExcludedBodyMask = &_vSharedEnvExcludedBodyMask;
+        ADD_TIMING(_statistics);
+        envManager.GetManager()->collide(bodyManager.GetManager().get(), &query, &FCLCollisionChecker::CheckNarrowPhaseCollision);
+        _CheckVoxelObstacle(bodyManager.GetManager().get(), query);
+        if( query._bCollision ) {
+            vresults[iconfig] = 1;
+            bAnyCollision = true;
+        }
+    }
+    return bAnyCollision;
+}
+
+/// \brief true if conservative advancement can handle the geometry
+static inline bool _IsContinuousCollisionPrimitive(const fcl::CollisionObject& coll)
+{
+    switch( coll.getNodeType() ) {
+    case fcl::GEOM_BOX:
+    case fcl::GEOM_SPHERE:
+    case fcl::GEOM_CYLINDER:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool FCLCollisionChecker::CheckContinuousCollision(KinBodyPtr pbody, const std::vector<OpenRAVE::dReal>& vStartConfig, const std::vector<OpenRAVE::dReal>& vEndConfig, OpenRAVE::IntervalType interval, CollisionReportPtr report)
+{
+    START_TIMING_OPT(_statistics, "BodyContinuous/Env",_options,pbody->IsRobot());
+    FCLRuntimeStatistics::QueryTiming runtimetiming(_runtimeStatistics, FCLRuntimeStatistics::QT_BodyContinuousEnv);
+    const int dof = pbody->GetDOF();
+    OPENRAVE_ASSERT_OP((int)vStartConfig.size(), ==, dof);
+    OPENRAVE_ASSERT_OP((int)vEndConfig.size(), ==, dof);
+    if( !!report ) {
+        report->Reset(_options);
+    }
+
+    if( (pbody->GetLinks().size() == 0) || !_IsEnabled(*pbody) ) {
+        return false;
+    }
+
+    // conservative advancement reports the first contact of every pair, it cannot let callbacks ignore it or restrict the check to the links moved by the active dofs
+    if( (_options & OpenRAVE::CO_ActiveDOFs) || (!(_options & OpenRAVE::CO_IgnoreCallbacks) && GetEnv()->HasRegisteredCollisionCallbacks()) ) {
+        return CollisionCheckerBase::CheckContinuousCollision(pbody, vStartConfig, vEndConfig, interval, report);
+    }
+
+    KinBody::KinBodyStateSaverRef saver(*pbody, KinBody::Save_LinkTransformation);
+
+    // a contact at an excluded end point cannot be told apart from a contact right after it, so only continue when the excluded end points are free
+    const int intervalmask = interval & OpenRAVE::IT_IntervalMask;
+    if( intervalmask == OpenRAVE::IT_Open || intervalmask == OpenRAVE::IT_OpenEnd ) {
+        pbody->SetDOFValues(vEndConfig, KinBody::CLA_Nothing);
+        if( CheckCollision(KinBodyConstPtr(pbody)) ) {
+            return CollisionCheckerBase::CheckContinuousCollision(pbody, vStartConfig, vEndConfig, interval, report);
+        }
+    }
+    pbody->SetDOFValues(vStartConfig, KinBody::CLA_Nothing);
+    if( intervalmask == OpenRAVE::IT_Open || intervalmask == OpenRAVE::IT_OpenStart ) {
+        if( CheckCollision(KinBodyConstPtr(pbody)) ) {
+            return CollisionCheckerBase::CheckContinuousCollision(pbody, vStartConfig, vEndConfig, interval, report);
+        }
+    }
+
+    _vContinuousDeltaCache = vEndConfig;
+    pbody->SubtractDOFValues(_vContinuousDeltaCache, vStartConfig);
+    OpenRAVE::dReal fMaxDelta = 0;
+    FOREACHC(itdelta, _vContinuousDeltaCache) {
+        fMaxDelta = max(fMaxDelta, RaveFabs(*itdelta));
+    }
+    const int numSteps = max(1, (int)ceil(fMaxDelta/_fContinuousCollisionStep));
+
+    // split the geometries of the scene into the ones moving with pbody and the static ones
+    _fclspace->Synchronize();
+    pbody->GetAttachedEnvironmentBodyIndices(_attachedBodyIndicesCache);
+    _vContinuousMovingGeometries.clear();
+    _vContinuousStaticObjects.clear();
+    for (const KinBodyConstPtr& pother : _fclspace->GetEnvBodies()) {
+        if( !pother || !pother->IsEnabled() ) {
+            continue;
+        }
+        const FCLSpace::FCLKinBodyInfoPtr& pinfo = _fclspace->GetInfo(*pother);
+        if( !pinfo ) {
+            continue;
+        }
+        const bool bMoving = std::binary_search(_attachedBodyIndicesCache.begin(), _attachedBodyIndicesCache.end(), pother->GetEnvironmentBodyIndex());
+        for(size_t ilink = 0; ilink < pinfo->vlinks.size(); ++ilink) {
+            if( !pother->GetLinks().at(ilink)->IsEnabled() ) {
+                continue;
+            }
+            for (const TransformCollisionPair& geompair : pinfo->vlinks[ilink]->vgeoms) {
+                if( bMoving ) {
+                    ContinuousMovingGeometry movinggeom;
+                    movinggeom.pcoll = geompair.second.get();
+                    movinggeom.tprev = movinggeom.pcoll->getTransform();
+                    movinggeom.aabbprev = movinggeom.pcoll->getAABB();
+                    _vContinuousMovingGeometries.push_back(movinggeom);
+                }
+                else {
+                    _vContinuousStaticObjects.push_back(geompair.second.get());
+                }
+            }
+        }
+    }
+
+    const fcl::ContinuousCollisionRequest request(10, 1e-4, fcl::CCDM_SCREW, fcl::GST_LIBCCD, fcl::CCDC_CONSERVATIVE_ADVANCEMENT);
+    fcl::ContinuousCollisionResult result;
+    _vContinuousConfigCache.resize(dof);
+    for(int istep = 1; istep <= numSteps; ++istep) {
+        const OpenRAVE::dReal t = OpenRAVE::dReal(istep)/OpenRAVE::dReal(numSteps);
+        for(int idof = 0; idof < dof; ++idof) {
+            _vContinuousConfigCache[idof] = vStartConfig[idof] + t*_vContinuousDeltaCache[idof];
+        }
+        pbody->SetDOFValues(_vContinuousConfigCache, KinBody::CLA_Nothing);
+        _fclspace->SynchronizeWithAttached(*pbody);
+
+        for (ContinuousMovingGeometry& movinggeom : _vContinuousMovingGeometries) {
+            // bound the screw motion by the boxes at both poses inflated by the rotation of the geometry around its center
+            fcl::AABB aabbswept = movinggeom.aabbprev + movinggeom.pcoll->getAABB();
+            const fcl::FCL_REAL radius = movinggeom.pcoll->collisionGeometry()->aabb_radius;
+            aabbswept.expand(fcl::Vec3f(radius, radius, radius));
+
+            for (fcl::CollisionObject* pstatic : _vContinuousStaticObjects) {
+                if( !aabbswept.overlap(pstatic->getAABB()) ) {
+                    continue;
+                }
+                if( !_IsContinuousCollisionPrimitive(*movinggeom.pcoll) || !_IsContinuousCollisionPrimitive(*pstatic) ) {
+                    RAVELOG_VERBOSE_FORMAT("env=%s, body %s sweeps geometries not supported by conservative advancement, discretizing the motion", GetEnv()->GetNameId()%pbody->GetName());
+                    return CollisionCheckerBase::CheckContinuousCollision(pbody, vStartConfig, vEndConfig, interval, report);
+                }
+
+                ADD_TIMING(_statistics);
+                result = fcl::ContinuousCollisionResult();
+                fcl::continuousCollide(movinggeom.pcoll->collisionGeometry().get(), movinggeom.tprev, movinggeom.pcoll->getTransform(), pstatic->collisionGeometry().get(), pstatic->getTransform(), pstatic->getTransform(), request, result);
+                if( result.is_collide ) {
+                    if( !!report ) {
+                        LinkConstPtr plink1 = GetCollisionLink(*movinggeom.pcoll).second, plink2 = GetCollisionLink(*pstatic).second;
+                        GeometryConstPtr pgeom1 = GetCollisionGeometry(*movinggeom.pcoll).second, pgeom2 = GetCollisionGeometry(*pstatic).second;
+                        report->SetLinkGeomCollision(plink1, pgeom1, plink2, pgeom2);
+                    }
+                    return true;
+                }
+            }
+            movinggeom.tprev = movinggeom.pcoll->getTransform();
+            movinggeom.aabbprev = movinggeom.pcoll->getAABB();
+        }
+    }
+    return false;
+}
+
 bool FCLCollisionChecker::CheckCollision(const RAY& ray, LinkConstPtr plink,CollisionReportPtr report)
 {
+    OPENRAVE_TRACE_SCOPE("FCLCollisionChecker::CheckCollision");
     RAVELOG_WARN("fcl doesn't support Ray collisions\n");
     return false; //TODO
 }
 
 bool FCLCollisionChecker::CheckCollision(const RAY& ray, KinBodyConstPtr pbody, CollisionReportPtr report)
 {
+    OPENRAVE_TRACE_SCOPE("FCLCollisionChecker::CheckCollision");
     RAVELOG_WARN("fcl doesn't support Ray collisions\n");
     return false; //TODO
 }
 
 bool FCLCollisionChecker::CheckCollision(const RAY& ray, CollisionReportPtr report)
 {
-    RAVELOG_WARN("fcl doesn't support Ray collisions\n");
-    return false; //TODO
+    OPENRAVE_TRACE_SCOPE("FCLCollisionChecker::CheckCollision");
+    _vRayCache.resize(1);
+    _vRayCache[0] = ray;
+    const bool bHit = CheckCollisionRays(_vRayCache, _vRayReportsCache) > 0;
+    if( !!report ) {
+        *report = _vRayReportsCache[0];
+    }
+    return bHit;
+}
+
+/// \brief intersects the segment origin + s*dir, s in [0, t], with the box [vmin, vmax]. On a hit, t is set to the entry parameter, 0 if the origin is inside.
+static inline bool _IntersectRayBox(const fcl::Vec3f& origin, const fcl::Vec3f& dir, const fcl::Vec3f& vmin, const fcl::Vec3f& vmax, fcl::FCL_REAL& t)
+{
+    fcl::FCL_REAL tenter = 0, texit = t;
+    for(int i = 0; i < 3; ++i) {
+        if( std::abs(dir[i]) < 1e-15 ) {
+            if( origin[i] < vmin[i] || origin[i] > vmax[i] ) {
+                return false;
+            }
+            continue;
+        }
+        fcl::FCL_REAL t0 = (vmin[i] - origin[i])/dir[i], t1 = (vmax[i] - origin[i])/dir[i];
+        if( t0 > t1 ) {
+            std::swap(t0, t1);
+        }
+        tenter = std::max(tenter, t0);
+        texit = std::min(texit, t1);
+        if( tenter > texit ) {
+            return false;
+        }
+    }
+    t = tenter;
+    return true;
+}
+
+/// \brief same as _IntersectRayBox for a sphere centered at the origin
+static inline bool _IntersectRaySphere(const fcl::Vec3f& origin, const fcl::Vec3f& dir, fcl::FCL_REAL radius, fcl::FCL_REAL& t)
+{
+    const fcl::FCL_REAL c = origin.sqrLength() - radius*radius;
+    if( c <= 0 ) {
+        t = 0;
+        return true;
+    }
+    const fcl::FCL_REAL a = dir.sqrLength(), b = origin.dot(dir);
+    const fcl::FCL_REAL discriminant = b*b - a*c;
+    if( a <= 0 || b >= 0 || discriminant < 0 ) {
+        return false;
+    }
+    const fcl::FCL_REAL thit = (-b - std::sqrt(discriminant))/a;
+    if( thit > t ) {
+        return false;
+    }
+    t = thit;
+    return true;
+}
+
+/// \brief same as _IntersectRayBox for a cylinder along z centered at the origin, the intersection of the slab |z| <= halfheight and the infinite cylinder
+static inline bool _IntersectRayCylinder(const fcl::Vec3f& origin, const fcl::Vec3f& dir, fcl::FCL_REAL radius, fcl::FCL_REAL halfheight, fcl::FCL_REAL& t)
+{
+    fcl::FCL_REAL tenter = 0, texit = t;
+    if( std::abs(dir[2]) < 1e-15 ) {
+        if( std::abs(origin[2]) > halfheight ) {
+            return false;
+        }
+    }
+    else {
+        fcl::FCL_REAL t0 = (-halfheight - origin[2])/dir[2], t1 = (halfheight - origin[2])/dir[2];
+        if( t0 > t1 ) {
+            std::swap(t0, t1);
+        }
+        tenter = std::max(tenter, t0);
+        texit = std::min(texit, t1);
+    }
+
+    const fcl::FCL_REAL a = dir[0]*dir[0] + dir[1]*dir[1];
+    const fcl::FCL_REAL b = origin[0]*dir[0] + origin[1]*dir[1];
+    const fcl::FCL_REAL c = origin[0]*origin[0] + origin[1]*origin[1] - radius*radius;
+    if( a < 1e-30 ) {
+        if( c > 0 ) {
+            return false;
+        }
+    }
+    else {
+        const fcl::FCL_REAL discriminant = b*b - a*c;
+        if( discriminant < 0 ) {
+            return false;
+        }
+        const fcl::FCL_REAL fSqrtDiscriminant = std::sqrt(discriminant);
+        tenter = std::max(tenter, (-b - fSqrtDiscriminant)/a);
+        texit = std::min(texit, (-b + fSqrtDiscriminant)/a);
+    }
+    if( tenter > texit ) {
+        return false;
+    }
+    t = tenter;
+    return true;
+}
+
+/// \brief same as _IntersectRayBox for the geometry of a collision object, the ray is in world coordinates
+///
+/// Geometries without an exact test (convex, cone, capsule, ...) are approximated by their local AABB.
+static bool _IntersectRayGeometry(const fcl::CollisionObject& coll, MeshRayIntersector meshRayIntersector, const fcl::Vec3f& origin, const fcl::Vec3f& dir, fcl::FCL_REAL& t)
+{
+    const fcl::Transform3f& tf = coll.getTransform();
+    const fcl::Matrix3f& R = tf.getRotation();
+    const fcl::Vec3f vdelta = origin - tf.getTranslation();
+    const fcl::Vec3f localorigin(R.getColumn(0).dot(vdelta), R.getColumn(1).dot(vdelta), R.getColumn(2).dot(vdelta));
+    const fcl::Vec3f localdir(R.getColumn(0).dot(dir), R.getColumn(1).dot(dir), R.getColumn(2).dot(dir));
+    const fcl::CollisionGeometry& geom = *coll.collisionGeometry();
+    switch(coll.getNodeType()) {
+    case fcl::GEOM_BOX: {
+        const fcl::Vec3f vhalfextents = static_cast<const fcl::Box&>(geom).side*0.5;
+        return _IntersectRayBox(localorigin, localdir, fcl::Vec3f(-vhalfextents[0], -vhalfextents[1], -vhalfextents[2]), vhalfextents, t);
+    }
+    case fcl::GEOM_SPHERE:
+        return _IntersectRaySphere(localorigin, localdir, static_cast<const fcl::Sphere&>(geom).radius, t);
+    case fcl::GEOM_CYLINDER: {
+        const fcl::Cylinder& cylinder = static_cast<const fcl::Cylinder&>(geom);
+        return _IntersectRayCylinder(localorigin, localdir, cylinder.radius, 0.5*cylinder.lz, t);
+    }
+    case fcl::BV_AABB:
+    case fcl::BV_OBB:
+    case fcl::BV_RSS:
+    case fcl::BV_kIOS:
+    case fcl::BV_OBBRSS:
+    case fcl::BV_KDOP16:
+    case fcl::BV_KDOP18:
+    case fcl::BV_KDOP24:
+        if( !!meshRayIntersector ) {
+            return meshRayIntersector(geom, localorigin, localdir, t);
+        }
+        break;
+    default:
+        break;
+    }
+    return _IntersectRayBox(localorigin, localdir, geom.aabb_local.min_, geom.aabb_local.max_, t);
+}
+
+int FCLCollisionChecker::CheckCollisionRays(const std::vector<RAY>& vrays, std::vector<CollisionReport>& vreports)
+{
+    _UpdateAutoBroadphaseAlgorithm();
+    vreports.resize(vrays.size());
+    for (CollisionReport& report : vreports) {
+        report.Reset(_options);
+    }
+    if( vrays.empty() ) {
+        return 0;
+    }
+
+    _fclspace->Synchronize();
+    static const std::vector<int> s_vNoExcludedBodyEnvIndices;
+    FCLCollisionManagerInstance& envManager = _GetEnvManager(s_vNoExcludedBodyEnvIndices);
+
+    // one pass over the broadphase collects the enabled geometries for all the rays
+    RayCandidates& candidates = _rayCandidates;
+    candidates.vobjects.clear();
+    for(int i = 0; i < 3; ++i) {
+        candidates.vmin[i].clear();
+        candidates.vmax[i].clear();
+    }
+    candidates.vlinkobjects.clear();
+    envManager.GetManager()->getObjects(candidates.vlinkobjects);
+    for (fcl::CollisionObject* plinkobject : candidates.vlinkobjects) {
+        const std::pair<FCLSpace::FCLKinBodyInfo::LinkInfo*, LinkConstPtr> linkinfo = GetCollisionLink(*plinkobject);
+        if( !linkinfo.first || !linkinfo.second || !linkinfo.second->IsEnabled() ) {
+            continue;
+        }
+        for (const TransformCollisionPair& geompair : linkinfo.first->vgeoms) {
+            const fcl::AABB& aabb = geompair.second->getAABB();
+            candidates.vobjects.push_back(geompair.second.get());
+            for(int i = 0; i < 3; ++i) {
+                candidates.vmin[i].push_back(aabb.min_[i]);
+                candidates.vmax[i].push_back(aabb.max_[i]);
+            }
+        }
+    }
+    const size_t numCandidates = candidates.vobjects.size();
+    candidates.vhits.resize(numCandidates);
+    const MeshRayIntersector meshRayIntersector = _fclspace->GetMeshRayIntersector();
+
+    int numHits = 0;
+    for(size_t iray = 0; iray < vrays.size(); ++iray) {
+        const fcl::Vec3f origin = ConvertVectorToFCL(vrays[iray].pos), dir = ConvertVectorToFCL(vrays[iray].dir);
+
+        // branchless slab test of all the AABBs so that the compiler vectorizes it. A zero direction component gets a huge
+        // inverse instead of an infinite one so that an origin lying on a slab plane does not produce NaNs
+        fcl::FCL_REAL vinvdir[3];
+        for(int i = 0; i < 3; ++i) {
+            vinvdir[i] = std::abs(dir[i]) > 1e-30 ? 1/dir[i] : 1e30;
+        }
+        const fcl::FCL_REAL* pminx = candidates.vmin[0].data(), *pminy = candidates.vmin[1].data(), *pminz = candidates.vmin[2].data();
+        const fcl::FCL_REAL* pmaxx = candidates.vmax[0].data(), *pmaxy = candidates.vmax[1].data(), *pmaxz = candidates.vmax[2].data();
+        uint8_t* phits = candidates.vhits.data();
+        const fcl::FCL_REAL ox = origin[0], oy = origin[1], oz = origin[2];
+        const fcl::FCL_REAL invx = vinvdir[0], invy = vinvdir[1], invz = vinvdir[2];
+        for(size_t icandidate = 0; icandidate < numCandidates; ++icandidate) {
+            const fcl::FCL_REAL tx0 = (pminx[icandidate] - ox)*invx, tx1 = (pmaxx[icandidate] - ox)*invx;
+            const fcl::FCL_REAL ty0 = (pminy[icandidate] - oy)*invy, ty1 = (pmaxy[icandidate] - oy)*invy;
+            const fcl::FCL_REAL tz0 = (pminz[icandidate] - oz)*invz, tz1 = (pmaxz[icandidate] - oz)*invz;
+            const fcl::FCL_REAL tenter = std::max(std::max(fcl::FCL_REAL(0), std::min(tx0, tx1)), std::max(std::min(ty0, ty1), std::min(tz0, tz1)));
+            const fcl::FCL_REAL texit = std::min(std::min(fcl::FCL_REAL(1), std::max(tx0, tx1)), std::min(std::max(ty0, ty1), std::max(tz0, tz1)));
+            phits[icandidate] = tenter <= texit;
+        }
+
+        fcl::FCL_REAL tbest = 1;
+        fcl::CollisionObject* pbestobject = nullptr;
+        for(size_t icandidate = 0; icandidate < numCandidates; ++icandidate) {
+            if( !phits[icandidate] ) {
+                continue;
+            }
+            fcl::FCL_REAL t = tbest;
+            if( _IntersectRayGeometry(*candidates.vobjects[icandidate], meshRayIntersector, origin, dir, t) && (!pbestobject || t < tbest) ) {
+                tbest = t;
+                pbestobject = candidates.vobjects[icandidate];
+            }
+        }
+
+        if( !!pbestobject ) {
+            CollisionReport& report = vreports[iray];
+            report.minDistance = tbest*dir.length();
+            report.SetLinkGeomCollision(GetCollisionLink(*pbestobject).second, GetCollisionGeometry(*pbestobject).second, LinkConstPtr(), GeometryConstPtr());
+            ++numHits;
+        }
+    }
+    return numHits;
 }
 
 bool FCLCollisionChecker::CheckCollision(const OpenRAVE::TriMesh& trimesh, KinBodyConstPtr pbody, CollisionReportPtr report)
 {
+    OPENRAVE_TRACE_SCOPE("FCLCollisionChecker::CheckCollision");
+    _UpdateAutoBroadphaseAlgorithm();
     if( !!report ) {
         report->Reset(_options);
     }
@@ -562,6 +1481,8 @@ bool FCLCollisionChecker::CheckCollision(const OpenRAVE::TriMesh& trimesh, KinBo
 
 bool FCLCollisionChecker::CheckCollision(const OpenRAVE::TriMesh& trimesh, CollisionReportPtr report)
 {
+    OPENRAVE_TRACE_SCOPE("FCLCollisionChecker::CheckCollision");
+    _UpdateAutoBroadphaseAlgorithm();
     if( !!report ) {
         report->Reset(_options);
     }
@@ -572,6 +1493,7 @@ bool FCLCollisionChecker::CheckCollision(const OpenRAVE::TriMesh& trimesh, Colli
     const std::vector<KinBodyConstPtr> vbodyexcluded;
     const std::vector<LinkConstPtr> vlinkexcluded;
     CollisionCallbackData query(shared_checker(), report, vbodyexcluded, vlinkexcluded);
+    query._pvExcludedBodyMask = &_vSharedEnvExcludedBodyMask;
     ADD_TIMING(_statistics);
 
     OPENRAVE_ASSERT_OP(trimesh.indices.size() % 3, ==, 0);
@@ -606,6 +1528,8 @@ bool FCLCollisionChecker::CheckCollision(const OpenRAVE::TriMesh& trimesh, Colli
 
 bool FCLCollisionChecker::CheckCollision(const OpenRAVE::AABB& ab, const OpenRAVE::Transform& aabbPose, CollisionReportPtr report)
 {
+    OPENRAVE_TRACE_SCOPE("FCLCollisionChecker::CheckCollision");
+    _UpdateAutoBroadphaseAlgorithm();
     if( !!report ) {
         report->Reset(_options);
     }
@@ -616,6 +1540,7 @@ bool FCLCollisionChecker::CheckCollision(const OpenRAVE::AABB& ab, const OpenRAV
     const std::vector<KinBodyConstPtr> vbodyexcluded;
     const std::vector<LinkConstPtr> vlinkexcluded;
     CollisionCallbackData query(shared_checker(), report, vbodyexcluded, vlinkexcluded);
+    query._pvExcludedBodyMask = &_vSharedEnvExcludedBodyMask;
     ADD_TIMING(_statistics);
 
     FCLSpace::FCLKinBodyInfo::LinkInfo objUserData;
@@ -639,6 +1564,8 @@ bool FCLCollisionChecker::CheckCollision(const OpenRAVE::AABB& ab, const OpenRAV
 
 bool FCLCollisionChecker::CheckCollision(const OpenRAVE::AABB& ab, const OpenRAVE::Transform& aabbPose, const std::vector<OpenRAVE::KinBodyConstPtr>& vIncludedBodies, OpenRAVE::CollisionReportPtr report)
 {
+    OPENRAVE_TRACE_SCOPE("FCLCollisionChecker::CheckCollision");
+    _UpdateAutoBroadphaseAlgorithm();
     if( !!report ) {
         report->Reset(_options);
     }
@@ -657,6 +1584,7 @@ bool FCLCollisionChecker::CheckCollision(const OpenRAVE::AABB& ab, const OpenRAV
     const std::vector<KinBodyConstPtr> vbodyexcluded;
     const std::vector<LinkConstPtr> vlinkexcluded;
     CollisionCallbackData query(shared_checker(), report, vbodyexcluded, vlinkexcluded);
+    query._pvExcludedBodyMask = &_vSharedEnvExcludedBodyMask;
     ADD_TIMING(_statistics);
 
     FCLSpace::FCLKinBodyInfo::LinkInfo objUserData;
@@ -680,7 +1608,9 @@ bool FCLCollisionChecker::CheckCollision(const OpenRAVE::AABB& ab, const OpenRAV
 
 bool FCLCollisionChecker::CheckStandaloneSelfCollision(KinBodyConstPtr pbody, CollisionReportPtr report)
 {
+    OPENRAVE_TRACE_SCOPE("FCLCollisionChecker::CheckStandaloneSelfCollision");
     START_TIMING_OPT(_statistics, "BodySelf",_options,pbody->IsRobot());
+    FCLRuntimeStatistics::QueryTiming runtimetiming(_runtimeStatistics, FCLRuntimeStatistics::QT_BodySelf);
     if( !!report ) {
         report->Reset(_options);
     }
@@ -746,7 +1676,9 @@ bool FCLCollisionChecker::CheckStandaloneSelfCollision(KinBodyConstPtr pbody, Co
 
 bool FCLCollisionChecker::CheckStandaloneSelfCollision(LinkConstPtr plink, CollisionReportPtr report)
 {
+    OPENRAVE_TRACE_SCOPE("FCLCollisionChecker::CheckStandaloneSelfCollision");
     START_TIMING_OPT(_statistics, "LinkSelf",_options,false);
+    FCLRuntimeStatistics::QueryTiming runtimetiming(_runtimeStatistics, FCLRuntimeStatistics::QT_LinkSelf);
     if( !!report ) {
         report->Reset(_options);
     }
@@ -872,6 +1804,10 @@ bool FCLCollisionChecker::CheckNarrowPhaseCollision(fcl::CollisionObject *o1, fc
         }
     }
 
+    if( _IsExcludedFromEnvManager(plink1, plink2, *pcb) ) {
+        return false;
+    }
+
     if( !!plink1 && !!plink2 ) {
         if( !pcb->bselfCollision && plink1->GetParent()->IsAttached(*plink2->GetParent())) {
             return false;
@@ -922,6 +1858,109 @@ bool FCLCollisionChecker::CheckNarrowPhaseCollision(fcl::CollisionObject *o1, fc
 }
 
 
+/// \brief boolean overlap tests of the primitive pairs that dominate usual scenes. Touching shapes are colliding like in fcl::collide.
+static inline bool _CheckPrimitiveCollision(const fcl::Sphere& sphere1, const fcl::Transform3f& t1, const fcl::Sphere& sphere2, const fcl::Transform3f& t2)
+{
+    const fcl::FCL_REAL fRadius = sphere1.radius + sphere2.radius;
+    return (t2.getTranslation() - t1.getTranslation()).sqrLength() <= fRadius*fRadius;
+}
+
+static inline bool _CheckPrimitiveCollision(const fcl::Box& box, const fcl::Transform3f& tbox, const fcl::Sphere& sphere, const fcl::Transform3f& tsphere)
+{
+    // closest point of the box to the sphere center in the box frame
+    const fcl::Matrix3f& R = tbox.getRotation();
+    const fcl::Vec3f vdelta = tsphere.getTranslation() - tbox.getTranslation();
+    fcl::FCL_REAL fSqrDistance = 0;
+    for(int i = 0; i < 3; ++i) {
+        const fcl::FCL_REAL fLocal = R.getColumn(i).dot(vdelta);
+        const fcl::FCL_REAL fHalfExtent = 0.5*box.side[i];
+        if( fLocal > fHalfExtent ) {
+            fSqrDistance += (fLocal - fHalfExtent)*(fLocal - fHalfExtent);
+        }
+        else if( fLocal < -fHalfExtent ) {
+            fSqrDistance += (fLocal + fHalfExtent)*(fLocal + fHalfExtent);
+        }
+    }
+    return fSqrDistance <= sphere.radius*sphere.radius;
+}
+
+static inline bool _CheckPrimitiveCollision(const fcl::Box& box1, const fcl::Transform3f& t1, const fcl::Box& box2, const fcl::Transform3f& t2)
+{
+    // separating axis test on the 15 candidate axes, see Gottschalk et al. "OBBTree"
+    const fcl::FCL_REAL fEpsilon = 1e-9; // keeps the cross product axes robust when edges are parallel
+    const fcl::Matrix3f& R1 = t1.getRotation();
+    const fcl::Matrix3f& R2 = t2.getRotation();
+    const fcl::Vec3f a = box1.side*0.5, b = box2.side*0.5;
+    const fcl::Vec3f vdelta = t2.getTranslation() - t1.getTranslation();
+    fcl::FCL_REAL R[3][3], AbsR[3][3], T[3];
+    for(int i = 0; i < 3; ++i) {
+        const fcl::Vec3f axis1 = R1.getColumn(i);
+        for(int j = 0; j < 3; ++j) {
+            R[i][j] = axis1.dot(R2.getColumn(j));
+            AbsR[i][j] = std::abs(R[i][j]) + fEpsilon;
+        }
+        T[i] = axis1.dot(vdelta);
+    }
+
+    // axes of box1 and box2
+    for(int i = 0; i < 3; ++i) {
+        if( std::abs(T[i]) > a[i] + b[0]*AbsR[i][0] + b[1]*AbsR[i][1] + b[2]*AbsR[i][2] ) {
+            return false;
+        }
+    }
+    for(int j = 0; j < 3; ++j) {
+        if( std::abs(T[0]*R[0][j] + T[1]*R[1][j] + T[2]*R[2][j]) > a[0]*AbsR[0][j] + a[1]*AbsR[1][j] + a[2]*AbsR[2][j] + b[j] ) {
+            return false;
+        }
+    }
+
+    // cross products of the axes of box1 and box2
+    for(int i = 0; i < 3; ++i) {
+        const int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+        for(int j = 0; j < 3; ++j) {
+            const int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+            const fcl::FCL_REAL ra = a[i1]*AbsR[i2][j] + a[i2]*AbsR[i1][j];
+            const fcl::FCL_REAL rb = b[j1]*AbsR[i][j2] + b[j2]*AbsR[i][j1];
+            if( std::abs(T[i2]*R[i1][j] - T[i1]*R[i2][j]) > ra + rb ) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/// \brief checks the pair with a specialized kernel if both geometries are primitives that have one
+///
+/// \param[out] bCollision the result of the check, only set if the function returns true
+/// \return true if the pair was handled, false if it should go through fcl::collide
+static bool _CheckPrimitiveCollision(const fcl::CollisionObject& o1, const fcl::CollisionObject& o2, bool& bCollision)
+{
+    const fcl::NODE_TYPE type1 = o1.getNodeType(), type2 = o2.getNodeType();
+    if( type1 == fcl::GEOM_BOX ) {
+        const fcl::Box& box1 = static_cast<const fcl::Box&>(*o1.collisionGeometry());
+        if( type2 == fcl::GEOM_BOX ) {
+            bCollision = _CheckPrimitiveCollision(box1, o1.getTransform(), static_cast<const fcl::Box&>(*o2.collisionGeometry()), o2.getTransform());
+            return true;
+        }
+        if( type2 == fcl::GEOM_SPHERE ) {
+            bCollision = _CheckPrimitiveCollision(box1, o1.getTransform(), static_cast<const fcl::Sphere&>(*o2.collisionGeometry()), o2.getTransform());
+            return true;
+        }
+    }
+    else if( type1 == fcl::GEOM_SPHERE ) {
+        const fcl::Sphere& sphere1 = static_cast<const fcl::Sphere&>(*o1.collisionGeometry());
+        if( type2 == fcl::GEOM_SPHERE ) {
+            bCollision = _CheckPrimitiveCollision(sphere1, o1.getTransform(), static_cast<const fcl::Sphere&>(*o2.collisionGeometry()), o2.getTransform());
+            return true;
+        }
+        if( type2 == fcl::GEOM_BOX ) {
+            bCollision = _CheckPrimitiveCollision(static_cast<const fcl::Box&>(*o2.collisionGeometry()), o2.getTransform(), sphere1, o1.getTransform());
+            return true;
+        }
+    }
+    return false;
+}
+
 bool FCLCollisionChecker::CheckNarrowPhaseGeomCollision(fcl::CollisionObject *o1, fcl::CollisionObject *o2, void *data) {
     CollisionCallbackData* pcb = static_cast<CollisionCallbackData *>(data);
     return pcb->_pchecker->CheckNarrowPhaseGeomCollision(o1, o2, pcb);
@@ -933,24 +1972,33 @@ bool FCLCollisionChecker::CheckNarrowPhaseGeomCollision(fcl::CollisionObject *o1
         return true; // don't test anymore
     }
 
-    pcb->_result.clear();
+    _runtimeStatistics.AddNarrowPhaseCall(o1->getNodeType(), o2->getNodeType());
+    size_t numContacts = 0;
+    bool bPrimitiveCollision = false;
+    if( !(_options & (OpenRAVE::CO_Contacts | OpenRAVE::CO_AllGeometryContacts)) && _CheckPrimitiveCollision(*o1, *o2, bPrimitiveCollision) ) {
+        // no contact is read from _result, so skip the fcl request/result setup
+        numContacts = bPrimitiveCollision ? 1 : 0;
+    }
+    else {
+        pcb->_result.clear();
 
 #ifdef NARROW_COLLISION_CACHING
-    CollisionPair collpair = MakeCollisionPair(o1, o2);
-    NarrowCollisionCache::iterator it = mCollisionCachedGuesses.find(collpair);
-    if( it != mCollisionCachedGuesses.end() ) {
-        pcb->_request.cached_gjk_guess = it->second;
-    } else {
-        // Is there anything more intelligent we could do there with the collision objects AABB ?
-        pcb->_request.cached_gjk_guess = fcl::Vec3f(1,0,0);
-    }
+        CollisionPair collpair = MakeCollisionPair(o1, o2);
+        NarrowCollisionCache::iterator it = mCollisionCachedGuesses.find(collpair);
+        if( it != mCollisionCachedGuesses.end() ) {
+            pcb->_request.cached_gjk_guess = it->second;
+        } else {
+            // Is there anything more intelligent we could do there with the collision objects AABB ?
+            pcb->_request.cached_gjk_guess = fcl::Vec3f(1,0,0);
+        }
 #endif
 
-    size_t numContacts = fcl::collide(o1, o2, pcb->_request, pcb->_result);
+        numContacts = fcl::collide(o1, o2, pcb->_request, pcb->_result);
 
 #ifdef NARROW_COLLISION_CACHING
-    mCollisionCachedGuesses[collpair] = pcb->_result.cached_gjk_guess;
+        mCollisionCachedGuesses[collpair] = pcb->_result.cached_gjk_guess;
 #endif
+    }
 
     if( numContacts > 0 ) {
         if( !!pcb->_report ) {
@@ -1092,6 +2140,10 @@ bool FCLCollisionChecker::CheckNarrowPhaseDistance(fcl::CollisionObject *o1, fcl
         }
     }
 
+    if( _IsExcludedFromEnvManager(plink1, plink2, *pcb) ) {
+        return false;
+    }
+
     if( !!plink1 && !!plink2 ) {
 
         LinkInfoPtr pLINK1 = _fclspace->GetLinkInfo(*plink1), pLINK2 = _fclspace->GetLinkInfo(*plink2);
@@ -1125,9 +2177,50 @@ bool FCLCollisionChecker::CheckNarrowPhaseGeomDistance(fcl::CollisionObject *o1,
 }
 
 
+/// \brief upper bound of how far any point of the object moved since it was at tprev
+static inline fcl::FCL_REAL _ComputeMotionBound(const fcl::CollisionObject& coll, const fcl::Transform3f& tprev)
+{
+    const fcl::Transform3f& tcur = coll.getTransform();
+    const fcl::Quaternion3f& qprev = tprev.getQuatRotation();
+    const fcl::Quaternion3f& qcur = tcur.getQuatRotation();
+    const fcl::FCL_REAL fCosHalfAngle = std::abs(qprev.getW()*qcur.getW() + qprev.getX()*qcur.getX() + qprev.getY()*qcur.getY() + qprev.getZ()*qcur.getZ());
+    const fcl::FCL_REAL fAngle = 2*std::acos(std::min(fCosHalfAngle, fcl::FCL_REAL(1)));
+    const fcl::CollisionGeometry& geom = *coll.collisionGeometry();
+    // a point at radius r of the object origin moves by at most r*angle from the rotation
+    return (tcur.getTranslation() - tprev.getTranslation()).length() + fAngle*(geom.aabb_center.length() + geom.aabb_radius);
+}
+
 bool FCLCollisionChecker::CheckNarrowPhaseGeomDistance(fcl::CollisionObject *o1, fcl::CollisionObject *o2, CollisionCallbackData* pcb, fcl::FCL_REAL& dist) {
-    // Compute the min distance between the objects.
-    fcl::distance(o1, o2, pcb->_distanceRequest, pcb->_distanceResult);
+    _runtimeStatistics.AddNarrowPhaseCall(o1->getNodeType(), o2->getNodeType());
+    if( _bCoherentDistance ) {
+        if( _coherentDistanceCache.size() > 100000 ) {
+            // objects of removed bodies are never queried again, so bound the memory
+            _coherentDistanceCache.clear();
+        }
+        const CollisionPair collpair = MakeCollisionPair(o1, o2);
+        CoherentDistanceInfo& info = _coherentDistanceCache[collpair];
+        if( info.pgeom1 == collpair.first->collisionGeometry().get() && info.pgeom2 == collpair.second->collisionGeometry().get() ) {
+            const fcl::FCL_REAL fLowerBound = info.distance - _ComputeMotionBound(*collpair.first, info.t1) - _ComputeMotionBound(*collpair.second, info.t2);
+            if( fLowerBound >= pcb->_report->minDistance ) {
+                // the pair cannot lower the minimum distance
+                dist = pcb->_distanceResult.min_distance;
+                return false;
+            }
+        }
+
+        _coherentDistanceResult.clear();
+        fcl::distance(o1, o2, pcb->_distanceRequest, _coherentDistanceResult);
+        info.pgeom1 = collpair.first->collisionGeometry().get();
+        info.pgeom2 = collpair.second->collisionGeometry().get();
+        info.t1 = collpair.first->getTransform();
+        info.t2 = collpair.second->getTransform();
+        info.distance = _coherentDistanceResult.min_distance;
+        pcb->_distanceResult.update(_coherentDistanceResult);
+    }
+    else {
+        // Compute the min distance between the objects.
+        fcl::distance(o1, o2, pcb->_distanceRequest, pcb->_distanceResult);
+    }
 
     // If the min distance between these two objects is smaller than the min distance found so far, store it as the new min distance.
     if (pcb->_report->minDistance > pcb->_distanceResult.min_distance) {
@@ -1141,7 +2234,6 @@ bool FCLCollisionChecker::CheckNarrowPhaseGeomDistance(fcl::CollisionObject *o1,
     return false;
 }
 
-#ifdef NARROW_COLLISION_CACHING
 CollisionPair FCLCollisionChecker::MakeCollisionPair(fcl::CollisionObject* o1, fcl::CollisionObject* o2)
 {
     if( o1 < o2 ) {
@@ -1150,7 +2242,6 @@ CollisionPair FCLCollisionChecker::MakeCollisionPair(fcl::CollisionObject* o1, f
         return make_pair(o2, o1);
     }
 }
-#endif
 
 LinkPair FCLCollisionChecker::MakeLinkPair(LinkConstPtr plink1, LinkConstPtr plink2)
 {
@@ -1190,8 +2281,12 @@ std::pair<FCLSpace::FCLKinBodyInfo::LinkInfo*, LinkConstPtr> FCLCollisionChecker
 
 std::pair<FCLSpace::FCLKinBodyInfo::FCLGeometryInfo*, GeometryConstPtr> FCLCollisionChecker::GetCollisionGeometry(const fcl::CollisionObject &collObj)
 {
-    const std::shared_ptr<const fcl::CollisionGeometry>& collgeom = collObj.collisionGeometry();
-    FCLSpace::FCLKinBodyInfo::FCLGeometryInfo* geom_raw = static_cast<FCLSpace::FCLKinBodyInfo::FCLGeometryInfo *>(collgeom->getUserData());
+    // collision geometries can be shared between spaces (FCLMeshCache), so find the geometry info through the link info of the collision object
+    FCLSpace::FCLKinBodyInfo::FCLGeometryInfo* geom_raw = nullptr;
+    const FCLSpace::FCLKinBodyInfo::LinkInfo* link_raw = static_cast<const FCLSpace::FCLKinBodyInfo::LinkInfo *>(collObj.getUserData());
+    if( !!link_raw ) {
+        geom_raw = link_raw->GetGeometryInfo(collObj);
+    }
     if( !!geom_raw ) {
         const GeometryConstPtr pgeom = geom_raw->GetGeometry();
         if( !pgeom ) {
@@ -1211,16 +2306,40 @@ BroadPhaseCollisionManagerPtr FCLCollisionChecker::_CreateManager() {
 FCLCollisionManagerInstance& FCLCollisionChecker::_GetBodyManager(KinBodyConstPtr pbody, bool bactiveDOFs)
 {
     _bParentlessCollisionObject = false;
-    BODYMANAGERSMAP::iterator it = _bodymanagers.find(std::make_pair(pbody.get(), (int)bactiveDOFs));
+    // managers tracking the active DOFs of a robot are kept per active DOF profile, so switching back to a set of active DOFs reuses a manager that already tracks its links
+    int managerkey = (int)bactiveDOFs;
+    if( bactiveDOFs && pbody->IsRobot() ) {
+        const RobotBase::ActiveDOFProfileConstPtr pprofile = static_cast<const RobotBase&>(*pbody).GetActiveDOFProfile();
+        if( !!pprofile ) {
+            managerkey = 1 + pprofile->nId;
+        }
+    }
+    BODYMANAGERSMAP::iterator it = _bodymanagers.find(std::make_pair(pbody.get(), managerkey));
     if( it != _bodymanagers.end() && !it->second->IsValid() ) {
         RAVELOG_WARN_FORMAT("env=%s, body manager cache is invalid. Perhaps, corresponding body has been removed. (self=%d)", GetEnv()->GetNameId()%_bIsSelfCollisionChecker);
         _bodymanagers.erase(it);
         it = _bodymanagers.end();
     }
+    _runtimeStatistics.AddBodyManagerLookup(it != _bodymanagers.end());
     if( it == _bodymanagers.end() ) {
+        if( managerkey > 1 ) {
+            // bound the number of profile managers of the body by dropping the least recently synchronized one
+            static const int s_nMaxProfileManagersPerBody = 8;
+            const BODYMANAGERSMAP::iterator itbegin = _bodymanagers.lower_bound(std::make_pair(pbody.get(), 2));
+            const BODYMANAGERSMAP::iterator itend = _bodymanagers.upper_bound(std::make_pair(pbody.get(), std::numeric_limits<int>::max()));
+            if( std::distance(itbegin, itend) >= s_nMaxProfileManagersPerBody ) {
+                BODYMANAGERSMAP::iterator itoldest = itbegin;
+                for(BODYMANAGERSMAP::iterator itmanager = itbegin; itmanager != itend; ++itmanager) {
+                    if( (int32_t)(itmanager->second->GetLastSyncTimeStamp() - itoldest->second->GetLastSyncTimeStamp()) < 0 ) {
+                        itoldest = itmanager;
+                    }
+                }
+                _bodymanagers.erase(itoldest);
+            }
+        }
         FCLCollisionManagerInstancePtr p(new FCLCollisionManagerInstance(*_fclspace, _CreateManager()));
         p->InitBodyManager(pbody, bactiveDOFs);
-        it = _bodymanagers.insert(BODYMANAGERSMAP::value_type(std::make_pair(pbody.get(), (int)bactiveDOFs), p)).first;
+        it = _bodymanagers.insert(BODYMANAGERSMAP::value_type(std::make_pair(pbody.get(), managerkey), p)).first;
 
         if ((int) _bodymanagers.size() > _maxNumBodyManagers) {
             RAVELOG_VERBOSE_FORMAT("env=%s, exceeded previous max number of body managers, now %d.", GetEnv()->GetNameId()%_bodymanagers.size());
@@ -1228,7 +2347,9 @@ FCLCollisionManagerInstance& FCLCollisionChecker::_GetBodyManager(KinBodyConstPt
         }
     }
 
+    const uint64_t nPrevBroadphaseUpdates = it->second->GetNumBroadphaseUpdates();
     it->second->Synchronize();
+    _runtimeStatistics.AddBroadphaseUpdates(it->second->GetNumBroadphaseUpdates() - nPrevBroadphaseUpdates);
     //RAVELOG_VERBOSE_FORMAT("env=%d, returning body manager cache %x (self=%d)", GetEnv()->GetId()%it->second.get()%_bIsSelfCollisionChecker);
     //it->second->PrintStatus(OpenRAVE::Level_Info);
     return *it->second;
@@ -1257,16 +2378,35 @@ FCLCollisionManagerInstance& FCLCollisionChecker::_GetEnvManager(const std::vect
         }
     }
 
-    EnvManagersMap::iterator it = _envmanagers.find(excludedBodyEnvIndices);
+    // in shared mode, the manager of the empty exclusion set serves all queries and the excluded bodies are filtered in the narrow phase callbacks
+    static const std::vector<int> s_vNoExcludedBodyEnvIndices;
+    const std::vector<int>& managerExcludedBodyEnvIndices = _bUseSharedEnvManager ? s_vNoExcludedBodyEnvIndices : excludedBodyEnvIndices;
+    _vSharedEnvExcludedBodyMask.clear();
+    if( _bUseSharedEnvManager ) {
+        if( !excludedBodyEnvIndices.empty() ) {
+            _vSharedEnvExcludedBodyMask.resize(GetEnv()->GetMaxEnvironmentBodyIndex() + 1, 0);
+            for (int excludeBodyIndex : excludedBodyEnvIndices) {
+                _vSharedEnvExcludedBodyMask.at(excludeBodyIndex) = 1;
+            }
+        }
+        if( excludedBodyEnvIndices != _vLastExcludedBodyEnvIndices ) {
+            ADD_COUNTER(_statistics, "EnvManager/SharedExclusionSwitch");
+            _vLastExcludedBodyEnvIndices = excludedBodyEnvIndices;
+        }
+    }
+
+    EnvManagersMap::iterator it = _envmanagers.find(managerExcludedBodyEnvIndices);
+    _runtimeStatistics.AddEnvManagerLookup(it != _envmanagers.end());
     if( it == _envmanagers.end() ) {
+        ADD_COUNTER(_statistics, "EnvManager/Create");
         FCLCollisionManagerInstancePtr p(new FCLCollisionManagerInstance(*_fclspace, _CreateManager()));
         vector<int8_t> vecExcludedBodyEnvIndices(GetEnv()->GetMaxEnvironmentBodyIndex() + 1, 0);
-        for (int excludeBodyIndex : excludedBodyEnvIndices) {
+        for (int excludeBodyIndex : managerExcludedBodyEnvIndices) {
             vecExcludedBodyEnvIndices.at(excludeBodyIndex) = 1;
         }
 
         p->InitEnvironment(vecExcludedBodyEnvIndices);
-        it = _envmanagers.insert(EnvManagersMap::value_type(excludedBodyEnvIndices, p)).first;
+        it = _envmanagers.insert(EnvManagersMap::value_type(managerExcludedBodyEnvIndices, p)).first;
 
         if ((int) _envmanagers.size() > _maxNumEnvManagers) {
             RAVELOG_VERBOSE_FORMAT("env=%s, exceeded previous max number of env managers, now %d.", GetEnv()->GetNameId()%_envmanagers.size());
@@ -1274,7 +2414,14 @@ FCLCollisionManagerInstance& FCLCollisionChecker::_GetEnvManager(const std::vect
         }
     }
     it->second->EnsureBodies(_fclspace->GetEnvBodies());
+    const uint64_t nPrevBroadphaseUpdates = it->second->GetNumBroadphaseUpdates();
     it->second->Synchronize();
+    const uint64_t nBroadphaseUpdates = it->second->GetNumBroadphaseUpdates() - nPrevBroadphaseUpdates;
+    _runtimeStatistics.AddBroadphaseUpdates(nBroadphaseUpdates);
+    if( _bAutoBroadphaseAlgorithm && _broadphaseSelector.AddQuery(it->second->GetManager()->size(), nBroadphaseUpdates) ) {
+        // the managers of this query are still in use
+        _bBroadphaseSwitchPending = true;
+    }
     //it->second->PrintStatus(OpenRAVE::Level_Info);
     //RAVELOG_VERBOSE_FORMAT("env=%d, returning env manager cache %x (self=%d)", GetEnv()->GetId()%it->second.get()%_bIsSelfCollisionChecker);
     return *it->second;
@@ -11,6 +11,8 @@
 
 #include "fclspace.h"
 #include "fclmanagercache.h"
+#include "fclvoxelobstacle.h"
+#include "fcldistancefield.h"
 
 #include "fclstatistics.h"
 
@@ -27,7 +29,6 @@ namespace fclrave {
 static EnvironmentMutex log_collision_use_mutex;
 #endif // FCLRAVE_COLLISION_OBJECTS_STATISTIC
 
-#ifdef NARROW_COLLISION_CACHING
 typedef std::pair<fcl::CollisionObject*, fcl::CollisionObject*> CollisionPair;
 
 } // fclrave
@@ -48,9 +49,20 @@ struct hash<fclrave::CollisionPair>
 
 namespace fclrave {
 
+#ifdef NARROW_COLLISION_CACHING
 typedef std::unordered_map<CollisionPair, fcl::Vec3f> NarrowCollisionCache;
 #endif // NARROW_COLLISION_CACHING
 
+/// \brief distance of a pair of geometries at the last distance query, see FCLCollisionChecker::_SetCoherentDistanceCommand
+struct CoherentDistanceInfo
+{
+    const fcl::CollisionGeometry* pgeom1; ///< geometry of the first object of the pair, detects objects recreated at the same address
+    const fcl::CollisionGeometry* pgeom2; ///< geometry of the second object of the pair
+    fcl::Transform3f t1, t2; ///< poses of the objects at the last query
+    fcl::FCL_REAL distance; ///< distance between the objects at the last query
+};
+typedef std::unordered_map<CollisionPair, CoherentDistanceInfo> CoherentDistanceCache;
+
 typedef FCLSpace::FCLKinBodyInfoConstPtr FCLKinBodyInfoConstPtr;
 typedef FCLSpace::FCLKinBodyInfoPtr FCLKinBodyInfoPtr;
 typedef FCLSpace::LinkInfoPtr LinkInfoPtr;
@@ -77,6 +89,7 @@ public:
         CollisionReportPtr _report;
         std::vector<KinBodyConstPtr> const& _vbodyexcluded;
         std::vector<LinkConstPtr> const& _vlinkexcluded;
+        const std::vector<uint8_t>* _pvExcludedBodyMask; ///< if not null and not empty, the pairs whose links all belong to bodies with a non-zero entry are ignored. Set on queries against the shared environment manager.
         std::list<EnvironmentBase::CollisionCallbackFn> listcallbacks;
 
         bool bselfCollision;  ///< true if currently checking for self collision.
@@ -95,6 +108,9 @@ public:
 
     void Clone(InterfaceBaseConstPtr preference, int cloningoptions);
 
+    /// Categories: "managers" (broadphase managers of the bodies and of the environment), "voxelobstacle", "distancefield" and "sharedbvhs" (the BVH models of the process-wide FCLMeshCache).
+    void GetMemoryUsage(MemoryUsage& memoryusage) const override;
+
     void SetNumMaxContacts(int numMaxContacts) {
         _numMaxContacts = numMaxContacts;
     }
@@ -136,16 +152,22 @@ public:
 
 
     /// Sets the broadphase algorithm for collision checking
-    /// The input algorithm can be one of : Naive, SaP, SSaP, IntervalTree, DynamicAABBTree{,1,2,3}, DynamicAABBTree_Array{,1,2,3}, SpatialHashing
+    /// The input algorithm can be one of : Naive, SaP, SSaP, IntervalTree, DynamicAABBTree{,1,2,3}, DynamicAABBTree_Array{,1,2,3}, SpatialHashing, Auto
+    /// Auto switches between Naive, SaP and DynamicAABBTree2 depending on the number of objects and of moved objects per query, see FCLBroadphaseSelector
     /// e.g. "SetBroadPhaseAlgorithm DynamicAABBTree"
     bool SetBroadphaseAlgorithmCommand(ostream& sout, istream& sinput);
 
     void _SetBroadphaseAlgorithm(const std::string &algorithm);
 
+    /// \brief the algorithm of the current managers, the one chosen by the selector in Auto mode
     const std::string & GetBroadphaseAlgorithm() const {
         return _broadPhaseCollisionManagerAlgorithm;
     }
 
+    inline bool IsAutoBroadphaseAlgorithm() const {
+        return _bAutoBroadphaseAlgorithm;
+    }
+
     /// Sets the bounding volume hierarchy representation which can be one of
     /// AABB, OBB, RSS, OBBRSS, kDOP16, kDOP18, kDOP24, kIOS
     /// e.g. "SetBVHRepresentation OBB"
@@ -155,9 +177,79 @@ public:
         return _fclspace->GetBVHRepresentation();
     }
 
+    /// Enables or disables sharing BVH models of meshes through the process-wide FCLMeshCache
+    /// e.g. "SetUseMeshCache 0"
+    bool _SetUseMeshCacheCommand(ostream& sout, istream& sinput);
+
+    /// Outputs "hits misses bytessaved numentries" of the process-wide FCLMeshCache
+    bool _GetMeshCacheStatisticsCommand(ostream& sout, istream& sinput);
+
+    /// Enables or disables colliding trimeshes as the convex pieces of their decomposition, optionally followed by the number of threads decomposing the meshes of a body
+    /// and the decomposition parameters "depth maxhullvertices concavitythresholdpercent mergethresholdpercent volumesplitthresholdpercent"
+    /// e.g. "SetUseConvexDecomposition 1 4 8 64 0.1 30 0.1"
+    bool _SetUseConvexDecompositionCommand(ostream& sout, istream& sinput);
+
+    /// Outputs "hits misses numentries numhulls" of the process-wide FCLConvexDecompositionCache
+    bool _GetConvexDecompositionCacheStatisticsCommand(ostream& sout, istream& sinput);
+
+    /// Enables (1) or disables (0) recording the runtime statistics. Disabled by default.
+    /// e.g. "SetStatisticsEnabled 1"
+    bool _SetStatisticsEnabledCommand(ostream& sout, istream& sinput);
+
+    /// Returns the runtime statistics recorded since the last reset as a JSON object.
+    bool _GetStatisticsCommand(ostream& sout, istream& sinput);
+
+    bool _ResetStatisticsCommand(ostream& sout, istream& sinput);
+
+    /// Enables (1) or disables (0) sharing one environment manager between all queries. When disabled (default), a manager is built for every set of excluded bodies.
+    /// e.g. "SetUseSharedEnvManager 0"
+    bool _SetUseSharedEnvManagerCommand(ostream& sout, istream& sinput);
+
+    /// Enables (1) or disables (0) coherent distance queries. When enabled, the distance of every geometry pair is remembered, and a pair is skipped when its last distance minus the motion of both geometries since then cannot be smaller than the minimum distance found so far.
+    /// e.g. "SetCoherentDistance 1"
+    bool _SetCoherentDistanceCommand(ostream& sout, istream& sinput);
+
+    /// Sets the maximum change of any DOF between two consecutive screw motions checked by CheckContinuousCollision
+    /// e.g. "SetContinuousCollisionStep 0.1"
+    bool _SetContinuousCollisionStepCommand(ostream& sout, istream& sinput);
+
+    /// Sets the side of the cells of the voxel obstacle, removes all its cells if it changes
+    /// e.g. "SetVoxelObstacleResolution 0.01"
+    bool _SetVoxelObstacleResolutionCommand(ostream& sout, istream& sinput);
+
+    /// Removes all the cells of the voxel obstacle
+    bool _ClearVoxelObstacleCommand(ostream& sout, istream& sinput);
+
+    /// Outputs the number of occupied cells of the voxel obstacle
+    bool _GetVoxelObstacleNumVoxelsCommand(ostream& sout, istream& sinput);
+
+    /// Marks the cells containing the points of input vrealvalues (x, y, z triplets in the world frame) as occupied, output vintvalues holds the number of new cells
+    static bool _InsertVoxelObstaclePointsTypedCommand(InterfaceBase& interfacebase, const TypedCommandData& input, TypedCommandData& output);
+
+    /// Marks the cells containing the points of input vrealvalues (x, y, z triplets in the world frame) as free, output vintvalues holds the number of removed cells
+    static bool _ClearVoxelObstaclePointsTypedCommand(InterfaceBase& interfacebase, const TypedCommandData& input, TypedCommandData& output);
+
+    /// Samples the signed distance field of the named bodies, which are expected not to move. The body and link queries against the environment skip these bodies when the field shows that they cannot be touched. The field is sampled again when one of the bodies changes. Without any body name, removes the distance field.
+    /// e.g. "SetDistanceField resolution padding wall rack1"
+    bool _SetDistanceFieldCommand(ostream& sout, istream& sinput);
+
+    /// For every point of input vrealvalues (x, y, z triplets in the world frame), output vrealvalues holds the interpolated distance to the bodies of the distance field followed by its gradient
+    static bool _GetDistanceFieldDistancesTypedCommand(InterfaceBase& interfacebase, const TypedCommandData& input, TypedCommandData& output);
+
+    /// Enables (1) or disables (0) checking the configurations of CheckCollisionBatch against the distance field with the covering spheres of the links only, which makes the results conservative. Meant for generating databases over millions of configurations.
+    /// e.g. "SetBatchSphereApproximation 1"
+    bool _SetBatchSphereApproximationCommand(ostream& sout, istream& sinput);
+
 
     bool InitEnvironment() override;
 
+    /// \brief all the state of the queries (fcl space, broadphase managers, caches) belongs to the checker instance, so one instance per thread can query a shared environment.
+    ///
+    /// The bodies have to be known to the instance beforehand (InitEnvironment), since initializing a body registers callbacks on it.
+    bool SupportsConcurrentReadOnlyQueries() const override {
+        return true;
+    }
+
     void DestroyEnvironment() override;
 
     bool InitKinBody(OpenRAVE::KinBodyPtr pbody) override;
@@ -184,6 +276,8 @@ public:
 
     bool CheckCollision(const RAY& ray, CollisionReportPtr report = CollisionReportPtr()) override;
 
+    int CheckCollisionRays(const std::vector<RAY>& vrays, std::vector<CollisionReport>& vreports) override;
+
     bool CheckCollision(const OpenRAVE::TriMesh& trimesh, KinBodyConstPtr pbody, CollisionReportPtr report = CollisionReportPtr()) override;
 
     bool CheckCollision(const OpenRAVE::TriMesh& trimesh, CollisionReportPtr report = CollisionReportPtr()) override;
@@ -192,6 +286,13 @@ public:
 
     bool CheckCollision(const OpenRAVE::AABB& ab, const OpenRAVE::Transform& aabbPose, const std::vector<OpenRAVE::KinBodyConstPtr>& vIncludedBodies, OpenRAVE::CollisionReportPtr report = CollisionReportPtr()) override;
 
+    bool CheckCollisionBatch(KinBodyPtr pbody, const OpenRAVE::dReal* pConfigurations, size_t nConfigurations, int dofstride, std::vector<uint8_t>& vresults, CollisionReportPtr report = CollisionReportPtr()) override;
+
+    /// \brief checks the motion with conservative advancement when all the geometries swept by the body are boxes, spheres or cylinders
+    ///
+    /// The motion is split so that no DOF changes by more than _fContinuousCollisionStep within a step, and every link is assumed to follow a screw motion between its poses at consecutive steps. Falls back to the discretized check of CollisionCheckerBase when the swept volume touches other geometry types, when an excluded end point is in collision, when CO_ActiveDOFs is set or when collision callbacks are registered.
+    bool CheckContinuousCollision(KinBodyPtr pbody, const std::vector<OpenRAVE::dReal>& vStartConfig, const std::vector<OpenRAVE::dReal>& vEndConfig, OpenRAVE::IntervalType interval, CollisionReportPtr report = CollisionReportPtr()) override;
+
     bool CheckStandaloneSelfCollision(KinBodyConstPtr pbody, CollisionReportPtr report = CollisionReportPtr()) override;
 
     bool CheckStandaloneSelfCollision(LinkConstPtr plink, CollisionReportPtr report = CollisionReportPtr()) override;
@@ -219,9 +320,7 @@ private:
 
     bool CheckNarrowPhaseGeomDistance(fcl::CollisionObject *o1, fcl::CollisionObject *o2, CollisionCallbackData* pcb, fcl::FCL_REAL& dist);
 
-#ifdef NARROW_COLLISION_CACHING
     static CollisionPair MakeCollisionPair(fcl::CollisionObject* o1, fcl::CollisionObject* o2);
-#endif
 
     static LinkPair MakeLinkPair(LinkConstPtr plink1, LinkConstPtr plink2);
     static LinkGeomPairs MakeLinkGeomPairs(LinkConstPtr plink1, LinkConstPtr plink2, GeometryConstPtr pgeom1, GeometryConstPtr pgeom2);
@@ -232,6 +331,18 @@ private:
 
     inline BroadPhaseCollisionManagerPtr _CreateManager();
 
+    /// \brief replaces all the managers by managers of algorithm
+    void _ResetManagers(const std::string& algorithm);
+
+    /// \brief in Auto mode, applies the algorithm chosen by the selector. Has to be called at the start of the queries, before any manager is retrieved, since it destroys the managers.
+    inline void _UpdateAutoBroadphaseAlgorithm() {
+        if( _bBroadphaseSwitchPending ) {
+            _bBroadphaseSwitchPending = false;
+            _runtimeStatistics.AddBroadphaseSwitch();
+            _ResetManagers(_broadphaseSelector.GetAlgorithm());
+        }
+    }
+
     FCLCollisionManagerInstance& _GetBodyManager(KinBodyConstPtr pbody, bool bactiveDOFs);
 
     /// \brief gets environment manager corresponding to excludedBodyEnvIndices
@@ -250,6 +361,61 @@ private:
 
     void _PrintCollisionManagerInstanceLE(const KinBody::Link& link, FCLCollisionManagerInstance& envManager);
 
+    /// \brief true if the pair comes from bodies the query excluded from the shared environment manager
+    static inline bool _IsExcludedFromEnvManager(const LinkConstPtr& plink1, const LinkConstPtr& plink2, const CollisionCallbackData& cb)
+    {
+        if( !cb._pvExcludedBodyMask || cb._pvExcludedBodyMask->empty() ) {
+            return false;
+        }
+        const std::vector<uint8_t>& vmask = *cb._pvExcludedBodyMask;
+        // standalone objects (null links) are never part of the environment
+        const int envBodyIndex1 = !!plink1 ? plink1->GetParent()->GetEnvironmentBodyIndex() : -1;
+        const int envBodyIndex2 = !!plink2 ? plink2->GetParent()->GetEnvironmentBodyIndex() : -1;
+        const bool bExcluded1 = !plink1 || (envBodyIndex1 >= 0 && envBodyIndex1 < (int)vmask.size() && vmask[envBodyIndex1]);
+        const bool bExcluded2 = !plink2 || (envBodyIndex2 >= 0 && envBodyIndex2 < (int)vmask.size() && vmask[envBodyIndex2]);
+        return bExcluded1 && bExcluded2;
+    }
+
+    /// \brief checks the objects of pobj against the voxel obstacle after they were checked against the environment
+    ///
+    /// \param pobj either a fcl::CollisionObject or a fcl::BroadPhaseCollisionManager
+    template <typename T>
+    inline void _CheckVoxelObstacle(T* pobj, CollisionCallbackData& query)
+    {
+        if( _pvoxelobstacle->IsEmpty() ) {
+            return;
+        }
+        // the cells do not belong to any body, so they must not be masked like the bodies of the shared environment manager
+        query._pvExcludedBodyMask = nullptr;
+        if( (_options & OpenRAVE::CO_Distance) && !!query._report ) {
+            _pvoxelobstacle->GetManager()->distance(pobj, &query, &FCLCollisionChecker::CheckNarrowPhaseDistance);
+        }
+        if( !query._bStopChecking ) {
+            _pvoxelobstacle->GetManager()->collide(pobj, &query, &FCLCollisionChecker::CheckNarrowPhaseCollision);
+        }
+    }
+
+    /// \brief samples the distance field again if one of its bodies changed since it was sampled. The fcl space has to be synchronized.
+    ///
+    /// \return true if the distance field can be used
+    bool _UpdateDistanceField();
+
+    /// \brief true if the distance field shows that the link is away from the bodies of the field
+    ///
+    /// Looks up the bounding box of the link first, then the covering spheres of the link when the box is too close.
+    bool _IsAwayFromDistanceField(FCLSpace::FCLKinBodyInfo::LinkInfo& linkinfo);
+
+    /// \brief true if the covering spheres of the enabled links of the attached bodies cannot touch the bodies of the distance field
+    ///
+    /// Only uses the link transforms, so the fcl objects do not have to be synchronized. A link with geometry but without covering spheres is never away.
+    bool _AreSpheresAwayFromDistanceField(const std::vector<int>& vattachedBodyIndices);
+
+    /// \brief returns vbodyexcluded extended with the bodies of the distance field if none of the links of the attached bodies can touch them, otherwise returns vbodyexcluded
+    const std::vector<KinBodyConstPtr>& _GetDistanceFieldExcludedBodies(const std::vector<int>& vattachedBodyIndices, const std::vector<KinBodyConstPtr>& vbodyexcluded);
+
+    /// \brief returns vbodyexcluded extended with the bodies of the distance field if the link cannot touch them, otherwise returns vbodyexcluded
+    const std::vector<KinBodyConstPtr>& _GetDistanceFieldExcludedBodies(FCLSpace::FCLKinBodyInfo::LinkInfo& linkinfo, const std::vector<KinBodyConstPtr>& vbodyexcluded);
+
     inline bool _IsEnabled(const KinBody& body)
     {
         if( body.IsEnabled() ) {
@@ -272,6 +438,9 @@ private:
     int _numMaxContacts;
     std::string _userdatakey;
     std::string _broadPhaseCollisionManagerAlgorithm; ///< broadphase algorithm to use to create a manager. tested: Naive, DynamicAABBTree2
+    bool _bAutoBroadphaseAlgorithm; ///< if true, _broadPhaseCollisionManagerAlgorithm follows _broadphaseSelector
+    bool _bBroadphaseSwitchPending; ///< if true, the selector chose a new algorithm that is applied at the start of the next query
+    FCLBroadphaseSelector _broadphaseSelector;
 
     typedef std::map< std::pair<const void*, int>, FCLCollisionManagerInstancePtr> BODYMANAGERSMAP; ///< Maps pairs of (body, bactiveDOFs) to oits manager
     BODYMANAGERSMAP _bodymanagers; ///< managers for each of the individual bodies. each manager should be called with InitBodyManager. Cannot use KinBodyPtr here since that will maintain a reference to the body!
@@ -279,6 +448,9 @@ private:
 
     typedef std::map<std::vector<int>, FCLCollisionManagerInstancePtr> EnvManagersMap; ///< Maps vector of excluded body indices to FCLCollisionManagerInstancePtr
     EnvManagersMap _envmanagers; // key is sorted vector of environment body indices of excluded bodies
+    bool _bUseSharedEnvManager; ///< if true, all queries use the manager of the empty exclusion set and filter their excluded bodies with _vSharedEnvExcludedBodyMask
+    std::vector<uint8_t> _vSharedEnvExcludedBodyMask; ///< environment body index -> 1 if excluded by the current query, empty if _bUseSharedEnvManager is false
+    std::vector<int> _vLastExcludedBodyEnvIndices; ///< excluded bodies of the previous query, to count the manager switches avoided by the shared manager
     int _nGetEnvManagerCacheClearCount; ///< count down until cache can be cleared
     int _maxNumEnvManagers = 0; ///< for debug, record max size of _envmanagers.
 
@@ -291,9 +463,14 @@ private:
     NarrowCollisionCache mCollisionCachedGuesses;
 #endif
 
+    CoherentDistanceCache _coherentDistanceCache; ///< last distance of every geometry pair, only used if _bCoherentDistance is true
+    fcl::DistanceResult _coherentDistanceResult; ///< cache
+    bool _bCoherentDistance; ///< if true, skip the geometry pairs whose distance cannot have become smaller than the current minimum since the last query
+
 #ifdef FCLUSESTATISTICS
     FCLStatisticsPtr _statistics;
 #endif
+    FCLRuntimeStatistics _runtimeStatistics; ///< always available, recording is enabled with the SetStatisticsEnabled command
 
     // In order to reduce allocations during collision checking
 
@@ -304,6 +481,49 @@ private:
 
     std::vector<int> _attachedBodyIndicesCache;
 
+    /// \brief enabled geometries tested by CheckCollisionRays, with their world AABBs laid out as separate arrays so that the ray-box tests vectorize
+    struct RayCandidates
+    {
+        std::vector<fcl::CollisionObject*> vlinkobjects; ///< cache of the link objects of the env manager
+        std::vector<fcl::CollisionObject*> vobjects;
+        std::vector<fcl::FCL_REAL> vmin[3], vmax[3];
+        std::vector<uint8_t> vhits; ///< 1 if the AABB of the geometry is hit by the current ray
+    };
+    RayCandidates _rayCandidates;
+    std::vector<RAY> _vRayCache;
+    std::vector<CollisionReport> _vRayReportsCache;
+
+    /// \brief geometry moving with the body in CheckContinuousCollision
+    struct ContinuousMovingGeometry
+    {
+        fcl::CollisionObject* pcoll; ///< synchronized with the pose of the geometry at the end of the current step
+        fcl::Transform3f tprev; ///< pose of the geometry at the start of the current step
+        fcl::AABB aabbprev; ///< bounding box of the geometry at the start of the current step
+    };
+    std::vector<ContinuousMovingGeometry> _vContinuousMovingGeometries;
+    std::vector<fcl::CollisionObject*> _vContinuousStaticObjects;
+    std::vector<OpenRAVE::dReal> _vContinuousDeltaCache, _vContinuousConfigCache;
+    OpenRAVE::dReal _fContinuousCollisionStep; ///< maximum change of any DOF between two consecutive screw motions checked by CheckContinuousCollision
+
+    FCLVoxelObstaclePtr _pvoxelobstacle; ///< obstacle filled from point clouds, checked by the body and link queries against the environment
+
+    /// \brief body sampled in the distance field, with the state it was sampled in
+    struct DistanceFieldBody
+    {
+        KinBodyConstWeakPtr pbody;
+        FCLSpace::FCLKinBodyInfoWeakPtr pinfo;
+        int nUpdateStamp; ///< KinBody::GetUpdateStamp when sampled
+        int nGeometryUpdateStamp; ///< FCLKinBodyInfo::nGeometryUpdateStamp when sampled
+    };
+    FCLDistanceField _distancefield;
+    std::vector<std::string> _vDistanceFieldBodyNames; ///< names of the bodies of the distance field, empty if not used
+    std::vector<DistanceFieldBody> _vDistanceFieldBodies; ///< bodies sampled in _distancefield
+    OpenRAVE::dReal _fDistanceFieldResolution, _fDistanceFieldPadding;
+    bool _bDistanceFieldSampled; ///< true if _distancefield was sampled from _vDistanceFieldBodies
+    std::vector<KinBodyConstPtr> _vDistanceFieldExcludedBodiesCache;
+    std::vector<fcl::CollisionObject*> _vDistanceFieldObjectsCache;
+    bool _bBatchSphereApproximation; ///< if true, CheckCollisionBatch checks the configurations against the distance field with the covering spheres only, see _SetBatchSphereApproximationCommand
+
     bool _bIsSelfCollisionChecker; // Currently not used
     bool _bParentlessCollisionObject; ///< if set to true, the last collision command ran into colliding with an unknown object
 };
@@ -0,0 +1,262 @@
+// -*- coding: utf-8 -*-
+#include "plugindefs.h"
+
+#include "fclconvexdecomposition.h"
+#include <fcl/container.h>
+#include <boost/functional/hash.hpp>
+#include <atomic>
+#include <thread>
+
+#include "NvConvexDecomposition.h"
+
+namespace fclrave {
+
+/// \brief fcl::Convex only references its points and faces, so keep the decomposition holding them alive
+class FCLSharedConvex : public fcl::Convex
+{
+public:
+    FCLSharedConvex(const ConvexHullsConstPtr& phulls, const ConvexHull& hull)
+        : fcl::Convex(const_cast<fcl::Vec3f*>(hull.vplanenormals.data()), const_cast<fcl::FCL_REAL*>(hull.vplanedistances.data()), hull.vplanenormals.size(),
+                      const_cast<fcl::Vec3f*>(hull.vpoints.data()), hull.vpoints.size(), const_cast<int*>(hull.vpolygons.data()))
+        , _phulls(phulls) {
+    }
+
+private:
+    ConvexHullsConstPtr _phulls;
+};
+
+FCLConvexDecompositionCache& FCLConvexDecompositionCache::GetInstance()
+{
+    static FCLConvexDecompositionCache s_convexDecompositionCache;
+    return s_convexDecompositionCache;
+}
+
+size_t FCLConvexDecompositionCache::_ComputeMeshHash(const OpenRAVE::TriMesh& mesh, const ConvexDecompositionParameters& params)
+{
+    size_t hash = boost::hash_value(params.fSkinWidth);
+    boost::hash_combine(hash, params.nDecompositionDepth);
+    boost::hash_combine(hash, params.nMaxHullVertices);
+    boost::hash_combine(hash, params.fConcavityThresholdPercent);
+    boost::hash_combine(hash, params.fMergeThresholdPercent);
+    boost::hash_combine(hash, params.fVolumeSplitThresholdPercent);
+    boost::hash_combine(hash, params.bUseInitialIslandGeneration);
+    boost::hash_combine(hash, params.bUseIslandGeneration);
+    boost::hash_combine(hash, mesh.vertices.size());
+    boost::hash_combine(hash, mesh.indices.size());
+    for (const Vector& v : mesh.vertices) {
+        boost::hash_combine(hash, v.x);
+        boost::hash_combine(hash, v.y);
+        boost::hash_combine(hash, v.z);
+    }
+    for (int index : mesh.indices) {
+        boost::hash_combine(hash, index);
+    }
+    return hash;
+}
+
+ConvexHullsConstPtr FCLConvexDecompositionCache::_DecomposeMesh(const OpenRAVE::TriMesh& mesh, const ConvexDecompositionParameters& params)
+{
+    std::shared_ptr<CONVEX_DECOMPOSITION::iConvexDecomposition> ic(CONVEX_DECOMPOSITION::createConvexDecomposition(), CONVEX_DECOMPOSITION::releaseConvexDecomposition);
+    std::vector<NxF32> vvertices(3*mesh.vertices.size());
+    for(size_t ivertex = 0; ivertex < mesh.vertices.size(); ++ivertex) {
+        vvertices[3*ivertex+0] = mesh.vertices[ivertex].x;
+        vvertices[3*ivertex+1] = mesh.vertices[ivertex].y;
+        vvertices[3*ivertex+2] = mesh.vertices[ivertex].z;
+    }
+    for(size_t iindex = 0; iindex+2 < mesh.indices.size(); iindex += 3) {
+        ic->addTriangle(&vvertices[3*mesh.indices[iindex]], &vvertices[3*mesh.indices[iindex+1]], &vvertices[3*mesh.indices[iindex+2]]);
+    }
+    // the library can spawn its own thread, but the parallelism is handled by DecomposeMeshes
+    ic->computeConvexDecomposition(params.fSkinWidth, params.nDecompositionDepth, params.nMaxHullVertices, params.fConcavityThresholdPercent, params.fMergeThresholdPercent, params.fVolumeSplitThresholdPercent, params.bUseInitialIslandGeneration, params.bUseIslandGeneration, false);
+
+    std::shared_ptr<std::vector<ConvexHull> > phulls = std::make_shared<std::vector<ConvexHull> >();
+    const NxU32 hullCount = ic->getHullCount();
+    phulls->reserve(hullCount);
+    CONVEX_DECOMPOSITION::ConvexHullResult result;
+    for(NxU32 ihull = 0; ihull < hullCount; ++ihull) {
+        if( !ic->getConvexHullResult(ihull, result) || result.mVcount < 4 || result.mTcount < 4 ) {
+            continue;
+        }
+        ConvexHull hull;
+        hull.vpoints.resize(result.mVcount);
+        fcl::Vec3f vcenter;
+        for(NxU32 ipoint = 0; ipoint < result.mVcount; ++ipoint) {
+            hull.vpoints[ipoint] = fcl::Vec3f(result.mVertices[3*ipoint], result.mVertices[3*ipoint+1], result.mVertices[3*ipoint+2]);
+            vcenter += hull.vpoints[ipoint];
+        }
+        vcenter *= 1.0/result.mVcount;
+
+        hull.vplanenormals.reserve(result.mTcount);
+        hull.vplanedistances.reserve(result.mTcount);
+        hull.vpolygons.reserve(4*result.mTcount);
+        for(NxU32 itri = 0; itri < result.mTcount; ++itri) {
+            int indices[3] = { (int)result.mIndices[3*itri], (int)result.mIndices[3*itri+1], (int)result.mIndices[3*itri+2] };
+            const fcl::Vec3f& v0 = hull.vpoints[indices[0]];
+            fcl::Vec3f vnormal = (hull.vpoints[indices[1]] - v0).cross(hull.vpoints[indices[2]] - v0);
+            const fcl::FCL_REAL flength = vnormal.length();
+            if( flength <= 1e-12 ) {
+                continue;
+            }
+            vnormal *= 1.0/flength;
+            // the winding of the hull faces is not guaranteed, so orient the planes away from the center
+            if( vnormal.dot(v0 - vcenter) < 0 ) {
+                vnormal = -vnormal;
+                std::swap(indices[1], indices[2]);
+            }
+            hull.vplanenormals.push_back(vnormal);
+            hull.vplanedistances.push_back(vnormal.dot(v0));
+            hull.vpolygons.push_back(3);
+            hull.vpolygons.insert(hull.vpolygons.end(), indices, indices+3);
+        }
+        if( hull.vplanenormals.size() >= 4 ) {
+            phulls->push_back(std::move(hull));
+        }
+    }
+    return phulls;
+}
+
+ConvexHullsConstPtr FCLConvexDecompositionCache::_Find(size_t hash, const OpenRAVE::TriMesh& mesh, const ConvexDecompositionParameters& params) const
+{
+    std::pair<std::unordered_multimap<size_t, ConvexHullsEntry>::const_iterator, std::unordered_multimap<size_t, ConvexHullsEntry>::const_iterator> itrange = _mapHulls.equal_range(hash);
+    for(std::unordered_multimap<size_t, ConvexHullsEntry>::const_iterator it = itrange.first; it != itrange.second; ++it) {
+        if( it->second.numvertices == mesh.vertices.size() && it->second.numindices == mesh.indices.size() && it->second.params == params ) {
+            return it->second.phulls;
+        }
+    }
+    return ConvexHullsConstPtr();
+}
+
+ConvexHullsConstPtr FCLConvexDecompositionCache::GetOrCreateConvexHulls(const OpenRAVE::TriMesh& mesh, const ConvexDecompositionParameters& params)
+{
+    const size_t hash = _ComputeMeshHash(mesh, params);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ConvexHullsConstPtr phulls = _Find(hash, mesh, params);
+        if( !!phulls ) {
+            _statistics.nHits++;
+            return phulls;
+        }
+    }
+
+    // decompose outside of the lock since it can take seconds
+    ConvexHullsConstPtr phulls = _DecomposeMesh(mesh, params);
+    std::lock_guard<std::mutex> lock(_mutex);
+    // another thread might have decomposed the same mesh in the meantime
+    ConvexHullsConstPtr pexisting = _Find(hash, mesh, params);
+    if( !!pexisting ) {
+        return pexisting;
+    }
+    _statistics.nMisses++;
+    _statistics.nHulls += phulls->size();
+    _mapHulls.emplace(hash, ConvexHullsEntry{mesh.vertices.size(), mesh.indices.size(), params, phulls});
+    return phulls;
+}
+
+void FCLConvexDecompositionCache::DecomposeMeshes(const std::vector<const OpenRAVE::TriMesh*>& vmeshes, const ConvexDecompositionParameters& params, int numthreads)
+{
+    std::vector<size_t> vallhashes(vmeshes.size(), 0);
+    for(size_t imesh = 0; imesh < vmeshes.size(); ++imesh) {
+        if( !!vmeshes[imesh] ) {
+            vallhashes[imesh] = _ComputeMeshHash(*vmeshes[imesh], params);
+        }
+    }
+
+    std::vector<size_t> vhashes;
+    std::vector<const OpenRAVE::TriMesh*> vmeshestodo;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for(size_t imesh = 0; imesh < vmeshes.size(); ++imesh) {
+            const OpenRAVE::TriMesh* pmesh = vmeshes[imesh];
+            if( !pmesh || pmesh->vertices.empty() || pmesh->indices.empty() ) {
+                continue;
+            }
+            const size_t hash = vallhashes[imesh];
+            if( !!_Find(hash, *pmesh, params) ) {
+                continue;
+            }
+            bool bDuplicate = false;
+            for(size_t itodo = 0; itodo < vmeshestodo.size(); ++itodo) {
+                if( vhashes[itodo] == hash && vmeshestodo[itodo]->vertices.size() == pmesh->vertices.size() && vmeshestodo[itodo]->indices.size() == pmesh->indices.size() ) {
+                    bDuplicate = true;
+                    break;
+                }
+            }
+            if( !bDuplicate ) {
+                vhashes.push_back(hash);
+                vmeshestodo.push_back(pmesh);
+            }
+        }
+    }
+    if( vmeshestodo.empty() ) {
+        return;
+    }
+
+    if( numthreads <= 0 ) {
+        numthreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    numthreads = std::min(numthreads, (int)vmeshestodo.size());
+
+    std::vector<ConvexHullsConstPtr> vresults(vmeshestodo.size());
+    std::atomic<size_t> nextmesh(0);
+    const uint64_t starttime = OpenRAVE::utils::GetMicroTime();
+    auto worker = [&]() {
+        for(size_t imesh = nextmesh++; imesh < vmeshestodo.size(); imesh = nextmesh++) {
+            try {
+                vresults[imesh] = _DecomposeMesh(*vmeshestodo[imesh], params);
+            }
+            catch(const std::exception& ex) {
+                RAVELOG_WARN_FORMAT("failed to decompose mesh with %d vertices: %s", vmeshestodo[imesh]->vertices.size()%ex.what());
+            }
+        }
+    };
+    std::vector<std::thread> vthreads;
+    vthreads.reserve(numthreads-1);
+    for(int ithread = 1; ithread < numthreads; ++ithread) {
+        vthreads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : vthreads) {
+        thread.join();
+    }
+    RAVELOG_DEBUG_FORMAT("decomposed %d meshes on %d threads in %.3fs", vmeshestodo.size()%numthreads%(1e-6*(OpenRAVE::utils::GetMicroTime() - starttime)));
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for(size_t imesh = 0; imesh < vmeshestodo.size(); ++imesh) {
+        if( !vresults[imesh] || !!_Find(vhashes[imesh], *vmeshestodo[imesh], params) ) {
+            continue;
+        }
+        _statistics.nMisses++;
+        _statistics.nHulls += vresults[imesh]->size();
+        _mapHulls.emplace(vhashes[imesh], ConvexHullsEntry{vmeshestodo[imesh]->vertices.size(), vmeshestodo[imesh]->indices.size(), params, vresults[imesh]});
+    }
+}
+
+FCLConvexDecompositionCache::Statistics FCLConvexDecompositionCache::GetStatistics()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _statistics.nEntries = _mapHulls.size();
+    return _statistics;
+}
+
+void FCLConvexDecompositionCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _mapHulls.clear();
+    _statistics.nHulls = 0;
+}
+
+std::shared_ptr<fcl::CollisionGeometry> CreateFCLConvexContainer(const ConvexHullsConstPtr& phulls)
+{
+    if( !phulls || phulls->empty() ) {
+        return std::shared_ptr<fcl::CollisionGeometry>();
+    }
+    std::vector<std::shared_ptr<fcl::CollisionObject>> contents;
+    contents.reserve(phulls->size());
+    for (const ConvexHull& hull : *phulls) {
+        std::shared_ptr<fcl::CollisionGeometry> fclGeom = std::make_shared<FCLSharedConvex>(phulls, hull);
+        contents.emplace_back(std::make_shared<fcl::CollisionObject>(fclGeom, fcl::Transform3f()));
+    }
+    return std::make_shared<fcl::Container>(contents);
+}
+
+}
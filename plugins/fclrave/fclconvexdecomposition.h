@@ -0,0 +1,101 @@
+// -*- coding: utf-8 -*-
+#ifndef OPENRAVE_FCL_CONVEXDECOMPOSITION
+#define OPENRAVE_FCL_CONVEXDECOMPOSITION
+
+#include <memory> // c++11
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace fclrave {
+
+/// \brief parameters of the convex decomposition, see CONVEX_DECOMPOSITION::iConvexDecomposition::computeConvexDecomposition
+struct ConvexDecompositionParameters
+{
+    bool operator==(const ConvexDecompositionParameters& other) const {
+        return fSkinWidth == other.fSkinWidth && nDecompositionDepth == other.nDecompositionDepth && nMaxHullVertices == other.nMaxHullVertices
+               && fConcavityThresholdPercent == other.fConcavityThresholdPercent && fMergeThresholdPercent == other.fMergeThresholdPercent
+               && fVolumeSplitThresholdPercent == other.fVolumeSplitThresholdPercent
+               && bUseInitialIslandGeneration == other.bUseInitialIslandGeneration && bUseIslandGeneration == other.bUseIslandGeneration;
+    }
+
+    float fSkinWidth = 0;
+    uint32_t nDecompositionDepth = 8;
+    uint32_t nMaxHullVertices = 64;
+    float fConcavityThresholdPercent = 0.1f;
+    float fMergeThresholdPercent = 30.0f;
+    float fVolumeSplitThresholdPercent = 0.1f;
+    bool bUseInitialIslandGeneration = true;
+    bool bUseIslandGeneration = false;
+};
+
+/// \brief one convex piece of a decomposed mesh, stored in the layout fcl::Convex references
+struct ConvexHull
+{
+    std::vector<fcl::Vec3f> vpoints;
+    std::vector<fcl::Vec3f> vplanenormals; ///< outward normal of every face
+    std::vector<fcl::FCL_REAL> vplanedistances; ///< offset of every face along its normal
+    std::vector<int> vpolygons; ///< for every face, the number of its vertices followed by their indices
+};
+typedef std::shared_ptr<const std::vector<ConvexHull> > ConvexHullsConstPtr;
+
+/// \brief process-wide cache of the convex decompositions of trimeshes
+///
+/// Decompositions are keyed by the content hash of the mesh and the parameters, and are kept until Clear is called
+/// since recomputing them takes much longer than building a BVH. Hash collisions are detected by comparing the mesh sizes and parameters.
+class FCLConvexDecompositionCache
+{
+public:
+    struct Statistics
+    {
+        uint64_t nHits = 0; ///< number of requests served with an existing decomposition
+        uint64_t nMisses = 0; ///< number of meshes that had to be decomposed
+        size_t nEntries = 0; ///< number of decompositions in the cache
+        size_t nHulls = 0; ///< total number of convex pieces in the cache
+    };
+
+    static FCLConvexDecompositionCache& GetInstance();
+
+    /// \brief returns the convex pieces of the mesh, decomposing it if it is not in the cache
+    ConvexHullsConstPtr GetOrCreateConvexHulls(const OpenRAVE::TriMesh& mesh, const ConvexDecompositionParameters& params);
+
+    /// \brief decomposes the meshes that are not in the cache yet on numthreads threads
+    ///
+    /// Identical meshes are decomposed once. Calling this before GetOrCreateConvexHulls for every mesh of a body
+    /// processes all the links of the body in parallel instead of one after the other.
+    /// \param numthreads if 0, uses the number of hardware threads
+    void DecomposeMeshes(const std::vector<const OpenRAVE::TriMesh*>& vmeshes, const ConvexDecompositionParameters& params, int numthreads=0);
+
+    Statistics GetStatistics();
+
+    /// \brief removes all the decompositions, the collision geometries built from them stay valid
+    void Clear();
+
+private:
+    struct ConvexHullsEntry
+    {
+        size_t numvertices;
+        size_t numindices;
+        ConvexDecompositionParameters params;
+        ConvexHullsConstPtr phulls;
+    };
+
+    static size_t _ComputeMeshHash(const OpenRAVE::TriMesh& mesh, const ConvexDecompositionParameters& params);
+
+    /// \brief runs the decomposition library, can be called from several threads at once
+    static ConvexHullsConstPtr _DecomposeMesh(const OpenRAVE::TriMesh& mesh, const ConvexDecompositionParameters& params);
+
+    /// \brief returns the cached decomposition or null, _mutex has to be locked
+    ConvexHullsConstPtr _Find(size_t hash, const OpenRAVE::TriMesh& mesh, const ConvexDecompositionParameters& params) const;
+
+    std::mutex _mutex;
+    std::unordered_multimap<size_t, ConvexHullsEntry> _mapHulls; ///< content hash -> decomposition
+    Statistics _statistics;
+};
+
+/// \brief creates a fcl::Container holding one fcl::Convex per convex piece. The pieces reference the points of phulls, which are kept alive by the geometry.
+std::shared_ptr<fcl::CollisionGeometry> CreateFCLConvexContainer(const ConvexHullsConstPtr& phulls);
+
+}
+
+#endif
@@ -0,0 +1,240 @@
+// -*- coding: utf-8 -*-
+#include "plugindefs.h"
+
+#include "fcldistancefield.h"
+
+namespace fclrave {
+
+static const double s_fDistanceTransformInf = 1e20;
+
+/// \brief squared euclidean distance transform of a sampled function along one line, see Felzenszwalb and Huttenlocher, "Distance Transforms of Sampled Functions"
+///
+/// \param f input values of n contiguous samples
+/// \param d output squared distances of the n samples, separated by stride
+/// \param v, z work buffers of at least n and n+1 elements
+static void _DistanceTransform1D(const double* f, double* d, int n, size_t stride, int* v, double* z)
+{
+    int k = 0;
+    v[0] = 0;
+    z[0] = -s_fDistanceTransformInf;
+    z[1] = s_fDistanceTransformInf;
+    for(int q = 1; q < n; ++q) {
+        const double fq = f[q] + (double)q*q;
+        double s = (fq - (f[v[k]] + (double)v[k]*v[k]))/(2.0*(q - v[k]));
+        // z[0] is lower than any s, so k stays positive
+        while( s <= z[k] ) {
+            --k;
+            s = (fq - (f[v[k]] + (double)v[k]*v[k]))/(2.0*(q - v[k]));
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k+1] = s_fDistanceTransformInf;
+    }
+    k = 0;
+    for(int q = 0; q < n; ++q) {
+        while( z[k+1] < q ) {
+            ++k;
+        }
+        const double dq = q - v[k];
+        d[q*stride] = dq*dq + f[v[k]];
+    }
+}
+
+/// \brief squared euclidean distance transform of a 3D grid, in place
+static void _DistanceTransform3D(std::vector<double>& vvalues, const int dims[3])
+{
+    const int maxdim = std::max(dims[0], std::max(dims[1], dims[2]));
+    std::vector<double> vline(maxdim), vz(maxdim+1);
+    std::vector<int> vv(maxdim);
+    const size_t strides[3] = { 1, (size_t)dims[0], (size_t)dims[0]*dims[1] };
+    for(int idim = 0; idim < 3; ++idim) {
+        const int iother0 = (idim+1)%3, iother1 = (idim+2)%3;
+        for(int i0 = 0; i0 < dims[iother0]; ++i0) {
+            for(int i1 = 0; i1 < dims[iother1]; ++i1) {
+                double* pline = &vvalues[i0*strides[iother0] + i1*strides[iother1]];
+                for(int q = 0; q < dims[idim]; ++q) {
+                    vline[q] = pline[q*strides[idim]];
+                }
+                _DistanceTransform1D(&vline[0], pline, dims[idim], strides[idim], &vv[0], &vz[0]);
+            }
+        }
+    }
+}
+
+FCLDistanceField::FCLDistanceField() : _resolution(0)
+{
+    _dims[0] = _dims[1] = _dims[2] = 0;
+}
+
+void FCLDistanceField::Build(const std::vector<fcl::CollisionObject*>& vobjects, OpenRAVE::dReal resolution, OpenRAVE::dReal padding)
+{
+    OPENRAVE_ASSERT_OP_FORMAT0(resolution, >, 0, "distance field resolution has to be positive", OpenRAVE::ORE_InvalidArguments);
+    OPENRAVE_ASSERT_OP_FORMAT0(padding, >=, 0, "distance field padding cannot be negative", OpenRAVE::ORE_InvalidArguments);
+    Clear();
+    if( vobjects.empty() ) {
+        return;
+    }
+
+    fcl::AABB abunion = vobjects.at(0)->getAABB();
+    for(size_t iobject = 1; iobject < vobjects.size(); ++iobject) {
+        abunion += vobjects[iobject]->getAABB();
+    }
+    _abgeometries.pos = ConvertVectorFromFCL(abunion.center());
+    _abgeometries.extents = ConvertVectorFromFCL(abunion.max_ - abunion.min_)*0.5;
+
+    size_t numcells = 1;
+    for(int idim = 0; idim < 3; ++idim) {
+        _dims[idim] = std::max(1, (int)std::ceil((abunion.max_[idim] - abunion.min_[idim] + 2*padding)/resolution));
+        numcells *= _dims[idim];
+    }
+    if( numcells > ((size_t)1 << 28) ) {
+        _dims[0] = _dims[1] = _dims[2] = 0;
+        throw OPENRAVE_EXCEPTION_FORMAT("distance field of %d cells is too large, increase the resolution %f", numcells%resolution, OpenRAVE::ORE_InvalidArguments);
+    }
+    _resolution = resolution;
+    _vorigin = ConvertVectorFromFCL(abunion.min_) - Vector(padding - 0.5*resolution, padding - 0.5*resolution, padding - 0.5*resolution);
+
+    std::vector<uint8_t> voccupied(numcells, 0);
+    FOREACHC(itobject, vobjects) {
+        const fcl::AABB& abobject = (*itobject)->getAABB();
+        int imin[3], imax[3];
+        for(int idim = 0; idim < 3; ++idim) {
+            imin[idim] = std::max(0, (int)std::floor((abobject.min_[idim] - _vorigin[idim])/_resolution + 0.5));
+            imax[idim] = std::min(_dims[idim], (int)std::floor((abobject.max_[idim] - _vorigin[idim])/_resolution + 0.5) + 1);
+        }
+        _Voxelize(**itobject, imin, imax, voccupied);
+    }
+
+    // distances from the free cells to the closest occupied cell, and from the occupied cells to the closest free cell
+    std::vector<double> voutside(numcells), vinside(numcells);
+    for(size_t icell = 0; icell < numcells; ++icell) {
+        voutside[icell] = voccupied[icell] ? 0 : s_fDistanceTransformInf;
+        vinside[icell] = voccupied[icell] ? s_fDistanceTransformInf : 0;
+    }
+    _DistanceTransform3D(voutside, _dims);
+    _DistanceTransform3D(vinside, _dims);
+
+    _vdistances.resize(numcells);
+    for(size_t icell = 0; icell < numcells; ++icell) {
+        _vdistances[icell] = voccupied[icell] ? -std::sqrt(vinside[icell])*_resolution : std::sqrt(voutside[icell])*_resolution;
+    }
+}
+
+void FCLDistanceField::Clear()
+{
+    _vdistances.clear();
+    _dims[0] = _dims[1] = _dims[2] = 0;
+}
+
+OpenRAVE::dReal FCLDistanceField::GetLowerBoundDistance(const OpenRAVE::Vector& point) const
+{
+    int index[3];
+    for(int idim = 0; idim < 3; ++idim) {
+        const OpenRAVE::dReal f = std::floor((point[idim] - _vorigin[idim])/_resolution + 0.5);
+        if( !(f >= 0 && f < _dims[idim]) ) {
+            // the grid contains the bounding box of the geometries
+            OpenRAVE::dReal fdist2 = 0;
+            for(int jdim = 0; jdim < 3; ++jdim) {
+                const OpenRAVE::dReal delta = RaveFabs(point[jdim] - _abgeometries.pos[jdim]) - _abgeometries.extents[jdim];
+                if( delta > 0 ) {
+                    fdist2 += delta*delta;
+                }
+            }
+            return OpenRAVE::RaveSqrt(fdist2);
+        }
+        index[idim] = (int)f;
+    }
+    // both the point and the closest point of the geometries can be anywhere in their cells
+    return _vdistances[_GetIndex(index[0], index[1], index[2])] - _resolution*std::sqrt(OpenRAVE::dReal(3));
+}
+
+OpenRAVE::dReal FCLDistanceField::GetDistance(const OpenRAVE::Vector& point, OpenRAVE::Vector* pgradient) const
+{
+    int i0[3], i1[3];
+    OpenRAVE::dReal t[3];
+    OpenRAVE::Vector vclamped;
+    for(int idim = 0; idim < 3; ++idim) {
+        const OpenRAVE::dReal fmax = _dims[idim] - 1;
+        OpenRAVE::dReal u = (point[idim] - _vorigin[idim])/_resolution;
+        u = u < 0 ? 0 : (u > fmax ? fmax : u);
+        vclamped[idim] = _vorigin[idim] + u*_resolution;
+        i0[idim] = std::min((int)u, std::max(_dims[idim] - 2, 0));
+        i1[idim] = std::min(i0[idim] + 1, _dims[idim] - 1);
+        t[idim] = u - i0[idim];
+    }
+
+    OpenRAVE::dReal c[2][2][2];
+    for(int iz = 0; iz < 2; ++iz) {
+        for(int iy = 0; iy < 2; ++iy) {
+            for(int ix = 0; ix < 2; ++ix) {
+                c[iz][iy][ix] = _vdistances[_GetIndex(ix ? i1[0] : i0[0], iy ? i1[1] : i0[1], iz ? i1[2] : i0[2])];
+            }
+        }
+    }
+    const OpenRAVE::dReal c00 = c[0][0][0] + (c[0][0][1] - c[0][0][0])*t[0], c10 = c[0][1][0] + (c[0][1][1] - c[0][1][0])*t[0];
+    const OpenRAVE::dReal c01 = c[1][0][0] + (c[1][0][1] - c[1][0][0])*t[0], c11 = c[1][1][0] + (c[1][1][1] - c[1][1][0])*t[0];
+    const OpenRAVE::dReal c0 = c00 + (c10 - c00)*t[1], c1 = c01 + (c11 - c01)*t[1];
+    OpenRAVE::dReal fdist = c0 + (c1 - c0)*t[2];
+
+    if( !!pgradient ) {
+        const OpenRAVE::dReal dx0 = (c[0][0][1] - c[0][0][0])*(1 - t[1]) + (c[0][1][1] - c[0][1][0])*t[1];
+        const OpenRAVE::dReal dx1 = (c[1][0][1] - c[1][0][0])*(1 - t[1]) + (c[1][1][1] - c[1][1][0])*t[1];
+        pgradient->x = (dx0*(1 - t[2]) + dx1*t[2])/_resolution;
+        pgradient->y = (c10 - c00 + ((c11 - c01) - (c10 - c00))*t[2])/_resolution;
+        pgradient->z = (c1 - c0)/_resolution;
+        pgradient->w = 0;
+    }
+
+    const OpenRAVE::Vector vdelta = point - vclamped;
+    const OpenRAVE::dReal foutside = OpenRAVE::RaveSqrt(vdelta.lengthsqr3());
+    if( foutside > 0 ) {
+        fdist += foutside;
+        if( !!pgradient ) {
+            *pgradient = vdelta*(1/foutside);
+        }
+    }
+    return fdist;
+}
+
+void FCLDistanceField::_Voxelize(fcl::CollisionObject& object, const int imin[3], const int imax[3], std::vector<uint8_t>& voccupied) const
+{
+    if( imin[0] >= imax[0] || imin[1] >= imax[1] || imin[2] >= imax[2] ) {
+        return;
+    }
+    fcl::Vec3f vmin, vmax;
+    for(int idim = 0; idim < 3; ++idim) {
+        vmin[idim] = _vorigin[idim] + (imin[idim] - 0.5)*_resolution;
+        vmax[idim] = _vorigin[idim] + (imax[idim] - 0.5)*_resolution;
+    }
+    if( !object.getAABB().overlap(fcl::AABB(vmin, vmax)) ) {
+        return;
+    }
+    const fcl::Vec3f vsize = vmax - vmin;
+    fcl::CollisionObject boxobject(std::make_shared<fcl::Box>(vsize[0], vsize[1], vsize[2]), fcl::Transform3f((vmin + vmax)*0.5));
+    fcl::CollisionRequest request;
+    fcl::CollisionResult result;
+    if( fcl::collide(&boxobject, &object, request, result) == 0 ) {
+        return;
+    }
+
+    // split the longest side of the range, until a single cell is left
+    int isplit = 0;
+    for(int idim = 1; idim < 3; ++idim) {
+        if( imax[idim] - imin[idim] > imax[isplit] - imin[isplit] ) {
+            isplit = idim;
+        }
+    }
+    if( imax[isplit] - imin[isplit] == 1 ) {
+        voccupied[_GetIndex(imin[0], imin[1], imin[2])] = 1;
+        return;
+    }
+    const int imid = (imin[isplit] + imax[isplit])/2;
+    int ihalfmax[3] = { imax[0], imax[1], imax[2] }, ihalfmin[3] = { imin[0], imin[1], imin[2] };
+    ihalfmax[isplit] = imid;
+    ihalfmin[isplit] = imid;
+    _Voxelize(object, imin, ihalfmax, voccupied);
+    _Voxelize(object, ihalfmin, imax, voccupied);
+}
+
+} // end namespace fclrave
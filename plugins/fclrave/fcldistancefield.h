@@ -0,0 +1,67 @@
+// -*- coding: utf-8 -*-
+#ifndef OPENRAVE_FCL_DISTANCEFIELD
+#define OPENRAVE_FCL_DISTANCEFIELD
+
+#include <vector>
+
+#include "fclspace.h"
+
+namespace fclrave {
+
+/// \brief signed distance field of a set of geometries that do not move, sampled on a regular grid.
+///
+/// The cells overlapping the geometries are found by colliding boxes covering the grid with every geometry, splitting the boxes that collide until they are one cell wide. The distances are then computed by an exact euclidean distance transform of these cells, positive outside of the geometries and negative inside. Looking up a point is O(1).
+class FCLDistanceField
+{
+public:
+    FCLDistanceField();
+
+    /// \brief samples the distance field of the geometries
+    ///
+    /// \param vobjects geometries with their world poses
+    /// \param resolution side of the cells
+    /// \param padding distance the grid extends beyond the bounding box of the geometries
+    void Build(const std::vector<fcl::CollisionObject*>& vobjects, OpenRAVE::dReal resolution, OpenRAVE::dReal padding);
+
+    void Clear();
+
+    inline bool IsEmpty() const {
+        return _vdistances.empty();
+    }
+
+    inline OpenRAVE::dReal GetResolution() const {
+        return _resolution;
+    }
+
+    inline size_t GetNumCells() const {
+        return _vdistances.size();
+    }
+
+    /// \brief returns a distance that is never larger than the distance from the point to the geometries
+    ///
+    /// Inside the grid, the distance of the cell of the point minus the largest error of the sampling. Outside of the grid, the distance to the bounding box of the geometries.
+    OpenRAVE::dReal GetLowerBoundDistance(const OpenRAVE::Vector& point) const;
+
+    /// \brief returns the trilinear interpolation of the sampled distances at point, and optionally their gradient
+    ///
+    /// Outside of the grid, the distance from point to the grid is added to the distance at the closest point of the grid.
+    OpenRAVE::dReal GetDistance(const OpenRAVE::Vector& point, OpenRAVE::Vector* pgradient=nullptr) const;
+
+private:
+    /// \brief marks the cells of the range [imin, imax) of the grid overlapping the geometry
+    void _Voxelize(fcl::CollisionObject& object, const int imin[3], const int imax[3], std::vector<uint8_t>& voccupied) const;
+
+    inline size_t _GetIndex(int ix, int iy, int iz) const {
+        return ((size_t)iz*_dims[1] + iy)*_dims[0] + ix;
+    }
+
+    OpenRAVE::dReal _resolution;
+    OpenRAVE::Vector _vorigin; ///< center of cell (0,0,0)
+    int _dims[3]; ///< number of cells along x, y, z
+    OpenRAVE::AABB _abgeometries; ///< bounding box of the geometries
+    std::vector<float> _vdistances; ///< signed distance at the center of every cell, x varies first
+};
+
+} // end namespace fclrave
+
+#endif
@@ -90,6 +90,7 @@ void FCLCollisionManagerInstance::KinBodyCache::Invalidate(bool warnOnNonEmptyCo
 FCLCollisionManagerInstance::FCLCollisionManagerInstance(FCLSpace& fclspace, BroadPhaseCollisionManagerPtr pmanager_)
     : _fclspace(fclspace)
     , pmanager(pmanager_)
+    , _nBroadphaseUpdates(0)
     , _bTrackActiveDOF(false) {
     _lastSyncTimeStamp = OpenRAVE::utils::GetMilliTime();
 }
@@ -368,16 +369,12 @@ void FCLCollisionManagerInstance::Synchronize() {
                         } else {
                             // check for any tracking link changes
                             _vTrackingActiveLinks.resize(robot.GetLinks().size(), 0);
+                            OpenRAVE::ResizeLinkStateBitMasks(_vTrackingActiveLinksMask, robot.GetLinks().size());
                             // the active links might have changed
                             _linkEnableStatesBitmasks = robot.GetLinkEnableStatesMasks();
+                            const RobotBase::ActiveDOFProfileConstPtr pprofile = robot.GetActiveDOFProfile();
                             for (size_t ilink = 0; ilink < robot.GetLinks().size(); ++ilink) {
-                                int isLinkActive = 0;
-                                FOREACH(itindex, robot.GetActiveDOFIndices()) {
-                                    if (robot.DoesAffect(robot.GetJointFromDOFIndex(*itindex)->GetJointIndex(), ilink)) {
-                                        isLinkActive = 1;
-                                        break;
-                                    }
-                                }
+                                const int isLinkActive = _IsLinkActive(robot, pprofile, ilink);
                                 if (!isLinkActive) {
                                     OpenRAVE::DisableLinkStateBit(_linkEnableStatesBitmasks, ilink);
                                 }
@@ -385,6 +382,11 @@ void FCLCollisionManagerInstance::Synchronize() {
 
                                 if (_vTrackingActiveLinks[ilink] != isLinkActive) {
                                     _vTrackingActiveLinks[ilink] = isLinkActive;
+                                    if (isLinkActive) {
+                                        OpenRAVE::EnableLinkStateBit(_vTrackingActiveLinksMask, ilink);
+                                    } else {
+                                        OpenRAVE::DisableLinkStateBit(_vTrackingActiveLinksMask, ilink);
+                                    }
                                     CollisionObjectPtr pcolobj = _fclspace.GetLinkBV(*pnewinfo, robot.GetLinks()[ilink]->GetIndex());
                                     if (bIsActiveLinkEnabled && !!pcolobj) {
                                         fcl::CollisionObject* pColObjRaw = pcolobj.get();
@@ -499,59 +501,54 @@ void FCLCollisionManagerInstance::Synchronize() {
             std::vector<uint64_t>& newLinkEnableStates = _linkEnableStatesCache;
             newLinkEnableStates = body.GetLinkEnableStatesMasks();
             if (_bTrackActiveDOF && ptrackingbody == pbody) {
-                for (size_t itestlink = 0; itestlink < _vTrackingActiveLinks.size(); ++itestlink) {
-                    if (!_vTrackingActiveLinks[itestlink]) {
-                        OpenRAVE::DisableLinkStateBit(newLinkEnableStates, itestlink);
-                    }
+                for (size_t iword = 0; iword < newLinkEnableStates.size(); ++iword) {
+                    newLinkEnableStates[iword] &= iword < _vTrackingActiveLinksMask.size() ? _vTrackingActiveLinksMask[iword] : 0;
                 }
             }
 
             // uint64_t changed = cache.linkmask ^ newlinkmask;
             // RAVELOG_VERBOSE_FORMAT("env=%d, %x (self=%d), lastsync=%u body %s (%d) for cache changed link %d != %d, linkmask=0x%x",
             // body.GetEnv()->GetId()%this%_fclspace.IsSelfCollisionChecker()%_lastSyncTimeStamp%body.GetName()%body.GetEnvironmentBodyIndex()%kinBodyInfo.nLinkUpdateStamp%cache.nLinkUpdateStamp%_GetLinkMask(newLinkEnableStates));
-            for (uint64_t ilink = 0; ilink < kinBodyInfo.vlinks.size(); ++ilink) {
-                uint8_t changed =
-                    OpenRAVE::IsLinkStateBitEnabled(cache.linkEnableStatesBitmasks, ilink) != OpenRAVE::IsLinkStateBitEnabled(newLinkEnableStates, ilink);
-                if (changed) {
-                    if (OpenRAVE::IsLinkStateBitEnabled(newLinkEnableStates, ilink)) {
-                        CollisionObjectPtr pcolobj = _fclspace.GetLinkBV(kinBodyInfo, ilink);
-                        if (!!pcolobj) {
-                            fcl::CollisionObject* pColObjRaw = pcolobj.get();
+            // only visit the links whose state changed, 64 links are compared at a time
+            OpenRAVE::ForEachChangedLinkStateBit(cache.linkEnableStatesBitmasks, newLinkEnableStates, kinBodyInfo.vlinks.size(), [&](size_t ilink) {
+                if (OpenRAVE::IsLinkStateBitEnabled(newLinkEnableStates, ilink)) {
+                    CollisionObjectPtr pcolobj = _fclspace.GetLinkBV(kinBodyInfo, ilink);
+                    if (!!pcolobj) {
+                        fcl::CollisionObject* pColObjRaw = pcolobj.get();
 #ifdef FCLRAVE_USE_REPLACEOBJECT
 #ifdef FCLRAVE_DEBUG_COLLISION_OBJECTS
-                            SaveCollisionObjectDebugInfos(pColObjRaw);
+                        SaveCollisionObjectDebugInfos(pColObjRaw);
 #endif
-                            if (!!cache.vcolobjs.at(ilink)) {
-                                pmanager->replaceObject(cache.vcolobjs.at(ilink).get(), pColObjRaw, false);
-                            } else {
-                                pmanager->registerObject(pColObjRaw);
-                            }
+                        if (!!cache.vcolobjs.at(ilink)) {
+                            pmanager->replaceObject(cache.vcolobjs.at(ilink).get(), pColObjRaw, false);
+                        } else {
+                            pmanager->registerObject(pColObjRaw);
+                        }
 #else
 
-                            // no replace
-                            if (!!cache.vcolobjs.at(ilink)) {
-                                pmanager->unregisterObject(cache.vcolobjs.at(ilink).get());
-                            }
+                        // no replace
+                        if (!!cache.vcolobjs.at(ilink)) {
+                            pmanager->unregisterObject(cache.vcolobjs.at(ilink).get());
+                        }
 #ifdef FCLRAVE_DEBUG_COLLISION_OBJECTS
-                            SaveCollisionObjectDebugInfos(pColObjRaw);
+                        SaveCollisionObjectDebugInfos(pColObjRaw);
 #endif
-                            pmanager->registerObject(pColObjRaw);
+                        pmanager->registerObject(pColObjRaw);
 #endif
-                            bcallsetup = true;
-                        } else {
-                            if (!!cache.vcolobjs.at(ilink)) {
-                                pmanager->unregisterObject(cache.vcolobjs.at(ilink).get());
-                            }
-                        }
-                        cache.vcolobjs.at(ilink) = pcolobj;
+                        bcallsetup = true;
                     } else {
                         if (!!cache.vcolobjs.at(ilink)) {
                             pmanager->unregisterObject(cache.vcolobjs.at(ilink).get());
-                            cache.vcolobjs.at(ilink).reset();
                         }
                     }
+                    cache.vcolobjs.at(ilink) = pcolobj;
+                } else {
+                    if (!!cache.vcolobjs.at(ilink)) {
+                        pmanager->unregisterObject(cache.vcolobjs.at(ilink).get());
+                        cache.vcolobjs.at(ilink).reset();
+                    }
                 }
-            }
+            });
 
             cache.linkEnableStatesBitmasks = newLinkEnableStates;
             cache.nLinkUpdateStamp = kinBodyInfo.nLinkUpdateStamp;
@@ -628,6 +625,7 @@ void FCLCollisionManagerInstance::Synchronize() {
                         // RAVELOG_VERBOSE_FORMAT("env=%d, %x (self=%d), body %s adding obj %x from link %d",
                         // body.GetEnv()->GetId()%this%_fclspace.IsSelfCollisionChecker()%body.GetName()%pColObjRaw%ilink);
                         if (cache.vcolobjs.at(ilink) == pcolobj) {
+                            ++_nBroadphaseUpdates;
 #ifdef FCLRAVE_USE_BULK_UPDATE
                             // same object, so just update
                             pmanager->update(cache.vcolobjs.at(ilink).get(), false);
@@ -819,16 +817,26 @@ bool FCLCollisionManagerInstance::_AddBody(
 
 void FCLCollisionManagerInstance::_UpdateActiveLinks(const RobotBase& robot) {
     _vTrackingActiveLinks.resize(robot.GetLinks().size());
+    OpenRAVE::InitializeLinkStateBitMasks(_vTrackingActiveLinksMask, robot.GetLinks().size());
+    const RobotBase::ActiveDOFProfileConstPtr pprofile = robot.GetActiveDOFProfile();
     for (size_t i = 0; i < robot.GetLinks().size(); ++i) {
-        int isLinkActive = 0;
-        FOREACH(itindex, robot.GetActiveDOFIndices()) {
-            if (robot.DoesAffect(robot.GetJointFromDOFIndex(*itindex)->GetJointIndex(), i)) {
-                isLinkActive = 1;
-                break;
-            }
+        _vTrackingActiveLinks[i] = _IsLinkActive(robot, pprofile, i);
+        if (_vTrackingActiveLinks[i]) {
+            OpenRAVE::EnableLinkStateBit(_vTrackingActiveLinksMask, i);
+        }
+    }
+}
+
+int FCLCollisionManagerInstance::_IsLinkActive(const RobotBase& robot, const RobotBase::ActiveDOFProfileConstPtr& pprofile, size_t ilink) {
+    if (!!pprofile && ilink < pprofile->vActiveLinks.size()) {
+        return pprofile->vActiveLinks[ilink];
+    }
+    FOREACHC(itindex, robot.GetActiveDOFIndices()) {
+        if (robot.DoesAffect(robot.GetJointFromDOFIndex(*itindex)->GetJointIndex(), ilink)) {
+            return 1;
         }
-        _vTrackingActiveLinks[i] = isLinkActive;
     }
+    return 0;
 }
 
 } // namespace fclrave
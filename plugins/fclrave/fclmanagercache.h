@@ -141,6 +141,11 @@ public:
         return _lastSyncTimeStamp;
     }
 
+    /// \brief number of collision objects updated in the broadphase manager since its creation
+    inline uint64_t GetNumBroadphaseUpdates() const {
+        return _nBroadphaseUpdates;
+    }
+
     inline bool IsValid() const
     {
         return !_ptrackingbody.expired(); // expired is slightly faster than lock
@@ -170,6 +175,9 @@ private:
 
     void _UpdateActiveLinks(const RobotBase& robot);
 
+    /// \brief 1 if the link is moved by the active DOFs of the robot, read from the active DOF profile when there is one
+    static int _IsLinkActive(const RobotBase& robot, const RobotBase::ActiveDOFProfileConstPtr& pprofile, size_t ilink);
+
 //    void CheckCount()
 //    {
 //        // count how many entries
@@ -201,12 +209,14 @@ private:
     BroadPhaseCollisionManagerPtr pmanager;
     std::vector<KinBodyCache> _vecCachedBodies; ///< vector of KinBodyCache(weak body, updatestamp)) where index is KinBody::GetEnvironmentBodyIndex. Index 0 has invalid entry because valid env id starts from 1.
     uint32_t _lastSyncTimeStamp; ///< timestamp when last synchronized
+    uint64_t _nBroadphaseUpdates; ///< number of pmanager->update calls, for statistics
 
     std::vector<int8_t> _vecExcludeBodyIndices; ///< any bodies that should not be considered inside the manager, used with environment mode. includes environment body index of of bodies who should be excluded.
     CollisionGroup _tmpSortedBuffer; ///< cache, sorted so that we can efficiently search
 
     KinBodyConstWeakPtr _ptrackingbody; ///< if set, then only tracking the attached bodies if this body
     std::vector<int> _vTrackingActiveLinks; ///< indices of which links are active for tracking body
+    std::vector<uint64_t> _vTrackingActiveLinksMask; ///< _vTrackingActiveLinks as a link state bit mask, kept in sync with it so the enable states can be masked a word at a time
     std::vector<uint64_t> _linkEnableStatesBitmasks; ///< links that are currently inside the manager
     std::vector<uint64_t> _linkEnableStatesCache; ///< memory holder for receiving return value of GetLinkEnableStatesMasks in Synchronize.
 
@@ -237,6 +247,111 @@ private:
 typedef boost::shared_ptr<FCLCollisionManagerInstance> FCLCollisionManagerInstancePtr;
 typedef boost::weak_ptr<FCLCollisionManagerInstance> FCLCollisionManagerInstanceWeakPtr;
 
+/// \brief chooses the broadphase algorithm of the "Auto" mode from the number of objects of the environment managers and how many of them move between queries
+///
+/// Naive has no structure to maintain and wins with few objects. SaP keeps its endpoints sorted by insertion sort, which is cheap when most objects move a little between queries. DynamicAABBTree2 refits the tree for every moved object and answers the queries in logarithmic time, so it wins when only a small part of a large scene moves.
+/// The queries are averaged over windows, the thresholds have hysteresis bands and a new algorithm has to be chosen for several consecutive windows before switching, so that the managers are not rebuilt back and forth.
+class FCLBroadphaseSelector
+{
+public:
+    FCLBroadphaseSelector() : _nSwitches(0) {
+        Reset("DynamicAABBTree2");
+    }
+
+    /// \brief restarts the monitoring from algorithm
+    void Reset(const std::string& algorithm) {
+        _algorithm = algorithm;
+        _candidate.clear();
+        _nCandidateWindows = 0;
+        _nWindowQueries = 0;
+        _nWindowObjects = 0;
+        _nWindowUpdates = 0;
+        _fMeanObjects = 0;
+        _fUpdatesPerQuery = 0;
+    }
+
+    /// \brief records one query of an environment manager
+    ///
+    /// \param numobjects number of collision objects in the manager
+    /// \param numupdates number of them that moved since the previous query
+    /// \return true if the algorithm changed, see GetAlgorithm
+    bool AddQuery(size_t numobjects, uint64_t numupdates) {
+        ++_nWindowQueries;
+        _nWindowObjects += numobjects;
+        _nWindowUpdates += numupdates;
+        if( _nWindowQueries < s_nWindowQueries ) {
+            return false;
+        }
+        _fMeanObjects = double(_nWindowObjects)/_nWindowQueries;
+        _fUpdatesPerQuery = double(_nWindowUpdates)/_nWindowQueries;
+        _nWindowQueries = 0;
+        _nWindowObjects = 0;
+        _nWindowUpdates = 0;
+
+        const char* candidate = _ChooseAlgorithm();
+        if( _algorithm == candidate ) {
+            _candidate.clear();
+            _nCandidateWindows = 0;
+            return false;
+        }
+        if( _candidate != candidate ) {
+            _candidate = candidate;
+            _nCandidateWindows = 0;
+        }
+        if( ++_nCandidateWindows < s_nWindowsToSwitch ) {
+            return false;
+        }
+        RAVELOG_DEBUG_FORMAT("switching broadphase algorithm from %s to %s, %f objects and %f updates per query", _algorithm%_candidate%_fMeanObjects%_fUpdatesPerQuery);
+        _algorithm.swap(_candidate);
+        _candidate.clear();
+        _nCandidateWindows = 0;
+        ++_nSwitches;
+        return true;
+    }
+
+    inline const std::string& GetAlgorithm() const {
+        return _algorithm;
+    }
+
+    inline uint64_t GetNumSwitches() const {
+        return _nSwitches;
+    }
+
+    /// \brief mean number of objects of the managers over the last window
+    inline double GetMeanObjects() const {
+        return _fMeanObjects;
+    }
+
+    /// \brief mean number of moved objects per query over the last window
+    inline double GetUpdatesPerQuery() const {
+        return _fUpdatesPerQuery;
+    }
+
+private:
+    const char* _ChooseAlgorithm() const {
+        // the bounds of the current algorithm are relaxed so that values around a threshold do not make it switch
+        const bool bNaive = _algorithm == "Naive";
+        if( _fMeanObjects < (bNaive ? 24 : 16) ) {
+            return "Naive";
+        }
+        const bool bSaP = _algorithm == "SaP";
+        if( _fUpdatesPerQuery > (bSaP ? 0.3 : 0.5)*_fMeanObjects ) {
+            return "SaP";
+        }
+        return "DynamicAABBTree2";
+    }
+
+    static const uint32_t s_nWindowQueries = 256; ///< number of queries averaged before choosing
+    static const uint32_t s_nWindowsToSwitch = 3; ///< number of consecutive windows choosing the same new algorithm before switching
+
+    std::string _algorithm, _candidate;
+    uint32_t _nCandidateWindows;
+    uint32_t _nWindowQueries;
+    uint64_t _nWindowObjects, _nWindowUpdates;
+    double _fMeanObjects, _fUpdatesPerQuery;
+    uint64_t _nSwitches;
+};
+
 } // end namespace fclrave
 
 #endif
@@ -2,6 +2,7 @@
 
 #include "fclspace.h"
 #include <fcl/container.h>
+#include <boost/functional/hash.hpp>
 
 namespace fclrave {
 
@@ -15,6 +16,183 @@ CollisionGeometryPtr ConvertMeshToFCL(std::vector<fcl::Vec3f> const &points,std:
     return model;
 }
 
+template <class T>
+bool IsSameMeshFCL(const fcl::CollisionGeometry& geom, std::vector<fcl::Vec3f> const &points, std::vector<fcl::Triangle> const &triangles)
+{
+    const fcl::BVHModel<T>* pmodel = dynamic_cast<const fcl::BVHModel<T>*>(&geom);
+    if( !pmodel || pmodel->num_vertices != (int)points.size() || pmodel->num_tris != (int)triangles.size() ) {
+        return false;
+    }
+    for(size_t ipoint = 0; ipoint < points.size(); ++ipoint) {
+        const fcl::Vec3f& v0 = pmodel->vertices[ipoint];
+        const fcl::Vec3f& v1 = points[ipoint];
+        if( v0[0] != v1[0] || v0[1] != v1[1] || v0[2] != v1[2] ) {
+            return false;
+        }
+    }
+    for(size_t itri = 0; itri < triangles.size(); ++itri) {
+        const fcl::Triangle& t0 = pmodel->tri_indices[itri];
+        const fcl::Triangle& t1 = triangles[itri];
+        if( t0[0] != t1[0] || t0[1] != t1[1] || t0[2] != t1[2] ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <class T>
+size_t GetMeshMemoryUsageFCL(const fcl::CollisionGeometry& geom)
+{
+    const fcl::BVHModel<T>* pmodel = dynamic_cast<const fcl::BVHModel<T>*>(&geom);
+    return !!pmodel ? (size_t)pmodel->memUsage(0) : 0;
+}
+
+template <class T>
+bool IntersectRayMeshFCL(const fcl::CollisionGeometry& geom, const fcl::Vec3f& origin, const fcl::Vec3f& dir, fcl::FCL_REAL& t)
+{
+    const fcl::BVHModel<T>* pmodel = dynamic_cast<const fcl::BVHModel<T>*>(&geom);
+    if( !pmodel || pmodel->getNumBVs() == 0 ) {
+        return false;
+    }
+    const fcl::FCL_REAL fSqrDirLength = dir.sqrLength();
+    if( fSqrDirLength <= 0 ) {
+        return false;
+    }
+
+    // the bounding volume types do not share a ray test, so every node is culled with the sphere enclosing its bounding volume
+    bool bHit = false;
+    std::vector<int> vstack;
+    vstack.reserve(64);
+    vstack.push_back(0);
+    while( !vstack.empty() ) {
+        const fcl::BVNode<T>& node = pmodel->getBV(vstack.back());
+        vstack.pop_back();
+
+        const fcl::Vec3f vcenter = node.bv.center();
+        const fcl::FCL_REAL fSqrRadius = 0.25*(node.bv.width()*node.bv.width() + node.bv.height()*node.bv.height() + node.bv.depth()*node.bv.depth());
+        const fcl::FCL_REAL tclosest = std::max(fcl::FCL_REAL(0), std::min(t, (vcenter - origin).dot(dir)/fSqrDirLength));
+        if( (origin + dir*tclosest - vcenter).sqrLength() > fSqrRadius ) {
+            continue;
+        }
+
+        if( !node.isLeaf() ) {
+            vstack.push_back(node.leftChild());
+            vstack.push_back(node.rightChild());
+            continue;
+        }
+
+        // Moller-Trumbore, both faces are hit
+        const fcl::Triangle& triangle = pmodel->tri_indices[node.primitiveId()];
+        const fcl::Vec3f& v0 = pmodel->vertices[triangle[0]];
+        const fcl::Vec3f e1 = pmodel->vertices[triangle[1]] - v0, e2 = pmodel->vertices[triangle[2]] - v0;
+        const fcl::Vec3f p = dir.cross(e2);
+        const fcl::FCL_REAL det = e1.dot(p);
+        if( std::abs(det) <= 1e-15 ) {
+            continue;
+        }
+        const fcl::FCL_REAL invdet = 1/det;
+        const fcl::Vec3f s = origin - v0;
+        const fcl::FCL_REAL u = s.dot(p)*invdet;
+        if( u < 0 || u > 1 ) {
+            continue;
+        }
+        const fcl::Vec3f q = s.cross(e1);
+        const fcl::FCL_REAL v = dir.dot(q)*invdet;
+        if( v < 0 || u + v > 1 ) {
+            continue;
+        }
+        const fcl::FCL_REAL thit = e2.dot(q)*invdet;
+        if( thit >= 0 && thit <= t ) {
+            t = thit;
+            bHit = true;
+        }
+    }
+    return bHit;
+}
+
+FCLMeshCache& FCLMeshCache::GetInstance()
+{
+    static FCLMeshCache s_meshCache;
+    return s_meshCache;
+}
+
+size_t FCLMeshCache::_ComputeMeshHash(const std::string& bvhRepresentation, std::vector<fcl::Vec3f> const &points, std::vector<fcl::Triangle> const &triangles)
+{
+    size_t hash = boost::hash_value(bvhRepresentation);
+    boost::hash_combine(hash, points.size());
+    boost::hash_combine(hash, triangles.size());
+    for (const fcl::Vec3f& point : points) {
+        boost::hash_combine(hash, point[0]);
+        boost::hash_combine(hash, point[1]);
+        boost::hash_combine(hash, point[2]);
+    }
+    for (const fcl::Triangle& triangle : triangles) {
+        boost::hash_combine(hash, triangle[0]);
+        boost::hash_combine(hash, triangle[1]);
+        boost::hash_combine(hash, triangle[2]);
+    }
+    return hash;
+}
+
+CollisionGeometryPtr FCLMeshCache::GetOrCreateMesh(const std::string& bvhRepresentation, const MeshFactory& meshFactory, MeshComparator meshComparator, MeshMemoryUsage meshMemoryUsage, std::vector<fcl::Vec3f> const &points, std::vector<fcl::Triangle> const &triangles)
+{
+    const size_t hash = _ComputeMeshHash(bvhRepresentation, points, triangles);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::pair<std::unordered_multimap<size_t, MeshEntry>::iterator, std::unordered_multimap<size_t, MeshEntry>::iterator> itrange = _mapMeshes.equal_range(hash);
+        std::unordered_multimap<size_t, MeshEntry>::iterator it = itrange.first;
+        while( it != itrange.second ) {
+            CollisionGeometryPtr pgeom = it->second.pgeom.lock();
+            if( !pgeom ) {
+                it = _mapMeshes.erase(it);
+                continue;
+            }
+            // the representation is part of the hash, but the comparator also guards against collisions between representations
+            if( it->second.meshComparator == meshComparator && meshComparator(*pgeom, points, triangles) ) {
+                _statistics.nHits++;
+                _statistics.nBytesSaved += it->second.nBytes;
+                return pgeom;
+            }
+            ++it;
+        }
+    }
+
+    // build outside of the lock since it can take a long time for big meshes. If two spaces build the same mesh concurrently, both are kept alive and the first one stays discoverable.
+    CollisionGeometryPtr pgeom = meshFactory(points, triangles);
+    if( !pgeom ) {
+        return pgeom;
+    }
+    // computeLocalAABB is called by the fcl::CollisionObject constructor, so compute it once here before the model starts being shared between threads
+    pgeom->computeLocalAABB();
+
+    MeshEntry entry;
+    entry.pgeom = pgeom;
+    entry.meshComparator = meshComparator;
+    entry.nBytes = meshMemoryUsage(*pgeom);
+    std::lock_guard<std::mutex> lock(_mutex);
+    _statistics.nMisses++;
+    _mapMeshes.emplace(hash, entry);
+    return pgeom;
+}
+
+FCLMeshCache::Statistics FCLMeshCache::GetStatistics()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _statistics.nBytes = 0;
+    std::unordered_multimap<size_t, MeshEntry>::iterator it = _mapMeshes.begin();
+    while( it != _mapMeshes.end() ) {
+        if( it->second.pgeom.expired() ) {
+            it = _mapMeshes.erase(it);
+        }
+        else {
+            _statistics.nBytes += it->second.nBytes;
+            ++it;
+        }
+    }
+    _statistics.nEntries = _mapMeshes.size();
+    return _statistics;
+}
+
 void FCLSpace::FCLKinBodyInfo::Reset()
 {
     FOREACH(itlink, vlinks) {
@@ -42,10 +220,65 @@ FCLSpace::FCLKinBodyInfo::LinkInfo::LinkInfo(KinBody::LinkPtr plink) : _plink(pl
 {
 }
 
+/// \brief adds the circumscribed spheres of the cells of the box [vmin, vmax] touching the geometry, splitting the box until its sides are not longer than fmaxside
+static void _AddCoveringSpheres(fcl::CollisionObject& geomobject, const fcl::Vec3f& vmin, const fcl::Vec3f& vmax, fcl::FCL_REAL fmaxside, const Transform& tgeom, std::vector<Vector>& vspheres)
+{
+    const fcl::Vec3f vsize = vmax - vmin;
+    fcl::CollisionObject boxobject(std::make_shared<fcl::Box>(vsize[0], vsize[1], vsize[2]), fcl::Transform3f((vmin + vmax)*0.5));
+    fcl::CollisionRequest request;
+    fcl::CollisionResult result;
+    if( fcl::collide(&boxobject, &geomobject, request, result) == 0 ) {
+        return;
+    }
+    int isplit = 0;
+    for(int idim = 1; idim < 3; ++idim) {
+        if( vsize[idim] > vsize[isplit] ) {
+            isplit = idim;
+        }
+    }
+    if( vsize[isplit] <= fmaxside ) {
+        Vector vsphere = tgeom*ConvertVectorFromFCL((vmin + vmax)*0.5);
+        vsphere.w = 0.5*vsize.length();
+        vspheres.push_back(vsphere);
+        return;
+    }
+    fcl::Vec3f vmid0 = vmax, vmid1 = vmin;
+    vmid0[isplit] = vmid1[isplit] = 0.5*(vmin[isplit] + vmax[isplit]);
+    _AddCoveringSpheres(geomobject, vmin, vmid0, fmaxside, tgeom, vspheres);
+    _AddCoveringSpheres(geomobject, vmid1, vmax, fmaxside, tgeom, vspheres);
+}
+
+const std::vector<Vector>& FCLSpace::FCLKinBodyInfo::LinkInfo::GetCoveringSpheres()
+{
+    if( vcoveringspheres.empty() ) {
+        FOREACHC(itgeompair, vgeoms) {
+            const std::shared_ptr<fcl::CollisionGeometry>& pgeometry = itgeompair->second->collisionGeometry();
+            // collide in the frame of the geometry
+            fcl::CollisionObject geomobject(pgeometry);
+            const fcl::AABB& ablocal = pgeometry->aabb_local;
+            const fcl::FCL_REAL fmaxside = 0.25*std::max(ablocal.width(), std::max(ablocal.height(), ablocal.depth()));
+            if( fmaxside <= 0 ) {
+                Vector vsphere = itgeompair->first*ConvertVectorFromFCL(ablocal.center());
+                vsphere.w = 0;
+                vcoveringspheres.push_back(vsphere);
+                continue;
+            }
+            // leave a margin so that the geometries touching the sides of the box are kept
+            const fcl::Vec3f vmargin(1e-6*fmaxside, 1e-6*fmaxside, 1e-6*fmaxside);
+            _AddCoveringSpheres(geomobject, ablocal.min_ - vmargin, ablocal.max_ + vmargin, fmaxside*(1 + 1e-5), itgeompair->first, vcoveringspheres);
+        }
+    }
+    return vcoveringspheres;
+}
+
 FCLSpace::FCLSpace(EnvironmentBasePtr penv, const std::string& userdatakey)
     : _penv(penv)
     , _userdatakey(userdatakey)
     , _currentpinfo(1, FCLKinBodyInfoPtr()) // initialize with one null pointer, this is a place holder for null pointer so that we can return by reference. env id 0 means invalid so it's consistent with the definition as well
+    , _meshComparator(nullptr)
+    , _meshMemoryUsage(nullptr)
+    , _meshRayIntersector(nullptr)
+    , _bUseMeshCache(true)
     , _bIsSelfCollisionChecker(true)
 {
     // After many test, OBB seems to be the only real option (followed by kIOS which is needed for distance checking)
@@ -71,6 +304,58 @@ void FCLSpace::DestroyEnvironment()
     _vecInitializedBodies.clear();
 }
 
+/// \brief creates the bounding box collision object of a link enclosing enclosingBV in the link frame
+static TranslationCollisionPair _CreateLinkBV(FCLSpace::FCLKinBodyInfo::LinkInfo& linkinfo, const fcl::AABB& enclosingBV)
+{
+    CollisionGeometryPtr pfclgeomBV = std::make_shared<fcl::Box>(enclosingBV.max_ - enclosingBV.min_);
+    CollisionObjectPtr pfclcollBV = boost::make_shared<fcl::CollisionObject>(pfclgeomBV);
+    const Vector trans = ConvertVectorFromFCL(0.5 * (enclosingBV.min_ + enclosingBV.max_));
+    pfclcollBV->setUserData(&linkinfo);
+    return std::make_pair(trans, pfclcollBV);
+}
+
+bool FCLSpace::_ReloadGeometryTransforms(const KinBody& body, FCLKinBodyInfo& info)
+{
+    const std::vector<KinBody::LinkPtr>& vlinks = body.GetLinks();
+    if( info.vlinks.size() != vlinks.size() ) {
+        return false;
+    }
+    for(size_t ilink = 0; ilink < vlinks.size(); ++ilink) {
+        const FCLKinBodyInfo::LinkInfo& linkinfo = *info.vlinks[ilink];
+        if( linkinfo.GetLink() != vlinks[ilink] || linkinfo.nGeometryShapeStamp != vlinks[ilink]->GetGeometryShapeStamp() || linkinfo.vgeominfos.size() != linkinfo.vgeoms.size() ) {
+            return false;
+        }
+        for (const boost::shared_ptr<FCLKinBodyInfo::FCLGeometryInfo>& pgeominfo : linkinfo.vgeominfos) {
+            if( !pgeominfo->GetGeometry() ) {
+                return false;
+            }
+        }
+    }
+
+    for (const boost::shared_ptr<FCLKinBodyInfo::LinkInfo>& plinkinfo : info.vlinks) {
+        FCLKinBodyInfo::LinkInfo& linkinfo = *plinkinfo;
+        if( linkinfo.vgeoms.empty() ) {
+            continue;
+        }
+        linkinfo.vcoveringspheres.resize(0);
+        fcl::AABB enclosingBV;
+        for(size_t igeom = 0; igeom < linkinfo.vgeoms.size(); ++igeom) {
+            const KinBody::GeometryPtr pgeom = linkinfo.vgeominfos[igeom]->GetGeometry();
+            linkinfo.vgeoms[igeom].first = pgeom->GetTransform();
+            if( igeom == 0 ) {
+                enclosingBV = ConvertAABBToFcl(pgeom->ComputeAABB(Transform()));
+            }
+            else {
+                enclosingBV += ConvertAABBToFcl(pgeom->ComputeAABB(Transform()));
+            }
+        }
+        // the broadphase managers re-register the link objects since the callback incremented nGeometryUpdateStamp
+        linkinfo.linkBV.second->setUserData(nullptr);
+        linkinfo.linkBV = _CreateLinkBV(linkinfo, enclosingBV);
+    }
+    return true;
+}
+
 void FCLSpace::ReloadKinBodyLinks(KinBodyConstPtr pbody, FCLKinBodyInfoPtr pinfo) {
     // If the body hasn't changed, don't reload the links.
     if (pbody->GetUpdateStamp() == pinfo->nLastLinkReloadStamp) {
@@ -78,6 +363,14 @@ void FCLSpace::ReloadKinBodyLinks(KinBodyConstPtr pbody, FCLKinBodyInfoPtr pinfo
     }
     pinfo->nLastLinkReloadStamp = pbody->GetUpdateStamp();
 
+    if( _ReloadGeometryTransforms(*pbody, *pinfo) ) {
+        return;
+    }
+
+    if( _bUseConvexDecomposition ) {
+        _DecomposeBodyMeshes(*pbody, pinfo->_geometrygroup);
+    }
+
     pinfo->vlinks.clear();
     pinfo->vlinks.reserve(pbody->GetLinks().size());
     FOREACHC(itlink, pbody->GetLinks()) {
@@ -106,7 +399,7 @@ void FCLSpace::ReloadKinBodyLinks(KinBodyConstPtr pbody, FCLKinBodyInfoPtr pinfo
                 // or, should the collision report store names of body, link, and geom?
                 // also, currently there is no information about which geometry group was used for collision checking.
                 // It's usually obvious immediately after CheckCollision is called, but later on, it it is not that obvious collision report is computed with which geometry group.
-                pfclgeom->setUserData(nullptr);
+                // the user data of pfclgeom is not touched since the geometry can be shared with other spaces through FCLMeshCache.
 
                 // We do not set the transformation here and leave it to _Synchronize
                 CollisionObjectPtr pfclcoll = boost::make_shared<fcl::CollisionObject>(pfclgeom);
@@ -134,7 +427,7 @@ void FCLSpace::ReloadKinBodyLinks(KinBodyConstPtr pbody, FCLKinBodyInfoPtr pinfo
                 }
                 boost::shared_ptr<FCLKinBodyInfo::FCLGeometryInfo> pfclgeominfo(new FCLKinBodyInfo::FCLGeometryInfo(pgeom));
                 pfclgeominfo->bodylinkgeomname = pbody->GetName() + "/" + plink->GetName() + "/" + pgeom->GetName();
-                pfclgeom->setUserData(pfclgeominfo.get());
+                // the collision geometry can be shared with other spaces through FCLMeshCache, so the geometry info is looked up from mapgeominfos instead of the geometry user data
                 // save the pointers
                 linkinfo->vgeominfos.push_back(pfclgeominfo);
 
@@ -143,6 +436,7 @@ void FCLSpace::ReloadKinBodyLinks(KinBodyConstPtr pbody, FCLKinBodyInfoPtr pinfo
                 pfclcoll->setUserData(linkinfo.get());
 
                 linkinfo->vgeoms.push_back(TransformCollisionPair(geominfo.GetTransform(), pfclcoll));
+                linkinfo->mapgeominfos[pfclcoll.get()] = pfclgeominfo.get();
 
                 KinBody::Link::Geometry _tmpgeometry(boost::shared_ptr<KinBody::Link>(), geominfo);
                 if( itgeom == vgeometries.begin() ) {
@@ -152,18 +446,14 @@ void FCLSpace::ReloadKinBodyLinks(KinBodyConstPtr pbody, FCLKinBodyInfoPtr pinfo
                     enclosingBV += ConvertAABBToFcl(_tmpgeometry.ComputeAABB(Transform()));
                 }
             }
+            linkinfo->nGeometryShapeStamp = plink->GetGeometryShapeStamp();
         }
 
         if( linkinfo->vgeoms.size() == 0 ) {
             RAVELOG_DEBUG_FORMAT("env=%s, Initializing body '%s' (index=%d) link '%s' with 0 geometries (env %d) (userdatakey %s)", _penv->GetNameId()%pbody->GetName()%pbody->GetEnvironmentBodyIndex()%plink->GetName()%_penv->GetId()%_userdatakey);
         }
         else {
-            CollisionGeometryPtr pfclgeomBV = std::make_shared<fcl::Box>(enclosingBV.max_ - enclosingBV.min_);
-            pfclgeomBV->setUserData(nullptr);
-            CollisionObjectPtr pfclcollBV = boost::make_shared<fcl::CollisionObject>(pfclgeomBV);
-            const Vector trans = ConvertVectorFromFCL(0.5 * (enclosingBV.min_ + enclosingBV.max_));
-            pfclcollBV->setUserData(linkinfo.get());
-            linkinfo->linkBV = std::make_pair(trans, pfclcollBV);
+            linkinfo->linkBV = _CreateLinkBV(*linkinfo, enclosingBV);
         }
 
         //link->nLastStamp = pinfo->nLastStamp;
@@ -310,27 +600,51 @@ void FCLSpace::SetBVHRepresentation(std::string const &type)
     if (type == "AABB") {
         _bvhRepresentation = type;
         _meshFactory = &ConvertMeshToFCL<fcl::AABB>;
+        _meshComparator = &IsSameMeshFCL<fcl::AABB>;
+        _meshMemoryUsage = &GetMeshMemoryUsageFCL<fcl::AABB>;
+        _meshRayIntersector = &IntersectRayMeshFCL<fcl::AABB>;
     } else if (type == "OBB") {
         _bvhRepresentation = type;
         _meshFactory = &ConvertMeshToFCL<fcl::OBB>;
+        _meshComparator = &IsSameMeshFCL<fcl::OBB>;
+        _meshMemoryUsage = &GetMeshMemoryUsageFCL<fcl::OBB>;
+        _meshRayIntersector = &IntersectRayMeshFCL<fcl::OBB>;
     } else if (type == "RSS") {
         _bvhRepresentation = type;
         _meshFactory = &ConvertMeshToFCL<fcl::RSS>;
+        _meshComparator = &IsSameMeshFCL<fcl::RSS>;
+        _meshMemoryUsage = &GetMeshMemoryUsageFCL<fcl::RSS>;
+        _meshRayIntersector = &IntersectRayMeshFCL<fcl::RSS>;
     } else if (type == "OBBRSS") {
         _bvhRepresentation = type;
         _meshFactory = &ConvertMeshToFCL<fcl::OBBRSS>;
+        _meshComparator = &IsSameMeshFCL<fcl::OBBRSS>;
+        _meshMemoryUsage = &GetMeshMemoryUsageFCL<fcl::OBBRSS>;
+        _meshRayIntersector = &IntersectRayMeshFCL<fcl::OBBRSS>;
     } else if (type == "kDOP16") {
         _bvhRepresentation = type;
         _meshFactory = &ConvertMeshToFCL< fcl::KDOP<16> >;
+        _meshComparator = &IsSameMeshFCL< fcl::KDOP<16> >;
+        _meshMemoryUsage = &GetMeshMemoryUsageFCL< fcl::KDOP<16> >;
+        _meshRayIntersector = &IntersectRayMeshFCL< fcl::KDOP<16> >;
     } else if (type == "kDOP18") {
         _bvhRepresentation = type;
         _meshFactory = &ConvertMeshToFCL< fcl::KDOP<18> >;
+        _meshComparator = &IsSameMeshFCL< fcl::KDOP<18> >;
+        _meshMemoryUsage = &GetMeshMemoryUsageFCL< fcl::KDOP<18> >;
+        _meshRayIntersector = &IntersectRayMeshFCL< fcl::KDOP<18> >;
     } else if (type == "kDOP24") {
         _bvhRepresentation = type;
         _meshFactory = &ConvertMeshToFCL< fcl::KDOP<24> >;
+        _meshComparator = &IsSameMeshFCL< fcl::KDOP<24> >;
+        _meshMemoryUsage = &GetMeshMemoryUsageFCL< fcl::KDOP<24> >;
+        _meshRayIntersector = &IntersectRayMeshFCL< fcl::KDOP<24> >;
     } else if (type == "kIOS") {
         _bvhRepresentation = type;
         _meshFactory = &ConvertMeshToFCL<fcl::kIOS>;
+        _meshComparator = &IsSameMeshFCL<fcl::kIOS>;
+        _meshMemoryUsage = &GetMeshMemoryUsageFCL<fcl::kIOS>;
+        _meshRayIntersector = &IntersectRayMeshFCL<fcl::kIOS>;
     } else {
         RAVELOG_WARN(str(boost::format("Unknown BVH representation '%s', keeping '%s' representation") % type % _bvhRepresentation));
         return;
@@ -353,6 +667,27 @@ std::string const& FCLSpace::GetBVHRepresentation() const {
     return _bvhRepresentation;
 }
 
+void FCLSpace::SetUseConvexDecomposition(bool bUseConvexDecomposition, const ConvexDecompositionParameters& params, int numthreads)
+{
+    _nConvexDecompositionThreads = numthreads;
+    if( bUseConvexDecomposition == _bUseConvexDecomposition && (!bUseConvexDecomposition || params == _convexDecompositionParameters) ) {
+        return;
+    }
+    _bUseConvexDecomposition = bUseConvexDecomposition;
+    _convexDecompositionParameters = params;
+
+    // reinitialize all the FCLKinBodyInfo
+    for (const KinBodyConstPtr& pbody : _vecInitializedBodies) {
+        if (!pbody) {
+            continue;
+        }
+        FCLKinBodyInfoPtr& pinfo = GetInfo(*pbody);
+        pinfo->nGeometryUpdateStamp++;
+        InitKinBody(pbody, pinfo);
+    }
+    _cachedpinfo.clear();
+}
+
 void FCLSpace::Synchronize()
 {
     // We synchronize only the initialized bodies, which differs from oderave
@@ -464,6 +799,112 @@ void _AppendFclBoxCollsionObject(const OpenRAVE::Vector& fullExtents, const Open
     contents.emplace_back(std::make_shared<fcl::CollisionObject>(fclGeom, fclTrans));
 }
 
+static const int s_nRevolutionSections = 24; ///< number of sides of the polygons replacing the circles of the solids of revolution
+
+/// \brief appends the convex piece between two circles centered on the z-axis, zbottom < ztop. The circles are replaced by circumscribed polygons so that the piece contains the exact solid.
+static void _AppendFrustumConvexHull(OpenRAVE::dReal zbottom, OpenRAVE::dReal rbottom, OpenRAVE::dReal ztop, OpenRAVE::dReal rtop, std::vector<ConvexHull>& vhulls)
+{
+    const int N = s_nRevolutionSections;
+    const OpenRAVE::dReal fcircumscribed = 1/std::cos(OpenRAVE::PI/N);
+    vhulls.push_back(ConvexHull());
+    ConvexHull& hull = vhulls.back();
+    // a circle of radius 0 is a single apex point
+    const int numbottom = rbottom > 0 ? N : 1, numtop = rtop > 0 ? N : 1;
+    hull.vpoints.reserve(numbottom + numtop);
+    for(int iring = 0; iring < 2; ++iring) {
+        const OpenRAVE::dReal z = iring == 0 ? zbottom : ztop, r = iring == 0 ? rbottom : rtop;
+        const int numpoints = iring == 0 ? numbottom : numtop;
+        for(int ipoint = 0; ipoint < numpoints; ++ipoint) {
+            const OpenRAVE::dReal theta = 2*OpenRAVE::PI*ipoint/N;
+            hull.vpoints.push_back(fcl::Vec3f(r*fcircumscribed*std::cos(theta), r*fcircumscribed*std::sin(theta), z));
+        }
+    }
+
+    if( numbottom > 1 ) {
+        hull.vplanenormals.push_back(fcl::Vec3f(0, 0, -1));
+        hull.vplanedistances.push_back(-zbottom);
+        hull.vpolygons.push_back(N);
+        for(int ipoint = N-1; ipoint >= 0; --ipoint) {
+            hull.vpolygons.push_back(ipoint);
+        }
+    }
+    if( numtop > 1 ) {
+        hull.vplanenormals.push_back(fcl::Vec3f(0, 0, 1));
+        hull.vplanedistances.push_back(ztop);
+        hull.vpolygons.push_back(N);
+        for(int ipoint = 0; ipoint < N; ++ipoint) {
+            hull.vpolygons.push_back(numbottom + ipoint);
+        }
+    }
+    // the sides are tangent to the circles in the middle of the polygon edges
+    const OpenRAVE::dReal height = ztop - zbottom;
+    const OpenRAVE::dReal fnormallength = std::sqrt(height*height + (rbottom - rtop)*(rbottom - rtop));
+    for(int iside = 0; iside < N; ++iside) {
+        const int inext = (iside + 1) % N;
+        const OpenRAVE::dReal theta = 2*OpenRAVE::PI*(iside + 0.5)/N;
+        const OpenRAVE::dReal c = std::cos(theta), s = std::sin(theta);
+        hull.vplanenormals.push_back(fcl::Vec3f(height*c/fnormallength, height*s/fnormallength, (rbottom - rtop)/fnormallength));
+        hull.vplanedistances.push_back((height*rbottom + (rbottom - rtop)*zbottom)/fnormallength);
+        hull.vpolygons.push_back((numbottom > 1) + (numtop > 1) + 2);
+        if( numbottom > 1 ) {
+            hull.vpolygons.push_back(iside);
+            hull.vpolygons.push_back(inext);
+        }
+        else {
+            hull.vpolygons.push_back(0);
+        }
+        if( numtop > 1 ) {
+            hull.vpolygons.push_back(numbottom + inext);
+            hull.vpolygons.push_back(numbottom + iside);
+        }
+        else {
+            hull.vpolygons.push_back(numbottom);
+        }
+    }
+}
+
+/// \brief creates the geometry of a solid of revolution around the z-axis from the radii of its sections sorted by z, as one convex piece per pair of consecutive sections
+static CollisionGeometryPtr _CreateFCLRevolutionGeometry(const std::vector<KinBody::GeometryInfo::AxialSlice>& vsortedslices)
+{
+    std::vector<ConvexHull> vhulls;
+    for(size_t islice = 0; islice+1 < vsortedslices.size(); ++islice) {
+        const KinBody::GeometryInfo::AxialSlice& bottom = vsortedslices[islice];
+        const KinBody::GeometryInfo::AxialSlice& top = vsortedslices[islice+1];
+        // flat sections and sections without radius have no volume
+        if( top.zOffset - bottom.zOffset < 1e-6 || (bottom.radius <= 0 && top.radius <= 0) ) {
+            continue;
+        }
+        _AppendFrustumConvexHull(bottom.zOffset, std::max(OpenRAVE::dReal(0), bottom.radius), top.zOffset, std::max(OpenRAVE::dReal(0), top.radius), vhulls);
+    }
+    if( vhulls.empty() ) {
+        return CollisionGeometryPtr();
+    }
+    return CreateFCLConvexContainer(std::make_shared<const std::vector<ConvexHull> >(std::move(vhulls)));
+}
+
+void FCLSpace::_DecomposeBodyMeshes(const KinBody& body, const std::string& geometrygroup)
+{
+    std::vector<const OpenRAVE::TriMesh*> vmeshes;
+    for (const KinBody::LinkPtr& plink : body.GetLinks()) {
+        if( geometrygroup.size() > 0 && plink->GetGroupNumGeometries(geometrygroup) >= 0 ) {
+            for (const KinBody::GeometryInfoPtr& pgeominfo : plink->GetGeometriesFromGroup(geometrygroup)) {
+                if( !!pgeominfo && pgeominfo->_type == OpenRAVE::GT_TriMesh ) {
+                    vmeshes.push_back(&pgeominfo->_meshcollision);
+                }
+            }
+        }
+        else {
+            for (const KinBody::Link::GeometryPtr& pgeom : plink->GetGeometries()) {
+                const KinBody::GeometryInfo& geominfo = pgeom->GetInfo();
+                if( geominfo._type == OpenRAVE::GT_TriMesh ) {
+                    vmeshes.push_back(&geominfo._meshcollision);
+                }
+            }
+        }
+    }
+    FCLConvexDecompositionCache::GetInstance().DecomposeMeshes(vmeshes, _convexDecompositionParameters, _nConvexDecompositionThreads);
+}
+
 CollisionGeometryPtr FCLSpace::_CreateFCLGeomFromGeometryInfo(const KinBody::GeometryInfo &info)
 {
     switch(info._type) {
@@ -538,7 +979,24 @@ CollisionGeometryPtr FCLSpace::_CreateFCLGeomFromGeometryInfo(const KinBody::Geo
         return std::make_shared<fcl::Container>(contents);
     }
     case OpenRAVE::GT_ConicalFrustum:
+    {
+        const OpenRAVE::dReal halfheight = 0.5*info.GetConicalFrustumHeight();
+        if( info.GetConicalFrustumTopRadius() == info.GetConicalFrustumBottomRadius() ) {
+            return std::make_shared<fcl::Cylinder>(info.GetConicalFrustumTopRadius(), info.GetConicalFrustumHeight());
+        }
+        std::vector<KinBody::GeometryInfo::AxialSlice> vslices(2);
+        vslices[0].zOffset = -halfheight;
+        vslices[0].radius = info.GetConicalFrustumBottomRadius();
+        vslices[1].zOffset = halfheight;
+        vslices[1].radius = info.GetConicalFrustumTopRadius();
+        return _CreateFCLRevolutionGeometry(vslices);
+    }
     case OpenRAVE::GT_Axial:
+    {
+        std::vector<KinBody::GeometryInfo::AxialSlice> vslices = info._vAxialSlices;
+        std::sort(vslices.begin(), vslices.end());
+        return _CreateFCLRevolutionGeometry(vslices);
+    }
     case OpenRAVE::GT_TriMesh:
     {
         const OpenRAVE::TriMesh& mesh = info._meshcollision;
@@ -547,6 +1005,14 @@ CollisionGeometryPtr FCLSpace::_CreateFCLGeomFromGeometryInfo(const KinBody::Geo
         }
 
         OPENRAVE_ASSERT_OP(mesh.indices.size() % 3, ==, 0);
+        if( _bUseConvexDecomposition ) {
+            CollisionGeometryPtr pconvexgeom = CreateFCLConvexContainer(FCLConvexDecompositionCache::GetInstance().GetOrCreateConvexHulls(mesh, _convexDecompositionParameters));
+            if( !!pconvexgeom ) {
+                return pconvexgeom;
+            }
+            RAVELOG_WARN_FORMAT("env=%s, convex decomposition of mesh with %d vertices returned no pieces, using its BVH", _penv->GetNameId()%mesh.vertices.size());
+        }
+
         size_t const num_points = mesh.vertices.size();
         size_t const num_triangles = mesh.indices.size() / 3;
 
@@ -562,6 +1028,9 @@ CollisionGeometryPtr FCLSpace::_CreateFCLGeomFromGeometryInfo(const KinBody::Geo
             fcl_triangles[itri] = fcl::Triangle(tri_indices[0], tri_indices[1], tri_indices[2]);
         }
 
+        if( _bUseMeshCache ) {
+            return FCLMeshCache::GetInstance().GetOrCreateMesh(_bvhRepresentation, _meshFactory, _meshComparator, _meshMemoryUsage, fcl_points, fcl_triangles);
+        }
         return _meshFactory(fcl_points, fcl_triangles);
     }
 
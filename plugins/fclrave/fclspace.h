@@ -4,8 +4,12 @@
 
 #include <boost/shared_ptr.hpp>
 #include <memory> // c++11
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
+#include "fclconvexdecomposition.h"
+
 namespace fclrave {
 
 typedef KinBody::LinkConstPtr LinkConstPtr;
@@ -25,6 +29,9 @@ typedef std::vector<fcl::CollisionObject *> CollisionGroup;
 typedef boost::shared_ptr<CollisionGroup> CollisionGroupPtr;
 typedef std::pair<Transform, CollisionObjectPtr> TransformCollisionPair;
 typedef std::pair<Vector, CollisionObjectPtr> TranslationCollisionPair;
+typedef bool (*MeshComparator)(const fcl::CollisionGeometry& geom, std::vector<fcl::Vec3f> const &points, std::vector<fcl::Triangle> const &triangles);
+typedef size_t (*MeshMemoryUsage)(const fcl::CollisionGeometry& geom);
+typedef bool (*MeshRayIntersector)(const fcl::CollisionGeometry& geom, const fcl::Vec3f& origin, const fcl::Vec3f& dir, fcl::FCL_REAL& t);
 
 
 // Helper functions for conversions from OpenRAVE to FCL
@@ -61,6 +68,45 @@ inline void EnsureVectorSize(std::vector<T>& vec, size_t size)
     }
 }
 
+/// \brief process-wide cache of immutable BVH models shared by all FCLSpace instances
+///
+/// Models are keyed by the content hash of the mesh and the BVH representation, and are only held through weak pointers,
+/// so a model is destroyed as soon as the last collision object using it goes away. Hash collisions are resolved by comparing the mesh contents.
+class FCLMeshCache
+{
+public:
+    struct Statistics
+    {
+        uint64_t nHits = 0; ///< number of requests served with an existing model
+        uint64_t nMisses = 0; ///< number of models that had to be built
+        uint64_t nBytesSaved = 0; ///< accumulated size of the models that did not have to be built
+        size_t nEntries = 0; ///< number of models currently alive in the cache
+        uint64_t nBytes = 0; ///< size of the models currently alive in the cache
+    };
+
+    static FCLMeshCache& GetInstance();
+
+    /// \brief returns a shared model for the mesh, building it with meshFactory if no identical model is alive
+    CollisionGeometryPtr GetOrCreateMesh(const std::string& bvhRepresentation, const MeshFactory& meshFactory, MeshComparator meshComparator, MeshMemoryUsage meshMemoryUsage, std::vector<fcl::Vec3f> const &points, std::vector<fcl::Triangle> const &triangles);
+
+    /// \brief returns the current statistics, removing expired entries first
+    Statistics GetStatistics();
+
+private:
+    struct MeshEntry
+    {
+        std::weak_ptr<fcl::CollisionGeometry> pgeom;
+        MeshComparator meshComparator;
+        size_t nBytes;
+    };
+
+    static size_t _ComputeMeshHash(const std::string& bvhRepresentation, std::vector<fcl::Vec3f> const &points, std::vector<fcl::Triangle> const &triangles);
+
+    std::mutex _mutex;
+    std::unordered_multimap<size_t, MeshEntry> _mapMeshes; ///< content hash -> model
+    Statistics _statistics;
+};
+
 /// \brief fcl spaces manages the individual collision objects and sets up callbacks to track their changes.
 ///
 /// It does not know or manage the broadphase manager
@@ -120,23 +166,40 @@ public:
                     (*itgeompair).second.reset();
                 }
                 vgeoms.resize(0);
+                mapgeominfos.clear();
 
                 // make sure to clear vgeominfos after vgeoms because the CollisionObject inside each vgeom element has a corresponding vgeominfo as a void pointer.
                 vgeominfos.resize(0);
+                vcoveringspheres.resize(0);
             }
 
+            /// \brief returns spheres whose union contains the geometries of the link, computed on the first call
+            ///
+            /// Every geometry is split into at most 4x4x4 cells of its bounding box, and the cells touching the geometry are covered by their circumscribed spheres. Like fcl, the inside of meshes is not covered.
+            /// \return the spheres in the link frame, xyz is the center and w the radius
+            const std::vector<Vector>& GetCoveringSpheres();
+
             inline KinBody::LinkPtr GetLink() const {
                 return _plink.lock();
             }
 
+            /// \brief returns the geometry info of a collision object of vgeoms, or nullptr if the link was created from a geometry group
+            inline FCLGeometryInfo* GetGeometryInfo(const fcl::CollisionObject& coll) const {
+                std::unordered_map<const fcl::CollisionObject*, FCLGeometryInfo*>::const_iterator it = mapgeominfos.find(&coll);
+                return it != mapgeominfos.end() ? it->second : nullptr;
+            }
+
             KinBody::LinkWeakPtr _plink;
-            vector< boost::shared_ptr<FCLGeometryInfo> > vgeominfos; ///< info for every geometry of the link
+            vector< boost::shared_ptr<FCLGeometryInfo> > vgeominfos; ///< info for every geometry of the link. If not empty, vgeominfos[i] corresponds to vgeoms[i]
 
             //int nLastStamp; ///< Tracks if the collision geometries are up to date wrt the body update stamp. This is for narrow phase collision
             TranslationCollisionPair linkBV; ///< pair of the translation and collision object corresponding to a bounding OBB for the link
             std::vector<TransformCollisionPair> vgeoms; ///< vector of transformations and collision object; one per geometries
+            std::unordered_map<const fcl::CollisionObject*, FCLGeometryInfo*> mapgeominfos; ///< collision object of vgeoms -> its element of vgeominfos. The collision geometries can be shared with other spaces through FCLMeshCache, so the per-space info cannot be stored in their user data
             std::string bodylinkname; // for debugging purposes
             bool bFromKinBodyLink; ///< if true, then from kinbodylink. Otherwise from standalone object that does not have any KinBody associations
+            int nGeometryShapeStamp = -1; ///< KinBody::Link::GetGeometryShapeStamp when vgeoms were created from the current geometries of the link, -1 if created from a geometry group
+            std::vector<Vector> vcoveringspheres; ///< cache of GetCoveringSpheres, cleared when vgeoms change
         };
 
         FCLKinBodyInfo() {}
@@ -261,6 +324,40 @@ public:
         return _meshFactory;
     }
 
+    /// \brief intersects a ray given in the frame of a mesh built by the mesh factory with its triangles.
+    ///
+    /// The ray is origin + t*dir. On input t is the largest parameter to consider, set to the parameter of the closest hit if the function returns true.
+    inline MeshRayIntersector GetMeshRayIntersector() const {
+        return _meshRayIntersector;
+    }
+
+    /// \brief if true, trimesh geometries share their BVH models through FCLMeshCache. Enabled by default.
+    inline void SetUseMeshCache(bool bUseMeshCache) {
+        _bUseMeshCache = bUseMeshCache;
+    }
+
+    inline bool IsUsingMeshCache() const {
+        return _bUseMeshCache;
+    }
+
+    /// \brief if true, trimesh geometries are collided as the fcl::Convex pieces of their convex decomposition instead of a BVH. Disabled by default.
+    ///
+    /// The decompositions are shared through FCLConvexDecompositionCache and the meshes of all the links of a body are decomposed in parallel. Reinitializes all the KinbodyInfo if needed.
+    /// \param numthreads number of threads decomposing the meshes of a body, 0 uses the number of hardware threads
+    void SetUseConvexDecomposition(bool bUseConvexDecomposition, const ConvexDecompositionParameters& params=ConvexDecompositionParameters(), int numthreads=0);
+
+    inline bool IsUsingConvexDecomposition() const {
+        return _bUseConvexDecomposition;
+    }
+
+    inline const ConvexDecompositionParameters& GetConvexDecompositionParameters() const {
+        return _convexDecompositionParameters;
+    }
+
+    inline int GetConvexDecompositionThreads() const {
+        return _nConvexDecompositionThreads;
+    }
+
     inline int GetEnvironmentId() const {
         return _penv->GetId();
     }
@@ -269,9 +366,17 @@ private:
     // what about the tests on non-zero size (eg. box extents) ?
     CollisionGeometryPtr _CreateFCLGeomFromGeometryInfo(const KinBody::GeometryInfo &info);
 
+    /// \brief decomposes the trimeshes of all the links of the body in parallel so that _CreateFCLGeomFromGeometryInfo finds them in FCLConvexDecompositionCache
+    void _DecomposeBodyMeshes(const KinBody& body, const std::string& geometrygroup);
+
     /// \brief pass in info.GetBody() as a reference to avoid dereferencing the weak pointer in FCLKinBodyInfo
     void _Synchronize(FCLKinBodyInfo& info, const KinBody& body);
 
+    /// \brief if only the local transforms of some geometries changed since the links of info were created, updates them while keeping the collision objects of the geometries
+    ///
+    /// \return false if the shapes of the geometries changed and the links have to be recreated
+    bool _ReloadGeometryTransforms(const KinBody& body, FCLKinBodyInfo& info);
+
     /// \brief controls whether the kinbody info is removed during the destructor
     class FCLKinBodyInfoRemover
     {
@@ -325,6 +430,13 @@ private:
 
     std::string _bvhRepresentation;
     MeshFactory _meshFactory;
+    MeshComparator _meshComparator; ///< checks if a model built by _meshFactory holds the given mesh
+    MeshMemoryUsage _meshMemoryUsage; ///< size in bytes of a model built by _meshFactory
+    MeshRayIntersector _meshRayIntersector; ///< ray test of a model built by _meshFactory
+    bool _bUseMeshCache; ///< if true, share BVH models with other spaces through FCLMeshCache
+    bool _bUseConvexDecomposition = false; ///< if true, trimeshes are represented by the convex pieces of their decomposition
+    ConvexDecompositionParameters _convexDecompositionParameters;
+    int _nConvexDecompositionThreads = 0; ///< number of threads decomposing the meshes of a body, 0 uses the number of hardware threads
 
     std::vector<KinBodyConstPtr> _vecInitializedBodies; ///< vector of the kinbody initialized in this space. index is the environment body index. nullptr means uninitialized.
     std::vector<std::map< std::string, FCLKinBodyInfoPtr> > _cachedpinfo; ///< Associates to each body id and geometry group name the corresponding kinbody info if already initialized and not currently set as user data. Index of vector is the environment id. index 0 holds null pointer because kin bodies in the env should have positive index.
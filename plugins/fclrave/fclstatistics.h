@@ -2,13 +2,223 @@
 #ifndef OPENRAVE_FCL_STATISTICS
 #define OPENRAVE_FCL_STATISTICS
 
-
-#ifdef FCLUSESTATISTICS
-
 #include "plugindefs.h"
+#include <array>
+#include <chrono>
+#include <cmath>
 #include <sstream>
 #include <fstream>
 
+namespace fclrave {
+
+/// \brief lightweight statistics that are always compiled in and enabled at runtime.
+///
+/// Contrary to FCLStatistics, recording only costs a few increments per query so it can be enabled in production with the "SetStatisticsEnabled 1" command and retrieved as JSON with "GetStatistics".
+class FCLRuntimeStatistics
+{
+public:
+    /// \brief the collision queries whose latencies are recorded, named like the FCLStatistics timings
+    enum QueryType {
+        QT_BodyEnv = 0,
+        QT_BodyBody,
+        QT_LinkEnv,
+        QT_LinkLink,
+        QT_LinkBody,
+        QT_BodyBatchEnv,
+        QT_BodyContinuousEnv,
+        QT_BodySelf,
+        QT_LinkSelf,
+        QT_Count,
+    };
+
+    /// \brief latency histogram with power of 2 buckets: bucket i holds the latencies in [2^(i-1), 2^i) nanoseconds
+    struct LatencyHistogram
+    {
+        static const int NUM_BUCKETS = 40; ///< last bucket starts at ~550s
+
+        LatencyHistogram() : count(0), maxns(0) {
+            vbuckets.fill(0);
+        }
+
+        inline void Add(uint64_t ns) {
+            int ibucket = 0;
+            while( ibucket < NUM_BUCKETS - 1 && (ns >> ibucket) != 0 ) {
+                ++ibucket;
+            }
+            ++vbuckets[ibucket];
+            ++count;
+            maxns = std::max(maxns, ns);
+        }
+
+        /// \brief upper bound of the latency in nanoseconds that the given fraction of the queries did not exceed
+        uint64_t GetPercentile(double fraction) const {
+            if( count == 0 ) {
+                return 0;
+            }
+            const uint64_t rank = std::max(uint64_t(1), uint64_t(std::ceil(fraction*count)));
+            uint64_t accumulated = 0;
+            for(int ibucket = 0; ibucket < NUM_BUCKETS; ++ibucket) {
+                accumulated += vbuckets[ibucket];
+                if( accumulated >= rank ) {
+                    return std::min(uint64_t(1) << ibucket, maxns);
+                }
+            }
+            return maxns;
+        }
+
+        std::array<uint64_t, NUM_BUCKETS> vbuckets;
+        uint64_t count;
+        uint64_t maxns;
+    };
+
+    /// \brief records the latency of a query from construction to destruction when the statistics are enabled
+    class QueryTiming
+    {
+public:
+        QueryTiming(FCLRuntimeStatistics& statistics, QueryType querytype) : _statistics(statistics), _querytype(querytype), _bEnabled(statistics.IsEnabled()) {
+            if( _bEnabled ) {
+                _starttime = std::chrono::steady_clock::now();
+            }
+        }
+        ~QueryTiming() {
+            if( _bEnabled ) {
+                _statistics._vLatencies[_querytype].Add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _starttime).count());
+            }
+        }
+private:
+        FCLRuntimeStatistics& _statistics;
+        QueryType _querytype;
+        bool _bEnabled;
+        std::chrono::steady_clock::time_point _starttime;
+    };
+
+    FCLRuntimeStatistics() : _bEnabled(false), _bAutoBroadphaseAlgorithm(false) {
+        Reset();
+    }
+
+    inline bool IsEnabled() const {
+        return _bEnabled;
+    }
+
+    inline void SetEnabled(bool bEnabled) {
+        _bEnabled = bEnabled;
+    }
+
+    void Reset() {
+        _vLatencies.fill(LatencyHistogram());
+        _vNarrowPhaseCalls.fill(0);
+        _nBroadphaseUpdates = 0;
+        _nBodyManagerHits = _nBodyManagerMisses = 0;
+        _nEnvManagerHits = _nEnvManagerMisses = 0;
+        _nBroadphaseSwitches = 0;
+    }
+
+    inline void AddNarrowPhaseCall(fcl::NODE_TYPE type1, fcl::NODE_TYPE type2) {
+        if( _bEnabled ) {
+            // count unordered pairs
+            if( type1 > type2 ) {
+                std::swap(type1, type2);
+            }
+            ++_vNarrowPhaseCalls[type1*fcl::NODE_COUNT + type2];
+        }
+    }
+
+    inline void AddBroadphaseUpdates(uint64_t nUpdates) {
+        if( _bEnabled ) {
+            _nBroadphaseUpdates += nUpdates;
+        }
+    }
+
+    /// \brief records the algorithm of the managers, always kept up to date since it is a state rather than a counter
+    inline void SetBroadphaseAlgorithm(const std::string& algorithm, bool bAuto) {
+        _broadphaseAlgorithm = algorithm;
+        _bAutoBroadphaseAlgorithm = bAuto;
+    }
+
+    /// \brief records a change of algorithm made by the Auto mode
+    inline void AddBroadphaseSwitch() {
+        if( _bEnabled ) {
+            ++_nBroadphaseSwitches;
+        }
+    }
+
+    inline void AddBodyManagerLookup(bool bHit) {
+        if( _bEnabled ) {
+            ++(bHit ? _nBodyManagerHits : _nBodyManagerMisses);
+        }
+    }
+
+    inline void AddEnvManagerLookup(bool bHit) {
+        if( _bEnabled ) {
+            ++(bHit ? _nEnvManagerHits : _nEnvManagerMisses);
+        }
+    }
+
+    /// \brief writes the statistics as a JSON object, latencies are in microseconds
+    void WriteJSON(std::ostream& os) const {
+        os << "{\"enabled\":" << (_bEnabled ? "true" : "false") << ",\"queries\":{";
+        bool bFirst = true;
+        for(int iquery = 0; iquery < QT_Count; ++iquery) {
+            const LatencyHistogram& histogram = _vLatencies[iquery];
+            if( histogram.count == 0 ) {
+                continue;
+            }
+            os << (bFirst ? "" : ",") << "\"" << GetQueryTypeName((QueryType)iquery) << "\":{\"count\":" << histogram.count << ",\"p50\":" << histogram.GetPercentile(0.5)*1e-3 << ",\"p99\":" << histogram.GetPercentile(0.99)*1e-3 << ",\"max\":" << histogram.maxns*1e-3 << "}";
+            bFirst = false;
+        }
+        os << "},\"narrowPhaseCalls\":{";
+        bFirst = true;
+        for(int type1 = 0; type1 < fcl::NODE_COUNT; ++type1) {
+            for(int type2 = type1; type2 < fcl::NODE_COUNT; ++type2) {
+                const uint64_t nCalls = _vNarrowPhaseCalls[type1*fcl::NODE_COUNT + type2];
+                if( nCalls > 0 ) {
+                    os << (bFirst ? "" : ",") << "\"" << GetNodeTypeName(type1) << "/" << GetNodeTypeName(type2) << "\":" << nCalls;
+                    bFirst = false;
+                }
+            }
+        }
+        os << "},\"broadphaseUpdates\":" << _nBroadphaseUpdates;
+        os << ",\"broadphase\":{\"algorithm\":\"" << _broadphaseAlgorithm << "\",\"auto\":" << (_bAutoBroadphaseAlgorithm ? "true" : "false") << ",\"switches\":" << _nBroadphaseSwitches << "}";
+        os << ",\"bodyManagerCache\":";
+        _WriteCacheJSON(os, _nBodyManagerHits, _nBodyManagerMisses);
+        os << ",\"envManagerCache\":";
+        _WriteCacheJSON(os, _nEnvManagerHits, _nEnvManagerMisses);
+        os << "}";
+    }
+
+    static const char* GetQueryTypeName(QueryType querytype) {
+        static const char* s_names[QT_Count] = {"Body/Env", "Body/Body", "Link/Env", "Link/Link", "Link/Body", "BodyBatch/Env", "BodyContinuous/Env", "BodySelf", "LinkSelf"};
+        return s_names[querytype];
+    }
+
+    static const char* GetNodeTypeName(int nodetype) {
+        static const char* s_names[] = {"BV_UNKNOWN", "BV_AABB", "BV_OBB", "BV_RSS", "BV_kIOS", "BV_OBBRSS", "BV_KDOP16", "BV_KDOP18", "BV_KDOP24", "GEOM_BOX", "GEOM_SPHERE", "GEOM_CAPSULE", "GEOM_CONE", "GEOM_CYLINDER", "GEOM_CONVEX", "GEOM_PLANE", "GEOM_HALFSPACE", "GEOM_TRIANGLE", "GEOM_OCTREE"};
+        if( nodetype < 0 || nodetype >= (int)(sizeof(s_names)/sizeof(s_names[0])) ) {
+            return "UNKNOWN";
+        }
+        return s_names[nodetype];
+    }
+
+private:
+    static void _WriteCacheJSON(std::ostream& os, uint64_t nHits, uint64_t nMisses) {
+        os << "{\"hits\":" << nHits << ",\"misses\":" << nMisses << ",\"hitRate\":" << (nHits + nMisses > 0 ? double(nHits)/double(nHits + nMisses) : 0.0) << "}";
+    }
+
+    bool _bEnabled;
+    std::array<LatencyHistogram, QT_Count> _vLatencies;
+    std::array<uint64_t, fcl::NODE_COUNT*fcl::NODE_COUNT> _vNarrowPhaseCalls; ///< indexed by type1*NODE_COUNT+type2 with type1 <= type2
+    uint64_t _nBroadphaseUpdates; ///< number of collision objects updated in the broadphase managers when synchronizing them
+    uint64_t _nBodyManagerHits, _nBodyManagerMisses;
+    uint64_t _nEnvManagerHits, _nEnvManagerMisses;
+    std::string _broadphaseAlgorithm;
+    bool _bAutoBroadphaseAlgorithm;
+    uint64_t _nBroadphaseSwitches; ///< number of algorithm changes made by the Auto mode
+};
+
+} // fclrave
+
+#ifdef FCLUSESTATISTICS
+
 
 namespace fclrave {
 
@@ -71,6 +281,9 @@ public:
             }
             f << ";" << maxTimingCount << std::endl;
         }
+        FOREACH(itcounter, counters) {
+            f << name << ";" << itcounter->first << ";" << itcounter->second << std::endl;
+        }
     }
 
     void StartManualTiming(std::string const& label) {
@@ -91,6 +304,10 @@ public:
         currentTimings.push_back(std::chrono::high_resolution_clock::now());
     }
 
+    void AddCounter(std::string const& label) {
+        ++counters[label];
+    }
+
     struct Timing {
         Timing(FCLStatistics& statistics) : _statistics(statistics) {
         }
@@ -110,6 +327,7 @@ private:
     std::string currentTimingLabel;
     std::vector<time_point> currentTimings;
     std::map< std::string, std::vector< std::vector<time_point> > > timings;
+    std::map< std::string, uint64_t > counters; ///< number of times every event happened
 };
 
 typedef boost::shared_ptr<FCLStatistics> FCLStatisticsPtr;
@@ -122,6 +340,8 @@ typedef boost::shared_ptr<FCLStatistics> FCLStatisticsPtr;
 
 #define ADD_TIMING(statistics) statistics->AddTimepoint()
 
+#define ADD_COUNTER(statistics, label) statistics->AddCounter(label)
+
 #define DISPLAY(statistics) statistics->DisplayAll()
 
 } // fclrave
@@ -136,6 +356,7 @@ class FCLStatistics {
 #define SETUP_STATISTICS(statistics, userdatakey, id) do {} while(false)
 #define START_TIMING(statistics, label) do {} while(false)
 #define ADD_TIMING(statistics) do {} while(false)
+#define ADD_COUNTER(statistics, label) do {} while(false)
 #define DISPLAY(statistics) do {} while(false)
 
 }
@@ -0,0 +1,159 @@
+// -*- coding: utf-8 -*-
+#include "plugindefs.h"
+
+#include "fclvoxelobstacle.h"
+
+namespace fclrave {
+
+static const int s_nVoxelKeyBits = 21;
+static const int64_t s_nVoxelKeyOffset = int64_t(1) << (s_nVoxelKeyBits-1);
+static const uint64_t s_nVoxelKeyMask = (uint64_t(1) << s_nVoxelKeyBits) - 1;
+
+FCLVoxelObstacle::FCLVoxelObstacle(BroadPhaseCollisionManagerPtr pmanager) : _resolution(0.01), _pmanager(pmanager)
+{
+    _pboxgeom = std::make_shared<fcl::Box>(_resolution, _resolution, _resolution);
+}
+
+FCLVoxelObstacle::~FCLVoxelObstacle()
+{
+    Clear();
+}
+
+void FCLVoxelObstacle::SetResolution(OpenRAVE::dReal resolution)
+{
+    OPENRAVE_ASSERT_OP_FORMAT0(resolution, >, 0, "voxel resolution has to be positive", OpenRAVE::ORE_InvalidArguments);
+    if( resolution == _resolution ) {
+        return;
+    }
+    Clear();
+    _resolution = resolution;
+    _pboxgeom = std::make_shared<fcl::Box>(_resolution, _resolution, _resolution);
+}
+
+size_t FCLVoxelObstacle::InsertPoints(const OpenRAVE::dReal* pxyz, size_t numpoints)
+{
+    const bool bWasEmpty = _mapVoxels.empty();
+    _vNewObjectsCache.resize(0);
+    size_t numOutOfRange = 0;
+    for(size_t ipoint = 0; ipoint < numpoints; ++ipoint, pxyz += 3) {
+        uint64_t key;
+        if( !_GetVoxelKey(pxyz, key) ) {
+            ++numOutOfRange;
+            continue;
+        }
+        CollisionObjectPtr& pcoll = _mapVoxels[key];
+        if( !!pcoll ) {
+            continue;
+        }
+        pcoll = boost::make_shared<fcl::CollisionObject>(_pboxgeom, fcl::Transform3f(_GetVoxelCenter(key)));
+        pcoll->computeAABB();
+        pcoll->setUserData(&_userdata);
+        _vNewObjectsCache.push_back(pcoll.get());
+    }
+    if( numOutOfRange > 0 ) {
+        RAVELOG_WARN_FORMAT("ignored %d points outside of the range of the voxel keys (resolution %f)", numOutOfRange%_resolution);
+    }
+    if( _vNewObjectsCache.size() > 0 ) {
+        if( bWasEmpty ) {
+            // builds a balanced tree at once
+            _pmanager->registerObjects(_vNewObjectsCache);
+        }
+        else {
+            FOREACH(itobj, _vNewObjectsCache) {
+                _pmanager->registerObject(*itobj);
+            }
+        }
+        _pmanager->setup();
+    }
+    return _vNewObjectsCache.size();
+}
+
+size_t FCLVoxelObstacle::ClearPoints(const OpenRAVE::dReal* pxyz, size_t numpoints)
+{
+    size_t numremoved = 0;
+    for(size_t ipoint = 0; ipoint < numpoints; ++ipoint, pxyz += 3) {
+        uint64_t key;
+        if( !_GetVoxelKey(pxyz, key) ) {
+            continue;
+        }
+        std::unordered_map<uint64_t, CollisionObjectPtr>::iterator it = _mapVoxels.find(key);
+        if( it == _mapVoxels.end() ) {
+            continue;
+        }
+        _pmanager->unregisterObject(it->second.get());
+        it->second->setUserData(nullptr);
+        _mapVoxels.erase(it);
+        ++numremoved;
+    }
+    if( numremoved > 0 ) {
+        _pmanager->setup();
+    }
+    return numremoved;
+}
+
+void FCLVoxelObstacle::Clear()
+{
+    _pmanager->clear();
+    FOREACH(itvoxel, _mapVoxels) {
+        itvoxel->second->setUserData(nullptr);
+    }
+    _mapVoxels.clear();
+}
+
+void FCLVoxelObstacle::SetManager(BroadPhaseCollisionManagerPtr pmanager)
+{
+    _pmanager->clear();
+    _pmanager = pmanager;
+    if( _mapVoxels.size() > 0 ) {
+        _vNewObjectsCache.resize(0);
+        FOREACHC(itvoxel, _mapVoxels) {
+            _vNewObjectsCache.push_back(itvoxel->second.get());
+        }
+        _pmanager->registerObjects(_vNewObjectsCache);
+        _pmanager->setup();
+    }
+}
+
+void FCLVoxelObstacle::Copy(const FCLVoxelObstacle& r)
+{
+    Clear();
+    _resolution = r._resolution;
+    _pboxgeom = r._pboxgeom; // never modified, so can be shared
+    std::vector<OpenRAVE::dReal> vxyz;
+    vxyz.reserve(3*r._mapVoxels.size());
+    FOREACHC(itvoxel, r._mapVoxels) {
+        const fcl::Vec3f center = r._GetVoxelCenter(itvoxel->first);
+        vxyz.push_back(center[0]);
+        vxyz.push_back(center[1]);
+        vxyz.push_back(center[2]);
+    }
+    if( vxyz.size() > 0 ) {
+        InsertPoints(&vxyz[0], vxyz.size()/3);
+    }
+}
+
+bool FCLVoxelObstacle::_GetVoxelKey(const OpenRAVE::dReal* pxyz, uint64_t& key) const
+{
+    key = 0;
+    for(int idim = 0; idim < 3; ++idim) {
+        const OpenRAVE::dReal findex = std::floor(pxyz[idim]/_resolution);
+        // also rejects nan
+        if( !(findex >= -s_nVoxelKeyOffset && findex < s_nVoxelKeyOffset) ) {
+            return false;
+        }
+        key |= uint64_t((int64_t)findex + s_nVoxelKeyOffset) << (idim*s_nVoxelKeyBits);
+    }
+    return true;
+}
+
+fcl::Vec3f FCLVoxelObstacle::_GetVoxelCenter(uint64_t key) const
+{
+    fcl::Vec3f center;
+    for(int idim = 0; idim < 3; ++idim) {
+        const int64_t index = (int64_t)((key >> (idim*s_nVoxelKeyBits)) & s_nVoxelKeyMask) - s_nVoxelKeyOffset;
+        center[idim] = (index + 0.5)*_resolution;
+    }
+    return center;
+}
+
+} // end namespace fclrave
@@ -0,0 +1,82 @@
+// -*- coding: utf-8 -*-
+#ifndef OPENRAVE_FCL_VOXELOBSTACLE
+#define OPENRAVE_FCL_VOXELOBSTACLE
+
+#include <unordered_map>
+#include <vector>
+
+#include "fclspace.h"
+#include "fclmanagercache.h"
+
+namespace fclrave {
+
+/// \brief obstacle made of the occupied cells of a regular grid, typically filled from the point clouds of a sensor.
+///
+/// The occupied cells are kept in a sparse map and registered as boxes in a broadphase manager owned by the obstacle, so inserting or clearing points only touches the cells of these points. The cells do not belong to any KinBody: their collision objects are standalone objects (their link info has no link), so they only collide with the links of the queried bodies.
+class FCLVoxelObstacle
+{
+public:
+    /// \param pmanager empty manager of the same broadphase algorithm as the managers the obstacle is checked against
+    FCLVoxelObstacle(BroadPhaseCollisionManagerPtr pmanager);
+    ~FCLVoxelObstacle();
+
+    /// \brief sets the side of the cells. Removes all the cells if it changes.
+    void SetResolution(OpenRAVE::dReal resolution);
+
+    inline OpenRAVE::dReal GetResolution() const {
+        return _resolution;
+    }
+
+    /// \brief marks the cells containing the points as occupied
+    ///
+    /// \param pxyz x, y, z coordinates of the points in the world frame
+    /// \return the number of cells that were not occupied before
+    size_t InsertPoints(const OpenRAVE::dReal* pxyz, size_t numpoints);
+
+    /// \brief marks the cells containing the points as free
+    ///
+    /// \return the number of cells that were occupied before
+    size_t ClearPoints(const OpenRAVE::dReal* pxyz, size_t numpoints);
+
+    /// \brief removes all the cells
+    void Clear();
+
+    inline size_t GetNumVoxels() const {
+        return _mapVoxels.size();
+    }
+
+    inline bool IsEmpty() const {
+        return _mapVoxels.empty();
+    }
+
+    /// \brief manager containing the collision objects of all the occupied cells
+    inline const BroadPhaseCollisionManagerPtr& GetManager() const {
+        return _pmanager;
+    }
+
+    /// \brief moves the cells to a new empty manager, necessary when the broadphase algorithm of the checker changes
+    void SetManager(BroadPhaseCollisionManagerPtr pmanager);
+
+    /// \brief copies the cells of another obstacle
+    void Copy(const FCLVoxelObstacle& r);
+
+private:
+    /// \brief computes the key of the cell containing the point, false if the point is outside of the range of the keys
+    bool _GetVoxelKey(const OpenRAVE::dReal* pxyz, uint64_t& key) const;
+
+    /// \brief center of the cell of key
+    fcl::Vec3f _GetVoxelCenter(uint64_t key) const;
+
+    OpenRAVE::dReal _resolution;
+    CollisionGeometryPtr _pboxgeom; ///< shared by all the cells
+    std::unordered_map<uint64_t, CollisionObjectPtr> _mapVoxels; ///< key packs the signed cell indices in 21 bits each
+    BroadPhaseCollisionManagerPtr _pmanager;
+    FCLSpace::FCLKinBodyInfo::LinkInfo _userdata; ///< user data of all the cells, has no link
+    std::vector<fcl::CollisionObject*> _vNewObjectsCache;
+};
+
+typedef boost::shared_ptr<FCLVoxelObstacle> FCLVoxelObstaclePtr;
+
+} // end namespace fclrave
+
+#endif
@@ -16,8 +16,12 @@
 #include "plugindefs.h"
 
 #include <algorithm>
+#include <atomic>
 #include <condition_variable>
+#include <cstring>
 #include <mutex>
+#include <set>
+#include <thread>
 #include <cmath>
 #include <boost/bind/bind.hpp>
 
@@ -62,6 +66,27 @@ static std::mutex s_QhullMutex;
     (dReal)0.525731112119133606025669084847876607285497935
 #define GTS_M_ICOSAHEDRON_Z (dReal)0.0
 
+static const uint64_t s_graspTableMagic = 0x31454c4250534147ULL; // "GASPBLE1"
+static const uint32_t s_graspTableVersion = 1;
+
+/// \brief header of the binary grasp tables written by GraspThreaded, followed by records
+struct GraspTableHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t realsize; ///< sizeof(dReal) of the writer
+    uint32_t preshapesize;
+    uint32_t finalshapesize;
+    char parametershash[40]; ///< md5 of the robot, target and grasp parameters, a table can only be resumed with the same parameters
+};
+
+/// \brief type of the records of the grasp table. Every record starts with the type, the number of contacts and the grasp id.
+enum GraspTableRecordType
+{
+    GTRT_Grasp = 1, ///< a successful grasp, followed by the dReal values of the grasp
+    GTRT_Checkpoint = 2, ///< all grasps with a smaller id than the record id are finished
+};
+
 template<class T1, class T2>
 struct sort_pair_first {
     bool operator()(const std::pair<T1,T2>&left, const std::pair<T1,T2>&right) {
@@ -81,12 +106,14 @@ class GrasperModule : public ModuleBase
     };
 
 public:
-    GrasperModule(EnvironmentBasePtr penv, std::istream& sinput)  : ModuleBase(penv), outfile(NULL), errfile(NULL) {
+    GrasperModule(EnvironmentBasePtr penv, std::istream& sinput)  : ModuleBase(penv), outfile(NULL) {
         __description = ":Interface Author: Rosen Diankov\n\nUsed to simulate a hand grasping an object by closing its fingers until collision with all links. ";
         RegisterCommand("Grasp",boost::bind(&GrasperModule::_GraspCommand,this,_1,_2),
                         "Performs a grasp and returns contact points");
         RegisterCommand("GraspThreaded",boost::bind(&GrasperModule::_GraspThreadedCommand,this,_1,_2),
-                        "Parllelizes the computation of the grasp planning and force closure. Number of threads can be specified with 'numthreads'.");
+                        "Parllelizes the computation of the grasp planning and force closure. Number of threads can be specified with 'numthreads'. With 'grasptable filename', the successful grasps are streamed into a binary table as they are found, and 'resume 1' continues an interrupted table computed with the same parameters.");
+        RegisterCommand("AnalyzeContactsBatch",boost::bind(&GrasperModule::_AnalyzeContactsBatchCommand,this,_1,_2),
+                        "Computes the force closure quality of many contact sets on 'numthreads' threads. Takes 'friction', 'numconepoints' and 'grasps N' followed by the number of contacts and the position and normal of every contact of the N grasps. Returns the minimum distance and volume of every grasp, the volume is only computed for grasps with force closure.");
         RegisterCommand("ComputeDistanceMap",boost::bind(&GrasperModule::_ComputeDistanceMapCommand,this,_1,_2),
                         "Computes a distance map around a particular point in space");
         RegisterCommand("GetStableContacts",boost::bind(&GrasperModule::_GetStableContactsCommand,this,_1,_2),
@@ -97,8 +124,6 @@ public:
     virtual ~GrasperModule() {
         if( !!outfile )
             fclose(outfile);
-        if( !!errfile )
-            fclose(errfile);
     }
 
     virtual void Destroy()
@@ -428,6 +453,85 @@ public:
         return true;
     }
 
+    virtual bool _AnalyzeContactsBatchCommand(std::ostream& sout, std::istream& sinput)
+    {
+        dReal friction = 0.4;
+        int numconepoints = 8;
+        int numthreads = 1;
+        vector< vector<CONTACT> > vcontactsets;
+        string cmd;
+        while(!sinput.eof()) {
+            sinput >> cmd;
+            if( !sinput ) {
+                break;
+            }
+            std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+
+            if( cmd == "friction" ) {
+                sinput >> friction;
+            }
+            else if( cmd == "numconepoints" ) {
+                sinput >> numconepoints;
+            }
+            else if( cmd == "numthreads" ) {
+                sinput >> numthreads;
+            }
+            else if( cmd == "grasps" ) {
+                size_t numgrasps = 0;
+                sinput >> numgrasps;
+                vcontactsets.resize(numgrasps);
+                FOREACH(itcontacts, vcontactsets) {
+                    size_t numcontacts = 0;
+                    sinput >> numcontacts;
+                    itcontacts->resize(numcontacts);
+                    FOREACH(itcontact, *itcontacts) {
+                        sinput >> itcontact->pos.x >> itcontact->pos.y >> itcontact->pos.z >> itcontact->norm.x >> itcontact->norm.y >> itcontact->norm.z;
+                    }
+                }
+            }
+            else {
+                RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
+                break;
+            }
+
+            if( !sinput ) {
+                RAVELOG_ERROR(str(boost::format("failed processing command %s\n")%cmd));
+                return false;
+            }
+        }
+
+        vector<GRASPANALYSIS> vanalyses(vcontactsets.size());
+        std::atomic<size_t> nNextGrasp(0);
+        auto worker = [&]() {
+            GraspQualityWorkspace workspace;
+            while(true) {
+                const size_t igrasp = nNextGrasp.fetch_add(1);
+                if( igrasp >= vcontactsets.size() ) {
+                    break;
+                }
+                try {
+                    vanalyses[igrasp] = _AnalyzeContacts3D(vcontactsets[igrasp], friction, numconepoints, true, workspace);
+                }
+                catch(const std::exception& ex) {
+                    RAVELOG_DEBUG(str(boost::format("grasp %d: force closure failed: %s")%igrasp%ex.what()));
+                }
+            }
+        };
+        vector<std::thread> vthreads;
+        for(int ithread = 1; ithread < numthreads; ++ithread) {
+            vthreads.emplace_back(worker);
+        }
+        worker();
+        FOREACH(itthread, vthreads) {
+            itthread->join();
+        }
+
+        FOREACHC(itanalysis, vanalyses) {
+            sout << itanalysis->mindist << " " << itanalysis->volume << " ";
+        }
+        return true;
+    }
+
     virtual bool _ComputeDistanceMapCommand(std::ostream& sout, std::istream& sinput)
     {
         EnvironmentLock lock(GetEnv()->GetMutex());
@@ -734,6 +838,8 @@ public:
         vector<dReal> standoffs;
         size_t startindex = 0;
         size_t maxgrasps = 0;
+        string grasptablefilename;
+        bool bresume = false;
 
         while(!sinput.eof()) {
             sinput >> cmd;
@@ -831,6 +937,12 @@ public:
             else if( cmd == "checkik" ) {
                 sinput >> worker_params->bCheckGraspIK;
             }
+            else if( cmd == "grasptable" ) {
+                sinput >> grasptablefilename;
+            }
+            else if( cmd == "resume" ) {
+                sinput >> bresume;
+            }
             else {
                 RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
                 break;
@@ -847,6 +959,47 @@ public:
         worker_params->affinedofs = _robot->GetAffineDOF();
         worker_params->affineaxis = _robot->GetAffineRotationAxis();
 
+        _listGraspResults.clear();
+        _setGraspIdsInProgress.clear();
+        _nGraspTableCheckpoint = 0;
+        if( grasptablefilename.size() > 0 ) {
+            // every input that changes the results goes into the hash so that a table is never resumed with different grasps
+            stringstream ssparameters;
+            ssparameters << std::setprecision(std::numeric_limits<dReal>::digits10+1);
+            ssparameters << _robot->GetRobotStructureHash() << " " << worker_params->manipname << " " << worker_params->targetname << " ";
+            KinBodyPtr ptarget = GetEnv()->GetKinBody(worker_params->targetname);
+            if( !!ptarget ) {
+                ssparameters << ptarget->GetKinematicsGeometryHash() << " ";
+            }
+            FOREACHC(itlink, worker_params->vavoidlinkgeometry) {
+                ssparameters << *itlink << " ";
+            }
+            ssparameters << worker_params->bonlycontacttarget << " " << worker_params->btightgrasp << " " << worker_params->fgraspingnoise << " " << worker_params->nGraspingNoiseRetries << " " << worker_params->friction << " " << worker_params->bComputeForceClosure << " " << worker_params->forceclosurethreshold << " " << worker_params->ftranslationstepmult << " " << worker_params->bCheckGraspIK << " ";
+            FOREACHC(itray, approachrays) {
+                ssparameters << itray->first << " " << itray->second << " ";
+            }
+            FOREACHC(itroll, rolls) {
+                ssparameters << *itroll << " ";
+            }
+            FOREACHC(itpreshape, preshapes) {
+                FOREACHC(it, *itpreshape) {
+                    ssparameters << *it << " ";
+                }
+            }
+            FOREACHC(itdirection, manipulatordirections) {
+                ssparameters << *itdirection << " ";
+            }
+            FOREACHC(itstandoff, standoffs) {
+                ssparameters << *itstandoff << " ";
+            }
+            const size_t preshapesize = _robot->GetActiveManipulator()->GetGripperIndices().size();
+            const size_t resumeindex = _OpenGraspTable(grasptablefilename, utils::GetMD5HashString(ssparameters.str()), preshapesize, _robot->GetDOF(), bresume);
+            if( resumeindex > startindex ) {
+                RAVELOG_INFO_FORMAT("resuming grasp table %s at grasp %d with %d grasps", grasptablefilename%resumeindex%_listGraspResults.size());
+                startindex = resumeindex;
+            }
+        }
+
         EnvironmentBasePtr pcloneenv = GetEnv()->CloneSelf(Clone_Bodies|Clone_Simulation);
 
         _bContinueWorker = true;
@@ -856,7 +1009,6 @@ public:
             listthreads[threadIdx] = boost::make_shared<std::thread>(std::bind(&GrasperModule::_WorkerThread, this, worker_params, pcloneenv));
         }
 
-        _listGraspResults.clear();
         size_t numgrasps = approachrays.size()*rolls.size()*preshapes.size()*standoffs.size()*manipulatordirections.size();
         if( maxgrasps == 0 ) {
             maxgrasps = numgrasps;
@@ -885,6 +1037,8 @@ public:
             _graspParamsWork->ftargetroll = rolls.at(iroll);
             _graspParamsWork->fstandoff = standoffs.at(istandoff);
             _graspParamsWork->preshape = preshapes.at(ipreshape);
+            _setGraspIdsInProgress.insert(id);
+            _nNextGraspId = id+1;
             _condGraspHasWork.notify_one();     // notify there is work
             _condGraspReceivedWork.wait(lock123);     // wait for more work
         }
@@ -896,6 +1050,9 @@ public:
             (*itthread)->join();
         }
         listthreads.clear();
+        if( _graspTableStream.is_open() ) {
+            _graspTableStream.close();
+        }
 
         // parse results to output
         sout << id << " " << _listGraspResults.size() << " ";
@@ -947,6 +1104,7 @@ public:
             CollisionReportPtr report(new CollisionReport());
             TrajectoryBasePtr ptraj = RaveCreateTrajectory(pcloneenv,"");
             GraspParametersThreadPtr grasp_params;
+            GraspQualityWorkspace qualityworkspace;
 
             // calculate the contact normals
             std::vector<KinBody::LinkPtr> vlinks, vindependentlinks;
@@ -974,6 +1132,7 @@ public:
                     _graspParamsWork.reset();
                     _condGraspReceivedWork.notify_all();
                 }
+                GraspFinisher finisher(*this, grasp_params);
 
                 RAVELOG_DEBUG(str(boost::format("grasp %d: start")%grasp_params->id));
 
@@ -1064,7 +1223,7 @@ public:
                         for(size_t i = 0; i < c.size(); ++i) {
                             c[i] = grasp_params->contacts[i].first;
                         }
-                        analysis = _AnalyzeContacts3D(c,worker_params->friction,8);
+                        analysis = _AnalyzeContacts3D(c,worker_params->friction,8,worker_params->forceclosurethreshold > 0,qualityworkspace);
                         if( analysis.mindist < worker_params->forceclosurethreshold ) {
                             RAVELOG_DEBUG(str(boost::format("grasp %d: force closure failed")%grasp_params->id));
                             continue;
@@ -1180,19 +1339,218 @@ public:
                 }
 
                 RAVELOG_DEBUG(str(boost::format("grasp %d: success")%grasp_params->id));
-
-                std::lock_guard<std::mutex> lock(_mutexGrasp);
-                _listGraspResults.push_back(grasp_params);
+                finisher._bSuccess = true;
             }
         }
         pcloneenv->Destroy();
     }
 
+    /// \brief calls _FinishGrasp when a worker is done with a grasp, whatever the outcome
+    struct GraspFinisher
+    {
+        GraspFinisher(GrasperModule& module, GraspParametersThreadPtr grasp_params) : _module(module), _grasp_params(grasp_params), _bSuccess(false) {
+        }
+        ~GraspFinisher() {
+            _module._FinishGrasp(_grasp_params, _bSuccess);
+        }
+        GrasperModule& _module;
+        GraspParametersThreadPtr _grasp_params;
+        bool _bSuccess;
+    };
+
+    /// \brief stores a successful grasp and advances the checkpoint of the grasp table
+    void _FinishGrasp(GraspParametersThreadPtr grasp_params, bool bSuccess)
+    {
+        std::lock_guard<std::mutex> lock(_mutexGrasp);
+        _setGraspIdsInProgress.erase(grasp_params->id);
+        if( bSuccess ) {
+            _listGraspResults.push_back(grasp_params);
+        }
+        if( !_graspTableStream.is_open() ) {
+            return;
+        }
+        if( bSuccess ) {
+            _WriteGraspTableRecord(GTRT_Grasp, grasp_params->id, grasp_params.get());
+        }
+        // grasps are handed out in increasing id order, so every grasp before the oldest one in progress is finished
+        const size_t checkpoint = _setGraspIdsInProgress.empty() ? _nNextGraspId : *_setGraspIdsInProgress.begin();
+        if( checkpoint > _nGraspTableCheckpoint ) {
+            _nGraspTableCheckpoint = checkpoint;
+            _WriteGraspTableRecord(GTRT_Checkpoint, checkpoint, NULL);
+        }
+        _graspTableStream.flush();
+        if( !_graspTableStream ) {
+            RAVELOG_ERROR("failed to write the grasp table, stop writing it\n");
+            _graspTableStream.close();
+        }
+    }
+
+    /// \brief appends a record to _graspTableStream, has to be called with _mutexGrasp locked
+    void _WriteGraspTableRecord(uint32_t type, uint64_t id, const GraspParametersThread* grasp_params)
+    {
+        uint32_t numcontacts = !grasp_params ? 0 : grasp_params->contacts.size();
+        _graspTableStream.write(reinterpret_cast<const char*>(&type), sizeof(type));
+        _graspTableStream.write(reinterpret_cast<const char*>(&numcontacts), sizeof(numcontacts));
+        _graspTableStream.write(reinterpret_cast<const char*>(&id), sizeof(id));
+        if( !grasp_params ) {
+            return;
+        }
+        _vGraspTableValues.resize(0);
+        for(int i = 0; i < 3; ++i) {
+            _vGraspTableValues.push_back(grasp_params->vtargetposition[i]);
+        }
+        for(int i = 0; i < 3; ++i) {
+            _vGraspTableValues.push_back(grasp_params->vtargetdirection[i]);
+        }
+        _vGraspTableValues.push_back(grasp_params->ftargetroll);
+        _vGraspTableValues.push_back(grasp_params->fstandoff);
+        for(int i = 0; i < 3; ++i) {
+            _vGraspTableValues.push_back(grasp_params->vmanipulatordirection[i]);
+        }
+        _vGraspTableValues.push_back(grasp_params->mindist);
+        _vGraspTableValues.push_back(grasp_params->volume);
+        _vGraspTableValues.insert(_vGraspTableValues.end(), grasp_params->preshape.begin(), grasp_params->preshape.end());
+        for(int i = 0; i < 4; ++i) {
+            _vGraspTableValues.push_back(grasp_params->transfinal.rot[i]);
+        }
+        for(int i = 0; i < 3; ++i) {
+            _vGraspTableValues.push_back(grasp_params->transfinal.trans[i]);
+        }
+        _vGraspTableValues.insert(_vGraspTableValues.end(), grasp_params->finalshape.begin(), grasp_params->finalshape.end());
+        FOREACHC(itcontact, grasp_params->contacts) {
+            for(int i = 0; i < 3; ++i) {
+                _vGraspTableValues.push_back(itcontact->first.pos[i]);
+            }
+            for(int i = 0; i < 3; ++i) {
+                _vGraspTableValues.push_back(itcontact->first.norm[i]);
+            }
+            _vGraspTableValues.push_back(itcontact->second);
+        }
+        _graspTableStream.write(reinterpret_cast<const char*>(_vGraspTableValues.data()), sizeof(dReal)*_vGraspTableValues.size());
+    }
+
+    /// \brief opens the grasp table for appending the results of GraspThreaded
+    ///
+    /// If bresume is set and the file was written with the same parameters, the grasps stored in it are added to _listGraspResults and
+    /// a trailing record cut by an interruption is dropped. Otherwise the file is overwritten.
+    /// \return the id of the first grasp that is not finished in the table
+    size_t _OpenGraspTable(const std::string& filename, const std::string& parametershash, size_t preshapesize, size_t finalshapesize, bool bresume)
+    {
+        GraspTableHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = s_graspTableMagic;
+        header.version = s_graspTableVersion;
+        header.realsize = sizeof(dReal);
+        header.preshapesize = preshapesize;
+        header.finalshapesize = finalshapesize;
+        strncpy(header.parametershash, parametershash.c_str(), sizeof(header.parametershash)-1);
+
+        size_t resumeindex = 0;
+        uint64_t validsize = 0;
+        if( bresume ) {
+            std::ifstream f(filename.c_str(), std::ios::binary);
+            GraspTableHeader fileheader;
+            if( !!f && f.read(reinterpret_cast<char*>(&fileheader), sizeof(fileheader)) && memcmp(&fileheader, &header, sizeof(header)) == 0 ) {
+                validsize = sizeof(header);
+                const size_t numvalues = 13 + preshapesize + 7 + finalshapesize;
+                std::vector<dReal> vvalues;
+                while(true) {
+                    uint32_t type = 0, numcontacts = 0;
+                    uint64_t id = 0;
+                    if( !f.read(reinterpret_cast<char*>(&type), sizeof(type)) || !f.read(reinterpret_cast<char*>(&numcontacts), sizeof(numcontacts)) || !f.read(reinterpret_cast<char*>(&id), sizeof(id)) ) {
+                        break;
+                    }
+                    if( type == GTRT_Checkpoint ) {
+                        resumeindex = id;
+                        validsize = f.tellg();
+                        continue;
+                    }
+                    if( type != GTRT_Grasp ) {
+                        break;
+                    }
+                    vvalues.resize(numvalues + 7*numcontacts);
+                    if( !f.read(reinterpret_cast<char*>(vvalues.data()), sizeof(dReal)*vvalues.size()) ) {
+                        break;
+                    }
+                    GraspParametersThreadPtr grasp_params(new GraspParametersThread());
+                    grasp_params->id = id;
+                    std::vector<dReal>::const_iterator itvalue = vvalues.begin();
+                    for(int i = 0; i < 3; ++i) {
+                        grasp_params->vtargetposition[i] = *itvalue++;
+                    }
+                    for(int i = 0; i < 3; ++i) {
+                        grasp_params->vtargetdirection[i] = *itvalue++;
+                    }
+                    grasp_params->ftargetroll = *itvalue++;
+                    grasp_params->fstandoff = *itvalue++;
+                    for(int i = 0; i < 3; ++i) {
+                        grasp_params->vmanipulatordirection[i] = *itvalue++;
+                    }
+                    grasp_params->mindist = *itvalue++;
+                    grasp_params->volume = *itvalue++;
+                    grasp_params->preshape.assign(itvalue, itvalue + preshapesize);
+                    itvalue += preshapesize;
+                    for(int i = 0; i < 4; ++i) {
+                        grasp_params->transfinal.rot[i] = *itvalue++;
+                    }
+                    for(int i = 0; i < 3; ++i) {
+                        grasp_params->transfinal.trans[i] = *itvalue++;
+                    }
+                    grasp_params->finalshape.assign(itvalue, itvalue + finalshapesize);
+                    itvalue += finalshapesize;
+                    grasp_params->contacts.resize(numcontacts);
+                    FOREACH(itcontact, grasp_params->contacts) {
+                        for(int i = 0; i < 3; ++i) {
+                            itcontact->first.pos[i] = *itvalue++;
+                        }
+                        for(int i = 0; i < 3; ++i) {
+                            itcontact->first.norm[i] = *itvalue++;
+                        }
+                        itcontact->second = (int)*itvalue++;
+                    }
+                    _listGraspResults.push_back(grasp_params);
+                    validsize = f.tellg();
+                }
+            }
+            else {
+                RAVELOG_WARN_FORMAT("grasp table %s was not written with the same parameters, starting a new one", filename);
+            }
+        }
+
+        if( validsize > 0 ) {
+            // keep the complete records and drop what an interruption could have cut
+            std::vector<char> vdata(validsize);
+            {
+                std::ifstream f(filename.c_str(), std::ios::binary);
+                f.read(vdata.data(), validsize);
+            }
+            _graspTableStream.open(filename.c_str(), std::ios::binary|std::ios::trunc);
+            _graspTableStream.write(vdata.data(), vdata.size());
+        }
+        else {
+            _graspTableStream.open(filename.c_str(), std::ios::binary|std::ios::trunc);
+            _graspTableStream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        }
+        if( !_graspTableStream ) {
+            _graspTableStream.close();
+            throw OPENRAVE_EXCEPTION_FORMAT("failed to open grasp table %s for writing", filename, ORE_InvalidArguments);
+        }
+        _graspTableStream.flush();
+        _nGraspTableCheckpoint = resumeindex;
+        _nNextGraspId = resumeindex;
+        return resumeindex;
+    }
+
     bool _bContinueWorker;
     std::mutex _mutexGrasp;
     GraspParametersThreadPtr _graspParamsWork;
     list<GraspParametersThreadPtr> _listGraspResults;
     std::condition_variable _condGraspHasWork, _condGraspReceivedWork;
+    std::set<size_t> _setGraspIdsInProgress; ///< ids of the grasps handed to the workers that are not finished
+    size_t _nNextGraspId = 0; ///< id of the next grasp to hand to the workers
+    std::ofstream _graspTableStream; ///< grasp table the results are streamed into, see _OpenGraspTable
+    size_t _nGraspTableCheckpoint = 0; ///< the last checkpoint written into the grasp table
+    std::vector<dReal> _vGraspTableValues; ///< cache
 
 protected:
     void _ComputeJointMaxLengths(vector<dReal>& vjointlengths)
@@ -1591,69 +1949,160 @@ protected:
         }
     }
 
+    /// \brief reusable buffers and qhull context for analyzing the contacts of many grasps
+    struct GraspQualityWorkspace
+    {
+        GraspQualityWorkspace() : errfile(NULL) {
+        }
+        ~GraspQualityWorkspace() {
+            if( !!errfile ) {
+                fclose(errfile);
+            }
+        }
+
+        std::vector<double> vwrenches[6]; ///< coordinates of the contact wrenches, one array per coordinate so that the loops over the wrenches vectorize
+        std::vector<double> vpoints, vconvexplanes; ///< the interleaved wrenches passed to qhull and the resulting planes
+        std::vector<CONTACT> vreducedcontacts;
+        std::vector<double> vconesin, vconecos; ///< sampled angles of the friction cones
+        FILE* errfile; ///< error messages from qhull
+#ifdef QHULL_FOUND
+        std::vector<coordT> qpoints;
+#ifdef QHULL_USE_REENTRANT
+        qhT qh; ///< every workspace has its own reentrant qhull context, so workspaces of different threads can compute hulls at the same time
+#endif
+#endif
+    };
+
     virtual GRASPANALYSIS _AnalyzeContacts3D(const vector<CONTACT>& contacts, dReal mu, int Nconepoints)
     {
-        if( mu == 0 ) {
-            return _AnalyzeContacts3D(contacts);
+        std::lock_guard<std::mutex> lock(_mutexQualityWorkspace);
+        return _AnalyzeContacts3D(contacts, mu, Nconepoints, false, _qualityworkspace);
+    }
+
+    virtual GRASPANALYSIS _AnalyzeContacts3D(const vector<CONTACT>& contacts)
+    {
+        std::lock_guard<std::mutex> lock(_mutexQualityWorkspace);
+        return _AnalyzeContacts3D(contacts, 0, 0, false, _qualityworkspace);
+    }
+
+    /// \brief analyzes the force closure of the contacts with linearized friction cones
+    ///
+    /// \param bOnlyForceClosure if true, the volume is not computed for contacts that cannot have force closure, which skips qhull for most of them
+    GRASPANALYSIS _AnalyzeContacts3D(const vector<CONTACT>& contacts, dReal mu, int Nconepoints, bool bOnlyForceClosure, GraspQualityWorkspace& workspace)
+    {
+        if( mu == 0 || Nconepoints <= 0 ) {
+            for(int j = 0; j < 6; ++j) {
+                workspace.vwrenches[j].resize(contacts.size());
+            }
+            for(size_t i = 0; i < contacts.size(); ++i) {
+                const CONTACT& c = contacts[i];
+                const Vector v = c.pos.cross(c.norm);
+                workspace.vwrenches[0][i] = c.norm.x;
+                workspace.vwrenches[1][i] = c.norm.y;
+                workspace.vwrenches[2][i] = c.norm.z;
+                workspace.vwrenches[3][i] = v.x;
+                workspace.vwrenches[4][i] = v.y;
+                workspace.vwrenches[5][i] = v.z;
+            }
+            return _AnalyzeWrenches(bOnlyForceClosure, workspace);
         }
 
-        if( contacts.size() > 16 ) {
+        if( contacts.size() > 16 && &contacts != &workspace.vreducedcontacts ) {
             // try reduce time by computing a subset of the points
-            vector<CONTACT> reducedcontacts;
-            reducedcontacts.reserve(16);
-            for(size_t i = 0; i < reducedcontacts.capacity(); ++i) {
-                reducedcontacts.push_back( contacts.at((i*contacts.size())/reducedcontacts.capacity()) );
+            workspace.vreducedcontacts.resize(16);
+            for(size_t i = 0; i < workspace.vreducedcontacts.size(); ++i) {
+                workspace.vreducedcontacts[i] = contacts.at((i*contacts.size())/workspace.vreducedcontacts.size());
             }
-            GRASPANALYSIS analysis = _AnalyzeContacts3D(reducedcontacts, mu, Nconepoints);
+            GRASPANALYSIS analysis = _AnalyzeContacts3D(workspace.vreducedcontacts, mu, Nconepoints, bOnlyForceClosure, workspace);
             if( analysis.mindist > 1e-9 ) {
                 return analysis;
             }
         }
 
-        dReal fdeltaang = 2*PI/(dReal)Nconepoints;
-        dReal fang = 0;
-        vector<pair<dReal,dReal> > vsincos(Nconepoints);
-        FOREACH(it,vsincos) {
-            it->first = RaveSin(fang);
-            it->second = RaveCos(fang);
-            fang += fdeltaang;
+        if( (int)workspace.vconesin.size() != Nconepoints ) {
+            workspace.vconesin.resize(Nconepoints);
+            workspace.vconecos.resize(Nconepoints);
+            dReal fdeltaang = 2*PI/(dReal)Nconepoints;
+            for(int k = 0; k < Nconepoints; ++k) {
+                workspace.vconesin[k] = RaveSin(k*fdeltaang);
+                workspace.vconecos[k] = RaveCos(k*fdeltaang);
+            }
         }
 
-        vector<CONTACT> newcontacts;
-        newcontacts.reserve(contacts.size()*Nconepoints);
-        FOREACHC(itcontact,contacts) {
-            // find a coordinate system where z is the normal
-            TransformMatrix torient = matrixFromQuat(quatRotateDirection(Vector(0,0,1),itcontact->norm));
-            Vector right(torient.m[0],torient.m[4],torient.m[8]);
-            Vector up(torient.m[1],torient.m[5],torient.m[9]);
-            FOREACH(it,vsincos) {
-                newcontacts.push_back(CONTACT(itcontact->pos, (itcontact->norm + mu*it->first*right + mu*it->second*up).normalize3(),0));
-            }
+        const size_t numwrenches = contacts.size()*Nconepoints;
+        for(int j = 0; j < 6; ++j) {
+            workspace.vwrenches[j].resize(numwrenches);
         }
-        return _AnalyzeContacts3D(newcontacts);
+        double* pfx = workspace.vwrenches[0].data();
+        double* pfy = workspace.vwrenches[1].data();
+        double* pfz = workspace.vwrenches[2].data();
+        double* ptx = workspace.vwrenches[3].data();
+        double* pty = workspace.vwrenches[4].data();
+        double* ptz = workspace.vwrenches[5].data();
+        const double* psin = workspace.vconesin.data();
+        const double* pcos = workspace.vconecos.data();
+        for(size_t icontact = 0; icontact < contacts.size(); ++icontact) {
+            const CONTACT& c = contacts[icontact];
+            // find a coordinate system where z is the normal
+            TransformMatrix torient = matrixFromQuat(quatRotateDirection(Vector(0,0,1),c.norm));
+            const double rx = mu*torient.m[0], ry = mu*torient.m[4], rz = mu*torient.m[8];
+            const double ux = mu*torient.m[1], uy = mu*torient.m[5], uz = mu*torient.m[9];
+            const double nx = c.norm.x, ny = c.norm.y, nz = c.norm.z, px = c.pos.x, py = c.pos.y, pz = c.pos.z;
+            const size_t offset = icontact*Nconepoints;
+            for(int k = 0; k < Nconepoints; ++k) {
+                double fx = nx + psin[k]*rx + pcos[k]*ux;
+                double fy = ny + psin[k]*ry + pcos[k]*uy;
+                double fz = nz + psin[k]*rz + pcos[k]*uz;
+                const double finvlen = 1/std::sqrt(fx*fx + fy*fy + fz*fz);
+                fx *= finvlen;
+                fy *= finvlen;
+                fz *= finvlen;
+                pfx[offset+k] = fx;
+                pfy[offset+k] = fy;
+                pfz[offset+k] = fz;
+                ptx[offset+k] = py*fz - pz*fy;
+                pty[offset+k] = pz*fx - px*fz;
+                ptz[offset+k] = px*fy - py*fx;
+            }
+        }
+        return _AnalyzeWrenches(bOnlyForceClosure, workspace);
     }
 
-    virtual GRASPANALYSIS _AnalyzeContacts3D(const vector<CONTACT>& contacts)
+    /// \brief computes the force closure of the wrenches in workspace.vwrenches
+    GRASPANALYSIS _AnalyzeWrenches(bool bOnlyForceClosure, GraspQualityWorkspace& workspace)
     {
-        if( contacts.size() < 7 ) {
+        const size_t numwrenches = workspace.vwrenches[0].size();
+        if( numwrenches < 7 ) {
             RAVELOG_DEBUG("need at least 7 contact wrenches to have force closure in 3D\n");
             return GRASPANALYSIS();
         }
-        RAVELOG_DEBUG(str(boost::format("analyzing %d contacts for force closure\n")%contacts.size()));
+        if( bOnlyForceClosure ) {
+            // the origin can only be inside the hull if every coordinate of the wrenches takes both signs
+            for(int j = 0; j < 6; ++j) {
+                const double* pvalues = workspace.vwrenches[j].data();
+                double fmin = pvalues[0], fmax = pvalues[0];
+                for(size_t i = 1; i < numwrenches; ++i) {
+                    fmin = std::min(fmin, pvalues[i]);
+                    fmax = std::max(fmax, pvalues[i]);
+                }
+                if( fmin >= 0 || fmax <= 0 ) {
+                    return GRASPANALYSIS();
+                }
+            }
+        }
+        RAVELOG_VERBOSE(str(boost::format("analyzing %d contact wrenches for force closure\n")%numwrenches));
         GRASPANALYSIS analysis;
-        vector<double> vpoints(6*contacts.size()), vconvexplanes;
-        vector<double>::iterator itpoint = vpoints.begin();
-        FOREACHC(itcontact, contacts) {
-            *itpoint++ = itcontact->norm.x;
-            *itpoint++ = itcontact->norm.y;
-            *itpoint++ = itcontact->norm.z;
-            Vector v = itcontact->pos.cross(itcontact->norm);
-            *itpoint++ = v.x;
-            *itpoint++ = v.y;
-            *itpoint++ = v.z;
-        }
-
-        analysis.volume = _ComputeConvexHull(vpoints,vconvexplanes,boost::shared_ptr< vector<int> >(),6);
+        workspace.vpoints.resize(6*numwrenches);
+        for(int j = 0; j < 6; ++j) {
+            const double* pvalues = workspace.vwrenches[j].data();
+            double* ppoints = workspace.vpoints.data() + j;
+            for(size_t i = 0; i < numwrenches; ++i) {
+                ppoints[6*i] = pvalues[i];
+            }
+        }
+
+        analysis.volume = _ComputeConvexHull(workspace.vpoints,workspace.vconvexplanes,boost::shared_ptr< vector<int> >(),6,workspace);
+        const vector<double>& vconvexplanes = workspace.vconvexplanes;
         if( vconvexplanes.size() == 0 ) {
             return analysis;
         }
@@ -1673,6 +2122,13 @@ protected:
     /// \param vpoints a set of points each of dimension dim
     /// \param vconvexplaces the places of the convex hull, dimension is dim+1
     virtual double _ComputeConvexHull(const vector<double>& vpoints, vector<double>& vconvexplanes, boost::shared_ptr< vector<int> > vconvexfaces, int dim)
+    {
+        std::lock_guard<std::mutex> lock(_mutexQualityWorkspace);
+        return _ComputeConvexHull(vpoints, vconvexplanes, vconvexfaces, dim, _qualityworkspace);
+    }
+
+    /// \brief computes the convex hull using the qhull context and buffers of the workspace
+    double _ComputeConvexHull(const vector<double>& vpoints, vector<double>& vconvexplanes, boost::shared_ptr< vector<int> > vconvexfaces, int dim, GraspQualityWorkspace& workspace)
     {
         vconvexplanes.resize(0);
 #ifdef QHULL_FOUND
@@ -1686,24 +2142,28 @@ protected:
             return 0;
         }
 
-        vector<coordT> qpoints(vpoints.size());
+        vector<coordT>& qpoints = workspace.qpoints;
+        qpoints.resize(vpoints.size());
         std::copy(vpoints.begin(),vpoints.end(),qpoints.begin());
 
         boolT ismalloc = 0;               // True if qhull should free points in qh_freeqhull() or reallocation
         char flags[]= "qhull Tv FA";     // option flags for qhull, see qh_opt.htm, output volume (FA)
 
+#ifndef QHULL_USE_REENTRANT
+        // non-reentrant qhull keeps its state in globals
         std::lock_guard<std::mutex> lock(s_QhullMutex);
+#endif
 
         if( !outfile ) {
             // outfile = tmpfile();        // stdout from qhull code
         }
-        if( !errfile ) {
-            errfile = tmpfile();        // stderr, error messages from qhull code
+        if( !workspace.errfile ) {
+            workspace.errfile = tmpfile();        // stderr, error messages from qhull code
         }
+        FILE* errfile = workspace.errfile;
 
 #ifdef QHULL_USE_REENTRANT
-        qhT qh_qh;
-        qhT *qh= &qh_qh;
+        qhT *qh= &workspace.qh;
         qh->qhmem.ferr = NULL;
         int exitcode= qh_new_qhull (qh, dim, qpoints.size()/dim, &qpoints[0], ismalloc, flags, outfile, errfile);
 #else
@@ -1817,7 +2277,8 @@ protected:
     CollisionReportPtr _report;
     std::mutex _mutex;
     FILE *outfile;
-    FILE *errfile;
+    std::mutex _mutexQualityWorkspace; ///< protects _qualityworkspace
+    GraspQualityWorkspace _qualityworkspace; ///< used by the functions that do not get a workspace
     std::vector<dReal> _vjointmaxlengths;
 };
 
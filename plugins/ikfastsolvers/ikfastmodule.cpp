@@ -190,6 +190,7 @@ public:
         {
             LOAD_IKFUNCTION0(ComputeIk);
             LOAD_IKFUNCTION0(ComputeIk2);
+            LOAD_IKFUNCTION0(ComputeIkBatch);
             LOAD_IKFUNCTION(ComputeFk);
             LOAD_IKFUNCTION(GetNumFreeParameters);
             LOAD_IKFUNCTION0(GetFreeIndices);
@@ -430,6 +431,17 @@ public:
         return lib;
     }
 
+    /// \brief registers another solver name for an already loaded library
+    void _AddIkName(boost::shared_ptr<IkLibrary> lib, const string& ikname)
+    {
+        string lowername = ikname;
+        std::transform(lowername.begin(), lowername.end(), lowername.begin(), ::tolower);
+        std::lock_guard<std::mutex> lock(GetLibraryMutex());
+        if( std::find(lib->GetIkNames().begin(), lib->GetIkNames().end(), lowername) == lib->GetIkNames().end() ) {
+            lib->AddIkName(lowername);
+        }
+    }
+
     void Clone(InterfaceBaseConstPtr preference, int cloningoptions)
     {
         InterfaceBase::Clone(preference,cloningoptions);
@@ -563,6 +575,63 @@ public:
 
         _EnsureIkFastVersion();
 
+        // only one thread looks up, generates and loads the library of a kinematics hash and ik type, the others wait for it and reuse it
+        const std::string kinematicshash = pmanip->GetInverseKinematicsStructureHash(iktype);
+        boost::shared_ptr<IkLibraryCacheEntry> entry;
+        {
+            std::lock_guard<std::mutex> lock(GetLibraryMutex());
+            boost::shared_ptr<IkLibraryCacheEntry>& rentry = (*GetLibraryCache())[std::make_pair(kinematicshash, (int)iktype)];
+            if( !rentry ) {
+                rentry.reset(new IkLibraryCacheEntry());
+            }
+            entry = rentry;
+        }
+        boost::shared_ptr<IkLibrary> lib;
+        {
+            std::lock_guard<std::mutex> lockentry(entry->mutex);
+            lib = entry->library;
+            if( !lib ) {
+                lib = _FindIkLibrary(probot, pmanip, iktype, striktype);
+                if( !lib ) {
+                    return false;
+                }
+                if( lib->GetIKType() == (int)iktype ) {
+                    entry->library = lib;
+                }
+            }
+            else {
+                RAVELOG_VERBOSE_FORMAT("env=%s, reusing ikfast library %s", GetEnv()->GetNameId()%lib->GetLibraryName());
+            }
+        }
+
+        bool bsuccess = true;
+        if( lib->GetIKType() != (int)iktype ) {
+            bsuccess = false;
+        }
+        else {
+            string ikfastname = str(boost::format("ikfast.%s.%s.%s")%kinematicshash%striktype%pmanip->GetName());
+            _AddIkName(lib, ikfastname);
+            IkSolverBasePtr iksolver = RaveCreateIkSolver(GetEnv(),string("ikfast ")+ikfastname);
+            if( !iksolver ) {
+                RAVELOG_WARN(str(boost::format("failed to create ik solver %s!")%ikfastname));
+                bsuccess = false;
+            }
+            else {
+                bsuccess = pmanip->SetIkSolver(iksolver);
+            }
+        }
+        // if not forcing the ik, then return true as long as a valid ik solver is set
+        if( bForceIK && !bsuccess ) {
+            return false;
+        }
+        return !!pmanip->GetIkSolver() && pmanip->GetIkSolver()->Supports(iktype);
+    }
+
+    /// \brief finds the ikfast library of the manipulator in the database and loads it, generates the library if it cannot be found.
+    ///
+    /// \return the library or null if it could not be found or generated
+    boost::shared_ptr<IkLibrary> _FindIkLibrary(RobotBasePtr probot, RobotBase::ManipulatorPtr pmanip, IkParameterizationType iktype, const std::string& striktype)
+    {
         string ikfilename;
         for(int iter = 0; iter < 2; ++iter) {
             string ikfilenamefound;
@@ -614,7 +683,7 @@ public:
             if( ikfilenamefound.size() == 0 ) {
                 if( iter > 0 ) {
                     RAVELOG_WARN(str(boost::format("failed to find ikfile: %s")%ikfilename));
-                    return false;
+                    return boost::shared_ptr<IkLibrary>();
                 }
 
                 // create a temporary file and store COLLADA kinematics representation
@@ -640,44 +709,27 @@ public:
             // check for file
             if( !ifstream(ikfilenamefound.c_str()) ) {
                 RAVELOG_INFO(str(boost::format("could not find: %s")%ikfilenamefound));
-                return false;
+                return boost::shared_ptr<IkLibrary>();
             }
 
             string ikfastname = str(boost::format("ikfast.%s.%s.%s")%pmanip->GetInverseKinematicsStructureHash(iktype)%striktype%pmanip->GetName());
-            boost::shared_ptr<IkLibrary> lib = _AddIkLibrary(ikfastname,ikfilenamefound);
-            bool bsuccess = true;
-            if( !lib ) {
-                bsuccess = false;
-            }
-            else {
-                if( lib->GetIKType() != (int)iktype ) {
-                    bsuccess = false;
-                }
-                else {
-                    IkSolverBasePtr iksolver = RaveCreateIkSolver(GetEnv(),string("ikfast ")+ikfastname);
-                    if( !iksolver ) {
-                        RAVELOG_WARN(str(boost::format("failed to create ik solver %s!")%ikfastname));
-                        bsuccess = false;
-                    }
-                    else {
-                        bsuccess = pmanip->SetIkSolver(iksolver);
-                    }
-                }
-            }
-            // if not forcing the ik, then return true as long as a valid ik solver is set
-            if( bForceIK && !bsuccess ) {
-                return false;
-            }
-            return !!pmanip->GetIkSolver() && pmanip->GetIkSolver()->Supports(iktype);
+            return _AddIkLibrary(ikfastname,ikfilenamefound);
         }
 
-        return false;
+        return boost::shared_ptr<IkLibrary>();
     }
 
     /// \brief makes sure ikfast version is already retrieved
     void _EnsureIkFastVersion()
     {
-        // get ikfast version
+        // get ikfast version, python is only asked once per process
+        static std::mutex s_mutexVersion;
+        static string s_ikfastversion, s_platform;
+        std::lock_guard<std::mutex> lock(s_mutexVersion);
+        if( _ikfastversion.size() == 0 || _platform.size() == 0 ) {
+            _ikfastversion = s_ikfastversion;
+            _platform = s_platform;
+        }
         if( _ikfastversion.size() == 0 || _platform.size() == 0 ) {
             RAVELOG_INFO("Getting ikfast version from existing python.\n");
             string output;
@@ -704,6 +756,8 @@ public:
             else {
                 _ikfastversion = output.substr(0,index);
                 _platform = output.substr(index+1);
+                s_ikfastversion = _ikfastversion;
+                s_platform = _platform;
             }
         }
     }
@@ -1537,6 +1591,23 @@ public:
         return s_vStaticLibraries;
     }
 
+    /// \brief the loaded library of a kinematics hash and ik type, shared by all environments
+    struct IkLibraryCacheEntry
+    {
+        std::mutex mutex; ///< held while the library is looked up, generated and loaded
+        boost::shared_ptr<IkLibrary> library;
+    };
+
+    /// \brief (kinematics hash, ik type) -> entry, protected by GetLibraryMutex()
+    static std::map<std::pair<std::string, int>, boost::shared_ptr<IkLibraryCacheEntry> >*& GetLibraryCache()
+    {
+        static std::map<std::pair<std::string, int>, boost::shared_ptr<IkLibraryCacheEntry> >* s_mapLibraryCache=NULL;
+        if( s_mapLibraryCache == NULL ) {
+            s_mapLibraryCache = new std::map<std::pair<std::string, int>, boost::shared_ptr<IkLibraryCacheEntry> >();
+        }
+        return s_mapLibraryCache;
+    }
+
     static std::mutex& GetLibraryMutex()
     {
         static std::mutex s_LibraryMutex;
@@ -1570,6 +1641,8 @@ ModuleBasePtr CreateIkFastModule(EnvironmentBasePtr penv, std::istream& sinput)
 }
 
 void DestroyIkFastLibraries() {
+    delete IkFastModule::GetLibraryCache();
+    IkFastModule::GetLibraryCache() = NULL;
     delete IkFastModule::GetLibraries();
     IkFastModule::GetLibraries() = NULL;
 }
@@ -22,9 +22,11 @@
 #include <boost/tuple/tuple.hpp>
 #include <boost/lexical_cast.hpp>
 
-#ifdef OPENRAVE_HAS_LAPACK
+#include <atomic>
+#include <exception>
+#include <thread>
+
 #include "jacobianinverse.h"
-#endif
 
 using namespace boost::placeholders;
 
@@ -40,6 +42,110 @@ public:
         IkReturnPtr ikreturn;
     };
 
+    /// \brief ikfast solution list that keeps its storage across Clear() calls.
+    ///
+    /// Unlike ikfast::IkSolutionList, cleared solutions are kept around so the next AddSolution can reuse their vectors.
+    class IkSolutionPool : public ikfast::IkSolutionListBase<IkReal>
+    {
+public:
+        IkSolutionPool() : _nsolutions(0) {
+        }
+
+        virtual size_t AddSolution(const std::vector<ikfast::IkSingleDOFSolutionBase<IkReal> >& vinfos, const std::vector<int>& vfree)
+        {
+            if( _nsolutions < _vsolutions.size() ) {
+                _vsolutions[_nsolutions]._vbasesol = vinfos;
+                _vsolutions[_nsolutions]._vfree = vfree;
+            }
+            else {
+                _vsolutions.emplace_back(vinfos, vfree);
+            }
+            return _nsolutions++;
+        }
+
+        virtual const ikfast::IkSolutionBase<IkReal>& GetSolution(size_t index) const
+        {
+            if( index >= _nsolutions ) {
+                throw std::runtime_error("GetSolution index is invalid");
+            }
+            return _vsolutions[index];
+        }
+
+        virtual size_t GetNumSolutions() const {
+            return _nsolutions;
+        }
+
+        virtual void Clear() {
+            _nsolutions = 0;
+        }
+
+        virtual void Print() const {
+            for(size_t i = 0; i < _nsolutions; ++i) {
+                std::cout << "Solution " << i << ":" << std::endl;
+                std::cout << "===========" << std::endl;
+                _vsolutions[i].Print();
+            }
+        }
+
+private:
+        std::vector< ikfast::IkSolution<IkReal> > _vsolutions; ///< only the first _nsolutions are valid
+        size_t _nsolutions;
+    };
+
+    /// \brief scratch buffers used by one level of _SolveSingle/_SolveAll.
+    ///
+    /// Filters can call back into the same solver, so the buffers are kept in a stack indexed by the recursion depth.
+    class SolveWorkspace
+    {
+public:
+        IkSolutionPool solutions;
+        std::vector<dReal> vravesol;
+        std::vector<IkReal> sol, vsolfree;
+        std::vector<int> vsolutionorder;
+        std::vector<std::pair<size_t,dReal> > vdists;
+        std::vector<dReal> vFreeInc;
+    };
+    typedef boost::shared_ptr<SolveWorkspace> SolveWorkspacePtr;
+
+    /// \brief cloned environment and solver used by one SolveAll worker thread
+    class SolveAllWorker
+    {
+public:
+        EnvironmentBasePtr penv;
+        boost::shared_ptr< IkFastSolver<IkReal> > psolver;
+    };
+
+    /// \brief raw ikfast solutions of one quantized goal, before any filtering
+    class CachedIkSolutions
+    {
+public:
+        std::vector< ikfast::IkSolution<IkReal> > vsolutions;
+        bool bsuccess; ///< return value of _CallIk
+        std::list< std::vector<int64_t> >::iterator itlru; ///< position of the key in _listIkCacheLRU
+    };
+
+    /// \brief acquires a workspace for the duration of its scope
+    class SolveWorkspaceScope
+    {
+public:
+        SolveWorkspaceScope(IkFastSolver<IkReal>& solver) : _solver(solver) {
+            if( _solver._nSolveWorkspaceDepth >= _solver._vSolveWorkspaces.size() ) {
+                _solver._vSolveWorkspaces.push_back(SolveWorkspacePtr(new SolveWorkspace()));
+            }
+            _workspace = _solver._vSolveWorkspaces[_solver._nSolveWorkspaceDepth++];
+            _workspace->solutions.Clear();
+        }
+        ~SolveWorkspaceScope() {
+            --_solver._nSolveWorkspaceDepth;
+        }
+        SolveWorkspace& Get() {
+            return *_workspace;
+        }
+private:
+        IkFastSolver<IkReal>& _solver;
+        SolveWorkspacePtr _workspace; ///< hold a reference since the stack can grow while in use
+    };
+
 public:
     IkFastSolver(EnvironmentBasePtr penv, std::istream& sinput, boost::shared_ptr<ikfast::IkFastFunctions<IkReal> > ikfunctions, const vector<dReal>& vfreeinc, dReal ikthreshold=1e-4) : IkSolverBase(penv), _ikfunctions(ikfunctions), _vFreeInc(vfreeinc), _ikthreshold(ikthreshold) {
         OPENRAVE_ASSERT_OP(ikfunctions->_GetIkRealSize(),==,sizeof(IkReal));
@@ -53,6 +159,8 @@ public:
         }
 
         _fRefineWithJacobianInverseAllowedError = -1;
+        _nSolveWorkspaceDepth = 0;
+        _nSolveAllThreads = 1;
         _vfreeparams.resize(ikfunctions->_GetNumFreeParameters());
         _fFreeIncRevolute = PI/8; // arbitrary
         _fFreeIncPrismaticNum = 10.0; // arbitrary
@@ -79,15 +187,35 @@ public:
                         "sets the free increments for all the free joints");
         RegisterCommand("GetFreeIncrements",boost::bind(&IkFastSolver<IkReal>::_GetFreeIncrementsCommand,this,_1,_2),
                         "returns the free increments for all the free joints.");
+        RegisterCommand("SetSolveAllThreads",boost::bind(&IkFastSolver<IkReal>::_SetSolveAllThreadsCommand,this,_1,_2),
+                        "format: int\n\n\
+number of threads SolveAll uses to search the discretized free joint values. Each extra thread gets its own clone of the environment, which is synchronized with the current environment on every SolveAll call. Solutions are returned in the same order as with one thread. Custom filters are bound to the original environment, so SolveAll stays single-threaded when they are used. Default is 1.");
+        RegisterCommand("GetSolveAllThreads",boost::bind(&IkFastSolver<IkReal>::_GetSolveAllThreadsCommand,this,_1,_2),
+                        "returns the number of threads SolveAll uses.");
         RegisterCommand("GetSolutionIndices",boost::bind(&IkFastSolver<IkReal>::_GetSolutionIndicesCommand,this,_1,_2),
                         "**Can only be called by a custom filter during a Solve function call.** Gets the indices of the current solution being considered. if large-range joints wrap around, (index>>16) holds the index. So (index&0xffff) is unique to robot link pose, while (index>>16) describes the repetition.");
         RegisterCommand("GetRobotLinkStateRepeatCount", boost::bind(&IkFastSolver<IkReal>::_GetRobotLinkStateRepeatCountCommand,this,_1,_2),
                         "**Can only be called by a custom filter during a Solve function call.**. Returns 1 if the filter was called already with the same robot link positions, 0 otherwise. This is useful in saving computation. ");
+        RegisterTypedCommand("GetSolutionIndices", &IkFastSolver<IkReal>::_GetSolutionIndicesTypedCommand,
+                             "**Can only be called by a custom filter during a Solve function call.** Same as the GetSolutionIndices command, output vintvalues holds the indices.");
+        RegisterTypedCommand("GetRobotLinkStateRepeatCount", &IkFastSolver<IkReal>::_GetRobotLinkStateRepeatCountTypedCommand,
+                             "**Can only be called by a custom filter during a Solve function call.** Same as the GetRobotLinkStateRepeatCount command, output vintvalues holds the count.");
         RegisterCommand("SetBackTraceSelfCollisionLinks",boost::bind(&IkFastSolver<IkReal>::_SetBackTraceSelfCollisionLinksCommand,this,_1,_2),
                         "format: int int\n\n\
 for numBacktraceLinksForSelfCollisionWithNonMoving numBacktraceLinksForSelfCollisionWithFree, when pruning self collisions, the number of links to look at. If the tip of the manip self collides with the base, then can safely quit the IK.");
+        RegisterCommand("SetSolutionCache",boost::bind(&IkFastSolver<IkReal>::_SetSolutionCacheCommand,this,_1,_2),
+                        "format: int [dReal dReal]\n\n\
+maxentries [translationresolution rotationresolution]. Caches the raw analytic solutions of the goals, before the joint limits, custom filters and collisions are checked. The goals are quantized in the manipulator base frame with the translation resolution (default 0.0001) and the rotation resolution for quaternion, direction and angle values (default 0.001), and a goal falling in the cell of a cached goal reuses its solutions. The solutions of a hit are the ones of the first goal of the cell, so the resolutions should be well below the ik threshold, otherwise the solutions are rejected by the precision check. The least recently used goal is evicted once maxentries goals are cached. 0 disables and clears the cache (default).");
+        RegisterCommand("GetSolutionCacheStatistics",boost::bind(&IkFastSolver<IkReal>::_GetSolutionCacheStatisticsCommand,this,_1,_2),
+                        "returns numhits nummisses numevictions numentries of the solution cache.");
+        RegisterCommand("ClearSolutionCache",boost::bind(&IkFastSolver<IkReal>::_ClearSolutionCacheCommand,this,_1,_2),
+                        "removes the cached solutions and resets the statistics.");
         _numBacktraceLinksForSelfCollisionWithNonMoving = 2;
         _numBacktraceLinksForSelfCollisionWithFree = 0;
+        _nIkCacheMaxEntries = 0;
+        _fIkCacheTranslationResolution = 0.0001;
+        _fIkCacheRotationResolution = 0.001;
+        _nIkCacheHits = _nIkCacheMisses = _nIkCacheEvictions = 0;
     }
     virtual ~IkFastSolver() {
     }
@@ -110,26 +238,20 @@ for numBacktraceLinksForSelfCollisionWithNonMoving numBacktraceLinksForSelfColli
 
     bool _SetJacobianRefineCommand(ostream& sout, istream& sinput)
     {
-#ifdef OPENRAVE_HAS_LAPACK
         dReal f = 0;
         int nMaxIterations = -1;
         sinput >> f >> nMaxIterations;
         _SetJacobianRefine(f, nMaxIterations);
         return true;
-#else
-        return false;
-#endif
     }
 
     void _SetJacobianRefine(dReal f, int nMaxIterations)
     {
-#ifdef OPENRAVE_HAS_LAPACK
         _fRefineWithJacobianInverseAllowedError = f;
         _jacobinvsolver.SetErrorThresh(_fRefineWithJacobianInverseAllowedError);
         if( nMaxIterations >= 0 ) {
             _jacobinvsolver.SetMaxIterations(nMaxIterations);
         }
-#endif
     }
 
     bool _SetWorkspaceDiscretizedRotationAngleCommand(ostream& sout, istream& sinput)
@@ -167,6 +289,68 @@ for numBacktraceLinksForSelfCollisionWithNonMoving numBacktraceLinksForSelfColli
         return !!sinput;
     }
 
+    bool _SetSolveAllThreadsCommand(ostream& sout, istream& sinput)
+    {
+        int nthreads = 1;
+        sinput >> nthreads;
+        if( !sinput ) {
+            return false;
+        }
+        nthreads = std::max(1, nthreads);
+        if( nthreads != _nSolveAllThreads ) {
+            _vSolveAllWorkers.clear();
+        }
+        _nSolveAllThreads = nthreads;
+        return true;
+    }
+
+    bool _GetSolveAllThreadsCommand(ostream& sout, istream& sinput)
+    {
+        sout << _nSolveAllThreads;
+        return true;
+    }
+
+    bool _SetSolutionCacheCommand(ostream& sout, istream& sinput)
+    {
+        int maxentries = 0;
+        sinput >> maxentries;
+        if( !sinput ) {
+            return false;
+        }
+        dReal ftransres = _fIkCacheTranslationResolution, frotres = _fIkCacheRotationResolution;
+        sinput >> ftransres >> frotres;
+        if( !sinput ) {
+            // resolutions are optional
+            ftransres = _fIkCacheTranslationResolution;
+            frotres = _fIkCacheRotationResolution;
+        }
+        if( ftransres <= 0 || frotres <= 0 ) {
+            return false;
+        }
+        if( ftransres != _fIkCacheTranslationResolution || frotres != _fIkCacheRotationResolution || maxentries <= 0 ) {
+            _ClearSolutionCache();
+        }
+        _nIkCacheMaxEntries = std::max(0, maxentries);
+        _fIkCacheTranslationResolution = ftransres;
+        _fIkCacheRotationResolution = frotres;
+        while( _mapIkCache.size() > _nIkCacheMaxEntries ) {
+            _EvictLeastRecentlyUsedSolutions();
+        }
+        return true;
+    }
+
+    bool _GetSolutionCacheStatisticsCommand(ostream& sout, istream& sinput)
+    {
+        sout << _nIkCacheHits << " " << _nIkCacheMisses << " " << _nIkCacheEvictions << " " << _mapIkCache.size();
+        return true;
+    }
+
+    bool _ClearSolutionCacheCommand(ostream& sout, istream& sinput)
+    {
+        _ClearSolutionCache();
+        return true;
+    }
+
     bool _GetFreeIndicesCommand(ostream& sout, istream& sinput)
     {
         FOREACHC(it, _vfreeparams) {
@@ -185,12 +369,8 @@ for numBacktraceLinksForSelfCollisionWithNonMoving numBacktraceLinksForSelfColli
 
     bool _GetJacobianRefineCommand(ostream& sout, istream& sinput)
     {
-#ifdef OPENRAVE_HAS_LAPACK
         sout << _jacobinvsolver.GetErrorThresh() << " " << _jacobinvsolver.GetMaxIterations();
         return true;
-#else
-        return false;
-#endif
     }
 
     bool _GetSolutionIndicesCommand(ostream& sout, istream& sinput)
@@ -208,6 +388,20 @@ for numBacktraceLinksForSelfCollisionWithNonMoving numBacktraceLinksForSelfColli
         return true;
     }
 
+    static bool _GetSolutionIndicesTypedCommand(InterfaceBase& interfacebase, const TypedCommandData& input, TypedCommandData& output)
+    {
+        const IkFastSolver<IkReal>& solver = static_cast<const IkFastSolver<IkReal>&>(interfacebase);
+        output.vintvalues.insert(output.vintvalues.end(), solver._vsolutionindices.begin(), solver._vsolutionindices.end());
+        return true;
+    }
+
+    static bool _GetRobotLinkStateRepeatCountTypedCommand(InterfaceBase& interfacebase, const TypedCommandData& input, TypedCommandData& output)
+    {
+        const IkFastSolver<IkReal>& solver = static_cast<const IkFastSolver<IkReal>&>(interfacebase);
+        output.vintvalues.push_back(solver._nSameStateRepeatCount);
+        return true;
+    }
+
     bool _SetBackTraceSelfCollisionLinksCommand(ostream& sout, istream& sinput)
     {
         sinput >> _numBacktraceLinksForSelfCollisionWithNonMoving >> _numBacktraceLinksForSelfCollisionWithFree;
@@ -285,6 +479,7 @@ for numBacktraceLinksForSelfCollisionWithNonMoving numBacktraceLinksForSelfColli
 
     virtual bool Init(RobotBase::ManipulatorConstPtr pmanip)
     {
+        _ClearSolutionCache();
         if( _kinematicshash.size() > 0 && pmanip->GetInverseKinematicsStructureHash(_iktype) != _kinematicshash ) {
             RAVELOG_ERROR_FORMAT("env=%d, inverse kinematics hashes do not match for manip %s:%s. IK will not work!  manip (%s) != loaded (%s)", pmanip->GetRobot()->GetEnv()->GetId()%pmanip->GetRobot()->GetName()%pmanip->GetName()%pmanip->GetInverseKinematicsStructureHash(_iktype)%_kinematicshash);
             return false;
@@ -397,11 +592,9 @@ for numBacktraceLinksForSelfCollisionWithNonMoving numBacktraceLinksForSelfColli
             }
         }
 
-#ifdef OPENRAVE_HAS_LAPACK
         if( !!pmanip ) {
             _jacobinvsolver.Init(*pmanip);
         }
-#endif
 
         SetJointLimits();
         return true;
@@ -429,10 +622,50 @@ for numBacktraceLinksForSelfCollisionWithNonMoving numBacktraceLinksForSelfColli
     }
 
     /// \brief manages the enabling and disabling of the end effector links depending on the filter options
+    /// \brief environment collision results of the end effector by its transform.
+    ///
+    /// Many ik solutions share the same end effector pose, so a colliding gripper pose only has to be checked once. Shared by all
+    /// poses of a SolveBatch call, so the full transform is compared.
+    class EndEffectorCollisionCache
+    {
+public:
+        EndEffectorCollisionCache() : numHits(0) {
+        }
+
+        /// \return 1 if colliding, 0 if not, -1 if unknown
+        int Find(const Transform& tendeffector)
+        {
+            FOREACHC(it, _listTransforms) {
+                if( (tendeffector.trans - it->first.trans).lengthsqr3() <= 1e-10 && RaveFabs(tendeffector.rot.dot(it->first.rot)) >= 1-1e-10 ) {
+                    ++numHits;
+                    return (int)it->second;
+                }
+            }
+            return -1;
+        }
+
+        void Register(const Transform& tendeffector, bool bColliding)
+        {
+            // the newest poses are the most likely to repeat
+            _listTransforms.emplace_front(tendeffector, bColliding);
+            if( _listTransforms.size() > 64 ) {
+                _listTransforms.pop_back();
+            }
+        }
+
+        int numHits; ///< number of found transforms, for debugging
+private:
+        std::list<std::pair<Transform, bool> > _listTransforms;
+    };
+    typedef boost::shared_ptr<EndEffectorCollisionCache> EndEffectorCollisionCachePtr;
+
     class StateCheckEndEffector
     {
 public:
-        StateCheckEndEffector(RobotBasePtr probot, const std::vector<KinBody::LinkPtr>& vchildlinks, const std::vector<KinBody::LinkPtr>& vindependentlinks, int filteroptions) : _vchildlinks(vchildlinks), _vindependentlinks(vindependentlinks) {
+        StateCheckEndEffector(RobotBasePtr probot, const std::vector<KinBody::LinkPtr>& vchildlinks, const std::vector<KinBody::LinkPtr>& vindependentlinks, int filteroptions, EndEffectorCollisionCachePtr pcollisioncache=EndEffectorCollisionCachePtr()) : _vchildlinks(vchildlinks), _vindependentlinks(vindependentlinks), _pcollisioncache(pcollisioncache) {
+            if( !_pcollisioncache ) {
+                _pcollisioncache.reset(new EndEffectorCollisionCache());
+            }
             _probot = probot;
             _bCheckEndEffectorEnvCollision = !(filteroptions & IKFO_IgnoreEndEffectorEnvCollisions);
             _bCheckEndEffectorSelfCollision = !(filteroptions & (IKFO_IgnoreEndEffectorSelfCollisions|IKFO_IgnoreSelfCollisions));
@@ -526,6 +759,10 @@ public:
             _listCollidingTransforms.emplace_back(t,  bcolliding);
         }
 
+        EndEffectorCollisionCache& GetCollisionCache() {
+            return *_pcollisioncache;
+        }
+
         int numImpossibleSelfCollisions; ///< a count of the number of self-collisions that most likely mean that the IK itself will fail.
 protected:
         void _InitSavers()
@@ -629,6 +866,7 @@ protected:
         UserDataPtr _callbackhandle;
         const std::vector<KinBody::LinkPtr>& _vchildlinks, &_vindependentlinks;
         std::list<std::pair<Transform, bool> > _listCollidingTransforms;
+        EndEffectorCollisionCachePtr _pcollisioncache;
         bool _bCheckEndEffectorEnvCollision, _bCheckEndEffectorSelfCollision, _bCheckSelfCollision, _bDisabled;
     };
 
@@ -696,6 +934,7 @@ protected:
 
     virtual bool Solve(const IkParameterization& rawparam, const std::vector<dReal>& q0, int filteroptions, IkReturnPtr ikreturn)
     {
+        OPENRAVE_TRACE_SCOPE("IkFastSolver::Solve");
         IkParameterization ikparamdummy;
         const IkParameterization& param = _ConvertIkParameterization(rawparam, ikparamdummy);
         if( !!ikreturn ) {
@@ -708,7 +947,11 @@ protected:
         std::vector<IkReal> vfree(_vfreeparams.size());
         StateCheckEndEffector stateCheck(probot,_vchildlinks,_vindependentlinks,filteroptions);
         CollisionOptionsStateSaver optionstate(GetEnv()->GetCollisionChecker(),GetEnv()->GetCollisionChecker()->GetCollisionOptions()|CO_ActiveDOFs,false);
-        IkReturnAction retaction = ComposeSolution(_vfreeparams, vfree, 0, q0, boost::bind(&IkFastSolver::_SolveSingle,shared_solver(), boost::ref(param),boost::ref(vfree),boost::ref(q0),filteroptions,ikreturn,boost::ref(stateCheck)), _vFreeInc);
+        boost::shared_ptr<IkFastSolver<IkReal> > solver = shared_solver();
+        auto fn = [&]() {
+                      return solver->_SolveSingle(param, vfree, q0, filteroptions, ikreturn, stateCheck);
+                  };
+        IkReturnAction retaction = ComposeSolution(_vfreeparams, vfree, 0, q0, fn, _vFreeInc);
         if( !!ikreturn ) {
             ikreturn->_action = retaction;
         }
@@ -717,6 +960,7 @@ protected:
 
     virtual bool SolveAll(const IkParameterization& rawparam, int filteroptions, std::vector<IkReturnPtr>& vikreturns)
     {
+        OPENRAVE_TRACE_SCOPE("IkFastSolver::SolveAll");
         vikreturns.resize(0);
         IkParameterization ikparamdummy;
         const IkParameterization& param = _ConvertIkParameterization(rawparam, ikparamdummy);
@@ -727,7 +971,17 @@ protected:
         std::vector<IkReal> vfree(_vfreeparams.size());
         StateCheckEndEffector stateCheck(probot,_vchildlinks,_vindependentlinks,filteroptions);
         CollisionOptionsStateSaver optionstate(GetEnv()->GetCollisionChecker(),GetEnv()->GetCollisionChecker()->GetCollisionOptions()|CO_ActiveDOFs,false);
-        IkReturnAction retaction = ComposeSolution(_vfreeparams, vfree, 0, vector<dReal>(), boost::bind(&IkFastSolver::_SolveAll,shared_solver(), param,boost::ref(vfree),filteroptions,boost::ref(vikreturns), boost::ref(stateCheck)), _vFreeInc);
+        IkReturnAction retaction;
+        if( _nSolveAllThreads > 1 && _vfreeparams.size() > 0 && ((filteroptions & IKFO_IgnoreCustomFilters) || !_HasFilterInRange(IKSP_MinPriority, IKSP_MaxPriority)) ) {
+            retaction = _SolveAllParallel(param, filteroptions, vikreturns, stateCheck);
+        }
+        else {
+            boost::shared_ptr<IkFastSolver<IkReal> > solver = shared_solver();
+            auto fn = [&]() {
+                          return solver->_SolveAll(param, vfree, filteroptions, vikreturns, stateCheck);
+                      };
+            retaction = ComposeSolution(_vfreeparams, vfree, 0, vector<dReal>(), fn, _vFreeInc);
+        }
         if( retaction & IKRA_Quit ) {
             return false;
         }
@@ -737,6 +991,7 @@ protected:
 
     virtual bool Solve(const IkParameterization& rawparam, const std::vector<dReal>& q0, const std::vector<dReal>& vFreeParameters, int filteroptions, IkReturnPtr ikreturn)
     {
+        OPENRAVE_TRACE_SCOPE("IkFastSolver::Solve");
         IkParameterization ikparamdummy;
         const IkParameterization& param = _ConvertIkParameterization(rawparam, ikparamdummy);
         if( vFreeParameters.size() != _vfreeparams.size() ) {
@@ -764,6 +1019,7 @@ protected:
 
     virtual bool SolveAll(const IkParameterization& rawparam, const std::vector<dReal>& vFreeParameters, int filteroptions, std::vector<IkReturnPtr>& vikreturns)
     {
+        OPENRAVE_TRACE_SCOPE("IkFastSolver::SolveAll");
         vikreturns.resize(0);
         IkParameterization ikparamdummy;
         const IkParameterization& param = _ConvertIkParameterization(rawparam, ikparamdummy);
@@ -788,6 +1044,148 @@ protected:
         return vikreturns.size()>0;
     }
 
+    virtual int SolveBatch(const std::vector<IkParameterization>& vparams, const std::vector<dReal>& q0, int filteroptions, std::vector<IkReturnPtr>& vikreturns, int numThreads)
+    {
+        vikreturns.resize(vparams.size());
+        FOREACH(itikreturn, vikreturns) {
+            itikreturn->reset(new IkReturn(IKRA_Reject));
+        }
+        // custom filters are bound to the original environment, so the cloned workers of SolveAll can only be used without them
+        size_t nthreads = std::min((size_t)std::max(1, numThreads), vparams.size());
+        if( !(filteroptions & IKFO_IgnoreCustomFilters) && _HasFilterInRange(IKSP_MinPriority, IKSP_MaxPriority) ) {
+            nthreads = 1;
+        }
+        if( nthreads > 1 ) {
+            _InitSolveAllWorkers(nthreads-1);
+        }
+        std::vector<uint8_t> vreachable;
+        _ComputeBatchReachability(vparams, vreachable);
+
+        std::atomic<size_t> nNextParam(0);
+        std::vector<std::exception_ptr> vexceptions(std::max((size_t)1, nthreads));
+        std::vector<std::thread> vthreads;
+        vthreads.reserve(nthreads > 0 ? nthreads-1 : 0);
+        for(size_t ithread = 1; ithread < nthreads; ++ithread) {
+            boost::shared_ptr< IkFastSolver<IkReal> > psolver = _vSolveAllWorkers.at(ithread-1).psolver;
+            vthreads.emplace_back([&, psolver, ithread]() {
+                try {
+                    EnvironmentLock lock(psolver->GetEnv()->GetMutex());
+                    psolver->_SolveBatch(vparams, q0, filteroptions, vreachable, vikreturns, nNextParam);
+                }
+                catch(...) {
+                    vexceptions[ithread] = std::current_exception();
+                    nNextParam.store(vparams.size());
+                }
+            });
+        }
+        try {
+            _SolveBatch(vparams, q0, filteroptions, vreachable, vikreturns, nNextParam);
+        }
+        catch(...) {
+            vexceptions.at(0) = std::current_exception();
+            nNextParam.store(vparams.size());
+        }
+        FOREACH(itthread, vthreads) {
+            itthread->join();
+        }
+        FOREACH(itexception, vexceptions) {
+            if( !!*itexception ) {
+                std::rethrow_exception(*itexception);
+            }
+        }
+
+        int numsolved = 0;
+        FOREACHC(itikreturn, vikreturns) {
+            if( (*itikreturn)->_action == IKRA_Success ) {
+                ++numsolved;
+            }
+        }
+        return numsolved;
+    }
+
+    /// \brief computes the raw ik of all Transform6D poses with one call of the batched ikfast function, so that the poses without any
+    /// kinematic solution are rejected before the collision setup.
+    ///
+    /// \param[out] vreachable 0 if the pose has no kinematic solution, 1 otherwise. Empty if the library or the solver does not support it.
+    void _ComputeBatchReachability(const std::vector<IkParameterization>& vparams, std::vector<uint8_t>& vreachable)
+    {
+        vreachable.resize(0);
+        // with free parameters the raw ik depends on the search and the jacobian refinement retries with jitter, so only the plain 6D case is batched
+        if( !_ikfunctions->_ComputeIkBatch || _iktype != IKP_Transform6D || _vfreeparams.size() > 0 || _fRefineWithJacobianInverseAllowedError > 0 ) {
+            return;
+        }
+        RobotBase::ManipulatorPtr pmanip(_pmanip);
+        Transform tIkChainEndlinkToEE;
+        if (!!pmanip->GetIkChainEndLink()) {
+            tIkChainEndlinkToEE = pmanip->GetIkChainEndLink()->GetTransform().inverse() * pmanip->GetEndEffector()->GetTransform();
+        }
+        const Transform tLocalToolInv = (tIkChainEndlinkToEE * pmanip->GetLocalToolTransform()).inverse();
+        std::vector<size_t> vindices;
+        std::vector<IkReal> veetrans, veerot;
+        for(size_t iparam = 0; iparam < vparams.size(); ++iparam) {
+            if( vparams[iparam].GetType() != IKP_Transform6D ) {
+                continue;
+            }
+            TransformMatrix t = vparams[iparam].GetTransform6D();
+            if( _bEmptyTransform6D ) {
+                t = t * tLocalToolInv;
+            }
+            vindices.push_back(iparam);
+            veetrans.insert(veetrans.end(), {(IkReal)t.trans.x, (IkReal)t.trans.y, (IkReal)t.trans.z});
+            veerot.insert(veerot.end(), {(IkReal)t.m[0],(IkReal)t.m[1],(IkReal)t.m[2],(IkReal)t.m[4],(IkReal)t.m[5],(IkReal)t.m[6],(IkReal)t.m[8],(IkReal)t.m[9],(IkReal)t.m[10]});
+        }
+        if( vindices.empty() ) {
+            return;
+        }
+        std::vector< ikfast::IkSolutionList<IkReal> > vsolutions(vindices.size());
+        std::vector< ikfast::IkSolutionListBase<IkReal>* > vpsolutions(vindices.size());
+        for(size_t i = 0; i < vindices.size(); ++i) {
+            vpsolutions[i] = &vsolutions[i];
+        }
+        int numsolved = _ikfunctions->_ComputeIkBatch((int)vindices.size(), &veetrans[0], &veerot[0], NULL, &vpsolutions[0]);
+        vreachable.resize(vparams.size(), 1);
+        for(size_t i = 0; i < vindices.size(); ++i) {
+            vreachable[vindices[i]] = vsolutions[i].GetNumSolutions() > 0;
+        }
+        RAVELOG_VERBOSE_FORMAT("env=%s, %d/%d poses have kinematic solutions", GetEnv()->GetNameId()%numsolved%vindices.size());
+    }
+
+    /// \brief solves the poses of vparams until all are taken, the robot state and collision options are set up once for all of them
+    ///
+    /// \param vreachable if not empty, the poses with 0 are rejected without solving
+    void _SolveBatch(const std::vector<IkParameterization>& vparams, const std::vector<dReal>& q0, int filteroptions, const std::vector<uint8_t>& vreachable, std::vector<IkReturnPtr>& vikreturns, std::atomic<size_t>& nNextParam)
+    {
+        RobotBase::ManipulatorPtr pmanip(_pmanip);
+        RobotBasePtr probot = pmanip->GetRobot();
+        RobotBase::RobotStateSaver saver(probot);
+        probot->SetActiveDOFs(pmanip->GetArmIndices());
+        CollisionCheckerBasePtr pchecker = GetEnv()->GetCollisionChecker();
+        CollisionOptionsStateSaver optionstate(pchecker,pchecker->GetCollisionOptions()|CO_ActiveDOFs,false);
+        boost::shared_ptr<IkFastSolver<IkReal> > solver = shared_solver();
+        std::vector<IkReal> vfree(_vfreeparams.size());
+        IkParameterization ikparamdummy;
+        EndEffectorCollisionCachePtr pcollisioncache(new EndEffectorCollisionCache());
+        while(true) {
+            const size_t iparam = nNextParam.fetch_add(1);
+            if( iparam >= vparams.size() ) {
+                break;
+            }
+            const IkParameterization& param = _ConvertIkParameterization(vparams[iparam], ikparamdummy);
+            IkReturnPtr ikreturn = vikreturns[iparam];
+            ikreturn->Clear();
+            if( vreachable.size() > 0 && !vreachable[iparam] ) {
+                ikreturn->_action = IKRA_RejectKinematics;
+                continue;
+            }
+            // the rotation only end effector checks are only valid for one pose, so only the collision cache is shared
+            StateCheckEndEffector stateCheck(probot,_vchildlinks,_vindependentlinks,filteroptions,pcollisioncache);
+            auto fn = [&]() {
+                          return solver->_SolveSingle(param, vfree, q0, filteroptions, ikreturn, stateCheck);
+                      };
+            ikreturn->_action = ComposeSolution(_vfreeparams, vfree, 0, q0, fn, _vFreeInc);
+        }
+    }
+
     virtual int GetNumFreeParameters() const
     {
         return (int)_vfreeparams.size();
@@ -855,6 +1253,10 @@ protected:
         _vfreeparamscales = r->_vfreeparamscales;
         _ikfunctions = r->_ikfunctions; // probably not necessary, but not setting it here could create inconsistency problems later on
         _vFreeInc = r->_vFreeInc;
+        if( _nSolveAllThreads != r->_nSolveAllThreads ) {
+            _vSolveAllWorkers.clear();
+        }
+        _nSolveAllThreads = r->_nSolveAllThreads;
         _fFreeIncRevolute = r->_fFreeIncRevolute;
         _fFreeIncPrismaticNum = r->_fFreeIncPrismaticNum;
         _nTotalDOF = r->_nTotalDOF;
@@ -870,15 +1272,19 @@ protected:
         _numBacktraceLinksForSelfCollisionWithNonMoving = r->_numBacktraceLinksForSelfCollisionWithNonMoving;
         _numBacktraceLinksForSelfCollisionWithFree = r->_numBacktraceLinksForSelfCollisionWithFree;
         _ikthreshold = r->_ikthreshold;
-#ifdef OPENRAVE_HAS_LAPACK
+        _nIkCacheMaxEntries = r->_nIkCacheMaxEntries;
+        _fIkCacheTranslationResolution = r->_fIkCacheTranslationResolution;
+        _fIkCacheRotationResolution = r->_fIkCacheRotationResolution;
+        _ClearSolutionCache();
         _SetJacobianRefine(r->_fRefineWithJacobianInverseAllowedError, r->_jacobinvsolver._nMaxIterations);
-#endif
 
         _bEmptyTransform6D = r->_bEmptyTransform6D;
     }
 
 protected:
-    IkReturnAction ComposeSolution(const std::vector<int>& vfreeparams, vector<IkReal>& vfree, int freeindex, const vector<dReal>& q0, const boost::function<IkReturnAction()>& fn, const std::vector<dReal>& vFreeInc)
+    /// \param fn called for every discretized value of the free parameters. Templated so that the bound functor is not converted to a boost::function on every call.
+    template <typename F>
+    IkReturnAction ComposeSolution(const std::vector<int>& vfreeparams, vector<IkReal>& vfree, int freeindex, const vector<dReal>& q0, F& fn, const std::vector<dReal>& vFreeInc)
     {
         if( freeindex >= (int)vfreeparams.size()) {
             return fn();
@@ -967,7 +1373,114 @@ protected:
     }
 
     /// \param tLocalTool _pmanip->GetLocalToolTransform()
-    inline bool _CallIk(const IkParameterization& param, const vector<IkReal>& vfree, const Transform& tLocalTool, ikfast::IkSolutionList<IkReal>& solutions)
+    inline bool _CallIk(const IkParameterization& param, const vector<IkReal>& vfree, const Transform& tLocalTool, ikfast::IkSolutionListBase<IkReal>& solutions)
+    {
+        if( _nIkCacheMaxEntries > 0 ) {
+            return _CallIkCached(param, vfree, tLocalTool, solutions);
+        }
+        return _CallIkRaw(param, vfree, tLocalTool, solutions);
+    }
+
+    /// \brief _CallIk looking up the raw solutions in the solution cache first, see the SetSolutionCache command
+    bool _CallIkCached(const IkParameterization& param, const vector<IkReal>& vfree, const Transform& tLocalTool, ikfast::IkSolutionListBase<IkReal>& solutions)
+    {
+        // the key holds the type, the quantized goal, the free values and the tool. The free values come from the same discretization every time and the tool rarely changes, so they are quantized finely.
+        const IkParameterizationType iktype = param.GetType();
+        std::vector<dReal>& vvalues = _vIkCacheValues;
+        vvalues.resize(param.GetNumberOfValues());
+        param.GetValues(vvalues.begin());
+        std::vector<int64_t>& vkey = _vIkCacheKey;
+        vkey.resize(0);
+        vkey.push_back(iktype);
+        for(size_t i = 0; i < vvalues.size(); ++i) {
+            vkey.push_back(_QuantizeCacheValue(vvalues[i], _IsRotationValue(iktype, i) ? _fIkCacheRotationResolution : _fIkCacheTranslationResolution));
+        }
+        const dReal ffineresolution = 1e-9;
+        FOREACHC(itfree, vfree) {
+            vkey.push_back(_QuantizeCacheValue(*itfree, ffineresolution));
+        }
+        for(int i = 0; i < 4; ++i) {
+            vkey.push_back(_QuantizeCacheValue(tLocalTool.rot[i], ffineresolution));
+        }
+        for(int i = 0; i < 3; ++i) {
+            vkey.push_back(_QuantizeCacheValue(tLocalTool.trans[i], ffineresolution));
+        }
+
+        typename std::map<std::vector<int64_t>, CachedIkSolutions>::iterator itcache = _mapIkCache.find(vkey);
+        if( itcache != _mapIkCache.end() ) {
+            ++_nIkCacheHits;
+            _listIkCacheLRU.splice(_listIkCacheLRU.begin(), _listIkCacheLRU, itcache->second.itlru);
+            solutions.Clear();
+            FOREACHC(itsolution, itcache->second.vsolutions) {
+                solutions.AddSolution(itsolution->_vbasesol, itsolution->_vfree);
+            }
+            return itcache->second.bsuccess;
+        }
+
+        ++_nIkCacheMisses;
+        bool bsuccess = _CallIkRaw(param, vfree, tLocalTool, solutions);
+        if( _mapIkCache.size() >= _nIkCacheMaxEntries ) {
+            _EvictLeastRecentlyUsedSolutions();
+        }
+        CachedIkSolutions& cached = _mapIkCache[vkey];
+        cached.bsuccess = bsuccess;
+        cached.vsolutions.reserve(solutions.GetNumSolutions());
+        for(size_t isolution = 0; isolution < solutions.GetNumSolutions(); ++isolution) {
+            cached.vsolutions.push_back(dynamic_cast<const ikfast::IkSolution<IkReal>& >(solutions.GetSolution(isolution)));
+        }
+        _listIkCacheLRU.push_front(vkey);
+        cached.itlru = _listIkCacheLRU.begin();
+        return bsuccess;
+    }
+
+    void _EvictLeastRecentlyUsedSolutions()
+    {
+        if( _listIkCacheLRU.size() > 0 ) {
+            _mapIkCache.erase(_listIkCacheLRU.back());
+            _listIkCacheLRU.pop_back();
+            ++_nIkCacheEvictions;
+        }
+    }
+
+    void _ClearSolutionCache()
+    {
+        _mapIkCache.clear();
+        _listIkCacheLRU.clear();
+        _nIkCacheHits = _nIkCacheMisses = _nIkCacheEvictions = 0;
+    }
+
+    static inline int64_t _QuantizeCacheValue(dReal value, dReal resolution)
+    {
+        return (int64_t)std::floor(value/resolution + 0.5);
+    }
+
+    /// \brief true if value index of IkParameterization::GetValues is a quaternion, direction or angle component rather than a translation
+    static bool _IsRotationValue(IkParameterizationType iktype, size_t index)
+    {
+        switch(iktype & ~IKP_VelocityDataBit) {
+        case IKP_Transform6D:
+        case IKP_Rotation3D:
+            return index < 4;
+        case IKP_Direction3D:
+        case IKP_Ray4D:
+        case IKP_TranslationDirection5D:
+            return index < 3;
+        case IKP_TranslationXYOrientation3D:
+            return index == 2;
+        case IKP_TranslationXAxisAngle4D:
+        case IKP_TranslationYAxisAngle4D:
+        case IKP_TranslationZAxisAngle4D:
+        case IKP_TranslationXAxisAngleZNorm4D:
+        case IKP_TranslationYAxisAngleXNorm4D:
+        case IKP_TranslationZAxisAngleYNorm4D:
+            return index == 0;
+        default:
+            return false;
+        }
+    }
+
+    /// \brief calls the ikfast functions
+    bool _CallIkRaw(const IkParameterization& param, const vector<IkReal>& vfree, const Transform& tLocalTool, ikfast::IkSolutionListBase<IkReal>& solutions)
     {
         bool bsuccess = false;
         if( !!_ikfunctions->_ComputeIk2 ) {
@@ -979,7 +1492,7 @@ protected:
         return bsuccess;
     }
 
-    bool _CallIk1(const IkParameterization& param, const vector<IkReal>& vfree, const Transform& tLocalTool, ikfast::IkSolutionList<IkReal>& solutions)
+    bool _CallIk1(const IkParameterization& param, const vector<IkReal>& vfree, const Transform& tLocalTool, ikfast::IkSolutionListBase<IkReal>& solutions)
     {
         try {
             switch(param.GetType()) {
@@ -1116,7 +1629,7 @@ protected:
         throw openrave_exception(str(boost::format(_("don't support ik parameterization 0x%x"))%param.GetType()),ORE_InvalidArguments);
     }
 
-    bool _CallIk2(const IkParameterization& param, const vector<IkReal>& vfree, const Transform& tLocalTool, ikfast::IkSolutionList<IkReal>& solutions)
+    bool _CallIk2(const IkParameterization& param, const vector<IkReal>& vfree, const Transform& tLocalTool, ikfast::IkSolutionListBase<IkReal>& solutions)
     {
         RobotBase::ManipulatorPtr pmanip = _pmanip.lock();
         try {
@@ -1137,7 +1650,6 @@ protected:
 //                ss << endl;
                 bool bret = _ikfunctions->_ComputeIk2(eetrans, eerot, vfree.size()>0 ? &vfree[0] : NULL, solutions, &pmanip);
                 if( !bret ) {
-#ifdef OPENRAVE_HAS_LAPACK
                     if( _fRefineWithJacobianInverseAllowedError > 0 ) {
                         // since will be refining, can add a little error to see if IK gets recomputed
                         eetrans[0] += 0.001;
@@ -1152,7 +1664,6 @@ protected:
                         }
                         RAVELOG_VERBOSE("ik failed, trying with slight jitter, ret=%d", (int)bret);
                     }
-#endif
                 }
 //                ss << "ret=" << bret << " numsols=" << solutions.GetNumSolutions();
 //                RAVELOG_INFO(ss.str());
@@ -1202,7 +1713,6 @@ protected:
                 //RAVELOG_INFO_FORMAT("translationdirection5d: %.17e %.17e %.17e %.17e 0 0 0 %.17e 0 0 0 %.17e", r.dir.x%r.dir.y%r.dir.z%r.pos.x%r.pos.y%r.pos.z);
                 bool bret = _ikfunctions->_ComputeIk2(eetrans, eerot, vfree.size()>0 ? &vfree[0] : NULL, solutions, &pmanip);
                 if( !bret ) {
-#ifdef OPENRAVE_HAS_LAPACK
                     if( _fRefineWithJacobianInverseAllowedError > 0 ) {
                         // since will be refining, can add a little error to see if IK gets recomputed
                         eerot[0] = r.dir.x+0.01;
@@ -1245,7 +1755,6 @@ protected:
                         }
                         RAVELOG_VERBOSE("ik failed, trying with slight jitter, ret=%d", (int)bret);
                     }
-#endif
                 }
 
                 return bret;
@@ -1329,7 +1838,9 @@ protected:
     IkReturnAction _SolveSingle(const IkParameterization& param, const vector<IkReal>& vfree, const vector<dReal>& q0, int filteroptions, IkReturnPtr ikreturn, StateCheckEndEffector& stateCheck)
     {
         RobotBase::ManipulatorPtr pmanip(_pmanip);
-        ikfast::IkSolutionList<IkReal> solutions;
+        SolveWorkspaceScope workspacescope(*this);
+        SolveWorkspace& workspace = workspacescope.Get();
+        IkSolutionPool& solutions = workspace.solutions;
         Transform tIkChainEndlinkToEE;
         if (!!pmanip->GetIkChainEndLink()) {
             tIkChainEndlinkToEE = pmanip->GetIkChainEndLink()->GetTransform().inverse() * pmanip->GetEndEffector()->GetTransform();
@@ -1341,15 +1852,20 @@ protected:
 
         RobotBasePtr probot = pmanip->GetRobot();
         SolutionInfo bestsolution;
-        std::vector<dReal> vravesol(pmanip->GetArmIndices().size());
-        std::vector<IkReal> sol(pmanip->GetArmIndices().size()), vsolfree;
+        std::vector<dReal>& vravesol = workspace.vravesol;
+        std::vector<IkReal>& sol = workspace.sol;
+        std::vector<IkReal>& vsolfree = workspace.vsolfree;
+        vravesol.resize(pmanip->GetArmIndices().size());
+        sol.resize(pmanip->GetArmIndices().size());
         // find the first valid solution that satisfies joint constraints and collisions
         boost::tuple<const vector<IkReal>&, const vector<dReal>&,int> textra(vsolfree, q0, filteroptions);
 
-        vector<int> vsolutionorder(solutions.GetNumSolutions());
+        std::vector<int>& vsolutionorder = workspace.vsolutionorder;
+        vsolutionorder.resize(solutions.GetNumSolutions());
         if( vravesol.size() == q0.size() ) {
             // sort the solutions from closest to farthest
-            vector<pair<size_t,dReal> > vdists; vdists.reserve(solutions.GetNumSolutions());
+            std::vector<std::pair<size_t,dReal> >& vdists = workspace.vdists;
+            vdists.resize(0);
             for(size_t isolution = 0; isolution < solutions.GetNumSolutions(); ++isolution) {
                 const ikfast::IkSolution<IkReal>& iksol = dynamic_cast<const ikfast::IkSolution<IkReal>& >(solutions.GetSolution(isolution));
                 iksol.Validate();
@@ -1383,8 +1899,11 @@ protected:
             if( iksol.GetFree().size() > 0 ) {
                 // have to search over all the free parameters of the solution!
                 vsolfree.resize(iksol.GetFree().size());
-                std::vector<dReal> vFreeInc(_GetFreeIncFromIndices(iksol.GetFree()));
-                res = ComposeSolution(iksol.GetFree(), vsolfree, 0, q0, boost::bind(&IkFastSolver::_ValidateSolutionSingle,shared_solver(), boost::ref(iksol), boost::ref(textra), boost::ref(sol), boost::ref(vravesol), boost::ref(bestsolution), boost::ref(param), boost::ref(stateCheck), boost::ref(paramnewglobal)), vFreeInc);
+                _GetFreeIncFromIndices(iksol.GetFree(), workspace.vFreeInc);
+                auto fn = [&]() {
+                              return _ValidateSolutionSingle(iksol, textra, sol, vravesol, bestsolution, param, stateCheck, paramnewglobal);
+                          };
+                res = ComposeSolution(iksol.GetFree(), vsolfree, 0, q0, fn, workspace.vFreeInc);
             }
             else {
                 vsolfree.resize(0);
@@ -1415,7 +1934,6 @@ protected:
 
     void _CheckRefineSolution(const IkParameterization& param, const RobotBase::Manipulator& manip, std::vector<dReal>& vsolution, bool bIgnoreJointLimits)
     {
-#ifdef OPENRAVE_HAS_LAPACK
         IkParameterization paramnew = manip.GetIkParameterization(param,false);
         dReal ikworkspacedist = param.ComputeDistanceSqr(paramnew);
         if( _fRefineWithJacobianInverseAllowedError > 0 && ikworkspacedist > _fRefineWithJacobianInverseAllowedError*_fRefineWithJacobianInverseAllowedError ) {
@@ -1462,7 +1980,6 @@ protected:
                 }
             }
         }
-#endif
     }
 
 
@@ -1593,7 +2110,8 @@ protected:
 
         CollisionReport report;
         CollisionReportPtr ptempreport;
-        if( !(filteroptions&IKFO_IgnoreSelfCollisions) || IS_DEBUGLEVEL(Level_Verbose) || paramnewglobal.GetType() == IKP_TranslationDirection5D ) { // 5D is necessary for tracking end effector collisions
+        // when the end effector is not determined by the ik, the report is necessary for tracking end effector collisions
+        if( !(filteroptions&IKFO_IgnoreSelfCollisions) || IS_DEBUGLEVEL(Level_Verbose) || (paramnewglobal.GetType() != IKP_Transform6D && (filteroptions&IKFO_CheckEnvCollisions)) ) {
             ptempreport = boost::shared_ptr<CollisionReport>(&report,utils::null_deleter());
         }
         if( !(filteroptions&IKFO_IgnoreSelfCollisions) ) {
@@ -1678,8 +2196,15 @@ protected:
                 // only check if the end-effector position is fully determined from the ik
                 if( paramnewglobal.GetType() == IKP_Transform6D ) {// || (int)pmanip->GetArmIndices().size() <= paramnewglobal.GetDOF() ) {
                     // if gripper is colliding, solutions will always fail, so completely stop solution process
-                    if( pmanip->CheckEndEffectorCollision(pmanip->GetTransform(), ptempreport) ) {
-                        if( !!ptempreport ) {
+                    const Transform tendeffector = pmanip->GetTransform();
+                    int colliding = stateCheck.GetCollisionCache().Find(tendeffector);
+                    const bool bChecked = colliding < 0;
+                    if( bChecked ) {
+                        colliding = pmanip->CheckEndEffectorCollision(tendeffector, ptempreport) ? 1 : 0;
+                        stateCheck.GetCollisionCache().Register(tendeffector, colliding == 1);
+                    }
+                    if( colliding == 1 ) {
+                        if( bChecked && !!ptempreport ) {
                             stringstream ss; ss << std::setprecision(std::numeric_limits<OpenRAVE::dReal>::digits10+1);
                             ss << "ikfast collision " << report.__str__() << " colvalues=[";
                             std::vector<dReal> vallvalues;
@@ -1713,29 +2238,17 @@ protected:
                     }
                 }
             }
+            // the other ik types do not determine the end effector, but their solutions often share its pose
+            const bool bCacheEndEffectorCollision = stateCheck.NeedCheckEndEffectorEnvCollision() && paramnewglobal.GetType() != IKP_Transform6D;
+            if( bCacheEndEffectorCollision && stateCheck.GetCollisionCache().Find(pmanip->GetTransform()) == 1 ) {
+                return static_cast<IkReturnAction>(retactionall|IKRA_RejectEnvCollision);
+            }
             if( GetEnv()->CheckCollision(KinBodyConstPtr(probot), ptempreport) ) {
-                if( paramnewglobal.GetType() == IKP_TranslationDirection5D ) {
-                    // colliding and 5d,so check if colliding with end effector. If yes, then register as part of the stateCheck
-                    bool bIsEndEffectorCollision = false;
-                    for(int icollision = 0; icollision < ptempreport->nNumValidCollisions; ++icollision) {
-                        const CollisionPairInfo& cpinfo = ptempreport->vCollisionInfos[icollision];
-                        
-                        if( cpinfo.CompareFirstBodyName(probot->GetName()) == 0 ) {
-                            if( cpinfo.FindFirstMatchingLinkIndex(_vchildlinks) >= 0 ) {
-                                bIsEndEffectorCollision = true;
-                                break;
-                            }
-                        }
-                        if( cpinfo.CompareSecondBodyName(probot->GetName()) == 0 ) {
-                            if( cpinfo.FindSecondMatchingLinkIndex(_vchildlinks) >= 0 ) {
-                                bIsEndEffectorCollision = true;
-                                break;
-                            }
-                        }
-                    }
-                    if( bIsEndEffectorCollision ) {
-                        // only really matters if in collision
-                        stateCheck.RegisterCollidingEndEffector(pmanip->GetTransform(), bIsEndEffectorCollision);
+                if( bCacheEndEffectorCollision && !!ptempreport && _IsEndEffectorCollision(*ptempreport, probot->GetName()) ) {
+                    // colliding with the end effector, so register as part of the stateCheck. only really matters if in collision
+                    stateCheck.GetCollisionCache().Register(pmanip->GetTransform(), true);
+                    if( paramnewglobal.GetType() == IKP_TranslationDirection5D ) {
+                        stateCheck.RegisterCollidingEndEffector(pmanip->GetTransform(), true);
                     }
                 }
 
@@ -1901,15 +2414,18 @@ protected:
     {
         RobotBase::ManipulatorPtr pmanip(_pmanip);
         RobotBasePtr probot = pmanip->GetRobot();
-        ikfast::IkSolutionList<IkReal> solutions;
+        SolveWorkspaceScope workspacescope(*this);
+        SolveWorkspace& workspace = workspacescope.Get();
+        IkSolutionPool& solutions = workspace.solutions;
         Transform tIkChainEndlinkToEE;
         if (!!pmanip->GetIkChainEndLink()) {
             tIkChainEndlinkToEE = pmanip->GetIkChainEndLink()->GetTransform().inverse() * pmanip->GetEndEffector()->GetTransform();
         }
 
         if( _CallIk(param,vfree, tIkChainEndlinkToEE * pmanip->GetLocalToolTransform(), solutions) ) {
-            vector<IkReal> vsolfree;
-            std::vector<IkReal> sol(pmanip->GetArmIndices().size());
+            std::vector<IkReal>& vsolfree = workspace.vsolfree;
+            std::vector<IkReal>& sol = workspace.sol;
+            sol.resize(pmanip->GetArmIndices().size());
             for(size_t isolution = 0; isolution < solutions.GetNumSolutions(); ++isolution) {
                 const ikfast::IkSolution<IkReal>& iksol = dynamic_cast<const ikfast::IkSolution<IkReal>& >(solutions.GetSolution(isolution));
                 iksol.Validate();
@@ -1917,8 +2433,11 @@ protected:
                 if( iksol.GetFree().size() > 0 ) {
                     // have to search over all the free parameters of the solution!
                     vsolfree.resize(iksol.GetFree().size());
-                    std::vector<dReal> vFreeInc(_GetFreeIncFromIndices(iksol.GetFree()));
-                    IkReturnAction retaction = ComposeSolution(iksol.GetFree(), vsolfree, 0, vector<dReal>(), boost::bind(&IkFastSolver::_ValidateSolutionAll,shared_solver(), boost::ref(param), boost::ref(iksol), boost::ref(vsolfree), filteroptions, boost::ref(sol), boost::ref(vikreturns), boost::ref(stateCheck)), vFreeInc);
+                    _GetFreeIncFromIndices(iksol.GetFree(), workspace.vFreeInc);
+                    auto fn = [&]() {
+                                  return _ValidateSolutionAll(param, iksol, vsolfree, filteroptions, sol, vikreturns, stateCheck);
+                              };
+                    IkReturnAction retaction = ComposeSolution(iksol.GetFree(), vsolfree, 0, vector<dReal>(), fn, workspace.vFreeInc);
                     if( retaction & IKRA_Quit) {
                         return retaction;
                     }
@@ -1934,6 +2453,137 @@ protected:
         return IKRA_Reject; // signals to continue
     }
 
+    /// \brief SolveAll over the free joint discretization of ComposeSolution using _nSolveAllThreads threads.
+    ///
+    /// The calling thread works on the current environment, the other threads on their own clones of it. Every grid point keeps its own list of solutions, so concatenating them gives the same result as the serial search.
+    IkReturnAction _SolveAllParallel(const IkParameterization& param, int filteroptions, std::vector<IkReturnPtr>& vikreturns, StateCheckEndEffector& stateCheck)
+    {
+        // enumerate the free joint values in the same order as the serial search
+        const size_t nfree = _vfreeparams.size();
+        std::vector<IkReal> vfree(nfree), vfreegrid;
+        auto fnrecord = [&]() {
+                            vfreegrid.insert(vfreegrid.end(), vfree.begin(), vfree.end());
+                            return IKRA_Reject;
+                        };
+        ComposeSolution(_vfreeparams, vfree, 0, vector<dReal>(), fnrecord, _vFreeInc);
+        const size_t ngrid = vfreegrid.size()/nfree;
+        const size_t nthreads = std::min((size_t)_nSolveAllThreads, ngrid);
+        if( nthreads > 1 ) {
+            _InitSolveAllWorkers(nthreads-1);
+        }
+
+        std::vector< std::vector<IkReturnPtr> > vgridreturns(ngrid);
+        std::atomic<size_t> nNextGrid(0), nFirstQuit(ngrid);
+        std::vector<std::exception_ptr> vexceptions(nthreads);
+        std::vector<std::thread> vthreads;
+        vthreads.reserve(nthreads > 0 ? nthreads-1 : 0);
+        for(size_t ithread = 1; ithread < nthreads; ++ithread) {
+            boost::shared_ptr< IkFastSolver<IkReal> > psolver = _vSolveAllWorkers.at(ithread-1).psolver;
+            vthreads.emplace_back([&, psolver, ithread]() {
+                try {
+                    EnvironmentLock lock(psolver->GetEnv()->GetMutex());
+                    RobotBase::ManipulatorPtr pworkermanip(psolver->_pmanip);
+                    RobotBasePtr pworkerrobot = pworkermanip->GetRobot();
+                    RobotBase::RobotStateSaver saver(pworkerrobot);
+                    pworkerrobot->SetActiveDOFs(pworkermanip->GetArmIndices());
+                    StateCheckEndEffector workerStateCheck(pworkerrobot,psolver->_vchildlinks,psolver->_vindependentlinks,filteroptions);
+                    CollisionCheckerBasePtr pchecker = psolver->GetEnv()->GetCollisionChecker();
+                    CollisionOptionsStateSaver optionstate(pchecker,pchecker->GetCollisionOptions()|CO_ActiveDOFs,false);
+                    psolver->_SolveAllGrid(param, filteroptions, vfreegrid, vgridreturns, nNextGrid, nFirstQuit, workerStateCheck);
+                }
+                catch(...) {
+                    vexceptions[ithread] = std::current_exception();
+                    _UpdateFirstQuit(nFirstQuit, 0);
+                }
+            });
+        }
+        try {
+            _SolveAllGrid(param, filteroptions, vfreegrid, vgridreturns, nNextGrid, nFirstQuit, stateCheck);
+        }
+        catch(...) {
+            vexceptions.at(0) = std::current_exception();
+            _UpdateFirstQuit(nFirstQuit, 0);
+        }
+        FOREACH(itthread, vthreads) {
+            itthread->join();
+        }
+        FOREACH(itexception, vexceptions) {
+            if( !!*itexception ) {
+                std::rethrow_exception(*itexception);
+            }
+        }
+
+        const size_t nlastgrid = std::min(nFirstQuit.load(), ngrid > 0 ? ngrid-1 : 0);
+        for(size_t igrid = 0; igrid < ngrid && igrid <= nlastgrid; ++igrid) {
+            vikreturns.insert(vikreturns.end(), vgridreturns[igrid].begin(), vgridreturns[igrid].end());
+        }
+        return nFirstQuit.load() < ngrid ? IKRA_Quit : IKRA_Reject;
+    }
+
+    /// \brief returns true if one of the collisions of the report involves an end effector link of the robot
+    bool _IsEndEffectorCollision(const CollisionReport& report, const std::string& robotname) const
+    {
+        for(int icollision = 0; icollision < report.nNumValidCollisions; ++icollision) {
+            const CollisionPairInfo& cpinfo = report.vCollisionInfos[icollision];
+            if( cpinfo.CompareFirstBodyName(robotname) == 0 && cpinfo.FindFirstMatchingLinkIndex(_vchildlinks) >= 0 ) {
+                return true;
+            }
+            if( cpinfo.CompareSecondBodyName(robotname) == 0 && cpinfo.FindSecondMatchingLinkIndex(_vchildlinks) >= 0 ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// \brief solves for the grid points of vfreegrid until all are taken or a grid point before them requested to quit
+    void _SolveAllGrid(const IkParameterization& param, int filteroptions, const std::vector<IkReal>& vfreegrid, std::vector< std::vector<IkReturnPtr> >& vgridreturns, std::atomic<size_t>& nNextGrid, std::atomic<size_t>& nFirstQuit, StateCheckEndEffector& stateCheck)
+    {
+        const size_t nfree = _vfreeparams.size();
+        std::vector<IkReal> vfree(nfree);
+        while(true) {
+            // grid points are taken in increasing order, so the ones before a quit are always finished
+            const size_t igrid = nNextGrid.fetch_add(1);
+            if( igrid >= vgridreturns.size() || igrid > nFirstQuit.load() ) {
+                break;
+            }
+            std::copy(vfreegrid.begin()+igrid*nfree, vfreegrid.begin()+(igrid+1)*nfree, vfree.begin());
+            IkReturnAction retaction = _SolveAll(param, vfree, filteroptions, vgridreturns[igrid], stateCheck);
+            if( retaction & IKRA_Quit ) {
+                _UpdateFirstQuit(nFirstQuit, igrid);
+            }
+        }
+    }
+
+    static void _UpdateFirstQuit(std::atomic<size_t>& nFirstQuit, size_t igrid)
+    {
+        size_t nprev = nFirstQuit.load();
+        while( igrid < nprev && !nFirstQuit.compare_exchange_weak(nprev, igrid) ) {
+        }
+    }
+
+    /// \brief makes sure there are nworkers cloned environments with solvers and synchronizes them with the current environment
+    void _InitSolveAllWorkers(size_t nworkers)
+    {
+        EnvironmentBasePtr penv = GetEnv();
+        const int cloningoptions = Clone_Bodies|Clone_ShareGeometry;
+        while( _vSolveAllWorkers.size() < nworkers ) {
+            SolveAllWorker worker;
+            worker.penv = penv->CloneSelf(str(boost::format("%s_ikworker%d")%penv->GetName()%_vSolveAllWorkers.size()), cloningoptions);
+            std::stringstream sinputempty;
+            worker.psolver.reset(new IkFastSolver<IkReal>(worker.penv, sinputempty, _ikfunctions, _vFreeInc, _ikthreshold));
+            _vSolveAllWorkers.push_back(worker);
+            RAVELOG_DEBUG_FORMAT("env=%s, created environment %d for parallel SolveAll", penv->GetNameId()%(_vSolveAllWorkers.size()-1));
+        }
+        for(size_t iworker = 0; iworker < nworkers; ++iworker) {
+            SolveAllWorker& worker = _vSolveAllWorkers[iworker];
+            worker.penv->Clone(penv, cloningoptions);
+            worker.psolver->Clone(shared_from_this(), 0);
+            if( !worker.psolver->_pmanip.lock() ) {
+                throw OPENRAVE_EXCEPTION_FORMAT(_("env=%s, could not find manipulator %s in the cloned environment for parallel SolveAll"), penv->GetNameId()%_manipname, ORE_InvalidState);
+            }
+        }
+    }
+
     IkReturnAction _ValidateSolutionAll(const IkParameterization& param, const ikfast::IkSolution<IkReal>& iksol, const vector<IkReal>& vfree, int filteroptions, std::vector<IkReal>& sol, std::vector<IkReturnPtr>& vikreturns, StateCheckEndEffector& stateCheck)
     {
         iksol.GetSolution(sol,vfree);
@@ -2044,7 +2694,7 @@ protected:
 
         CollisionReport report;
         CollisionReportPtr ptempreport;
-        if( IS_DEBUGLEVEL(Level_Verbose) ) {
+        if( IS_DEBUGLEVEL(Level_Verbose) || (paramnewglobal.GetType() != IKP_Transform6D && (filteroptions&IKFO_CheckEnvCollisions)) ) {
             ptempreport = boost::shared_ptr<CollisionReport>(&report,utils::null_deleter());
         }
         if( !(filteroptions&IKFO_IgnoreSelfCollisions) ) {
@@ -2125,8 +2775,15 @@ protected:
             if( stateCheck.NeedCheckEndEffectorEnvCollision() ) {
                 // only check if the end-effector position is fully determined from the ik
                 if( paramnewglobal.GetType() == IKP_Transform6D ) {// || (int)pmanip->GetArmIndices().size() <= paramnewglobal.GetDOF() ) {
-                    if( pmanip->CheckEndEffectorCollision(pmanip->GetTransform(), ptempreport) ) {
-                        if( !!ptempreport  && ptempreport->IsValid() ) {
+                    const Transform tendeffector = pmanip->GetTransform();
+                    int colliding = stateCheck.GetCollisionCache().Find(tendeffector);
+                    const bool bChecked = colliding < 0;
+                    if( bChecked ) {
+                        colliding = pmanip->CheckEndEffectorCollision(tendeffector, ptempreport) ? 1 : 0;
+                        stateCheck.GetCollisionCache().Register(tendeffector, colliding == 1);
+                    }
+                    if( colliding == 1 ) {
+                        if( bChecked && !!ptempreport  && ptempreport->IsValid() ) {
                             stringstream ss; ss << std::setprecision(std::numeric_limits<OpenRAVE::dReal>::digits10+1);
                             ss << "env=" << GetEnv()->GetId() << ", ikfast collision " << ptempreport->__str__() << " ";
 //                            if( !!ptempreport->plink1 ) {
@@ -2165,7 +2822,15 @@ protected:
                     stateCheck.ResetCheckEndEffectorEnvCollision();
                 }
             }
+            // the other ik types do not determine the end effector, but their solutions often share its pose
+            const bool bCacheEndEffectorCollision = stateCheck.NeedCheckEndEffectorEnvCollision() && paramnewglobal.GetType() != IKP_Transform6D;
+            if( bCacheEndEffectorCollision && stateCheck.GetCollisionCache().Find(pmanip->GetTransform()) == 1 ) {
+                return static_cast<IkReturnAction>(retactionall|IKRA_RejectEnvCollision);
+            }
             if( GetEnv()->CheckCollision(KinBodyConstPtr(probot), ptempreport) ) {
+                if( bCacheEndEffectorCollision && !!ptempreport && _IsEndEffectorCollision(*ptempreport, probot->GetName()) ) {
+                    stateCheck.GetCollisionCache().Register(pmanip->GetTransform(), true);
+                }
                 if( !!ptempreport ) {
                     stringstream ss; ss << std::setprecision(std::numeric_limits<OpenRAVE::dReal>::digits10+1);
                     ss << "ikfast collision " << report.__str__() << " colvalues=[";
@@ -2409,9 +3074,9 @@ protected:
     }
 
     /// \brief return incremental values for indices in the chain
-    std::vector<dReal> _GetFreeIncFromIndices(const std::vector<int>& vindices)
+    void _GetFreeIncFromIndices(const std::vector<int>& vindices, std::vector<dReal>& vFreeInc)
     {
-        std::vector<dReal> vFreeInc(vindices.size());
+        vFreeInc.resize(vindices.size());
         for(size_t i = 0; i < vindices.size(); ++i) {
             if( _vjointrevolute.at(vindices[i]) ) {
                 vFreeInc[i] = _fFreeIncRevolute;
@@ -2421,7 +3086,6 @@ protected:
                 vFreeInc[i] = (_qupper.at(i)-_qlower.at(i))/_fFreeIncPrismaticNum;
             }
         }
-        return vFreeInc;
     }
 
     /// \brief convert ikparam to another type.
@@ -2492,9 +3156,7 @@ protected:
     dReal _ikthreshold; ///< workspace distance threshold sanity checking between desired workspace goal and the workspace position with the returned ik values.
     dReal _fRefineWithJacobianInverseAllowedError; ///< if > 0, then use jacobian inverse numerical method to refine the results until workspace error drops down this much. By default it is disabled (=-1)
 
-#ifdef OPENRAVE_HAS_LAPACK
     ikfastsolvers::JacobianInverseSolver<double> _jacobinvsolver; ///< jacobian inverse solver if _fRefineWithJacobianInverseAllowedError is > 0
-#endif
 
     //@{
     // cache for current Solve call. This has to be saved/restored if any user functions are called (like filters) since the filters themselves can potentially call into this ik solver.
@@ -2502,8 +3164,25 @@ protected:
     int _nSameStateRepeatCount;
     //@}
 
+    std::vector<SolveWorkspacePtr> _vSolveWorkspaces; ///< reusable scratch buffers for _SolveSingle/_SolveAll, one per nesting level. Not multi-thread safe.
+    size_t _nSolveWorkspaceDepth; ///< number of _vSolveWorkspaces currently in use
+
+    int _nSolveAllThreads; ///< number of threads SolveAll uses to search the free joint discretization
+    std::vector<SolveAllWorker> _vSolveAllWorkers; ///< cloned environments for the extra SolveAll threads
+
     bool _bEmptyTransform6D; ///< if true, then the iksolver has been built with identity of the manipulator transform. Only valid for Transform6D IKs.
 
+    //@{
+    // solution cache, see the SetSolutionCache command. Not multi-thread safe.
+    size_t _nIkCacheMaxEntries; ///< 0 if the cache is disabled
+    dReal _fIkCacheTranslationResolution, _fIkCacheRotationResolution;
+    std::map<std::vector<int64_t>, CachedIkSolutions> _mapIkCache; ///< quantized goal -> raw solutions
+    std::list< std::vector<int64_t> > _listIkCacheLRU; ///< keys of _mapIkCache, most recently used first
+    std::vector<int64_t> _vIkCacheKey; ///< cache for the key of the current goal
+    std::vector<dReal> _vIkCacheValues; ///< cache for the values of the current goal
+    uint64_t _nIkCacheHits, _nIkCacheMisses, _nIkCacheEvictions;
+    //@}
+
 };
 
 #ifdef OPENRAVE_IKFAST_FLOAT32
@@ -20,18 +20,97 @@
 
 #include "plugindefs.h"
 
-#ifdef OPENRAVE_HAS_LAPACK
+namespace ikfastsolvers {
 
-#include <boost/numeric/ublas/vector.hpp>
-#include <boost/numeric/ublas/vector_proxy.hpp>
-#include <boost/numeric/ublas/matrix.hpp>
-#include <boost/numeric/ublas/triangular.hpp>
-#include <boost/numeric/ublas/lu.hpp>
-#include <boost/numeric/ublas/io.hpp>
+/// \brief solves (A + lambda*I)*y = b with a cholesky factorization, where A is a symmetric positive semi-definite NxN row major matrix
+///
+/// \return false if the damped matrix is close to singular
+template <typename T, int N>
+inline bool SolveDampedCholesky(const T* A, T lambda, const T* b, T* y)
+{
+    T L[N*N], z[N];
+    for(int i = 0; i < N; ++i) {
+        for(int j = 0; j <= i; ++j) {
+            T f = A[i*N+j];
+            if( i == j ) {
+                f += lambda;
+            }
+            for(int k = 0; k < j; ++k) {
+                f -= L[i*N+k]*L[j*N+k];
+            }
+            if( i == j ) {
+                if( !(f > 1e-9) ) {
+                    return false;
+                }
+                L[i*N+i] = sqrt(f);
+            }
+            else {
+                L[i*N+j] = f/L[j*N+j];
+            }
+        }
+    }
+    for(int i = 0; i < N; ++i) {
+        T f = b[i];
+        for(int k = 0; k < i; ++k) {
+            f -= L[i*N+k]*z[k];
+        }
+        z[i] = f/L[i*N+i];
+    }
+    for(int i = N-1; i >= 0; --i) {
+        T f = z[i];
+        for(int k = i+1; k < N; ++k) {
+            f -= L[k*N+i]*y[k];
+        }
+        y[i] = f/L[i*N+i];
+    }
+    return true;
+}
 
-namespace ikfastsolvers {
+/// \brief computes the damped least squares step qdelta = J^T*(J*J^T + lambda*I)^-1*error
+///
+/// \param J ikdof x armdof row major jacobian, ikdof is at most 6
+/// \return false if the damped matrix is close to singular
+template <typename T>
+inline bool ComputeDampedLeastSquaresStep(const T* J, int ikdof, int armdof, T lambda, const T* error, T* qdelta)
+{
+    T JJt[36], y[6];
+    for(int i = 0; i < ikdof; ++i) {
+        for(int j = 0; j <= i; ++j) {
+            T f = 0;
+            for(int k = 0; k < armdof; ++k) {
+                f += J[i*armdof+k]*J[j*armdof+k];
+            }
+            JJt[i*ikdof+j] = f;
+            JJt[j*ikdof+i] = f;
+        }
+    }
+    bool bSolved = false;
+    switch(ikdof) {
+    case 1: bSolved = SolveDampedCholesky<T,1>(JJt, lambda, error, y); break;
+    case 2: bSolved = SolveDampedCholesky<T,2>(JJt, lambda, error, y); break;
+    case 3: bSolved = SolveDampedCholesky<T,3>(JJt, lambda, error, y); break;
+    case 4: bSolved = SolveDampedCholesky<T,4>(JJt, lambda, error, y); break;
+    case 5: bSolved = SolveDampedCholesky<T,5>(JJt, lambda, error, y); break;
+    case 6: bSolved = SolveDampedCholesky<T,6>(JJt, lambda, error, y); break;
+    default: break;
+    }
+    if( !bSolved ) {
+        return false;
+    }
+    for(int k = 0; k < armdof; ++k) {
+        T f = 0;
+        for(int i = 0; i < ikdof; ++i) {
+            f += J[i*armdof+k]*y[i];
+        }
+        qdelta[k] = f;
+    }
+    return true;
+}
 
-/// \brief inverse jacobian solver. although uses RobotBase::Manipulator, should not hold a shared pointer of it
+/** \brief inverse jacobian solver. although uses RobotBase::Manipulator, should not hold a shared pointer of it
+
+    Every iteration is a damped least squares (Levenberg-Marquardt) step. The constraint space has at most 6 dimensions, so (J*J^T + lambda*I)*y = error is solved with a fixed size cholesky factorization and the step is J^T*y. The damping decreases after steps that reduce the error and increases after steps that do not, which are undone. The iterations also stop when the error decreases too slowly to converge. Nothing is allocated during the iterations.
+ */
 template <typename T>
 class JacobianInverseSolver
 {
@@ -52,6 +131,10 @@ public:
         _errorthresh2 = 1e-12;
         _lastiter = -1;
         _nMaxIterations = 100;
+        _fMinDamping = 1e-12;
+        _fMaxDamping = 1e2;
+        _fSlowDecreaseRatio = 0.98;
+        _nMaxSlowIterations = 3;
     }
 
     /// \brief initializes with the manipulator, but doesn't store it!
@@ -61,14 +144,7 @@ public:
     {
         RobotBasePtr probot = manip.GetRobot();
 
-        _J.resize(6,probot->GetActiveDOF());
-        _invJJt.resize(6,6);
-        _error.resize(6,1);
-
-        _J3d.resize(3,probot->GetActiveDOF());
-        _invJJt3d.resize(3,3);
-        _error3d.resize(3,1);
-
+        _J.resize(6*probot->GetActiveDOF());
         _viweights.resize(manip.GetArmIndices().size(),0);
         for(size_t i = 0; i < _viweights.size(); ++i) {
             int dof = manip.GetArmIndices().at(i);
@@ -78,6 +154,8 @@ public:
             }
             _viweights[i] = 1;
         }
+        _vjacobiantrans.resize(3*_viweights.size());
+        _vLinkPositions.resize(1);
     }
 
     void SetErrorThresh(T errorthresh)
@@ -113,389 +191,12 @@ public:
 //        if (! manip.GetIkSolver()->Supports(ikgoal.GetType())) {
 //            throw OPENRAVE_EXCEPTION_FORMAT(_("iksolver %s of manipulator '%s' does not support iktype 0x%x."),manip.GetIkSolver()%manip.GetName()%ikgoal.GetType(),ORE_InvalidArguments);
 //        }
-
-        RobotBasePtr probot = manip.GetRobot();
-        uint32_t checklimits = bIgnoreJointLimits ? OpenRAVE::KinBody::CLA_Nothing : OpenRAVE::KinBody::CLA_CheckLimitsSilent; // if not ignoring limits, silently clamp the values to their limits.
-        const int ikdof = ikgoal.GetDOF();
-        BOOST_ASSERT(6 >= ikdof && ikdof > 0);
-        _J.resize(ikdof,probot->GetActiveDOF());
-        _invJJt.resize(ikdof, ikdof);
-        _error.resize(ikdof,1);
-
-        _goalIkp = ikgoal;
-        //_vGoalQuat = tgoal.rot;
-        //_vGoalAxisAngle = axisAngleFromQuat(tgoal.rot);
-        //_vGoalPosition = tgoal.trans;
-        
-        KinBody::KinBodyStateSaver saver(probot, KinBody::Save_LinkTransformation);
-        Transform tbase = manip.GetBase()->GetTransform();
-        Transform trobot = probot->GetTransform();
-        probot->SetTransform(tbase.inverse()*trobot); // transform so that the manip's base is at the identity and matches tgoal
-
-        const IkParameterization ikpprev = manip.GetIkParameterization(ikgoal);
-        T totalerror21 = _ComputeConstraintError(ikpprev, _error, _nMaxIterations);
-        if( totalerror21 <= _errorthresh2 ) {
-            return -1;
-        }
-
-        const T lambda2 = 1e-12;         // normalization constant, changes the rate of convergence, but also improves convergence stability
-        using namespace boost::numeric::ublas;
-
-        T firsterror2 = totalerror21;
-        T besterror2 = totalerror21;
-        _lasterror2 = totalerror21;
-        //int armdof = manip.GetArmDOF();
-        std::vector<dReal>& vbest = _cachevbest; vbest = vsolution;
-        std::vector<dReal>& vnew = _cachevnew; vnew = vsolution;
-        bool bSuccess = false;
-        int iter = 0;
-        // setup a class so its destructor saves the last iter used in _lastiter
-        ValueSaver valuesaver(&iter, &_lastiter);
-        for(iter = 0; iter < _nMaxIterations; ++iter) {
-            const IkParameterization ikpmanip = manip.GetIkParameterization(ikgoal);
-            T totalerror2 = _ComputeConstraintError(ikpmanip, _error, _nMaxIterations-iter);
-            //dReal ratio = totalerror2/_lasterror2;
-            //RAVELOG_VERBOSE_FORMAT("%s:%s iter=%d, totalerror %.15e (%f)", probot->GetName()%manip.GetName()%iter%RaveSqrt(totalerror2)%RaveSqrt(totalerror2/_lasterror2));
-            if( totalerror2 < besterror2 ) {
-                besterror2 = totalerror2;
-                vbest = vnew;
-            }
-            if( totalerror2 <= _errorthresh2 ) {
-                bSuccess = true;
-                break;
-            }
-//            if( ratio > 0.98 ) {
-//                // probably won't get better...
-//                break;
-//            }
-
-            // 2.0 is an arbitrary number...
-            if( totalerror2 > 10.0*firsterror2 ) {// && fdistcur2 > 4.0*fdistprev2 ) {
-                // last adjustment was greater than total distance (jacobian was close to being singular)
-                RAVELOG_VERBOSE_FORMAT("last adjustment on iter %d was greater than total distance (jacobian was close to being singular?): %.15e > %.15e", iter%totalerror2%_lasterror2);//%fdistcur2%fdistprev2);
-                iter = -1;
-                break;
-            }
-            _lasterror2 = totalerror2;
-
-            // calculate jacobians
-            _CalculateJacobian(manip, ikpmanip);
-
-            // pseudo inverse of jacobian
-            _Jt = trans(_J);
-            _invJJt = prod(_J,_Jt);
-            for(int i = 0; i < ikdof; ++i) {
-                _invJJt(i,i) += lambda2;
-            }
-
-#ifdef OPENRAVE_DISPLAY_CONVERGENCESTATS
-            stringstream ss; ss << std::setprecision(std::numeric_limits<OpenRAVE::dReal>::digits10+2);
-            ss << std::endl << "J=array([" << std::endl;
-            for(int i = 0; i < armdof; ++i) {
-                ss << "[";
-                for(int j = 0; j < ikdof; ++j) {
-                    ss << _J(i,j) << ", ";
-                }
-                ss << "]," << std::endl;
-            }
-            ss << "]);" << std::endl;
-            ss << "error=array([";
-            for(int i = 0; i < ikdof; ++i) {
-                ss << _error(i,0) << ", ";
-            }
-            ss << "]);" << std::endl;
-#endif
-            try {
-                if( !_InvertMatrix(_invJJt,_invJJt) ) {
-                    RAVELOG_VERBOSE("failed to invert matrix\n");
-                    iter = -1;
-                    break;
-                }
-            }
-            catch(const std::exception& ex) {
-                RAVELOG_VERBOSE_FORMAT("got exception during constraining, perhaps matix is singular: %s", ex.what());
-                iter = -1;
-                break;
-            }
-            catch(...) {
-                RAVELOG_WARN("got unknown exception during constraining\n");
-                iter = -1;
-                break;
-            }
-            _invJ = prod(_Jt,_invJJt);
-            _qdelta = prod(_invJ,_error);
-
-#ifdef OPENRAVE_DISPLAY_CONVERGENCESTATS
-            ss << std::endl << "invJJt=array([" << std::endl;
-            for(int i = 0; i < armdof; ++i) {
-                ss << "[";
-                for(int j = 0; j < armdof; ++j) {
-                    ss << _invJJt(i,j) << ", ";
-                }
-                ss << "]," << std::endl;
-            }
-            ss << "]);" << std::endl;
-
-            ss << "qdelta=array([";
-            for(size_t i = 0; i < vnew.size(); ++i) {
-                ss << _qdelta(i,0) << ", ";
-            }
-            ss << "]);" << std::endl;
-            ss << "vprev=array([";
-            for(size_t i = 0; i < vnew.size(); ++i) {
-                ss << vnew[i] << ", ";
-            }
-            ss << "]);" << std::endl;
-
-            RAVELOG_VERBOSE(ss.str());
-#endif
-
-            dReal fmindeltascale = 1; // depending on
-            bool baddelta = false;
-            for(size_t i = 0; i < vnew.size(); ++i) {
-                if(!isfinite(_qdelta(i,0))) { // don't assert since it is frequent and could destroy the entire plan
-                    RAVELOG_WARN_FORMAT("inverse matrix produced a non-finite value: %e", _qdelta(i,0));
-                    baddelta = true;
-                    break;
-                }
-
-                dReal f = _qdelta(i,0)*_viweights.at(i);
-                _qdelta(i,0) = f;
-            }
-            if( baddelta ) {
-                break;
-            }
-
-            if( fmindeltascale < 1 ) {
-                for(size_t i = 0; i < vnew.size(); ++i) {
-                    vnew.at(i) += _qdelta(i,0)*fmindeltascale;
-                }
-            }
-            else {
-                for(size_t i = 0; i < vnew.size(); ++i) {
-                    vnew.at(i) += _qdelta(i,0);
-                }
-            }
-
-            probot->SetActiveDOFValues(vnew, checklimits);
-            if( checklimits == OpenRAVE::KinBody::CLA_CheckLimitsSilent ) {
-                probot->GetActiveDOFValues(vnew);
-            }
-        }
-
-        int retcode = 0;
-        if( bSuccess || besterror2 < firsterror2 ) {
-            // revert to real values
-            probot->SetActiveDOFValues(vbest, checklimits);
-            probot->GetActiveDOFValues(vsolution); // have to re-get the joint values since joint limits are involved
-            probot->SetTransform(trobot);
-            saver.Release(); // finished successfully, so use the new state
-            if( bSuccess || besterror2 <= 10*_errorthresh2 ) { // if close enough to error, just return as being close. user should take this in account when setting the error threshold
-                retcode = 1;
-            }
-            else {
-                retcode = 2;
-            }
-        }
-        else if( iter >= _nMaxIterations ) {
-            iter = -1;
-            RAVELOG_VERBOSE_FORMAT("constraint function exceeded %d iterations, first error^2 is %.15e, final error^2 is %.15e > %.15e", _nMaxIterations%firsterror2%_lasterror2%_errorthresh2);
-        }
-        return retcode;
+        return _ComputeSolution(ikgoal, manip, vsolution, bIgnoreJointLimits, false);
     }
 
     int ComputeSolutionTranslation(const IkParameterization& ikgoal, const RobotBase::Manipulator& manip, std::vector<dReal>& vsolution, bool bIgnoreJointLimits=false)
     {
-        // check if manip's iksolver suppports this ikgoal type
-//        if (! manip.GetIkSolver()->Supports(ikgoal.GetType())) {
-//            throw OPENRAVE_EXCEPTION_FORMAT(_("iksolver %s of manipulator '%s' do not support iktype 0x%x"),manip.GetIkSolver()%manip.GetName()%ikgoal.GetIkType(),ORE_InvalidArguments);
-//        }
-
-        _goalIkp = ikgoal;
-        
-        RobotBasePtr probot = manip.GetRobot();
-        uint32_t checklimits = bIgnoreJointLimits ? OpenRAVE::KinBody::CLA_Nothing : OpenRAVE::KinBody::CLA_CheckLimitsSilent; // if not ignoring limits, silently clamp the values to their limits.
-
-        KinBody::KinBodyStateSaver saver(probot, KinBody::Save_LinkTransformation);
-        Transform tbase = manip.GetBase()->GetTransform();
-        Transform trobot = probot->GetTransform();
-        probot->SetTransform(tbase.inverse()*trobot); // transform so that the manip's base is at the identity and matches tgoal
-
-        Transform tprev = manip.GetTransform();
-        T totalerror21 = _ComputeConstraintError(tprev, _error3d, _nMaxIterations, false);
-        if( totalerror21 <= _errorthresh2 ) {
-            return -1;
-        }
-
-        const T lambda2 = 1e-12;         // normalization constant, changes the rate of convergence, but also improves convergence stability
-        using namespace boost::numeric::ublas;
-
-        T firsterror2 = totalerror21;
-        T besterror2 = totalerror21;
-        _lasterror2 = totalerror21;
-        int armdof = manip.GetArmDOF();
-        std::vector<dReal>& vbest = _cachevbest; vbest = vsolution;
-        std::vector<dReal>& vnew = _cachevnew; vnew = vsolution;
-        bool bSuccess = false;
-        int iter = 0;
-        // setup a class so its destructor saves the last iter used in _lastiter
-        ValueSaver valuesaver(&iter, &_lastiter);
-        for(iter = 0; iter < _nMaxIterations; ++iter) {
-            Transform tmanip = manip.GetTransform();
-            T totalerror2 = _ComputeConstraintError(tmanip, _error3d, _nMaxIterations-iter, false);
-            //dReal ratio = totalerror2/_lasterror2;
-            //RAVELOG_VERBOSE_FORMAT("%s:%s iter=%d, totalerror %.15e (%f)", probot->GetName()%manip.GetName()%iter%RaveSqrt(totalerror2)%RaveSqrt(totalerror2/_lasterror2));
-            if( totalerror2 < besterror2 ) {
-                besterror2 = totalerror2;
-                vbest = vnew;
-            }
-            if( totalerror2 <= _errorthresh2 ) {
-                bSuccess = true;
-                break;
-            }
-//            if( ratio > 0.98 ) {
-//                // probably won't get better...
-//                break;
-//            }
-
-            // 2.0 is an arbitrary number...
-            if( totalerror2 > 10.0*firsterror2 ) {// && fdistcur2 > 4.0*fdistprev2 ) {
-                // last adjustment was greater than total distance (jacobian was close to being singular)
-                RAVELOG_VERBOSE_FORMAT("last adjustment on iter %d was greater than total distance (jacobian was close to being singular?): %.15e > %.15e", iter%totalerror2%_lasterror2);//%fdistcur2%fdistprev2);
-                iter = -1;
-                break;
-            }
-            _lasterror2 = totalerror2;
-
-            // compute jacobians, make sure to transform by the world frame
-            manip.CalculateJacobian(_vjacobian);
-            for(size_t j = 0; j < _viweights.size(); ++j) {
-                Vector v = Vector(_vjacobian[j],_vjacobian[armdof+j],_vjacobian[2*armdof+j]);
-                _J3d(0,j) = v[0]*_viweights[j];
-                _J3d(1,j) = v[1]*_viweights[j];
-                _J3d(2,j) = v[2]*_viweights[j];
-            }
-            // pseudo inverse of jacobian
-            _Jt3d = trans(_J3d);
-            _invJJt3d = prod(_J3d,_Jt3d);
-            for(int i = 0; i < 3; ++i) {
-                _invJJt3d(i,i) += lambda2;
-            }
-
-#ifdef OPENRAVE_DISPLAY_CONVERGENCESTATS
-            stringstream ss; ss << std::setprecision(std::numeric_limits<OpenRAVE::dReal>::digits10+2);
-            ss << std::endl << "J=array([" << std::endl;
-            for(int i = 0; i < 3; ++i) {
-                ss << "[";
-                for(int j = 0; j < 3; ++j) {
-                    ss << _J3d(i,j) << ", ";
-                }
-                ss << "]," << std::endl;
-            }
-            ss << "]);" << std::endl;
-            ss << "error=array([";
-            for(int i = 0; i < 3; ++i) {
-                ss << _error3d(i,0) << ", ";
-            }
-            ss << "]);" << std::endl;
-#endif
-            try {
-                if( !_InvertMatrix(_invJJt3d,_invJJt3d) ) {
-                    RAVELOG_VERBOSE("failed to invert matrix\n");
-                    iter = -1;
-                    break;
-                }
-            }
-            catch(const std::exception& ex) {
-                RAVELOG_VERBOSE_FORMAT("got exception during constraining, perhaps matix is singular: %s", ex.what());
-                iter = -1;
-                break;
-            }
-            catch(...) {
-                RAVELOG_WARN("got unknown exception during constraining\n");
-                iter = -1;
-                break;
-            }
-            _invJ3d = prod(_Jt3d,_invJJt3d);
-            _qdelta = prod(_invJ3d,_error3d);
-
-#ifdef OPENRAVE_DISPLAY_CONVERGENCESTATS
-            ss << std::endl << "invJJt=array([" << std::endl;
-            for(int i = 0; i < 3; ++i) {
-                ss << "[";
-                for(int j = 0; j < 3; ++j) {
-                    ss << _invJJt3d(i,j) << ", ";
-                }
-                ss << "]," << std::endl;
-            }
-            ss << "]);" << std::endl;
-
-            ss << "qdelta=array([";
-            for(size_t i = 0; i < vnew.size(); ++i) {
-                ss << _qdelta(i,0) << ", ";
-            }
-            ss << "]);" << std::endl;
-            ss << "vprev=array([";
-            for(size_t i = 0; i < vnew.size(); ++i) {
-                ss << vnew[i] << ", ";
-            }
-            ss << "]);" << std::endl;
-
-            RAVELOG_VERBOSE(ss.str());
-#endif
-
-            dReal fmindeltascale = 1; // depending on
-            bool baddelta = false;
-            for(size_t i = 0; i < vnew.size(); ++i) {
-                if(!isfinite(_qdelta(i,0))) { // don't assert since it is frequent and could destroy the entire plan
-                    RAVELOG_WARN_FORMAT("inverse matrix produced a non-finite value: %e", _qdelta(i,0));
-                    baddelta = true;
-                    break;
-                }
-
-                dReal f = _qdelta(i,0)*_viweights.at(i);
-                _qdelta(i,0) = f;
-            }
-            if( baddelta ) {
-                break;
-            }
-
-            if( fmindeltascale < 1 ) {
-                for(size_t i = 0; i < vnew.size(); ++i) {
-                    vnew.at(i) += _qdelta(i,0)*fmindeltascale;
-                }
-            }
-            else {
-                for(size_t i = 0; i < vnew.size(); ++i) {
-                    vnew.at(i) += _qdelta(i,0);
-                }
-            }
-
-            probot->SetActiveDOFValues(vnew, checklimits);
-            if( checklimits == OpenRAVE::KinBody::CLA_CheckLimitsSilent ) {
-                probot->GetActiveDOFValues(vnew);
-            }
-        }
-
-        int retcode = 0;
-        if( bSuccess || besterror2 < firsterror2 ) {
-            // revert to real values
-            probot->SetActiveDOFValues(vbest, checklimits);
-            probot->GetActiveDOFValues(vsolution); // have to re-get the joint values since joint limits are involved
-            probot->SetTransform(trobot);
-            saver.Release(); // finished successfully, so use the new state
-            if( bSuccess || besterror2 < 10*_errorthresh2 ) { // if close enough to error, just return as being close. user should take this in account when setting the error threshold
-                retcode = 1;
-            }
-            else {
-                retcode = 2;
-            }
-        }
-        else if( iter >= _nMaxIterations ) {
-            iter = -1;
-            RAVELOG_VERBOSE_FORMAT("constraint function exceeded %d iterations, first error^2 is %.15e, final error^2 is %.15e > %.15e", _nMaxIterations%firsterror2%_lasterror2%_errorthresh2);
-        }
-        return retcode;
+        return _ComputeSolution(ikgoal, manip, vsolution, bIgnoreJointLimits, true);
     }
 
     /// \brief computes the jacobian inverse solution.
@@ -510,12 +211,12 @@ public:
         return ComputeSolution(IkParameterization(tgoal, IKP_Transform6D), manip, vsolution, bIgnoreJointLimits);
     }
     
-    int ComputeSolutionTranslation(const Transform& tgoal, const RobotBase::Manipulator& manip, std::vector<dReal>& vsolution)
+    int ComputeSolutionTranslation(const Transform& tgoal, const RobotBase::Manipulator& manip, std::vector<dReal>& vsolution, bool bIgnoreJointLimits=false)
     {
-        return ComputeSolutionTranslation(IkParameterization(tgoal, IKP_Translation3D), manip, vsolution);
+        return ComputeSolutionTranslation(IkParameterization(tgoal, IKP_Translation3D), manip, vsolution, bIgnoreJointLimits);
     }
 
-    virtual T _ComputeConstraintError(const IkParameterization& ikpcur, boost::numeric::ublas::matrix<T>& error, int nMaxIterations, bool bAddRotation=true)
+    virtual T _ComputeConstraintError(const IkParameterization& ikpcur, T* error, int nMaxIterations, bool bAddRotation=true)
     {
         T totalerror2=0;
         int transoffset = 0;
@@ -527,15 +228,15 @@ public:
                 if( bAddRotation ) {
                     const Vector axisangleerror = axisAngleFromQuat(quatMultiply(tgoal.rot, quatInverse(tcur.rot)));
                     for(int i = 0; i < 3; ++i) {
-                        error(i,0) = axisangleerror[i];
-                        totalerror2 += error(i,0)*error(i,0);
+                        error[i] = axisangleerror[i];
+                        totalerror2 += error[i]*error[i];
                     }
                     transoffset += 3;
                 }
 
                 for(int i = 0; i < 3; ++i) {
-                    error(i+transoffset,0) = (tgoal.trans[i]-tcur.trans[i]);
-                    totalerror2 += error(i+transoffset,0)*error(i+transoffset,0);
+                    error[i+transoffset] = (tgoal.trans[i]-tcur.trans[i]);
+                    totalerror2 += error[i+transoffset]*error[i+transoffset];
                 }
         
                 dReal fallowableerror2 = 0.03; // arbitrary... since solutions are close, is this step necessary?
@@ -548,8 +249,8 @@ public:
                     }
                     T fiscale = 1/fscale;
                     RAVELOG_VERBOSE_FORMAT("fiscale=%f", fiscale);
-                    for(int i = 0; i < (int)error.size1(); ++i) {
-                        error(i,0) *= fiscale;
+                    for(int i = 0; i < transoffset+3; ++i) {
+                        error[i] *= fiscale;
                     }
                 }
                 break;
@@ -559,14 +260,14 @@ public:
                 const std::pair<Vector,dReal> cur = ikpcur.GetTranslationZAxisAngle4D();
                 const std::pair<Vector,dReal> goal = _goalIkp.GetTranslationZAxisAngle4D();
                 if( bAddRotation ) {
-                    error(0,0) = goal.second - cur.second;
-                    totalerror2 += error(0,0)*error(0,0);
+                    error[0] = goal.second - cur.second;
+                    totalerror2 += error[0]*error[0];
                     transoffset = 1;
                 }
 
                 for(int i = 0; i < 3; ++i) {
-                    error(i+transoffset,0) = (goal.first[i]-cur.first[i]);
-                    totalerror2 += error(i+transoffset,0)*error(i+transoffset,0);
+                    error[i+transoffset] = (goal.first[i]-cur.first[i]);
+                    totalerror2 += error[i+transoffset]*error[i+transoffset];
                 }
                 break;
             }
@@ -586,18 +287,11 @@ public:
             {
                 manip.CalculateAngularVelocityJacobian(_vjacobian); // doesn't work well...
                 for(size_t j = 0; j < _viweights.size(); ++j) {
-                    Vector v = Vector(_vjacobian[j],_vjacobian[armdof+j],_vjacobian[2*armdof+j]);
-                    _J(0,j) = v[0]*_viweights[j];
-                    _J(1,j) = v[1]*_viweights[j];
-                    _J(2,j) = v[2]*_viweights[j];
-                }
-                manip.CalculateJacobian(_vjacobian);
-                for(size_t j = 0; j < _viweights.size(); ++j) {
-                    Vector v = Vector(_vjacobian[j],_vjacobian[armdof+j],_vjacobian[2*armdof+j]);
-                    _J(0+3,j) = v[0]*_viweights[j];
-                    _J(1+3,j) = v[1]*_viweights[j];
-                    _J(2+3,j) = v[2]*_viweights[j];
+                    _J[j] = _vjacobian[j]*_viweights[j];
+                    _J[armdof+j] = _vjacobian[armdof+j]*_viweights[j];
+                    _J[2*armdof+j] = _vjacobian[2*armdof+j]*_viweights[j];
                 }
+                _CalculateTranslationJacobian(manip, 3);
                 break;
             }
         case IKP_TranslationZAxisAngle4D:
@@ -625,7 +319,7 @@ public:
                     if (1.0 - rzzSq > 1.0e-9) { // non-singular
                         const double dfdh = -1.0 / sqrt(1.0 - rzzSq);
                         const double dhdq = jointAxis.cross(manipZDir)[2];
-                        _J(0,j) = dfdh * dhdq * _viweights[j];
+                        _J[j] = dfdh * dhdq * _viweights[j];
                     }
                     else { // singular, base z axis and manip z axis are almost parallel
                         // positive value means error increases if joint is rotated positively
@@ -633,18 +327,12 @@ public:
                         const double jacobianSign = jacobianZDot > 0 ? 1 : -1;
 
                         const double jacobianZAngle = (jointAxis.cross(manipZDir)).lengthsqr2();
-                        _J(0,j) = jacobianSign * jacobianZAngle *_viweights[j];
+                        _J[j] = jacobianSign * jacobianZAngle *_viweights[j];
                     }
                 }
             
                 // position part
-                manip.CalculateJacobian(_vjacobian);
-                for(size_t j = 0; j < _viweights.size(); ++j) {
-                    Vector v = Vector(_vjacobian[j],_vjacobian[armdof+j],_vjacobian[2*armdof+j]);
-                    _J(0+1,j) = v[0]*_viweights[j];
-                    _J(1+1,j) = v[1]*_viweights[j];
-                    _J(2+1,j) = v[2]*_viweights[j];
-                }
+                _CalculateTranslationJacobian(manip, 1);
                 break;
             }
         default:
@@ -652,36 +340,178 @@ public:
         };
     }
 
-    // Matrix inversion routine. Uses lu_factorize and lu_substitute in uBLAS to invert a matrix */
-    static bool _InvertMatrix(const boost::numeric::ublas::matrix<T>& input, boost::numeric::ublas::matrix<T>& inverse) {
-        using namespace boost::numeric::ublas;
-        matrix<T> A(input);         // create a working copy of the input
-        permutation_matrix<std::size_t> pm(A.size1());         // create a permutation matrix for the LU-factorization
-        int res = lu_factorize(A,pm);         // perform LU-factorization
-        if( res != 0 )
-            return false;
-
-        inverse.assign(identity_matrix<T>(A.size1()));         // create identity matrix of "inverse"
-        for(size_t i = 0; i < A.size1(); ++i) {
-            if( RaveFabs(A(i,i)) < 1e-9 ) {
-                RAVELOG_VERBOSE_FORMAT("most likely matrix is singular %.15e, so fail!", RaveFabs(A(i,i)));
-                return false;
+    /// \brief fills the 3 rows of _J starting at rowoffset with the translation jacobian of the manipulator, computed with the batch jacobian of the robot straight into a buffer
+    void _CalculateTranslationJacobian(const RobotBase::Manipulator& manip, int rowoffset)
+    {
+        const int armdof = manip.GetArmDOF();
+        _vLinkPositions.resize(1);
+        _vLinkPositions[0].first = manip.GetEndEffector()->GetIndex();
+        _vLinkPositions[0].second = manip.GetTransform().trans;
+        _vjacobiantrans.resize(3*armdof);
+        manip.GetRobot()->ComputeJacobianTranslations(_vLinkPositions, &_vjacobiantrans[0], manip.GetArmIndices());
+        for(int i = 0; i < 3; ++i) {
+            for(size_t j = 0; j < _viweights.size(); ++j) {
+                _J[(rowoffset+i)*armdof+j] = _vjacobiantrans[i*armdof+j]*_viweights[j];
             }
         }
-        lu_substitute(A, pm, inverse);         // backsubstitute to get the inverse
+    }
+
+    /// \brief computes the damped least squares step _qdelta = W*J^T*(J*J^T + lambda*I)^-1*error for the first ikdof rows of _J
+    ///
+    /// \return false if the damped matrix is close to singular
+    bool _ComputeDampedStep(int ikdof, int armdof, T lambda)
+    {
+        if( !ComputeDampedLeastSquaresStep(&_J[0], ikdof, armdof, lambda, _error, &_qdelta[0]) ) {
+            return false;
+        }
+        for(int k = 0; k < armdof; ++k) {
+            _qdelta[k] *= _viweights[k];
+        }
         return true;
     }
 
-    /// \brief computes squared distance
-//    void _ComputeConfigurationDistance2(const std::vector<dReal>& v0, const std::vector<dReal>& v1)
-//    {
-//        dReal dist2 = 0;
-//        for(size_t i = 0; i < v0.size(); ++i) {
-//            dReal f = (v0[i] - v1[i])*_viweights[i];
-//            dist2 += f*f;
-//        }
-//        return dist2;
-//    }
+    /// \brief the iterations of ComputeSolution and ComputeSolutionTranslation
+    ///
+    /// \param bTranslationOnly if true, only the translation of the goal is used
+    int _ComputeSolution(const IkParameterization& ikgoal, const RobotBase::Manipulator& manip, std::vector<dReal>& vsolution, bool bIgnoreJointLimits, bool bTranslationOnly)
+    {
+        RobotBasePtr probot = manip.GetRobot();
+        uint32_t checklimits = bIgnoreJointLimits ? OpenRAVE::KinBody::CLA_Nothing : OpenRAVE::KinBody::CLA_CheckLimitsSilent; // if not ignoring limits, silently clamp the values to their limits.
+        const int ikdof = bTranslationOnly ? 3 : ikgoal.GetDOF();
+        BOOST_ASSERT(6 >= ikdof && ikdof > 0);
+        const int armdof = _viweights.size();
+        BOOST_ASSERT((int)vsolution.size() == armdof);
+        _J.resize(6*armdof);
+        _qdelta.resize(armdof);
+
+        _goalIkp = ikgoal;
+
+        KinBody::KinBodyStateSaver saver(probot, KinBody::Save_LinkTransformation);
+        Transform tbase = manip.GetBase()->GetTransform();
+        Transform trobot = probot->GetTransform();
+        probot->SetTransform(tbase.inverse()*trobot); // transform so that the manip's base is at the identity and matches tgoal
+
+        const IkParameterization ikpprev = bTranslationOnly ? IkParameterization(manip.GetTransform()) : manip.GetIkParameterization(ikgoal);
+        T totalerror21 = _ComputeConstraintError(ikpprev, _error, _nMaxIterations, !bTranslationOnly);
+        if( totalerror21 <= _errorthresh2 ) {
+            return -1;
+        }
+
+        T firsterror2 = totalerror21;
+        T besterror2 = totalerror21;
+        _lasterror2 = totalerror21;
+        std::vector<dReal>& vbest = _cachevbest; vbest = vsolution;
+        std::vector<dReal>& vnew = _cachevnew; vnew = vsolution;
+        bool bSuccess = false;
+        bool bReverted = false; // true if vnew was just reset to vbest after a step that did not decrease the error
+        int numslowiterations = 0;
+        T lambda = _fMinDamping; // normalization constant, changes the rate of convergence, but also improves convergence stability
+        int iter = 0;
+        // setup a class so its destructor saves the last iter used in _lastiter
+        ValueSaver valuesaver(&iter, &_lastiter);
+        for(iter = 0; iter < _nMaxIterations; ++iter) {
+            const IkParameterization ikpmanip = bTranslationOnly ? IkParameterization(manip.GetTransform()) : manip.GetIkParameterization(ikgoal);
+            T totalerror2 = _ComputeConstraintError(ikpmanip, _error, _nMaxIterations-iter, !bTranslationOnly);
+            if( totalerror2 <= _errorthresh2 ) {
+                besterror2 = totalerror2;
+                vbest = vnew;
+                bSuccess = true;
+                break;
+            }
+
+            if( iter > 0 && !bReverted ) {
+                if( totalerror2 >= _lasterror2 ) {
+                    // the step did not decrease the error, so undo it and take a shorter step
+                    lambda *= 10;
+                    if( lambda > _fMaxDamping ) {
+                        RAVELOG_VERBOSE_FORMAT("error does not decrease on iter %d even with damping %e: %.15e >= %.15e", iter%_fMaxDamping%totalerror2%_lasterror2);
+                        break;
+                    }
+                    vnew = vbest;
+                    probot->SetActiveDOFValues(vnew, checklimits);
+                    bReverted = true;
+                    continue;
+                }
+                lambda = std::max(lambda*T(0.1), _fMinDamping);
+                if( totalerror2 > _fSlowDecreaseRatio*_lasterror2 ) {
+                    if( ++numslowiterations >= _nMaxSlowIterations ) {
+                        RAVELOG_VERBOSE_FORMAT("error decreases too slowly on iter %d: %.15e, %.15e", iter%totalerror2%_lasterror2);
+                        break;
+                    }
+                }
+                else {
+                    numslowiterations = 0;
+                }
+            }
+            bReverted = false;
+            if( totalerror2 < besterror2 ) {
+                besterror2 = totalerror2;
+                vbest = vnew;
+            }
+            _lasterror2 = totalerror2;
+
+            // calculate jacobians
+            if( bTranslationOnly ) {
+                _CalculateTranslationJacobian(manip, 0);
+            }
+            else {
+                _CalculateJacobian(manip, ikpmanip);
+            }
+
+            while( !_ComputeDampedStep(ikdof, armdof, lambda) ) {
+                lambda *= 10;
+                if( lambda > _fMaxDamping ) {
+                    break;
+                }
+            }
+            if( lambda > _fMaxDamping ) {
+                RAVELOG_VERBOSE("failed to solve the damped jacobian system, jacobian is most likely singular\n");
+                iter = -1;
+                break;
+            }
+
+            bool baddelta = false;
+            for(int i = 0; i < armdof; ++i) {
+                if(!isfinite(_qdelta[i])) { // don't assert since it is frequent and could destroy the entire plan
+                    RAVELOG_WARN_FORMAT("inverse matrix produced a non-finite value: %e", _qdelta[i]);
+                    baddelta = true;
+                    break;
+                }
+            }
+            if( baddelta ) {
+                break;
+            }
+
+            for(int i = 0; i < armdof; ++i) {
+                vnew[i] += _qdelta[i];
+            }
+
+            probot->SetActiveDOFValues(vnew, checklimits);
+            if( checklimits == OpenRAVE::KinBody::CLA_CheckLimitsSilent ) {
+                probot->GetActiveDOFValues(vnew);
+            }
+        }
+
+        int retcode = 0;
+        if( bSuccess || besterror2 < firsterror2 ) {
+            // revert to real values
+            probot->SetActiveDOFValues(vbest, checklimits);
+            probot->GetActiveDOFValues(vsolution); // have to re-get the joint values since joint limits are involved
+            probot->SetTransform(trobot);
+            saver.Release(); // finished successfully, so use the new state
+            if( bSuccess || besterror2 <= 10*_errorthresh2 ) { // if close enough to error, just return as being close. user should take this in account when setting the error threshold
+                retcode = 1;
+            }
+            else {
+                retcode = 2;
+            }
+        }
+        else if( iter >= _nMaxIterations ) {
+            iter = -1;
+            RAVELOG_VERBOSE_FORMAT("constraint function exceeded %d iterations, first error^2 is %.15e, final error^2 is %.15e > %.15e", _nMaxIterations%firsterror2%_lasterror2%_errorthresh2);
+        }
+        return retcode;
+    }
 
     // statistics about last run
     int _lastiter;
@@ -689,14 +519,18 @@ public:
     int _nMaxIterations;
 
 protected:
-    //Vector _vGoalQuat, _vGoalAxisAngle, _vGoalPosition;
     IkParameterization _goalIkp;
     std::vector<dReal> _viweights, _vcachevalues;
     T _errorthresh2;
+    T _fMinDamping, _fMaxDamping; ///< range of the damping of the least squares steps
+    T _fSlowDecreaseRatio; ///< an iteration is slow if the error does not go below this ratio of the previous error
+    int _nMaxSlowIterations; ///< number of consecutive slow iterations after which the solver stops
     std::vector<dReal> _vjacobian;
-    boost::numeric::ublas::matrix<T> _J, _Jt, _invJJt, _invJ, _error, _qdelta;
-
-    boost::numeric::ublas::matrix<T> _J3d, _Jt3d, _invJJt3d, _invJ3d, _error3d; // for translation
+    std::vector<T> _vjacobiantrans; ///< translation jacobian from the batch jacobian of the robot
+    std::vector< std::pair<int, Vector> > _vLinkPositions; ///< the end effector position for the batch jacobian
+    std::vector<T> _J; ///< at most 6 x armdof row major weighted jacobian
+    std::vector<T> _qdelta; ///< step of the arm dof values
+    T _error[6]; ///< constraint error, at most 6 values
 
     std::vector<dReal> _cachevnew, _cachevbest; ///< cache
     dReal _fTighterCosAngleThresh; ///< if _pdirthresh is used, then this is a smaller angle than the one used in _pdirthresh->fCosAngleThresh
@@ -705,5 +539,3 @@ protected:
 } // end namespace ikfastsolvers
 
 #endif
-
-#endif
@@ -0,0 +1,808 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2026 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "plugindefs.h"
+
+#include <boost/bind/bind.hpp>
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "jacobianinverse.h"
+
+using namespace boost::placeholders;
+
+/** \brief numerical ik for manipulators that do not have an ikfast solver.
+
+    On Init the kinematic chain from the manipulator base to the end effector is copied into a list of joint transforms, so forward kinematics and jacobians are computed without touching the robot. This allows several threads to run damped least squares descents from different seeds at the same time. The first seed is the initial configuration given to Solve, the others are sampled uniformly inside the joint limits. The converged configurations that are far enough from each other are then checked with the filters and collisions on the calling thread.
+ */
+class NumericalIkSolver : public IkSolverBase
+{
+    /// \brief one moving joint of the chain, the child frame is parent * tleft * joint(fsign*(value+foffset)) * tright
+    struct ChainJoint
+    {
+        Transform tleft, tright;
+        Vector vaxis;
+        dReal fsign; ///< -1 if the chain goes from the child link to the parent link of the joint
+        dReal foffset; ///< wrap offset of the joint
+        int armindex; ///< index into the manipulator arm dof values
+        bool bRevolute;
+    };
+
+    /// \brief scratch buffers of one search thread
+    struct SearchWorkspace
+    {
+        std::vector<dReal> vq, vqnew, vqdelta, vJ;
+        std::vector<Vector> vjointpos, vjointaxis, vjointposnew, vjointaxisnew;
+    };
+
+    /// \brief a converged configuration and the restart it came from
+    struct Candidate
+    {
+        int irestart;
+        std::vector<dReal> vsolution;
+    };
+
+public:
+    NumericalIkSolver(EnvironmentBasePtr penv) : IkSolverBase(penv)
+    {
+        __description = "Numerical inverse kinematics for serial chains of revolute and prismatic joints. Runs damped least squares from the initial configuration and from random configurations inside the joint limits, optionally on several threads, and returns the distinct solutions that pass the filters. Supports Transform6D, Rotation3D, Translation3D, Direction3D and TranslationDirection5D.";
+        RegisterCommand("SetNumThreads",boost::bind(&NumericalIkSolver::_SetNumThreadsCommand,this,_1,_2),
+                        "format: int\n\nnumber of threads running random restarts. The calling thread is one of them. Default is 1.");
+        RegisterCommand("SetMaxRestarts",boost::bind(&NumericalIkSolver::_SetMaxRestartsCommand,this,_1,_2),
+                        "format: int\n\nmaximum number of seeds tried by one Solve or SolveAll call. Default is 100.");
+        RegisterCommand("SetMaxSolutions",boost::bind(&NumericalIkSolver::_SetMaxSolutionsCommand,this,_1,_2),
+                        "format: int\n\nSolveAll stops after this many distinct solutions pass the filters. Default is 8.");
+        RegisterCommand("SetMaxIterations",boost::bind(&NumericalIkSolver::_SetMaxIterationsCommand,this,_1,_2),
+                        "format: int\n\nmaximum number of damped least squares iterations from one seed. Default is 100.");
+        RegisterCommand("SetErrorThresh",boost::bind(&NumericalIkSolver::_SetErrorThreshCommand,this,_1,_2),
+                        "format: float\n\nworkspace error (meters and radians) below which a configuration is a solution. Default is 1e-6.");
+        RegisterCommand("SetDistinctThresh",boost::bind(&NumericalIkSolver::_SetDistinctThreshCommand,this,_1,_2),
+                        "format: float\n\ntwo solutions are distinct if one of their joint values differs by more than this. Default is 0.01.");
+        RegisterCommand("SetSeed",boost::bind(&NumericalIkSolver::_SetSeedCommand,this,_1,_2),
+                        "format: int\n\nseed of the random restarts. Restart i always starts from the same configuration for the same seed.");
+        _nNumThreads = 1;
+        _nMaxRestarts = 100;
+        _nMaxSolutions = 8;
+        _nMaxIterations = 100;
+        _fErrorThresh = 1e-6;
+        _fDistinctThresh = 0.01;
+        _nSeed = 0;
+        _fMaxStep = 0.5;
+    }
+    virtual ~NumericalIkSolver() {
+    }
+
+    inline boost::shared_ptr<NumericalIkSolver> shared_solver() {
+        return boost::static_pointer_cast<NumericalIkSolver>(shared_from_this());
+    }
+    inline boost::weak_ptr<NumericalIkSolver> weak_solver() {
+        return shared_solver();
+    }
+
+    virtual bool Init(RobotBase::ManipulatorConstPtr pmanip)
+    {
+        RobotBasePtr probot = pmanip->GetRobot();
+        bool bfound = false;
+        _pmanip.reset();
+        _manipname.clear();
+        _cblimits.reset();
+        _vchain.resize(0);
+        FOREACHC(itmanip,probot->GetManipulators()) {
+            if( *itmanip == pmanip ) {
+                _pmanip = *itmanip;
+                _manipname = (*itmanip)->GetName();
+                bfound = true;
+            }
+        }
+        if( !bfound ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("manipulator '%s' not found in robot '%s'"), pmanip->GetName()%probot->GetName(), ORE_InvalidArguments);
+        }
+
+        const std::vector<int>& varmindices = pmanip->GetArmIndices();
+        std::vector<KinBody::JointPtr> vjoints;
+        std::vector<KinBody::LinkPtr> vlinks;
+        if( !probot->GetChain(pmanip->GetBase()->GetIndex(), pmanip->GetEndEffector()->GetIndex(), vjoints) || !probot->GetChain(pmanip->GetBase()->GetIndex(), pmanip->GetEndEffector()->GetIndex(), vlinks) ) {
+            RAVELOG_WARN_FORMAT("env=%d, manip %s:%s has no chain from the base to the end effector", GetEnv()->GetId()%probot->GetName()%_manipname);
+            return false;
+        }
+        Transform tstatic; // accumulated transforms of static joints since the last moving joint
+        for(size_t ijoint = 0; ijoint < vjoints.size(); ++ijoint) {
+            const KinBody::Joint& joint = *vjoints[ijoint];
+            const bool bForward = joint.GetHierarchyParentLink() == vlinks.at(ijoint);
+            const Transform tleft = bForward ? joint.GetInternalHierarchyLeftTransform() : joint.GetInternalHierarchyRightTransform().inverse();
+            const Transform tright = bForward ? joint.GetInternalHierarchyRightTransform() : joint.GetInternalHierarchyLeftTransform().inverse();
+            if( joint.IsStatic() ) {
+                tstatic = tstatic * tleft * tright;
+                continue;
+            }
+            if( joint.GetDOF() != 1 || joint.IsMimic() || joint.GetDOFIndex() < 0 || !(joint.IsRevolute(0) || joint.IsPrismatic(0)) ) {
+                RAVELOG_WARN_FORMAT("env=%d, joint %s of manip %s:%s is not a single dof revolute or prismatic joint", GetEnv()->GetId()%joint.GetName()%probot->GetName()%_manipname);
+                return false;
+            }
+            std::vector<int>::const_iterator itarmindex = find(varmindices.begin(), varmindices.end(), joint.GetDOFIndex());
+            if( itarmindex == varmindices.end() ) {
+                RAVELOG_WARN_FORMAT("env=%d, joint %s is in the chain of manip %s:%s, but not in its arm indices", GetEnv()->GetId()%joint.GetName()%probot->GetName()%_manipname);
+                return false;
+            }
+            ChainJoint chainjoint;
+            chainjoint.tleft = tstatic * tleft;
+            chainjoint.tright = tright;
+            chainjoint.vaxis = joint.GetInternalHierarchyAxis(0);
+            chainjoint.fsign = bForward ? 1 : -1;
+            chainjoint.foffset = joint.GetWrapOffset(0);
+            chainjoint.armindex = itarmindex - varmindices.begin();
+            chainjoint.bRevolute = joint.IsRevolute(0);
+            _vchain.push_back(chainjoint);
+            tstatic = Transform();
+        }
+        _tlocaltool = tstatic * pmanip->GetLocalToolTransform();
+        _vlocaldirection = pmanip->GetLocalToolDirection();
+        if( _vchain.size() == 0 || (int)_vchain.size() != pmanip->GetArmDOF() ) {
+            RAVELOG_WARN_FORMAT("env=%d, only %d of the %d arm joints of manip %s:%s are in the chain to the end effector", GetEnv()->GetId()%_vchain.size()%pmanip->GetArmDOF()%probot->GetName()%_manipname);
+            _vchain.resize(0);
+            return false;
+        }
+
+        _cblimits = probot->RegisterChangeCallback(KinBody::Prop_JointLimits,boost::bind(&NumericalIkSolver::SetJointLimits,boost::bind(&utils::sptr_from<NumericalIkSolver>, weak_solver())));
+        SetJointLimits();
+
+        // the chain has to reproduce the manipulator transform of the current configuration
+        std::vector<dReal> vcurvalues;
+        probot->GetDOFValues(vcurvalues, varmindices);
+        Transform tchain;
+        _ComputeForwardKinematics(&vcurvalues[0], tchain, NULL, NULL);
+        const Transform tmanip = pmanip->GetBase()->GetTransform().inverse() * pmanip->GetTransform();
+        const dReal frotdist2 = min((tchain.rot-tmanip.rot).lengthsqr4(), (tchain.rot+tmanip.rot).lengthsqr4());
+        if( (tchain.trans-tmanip.trans).lengthsqr3() > 1e-10 || frotdist2 > 1e-10 ) {
+            RAVELOG_WARN_FORMAT("env=%d, kinematic chain of manip %s:%s does not match its transform", GetEnv()->GetId()%probot->GetName()%_manipname);
+            _vchain.resize(0);
+            _cblimits.reset();
+            return false;
+        }
+        return true;
+    }
+
+    virtual void SetJointLimits()
+    {
+        RobotBase::ManipulatorPtr pmanip = _pmanip.lock();
+        if( !pmanip ) {
+            RAVELOG_WARN_FORMAT("env=%d iksolver points to removed manip '%s'", GetEnv()->GetId()%_manipname);
+            return;
+        }
+        RobotBasePtr probot = pmanip->GetRobot();
+        probot->GetDOFLimits(_qlower, _qupper, pmanip->GetArmIndices());
+        _vcircular.resize(_qlower.size());
+        for(size_t i = 0; i < _vcircular.size(); ++i) {
+            const int dofindex = pmanip->GetArmIndices()[i];
+            KinBody::JointPtr pjoint = probot->GetJointFromDOFIndex(dofindex);
+            _vcircular[i] = pjoint->IsCircular(dofindex-pjoint->GetDOFIndex());
+        }
+    }
+
+    virtual bool Supports(IkParameterizationType iktype) const
+    {
+        switch(iktype) {
+        case IKP_Transform6D:
+        case IKP_Rotation3D:
+        case IKP_Translation3D:
+        case IKP_Direction3D:
+        case IKP_TranslationDirection5D:
+            return _vchain.size() > 0 && (int)_vchain.size() >= IkParameterization::GetDOF(iktype);
+        default:
+            return false;
+        }
+    }
+
+    virtual bool Solve(const IkParameterization& param, const std::vector<dReal>& q0, int filteroptions, boost::shared_ptr< std::vector<dReal> > result)
+    {
+        std::vector<dReal> q0local = q0; // copy in case result points to q0
+        if( !!result ) {
+            result->resize(0);
+        }
+        IkReturn ikreturn(IKRA_Success);
+        IkReturnPtr pikreturn(&ikreturn,utils::null_deleter());
+        if( !Solve(param,q0local,filteroptions,pikreturn) ) {
+            return false;
+        }
+        if( !!result ) {
+            *result = ikreturn._vsolution;
+        }
+        return true;
+    }
+
+    virtual bool Solve(const IkParameterization& param, const std::vector<dReal>& q0, int filteroptions, IkReturnPtr ikreturn)
+    {
+        std::vector<IkReturnPtr> vikreturns;
+        const IkReturnAction retaction = _Solve(param, q0, filteroptions, 1, vikreturns);
+        if( !!ikreturn ) {
+            if( vikreturns.size() > 0 ) {
+                *ikreturn = *vikreturns[0];
+            }
+            else {
+                ikreturn->Clear();
+                ikreturn->_action = retaction;
+            }
+        }
+        return vikreturns.size() > 0;
+    }
+
+    virtual bool SolveAll(const IkParameterization& param, int filteroptions, std::vector< std::vector<dReal> >& qSolutions)
+    {
+        std::vector<IkReturnPtr> vikreturns;
+        qSolutions.resize(0);
+        if( !SolveAll(param,filteroptions,vikreturns) ) {
+            return false;
+        }
+        qSolutions.resize(vikreturns.size());
+        for(size_t i = 0; i < vikreturns.size(); ++i) {
+            qSolutions[i] = vikreturns[i]->_vsolution;
+        }
+        return qSolutions.size()>0;
+    }
+
+    virtual bool SolveAll(const IkParameterization& param, int filteroptions, std::vector<IkReturnPtr>& vikreturns)
+    {
+        std::vector<dReal> q0;
+        RobotBase::ManipulatorPtr pmanip(_pmanip);
+        pmanip->GetRobot()->GetDOFValues(q0, pmanip->GetArmIndices());
+        _Solve(param, q0, filteroptions, _nMaxSolutions, vikreturns);
+        return vikreturns.size() > 0;
+    }
+
+    /// there are no free parameters, so vFreeParameters is ignored
+    virtual bool Solve(const IkParameterization& param, const std::vector<dReal>& q0, const std::vector<dReal>& vFreeParameters, int filteroptions, boost::shared_ptr< std::vector<dReal> > result)
+    {
+        return Solve(param, q0, filteroptions, result);
+    }
+
+    virtual bool Solve(const IkParameterization& param, const std::vector<dReal>& q0, const std::vector<dReal>& vFreeParameters, int filteroptions, IkReturnPtr ikreturn)
+    {
+        return Solve(param, q0, filteroptions, ikreturn);
+    }
+
+    virtual bool SolveAll(const IkParameterization& param, const std::vector<dReal>& vFreeParameters, int filteroptions, std::vector< std::vector<dReal> >& qSolutions)
+    {
+        return SolveAll(param, filteroptions, qSolutions);
+    }
+
+    virtual bool SolveAll(const IkParameterization& param, const std::vector<dReal>& vFreeParameters, int filteroptions, std::vector<IkReturnPtr>& vikreturns)
+    {
+        return SolveAll(param, filteroptions, vikreturns);
+    }
+
+    virtual IkReturnAction CallFilters(const IkParameterization& param, IkReturnPtr ikreturn, int minpriority, int maxpriority)
+    {
+        RobotBase::ManipulatorPtr pmanip = _pmanip.lock();
+        if( !pmanip ) {
+            RAVELOG_WARN_FORMAT("env=%d iksolver points to removed manip '%s', passing through", GetEnv()->GetId()%_manipname);
+            return IKRA_Success; // pass through
+        }
+        std::vector<dReal> vsolution;
+        pmanip->GetRobot()->GetDOFValues(vsolution, pmanip->GetArmIndices());
+        return _CallFilters(vsolution, pmanip, param, ikreturn, minpriority, maxpriority);
+    }
+
+    virtual int GetNumFreeParameters() const
+    {
+        return 0;
+    }
+
+    virtual bool GetFreeParameters(std::vector<dReal>& vFreeParameters) const
+    {
+        vFreeParameters.resize(0);
+        return true;
+    }
+
+    virtual bool GetFreeIndices(std::vector<int>& vFreeIndices) const
+    {
+        vFreeIndices.resize(0);
+        return true;
+    }
+
+    virtual RobotBase::ManipulatorPtr GetManipulator() const {
+        return _pmanip.lock();
+    }
+
+    virtual void Clone(InterfaceBaseConstPtr preference, int cloningoptions)
+    {
+        IkSolverBase::Clone(preference, cloningoptions);
+        boost::shared_ptr<NumericalIkSolver const> r = boost::dynamic_pointer_cast<NumericalIkSolver const>(preference);
+        _nNumThreads = r->_nNumThreads;
+        _nMaxRestarts = r->_nMaxRestarts;
+        _nMaxSolutions = r->_nMaxSolutions;
+        _nMaxIterations = r->_nMaxIterations;
+        _fErrorThresh = r->_fErrorThresh;
+        _fDistinctThresh = r->_fDistinctThresh;
+        _nSeed = r->_nSeed;
+        _fMaxStep = r->_fMaxStep;
+
+        _pmanip.reset();
+        _manipname.clear();
+        _cblimits.reset();
+        _vchain.resize(0);
+        RobotBase::ManipulatorPtr rmanip = r->_pmanip.lock();
+        if( !!rmanip ) {
+            RobotBasePtr probot = GetEnv()->GetRobot(rmanip->GetRobot()->GetName());
+            if( !!probot ) {
+                RobotBase::ManipulatorPtr pmanip = probot->GetManipulator(rmanip->GetName());
+                if( !!pmanip ) {
+                    Init(pmanip);
+                }
+            }
+        }
+    }
+
+protected:
+    bool _SetNumThreadsCommand(ostream& sout, istream& sinput)
+    {
+        int nthreads = 1;
+        sinput >> nthreads;
+        if( !sinput ) {
+            return false;
+        }
+        _nNumThreads = std::max(1, nthreads);
+        return true;
+    }
+
+    bool _SetMaxRestartsCommand(ostream& sout, istream& sinput)
+    {
+        sinput >> _nMaxRestarts;
+        return !!sinput;
+    }
+
+    bool _SetMaxSolutionsCommand(ostream& sout, istream& sinput)
+    {
+        sinput >> _nMaxSolutions;
+        return !!sinput;
+    }
+
+    bool _SetMaxIterationsCommand(ostream& sout, istream& sinput)
+    {
+        sinput >> _nMaxIterations;
+        return !!sinput;
+    }
+
+    bool _SetErrorThreshCommand(ostream& sout, istream& sinput)
+    {
+        sinput >> _fErrorThresh;
+        return !!sinput;
+    }
+
+    bool _SetDistinctThreshCommand(ostream& sout, istream& sinput)
+    {
+        sinput >> _fDistinctThresh;
+        return !!sinput;
+    }
+
+    bool _SetSeedCommand(ostream& sout, istream& sinput)
+    {
+        sinput >> _nSeed;
+        return !!sinput;
+    }
+
+    /// \brief searches for up to numsolutions solutions that pass the filters
+    ///
+    /// \param[out] vikreturns the accepted solutions in the order of their restarts
+    /// \return IKRA_Success if at least one solution was accepted, otherwise the action of the last rejected candidate
+    IkReturnAction _Solve(const IkParameterization& param, const std::vector<dReal>& q0, int filteroptions, int numsolutions, std::vector<IkReturnPtr>& vikreturns)
+    {
+        vikreturns.resize(0);
+        RobotBase::ManipulatorPtr pmanip(_pmanip);
+        if( !Supports(param.GetType()) ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("numerical ik solver of manip %s does not support iktype 0x%x"), _manipname%param.GetType(), ORE_InvalidArguments);
+        }
+        RobotBasePtr probot = pmanip->GetRobot();
+        RobotBase::RobotStateSaver saver(probot);
+        probot->SetActiveDOFs(pmanip->GetArmIndices());
+        CollisionOptionsStateSaver optionstate(GetEnv()->GetCollisionChecker(),GetEnv()->GetCollisionChecker()->GetCollisionOptions()|CO_ActiveDOFs,false);
+        const bool bCheckLimits = !(filteroptions & IKFO_IgnoreJointLimits);
+
+        IkReturnAction retaction = IKRA_Reject;
+        std::vector<Candidate> vcandidates;
+        size_t ntested = 0;
+        int nextrestart = 0;
+        while( (int)vikreturns.size() < numsolutions && nextrestart < _nMaxRestarts ) {
+            _SearchCandidates(param, q0, numsolutions-(int)vikreturns.size(), bCheckLimits, nextrestart, vcandidates);
+            for(; ntested < vcandidates.size(); ++ntested) {
+                IkReturnPtr localret(new IkReturn(IKRA_Success));
+                localret->_vsolution = vcandidates[ntested].vsolution;
+                IkReturnAction action = _ValidateSolution(param, filteroptions, pmanip, localret);
+                if( action == IKRA_Success ) {
+                    vikreturns.push_back(localret);
+                    _CallFinishCallbacks(localret, pmanip, param);
+                    if( (int)vikreturns.size() >= numsolutions ) {
+                        break;
+                    }
+                }
+                else {
+                    retaction = action;
+                    if( action & IKRA_Quit ) {
+                        return retaction;
+                    }
+                }
+            }
+        }
+        return vikreturns.size() > 0 ? IKRA_Success : retaction;
+    }
+
+    /// \brief sets the solution on the robot and runs the custom filters and the collision checks
+    IkReturnAction _ValidateSolution(const IkParameterization& param, int filteroptions, RobotBase::ManipulatorPtr pmanip, IkReturnPtr ikreturn)
+    {
+        RobotBasePtr probot = pmanip->GetRobot();
+        probot->SetActiveDOFValues(ikreturn->_vsolution, KinBody::CLA_Nothing);
+        // like ikfast, the custom filters with positive priority run before the collision checks
+        if( !(filteroptions & IKFO_IgnoreCustomFilters) && _HasFilterInRange(1, IKSP_MaxPriority) ) {
+            IkReturnAction action = _CallFilters(ikreturn->_vsolution, pmanip, param, ikreturn, 1, IKSP_MaxPriority);
+            if( action != IKRA_Success ) {
+                return action;
+            }
+        }
+        if( !(filteroptions & IKFO_IgnoreSelfCollisions) && probot->CheckSelfCollision() ) {
+            return IKRA_RejectSelfCollision;
+        }
+        if( (filteroptions & IKFO_CheckEnvCollisions) && GetEnv()->CheckCollision(KinBodyConstPtr(probot)) ) {
+            return IKRA_RejectEnvCollision;
+        }
+        if( !(filteroptions & IKFO_IgnoreCustomFilters) && _HasFilterInRange(IKSP_MinPriority, 0) ) {
+            return _CallFilters(ikreturn->_vsolution, pmanip, param, ikreturn, IKSP_MinPriority, 0);
+        }
+        return IKRA_Success;
+    }
+
+    /// \brief runs restarts from nextrestart on _nNumThreads threads until numneeded new distinct solutions are found or the restarts run out
+    ///
+    /// The new candidates are appended to vcandidates sorted by their restart. The robot is not touched.
+    void _SearchCandidates(const IkParameterization& param, const std::vector<dReal>& q0, int numneeded, bool bCheckLimits, int& nextrestart, std::vector<Candidate>& vcandidates)
+    {
+        const size_t nexisting = vcandidates.size();
+        std::mutex mutex;
+        std::atomic<int> nNextRestart(nextrestart);
+        std::atomic<bool> bDone(false);
+        int numfound = 0;
+        auto fn = [&](SearchWorkspace& workspace) {
+                      while( !bDone ) {
+                          const int irestart = nNextRestart++;
+                          if( irestart >= _nMaxRestarts ) {
+                              break;
+                          }
+                          _SampleSeed(irestart, q0, workspace.vq);
+                          if( !_SolveFromSeed(param, bCheckLimits, workspace) ) {
+                              continue;
+                          }
+                          std::lock_guard<std::mutex> lock(mutex);
+                          bool bDistinct = true;
+                          FOREACHC(itcandidate, vcandidates) {
+                              if( !_IsDistinct(itcandidate->vsolution, workspace.vq) ) {
+                                  bDistinct = false;
+                                  break;
+                              }
+                          }
+                          if( bDistinct ) {
+                              vcandidates.push_back(Candidate());
+                              vcandidates.back().irestart = irestart;
+                              vcandidates.back().vsolution = workspace.vq;
+                              if( ++numfound >= numneeded ) {
+                                  bDone = true;
+                              }
+                          }
+                      }
+                  };
+
+        const int nthreads = std::max(1, std::min(_nNumThreads, _nMaxRestarts-nextrestart));
+        _vthreadworkspaces.resize(nthreads-1);
+        std::vector<std::exception_ptr> vexceptions(nthreads);
+        std::vector<std::thread> vthreads;
+        vthreads.reserve(nthreads-1);
+        for(int ithread = 1; ithread < nthreads; ++ithread) {
+            vthreads.emplace_back([&, ithread]() {
+                try {
+                    fn(_vthreadworkspaces[ithread-1]);
+                }
+                catch(...) {
+                    vexceptions[ithread] = std::current_exception();
+                    bDone = true;
+                }
+            });
+        }
+        try {
+            fn(_workspace);
+        }
+        catch(...) {
+            vexceptions.at(0) = std::current_exception();
+            bDone = true;
+        }
+        FOREACH(itthread, vthreads) {
+            itthread->join();
+        }
+        FOREACH(itexception, vexceptions) {
+            if( !!*itexception ) {
+                std::rethrow_exception(*itexception);
+            }
+        }
+        nextrestart = std::min(nNextRestart.load(), _nMaxRestarts);
+        std::sort(vcandidates.begin()+nexisting, vcandidates.end(), [](const Candidate& c0, const Candidate& c1) {
+            return c0.irestart < c1.irestart;
+        });
+    }
+
+    /// \brief restart 0 starts from q0, the others from configurations sampled from the joint limits with a generator seeded by the restart index
+    void _SampleSeed(int irestart, const std::vector<dReal>& q0, std::vector<dReal>& vq) const
+    {
+        if( irestart == 0 && q0.size() == _qlower.size() ) {
+            vq = q0;
+            return;
+        }
+        std::mt19937 rng(_nSeed*1000003u + (uint32_t)irestart);
+        std::uniform_real_distribution<dReal> distribution(0, 1);
+        vq.resize(_qlower.size());
+        for(size_t i = 0; i < vq.size(); ++i) {
+            const dReal flower = _vcircular[i] ? -PI : _qlower[i];
+            const dReal fupper = _vcircular[i] ? PI : _qupper[i];
+            vq[i] = flower + (fupper-flower)*distribution(rng);
+        }
+    }
+
+    inline bool _IsDistinct(const std::vector<dReal>& v0, const std::vector<dReal>& v1) const
+    {
+        for(size_t i = 0; i < v0.size(); ++i) {
+            const dReal fdiff = _vcircular[i] ? utils::SubtractCircularAngle(v0[i], v1[i]) : v0[i]-v1[i];
+            if( RaveFabs(fdiff) > _fDistinctThresh ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// \brief computes the manipulator transform in the base frame from the arm values
+    ///
+    /// \param pjointpos if not NULL, fills the position of every joint of the chain in the base frame
+    /// \param pjointaxis if not NULL, fills the signed axis of every joint of the chain in the base frame
+    void _ComputeForwardKinematics(const dReal* pvalues, Transform& tmanip, Vector* pjointpos, Vector* pjointaxis) const
+    {
+        Transform t;
+        for(size_t i = 0; i < _vchain.size(); ++i) {
+            const ChainJoint& chainjoint = _vchain[i];
+            t = t * chainjoint.tleft;
+            if( !!pjointpos ) {
+                pjointpos[i] = t.trans;
+                pjointaxis[i] = t.rotate(chainjoint.vaxis) * chainjoint.fsign;
+            }
+            const dReal fvalue = chainjoint.fsign*(pvalues[chainjoint.armindex]+chainjoint.foffset);
+            Transform tjoint;
+            if( chainjoint.bRevolute ) {
+                tjoint.rot = quatFromAxisAngle(chainjoint.vaxis, fvalue);
+            }
+            else {
+                tjoint.trans = chainjoint.vaxis*fvalue;
+            }
+            t = t * tjoint * chainjoint.tright;
+        }
+        tmanip = t * _tlocaltool;
+    }
+
+    /// \brief the error and jacobian have 3 angular rows if the ik type constrains the rotation, followed by 3 linear rows if it constrains the translation
+    static inline bool _HasAngularRows(IkParameterizationType iktype)
+    {
+        return iktype != IKP_Translation3D;
+    }
+
+    static inline bool _HasLinearRows(IkParameterizationType iktype)
+    {
+        return iktype == IKP_Transform6D || iktype == IKP_TranslationDirection5D || iktype == IKP_Translation3D;
+    }
+
+    static inline int _GetNumRows(IkParameterizationType iktype)
+    {
+        return 3*((int)_HasAngularRows(iktype) + (int)_HasLinearRows(iktype));
+    }
+
+    /// \brief angular velocity that rotates direction vcur to vgoal in one unit of time
+    static Vector _GetDirectionError(const Vector& vcur, const Vector& vgoal)
+    {
+        const Vector vcross = vcur.cross(vgoal);
+        const dReal fsin = RaveSqrt(vcross.lengthsqr3());
+        if( fsin <= 1e-12 ) {
+            return Vector();
+        }
+        return vcross * (RaveAtan2(fsin, vcur.dot3(vgoal))/fsin);
+    }
+
+    /// \return the squared norm of the error
+    dReal _ComputeError(const IkParameterization& param, const Transform& tmanip, dReal* error) const
+    {
+        Vector vangular, vlinear;
+        switch(param.GetType()) {
+        case IKP_Transform6D:
+            vangular = axisAngleFromQuat(quatMultiply(param.GetTransform6D().rot, quatInverse(tmanip.rot)));
+            vlinear = param.GetTransform6D().trans - tmanip.trans;
+            break;
+        case IKP_Rotation3D:
+            vangular = axisAngleFromQuat(quatMultiply(param.GetRotation3D(), quatInverse(tmanip.rot)));
+            break;
+        case IKP_Translation3D:
+            vlinear = param.GetTranslation3D() - tmanip.trans;
+            break;
+        case IKP_Direction3D:
+            vangular = _GetDirectionError(tmanip.rotate(_vlocaldirection), param.GetDirection3D());
+            break;
+        case IKP_TranslationDirection5D:
+            vangular = _GetDirectionError(tmanip.rotate(_vlocaldirection), param.GetTranslationDirection5D().dir);
+            vlinear = param.GetTranslationDirection5D().pos - tmanip.trans;
+            break;
+        default:
+            break;
+        }
+        const int linearoffset = _HasAngularRows(param.GetType()) ? 3 : 0;
+        const bool bLinear = _HasLinearRows(param.GetType());
+        for(int i = 0; i < 3; ++i) {
+            if( linearoffset > 0 ) {
+                error[i] = vangular[i];
+            }
+            if( bLinear ) {
+                error[linearoffset+i] = vlinear[i];
+            }
+        }
+        return vangular.lengthsqr3() + vlinear.lengthsqr3();
+    }
+
+    /// \brief fills the numrows x armdof jacobian in the same row order as _ComputeError
+    void _ComputeJacobian(IkParameterizationType iktype, const Transform& tmanip, const Vector* pjointpos, const Vector* pjointaxis, dReal* J) const
+    {
+        const int armdof = _vchain.size();
+        const bool bAngular = _HasAngularRows(iktype);
+        const bool bLinear = _HasLinearRows(iktype);
+        const int linearoffset = bAngular ? 3 : 0;
+        for(size_t i = 0; i < _vchain.size(); ++i) {
+            const int j = _vchain[i].armindex;
+            const Vector& vaxis = pjointaxis[i];
+            Vector vangular, vlinear;
+            if( _vchain[i].bRevolute ) {
+                vangular = vaxis;
+                vlinear = vaxis.cross(tmanip.trans-pjointpos[i]);
+            }
+            else {
+                vlinear = vaxis;
+            }
+            for(int k = 0; k < 3; ++k) {
+                if( bAngular ) {
+                    J[k*armdof+j] = vangular[k];
+                }
+                if( bLinear ) {
+                    J[(linearoffset+k)*armdof+j] = vlinear[k];
+                }
+            }
+        }
+    }
+
+    /// \brief runs damped least squares from workspace.vq
+    ///
+    /// Steps that decrease the error are accepted and relax the damping, the others are rejected and increase it.
+    /// \return true if the error converged, workspace.vq holds the solution
+    bool _SolveFromSeed(const IkParameterization& param, bool bCheckLimits, SearchWorkspace& workspace) const
+    {
+        const int armdof = _vchain.size();
+        const int numrows = _GetNumRows(param.GetType());
+        const dReal ferrorthresh2 = _fErrorThresh*_fErrorThresh;
+        workspace.vqnew.resize(armdof);
+        workspace.vqdelta.resize(armdof);
+        workspace.vJ.resize(numrows*armdof);
+        workspace.vjointpos.resize(armdof);
+        workspace.vjointaxis.resize(armdof);
+        workspace.vjointposnew.resize(armdof);
+        workspace.vjointaxisnew.resize(armdof);
+
+        dReal error[6], errornew[6];
+        Transform tmanip, tmanipnew;
+        _ComputeForwardKinematics(&workspace.vq[0], tmanip, &workspace.vjointpos[0], &workspace.vjointaxis[0]);
+        dReal ferror2 = _ComputeError(param, tmanip, error);
+        dReal lambda = 1e-9;
+        bool bJacobianValid = false;
+        int numslowiterations = 0;
+        for(int iter = 0; iter < _nMaxIterations; ++iter) {
+            if( ferror2 <= ferrorthresh2 ) {
+                return true;
+            }
+            if( !bJacobianValid ) {
+                _ComputeJacobian(param.GetType(), tmanip, &workspace.vjointpos[0], &workspace.vjointaxis[0], &workspace.vJ[0]);
+                bJacobianValid = true;
+            }
+            if( !ikfastsolvers::ComputeDampedLeastSquaresStep(&workspace.vJ[0], numrows, armdof, lambda, error, &workspace.vqdelta[0]) ) {
+                lambda *= 10;
+                if( lambda > 1e2 ) {
+                    return false;
+                }
+                continue;
+            }
+
+            dReal fmaxstep = 0;
+            for(int i = 0; i < armdof; ++i) {
+                fmaxstep = max(fmaxstep, RaveFabs(workspace.vqdelta[i]));
+            }
+            if( !(fmaxstep < 1e30) ) {
+                return false; // not finite
+            }
+            const dReal fscale = fmaxstep > _fMaxStep ? _fMaxStep/fmaxstep : dReal(1);
+            for(int i = 0; i < armdof; ++i) {
+                dReal f = workspace.vq[i] + fscale*workspace.vqdelta[i];
+                if( _vcircular[i] ) {
+                    f = utils::NormalizeCircularAngle(f, -PI, PI);
+                }
+                else if( bCheckLimits ) {
+                    f = max(_qlower[i], min(_qupper[i], f));
+                }
+                workspace.vqnew[i] = f;
+            }
+
+            _ComputeForwardKinematics(&workspace.vqnew[0], tmanipnew, &workspace.vjointposnew[0], &workspace.vjointaxisnew[0]);
+            const dReal ferrornew2 = _ComputeError(param, tmanipnew, errornew);
+            if( ferrornew2 < ferror2 ) {
+                if( ferrornew2 > 0.98*ferror2 ) {
+                    // most likely pushing against a joint limit or in a local minimum
+                    if( ++numslowiterations >= 3 ) {
+                        return false;
+                    }
+                }
+                else {
+                    numslowiterations = 0;
+                }
+                workspace.vq.swap(workspace.vqnew);
+                workspace.vjointpos.swap(workspace.vjointposnew);
+                workspace.vjointaxis.swap(workspace.vjointaxisnew);
+                tmanip = tmanipnew;
+                std::copy(errornew, errornew+numrows, error);
+                ferror2 = ferrornew2;
+                bJacobianValid = false;
+                lambda = max(lambda*dReal(0.1), dReal(1e-9));
+            }
+            else {
+                lambda *= 10;
+                if( lambda > 1e2 ) {
+                    return false;
+                }
+            }
+        }
+        return ferror2 <= ferrorthresh2;
+    }
+
+    RobotBase::ManipulatorWeakPtr _pmanip;
+    std::string _manipname; ///< name of the manipluator being set, this is for book keeping purposes
+    UserDataPtr _cblimits;
+    std::vector<ChainJoint> _vchain; ///< moving joints from the manipulator base to the end effector
+    Transform _tlocaltool; ///< transform of the manipulator frame in the frame after the last joint
+    Vector _vlocaldirection; ///< manipulator direction in the manipulator frame
+    std::vector<dReal> _qlower, _qupper;
+    std::vector<uint8_t> _vcircular; ///< 1 if the arm joint is circular
+
+    int _nNumThreads; ///< number of threads running restarts, including the calling thread
+    int _nMaxRestarts; ///< maximum number of seeds per call
+    int _nMaxSolutions; ///< number of solutions SolveAll looks for
+    int _nMaxIterations; ///< maximum number of iterations per seed
+    dReal _fErrorThresh; ///< workspace error of a solution
+    dReal _fDistinctThresh; ///< minimum joint difference between distinct solutions
+    uint32_t _nSeed;
+    dReal _fMaxStep; ///< maximum change of a joint value in one iteration
+
+    SearchWorkspace _workspace; ///< workspace of the calling thread
+    std::vector<SearchWorkspace> _vthreadworkspaces; ///< workspaces of the other search threads
+};
+
+IkSolverBasePtr CreateNumericalIkSolver(EnvironmentBasePtr penv, std::istream& sinput)
+{
+    return IkSolverBasePtr(new NumericalIkSolver(penv));
+}
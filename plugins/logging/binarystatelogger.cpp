@@ -0,0 +1,815 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2026 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "plugindefs.h"
+
+#include <condition_variable>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <boost/bind/bind.hpp>
+
+#ifdef OPENRAVE_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace boost::placeholders;
+
+/* File layout, values are stored in the byte order of the recording machine:
+
+   header: uint32 magic, uint16 version, uint8 sizeof(dReal)
+   chunks: uint32 storedsize, uint32 rawsize, uint64 starttime, uint64 endtime, uint8 compression, storedsize bytes
+   index:  uint32 numchunks, for every chunk uint64 offset, uint64 starttime, uint64 endtime
+   footer: uint64 indexoffset, uint32 magic
+
+   A chunk decompresses to the body table (uint32 numbodies, then the name and uint16 dof of every body) followed by its frames.
+   A frame is the uint64 simulation time in microseconds, uint32 numentries, and for every entry uint32 bodyindex, uint8 mask of StateField and the masked fields.
+   The first frame of a chunk has every field of every body so that replay can start at any chunk, the other frames only have the fields that changed since the previous frame.
+   If the footer is missing because the logger did not stop cleanly, replay scans the chunk headers instead.
+ */
+
+namespace binarystatelog {
+
+static const uint32_t s_nMagic = 0x4c53524f; // "ORSL"
+static const uint16_t s_nVersion = 1;
+static const size_t s_nChunkHeaderSize = 25;
+
+enum StateField
+{
+    SF_Transform = 1,
+    SF_DOFValues = 2,
+    SF_Enabled = 4,
+    SF_Grabbed = 8,
+    SF_All = 15,
+};
+
+enum ChunkCompression
+{
+    CC_None = 0,
+    CC_Zlib = 1,
+};
+
+/// \brief recorded state of one body
+struct BodyState
+{
+    BodyState() : bEnabled(true) {
+    }
+    Transform t;
+    std::vector<dReal> vDOFValues;
+    bool bEnabled;
+    std::vector< std::pair<std::string, std::string> > vGrabbed; ///< name of every grabbed body and of the link grabbing it
+};
+
+struct ChunkIndex
+{
+    uint64_t offset, starttime, endtime;
+};
+
+template <typename T>
+inline void WriteValue(std::vector<uint8_t>& v, const T& value)
+{
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+    v.insert(v.end(), p, p+sizeof(T));
+}
+
+inline void WriteString(std::vector<uint8_t>& v, const std::string& s)
+{
+    WriteValue(v, static_cast<uint16_t>(s.size()));
+    v.insert(v.end(), s.begin(), s.end());
+}
+
+template <typename T>
+inline void WriteValue(std::ostream& O, const T& value)
+{
+    O.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+inline bool ReadValue(std::istream& I, T& value)
+{
+    return !!I.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+/// \brief reads the values of a decompressed chunk, throws if reading past its end
+class ChunkReader
+{
+public:
+    ChunkReader(const std::vector<uint8_t>& vdata) : _p(vdata.data()), _pend(vdata.data()+vdata.size()) {
+    }
+
+    template <typename T>
+    T Read()
+    {
+        T value;
+        _Check(sizeof(T));
+        std::memcpy(&value, _p, sizeof(T));
+        _p += sizeof(T);
+        return value;
+    }
+
+    void ReadString(std::string& s)
+    {
+        uint16_t size = Read<uint16_t>();
+        _Check(size);
+        s.assign(reinterpret_cast<const char*>(_p), size);
+        _p += size;
+    }
+
+    void ReadValues(std::vector<dReal>& v)
+    {
+        _Check(v.size()*sizeof(dReal));
+        if( v.size() > 0 ) {
+            std::memcpy(v.data(), _p, v.size()*sizeof(dReal));
+        }
+        _p += v.size()*sizeof(dReal);
+    }
+
+    bool IsEnd() const {
+        return _p >= _pend;
+    }
+
+private:
+    void _Check(size_t size) const
+    {
+        if( static_cast<size_t>(_pend-_p) < size ) {
+            throw OPENRAVE_EXCEPTION_FORMAT0("state log chunk is truncated", ORE_InvalidArguments);
+        }
+    }
+
+    const uint8_t* _p;
+    const uint8_t* _pend;
+};
+
+inline void WriteBodyState(std::vector<uint8_t>& v, const BodyState& state, uint8_t mask)
+{
+    if( mask & SF_Transform ) {
+        for(int i = 0; i < 4; ++i) {
+            WriteValue(v, state.t.rot[i]);
+        }
+        for(int i = 0; i < 3; ++i) {
+            WriteValue(v, state.t.trans[i]);
+        }
+    }
+    if( (mask & SF_DOFValues) && state.vDOFValues.size() > 0 ) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(state.vDOFValues.data());
+        v.insert(v.end(), p, p+state.vDOFValues.size()*sizeof(dReal));
+    }
+    if( mask & SF_Enabled ) {
+        WriteValue(v, static_cast<uint8_t>(state.bEnabled));
+    }
+    if( mask & SF_Grabbed ) {
+        WriteValue(v, static_cast<uint16_t>(state.vGrabbed.size()));
+        FOREACHC(itgrabbed, state.vGrabbed) {
+            WriteString(v, itgrabbed->first);
+            WriteString(v, itgrabbed->second);
+        }
+    }
+}
+
+/// \param state has to have its DOF values initialized to the DOF of the body
+inline void ReadBodyState(ChunkReader& reader, BodyState& state, uint8_t mask)
+{
+    if( mask & SF_Transform ) {
+        for(int i = 0; i < 4; ++i) {
+            state.t.rot[i] = reader.Read<dReal>();
+        }
+        for(int i = 0; i < 3; ++i) {
+            state.t.trans[i] = reader.Read<dReal>();
+        }
+    }
+    if( mask & SF_DOFValues ) {
+        reader.ReadValues(state.vDOFValues);
+    }
+    if( mask & SF_Enabled ) {
+        state.bEnabled = reader.Read<uint8_t>() != 0;
+    }
+    if( mask & SF_Grabbed ) {
+        state.vGrabbed.resize(reader.Read<uint16_t>());
+        FOREACH(itgrabbed, state.vGrabbed) {
+            reader.ReadString(itgrabbed->first);
+            reader.ReadString(itgrabbed->second);
+        }
+    }
+}
+
+/// \brief returns the mask of the fields that differ between the two states
+inline uint8_t GetChangedFields(const BodyState& prev, const BodyState& cur)
+{
+    uint8_t mask = 0;
+    for(int i = 0; i < 4; ++i) {
+        if( prev.t.rot[i] != cur.t.rot[i] ) {
+            mask |= SF_Transform;
+        }
+    }
+    for(int i = 0; i < 3; ++i) {
+        if( prev.t.trans[i] != cur.t.trans[i] ) {
+            mask |= SF_Transform;
+        }
+    }
+    if( prev.vDOFValues != cur.vDOFValues ) {
+        mask |= SF_DOFValues;
+    }
+    if( prev.bEnabled != cur.bEnabled ) {
+        mask |= SF_Enabled;
+    }
+    if( prev.vGrabbed != cur.vGrabbed ) {
+        mask |= SF_Grabbed;
+    }
+    return mask;
+}
+
+/// \brief compresses a chunk
+///
+/// \return the compression of vstored, if CC_None the chunk should be stored as is
+inline ChunkCompression CompressChunk(const std::vector<uint8_t>& vraw, std::vector<uint8_t>& vstored)
+{
+#ifdef OPENRAVE_HAS_ZLIB
+    uLongf size = compressBound(vraw.size());
+    vstored.resize(size);
+    if( compress2(vstored.data(), &size, vraw.data(), vraw.size(), Z_BEST_SPEED) == Z_OK && size < vraw.size() ) {
+        vstored.resize(size);
+        return CC_Zlib;
+    }
+#endif
+    return CC_None;
+}
+
+inline void DecompressChunk(uint8_t compression, std::vector<uint8_t>& vstored, size_t rawsize, std::vector<uint8_t>& vraw)
+{
+    if( compression == CC_None ) {
+        vraw.swap(vstored);
+        return;
+    }
+#ifdef OPENRAVE_HAS_ZLIB
+    if( compression == CC_Zlib ) {
+        vraw.resize(rawsize);
+        uLongf size = rawsize;
+        if( uncompress(vraw.data(), &size, vstored.data(), vstored.size()) != Z_OK || size != rawsize ) {
+            throw OPENRAVE_EXCEPTION_FORMAT0("failed to decompress state log chunk", ORE_InvalidArguments);
+        }
+        return;
+    }
+#endif
+    throw OPENRAVE_EXCEPTION_FORMAT("state log chunk compression %d is not supported", (int)compression, ORE_NotImplemented);
+}
+
+class BinaryStateLogger : public ModuleBase
+{
+    /// \brief chunk whose frames are complete and that waits to be compressed and written
+    struct PendingChunk
+    {
+        std::vector<uint8_t> vdata;
+        uint64_t starttime, endtime;
+    };
+
+    struct RecordStatistics
+    {
+        RecordStatistics() : numFrames(0), numChunks(0), numRawBytes(0), numWrittenBytes(0) {
+        }
+        uint64_t numFrames;
+        uint64_t numChunks; ///< chunks written to the file
+        uint64_t numRawBytes, numWrittenBytes; ///< size of the written chunks before and after compression
+    };
+
+public:
+    BinaryStateLogger(EnvironmentBasePtr penv, std::istream& sinput) : ModuleBase(penv)
+    {
+        __description = "Records the transforms, DOF values, enable states and grabbed bodies of all bodies at every simulation step into an indexed binary file that can be played back with BinaryStateReplay. Frames only hold the values that changed since the previous frame and are compressed in chunks on a separate thread. The module has to be added to the environment so that it is stepped with the simulation.";
+        RegisterCommand("Start",boost::bind(&BinaryStateLogger::_StartCommand,this,_1,_2),
+                        "Starts recording into a file, this stops the previous recording and overwrites the file. Format::\n\n  Start [keyframeinterval num] filename [filename]\\n\n\nkeyframeinterval is the number of frames of every chunk (default 100). Replay starts decoding at the beginning of a chunk, so smaller values make seeking faster and the file larger.");
+        RegisterCommand("Stop",boost::bind(&BinaryStateLogger::_StopCommand,this,_1,_2),
+                        "Stops recording and writes the index of the file. Format::\n\n  Stop\n\n");
+        RegisterCommand("GetStatistics",boost::bind(&BinaryStateLogger::_GetStatisticsCommand,this,_1,_2),
+                        "Returns the statistics of the current recording::\n\n  numframes numchunks numrawbytes numwrittenbytes\n\n");
+        _nKeyframeInterval = 100;
+        _nFramesInChunk = 0;
+        _chunkstarttime = _chunkendtime = 0;
+        _bRecording = false;
+        _bStopThread = false;
+    }
+
+    virtual ~BinaryStateLogger()
+    {
+        _Stop();
+    }
+
+    virtual void Destroy()
+    {
+        _Stop();
+    }
+
+    virtual bool SimulationStep(dReal fElapsedTime)
+    {
+        std::lock_guard<std::mutex> lock(_mutexRecord);
+        if( _bRecording ) {
+            _RecordFrame();
+        }
+        return false;
+    }
+
+protected:
+    bool _StartCommand(ostream& sout, istream& sinput)
+    {
+        _Stop();
+        std::string filename;
+        uint32_t nKeyframeInterval = 100;
+        string cmd;
+        while(!sinput.eof()) {
+            sinput >> cmd;
+            if( !sinput ) {
+                break;
+            }
+            std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+            if( cmd == "keyframeinterval" ) {
+                sinput >> nKeyframeInterval;
+                nKeyframeInterval = max(nKeyframeInterval, (uint32_t)1);
+            }
+            else if( cmd == "filename" ) {
+                if( !getline(sinput, filename) ) {
+                    return false;
+                }
+                boost::trim(filename);
+            }
+            else {
+                RAVELOG_WARN_FORMAT("unrecognized command: %s", cmd);
+                return false;
+            }
+            if( sinput.fail() || !sinput ) {
+                break;
+            }
+        }
+        if( filename.size() == 0 ) {
+            RAVELOG_WARN("no filename given to record the state into\n");
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutexRecord);
+        _ofs.open(filename.c_str(), std::ios::binary|std::ios::trunc);
+        if( !_ofs ) {
+            RAVELOG_WARN_FORMAT("failed to open %s for recording", filename);
+            return false;
+        }
+        WriteValue(_ofs, s_nMagic);
+        WriteValue(_ofs, s_nVersion);
+        WriteValue(_ofs, static_cast<uint8_t>(sizeof(dReal)));
+        _nKeyframeInterval = nKeyframeInterval;
+        _nFramesInChunk = 0;
+        _vChunkIndices.clear();
+        _statistics = RecordStatistics();
+        _bStopThread = false;
+        _threadwrite = boost::make_shared<std::thread>(std::bind(&BinaryStateLogger::_WriteThread, this));
+        _bRecording = true;
+        RAVELOG_INFO_FORMAT("recording environment state into %s", filename);
+        return true;
+    }
+
+    bool _StopCommand(ostream& sout, istream& sinput)
+    {
+        _Stop();
+        return true;
+    }
+
+    bool _GetStatisticsCommand(ostream& sout, istream& sinput)
+    {
+        std::lock_guard<std::mutex> lock(_mutexWrite);
+        sout << _statistics.numFrames << " " << _statistics.numChunks << " " << _statistics.numRawBytes << " " << _statistics.numWrittenBytes;
+        return true;
+    }
+
+    void _Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutexRecord);
+            if( !_bRecording ) {
+                return;
+            }
+            _bRecording = false;
+            if( _nFramesInChunk > 0 ) {
+                _FlushChunk();
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutexWrite);
+            _bStopThread = true;
+            _condPendingChunk.notify_all();
+        }
+        _threadwrite->join();
+        _threadwrite.reset();
+
+        // the write thread is done, so the file and the index can be accessed directly
+        uint64_t indexoffset = _ofs.tellp();
+        WriteValue(_ofs, static_cast<uint32_t>(_vChunkIndices.size()));
+        FOREACHC(itindex, _vChunkIndices) {
+            WriteValue(_ofs, itindex->offset);
+            WriteValue(_ofs, itindex->starttime);
+            WriteValue(_ofs, itindex->endtime);
+        }
+        WriteValue(_ofs, indexoffset);
+        WriteValue(_ofs, s_nMagic);
+        _ofs.close();
+        _vbodies.clear();
+        _vRecordedBodies.clear();
+        _vstates.clear();
+    }
+
+    /// \brief records the state of all bodies, has to be called with _mutexRecord locked
+    void _RecordFrame()
+    {
+        GetEnv()->GetBodies(_vbodies);
+        bool bKeyframe = _nFramesInChunk == 0 || _nFramesInChunk >= _nKeyframeInterval || _vbodies.size() != _vRecordedBodies.size();
+        for(size_t ibody = 0; ibody < _vbodies.size() && !bKeyframe; ++ibody) {
+            // a new chunk starts whenever bodies are added, removed or reloaded since the body table is per chunk
+            if( _vbodies[ibody].get() != _vRecordedBodies[ibody] || _vbodies[ibody]->GetDOF() != (int)_vstates[ibody].vDOFValues.size() || _vbodies[ibody]->GetName() != _vRecordedBodyNames[ibody] ) {
+                bKeyframe = true;
+            }
+        }
+        uint64_t simtime = GetEnv()->GetSimulationTime();
+        if( bKeyframe ) {
+            if( _nFramesInChunk > 0 ) {
+                _FlushChunk();
+            }
+            _vchunk.resize(0);
+            _vRecordedBodies.resize(_vbodies.size());
+            _vRecordedBodyNames.resize(_vbodies.size());
+            _vstates.resize(_vbodies.size());
+            WriteValue(_vchunk, static_cast<uint32_t>(_vbodies.size()));
+            for(size_t ibody = 0; ibody < _vbodies.size(); ++ibody) {
+                _vRecordedBodies[ibody] = _vbodies[ibody].get();
+                _vRecordedBodyNames[ibody] = _vbodies[ibody]->GetName();
+                WriteString(_vchunk, _vRecordedBodyNames[ibody]);
+                WriteValue(_vchunk, static_cast<uint16_t>(_vbodies[ibody]->GetDOF()));
+            }
+            _chunkstarttime = simtime;
+        }
+
+        WriteValue(_vchunk, simtime);
+        size_t numentriesoffset = _vchunk.size();
+        WriteValue(_vchunk, static_cast<uint32_t>(0));
+        uint32_t numentries = 0;
+        for(size_t ibody = 0; ibody < _vbodies.size(); ++ibody) {
+            _GetBodyState(*_vbodies[ibody], _tempstate);
+            uint8_t mask = bKeyframe ? (uint8_t)SF_All : GetChangedFields(_vstates[ibody], _tempstate);
+            if( mask != 0 ) {
+                WriteValue(_vchunk, static_cast<uint32_t>(ibody));
+                WriteValue(_vchunk, mask);
+                WriteBodyState(_vchunk, _tempstate, mask);
+                std::swap(_vstates[ibody], _tempstate);
+                ++numentries;
+            }
+        }
+        std::memcpy(&_vchunk[numentriesoffset], &numentries, sizeof(numentries));
+        _chunkendtime = simtime;
+        ++_nFramesInChunk;
+        {
+            std::lock_guard<std::mutex> lock(_mutexWrite);
+            _statistics.numFrames++;
+        }
+    }
+
+    void _GetBodyState(const KinBody& body, BodyState& state)
+    {
+        state.t = body.GetTransform();
+        body.GetDOFValues(state.vDOFValues);
+        state.bEnabled = body.IsEnabled();
+        state.vGrabbed.resize(0);
+        if( body.GetNumGrabbed() > 0 ) {
+            body.GetGrabbedInfo(_vGrabbedInfos);
+            FOREACHC(itinfo, _vGrabbedInfos) {
+                state.vGrabbed.push_back(std::make_pair(itinfo->_grabbedname, itinfo->_robotlinkname));
+            }
+        }
+    }
+
+    /// \brief hands the current chunk to the write thread, has to be called with _mutexRecord locked
+    void _FlushChunk()
+    {
+        boost::shared_ptr<PendingChunk> pchunk(new PendingChunk());
+        pchunk->vdata.swap(_vchunk);
+        pchunk->starttime = _chunkstarttime;
+        pchunk->endtime = _chunkendtime;
+        _nFramesInChunk = 0;
+        std::lock_guard<std::mutex> lock(_mutexWrite);
+        _listPendingChunks.push_back(pchunk);
+        _condPendingChunk.notify_all();
+    }
+
+    void _WriteThread()
+    {
+        std::vector<uint8_t> vstored;
+        while(1) {
+            boost::shared_ptr<PendingChunk> pchunk;
+            {
+                std::unique_lock<std::mutex> lock(_mutexWrite);
+                while( _listPendingChunks.empty() && !_bStopThread ) {
+                    _condPendingChunk.wait(lock);
+                }
+                if( _listPendingChunks.empty() ) {
+                    break;
+                }
+                pchunk = _listPendingChunks.front();
+                _listPendingChunks.pop_front();
+            }
+
+            ChunkCompression compression = CompressChunk(pchunk->vdata, vstored);
+            const std::vector<uint8_t>& vwrite = compression == CC_None ? pchunk->vdata : vstored;
+            ChunkIndex index;
+            index.offset = _ofs.tellp();
+            index.starttime = pchunk->starttime;
+            index.endtime = pchunk->endtime;
+            WriteValue(_ofs, static_cast<uint32_t>(vwrite.size()));
+            WriteValue(_ofs, static_cast<uint32_t>(pchunk->vdata.size()));
+            WriteValue(_ofs, index.starttime);
+            WriteValue(_ofs, index.endtime);
+            WriteValue(_ofs, static_cast<uint8_t>(compression));
+            _ofs.write(reinterpret_cast<const char*>(vwrite.data()), vwrite.size());
+            _vChunkIndices.push_back(index);
+            if( !_ofs ) {
+                RAVELOG_WARN("failed to write state log chunk\n");
+            }
+
+            std::lock_guard<std::mutex> lock(_mutexWrite);
+            _statistics.numChunks++;
+            _statistics.numRawBytes += pchunk->vdata.size();
+            _statistics.numWrittenBytes += s_nChunkHeaderSize + vwrite.size();
+        }
+    }
+
+    std::mutex _mutexRecord; ///< protects the recording state below, locked every simulation step
+    bool _bRecording;
+    uint32_t _nKeyframeInterval, _nFramesInChunk;
+    uint64_t _chunkstarttime, _chunkendtime;
+    std::vector<uint8_t> _vchunk; ///< the chunk being recorded
+    std::vector<const KinBody*> _vRecordedBodies; ///< the bodies of the body table of the current chunk, only used for comparing
+    std::vector<std::string> _vRecordedBodyNames;
+    std::vector<BodyState> _vstates; ///< the last recorded state of every body of the body table
+    std::vector<KinBodyPtr> _vbodies;
+    BodyState _tempstate;
+    std::vector<KinBody::GrabbedInfo> _vGrabbedInfos;
+
+    std::mutex _mutexWrite; ///< protects _listPendingChunks, _bStopThread and _statistics
+    std::condition_variable _condPendingChunk;
+    std::list< boost::shared_ptr<PendingChunk> > _listPendingChunks;
+    bool _bStopThread;
+    RecordStatistics _statistics;
+    boost::shared_ptr<std::thread> _threadwrite;
+    std::ofstream _ofs; ///< only accessed by _threadwrite while it runs
+    std::vector<ChunkIndex> _vChunkIndices; ///< only accessed by _threadwrite while it runs
+};
+
+class BinaryStateReplay : public ModuleBase
+{
+public:
+    BinaryStateReplay(EnvironmentBasePtr penv, std::istream& sinput) : ModuleBase(penv)
+    {
+        __description = "Plays back files recorded by BinaryStateLogger by setting the state of the bodies of the environment with the same names.";
+        RegisterCommand("Open",boost::bind(&BinaryStateReplay::_OpenCommand,this,_1,_2),
+                        "Opens a file recorded by BinaryStateLogger. Format::\n\n  Open [filename]\n\n");
+        RegisterCommand("GetTimeRange",boost::bind(&BinaryStateReplay::_GetTimeRangeCommand,this,_1,_2),
+                        "Returns the simulation times in microseconds of the first and last recorded frames::\n\n  starttime endtime\n\n");
+        RegisterCommand("SeekTime",boost::bind(&BinaryStateReplay::_SeekTimeCommand,this,_1,_2),
+                        "Sets the bodies of the environment to the last frame recorded at or before the time. Format::\n\n  SeekTime [time in microseconds]\n\nReturns the time of the frame that was set. Recorded bodies that are not in the environment are skipped. Grabbed bodies are only released and grabbed again when the grabbing changed.");
+        _nLoadedChunk = -1;
+    }
+
+protected:
+    bool _OpenCommand(ostream& sout, istream& sinput)
+    {
+        std::string filename;
+        if( !getline(sinput, filename) ) {
+            return false;
+        }
+        boost::trim(filename);
+        _ifs.close();
+        _ifs.clear();
+        _vChunkIndices.clear();
+        _nLoadedChunk = -1;
+        _ifs.open(filename.c_str(), std::ios::binary);
+        if( !_ifs ) {
+            RAVELOG_WARN_FORMAT("failed to open state log %s", filename);
+            return false;
+        }
+        uint32_t magic = 0;
+        uint16_t version = 0;
+        uint8_t realsize = 0;
+        if( !ReadValue(_ifs, magic) || !ReadValue(_ifs, version) || !ReadValue(_ifs, realsize) || magic != s_nMagic ) {
+            RAVELOG_WARN_FORMAT("%s is not a state log", filename);
+            return false;
+        }
+        if( version != s_nVersion || realsize != sizeof(dReal) ) {
+            RAVELOG_WARN_FORMAT("state log %s has version %d with %d byte reals, only version %d with %d byte reals is supported", filename%version%(int)realsize%s_nVersion%sizeof(dReal));
+            return false;
+        }
+        uint64_t headersize = _ifs.tellg();
+        if( !_ReadIndex() ) {
+            RAVELOG_WARN_FORMAT("state log %s has no index, scanning the chunks", filename);
+            _ScanChunks(headersize);
+        }
+        return true;
+    }
+
+    bool _GetTimeRangeCommand(ostream& sout, istream& sinput)
+    {
+        if( _vChunkIndices.size() == 0 ) {
+            return false;
+        }
+        sout << _vChunkIndices.front().starttime << " " << _vChunkIndices.back().endtime;
+        return true;
+    }
+
+    bool _SeekTimeCommand(ostream& sout, istream& sinput)
+    {
+        uint64_t time = 0;
+        sinput >> time;
+        if( !sinput || _vChunkIndices.size() == 0 || time < _vChunkIndices.front().starttime ) {
+            return false;
+        }
+        // last chunk starting at or before time
+        int ichunk = 0;
+        while( ichunk+1 < (int)_vChunkIndices.size() && _vChunkIndices[ichunk+1].starttime <= time ) {
+            ++ichunk;
+        }
+        _LoadChunk(ichunk);
+
+        ChunkReader reader(_vchunk);
+        std::vector<std::string> vbodynames(reader.Read<uint32_t>());
+        std::vector<BodyState> vstates(vbodynames.size());
+        for(size_t ibody = 0; ibody < vbodynames.size(); ++ibody) {
+            reader.ReadString(vbodynames[ibody]);
+            vstates[ibody].vDOFValues.resize(reader.Read<uint16_t>());
+        }
+        uint64_t frametime = 0;
+        while( !reader.IsEnd() ) {
+            uint64_t nexttime = reader.Read<uint64_t>();
+            if( nexttime > time ) {
+                break;
+            }
+            frametime = nexttime;
+            uint32_t numentries = reader.Read<uint32_t>();
+            for(uint32_t ientry = 0; ientry < numentries; ++ientry) {
+                uint32_t ibody = reader.Read<uint32_t>();
+                uint8_t mask = reader.Read<uint8_t>();
+                if( ibody >= vstates.size() ) {
+                    throw OPENRAVE_EXCEPTION_FORMAT("state log frame has body index %d, but chunk only has %d bodies", ibody%vstates.size(), ORE_InvalidArguments);
+                }
+                ReadBodyState(reader, vstates[ibody], mask);
+            }
+        }
+
+        EnvironmentLock lock(GetEnv()->GetMutex());
+        std::vector<KinBodyPtr> vbodies(vbodynames.size());
+        for(size_t ibody = 0; ibody < vbodynames.size(); ++ibody) {
+            KinBodyPtr pbody = GetEnv()->GetKinBody(vbodynames[ibody]);
+            if( !pbody ) {
+                RAVELOG_VERBOSE_FORMAT("recorded body %s is not in the environment", vbodynames[ibody]);
+                continue;
+            }
+            const BodyState& state = vstates[ibody];
+            if( pbody->GetDOF() != (int)state.vDOFValues.size() ) {
+                RAVELOG_WARN_FORMAT("recorded body %s has %d DOF, but the body in the environment has %d", vbodynames[ibody]%state.vDOFValues.size()%pbody->GetDOF());
+                continue;
+            }
+            pbody->SetDOFValues(state.vDOFValues, state.t, KinBody::CLA_Nothing);
+            if( pbody->IsEnabled() != state.bEnabled ) {
+                pbody->Enable(state.bEnabled);
+            }
+            vbodies[ibody] = pbody;
+        }
+
+        // grab after all bodies are in place so that the relative transforms of the grabbed bodies are correct
+        std::vector<KinBody::GrabbedInfo> vgrabbedinfos;
+        for(size_t ibody = 0; ibody < vbodies.size(); ++ibody) {
+            if( !vbodies[ibody] ) {
+                continue;
+            }
+            KinBodyPtr pbody = vbodies[ibody];
+            const BodyState& state = vstates[ibody];
+            pbody->GetGrabbedInfo(vgrabbedinfos);
+            bool bSameGrabbed = vgrabbedinfos.size() == state.vGrabbed.size();
+            for(size_t igrabbed = 0; igrabbed < vgrabbedinfos.size() && bSameGrabbed; ++igrabbed) {
+                bSameGrabbed = vgrabbedinfos[igrabbed]._grabbedname == state.vGrabbed[igrabbed].first && vgrabbedinfos[igrabbed]._robotlinkname == state.vGrabbed[igrabbed].second;
+            }
+            if( bSameGrabbed ) {
+                continue;
+            }
+            pbody->ReleaseAllGrabbed();
+            FOREACHC(itgrabbed, state.vGrabbed) {
+                KinBodyPtr pgrabbed = GetEnv()->GetKinBody(itgrabbed->first);
+                KinBody::LinkPtr plink = pbody->GetLink(itgrabbed->second);
+                if( !pgrabbed || !plink ) {
+                    RAVELOG_WARN_FORMAT("cannot grab %s with link %s of %s", itgrabbed->first%itgrabbed->second%pbody->GetName());
+                    continue;
+                }
+                pbody->Grab(pgrabbed, plink, rapidjson::Value());
+            }
+        }
+        sout << frametime;
+        return true;
+    }
+
+    /// \brief reads the index at the end of the file
+    ///
+    /// \return false if the file has no index
+    bool _ReadIndex()
+    {
+        const std::streamoff footersize = sizeof(uint64_t)+sizeof(uint32_t);
+        _ifs.seekg(0, std::ios::end);
+        std::streamoff filesize = _ifs.tellg();
+        if( filesize < footersize ) {
+            return false;
+        }
+        _ifs.seekg(filesize-footersize);
+        uint64_t indexoffset = 0;
+        uint32_t magic = 0, numchunks = 0;
+        if( !ReadValue(_ifs, indexoffset) || !ReadValue(_ifs, magic) || magic != s_nMagic || indexoffset >= (uint64_t)filesize ) {
+            _ifs.clear();
+            return false;
+        }
+        _ifs.seekg(indexoffset);
+        if( !ReadValue(_ifs, numchunks) ) {
+            _ifs.clear();
+            return false;
+        }
+        _vChunkIndices.resize(numchunks);
+        FOREACH(itindex, _vChunkIndices) {
+            if( !ReadValue(_ifs, itindex->offset) || !ReadValue(_ifs, itindex->starttime) || !ReadValue(_ifs, itindex->endtime) ) {
+                _ifs.clear();
+                _vChunkIndices.clear();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// \brief rebuilds the index from the chunk headers, stops at the first truncated chunk
+    void _ScanChunks(uint64_t offset)
+    {
+        _ifs.seekg(0, std::ios::end);
+        uint64_t filesize = _ifs.tellg();
+        while( offset + s_nChunkHeaderSize <= filesize ) {
+            _ifs.seekg(offset);
+            uint32_t storedsize = 0, rawsize = 0;
+            ChunkIndex index;
+            index.offset = offset;
+            if( !ReadValue(_ifs, storedsize) || !ReadValue(_ifs, rawsize) || !ReadValue(_ifs, index.starttime) || !ReadValue(_ifs, index.endtime) ) {
+                break;
+            }
+            if( offset + s_nChunkHeaderSize + storedsize > filesize ) {
+                break;
+            }
+            _vChunkIndices.push_back(index);
+            offset += s_nChunkHeaderSize + storedsize;
+        }
+        _ifs.clear();
+    }
+
+    void _LoadChunk(int ichunk)
+    {
+        if( _nLoadedChunk == ichunk ) {
+            return;
+        }
+        _nLoadedChunk = -1;
+        _ifs.seekg(_vChunkIndices.at(ichunk).offset);
+        uint32_t storedsize = 0, rawsize = 0;
+        uint64_t starttime = 0, endtime = 0;
+        uint8_t compression = 0;
+        if( !ReadValue(_ifs, storedsize) || !ReadValue(_ifs, rawsize) || !ReadValue(_ifs, starttime) || !ReadValue(_ifs, endtime) || !ReadValue(_ifs, compression) ) {
+            _ifs.clear();
+            throw OPENRAVE_EXCEPTION_FORMAT("failed to read the header of state log chunk %d", ichunk, ORE_InvalidArguments);
+        }
+        _vstored.resize(storedsize);
+        if( !_ifs.read(reinterpret_cast<char*>(_vstored.data()), storedsize) ) {
+            _ifs.clear();
+            throw OPENRAVE_EXCEPTION_FORMAT("failed to read state log chunk %d", ichunk, ORE_InvalidArguments);
+        }
+        DecompressChunk(compression, _vstored, rawsize, _vchunk);
+        _nLoadedChunk = ichunk;
+    }
+
+    std::ifstream _ifs;
+    std::vector<ChunkIndex> _vChunkIndices;
+    std::vector<uint8_t> _vstored, _vchunk; ///< the stored and decompressed data of the chunk _nLoadedChunk
+    int _nLoadedChunk;
+};
+
+} // end namespace binarystatelog
+
+ModuleBasePtr CreateBinaryStateLogger(EnvironmentBasePtr penv, std::istream& sinput) {
+    return ModuleBasePtr(new binarystatelog::BinaryStateLogger(penv,sinput));
+}
+
+ModuleBasePtr CreateBinaryStateReplay(EnvironmentBasePtr penv, std::istream& sinput) {
+    return ModuleBasePtr(new binarystatelog::BinaryStateReplay(penv,sinput));
+}
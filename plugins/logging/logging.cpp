@@ -18,6 +18,9 @@
 #include "logging.h"
 #include "plugindefs.h"
 
+OpenRAVE::ModuleBasePtr CreateBinaryStateLogger(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
+OpenRAVE::ModuleBasePtr CreateBinaryStateReplay(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
+
 #ifdef ENABLE_VIDEORECORDING
 OpenRAVE::ModuleBasePtr CreateViewerRecorder(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
 void DestroyViewerRecordingStaticResources();
@@ -27,6 +30,8 @@ const std::string LoggingPlugin::_pluginname = "LoggingPlugin";
 
 LoggingPlugin::LoggingPlugin()
 {
+    _interfaces[OpenRAVE::PT_Module].push_back("BinaryStateLogger");
+    _interfaces[OpenRAVE::PT_Module].push_back("BinaryStateReplay");
 #ifdef ENABLE_VIDEORECORDING
     _interfaces[OpenRAVE::PT_Module].push_back("ViewerRecorder");
 #endif
@@ -48,6 +53,12 @@ OpenRAVE::InterfaceBasePtr LoggingPlugin::CreateInterface(OpenRAVE::InterfaceTyp
 {
     switch(type) {
     case OpenRAVE::PT_Module:
+        if( interfacename == "binarystatelogger" ) {
+            return CreateBinaryStateLogger(penv,sinput);
+        }
+        else if( interfacename == "binarystatereplay" ) {
+            return CreateBinaryStateReplay(penv,sinput);
+        }
 #ifdef ENABLE_VIDEORECORDING
         if( interfacename == "viewerrecorder" ) {
             return CreateViewerRecorder(penv,sinput);
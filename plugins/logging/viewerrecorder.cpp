@@ -91,14 +91,26 @@ class ViewerRecorder : public ModuleBase
     }
     struct VideoFrame
     {
-        VideoFrame() : _timestamp(0), _bProcessed(false) {
+        VideoFrame() : _timestamp(0), _capturetime(0), _bProcessed(false) {
         }
         vector<uint8_t> _vimagememory;
         int _width, _height, _pixeldepth;
         uint64_t _timestamp;
+        uint64_t _capturetime; ///< real time the frame was copied from the viewer, for the encode latency
         bool _bProcessed;
     };
 
+    struct RecordStatistics
+    {
+        RecordStatistics() : numCaptured(0), numEncoded(0), numDropped(0), numLatencies(0), sumEncodeLatencyUS(0), maxEncodeLatencyUS(0) {
+        }
+        uint64_t numCaptured; ///< frames received from the viewer
+        uint64_t numEncoded; ///< frames written to the video, including repeated frames
+        uint64_t numDropped; ///< frames dropped because the encoder was behind
+        uint64_t numLatencies;
+        uint64_t sumEncodeLatencyUS, maxEncodeLatencyUS; ///< time from the capture of a frame to the end of its encoding
+    };
+
     std::mutex _mutex; // for video data passing
     std::mutex _mutexlibrary; // for video encoding library resources
     std::condition_variable _condnewframe;
@@ -114,21 +126,27 @@ class ViewerRecorder : public ModuleBase
     UserDataPtr _callback;
     int _nUseSimulationTime; // 0 to record as is, 1 to record with respect to simulation, 2 to control simulation to viewer updates
     dReal _fSimulationTimeMultiplier; // how many times to make the simulation time faster
-    list<boost::shared_ptr<VideoFrame> > _listAddFrames, _listFinishedFrames;
+    list<boost::shared_ptr<VideoFrame> > _listAddFrames, _listFinishedFrames; ///< frames waiting to be encoded and frame buffers that can be reused
     boost::shared_ptr<VideoFrame> _frameLastAdded;
+    boost::shared_ptr<VideoFrame> _frameEncoding; ///< frame the record thread is encoding, its memory cannot be reused
+    size_t _nMaxQueuedFrames; ///< when more frames wait to be encoded, the oldest ones are dropped so that the viewer never waits
+    std::string _encodername; ///< if not empty, name of the libavcodec encoder, like h264_nvenc
+    RecordStatistics _statistics; ///< protected by _mutex
 
 public:
     ViewerRecorder(EnvironmentBasePtr penv, std::istream& sinput) : ModuleBase(penv)
     {
         __description = ":Interface Author: Rosen Diankov\n\nRecords the images produced from a viewer into video file. The recordings can be synchronized to real-time or simulation time, by default simulation time is used. Each instance can record only one file at a time. To record multiple files simultaneously, create multiple VideoRecorder instances";
         RegisterCommand("Start",boost::bind(&ViewerRecorder::_StartCommand,this,_1,_2),
-                        "Starts recording a file, this will stop all previous recordings and overwrite any previous files stored in this location. Format::\n\n  Start [width] [height] [framerate] codec [codec] timing [simtime/realtime/controlsimtime[=timestepmult]] viewer [name]\\n filename [filename]\\n\n\nBecause the viewer and filenames can have spaces, the names are ready until a newline is encountered");
+                        "Starts recording a file, this will stop all previous recordings and overwrite any previous files stored in this location. Format::\n\n  Start [width] [height] [framerate] codec [codec] encoder [name] maxqueuedframes [num] timing [simtime/realtime/controlsimtime[=timestepmult]] viewer [name]\\n filename [filename]\\n\n\nBecause the viewer and filenames can have spaces, the names are ready until a newline is encountered. encoder selects a libavcodec encoder by name, like h264_nvenc, the container is then guessed from the filename. maxqueuedframes is the number of frames that can wait to be encoded before the oldest are dropped (default 16).");
         RegisterCommand("Stop",boost::bind(&ViewerRecorder::_StopCommand,this,_1,_2),
                         "Stops recording and saves the file. Format::\n\n  Stop\n\n");
         RegisterCommand("GetCodecs",boost::bind(&ViewerRecorder::_GetCodecsCommand,this,_1,_2),
                         "Return all the possible codecs, one codec per line:[video_codec id] [name]");
         RegisterCommand("SetWatermark",boost::bind(&ViewerRecorder::_SetWatermarkCommand,this,_1,_2),
                         "Set a WxHx4 image as a watermark. Each color is an unsigned integer ordered as A|B|G|R. The origin should be the top left corner");
+        RegisterCommand("GetStatistics",boost::bind(&ViewerRecorder::_GetStatisticsCommand,this,_1,_2),
+                        "Returns the statistics of the current recording::\n\n  numcaptured numencoded numdropped numqueued meanencodelatencyus maxencodelatencyus\n\n");
         _nFrameCount = _nVideoWidth = _nVideoHeight = 0;
         _framerate = 0;
         _nUseSimulationTime = 1;
@@ -137,6 +155,7 @@ public:
         _bContinueThread = true;
         _bStopRecord = true;
         _frameindex = 0;
+        _nMaxQueuedFrames = 16;
 #ifdef _WIN32
         _pfile = NULL;
         _ps = NULL;
@@ -154,6 +173,7 @@ public:
         _outbuf = NULL;
         _picture_size = 0;
         _outbuf_size = 0;
+        _swsctx = NULL;
 #endif
         _threadrecord = boost::make_shared<std::thread>(std::bind(&ViewerRecorder::_RecordThread, this));
     }
@@ -194,6 +214,13 @@ protected:
                 if( cmd == "codec" ) {
                     sinput >> codecid;
                 }
+                else if( cmd == "encoder" ) {
+                    sinput >> _encodername;
+                }
+                else if( cmd == "maxqueuedframes" ) {
+                    sinput >> _nMaxQueuedFrames;
+                    _nMaxQueuedFrames = max(_nMaxQueuedFrames, (size_t)1);
+                }
                 else if( cmd == "filename" ) {
                     if( !getline(sinput, _filename) ) {
                         return false;
@@ -285,46 +312,84 @@ protected:
         return !!sinput;
     }
 
-    void _ViewerImageCallback(const uint8_t* memory, int width, int height, int pixeldepth)
+    bool _GetStatisticsCommand(ostream& sout, istream& sinput)
     {
         std::lock_guard<std::mutex> lock(_mutex);
-        if( !GetEnv() || !_callback ) {
-            // recorder already destroyed and this thread is just remaining
-            return;
+        sout << _statistics.numCaptured << " " << _statistics.numEncoded << " " << _statistics.numDropped << " " << _listAddFrames.size() << " "
+             << (_statistics.numLatencies > 0 ? _statistics.sumEncodeLatencyUS/_statistics.numLatencies : 0) << " " << _statistics.maxEncodeLatencyUS;
+        return true;
+    }
+
+    /// \brief keeps the memory of a frame that is not used anymore for the next captures, _mutex has to be locked
+    void _RecycleFrame(const boost::shared_ptr<VideoFrame>& frame)
+    {
+        if( frame != _frameLastAdded && frame != _frameEncoding && _listFinishedFrames.size() < _nMaxQueuedFrames ) {
+            _listFinishedFrames.push_back(frame);
         }
-        uint64_t timestamp = _nUseSimulationTime ? GetEnv()->GetSimulationTime() : utils::GetMicroTime();
-        boost::shared_ptr<VideoFrame> frame;
+    }
 
-        if( _listAddFrames.size() > 0 ) {
-            BOOST_ASSERT( timestamp-_starttime >= _listAddFrames.back()->_timestamp-_starttime );
-            if( _listAddFrames.back()->_timestamp == timestamp ) {
-                // if the timestamps match, then take the newest frame
-                frame = _listAddFrames.back();
-                _listAddFrames.pop_back();
+    void _ViewerImageCallback(const uint8_t* memory, int width, int height, int pixeldepth)
+    {
+        uint64_t timestamp = 0;
+        boost::shared_ptr<VideoFrame> frame;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if( !GetEnv() || !_callback ) {
+                // recorder already destroyed and this thread is just remaining
+                return;
             }
-        }
-        if( !frame ) {
-            if( _listFinishedFrames.size() > 0 ) {
-                frame = _listFinishedFrames.back();
-                _listFinishedFrames.pop_back();
+            timestamp = _nUseSimulationTime ? GetEnv()->GetSimulationTime() : utils::GetMicroTime();
+
+            if( _listAddFrames.size() > 0 ) {
+                BOOST_ASSERT( timestamp-_starttime >= _listAddFrames.back()->_timestamp-_starttime );
+                if( _listAddFrames.back()->_timestamp == timestamp ) {
+                    // if the timestamps match, then take the newest frame
+                    if( _listAddFrames.back() != _frameLastAdded && _listAddFrames.back() != _frameEncoding ) {
+                        frame = _listAddFrames.back();
+                    }
+                    _listAddFrames.pop_back();
+                }
             }
-            else {
-                frame.reset(new VideoFrame());
+            if( !frame ) {
+                if( _listAddFrames.size() >= _nMaxQueuedFrames ) {
+                    // the encoder is behind, so drop the oldest frame instead of making the viewer wait
+                    _RecycleFrame(_listAddFrames.front());
+                    _listAddFrames.pop_front();
+                    ++_statistics.numDropped;
+                }
+                if( _listFinishedFrames.size() > 0 ) {
+                    frame = _listFinishedFrames.back();
+                    _listFinishedFrames.pop_back();
+                }
+                else {
+                    frame.reset(new VideoFrame());
+                }
             }
+            ++_statistics.numCaptured;
         }
+
+        // copy without _mutex so that the record thread can choose and encode frames meanwhile
         frame->_width = width;
         frame->_height = height;
         frame->_pixeldepth = pixeldepth;
         //RAVELOG_VERBOSE("image frame is %d x %d\n",width,height);
         frame->_timestamp = timestamp;
+        frame->_capturetime = utils::GetMicroTime();
+        frame->_bProcessed = false;
         frame->_vimagememory.resize(width*height*pixeldepth);
         std::copy(memory,memory+width*height*pixeldepth,frame->_vimagememory.begin());
-        _listAddFrames.push_back(frame);
-        if( _starttime == 0 ) {
-            _starttime = timestamp;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if( !_callback ) {
+                return;
+            }
+            _listAddFrames.push_back(frame);
+            if( _starttime == 0 ) {
+                _starttime = timestamp;
+            }
+            RAVELOG_VERBOSE(str(boost::format("new frame %d\n")%(timestamp-_starttime)));
+            _condnewframe.notify_one();
         }
-        RAVELOG_VERBOSE(str(boost::format("new frame %d\n")%(timestamp-_starttime)));
-        _condnewframe.notify_one();
         if( _nUseSimulationTime == 2 ) {
             // calls the environment lock, which might be taken if the environment is destroying the problem
             // therefore need to take it first
@@ -402,6 +467,9 @@ protected:
                     }
                     frame = *itbest;
                     size_t prevsize = _listAddFrames.size();
+                    for(itframe = _listAddFrames.begin(); itframe != itbest; ++itframe) {
+                        _RecycleFrame(*itframe);
+                    }
                     _listAddFrames.erase(_listAddFrames.begin(),itbest);
                     if( frame->_timestamp-_starttime <= _frametime ) {
                         // the frame is before the next mark, so erase it
@@ -410,6 +478,7 @@ protected:
                     RAVELOG_VERBOSE(str(boost::format("frame size: %d -> %d\n")%prevsize%_listAddFrames.size()));
                     numstores = 1;
                 }
+                _frameEncoding = frame;
             }
 
             if( !frame->_bProcessed ) {
@@ -422,11 +491,25 @@ protected:
                 for(uint64_t i = 0; i < numstores; ++i) {
                     _AddFrame(&frame->_vimagememory.at(0));
                 }
-                _frameLastAdded = frame;
             }
             catch(const std::exception& ex) {
                 RAVELOG_WARN("%s\n",ex.what());
             }
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            _frameEncoding.reset();
+            _statistics.numEncoded += numstores;
+            if( frame != _frameLastAdded ) {
+                const uint64_t latency = utils::GetMicroTime() - frame->_capturetime;
+                _statistics.sumEncodeLatencyUS += latency;
+                _statistics.maxEncodeLatencyUS = max(_statistics.maxEncodeLatencyUS, latency);
+                ++_statistics.numLatencies;
+                boost::shared_ptr<VideoFrame> prevframe = _frameLastAdded;
+                _frameLastAdded = frame;
+                if( !!prevframe ) {
+                    _RecycleFrame(prevframe);
+                }
+            }
         }
     }
 
@@ -466,6 +549,9 @@ protected:
             _listFinishedFrames.clear();
             _frameLastAdded.reset();
             _filename = "";
+            _encodername.clear();
+            _nMaxQueuedFrames = 16;
+            _statistics = RecordStatistics();
         }
         {
             RAVELOG_DEBUG("ViewerRecorder _ResetLibrary\n");
@@ -645,6 +731,11 @@ protected:
     int _picture_size;
     int _outbuf_size;
     bool _bWroteURL, _bWroteHeader;
+#ifdef HAVE_NEW_FFMPEG
+    struct SwsContext *_swsctx; ///< converts the viewer images to the pixel format of the encoder, reused for every frame
+#else
+    void *_swsctx;
+#endif
 
     void _ResetLibrary()
     {
@@ -652,6 +743,12 @@ protected:
         free(_picture); _picture = NULL;
         free(_yuv420p); _yuv420p = NULL;
         free(_outbuf); _outbuf = NULL;
+#ifdef HAVE_NEW_FFMPEG
+        if( !!_swsctx ) {
+            sws_freeContext(_swsctx);
+        }
+#endif
+        _swsctx = NULL;
         if( !!_stream ) {
             avcodec_close(_stream->codec);
             _stream = NULL;
@@ -730,7 +827,20 @@ protected:
 #endif
 
         _output = NULL;
-        if ( bFixH264 ) {
+        codec = NULL;
+        if( _encodername.size() > 0 ) {
+            // hardware encoders like h264_nvenc take the same yuv420p frames, only the name selects them
+            codec = avcodec_find_encoder_by_name(_encodername.c_str());
+            if( !codec ) {
+                throw OPENRAVE_EXCEPTION_FORMAT("encoder %s is not supported by libavcodec", _encodername, ORE_InvalidArguments);
+            }
+            video_codec = codec->id;
+            avformat_alloc_output_context2(&_output, NULL, NULL, filename.c_str());
+            if( !_output ) {
+                throw OPENRAVE_EXCEPTION_FORMAT("cannot guess the container of %s", filename, ORE_InvalidArguments);
+            }
+        }
+        else if ( bFixH264 ) {
             avformat_alloc_output_context2(&_output, NULL, "mp4", NULL);
             BOOST_ASSERT(!!_output);
         } else {
@@ -750,7 +860,9 @@ protected:
         
         snprintf(_output->filename, sizeof(_output->filename), "%s", filename.c_str());
 
-        codec = avcodec_find_encoder(video_codec);
+        if( !codec ) {
+            codec = avcodec_find_encoder(video_codec);
+        }
         BOOST_ASSERT(!!codec);
 
 #if LIBAVFORMAT_VERSION_INT >= (54<<16)     
@@ -858,6 +970,24 @@ protected:
             return;
         }
 
+#ifdef HAVE_NEW_FFMPEG
+        // flip vertically by starting at the last row with a negative stride, so the conversion reads the image in place
+        _picture->data[0] = (uint8_t*)pdata + (_stream->codec->height-1)*_stream->codec->width*3;
+        _picture->linesize[0] = -_stream->codec->width * 3;
+
+        // the sizes match, so swscale uses its unscaled simd converters
+#if LIBAVFORMAT_VERSION_INT >= (55<<16)
+        _swsctx = sws_getCachedContext(_swsctx, _stream->codec->width, _stream->codec->height, AV_PIX_FMT_BGR24, _stream->codec->width, _stream->codec->height, AV_PIX_FMT_YUV420P, SWS_FAST_BILINEAR, NULL, NULL, NULL);
+#else
+        _swsctx = sws_getCachedContext(_swsctx, _stream->codec->width, _stream->codec->height, PIX_FMT_BGR24, _stream->codec->width, _stream->codec->height, AV_PIX_FMT_YUV420P, SWS_FAST_BILINEAR, NULL, NULL, NULL);
+#endif
+        if( !_swsctx ) {
+            throw OPENRAVE_EXCEPTION_FORMAT0("ADD_FRAME sws_getCachedContext failed",ORE_Assert);
+        }
+        if (!sws_scale(_swsctx, _picture->data, _picture->linesize, 0, _stream->codec->height, _yuv420p->data, _yuv420p->linesize)) {
+            throw OPENRAVE_EXCEPTION_FORMAT0("ADD_FRAME sws_scale failed",ORE_Assert);
+        }
+#else
         // flip vertically
         static vector<char> newdata;
         newdata.resize(_stream->codec->height*_stream->codec->width*3);
@@ -870,20 +1000,6 @@ protected:
         _picture->data[0] = (uint8_t*)&newdata[0];
         _picture->linesize[0] = _stream->codec->width * 3;
 
-#ifdef HAVE_NEW_FFMPEG
-        struct SwsContext *img_convert_ctx;
-#if LIBAVFORMAT_VERSION_INT >= (55<<16)
-        img_convert_ctx = sws_getContext(_stream->codec->width, _stream->codec->height, AV_PIX_FMT_BGR24, _stream->codec->width, _stream->codec->height, AV_PIX_FMT_YUV420P, SWS_BICUBIC /* flags */, NULL, NULL, NULL);
-#else
-        img_convert_ctx = sws_getContext(_stream->codec->width, _stream->codec->height, PIX_FMT_BGR24, _stream->codec->width, _stream->codec->height, AV_PIX_FMT_YUV420P, SWS_BICUBIC /* flags */, NULL, NULL, NULL);
-#endif
-        if (!sws_scale(img_convert_ctx, _picture->data, _picture->linesize, 0, _stream->codec->height, _yuv420p->data, _yuv420p->linesize)) {
-            sws_freeContext(img_convert_ctx);
-            throw OPENRAVE_EXCEPTION_FORMAT0("ADD_FRAME sws_scale failed",ORE_Assert);
-        }
-
-        sws_freeContext(img_convert_ctx);
-#else
         if( img_convert((AVPicture*)_yuv420p, PIX_FMT_YUV420P, (AVPicture*)_picture, PIX_FMT_BGR24, _stream->codec->width, _stream->codec->height) ) {
             throw OPENRAVE_EXCEPTION_FORMAT0("ADD_FRAME img_convert failed",ORE_Assert);
         }
@@ -17,6 +17,7 @@
 #define RAVE_PHYSICSENGINE_ODE
 
 #include "odespace.h"
+#include <thread>
 
 class ODEPhysicsEngine : public OpenRAVE::PhysicsEngineBase
 {
@@ -148,6 +149,26 @@ public:
                 }
                 RAVELOG_DEBUG("Setting surface layer depth to: %f\n",_physics->_surfacelayer);
             }
+            else if( name == "numthreads" ) {
+                int temp=0;
+                _ss >> temp;
+                // Set the number of threads stepping independent islands, 0 uses the number of hardware threads
+                if (temp >= 0) {
+                    _physics->_numthreads = temp;
+                }
+            }
+            else if( name == "autodisable" ) {
+                _ss >> _physics->_bAutoDisable;
+            }
+            else if( name == "autodisablelinearthreshold" ) {
+                _ss >> _physics->_autodisablelinearthreshold;
+            }
+            else if( name == "autodisableangularthreshold" ) {
+                _ss >> _physics->_autodisableangularthreshold;
+            }
+            else if( name == "autodisablesteps" ) {
+                _ss >> _physics->_autodisablesteps;
+            }
             else {
                 RAVELOG_ERROR("unknown field %s\n", name.c_str());
             }
@@ -170,8 +191,8 @@ public:
             }
         }
 
-        static const boost::array<string, 11>& GetTags() {
-            static const boost::array<string, 11> tags = {{"friction","selfcollision", "gravity", "contact", "erp", "cfm", "elastic_reduction_parameter", "constraint_force_mixing", "dcontactapprox", "numiterations", "surfacelayer" }};
+        static const boost::array<string, 16>& GetTags() {
+            static const boost::array<string, 16> tags = {{"friction","selfcollision", "gravity", "contact", "erp", "cfm", "elastic_reduction_parameter", "constraint_force_mixing", "dcontactapprox", "numiterations", "surfacelayer", "numthreads", "autodisable", "autodisablelinearthreshold", "autodisableangularthreshold", "autodisablesteps" }};
             return tags;
         }
 
@@ -199,8 +220,11 @@ It is possible to set ODE physics engine and its properties inside the <environm
       <selfcollision>1</selfcollision>\n\
       <dcontactapprox>1</dcontactapprox>\n\
       <numiterations>1</numiterations>\n\
+      <numthreads>4</numthreads>\n\
+      <autodisable>1</autodisable>\n\
     </odeproperties>\n\
   </physicsengine>\n\n\
+Bodies that do not touch each other form independent islands, which are stepped concurrently on **numthreads** threads when ODE has a threading implementation. With **autodisable**, the islands that come to rest are put to sleep and skipped until something touches them, so the cost of a step scales with the moving bodies.\n\n\
 The possible properties that can be set are: ";
         FOREACHC(it, PhysicsPropertiesXMLReader::GetTags()) {
             ss << "**" << *it << "**, ";
@@ -216,6 +240,15 @@ The possible properties that can be set are: ";
         _surface_mode = 0;
         _surfacelayer = 0.001;
         _options = OpenRAVE::PEO_SelfCollisions;
+        _numthreads = 1;
+        _bAutoDisable = false;
+        _autodisablelinearthreshold = 0.01;
+        _autodisableangularthreshold = 0.01;
+        _autodisablesteps = 10;
+#ifdef ODE_HAVE_THREADING_IMPLEMENTATION
+        _threading = NULL;
+        _threadpool = NULL;
+#endif
 
         memset(_jointadd, 0, sizeof(_jointadd));
         _jointadd[dJointTypeBall] = DummyAddForce;
@@ -235,6 +268,7 @@ The possible properties that can be set are: ";
         _jointgetvel[dJointTypeHinge2].push_back(dJointGetHinge2Angle2Rate);
     }
     virtual ~ODEPhysicsEngine() {
+        _DestroyStepThreading();
         _odespace->Destroy();
     }
 
@@ -260,6 +294,7 @@ The possible properties that can be set are: ";
         dWorldSetCFM(_odespace->GetWorld(),_globalcfm);
         dWorldSetQuickStepNumIterations (_odespace->GetWorld(), _num_iterations);
         dWorldSetContactSurfaceLayer(_odespace->GetWorld(), _surfacelayer);
+        _UpdateIslandParameters();
         return true;
     }
 
@@ -267,6 +302,7 @@ The possible properties that can be set are: ";
     {
         _listcallbacks.clear();
         _report.reset();
+        _DestroyStepThreading();
         _odespace->DestroyEnvironment();
         vector<KinBodyPtr> vbodies;
         GetEnv()->GetBodies(vbodies);
@@ -321,10 +357,16 @@ The possible properties that can be set are: ";
         _globalerp = r->_globalerp;
         _surface_mode = r->_surface_mode;
         _num_iterations = r->_num_iterations;
+        _numthreads = r->_numthreads;
+        _bAutoDisable = r->_bAutoDisable;
+        _autodisablelinearthreshold = r->_autodisablelinearthreshold;
+        _autodisableangularthreshold = r->_autodisableangularthreshold;
+        _autodisablesteps = r->_autodisablesteps;
         if( !!_odespace && _odespace->IsInitialized() ) {
             dWorldSetERP(_odespace->GetWorld(),_globalerp);
             dWorldSetCFM(_odespace->GetWorld(),_globalcfm);
             dWorldSetQuickStepNumIterations (_odespace->GetWorld(), _num_iterations);
+            _UpdateIslandParameters();
         }
     }
 
@@ -524,6 +566,18 @@ The possible properties that can be set are: ";
             ODESpace::KinBodyInfoPtr pinfo = _odespace->GetInfo(*itbody);
             BOOST_ASSERT( pinfo->vlinks.size() == (*itbody)->GetLinks().size());
             if( (*itbody)->IsEnabled() ) {
+                // the bodies of sleeping islands and static links are not moved by the step
+                bool bMoved = false;
+                FOREACHC(itlink, pinfo->vlinks) {
+                    if( dBodyIsEnabled((*itlink)->body) ) {
+                        bMoved = true;
+                        break;
+                    }
+                }
+                if( !bMoved ) {
+                    pinfo->nLastStamp = (*itbody)->GetUpdateStamp();
+                    continue;
+                }
                 vector<Transform> vtrans(pinfo->vlinks.size());
                 for(size_t i = 0; i < pinfo->vlinks.size(); ++i) {
                     const dReal* prot = dBodyGetQuaternion(pinfo->vlinks[i]->body);
@@ -640,12 +694,12 @@ private:
             //        contact[i].surface.soft_cfm = 0.04;
             dJointID c = dJointCreateContact (_odespace->GetWorld(),_odespace->GetContactGroup(),contact+i);
 
-            // make sure that static objects are not enabled by adding a joint attaching them
+            // make sure that static objects are not enabled by adding a joint attaching them. Sleeping bodies are attached so that the island wakes them up.
             if( b1 ) {
-                b1 = dBodyIsEnabled(b1) ? b1 : 0;
+                b1 = _IsDynamicBody(b1) ? b1 : 0;
             }
             if( b2 ) {
-                b2 = dBodyIsEnabled(b2) ? b2 : 0;
+                b2 = _IsDynamicBody(b2) ? b2 : 0;
             }
             dJointAttach (c, b1, b2);
 
@@ -667,6 +721,67 @@ private:
         //        dJointAttach (c,b1,b2);
     }
 
+    /// \brief true if the body is moved by the simulation, false for static and disabled links. Bodies put to sleep by auto-disable are dynamic.
+    static bool _IsDynamicBody(dBodyID body)
+    {
+        if( dBodyIsEnabled(body) ) {
+            return true;
+        }
+        const ODESpace::KinBodyInfo::LINK* plink = (const ODESpace::KinBodyInfo::LINK*)dBodyGetData(body);
+        return !!plink && plink->_bEnabled;
+    }
+
+    /// \brief sets the auto-disable parameters and the threading implementation of the world
+    void _UpdateIslandParameters()
+    {
+        dWorldID world = _odespace->GetWorld();
+        dWorldSetAutoDisableFlag(world, _bAutoDisable);
+        dWorldSetAutoDisableLinearThreshold(world, _autodisablelinearthreshold);
+        dWorldSetAutoDisableAngularThreshold(world, _autodisableangularthreshold);
+        dWorldSetAutoDisableSteps(world, _autodisablesteps);
+        dWorldSetAutoDisableTime(world, 0);
+
+        _DestroyStepThreading();
+        int numthreads = _numthreads > 0 ? _numthreads : (int)std::thread::hardware_concurrency();
+        if( numthreads <= 1 ) {
+            return;
+        }
+#ifdef ODE_HAVE_THREADING_IMPLEMENTATION
+        _threading = dThreadingAllocateMultiThreadedImplementation();
+        _threadpool = dThreadingAllocateThreadPool(numthreads, 0, dAllocateFlagBasicData, NULL);
+        if( !_threading || !_threadpool ) {
+            RAVELOG_WARN_FORMAT("env=%s, failed to allocate %d ode threads, stepping islands on one thread", GetEnv()->GetNameId()%numthreads);
+            _DestroyStepThreading();
+            return;
+        }
+        dThreadingThreadPoolServeMultiThreadedImplementation(_threadpool, _threading);
+        dWorldSetStepThreadingImplementation(world, dThreadingImplementationGetFunctions(_threading), _threading);
+        dWorldSetStepIslandsProcessingMaxThreadCount(world, numthreads);
+#else
+        RAVELOG_WARN_FORMAT("env=%s, ode was built without a threading implementation, stepping islands on one thread instead of %d", GetEnv()->GetNameId()%numthreads);
+#endif
+    }
+
+    void _DestroyStepThreading()
+    {
+#ifdef ODE_HAVE_THREADING_IMPLEMENTATION
+        if( !!_threading ) {
+            dThreadingImplementationShutdownProcessing(_threading);
+        }
+        if( !!_threadpool ) {
+            dThreadingFreeThreadPool(_threadpool);
+            _threadpool = NULL;
+        }
+        if( !!_threading ) {
+            if( !!_odespace && _odespace->IsInitialized() ) {
+                dWorldSetStepThreadingImplementation(_odespace->GetWorld(), NULL, NULL);
+            }
+            dThreadingFreeImplementation(_threading);
+            _threading = NULL;
+        }
+#endif
+    }
+
     void _SyncCallback(ODESpace::KinBodyInfoConstPtr pinfo)
     {
         // things very difficult when dynamics are not reset
@@ -696,6 +811,14 @@ private:
     float _surfacelayer;  ///> Surface layer depth
 
     int _num_iterations; ///> Max QuickStep iterations for each timestep
+    int _numthreads; ///> number of threads stepping independent islands, 0 uses the number of hardware threads
+    bool _bAutoDisable; ///> if true, islands at rest are put to sleep until touched
+    dReal _autodisablelinearthreshold, _autodisableangularthreshold; ///> velocities below which a body is considered at rest
+    int _autodisablesteps; ///> number of steps a body has to be at rest before it is put to sleep
+#ifdef ODE_HAVE_THREADING_IMPLEMENTATION
+    dThreadingImplementationID _threading;
+    dThreadingThreadPoolID _threadpool;
+#endif
 
     typedef void (*JointSetFn)(dJointID, int param, dReal val);
     typedef dReal (*JointGetFn)(dJointID);
@@ -18,6 +18,8 @@
 
 //#include <boost/thread/tss.hpp>
 
+static const dReal g_fSyncEpsilon = 1e-9; ///< smallest change of a link pose written to the ode world
+
 // manages a space of ODE objects
 class ODESpace : public boost::enable_shared_from_this<ODESpace>
 {
@@ -695,21 +697,37 @@ private:
             if( block ) {
                 lockode = boost::make_shared<std::unique_lock<std::mutex>>(_ode->_mutex);
             }
-            vector<Transform> vtrans;
             KinBodyPtr pbody = pinfo->GetBody();
-            pbody->GetLinkTransformations(vtrans, pinfo->_vdofbranches);
+            pbody->GetLinkTransformations(_vtranscache, pinfo->_vdofbranches);
             pinfo->nLastStamp = pbody->GetUpdateStamp();
-            BOOST_ASSERT( vtrans.size() == pinfo->vlinks.size() );
-            for(size_t i = 0; i < vtrans.size(); ++i) {
-                RaveTransform<dReal> t = vtrans[i] * pinfo->vlinks[i]->tlinkmass;
+            BOOST_ASSERT( _vtranscache.size() == pinfo->vlinks.size() );
+            for(size_t i = 0; i < _vtranscache.size(); ++i) {
+                KinBodyInfo::LINK& link = *pinfo->vlinks[i];
+                // update stamps also reflect enable links
+                link.Enable(link.GetLink()->IsEnabled());
+
+                // most stamp changes only move some of the links, so leave the others untouched in the world
+                RaveTransform<dReal> t = _vtranscache[i] * link.tlinkmass;
                 BOOST_ASSERT( RaveFabs(t.rot.lengthsqr4()-1) < 0.0001f );
-                dBodySetQuaternion(pinfo->vlinks[i]->body, &t.rot[0]);
-                dBodySetPosition(pinfo->vlinks[i]->body, t.trans.x, t.trans.y, t.trans.z);
-            }
-
-            // update stamps also reflect enable links
-            FOREACH(it, pinfo->vlinks) {
-                (*it)->Enable((*it)->GetLink()->IsEnabled());
+                const dReal* prot = dBodyGetQuaternion(link.body);
+                const dReal* ptrans = dBodyGetPosition(link.body);
+                // the round trip through the mass frame is not exact, so compare with a tolerance
+                bool bMoved = false;
+                for(int j = 0; j < 4 && !bMoved; ++j) {
+                    bMoved = RaveFabs(prot[j] - t.rot[j]) > g_fSyncEpsilon;
+                }
+                for(int j = 0; j < 3 && !bMoved; ++j) {
+                    bMoved = RaveFabs(ptrans[j] - t.trans[j]) > g_fSyncEpsilon;
+                }
+                if( !bMoved ) {
+                    continue;
+                }
+                dBodySetQuaternion(link.body, &t.rot[0]);
+                dBodySetPosition(link.body, t.trans.x, t.trans.y, t.trans.z);
+                if( link._bEnabled && !dBodyIsEnabled(link.body) ) {
+                    // wake up the links put to sleep by auto-disable since they were moved
+                    dBodyEnable(link.body);
+                }
             }
             if( !!_synccallback ) {
                 _synccallback(pinfo);
@@ -735,6 +753,7 @@ private:
     std::string _geometrygroup;
     SynchronizeCallbackFn _synccallback;
     std::set<KinBodyConstPtr> _setInitializedBodies; ///< set of bodies that have been initialized and user data is set
+    std::vector<Transform> _vtranscache; ///< cache
     bool _bUsingPhysics;
 };
 
@@ -19,6 +19,81 @@
 
 #include "pqp/PQP.h"
 #include <boost/lexical_cast.hpp>
+#include <boost/bind/bind.hpp>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+/// \brief PQP models of the link meshes, shared by all the pqp checkers of the process
+///
+/// Cloned environments have the same link meshes, so their checkers share the models instead of rebuilding the bounding volume hierarchies. A model is kept only as long as a checker uses it.
+/// PQP_Distance writes the last closest triangle into the models as a starting guess for the next query, this is the only state of the models modified by the queries.
+class PQPModelCache
+{
+public:
+    /// \brief returns the model of the mesh, builds it if no checker uses it yet
+    boost::shared_ptr<PQP_Model> GetModel(const TriMesh& trimesh)
+    {
+        if( trimesh.indices.size() == 0 ) {
+            return boost::shared_ptr<PQP_Model>();
+        }
+        // the compact meshes are shared by everyone holding the same mesh, so comparing them is comparing pointers
+        TriMeshCompactConstPtr pcompactmesh = TriMeshCompact::Create(trimesh);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::pair<std::multimap<size_t, Entry>::iterator, std::multimap<size_t, Entry>::iterator> itrange = _mapModels.equal_range(pcompactmesh->GetHash());
+        for(std::multimap<size_t, Entry>::iterator it = itrange.first; it != itrange.second; ++it) {
+            if( it->second.pcompactmesh == pcompactmesh ) {
+                boost::shared_ptr<PQP_Model> pmodel = it->second.pmodel.lock();
+                if( !!pmodel ) {
+                    return pmodel;
+                }
+            }
+        }
+
+        // remove the models that are not used anymore
+        for(std::multimap<size_t, Entry>::iterator it = _mapModels.begin(); it != _mapModels.end(); ) {
+            if( it->second.pmodel.expired() ) {
+                _mapModels.erase(it++);
+            }
+            else {
+                ++it;
+            }
+        }
+
+        boost::shared_ptr<PQP_Model> pmodel(new PQP_Model());
+        PQP_REAL p1[3], p2[3], p3[3];
+        pmodel->BeginModel(trimesh.indices.size()/3);
+        for(int j = 0; j < (int)trimesh.indices.size(); j+=3) {
+            p1[0] = trimesh.vertices[trimesh.indices[j]].x;     p1[1] = trimesh.vertices[trimesh.indices[j]].y;     p1[2] = trimesh.vertices[trimesh.indices[j]].z;
+            p2[0] = trimesh.vertices[trimesh.indices[j+1]].x;   p2[1] = trimesh.vertices[trimesh.indices[j+1]].y;     p2[2] = trimesh.vertices[trimesh.indices[j+1]].z;
+            p3[0] = trimesh.vertices[trimesh.indices[j+2]].x;   p3[1] = trimesh.vertices[trimesh.indices[j+2]].y;     p3[2] = trimesh.vertices[trimesh.indices[j+2]].z;
+            pmodel->AddTri(p1, p2, p3, j/3);
+        }
+        pmodel->EndModel();
+
+        Entry& entry = _mapModels.insert(std::make_pair(pcompactmesh->GetHash(), Entry()))->second;
+        entry.pcompactmesh = pcompactmesh;
+        entry.pmodel = pmodel;
+        return pmodel;
+    }
+
+private:
+    struct Entry
+    {
+        TriMeshCompactConstPtr pcompactmesh; ///< the mesh the model was built from
+        boost::weak_ptr<PQP_Model> pmodel;
+    };
+
+    std::mutex _mutex;
+    std::multimap<size_t, Entry> _mapModels; ///< indexed by the hash of the mesh
+};
+
+inline PQPModelCache& GetPQPModelCache()
+{
+    static PQPModelCache s_cache;
+    return s_cache;
+}
 
 //wrapper class for PQP, distance and tolerance checking is _off_ by default, collision checking is _on_ by default
 class CollisionCheckerPQP : public CollisionCheckerBase
@@ -48,16 +123,33 @@ public:
         _rel_err = 200.0;     //temporary change
         _abs_err = 0.001;       //temporary change
         _tolerance = 0.0;
+        _options = 0;
 
         //enable or disable various features
         _benablecol = true;
         _benabledis = false;
         _benabletol = false;
+        _numBatchThreads = 1;
+
+        RegisterTypedCommand("GetLinkPairDistances", &CollisionCheckerPQP::_GetLinkPairDistancesTypedCommand, "input vintvalues holds the environment body index and link index of both links of every pair (4 values per pair). Output vrealvalues holds for every pair the distance followed by the closest points of the first and second links in the world frame (7 values per pair), the distance is -1 if a link is disabled or has no geometry. If input vrealvalues holds a tolerance, only checks if the pairs are closer than it and output vintvalues holds 1 for these pairs and 0 for the others.");
+        RegisterCommand("SetBatchNumThreads", boost::bind(&CollisionCheckerPQP::_SetBatchNumThreadsCommand, this, boost::placeholders::_1, boost::placeholders::_2), "sets the number of threads the pairs of GetLinkPairDistances are split into, 1 runs them in the calling thread");
     }
     virtual ~CollisionCheckerPQP() {
         DestroyEnvironment();
     }
 
+    virtual void Clone(InterfaceBaseConstPtr preference, int cloningoptions)
+    {
+        CollisionCheckerBase::Clone(preference, cloningoptions);
+        boost::shared_ptr<CollisionCheckerPQP const> r = boost::dynamic_pointer_cast<CollisionCheckerPQP const>(preference);
+        SetCollisionOptions(r->_options);
+        _benabletol = r->_benabletol;
+        _tolerance = r->_tolerance;
+        _rel_err = r->_rel_err;
+        _abs_err = r->_abs_err;
+        _numBatchThreads = r->_numBatchThreads;
+    }
+
     virtual bool InitEnvironment()
     {
         RAVELOG_DEBUG("creating pqp collision\n");
@@ -99,23 +191,9 @@ public:
         pinfo->_pbody = boost::const_pointer_cast<KinBody>(pbody);
         pbody->SetUserData(_userdatakey, pinfo);
 
-        PQP_REAL p1[3], p2[3], p3[3];
         pinfo->vlinks.reserve(pbody->GetLinks().size());
         FOREACHC(itlink, pbody->GetLinks()) {
-            const TriMesh& trimesh = (*itlink)->GetCollisionData();
-            boost::shared_ptr<PQP_Model> pm;
-            if( trimesh.indices.size() > 0 ) {
-                pm.reset(new PQP_Model());
-                pm->BeginModel(trimesh.indices.size()/3);
-                for(int j = 0; j < (int)trimesh.indices.size(); j+=3) {
-                    p1[0] = trimesh.vertices[trimesh.indices[j]].x;     p1[1] = trimesh.vertices[trimesh.indices[j]].y;     p1[2] = trimesh.vertices[trimesh.indices[j]].z;
-                    p2[0] = trimesh.vertices[trimesh.indices[j+1]].x;   p2[1] = trimesh.vertices[trimesh.indices[j+1]].y;     p2[2] = trimesh.vertices[trimesh.indices[j+1]].z;
-                    p3[0] = trimesh.vertices[trimesh.indices[j+2]].x;   p3[1] = trimesh.vertices[trimesh.indices[j+2]].y;     p3[2] = trimesh.vertices[trimesh.indices[j+2]].z;
-                    pm->AddTri(p1, p2, p3, j/3);
-                }
-                pm->EndModel();
-            }
-            pinfo->vlinks.push_back(pm);
+            pinfo->vlinks.push_back(GetPQPModelCache().GetModel((*itlink)->GetCollisionData()));
         }
 
         return true;
@@ -573,9 +651,9 @@ private:
             }
 
             if(!report) {
-                PQP_CollideResult _colres;
-                PQP_Collide(&_colres,R1,T1,m1.get(),R2,T2,m2.get());
-                if(_colres.NumPairs() > 0) {
+                // without report, only whether there is a contact matters
+                PQP_Collide(&colres,R1,T1,m1.get(),R2,T2,m2.get(),PQP_FIRST_CONTACT);
+                if(colres.NumPairs() > 0) {
                     bcollision = true;
                 }
             }
@@ -666,6 +744,121 @@ private:
         }
     }
 
+    /// \brief models and world poses of the links of a pair of GetLinkPairDistances
+    struct LinkPairQuery
+    {
+        boost::shared_ptr<PQP_Model> pmodel1, pmodel2; ///< empty if the link is disabled or has no geometry
+        PQP_REAL R1[3][3], T1[3], R2[3][3], T2[3];
+    };
+
+    /// \brief fills the model and pose of a link of a pair, false if the indices are not valid
+    bool _InitLinkPairQuery(int64_t bodyindex, int64_t linkindex, boost::shared_ptr<PQP_Model>& pmodel, PQP_REAL R[3][3], PQP_REAL T[3])
+    {
+        KinBodyPtr pbody;
+        if( bodyindex > 0 && bodyindex <= std::numeric_limits<int>::max() ) {
+            pbody = GetEnv()->GetBodyFromEnvironmentBodyIndex((int)bodyindex);
+        }
+        if( !pbody || linkindex < 0 || linkindex >= (int64_t)pbody->GetLinks().size() ) {
+            RAVELOG_WARN_FORMAT("env=%s, invalid link pair body index %d link index %d", GetEnv()->GetNameId()%bodyindex%linkindex);
+            return false;
+        }
+        _InitKinBody(pbody);
+        const KinBody::LinkPtr& plink = pbody->GetLinks()[linkindex];
+        if( plink->IsEnabled() ) {
+            pmodel = GetLinkModel(plink);
+        }
+        else {
+            pmodel.reset();
+        }
+        GetPQPTransformFromTransform(plink->GetTransform(), R, T);
+        return true;
+    }
+
+    /// \brief runs the queries of _vLinkPairQueriesCache, split between _numBatchThreads threads
+    ///
+    /// Every thread has its own PQP results and writes to its own elements of output, the environment is not accessed.
+    void _RunLinkPairQueries(bool bTolerance, PQP_REAL tolerance, TypedCommandData& output)
+    {
+        const size_t numpairs = _vLinkPairQueriesCache.size();
+        if( bTolerance ) {
+            output.vintvalues.resize(numpairs);
+        }
+        else {
+            output.vrealvalues.resize(7*numpairs);
+        }
+        std::atomic<size_t> nextpair(0);
+        const auto fnrun = [&]() {
+            PQP_DistanceResult threaddisres;
+            PQP_ToleranceResult threadtolres;
+            for(size_t ipair = nextpair++; ipair < numpairs; ipair = nextpair++) {
+                LinkPairQuery& query = _vLinkPairQueriesCache[ipair];
+                if( bTolerance ) {
+                    output.vintvalues[ipair] = 0;
+                    if( !!query.pmodel1 && !!query.pmodel2 ) {
+                        PQP_Tolerance(&threadtolres, query.R1, query.T1, query.pmodel1.get(), query.R2, query.T2, query.pmodel2.get(), tolerance);
+                        output.vintvalues[ipair] = threadtolres.CloserThanTolerance() ? 1 : 0;
+                    }
+                    continue;
+                }
+                dReal* pvalues = &output.vrealvalues[7*ipair];
+                if( !query.pmodel1 || !query.pmodel2 ) {
+                    pvalues[0] = -1;
+                    std::fill(pvalues+1, pvalues+7, dReal(0));
+                    continue;
+                }
+                PQP_Distance(&threaddisres, query.R1, query.T1, query.pmodel1.get(), query.R2, query.T2, query.pmodel2.get(), _rel_err, _abs_err);
+                const Vector p1 = PQPRealToVector(threaddisres.P1(), query.R1, query.T1);
+                const Vector p2 = PQPRealToVector(threaddisres.P2(), query.R2, query.T2);
+                pvalues[0] = threaddisres.Distance();
+                pvalues[1] = p1.x; pvalues[2] = p1.y; pvalues[3] = p1.z;
+                pvalues[4] = p2.x; pvalues[5] = p2.y; pvalues[6] = p2.z;
+            }
+        };
+
+        const int numthreads = (int)std::min((size_t)_numBatchThreads, numpairs);
+        std::vector<std::thread> vthreads;
+        for(int ithread = 1; ithread < numthreads; ++ithread) {
+            vthreads.emplace_back(fnrun);
+        }
+        fnrun();
+        FOREACH(itthread, vthreads) {
+            itthread->join();
+        }
+    }
+
+    static bool _GetLinkPairDistancesTypedCommand(InterfaceBase& interfacebase, const TypedCommandData& input, TypedCommandData& output)
+    {
+        if( input.vintvalues.size() % 4 != 0 || input.vrealvalues.size() > 1 ) {
+            return false;
+        }
+        CollisionCheckerPQP& checker = static_cast<CollisionCheckerPQP&>(interfacebase);
+        const size_t numpairs = input.vintvalues.size()/4;
+        checker._vLinkPairQueriesCache.resize(numpairs);
+        for(size_t ipair = 0; ipair < numpairs; ++ipair) {
+            LinkPairQuery& query = checker._vLinkPairQueriesCache[ipair];
+            const int64_t* pindices = &input.vintvalues[4*ipair];
+            if( !checker._InitLinkPairQuery(pindices[0], pindices[1], query.pmodel1, query.R1, query.T1) || !checker._InitLinkPairQuery(pindices[2], pindices[3], query.pmodel2, query.R2, query.T2) ) {
+                checker._vLinkPairQueriesCache.resize(0);
+                return false;
+            }
+        }
+        checker._RunLinkPairQueries(input.vrealvalues.size() == 1, input.vrealvalues.size() == 1 ? input.vrealvalues[0] : 0, output);
+        // do not keep the models alive
+        checker._vLinkPairQueriesCache.resize(0);
+        return true;
+    }
+
+    bool _SetBatchNumThreadsCommand(std::ostream& sout, std::istream& sinput)
+    {
+        int numthreads = 0;
+        sinput >> numthreads;
+        if( !sinput || numthreads < 1 ) {
+            return false;
+        }
+        _numBatchThreads = numthreads;
+        return true;
+    }
+
     int _options;
 
     //pqp parameters
@@ -685,6 +878,9 @@ private:
     bool _benabletol;
     PQP_ToleranceResult tolres;
 
+    int _numBatchThreads; ///< number of threads of GetLinkPairDistances
+    std::vector<LinkPairQuery> _vLinkPairQueriesCache;
+
     //for collision reporting
     Vector u1, u2, u3, v1, v2, v3;
     Vector contactpos, contactnorm;
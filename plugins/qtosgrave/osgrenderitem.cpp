@@ -19,13 +19,196 @@
 #include "osgrenderitem.h"
 #include "osglodlabel.h"
 #include <osgUtil/SmoothingVisitor>
+#include <osgUtil/Simplifier>
+#include <osg/LOD>
 #include <osg/BlendFunc>
 #include <osg/PolygonOffset>
 #include <osg/LineStipple>
 #include <osg/Depth>
+#include <osg/observer_ptr>
+
+#include <boost/functional/hash.hpp>
+#include <mutex>
 
 namespace qtosgrave {
 
+/// \brief geodes of the geometries shared by all the bodies, so identical meshes are built, smoothed and uploaded to the gpu once
+///
+/// The key holds the type and the dimensions of the geometry, and for meshes their sizes and a hash of their vertices and indices.
+/// Only observers are kept, so a geode is released when the last body using it is unloaded. The material of every body is set on
+/// the parent group of the geode, so sharing does not mix the colors of the bodies.
+/// The simplified levels of detail of large meshes and render files are kept in the same cache, see _CreateLODNode.
+class SharedGeodeCache
+{
+public:
+    static SharedGeodeCache& GetInstance()
+    {
+        static SharedGeodeCache s_cache;
+        return s_cache;
+    }
+
+    template <typename CreateGeodeFn>
+    osg::ref_ptr<osg::Geode> GetOrCreateGeode(const std::string& key, const CreateGeodeFn& fncreate)
+    {
+        return GetOrCreateNode<osg::Geode>(key, fncreate);
+    }
+
+    /// \brief same as GetOrCreateGeode for any node type, the key has to identify the type of the node
+    template <typename NodeType, typename CreateNodeFn>
+    osg::ref_ptr<NodeType> GetOrCreateNode(const std::string& key, const CreateNodeFn& fncreate)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        osg::ref_ptr<osg::Node> node;
+        std::map<std::string, osg::observer_ptr<osg::Node> >::iterator it = _mapgeodes.find(key);
+        if( it != _mapgeodes.end() && it->second.lock(node) ) {
+            return osg::ref_ptr<NodeType>(static_cast<NodeType*>(node.get()));
+        }
+        osg::ref_ptr<NodeType> newnode = fncreate();
+        _mapgeodes[key] = newnode.get();
+        if( _mapgeodes.size() >= 2*_numlivegeodes ) {
+            // remove the released geodes once the map doubled since the last time
+            for(it = _mapgeodes.begin(); it != _mapgeodes.end(); ) {
+                if( !it->second.valid() ) {
+                    _mapgeodes.erase(it++);
+                }
+                else {
+                    ++it;
+                }
+            }
+            _numlivegeodes = std::max(_mapgeodes.size(), (size_t)64);
+        }
+        return newnode;
+    }
+
+private:
+    SharedGeodeCache() : _numlivegeodes(64) {
+    }
+
+    std::mutex _mutex;
+    std::map<std::string, osg::observer_ptr<osg::Node> > _mapgeodes;
+    size_t _numlivegeodes; ///< number of entries after the last cleanup
+};
+
+static std::string _GetMeshGeodeKey(const TriMesh& mesh)
+{
+    size_t hash = 0;
+    for(size_t i = 0; i < mesh.vertices.size(); ++i) {
+        // the geometry stores floats, so meshes differing only beyond float precision render the same
+        boost::hash_combine(hash, (float)mesh.vertices[i].x);
+        boost::hash_combine(hash, (float)mesh.vertices[i].y);
+        boost::hash_combine(hash, (float)mesh.vertices[i].z);
+    }
+    boost::hash_range(hash, mesh.indices.begin(), mesh.indices.end());
+    return str(boost::format("mesh %d %d %x")%mesh.vertices.size()%mesh.indices.size()%hash);
+}
+
+static osg::ref_ptr<osg::Geode> _CreateShapeGeode(osg::Shape* pshape)
+{
+    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+    osg::ref_ptr<osg::ShapeDrawable> sd = new osg::ShapeDrawable(pshape);
+    geode->addDrawable(sd.get());
+    return geode;
+}
+
+static osg::ref_ptr<osg::Geode> _CreateMeshGeode(const TriMesh& mesh)
+{
+    osg::ref_ptr<osg::Geometry> geom = new osg::Geometry;
+    // buffer objects are shared by every instance of the geode, display lists would be compiled per geometry anyway
+    geom->setUseDisplayList(false);
+    geom->setUseVertexBufferObjects(true);
+
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array();
+    vertices->reserveArray(mesh.vertices.size());
+    for(size_t i = 0; i < mesh.vertices.size(); ++i) {
+        RaveVector<float> v = mesh.vertices[i];
+        vertices->push_back(osg::Vec3(v.x, v.y, v.z));
+    }
+    geom->setVertexArray(vertices.get());
+
+    osg::DrawElementsUInt* geom_prim = new osg::DrawElementsUInt(osg::PrimitiveSet::TRIANGLES, mesh.indices.size());
+    for(size_t i = 0; i < mesh.indices.size(); ++i) {
+        (*geom_prim)[i] = mesh.indices[i];
+    }
+    geom->addPrimitiveSet(geom_prim);
+
+    osgUtil::SmoothingVisitor::smooth(*geom); // compute vertex normals
+    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+    geode->addDrawable(geom);
+    return geode;
+}
+
+/// \brief meshes with fewer triangles are always rendered at full resolution
+static const size_t s_nLODMinTriangles = 20000;
+
+/// \brief fraction of the triangles kept by every simplified level of detail, and the size in pixels on screen below which the level is used
+static const float s_fLODSampleRatios[] = { 0.25f, 0.05f };
+static const float s_fLODPixelSizes[] = { 300.0f, 60.0f };
+
+/// \brief counts the triangles of all the geometries under a node
+class TriangleCountVisitor : public osg::NodeVisitor
+{
+public:
+    TriangleCountVisitor() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN), numtriangles(0) {
+    }
+
+    virtual void apply(osg::Geode& geode)
+    {
+        for(unsigned int idrawable = 0; idrawable < geode.getNumDrawables(); ++idrawable) {
+            const osg::Geometry* pgeometry = geode.getDrawable(idrawable)->asGeometry();
+            if( !pgeometry ) {
+                continue;
+            }
+            for(unsigned int iprimitive = 0; iprimitive < pgeometry->getNumPrimitiveSets(); ++iprimitive) {
+                const osg::PrimitiveSet* pprimitiveset = pgeometry->getPrimitiveSet(iprimitive);
+                if( pprimitiveset->getMode() == osg::PrimitiveSet::TRIANGLES || pprimitiveset->getMode() == osg::PrimitiveSet::TRIANGLE_STRIP
+                    || pprimitiveset->getMode() == osg::PrimitiveSet::TRIANGLE_FAN || pprimitiveset->getMode() == osg::PrimitiveSet::QUADS
+                    || pprimitiveset->getMode() == osg::PrimitiveSet::POLYGON ) {
+                    numtriangles += pprimitiveset->getNumPrimitives();
+                }
+            }
+        }
+    }
+
+    size_t numtriangles;
+};
+
+/// \brief returns a copy of node keeping sampleratio of its triangles, simplified by edge collapse
+static osg::ref_ptr<osg::Node> _CreateSimplifiedNode(const osg::Node& node, float sampleratio)
+{
+    osg::ref_ptr<osg::Node> psimplified = static_cast<osg::Node*>(node.clone(osg::CopyOp::DEEP_COPY_ALL));
+    osgUtil::Simplifier simplifier(sampleratio);
+    simplifier.setDoTriStrip(false); // keep the triangle lists of the buffer objects, stripping millions of triangles takes longer than the simplification
+    psimplified->accept(simplifier);
+    return psimplified;
+}
+
+/// \brief returns a node switching between pfull and its simplified copies depending on its size on screen
+///
+/// The simplified copies are cached under key, so a large mesh or render file is only simplified once per process. If pfull has
+/// less than s_nLODMinTriangles triangles, it is returned as is.
+static osg::ref_ptr<osg::Node> _CreateLODNode(osg::ref_ptr<osg::Node> pfull, const std::string& key)
+{
+    TriangleCountVisitor counter;
+    pfull->accept(counter);
+    if( counter.numtriangles < s_nLODMinTriangles ) {
+        return pfull;
+    }
+
+    osg::ref_ptr<osg::LOD> plod = new osg::LOD();
+    plod->setRangeMode(osg::LOD::PIXEL_SIZE_ON_SCREEN);
+    plod->addChild(pfull.get(), s_fLODPixelSizes[0], FLT_MAX);
+    const size_t numlevels = sizeof(s_fLODSampleRatios)/sizeof(s_fLODSampleRatios[0]);
+    for(size_t ilevel = 0; ilevel < numlevels; ++ilevel) {
+        const float sampleratio = s_fLODSampleRatios[ilevel];
+        osg::ref_ptr<osg::Node> psimplified = SharedGeodeCache::GetInstance().GetOrCreateNode<osg::Node>(str(boost::format("%s lod %.3g")%key%sampleratio), [&pfull, sampleratio]() {
+            return _CreateSimplifiedNode(*pfull, sampleratio);
+        });
+        plod->addChild(psimplified.get(), ilevel+1 < numlevels ? s_fLODPixelSizes[ilevel+1] : 0.0f, s_fLODPixelSizes[ilevel]);
+    }
+    RAVELOG_VERBOSE_FORMAT("created %d levels of detail for %s with %d triangles", (numlevels+1)%key%counter.numtriangles);
+    return plod;
+}
+
 OSGGroupPtr CreateOSGXYZAxes(double len, double axisthickness)
 {
     osg::Vec4f colors[] = {
@@ -241,6 +424,7 @@ KinBodyItem::KinBodyItem(OSGGroupPtr osgSceneRoot, OSGGroupPtr osgFigureRoot, Ki
     _userdata = 0;
     _bReload = false;
     _bDrawStateChanged = false;
+    _bTransformsDirty = true;
 
     _environmentid = pbody->GetEnvironmentBodyIndex();
     _geometrycallback = pbody->RegisterChangeCallback(KinBody::Prop_LinkGeometry, boost::bind(&KinBodyItem::_HandleGeometryChangedCallback,this));
@@ -262,6 +446,8 @@ void KinBodyItem::Load()
 
     _veclinks.resize(0);
     _vecgeoms.resize(_pbody->GetLinks().size());
+    _vlinkgeometryshapestamps.resize(0);
+    _vecgeomtransforms.resize(_pbody->GetLinks().size());
 
     Transform tbody = _pbody->GetTransform();
     Transform tbodyinv = tbody.inverse();
@@ -293,10 +479,13 @@ void KinBodyItem::Load()
         _veclinks.push_back(LinkNodes(posglinkroot, posglinktrans));
         size_t linkindex = itlink - _pbody->GetLinks().begin();
         _vecgeoms.at(linkindex).resize(0);
+        _vlinkgeometryshapestamps.push_back(porlink->GetGeometryShapeStamp());
+        _vecgeomtransforms.at(linkindex).resize(0);
 
         for(size_t igeom = 0; igeom < porlink->GetGeometries().size(); ++igeom) {
             _vecgeoms[linkindex].push_back( GeomNodes(new osg::Group(), new osg::MatrixTransform()) );
             KinBody::Link::GeometryPtr orgeom = porlink->GetGeometries()[igeom];
+            _vecgeomtransforms[linkindex].push_back(orgeom->GetTransform());
             if( !orgeom->IsVisible() && _viewmode == VG_RenderOnly ) {
                 continue;
             }
@@ -331,6 +520,9 @@ void KinBodyItem::Load()
                     pgeometryroot->preMult(mRotate);
 
                     loadedModel = osgDB::readNodeFile(orgeom->GetRenderFilename());
+                    if( !!loadedModel ) {
+                        loadedModel = _CreateLODNode(loadedModel, "file " + orgeom->GetRenderFilename());
+                    }
 
                     pgeometrydata = loadedModel->asGroup();
                     osg::ref_ptr<osg::StateSet> state = pgeometrydata->getOrCreateStateSet();
@@ -408,37 +600,31 @@ void KinBodyItem::Load()
                 switch(orgeom->GetType()) {
                 //  Geometry is defined like a Sphere
                 case GT_Sphere: {
-                    osg::Sphere* s = new osg::Sphere();
-                    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
-                    s->setRadius(orgeom->GetSphereRadius());
-                    osg::ref_ptr<osg::ShapeDrawable> sd = new osg::ShapeDrawable(s);
-                    geode->addDrawable(sd.get());
-
+                    const float radius = orgeom->GetSphereRadius();
+                    osg::ref_ptr<osg::Geode> geode = SharedGeodeCache::GetInstance().GetOrCreateGeode(str(boost::format("sphere %.9g")%radius), [radius]() {
+                        return _CreateShapeGeode(new osg::Sphere(osg::Vec3f(), radius));
+                    });
                     pgeometrydata->addChild(geode.get());
                     break;
                 }
                 //  Geometry is defined like a Box
                 case GT_Box: {
-                    Vector v;
-                    osg::ref_ptr<osg::Box> box = new osg::Box();
-                    box->setHalfLengths(osg::Vec3f(orgeom->GetBoxExtents().x,orgeom->GetBoxExtents().y,orgeom->GetBoxExtents().z));
-
-                    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
-                    osg::ref_ptr<osg::ShapeDrawable> sd = new osg::ShapeDrawable(box.get());
-                    geode->addDrawable(sd.get());
-
+                    const osg::Vec3f halflengths(orgeom->GetBoxExtents().x,orgeom->GetBoxExtents().y,orgeom->GetBoxExtents().z);
+                    osg::ref_ptr<osg::Geode> geode = SharedGeodeCache::GetInstance().GetOrCreateGeode(str(boost::format("box %.9g %.9g %.9g")%halflengths.x()%halflengths.y()%halflengths.z()), [&halflengths]() {
+                        osg::ref_ptr<osg::Box> box = new osg::Box();
+                        box->setHalfLengths(halflengths);
+                        return _CreateShapeGeode(box.get());
+                    });
                     pgeometrydata->addChild(geode.get());
                     break;
                 }
                 //  Geometry is defined like a Cylinder
                 case GT_Cylinder: {
                     // make SoCylinder point towards z, not y
-                    osg::Cylinder* cy = new osg::Cylinder();
-                    cy->setRadius(orgeom->GetCylinderRadius());
-                    cy->setHeight(orgeom->GetCylinderHeight());
-                    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
-                    osg::ref_ptr<osg::ShapeDrawable> sd = new osg::ShapeDrawable(cy);
-                    geode->addDrawable(sd.get());
+                    const float radius = orgeom->GetCylinderRadius(), height = orgeom->GetCylinderHeight();
+                    osg::ref_ptr<osg::Geode> geode = SharedGeodeCache::GetInstance().GetOrCreateGeode(str(boost::format("cylinder %.9g %.9g")%radius%height), [radius, height]() {
+                        return _CreateShapeGeode(new osg::Cylinder(osg::Vec3f(), radius, height));
+                    });
                     pgeometrydata->addChild(geode.get());
                     break;
                 }
@@ -448,31 +634,13 @@ void KinBodyItem::Load()
                 case GT_Cage:
                 case GT_Container:
                 case GT_TriMesh: {
-                    // make triangleMesh
-                    osg::ref_ptr<osg::Geometry> geom = new osg::Geometry;
-
-                    //geom->setColorBinding(osg::Geometry::BIND_OVERALL); // need to call geom->setColorArray first
-
+                    // make triangleMesh, identical meshes of all the bodies share one geode
                     const TriMesh& mesh = orgeom->GetCollisionMesh();
-                    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array();
-                    vertices->reserveArray(mesh.vertices.size());
-                    for(size_t i = 0; i < mesh.vertices.size(); ++i) {
-                        RaveVector<float> v = mesh.vertices[i];
-                        vertices->push_back(osg::Vec3(v.x, v.y, v.z));
-                    }
-                    geom->setVertexArray(vertices.get());
-
-
-                    osg::DrawElementsUInt* geom_prim = new osg::DrawElementsUInt(osg::PrimitiveSet::TRIANGLES, mesh.indices.size());
-                    for(size_t i = 0; i < mesh.indices.size(); ++i) {
-                        (*geom_prim)[i] = mesh.indices[i];
-                    }
-                    geom->addPrimitiveSet(geom_prim);
-
-                    osgUtil::SmoothingVisitor::smooth(*geom); // compute vertex normals
-                    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
-                    geode->addDrawable(geom);
-                    pgeometrydata->addChild(geode);
+                    const std::string meshkey = _GetMeshGeodeKey(mesh);
+                    osg::ref_ptr<osg::Geode> geode = SharedGeodeCache::GetInstance().GetOrCreateGeode(meshkey, [&mesh]() {
+                        return _CreateMeshGeode(mesh);
+                    });
+                    pgeometrydata->addChild(_CreateLODNode(geode.get(), meshkey));
 
                     if(orgeom->GetType() == GT_TriMesh || orgeom->GetType() == GT_Axial || orgeom->GetType() == GT_ConicalFrustum){
                         // CropContainerMargins and CropContainerEmptyMargins only exists in GT_Cage and GT_Container
@@ -643,6 +811,7 @@ void KinBodyItem::Load()
 
     _bReload = false;
     _bDrawStateChanged = false;
+    _bTransformsDirty = true;
 }
 
 void KinBodyItem::_PrintMatrix(osg::Matrix& m)
@@ -747,6 +916,46 @@ void KinBodyItem::_HandleGeometryChangedCallback()
     _bReload = true;
 }
 
+bool KinBodyItem::_UpdateGeometryTransforms()
+{
+    const std::vector<KinBody::LinkPtr>& vlinks = _pbody->GetLinks();
+    if( vlinks.size() != _vlinkgeometryshapestamps.size() || vlinks.size() != _vecgeoms.size() ) {
+        return false;
+    }
+    for(size_t ilink = 0; ilink < vlinks.size(); ++ilink) {
+        if( vlinks[ilink]->GetGeometryShapeStamp() != _vlinkgeometryshapestamps[ilink] || vlinks[ilink]->GetGeometries().size() != _vecgeoms[ilink].size() ) {
+            return false;
+        }
+    }
+
+    for(size_t ilink = 0; ilink < vlinks.size(); ++ilink) {
+        const std::vector<KinBody::Link::GeometryPtr>& vgeometries = vlinks[ilink]->GetGeometries();
+        for(size_t igeom = 0; igeom < vgeometries.size(); ++igeom) {
+            const Transform& tgeom = vgeometries[igeom]->GetTransform();
+            Transform& tloaded = _vecgeomtransforms[ilink][igeom];
+            if( TransformDistanceFast(tgeom, tloaded) <= g_fEpsilonLinear ) {
+                continue;
+            }
+            // the matrix can also hold the scale and rotation of the render file in the geometry frame, so only replace the geometry transform
+            OSGMatrixTransformPtr pgeometryroot = _vecgeoms[ilink][igeom].second;
+            pgeometryroot->setMatrix(pgeometryroot->getMatrix()*osg::Matrix::inverse(GetMatrixFromRaveTransform(tloaded))*GetMatrixFromRaveTransform(tgeom));
+            tloaded = tgeom;
+        }
+    }
+    return true;
+}
+
+void KinBodyItem::_UpdateChangedGeometries()
+{
+    if( _bReload && !_bDrawStateChanged && _UpdateGeometryTransforms() ) {
+        _bReload = false;
+        return;
+    }
+    if( _bReload || _bDrawStateChanged ) {
+        Load();
+    }
+}
+
 void KinBodyItem::_HandleDrawChangedCallback()
 {
     _bDrawStateChanged = true;
@@ -812,7 +1021,7 @@ bool KinBodyItem::UpdateFromModel()
         return false;
     }
     vector<Transform> vtrans;
-    vector<dReal> vjointvalues;
+    vector<dReal> vjointvalues, vdofbranches;
 
     {
         boost::shared_ptr<EnvironmentLock> lockenv = LockEnvironmentWithTimeout(_pbody->GetEnv(), 50000);
@@ -820,7 +1029,7 @@ bool KinBodyItem::UpdateFromModel()
             return false;
         }
         if( _bReload || _bDrawStateChanged ) {
-            Load();
+            _UpdateChangedGeometries();
         }
         else {
             _osgdata->setName(_pbody->GetName());
@@ -828,7 +1037,7 @@ bool KinBodyItem::UpdateFromModel()
 
         // make sure the body is still present!
         if( _pbody->GetEnv()->GetBodyFromEnvironmentBodyIndex(_environmentid) == _pbody ) {
-            _pbody->GetLinkTransformations(_vtrans, _vjointvalues);
+            _pbody->GetLinkTransformations(vtrans, vdofbranches);
             _pbody->GetDOFValues(vjointvalues);
         }
         else {
@@ -848,15 +1057,18 @@ bool KinBodyItem::UpdateFromModel(const vector<dReal>& vjointvalues, const vecto
     }
 
     if( _bReload || _bDrawStateChanged ) {
-        EnvironmentLock lockenv(_pbody->GetEnv()->GetMutex());
+        // never block the render thread on the environment, if the simulation holds the lock the geometry is reloaded on one of the next frames
+        boost::shared_ptr<EnvironmentLock> lockenv = LockEnvironmentWithTimeout(_pbody->GetEnv(), 1000);
         if( !!lockenv ) {
-            if( _bReload || _bDrawStateChanged ) {
-                Load();
-            }
+            _UpdateChangedGeometries();
         }
     }
 
     std::lock_guard<std::mutex> lock(_mutexjoints);
+    if( !_bTransformsDirty && _vtrans == vtrans && _vjointvalues == vjointvalues ) {
+        // body did not move since the last frame, the scene graph already holds its transforms
+        return true;
+    }
     _vjointvalues = vjointvalues;
     _vtrans = vtrans;
 
@@ -898,6 +1110,7 @@ bool KinBodyItem::UpdateFromModel(const vector<dReal>& vjointvalues, const vecto
         SetMatrixTransform(*_veclinks.at(ilink).second, tlocal);
     }
 
+    _bTransformsDirty = false;
     return true;
 }
 
@@ -932,6 +1145,7 @@ void KinBodyItem::SetGrab(bool bGrab, bool bUpdate)
     }
 
     bGrabbed = bGrab;
+    _bTransformsDirty = true; // draggers are inserted above the item when grabbing
     if( bGrab ) {
         SetVisualizationMode("selected");
     }
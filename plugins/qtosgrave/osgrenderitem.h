@@ -199,6 +199,14 @@ protected:
     virtual void _HandleGeometryChangedCallback();
     virtual void _HandleDrawChangedCallback();
 
+    /// \brief if only the local transforms of some geometries changed since Load, updates their nodes
+    ///
+    /// \return false if the geometries have to be loaded again
+    bool _UpdateGeometryTransforms();
+
+    /// \brief applies the pending geometry and draw changes, has to be called with the environment locked
+    void _UpdateChangedGeometries();
+
     typedef std::pair<OSGGroupPtr, OSGMatrixTransformPtr> LinkNodes;
     typedef std::pair<OSGGroupPtr, OSGMatrixTransformPtr> GeomNodes;
 
@@ -206,8 +214,11 @@ protected:
     int _environmentid;        ///< _pbody->GetEnvironmentBodyIndex()
     std::vector<LinkNodes> _veclinks; ///< render items for each link, indexed same as links. The group's hierarchy mimics the kinematics hierarchy. For each pair, the first Group node is used for the hierarchy, the second node contains the transform with respect to the body's transform
     std::vector<std::vector<GeomNodes> > _vecgeoms; ///< render items for each link's geometries, indexed same as geometries.
+    std::vector<int> _vlinkgeometryshapestamps; ///< KinBody::Link::GetGeometryShapeStamp of every link when loaded
+    std::vector<std::vector<Transform> > _vecgeomtransforms; ///< local transform of every geometry of _vecgeoms when its node was last updated
     bool bEnabled;
     bool bGrabbed, _bReload, _bDrawStateChanged;
+    bool _bTransformsDirty; ///< if true, the link transforms of the scene graph have to be set on the next UpdateFromModel even if the body did not move
     ViewGeometry _viewmode;
     int _userdata;
 
@@ -147,6 +147,10 @@ QtOSGViewer::QtOSGViewer(EnvironmentBasePtr penv, std::istream& sinput, QCoreApp
 
     RegisterCommand("SetFiguresInCamera",boost::bind(&QtOSGViewer::_SetFiguresInCamera, this, _1, _2),
                     "Accepts 0/1 value that decides whether to render the figure plots in the camera image through GetCameraImage");
+    RegisterCommand("SetPublishBodies",boost::bind(&QtOSGViewer::_SetPublishBodiesCommand, this, _1, _2),
+                    "Accepts 0/1 value. If 0, the viewer never calls UpdatePublishedBodies itself and only renders the bodies published by the simulation thread, so it never competes for the environment lock to take the snapshot. Default is 1");
+    RegisterCommand("SetItemLoadBudget",boost::bind(&QtOSGViewer::_SetItemLoadBudgetCommand, this, _1, _2),
+                    "Accepts the maximum time in microseconds spent per frame creating the render items of new bodies, the remaining bodies are created on the next frames. 0 disables the limit");
     RegisterCommand("SetItemVisualization",boost::bind(&QtOSGViewer::_SetItemVisualizationCommand, this, _1, _2),
                     "sets the visualization mode of a kinbody/render item in the viewer");
     RegisterCommand("ShowWorldAxes",boost::bind(&QtOSGViewer::_ShowWorldAxesCommand, this, _1, _2),
@@ -203,6 +207,8 @@ QtOSGViewer::QtOSGViewer(EnvironmentBasePtr penv, std::istream& sinput, QCoreApp
     fontFile.close();
 
     _bLockEnvironment = true;
+    _bPublishBodies = true;
+    _nItemLoadBudgetUS = 20000;
     _InitGUI(bCreateStatusBar, bCreateMenu);
     _bUpdateEnvironment = true;
     _bExternalLoop = false;
@@ -1106,6 +1112,23 @@ bool QtOSGViewer::_SetFiguresInCamera(ostream& sout, istream& sinput)
     return !!sinput;
 }
 
+bool QtOSGViewer::_SetPublishBodiesCommand(ostream& sout, istream& sinput)
+{
+    sinput >> _bPublishBodies;
+    return !!sinput;
+}
+
+bool QtOSGViewer::_SetItemLoadBudgetCommand(ostream& sout, istream& sinput)
+{
+    uint64_t loadbudgetus = 0;
+    sinput >> loadbudgetus;
+    if( !sinput ) {
+        return false;
+    }
+    _nItemLoadBudgetUS = loadbudgetus;
+    return true;
+}
+
 bool QtOSGViewer::_SetItemVisualizationCommand(ostream& sout, istream& sinput)
 {
     std::string itemname, visualizationmode;
@@ -2126,7 +2149,7 @@ void QtOSGViewer::UpdateFromModel()
 
     EnvironmentLock lockenv(GetEnv()->GetMutex(), OpenRAVE::defer_lock_t());
 
-    if( _bLockEnvironment && !lockenv ) {
+    if( _bLockEnvironment && _bPublishBodies && !lockenv ) {
         uint64_t basetime = utils::GetMicroTime();
         while(utils::GetMicroTime()-basetime<1000 ) {
             if( lockenv.try_lock() ) {
@@ -2149,6 +2172,7 @@ void QtOSGViewer::UpdateFromModel()
     }
 
     bool newdata = false; // set to true if new object was created
+    const uint64_t loadstarttime = utils::GetMicroTime();
     FOREACH(itbody, vecbodies) {
         BOOST_ASSERT( !!itbody->pbody );
         KinBodyPtr pbody = itbody->pbody; // try to use only as an id, don't call any methods!
@@ -2174,6 +2198,11 @@ void QtOSGViewer::UpdateFromModel()
                         continue;
                     }
 
+                    if( newdata && _nItemLoadBudgetUS > 0 && utils::GetMicroTime() - loadstarttime >= _nItemLoadBudgetUS ) {
+                        // spent the budget of this frame on loading other bodies, create this one on the next frame so that the viewer stays responsive
+                        continue;
+                    }
+
                     if( _bLockEnvironment && !lockenv ) {
                         uint64_t basetime = utils::GetMicroTime();
                         while(utils::GetMicroTime()-basetime<1000 ) {
@@ -406,6 +406,8 @@ public:
 
     bool _SetFiguresInCamera(ostream& sout, istream& sinput);
     bool _ShowWorldAxesCommand(ostream& sout, istream& sinput);
+    bool _SetPublishBodiesCommand(ostream& sout, istream& sinput);
+    bool _SetItemLoadBudgetCommand(ostream& sout, istream& sinput);
     bool _SetItemVisualizationCommand(ostream& sout, istream& sinput);
     bool _SetNearPlaneCommand(ostream& sout, istream& sinput);
     bool _SetTextureCubeMap(ostream& out, istream& sinput);
@@ -555,6 +557,8 @@ public:
     // control related
     bool _bUpdateEnvironment; ///< if true, should update the viewer to the openrave environment periodically
     bool _bLockEnvironment; ///< if true, should lock the environment when updating from it. Otherwise, the environment can assumed to be already locked in another thread that the viewer controls
+    bool _bPublishBodies; ///< if true, the viewer calls UpdatePublishedBodies itself before rendering. Otherwise only the bodies published by the simulation thread are rendered
+    uint64_t _nItemLoadBudgetUS; ///< maximum time in microseconds spent per frame creating render items for new bodies, 0 for no limit
 
     bool _bExternalLoop; ///< If true, the Qt loop is not started by qtosgviewer, which means qtosgviewer should not terminate the Qt loop during deallocation.
     int _nQuitMainLoop; ///< controls if the main loop's state. If 0, then nothing is initialized. If -1, then currently initializing/running. If 1, then currently quitting from the main loop. If 2, then successfully quit from the main loop.
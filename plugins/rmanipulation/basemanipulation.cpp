@@ -37,6 +37,7 @@ public:
 - minsteps - The minimum number of steps that need to be taken in order for success to declared. If robot doesn't reach this number of steps, it fails.\n\n\
 - maxsteps - The maximum number of steps the robot should take.\n\n\
 - direction - The workspace direction to move end effector in.\n\n\
+- jacobian - if 1, the planner follows the line with jacobian steps warm started from the previous configuration instead of calling the ik solver at every step.\n\n\
 Method wraps the WorkspaceTrajectoryTracker planner. For more details on parameters, check out its documentation.");
         RegisterCommand("MoveManipulator",boost::bind(&BaseManipulation::MoveManipulator,this,_1,_2),
                         "Moves arm joints of active manipulator to a given set of joint values");
@@ -200,6 +201,7 @@ protected:
         int minsteps = 0;
         int maxsteps = 10000;
         bool starteematrix = false;
+        bool bJacobianTracking = false;
 
         RobotBase::ManipulatorConstPtr pmanip = robot->GetActiveManipulator();
         Transform Tee;
@@ -249,7 +251,7 @@ protected:
                 sinput >> params->maxdeviationangle;
             }
             else if( cmd == "jacobian" ) {
-                RAVELOG_WARN("MoveHandStraight jacobian parameter not supported anymore\n");
+                sinput >> bJacobianTracking;
             }
             else if( cmd == "planner" ) {
                 sinput >> plannername;
@@ -325,6 +327,14 @@ protected:
             return false;
         }
 
+        if( bJacobianTracking ) {
+            stringstream sjacobianout, sjacobianin;
+            sjacobianin << "SetJacobianTracking 1";
+            if( !planner->SendCommand(sjacobianout, sjacobianin) ) {
+                RAVELOG_WARN_FORMAT("planner %s does not support jacobian tracking, so using its default tracking", plannername);
+            }
+        }
+
         if( !planner->InitPlan(robot, params).HasSolution() ) {
             RAVELOG_ERROR("InitPlan failed\n");
             return false;
@@ -0,0 +1,398 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2019 Rosen Diankov (rosen.diankov@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "commonmanipulation.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <boost/bind/bind.hpp>
+#include <boost/functional/hash.hpp>
+
+using namespace boost::placeholders;
+
+static const uint64_t s_ikCountsMagic = 0x31544e434b49524fULL; // "ORIKCNT1"
+static const uint32_t s_ikCountsVersion = 1;
+
+/// \brief header of the ik solution count files, followed by one int32_t count per pose, -1 if the pose was not computed yet
+struct IkCountsFileHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t allsolutions; ///< 1 if the counts are the number of ik solutions, 0 if they only tell whether a solution exists
+    uint64_t numposes;
+    uint64_t poseshash; ///< hash of the poses, so that the counts of other poses are not resumed
+    char kinematicshash[64];
+};
+
+/// \brief computes the databases of python/databases (kinematicreachability, inversereachability) natively, distributing the ik queries over threads owning clones of the environment.
+class ReachabilityDatabase : public ModuleBase
+{
+public:
+    ReachabilityDatabase(EnvironmentBasePtr penv) : ModuleBase(penv), _numDone(0), _numTotal(0), _bCancel(false)
+    {
+        __description = "\
+Computes the reachability databases natively. The ik queries are distributed over threads that each own a clone of the environment, so the environment is only locked while cloning.";
+        RegisterCommand("ComputeIkSolutionCounts",boost::bind(&ReachabilityDatabase::_ComputeIkSolutionCountsCommand,this,_1,_2),
+                        "Counts the ik solutions of tool poses of a manipulator. The counts are written into a memory-mapped file as they are computed, so an interrupted computation resumes where it stopped when called again with the same files. Returns the byte offset of the int32 counts in the counts file and the number of poses computed by this call.\nParameters:\n\n\
+* robot - name of the robot\n\
+* manip - name of the manipulator\n\
+* poses - file of float64 poses (qw qx qy qz x y z) of the tool in the manipulator base link frame\n\
+* counts - file the counts are written to, -1 for the poses that are not computed yet\n\
+* allsolutions - if 1, counts all the ik solutions, otherwise only finds one (default 0)\n\
+* numthreads - number of threads, 0 uses the number of cores (default 0)\n");
+        RegisterCommand("GenerateReachabilityMap",boost::bind(&ReachabilityDatabase::_GenerateReachabilityMapCommand,this,_1,_2),
+                        "Generates the RobotBase::ManipulatorReachabilityMap of a manipulator and saves it.\nParameters:\n\n\
+* robot - name of the robot\n\
+* manip - name of the manipulator\n\
+* filename - file to save the map to, default is the database file of the manipulator\n\
+* voxelsize - edge length of the voxels (default 0.04)\n\
+* numrotations - number of sampled rotations, at most 64 (default 64)\n\
+* numthreads - number of threads, 0 uses the number of cores (default 0)\n\
+* setmap - if 1, also sets the map on the manipulator (default 0)\n");
+        RegisterCommand("GetProgress",boost::bind(&ReachabilityDatabase::_GetProgressCommand,this,_1,_2),
+                        "Returns the number of computed poses and the number of poses of the running ComputeIkSolutionCounts, can be called from another thread");
+        RegisterCommand("Cancel",boost::bind(&ReachabilityDatabase::_CancelCommand,this,_1,_2),
+                        "Stops the running ComputeIkSolutionCounts, the poses computed so far are kept in the counts file");
+    }
+    virtual ~ReachabilityDatabase() {
+    }
+
+protected:
+    RobotBase::ManipulatorPtr _GetManipulator(const std::string& robotname, const std::string& manipname)
+    {
+        RobotBasePtr probot = GetEnv()->GetRobot(robotname);
+        if( !probot ) {
+            RAVELOG_WARN_FORMAT("env=%s, could not find robot '%s'", GetEnv()->GetNameId()%robotname);
+            return RobotBase::ManipulatorPtr();
+        }
+        RobotBase::ManipulatorPtr pmanip = manipname.size() > 0 ? probot->GetManipulator(manipname) : probot->GetActiveManipulator();
+        if( !pmanip ) {
+            RAVELOG_WARN_FORMAT("env=%s, could not find manipulator '%s' on robot %s", GetEnv()->GetNameId()%manipname%robotname);
+        }
+        return pmanip;
+    }
+
+    bool _ComputeIkSolutionCountsCommand(ostream& sout, istream& sinput)
+    {
+#ifdef _WIN32
+        RAVELOG_WARN("ComputeIkSolutionCounts needs memory-mapped files, which are not supported on windows\n");
+        return false;
+#else
+        std::string robotname, manipname, posesfilename, countsfilename;
+        bool bAllSolutions = false;
+        int numthreads = 0;
+        string cmd;
+        while(!sinput.eof()) {
+            sinput >> cmd;
+            if( !sinput ) {
+                break;
+            }
+            std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+            if( cmd == "robot" ) {
+                sinput >> robotname;
+            }
+            else if( cmd == "manip" ) {
+                sinput >> manipname;
+            }
+            else if( cmd == "poses" ) {
+                sinput >> posesfilename;
+            }
+            else if( cmd == "counts" ) {
+                sinput >> countsfilename;
+            }
+            else if( cmd == "allsolutions" ) {
+                sinput >> bAllSolutions;
+            }
+            else if( cmd == "numthreads" ) {
+                sinput >> numthreads;
+            }
+            else {
+                RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
+                break;
+            }
+            if( !sinput ) {
+                RAVELOG_ERROR(str(boost::format("failed processing command %s\n")%cmd));
+                return false;
+            }
+        }
+        if( posesfilename.empty() || countsfilename.empty() ) {
+            RAVELOG_WARN("ComputeIkSolutionCounts needs the poses and counts files\n");
+            return false;
+        }
+        if( numthreads <= 0 ) {
+            numthreads = std::max(1, (int)std::thread::hardware_concurrency());
+        }
+
+        std::vector<double> vposes;
+        {
+            std::ifstream f(posesfilename.c_str(), std::ios::binary);
+            if( !f ) {
+                RAVELOG_WARN_FORMAT("failed to open poses file '%s'", posesfilename);
+                return false;
+            }
+            f.seekg(0, std::ios::end);
+            const std::streamoff size = f.tellg();
+            f.seekg(0, std::ios::beg);
+            if( size <= 0 || size % (7*sizeof(double)) != 0 ) {
+                RAVELOG_WARN_FORMAT("poses file '%s' does not hold 7 float64 values per pose", posesfilename);
+                return false;
+            }
+            vposes.resize(size/sizeof(double));
+            f.read(reinterpret_cast<char*>(vposes.data()), size);
+            if( !f ) {
+                RAVELOG_WARN_FORMAT("failed to read poses file '%s'", posesfilename);
+                return false;
+            }
+        }
+        const uint64_t numposes = vposes.size()/7;
+
+        std::vector<EnvironmentBasePtr> vclonedenvs(numthreads);
+        std::string robotfullname, manipfullname, kinematicshash;
+        {
+            EnvironmentLock lock(GetEnv()->GetMutex());
+            RobotBase::ManipulatorPtr pmanip = _GetManipulator(robotname, manipname);
+            if( !pmanip ) {
+                return false;
+            }
+            if( !pmanip->GetIkSolver() || !pmanip->GetIkSolver()->Supports(IKP_Transform6D) ) {
+                RAVELOG_WARN_FORMAT("env=%s, manipulator %s:%s does not have an ik solver supporting Transform6D", GetEnv()->GetNameId()%pmanip->GetRobot()->GetName()%pmanip->GetName());
+                return false;
+            }
+            robotfullname = pmanip->GetRobot()->GetName();
+            manipfullname = pmanip->GetName();
+            kinematicshash = pmanip->GetKinematicsStructureHash();
+            for(int ithread = 0; ithread < numthreads; ++ithread) {
+                vclonedenvs[ithread] = GetEnv()->CloneSelf(str(boost::format("%s_ikcounts%d")%GetEnv()->GetName()%ithread), Clone_Bodies);
+            }
+        }
+
+        IkCountsFileHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = s_ikCountsMagic;
+        header.version = s_ikCountsVersion;
+        header.allsolutions = bAllSolutions ? 1 : 0;
+        header.numposes = numposes;
+        size_t poseshash = 0;
+        FOREACHC(itvalue, vposes) {
+            boost::hash_combine(poseshash, *itvalue);
+        }
+        header.poseshash = poseshash;
+        strncpy(header.kinematicshash, kinematicshash.c_str(), sizeof(header.kinematicshash)-1);
+        const uint64_t filesize = sizeof(header) + numposes*sizeof(int32_t);
+
+        const int fd = open(countsfilename.c_str(), O_RDWR|O_CREAT, 0644);
+        if( fd < 0 ) {
+            RAVELOG_WARN_FORMAT("failed to open counts file '%s': %s", countsfilename%strerror(errno));
+            return false;
+        }
+        // resume only from a file computed for the same poses, kinematics and mode
+        IkCountsFileHeader oldheader;
+        memset(&oldheader, 0, sizeof(oldheader));
+        struct stat filestat;
+        const bool bResume = fstat(fd, &filestat) == 0 && (uint64_t)filestat.st_size == filesize && pread(fd, &oldheader, sizeof(oldheader), 0) == (ssize_t)sizeof(oldheader) && memcmp(&oldheader, &header, sizeof(header)) == 0;
+        if( !bResume && ftruncate(fd, filesize) != 0 ) {
+            RAVELOG_WARN_FORMAT("failed to resize counts file '%s': %s", countsfilename%strerror(errno));
+            close(fd);
+            return false;
+        }
+        void* pmapped = mmap(nullptr, filesize, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if( pmapped == MAP_FAILED ) {
+            RAVELOG_WARN_FORMAT("failed to map counts file '%s': %s", countsfilename%strerror(errno));
+            return false;
+        }
+        int32_t* pcounts = reinterpret_cast<int32_t*>(static_cast<uint8_t*>(pmapped) + sizeof(header));
+        uint64_t numalreadydone = 0;
+        if( bResume ) {
+            for(uint64_t ipose = 0; ipose < numposes; ++ipose) {
+                if( pcounts[ipose] >= 0 ) {
+                    ++numalreadydone;
+                }
+            }
+            RAVELOG_INFO_FORMAT("env=%s, resuming ik solution counts of '%s', %d/%d poses already computed", GetEnv()->GetNameId()%countsfilename%numalreadydone%numposes);
+        }
+        else {
+            std::fill(pcounts, pcounts + numposes, -1);
+            memcpy(pmapped, &header, sizeof(header));
+        }
+
+        _numTotal = numposes;
+        _numDone = numalreadydone;
+        _bCancel = false;
+        std::vector<std::exception_ptr> vexceptions(numthreads);
+        std::atomic<uint64_t> nNextPose(0);
+        const uint64_t nProgressStep = std::max(numposes/100, (uint64_t)1);
+        auto worker = [&](int ithread) {
+            try {
+                EnvironmentBasePtr pclonedenv = vclonedenvs[ithread];
+                EnvironmentLock lock(pclonedenv->GetMutex());
+                RobotBasePtr pclonedrobot = pclonedenv->GetRobot(robotfullname);
+                RobotBase::ManipulatorPtr pclonedmanip = !pclonedrobot ? RobotBase::ManipulatorPtr() : pclonedrobot->GetManipulator(manipfullname);
+                if( !pclonedmanip ) {
+                    throw OPENRAVE_EXCEPTION_FORMAT("env=%s, could not find manipulator %s:%s in the cloned environment", pclonedenv->GetNameId()%robotfullname%manipfullname, ORE_InvalidState);
+                }
+                const Transform tbase = pclonedmanip->GetBase()->GetTransform();
+                std::vector<dReal> vsolution;
+                std::vector< std::vector<dReal> > vsolutions;
+                while( !_bCancel ) {
+                    const uint64_t ipose = nNextPose.fetch_add(1);
+                    if( ipose >= numposes ) {
+                        break;
+                    }
+                    if( pcounts[ipose] >= 0 ) {
+                        continue;
+                    }
+                    const double* ppose = &vposes[7*ipose];
+                    const IkParameterization ikparam(tbase*Transform(Vector(ppose[0], ppose[1], ppose[2], ppose[3]), Vector(ppose[4], ppose[5], ppose[6])));
+                    if( bAllSolutions ) {
+                        pcounts[ipose] = pclonedmanip->FindIKSolutions(ikparam, vsolutions, 0) ? (int32_t)vsolutions.size() : 0;
+                    }
+                    else {
+                        pcounts[ipose] = pclonedmanip->FindIKSolution(ikparam, vsolution, 0) ? 1 : 0;
+                    }
+                    const uint64_t numdone = ++_numDone;
+                    if( numdone % nProgressStep == 0 ) {
+                        RAVELOG_INFO_FORMAT("ik solution counts %d/%d", numdone%numposes);
+                    }
+                }
+            }
+            catch(...) {
+                vexceptions[ithread] = std::current_exception();
+                _bCancel = true;
+            }
+        };
+
+        std::vector<std::thread> vthreads;
+        vthreads.reserve(numthreads-1);
+        for(int ithread = 1; ithread < numthreads; ++ithread) {
+            vthreads.emplace_back(worker, ithread);
+        }
+        worker(0);
+        FOREACH(itthread, vthreads) {
+            itthread->join();
+        }
+        vclonedenvs.clear();
+        msync(pmapped, filesize, MS_SYNC);
+        munmap(pmapped, filesize);
+        FOREACHC(itexception, vexceptions) {
+            if( !!*itexception ) {
+                std::rethrow_exception(*itexception);
+            }
+        }
+        if( _bCancel ) {
+            RAVELOG_INFO_FORMAT("env=%s, ik solution counts of '%s' canceled at %d/%d poses", GetEnv()->GetNameId()%countsfilename%(uint64_t)_numDone%numposes);
+            return false;
+        }
+        sout << sizeof(header) << " " << (_numDone - numalreadydone);
+        return true;
+#endif
+    }
+
+    bool _GenerateReachabilityMapCommand(ostream& sout, istream& sinput)
+    {
+        std::string robotname, manipname, filename;
+        dReal voxelsize = 0.04;
+        int numrotations = 64, numthreads = 0;
+        bool bSetMap = false;
+        string cmd;
+        while(!sinput.eof()) {
+            sinput >> cmd;
+            if( !sinput ) {
+                break;
+            }
+            std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+            if( cmd == "robot" ) {
+                sinput >> robotname;
+            }
+            else if( cmd == "manip" ) {
+                sinput >> manipname;
+            }
+            else if( cmd == "filename" ) {
+                sinput >> filename;
+            }
+            else if( cmd == "voxelsize" ) {
+                sinput >> voxelsize;
+            }
+            else if( cmd == "numrotations" ) {
+                sinput >> numrotations;
+            }
+            else if( cmd == "numthreads" ) {
+                sinput >> numthreads;
+            }
+            else if( cmd == "setmap" ) {
+                sinput >> bSetMap;
+            }
+            else {
+                RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
+                break;
+            }
+            if( !sinput ) {
+                RAVELOG_ERROR(str(boost::format("failed processing command %s\n")%cmd));
+                return false;
+            }
+        }
+
+        RobotBase::ManipulatorPtr pmanip;
+        {
+            EnvironmentLock lock(GetEnv()->GetMutex());
+            pmanip = _GetManipulator(robotname, manipname);
+            if( !pmanip ) {
+                return false;
+            }
+            if( filename.empty() ) {
+                filename = RaveFindDatabaseFile(RobotBase::ManipulatorReachabilityMap::GetDatabaseFilename(*pmanip), false);
+            }
+        }
+        // Generate only locks the environment while cloning it
+        RobotBase::ManipulatorReachabilityMapPtr pmap = RobotBase::ManipulatorReachabilityMap::Generate(pmanip, voxelsize, numrotations, numthreads);
+        pmap->Save(filename);
+        if( bSetMap ) {
+            EnvironmentLock lock(GetEnv()->GetMutex());
+            pmanip->SetReachabilityMap(pmap);
+        }
+        sout << filename;
+        return true;
+    }
+
+    bool _GetProgressCommand(ostream& sout, istream& sinput)
+    {
+        sout << (uint64_t)_numDone << " " << (uint64_t)_numTotal;
+        return true;
+    }
+
+    bool _CancelCommand(ostream& sout, istream& sinput)
+    {
+        _bCancel = true;
+        return true;
+    }
+
+    std::atomic<uint64_t> _numDone, _numTotal; ///< progress of the running ComputeIkSolutionCounts
+    std::atomic<bool> _bCancel; ///< set to stop the running ComputeIkSolutionCounts
+};
+
+ModuleBasePtr CreateReachabilityDatabase(EnvironmentBasePtr penv) {
+    return ModuleBasePtr(new ReachabilityDatabase(penv));
+}
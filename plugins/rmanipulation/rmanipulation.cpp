@@ -20,6 +20,7 @@ OpenRAVE::ModuleBasePtr CreateBaseManipulation(OpenRAVE::EnvironmentBasePtr penv
 //OpenRAVE::ModuleBasePtr CreateTaskCaging(OpenRAVE::EnvironmentBasePtr penv);
 OpenRAVE::ModuleBasePtr CreateTaskManipulation(OpenRAVE::EnvironmentBasePtr penv);
 OpenRAVE::ModuleBasePtr CreateVisualFeedback(OpenRAVE::EnvironmentBasePtr penv);
+OpenRAVE::ModuleBasePtr CreateReachabilityDatabase(OpenRAVE::EnvironmentBasePtr penv);
 
 RManipulationPlugin::RManipulationPlugin()
 {
@@ -27,6 +28,7 @@ RManipulationPlugin::RManipulationPlugin()
     _interfaces[PT_Module].push_back("TaskManipulation");
     _interfaces[PT_Module].push_back("TaskCaging");
     _interfaces[PT_Module].push_back("VisualFeedback");
+    _interfaces[PT_Module].push_back("ReachabilityDatabase");
 }
 
 RManipulationPlugin::~RManipulationPlugin() {}
@@ -47,6 +49,9 @@ OpenRAVE::InterfaceBasePtr RManipulationPlugin::CreateInterface(OpenRAVE::Interf
         else if( interfacename == "visualfeedback") {
             return CreateVisualFeedback(penv);
         }
+        else if( interfacename == "reachabilitydatabase" ) {
+            return CreateReachabilityDatabase(penv);
+        }
         break;
     default:
         break;
@@ -15,6 +15,11 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "commonmanipulation.h"
 
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <thread>
+
 #include <boost/bind/bind.hpp>
 using namespace boost::placeholders;
 
@@ -77,6 +82,7 @@ Task-based manipulation planning involving target objects. A lot of the algorith
 * savepreshapetraj\n\
 * grasptranslationstepmult\n\
 * graspfinestep\n\
+* planningthreads\n\
 ");
         RegisterCommand("CloseFingers",boost::bind(&TaskManipulation::ChuckFingers,this,_1,_2),
                         "Chucks the active manipulator fingers using the grasp planner along manip->GetChuckingDirection().");
@@ -112,6 +118,8 @@ Task-based manipulation planning involving target objects. A lot of the algorith
 
     virtual void Destroy()
     {
+        _StopGraspPlanningWorkers();
+        _vGraspPlanningWorkers.clear();
         ModuleBase::Destroy();
         listsystems.clear();
         _pGrasperPlanner.reset();
@@ -378,6 +386,7 @@ protected:
         boost::shared_ptr<ostream> pOutputTrajStream;
         int nMaxSeedGrasps = 20, nMaxSeedDests = 5, nMaxSeedIkSolutions = 0;
         int nMaxIterations = 4000;
+        int nPlanningThreads = 1; // if > 1, number of workers planning the grasp goals while the grasps are validated
         bool bQuitAfterFirstRun = false;
         dReal jitter = 0.03;
         int nJitterIterations = 5000;
@@ -512,6 +521,9 @@ protected:
             else if( cmd == "graspfinestep" ) {
                 sinput >> graspparams->ffinestep;
             }
+            else if( cmd == "planningthreads" ) {
+                sinput >> nPlanningThreads;
+            }
             else {
                 RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
                 break;
@@ -635,18 +647,33 @@ protected:
             //fApproachOffset = 0; // cannot approach?
         }
 
+        // the workers cannot keep planning once the function returns
+        boost::shared_ptr<void> stopworkers((void*) 0, boost::bind(&TaskManipulation::_StopGraspPlanningWorkers, this));
+
         for(int igraspperm = 0; igraspperm < (int)vgrasppermuation.size(); ++igraspperm) {
             int igrasp = vgrasppermuation[igraspperm];
             dReal* pgrasp = &vgrasps[igrasp*nGraspDim];
 
+            if( nPlanningThreads > 1 ) {
+                ptraj = _CollectGraspPlanningWorkers(false, goalFound, nSearchTime);
+                if( !!ptraj ) {
+                    break;
+                }
+            }
+
             if(( listGraspGoals.size() > 0) &&( iCountdown-- <= 0) ) {
                 // start planning
                 geometrypadder.SwitchPadded();
 
                 RAVELOG_VERBOSE(str(boost::format("planning grasps %d\n")%listGraspGoals.size()));
-                uint64_t basestart = utils::GetMicroTime();
-                ptraj = _PlanGrasp(listGraspGoals, nMaxSeedIkSolutions, goalFound, nMaxIterations,mapPreshapeTrajectories, geometrypadder, fPadding, fRRTStepLength);
-                nSearchTime += utils::GetMicroTime() - basestart;
+                if( nPlanningThreads > 1 ) {
+                    ptraj = _DispatchGraspGoals(listGraspGoals, mapPreshapeTrajectories, nPlanningThreads, goalFound, nSearchTime, !!ikfilter ? ptarget : KinBodyPtr(), sPaddedGeometryGroup, nMaxIterations, fPadding, fRRTStepLength);
+                }
+                else {
+                    uint64_t basestart = utils::GetMicroTime();
+                    ptraj = _PlanGrasp(listGraspGoals, nMaxSeedIkSolutions, goalFound, nMaxIterations,mapPreshapeTrajectories, geometrypadder, fPadding, fRRTStepLength);
+                    nSearchTime += utils::GetMicroTime() - basestart;
+                }
 
                 if( !!ptraj || bQuitAfterFirstRun ) {
                     break;
@@ -1019,9 +1046,14 @@ protected:
 
             if( (int)listGraspGoals.size() >= nMaxSeedGrasps ) {
                 RAVELOG_VERBOSE(str(boost::format("planning grasps %d\n")%listGraspGoals.size()));
-                uint64_t basestart = utils::GetMicroTime();
-                ptraj = _PlanGrasp(listGraspGoals, nMaxSeedGrasps, goalFound, nMaxIterations,mapPreshapeTrajectories, geometrypadder, fPadding, fRRTStepLength);
-                nSearchTime += utils::GetMicroTime() - basestart;
+                if( nPlanningThreads > 1 ) {
+                    ptraj = _DispatchGraspGoals(listGraspGoals, mapPreshapeTrajectories, nPlanningThreads, goalFound, nSearchTime, !!ikfilter ? ptarget : KinBodyPtr(), sPaddedGeometryGroup, nMaxIterations, fPadding, fRRTStepLength);
+                }
+                else {
+                    uint64_t basestart = utils::GetMicroTime();
+                    ptraj = _PlanGrasp(listGraspGoals, nMaxSeedGrasps, goalFound, nMaxIterations,mapPreshapeTrajectories, geometrypadder, fPadding, fRRTStepLength);
+                    nSearchTime += utils::GetMicroTime() - basestart;
+                }
                 if( bQuitAfterFirstRun ) {
                     break;
                 }
@@ -1034,6 +1066,15 @@ protected:
 
         geometrypadder.SwitchPadded();
         // if there's left over goal positions, start planning
+        if( nPlanningThreads > 1 ) {
+            if( !ptraj && listGraspGoals.size() > 0 ) {
+                ptraj = _DispatchGraspGoals(listGraspGoals, mapPreshapeTrajectories, nPlanningThreads, goalFound, nSearchTime, !!ikfilter ? ptarget : KinBodyPtr(), sPaddedGeometryGroup, nMaxIterations, fPadding, fRRTStepLength);
+            }
+            // wait for the first worker that finds a plan
+            while( !ptraj && _IsGraspPlanningWorkerRunning() ) {
+                ptraj = _CollectGraspPlanningWorkers(true, goalFound, nSearchTime);
+            }
+        }
         while( !ptraj && listGraspGoals.size() > 0 ) {
             //TODO have to update ptrajToPreshape
             RAVELOG_VERBOSE(str(boost::format("planning grasps %d\n")%listGraspGoals.size()));
@@ -1528,6 +1569,200 @@ protected:
         return boost::static_pointer_cast<TaskManipulation const>(shared_from_this());
     }
 
+    /// \brief plans grasp goals handed over by GraspPlanning in its own thread and cloned environment
+    struct GraspPlanningWorker
+    {
+        GraspPlanningWorker() : bCancel(false), bFinished(false), nMaxIterations(0), fPadding(0), fRRTStepLength(0), nSearchTime(0) {
+        }
+        EnvironmentBasePtr penv;
+        boost::shared_ptr<TaskManipulation> pmodule; ///< plans with the robot and rrt planner of penv
+        UserDataPtr callbackhandle, ikfilter;
+        std::thread thread;
+        std::atomic<bool> bCancel; ///< set when another worker found a plan first
+        std::atomic<bool> bFinished; ///< set by the thread when done, the thread still has to be joined
+
+        list<GRASPGOAL> listGraspGoals;
+        PRESHAPETRAJMAP mapPreshapeTrajectories; ///< copy of the preshape trajectories when the goals were handed over
+        std::string sPaddedGeometryGroup;
+        int nMaxIterations;
+        dReal fPadding, fRRTStepLength;
+
+        TrajectoryBasePtr ptraj; ///< the plan in penv
+        GRASPGOAL goalFound;
+        uint64_t nSearchTime;
+        std::exception_ptr exception;
+    };
+    typedef boost::shared_ptr<GraspPlanningWorker> GraspPlanningWorkerPtr;
+
+    /// \brief hands the grasp goals to an idle worker that plans them while the caller validates the next grasps. If all nWorkers workers are busy, waits until one of them finishes.
+    ///
+    /// \param ptarget if not empty, registers _FilterIkForGrasping on the ik solver of the worker
+    /// \return the plan if a worker found one while waiting, in which case the goals are not handed over
+    TrajectoryBasePtr _DispatchGraspGoals(list<GRASPGOAL>& listGraspGoals, const PRESHAPETRAJMAP& mapPreshapeTrajectories, int nWorkers, GRASPGOAL& goalfound, uint64_t& nSearchTime, KinBodyPtr ptarget, const std::string& sPaddedGeometryGroup, int nMaxIterations, dReal fPadding, dReal fRRTStepLength)
+    {
+        TrajectoryBasePtr ptraj;
+        GraspPlanningWorkerPtr worker;
+        while( !worker ) {
+            FOREACH(itworker, _vGraspPlanningWorkers) {
+                if( !(*itworker)->thread.joinable() ) {
+                    worker = *itworker;
+                    break;
+                }
+            }
+            if( !worker && (int)_vGraspPlanningWorkers.size() < nWorkers ) {
+                worker.reset(new GraspPlanningWorker());
+                worker->penv = GetEnv()->CloneSelf(str(boost::format("%s_graspworker%d")%GetEnv()->GetName()%_vGraspPlanningWorkers.size()), Clone_Bodies);
+                // the workers only check collisions, so do not compete with the planning threads
+                worker->penv->StopSimulation();
+                worker->pmodule.reset(new TaskManipulation(worker->penv));
+                worker->pmodule->_pRRTPlanner = RaveCreatePlanner(worker->penv, _pRRTPlanner->GetXMLId());
+                if( !worker->pmodule->_pRRTPlanner ) {
+                    throw OPENRAVE_EXCEPTION_FORMAT("env=%s, failed to create planner %s for the grasp planning workers", GetEnv()->GetNameId()%_pRRTPlanner->GetXMLId(), ORE_InvalidPlugin);
+                }
+                GraspPlanningWorker* pworker = worker.get();
+                worker->callbackhandle = worker->pmodule->_pRRTPlanner->RegisterPlanCallback([pworker](const PlannerBase::PlannerProgress&) {
+                    return pworker->bCancel ? PA_Interrupt : PA_None;
+                });
+                _vGraspPlanningWorkers.push_back(worker);
+                RAVELOG_DEBUG_FORMAT("env=%s, created environment %d for grasp planning", GetEnv()->GetNameId()%(_vGraspPlanningWorkers.size()-1));
+            }
+            if( !worker ) {
+                ptraj = _CollectGraspPlanningWorkers(true, goalfound, nSearchTime);
+                if( !!ptraj ) {
+                    return ptraj;
+                }
+            }
+        }
+
+        // copy the current state, this is where the validation thread would have started planning
+        worker->penv->Clone(GetEnv(), Clone_Bodies);
+        TaskManipulation& module = *worker->pmodule;
+        module._robot = worker->penv->GetRobot(_robot->GetName());
+        if( !module._robot ) {
+            throw OPENRAVE_EXCEPTION_FORMAT("env=%s, could not find robot %s in the cloned environment for grasp planning", GetEnv()->GetNameId()%_robot->GetName(), ORE_InvalidState);
+        }
+        module._strRobotName = _strRobotName;
+        module._fMaxVelMult = _fMaxVelMult;
+        module._minimumgoalpaths = _minimumgoalpaths;
+        module._sPostProcessingParameters = _sPostProcessingParameters;
+        worker->ikfilter.reset();
+        if( !!ptarget ) {
+            KinBodyPtr pworkertarget = worker->penv->GetKinBody(ptarget->GetName());
+            if( !pworkertarget ) {
+                throw OPENRAVE_EXCEPTION_FORMAT("env=%s, could not find target %s in the cloned environment for grasp planning", GetEnv()->GetNameId()%ptarget->GetName(), ORE_InvalidState);
+            }
+            worker->ikfilter = module._robot->GetActiveManipulator()->GetIkSolver()->RegisterCustomFilter(0,boost::bind(&TaskManipulation::_FilterIkForGrasping,worker->pmodule,_1,_2,_3,pworkertarget));
+        }
+
+        worker->listGraspGoals.clear();
+        worker->listGraspGoals.swap(listGraspGoals);
+        worker->mapPreshapeTrajectories = mapPreshapeTrajectories;
+        worker->sPaddedGeometryGroup = sPaddedGeometryGroup;
+        worker->nMaxIterations = nMaxIterations;
+        worker->fPadding = fPadding;
+        worker->fRRTStepLength = fRRTStepLength;
+        worker->ptraj.reset();
+        worker->nSearchTime = 0;
+        worker->exception = std::exception_ptr();
+        worker->bCancel = false;
+        worker->bFinished = false;
+        GraspPlanningWorker* pworker = worker.get();
+        worker->thread = std::thread([pworker]() {
+            try {
+                EnvironmentLock lock(pworker->penv->GetMutex());
+                TaskManipulation& module = *pworker->pmodule;
+                GeometryGroupSaver geometrypadder(KinBodyPtr(module._robot), pworker->sPaddedGeometryGroup);
+                geometrypadder.SwitchPadded();
+                while( !pworker->ptraj && pworker->listGraspGoals.size() > 0 && !pworker->bCancel ) {
+                    uint64_t basestart = utils::GetMicroTime();
+                    pworker->ptraj = module._PlanGrasp(pworker->listGraspGoals, 0, pworker->goalFound, pworker->nMaxIterations, pworker->mapPreshapeTrajectories, geometrypadder, pworker->fPadding, pworker->fRRTStepLength);
+                    pworker->nSearchTime += utils::GetMicroTime() - basestart;
+                }
+            }
+            catch(...) {
+                pworker->exception = std::current_exception();
+            }
+            pworker->bFinished = true;
+        });
+        return ptraj;
+    }
+
+    /// \brief joins the finished grasp planning workers. If one of them found a plan, interrupts the others and returns the plan copied to this environment.
+    ///
+    /// \param bWait if true, blocks until at least one running worker finishes
+    TrajectoryBasePtr _CollectGraspPlanningWorkers(bool bWait, GRASPGOAL& goalfound, uint64_t& nSearchTime)
+    {
+        GraspPlanningWorkerPtr winner;
+        while(1) {
+            bool bRunning = false, bJoined = false;
+            FOREACH(itworker, _vGraspPlanningWorkers) {
+                GraspPlanningWorkerPtr worker = *itworker;
+                if( !worker->thread.joinable() ) {
+                    continue;
+                }
+                if( !worker->bFinished ) {
+                    bRunning = true;
+                    continue;
+                }
+                worker->thread.join();
+                worker->ikfilter.reset();
+                bJoined = true;
+                nSearchTime += worker->nSearchTime;
+                if( !!worker->exception ) {
+                    std::exception_ptr exception = worker->exception;
+                    worker->exception = std::exception_ptr();
+                    _StopGraspPlanningWorkers();
+                    std::rethrow_exception(exception);
+                }
+                if( !!worker->ptraj && !winner ) {
+                    winner = worker;
+                }
+            }
+            if( !!winner || !bWait || bJoined || !bRunning ) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        TrajectoryBasePtr ptraj;
+        if( !!winner ) {
+            _StopGraspPlanningWorkers();
+            goalfound = winner->goalFound;
+            ptraj = RaveCreateTrajectory(GetEnv(), winner->ptraj->GetXMLId());
+            ptraj->Clone(winner->ptraj, 0);
+            winner->ptraj.reset();
+        }
+        return ptraj;
+    }
+
+    /// \brief interrupts all the running grasp planning workers and waits for them
+    void _StopGraspPlanningWorkers()
+    {
+        FOREACH(itworker, _vGraspPlanningWorkers) {
+            (*itworker)->bCancel = true;
+        }
+        FOREACH(itworker, _vGraspPlanningWorkers) {
+            GraspPlanningWorker& worker = **itworker;
+            if( worker.thread.joinable() ) {
+                worker.thread.join();
+            }
+            worker.ikfilter.reset();
+            worker.listGraspGoals.clear();
+            worker.mapPreshapeTrajectories.clear();
+            worker.ptraj.reset();
+        }
+    }
+
+    bool _IsGraspPlanningWorkerRunning() const
+    {
+        FOREACHC(itworker, _vGraspPlanningWorkers) {
+            if( (*itworker)->thread.joinable() ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     /// \brief grasps using the list of grasp goals. Removes all the goals that the planner planned with
     TrajectoryBasePtr _PlanGrasp(list<GRASPGOAL>&listGraspGoals, int nSeedIkSolutions, GRASPGOAL& goalfound, int nMaxIterations,PRESHAPETRAJMAP& mapPreshapeTrajectories, GeometryGroupSaver& geometrypadder, dReal fPadding, dReal fRRTStepLength)
     {
@@ -1862,6 +2097,7 @@ protected:
     std::string _sPostProcessingParameters;
     int _minimumgoalpaths;
     CollisionReportPtr _report;
+    std::vector<GraspPlanningWorkerPtr> _vGraspPlanningWorkers; ///< workers for GraspPlanning with planningthreads > 1, each has its own environment
 };
 
 ModuleBasePtr CreateTaskManipulation(EnvironmentBasePtr penv) {
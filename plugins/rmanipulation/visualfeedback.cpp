@@ -19,11 +19,13 @@
 
 using namespace boost::placeholders;
 
-/// samples rays from the projected OBB and returns true if the test function returns true
-/// for all the rays. Otherwise, returns false
-/// allowableoutliers - specifies the % of allowable outliying rays
-bool SampleProjectedOBBWithTest(const OBB& obb, dReal delta, const boost::function<bool(const Vector&)>& testfn,dReal allowableocclusion=0)
+/// samples ray directions on the projected OBB with a density of delta in the image plane
+/// allowableocclusion - specifies the % of allowable outliying rays
+/// \param[out] vsamples the ray directions in the camera coordinate system, with z=1
+/// \return the number of rays that are allowed to fail
+int SampleProjectedOBB(const OBB& obb, dReal delta, dReal allowableocclusion, std::vector<Vector>& vsamples)
 {
+    vsamples.resize(0);
     dReal fscalefactor = 0.95f; // have to make box smaller or else rays might miss
     Vector vpoints[8] = { obb.pos + fscalefactor*(obb.right*obb.extents.x + obb.up*obb.extents.y + obb.dir*obb.extents.z),
                           obb.pos + fscalefactor*(obb.right*obb.extents.x + obb.up*obb.extents.y - obb.dir*obb.extents.z),
@@ -98,11 +100,7 @@ bool SampleProjectedOBBWithTest(const OBB& obb, dReal delta, const boost::functi
             int numsteps = (int)(ftotalen/delta);
             Vector vdelta = (vcur2-vcur1)*(1.0f/numsteps), vcur = vcur1;
             for(int k = 0; k <= numsteps; ++k, vcur += vdelta) {
-
-                if( !testfn(vcur) ) {
-                    if( nallowableoutliers-- <= 0 )
-                        return false;
-                }
+                vsamples.push_back(vcur);
             }
         }
 
@@ -125,14 +123,27 @@ bool SampleProjectedOBBWithTest(const OBB& obb, dReal delta, const boost::functi
             int numsteps = (int)(ftotalen/delta);
             Vector vdelta = (vcur2-vcur1)*(1.0f/numsteps), vcur = vcur1;
             for(int k = 0; k <= numsteps; ++k, vcur += vdelta) {
-                if( !testfn(vcur) ) {
-                    if( nallowableoutliers-- <= 0 )
-                        return false;
-                }
+                vsamples.push_back(vcur);
             }
         }
     }
 
+    return nallowableoutliers;
+}
+
+/// samples rays from the projected OBB and returns true if the test function returns true
+/// for all the rays. Otherwise, returns false
+/// allowableoutliers - specifies the % of allowable outliying rays
+bool SampleProjectedOBBWithTest(const OBB& obb, dReal delta, const boost::function<bool(const Vector&)>& testfn,dReal allowableocclusion=0)
+{
+    std::vector<Vector> vsamples;
+    int nallowableoutliers = SampleProjectedOBB(obb, delta, allowableocclusion, vsamples);
+    FOREACHC(itsample, vsamples) {
+        if( !testfn(*itsample) ) {
+            if( nallowableoutliers-- <= 0 )
+                return false;
+        }
+    }
     return true;
 }
 
@@ -365,11 +376,17 @@ public:
             Transform tworldcamera = ttarget*tCameraInTarget;  // tCameraInTarget is in targetLink coordinates
             _ptargetbox->Enable(true);
             SampleRaysScope srs(*this);
+            // the rays are checked in batches, which cannot ignore the hits through the collision callback, so disable what the callback would ignore
+            std::vector<KinBody::KinBodyStateSaverPtr> vignoresavers;
+            if( !!_collisionfn ) {
+                _DisableIgnoredLinks(vignoresavers);
+            }
             std::string occludingbodyandlinkname = "";
             FOREACH(itobb,_vTargetLocalOBBs) {  // itobb is in targetlink coordinates
                 OBB cameraobb = geometry::TransformOBB(tCameraInTargetinv,*itobb);
-                // SampleProjectedOBBWithTest usually quits when first occlusion is found, so just passing occludingbodyandlinkname to _TestRay should return the initial occluding part.
-                if( !SampleProjectedOBBWithTest(cameraobb, _vf->_fSampleRayDensity, boost::bind(&VisibilityConstraintFunction::_TestRay, this, _1, boost::ref(tworldcamera), boost::ref(occludingbodyandlinkname)),_vf->_fAllowableOcclusion) ) {
+                int nallowableoutliers = SampleProjectedOBB(cameraobb, _vf->_fSampleRayDensity, _vf->_fAllowableOcclusion, _vraysamples);
+                // _TestRays quits at the batch where the occlusions exceed nallowableoutliers, so occludingbodyandlinkname is the first occluding part.
+                if( !_TestRays(_vraysamples, tworldcamera, nallowableoutliers, occludingbodyandlinkname) ) {
                     RAVELOG_VERBOSE("box is occluded\n");
                     errormsg = str(boost::format("{\"type\":\"pattern_occluded\", \"bodylinkname\":\"%s\"}")%occludingbodyandlinkname);
                     return true;
@@ -410,22 +427,48 @@ public:
         }
 
 private:
+        /// \brief returns true if the number of rays occluded by other targets does not exceed nallowableoutliers
+        ///
+        /// The rays are checked with CheckCollisionRays in batches of s_nRayBatchSize so that the checker can share the scene traversal between them.
+        /// \param vsamples the ray directions in the camera coordinate system
+        /// \param tcamera is the camera in the world coordinate system
+        bool _TestRays(const std::vector<Vector>& vsamples, const TransformMatrix& tcamera, int nallowableoutliers, std::string& errormsg)
+        {
+            static const size_t s_nRayBatchSize = 64;
+            EnvironmentBasePtr penv = _vf->_robot->GetEnv();
+            for(size_t istart = 0; istart < vsamples.size(); istart += s_nRayBatchSize) {
+                size_t iend = std::min(vsamples.size(), istart + s_nRayBatchSize);
+                _vrays.resize(iend - istart);
+                for(size_t isample = istart; isample < iend; ++isample) {
+                    const Vector& v = vsamples[isample];
+                    RAY& r = _vrays[isample - istart];
+                    dReal filen = 1/RaveSqrt(v.lengthsqr3());
+                    r.dir = tcamera.rotate((200.0f*filen)*v);                     // hardcoded test ray length of 200 meters
+                    r.pos = tcamera.trans + 0.5f*_vf->_fRayMinDist*r.dir;         // move the rays a little forward
+                }
+                penv->CheckCollisionRays(_vrays, _vrayreports);
+                for(size_t iray = 0; iray < _vrays.size(); ++iray) {
+                    if( !_TestRayHit(_vrays[iray], _vrayreports.at(iray), errormsg) ) {
+                        if( nallowableoutliers-- <= 0 ) {
+                            return false;
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+
         /// \brief return true if not occluded by any other target (ray hits the intended target box)
         ///
-        /// \brief v is in camera coordinate system
-        /// \brief tcamera is the camera in the world coordinate system
-        bool _TestRay(const Vector& v, const TransformMatrix& tcamera, std::string& errormsg)
+        /// \param r the ray in the world coordinate system
+        /// \param report the collision report of r, valid if r hit anything
+        bool _TestRayHit(const RAY& r, const CollisionReport& report, std::string& errormsg)
         {
-            RAY r;
-            dReal filen = 1/RaveSqrt(v.lengthsqr3());
-            r.dir = tcamera.rotate((200.0f*filen)*v);                     // hardcoded test ray length of 200 meters
-            r.pos = tcamera.trans + 0.5f*_vf->_fRayMinDist*r.dir;         // move the rays a little forward
-            if( !_vf->_robot->GetEnv()->CheckCollision(r,_report) ) {
+            if( !report.IsValid() ) {
                 return true;         // not supposed to happen, but it is OK
             }
 
-            BOOST_ASSERT(_report->IsValid());
-            const CollisionPairInfo& cpinfo = _report->vCollisionInfos.at(0);
+            const CollisionPairInfo& cpinfo = report.vCollisionInfos.at(0);
             
             //            RaveVector<float> vpoints[2];
             //            vpoints[0] = r.pos;
@@ -447,10 +490,12 @@ private:
                 }
                 else if( cpinfo.CompareFirstBodyName(_vf->_targetlink->GetParent()->GetName()) == 0 && cpinfo.CompareFirstLinkName(_vf->_targetlink->GetName()) == 0 ) {
                     // the original link is returned, have to check if the collision point is within _ptargetbox since we could be targeting one specific geometry rather than others.
-                    if( cpinfo.contacts.size() > 0 ) {
+                    // checkers that only return the distance along the ray do not fill the contacts
+                    if( cpinfo.contacts.size() > 0 || report.minDistance < 1e10 ) {
+                        Vector vcontact = cpinfo.contacts.size() > 0 ? cpinfo.contacts.at(0).pos : r.pos + r.dir*(report.minDistance/RaveSqrt(r.dir.lengthsqr3()));
                         // transform the contact point into the target link coordinate system
                         Transform ttarget = _vf->_targetlink->GetTransform();
-                        Vector vintargetlink = ttarget.inverse()*cpinfo.contacts.at(0).pos;
+                        Vector vintargetlink = ttarget.inverse()*vcontact;
                         // if vertex is inside any of the OBBs, then return true. Note: assumes that the original geometries are a box
                         bool bInside = false;
                         FOREACH(itobb, _vTargetLocalOBBs) {
@@ -492,6 +537,30 @@ private:
             return true;
         }
 
+        /// \brief disables the links that _IgnoreCollisionCallback ignores, the sensor robot and the invisible links
+        void _DisableIgnoredLinks(std::vector<KinBody::KinBodyStateSaverPtr>& vsavers)
+        {
+            std::vector<KinBodyPtr> vbodies;
+            _vf->GetEnv()->GetBodies(vbodies);
+            FOREACH(itbody, vbodies) {
+                KinBodyPtr pbody = *itbody;
+                if( pbody == _ptargetbox || !pbody->IsEnabled() ) {
+                    continue;
+                }
+                bool bSensorRobot = pbody == _vf->_sensorrobot;
+                bool bSaved = false;
+                FOREACHC(itlink, pbody->GetLinks()) {
+                    if( (*itlink)->IsEnabled() && (bSensorRobot || !(*itlink)->IsVisible()) ) {
+                        if( !bSaved ) {
+                            vsavers.push_back(KinBody::KinBodyStateSaverPtr(new KinBody::KinBodyStateSaver(pbody, KinBody::Save_LinkEnable)));
+                            bSaved = true;
+                        }
+                        (*itlink)->Enable(false);
+                    }
+                }
+            }
+        }
+
         CollisionAction _IgnoreCollisionCallback(CollisionReportPtr preport, bool IsCalledFromPhysicsEngine)
         {
             if( _bSamplingRays ) {
@@ -539,6 +608,9 @@ private:
         UserDataPtr _collisionfn;
 
         vector<OBB> _vTargetLocalOBBs;         ///< target geometry bounding boxes in the target link coordinate system
+        vector<Vector> _vraysamples;         ///< cache for the ray directions in the camera coordinate system
+        vector<RAY> _vrays;         ///< cache for a batch of rays
+        vector<CollisionReport> _vrayreports;         ///< cache for the reports of _vrays
         vector<dReal> _vsolution;
         IkReturnPtr _ikreturn;
         CollisionReportPtr _report;
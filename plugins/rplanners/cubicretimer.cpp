@@ -50,6 +50,7 @@ public:
 
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
     {
+        OPENRAVE_TRACE_SCOPE("CubicTrajectoryRetimer::PlanPath");
         _trajxmlid = ptraj->GetXMLId();
         return TrajectoryRetimer::PlanPath(ptraj, planningoptions);
     }
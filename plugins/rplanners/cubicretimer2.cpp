@@ -45,6 +45,7 @@ public:
 
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
     {
+        OPENRAVE_TRACE_SCOPE("CubicTrajectoryRetimer2::PlanPath");
         _pinterpolator.reset(new PiecewisePolynomials::CubicInterpolator(_parameters->GetDOF(), GetEnv()->GetId()));
         _ptranslationInterpolator.reset(new PiecewisePolynomials::CubicInterpolator(3, GetEnv()->GetId()));
         _checker.Initialize(_parameters->GetDOF(), GetEnv()->GetId());
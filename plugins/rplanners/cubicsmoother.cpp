@@ -36,16 +36,23 @@ public:
 
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
     {
+        OPENRAVE_TRACE_SCOPE("CubicSmoother::PlanPath");
         uint32_t startTime = utils::GetMilliTime();
+        _basetime = startTime;
 
         _limitsChecker.SetEpsilonForAccelerationDiscrepancyChecking(100*PiecewisePolynomials::g_fPolynomialEpsilon); // this follows cubic interpolator (see comments in CubicInterpolator::Initialize).
 
         BOOST_ASSERT(!!_parameters && !!ptraj);
+        PlannerProfile::StageTimer profiletimer(_parameters->_profile.get(), PlannerProfile::PPS_Smoothing);
         if( ptraj->GetNumWaypoints() < 2 ) {
             RAVELOG_WARN_FORMAT("env=%d, Input traj has %d waypoints.", _envId%ptraj->GetNumWaypoints());
             return PS_Failed;
         }
 
+        if( _shortcutWorkers.IsInitialized() && _parameters->_nMaxIterations > 0 ) {
+            return _PlanPathWithShortcutWorkers(ptraj, planningoptions);
+        }
+
         // Sample _fileIndex
         if( !!_loggingUniformSampler ) {
             _fileIndex = _loggingUniformSampler->SampleSequenceOneUInt32()%_fileIndexMod;
@@ -540,12 +547,18 @@ public:
         dReal tTotal = tOriginal;
         int iter = 0;
         int lastSuccessfulShortcutIter = -1;
+        bool bShortcutTimeExceeded = false;
         for(; iter < numIters; ++iter ) {
             if( tTotal < minTimeStep ) {
                 RAVELOG_DEBUG_FORMAT("env=%d, shortcut iter=%d/%d, tTotal=%.15e is too shortcut to continue (minTimeStep=%.15e)", _envId%iter%numIters%tTotal%minTimeStep);
                 break;
             }
 
+            if( IsPlanningTimeExceeded(*_parameters, _basetime) ) {
+                bShortcutTimeExceeded = true;
+                break;
+            }
+
             if( !CORRECT_VELACCELMULT ) {
                 // When using correct vel/accel mult, for now expect to get a lot more of slowing down iterations
                 if( nItersFromPrevSuccessful + nTimeBasedConstraintsFailed > nCutoffIters ) {
@@ -1028,7 +1041,7 @@ public:
                         itchunk->_iteration = iter;
                     }
 #endif
-                    pwptraj.ReplaceSegment(t0, t1, vChunksOut);
+                    pwptraj.ReplaceSegment(t0, t1, vChunksOut, _cacheReplaceChunk);
                 }
                 // RAVELOG_DEBUG_FORMAT("env=%d, fSegmentTime=%f; fDiff=%f; prevduration=%f; newduration=%f", _envId%fSegmentTime%fDiff%tTotal%pwptraj.duration);
                 tTotal = pwptraj.duration;
@@ -1060,7 +1073,10 @@ public:
         // Report statistics
         std::stringstream ss;
         ss << std::setprecision(std::numeric_limits<dReal>::digits10 + 1);
-        if( fScore/fCurrentBestScore < fCutoffRatio ) {
+        if( bShortcutTimeExceeded ) {
+            ss << "planning time exceeded (" << (utils::GetMilliTime() - _basetime) << "ms >= " << _parameters->_nMaxPlanningTime << "ms)";
+        }
+        else if( fScore/fCurrentBestScore < fCutoffRatio ) {
             ss << "current score falls below threshold (" << fScore/fCurrentBestScore << " < " << fCutoffRatio << ")";
         }
         else if( nItersFromPrevSuccessful + nTimeBasedConstraintsFailed > nCutoffIters ) {
@@ -11,7 +11,7 @@
 //
 // You should have received a copy of the GNU Lesser General Public License along with this program.
 // If not, see <http://www.gnu.org/licenses/>.
-#include "openraveplugindefs.h"
+#include "rplanners.h"
 #include <fstream>
 #include <openrave/planningutils.h>
 
@@ -43,6 +43,9 @@ public:
     JerkLimitedSmootherBase(EnvironmentBasePtr penv, std::istream& sinput) : PlannerBase(penv)
     {
         __description = "";
+        RegisterCommand("SetNumShortcutWorkers",boost::bind(&JerkLimitedSmootherBase::_SetNumShortcutWorkersCommand,this,_1,_2),
+                        "sets the number of independent smoothers run in parallel with different seeds on clones of the environment. The shortest result is kept. Shortcutting stops at _nMaxPlanningTime. 1 (default) disables the parallel mode.");
+        _nShortcutWorkers = 1;
         _bManipConstraints = false;
         _constraintReturn.reset(new ConstraintFilterReturn());
         _loggingUniformSampler = RaveCreateSpaceSampler(GetEnv(), "mt19937");
@@ -162,6 +165,7 @@ public:
         _tEndCheckPathAllConstraints = 0;
 #endif
 
+        _shortcutWorkers.Init(GetEnv(), GetPlannerName(), _nShortcutWorkers, _parameters);
         return !!_uniformSampler;
     }
 
@@ -581,7 +585,7 @@ protected:
     {
         // Cache stuff
         std::vector<dReal> &x0Vect = _cacheX0Vect;
-        std::vector<dReal> vAllWaypoints = _cacheAllWaypoints;
+        std::vector<dReal>& vAllWaypoints = _cacheAllWaypoints;
         std::vector<std::vector<dReal> >& vWaypoints = _cacheWaypoints;
 
         // If there is timing information, simply ignore it.
@@ -764,7 +768,7 @@ protected:
         size_t numWaypoints = vNewWaypoints.size();
 
 #ifdef JERK_LIMITED_SMOOTHER_VALIDATE
-        PiecewisePolynomials::PiecewisePolynomialTrajectory testtraj;
+        PiecewisePolynomials::PiecewisePolynomialTrajectory& testtraj = _cacheValidationTraj;
         std::vector<dReal> startValues, endValues, intermediateValues;
         const dReal collinearThresh = 1e-12;
 #endif
@@ -1046,6 +1050,29 @@ protected:
         ss << "];";
     }
 
+    /// \brief smoothes ptraj with every shortcut worker in parallel and keeps the result with the shortest duration
+    PlannerStatus _PlanPathWithShortcutWorkers(TrajectoryBasePtr ptraj, int planningoptions)
+    {
+        PlannerStatus status = _shortcutWorkers.PlanPath(ptraj, planningoptions, [this](const PlannerProgress& progress) {
+            return _CallCallbacks(progress);
+        }, _parameters->_profile);
+        if( !(status.GetStatusCode() & PS_HasSolution) ) {
+            return status;
+        }
+        return _ProcessPostPlanners(RobotBasePtr(), ptraj);
+    }
+
+    bool _SetNumShortcutWorkersCommand(std::ostream& sout, std::istream& sinput)
+    {
+        int nWorkers = 1;
+        sinput >> nWorkers;
+        if( !sinput ) {
+            return false;
+        }
+        _nShortcutWorkers = std::max(1, nWorkers);
+        return true;
+    }
+
     //
     // Members
     //
@@ -1063,6 +1090,10 @@ protected:
     bool _bManipConstraints; ///< if true, then there are manip vel/accel constraints
     boost::shared_ptr<ManipConstraintChecker3> _manipConstraintChecker;
     PlannerProgress _progress;
+    uint32_t _basetime = 0; ///< timestamp at the beginning of PlanPath. used for checking the _nMaxPlanningTime budget.
+
+    int _nShortcutWorkers; ///< if > 1, PlanPath runs this many smoothers with different seeds on cloned environments and keeps the shortest result
+    ParallelShortcutWorkers _shortcutWorkers;
     IntervalType _maskinterpolation = IT_Default; // a smoother derived from this class must set this according to their interpolation type
 
     // for logging
@@ -1087,6 +1118,8 @@ protected:
 
     std::vector<PiecewisePolynomials::Chunk> _cacheInterpolatedChunks; ///< for storing interpolation results
     std::vector<PiecewisePolynomials::Chunk> _cacheCheckedChunks; ///< for storing results from CheckChunkAllConstraints
+    PiecewisePolynomials::Chunk _cacheReplaceChunk; ///< scratch for PiecewisePolynomialTrajectory::ReplaceSegment during shortcutting
+    PiecewisePolynomials::PiecewisePolynomialTrajectory _cacheValidationTraj; ///< for validating the initial time-parameterization
 
     // for use in CheckChunkAllConstraints.
     std::vector<dReal> _cacheX0Vect2, _cacheX1Vect2, _cacheV0Vect2, _cacheV1Vect2, _cacheA0Vect2, _cacheA1Vect2;
@@ -0,0 +1,912 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2011 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "openraveplugindefs.h"
+
+#include <cmath>
+#include <functional>
+#include <queue>
+
+/// \brief A* on a (x, y, heading) lattice for planar bases, see the __description for the details
+class LatticePlanner : public PlannerBase
+{
+public:
+    class LatticeParameters : public PlannerBase::PlannerParameters {
+public:
+        LatticeParameters() : fCellSize(0.05), nNumHeadings(16), nPrimitiveLength(4), fReverseCostMultiplier(3), fRotationWeight(0.2), fInscribedRadius(0), fFloorClearance(0.01), fHeuristicWeight(1), _bProcessingLattice(false) {
+            _vXMLParameters.push_back("cellsize");
+            _vXMLParameters.push_back("numheadings");
+            _vXMLParameters.push_back("primitivelength");
+            _vXMLParameters.push_back("reversecostmultiplier");
+            _vXMLParameters.push_back("rotationweight");
+            _vXMLParameters.push_back("inscribedradius");
+            _vXMLParameters.push_back("floorclearance");
+            _vXMLParameters.push_back("heuristicweight");
+        }
+
+        dReal fCellSize;                ///< size of the cells of the occupancy grid and of the lattice in meters
+        int nNumHeadings;               ///< number of discretized headings
+        int nPrimitiveLength;           ///< length of the translating motion primitives in cells
+        dReal fReverseCostMultiplier;   ///< multiplies the cost of driving backwards, if <= 0, the base only drives forwards
+        dReal fRotationWeight;          ///< cost of rotating the base by one radian in meters
+        dReal fInscribedRadius;         ///< radius of a circle centered at the base origin that is always inside the robot, poses with an obstacle closer than it are rejected without collision checking
+        dReal fFloorClearance;          ///< geometry lower than the bottom of the robot plus this clearance is not an obstacle
+        dReal fHeuristicWeight;         ///< > 1 makes the search greedier at the expense of the optimality of the path
+protected:
+        bool _bProcessingLattice;
+        virtual bool serialize(std::ostream& O) const
+        {
+            if( !PlannerParameters::serialize(O) ) {
+                return false;
+            }
+            O << "<cellsize>" << fCellSize << "</cellsize>" << endl;
+            O << "<numheadings>" << nNumHeadings << "</numheadings>" << endl;
+            O << "<primitivelength>" << nPrimitiveLength << "</primitivelength>" << endl;
+            O << "<reversecostmultiplier>" << fReverseCostMultiplier << "</reversecostmultiplier>" << endl;
+            O << "<rotationweight>" << fRotationWeight << "</rotationweight>" << endl;
+            O << "<inscribedradius>" << fInscribedRadius << "</inscribedradius>" << endl;
+            O << "<floorclearance>" << fFloorClearance << "</floorclearance>" << endl;
+            O << "<heuristicweight>" << fHeuristicWeight << "</heuristicweight>" << endl;
+            return !!O;
+        }
+
+        ProcessElement startElement(const std::string& name, const AttributesList& atts)
+        {
+            if( _bProcessingLattice ) {
+                return PE_Ignore;
+            }
+            switch( PlannerBase::PlannerParameters::startElement(name,atts) ) {
+            case PE_Pass: break;
+            case PE_Support: return PE_Support;
+            case PE_Ignore: return PE_Ignore;
+            }
+            _bProcessingLattice = name=="cellsize"||name=="numheadings"||name=="primitivelength"||name=="reversecostmultiplier"||name=="rotationweight"||name=="inscribedradius"||name=="floorclearance"||name=="heuristicweight";
+            return _bProcessingLattice ? PE_Support : PE_Pass;
+        }
+        virtual bool endElement(const string& name)
+        {
+            if( _bProcessingLattice ) {
+                if( name == "cellsize") {
+                    _ss >> fCellSize;
+                }
+                else if( name == "numheadings") {
+                    _ss >> nNumHeadings;
+                }
+                else if( name == "primitivelength") {
+                    _ss >> nPrimitiveLength;
+                }
+                else if( name == "reversecostmultiplier") {
+                    _ss >> fReverseCostMultiplier;
+                }
+                else if( name == "rotationweight") {
+                    _ss >> fRotationWeight;
+                }
+                else if( name == "inscribedradius") {
+                    _ss >> fInscribedRadius;
+                }
+                else if( name == "floorclearance") {
+                    _ss >> fFloorClearance;
+                }
+                else if( name == "heuristicweight") {
+                    _ss >> fHeuristicWeight;
+                }
+                else {
+                    RAVELOG_WARN(str(boost::format("unknown tag %s\n")%name));
+                }
+                _bProcessingLattice = false;
+                return false;
+            }
+            // give a chance for the default parameters to get processed
+            return PlannerParameters::endElement(name);
+        }
+    };
+    typedef boost::shared_ptr<LatticeParameters> LatticeParametersPtr;
+
+    LatticePlanner(EnvironmentBasePtr penv, std::istream& sinput) : PlannerBase(penv)
+    {
+        __description = "\
+A* search over a lattice of base poses (x, y, heading) for robots whose active dofs are DOF_X|DOF_Y|DOF_RotationAxis around the z axis.\n\n\
+The successors of a pose are precomputed motion primitives: driving forward or backward by 'primitivelength' cells, turning left or right by one heading while driving forward, and rotating in place. \
+Obstacles are rasterized once from TriangulateSceneView into a 2D occupancy grid between the bottom and the top of the robot and a distance transform is computed on it. \
+Primitives that stay farther from the obstacles than the circumscribed radius of the robot are accepted without collision checking, the others are checked with the planner constraints. \
+The grid is kept across queries until a body of the environment changes, that is until its update stamp changes or bodies are added or removed.\n\n\
+The search is guided by a 2D Dijkstra over the grid from the goal cells, so dead ends are recognized before expanding the headings. \
+Multiple goals can be given in vgoalconfig. The nodes and the open list are kept in arrays that are reused by the next queries.\n";
+        _nGridX = _nGridY = 0;
+        _fRobotRadius = 0;
+        _fRobotZMin = _fRobotZMax = 0;
+        _bGridValid = false;
+        _bHeuristicValid = false;
+    }
+
+    virtual ~LatticePlanner() {
+    }
+
+    virtual PlannerStatus InitPlan(RobotBasePtr probot, PlannerParametersConstPtr pparams) override
+    {
+        EnvironmentLock lock(GetEnv()->GetMutex());
+        _parameters.reset();
+        _robot = probot;
+        LatticeParametersPtr parameters(new LatticeParameters());
+        parameters->copy(pparams);
+
+        if( parameters->GetDOF() != 3 || _robot->GetActiveDOF() != 3 || _robot->GetActiveDOFIndices().size() > 0 || _robot->GetAffineDOF() != (DOF_X|DOF_Y|DOF_RotationAxis) ) {
+            return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, lattice planner needs the active dofs of robot %s to be DOF_X|DOF_Y|DOF_RotationAxis")%GetEnv()->GetNameId()%_robot->GetName()), PS_Failed);
+        }
+        if( RaveFabs(_robot->GetAffineRotationAxis().z) < 1-g_fEpsilonLinear ) {
+            return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, lattice planner needs the affine rotation axis of robot %s to be the z axis")%GetEnv()->GetNameId()%_robot->GetName()), PS_Failed);
+        }
+        if( parameters->fCellSize <= 0 || parameters->nNumHeadings < 4 || parameters->nPrimitiveLength <= 0 ) {
+            return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, invalid lattice cellsize=%f, numheadings=%d, primitivelength=%d")%GetEnv()->GetNameId()%parameters->fCellSize%parameters->nNumHeadings%parameters->nPrimitiveLength), PS_Failed);
+        }
+        if( parameters->vinitialconfig.size() != 3 || parameters->vgoalconfig.size() == 0 || (parameters->vgoalconfig.size() % 3) != 0 ) {
+            return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, lattice planner needs one initial config and at least one goal config")%GetEnv()->GetNameId()), PS_Failed);
+        }
+
+        if( _vprimitives.size() != (size_t)parameters->nNumHeadings || _fPrimitivesCellSize != parameters->fCellSize || _nPrimitivesLength != parameters->nPrimitiveLength || _fPrimitivesReverseCostMultiplier != parameters->fReverseCostMultiplier || _fPrimitivesRotationWeight != parameters->fRotationWeight ) {
+            _ComputeMotionPrimitives(*parameters);
+        }
+        if( _fGridCellSize != parameters->fCellSize ) {
+            _bGridValid = false;
+        }
+
+        // the footprint of the robot and the grabbed bodies, the circle around the base origin contains every link whatever the heading
+        {
+            RobotBase::RobotStateSaver savestate(_robot);
+            std::vector<KinBodyPtr> vgrabbed;
+            _robot->GetGrabbed(vgrabbed);
+            vgrabbed.push_back(_robot);
+            const Vector vbaseorigin = _robot->GetTransform().trans;
+            dReal fradius = 0, fzmin = 1e30, fzmax = -1e30;
+            FOREACHC(itbody, vgrabbed) {
+                FOREACHC(itlink, (*itbody)->GetLinks()) {
+                    if( !(*itlink)->IsEnabled() || (*itlink)->GetGeometries().size() == 0 ) {
+                        continue;
+                    }
+                    AABB ab = (*itlink)->ComputeAABB();
+                    fradius = max(fradius, RaveSqrt((ab.pos.x-vbaseorigin.x)*(ab.pos.x-vbaseorigin.x) + (ab.pos.y-vbaseorigin.y)*(ab.pos.y-vbaseorigin.y)) + RaveSqrt(ab.extents.x*ab.extents.x + ab.extents.y*ab.extents.y));
+                    fzmin = min(fzmin, ab.pos.z - ab.extents.z);
+                    fzmax = max(fzmax, ab.pos.z + ab.extents.z);
+                }
+            }
+            if( fzmin > fzmax ) {
+                return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, robot %s has no enabled geometry")%GetEnv()->GetNameId()%_robot->GetName()), PS_Failed);
+            }
+            fzmin += parameters->fFloorClearance;
+            if( fzmin != _fRobotZMin || fzmax != _fRobotZMax ) {
+                _bGridValid = false;
+            }
+            _fRobotRadius = fradius;
+            _fRobotZMin = fzmin;
+            _fRobotZMax = fzmax;
+        }
+
+        _vtempconfig0.resize(3);
+        _vtempconfig1.resize(3);
+        _parameters = parameters;
+        return PlannerStatus(PS_HasSolution);
+    }
+
+    virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
+    {
+        OPENRAVE_TRACE_SCOPE("LatticePlanner::PlanPath");
+        if( !_parameters ) {
+            return PlannerStatus("parameters are not set", PS_Failed);
+        }
+        EnvironmentLock lock(GetEnv()->GetMutex());
+        RobotBase::RobotStateSaver saver(_robot);
+        uint64_t basetimeus = utils::GetMonotonicTime();
+        const LatticeParameters& params = *_parameters;
+        const int numheadings = params.nNumHeadings;
+
+        if( !_UpdateGrid() ) {
+            return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, failed to build the occupancy grid with cellsize %f")%GetEnv()->GetNameId()%params.fCellSize), PS_Failed);
+        }
+
+        // snap the initial and goal configurations to the lattice and check the connections to the exact configurations
+        int startstate = -1;
+        if( !_SnapConfig(params.vinitialconfig, startstate) ) {
+            return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, initial config is outside of the occupancy grid")%GetEnv()->GetNameId()), PS_Failed);
+        }
+        _GetStateConfig(startstate, _vtempconfig0);
+        if( params.CheckPathAllConstraints(params.vinitialconfig, _vtempconfig0, std::vector<dReal>(), std::vector<dReal>(), 0, IT_Closed) != 0 ) {
+            return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, cannot connect the initial config to the lattice")%GetEnv()->GetNameId()), PS_Failed);
+        }
+
+        _vgoalstates.resize(0);
+        _vgoalindices.resize(0);
+        std::vector<dReal> vgoal(3);
+        for(size_t igoal = 0; igoal < params.vgoalconfig.size()/3; ++igoal) {
+            std::copy(params.vgoalconfig.begin()+3*igoal, params.vgoalconfig.begin()+3*igoal+3, vgoal.begin());
+            int goalstate = -1;
+            if( !_SnapConfig(vgoal, goalstate) ) {
+                RAVELOG_WARN_FORMAT("env=%s, goal %d is outside of the occupancy grid", GetEnv()->GetNameId()%igoal);
+                continue;
+            }
+            _GetStateConfig(goalstate, _vtempconfig1);
+            if( params.CheckPathAllConstraints(_vtempconfig1, vgoal, std::vector<dReal>(), std::vector<dReal>(), 0, IT_Closed) != 0 ) {
+                RAVELOG_DEBUG_FORMAT("env=%s, cannot connect goal %d to the lattice", GetEnv()->GetNameId()%igoal);
+                continue;
+            }
+            _vgoalstates.push_back(goalstate);
+            _vgoalindices.push_back(igoal);
+        }
+        if( _vgoalstates.size() == 0 ) {
+            return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, no goal can be connected to the lattice")%GetEnv()->GetNameId()), PS_Failed);
+        }
+
+        _UpdateHeuristic();
+
+        // A*, the nodes are indexed through _vstatenodes and only the touched entries are reset at the end
+        const size_t numstates = (size_t)_nGridX*_nGridY*numheadings;
+        if( _vstatenodes.size() != numstates ) {
+            _vstatenodes.resize(0);
+            _vstatenodes.resize(numstates, -1);
+        }
+        _vnodes.resize(0);
+        _vheap.resize(0);
+
+        int igoalnode = -1;
+        PlannerStatus status;
+        bool bStopped = false;
+        {
+            LatticeNode startnode;
+            startnode.state = startstate;
+            startnode.g = 0;
+            startnode.f = _ComputeHeuristic(startstate);
+            _vnodes.push_back(startnode);
+            _vstatenodes[startstate] = 0;
+            if( startnode.f < s_fInfinity ) {
+                _HeapPush(0);
+            }
+        }
+
+        int nMaxIterations = params._nMaxIterations > 0 ? params._nMaxIterations : 1000000;
+        int numexpansions = 0;
+        PlannerProgress progress;
+        while( _vheap.size() > 0 ) {
+            const int inode = _HeapPop();
+            _vnodes[inode].closed = true;
+            const int state = _vnodes[inode].state;
+            if( std::find(_vgoalstates.begin(), _vgoalstates.end(), state) != _vgoalstates.end() ) {
+                igoalnode = inode;
+                break;
+            }
+
+            if( ++numexpansions > nMaxIterations ) {
+                status = OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, exceeded %d expansions")%GetEnv()->GetNameId()%nMaxIterations), PS_Failed);
+                bStopped = true;
+                break;
+            }
+            if( (numexpansions & 0xff) == 0 ) {
+                progress._iteration = numexpansions;
+                if( _CallCallbacks(progress) == PA_Interrupt ) {
+                    status = OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, planning was interrupted")%GetEnv()->GetNameId()), PS_Interrupted);
+                    bStopped = true;
+                    break;
+                }
+                if( params._nMaxPlanningTime > 0 && utils::GetMonotonicTime()-basetimeus >= 1000*(uint64_t)params._nMaxPlanningTime ) {
+                    status = OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, time exceeded after %d expansions")%GetEnv()->GetNameId()%numexpansions), PS_Failed);
+                    bStopped = true;
+                    break;
+                }
+            }
+
+            const int heading = state % numheadings;
+            const int cell = state / numheadings;
+            const int ix = cell % _nGridX, iy = cell / _nGridX;
+            const std::vector<MotionPrimitive>& vprimitives = _vprimitives[heading];
+            for(size_t iprimitive = 0; iprimitive < vprimitives.size(); ++iprimitive) {
+                const MotionPrimitive& primitive = vprimitives[iprimitive];
+                const int nextx = ix + primitive.dx, nexty = iy + primitive.dy;
+                if( nextx < 0 || nextx >= _nGridX || nexty < 0 || nexty >= _nGridY ) {
+                    continue;
+                }
+                const int nextstate = (nexty*_nGridX + nextx)*numheadings + primitive.endheading;
+                int inextnode = _vstatenodes[nextstate];
+                const dReal g = _vnodes[inode].g + primitive.cost;
+                if( inextnode >= 0 && (_vnodes[inextnode].closed || g >= _vnodes[inextnode].g) ) {
+                    continue;
+                }
+                if( !_CheckPrimitive(ix, iy, heading, primitive) ) {
+                    continue;
+                }
+                if( inextnode < 0 ) {
+                    dReal h = _ComputeHeuristic(nextstate);
+                    if( h >= s_fInfinity ) {
+                        continue;
+                    }
+                    inextnode = (int)_vnodes.size();
+                    _vnodes.push_back(LatticeNode());
+                    LatticeNode& nextnode = _vnodes.back();
+                    nextnode.state = nextstate;
+                    nextnode.parent = inode;
+                    nextnode.g = g;
+                    nextnode.f = g + h;
+                    _vstatenodes[nextstate] = inextnode;
+                    _HeapPush(inextnode);
+                }
+                else {
+                    LatticeNode& nextnode = _vnodes[inextnode];
+                    nextnode.f += g - nextnode.g;
+                    nextnode.g = g;
+                    nextnode.parent = inode;
+                    _HeapDecrease(inextnode);
+                }
+            }
+        }
+
+        // prepare the arrays for the next query
+        FOREACHC(itnode, _vnodes) {
+            _vstatenodes[itnode->state] = -1;
+        }
+
+        if( igoalnode < 0 ) {
+            if( !bStopped ) {
+                status = OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, lattice search exhausted after %d expansions")%GetEnv()->GetNameId()%numexpansions), PS_Failed);
+            }
+            return status;
+        }
+
+        // the states from the goal to the start
+        std::vector<int> vpathstates;
+        for(int inode = igoalnode; inode >= 0; inode = _vnodes[inode].parent) {
+            vpathstates.push_back(_vnodes[inode].state);
+        }
+        const int goalstate = vpathstates.front();
+        const size_t igoal = _vgoalindices.at(std::find(_vgoalstates.begin(), _vgoalstates.end(), goalstate) - _vgoalstates.begin());
+
+        // waypoints with the rotation unwrapped so that the trajectory interpolates the short way
+        std::vector<dReal> vwaypoints;
+        vwaypoints.reserve(3*(vpathstates.size()+2));
+        vwaypoints.insert(vwaypoints.end(), params.vinitialconfig.begin(), params.vinitialconfig.end());
+        for(std::vector<int>::reverse_iterator itstate = vpathstates.rbegin(); itstate != vpathstates.rend(); ++itstate) {
+            _GetStateConfig(*itstate, _vtempconfig0);
+            _AppendUnwrapped(vwaypoints, _vtempconfig0);
+        }
+        std::copy(params.vgoalconfig.begin()+3*igoal, params.vgoalconfig.begin()+3*igoal+3, vgoal.begin());
+        _AppendUnwrapped(vwaypoints, vgoal);
+
+        if( params._configurationspecification != ptraj->GetConfigurationSpecification() ) {
+            ptraj->Init(params._configurationspecification);
+        }
+        ptraj->Insert(ptraj->GetNumWaypoints(), vwaypoints);
+
+        RAVELOG_DEBUG_FORMAT("env=%s, lattice path with %d states to goal %d, cost=%f, expansions=%d, nodes=%d, time=%fs", GetEnv()->GetNameId()%vpathstates.size()%igoal%_vnodes[igoalnode].g%numexpansions%_vnodes.size()%(1e-6*(utils::GetMonotonicTime()-basetimeus)));
+        _ProcessPostPlanners(_robot,ptraj);
+        return PlannerStatus(PS_HasSolution);
+    }
+
+    virtual PlannerParametersConstPtr GetParameters() const override {
+        return _parameters;
+    }
+
+private:
+    /// \brief successor of a lattice pose, relative to the cell and heading of the pose
+    struct MotionPrimitive
+    {
+        int dx, dy;         ///< cell offset of the end pose
+        int endheading;     ///< heading of the end pose
+        dReal cost;
+        std::vector< std::pair<int,int> > vsweptcells; ///< cell offsets the base origin goes through, the footprint check is rotation invariant so only the cells matter
+    };
+
+    struct LatticeNode
+    {
+        LatticeNode() : state(-1), parent(-1), heapindex(-1), closed(false), g(0), f(0) {
+        }
+        int state;
+        int parent;         ///< index in _vnodes
+        int heapindex;      ///< index in _vheap, -1 if not in the open list
+        bool closed;
+        dReal g, f;
+    };
+
+    void _ComputeMotionPrimitives(const LatticeParameters& params)
+    {
+        const int numheadings = params.nNumHeadings;
+        const dReal fheadingstep = 2*PI/numheadings;
+        const dReal flength = params.nPrimitiveLength;
+        _vprimitives.resize(numheadings);
+        for(int heading = 0; heading < numheadings; ++heading) {
+            std::vector<MotionPrimitive>& vprimitives = _vprimitives[heading];
+            vprimitives.resize(0);
+            const dReal ftheta = heading*fheadingstep;
+            for(int turn = -1; turn <= 1; ++turn) {
+                // the end of an arc is approximated by the chord at the mean heading
+                const dReal fmeantheta = ftheta + 0.5*turn*fheadingstep;
+                MotionPrimitive primitive;
+                primitive.dx = (int)std::floor(flength*RaveCos(fmeantheta) + 0.5);
+                primitive.dy = (int)std::floor(flength*RaveSin(fmeantheta) + 0.5);
+                primitive.endheading = (heading + turn + numheadings) % numheadings;
+                const dReal fdist = params.fCellSize*RaveSqrt(dReal(primitive.dx*primitive.dx + primitive.dy*primitive.dy));
+                primitive.cost = fdist + params.fRotationWeight*RaveFabs(turn*fheadingstep);
+                _ComputeSweptCells(primitive);
+                vprimitives.push_back(primitive);
+                if( turn == 0 && params.fReverseCostMultiplier > 0 ) {
+                    MotionPrimitive reverseprimitive = primitive;
+                    reverseprimitive.dx = -primitive.dx;
+                    reverseprimitive.dy = -primitive.dy;
+                    reverseprimitive.cost = fdist*params.fReverseCostMultiplier;
+                    _ComputeSweptCells(reverseprimitive);
+                    vprimitives.push_back(reverseprimitive);
+                }
+            }
+            for(int turn = -1; turn <= 1; turn += 2) {
+                MotionPrimitive primitive;
+                primitive.dx = primitive.dy = 0;
+                primitive.endheading = (heading + turn + numheadings) % numheadings;
+                // never 0 so that rotating in place does not create zero cost cycles
+                primitive.cost = max(params.fRotationWeight, dReal(g_fEpsilonLinear))*fheadingstep;
+                _ComputeSweptCells(primitive);
+                vprimitives.push_back(primitive);
+            }
+        }
+        _fPrimitivesCellSize = params.fCellSize;
+        _nPrimitivesLength = params.nPrimitiveLength;
+        _fPrimitivesReverseCostMultiplier = params.fReverseCostMultiplier;
+        _fPrimitivesRotationWeight = params.fRotationWeight;
+    }
+
+    static void _ComputeSweptCells(MotionPrimitive& primitive)
+    {
+        primitive.vsweptcells.resize(0);
+        // the base starts at the center of its cell, sample every half cell
+        const dReal flength = RaveSqrt(dReal(primitive.dx*primitive.dx + primitive.dy*primitive.dy));
+        const int numsamples = max(1, (int)RaveCeil(2*flength));
+        for(int isample = 0; isample <= numsamples; ++isample) {
+            const dReal fraction = dReal(isample)/numsamples;
+            const std::pair<int,int> cell((int)std::floor(0.5 + fraction*primitive.dx), (int)std::floor(0.5 + fraction*primitive.dy));
+            if( std::find(primitive.vsweptcells.begin(), primitive.vsweptcells.end(), cell) == primitive.vsweptcells.end() ) {
+                primitive.vsweptcells.push_back(cell);
+            }
+        }
+    }
+
+    /// \brief checks the cells a primitive sweeps, falls back to the planner constraints only when an obstacle could touch the robot
+    bool _CheckPrimitive(int ix, int iy, int heading, const MotionPrimitive& primitive)
+    {
+        const dReal fCellDiagonal = _fGridCellSize*RaveSqrt(dReal(2));
+        bool bNeedCheck = false;
+        FOREACHC(itcell, primitive.vsweptcells) {
+            const int cx = ix + itcell->first, cy = iy + itcell->second;
+            if( cx < 0 || cx >= _nGridX || cy < 0 || cy >= _nGridY ) {
+                return false;
+            }
+            const dReal fdist = _vgriddist[cy*_nGridX + cx];
+            if( fdist + fCellDiagonal < _parameters->fInscribedRadius ) {
+                return false;
+            }
+            if( fdist - _fGridSlack < _fRobotRadius ) {
+                bNeedCheck = true;
+            }
+        }
+        if( !bNeedCheck ) {
+            return true;
+        }
+        const int numheadings = _parameters->nNumHeadings;
+        _GetStateConfig((iy*_nGridX + ix)*numheadings + heading, _vtempconfig0);
+        _GetStateConfig(((iy+primitive.dy)*_nGridX + ix + primitive.dx)*numheadings + primitive.endheading, _vtempconfig1);
+        return _parameters->CheckPathAllConstraints(_vtempconfig0, _vtempconfig1, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart) == 0;
+    }
+
+    /// \brief rebuilds the occupancy grid and its distance transform if a body changed since the last build
+    ///
+    /// \return false if the grid would be too large
+    bool _UpdateGrid()
+    {
+        const LatticeParameters& params = *_parameters;
+        std::vector<KinBodyPtr> vgrabbed;
+        _robot->GetGrabbed(vgrabbed);
+        GetEnv()->GetBodies(_vbodies);
+        _vbodystamps.resize(0);
+        FOREACHC(itbody, _vbodies) {
+            if( *itbody == _robot || std::find(vgrabbed.begin(), vgrabbed.end(), *itbody) != vgrabbed.end() ) {
+                continue;
+            }
+            _vbodystamps.push_back(std::make_pair((*itbody)->GetEnvironmentBodyIndex(), (*itbody)->GetUpdateStamp()));
+        }
+        _vbodies.resize(0);
+        std::sort(_vbodystamps.begin(), _vbodystamps.end());
+
+        // the initial and goal configurations have to be inside the grid with some margin
+        dReal fxmin = params.vinitialconfig[0], fxmax = params.vinitialconfig[0], fymin = params.vinitialconfig[1], fymax = params.vinitialconfig[1];
+        for(size_t i = 0; i+2 < params.vgoalconfig.size(); i += 3) {
+            fxmin = min(fxmin, params.vgoalconfig[i]);
+            fxmax = max(fxmax, params.vgoalconfig[i]);
+            fymin = min(fymin, params.vgoalconfig[i+1]);
+            fymax = max(fymax, params.vgoalconfig[i+1]);
+        }
+        const dReal fmargin = 2*_fRobotRadius + params.nPrimitiveLength*params.fCellSize;
+        if( _bGridValid && _vbodystamps == _vgridbodystamps
+            && fxmin - fmargin >= _vGridOrigin.x && fymin - fmargin >= _vGridOrigin.y
+            && fxmax + fmargin <= _vGridOrigin.x + _nGridX*_fGridCellSize && fymax + fmargin <= _vGridOrigin.y + _nGridY*_fGridCellSize ) {
+            return true;
+        }
+
+        _bGridValid = false;
+        _bHeuristicValid = false;
+        const dReal fcellsize = params.fCellSize;
+
+        // clip the triangles of the obstacles to the height of the robot and keep their 2D projection
+        std::vector<EnvironmentBase::TriMeshViewPart> vparts;
+        GetEnv()->TriangulateSceneView(vparts, EnvironmentBase::SO_Everything, "");
+        _vcliptriangles.resize(0);
+        std::vector<Vector> vpolygon, vclipped;
+        FOREACHC(itpart, vparts) {
+            if( !std::binary_search(_vbodystamps.begin(), _vbodystamps.end(), std::make_pair(itpart->bodyIndex, std::numeric_limits<int>::min()), _CompareBodyIndex) ) {
+                continue;
+            }
+            KinBodyPtr pbody = GetEnv()->GetBodyFromEnvironmentBodyIndex(itpart->bodyIndex);
+            if( !pbody || itpart->linkIndex < 0 || itpart->linkIndex >= (int)pbody->GetLinks().size() || !pbody->GetLinks()[itpart->linkIndex]->IsEnabled() ) {
+                continue;
+            }
+            const TriMesh& mesh = *itpart->pmesh;
+            for(size_t iindex = 0; iindex+2 < mesh.indices.size(); iindex += 3) {
+                vpolygon.resize(3);
+                for(int j = 0; j < 3; ++j) {
+                    vpolygon[j] = itpart->transform*mesh.vertices.at(mesh.indices[iindex+j]);
+                }
+                _ClipPolygonZ(vpolygon, _fRobotZMin, true, vclipped);
+                _ClipPolygonZ(vclipped, _fRobotZMax, false, vpolygon);
+                for(size_t j = 1; j+1 < vpolygon.size(); ++j) {
+                    _vcliptriangles.push_back(vpolygon[0]);
+                    _vcliptriangles.push_back(vpolygon[j]);
+                    _vcliptriangles.push_back(vpolygon[j+1]);
+                }
+            }
+        }
+        FOREACHC(itpoint, _vcliptriangles) {
+            fxmin = min(fxmin, itpoint->x);
+            fxmax = max(fxmax, itpoint->x);
+            fymin = min(fymin, itpoint->y);
+            fymax = max(fymax, itpoint->y);
+        }
+
+        _vGridOrigin = Vector(fxmin - fmargin, fymin - fmargin, 0);
+        _nGridX = (int)RaveCeil((fxmax - fxmin + 2*fmargin)/fcellsize) + 1;
+        _nGridY = (int)RaveCeil((fymax - fymin + 2*fmargin)/fcellsize) + 1;
+        if( (uint64_t)_nGridX*_nGridY*params.nNumHeadings > s_nMaxLatticeStates ) {
+            RAVELOG_WARN_FORMAT("env=%s, lattice of %dx%dx%d states is too large, increase the cellsize", GetEnv()->GetNameId()%_nGridX%_nGridY%params.nNumHeadings);
+            _nGridX = _nGridY = 0;
+            return false;
+        }
+        _fGridCellSize = fcellsize;
+        // a point inside a cell is at most half a diagonal from its center, and every point of an obstacle is at most half a cell from a rasterized sample
+        _fGridSlack = fcellsize*(RaveSqrt(dReal(2)) + 0.5);
+
+        // rasterize the triangles by sampling them every half cell
+        std::vector<uint8_t> voccupied(_nGridX*_nGridY, 0);
+        const dReal fcellsizeinv = 1/fcellsize;
+        for(size_t itri = 0; itri < _vcliptriangles.size(); itri += 3) {
+            const Vector& v0 = _vcliptriangles[itri];
+            const Vector e1 = _vcliptriangles[itri+1] - v0, e2 = _vcliptriangles[itri+2] - v0, e3 = _vcliptriangles[itri+2] - _vcliptriangles[itri+1];
+            const dReal fmaxedge = RaveSqrt(max(e1.x*e1.x + e1.y*e1.y, max(e2.x*e2.x + e2.y*e2.y, e3.x*e3.x + e3.y*e3.y)));
+            const int numsamples = max(1, (int)RaveCeil(2*fmaxedge*fcellsizeinv));
+            const dReal fsampleinv = dReal(1)/numsamples;
+            for(int i = 0; i <= numsamples; ++i) {
+                for(int j = 0; i + j <= numsamples; ++j) {
+                    const dReal x = v0.x + (i*e1.x + j*e2.x)*fsampleinv, y = v0.y + (i*e1.y + j*e2.y)*fsampleinv;
+                    const int cx = (int)((x - _vGridOrigin.x)*fcellsizeinv), cy = (int)((y - _vGridOrigin.y)*fcellsizeinv);
+                    if( cx >= 0 && cx < _nGridX && cy >= 0 && cy < _nGridY ) {
+                        voccupied[cy*_nGridX + cx] = 1;
+                    }
+                }
+            }
+        }
+
+        _ComputeDistanceTransform(voccupied);
+        _vgridbodystamps = _vbodystamps;
+        _bGridValid = true;
+        RAVELOG_DEBUG_FORMAT("env=%s, built %dx%d occupancy grid from %d triangles", GetEnv()->GetNameId()%_nGridX%_nGridY%(_vcliptriangles.size()/3));
+        return true;
+    }
+
+    static bool _CompareBodyIndex(const std::pair<int,int>& p0, const std::pair<int,int>& p1) {
+        return p0.first < p1.first;
+    }
+
+    /// \brief Sutherland-Hodgman clipping of a convex polygon against a horizontal plane
+    static void _ClipPolygonZ(const std::vector<Vector>& vpolygon, dReal z, bool bKeepAbove, std::vector<Vector>& vclipped)
+    {
+        vclipped.resize(0);
+        for(size_t i = 0; i < vpolygon.size(); ++i) {
+            const Vector& v0 = vpolygon[i];
+            const Vector& v1 = vpolygon[(i+1)%vpolygon.size()];
+            const dReal d0 = bKeepAbove ? v0.z - z : z - v0.z;
+            const dReal d1 = bKeepAbove ? v1.z - z : z - v1.z;
+            if( d0 >= 0 ) {
+                vclipped.push_back(v0);
+            }
+            if( (d0 >= 0) != (d1 >= 0) ) {
+                vclipped.push_back(v0 + (v1 - v0)*(d0/(d0 - d1)));
+            }
+        }
+    }
+
+    /// \brief exact euclidean distance transform of Felzenszwalb and Huttenlocher, fills _vgriddist with the distance to the closest occupied cell in meters
+    void _ComputeDistanceTransform(const std::vector<uint8_t>& voccupied)
+    {
+        const double finf = 1e20;
+        const int maxsize = max(_nGridX, _nGridY);
+        _vdtinput.resize(maxsize);
+        _vdtoutput.resize(maxsize);
+        _vdtenvelope.resize(maxsize+1);
+        _vdtparabolas.resize(maxsize);
+
+        std::vector<double> vsqrdist(_nGridX*_nGridY);
+        for(size_t i = 0; i < voccupied.size(); ++i) {
+            vsqrdist[i] = voccupied[i] ? 0 : finf;
+        }
+        for(int x = 0; x < _nGridX; ++x) {
+            for(int y = 0; y < _nGridY; ++y) {
+                _vdtinput[y] = vsqrdist[y*_nGridX + x];
+            }
+            _DistanceTransform1D(_nGridY);
+            for(int y = 0; y < _nGridY; ++y) {
+                vsqrdist[y*_nGridX + x] = _vdtoutput[y];
+            }
+        }
+        for(int y = 0; y < _nGridY; ++y) {
+            std::copy(vsqrdist.begin() + y*_nGridX, vsqrdist.begin() + (y+1)*_nGridX, _vdtinput.begin());
+            _DistanceTransform1D(_nGridX);
+            std::copy(_vdtoutput.begin(), _vdtoutput.begin() + _nGridX, vsqrdist.begin() + y*_nGridX);
+        }
+        _vgriddist.resize(vsqrdist.size());
+        for(size_t i = 0; i < vsqrdist.size(); ++i) {
+            // no obstacle at all leaves finf, which is farther than any robot
+            _vgriddist[i] = vsqrdist[i] >= finf ? dReal(1e10) : _fGridCellSize*RaveSqrt(dReal(vsqrdist[i]));
+        }
+    }
+
+    /// \brief lower envelope of the parabolas rooted at _vdtinput, writes _vdtoutput
+    void _DistanceTransform1D(int n)
+    {
+        const double finf = 1e20;
+        int k = 0;
+        _vdtparabolas[0] = 0;
+        _vdtenvelope[0] = -finf;
+        _vdtenvelope[1] = finf;
+        for(int q = 1; q < n; ++q) {
+            double s = ((_vdtinput[q] + double(q)*q) - (_vdtinput[_vdtparabolas[k]] + double(_vdtparabolas[k])*_vdtparabolas[k]))/(2.0*q - 2.0*_vdtparabolas[k]);
+            while( s <= _vdtenvelope[k] ) {
+                --k;
+                s = ((_vdtinput[q] + double(q)*q) - (_vdtinput[_vdtparabolas[k]] + double(_vdtparabolas[k])*_vdtparabolas[k]))/(2.0*q - 2.0*_vdtparabolas[k]);
+            }
+            ++k;
+            _vdtparabolas[k] = q;
+            _vdtenvelope[k] = s;
+            _vdtenvelope[k+1] = finf;
+        }
+        k = 0;
+        for(int q = 0; q < n; ++q) {
+            while( _vdtenvelope[k+1] < q ) {
+                ++k;
+            }
+            const double d = q - _vdtparabolas[k];
+            _vdtoutput[q] = d*d + _vdtinput[_vdtparabolas[k]];
+        }
+    }
+
+    /// \brief 2D Dijkstra from the goal cells over the cells that are not certainly in collision, recomputed only when the goal cells or the grid change
+    void _UpdateHeuristic()
+    {
+        const int numheadings = _parameters->nNumHeadings;
+        std::vector<int> vgoalcells;
+        FOREACHC(itstate, _vgoalstates) {
+            vgoalcells.push_back(*itstate/numheadings);
+        }
+        std::sort(vgoalcells.begin(), vgoalcells.end());
+        vgoalcells.erase(std::unique(vgoalcells.begin(), vgoalcells.end()), vgoalcells.end());
+        if( _bHeuristicValid && vgoalcells == _vheuristicgoalcells && _fHeuristicInscribedRadius == _parameters->fInscribedRadius ) {
+            return;
+        }
+
+        const dReal fCellDiagonal = _fGridCellSize*RaveSqrt(dReal(2));
+        _vheuristic.resize(0);
+        _vheuristic.resize(_nGridX*_nGridY, s_fInfinity);
+        typedef std::pair<dReal, int> CostCell;
+        std::priority_queue<CostCell, std::vector<CostCell>, std::greater<CostCell> > openlist;
+        FOREACHC(itcell, vgoalcells) {
+            _vheuristic[*itcell] = 0;
+            openlist.push(CostCell(0, *itcell));
+        }
+        static const int s_neighbors[8][2] = { {1,0}, {-1,0}, {0,1}, {0,-1}, {1,1}, {1,-1}, {-1,1}, {-1,-1} };
+        while( !openlist.empty() ) {
+            const CostCell top = openlist.top();
+            openlist.pop();
+            if( top.first > _vheuristic[top.second] ) {
+                continue;
+            }
+            const int cx = top.second % _nGridX, cy = top.second / _nGridX;
+            for(int ineighbor = 0; ineighbor < 8; ++ineighbor) {
+                const int nx = cx + s_neighbors[ineighbor][0], ny = cy + s_neighbors[ineighbor][1];
+                if( nx < 0 || nx >= _nGridX || ny < 0 || ny >= _nGridY ) {
+                    continue;
+                }
+                const int ncell = ny*_nGridX + nx;
+                if( _vgriddist[ncell] + fCellDiagonal < _parameters->fInscribedRadius ) {
+                    continue;
+                }
+                const dReal fcost = top.first + (ineighbor < 4 ? _fGridCellSize : fCellDiagonal);
+                if( fcost < _vheuristic[ncell] ) {
+                    _vheuristic[ncell] = fcost;
+                    openlist.push(CostCell(fcost, ncell));
+                }
+            }
+        }
+        _vheuristicgoalcells.swap(vgoalcells);
+        _fHeuristicInscribedRadius = _parameters->fInscribedRadius;
+        _bHeuristicValid = true;
+    }
+
+    /// \brief admissible estimate of the cost to the closest goal
+    dReal _ComputeHeuristic(int state) const
+    {
+        const int numheadings = _parameters->nNumHeadings;
+        const int cell = state/numheadings;
+        const dReal fgriddist = _vheuristic[cell];
+        if( fgriddist >= s_fInfinity ) {
+            return s_fInfinity;
+        }
+        const int cx = cell % _nGridX, cy = cell / _nGridX;
+        dReal feuclid = s_fInfinity;
+        FOREACHC(itstate, _vgoalstates) {
+            const int goalcell = *itstate/numheadings;
+            const dReal dx = goalcell % _nGridX - cx, dy = goalcell / _nGridX - cy;
+            feuclid = min(feuclid, _fGridCellSize*RaveSqrt(dx*dx + dy*dy));
+        }
+        // 8-connected paths are at most 1/cos(pi/8) longer than the straight primitives
+        return _parameters->fHeuristicWeight*max(fgriddist*RaveCos(dReal(PI/8)), feuclid);
+    }
+
+    bool _SnapConfig(const std::vector<dReal>& vconfig, int& state) const
+    {
+        const int cx = (int)std::floor((vconfig.at(0) - _vGridOrigin.x)/_fGridCellSize);
+        const int cy = (int)std::floor((vconfig.at(1) - _vGridOrigin.y)/_fGridCellSize);
+        if( cx < 0 || cx >= _nGridX || cy < 0 || cy >= _nGridY ) {
+            return false;
+        }
+        const int numheadings = _parameters->nNumHeadings;
+        const dReal fheading = utils::NormalizeCircularAngle(vconfig.at(2), dReal(0), dReal(2*PI))*numheadings/(2*PI);
+        const int heading = ((int)std::floor(fheading + 0.5)) % numheadings;
+        state = (cy*_nGridX + cx)*numheadings + heading;
+        return true;
+    }
+
+    void _GetStateConfig(int state, std::vector<dReal>& vconfig) const
+    {
+        const int numheadings = _parameters->nNumHeadings;
+        const int cell = state/numheadings;
+        vconfig.resize(3);
+        vconfig[0] = _vGridOrigin.x + (cell % _nGridX + 0.5)*_fGridCellSize;
+        vconfig[1] = _vGridOrigin.y + (cell / _nGridX + 0.5)*_fGridCellSize;
+        vconfig[2] = utils::NormalizeCircularAngle(dReal(state % numheadings)*2*PI/numheadings, dReal(-PI), dReal(PI));
+    }
+
+    static void _AppendUnwrapped(std::vector<dReal>& vwaypoints, const std::vector<dReal>& vconfig)
+    {
+        const dReal fprevangle = vwaypoints.at(vwaypoints.size()-1);
+        vwaypoints.push_back(vconfig[0]);
+        vwaypoints.push_back(vconfig[1]);
+        vwaypoints.push_back(fprevangle + utils::SubtractCircularAngle(vconfig[2], fprevangle));
+    }
+
+    void _HeapPush(int inode)
+    {
+        _vnodes[inode].heapindex = (int)_vheap.size();
+        _vheap.push_back(inode);
+        _HeapDecrease(inode);
+    }
+
+    /// \brief moves a node up after its f decreased
+    void _HeapDecrease(int inode)
+    {
+        int index = _vnodes[inode].heapindex;
+        const dReal f = _vnodes[inode].f;
+        while( index > 0 ) {
+            const int parentindex = (index-1)/2;
+            const int iparentnode = _vheap[parentindex];
+            if( _vnodes[iparentnode].f <= f ) {
+                break;
+            }
+            _vheap[index] = iparentnode;
+            _vnodes[iparentnode].heapindex = index;
+            index = parentindex;
+        }
+        _vheap[index] = inode;
+        _vnodes[inode].heapindex = index;
+    }
+
+    int _HeapPop()
+    {
+        const int itopnode = _vheap.front();
+        _vnodes[itopnode].heapindex = -1;
+        const int ilastnode = _vheap.back();
+        _vheap.pop_back();
+        if( _vheap.size() > 0 ) {
+            const dReal f = _vnodes[ilastnode].f;
+            const int size = (int)_vheap.size();
+            int index = 0;
+            while( true ) {
+                int childindex = 2*index+1;
+                if( childindex >= size ) {
+                    break;
+                }
+                if( childindex+1 < size && _vnodes[_vheap[childindex+1]].f < _vnodes[_vheap[childindex]].f ) {
+                    ++childindex;
+                }
+                if( f <= _vnodes[_vheap[childindex]].f ) {
+                    break;
+                }
+                _vheap[index] = _vheap[childindex];
+                _vnodes[_vheap[index]].heapindex = index;
+                index = childindex;
+            }
+            _vheap[index] = ilastnode;
+            _vnodes[ilastnode].heapindex = index;
+        }
+        return itopnode;
+    }
+
+    static const dReal s_fInfinity;
+    static const uint64_t s_nMaxLatticeStates = 1<<26;
+
+    LatticeParametersPtr _parameters;
+    RobotBasePtr _robot;
+
+    // motion primitives for every heading, depend only on the lattice parameters
+    std::vector< std::vector<MotionPrimitive> > _vprimitives;
+    dReal _fPrimitivesCellSize = 0, _fPrimitivesReverseCostMultiplier = 0, _fPrimitivesRotationWeight = 0;
+    int _nPrimitivesLength = 0;
+
+    dReal _fRobotRadius; ///< circumscribed radius of the robot and its grabbed bodies around the base origin
+    dReal _fRobotZMin, _fRobotZMax; ///< height band in which geometry is an obstacle
+
+    // occupancy grid, valid while _vgridbodystamps matches the environment
+    bool _bGridValid;
+    std::vector< std::pair<int,int> > _vgridbodystamps; ///< sorted (environment body index, update stamp) of the obstacles when the grid was built
+    Vector _vGridOrigin;
+    int _nGridX, _nGridY;
+    dReal _fGridCellSize = 0, _fGridSlack = 0;
+    std::vector<dReal> _vgriddist; ///< distance from the center of every cell to the closest occupied cell
+
+    // heuristic, valid while the grid and the goal cells do not change
+    bool _bHeuristicValid;
+    std::vector<int> _vheuristicgoalcells;
+    dReal _fHeuristicInscribedRadius = 0;
+    std::vector<dReal> _vheuristic;
+
+    // search state, the arrays keep their capacity across queries
+    std::vector<LatticeNode> _vnodes; ///< node pool
+    std::vector<int> _vheap; ///< binary heap of node indices ordered by f
+    std::vector<int> _vstatenodes; ///< node index of every lattice state, -1 if not reached
+    std::vector<int> _vgoalstates;
+    std::vector<size_t> _vgoalindices; ///< index in vgoalconfig of every entry of _vgoalstates
+
+    // cache
+    std::vector<KinBodyPtr> _vbodies;
+    std::vector< std::pair<int,int> > _vbodystamps;
+    std::vector<Vector> _vcliptriangles;
+    std::vector<double> _vdtinput, _vdtoutput, _vdtenvelope;
+    std::vector<int> _vdtparabolas;
+    std::vector<dReal> _vtempconfig0, _vtempconfig1;
+};
+
+const dReal LatticePlanner::s_fInfinity = 1e30;
+
+PlannerBasePtr CreateLatticePlanner(EnvironmentBasePtr penv, std::istream& sinput) {
+    return PlannerBasePtr(new LatticePlanner(penv, sinput));
+}
@@ -0,0 +1,944 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2014 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "openraveplugindefs.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <queue>
+
+#define _(msgid) OpenRAVE::RaveGetLocalizedTextForDomain("openrave_plugins_rplanners", msgid)
+
+namespace {
+
+static const char s_roadmapMagic[8] = {'o','r','l','a','z','y','p','m'};
+static const uint32_t s_roadmapVersion = 1;
+
+/// \brief validity of a node or an edge of the roadmap
+enum RoadmapStatus
+{
+    RS_Unknown = 0, ///< not checked yet, or invalidated since
+    RS_Free = 1,
+    RS_Colliding = 2,
+};
+
+/// \brief the state of a body of the environment the roadmap was validated against
+struct RoadmapBodyState
+{
+    std::string name;
+    std::string state; ///< geometry hash, transform and dof values
+    dReal aabb[6]; ///< position and extents of the body
+};
+
+/// \brief multi-query roadmap of one robot geometry, configuration specification and robot placement
+///
+/// The nodes are stored in flat arrays and the undirected edges in compressed sparse row form, with every edge stored in both directions. Nodes and edges start unknown and are only validated when they are on a path found by the search. The roadmaps are shared by all the planners of the process and saved to a binary file after every query that changed them.
+class Roadmap
+{
+public:
+    Roadmap(const std::string& filename, int dof) : _filename(filename), _dof(dof), _fMaxDiameter(0) {
+        _vedgeoffsets.push_back(0);
+        _Load();
+    }
+
+    inline size_t GetNumNodes() const {
+        return _vnodestatus.size();
+    }
+    inline const dReal* GetNodeConfig(uint32_t inode) const {
+        return &_vnodeconfigs[inode*_dof];
+    }
+
+    /// \brief adds the nodes and connects every new node to its numneighbors nearest nodes
+    void AddNodes(const std::vector<dReal>& vnewconfigs, int numneighbors, const PlannerBase::PlannerParameters::DistMetricFn& distfn)
+    {
+        const uint32_t numoldnodes = GetNumNodes();
+        const uint32_t numnewnodes = vnewconfigs.size()/_dof;
+        if( numnewnodes == 0 ) {
+            return;
+        }
+        // gather the edges a < b of the current graph
+        std::vector< std::pair<uint64_t, uint8_t> > vedges;
+        vedges.reserve(_vedgetargets.size()/2 + numnewnodes*numneighbors);
+        for(uint32_t inode = 0; inode < numoldnodes; ++inode) {
+            for(uint32_t iedge = _vedgeoffsets[inode]; iedge < _vedgeoffsets[inode+1]; ++iedge) {
+                if( inode < _vedgetargets[iedge] ) {
+                    vedges.emplace_back(((uint64_t)inode<<32)|_vedgetargets[iedge], _vedgestatus[iedge]);
+                }
+            }
+        }
+
+        _vnodeconfigs.insert(_vnodeconfigs.end(), vnewconfigs.begin(), vnewconfigs.end());
+        _vnodestatus.resize(numoldnodes+numnewnodes, RS_Unknown);
+        _vnodeaabbs.resize(6*(numoldnodes+numnewnodes), -1);
+        std::vector<dReal> q0(_dof), q1(_dof);
+        std::vector< std::pair<dReal, uint32_t> > vneighbors;
+        for(uint32_t inode = numoldnodes; inode < numoldnodes+numnewnodes; ++inode) {
+            q0.assign(GetNodeConfig(inode), GetNodeConfig(inode)+_dof);
+            vneighbors.resize(0);
+            for(uint32_t iother = 0; iother < numoldnodes+numnewnodes; ++iother) {
+                if( iother != inode ) {
+                    q1.assign(GetNodeConfig(iother), GetNodeConfig(iother)+_dof);
+                    vneighbors.emplace_back(distfn(q0, q1), iother);
+                }
+            }
+            const size_t numconnect = std::min(vneighbors.size(), (size_t)numneighbors);
+            std::partial_sort(vneighbors.begin(), vneighbors.begin()+numconnect, vneighbors.end());
+            for(size_t ineighbor = 0; ineighbor < numconnect; ++ineighbor) {
+                const uint32_t a = std::min(inode, vneighbors[ineighbor].second), b = std::max(inode, vneighbors[ineighbor].second);
+                vedges.emplace_back(((uint64_t)a<<32)|b, RS_Unknown);
+            }
+        }
+
+        // keep the known status of duplicate edges
+        std::stable_sort(vedges.begin(), vedges.end(), [](const std::pair<uint64_t, uint8_t>& e0, const std::pair<uint64_t, uint8_t>& e1) {
+            return e0.first < e1.first;
+        });
+        vedges.erase(std::unique(vedges.begin(), vedges.end(), [](const std::pair<uint64_t, uint8_t>& e0, const std::pair<uint64_t, uint8_t>& e1) {
+            return e0.first == e1.first;
+        }), vedges.end());
+        _BuildEdges(vedges);
+        _bChanged = true;
+    }
+
+    inline uint32_t GetEdgeBegin(uint32_t inode) const {
+        return _vedgeoffsets[inode];
+    }
+    inline uint32_t GetEdgeEnd(uint32_t inode) const {
+        return _vedgeoffsets[inode+1];
+    }
+    inline uint32_t GetEdgeTarget(uint32_t iedge) const {
+        return _vedgetargets[iedge];
+    }
+    inline uint8_t GetEdgeStatus(uint32_t iedge) const {
+        return _vedgestatus[iedge];
+    }
+    inline uint8_t GetNodeStatus(uint32_t inode) const {
+        return _vnodestatus[inode];
+    }
+
+    /// \brief sets the status of the edge and of its reverse
+    void SetEdgeStatus(uint32_t inode, uint32_t iedge, uint8_t status)
+    {
+        _vedgestatus[iedge] = status;
+        const uint32_t itarget = _vedgetargets[iedge];
+        for(uint32_t ireverse = _vedgeoffsets[itarget]; ireverse < _vedgeoffsets[itarget+1]; ++ireverse) {
+            if( _vedgetargets[ireverse] == inode ) {
+                _vedgestatus[ireverse] = status;
+                break;
+            }
+        }
+        _bChanged = true;
+    }
+
+    /// \param aabb the workspace box of the robot at the node
+    void SetNodeStatus(uint32_t inode, uint8_t status, const AABB& aabb)
+    {
+        _vnodestatus[inode] = status;
+        dReal* paabb = &_vnodeaabbs[6*inode];
+        for(int i = 0; i < 3; ++i) {
+            paabb[i] = aabb.pos[i];
+            paabb[3+i] = aabb.extents[i];
+        }
+        _fMaxDiameter = std::max(_fMaxDiameter, 2*RaveSqrt(aabb.extents.lengthsqr3()));
+        _bChanged = true;
+    }
+
+    /// \brief compares the bodies with the ones the roadmap was validated against, and resets the nodes and edges whose workspace boxes intersect the old or new box of a body that changed
+    ///
+    /// The box of an edge is the union of the boxes of its nodes grown by how far any point of the robot can move along the edge. Every dof moves a point of the robot at most by the diameter of the robot times its change for revolute joints and by its change for prismatic joints.
+    void Synchronize(const std::vector<RoadmapBodyState>& vbodies)
+    {
+        std::vector<AABB> vregions;
+        std::map<std::string, const RoadmapBodyState*> mapold, mapnew;
+        FOREACHC(itbody, _vbodies) {
+            mapold[itbody->name] = &*itbody;
+        }
+        FOREACHC(itbody, vbodies) {
+            mapnew[itbody->name] = &*itbody;
+            std::map<std::string, const RoadmapBodyState*>::const_iterator itold = mapold.find(itbody->name);
+            if( itold == mapold.end() || itold->second->state != itbody->state ) {
+                vregions.push_back(_GetBodyAABB(*itbody));
+                if( itold != mapold.end() ) {
+                    vregions.push_back(_GetBodyAABB(*itold->second));
+                }
+            }
+        }
+        FOREACHC(itbody, _vbodies) {
+            if( mapnew.find(itbody->name) == mapnew.end() ) {
+                vregions.push_back(_GetBodyAABB(*itbody));
+            }
+        }
+        if( _vbodies.size() == 0 && GetNumNodes() > 0 ) {
+            // do not know what the roadmap was validated against
+            std::fill(_vnodestatus.begin(), _vnodestatus.end(), RS_Unknown);
+            std::fill(_vedgestatus.begin(), _vedgestatus.end(), RS_Unknown);
+            vregions.clear();
+        }
+        _vbodies = vbodies;
+        _bChanged = true;
+        if( vregions.size() == 0 ) {
+            return;
+        }
+
+        size_t numresetnodes = 0, numresetedges = 0;
+        for(uint32_t inode = 0; inode < GetNumNodes(); ++inode) {
+            if( _vnodestatus[inode] != RS_Unknown && _IntersectsAny(_GetNodeAABB(inode), vregions) ) {
+                _vnodestatus[inode] = RS_Unknown;
+                ++numresetnodes;
+            }
+        }
+        const dReal fReach = std::max(_fMaxDiameter, dReal(1));
+        for(uint32_t inode = 0; inode < GetNumNodes(); ++inode) {
+            for(uint32_t iedge = _vedgeoffsets[inode]; iedge < _vedgeoffsets[inode+1]; ++iedge) {
+                const uint32_t itarget = _vedgetargets[iedge];
+                if( itarget < inode || _vedgestatus[iedge] == RS_Unknown ) {
+                    continue;
+                }
+                const dReal* paabb0 = &_vnodeaabbs[6*inode];
+                const dReal* paabb1 = &_vnodeaabbs[6*itarget];
+                bool bReset = paabb0[3] < 0 || paabb1[3] < 0;
+                if( !bReset ) {
+                    dReal fConfigDistance = 0;
+                    for(int idof = 0; idof < _dof; ++idof) {
+                        fConfigDistance += RaveFabs(GetNodeConfig(inode)[idof] - GetNodeConfig(itarget)[idof]);
+                    }
+                    AABB ab;
+                    for(int i = 0; i < 3; ++i) {
+                        const dReal fmin = std::min(paabb0[i]-paabb0[3+i], paabb1[i]-paabb1[3+i]);
+                        const dReal fmax = std::max(paabb0[i]+paabb0[3+i], paabb1[i]+paabb1[3+i]);
+                        ab.pos[i] = 0.5*(fmin+fmax);
+                        ab.extents[i] = 0.5*(fmax-fmin) + 0.5*fReach*fConfigDistance;
+                    }
+                    bReset = _IntersectsAny(ab, vregions);
+                }
+                if( bReset ) {
+                    SetEdgeStatus(inode, iedge, RS_Unknown);
+                    ++numresetedges;
+                }
+            }
+        }
+        RAVELOG_DEBUG_FORMAT("%d bodies changed, reset %d/%d nodes and %d/%d edges of roadmap %s", (vregions.size()/2)%numresetnodes%GetNumNodes()%numresetedges%(_vedgetargets.size()/2)%_filename);
+    }
+
+    /// \brief saves the roadmap if it changed since the last save. Writes to a temporary file first so that other processes never read a partial roadmap
+    void Save()
+    {
+        if( !_bChanged ) {
+            return;
+        }
+        const std::string tempfilename = _filename + ".tmp";
+        {
+            std::ofstream f(tempfilename.c_str(), std::ios::binary);
+            if( !f ) {
+                RAVELOG_WARN_FORMAT("failed to save the roadmap to %s", tempfilename);
+                return;
+            }
+            f.write(s_roadmapMagic, sizeof(s_roadmapMagic));
+            _WriteValue(f, s_roadmapVersion);
+            _WriteValue(f, (uint32_t)sizeof(dReal));
+            _WriteValue(f, (uint32_t)_dof);
+            _WriteValue(f, _fMaxDiameter);
+            _WriteVector(f, _vnodeconfigs);
+            _WriteVector(f, _vnodestatus);
+            _WriteVector(f, _vnodeaabbs);
+            _WriteVector(f, _vedgeoffsets);
+            _WriteVector(f, _vedgetargets);
+            _WriteVector(f, _vedgestatus);
+            _WriteValue(f, (uint32_t)_vbodies.size());
+            FOREACHC(itbody, _vbodies) {
+                _WriteString(f, itbody->name);
+                _WriteString(f, itbody->state);
+                f.write((const char*)itbody->aabb, sizeof(itbody->aabb));
+            }
+        }
+        if( std::rename(tempfilename.c_str(), _filename.c_str()) != 0 ) {
+            RAVELOG_WARN_FORMAT("failed to save the roadmap to %s", _filename);
+            return;
+        }
+        _bChanged = false;
+    }
+
+    std::mutex _mutex; ///< held by the planner using the roadmap
+
+private:
+    void _BuildEdges(const std::vector< std::pair<uint64_t, uint8_t> >& vedges)
+    {
+        const uint32_t numnodes = GetNumNodes();
+        _vedgeoffsets.assign(numnodes+1, 0);
+        FOREACHC(itedge, vedges) {
+            ++_vedgeoffsets[(itedge->first>>32)+1];
+            ++_vedgeoffsets[(itedge->first&0xffffffff)+1];
+        }
+        for(uint32_t inode = 0; inode < numnodes; ++inode) {
+            _vedgeoffsets[inode+1] += _vedgeoffsets[inode];
+        }
+        _vedgetargets.resize(_vedgeoffsets.back());
+        _vedgestatus.resize(_vedgeoffsets.back());
+        std::vector<uint32_t> vnext(_vedgeoffsets.begin(), _vedgeoffsets.end()-1);
+        FOREACHC(itedge, vedges) {
+            const uint32_t a = itedge->first>>32, b = itedge->first&0xffffffff;
+            _vedgetargets[vnext[a]] = b;
+            _vedgestatus[vnext[a]++] = itedge->second;
+            _vedgetargets[vnext[b]] = a;
+            _vedgestatus[vnext[b]++] = itedge->second;
+        }
+    }
+
+    inline AABB _GetNodeAABB(uint32_t inode) const
+    {
+        AABB ab;
+        const dReal* paabb = &_vnodeaabbs[6*inode];
+        ab.pos = Vector(paabb[0], paabb[1], paabb[2]);
+        ab.extents = Vector(paabb[3], paabb[4], paabb[5]);
+        return ab;
+    }
+
+    static inline AABB _GetBodyAABB(const RoadmapBodyState& body)
+    {
+        AABB ab;
+        ab.pos = Vector(body.aabb[0], body.aabb[1], body.aabb[2]);
+        ab.extents = Vector(body.aabb[3], body.aabb[4], body.aabb[5]);
+        return ab;
+    }
+
+    /// \return true if ab intersects one of the regions, or if ab is not known
+    static bool _IntersectsAny(const AABB& ab, const std::vector<AABB>& vregions)
+    {
+        if( ab.extents.x < 0 ) {
+            return true;
+        }
+        FOREACHC(itregion, vregions) {
+            if( RaveFabs(ab.pos.x-itregion->pos.x) <= ab.extents.x+itregion->extents.x && RaveFabs(ab.pos.y-itregion->pos.y) <= ab.extents.y+itregion->extents.y && RaveFabs(ab.pos.z-itregion->pos.z) <= ab.extents.z+itregion->extents.z ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <typename T>
+    static void _WriteValue(std::ostream& f, const T& value) {
+        f.write((const char*)&value, sizeof(T));
+    }
+    template <typename T>
+    static bool _ReadValue(std::istream& f, T& value) {
+        f.read((char*)&value, sizeof(T));
+        return !!f;
+    }
+    template <typename T>
+    static void _WriteVector(std::ostream& f, const std::vector<T>& v) {
+        _WriteValue(f, (uint64_t)v.size());
+        f.write((const char*)v.data(), v.size()*sizeof(T));
+    }
+    template <typename T>
+    static bool _ReadVector(std::istream& f, std::vector<T>& v) {
+        uint64_t size = 0;
+        if( !_ReadValue(f, size) ) {
+            return false;
+        }
+        v.resize(size);
+        f.read((char*)v.data(), size*sizeof(T));
+        return !!f;
+    }
+    static void _WriteString(std::ostream& f, const std::string& s) {
+        _WriteValue(f, (uint32_t)s.size());
+        f.write(s.data(), s.size());
+    }
+    static bool _ReadString(std::istream& f, std::string& s) {
+        uint32_t size = 0;
+        if( !_ReadValue(f, size) ) {
+            return false;
+        }
+        s.resize(size);
+        f.read(&s[0], size);
+        return !!f;
+    }
+
+    void _Load()
+    {
+        std::ifstream f(_filename.c_str(), std::ios::binary);
+        if( !f ) {
+            _bChanged = true;
+            return;
+        }
+        char magic[sizeof(s_roadmapMagic)];
+        uint32_t version = 0, realsize = 0, dof = 0, numbodies = 0;
+        f.read(magic, sizeof(magic));
+        if( !f || std::memcmp(magic, s_roadmapMagic, sizeof(magic)) != 0 || !_ReadValue(f, version) || version != s_roadmapVersion || !_ReadValue(f, realsize) || realsize != sizeof(dReal) || !_ReadValue(f, dof) || (int)dof != _dof ) {
+            RAVELOG_WARN_FORMAT("roadmap %s has a different format, ignoring it", _filename);
+            _bChanged = true;
+            return;
+        }
+        bool bSuccess = _ReadValue(f, _fMaxDiameter) && _ReadVector(f, _vnodeconfigs) && _ReadVector(f, _vnodestatus) && _ReadVector(f, _vnodeaabbs) && _ReadVector(f, _vedgeoffsets) && _ReadVector(f, _vedgetargets) && _ReadVector(f, _vedgestatus) && _ReadValue(f, numbodies);
+        if( bSuccess ) {
+            _vbodies.resize(numbodies);
+            FOREACH(itbody, _vbodies) {
+                if( !_ReadString(f, itbody->name) || !_ReadString(f, itbody->state) || !_ReadValue(f, itbody->aabb) ) {
+                    bSuccess = false;
+                    break;
+                }
+            }
+        }
+        const size_t numnodes = _vnodestatus.size();
+        if( !bSuccess || _vnodeconfigs.size() != numnodes*_dof || _vnodeaabbs.size() != numnodes*6 || _vedgeoffsets.size() != numnodes+1 || _vedgeoffsets.back() != _vedgetargets.size() || _vedgestatus.size() != _vedgetargets.size() ) {
+            RAVELOG_WARN_FORMAT("roadmap %s is corrupted, ignoring it", _filename);
+            _vnodeconfigs.clear();
+            _vnodestatus.clear();
+            _vnodeaabbs.clear();
+            _vedgeoffsets.assign(1, 0);
+            _vedgetargets.clear();
+            _vedgestatus.clear();
+            _vbodies.clear();
+            _fMaxDiameter = 0;
+            _bChanged = true;
+            return;
+        }
+        _bChanged = false;
+        RAVELOG_DEBUG_FORMAT("loaded roadmap %s with %d nodes and %d edges", _filename%numnodes%(_vedgetargets.size()/2));
+    }
+
+    const std::string _filename;
+    const int _dof;
+    std::vector<dReal> _vnodeconfigs; ///< dof values of every node
+    std::vector<uint8_t> _vnodestatus; ///< RoadmapStatus of every node
+    std::vector<dReal> _vnodeaabbs; ///< position and extents of the workspace box of the robot at every node, negative extents if not computed yet
+    std::vector<uint32_t> _vedgeoffsets; ///< the edges of node i are [_vedgeoffsets[i], _vedgeoffsets[i+1])
+    std::vector<uint32_t> _vedgetargets; ///< the node every edge goes to
+    std::vector<uint8_t> _vedgestatus; ///< RoadmapStatus of every edge
+    std::vector<RoadmapBodyState> _vbodies; ///< the bodies the statuses were validated against
+    dReal _fMaxDiameter; ///< largest diameter of the workspace boxes of the nodes
+    bool _bChanged; ///< true if the roadmap changed since it was loaded or saved
+};
+
+typedef boost::shared_ptr<Roadmap> RoadmapPtr;
+
+/// \brief returns the roadmap stored in filename, loading it the first time
+RoadmapPtr GetRoadmap(const std::string& filename, int dof)
+{
+    static std::mutex s_mutex;
+    static std::map<std::string, RoadmapPtr> s_mapRoadmaps;
+    std::lock_guard<std::mutex> lock(s_mutex);
+    RoadmapPtr& proadmap = s_mapRoadmaps[filename];
+    if( !proadmap ) {
+        proadmap.reset(new Roadmap(filename, dof));
+    }
+    return proadmap;
+}
+
+} // end namespace
+
+/// \brief multi-query planner that keeps a lazily validated roadmap for every robot placement
+class LazyPRMPlanner : public PlannerBase
+{
+public:
+    LazyPRMPlanner(EnvironmentBasePtr penv, std::istream& sinput) : PlannerBase(penv), _sRoadmapDirectory(RaveGetHomeDirectory()), _nNumSamples(1000), _nNumNeighbors(10), _nMaxExpansions(10)
+    {
+        __description = "\
+Multi-query lazy probabilistic roadmap planner for static cells. The roadmap is sampled without checking collisions. Every query searches the roadmap with A*, checks the nodes and edges of the path it found, and searches again without the invalid ones until a valid path is found. The results of the checks are kept in the roadmap, so repeated queries in the same cell mostly only search the graph. When no path is found, more nodes are sampled.\n\n\
+There is one roadmap for every robot geometry, grabbed bodies, configuration specification and robot placement, saved to a file in the roadmap directory so that it survives the process. When other bodies move, only the nodes and edges whose workspace boxes intersect the old or new boxes of the bodies are checked again.\n\n\
+The post-processing planner is run on the resulting path.";
+        RegisterCommand("SetRoadmapDirectory",boost::bind(&LazyPRMPlanner::_SetRoadmapDirectoryCommand,this,_1,_2),
+                        "sets the directory the roadmaps are saved in, by default the openrave home directory");
+        RegisterCommand("SetNumSamples",boost::bind(&LazyPRMPlanner::_SetNumSamplesCommand,this,_1,_2),
+                        "sets the number of nodes sampled for a new roadmap and every time no path is found, 1000 by default");
+        RegisterCommand("SetNumNeighbors",boost::bind(&LazyPRMPlanner::_SetNumNeighborsCommand,this,_1,_2),
+                        "sets the number of nearest nodes every new node is connected to, 10 by default");
+        RegisterCommand("GetNumNodes",boost::bind(&LazyPRMPlanner::_GetNumNodesCommand,this,_1,_2),
+                        "returns the number of nodes of the roadmap of the last InitPlan");
+    }
+    virtual ~LazyPRMPlanner() {
+    }
+
+    virtual PlannerStatus InitPlan(RobotBasePtr pbase, PlannerParametersConstPtr pparams) override
+    {
+        EnvironmentLock lock(GetEnv()->GetMutex());
+        _parameters.reset(new PlannerParameters());
+        _parameters->copy(pparams);
+        _parameters->Validate();
+        _robot = pbase;
+        if( _parameters->GetDOF() <= 0 ) {
+            _parameters.reset();
+            return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, LazyPRM needs a configuration specification")%GetEnv()->GetNameId()), PS_Failed);
+        }
+        _proadmap = GetRoadmap(str(boost::format("%s/lazyprm_%s.bin")%_sRoadmapDirectory%_ComputeRoadmapHash()), _parameters->GetDOF());
+        return PlannerStatus(PS_HasSolution);
+    }
+
+    virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
+    {
+        OPENRAVE_TRACE_SCOPE("LazyPRMPlanner::PlanPath");
+        if(!_parameters) {
+            return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, LazyPRMPlanner::PlanPath - Error, planner not initialized")%GetEnv()->GetNameId()), PS_Failed);
+        }
+        const int dof = _parameters->GetDOF();
+        if( _parameters->vinitialconfig.size() < (size_t)dof || _parameters->vgoalconfig.size() < (size_t)dof ) {
+            return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, LazyPRM needs initial and goal configurations")%GetEnv()->GetNameId()), PS_Failed);
+        }
+
+        EnvironmentLock lock(GetEnv()->GetMutex());
+        std::lock_guard<std::mutex> roadmaplock(_proadmap->_mutex);
+        uint64_t basetimeus = utils::GetMonotonicTime();
+        PlannerParameters::StateSaver savestate(_parameters);
+        Roadmap& roadmap = *_proadmap;
+
+        std::vector<RoadmapBodyState> vbodies;
+        _GetBodyStates(vbodies);
+        roadmap.Synchronize(vbodies);
+        if( roadmap.GetNumNodes() == 0 ) {
+            _SampleNodes(_nNumSamples);
+        }
+
+        // the starts and goals are temporary nodes after the roadmap nodes
+        _vquerynodes.resize(0);
+        for(size_t i = 0; i+dof <= _parameters->vinitialconfig.size(); i += dof) {
+            _vquerynodes.push_back(QueryNode(_parameters->vinitialconfig.begin()+i, _parameters->vinitialconfig.begin()+i+dof, false));
+        }
+        for(size_t i = 0; i+dof <= _parameters->vgoalconfig.size(); i += dof) {
+            _vquerynodes.push_back(QueryNode(_parameters->vgoalconfig.begin()+i, _parameters->vgoalconfig.begin()+i+dof, true));
+        }
+
+        std::vector<uint32_t> vnodepath;
+        PlannerProgress progress;
+        int numsearches = 0;
+        for(int iexpansion = 0; iexpansion <= _nMaxExpansions; ++iexpansion) {
+            if( iexpansion > 0 ) {
+                _SampleNodes(_nNumSamples/2);
+            }
+            _ConnectQueryNodes();
+            while( _Search(vnodepath) ) {
+                ++numsearches;
+                if( _ValidatePath(vnodepath) ) {
+                    std::vector<dReal> vpath;
+                    vpath.reserve(vnodepath.size()*dof);
+                    FOREACHC(itnode, vnodepath) {
+                        const dReal* pconfig = _GetConfig(*itnode);
+                        vpath.insert(vpath.end(), pconfig, pconfig+dof);
+                    }
+                    roadmap.Save();
+                    if( ptraj->GetConfigurationSpecification().GetDOF() == 0 ) {
+                        ptraj->Init(_parameters->_configurationspecification);
+                    }
+                    ptraj->Insert(ptraj->GetNumWaypoints(), vpath, _parameters->_configurationspecification);
+                    RAVELOG_DEBUG_FORMAT("env=%s, plan success, path=%d points, searches=%d, roadmap nodes=%d, computation time=%u[us]", GetEnv()->GetNameId()%ptraj->GetNumWaypoints()%numsearches%roadmap.GetNumNodes()%(utils::GetMonotonicTime()-basetimeus));
+                    return _ProcessPostPlanners(_robot,ptraj);
+                }
+                if( _CallCallbacks(progress) == PA_Interrupt ) {
+                    roadmap.Save();
+                    return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, Planning was interrupted")%GetEnv()->GetNameId()), PS_Interrupted);
+                }
+                ++progress._iteration;
+            }
+            if( _parameters->_nMaxPlanningTime > 0 && utils::GetMonotonicTime()-basetimeus > 1000*(uint64_t)_parameters->_nMaxPlanningTime ) {
+                break;
+            }
+        }
+        roadmap.Save();
+        std::string description = str(boost::format(_("env=%s, no path in the roadmap with %d nodes after %d searches in %u[us]"))%GetEnv()->GetNameId()%roadmap.GetNumNodes()%numsearches%(utils::GetMonotonicTime()-basetimeus));
+        RAVELOG_WARN(description);
+        return OPENRAVE_PLANNER_STATUS(description, PS_Failed);
+    }
+
+    virtual PlannerParametersConstPtr GetParameters() const {
+        return _parameters;
+    }
+
+protected:
+    /// \brief a start or goal of the query
+    struct QueryNode
+    {
+        QueryNode(std::vector<dReal>::const_iterator itbegin, std::vector<dReal>::const_iterator itend, bool bGoal) : vconfig(itbegin, itend), status(RS_Unknown), bGoal(bGoal) {
+        }
+        std::vector<dReal> vconfig;
+        std::vector< std::pair<uint32_t, uint8_t> > vedges; ///< nodes it is connected to and the status of the edges
+        uint8_t status;
+        bool bGoal;
+    };
+
+    /// \brief the md5 hash of everything the roadmap depends on except the other bodies of the environment
+    ///
+    /// _GetBodyStates skips the robot, so the values of the robot dofs that are not planned and the enable states of its links are part of the hash.
+    std::string _ComputeRoadmapHash() const
+    {
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(4);
+        ss << _robot->GetKinematicsGeometryHash() << std::endl << _parameters->_configurationspecification << std::endl;
+        const Transform t = _robot->GetTransform();
+        ss << t.trans.x << " " << t.trans.y << " " << t.trans.z << " " << t.rot.x << " " << t.rot.y << " " << t.rot.z << " " << t.rot.w << std::endl;
+        std::vector<int> vuseddofindices, vusedconfigindices;
+        _parameters->_configurationspecification.ExtractUsedIndices(_robot, vuseddofindices, vusedconfigindices);
+        std::vector<dReal> vdofvalues;
+        _robot->GetDOFValues(vdofvalues);
+        for(int idof = 0; idof < (int)vdofvalues.size(); ++idof) {
+            if( std::find(vuseddofindices.begin(), vuseddofindices.end(), idof) == vuseddofindices.end() ) {
+                ss << idof << " " << vdofvalues[idof] << " ";
+            }
+        }
+        ss << std::endl;
+        std::vector<uint8_t> venablestates;
+        _robot->GetLinkEnableStates(venablestates);
+        FOREACHC(itenable, venablestates) {
+            ss << (int)*itenable;
+        }
+        ss << std::endl;
+        std::vector<KinBodyPtr> vgrabbed;
+        _robot->GetGrabbed(vgrabbed);
+        FOREACHC(itgrabbed, vgrabbed) {
+            ss << (*itgrabbed)->GetKinematicsGeometryHash() << std::endl;
+        }
+        return utils::GetMD5HashString(ss.str());
+    }
+
+    void _GetBodyStates(std::vector<RoadmapBodyState>& vbodies) const
+    {
+        std::vector<KinBodyPtr> venvbodies;
+        GetEnv()->GetBodies(venvbodies);
+        std::vector<dReal> vdofvalues;
+        vbodies.resize(0);
+        FOREACHC(itbody, venvbodies) {
+            const KinBody& body = **itbody;
+            if( *itbody == _robot || !!_robot->IsGrabbing(body) ) {
+                continue;
+            }
+            RoadmapBodyState bodystate;
+            bodystate.name = body.GetName();
+            std::stringstream ss;
+            ss << std::fixed << std::setprecision(4);
+            const Transform t = body.GetTransform();
+            ss << body.GetKinematicsGeometryHash() << " " << body.IsEnabled() << " " << t.trans.x << " " << t.trans.y << " " << t.trans.z << " " << t.rot.x << " " << t.rot.y << " " << t.rot.z << " " << t.rot.w;
+            body.GetDOFValues(vdofvalues);
+            FOREACHC(itvalue, vdofvalues) {
+                ss << " " << *itvalue;
+            }
+            bodystate.state = ss.str();
+            const AABB ab = body.ComputeAABB();
+            for(int i = 0; i < 3; ++i) {
+                bodystate.aabb[i] = ab.pos[i];
+                bodystate.aabb[3+i] = ab.extents[i];
+            }
+            vbodies.push_back(bodystate);
+        }
+    }
+
+    void _SampleNodes(int numsamples)
+    {
+        const int dof = _parameters->GetDOF();
+        std::vector<dReal> vsample(dof), vconfigs;
+        vconfigs.reserve(numsamples*dof);
+        for(int isample = 0; isample < numsamples; ++isample) {
+            if( _parameters->_samplefn(vsample) && (int)vsample.size() == dof ) {
+                vconfigs.insert(vconfigs.end(), vsample.begin(), vsample.end());
+            }
+        }
+        _proadmap->AddNodes(vconfigs, _nNumNeighbors, _parameters->_distmetricfn);
+    }
+
+    /// \brief connects every start and goal to its nearest roadmap nodes, and the starts directly to the goals
+    void _ConnectQueryNodes()
+    {
+        const Roadmap& roadmap = *_proadmap;
+        const int dof = _parameters->GetDOF();
+        const uint32_t numnodes = roadmap.GetNumNodes();
+        std::vector<dReal> vconfig(dof);
+        std::vector< std::pair<dReal, uint32_t> > vneighbors;
+        for(size_t iquery = 0; iquery < _vquerynodes.size(); ++iquery) {
+            QueryNode& querynode = _vquerynodes[iquery];
+            querynode.vedges.resize(0);
+            vneighbors.resize(0);
+            for(uint32_t inode = 0; inode < numnodes; ++inode) {
+                if( roadmap.GetNodeStatus(inode) != RS_Colliding ) {
+                    vconfig.assign(roadmap.GetNodeConfig(inode), roadmap.GetNodeConfig(inode)+dof);
+                    vneighbors.emplace_back(_parameters->_distmetricfn(querynode.vconfig, vconfig), inode);
+                }
+            }
+            const size_t numconnect = std::min(vneighbors.size(), (size_t)_nNumNeighbors);
+            std::partial_sort(vneighbors.begin(), vneighbors.begin()+numconnect, vneighbors.end());
+            for(size_t ineighbor = 0; ineighbor < numconnect; ++ineighbor) {
+                querynode.vedges.emplace_back(vneighbors[ineighbor].second, RS_Unknown);
+            }
+            for(size_t iother = 0; iother < _vquerynodes.size(); ++iother) {
+                if( _vquerynodes[iother].bGoal != querynode.bGoal ) {
+                    querynode.vedges.emplace_back(numnodes+iother, RS_Unknown);
+                }
+            }
+        }
+    }
+
+    inline const dReal* _GetConfig(uint32_t inode) const
+    {
+        const uint32_t numnodes = _proadmap->GetNumNodes();
+        return inode < numnodes ? _proadmap->GetNodeConfig(inode) : _vquerynodes[inode-numnodes].vconfig.data();
+    }
+
+    /// \brief A* from the starts to any goal over the nodes and edges that are not colliding
+    ///
+    /// \return true if a path was found
+    bool _Search(std::vector<uint32_t>& vnodepath)
+    {
+        const Roadmap& roadmap = *_proadmap;
+        const int dof = _parameters->GetDOF();
+        const uint32_t numnodes = roadmap.GetNumNodes();
+        const uint32_t numtotal = numnodes + _vquerynodes.size();
+        std::vector<dReal> vcost(numtotal, std::numeric_limits<dReal>::infinity());
+        std::vector<uint32_t> vparent(numtotal, numtotal);
+        std::vector<uint8_t> vclosed(numtotal, 0);
+        std::vector<dReal> q0(dof), q1(dof);
+
+        // edges from roadmap nodes to the query nodes
+        std::multimap<uint32_t, uint32_t> mapreverseedges;
+        for(uint32_t iquery = 0; iquery < _vquerynodes.size(); ++iquery) {
+            FOREACHC(itedge, _vquerynodes[iquery].vedges) {
+                if( itedge->first < numnodes && itedge->second != RS_Colliding ) {
+                    mapreverseedges.insert(std::make_pair(itedge->first, numnodes+iquery));
+                }
+            }
+        }
+
+        // heuristic is the distance to the closest goal
+        std::vector<dReal> vheuristic(numtotal, -1);
+        auto heuristicfn = [&](uint32_t inode) {
+            if( vheuristic[inode] < 0 ) {
+                const dReal* pconfig = _GetConfig(inode);
+                q0.assign(pconfig, pconfig+dof);
+                dReal fmin = std::numeric_limits<dReal>::infinity();
+                FOREACHC(itquery, _vquerynodes) {
+                    if( itquery->bGoal && itquery->status != RS_Colliding ) {
+                        fmin = std::min(fmin, _parameters->_distmetricfn(q0, itquery->vconfig));
+                    }
+                }
+                vheuristic[inode] = fmin;
+            }
+            return vheuristic[inode];
+        };
+
+        typedef std::pair<dReal, uint32_t> OpenEntry;
+        std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry> > openset;
+        for(uint32_t iquery = 0; iquery < _vquerynodes.size(); ++iquery) {
+            if( !_vquerynodes[iquery].bGoal && _vquerynodes[iquery].status != RS_Colliding ) {
+                vcost[numnodes+iquery] = 0;
+                openset.push(OpenEntry(heuristicfn(numnodes+iquery), numnodes+iquery));
+            }
+        }
+
+        uint32_t igoalfound = numtotal;
+        while( !openset.empty() ) {
+            const uint32_t inode = openset.top().second;
+            openset.pop();
+            if( vclosed[inode] ) {
+                continue;
+            }
+            vclosed[inode] = 1;
+            if( inode >= numnodes && _vquerynodes[inode-numnodes].bGoal ) {
+                igoalfound = inode;
+                break;
+            }
+            const dReal* pconfig = _GetConfig(inode);
+            q0.assign(pconfig, pconfig+dof);
+            auto relaxfn = [&](uint32_t itarget) {
+                const uint8_t targetstatus = itarget < numnodes ? roadmap.GetNodeStatus(itarget) : _vquerynodes[itarget-numnodes].status;
+                if( vclosed[itarget] || targetstatus == RS_Colliding ) {
+                    return;
+                }
+                const dReal* ptargetconfig = _GetConfig(itarget);
+                q1.assign(ptargetconfig, ptargetconfig+dof);
+                const dReal fcost = vcost[inode] + _parameters->_distmetricfn(q0, q1);
+                if( fcost < vcost[itarget] ) {
+                    vcost[itarget] = fcost;
+                    vparent[itarget] = inode;
+                    openset.push(OpenEntry(fcost + heuristicfn(itarget), itarget));
+                }
+            };
+            if( inode < numnodes ) {
+                for(uint32_t iedge = roadmap.GetEdgeBegin(inode); iedge < roadmap.GetEdgeEnd(inode); ++iedge) {
+                    if( roadmap.GetEdgeStatus(iedge) != RS_Colliding ) {
+                        relaxfn(roadmap.GetEdgeTarget(iedge));
+                    }
+                }
+                std::pair<std::multimap<uint32_t, uint32_t>::const_iterator, std::multimap<uint32_t, uint32_t>::const_iterator> itrange = mapreverseedges.equal_range(inode);
+                for(std::multimap<uint32_t, uint32_t>::const_iterator it = itrange.first; it != itrange.second; ++it) {
+                    relaxfn(it->second);
+                }
+            }
+            else {
+                FOREACHC(itedge, _vquerynodes[inode-numnodes].vedges) {
+                    if( itedge->second != RS_Colliding ) {
+                        relaxfn(itedge->first);
+                    }
+                }
+            }
+        }
+        if( igoalfound == numtotal ) {
+            return false;
+        }
+        vnodepath.resize(0);
+        for(uint32_t inode = igoalfound; inode != numtotal; inode = vparent[inode]) {
+            vnodepath.push_back(inode);
+        }
+        std::reverse(vnodepath.begin(), vnodepath.end());
+        return true;
+    }
+
+    /// \brief checks the unknown nodes and edges of the path and stores the results
+    ///
+    /// \return true if the path is valid
+    bool _ValidatePath(const std::vector<uint32_t>& vnodepath)
+    {
+        Roadmap& roadmap = *_proadmap;
+        const int dof = _parameters->GetDOF();
+        const uint32_t numnodes = roadmap.GetNumNodes();
+        const std::vector<dReal> vempty;
+        std::vector<dReal> q0(dof), q1(dof);
+
+        // nodes first since they are cheaper and invalidate more paths
+        FOREACHC(itnode, vnodepath) {
+            const uint8_t status = *itnode < numnodes ? roadmap.GetNodeStatus(*itnode) : _vquerynodes[*itnode-numnodes].status;
+            if( status != RS_Unknown ) {
+                continue;
+            }
+            const dReal* pconfig = _GetConfig(*itnode);
+            q0.assign(pconfig, pconfig+dof);
+            const uint8_t newstatus = _parameters->CheckPathAllConstraints(q0, q0, vempty, vempty, 0, IT_Closed) == 0 ? RS_Free : RS_Colliding;
+            if( *itnode < numnodes ) {
+                roadmap.SetNodeStatus(*itnode, newstatus, _ComputeRobotAABB(q0));
+            }
+            else {
+                _vquerynodes[*itnode-numnodes].status = newstatus;
+            }
+            if( newstatus == RS_Colliding ) {
+                return false;
+            }
+        }
+
+        for(size_t ipath = 0; ipath+1 < vnodepath.size(); ++ipath) {
+            const uint32_t inode0 = vnodepath[ipath], inode1 = vnodepath[ipath+1];
+            // find the status of the edge
+            uint8_t* pquerystatus = NULL;
+            uint32_t iroadmapedge = 0;
+            bool bRoadmapEdge = false;
+            uint8_t status = RS_Unknown;
+            if( inode0 < numnodes && inode1 < numnodes ) {
+                for(uint32_t iedge = roadmap.GetEdgeBegin(inode0); iedge < roadmap.GetEdgeEnd(inode0); ++iedge) {
+                    if( roadmap.GetEdgeTarget(iedge) == inode1 ) {
+                        iroadmapedge = iedge;
+                        bRoadmapEdge = true;
+                        status = roadmap.GetEdgeStatus(iedge);
+                        break;
+                    }
+                }
+            }
+            else {
+                // edges of query nodes are stored on the query node
+                const uint32_t iquery = inode0 >= numnodes ? inode0-numnodes : inode1-numnodes;
+                const uint32_t iother = inode0 >= numnodes ? inode1 : inode0;
+                FOREACH(itedge, _vquerynodes[iquery].vedges) {
+                    if( itedge->first == iother ) {
+                        pquerystatus = &itedge->second;
+                        status = itedge->second;
+                        break;
+                    }
+                }
+            }
+            if( status == RS_Free ) {
+                continue;
+            }
+            const dReal* pconfig0 = _GetConfig(inode0);
+            const dReal* pconfig1 = _GetConfig(inode1);
+            q0.assign(pconfig0, pconfig0+dof);
+            q1.assign(pconfig1, pconfig1+dof);
+            const uint8_t newstatus = _parameters->CheckPathAllConstraints(q0, q1, vempty, vempty, 0, IT_Open) == 0 ? RS_Free : RS_Colliding;
+            if( bRoadmapEdge ) {
+                roadmap.SetEdgeStatus(inode0, iroadmapedge, newstatus);
+            }
+            else if( !!pquerystatus ) {
+                *pquerystatus = newstatus;
+                _SetQueryEdgeStatus(inode1 >= numnodes ? inode1-numnodes : inode0-numnodes, inode1 >= numnodes ? inode0 : inode1, newstatus);
+            }
+            if( newstatus == RS_Colliding ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// \brief sets the status of the edge stored on the other query node of an edge between two query nodes
+    void _SetQueryEdgeStatus(uint32_t iquery, uint32_t itarget, uint8_t status)
+    {
+        FOREACH(itedge, _vquerynodes[iquery].vedges) {
+            if( itedge->first == itarget ) {
+                itedge->second = status;
+            }
+        }
+    }
+
+    /// \brief the workspace box of the robot and its grabbed bodies at the configuration
+    AABB _ComputeRobotAABB(const std::vector<dReal>& vconfig)
+    {
+        _parameters->SetStateValues(vconfig, 0);
+        AABB ab = _robot->ComputeAABB();
+        Vector vmin = ab.pos - ab.extents, vmax = ab.pos + ab.extents;
+        std::vector<KinBodyPtr> vgrabbed;
+        _robot->GetGrabbed(vgrabbed);
+        FOREACHC(itgrabbed, vgrabbed) {
+            const AABB abgrabbed = (*itgrabbed)->ComputeAABB();
+            for(int i = 0; i < 3; ++i) {
+                vmin[i] = std::min(vmin[i], abgrabbed.pos[i]-abgrabbed.extents[i]);
+                vmax[i] = std::max(vmax[i], abgrabbed.pos[i]+abgrabbed.extents[i]);
+            }
+        }
+        ab.pos = 0.5*(vmin+vmax);
+        ab.extents = 0.5*(vmax-vmin);
+        return ab;
+    }
+
+    bool _SetRoadmapDirectoryCommand(ostream& sout, istream& sinput)
+    {
+        sinput >> _sRoadmapDirectory;
+        return !!sinput;
+    }
+
+    bool _SetNumSamplesCommand(ostream& sout, istream& sinput)
+    {
+        sinput >> _nNumSamples;
+        return !!sinput;
+    }
+
+    bool _SetNumNeighborsCommand(ostream& sout, istream& sinput)
+    {
+        sinput >> _nNumNeighbors;
+        return !!sinput;
+    }
+
+    bool _GetNumNodesCommand(ostream& sout, istream& sinput)
+    {
+        sout << (!!_proadmap ? _proadmap->GetNumNodes() : 0);
+        return true;
+    }
+
+    PlannerParametersPtr _parameters;
+    RobotBasePtr _robot;
+    RoadmapPtr _proadmap; ///< roadmap of the last InitPlan
+    std::vector<QueryNode> _vquerynodes; ///< starts and goals of the current query, their indices follow the roadmap nodes
+
+    std::string _sRoadmapDirectory;
+    int _nNumSamples; ///< number of nodes of a new roadmap
+    int _nNumNeighbors; ///< number of nearest nodes a node is connected to
+    int _nMaxExpansions; ///< number of times nodes are added to the roadmap when no path is found
+};
+
+PlannerBasePtr CreateLazyPRMPlanner(EnvironmentBasePtr penv, std::istream& sinput)
+{
+    return PlannerBasePtr(new LazyPRMPlanner(penv, sinput));
+}
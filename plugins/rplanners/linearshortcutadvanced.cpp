@@ -77,7 +77,9 @@ public:
 
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
     {
+        OPENRAVE_TRACE_SCOPE("ShortcutLinearPlanner::PlanPath");
         BOOST_ASSERT(!!_parameters && !!ptraj );
+        PlannerProfile::StageTimer profiletimer(_parameters->_profile.get(), PlannerProfile::PPS_Smoothing);
         if( ptraj->GetNumWaypoints() < 2 ) {
             return PlannerStatus(PS_Failed);
         }
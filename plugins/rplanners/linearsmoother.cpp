@@ -13,7 +13,7 @@
 //
 // You should have received a copy of the GNU Lesser General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
-#include "openraveplugindefs.h"
+#include "rplanners.h"
 
 class LinearSmoother : public PlannerBase
 {
@@ -23,6 +23,7 @@ public:
         __description = ":Interface Author: Rosen Diankov\n\nPath optimizer using linear shortcuts assuming robot has no constraints and _neighstatefn is just regular addition. Should be faster than shortcut_linear.\n\nIf passing 0 or 1 to the constructor, can enable/disable single-dof smoothing.";
         _linearretimer = RaveCreatePlanner(GetEnv(), "LinearTrajectoryRetimer");
         _nUseSingleDOFSmoothing = 1;
+        _basetime = 0;
         sinput >> _nUseSingleDOFSmoothing;
         RAVELOG_INFO_FORMAT("env=%s, _nUseSingleDOFSmoothing=%d", GetEnv()->GetNameId()%_nUseSingleDOFSmoothing);
     }
@@ -103,7 +104,9 @@ public:
 
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
     {
+        OPENRAVE_TRACE_SCOPE("LinearSmoother::PlanPath");
         BOOST_ASSERT(!!_parameters && !!ptraj );
+        PlannerProfile::StageTimer profiletimer(_parameters->_profile.get(), PlannerProfile::PPS_Smoothing);
         if( ptraj->GetNumWaypoints() < 2 ) {
             return OPENRAVE_PLANNER_STATUS(PS_Failed);
         }
@@ -114,6 +117,7 @@ public:
         }
 
         uint32_t basetime = utils::GetMilliTime();
+        _basetime = basetime;
         PlannerParametersConstPtr parameters = GetParameters();
 
         if( IS_DEBUGLEVEL(Level_Verbose) ) {
@@ -217,7 +221,7 @@ public:
                     uint32_t basetime1 = utils::GetMilliTime();
                     int nIterationGroup = parameters->_nMaxIterations/100;
                     int nCurIterations = 0;
-                    while(nCurIterations < parameters->_nMaxIterations) {
+                    while(nCurIterations < parameters->_nMaxIterations && !IsPlanningTimeExceeded(*_parameters, _basetime)) {
                         dReal newdist1 = _OptimizePathSingleGroup(listpath, totaldist, nIterationGroup);
                         if( newdist1 < 0 ) {
                             return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%d, Planning was interrupted")%GetEnv()->GetId()), PS_Interrupted);
@@ -286,6 +290,10 @@ protected:
 
         int nrejected = 0;
         for(int curiter = 0; curiter < nMaxIterations; ++curiter ) {
+            if( IsPlanningTimeExceeded(*_parameters, _basetime) ) {
+                RAVELOG_DEBUG_FORMAT("env=%s, smoothing time exceeded (%dms) so breaking. iter=%d < %d", GetEnv()->GetNameId()%(utils::GetMilliTime() - _basetime)%curiter%nMaxIterations);
+                break;
+            }
             if( nrejected >= 20 ) {
                 RAVELOG_VERBOSE_FORMAT("env=%s, smoothing quitting early", GetEnv()->GetNameId());
                 break;
@@ -391,6 +399,10 @@ protected:
         int nrejected = 0;
         PlannerProgress progress;
         for(int curiter = 0; curiter < nMaxIterations; ++curiter ) {
+            if( IsPlanningTimeExceeded(*_parameters, _basetime) ) {
+                RAVELOG_DEBUG_FORMAT("env=%s, smoothing time exceeded (%dms) so breaking. iter=%d < %d", GetEnv()->GetNameId()%(utils::GetMilliTime() - _basetime)%curiter%nMaxIterations);
+                break;
+            }
             if( nrejected >= 20 ) {
                 RAVELOG_VERBOSE_FORMAT("env=%s, smoothing quitting early", GetEnv()->GetNameId());
                 break;
@@ -568,6 +580,10 @@ protected:
         int nrejected = 0;
         PlannerProgress progress;
         for(int curiter = 0; curiter < nMaxIterations; ++curiter ) {
+            if( IsPlanningTimeExceeded(*_parameters, _basetime) ) {
+                RAVELOG_DEBUG_FORMAT("env=%s, smoothing time exceeded (%dms) so breaking. iter=%d < %d", GetEnv()->GetNameId()%(utils::GetMilliTime() - _basetime)%curiter%nMaxIterations);
+                break;
+            }
             if( nrejected >= 20 ) {
                 RAVELOG_VERBOSE_FORMAT("env=%s, smoothing quitting early", GetEnv()->GetNameId());
                 break;
@@ -889,6 +905,10 @@ protected:
 
         int nrejected = 0;
         for(int curiter = 0; curiter < nMaxIterations; ++curiter ) {
+            if( IsPlanningTimeExceeded(*_parameters, _basetime) ) {
+                RAVELOG_DEBUG_FORMAT("env=%s, smoothing time exceeded (%dms) so breaking. iter=%d < %d", GetEnv()->GetNameId()%(utils::GetMilliTime() - _basetime)%curiter%nMaxIterations);
+                break;
+            }
             if( nrejected >= 40 ) {
                 RAVELOG_VERBOSE_FORMAT("env=%s, smoothing quitting early", GetEnv()->GetNameId());
                 break;
@@ -1279,6 +1299,7 @@ protected:
     PlannerBasePtr _linearretimer;
     std::vector<dReal> _vConfigVelocityLimitInv;
     int _nUseSingleDOFSmoothing;
+    uint32_t _basetime; ///< timestamp at the beginning of PlanPath. used for checking the _nMaxPlanningTime budget.
 };
 
 PlannerBasePtr CreateLinearSmoother(EnvironmentBasePtr penv, std::istream& sinput) {
@@ -348,6 +348,55 @@ bool IterativeFixRamps(std::list<ParabolicRamp::ParabolicRampND>& ramps, std::li
     return true;
 }
 
+/** Merge all the ramps that are shorter than minswitchtime, except for the first and the last ones, into their neighbors in one sweep.
+    After ramps i-1,i,i+1 are merged into two ramps, the sweep steps back to check the new ramps, so every merge costs a constant number of
+    steps and the sweep is linear in the number of ramps.
+    \param ramps the ramps to merge in place
+    \param startindex index of the ramp the sweep starts from, the sweep then restarts from the beginning so that all the ramps are visited
+ */
+bool MergeShortInteriorRamps(std::list<ParabolicRamp::ParabolicRampND>& ramps, size_t startindex, ConstraintTrajectoryTimingParametersPtr params)
+{
+    if( ramps.size() < 3 ) {
+        return true;
+    }
+    ParabolicRamp::ParabolicRampND resramp0,resramp1;
+    for(int ipass = 0; ipass < 2; ++ipass) {
+        std::list<ParabolicRamp::ParabolicRampND>::iterator itramp = ramps.begin();
+        if( ipass == 0 ) {
+            if( startindex <= 1 ) {
+                continue;
+            }
+            std::advance(itramp,min(startindex,ramps.size()-1));
+        }
+        else {
+            ++itramp;
+        }
+        while(itramp != ramps.end()) {
+            std::list<ParabolicRamp::ParabolicRampND>::iterator itnext = itramp, itprev = itramp;
+            ++itnext;
+            if( itnext == ramps.end() ) {
+                break;
+            }
+            if( itramp->endTime >= params->minswitchtime ) {
+                itramp = itnext;
+                continue;
+            }
+            --itprev;
+            if( !MergeRamps(*itprev,*itramp,*itnext,resramp0,resramp1,params) ) {
+                return false;
+            }
+            *itprev = resramp0;
+            *itramp = resramp1;
+            ramps.erase(itnext);
+            // the new ramps can also be short
+            if( itprev != ramps.begin() ) {
+                itramp = itprev;
+            }
+        }
+    }
+    return true;
+}
+
 /** Iteratively kill all ramps that are shorter than minswitchtime by merging them into neighboring ramps. Rounds all times to the controller timestep. Does not change the global time duration too much
     \param origramps input ramps
     \param ramps result ramps
@@ -359,71 +408,28 @@ bool IterativeMergeRampsFixedTime(const std::list<ParabolicRamp::ParabolicRampND
     size_t i = 0;
     int nb_short_ramps = 0;
     FOREACHC(itramp,origramps) {
-        if(itramp->endTime < params->minswitchtime && i>0 && i<ramps.size()-1) {
+        if(itramp->endTime < params->minswitchtime && i>0 && i+1<origramps.size()) {
             nb_short_ramps++;
         }
         i++;
     }
-    int maxmergeiterations = min(params->maxmergeiterations, 2*factorial(nb_short_ramps));
+    // the factorial overflows for long trajectories
+    int maxmergeiterations = nb_short_ramps <= 12 ? min(params->maxmergeiterations, 2*factorial(nb_short_ramps)) : params->maxmergeiterations;
 
     int itersi=0;
     bool solvedglobal = false;
 
-    // This loop could be optimized by caching and re-using results of permutations that begin similarly
-    // can also do a uniform random sampling of permutations
     while((!solvedglobal) && itersi < maxmergeiterations) {
         //printf("Iteration %d\n",itersi);
         ramps = origramps;
         itersi++;
         // Kill all ramps that are not the first or the last. For every three ramps where the middle ramp is smaller than minswitchtime, merge the ramp that is in the middle to form two new ramps.
-        bool solved = false;
-        while(true) {
-            solved = true;
-            i = 0;
-            FOREACHC(itramp,ramps) {
-                if(itramp->endTime < params->minswitchtime && i>0 && i<ramps.size()-1) {
-                    solved = false;
-                    break;
-                }
-                i++;
-            }
-            if (solved) {
-                break;
-            }
-            if(ramps.size()<=2) {
-                solved = false;
-                break;
-            }
-            std::vector<int> invalidrampindices;
-            invalidrampindices.resize(0);
-            i = 0;
-            FOREACHC(itramp,ramps) {
-                if(itramp->endTime < params->minswitchtime && i>0 && i<ramps.size()-1) {
-                    invalidrampindices.push_back(i);
-                }
-                i++;
-            }
-            int jramp = invalidrampindices[uniformsampler->SampleSequenceOneUInt32()%invalidrampindices.size()];
-            std::list<ParabolicRamp::ParabolicRampND>::iterator itlist = ramps.begin();
-            std::advance(itlist,jramp+1);
-            ParabolicRamp::ParabolicRampND ramp0,ramp1,ramp2,resramp0,resramp1;
-            ramp2 =*itlist;
-            itlist--;
-            ramp1 = *itlist;
-            itlist--;
-            ramp0 = *itlist;
-            bool res = MergeRamps(ramp0,ramp1,ramp2,resramp0,resramp1,params);
-            if(!res) {
-                solved = false;
-                break;
-            }
-            itlist = ramps.erase(itlist);
-            itlist = ramps.erase(itlist);
-            itlist = ramps.erase(itlist);
-            ramps.insert(itlist,resramp1);
-            itlist--;
-            ramps.insert(itlist,resramp0);
+        // The first iteration sweeps from the beginning, the next ones start from a random ramp to try other merge orders.
+        size_t startindex = 0;
+        if( itersi > 1 && ramps.size() > 2 ) {
+            startindex = 1 + uniformsampler->SampleSequenceOneUInt32()%(ramps.size()-2);
         }
+        bool solved = MergeShortInteriorRamps(ramps,startindex,params);
         if(!solved) {
             continue;
         }
@@ -576,6 +582,64 @@ bool CheckRamps(std::list<ParabolicRamp::ParabolicRampND>&ramps, ParabolicRamp::
     return true;
 }
 
+/** Checks ramps and remembers the ones that passed so that the timescaling searches, which keep most of the ramps the same from one coefficient
+    to the next, only check the ramps they changed. The checks go through the same checker, so they still use its batched collision checks.
+ */
+class RampCheckCache
+{
+public:
+    RampCheckCache(ParabolicRamp::RampFeasibilityChecker& check, int options) : _check(check), _options(options) {
+    }
+
+    /// \brief checks the modified ramps first since they are the most likely to fail
+    bool CheckRamps(const std::list<ParabolicRamp::ParabolicRampND>& ramps)
+    {
+        for(int ipass = 0; ipass < 2; ++ipass) {
+            FOREACHC(itramp,ramps) {
+                if( itramp->modified != (ipass == 0) ) {
+                    continue;
+                }
+                if( !itramp->IsValid() ) {
+                    return false;
+                }
+                _GetKey(*itramp);
+                if( _setfeasiblekeys.count(_vkey) > 0 ) {
+                    continue;
+                }
+                if( !_check.Check(*itramp,_options) ) {
+                    return false;
+                }
+                _setfeasiblekeys.insert(_vkey);
+            }
+        }
+        return true;
+    }
+
+private:
+    /// \brief the boundary conditions do not define the ramp, so the key also has the switch times, accelerations and velocity of every 1D ramp
+    void _GetKey(const ParabolicRamp::ParabolicRampND& ramp)
+    {
+        _vkey.resize(0);
+        _vkey.insert(_vkey.end(),ramp.x0.begin(),ramp.x0.end());
+        _vkey.insert(_vkey.end(),ramp.dx0.begin(),ramp.dx0.end());
+        _vkey.insert(_vkey.end(),ramp.x1.begin(),ramp.x1.end());
+        _vkey.insert(_vkey.end(),ramp.dx1.begin(),ramp.dx1.end());
+        _vkey.push_back(ramp.endTime);
+        FOREACHC(itramp1d,ramp.ramps) {
+            _vkey.push_back(itramp1d->tswitch1);
+            _vkey.push_back(itramp1d->tswitch2);
+            _vkey.push_back(itramp1d->a1);
+            _vkey.push_back(itramp1d->a2);
+            _vkey.push_back(itramp1d->v);
+        }
+    }
+
+    ParabolicRamp::RampFeasibilityChecker& _check;
+    int _options;
+    std::vector<dReal> _vkey;
+    std::set< std::vector<dReal> > _setfeasiblekeys; ///< ramps that passed the checks
+};
+
 bool SpecialCheckRamp(const ParabolicRamp::ParabolicRampND& ramp,const ParabolicRamp::Vector& qstart, const ParabolicRamp::Vector& qgoal, dReal radius, ConstraintTrajectoryTimingParametersPtr params, ParabolicRamp::RampFeasibilityChecker& check, int options)
 {
 
@@ -753,10 +817,11 @@ bool IterativeMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origram
 {
     std::list<ParabolicRamp::ParabolicRampND> ramps,ramps2;
     dReal testcoef;
+    RampCheckCache checkcache(check,options);
 
     //printf("Coef = 1\n");
     bool res = IterativeMergeRampsFixedTime(origramps, ramps2, params, checkcontrollertime, uniformsampler);
-    res = res &&  CheckRamps(ramps2,check,options);
+    res = res &&  checkcache.CheckRamps(ramps2);
     if (res) {
         resramps.swap(ramps2);
         return true;
@@ -769,7 +834,7 @@ bool IterativeMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origram
         return false;
     }
     res = IterativeMergeRampsFixedTime(ramps, ramps2, params, checkcontrollertime, uniformsampler);
-    res = res && CheckRamps(ramps2,check,options);
+    res = res && checkcache.CheckRamps(ramps2);
     if (!res) {
         return false;
     }
@@ -786,7 +851,7 @@ bool IterativeMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origram
             continue;
         }
         res = IterativeMergeRampsFixedTime(ramps, ramps2, params, checkcontrollertime, uniformsampler);
-        res = res && CheckRamps(ramps2,check,options);
+        res = res && checkcache.CheckRamps(ramps2);
         if(res) {
             hi = testcoef;
             resramps.swap(ramps2);
@@ -802,13 +867,14 @@ bool IterativeMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origram
 bool IterativeMergeRampsNoDichotomy(const std::list<ParabolicRamp::ParabolicRampND>&origramps,std::list<ParabolicRamp::ParabolicRampND>&resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, dReal stepsize, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options)
 {
     std::list<ParabolicRamp::ParabolicRampND> ramps;
+    RampCheckCache checkcache(check,options);
     for(dReal testcoef=1; testcoef<=upperbound; testcoef+=stepsize) {
         bool canscale = ScaleRampsTime(origramps,ramps,testcoef,true,params);
         if(!canscale) {
             continue;
         }
         bool res = IterativeMergeRampsFixedTime(ramps, resramps, params, checkcontrollertime, uniformsampler);
-        res = res && CheckRamps(resramps,check,options);
+        res = res && checkcache.CheckRamps(resramps);
         if(res) {
             RAVELOG_DEBUG_FORMAT("Timescale coefficient: %f succeeded\n",testcoef);
             return true;
@@ -0,0 +1,247 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2014 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef RAVE_PLANNERS_NEARESTNEIGHBORINDEX_H
+#define RAVE_PLANNERS_NEARESTNEIGHBORINDEX_H
+
+/// \brief statistics of the nearest neighbor queries of a SpatialTree
+struct NearestNeighborStats
+{
+    NearestNeighborStats() {
+        Reset();
+    }
+    void Reset() {
+        numqueries = 0;
+        querytimens = 0;
+        numrecallchecks = 0;
+        numrecallhits = 0;
+    }
+
+    /// \brief fraction of the checked queries that returned a nearest neighbor as close as the exact search
+    dReal GetRecall() const {
+        return numrecallchecks > 0 ? dReal(numrecallhits)/dReal(numrecallchecks) : dReal(1);
+    }
+
+    uint64_t numqueries; ///< number of queries
+    uint64_t querytimens; ///< total time spent in the queries
+    uint64_t numrecallchecks; ///< number of queries that were also answered with the exact search
+    uint64_t numrecallhits; ///< number of checked queries where the result was as close as the exact result
+};
+
+/** \brief nearest neighbor index for the weighted euclidean metric sqrt(sum_i (w_i*(a_i-b_i))^2).
+
+    The weighted configurations are stored contiguously, and most of them are ordered by the leaves of a kd-tree. New configurations are appended to a
+    tail that is searched linearly until the kd-tree is rebuilt. With epsilon > 0, branches are only searched if they can contain a neighbor that is
+    closer by more than a factor of (1+epsilon), which makes the search approximate.
+
+    Node has to have a _usenn member, nodes with _usenn == 0 are skipped.
+ */
+template <typename Node>
+class KdTreeNearestNeighborIndex
+{
+public:
+    typedef Node* NodePtr;
+
+    KdTreeNearestNeighborIndex() : _dof(0), _fEpsilonMult(1), _numindexed(0) {
+    }
+
+    /// \param vweights the weights of the metric
+    /// \param fEpsilon approximation factor, 0 for exact search
+    void Init(const std::vector<dReal>& vweights, dReal fEpsilon)
+    {
+        Reset();
+        _vweights = vweights;
+        _dof = vweights.size();
+        _fEpsilonMult = 1/((1+fEpsilon)*(1+fEpsilon));
+        _vquery.resize(_dof);
+    }
+
+    void Reset()
+    {
+        _vconfigs.resize(0);
+        _vnodes.resize(0);
+        _vkdnodes.resize(0);
+        _numindexed = 0;
+    }
+
+    inline size_t GetSize() const {
+        return _vnodes.size();
+    }
+
+    void Add(NodePtr node, const dReal* pconfig)
+    {
+        for(int i = 0; i < _dof; ++i) {
+            _vconfigs.push_back(_vweights[i]*pconfig[i]);
+        }
+        _vnodes.push_back(node);
+        // rebuild when the linear tail gets too big compared to the indexed part. This keeps the amortized rebuild cost logarithmic
+        if( _vnodes.size() - _numindexed > std::max(size_t(256), std::min(_numindexed/4, size_t(4096))) ) {
+            _Rebuild();
+        }
+    }
+
+    /// \brief removes the node from the index, the memory is reclaimed when the index is rebuilt
+    void Remove(NodePtr node)
+    {
+        typename std::vector<NodePtr>::iterator itnode = std::find(_vnodes.begin(), _vnodes.end(), node);
+        if( itnode != _vnodes.end() ) {
+            *itnode = NULL;
+        }
+    }
+
+    /// \brief returns the nearest node with _usenn set and the squared weighted distance to it. The node is NULL if the index has no valid nodes.
+    std::pair<NodePtr, dReal> FindNearest(const std::vector<dReal>& vquerystate) const
+    {
+        for(int i = 0; i < _dof; ++i) {
+            _vquery[i] = _vweights[i]*vquerystate[i];
+        }
+        std::pair<NodePtr, dReal> best(NULL, std::numeric_limits<dReal>::infinity());
+        if( _vkdnodes.size() > 0 ) {
+            _Search(0, best);
+        }
+        _SearchRange(_numindexed, _vnodes.size(), best);
+        return best;
+    }
+
+protected:
+    struct KdNode
+    {
+        int splitdim; ///< -1 if leaf
+        dReal splitvalue;
+        int children[2]; ///< indices into _vkdnodes of the lower and upper half
+        int begin, end; ///< range of points of the leaf
+    };
+
+    void _Search(int ikdnode, std::pair<NodePtr, dReal>& best) const
+    {
+        const KdNode& kdnode = _vkdnodes[ikdnode];
+        if( kdnode.splitdim < 0 ) {
+            _SearchRange(kdnode.begin, kdnode.end, best);
+            return;
+        }
+        dReal fdiff = _vquery[kdnode.splitdim] - kdnode.splitvalue;
+        int first = fdiff < 0 ? 0 : 1;
+        _Search(kdnode.children[first], best);
+        if( fdiff*fdiff < best.second*_fEpsilonMult ) {
+            _Search(kdnode.children[1-first], best);
+        }
+    }
+
+    void _SearchRange(size_t begin, size_t end, std::pair<NodePtr, dReal>& best) const
+    {
+        const dReal* pconfig = _vconfigs.data() + begin*_dof;
+        for(size_t index = begin; index < end; ++index, pconfig += _dof) {
+            dReal fdist = 0;
+            int i = 0;
+            for(; i < _dof; ++i) {
+                dReal f = pconfig[i] - _vquery[i];
+                fdist += f*f;
+                if( fdist >= best.second ) {
+                    break;
+                }
+            }
+            if( i == _dof && !!_vnodes[index] && _vnodes[index]->_usenn ) {
+                best.first = _vnodes[index];
+                best.second = fdist;
+            }
+        }
+    }
+
+    /// \brief compacts the removed nodes and builds the kd-tree over all points
+    void _Rebuild()
+    {
+        std::vector<int> vorder; vorder.reserve(_vnodes.size());
+        for(size_t index = 0; index < _vnodes.size(); ++index) {
+            if( !!_vnodes[index] ) {
+                vorder.push_back(index);
+            }
+        }
+        _vkdnodes.resize(0);
+        if( vorder.size() > 0 ) {
+            _Build(vorder, 0, vorder.size());
+        }
+
+        // store the points in the order of the leaves
+        std::vector<dReal> vconfigs(vorder.size()*_dof);
+        std::vector<NodePtr> vnodes(vorder.size());
+        for(size_t i = 0; i < vorder.size(); ++i) {
+            std::copy(_vconfigs.begin()+vorder[i]*_dof, _vconfigs.begin()+(vorder[i]+1)*_dof, vconfigs.begin()+i*_dof);
+            vnodes[i] = _vnodes[vorder[i]];
+        }
+        _vconfigs.swap(vconfigs);
+        _vnodes.swap(vnodes);
+        _numindexed = _vnodes.size();
+    }
+
+    /// \brief builds the kd-tree of vorder[begin:end] and returns its index in _vkdnodes
+    int _Build(std::vector<int>& vorder, int begin, int end)
+    {
+        const int ikdnode = _vkdnodes.size();
+        _vkdnodes.push_back(KdNode());
+        _vkdnodes[ikdnode].begin = begin;
+        _vkdnodes[ikdnode].end = end;
+        _vkdnodes[ikdnode].splitdim = -1;
+        if( end - begin <= s_nMaxLeafSize ) {
+            return ikdnode;
+        }
+
+        // split the dimension with the largest spread at the median
+        int splitdim = 0;
+        dReal fmaxspread = -1;
+        for(int idim = 0; idim < _dof; ++idim) {
+            dReal fmin = std::numeric_limits<dReal>::infinity(), fmax = -std::numeric_limits<dReal>::infinity();
+            for(int i = begin; i < end; ++i) {
+                dReal f = _vconfigs[vorder[i]*_dof+idim];
+                fmin = std::min(fmin, f);
+                fmax = std::max(fmax, f);
+            }
+            if( fmax - fmin > fmaxspread ) {
+                fmaxspread = fmax - fmin;
+                splitdim = idim;
+            }
+        }
+        if( fmaxspread <= 0 ) {
+            // all points are the same
+            return ikdnode;
+        }
+        const int median = begin + (end-begin)/2;
+        std::nth_element(vorder.begin()+begin, vorder.begin()+median, vorder.begin()+end, [this, splitdim](int index0, int index1) {
+            return _vconfigs[index0*_dof+splitdim] < _vconfigs[index1*_dof+splitdim];
+        });
+        const dReal splitvalue = _vconfigs[vorder[median]*_dof+splitdim];
+        const int lowerchild = _Build(vorder, begin, median);
+        const int upperchild = _Build(vorder, median, end);
+        KdNode& kdnode = _vkdnodes[ikdnode];
+        kdnode.splitdim = splitdim;
+        kdnode.splitvalue = splitvalue;
+        kdnode.children[0] = lowerchild;
+        kdnode.children[1] = upperchild;
+        return ikdnode;
+    }
+
+    static const int s_nMaxLeafSize = 16;
+
+    std::vector<dReal> _vweights;
+    int _dof;
+    dReal _fEpsilonMult; ///< 1/(1+epsilon)^2
+    std::vector<dReal> _vconfigs; ///< the weighted configurations of all points, _dof values each
+    std::vector<NodePtr> _vnodes; ///< the node of every point, NULL if removed
+    std::vector<KdNode> _vkdnodes; ///< the kd-tree over the first _numindexed points, _vkdnodes[0] is the root
+    size_t _numindexed; ///< the number of points ordered by the kd-tree, the rest are searched linearly
+    mutable std::vector<dReal> _vquery; ///< the weighted query
+};
+
+#endif
@@ -0,0 +1,125 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2014 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef RAVE_PLANNERS_NODEPOOL_H
+#define RAVE_PLANNERS_NODEPOOL_H
+
+/** \brief allocates fixed size chunks from large slabs of memory.
+
+    Freed chunks are kept in a free list. Reset returns all chunks at once without giving the slabs back to the system, so a tree that is
+    cleared and filled again for every plan does not allocate any more memory once the slabs are big enough. The chunk size can change on
+    every Reset since the slabs are raw memory.
+ */
+class NodePool
+{
+public:
+    NodePool() : _chunksize(0), _islab(0), _slaboffset(0), _pfreelist(NULL), _numchunks(0) {
+    }
+
+    /// \brief returns all chunks to the pool and sets the chunk size of the next allocations
+    void Reset(size_t chunksize)
+    {
+        // keep every chunk aligned for dReal and pointers
+        const size_t alignment = std::max(sizeof(dReal), sizeof(void*));
+        _chunksize = std::max((chunksize + alignment - 1)/alignment*alignment, sizeof(void*));
+        Reset();
+    }
+
+    /// \brief returns all chunks to the pool, the slabs are kept
+    void Reset()
+    {
+        _islab = 0;
+        _slaboffset = 0;
+        _pfreelist = NULL;
+        _numchunks = 0;
+    }
+
+    /// \brief releases all the slabs
+    void Clear()
+    {
+        Reset();
+        _vslabs.clear();
+    }
+
+    void* malloc()
+    {
+        BOOST_ASSERT(_chunksize > 0);
+        ++_numchunks;
+        if( !!_pfreelist ) {
+            void* pmemory = _pfreelist;
+            _pfreelist = *static_cast<void**>(_pfreelist);
+            return pmemory;
+        }
+        while( _islab < _vslabs.size() ) {
+            std::vector<char>& slab = _vslabs[_islab];
+            if( _slaboffset + _chunksize <= slab.size() ) {
+                void* pmemory = &slab[_slaboffset];
+                _slaboffset += _chunksize;
+                return pmemory;
+            }
+            ++_islab;
+            _slaboffset = 0;
+        }
+
+        // need a new slab, double the size every time to keep the number of slabs small
+        size_t slabsize = std::max(size_t(s_nMinSlabSize), _chunksize*32);
+        if( _vslabs.size() > 0 ) {
+            slabsize = std::max(slabsize, std::min(2*_vslabs.back().size(), size_t(s_nMaxSlabSize)));
+        }
+        _vslabs.push_back(std::vector<char>());
+        _vslabs.back().resize(slabsize);
+        _islab = _vslabs.size()-1;
+        _slaboffset = _chunksize;
+        return &_vslabs.back()[0];
+    }
+
+    void free(void* pmemory)
+    {
+        if( !!pmemory ) {
+            *static_cast<void**>(pmemory) = _pfreelist;
+            _pfreelist = pmemory;
+            --_numchunks;
+        }
+    }
+
+    /// \brief number of allocated chunks
+    inline size_t GetNumChunks() const {
+        return _numchunks;
+    }
+
+    /// \brief total memory reserved by the slabs in bytes
+    size_t GetReservedSize() const
+    {
+        size_t size = 0;
+        FOREACHC(itslab, _vslabs) {
+            size += itslab->size();
+        }
+        return size;
+    }
+
+private:
+    static const size_t s_nMinSlabSize = 1<<16;
+    static const size_t s_nMaxSlabSize = 1<<22;
+
+    std::vector< std::vector<char> > _vslabs; ///< the memory, operator new aligns every slab for any type
+    size_t _chunksize;
+    size_t _islab; ///< the slab the next chunk is taken from
+    size_t _slaboffset; ///< offset of the next chunk inside _vslabs[_islab]
+    void* _pfreelist; ///< freed chunks, each one stores a pointer to the next
+    size_t _numchunks;
+};
+
+#endif
@@ -44,6 +44,7 @@ public:
 
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
     {
+        OPENRAVE_TRACE_SCOPE("ParabolicTrajectoryRetimer::PlanPath");
         _trajxmlid = ptraj->GetXMLId();
         return TrajectoryRetimer::PlanPath(ptraj, planningoptions);
     }
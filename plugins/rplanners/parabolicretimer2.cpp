@@ -43,6 +43,7 @@ public:
 
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
     {
+        OPENRAVE_TRACE_SCOPE("ParabolicTrajectoryRetimer2::PlanPath");
         _interpolator.Initialize(_parameters->GetDOF(), GetEnv()->GetId());
         _translationinterpolator.Initialize(3, GetEnv()->GetId());
         _trajxmlid = ptraj->GetXMLId();
@@ -204,6 +205,71 @@ protected:
         }
     }
 
+    /// \brief when every waypoint is reached with zero velocity, the minimum time of a segment is the largest rest-to-rest time of its dofs,
+    /// which has a closed form. Computes it for all the segments with branch-free loops over contiguous arrays so that the compiler can vectorize them.
+    bool _ComputeMinimumTimesJointValues(GroupInfoConstPtr info, size_t numpoints, std::vector<dReal>::iterator itmintimes)
+    {
+        if( (_bmanipconstraints && !!_manipconstraintchecker) || _parameters->_hasvelocities || info->orgveloffset >= 0 ) {
+            // the limits or the boundary velocities of a segment depend on the robot state or on the previous segment
+            return false;
+        }
+        if( numpoints < 2 ) {
+            return false;
+        }
+        const dReal epsilon = RampOptimizer::g_fRampEpsilon;
+        for(int j = 0; j < info->gpos.dof; ++j) {
+            if( !(info->_vConfigVelocityLimit[j] > 0) || !(info->_vConfigAccelerationLimit[j] > 0) ) {
+                // let _ComputeMinimumTimeJointValues report the error
+                return false;
+            }
+        }
+
+        size_t numsegments = numpoints-1;
+        int newdof = _cachednewspec.GetDOF(), olddof = _cachedoldspec.GetDOF();
+        _vbatchx0.resize(numsegments);
+        _vbatchdiff.resize(numsegments);
+        _vbatchinvalid.resize(numsegments);
+        std::fill(itmintimes, itmintimes+numpoints, dReal(0));
+        std::fill(_vbatchinvalid.begin(), _vbatchinvalid.end(), dReal(0));
+        dReal* pmintimes = &*itmintimes + 1;
+        dReal* pinvalid = &_vbatchinvalid[0];
+        for(int j = 0; j < info->gpos.dof; ++j) {
+            // gather the dof into contiguous arrays
+            std::vector<dReal>::const_iterator itpos = _vdata.begin()+info->gpos.offset+j;
+            std::vector<dReal>::const_iterator itdiff = _vdiffdata.begin()+olddof+info->orgposoffset+j;
+            for(size_t i = 0; i < numsegments; ++i) {
+                _vbatchx0[i] = *(itpos+i*newdof);
+                _vbatchdiff[i] = *(itdiff+i*olddof);
+            }
+
+            const dReal* px0 = &_vbatchx0[0];
+            const dReal* pdiff = &_vbatchdiff[0];
+            const dReal vm = info->_vConfigVelocityLimit[j], am = info->_vConfigAccelerationLimit[j], aminv = 1/am, ivmam = 1/(am*vm);
+            const dReal xmin = info->_vConfigLowerLimit[j]-epsilon, xmax = info->_vConfigUpperLimit[j]+epsilon;
+            for(size_t i = 0; i < numsegments; ++i) {
+                // same arithmetic as ParabolicInterpolator::Compute1DTrajectory with v0=v1=0
+                dReal x0 = px0[i];
+                dReal x1 = x0 + pdiff[i];
+                dReal d = std::abs(x1 - x0);
+                dReal vp = std::sqrt(am*d); // inlined so that the loop can be vectorized
+                dReal t1 = vp*aminv; // duration of the acceleration ramp without velocity limit
+                dReal h = vp - vm;
+                dReal th = h*aminv;
+                dReal ttwo = t1 + t1;
+                dReal tthree = (t1 - th) + (2*th + h*h*ivmam) + (t1 - th);
+                dReal t = d <= epsilon ? dReal(0) : (vp <= vm + epsilon ? ttwo : tthree);
+                pmintimes[i] = pmintimes[i] > t ? pmintimes[i] : t;
+                pinvalid[i] += (x0 > xmax || x0 < xmin || x1 > xmax || x1 < xmin) ? dReal(1) : dReal(0);
+            }
+        }
+        for(size_t i = 0; i < numsegments; ++i) {
+            if( pinvalid[i] > 0 ) {
+                pmintimes[i] = -1;
+            }
+        }
+        return true;
+    }
+
     void _ComputeVelocitiesJointValues(GroupInfoConstPtr info, std::vector<dReal>::const_iterator itorgdiff, std::vector<dReal>::const_iterator itdataprev, std::vector<dReal>::iterator itdata)
     {
         if( info->orgveloffset >= 0  ) {
@@ -1039,6 +1105,7 @@ protected:
     vector<dReal> _v0pos, _v0vel, _v1pos, _v1vel;
     vector<dReal> _vtrajpoints;
     std::vector<dReal> _cachevellimits, _cacheaccellimits;
+    std::vector<dReal> _vbatchx0, _vbatchdiff, _vbatchinvalid; ///< per segment data of one dof for _ComputeMinimumTimesJointValues
     std::vector<RampOptimizer::RampND> _cacheRampNDVect;
     RampOptimizer::ParabolicCurve _curve;
 
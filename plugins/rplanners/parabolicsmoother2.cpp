@@ -11,7 +11,7 @@
 //
 // You should have received a copy of the GNU Lesser General Public License along with this program.
 // If not, see <http://www.gnu.org/licenses/>.
-#include "openraveplugindefs.h"
+#include "rplanners.h"
 #include <cfloat>
 #include <fstream>
 #include <openrave/planningutils.h>
@@ -355,6 +355,9 @@ public:
     ParabolicSmoother2(EnvironmentBasePtr penv, std::istream& sinput) : PlannerBase(penv), _feasibilitychecker(this)
     {
         __description = "";
+        RegisterCommand("SetNumShortcutWorkers",boost::bind(&ParabolicSmoother2::_SetNumShortcutWorkersCommand,this,_1,_2),
+                        "sets the number of independent smoothers run in parallel with different seeds on clones of the environment. The shortest result is kept. Shortcutting stops at _nMaxPlanningTime. 1 (default) disables the parallel mode.");
+        _nShortcutWorkers = 1;
         _bmanipconstraints = false;
         _constraintreturn.reset(new ConstraintFilterReturn());
         _logginguniformsampler = RaveCreateSpaceSampler(GetEnv(), "mt19937");
@@ -474,6 +477,7 @@ public:
         if( _cacheAccelLimits.capacity() < ndof ) {
             _cacheAccelLimits.reserve(ndof);
         }
+        _shortcutworkers.Init(GetEnv(), "parabolicsmoother2", _nShortcutWorkers, _parameters);
         return !!_uniformsampler;
     }
 
@@ -484,12 +488,24 @@ public:
 
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
     {
+        OPENRAVE_TRACE_SCOPE("ParabolicSmoother2::PlanPath");
         BOOST_ASSERT(!!_parameters && !!ptraj);
+        PlannerProfile::StageTimer profiletimer(_parameters->_profile.get(), PlannerProfile::PPS_Smoothing);
 
         if( ptraj->GetNumWaypoints() < 2 ) {
             return OPENRAVE_PLANNER_STATUS(PS_Failed);
         }
 
+        if( _shortcutworkers.IsInitialized() && _parameters->_nMaxIterations > 0 ) {
+            PlannerStatus status = _shortcutworkers.PlanPath(ptraj, planningoptions, [this](const PlannerProgress& progress) {
+                return _CallCallbacks(progress);
+            }, _parameters->_profile);
+            if( !(status.GetStatusCode() & PS_HasSolution) ) {
+                return status;
+            }
+            return _ProcessPostPlanners(RobotBasePtr(), ptraj);
+        }
+
         _basetime = utils::GetMilliTime();
 
         if( IS_DEBUGLEVEL(_dumplevel) ) {
@@ -1262,7 +1278,14 @@ public:
             // No manip tool direction constraint but CFO_FillCheckedConfiguration is enabled. We do
             // this because we want to keep the intermediate configurations for collision checking
             // at a later stage.
-            vIntermediateConfigurations.insert(vIntermediateConfigurations.end(), _constraintreturn->_configurations.begin(), _constraintreturn->_configurations.end());
+            if( vIntermediateConfigurations.size() == 0 ) {
+                // take the buffer instead of copying it, the filter return gets the capacity of vIntermediateConfigurations for the next check
+                _vcachecheckedtimes.resize(0);
+                _constraintreturn->SwapCheckedConfigurations(vIntermediateConfigurations, _vcachecheckedtimes);
+            }
+            else {
+                vIntermediateConfigurations.insert(vIntermediateConfigurations.end(), _constraintreturn->_configurations.begin(), _constraintreturn->_configurations.end());
+            }
         }
 
         if( rampndVectOut.size() == 0 ) {
@@ -3515,6 +3538,17 @@ protected:
         _EnsureValidlySampledTimes(t0, t1, tTotal);
     }
 
+    bool _SetNumShortcutWorkersCommand(std::ostream& sout, std::istream& sinput)
+    {
+        int nworkers = 1;
+        sinput >> nworkers;
+        if( !sinput ) {
+            return false;
+        }
+        _nShortcutWorkers = std::max(1, nworkers);
+        return true;
+    }
+
     /// Members
     int _environmentid;
     ConstraintTrajectoryTimingParametersPtr _parameters;
@@ -3540,6 +3574,9 @@ protected:
     DebugLevel _dumplevel;  ///< minimum debug level which triggers trajectory saving
     std::vector<int> _vShortcutStats; ///< keeps track of the number of times a shortcut iter finishes with each ShortcutStatus
 
+    int _nShortcutWorkers; ///< if > 1, PlanPath runs this many smoothers with different seeds on cloned environments and keeps the shortest result
+    ParallelShortcutWorkers _shortcutworkers;
+
     /// Caching stuff
     RampOptimizer::ParabolicPath _cacheparabolicpath, _cacheparabolicpath2;
     std::vector<dReal> _cacheWaypoints; ///< stores concatenated waypoints obtained from the input trajectory
@@ -3555,6 +3592,7 @@ protected:
 
     // in SegmentFeasible2
     std::vector<dReal> _cacheCurPos, _cacheNewPos, _cacheCurVel, _cacheNewVel;
+    std::vector<dReal> _vcachecheckedtimes; ///< swapped with the checked configuration times of _constraintreturn when taking its checked configurations
     RampOptimizer::RampND _cacheRampNDSeg;
 
     // in _SetMileStones
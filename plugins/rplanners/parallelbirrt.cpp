@@ -0,0 +1,287 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2014 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "rplanners.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+/// \brief runs several BiRRT planners with different seeds on cloned environments and returns the first solution
+class ParallelBirrtPlanner : public PlannerBase
+{
+    struct Worker
+    {
+        Worker() : nNextGoalIndex(0) {
+        }
+        EnvironmentBasePtr penv;
+        RobotBasePtr probot;
+        PlannerBasePtr planner;
+        RRTParametersPtr parameters;
+        TrajectoryBasePtr ptraj;
+        UserDataPtr callbackhandle;
+        PlannerStatus status;
+        size_t nNextGoalIndex; ///< index of the next shared goal the worker has not seen
+    };
+    typedef boost::shared_ptr<Worker> WorkerPtr;
+
+public:
+    ParallelBirrtPlanner(EnvironmentBasePtr penv, std::istream& sinput) : PlannerBase(penv), _nWinner(-1), _bCancel(false)
+    {
+        __description = "\
+Runs several BiRRT planners with different random seeds in parallel, each on its own clone of the environment, and returns the first path that is found. The other planners are interrupted as soon as one succeeds. Since the planning time of BiRRT has a long tail, this reduces the worst case planning times a lot.\n\n\
+The workers rebuild the constraint functions from the configuration specification of the parameters, so custom functions set on the parameters are not used by the workers. If the parameters have a _samplegoalfn, it is called from the planning thread and the sampled goals are given to the workers.\n\n\
+The post-processing planner is run once on the resulting path in the original environment.";
+        RegisterCommand("SetNumWorkers",boost::bind(&ParallelBirrtPlanner::_SetNumWorkersCommand,this,_1,_2),
+                        "sets the number of parallel planners, by default the number of hardware threads");
+        RegisterCommand("GetNumWorkers",boost::bind(&ParallelBirrtPlanner::_GetNumWorkersCommand,this,_1,_2),
+                        "returns the number of parallel planners");
+        RegisterCommand("SetShareGoals",boost::bind(&ParallelBirrtPlanner::_SetShareGoalsCommand,this,_1,_2),
+                        "if 1 (default), every sampled goal is given to all the workers. If 0, the sampled goals are divided between the workers.");
+        _nWorkers = std::max(1, (int)std::thread::hardware_concurrency());
+        _bShareGoals = true;
+        sinput >> _nWorkers;
+        _nWorkers = std::max(1, _nWorkers);
+    }
+    virtual ~ParallelBirrtPlanner() {
+    }
+
+    virtual PlannerStatus InitPlan(RobotBasePtr pbase, PlannerParametersConstPtr pparams) override
+    {
+        EnvironmentLock lock(GetEnv()->GetMutex());
+        _parameters.reset(new RRTParameters());
+        _parameters->copy(pparams);
+        _parameters->Validate();
+        _robot = pbase;
+        _vsharedgoals.resize(0);
+
+        if( (int)_vworkers.size() != _nWorkers ) {
+            _vworkers.clear();
+            for(int iworker = 0; iworker < _nWorkers; ++iworker) {
+                WorkerPtr worker(new Worker());
+                worker->penv = GetEnv()->CloneSelf(str(boost::format("%s_birrtworker%d")%GetEnv()->GetName()%iworker), Clone_Bodies);
+                // the workers only check collisions, so do not compete with the planning threads
+                worker->penv->StopSimulation();
+                worker->planner = RaveCreatePlanner(worker->penv, "birrt");
+                if( !worker->planner ) {
+                    _vworkers.clear();
+                    return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, failed to create birrt planner")%GetEnv()->GetNameId()), PS_Failed);
+                }
+                worker->callbackhandle = worker->planner->RegisterPlanCallback(boost::bind(&ParallelBirrtPlanner::_WorkerCallback,this,_1));
+                _vworkers.push_back(worker);
+            }
+        }
+        else {
+            FOREACH(itworker, _vworkers) {
+                (*itworker)->penv->Clone(GetEnv(), Clone_Bodies);
+            }
+        }
+
+        PlannerStatus status;
+        int numinitialized = 0;
+        for(size_t iworker = 0; iworker < _vworkers.size(); ++iworker) {
+            Worker& worker = *_vworkers[iworker];
+            worker.probot = worker.penv->GetRobot(_robot->GetName());
+            if( !worker.probot ) {
+                return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, could not find robot %s in the cloned environment")%GetEnv()->GetNameId()%_robot->GetName()), PS_Failed);
+            }
+            worker.nNextGoalIndex = 0;
+            worker.parameters = _CreateWorkerParameters(worker, iworker);
+            status = worker.planner->InitPlan(worker.probot, worker.parameters);
+            if( !(status.GetStatusCode() & PS_HasSolution) ) {
+                RAVELOG_DEBUG_FORMAT("env=%s, worker %d failed to initialize: %s", GetEnv()->GetNameId()%iworker%status.description);
+                worker.parameters.reset();
+                continue;
+            }
+            ++numinitialized;
+        }
+        if( numinitialized == 0 ) {
+            _parameters.reset();
+            return status;
+        }
+        RAVELOG_DEBUG_FORMAT("env=%s, ParallelBiRRT initialized %d/%d workers", GetEnv()->GetNameId()%numinitialized%_vworkers.size());
+        return PlannerStatus(PS_HasSolution);
+    }
+
+    virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
+    {
+        OPENRAVE_TRACE_SCOPE("ParallelBirrtPlanner::PlanPath");
+        if(!_parameters) {
+            return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, ParallelBirrtPlanner::PlanPath - Error, planner not initialized")%GetEnv()->GetNameId()), PS_Failed);
+        }
+
+        EnvironmentLock lock(GetEnv()->GetMutex());
+        uint64_t basetimeus = utils::GetMonotonicTime();
+        PlannerParameters::StateSaver savestate(_parameters);
+
+        _nWinner = -1;
+        _bCancel = false;
+        // cancels and joins the workers if the callbacks or the goal sampling throw
+        ParallelPlannerWorkerThreads threads(GetEnv()->GetNameId(), _bCancel);
+        for(size_t iworker = 0; iworker < _vworkers.size(); ++iworker) {
+            WorkerPtr worker = _vworkers[iworker];
+            if( !worker->parameters ) {
+                continue;
+            }
+            worker->ptraj = RaveCreateTrajectory(worker->penv, ptraj->GetXMLId());
+            threads.Run(iworker, [worker, planningoptions]() {
+                return worker->planner->PlanPath(worker->ptraj, planningoptions);
+            }, [this, worker, iworker](const PlannerStatus& status) {
+                worker->status = status;
+                if( status.GetStatusCode() & PS_HasSolution ) {
+                    int expected = -1;
+                    _nWinner.compare_exchange_strong(expected, (int)iworker);
+                }
+            });
+        }
+        const int numstarted = threads.GetNumStarted();
+
+        // sample the goals and call the callbacks while the workers are planning
+        PlannerProgress progress;
+        std::vector<dReal> vgoal;
+        while( _nWinner < 0 && threads.GetNumFinished() < numstarted ) {
+            if( _CallCallbacks(progress) == PA_Interrupt ) {
+                _bCancel = true;
+                break;
+            }
+            bool bSampledGoal = false;
+            if( !!_parameters->_samplegoalfn ) {
+                vgoal.resize(0);
+                if( CallProfiledSampleFn(_parameters->_samplegoalfn, vgoal, _parameters->_profile, PlannerProfile::PPS_IK) && (int)vgoal.size() == _parameters->GetDOF() ) {
+                    std::lock_guard<std::mutex> goallock(_mutexGoals);
+                    _vsharedgoals.push_back(vgoal);
+                    bSampledGoal = true;
+                }
+            }
+            if( !bSampledGoal ) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            ++progress._iteration;
+        }
+        threads.Join();
+        if( !!_parameters->_profile ) {
+            FOREACHC(itworker, _vworkers) {
+                if( !!(*itworker)->parameters && !!(*itworker)->parameters->_profile ) {
+                    _parameters->_profile->Add(*(*itworker)->parameters->_profile);
+                    (*itworker)->parameters->_profile->Reset();
+                }
+            }
+        }
+
+        const int nWinner = _nWinner;
+        uint64_t elapsedtimeus = utils::GetMonotonicTime()-basetimeus;
+        if( nWinner < 0 ) {
+            if( _bCancel ) {
+                return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, Planning was interrupted")%GetEnv()->GetNameId()), PS_Interrupted);
+            }
+            std::string description = str(boost::format(_("env=%s, all %d workers failed in %u[us]"))%GetEnv()->GetNameId()%numstarted%elapsedtimeus);
+            RAVELOG_WARN(description);
+            return OPENRAVE_PLANNER_STATUS(description, PS_Failed);
+        }
+
+        Worker& winner = *_vworkers.at(nWinner);
+        std::vector<dReal> vdata;
+        winner.ptraj->GetWaypoints(0, winner.ptraj->GetNumWaypoints(), vdata, _parameters->_configurationspecification);
+        if( ptraj->GetConfigurationSpecification().GetDOF() == 0 ) {
+            ptraj->Init(_parameters->_configurationspecification);
+        }
+        ptraj->Insert(ptraj->GetNumWaypoints(), vdata, _parameters->_configurationspecification);
+        RAVELOG_DEBUG_FORMAT("env=%s, plan success from worker %d/%d, path=%d points, shared goals=%d, computation time=%u[us]", GetEnv()->GetNameId()%nWinner%numstarted%ptraj->GetNumWaypoints()%_vsharedgoals.size()%elapsedtimeus);
+        return _ProcessPostPlanners(_robot,ptraj);
+    }
+
+    virtual PlannerParametersConstPtr GetParameters() const {
+        return _parameters;
+    }
+
+protected:
+    /// \brief creates the parameters of a worker with the state and constraint functions bound to the cloned environment
+    RRTParametersPtr _CreateWorkerParameters(const Worker& worker, int iworker)
+    {
+        RRTParametersPtr params(new RRTParameters());
+        InitParallelWorkerParameters(params, _parameters, worker.penv, iworker+1);
+        // these are bound to the original environment
+        params->_costfn.clear();
+        params->_goalfn.clear();
+        params->_sampleinitialfn.clear();
+        params->_samplegoalfn.clear();
+        if( !!_parameters->_samplegoalfn ) {
+            params->_samplegoalfn = boost::bind(&ParallelBirrtPlanner::_SampleSharedGoal,this,iworker,_1);
+        }
+        return params;
+    }
+
+    /// \brief _samplegoalfn of the workers, returns the next goal sampled by the planning thread that belongs to the worker
+    bool _SampleSharedGoal(int iworker, std::vector<dReal>& vgoal)
+    {
+        Worker& worker = *_vworkers.at(iworker);
+        std::lock_guard<std::mutex> goallock(_mutexGoals);
+        while( worker.nNextGoalIndex < _vsharedgoals.size() ) {
+            size_t goalindex = worker.nNextGoalIndex++;
+            if( _bShareGoals || (int)(goalindex % _vworkers.size()) == iworker ) {
+                vgoal = _vsharedgoals[goalindex];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    PlannerAction _WorkerCallback(const PlannerProgress& progress)
+    {
+        return (_nWinner >= 0 || _bCancel) ? PA_Interrupt : PA_None;
+    }
+
+    bool _SetNumWorkersCommand(ostream& sout, istream& sinput)
+    {
+        int nworkers = 1;
+        sinput >> nworkers;
+        if( !sinput ) {
+            return false;
+        }
+        _nWorkers = std::max(1, nworkers);
+        return true;
+    }
+
+    bool _GetNumWorkersCommand(ostream& sout, istream& sinput)
+    {
+        sout << _nWorkers;
+        return true;
+    }
+
+    bool _SetShareGoalsCommand(ostream& sout, istream& sinput)
+    {
+        sinput >> _bShareGoals;
+        return !!sinput;
+    }
+
+    RRTParametersPtr _parameters;
+    RobotBasePtr _robot;
+    int _nWorkers;
+    bool _bShareGoals;
+    std::vector<WorkerPtr> _vworkers;
+
+    std::atomic<int> _nWinner; ///< index of the first worker that found a path, -1 if none
+    std::atomic<bool> _bCancel; ///< true if the planning was interrupted
+
+    std::mutex _mutexGoals; ///< protects _vsharedgoals
+    std::vector< std::vector<dReal> > _vsharedgoals; ///< goals sampled by the planning thread
+};
+
+PlannerBasePtr CreateParallelBirrtPlanner(EnvironmentBasePtr penv, std::istream& sinput)
+{
+    return PlannerBasePtr(new ParallelBirrtPlanner(penv, sinput));
+}
@@ -0,0 +1,449 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2014 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "openraveplugindefs.h"
+
+#include <cstdio>
+#include <mutex>
+#include <set>
+
+#define _(msgid) OpenRAVE::RaveGetLocalizedTextForDomain("openrave_plugins_rplanners", msgid)
+
+namespace {
+
+/// \brief the paths planned for one robot, configuration specification and static environment
+///
+/// Shared by all the planners of the process and persisted to a text file. Libraries are meant to hold hundreds of paths, so they are searched linearly.
+class PathLibrary
+{
+public:
+    PathLibrary(const std::string& filename) : _filename(filename) {
+        _Load();
+    }
+
+    /// \brief returns the paths closest to the start and goal, closest first
+    ///
+    /// \param distfn the metric of the configurations, the distance of a path is the sum of the distances of its start and goal
+    void FindClosest(const std::vector<dReal>& vstart, const std::vector<dReal>& vgoal, const PlannerBase::PlannerParameters::DistMetricFn& distfn, size_t numpaths, std::vector< std::pair<dReal, std::vector<dReal> > >& vclosest)
+    {
+        const size_t dof = vstart.size();
+        std::vector<dReal> vpathstart(dof), vpathgoal(dof);
+        std::lock_guard<std::mutex> lock(_mutex);
+        vclosest.resize(0);
+        FOREACHC(itpath, _vpaths) {
+            if( itpath->size() < 2*dof || itpath->size() % dof != 0 ) {
+                continue;
+            }
+            vpathstart.assign(itpath->begin(), itpath->begin()+dof);
+            vpathgoal.assign(itpath->end()-dof, itpath->end());
+            vclosest.emplace_back(distfn(vstart, vpathstart) + distfn(vgoal, vpathgoal), *itpath);
+        }
+        std::sort(vclosest.begin(), vclosest.end(), [](const std::pair<dReal, std::vector<dReal> >& a, const std::pair<dReal, std::vector<dReal> >& b) {
+            return a.first < b.first;
+        });
+        if( vclosest.size() > numpaths ) {
+            vclosest.resize(numpaths);
+        }
+    }
+
+    /// \brief adds the path and saves the library. A stored path whose start and goal are both within fReplaceDistance of the new ones is replaced.
+    void Add(const std::vector<dReal>& vpath, size_t dof, const PlannerBase::PlannerParameters::DistMetricFn& distfn, dReal fReplaceDistance, size_t maxpaths)
+    {
+        if( dof == 0 || vpath.size() < 2*dof ) {
+            return;
+        }
+        const std::vector<dReal> vstart(vpath.begin(), vpath.begin()+dof), vgoal(vpath.end()-dof, vpath.end());
+        std::vector<dReal> vpathstart(dof), vpathgoal(dof);
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::list< std::vector<dReal> >::iterator itpath = _vpaths.begin();
+        for(; itpath != _vpaths.end(); ++itpath) {
+            if( itpath->size() < 2*dof ) {
+                continue;
+            }
+            vpathstart.assign(itpath->begin(), itpath->begin()+dof);
+            vpathgoal.assign(itpath->end()-dof, itpath->end());
+            if( distfn(vstart, vpathstart) <= fReplaceDistance && distfn(vgoal, vpathgoal) <= fReplaceDistance ) {
+                break;
+            }
+        }
+        if( itpath != _vpaths.end() ) {
+            _vpaths.erase(itpath);
+        }
+        _vpaths.push_back(vpath);
+        while( _vpaths.size() > maxpaths ) {
+            _vpaths.pop_front();
+        }
+        _Save();
+    }
+
+    size_t GetNumPaths() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _vpaths.size();
+    }
+
+private:
+    /// \brief the file has the number of paths followed by the number of values and the values of every path
+    void _Load()
+    {
+        std::ifstream f(_filename.c_str());
+        if( !f ) {
+            return;
+        }
+        size_t numpaths = 0;
+        f >> numpaths;
+        for(size_t ipath = 0; ipath < numpaths && !!f; ++ipath) {
+            size_t numvalues = 0;
+            f >> numvalues;
+            std::vector<dReal> vpath(numvalues);
+            FOREACH(itvalue, vpath) {
+                f >> *itvalue;
+            }
+            if( !!f ) {
+                _vpaths.push_back(vpath);
+            }
+        }
+        RAVELOG_DEBUG_FORMAT("loaded %d paths from %s", _vpaths.size()%_filename);
+    }
+
+    /// \brief writes to a temporary file first so that other processes never read a partial library
+    void _Save() const
+    {
+        const std::string tempfilename = _filename + ".tmp";
+        {
+            std::ofstream f(tempfilename.c_str());
+            if( !f ) {
+                RAVELOG_WARN_FORMAT("failed to save the path library to %s", tempfilename);
+                return;
+            }
+            f << std::setprecision(std::numeric_limits<dReal>::digits10+1);
+            f << _vpaths.size() << std::endl;
+            FOREACHC(itpath, _vpaths) {
+                f << itpath->size();
+                FOREACHC(itvalue, *itpath) {
+                    f << " " << *itvalue;
+                }
+                f << std::endl;
+            }
+        }
+        if( std::rename(tempfilename.c_str(), _filename.c_str()) != 0 ) {
+            RAVELOG_WARN_FORMAT("failed to save the path library to %s", _filename);
+        }
+    }
+
+    const std::string _filename;
+    mutable std::mutex _mutex; ///< protects _vpaths
+    std::list< std::vector<dReal> > _vpaths; ///< the dof values of the waypoints of every path, oldest first
+};
+
+typedef boost::shared_ptr<PathLibrary> PathLibraryPtr;
+
+/// \brief returns the library stored in filename, loading it the first time
+PathLibraryPtr GetPathLibrary(const std::string& filename)
+{
+    static std::mutex s_mutex;
+    static std::map<std::string, PathLibraryPtr> s_mapLibraries;
+    std::lock_guard<std::mutex> lock(s_mutex);
+    PathLibraryPtr& plibrary = s_mapLibraries[filename];
+    if( !plibrary ) {
+        plibrary.reset(new PathLibrary(filename));
+    }
+    return plibrary;
+}
+
+} // end namespace
+
+/// \brief reuses the paths planned before for similar starts and goals, and falls back to BiRRT
+class PathLibraryPlanner : public PlannerBase
+{
+public:
+    PathLibraryPlanner(EnvironmentBasePtr penv, std::istream& sinput) : PlannerBase(penv), _sLibraryDirectory(RaveGetHomeDirectory()), _nNumCandidates(3), _nMaxPaths(1000), _nRepairIterations(1000)
+    {
+        __description = "\
+Keeps a library of the paths that were planned for the robot, and plans a new query by reusing the stored paths whose start and goal are closest to the query. The start and goal of the query are connected to the stored path, and every segment is checked with CheckPathAllConstraints. Sections that became invalid are replanned with BiRRT with lazy collision checking between the valid waypoints around them. If none of the closest paths can be repaired, the whole query is planned with BiRRT. New and repaired paths are added to the library.\n\n\
+There is one library for every robot geometry, configuration specification and static environment, saved to a file in the library directory so that it survives the process. The static environment is made of the transforms and dof values of all the bodies except the robot, the bodies it grabs, and the bodies set with SetDynamicBodies.\n\n\
+The post-processing planner is run on the resulting path.";
+        RegisterCommand("SetLibraryDirectory",boost::bind(&PathLibraryPlanner::_SetLibraryDirectoryCommand,this,_1,_2),
+                        "sets the directory the path libraries are saved in, by default the openrave home directory");
+        RegisterCommand("SetDynamicBodies",boost::bind(&PathLibraryPlanner::_SetDynamicBodiesCommand,this,_1,_2),
+                        "sets the names of the bodies that move between queries and are not part of the static environment the library is for");
+        RegisterCommand("SetNumCandidates",boost::bind(&PathLibraryPlanner::_SetNumCandidatesCommand,this,_1,_2),
+                        "sets the number of stored paths that are tried before planning from scratch, 3 by default");
+        RegisterCommand("SetMaxPaths",boost::bind(&PathLibraryPlanner::_SetMaxPathsCommand,this,_1,_2),
+                        "sets the number of paths kept in a library, 1000 by default. The oldest paths are removed first.");
+        RegisterCommand("GetNumPaths",boost::bind(&PathLibraryPlanner::_GetNumPathsCommand,this,_1,_2),
+                        "returns the number of paths in the library of the last InitPlan");
+    }
+    virtual ~PathLibraryPlanner() {
+    }
+
+    virtual PlannerStatus InitPlan(RobotBasePtr pbase, PlannerParametersConstPtr pparams) override
+    {
+        EnvironmentLock lock(GetEnv()->GetMutex());
+        _parameters.reset(new RRTParameters());
+        _parameters->copy(pparams);
+        _parameters->Validate();
+        _robot = pbase;
+        if( !_birrt ) {
+            _birrt = RaveCreatePlanner(GetEnv(), "birrt");
+            if( !_birrt ) {
+                _parameters.reset();
+                return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, failed to create birrt planner")%GetEnv()->GetNameId()), PS_Failed);
+            }
+        }
+        _plibrary = GetPathLibrary(str(boost::format("%s/pathlibrary_%s.txt")%_sLibraryDirectory%_ComputeLibraryHash()));
+        return PlannerStatus(PS_HasSolution);
+    }
+
+    virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
+    {
+        OPENRAVE_TRACE_SCOPE("PathLibraryPlanner::PlanPath");
+        if(!_parameters) {
+            return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, PathLibraryPlanner::PlanPath - Error, planner not initialized")%GetEnv()->GetNameId()), PS_Failed);
+        }
+
+        EnvironmentLock lock(GetEnv()->GetMutex());
+        uint64_t basetimeus = utils::GetMonotonicTime();
+        PlannerParameters::StateSaver savestate(_parameters);
+
+        const int dof = _parameters->GetDOF();
+        std::vector<dReal> vpath;
+        bool bFound = false, bRepaired = false;
+        if( _parameters->vinitialconfig.size() >= (size_t)dof && _parameters->vgoalconfig.size() >= (size_t)dof ) {
+            const std::vector<dReal> vstart(_parameters->vinitialconfig.begin(), _parameters->vinitialconfig.begin()+dof);
+            std::vector< std::pair<dReal, std::vector<dReal> > > vcandidates, vgoalcandidates;
+            for(size_t igoal = 0; igoal+dof <= _parameters->vgoalconfig.size(); igoal += dof) {
+                const std::vector<dReal> vgoal(_parameters->vgoalconfig.begin()+igoal, _parameters->vgoalconfig.begin()+igoal+dof);
+                _plibrary->FindClosest(vstart, vgoal, _parameters->_distmetricfn, _nNumCandidates, vgoalcandidates);
+                FOREACH(itcandidate, vgoalcandidates) {
+                    // connect the query to the stored path
+                    itcandidate->second.insert(itcandidate->second.begin(), vstart.begin(), vstart.end());
+                    itcandidate->second.insert(itcandidate->second.end(), vgoal.begin(), vgoal.end());
+                    vcandidates.push_back(std::move(*itcandidate));
+                }
+            }
+            std::stable_sort(vcandidates.begin(), vcandidates.end(), [](const std::pair<dReal, std::vector<dReal> >& a, const std::pair<dReal, std::vector<dReal> >& b) {
+                return a.first < b.first;
+            });
+            for(size_t icandidate = 0; icandidate < vcandidates.size() && icandidate < (size_t)_nNumCandidates; ++icandidate) {
+                vpath.swap(vcandidates[icandidate].second);
+                _RemoveDuplicateWaypoints(vpath);
+                if( _RepairPath(vpath, bRepaired) ) {
+                    RAVELOG_DEBUG_FORMAT("env=%s, reused stored path %d/%d with %d waypoints", GetEnv()->GetNameId()%icandidate%vcandidates.size()%(vpath.size()/dof));
+                    bFound = true;
+                    break;
+                }
+            }
+        }
+
+        if( !bFound ) {
+            PlannerStatus status = _PlanBirrt(_parameters, vpath, planningoptions);
+            if( !(status.GetStatusCode() & PS_HasSolution) ) {
+                return status;
+            }
+        }
+        if( !bFound || bRepaired ) {
+            _plibrary->Add(vpath, dof, _parameters->_distmetricfn, g_fEpsilonLinear, _nMaxPaths);
+        }
+
+        if( ptraj->GetConfigurationSpecification().GetDOF() == 0 ) {
+            ptraj->Init(_parameters->_configurationspecification);
+        }
+        ptraj->Insert(ptraj->GetNumWaypoints(), vpath, _parameters->_configurationspecification);
+        RAVELOG_DEBUG_FORMAT("env=%s, plan success %s library, path=%d points, computation time=%u[us]", GetEnv()->GetNameId()%(bFound ? "from" : "without")%ptraj->GetNumWaypoints()%(utils::GetMonotonicTime()-basetimeus));
+        return _ProcessPostPlanners(_robot,ptraj);
+    }
+
+    virtual PlannerParametersConstPtr GetParameters() const {
+        return _parameters;
+    }
+
+protected:
+    /// \brief the md5 hash of everything the validity of the stored paths depends on
+    std::string _ComputeLibraryHash() const
+    {
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(3);
+        ss << _robot->GetKinematicsGeometryHash() << std::endl << _parameters->_configurationspecification << std::endl;
+        std::vector<KinBodyPtr> vbodies;
+        GetEnv()->GetBodies(vbodies);
+        std::vector<dReal> vdofvalues;
+        FOREACHC(itbody, vbodies) {
+            const KinBody& body = **itbody;
+            if( *itbody == _robot || !!_robot->IsGrabbing(body) || _setDynamicBodyNames.count(body.GetName()) > 0 ) {
+                continue;
+            }
+            const Transform t = body.GetTransform();
+            ss << body.GetName() << " " << body.GetKinematicsGeometryHash() << " " << t.trans.x << " " << t.trans.y << " " << t.trans.z << " " << t.rot.x << " " << t.rot.y << " " << t.rot.z << " " << t.rot.w;
+            body.GetDOFValues(vdofvalues);
+            FOREACHC(itvalue, vdofvalues) {
+                ss << " " << *itvalue;
+            }
+            ss << std::endl;
+        }
+        return utils::GetMD5HashString(ss.str());
+    }
+
+    void _RemoveDuplicateWaypoints(std::vector<dReal>& vpath) const
+    {
+        const int dof = _parameters->GetDOF();
+        std::vector<dReal> vprev(dof), vcur(dof), vunique;
+        vunique.reserve(vpath.size());
+        for(size_t ivalue = 0; ivalue+dof <= vpath.size(); ivalue += dof) {
+            vcur.assign(vpath.begin()+ivalue, vpath.begin()+ivalue+dof);
+            if( vunique.size() > 0 && ivalue+dof < vpath.size() && _parameters->_distmetricfn(vprev, vcur) <= g_fEpsilonLinear ) {
+                continue;
+            }
+            if( vunique.size() > 0 && ivalue+dof == vpath.size() && _parameters->_distmetricfn(vprev, vcur) <= g_fEpsilonLinear ) {
+                // keep the exact goal
+                vunique.resize(vunique.size()-dof);
+            }
+            vunique.insert(vunique.end(), vcur.begin(), vcur.end());
+            vprev.swap(vcur);
+        }
+        vpath.swap(vunique);
+    }
+
+    /// \brief checks the segments of the path, and replans the sections that are invalid between the valid waypoints around them
+    ///
+    /// \param bRepaired set to true if a section was replanned
+    /// \return true if vpath is valid
+    bool _RepairPath(std::vector<dReal>& vpath, bool& bRepaired)
+    {
+        bRepaired = false;
+        const int dof = _parameters->GetDOF();
+        const size_t numwaypoints = vpath.size()/dof;
+        if( numwaypoints < 2 ) {
+            return false;
+        }
+        std::vector<dReal> q0(vpath.begin(), vpath.begin()+dof), q1(dof), vrepaired, vsection;
+        const std::vector<dReal> vempty;
+        vrepaired.reserve(vpath.size());
+        vrepaired.insert(vrepaired.end(), q0.begin(), q0.end());
+        size_t iwaypoint = 0;
+        while( iwaypoint+1 < numwaypoints ) {
+            q1.assign(vpath.begin()+(iwaypoint+1)*dof, vpath.begin()+(iwaypoint+2)*dof);
+            if( _parameters->CheckPathAllConstraints(q0, q1, vempty, vempty, 0, iwaypoint == 0 ? IT_Closed : IT_OpenStart) == 0 ) {
+                vrepaired.insert(vrepaired.end(), q1.begin(), q1.end());
+                q0.swap(q1);
+                ++iwaypoint;
+                continue;
+            }
+
+            // the section to replan ends at the next valid waypoint
+            size_t inext = iwaypoint+1;
+            while( inext < numwaypoints ) {
+                q1.assign(vpath.begin()+inext*dof, vpath.begin()+(inext+1)*dof);
+                if( _parameters->CheckPathAllConstraints(q1, q1, vempty, vempty, 0, IT_Closed) == 0 ) {
+                    break;
+                }
+                ++inext;
+            }
+            if( inext >= numwaypoints ) {
+                return false;
+            }
+            RRTParametersPtr params(new RRTParameters());
+            params->copy(_parameters);
+            params->vinitialconfig = q0;
+            params->vgoalconfig = q1;
+            params->_samplegoalfn.clear();
+            params->_sampleinitialfn.clear();
+            params->_bLazyCollisionChecking = true;
+            params->_nMaxIterations = _nRepairIterations;
+            if( !(_PlanBirrt(params, vsection, 0).GetStatusCode() & PS_HasSolution) || vsection.size() < 2*(size_t)dof ) {
+                return false;
+            }
+            vrepaired.insert(vrepaired.end(), vsection.begin()+dof, vsection.end());
+            q0 = q1;
+            iwaypoint = inext;
+            bRepaired = true;
+        }
+        vpath.swap(vrepaired);
+        return true;
+    }
+
+    /// \brief plans with BiRRT without post-processing
+    PlannerStatus _PlanBirrt(PlannerParametersConstPtr params, std::vector<dReal>& vpath, int planningoptions)
+    {
+        RRTParametersPtr birrtparams(new RRTParameters());
+        birrtparams->copy(params);
+        birrtparams->_sPostProcessingPlanner = "";
+        birrtparams->_sPostProcessingParameters = "";
+        PlannerStatus status = _birrt->InitPlan(_robot, birrtparams);
+        if( !(status.GetStatusCode() & PS_HasSolution) ) {
+            return status;
+        }
+        if( !_ptrajbirrt ) {
+            _ptrajbirrt = RaveCreateTrajectory(GetEnv(), "");
+        }
+        _ptrajbirrt->Init(_parameters->_configurationspecification);
+        status = _birrt->PlanPath(_ptrajbirrt, planningoptions);
+        if( status.GetStatusCode() & PS_HasSolution ) {
+            _ptrajbirrt->GetWaypoints(0, _ptrajbirrt->GetNumWaypoints(), vpath, _parameters->_configurationspecification);
+        }
+        return status;
+    }
+
+    bool _SetLibraryDirectoryCommand(ostream& sout, istream& sinput)
+    {
+        sinput >> _sLibraryDirectory;
+        return !!sinput;
+    }
+
+    bool _SetDynamicBodiesCommand(ostream& sout, istream& sinput)
+    {
+        _setDynamicBodyNames.clear();
+        std::string name;
+        while( sinput >> name ) {
+            _setDynamicBodyNames.insert(name);
+        }
+        return true;
+    }
+
+    bool _SetNumCandidatesCommand(ostream& sout, istream& sinput)
+    {
+        sinput >> _nNumCandidates;
+        return !!sinput;
+    }
+
+    bool _SetMaxPathsCommand(ostream& sout, istream& sinput)
+    {
+        sinput >> _nMaxPaths;
+        return !!sinput;
+    }
+
+    bool _GetNumPathsCommand(ostream& sout, istream& sinput)
+    {
+        sout << (!!_plibrary ? _plibrary->GetNumPaths() : 0);
+        return true;
+    }
+
+    RRTParametersPtr _parameters;
+    RobotBasePtr _robot;
+    PlannerBasePtr _birrt; ///< plans the queries that cannot be answered from the library and repairs the stored paths
+    TrajectoryBasePtr _ptrajbirrt; ///< output of _birrt
+    PathLibraryPtr _plibrary; ///< library of the last InitPlan
+
+    std::string _sLibraryDirectory;
+    std::set<std::string> _setDynamicBodyNames; ///< bodies that are not part of the static environment
+    int _nNumCandidates; ///< number of stored paths tried for every query
+    size_t _nMaxPaths; ///< maximum number of paths of a library
+    int _nRepairIterations; ///< maximum iterations of BiRRT when repairing a section of a stored path
+};
+
+PlannerBasePtr CreatePathLibraryPlanner(EnvironmentBasePtr penv, std::istream& sinput)
+{
+    return PlannerBasePtr(new PathLibraryPlanner(penv, sinput));
+}
@@ -36,6 +36,76 @@ const char* GetPolynomialCheckReturnString(PolynomialCheckReturn ret)
     return "PCR(Unknown)";
 }
 
+/// \brief Append to roots the real roots of the polynomial c[0] + c[1]*t + ... + c[n]*t^n with n <= 3, computed in closed
+///        form. For cubics, the roots of the derivative are appended too so that a pair of close roots lost to rounding is
+///        still approximated by a nearby point. Returns the number of points appended (at most five).
+static int _FindCriticalPointCandidates(const dReal* c, int n, dReal* roots)
+{
+    while( n > 0 && c[n] == 0 ) {
+        --n;
+    }
+    if( n == 1 ) {
+        roots[0] = -c[0]/c[1];
+        return 1;
+    }
+    if( n == 2 ) {
+        // Same formula as Polynomial::_FindAllLocalExtrema
+        const dReal a = c[2], b = c[1], cc = c[0];
+        const dReal det = b*b - 4*a*cc;
+        const dReal tol = 64.0*std::numeric_limits<dReal>::epsilon();
+        if( det < -tol ) {
+            return 0;
+        }
+        if( det <= tol ) {
+            roots[0] = -0.5*b/a;
+            return 1;
+        }
+        const dReal temp = b >= 0 ? -0.5*(b + Sqrt(det)) : -0.5*(b - Sqrt(det));
+        roots[0] = temp/a;
+        roots[1] = cc/temp;
+        return 2;
+    }
+    if( n == 3 ) {
+        // Normalize to t^3 + B*t^2 + C*t + D and substitute t = y - B/3 to get y^3 + P*y + Q.
+        const dReal B = c[2]/c[3], C = c[1]/c[3], D = c[0]/c[3];
+        const dReal shift = B/3;
+        const dReal P = C - B*shift;
+        const dReal Q = (2*B*B*B)/27 - B*C/3 + D;
+        const dReal disc = 0.25*Q*Q + P*P*P/27;
+        int numroots = 0;
+        if( disc > 0 ) {
+            const dReal sqrtdisc = Sqrt(disc);
+            roots[numroots++] = std::cbrt(-0.5*Q + sqrtdisc) + std::cbrt(-0.5*Q - sqrtdisc) - shift;
+        }
+        else if( P == 0 ) {
+            roots[numroots++] = -shift;
+        }
+        else {
+            const dReal r = Sqrt(-P/3);
+            dReal cosarg = (1.5*Q/P)*Sqrt(-3/P);
+            cosarg = cosarg > 1 ? 1 : (cosarg < -1 ? -1 : cosarg);
+            const dReal phi = std::acos(cosarg)/3;
+            for( int k = 0; k < 3; ++k ) {
+                roots[numroots++] = 2*r*std::cos(phi - 2*M_PI*k/3) - shift;
+            }
+        }
+        // One Newton step to polish the roots
+        for( int iroot = 0; iroot < numroots; ++iroot ) {
+            const dReal t = roots[iroot];
+            const dReal f = ((t + B)*t + C)*t + D;
+            const dReal df = (3*t + 2*B)*t + C;
+            if( df != 0 ) {
+                roots[iroot] = t - f/df;
+            }
+        }
+        // Roots of the derivative 3*c3*t^2 + 2*c2*t + c1
+        const dReal dc[3] = {c[1], 2*c[2], 3*c[3]};
+        numroots += _FindCriticalPointCandidates(dc, 2, roots + numroots);
+        return numroots;
+    }
+    return 0;
+}
+
 PolynomialChecker::PolynomialChecker(size_t ndof_, int envid_) : ndof(ndof_), envid(envid_)
 {
     _cacheCoordsVect.reserve(4); // quintic polynomial has at most 4 extrema
@@ -268,6 +338,121 @@ PolynomialCheckReturn PolynomialChecker::CheckPolynomialLimits(const Polynomial&
     return PCR_Normal;
 }
 
+bool PolynomialChecker::_CheckChunkLimitsClosedForm(const Chunk& c, const std::vector<dReal>& xminVect, const std::vector<dReal>& xmaxVect,
+                                                    const std::vector<dReal>& vmVect, const std::vector<dReal>& amVect, const std::vector<dReal>& jmVect)
+{
+    const size_t numcoeffs = 6; // up to quintic polynomials
+    if( c.vpolynomials.size() != ndof ) {
+        return false;
+    }
+    for( size_t idof = 0; idof < ndof; ++idof ) {
+        if( c.vpolynomials[idof].degree >= numcoeffs || c.vpolynomials[idof].vcoeffs.size() > numcoeffs ) {
+            return false;
+        }
+    }
+
+    // Gather the coefficients and limits so that the boundary checks below run over contiguous arrays of all dofs.
+    std::vector<dReal>& vcoeffs = _cacheBatchCoeffsVect;
+    std::vector<dReal>& vlimits = _cacheBatchLimitsVect;
+    vcoeffs.resize(numcoeffs*ndof + ndof); // the last ndof values are the durations
+    vlimits.resize(5*ndof);
+    std::fill(vcoeffs.begin(), vcoeffs.end(), 0);
+    const bool bHasVelocityLimits = vmVect.size() == ndof;
+    const bool bHasAccelerationLimits = amVect.size() == ndof;
+    const bool bHasJerkLimits = jmVect.size() == ndof;
+    for( size_t idof = 0; idof < ndof; ++idof ) {
+        const Polynomial& p = c.vpolynomials[idof];
+        for( size_t icoeff = 0; icoeff < p.vcoeffs.size(); ++icoeff ) {
+            vcoeffs[icoeff*ndof + idof] = p.vcoeffs[icoeff];
+        }
+        vcoeffs[numcoeffs*ndof + idof] = p.duration;
+        // A limit that is not checked becomes infinite
+        vlimits[idof] = xminVect[idof] - g_fPolynomialEpsilon;
+        vlimits[ndof + idof] = xmaxVect[idof] + g_fPolynomialEpsilon;
+        vlimits[2*ndof + idof] = (bHasVelocityLimits && vmVect[idof] > g_fPolynomialEpsilon) ? vmVect[idof] + g_fPolynomialEpsilon : g_fPolynomialInf;
+        vlimits[3*ndof + idof] = (bHasAccelerationLimits && amVect[idof] > g_fPolynomialEpsilon) ? amVect[idof] + g_fPolynomialEpsilon : g_fPolynomialInf;
+        vlimits[4*ndof + idof] = (bHasJerkLimits && jmVect[idof] > g_fPolynomialEpsilon) ? jmVect[idof] + epsilonForJerkLimitsChecking : g_fPolynomialInf;
+    }
+
+    // Boundary values of all dofs. The loop has no branches so that it can be vectorized.
+    const dReal* c0 = &vcoeffs[0];
+    const dReal* c1 = c0 + ndof;
+    const dReal* c2 = c1 + ndof;
+    const dReal* c3 = c2 + ndof;
+    const dReal* c4 = c3 + ndof;
+    const dReal* c5 = c4 + ndof;
+    const dReal* pT = c5 + ndof;
+    const dReal* pxmin = &vlimits[0];
+    const dReal* pxmax = pxmin + ndof;
+    const dReal* pvm = pxmax + ndof;
+    const dReal* pam = pvm + ndof;
+    const dReal* pjm = pam + ndof;
+    int nviolations = 0;
+    for( size_t idof = 0; idof < ndof; ++idof ) {
+        const dReal T = pT[idof];
+        const dReal x0 = c0[idof], v0 = c1[idof], a0 = 2*c2[idof], j0 = 6*c3[idof];
+        const dReal x1 = c0[idof] + T*(c1[idof] + T*(c2[idof] + T*(c3[idof] + T*(c4[idof] + T*c5[idof]))));
+        const dReal v1 = c1[idof] + T*(2*c2[idof] + T*(3*c3[idof] + T*(4*c4[idof] + T*5*c5[idof])));
+        const dReal a1 = 2*c2[idof] + T*(6*c3[idof] + T*(12*c4[idof] + T*20*c5[idof]));
+        const dReal j1 = 6*c3[idof] + T*(24*c4[idof] + T*60*c5[idof]);
+        nviolations += (x0 > pxmax[idof]) | (x0 < pxmin[idof]) | (x1 > pxmax[idof]) | (x1 < pxmin[idof])
+                       | (RaveFabs(v0) > pvm[idof]) | (RaveFabs(v1) > pvm[idof])
+                       | (RaveFabs(a0) > pam[idof]) | (RaveFabs(a1) > pam[idof])
+                       | (RaveFabs(j0) > pjm[idof]) | (RaveFabs(j1) > pjm[idof]);
+    }
+    if( nviolations > 0 ) {
+        return false;
+    }
+
+    // Interior extrema. The critical points of the k-th derivative are the roots of the (k+1)-th derivative, which has degree at most three.
+    dReal dcoeffs[numcoeffs], ddcoeffs[numcoeffs], candidates[5];
+    for( size_t idof = 0; idof < ndof; ++idof ) {
+        const Polynomial& p = c.vpolynomials[idof];
+        const dReal T = pT[idof];
+        // Position extrema are cached in the polynomial
+        for( std::vector<Coordinate>::const_iterator it = p.GetExtrema().begin(); it != p.GetExtrema().end(); ++it ) {
+            if( it->point >= -g_fPolynomialEpsilon && it->point <= T + g_fPolynomialEpsilon ) {
+                if( it->value > pxmax[idof] || it->value < pxmin[idof] ) {
+                    return false;
+                }
+            }
+        }
+
+        for( size_t ideriv = 1; ideriv <= 3; ++ideriv ) {
+            const dReal limit = vlimits[(ideriv + 1)*ndof + idof];
+            if( limit >= g_fPolynomialInf || p.degree <= ideriv ) {
+                continue;
+            }
+            // dcoeffs holds the ideriv-th derivative, ddcoeffs the next one
+            const int nddegree = (int)p.degree - (int)ideriv - 1;
+            for( int i = 0; i <= nddegree + 1; ++i ) {
+                dReal f = vcoeffs[(i + ideriv)*ndof + idof];
+                for( size_t k = 1; k <= ideriv; ++k ) {
+                    f *= (dReal)(i + k);
+                }
+                dcoeffs[i] = f;
+            }
+            for( int i = 0; i <= nddegree; ++i ) {
+                ddcoeffs[i] = dcoeffs[i + 1]*(i + 1);
+            }
+            const int numcandidates = _FindCriticalPointCandidates(ddcoeffs, nddegree, candidates);
+            for( int icandidate = 0; icandidate < numcandidates; ++icandidate ) {
+                const dReal t = candidates[icandidate];
+                if( t >= -g_fPolynomialEpsilon && t <= T + g_fPolynomialEpsilon ) {
+                    dReal val = dcoeffs[nddegree + 1];
+                    for( int i = nddegree; i >= 0; --i ) {
+                        val = val*t + dcoeffs[i];
+                    }
+                    if( RaveFabs(val) > limit ) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
 PolynomialCheckReturn PolynomialChecker::CheckPiecewisePolynomial(const PiecewisePolynomial& p, const dReal xmin, const dReal xmax, const dReal vm, const dReal am, const dReal jm,
                                                                   const dReal x0, const dReal x1, const dReal v0, const dReal v1, const dReal a0, const dReal a1)
 {
@@ -346,6 +531,8 @@ PolynomialCheckReturn PolynomialChecker::CheckChunk(const Chunk& c, const std::v
     bool bHasVelocityLimits = vmVect.size() == ndof;
     bool bHasAccelerationLimits = amVect.size() == ndof;
     bool bHasJerkLimits = jmVect.size() == ndof;
+    // When all the limits are satisfied, only the boundary values are left to check for each dof
+    const bool bLimitsChecked = _CheckChunkLimitsClosedForm(c, xminVect, xmaxVect, vmVect, amVect, jmVect);
     PolynomialCheckReturn ret;
     for( size_t idof = 0; idof < ndof; ++idof ) {
         if( bHasVelocityLimits ) {
@@ -367,8 +554,16 @@ PolynomialCheckReturn PolynomialChecker::CheckChunk(const Chunk& c, const std::v
 #endif
             return PCR_DurationDiscrepancy;
         }
-        ret = CheckPolynomial(c.vpolynomials[idof], xminVect[idof], xmaxVect[idof], vm, am, jm,
-                              x0Vect[idof], x1Vect[idof], v0Vect[idof], v1Vect[idof], a0Vect[idof], a1Vect[idof]);
+        if( bLimitsChecked ) {
+            ret = CheckPolynomialValues(c.vpolynomials[idof], 0, x0Vect[idof], v0Vect[idof], a0Vect[idof]);
+            if( ret == PCR_Normal ) {
+                ret = CheckPolynomialValues(c.vpolynomials[idof], c.vpolynomials[idof].duration, x1Vect[idof], v1Vect[idof], a1Vect[idof]);
+            }
+        }
+        else {
+            ret = CheckPolynomial(c.vpolynomials[idof], xminVect[idof], xmaxVect[idof], vm, am, jm,
+                                  x0Vect[idof], x1Vect[idof], v0Vect[idof], v1Vect[idof], a0Vect[idof], a1Vect[idof]);
+        }
         if( ret != PCR_Normal ) {
 #ifdef JERK_LIMITED_POLY_CHECKER_DEBUG
             _failedDOF = idof;
@@ -399,6 +594,10 @@ PolynomialCheckReturn PolynomialChecker::CheckChunkValues(const Chunk& c, dReal
 PolynomialCheckReturn PolynomialChecker::CheckChunkLimits(const Chunk& c, const std::vector<dReal>& xminVect, const std::vector<dReal>& xmaxVect,
                                                           const std::vector<dReal>& vmVect, const std::vector<dReal>& amVect, const std::vector<dReal>& jmVect)
 {
+    if( _CheckChunkLimitsClosedForm(c, xminVect, xmaxVect, vmVect, amVect, jmVect) ) {
+        return PCR_Normal;
+    }
+    // Find which dof violates which limit
     PolynomialCheckReturn ret = PCR_Normal;
     for( size_t idof = 0; idof < ndof; ++idof ) {
         ret = CheckPolynomialLimits(c.vpolynomials[idof], xminVect[idof], xmaxVect[idof], vmVect[idof], amVect[idof], jmVect[idof]);
@@ -463,6 +662,7 @@ PolynomialCheckReturn PolynomialChecker::CheckChunks(const std::vector<Chunk>& v
         if( itchunk != vchunks.begin() ) {
             bCheckValues = true;
         }
+        const bool bLimitsChecked = _CheckChunkLimitsClosedForm(*itchunk, xminVect, xmaxVect, vmVect, amVect, jmVect);
 
         for( size_t idof = 0; idof < ndof; ++idof ) {
             if( bHasVelocityLimits ) {
@@ -501,6 +701,9 @@ PolynomialCheckReturn PolynomialChecker::CheckChunks(const std::vector<Chunk>& v
             }
 
             // Check polynomial limits
+            if( bLimitsChecked ) {
+                continue;
+            }
             ret = CheckPolynomialLimits(itchunk->vpolynomials[idof], xminVect[idof], xmaxVect[idof], vm, am, jm);
             if( ret != PCR_Normal ) {
 #ifdef JERK_LIMITED_POLY_CHECKER_DEBUG
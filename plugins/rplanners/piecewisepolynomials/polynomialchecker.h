@@ -147,6 +147,8 @@ public:
 
     std::vector<Coordinate> _cacheCoordsVect;
     std::vector<dReal> _cacheXVect, _cacheVVect, _cacheAVect;
+    std::vector<dReal> _cacheBatchCoeffsVect; ///< coefficients of all the dofs of a chunk, stored coefficient-major for _CheckChunkLimitsClosedForm
+    std::vector<dReal> _cacheBatchLimitsVect; ///< xmin, xmax, vm, am, jm of all the dofs including the tolerances, stored limit-major
 
 #ifdef JERK_LIMITED_POLY_CHECKER_DEBUG
     dReal _failedPoint;
@@ -157,6 +159,15 @@ public:
 #endif
 
 private:
+    /// \brief Check the limits of all the dofs of a chunk at once. The boundary values of all the dofs are evaluated
+    ///        together and the interior extrema of the derivatives are found with closed-form roots, stopping at the
+    ///        first possible violation.
+    ///
+    /// \return true if the chunk respects all the limits. false if a limit may be violated or if the chunk has
+    ///         polynomials of degree larger than five, in which case the per-dof checks have to be run to get the result.
+    bool _CheckChunkLimitsClosedForm(const Chunk& c, const std::vector<dReal>& xminVect, const std::vector<dReal>& xmaxVect,
+                                     const std::vector<dReal>& vmVect, const std::vector<dReal>& amVect, const std::vector<dReal>& jmVect);
+
     // Specific tolerance for checking discrepancies.
     dReal epsilonForPositionDiscrepancyChecking = g_fPolynomialEpsilon;
     dReal epsilonForVelocityDiscrepancyChecking = g_fPolynomialEpsilon;
@@ -1065,6 +1065,12 @@ void PiecewisePolynomialTrajectory::Deserialize(std::istream& I)
 }
 
 void PiecewisePolynomialTrajectory::ReplaceSegment(dReal t0, dReal t1, const std::vector<Chunk>& vchunks_)
+{
+    Chunk tempChunk;
+    ReplaceSegment(t0, t1, vchunks_, tempChunk);
+}
+
+void PiecewisePolynomialTrajectory::ReplaceSegment(dReal t0, dReal t1, const std::vector<Chunk>& vchunks_, Chunk& tempChunk)
 {
     OPENRAVE_ASSERT_OP(t0, <=, t1);
     size_t index0, index1;
@@ -1072,14 +1078,12 @@ void PiecewisePolynomialTrajectory::ReplaceSegment(dReal t0, dReal t1, const std
     this->FindChunkIndex(t0, index0, rem0);
     this->FindChunkIndex(t1, index1, rem1);
     if( index0 == index1 ) {
-        Chunk tempChunk;
         this->vchunks[index0].Cut(rem1, tempChunk); // now tempChunk stores the portion from rem1 to duration
         this->vchunks.insert(this->vchunks.begin() + index0 + 1, tempChunk); // tempChunk is copied into the traj
         this->vchunks[index0].Cut(rem0, tempChunk); // now chunk index0 stores the portion from 0 to rem0
         this->vchunks.insert(this->vchunks.begin() + index0 + 1, vchunks_.begin(), vchunks_.end()); // insert vchunks after index0
     }
     else {
-        Chunk tempChunk;
         // Manage chunk index1
         this->vchunks[index1].Cut(rem1, tempChunk);
         this->vchunks[index1] = tempChunk; // replace chunk index1 by the portion from rem1 to duration
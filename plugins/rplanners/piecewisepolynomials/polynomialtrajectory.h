@@ -386,6 +386,10 @@ public:
     ///        This function does not check continuity at the junctions.
     void ReplaceSegment(dReal t0, dReal t1, const std::vector<Chunk>& vchunks);
 
+    /// \brief Same as ReplaceSegment but uses tempChunk as scratch space so that callers replacing segments repeatedly
+    ///        can keep its capacity.
+    void ReplaceSegment(dReal t0, dReal t1, const std::vector<Chunk>& vchunks, Chunk& tempChunk);
+
     /// \brief Reset the trajectory data.
     inline void Reset()
     {
@@ -45,6 +45,7 @@ public:
 
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
     {
+        OPENRAVE_TRACE_SCOPE("QuinticTrajectoryRetimer::PlanPath");
         _pinterpolator.reset(new PiecewisePolynomials::QuinticInterpolator(_parameters->GetDOF(), GetEnv()->GetId()));
         _ptranslationInterpolator.reset(new PiecewisePolynomials::QuinticInterpolator(3, GetEnv()->GetId()));
         // TODO: _pikInterpolator
@@ -36,14 +36,21 @@ public:
 
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
     {
+        OPENRAVE_TRACE_SCOPE("QuinticSmoother::PlanPath");
         uint32_t startTime = utils::GetMilliTime();
+        _basetime = startTime;
 
         BOOST_ASSERT(!!_parameters && !!ptraj);
+        PlannerProfile::StageTimer profiletimer(_parameters->_profile.get(), PlannerProfile::PPS_Smoothing);
         if( ptraj->GetNumWaypoints() < 2 ) {
             RAVELOG_WARN_FORMAT("env=%d, Input traj has %d waypoints.", _envId%ptraj->GetNumWaypoints());
             return PS_Failed;
         }
 
+        if( _shortcutWorkers.IsInitialized() && _parameters->_nMaxIterations > 0 ) {
+            return _PlanPathWithShortcutWorkers(ptraj, planningoptions);
+        }
+
         // Sample _fileIndex
         if( !!_loggingUniformSampler ) {
             _fileIndex = _loggingUniformSampler->SampleSequenceOneUInt32()%_fileIndexMod;
@@ -398,12 +405,18 @@ public:
         const dReal tOriginal = pwptraj.duration;
         dReal tTotal = tOriginal;
         int iter = 0;
+        bool bShortcutTimeExceeded = false;
         for(; iter < numIters; ++iter ) {
             if( tTotal < minTimeStep ) {
                 RAVELOG_DEBUG_FORMAT("env=%d, shortcut iter=%d/%d, tTotal=%.15e is too shortcut to continue (minTimeStep=%.15e)", _envId%iter%numIters%tTotal%minTimeStep);
                 break;
             }
 
+            if( IsPlanningTimeExceeded(*_parameters, _basetime) ) {
+                bShortcutTimeExceeded = true;
+                break;
+            }
+
             if( nItersFromPrevSuccessful + nTimeBasedConstraintsFailed > nCutoffIters ) {
                 break;
             }
@@ -648,7 +661,7 @@ public:
                     pwptraj.Initialize(vChunksOut);
                 }
                 else {
-                    pwptraj.ReplaceSegment(t0, t1, vChunksOut);
+                    pwptraj.ReplaceSegment(t0, t1, vChunksOut, _cacheReplaceChunk);
                 }
                 // RAVELOG_DEBUG_FORMAT("env=%d, fSegmentTime=%f; fDiff=%f; prevduration=%f; newduration=%f", _envId%fSegmentTime%fDiff%tTotal%pwptraj.duration);
                 tTotal = pwptraj.duration;
@@ -676,7 +689,10 @@ public:
         // Report statistics
         std::stringstream ss;
         ss << std::setprecision(std::numeric_limits<dReal>::digits10 + 1);
-        if( fScore/fCurrentBestScore < fCutoffRatio ) {
+        if( bShortcutTimeExceeded ) {
+            ss << "planning time exceeded (" << (utils::GetMilliTime() - _basetime) << "ms >= " << _parameters->_nMaxPlanningTime << "ms)";
+        }
+        else if( fScore/fCurrentBestScore < fCutoffRatio ) {
             ss << "current score falls below threshold (" << fScore/fCurrentBestScore << " < " << fCutoffRatio << ")";
         }
         else if( nItersFromPrevSuccessful + nTimeBasedConstraintsFailed > nCutoffIters ) {
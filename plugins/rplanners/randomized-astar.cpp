@@ -346,6 +346,7 @@ Rosen Diankov, James Kuffner. \"Randomized Statistical Path Planning. Intl. Conf
 
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
     {
+        OPENRAVE_TRACE_SCOPE("RandomizedAStarPlanner::PlanPath");
         if( !_parameters ) {
             return PlannerStatus("parameters are not set", PS_Failed);
         }
@@ -22,9 +22,13 @@
 OpenRAVE::PlannerBasePtr CreateShortcutLinearPlanner(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
 //OpenRAVE::PlannerBasePtr CreateGraspGradientPlanner(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
 OpenRAVE::PlannerBasePtr CreateRandomizedAStarPlanner(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
+OpenRAVE::PlannerBasePtr CreateLatticePlanner(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
 OpenRAVE::PlannerBasePtr CreateWorkspaceTrajectoryTracker(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
 OpenRAVE::PlannerBasePtr CreateLinearSmoother(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
 OpenRAVE::PlannerBasePtr CreateConstraintParabolicSmoother(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
+OpenRAVE::PlannerBasePtr CreateParallelBirrtPlanner(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
+OpenRAVE::PlannerBasePtr CreatePathLibraryPlanner(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
+OpenRAVE::PlannerBasePtr CreateLazyPRMPlanner(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
 
 namespace rplanners {
 OpenRAVE::PlannerBasePtr CreateParabolicSmoother(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
@@ -37,6 +41,7 @@ OpenRAVE::PlannerBasePtr CreateCubicTrajectoryRetimer2(OpenRAVE::EnvironmentBase
 OpenRAVE::PlannerBasePtr CreateCubicSmoother(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
 OpenRAVE::PlannerBasePtr CreateQuinticSmoother(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
 OpenRAVE::PlannerBasePtr CreateQuinticTrajectoryRetimer(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
+OpenRAVE::PlannerBasePtr CreateToppraTrajectoryRetimer(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput);
 }
 
 const std::string RPlannersPlugin::_pluginname = "RPlannersPlugin";
@@ -44,7 +49,11 @@ const std::string RPlannersPlugin::_pluginname = "RPlannersPlugin";
 RPlannersPlugin::RPlannersPlugin()
 {
     _interfaces[PT_Planner].push_back("RAStar");
+    _interfaces[PT_Planner].push_back("LatticePlanner");
     _interfaces[PT_Planner].push_back("BiRRT");
+    _interfaces[PT_Planner].push_back("ParallelBiRRT");
+    _interfaces[PT_Planner].push_back("PathLibraryPlanner");
+    _interfaces[PT_Planner].push_back("LazyPRM");
     _interfaces[PT_Planner].push_back("BasicRRT");
     _interfaces[PT_Planner].push_back("ExplorationRRT");
     _interfaces[PT_Planner].push_back("GraspGradient");
@@ -62,6 +71,7 @@ RPlannersPlugin::RPlannersPlugin()
     _interfaces[PT_Planner].push_back("CubicSmoother");
     _interfaces[PT_Planner].push_back("QuinticSmoother");
     _interfaces[PT_Planner].push_back("QuinticTrajectoryRetimer");
+    _interfaces[PT_Planner].push_back("ToppraTrajectoryRetimer");
 }
 
 RPlannersPlugin::~RPlannersPlugin() {}
@@ -73,9 +83,21 @@ OpenRAVE::InterfaceBasePtr RPlannersPlugin::CreateInterface(OpenRAVE::InterfaceT
         if( interfacename == "rastar" || interfacename == "ra*" ) {
             return CreateRandomizedAStarPlanner(penv,sinput);
         }
+        else if( interfacename == "latticeplanner" ) {
+            return CreateLatticePlanner(penv,sinput);
+        }
         else if( interfacename == "birrt") {
             return boost::make_shared<BirrtPlanner>(penv);
         }
+        else if( interfacename == "parallelbirrt") {
+            return CreateParallelBirrtPlanner(penv,sinput);
+        }
+        else if( interfacename == "pathlibraryplanner") {
+            return CreatePathLibraryPlanner(penv,sinput);
+        }
+        else if( interfacename == "lazyprm") {
+            return CreateLazyPRMPlanner(penv,sinput);
+        }
         else if( interfacename == "rbirrt") {
             RAVELOG_WARN("rBiRRT is deprecated, use BiRRT\n");
             return boost::make_shared<BirrtPlanner>(penv);
@@ -131,6 +153,9 @@ OpenRAVE::InterfaceBasePtr RPlannersPlugin::CreateInterface(OpenRAVE::InterfaceT
         else if( interfacename == "quintictrajectoryretimer" ) {
             return rplanners::CreateQuinticTrajectoryRetimer(penv, sinput);
         }
+        else if( interfacename == "toppratrajectoryretimer" ) {
+            return rplanners::CreateToppraTrajectoryRetimer(penv, sinput);
+        }
         break;
     default:
         break;
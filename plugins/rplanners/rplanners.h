@@ -19,7 +19,10 @@
 
 #include "openraveplugindefs.h"
 
-#include <boost/pool/pool.hpp>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
 
 #define _(msgid) OpenRAVE::RaveGetLocalizedTextForDomain("openrave_plugins_rplanners", msgid)
 
@@ -29,6 +32,294 @@ enum ExtendType {
     ET_Connected=2
 };
 
+/// \brief calls one of the sample functions of the planner parameters and adds its time to the stage of profile, if set
+inline bool CallProfiledSampleFn(const PlannerParameters::SampleFn& samplefn, std::vector<dReal>& vsample, const PlannerProfilePtr& profile, PlannerProfile::ProfileStage stage)
+{
+    PlannerProfile::StageTimer timer(profile.get(), stage);
+    return samplefn(vsample);
+}
+
+/// \brief returns true if the _nMaxPlanningTime of parameters is set and has elapsed since basetime, the utils::GetMilliTime at the beginning of PlanPath.
+///
+/// Checked by the smoothers between shortcut iterations. Since a shortcut is only applied once it is feasible, the path is always valid when breaking out.
+inline bool IsPlanningTimeExceeded(const PlannerParameters& parameters, uint32_t basetime)
+{
+    return parameters._nMaxPlanningTime > 0 && utils::GetMilliTime() - basetime >= parameters._nMaxPlanningTime;
+}
+
+/// \brief initializes params as a copy of parameters for a worker planning in the cloned environment penv
+///
+/// SetConfigurationSpecification resets the configuration data from the robot of penv, so the initial configuration and the limits are restored afterwards. Worker iworker uses the seed of parameters offset by 7919*iworker, so the first worker gives the same result as the serial planner. Profiles are not thread safe, so the worker gets its own profile if parameters has one. Post-processing is cleared since the caller processes the merged result.
+inline void InitParallelWorkerParameters(PlannerParametersPtr params, PlannerParametersConstPtr parameters, EnvironmentBasePtr penv, int iworker)
+{
+    params->copy(parameters);
+    params->SetConfigurationSpecification(penv, parameters->_configurationspecification);
+    params->vinitialconfig = parameters->vinitialconfig;
+    params->_vConfigLowerLimit = parameters->_vConfigLowerLimit;
+    params->_vConfigUpperLimit = parameters->_vConfigUpperLimit;
+    params->_vConfigVelocityLimit = parameters->_vConfigVelocityLimit;
+    params->_vConfigAccelerationLimit = parameters->_vConfigAccelerationLimit;
+    params->_vConfigJerkLimit = parameters->_vConfigJerkLimit;
+    params->_vConfigResolution = parameters->_vConfigResolution;
+    params->_nRandomGeneratorSeed = parameters->_nRandomGeneratorSeed + 7919*iworker;
+    params->_profile.reset();
+    if( !!parameters->_profile ) {
+        params->_profile.reset(new PlannerProfile());
+    }
+    params->_sPostProcessingPlanner = "";
+    params->_sPostProcessingParameters = "";
+}
+
+/// \brief runs the workers of a parallel planner on their own threads and joins them on every exit path
+///
+/// If the threads were not joined with Join, the destructor sets the cancel flag polled by the worker callbacks and joins them, since destroying a joinable std::thread terminates the process.
+class ParallelPlannerWorkerThreads
+{
+public:
+    typedef boost::function<PlannerStatus()> WorkerFn;
+    typedef boost::function<void(const PlannerStatus&)> FinishFn;
+
+    ParallelPlannerWorkerThreads(const std::string& envnameid, std::atomic<bool>& bCancel) : _envnameid(envnameid), _bCancel(bCancel), _numfinished(0) {
+    }
+    ~ParallelPlannerWorkerThreads() {
+        if( _vthreads.size() > 0 ) {
+            _bCancel = true;
+            Join();
+        }
+    }
+
+    /// \brief starts workerfn on a new thread and calls finishfn with its status on the same thread
+    ///
+    /// Any exception thrown by workerfn is converted into a failed status.
+    void Run(int iworker, const WorkerFn& workerfn, const FinishFn& finishfn)
+    {
+        _vthreads.emplace_back([this, iworker, workerfn, finishfn]() {
+            PlannerStatus status;
+            try {
+                status = workerfn();
+            }
+            catch(const std::exception& ex) {
+                status = PlannerStatus(str(boost::format("env=%s, worker %d threw an exception: %s")%_envnameid%iworker%ex.what()), PS_Failed);
+            }
+            catch(...) {
+                status = PlannerStatus(str(boost::format("env=%s, worker %d threw an unknown exception")%_envnameid%iworker), PS_Failed);
+            }
+            try {
+                finishfn(status);
+            }
+            catch(const std::exception& ex) {
+                RAVELOG_WARN_FORMAT("env=%s, failed to finish worker %d: %s", _envnameid%iworker%ex.what());
+            }
+            _numfinished++;
+        });
+    }
+
+    void Join()
+    {
+        FOREACH(itthread, _vthreads) {
+            if( itthread->joinable() ) {
+                itthread->join();
+            }
+        }
+        _vthreads.clear();
+    }
+
+    inline int GetNumStarted() const {
+        return (int)_vthreads.size();
+    }
+
+    inline int GetNumFinished() const {
+        return _numfinished;
+    }
+
+private:
+    std::string _envnameid;
+    std::atomic<bool>& _bCancel;
+    std::atomic<int> _numfinished;
+    std::vector<std::thread> _vthreads;
+};
+
+/// \brief runs several smoothers with different seeds on clones of the environment and keeps the result with the shortest duration
+class ParallelShortcutWorkers
+{
+public:
+    ParallelShortcutWorkers() : _bCancel(false) {
+    }
+
+    /// \brief creates or re-clones the environments of the workers and initializes their smoothers, clears the workers if nworkers <= 1 or none could be initialized.
+    ///
+    /// The state and constraint functions of the worker parameters are rebuilt from the configuration specification, so custom functions set on the parameters are not used by the workers.
+    /// \param plannername the name of the smoother to create for every worker
+    void Init(EnvironmentBasePtr penv, const std::string& plannername, int nworkers, ConstraintTrajectoryTimingParametersConstPtr parameters)
+    {
+        if( nworkers <= 1 ) {
+            _vworkers.clear();
+            return;
+        }
+
+        _envnameid = penv->GetNameId();
+        if( (int)_vworkers.size() != nworkers || _plannername != plannername ) {
+            _vworkers.clear();
+            _plannername = plannername;
+            for(int iworker = 0; iworker < nworkers; ++iworker) {
+                WorkerPtr worker(new Worker());
+                worker->penv = penv->CloneSelf(str(boost::format("%s_shortcutworker%d")%penv->GetName()%iworker), Clone_Bodies);
+                worker->penv->StopSimulation();
+                worker->planner = RaveCreatePlanner(worker->penv, plannername);
+                if( !worker->planner ) {
+                    RAVELOG_WARN_FORMAT("env=%s, failed to create shortcut worker planner %s, so shortcutting serially", _envnameid%plannername);
+                    _vworkers.clear();
+                    return;
+                }
+                worker->callbackhandle = worker->planner->RegisterPlanCallback(boost::bind(&ParallelShortcutWorkers::_WorkerCallback,this,_1));
+                _vworkers.push_back(worker);
+            }
+        }
+        else {
+            FOREACH(itworker, _vworkers) {
+                (*itworker)->penv->Clone(penv, Clone_Bodies);
+            }
+        }
+
+        int numinitialized = 0;
+        for(size_t iworker = 0; iworker < _vworkers.size(); ++iworker) {
+            Worker& worker = *_vworkers[iworker];
+            worker.bInitialized = false;
+            try {
+                worker.parameters.reset(new ConstraintTrajectoryTimingParameters());
+                InitParallelWorkerParameters(worker.parameters, parameters, worker.penv, iworker);
+                worker.bInitialized = !!(worker.planner->InitPlan(RobotBasePtr(), worker.parameters).GetStatusCode() & PS_HasSolution);
+            }
+            catch(const std::exception& ex) {
+                RAVELOG_WARN_FORMAT("env=%s, failed to initialize shortcut worker %d: %s", _envnameid%iworker%ex.what());
+            }
+            if( worker.bInitialized ) {
+                ++numinitialized;
+            }
+        }
+        if( numinitialized == 0 ) {
+            RAVELOG_WARN_FORMAT("env=%s, no shortcut worker could be initialized, so shortcutting serially", _envnameid);
+            _vworkers.clear();
+        }
+    }
+
+    /// \brief true if PlanPath can be used
+    inline bool IsInitialized() const {
+        return _vworkers.size() > 0;
+    }
+
+    /// \brief smoothes ptraj with every worker in parallel and replaces it with the result of the shortest duration
+    ///
+    /// \param callbackfn called by the calling thread while the workers are running, the workers are interrupted if it returns PA_Interrupt
+    /// \param profile if not empty, the profiles of the workers are added to it
+    PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions, const boost::function<PlannerAction(const PlannerProgress&)>& callbackfn, PlannerProfilePtr profile)
+    {
+        uint64_t basetimeus = utils::GetMonotonicTime();
+        std::vector<dReal> vdata;
+        ptraj->GetWaypoints(0, ptraj->GetNumWaypoints(), vdata);
+
+        _bCancel = false;
+        {
+            ParallelPlannerWorkerThreads threads(_envnameid, _bCancel);
+            for(size_t iworker = 0; iworker < _vworkers.size(); ++iworker) {
+                WorkerPtr worker = _vworkers[iworker];
+                if( !worker->bInitialized ) {
+                    continue;
+                }
+                worker->status = PlannerStatus(PS_Failed);
+                worker->ptraj = RaveCreateTrajectory(worker->penv, ptraj->GetXMLId());
+                worker->ptraj->Init(ptraj->GetConfigurationSpecification());
+                worker->ptraj->Insert(0, vdata);
+                threads.Run(iworker, [worker, planningoptions]() {
+                    EnvironmentLock lock(worker->penv->GetMutex());
+                    return worker->planner->PlanPath(worker->ptraj, planningoptions);
+                }, [worker](const PlannerStatus& status) {
+                    worker->status = status;
+                });
+            }
+
+            PlannerProgress progress;
+            while( threads.GetNumFinished() < threads.GetNumStarted() ) {
+                if( callbackfn(progress) == PA_Interrupt ) {
+                    _bCancel = true;
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                ++progress._iteration;
+            }
+            threads.Join();
+        }
+        if( !!profile ) {
+            FOREACHC(itworker, _vworkers) {
+                if( (*itworker)->bInitialized && !!(*itworker)->parameters->_profile ) {
+                    profile->Add(*(*itworker)->parameters->_profile);
+                    (*itworker)->parameters->_profile->Reset();
+                }
+            }
+        }
+        if( _bCancel ) {
+            return OPENRAVE_PLANNER_STATUS(str(boost::format("env=%s, Planning was interrupted")%_envnameid), PS_Interrupted);
+        }
+
+        int nbestworker = -1;
+        int numstarted = 0;
+        dReal fBestDuration = 0;
+        PlannerStatus failedstatus(PS_Failed);
+        for(size_t iworker = 0; iworker < _vworkers.size(); ++iworker) {
+            const Worker& worker = *_vworkers[iworker];
+            if( !worker.bInitialized ) {
+                continue;
+            }
+            ++numstarted;
+            if( !(worker.status.GetStatusCode() & PS_HasSolution) ) {
+                failedstatus = worker.status;
+                continue;
+            }
+            if( nbestworker < 0 || worker.ptraj->GetDuration() < fBestDuration ) {
+                nbestworker = iworker;
+                fBestDuration = worker.ptraj->GetDuration();
+            }
+        }
+        if( nbestworker < 0 ) {
+            RAVELOG_WARN_FORMAT("env=%s, all %d shortcut workers failed: %s", _envnameid%numstarted%failedstatus.description);
+            return failedstatus;
+        }
+
+        const Worker& bestworker = *_vworkers.at(nbestworker);
+        bestworker.ptraj->GetWaypoints(0, bestworker.ptraj->GetNumWaypoints(), vdata);
+        ptraj->Init(bestworker.ptraj->GetConfigurationSpecification());
+        ptraj->Insert(0, vdata);
+        RAVELOG_DEBUG_FORMAT("env=%s, kept result of shortcut worker %d/%d, duration=%.15e, computation time=%u[us]", _envnameid%nbestworker%numstarted%fBestDuration%(utils::GetMonotonicTime() - basetimeus));
+        return PlannerStatus(PS_HasSolution);
+    }
+
+private:
+    PlannerAction _WorkerCallback(const PlannerProgress& progress)
+    {
+        return _bCancel ? PA_Interrupt : PA_None;
+    }
+
+    /// \brief an independent smoother running in a clone of the environment
+    struct Worker
+    {
+        Worker() : bInitialized(false) {
+        }
+        EnvironmentBasePtr penv;
+        PlannerBasePtr planner;
+        ConstraintTrajectoryTimingParametersPtr parameters;
+        TrajectoryBasePtr ptraj;
+        UserDataPtr callbackhandle;
+        PlannerStatus status;
+        bool bInitialized; ///< true if InitPlan of the worker planner succeeded
+    };
+    typedef boost::shared_ptr<Worker> WorkerPtr;
+
+    std::string _envnameid;
+    std::string _plannername;
+    std::vector<WorkerPtr> _vworkers;
+    std::atomic<bool> _bCancel; ///< true if the workers should be interrupted
+};
+
 #ifndef __clang__
 /// \brief wraps a static array of T onto a std::vector. Destructor just NULLs out the pointers. Any dynamic resizing operations on this vector wrapper would probably cause the problem to segfault, so use as if it is constant.
 ///
@@ -83,6 +374,7 @@ public:
         _level = 0;
         _hasselfchild = 0;
         _usenn = 1;
+        _edgevalidated = 1;
         _userdata = 0;
     }
     SimpleNode(SimpleNode* parent, const dReal* pconfig, int dof) : rrtparent(parent) {
@@ -90,6 +382,7 @@ public:
         _level = 0;
         _hasselfchild = 0;
         _usenn = 1;
+        _edgevalidated = 1;
         _userdata = 0;
     }
     ~SimpleNode() {
@@ -100,6 +393,7 @@ public:
     int16_t _level; ///< the level the node belongs to
     uint8_t _hasselfchild; ///< if 1, then _vchildren has contains a clone of this node in the level below it.
     uint8_t _usenn; ///< if 1, then use part of the nearest neighbor search, otherwise ignore
+    uint8_t _edgevalidated; ///< if 0, the constraints of the edge from rrtparent to this node have not been checked yet (lazy collision checking)
     uint32_t _userdata; ///< user specified data tagging this node
 
 #ifdef _DEBUG
@@ -108,6 +402,9 @@ public:
     dReal q[0]; // the configuration immediately follows the struct
 };
 
+#include "nearestneighborindex.h"
+#include "nodepool.h"
+
 class SpatialTreeBase
 {
 public:
@@ -159,6 +456,11 @@ public:
         _maxlevel = 0;
         _minlevel = 0;
         _fMaxLevelBound = 0;
+        _bUseNearestNeighborIndex = false;
+        _bUseDistanceKernel = false;
+        _bLazyCollisionChecking = false;
+        _numlazyedgechecks = 0;
+        _numlazyinvalidedges = 0;
     }
 
     ~SpatialTree() {
@@ -168,15 +470,8 @@ public:
     virtual void Init(boost::weak_ptr<PlannerBase> planner, int dof, boost::function<dReal(const std::vector<dReal>&, const std::vector<dReal>&)>& distmetricfn, dReal fStepLength, dReal maxdistance)
     {
         Reset();
-        if( !!_pNodesPool ) {
-            // see if pool can be preserved
-            if( _dof != dof ) {
-                _pNodesPool.reset();
-            }
-        }
-        if( !_pNodesPool ) {
-            _pNodesPool.reset(new boost::pool<>(sizeof(Node)+dof*sizeof(dReal)));
-        }
+        // the slabs are reused even if the dof changes
+        _nodepool.Reset(sizeof(Node)+dof*sizeof(dReal));
         _planner = planner;
         _distmetricfn = distmetricfn;
         _fStepLength = fStepLength;
@@ -194,39 +489,162 @@ public:
             _vsetLevelNodes.resize(enclevel+1);
         }
         _constraintreturn.reset(new ConstraintFilterReturn());
+        _bUseNearestNeighborIndex = false;
+        _bUseDistanceKernel = false;
+        _nnstats.Reset();
+        _bLazyCollisionChecking = false;
+        _numlazyedgechecks = 0;
+        _numlazyinvalidedges = 0;
     }
 
-    virtual void Reset()
+    /// \brief if true, Extend only checks the constraints of the new configurations and the edges have to be checked with ValidatePathToRoot
+    inline void SetLazyCollisionChecking(bool bLazyCollisionChecking) {
+        _bLazyCollisionChecking = bLazyCollisionChecking;
+    }
+
+    inline bool IsLazyCollisionChecking() const {
+        return _bLazyCollisionChecking;
+    }
+
+    /// \brief number of edges checked by ValidatePathToRoot
+    inline int GetNumLazyEdgeChecks() const {
+        return _numlazyedgechecks;
+    }
+
+    /// \brief number of edges that ValidatePathToRoot found to be invalid
+    inline int GetNumLazyInvalidEdges() const {
+        return _numlazyinvalidedges;
+    }
+
+    /** \brief checks the edges on the path from nodebase to its root that were added without checking
+
+        If an edge fails, the node at its end and all its descendants are removed from the nearest neighbor search.
+        \return true if all the edges of the path are valid
+     */
+    bool ValidatePathToRoot(NodeBasePtr nodebase, int constraintFilterOptions=0xffff|CFO_FillCheckedConfiguration)
     {
-        if( !!_pNodesPool ) {
-            // make sure all children are deleted
-            for(size_t ilevel = 0; ilevel < _vsetLevelNodes.size(); ++ilevel) {
-                FOREACH(itnode, _vsetLevelNodes[ilevel]) {
-                    (*itnode)->~Node();
-                }
+        boost::shared_ptr<PlannerBase> planner(_planner);
+        PlannerBase::PlannerParametersConstPtr params = planner->GetParameters();
+        for(NodePtr node = (NodePtr)nodebase; !!node->rrtparent; node = node->rrtparent) {
+            if( node->_edgevalidated ) {
+                continue;
             }
-            FOREACH(itchildren, _vsetLevelNodes) {
-                itchildren->clear();
+            _vCurConfig.resize(_dof);
+            std::copy(node->rrtparent->q, node->rrtparent->q+_dof, _vCurConfig.begin());
+            std::copy(node->q, node->q+_dof, _vNewConfig.begin());
+            ++_numlazyedgechecks;
+            int ret;
+            if( _fromgoal ) {
+                ret = params->CheckPathAllConstraints(_vNewConfig, _vCurConfig, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenEnd, constraintFilterOptions|CFO_FromPathSampling, _constraintreturn);
+            }
+            else {
+                ret = params->CheckPathAllConstraints(_vCurConfig, _vNewConfig, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart, constraintFilterOptions|CFO_FromPathSampling, _constraintreturn);
             }
-            //_pNodesPool->purge_memory();
-            _pNodesPool.reset(new boost::pool<>(sizeof(Node)+_dof*sizeof(dReal)));
+            // the path only stores the node configurations, so an edge whose checked path deviates from the interpolation cannot be used
+            if( ret != 0 || _constraintreturn->_bHasRampDeviatedFromInterpolation ) {
+                ++_numlazyinvalidedges;
+                InvalidateNodesWithParent(node);
+                return false;
+            }
+            node->_edgevalidated = 1;
+        }
+        return true;
+    }
+
+    /** \brief sets the nearest neighbor search, has to be called after Init and before any nodes are inserted.
+
+        \param type see RRTParameters::_nearestneighbor
+        \param fEpsilon see RRTParameters::_fNearestNeighborEpsilon
+        \param vlowerlimit, vupperlimit the limits of the configurations, used to check that the distance metric is a weighted euclidean metric
+        \return false if the type cannot be used and the cover tree search is used instead
+     */
+    bool InitNearestNeighborIndex(const std::string& type, dReal fEpsilon, const std::vector<dReal>& vlowerlimit, const std::vector<dReal>& vupperlimit)
+    {
+        _bUseNearestNeighborIndex = false;
+        _nnindex.Reset();
+        if( type.size() == 0 || type == "covertree" ) {
+            return true;
         }
+        if( _numnodes > 0 ) {
+            RAVELOG_WARN("cannot change the nearest neighbor search when the tree has nodes, using covertree");
+            return false;
+        }
+        if( type != "kdtree" ) {
+            RAVELOG_WARN_FORMAT("unknown nearest neighbor search '%s', using covertree", type);
+            return false;
+        }
+        std::vector<dReal> vweights;
+        if( !_ComputeEuclideanWeights(vlowerlimit, vupperlimit, vweights) ) {
+            RAVELOG_DEBUG("distance metric is not weighted euclidean, using covertree for the nearest neighbor search");
+            return false;
+        }
+        _nnindex.Init(vweights, fEpsilon);
+        _bUseNearestNeighborIndex = true;
+        return true;
+    }
+
+    /** \brief computes the distances with an inlined weighted euclidean kernel instead of calling the distance metric, has to be called after Init.
+
+        \param vlowerlimit, vupperlimit the limits of the configurations, used to check that the distance metric is a weighted euclidean metric
+        \return false if the distance metric is not weighted euclidean, for example because of circular joints, and is called as before
+     */
+    bool InitDistanceKernel(const std::vector<dReal>& vlowerlimit, const std::vector<dReal>& vupperlimit)
+    {
+        _bUseDistanceKernel = false;
+        if( !_ComputeEuclideanWeights(vlowerlimit, vupperlimit, _vweights2) ) {
+            return false;
+        }
+        FOREACH(itweight, _vweights2) {
+            *itweight *= *itweight;
+        }
+        _bUseDistanceKernel = true;
+        return true;
+    }
+
+    inline bool IsUsingNearestNeighborIndex() const {
+        return _bUseNearestNeighborIndex;
+    }
+
+    inline const NearestNeighborStats& GetNearestNeighborStats() const {
+        return _nnstats;
+    }
+
+    virtual void Reset()
+    {
+        // make sure all children are deleted
+        for(size_t ilevel = 0; ilevel < _vsetLevelNodes.size(); ++ilevel) {
+            FOREACH(itnode, _vsetLevelNodes[ilevel]) {
+                (*itnode)->~Node();
+            }
+        }
+        FOREACH(itchildren, _vsetLevelNodes) {
+            itchildren->clear();
+        }
+        // give all nodes back at once, the memory is kept for the next plan
+        _nodepool.Reset();
         _numnodes = 0;
+        _nnindex.Reset();
     }
 
     inline dReal _ComputeDistance(const dReal* config0, const dReal* config1) const
     {
+        if( _bUseDistanceKernel ) {
+            return planningutils::ComputeWeightedDistance(&_vweights2[0], config0, config1, _dof);
+        }
         return _distmetricfn(VectorWrapper<dReal>(config0, config0+_dof), VectorWrapper<dReal>(config1, config1+_dof));
     }
 
     inline dReal _ComputeDistance(const dReal* config0, const std::vector<dReal>& config1) const
     {
+        if( _bUseDistanceKernel ) {
+            return planningutils::ComputeWeightedDistance(&_vweights2[0], config0, &config1[0], _dof);
+        }
         return _distmetricfn(VectorWrapper<dReal>(config0,config0+_dof), config1);
     }
 
     inline dReal _ComputeDistance(NodePtr node0, NodePtr node1) const
     {
-        return _distmetricfn(VectorWrapper<dReal>(node0->q, &node0->q[_dof]), VectorWrapper<dReal>(node1->q, &node1->q[_dof]));
+        return _ComputeDistance(node0->q, node1->q);
     }
 
     std::pair<NodeBasePtr, dReal> FindNearestNode(const std::vector<dReal>& vquerystate) const
@@ -307,16 +725,20 @@ public:
 
     virtual ExtendType Extend(const vector<dReal>& vTargetConfig, NodeBasePtr& lastnode, bool bOneStep=false, int constraintFilterOptions=0xffff|CFO_FillCheckedConfiguration)
     {
+        boost::shared_ptr<PlannerBase> planner(_planner);
+        PlannerBase::PlannerParametersConstPtr params = planner->GetParameters();
         // get the nearest neighbor
-        std::pair<NodePtr, dReal> nn = _FindNearestNode(vTargetConfig);
+        std::pair<NodePtr, dReal> nn;
+        {
+            PlannerProfile::StageTimer timer(params->_profile.get(), PlannerProfile::PPS_NearestNeighbor);
+            nn = _FindNearestNode(vTargetConfig);
+        }
         if( !nn.first ) {
             return ET_Failed;
         }
         NodePtr pnode = nn.first;
         lastnode = nn.first;
         bool bHasAdded = false;
-        boost::shared_ptr<PlannerBase> planner(_planner);
-        PlannerBase::PlannerParametersConstPtr params = planner->GetParameters();
         _vCurConfig.resize(_dof);
         std::copy(pnode->q, pnode->q+_dof, _vCurConfig.begin());
         // extend
@@ -361,7 +783,13 @@ public:
             }
 
             // necessary to pass in _constraintreturn since _neighstatefn can have constraints and it can change the interpolation. Use _constraintreturn->_bHasRampDeviatedFromInterpolation to figure out if something changed.
-            if( _fromgoal ) {
+            if( _bLazyCollisionChecking ) {
+                // only check the new configuration, the edge is checked by ValidatePathToRoot
+                if( params->CheckPathAllConstraints(_vNewConfig, _vNewConfig, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart, constraintFilterOptions) != 0 ) {
+                    return bHasAdded ? ET_Sucess : ET_Failed;
+                }
+            }
+            else if( _fromgoal ) {
                 if( params->CheckPathAllConstraints(_vNewConfig, _vCurConfig, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenEnd, constraintFilterOptions|CFO_FromPathSampling, _constraintreturn) != 0 ) {
                     return bHasAdded ? ET_Sucess : ET_Failed;
                 }
@@ -394,13 +822,15 @@ public:
             // dReal currentDistance =  _ComputeDistance(&_vCurConfig[0], _vNewConfig);
 
             int iAdded = 0;
-            if( _constraintreturn->_bHasRampDeviatedFromInterpolation ) {
+            if( !_bLazyCollisionChecking && _constraintreturn->_bHasRampDeviatedFromInterpolation ) {
                 // Since the path checked by CheckPathAllConstraints can be different from a straight line segment connecting _vNewConfig and _vCurConfig, we add all checked configurations along the checked segment to the tree.
+                // The nodes are built directly from _constraintreturn->_configurations, only the last visited configuration is copied to _vNewConfig.
+                const dReal* plastconfig = NULL;
                 if( _fromgoal ) {
                     // Need to add nodes to the tree starting from the one closest to the nearest neighbor. Since _fromgoal is true, the closest one is the last config in _constraintreturn->_configurations
                     for(int iconfig = ((int)_constraintreturn->_configurations.size()) - _dof; iconfig >= 0; iconfig -= _dof) {
-                        std::copy(_constraintreturn->_configurations.begin() + iconfig, _constraintreturn->_configurations.begin() + iconfig + _dof, _vNewConfig.begin());
-                        NodePtr pnewnode = _InsertNode(pnode, _vNewConfig, 0); ///< set userdata to 0
+                        plastconfig = &_constraintreturn->_configurations[iconfig];
+                        NodePtr pnewnode = _InsertNode(pnode, plastconfig, 0); ///< set userdata to 0
                         if( !!pnewnode ) {
                             bHasAdded = true;
                             pnode = pnewnode;
@@ -415,8 +845,8 @@ public:
                 }
                 else {
                     for(int iconfig = 0; iconfig+_dof-1 < (int)_constraintreturn->_configurations.size(); iconfig += _dof) {
-                        std::copy(_constraintreturn->_configurations.begin() + iconfig, _constraintreturn->_configurations.begin() + iconfig + _dof, _vNewConfig.begin());
-                        NodePtr pnewnode = _InsertNode(pnode, _vNewConfig, 0); ///< set userdata to 0
+                        plastconfig = &_constraintreturn->_configurations[iconfig];
+                        NodePtr pnewnode = _InsertNode(pnode, plastconfig, 0); ///< set userdata to 0
                         if( !!pnewnode ) {
                             bHasAdded = true;
                             pnode = pnewnode;
@@ -429,10 +859,14 @@ public:
                         }
                     }
                 }
+                if( !!plastconfig ) {
+                    std::copy(plastconfig, plastconfig + _dof, _vNewConfig.begin());
+                }
             }
             else {
                 NodePtr pnewnode = _InsertNode(pnode, _vNewConfig, 0); ///< set userdata to 0
                 if( !!pnewnode ) {
+                    pnewnode->_edgevalidated = !_bLazyCollisionChecking;
                     pnode = pnewnode;
                     lastnode = pnode;
                     bHasAdded = true;
@@ -617,11 +1051,11 @@ private:
         int retid = s_id++;
         return retid;
     }
-    inline NodePtr _CreateNode(NodePtr rrtparent, const vector<dReal>& config, uint32_t userdata)
+    inline NodePtr _CreateNode(NodePtr rrtparent, const dReal* pconfig, uint32_t userdata)
     {
         // allocate memory for the structur and the internal state vectors
-        void* pmemory = _pNodesPool->malloc();
-        NodePtr node = new (pmemory) Node(rrtparent, config);
+        void* pmemory = _nodepool.malloc();
+        NodePtr node = new (pmemory) Node(rrtparent, pconfig, _dof);
         node->_userdata = userdata;
 #ifdef _DEBUG
         node->id = GetNewStaticId();
@@ -632,20 +1066,61 @@ private:
     inline NodePtr _CloneNode(NodePtr refnode)
     {
         // allocate memory for the structur and the internal state vectors
-        void* pmemory = _pNodesPool->malloc();
+        void* pmemory = _nodepool.malloc();
         NodePtr node = new (pmemory) Node(refnode->rrtparent, refnode->q, _dof);
         node->_userdata = refnode->_userdata;
+        node->_edgevalidated = refnode->_edgevalidated;
 #ifdef _DEBUG
         node->id = GetNewStaticId();
 #endif
         return node;
     }
 
+    /// \brief computes the weights w such that the distance metric is sqrt(sum_i (w_i*(a_i-b_i))^2) inside the limits
+    ///
+    /// \return false if the distance metric does not match a weighted euclidean metric, for example because of circular joints
+    bool _ComputeEuclideanWeights(const std::vector<dReal>& vlowerlimit, const std::vector<dReal>& vupperlimit, std::vector<dReal>& vweights) const
+    {
+        if( (int)vlowerlimit.size() != _dof || (int)vupperlimit.size() != _dof ) {
+            return false;
+        }
+        std::vector<dReal> vcenter(_dof), vtest(_dof);
+        for(int i = 0; i < _dof; ++i) {
+            vcenter[i] = 0.5*(vlowerlimit[i]+vupperlimit[i]);
+        }
+        vweights.resize(_dof);
+        for(int i = 0; i < _dof; ++i) {
+            const dReal fdelta = std::max(dReal(0.01)*(vupperlimit[i]-vlowerlimit[i]), dReal(1e-4));
+            vtest = vcenter;
+            vtest[i] += fdelta;
+            vweights[i] = _distmetricfn(vtest, vcenter)/fdelta;
+        }
+
+        // check with random pairs over the whole range, this fails for circular joints
+        std::mt19937 rng(0);
+        std::uniform_real_distribution<dReal> distribution(0, 1);
+        std::vector<dReal> vtest2(_dof);
+        for(int itest = 0; itest < 32; ++itest) {
+            dReal fexpecteddist2 = 0;
+            for(int i = 0; i < _dof; ++i) {
+                vtest[i] = vlowerlimit[i] + (vupperlimit[i]-vlowerlimit[i])*distribution(rng);
+                vtest2[i] = vlowerlimit[i] + (vupperlimit[i]-vlowerlimit[i])*distribution(rng);
+                dReal f = vweights[i]*(vtest[i]-vtest2[i]);
+                fexpecteddist2 += f*f;
+            }
+            const dReal fexpecteddist = RaveSqrt(fexpecteddist2);
+            if( RaveFabs(_distmetricfn(vtest, vtest2) - fexpecteddist) > 1e-4*std::max(fexpecteddist, dReal(1)) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
     void _DeleteNode(Node* p)
     {
         if( !!p ) {
             p->~Node();
-            _pNodesPool->free(p);
+            _nodepool.free(p);
         }
     }
 
@@ -659,6 +1134,30 @@ private:
     }
 
     std::pair<NodePtr, dReal> _FindNearestNode(const std::vector<dReal>& vquerystate) const
+    {
+        if( !_bUseNearestNeighborIndex ) {
+            return _FindNearestNodeCoverTree(vquerystate);
+        }
+        OPENRAVE_ASSERT_OP((int)vquerystate.size(),==,_dof);
+        uint64_t starttime = utils::GetNanoPerformanceTime();
+        std::pair<NodePtr, dReal> bestnode = _nnindex.FindNearest(vquerystate);
+        if( !!bestnode.first ) {
+            bestnode.second = _ComputeDistance(bestnode.first->q, vquerystate);
+        }
+        _nnstats.querytimens += utils::GetNanoPerformanceTime() - starttime;
+        _nnstats.numqueries++;
+        if( IS_DEBUGLEVEL(Level_Debug) && (_nnstats.numqueries % 100) == 0 ) {
+            // compare with the exact search
+            std::pair<NodePtr, dReal> exactnode = _FindNearestNodeCoverTree(vquerystate);
+            _nnstats.numrecallchecks++;
+            if( !exactnode.first || (!!bestnode.first && bestnode.second <= exactnode.second + g_fEpsilonLinear) ) {
+                _nnstats.numrecallhits++;
+            }
+        }
+        return bestnode;
+    }
+
+    std::pair<NodePtr, dReal> _FindNearestNodeCoverTree(const std::vector<dReal>& vquerystate) const
     {
         std::pair<NodePtr, dReal> bestnode;
         bestnode.first = NULL;
@@ -711,29 +1210,41 @@ private:
 
     NodePtr _InsertNode(NodePtr parent, const vector<dReal>& config, uint32_t userdata)
     {
-        NodePtr newnode = _CreateNode(parent, config, userdata);
+        return _InsertNode(parent, &config[0], userdata);
+    }
+
+    /// \brief inserts the _dof values at pconfig, used to build the nodes directly from the checked configurations of a ConstraintFilterReturn
+    NodePtr _InsertNode(NodePtr parent, const dReal* pconfig, uint32_t userdata)
+    {
+        NodePtr newnode = _CreateNode(parent, pconfig, userdata);
         if( _numnodes == 0 ) {
             // no root
             _vsetLevelNodes.at(_EncodeLevel(_maxlevel)).insert(newnode); // add to the level
             newnode->_level = _maxlevel;
             _numnodes += 1;
+            if( _bUseNearestNeighborIndex ) {
+                _nnindex.Add(newnode, newnode->q);
+            }
         }
         else {
             _vCurrentLevelNodes.resize(1);
             _vCurrentLevelNodes[0].first = *_vsetLevelNodes.at(_EncodeLevel(_maxlevel)).begin();
-            _vCurrentLevelNodes[0].second = _ComputeDistance(_vCurrentLevelNodes[0].first->q, config);
+            _vCurrentLevelNodes[0].second = _ComputeDistance(_vCurrentLevelNodes[0].first->q, pconfig);
             int nParentFound = _InsertRecursive(newnode, _vCurrentLevelNodes, _maxlevel, _fMaxLevelBound);
             if( nParentFound == 0 ) {
                 // could possibly happen with circulr joints, still need to take a look at correct fix (see #323)
                 std::stringstream ss; ss << std::setprecision(std::numeric_limits<dReal>::digits10+1);
-                FOREACHC(it, config) {
-                    ss << *it << ",";
+                for(int idof = 0; idof < _dof; ++idof) {
+                    ss << pconfig[idof] << ",";
                 }
                 throw OPENRAVE_EXCEPTION_FORMAT("Could not insert config=[%s] inside the cover tree, perhaps cover tree _maxdistance=%f is not enough from the root", ss.str()%_maxdistance, ORE_Assert);
             }
             if( nParentFound < 0 ) {
                 return NodePtr();
             }
+            if( _bUseNearestNeighborIndex ) {
+                _nnindex.Add(newnode, newnode->q);
+            }
         }
         //BOOST_ASSERT(Validate());
         return newnode;
@@ -921,6 +1432,9 @@ private:
         _vvCacheNodes.at(0).push_back(proot);
         bool bRemoved = _Remove(removenode, _vvCacheNodes, _maxlevel, _fMaxLevelBound);
         if( bRemoved ) {
+            if( _bUseNearestNeighborIndex ) {
+                _nnindex.Remove(removenode);
+            }
             _DeleteNode(removenode);
         }
         if( removenode == proot ) {
@@ -1056,7 +1570,7 @@ private:
     int _fromgoal;
 
     // cover tree data structures
-    boost::shared_ptr< boost::pool<> > _pNodesPool; ///< pool nodes are created from
+    NodePool _nodepool; ///< pool nodes are created from, kept across Reset
 
     std::vector< std::set<NodePtr> > _vsetLevelNodes; ///< _vsetLevelNodes[enc(level)][node] holds the indices of the children of "node" of a given the level. enc(level) maps (-inf,inf) into [0,inf) so it can be indexed by the vector. Every node has an entry in a map here. If the node doesn't hold any children, then it is at the leaf of the tree. _vsetLevelNodes.at(_EncodeLevel(_maxlevel)) is the root.
 
@@ -1077,6 +1591,16 @@ private:
 
     mutable std::vector< std::pair<NodePtr, dReal> > _vCurrentLevelNodes, _vNextLevelNodes;
     mutable std::vector< std::vector<NodePtr> > _vvCacheNodes;
+
+    KdTreeNearestNeighborIndex<Node> _nnindex; ///< used for the nearest neighbor queries if _bUseNearestNeighborIndex is true
+    bool _bUseNearestNeighborIndex;
+    mutable NearestNeighborStats _nnstats;
+
+    std::vector<dReal> _vweights2; ///< squared weights of the distance kernel
+    bool _bUseDistanceKernel; ///< if true, _ComputeDistance uses the weighted euclidean kernel instead of _distmetricfn, see InitDistanceKernel
+
+    bool _bLazyCollisionChecking; ///< see SetLazyCollisionChecking
+    int _numlazyedgechecks, _numlazyinvalidedges;
 };
 
 #ifdef RAVE_REGISTER_BOOST
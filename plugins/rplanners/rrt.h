@@ -71,6 +71,11 @@ Uses the Rapidly-Exploring Random Trees Algorithm.\n\
         _sampleConfig.resize(params->GetDOF());
         // TODO perhaps distmetricfn should take into number of revolutions of circular joints
         _treeForward.Init(shared_planner(), params->GetDOF(), params->_distmetricfn, params->_fStepLength, params->_distmetricfn(params->_vConfigLowerLimit, params->_vConfigUpperLimit));
+        _treeForward.InitDistanceKernel(params->_vConfigLowerLimit, params->_vConfigUpperLimit);
+        boost::shared_ptr<RRTParameters const> rrtparams = boost::dynamic_pointer_cast<RRTParameters const>(params);
+        if( !!rrtparams ) {
+            _treeForward.InitNearestNeighborIndex(rrtparams->_nearestneighbor, rrtparams->_fNearestNeighborEpsilon, params->_vConfigLowerLimit, params->_vConfigUpperLimit);
+        }
         std::vector<dReal> vinitialconfig(params->GetDOF());
         for(size_t index = 0; index < params->vinitialconfig.size(); index += params->GetDOF()) {
             std::copy(params->vinitialconfig.begin()+index,params->vinitialconfig.begin()+index+params->GetDOF(),vinitialconfig.begin());
@@ -318,6 +323,10 @@ Some python code to display data::\n\
 
         // TODO perhaps distmetricfn should take into number of revolutions of circular joints
         _treeBackward.Init(shared_planner(), _parameters->GetDOF(), _parameters->_distmetricfn, _parameters->_fStepLength, _parameters->_distmetricfn(_parameters->_vConfigLowerLimit, _parameters->_vConfigUpperLimit));
+        _treeBackward.InitDistanceKernel(_parameters->_vConfigLowerLimit, _parameters->_vConfigUpperLimit);
+        _treeBackward.InitNearestNeighborIndex(_parameters->_nearestneighbor, _parameters->_fNearestNeighborEpsilon, _parameters->_vConfigLowerLimit, _parameters->_vConfigUpperLimit);
+        _treeForward.SetLazyCollisionChecking(_parameters->_bLazyCollisionChecking);
+        _treeBackward.SetLazyCollisionChecking(_parameters->_bLazyCollisionChecking);
 
         //read in all goals
         if( (_parameters->vgoalconfig.size() % _parameters->GetDOF()) != 0 ) {
@@ -369,6 +378,7 @@ Some python code to display data::\n\
 
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
     {
+        OPENRAVE_TRACE_SCOPE("BirrtPlanner::PlanPath");
         _goalindex = -1;
         _startindex = -1;
         if(!_parameters) {
@@ -397,7 +407,7 @@ Some python code to display data::\n\
         PlannerProgress progress;
         PlannerAction callbackaction=PA_None;
         while(_vgoalpaths.size() < _parameters->_minimumgoalpaths && iter < 3*_parameters->_nMaxIterations) {
-            RAVELOG_VERBOSE_FORMAT("env=%s, iter=%d, forward=%d, backward=%d", GetEnv()->GetNameId()%(iter/3)%_treeForward.GetNumNodes()%_treeBackward.GetNumNodes());
+            RAVELOG_VERBOSE_DEFERRED("env=%s, iter=%d, forward=%d, backward=%d", GetEnv()->GetNameId(), iter/3, _treeForward.GetNumNodes(), _treeBackward.GetNumNodes());
             ++iter;
 
             // have to check callbacks at the beginning since code can continue
@@ -422,16 +432,16 @@ Some python code to display data::\n\
 
             if( !!_parameters->_samplegoalfn ) {
                 vector<dReal> vgoal;
-                if( _parameters->_samplegoalfn(vgoal) ) {
-                    RAVELOG_VERBOSE(str(boost::format("env=%s, inserting new goal index %d")%GetEnv()->GetNameId()%_vecGoalNodes.size()));
+                if( CallProfiledSampleFn(_parameters->_samplegoalfn, vgoal, _parameters->_profile, PlannerProfile::PPS_IK) ) {
+                    RAVELOG_VERBOSE_DEFERRED("env=%s, inserting new goal index %d", GetEnv()->GetNameId(), _vecGoalNodes.size());
                     _vecGoalNodes.push_back(_treeBackward.InsertNode(NULL, vgoal, _vecGoalNodes.size()));
                     _nValidGoals++;
                 }
             }
             if( !!_parameters->_sampleinitialfn ) {
                 vector<dReal> vinitial;
-                if( _parameters->_sampleinitialfn(vinitial) ) {
-                    RAVELOG_VERBOSE(str(boost::format("env=%s, inserting new initial %d")%GetEnv()->GetNameId()%_vecInitialNodes.size()));
+                if( CallProfiledSampleFn(_parameters->_sampleinitialfn, vinitial, _parameters->_profile, PlannerProfile::PPS_IK) ) {
+                    RAVELOG_VERBOSE_DEFERRED("env=%s, inserting new initial %d", GetEnv()->GetNameId(), _vecInitialNodes.size());
                     _vecInitialNodes.push_back(_treeForward.InsertNode(NULL,vinitial, _vecInitialNodes.size()));
                 }
             }
@@ -466,7 +476,7 @@ Some python code to display data::\n\
             }
 
             if( _sampleConfig.size() == 0 ) {
-                if( !_parameters->_samplefn(_sampleConfig) ) {
+                if( !CallProfiledSampleFn(_parameters->_samplefn, _sampleConfig, _parameters->_profile, PlannerProfile::PPS_Sampling) ) {
                     continue;
                 }
             }
@@ -494,6 +504,17 @@ Some python code to display data::\n\
                 planningstatus.AddCollisionReport(_treeBackward.GetConstraintReport()->_report);
             }
 
+            if( et == ET_Connected && _parameters->_bLazyCollisionChecking ) {
+                // the edges were not checked while growing the trees, so check the path now. Invalid edges are removed from the trees
+                bool bForwardValid = _treeForward.ValidatePathToRoot(TreeA == &_treeForward ? iConnectedA : iConnectedB, constraintFilterOptions);
+                if( !bForwardValid || !_treeBackward.ValidatePathToRoot(TreeA == &_treeBackward ? iConnectedA : iConnectedB, constraintFilterOptions) ) {
+                    if( constraintFilterOptions&CFO_FillCollisionReport ) {
+                        planningstatus.AddCollisionReport((bForwardValid ? _treeBackward : _treeForward).GetConstraintReport()->_report);
+                    }
+                    et = ET_Failed;
+                }
+            }
+
             if( et == ET_Connected ) {
                 // connected, process goal
                 _vgoalpaths.push_back(GOALPATH());
@@ -532,6 +553,10 @@ Some python code to display data::\n\
             progress._iteration = iter/3;
         }
 
+        _LogNearestNeighborStats();
+        if( _parameters->_bLazyCollisionChecking ) {
+            RAVELOG_DEBUG_FORMAT("env=%s, lazy collision checking checked %d edges, %d invalid", GetEnv()->GetNameId()%(_treeForward.GetNumLazyEdgeChecks()+_treeBackward.GetNumLazyEdgeChecks())%(_treeForward.GetNumLazyInvalidEdges()+_treeBackward.GetNumLazyInvalidEdges()));
+        }
         if( _vgoalpaths.size() == 0 ) {
             uint64_t elapsedtimeus = utils::GetMonotonicTime()-basetimeus;
             std::string description = str(boost::format(_("env=%s, plan failed in %u[us], iter=%d, nMaxIterations=%d"))%GetEnv()->GetNameId()%(elapsedtimeus)%(iter/3)%_parameters->_nMaxIterations);
@@ -682,6 +707,16 @@ Some python code to display data::\n\
     }
 
 protected:
+    void _LogNearestNeighborStats() const
+    {
+        if( !IS_DEBUGLEVEL(Level_Debug) || !_treeForward.IsUsingNearestNeighborIndex() ) {
+            return;
+        }
+        const NearestNeighborStats& forwardstats = _treeForward.GetNearestNeighborStats();
+        const NearestNeighborStats& backwardstats = _treeBackward.GetNearestNeighborStats();
+        RAVELOG_DEBUG_FORMAT("env=%s, nearest neighbor queries forward=%d (%fs, recall=%f), backward=%d (%fs, recall=%f)", GetEnv()->GetNameId()%forwardstats.numqueries%(1e-9*forwardstats.querytimens)%forwardstats.GetRecall()%backwardstats.numqueries%(1e-9*backwardstats.querytimens)%backwardstats.GetRecall());
+    }
+
     RRTParametersPtr _parameters;
     SpatialTree< SimpleNode > _treeBackward;
     dReal _fGoalBiasProb;
@@ -760,6 +795,7 @@ public:
 
     PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
     {
+        OPENRAVE_TRACE_SCOPE("BasicRrtPlanner::PlanPath");
         if(!_parameters) {
             std::string description = str(boost::format("env=%s, BasicRrtPlanner::PlanPath - Error, planner not initialized")%GetEnv()->GetNameId());
             RAVELOG_WARN(description);
@@ -793,14 +829,14 @@ public:
             }
             if( !!_parameters->_samplegoalfn ) {
                 vector<dReal> vgoal;
-                if( _parameters->_samplegoalfn(vgoal) ) {
+                if( CallProfiledSampleFn(_parameters->_samplegoalfn, vgoal, _parameters->_profile, PlannerProfile::PPS_IK) ) {
                     RAVELOG_VERBOSE_FORMAT("env=%s, found goal", GetEnv()->GetNameId());
                     _vecGoals.push_back(vgoal);
                 }
             }
             if( !!_parameters->_sampleinitialfn ) {
                 vector<dReal> vinitial;
-                if( _parameters->_sampleinitialfn(vinitial) ) {
+                if( CallProfiledSampleFn(_parameters->_sampleinitialfn, vinitial, _parameters->_profile, PlannerProfile::PPS_IK) ) {
                     RAVELOG_VERBOSE_FORMAT("env=%s, found initial", GetEnv()->GetNameId());
                     _vecInitialNodes.push_back(_treeForward.InsertNode(NULL, vinitial, _vecInitialNodes.size()));
                 }
@@ -809,7 +845,7 @@ public:
             if( (iter == 1 || RaveRandomFloat() < _fGoalBiasProb ) && _vecGoals.size() > 0 ) {
                 _sampleConfig = _vecGoals[RaveRandomInt()%_vecGoals.size()];
             }
-            else if( !_parameters->_samplefn(_sampleConfig) ) {
+            else if( !CallProfiledSampleFn(_parameters->_samplefn, _sampleConfig, _parameters->_profile, PlannerProfile::PPS_Sampling) ) {
                 continue;
             }
 
@@ -986,6 +1022,7 @@ public:
 
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
     {
+        OPENRAVE_TRACE_SCOPE("ExplorationPlanner::PlanPath");
         _goalindex = -1;
         _startindex = -1;
         if( !_parameters ) {
@@ -1016,7 +1053,7 @@ public:
                 }
             }
             else {     // rrt extend
-                if( !_parameters->_samplefn(vSampleConfig) ) {
+                if( !CallProfiledSampleFn(_parameters->_samplefn, vSampleConfig, _parameters->_profile, PlannerProfile::PPS_Sampling) ) {
                     continue;
                 }
                 NodeBasePtr plastnode;
@@ -0,0 +1,656 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2012 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "rplanners.h"
+#include "manipconstraints2.h"
+
+namespace rplanners {
+
+/** \brief time-optimal path parameterization based on reachability analysis (TOPP-RA).
+
+    The geometric path q(s) is kept and only its timing s(t) is computed. With x = ds/dt^2 and u = d^2s/dt^2, the velocity,
+    acceleration, torque and manipulator constraints at a grid point s_i all become linear inequalities in (u,x). A backward
+    pass computes for every grid point the interval of x from which the end of the path can still be reached, then a
+    forward pass takes the largest u that stays inside these intervals. Each pass solves one two variable linear program per
+    grid point, so the computation is linear in the number of grid points.
+
+    If the input trajectory is timed, its timing is used as the path parameter and its shape is kept. The grid contains all
+    its waypoints, and if its positions are interpolated linearly the path stops at each of them. Otherwise the path goes
+    linearly through the waypoints and stops at each of them.
+ */
+class ToppraTrajectoryRetimer : public PlannerBase
+{
+    /// \brief constraint alpha*u + beta*x <= gamma
+    struct HalfPlane
+    {
+        HalfPlane() : alpha(0), beta(0), gamma(0) {
+        }
+        HalfPlane(dReal alpha_, dReal beta_, dReal gamma_) : alpha(alpha_), beta(beta_), gamma(gamma_) {
+        }
+        dReal alpha, beta, gamma;
+    };
+
+    /// \brief body whose torques are limited, with the mapping between its dofs and the configuration space
+    struct TorqueLimitedBody
+    {
+        KinBodyPtr pbody;
+        std::vector<int> vuseddofindices, vconfigindices;
+        std::vector<dReal> vtorquelimits; ///< for every used dof
+    };
+
+public:
+    ToppraTrajectoryRetimer(EnvironmentBasePtr penv, std::istream& sinput) : PlannerBase(penv)
+    {
+        __description = "Time-optimal path parameterization by reachability analysis (TOPP-RA). Keeps the geometric path of the input trajectory and computes the fastest timing under the joint velocity, acceleration, torque and manipulator speed/acceleration limits. If the input trajectory is timed, its path is kept, otherwise the robot moves linearly between the waypoints and stops at each of them. Overwrites the velocities and timestamps of the input trajectory.";
+        RegisterCommand("SetGridSize",boost::bind(&ToppraTrajectoryRetimer::_SetGridSizeCommand,this,_1,_2),
+                        "sets the number of grid intervals used to discretize the whole path (default 200). Paths through untimed waypoints get at least 8 intervals per segment.");
+        RegisterCommand("SetUseTorqueLimits",boost::bind(&ToppraTrajectoryRetimer::_SetUseTorqueLimitsCommand,this,_1,_2),
+                        "if 1 (default), the torque limits of the bodies in the configuration space are enforced with their inverse dynamics");
+        _nGridSize = 200;
+        _bUseTorqueLimits = true;
+        _bmanipconstraints = false;
+    }
+
+    virtual PlannerStatus InitPlan(RobotBasePtr pbase, PlannerParametersConstPtr params) override
+    {
+        EnvironmentLock lock(GetEnv()->GetMutex());
+        params->Validate();
+        _parameters.reset(new ConstraintTrajectoryTimingParameters());
+        _parameters->copy(params);
+        return _InitPlan() ? PlannerStatus(PS_HasSolution) : PlannerStatus(PS_Failed);
+    }
+
+    virtual PlannerStatus InitPlan(RobotBasePtr pbase, std::istream& isParameters) override
+    {
+        EnvironmentLock lock(GetEnv()->GetMutex());
+        _parameters.reset(new ConstraintTrajectoryTimingParameters());
+        isParameters >> *_parameters;
+        _parameters->Validate();
+        return _InitPlan() ? PlannerStatus(PS_HasSolution) : PlannerStatus(PS_Failed);
+    }
+
+    virtual PlannerParametersConstPtr GetParameters() const override {
+        return _parameters;
+    }
+
+    virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
+    {
+        OPENRAVE_TRACE_SCOPE("ToppraTrajectoryRetimer::PlanPath");
+        BOOST_ASSERT(!!_parameters && !!ptraj && ptraj->GetEnv()==GetEnv());
+        PlannerProfile::StageTimer profiletimer(_parameters->_profile.get(), PlannerProfile::PPS_Retiming);
+        const ConfigurationSpecification& posspec = _parameters->_configurationspecification;
+        const int ndof = posspec.GetDOF();
+        size_t numpoints = ptraj->GetNumWaypoints();
+        if( numpoints == 0 ) {
+            std::string description = str(boost::format("env=%d, there's nothing to retime")%GetEnv()->GetId());
+            return OPENRAVE_PLANNER_STATUS(description, PS_Failed);
+        }
+
+        ConfigurationSpecification newspec = posspec;
+        FOREACH(itgroup, newspec._vgroups) {
+            itgroup->interpolation = "cubic";
+        }
+        newspec.AddDerivativeGroups(1, true);
+        const int newdof = newspec.GetDOF();
+        std::vector<ConfigurationSpecification::Group>::const_iterator itnewtimegroup = newspec.FindCompatibleGroup("deltatime", false);
+        BOOST_ASSERT(itnewtimegroup != newspec._vgroups.end());
+        const int timeoffset = itnewtimegroup->offset;
+
+        std::vector<dReal>& vwaypoints = _vtempdata;
+        ptraj->GetWaypoints(0, numpoints, vwaypoints, posspec);
+        std::vector<dReal>& vnewdata = _vnewdata;
+        vnewdata.resize(0);
+        if( numpoints == 1 ) {
+            vnewdata.resize(newdof, 0);
+            ConfigurationSpecification::ConvertData(vnewdata.begin(), newspec, vwaypoints.begin(), posspec, 1, GetEnv(), false);
+            _WriteTrajectory(ptraj, newspec, vnewdata);
+            return OPENRAVE_PLANNER_STATUS(PS_HasSolution);
+        }
+
+        // Use the timing of the trajectory as the path parameter if it has one
+        ConfigurationSpecification velspec = posspec.ConvertToVelocitySpecification();
+        bool bTimedPath = ptraj->GetConfigurationSpecification().FindCompatibleGroup("deltatime", false) != ptraj->GetConfigurationSpecification()._vgroups.end() && ptraj->GetDuration() > g_fEpsilonLinear;
+        FOREACHC(itgroup, velspec._vgroups) {
+            if( ptraj->GetConfigurationSpecification().FindCompatibleGroup(*itgroup, true) == ptraj->GetConfigurationSpecification()._vgroups.end() ) {
+                bTimedPath = false;
+            }
+        }
+
+        try {
+            if( bTimedPath ) {
+                // the grid contains the time of every waypoint so that the output goes through them. Where the velocity of the
+                // path jumps at a waypoint, the path has to stop there, so the pieces between such waypoints are parameterized on their own.
+                const ConfigurationSpecification& trajspec = ptraj->GetConfigurationSpecification();
+                const int trajtimeoffset = trajspec.FindCompatibleGroup("deltatime", false)->offset;
+                const int trajdof = trajspec.GetDOF();
+                bool bContinuousVelocity = true;
+                FOREACHC(itgroup, posspec._vgroups) {
+                    std::vector<ConfigurationSpecification::Group>::const_iterator ittrajgroup = trajspec.FindCompatibleGroup(*itgroup, true);
+                    if( ittrajgroup == trajspec._vgroups.end() || ittrajgroup->interpolation.size() == 0 || ittrajgroup->interpolation == "linear" || ittrajgroup->interpolation == "previous" || ittrajgroup->interpolation == "next" ) {
+                        bContinuousVelocity = false;
+                    }
+                }
+                std::vector<dReal>& vwaypointtimes = _vwaypointtimes;
+                ptraj->GetWaypoints(0, numpoints, _vtrajdata);
+                vwaypointtimes.resize(numpoints);
+                vwaypointtimes[0] = 0;
+                for(size_t ipoint = 1; ipoint < numpoints; ++ipoint) {
+                    vwaypointtimes[ipoint] = vwaypointtimes[ipoint-1] + _vtrajdata[ipoint*trajdof+trajtimeoffset];
+                }
+                const dReal fduration = vwaypointtimes.back();
+                const int numintervals = std::max(_nGridSize, 2*(int)(numpoints-1));
+                size_t ipiecestart = 0;
+                for(size_t ipoint = 1; ipoint < numpoints; ++ipoint) {
+                    if( ipoint+1 < numpoints && bContinuousVelocity ) {
+                        continue;
+                    }
+                    if( vwaypointtimes[ipoint] - vwaypointtimes[ipiecestart] <= g_fEpsilonLinear ) {
+                        // no motion in time, the piece is merged into the next one
+                        continue;
+                    }
+                    _SampleTimedPiece(ptraj, ipiecestart, ipoint, numintervals*(vwaypointtimes[ipoint] - vwaypointtimes[ipiecestart])/fduration, ndof);
+                    if( !_ComputeParameterization(ndof) ) {
+                        std::string description = str(boost::format("env=%d, path cannot be parameterized within the limits between waypoints %d and %d")%GetEnv()->GetId()%ipiecestart%ipoint);
+                        RAVELOG_DEBUG(description);
+                        return OPENRAVE_PLANNER_STATUS(description, PS_Failed);
+                    }
+                    _AppendGridPoints(newspec, ndof, vnewdata.size() == 0, vnewdata);
+                    ipiecestart = ipoint;
+                }
+                if( vnewdata.size() == 0 ) {
+                    // the path does not move in time
+                    vnewdata.resize(newdof, 0);
+                    ConfigurationSpecification::ConvertData(vnewdata.begin(), newspec, vwaypoints.begin(), posspec, 1, GetEnv(), false);
+                }
+            }
+            else {
+                // stop at every waypoint, each segment is parameterized on its own
+                const int numsegments = (int)numpoints-1;
+                const int numintervals = std::max(8, _nGridSize/numsegments);
+                std::vector<dReal> vprev(ndof), vdiff(ndof);
+                for(int isegment = 0; isegment < numsegments; ++isegment) {
+                    std::copy(vwaypoints.begin()+isegment*ndof, vwaypoints.begin()+(isegment+1)*ndof, vprev.begin());
+                    std::copy(vwaypoints.begin()+(isegment+1)*ndof, vwaypoints.begin()+(isegment+2)*ndof, vdiff.begin());
+                    _parameters->_diffstatefn(vdiff, vprev);
+                    _vgrids.resize(numintervals+1);
+                    _vgridq.resize((numintervals+1)*ndof);
+                    _vgriddq.resize((numintervals+1)*ndof);
+                    _vgridddq.resize((numintervals+1)*ndof);
+                    for(int i = 0; i <= numintervals; ++i) {
+                        dReal s = dReal(i)/numintervals;
+                        _vgrids[i] = s;
+                        for(int j = 0; j < ndof; ++j) {
+                            _vgridq[i*ndof+j] = vprev[j] + s*vdiff[j];
+                            _vgriddq[i*ndof+j] = vdiff[j];
+                            _vgridddq[i*ndof+j] = 0;
+                        }
+                    }
+                    if( !_ComputeParameterization(ndof) ) {
+                        std::string description = str(boost::format("env=%d, segment %d/%d cannot be parameterized within the limits")%GetEnv()->GetId()%isegment%numsegments);
+                        RAVELOG_DEBUG(description);
+                        return OPENRAVE_PLANNER_STATUS(description, PS_Failed);
+                    }
+                    _AppendGridPoints(newspec, ndof, isegment == 0, vnewdata);
+                }
+            }
+        }
+        catch (const std::exception& ex) {
+            std::string description = str(boost::format("env=%d, TOPP-RA retimer failed: %s")%GetEnv()->GetId()%ex.what());
+            RAVELOG_WARN(description);
+            return OPENRAVE_PLANNER_STATUS(description, PS_Failed);
+        }
+
+        BOOST_ASSERT(vnewdata.size() > 0 && vnewdata.at(timeoffset) == 0);
+        _WriteTrajectory(ptraj, newspec, vnewdata);
+        return OPENRAVE_PLANNER_STATUS(PS_HasSolution);
+    }
+
+protected:
+    bool _InitPlan()
+    {
+        const ConfigurationSpecification& spec = _parameters->_configurationspecification;
+        if( (int)_parameters->_vConfigVelocityLimit.size() != _parameters->GetDOF() || (int)_parameters->_vConfigAccelerationLimit.size() != _parameters->GetDOF() ) {
+            return false;
+        }
+        if( _parameters->_interpolation.size() > 0 && _parameters->_interpolation != "cubic" ) {
+            RAVELOG_WARN_FORMAT("env=%d, TOPP-RA retimer only outputs cubic interpolation, requested %s", GetEnv()->GetId()%_parameters->_interpolation);
+            return false;
+        }
+        FOREACHC(itgroup, spec._vgroups) {
+            if( itgroup->name.size() < 12 || itgroup->name.substr(0,12) != "joint_values" ) {
+                RAVELOG_WARN_FORMAT("env=%d, TOPP-RA retimer only supports joint_values groups, got %s", GetEnv()->GetId()%itgroup->name);
+                return false;
+            }
+        }
+
+        _bmanipconstraints = _parameters->manipname.size() > 0 && (_parameters->maxmanipspeed>0 || _parameters->maxmanipaccel>0);
+        if( _bmanipconstraints ) {
+            if( !_manipconstraintchecker ) {
+                _manipconstraintchecker.reset(new ManipConstraintChecker2(GetEnv()));
+            }
+            _manipconstraintchecker->Init(_parameters->manipname, spec, _parameters->maxmanipspeed, _parameters->maxmanipaccel);
+        }
+
+        _listtorquebodies.clear();
+        if( _bUseTorqueLimits ) {
+            std::vector<KinBodyPtr> vusedbodies;
+            spec.ExtractUsedBodies(GetEnv(), vusedbodies);
+            std::vector<dReal> vtorquelimits;
+            FOREACH(itbody, vusedbodies) {
+                TorqueLimitedBody torquebody;
+                torquebody.pbody = *itbody;
+                spec.ExtractUsedIndices(*itbody, torquebody.vuseddofindices, torquebody.vconfigindices);
+                (*itbody)->GetDOFTorqueLimits(vtorquelimits);
+                bool bHasLimits = false;
+                torquebody.vtorquelimits.resize(torquebody.vuseddofindices.size());
+                for(size_t index = 0; index < torquebody.vuseddofindices.size(); ++index) {
+                    torquebody.vtorquelimits[index] = vtorquelimits.at(torquebody.vuseddofindices[index]);
+                    if( torquebody.vtorquelimits[index] > 0 ) {
+                        bHasLimits = true;
+                    }
+                }
+                if( bHasLimits ) {
+                    _listtorquebodies.push_back(torquebody);
+                }
+            }
+        }
+        return true;
+    }
+
+    /// \brief fills the grid of the timed path between waypoints ipointstart and ipointend of ptraj using _vwaypointtimes.
+    ///
+    /// Every waypoint is a grid point and the intervals are distributed over the segments by their duration. The derivatives of the path
+    /// are computed inside every segment, so they do not span the acceleration changes at the waypoints.
+    /// \param fnumintervals desired number of grid intervals of the piece
+    void _SampleTimedPiece(TrajectoryBasePtr ptraj, size_t ipointstart, size_t ipointend, dReal fnumintervals, int ndof)
+    {
+        const ConfigurationSpecification& posspec = _parameters->_configurationspecification;
+        const ConfigurationSpecification velspec = posspec.ConvertToVelocitySpecification();
+        const dReal fpieceduration = _vwaypointtimes[ipointend] - _vwaypointtimes[ipointstart];
+        _vgrids.resize(0);
+        _vgridq.resize(0);
+        _vgriddq.resize(0);
+        _vgridddq.resize(0);
+        std::vector<dReal>& vsample = _vsample, &vvel0 = _vvel0, &vvel1 = _vvel1;
+        for(size_t isegment = ipointstart; isegment < ipointend; ++isegment) {
+            const dReal fsegmentstart = _vwaypointtimes[isegment], fsegmentend = _vwaypointtimes[isegment+1];
+            const dReal fsegmentduration = fsegmentend - fsegmentstart;
+            if( fsegmentduration <= g_fEpsilonLinear ) {
+                continue;
+            }
+            const int numintervals = std::max(1, (int)RaveCeil(fnumintervals*fsegmentduration/fpieceduration - g_fEpsilonLinear));
+            const dReal fstep = fsegmentduration/numintervals;
+            const dReal fdiffstep = std::min(fstep*0.25, dReal(1e-4)*fsegmentduration);
+            // the first point of the segment is the last point of the previous one, only the piece start is added
+            const int istart = _vgrids.size() == 0 ? 0 : 1;
+            if( istart == 1 ) {
+                // the constraints of the interval following the waypoint use the derivatives of this segment
+                _vgrids.pop_back();
+                _vgridq.resize(_vgridq.size()-ndof);
+                _vgriddq.resize(_vgriddq.size()-ndof);
+                _vgridddq.resize(_vgridddq.size()-ndof);
+            }
+            for(int i = 0; i <= numintervals; ++i) {
+                const dReal s = i == numintervals ? fsegmentend : fsegmentstart + i*fstep;
+                _vgrids.push_back(s - _vwaypointtimes[ipointstart]);
+                ptraj->Sample(vsample, s, posspec);
+                _vgridq.insert(_vgridq.end(), vsample.begin(), vsample.end());
+                // sample the velocities strictly inside the segment, the waypoint itself could belong to either segment
+                const dReal sv = std::min(fsegmentend - fdiffstep, std::max(fsegmentstart + fdiffstep, s));
+                ptraj->Sample(vsample, sv, velspec);
+                _vgriddq.insert(_vgriddq.end(), vsample.begin(), vsample.end());
+                const dReal s0 = std::max(fsegmentstart + 0.5*fdiffstep, sv - fdiffstep), s1 = std::min(fsegmentend - 0.5*fdiffstep, sv + fdiffstep);
+                ptraj->Sample(vvel0, s0, velspec);
+                ptraj->Sample(vvel1, s1, velspec);
+                for(int j = 0; j < ndof; ++j) {
+                    _vgridddq.push_back((vvel1[j] - vvel0[j])/(s1 - s0));
+                }
+            }
+        }
+    }
+
+    /// \brief computes the half-planes of every grid point from _vgridq, _vgriddq, _vgridddq, then runs the backward and forward passes. Fills _vgridx.
+    bool _ComputeParameterization(int ndof)
+    {
+        const size_t numgrid = _vgrids.size();
+        _vgridxmax.resize(numgrid);
+        _vgridhalfplanestart.resize(numgrid+1);
+        _vhalfplanes.resize(0);
+        for(size_t i = 0; i < numgrid; ++i) {
+            _vgridhalfplanestart[i] = _vhalfplanes.size();
+            dReal xmax = g_fMaxPathSpeedSqr;
+            for(int j = 0; j < ndof; ++j) {
+                dReal dq = _vgriddq[i*ndof+j], ddq = _vgridddq[i*ndof+j];
+                if( RaveFabs(dq) > g_fEpsilon ) {
+                    dReal f = _parameters->_vConfigVelocityLimit[j]/RaveFabs(dq);
+                    xmax = std::min(xmax, f*f);
+                }
+                dReal am = _parameters->_vConfigAccelerationLimit[j];
+                if( am > 0 ) {
+                    _vhalfplanes.push_back(HalfPlane(dq, ddq, am));
+                    _vhalfplanes.push_back(HalfPlane(-dq, -ddq, am));
+                }
+            }
+            _vgridxmax[i] = xmax;
+        }
+        _vgridhalfplanestart[numgrid] = _vhalfplanes.size();
+        if( _listtorquebodies.size() > 0 ) {
+            _AddTorqueConstraints(ndof);
+        }
+        if( _bmanipconstraints && !!_manipconstraintchecker ) {
+            _AddManipConstraints(ndof);
+        }
+
+        // backward pass: controllable sets, the path ends at rest
+        _vgridxlower.resize(numgrid);
+        _vgridxupper.resize(numgrid);
+        _vgridxlower[numgrid-1] = 0;
+        _vgridxupper[numgrid-1] = 0;
+        for(int i = (int)numgrid-2; i >= 0; --i) {
+            dReal delta = _vgrids[i+1] - _vgrids[i];
+            if( !_ComputeControllableInterval(i, delta, _vgridxlower[i+1], _vgridxupper[i+1], _vgridxlower[i], _vgridxupper[i]) ) {
+                RAVELOG_VERBOSE_FORMAT("env=%d, grid point %d/%d is not controllable", GetEnv()->GetId()%i%numgrid);
+                return false;
+            }
+        }
+        if( _vgridxlower[0] > g_fEpsilonLinear ) {
+            // cannot start at rest
+            return false;
+        }
+
+        // forward pass: greedily take the largest acceleration that stays in the controllable sets
+        _vgridx.resize(numgrid);
+        _vgridx[0] = 0;
+        for(size_t i = 0; i+1 < numgrid; ++i) {
+            dReal delta = _vgrids[i+1] - _vgrids[i];
+            dReal x = _vgridx[i];
+            dReal umax = (_vgridxupper[i+1] - x)/(2*delta);
+            for(size_t ihalfplane = _vgridhalfplanestart[i]; ihalfplane < _vgridhalfplanestart[i+1]; ++ihalfplane) {
+                const HalfPlane& h = _vhalfplanes[ihalfplane];
+                if( h.alpha > g_fEpsilonAlpha ) {
+                    umax = std::min(umax, (h.gamma - h.beta*x)/h.alpha);
+                }
+            }
+            dReal xnext = x + 2*delta*umax;
+            xnext = std::max(xnext, _vgridxlower[i+1]);
+            xnext = std::min(xnext, _vgridxupper[i+1]);
+            _vgridx[i+1] = std::max(dReal(0), xnext);
+        }
+        return true;
+    }
+
+    /// \brief computes [xlower, xupper] of grid point i such that some u leads to a state in [nextxlower, nextxupper] at grid point i+1
+    ///
+    /// The two variable linear program is solved by eliminating u: every pair of a lower and an upper bound on u gives a bound on x.
+    bool _ComputeControllableInterval(int i, dReal delta, dReal nextxlower, dReal nextxupper, dReal& xlower, dReal& xupper)
+    {
+        // u >= lp + lq*x or u <= up + uq*x
+        _vlowerbounds.resize(0);
+        _vupperbounds.resize(0);
+        dReal xmin = 0, xmax = _vgridxmax[i];
+        // x + 2*delta*u in [nextxlower, nextxupper]
+        _vlowerbounds.push_back(std::make_pair(nextxlower/(2*delta), -1/(2*delta)));
+        _vupperbounds.push_back(std::make_pair(nextxupper/(2*delta), -1/(2*delta)));
+        for(size_t ihalfplane = _vgridhalfplanestart[i]; ihalfplane < _vgridhalfplanestart[i+1]; ++ihalfplane) {
+            const HalfPlane& h = _vhalfplanes[ihalfplane];
+            if( h.alpha > g_fEpsilonAlpha ) {
+                _vupperbounds.push_back(std::make_pair(h.gamma/h.alpha, -h.beta/h.alpha));
+            }
+            else if( h.alpha < -g_fEpsilonAlpha ) {
+                _vlowerbounds.push_back(std::make_pair(h.gamma/h.alpha, -h.beta/h.alpha));
+            }
+            else if( !_IntersectLinearBound(h.beta, h.gamma, xmin, xmax) ) {
+                return false;
+            }
+        }
+        FOREACHC(itlower, _vlowerbounds) {
+            FOREACHC(itupper, _vupperbounds) {
+                // itlower->first + itlower->second*x <= itupper->first + itupper->second*x
+                if( !_IntersectLinearBound(itlower->second - itupper->second, itupper->first - itlower->first, xmin, xmax) ) {
+                    return false;
+                }
+            }
+        }
+        xlower = xmin;
+        xupper = xmax;
+        return true;
+    }
+
+    /// \brief intersects [xmin, xmax] with coeff*x <= rhs. returns false if the result is empty
+    inline bool _IntersectLinearBound(dReal coeff, dReal rhs, dReal& xmin, dReal& xmax)
+    {
+        if( coeff > g_fEpsilonAlpha ) {
+            xmax = std::min(xmax, rhs/coeff);
+        }
+        else if( coeff < -g_fEpsilonAlpha ) {
+            xmin = std::max(xmin, rhs/coeff);
+        }
+        else if( rhs < -g_fEpsilonLinear ) {
+            return false;
+        }
+        if( xmin > xmax ) {
+            if( xmin - xmax > g_fEpsilonLinear ) {
+                return false;
+            }
+            xmin = xmax;
+        }
+        return true;
+    }
+
+    /// \brief torque = a*u + b*x + c, with c = ID(q,0,0), a = ID(q,0,q') - c, and b = ID(q,q',q'') - c
+    void _AddTorqueConstraints(int ndof)
+    {
+        const size_t numgrid = _vgrids.size();
+        std::vector< std::vector<HalfPlane> > vgridhalfplanes(numgrid);
+        FOREACH(ittorquebody, _listtorquebodies) {
+            KinBodyPtr pbody = ittorquebody->pbody;
+            const int nbodydof = pbody->GetDOF();
+            std::vector<dReal> vcurvalues;
+            pbody->GetDOFValues(vcurvalues);
+            // three states per grid point
+            _vidvalues.resize(3*numgrid*nbodydof);
+            _vidvelocities.resize(3*numgrid*nbodydof);
+            _vidaccelerations.resize(3*numgrid*nbodydof);
+            std::fill(_vidvelocities.begin(), _vidvelocities.end(), 0);
+            std::fill(_vidaccelerations.begin(), _vidaccelerations.end(), 0);
+            for(size_t i = 0; i < numgrid; ++i) {
+                for(int istate = 0; istate < 3; ++istate) {
+                    std::copy(vcurvalues.begin(), vcurvalues.end(), _vidvalues.begin()+(3*i+istate)*nbodydof);
+                }
+                for(size_t index = 0; index < ittorquebody->vuseddofindices.size(); ++index) {
+                    int idof = ittorquebody->vuseddofindices[index], iconfig = ittorquebody->vconfigindices[index];
+                    for(int istate = 0; istate < 3; ++istate) {
+                        _vidvalues[(3*i+istate)*nbodydof+idof] = _vgridq[i*ndof+iconfig];
+                    }
+                    _vidaccelerations[(3*i+1)*nbodydof+idof] = _vgriddq[i*ndof+iconfig];
+                    _vidvelocities[(3*i+2)*nbodydof+idof] = _vgriddq[i*ndof+iconfig];
+                    _vidaccelerations[(3*i+2)*nbodydof+idof] = _vgridddq[i*ndof+iconfig];
+                }
+            }
+            pbody->ComputeInverseDynamicsBatch(_vidtorques, _vidvalues, _vidvelocities, _vidaccelerations, _idworkspace);
+            for(size_t i = 0; i < numgrid; ++i) {
+                for(size_t index = 0; index < ittorquebody->vuseddofindices.size(); ++index) {
+                    dReal torquelimit = ittorquebody->vtorquelimits[index];
+                    if( torquelimit <= 0 ) {
+                        continue;
+                    }
+                    int idof = ittorquebody->vuseddofindices[index];
+                    dReal c = _vidtorques[(3*i)*nbodydof+idof];
+                    dReal a = _vidtorques[(3*i+1)*nbodydof+idof] - c;
+                    dReal b = _vidtorques[(3*i+2)*nbodydof+idof] - c;
+                    vgridhalfplanes[i].push_back(HalfPlane(a, b, torquelimit - c));
+                    vgridhalfplanes[i].push_back(HalfPlane(-a, -b, torquelimit + c));
+                }
+            }
+        }
+        _MergeHalfPlanes(vgridhalfplanes);
+    }
+
+    /// \brief constraints on the check points of the manipulators of _manipconstraintchecker
+    ///
+    /// The velocity of a point is pv*sqrt(x) and its acceleration pv*u + pa*x. The speed limit bounds x, and the norm of
+    /// the acceleration is bounded by |pv|*|u| + |pa|*x, which gives two linear constraints.
+    void _AddManipConstraints(int ndof)
+    {
+        const size_t numgrid = _vgrids.size();
+        const dReal maxmanipspeed = _parameters->maxmanipspeed, maxmanipaccel = _parameters->maxmanipaccel;
+        std::vector< std::vector<HalfPlane> > vgridhalfplanes(numgrid);
+        std::vector<dReal> vvalues, vvelocities, vaccelerations;
+        std::vector<std::pair<Vector,Vector> > vlinkvelocities, vlinkaccelerations;
+        FOREACHC(itmanipinfo, _manipconstraintchecker->GetCheckManips()) {
+            KinBodyPtr probot = itmanipinfo->plink->GetParent();
+            KinBody::KinBodyStateSaver saver(probot, KinBody::Save_LinkTransformation|KinBody::Save_LinkVelocities);
+            const int endeffindex = itmanipinfo->plink->GetIndex();
+            vvalues.resize(itmanipinfo->vuseddofindices.size());
+            vvelocities.resize(itmanipinfo->vuseddofindices.size());
+            vaccelerations.resize(probot->GetDOF());
+            std::fill(vaccelerations.begin(), vaccelerations.end(), 0);
+            for(size_t i = 0; i < numgrid; ++i) {
+                for(size_t index = 0; index < itmanipinfo->vuseddofindices.size(); ++index) {
+                    int iconfig = itmanipinfo->vconfigindices[index];
+                    vvalues[index] = _vgridq[i*ndof+iconfig];
+                    vvelocities[index] = _vgriddq[i*ndof+iconfig];
+                    vaccelerations[itmanipinfo->vuseddofindices[index]] = _vgridddq[i*ndof+iconfig];
+                }
+                probot->SetDOFValues(vvalues, KinBody::CLA_CheckLimits, itmanipinfo->vuseddofindices);
+                probot->SetDOFVelocities(vvelocities, KinBody::CLA_Nothing, itmanipinfo->vuseddofindices);
+                probot->GetLinkVelocities(vlinkvelocities);
+                probot->GetLinkAccelerations(vaccelerations, vlinkaccelerations);
+                const Vector& vellin = vlinkvelocities.at(endeffindex).first;
+                const Vector& velang = vlinkvelocities.at(endeffindex).second;
+                const Vector& acclin = vlinkaccelerations.at(endeffindex).first;
+                const Vector& accang = vlinkaccelerations.at(endeffindex).second;
+                Transform R = itmanipinfo->plink->GetTransform();
+                FOREACHC(itpoint, itmanipinfo->checkpoints) {
+                    Vector point = R.rotate(*itpoint);
+                    Vector pv = vellin + velang.cross(point);
+                    dReal fpv = RaveSqrt(pv.lengthsqr3());
+                    if( maxmanipspeed > 0 && fpv > g_fEpsilon ) {
+                        dReal f = maxmanipspeed/fpv;
+                        _vgridxmax[i] = std::min(_vgridxmax[i], f*f);
+                    }
+                    if( maxmanipaccel > 0 ) {
+                        Vector pa = acclin + velang.cross(velang.cross(point)) + accang.cross(point);
+                        dReal fpa = RaveSqrt(pa.lengthsqr3());
+                        vgridhalfplanes[i].push_back(HalfPlane(fpv, fpa, maxmanipaccel));
+                        vgridhalfplanes[i].push_back(HalfPlane(-fpv, fpa, maxmanipaccel));
+                    }
+                }
+            }
+        }
+        _MergeHalfPlanes(vgridhalfplanes);
+    }
+
+    /// \brief appends vgridhalfplanes[i] to the half-planes of grid point i
+    void _MergeHalfPlanes(const std::vector< std::vector<HalfPlane> >& vgridhalfplanes)
+    {
+        const size_t numgrid = _vgrids.size();
+        std::vector<HalfPlane> vmerged;
+        std::vector<size_t> vmergedstart(numgrid+1);
+        for(size_t i = 0; i < numgrid; ++i) {
+            vmergedstart[i] = vmerged.size();
+            vmerged.insert(vmerged.end(), _vhalfplanes.begin()+_vgridhalfplanestart[i], _vhalfplanes.begin()+_vgridhalfplanestart[i+1]);
+            vmerged.insert(vmerged.end(), vgridhalfplanes[i].begin(), vgridhalfplanes[i].end());
+        }
+        vmergedstart[numgrid] = vmerged.size();
+        _vhalfplanes.swap(vmerged);
+        _vgridhalfplanestart.swap(vmergedstart);
+    }
+
+    /// \brief appends the grid points with the computed timing to vnewdata. if bIncludeFirst is false, skips the first grid point since it is the last point of the previous segment
+    void _AppendGridPoints(const ConfigurationSpecification& newspec, int ndof, bool bIncludeFirst, std::vector<dReal>& vnewdata)
+    {
+        const ConfigurationSpecification& posspec = _parameters->_configurationspecification;
+        const ConfigurationSpecification velspec = posspec.ConvertToVelocitySpecification();
+        const int newdof = newspec.GetDOF();
+        std::vector<ConfigurationSpecification::Group>::const_iterator ittimegroup = newspec.FindCompatibleGroup("deltatime", false);
+        const size_t numgrid = _vgrids.size();
+        size_t istart = bIncludeFirst ? 0 : 1;
+        size_t offset = vnewdata.size();
+        vnewdata.resize(offset + (numgrid-istart)*newdof, 0);
+        std::vector<dReal> vvel(ndof);
+        for(size_t i = istart; i < numgrid; ++i) {
+            std::vector<dReal>::iterator itdata = vnewdata.begin()+offset+(i-istart)*newdof;
+            ConfigurationSpecification::ConvertData(itdata, newspec, _vgridq.begin()+i*ndof, posspec, 1, GetEnv(), false);
+            dReal sd = RaveSqrt(std::max(dReal(0), _vgridx[i]));
+            for(int j = 0; j < ndof; ++j) {
+                vvel[j] = _vgriddq[i*ndof+j]*sd;
+            }
+            ConfigurationSpecification::ConvertData(itdata, newspec, vvel.begin(), velspec, 1, GetEnv(), false);
+            dReal deltatime = 0;
+            if( i > 0 ) {
+                dReal sdsum = RaveSqrt(std::max(dReal(0), _vgridx[i-1])) + sd;
+                deltatime = 2*(_vgrids[i] - _vgrids[i-1])/std::max(sdsum, g_fEpsilon);
+            }
+            *(itdata + ittimegroup->offset) = deltatime;
+        }
+    }
+
+    void _WriteTrajectory(TrajectoryBasePtr ptraj, const ConfigurationSpecification& newspec, const std::vector<dReal>& data)
+    {
+        ptraj->Init(newspec);
+        ptraj->Insert(0, data);
+    }
+
+    bool _SetGridSizeCommand(std::ostream& sout, std::istream& sinput)
+    {
+        int ngridsize = 0;
+        sinput >> ngridsize;
+        if( !sinput || ngridsize <= 0 ) {
+            return false;
+        }
+        _nGridSize = ngridsize;
+        return true;
+    }
+
+    bool _SetUseTorqueLimitsCommand(std::ostream& sout, std::istream& sinput)
+    {
+        sinput >> _bUseTorqueLimits;
+        return !!sinput;
+    }
+
+    static const dReal g_fMaxPathSpeedSqr; ///< bound on x when no constraint limits the path speed, for example where the path does not move
+    static const dReal g_fEpsilonAlpha; ///< coefficients of u below this are considered 0
+    static const dReal g_fEpsilonLinear; ///< tolerance when intersecting the bounds of x
+
+    ConstraintTrajectoryTimingParametersPtr _parameters;
+    boost::shared_ptr<ManipConstraintChecker2> _manipconstraintchecker;
+    std::list<TorqueLimitedBody> _listtorquebodies;
+    int _nGridSize; ///< number of grid intervals of the whole path
+    bool _bUseTorqueLimits;
+    bool _bmanipconstraints;
+
+    // cache
+    std::vector<dReal> _vgrids, _vgridq, _vgriddq, _vgridddq; ///< path parameter, q(s), q'(s), q''(s) of every grid point
+    std::vector<dReal> _vgridxmax, _vgridxlower, _vgridxupper, _vgridx; ///< bound on x, controllable set, and x of the parameterization of every grid point
+    std::vector<HalfPlane> _vhalfplanes; ///< constraints of all the grid points
+    std::vector<size_t> _vgridhalfplanestart; ///< the constraints of grid point i are in [_vgridhalfplanestart[i], _vgridhalfplanestart[i+1])
+    std::vector< std::pair<dReal, dReal> > _vlowerbounds, _vupperbounds;
+    std::vector<dReal> _vidvalues, _vidvelocities, _vidaccelerations, _vidtorques;
+    KinBody::InverseDynamicsWorkspace _idworkspace;
+    std::vector<dReal> _vtempdata, _vnewdata;
+    std::vector<dReal> _vtrajdata, _vwaypointtimes, _vsample, _vvel0, _vvel1; ///< raw waypoints of a timed input trajectory, their times, and samples of the path
+};
+
+const dReal ToppraTrajectoryRetimer::g_fMaxPathSpeedSqr = 1e12;
+const dReal ToppraTrajectoryRetimer::g_fEpsilonAlpha = 1e-10;
+const dReal ToppraTrajectoryRetimer::g_fEpsilonLinear = 1e-9;
+
+PlannerBasePtr CreateToppraTrajectoryRetimer(EnvironmentBasePtr penv, std::istream& sinput)
+{
+    return PlannerBasePtr(new ToppraTrajectoryRetimer(penv, sinput));
+}
+
+} // end namespace rplanners
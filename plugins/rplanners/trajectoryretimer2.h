@@ -101,8 +101,10 @@ public:
 
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj, int planningoptions) override
     {
+        OPENRAVE_TRACE_SCOPE("TrajectoryRetimer2::PlanPath");
         // TODO there's a lot of info that is being recomputed which could be cached depending on the configurationspace of the incoming trajectory
         BOOST_ASSERT(!!_parameters && !!ptraj && ptraj->GetEnv()==GetEnv());
+        PlannerProfile::StageTimer profiletimer(_parameters->_profile.get(), PlannerProfile::PPS_Retiming);
         BOOST_ASSERT(_parameters->GetDOF() == _parameters->_configurationspecification.GetDOF());
         std::vector<ConfigurationSpecification::Group>::const_iterator itoldgrouptime = ptraj->GetConfigurationSpecification().FindCompatibleGroup("deltatime",false);
         if( _parameters->_hastimestamps && itoldgrouptime == ptraj->GetConfigurationSpecification()._vgroups.end() ) {
@@ -179,6 +181,7 @@ public:
             if( _cachedoldspec != _parameters->_configurationspecification || posinterpolation != _cachedposinterpolation ) {
                 _listgroupinfo.clear();
                 _listmintimefns.clear();
+                _listbatchmintimefns.clear();
                 _listvelocityfns.clear();
                 _listcheckvelocityfns.clear();
                 _listwritefns.clear();
@@ -238,12 +241,15 @@ public:
                         // if _parameters->_hastimestamps, then use this for double checking that times are feasible
                         if( igrouptype == 0 ) {
                             _listmintimefns.push_back(boost::bind(&TrajectoryRetimer2::_ComputeMinimumTimeJointValues,this,_listgroupinfo.back(),_1,_2,_3,_4));
+                            _listbatchmintimefns.push_back(boost::bind(&TrajectoryRetimer2::_ComputeMinimumTimesJointValues,this,_listgroupinfo.back(),_1,_2));
                         }
                         else if( igrouptype == 1 ) {
                             _listmintimefns.push_back(boost::bind(&TrajectoryRetimer2::_ComputeMinimumTimeAffine,this,_listgroupinfo.back(),affinedofs,_1,_2,_3,_4));
+                            _listbatchmintimefns.push_back(boost::function<bool(size_t, std::vector<dReal>::iterator)>());
                         }
                         else if( igrouptype == 2 ) {
                             _listmintimefns.push_back(boost::bind(&TrajectoryRetimer2::_ComputeMinimumTimeIk,this,_listgroupinfo.back(),iktype,_1,_2,_3,_4));
+                            _listbatchmintimefns.push_back(boost::function<bool(size_t, std::vector<dReal>::iterator)>());
                         }
                     }
 
@@ -327,6 +333,16 @@ public:
                 ptraj->GetWaypoints(0,numpoints,_vtempdata0,velspec);
                 ConfigurationSpecification::ConvertData(_vdata.begin(),_cachednewspec,_vtempdata0.begin(),velspec,numpoints,GetEnv(),false);
             }
+            // groups that support it compute the minimum times of all their segments at once, the others are computed point by point in the loop below
+            _vbatchmintimes.resize(_listmintimefns.size()*numpoints);
+            _vbatchcomputed.assign(_listmintimefns.size(), 0);
+            if( !_parameters->_hastimestamps || !_parameters->_hasvelocities ) {
+                size_t igroup = 0;
+                FOREACH(itbatch, _listbatchmintimefns) {
+                    _vbatchcomputed[igroup] = !!(*itbatch) && (*itbatch)(numpoints, _vbatchmintimes.begin()+igroup*numpoints);
+                    ++igroup;
+                }
+            }
             try {
                 std::vector<dReal>::iterator itorgdiff = _vdiffdata.begin()+_cachedoldspec.GetDOF();
                 std::vector<dReal>::iterator itdataprev = itdata;
@@ -348,8 +364,10 @@ public:
                         }
                     }
                     else {
+                        size_t igroup = 0;
                         FOREACH(itmin, _listmintimefns) {
-                            dReal fgrouptime = (*itmin)(itorgdiff, itdataprev, itdata,bUseEndVelocity);
+                            dReal fgrouptime = _vbatchcomputed[igroup] ? _vbatchmintimes[igroup*numpoints+i] : (*itmin)(itorgdiff, itdataprev, itdata,bUseEndVelocity);
+                            ++igroup;
                             if( fgrouptime < 0 ) {
                                 std::string description = str(boost::format("env=%d, point %d/%d has uncomputable minimum time, possibly due to boundary constraints")%GetEnv()->GetId()%i%numpoints);
                                 RAVELOG_VERBOSE(description);
@@ -444,6 +462,13 @@ protected:
 
     /// \brief compute the minimum time to achieve the point. returns a mintime>=0 if successeeded, otherwise returns value < 0.
     virtual dReal _ComputeMinimumTimeJointValues(GroupInfoConstPtr info, std::vector<dReal>::const_iterator itorgdiff, std::vector<dReal>::const_iterator itdataprev, std::vector<dReal>::const_iterator itdata, bool bUseEndVelocity) = 0;
+    /// \brief compute the minimum times of all the segments of the group at once, before any velocity is written to the data.
+    ///
+    /// itmintimes[i] receives the minimum time from point i-1 to point i, or a value < 0 if it cannot be computed.
+    /// \return false if the minimum times depend on the data written by the previous segments, in which case _ComputeMinimumTimeJointValues is called for every point
+    virtual bool _ComputeMinimumTimesJointValues(GroupInfoConstPtr info, size_t numpoints, std::vector<dReal>::iterator itmintimes) {
+        return false;
+    }
     /// \brief given the delta time, compute the velocities in the data
     virtual void _ComputeVelocitiesJointValues(GroupInfoConstPtr info, std::vector<dReal>::const_iterator itorgdiff, std::vector<dReal>::const_iterator itdataprev, std::vector<dReal>::iterator itdata) = 0;
     /// \brief given the computed deltatime and velocities at each point, check position, velocity, and acceleration limits
@@ -487,6 +512,7 @@ protected:
     ConfigurationSpecification _cachedoldspec, _cachednewspec; ///< the configuration specification that the cached structures have been set for
     std::string _cachedposinterpolation;
     std::list< boost::function<dReal(std::vector<dReal>::const_iterator,std::vector<dReal>::const_iterator,std::vector<dReal>::const_iterator,bool) > > _listmintimefns;
+    std::list< boost::function<bool(size_t, std::vector<dReal>::iterator) > > _listbatchmintimefns; ///< same order as _listmintimefns, empty if the group has no batch computation
     std::list< boost::function<void(std::vector<dReal>::const_iterator,std::vector<dReal>::const_iterator,std::vector<dReal>::iterator) > > _listvelocityfns;
     std::list< boost::function<bool(std::vector<dReal>::const_iterator,std::vector<dReal>::iterator, int) > > _listcheckvelocityfns;
     std::list< boost::function<bool(std::vector<dReal>::const_iterator,std::vector<dReal>::const_iterator,std::vector<dReal>::iterator) > > _listwritefns;
@@ -495,6 +521,8 @@ protected:
     int _timeoffset;
     std::list<GroupInfoPtr> _listgroupinfo;
     vector<dReal> _vtempdata0, _vtempdata1;
+    std::vector<dReal> _vbatchmintimes; ///< for every group of _listmintimefns, the minimum times of all the segments when _vbatchcomputed is set
+    std::vector<uint8_t> _vbatchcomputed;
 
     bool _bmanipconstraints; /// if true, check workspace manip constraints
 };
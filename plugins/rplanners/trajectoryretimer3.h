@@ -119,9 +119,11 @@ public:
 
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj)
     {
+        OPENRAVE_TRACE_SCOPE("TrajectoryRetimer3::PlanPath");
         // TODO: only works with quintic interpolation now
         // Idea: this trajectory retimer supports interpolation of order at least quintic. velocities and accelerations if not provided will be set to zero. there is no need to have ComputeVelocityX functions since any velocities and accelerations will always result in a valid interpolation.
         BOOST_ASSERT(!!_parameters && !!ptraj && ptraj->GetEnv() == GetEnv());
+        PlannerProfile::StageTimer profiletimer(_parameters->_profile.get(), PlannerProfile::PPS_Retiming);
         BOOST_ASSERT(_parameters->GetDOF() == _parameters->_configurationspecification.GetDOF());
 
         std::vector<ConfigurationSpecification::Group>::const_iterator itTimeGroup = ptraj->GetConfigurationSpecification().FindCompatibleGroup("deltatime", false);
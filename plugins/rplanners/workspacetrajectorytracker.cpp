@@ -40,8 +40,11 @@ Planner Parameters\n\
 - **TrajectoryBasePtr workspacetraj** - workspace trajectory of the end effector, needs to hold 'ikparam_values' groups\n\
 \n\
 ";
+        RegisterCommand("SetJacobianTracking",boost::bind(&WorkspaceTrajectoryTracker::_SetJacobianTrackingCommand,this,_1,_2),
+                        "if 1, tracks the workspace trajectory with damped least squares steps warm started from the previous configuration instead of calling the ik solver at every sample. The factorization of the jacobian is reused while the steps converge, and the environment collisions are checked once per chunk of samples. Default is 0.");
         _report.reset(new CollisionReport());
         _filteroptions = 0;
+        _bJacobianTracking = false;
     }
     virtual ~WorkspaceTrajectoryTracker() {
     }
@@ -137,6 +140,7 @@ Planner Parameters\n\
 
     virtual PlannerStatus PlanPath(TrajectoryBasePtr poutputtraj, int planningoptions) override
     {
+        OPENRAVE_TRACE_SCOPE("WorkspaceTrajectoryTracker::PlanPath");
         if(!_parameters) {
             std::string description = "WorkspaceTrajectoryTracker::PlanPath - Error, planner not initialized\n";
             RAVELOG_ERROR(description);
@@ -239,6 +243,14 @@ Planner Parameters\n\
             poutputtraj->Insert(poutputtraj->GetNumWaypoints(),_parameters->vinitialconfig,_parameters->_configurationspecification);
         }
 
+        if( _bJacobianTracking ) {
+            PlannerStatus trackstatus = _TrackWithJacobian(poutputtraj, listtransforms, fstarttime, minimumcompletetime);
+            if( !trackstatus.HasSolution() ) {
+                return trackstatus;
+            }
+            return _RetimeOutputTrajectory(poutputtraj, basetime);
+        }
+
         UserDataPtr filterhandle = _manip->GetIkSolver()->RegisterCustomFilter(0,boost::bind(&WorkspaceTrajectoryTracker::_ValidateSolution,this,_1,_2,_3));
         vector<dReal> vsolution;
         if( !_parameters->greedysearch ) {
@@ -251,14 +263,14 @@ Planner Parameters\n\
         for(; ittrans != listtransforms.end(); ftime += _parameters->_fStepLength, ++ittrans) {
             _filteroptions = (ftime >= fstarttime) ? IKFO_CheckEnvCollisions : 0;
             IkParameterization ikparam1(*ittrans,IKP_Transform6D);
-            if( !_manip->FindIKSolution(ikparam1,vsolution,_filteroptions) ) {
+            if( !_FindIKSolution(ikparam1,vsolution,_filteroptions) ) {
                 if( _filteroptions == 0 ) {
                     // haven't even checked with environment collisions, so a solution really doesn't exist
                     return PlannerStatus(PS_Failed);
                 }
                 if(( ftime < _parameters->ignorefirstcollision) && bPrevInCollision ) {
                     _filteroptions = 0;
-                    if( !_manip->FindIKSolution(ikparam1,vsolution,_filteroptions) ) {
+                    if( !_FindIKSolution(ikparam1,vsolution,_filteroptions) ) {
                         return PlannerStatus(PS_Failed);
                     }
                 }
@@ -288,6 +300,16 @@ Planner Parameters\n\
             return PlannerStatus("bPrevInCollision" ,PS_Failed);
         }
 
+        return _RetimeOutputTrajectory(poutputtraj, basetime);
+    }
+
+    virtual PlannerParametersConstPtr GetParameters() const {
+        return _parameters;
+    }
+
+protected:
+    PlannerStatus _RetimeOutputTrajectory(TrajectoryBasePtr poutputtraj, uint32_t basetime)
+    {
         if( !_retimerplanner->InitPlan(RobotBasePtr(),_parameters).HasSolution() || !_retimerplanner->PlanPath(poutputtraj).HasSolution() ) {
             return PlannerStatus(PS_Failed);
         }
@@ -296,11 +318,215 @@ Planner Parameters\n\
         return PlannerStatus(PS_HasSolution);
     }
 
-    virtual PlannerParametersConstPtr GetParameters() const {
-        return _parameters;
+    /// \brief follows listtransforms with damped least squares steps starting from the current configuration and appends the configurations to poutputtraj.
+    ///
+    /// Consecutive samples are close, so the factorization of J*J^T + damping computed at the previous configuration is reused
+    /// as long as the steps keep converging fast, and is only recomputed when they do not. Environment collisions are checked
+    /// for every chunk of samples with the same ignorefirstcollision and minimumcompletetime rules as the ik mode.
+    PlannerStatus _TrackWithJacobian(TrajectoryBasePtr poutputtraj, const std::list<Transform>& listtransforms, dReal fstarttime, dReal minimumcompletetime)
+    {
+        const int ndof = _parameters->GetDOF();
+        std::vector<dReal>& q = _vtrackconfig;
+        if( (int)_parameters->vinitialconfig.size() == ndof ) {
+            q = _parameters->vinitialconfig;
+        }
+        else {
+            // no initial configuration, so start from the ik solution of the first sample
+            if( !_FindIKSolution(IkParameterization(listtransforms.front(),IKP_Transform6D),q,0) ) {
+                return PlannerStatus("no ik solution for the start of the workspace trajectory", PS_Failed);
+            }
+            if( _parameters->SetStateValues(q) != 0 ) {
+                return PlannerStatus("failed to set initial state", PS_Failed);
+            }
+        }
+
+        _vtrackconfig2.resize(ndof);
+        _vchunkconfigs.resize(0);
+        _vchunktimes.resize(0);
+        _vchunkstart = q;
+        bool bPrevInCollision = true;
+        bool bHasFactorization = false;
+        dReal ftime = 0;
+        std::list<Transform>::const_iterator ittrans = listtransforms.begin();
+        for(; ittrans != listtransforms.end(); ftime += _parameters->_fStepLength, ++ittrans) {
+            bool bConverged = false;
+            dReal fpreverror2 = 0;
+            for(int iter = 0; iter < s_nMaxJacobianIterations; ++iter) {
+                Transform tcur = _manip->GetTransform();
+                Vector vrotquat = quatMultiply(ittrans->rot, quatInverse(tcur.rot));
+                if( vrotquat.x < 0 ) {
+                    vrotquat = -vrotquat;
+                }
+                Vector vtranserror = ittrans->trans - tcur.trans;
+                Vector vroterror = axisAngleFromQuat(vrotquat);
+                dReal ferror[6] = {vtranserror.x, vtranserror.y, vtranserror.z, vroterror.x, vroterror.y, vroterror.z};
+                dReal ferror2 = vtranserror.lengthsqr3() + vroterror.lengthsqr3();
+                if( ferror2 <= s_fJacobianToleranceSqr ) {
+                    bConverged = true;
+                    break;
+                }
+                if( bHasFactorization && iter > 0 && ferror2 > 0.0625*fpreverror2 ) {
+                    // the reused factorization does not converge fast enough anymore
+                    bHasFactorization = false;
+                }
+                fpreverror2 = ferror2;
+                if( !bHasFactorization ) {
+                    _ComputeJacobianFactorization(ndof);
+                    bHasFactorization = true;
+                }
+                // dq = J^T (J J^T + damping)^-1 error
+                _SolveFactorization(ferror);
+                for(int j = 0; j < ndof; ++j) {
+                    dReal dq = 0;
+                    for(int i = 0; i < 3; ++i) {
+                        dq += _vtrackjacobian[i*ndof+j]*ferror[i] + _vtrackangularjacobian[i*ndof+j]*ferror[3+i];
+                    }
+                    q[j] += dq;
+                }
+                if( _parameters->SetStateValues(q) != 0 ) {
+                    break;
+                }
+                for(int j = 0; j < ndof; ++j) {
+                    if( q[j] < _parameters->_vConfigLowerLimit[j] - g_fEpsilonJointLimit || q[j] > _parameters->_vConfigUpperLimit[j] + g_fEpsilonJointLimit ) {
+                        iter = s_nMaxJacobianIterations;
+                        break;
+                    }
+                }
+            }
+            if( !bConverged ) {
+                if( !bPrevInCollision && ftime >= minimumcompletetime ) {
+                    break;
+                }
+                return PlannerStatus(str(boost::format("jacobian tracking did not converge at time %f")%ftime), PS_Failed);
+            }
+            _vchunkconfigs.insert(_vchunkconfigs.end(), q.begin(), q.end());
+            _vchunktimes.push_back(ftime);
+            if( (int)_vchunktimes.size() >= s_nCollisionChunkSize ) {
+                int ret = _FlushChunk(poutputtraj, fstarttime, minimumcompletetime, bPrevInCollision);
+                if( ret < 0 ) {
+                    return PlannerStatus(str(boost::format("collision while tracking at time %f")%ftime), PS_Failed);
+                }
+                if( ret > 0 ) {
+                    return PlannerStatus(PS_HasSolution);
+                }
+                // the state was changed by the collision checks
+                if( _parameters->SetStateValues(q) != 0 ) {
+                    return PlannerStatus("failed to set state", PS_Failed);
+                }
+            }
+        }
+        if( _vchunktimes.size() > 0 && _FlushChunk(poutputtraj, fstarttime, minimumcompletetime, bPrevInCollision) < 0 ) {
+            return PlannerStatus(str(boost::format("collision while tracking at time %f")%ftime), PS_Failed);
+        }
+        if( bPrevInCollision ) {
+            return PlannerStatus("bPrevInCollision" ,PS_Failed);
+        }
+        return PlannerStatus(PS_HasSolution);
+    }
+
+    /// \brief checks the segments of the chunk and appends the valid configurations to poutputtraj with one Insert call.
+    ///
+    /// \return 0 if the whole chunk is valid, 1 if the trajectory has to stop before a colliding configuration after minimumcompletetime, -1 if it is in collision
+    int _FlushChunk(TrajectoryBasePtr poutputtraj, dReal fstarttime, dReal minimumcompletetime, bool& bPrevInCollision)
+    {
+        const int ndof = _parameters->GetDOF();
+        FOREACH(it,_vchildlinks) {
+            (*it)->Enable(true);
+        }
+        int ret = 0;
+        size_t numvalid = 0;
+        for(; numvalid < _vchunktimes.size(); ++numvalid) {
+            const dReal ftime = _vchunktimes[numvalid];
+            std::copy(_vchunkconfigs.begin()+numvalid*ndof, _vchunkconfigs.begin()+(numvalid+1)*ndof, _vtrackconfig2.begin());
+            if( ftime < fstarttime || _parameters->CheckPathAllConstraints(_vchunkstart, _vtrackconfig2, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart) == 0 ) {
+                bPrevInCollision = false;
+            }
+            else if( ftime < _parameters->ignorefirstcollision && bPrevInCollision ) {
+                // allowed to be in collision at the start
+            }
+            else {
+                ret = (!bPrevInCollision && ftime >= minimumcompletetime) ? 1 : -1;
+                break;
+            }
+            _vchunkstart = _vtrackconfig2;
+        }
+        FOREACH(it,_vchildlinks) {
+            (*it)->Enable(false);
+        }
+        if( ret >= 0 && numvalid > 0 ) {
+            _vchunkconfigs.resize(numvalid*ndof);
+            poutputtraj->Insert(poutputtraj->GetNumWaypoints(),_vchunkconfigs,_parameters->_configurationspecification);
+        }
+        _vchunkconfigs.resize(0);
+        _vchunktimes.resize(0);
+        return ret;
+    }
+
+    /// \brief calls FindIKSolution of the manipulator and adds its time to the profile of the parameters
+    bool _FindIKSolution(const IkParameterization& ikparam, std::vector<dReal>& solution, int filteroptions)
+    {
+        PlannerProfile::StageTimer timer(_parameters->_profile.get(), PlannerProfile::PPS_IK);
+        return _manip->FindIKSolution(ikparam, solution, filteroptions);
+    }
+
+    /// \brief computes the jacobian at the current state and the cholesky factorization of J*J^T + damping
+    void _ComputeJacobianFactorization(int ndof)
+    {
+        _manip->CalculateJacobian(_vtrackjacobian);
+        _manip->CalculateAngularVelocityJacobian(_vtrackangularjacobian);
+        for(int i = 0; i < 6; ++i) {
+            const dReal* pi = i < 3 ? &_vtrackjacobian[i*ndof] : &_vtrackangularjacobian[(i-3)*ndof];
+            for(int k = 0; k <= i; ++k) {
+                const dReal* pk = k < 3 ? &_vtrackjacobian[k*ndof] : &_vtrackangularjacobian[(k-3)*ndof];
+                dReal f = 0;
+                for(int j = 0; j < ndof; ++j) {
+                    f += pi[j]*pk[j];
+                }
+                _jjtcholesky[i*6+k] = f;
+            }
+            _jjtcholesky[i*6+i] += s_fJacobianDamping*s_fJacobianDamping;
+        }
+        // in-place cholesky of the lower triangle, J*J^T + damping is positive definite
+        for(int k = 0; k < 6; ++k) {
+            dReal fdiag = _jjtcholesky[k*6+k];
+            for(int j = 0; j < k; ++j) {
+                fdiag -= _jjtcholesky[k*6+j]*_jjtcholesky[k*6+j];
+            }
+            fdiag = RaveSqrt(std::max(fdiag, g_fEpsilon));
+            _jjtcholesky[k*6+k] = fdiag;
+            for(int i = k+1; i < 6; ++i) {
+                dReal f = _jjtcholesky[i*6+k];
+                for(int j = 0; j < k; ++j) {
+                    f -= _jjtcholesky[i*6+j]*_jjtcholesky[k*6+j];
+                }
+                _jjtcholesky[i*6+k] = f/fdiag;
+            }
+        }
+    }
+
+    /// \brief solves (L L^T) x = b in place with the factorization of _ComputeJacobianFactorization
+    void _SolveFactorization(dReal b[6]) const
+    {
+        for(int i = 0; i < 6; ++i) {
+            for(int j = 0; j < i; ++j) {
+                b[i] -= _jjtcholesky[i*6+j]*b[j];
+            }
+            b[i] /= _jjtcholesky[i*6+i];
+        }
+        for(int i = 5; i >= 0; --i) {
+            for(int j = i+1; j < 6; ++j) {
+                b[i] -= _jjtcholesky[j*6+i]*b[j];
+            }
+            b[i] /= _jjtcholesky[i*6+i];
+        }
+    }
+
+    bool _SetJacobianTrackingCommand(std::ostream& sout, std::istream& sinput)
+    {
+        sinput >> _bJacobianTracking;
+        return !!sinput;
     }
 
-protected:
     void _SetPreviousSolution(const std::vector<dReal>& vsolution, bool bsetjacobian=true)
     {
         if( bsetjacobian ) {
@@ -438,8 +664,21 @@ protected:
     IkParameterization _ikprev;
     vector<dReal> _vprevsolution;
     PlannerBasePtr _retimerplanner;
+
+    // jacobian tracking
+    static const int s_nMaxJacobianIterations = 20;
+    static const int s_nCollisionChunkSize = 16; ///< number of samples whose collisions are checked together
+    static const dReal s_fJacobianDamping; ///< damping of the least squares steps
+    static const dReal s_fJacobianToleranceSqr; ///< squared error of the end effector pose at which a sample is reached
+    bool _bJacobianTracking;
+    vector<dReal> _vtrackconfig, _vtrackconfig2, _vtrackjacobian, _vtrackangularjacobian;
+    vector<dReal> _vchunkconfigs, _vchunktimes, _vchunkstart;
+    boost::array<dReal,36> _jjtcholesky; ///< lower triangular cholesky factor of J*J^T + damping
 };
 
+const dReal WorkspaceTrajectoryTracker::s_fJacobianDamping = 1e-3;
+const dReal WorkspaceTrajectoryTracker::s_fJacobianToleranceSqr = 1e-12;
+
 PlannerBasePtr CreateWorkspaceTrajectoryTracker(EnvironmentBasePtr penv, std::istream& sinput) {
     return PlannerBasePtr(new WorkspaceTrajectoryTracker(penv, sinput));
 }
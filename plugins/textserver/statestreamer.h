@@ -0,0 +1,318 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2011 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef OPENRAVE_STATESTREAMER
+#define OPENRAVE_STATESTREAMER
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/// \brief streams the published body states to every connected client as quantized deltas.
+///
+/// Every tick, a client receives a frame of a 4 byte little endian size followed by varints:
+/// \verbatim
+/// tick numremoved [environmentid]* numchanged [environmentid flags ([name] numlinks numdofs)? [linkposes]? [dofvalues]?]*
+/// \endverbatim
+/// flags is a combination of 1 (new body, followed by its name as length and bytes, its number of links and dofs), 2 (link poses follow)
+/// and 4 (dof values follow). Link poses are 3 translations in units of the translation resolution followed by 4 quaternion values
+/// in units of 1/32767, the dof values are in units of the dof resolution. All of them are zigzag encoded differences from the values
+/// last sent to the client, which start at 0 for a new body. Bodies are only sent when a value moved more than its threshold
+/// since the last time it was sent, and ticks without changes are not sent. The states come from EnvironmentBase::GetPublishedBodies,
+/// so they are as recent as the last UpdatePublishedBodies.
+class StateStreamer : public ModuleBase
+{
+    /// \brief quantized state of a body as last sent to a client
+    struct SentBodyState
+    {
+        std::vector<int32_t> vlinkposes; ///< 7 values per link
+        std::vector<int32_t> vdofvalues;
+    };
+
+    struct Client
+    {
+        int sockfd = 0;
+        std::map<int, SentBodyState> mapSentBodies; ///< environment body index -> last sent state
+    };
+
+public:
+    StateStreamer(EnvironmentBasePtr penv) : ModuleBase(penv), _server_sockfd(0), _bStop(false), _fTickTime(0.05), _fTranslationResolution(0.0001), _fDOFResolution(0.0001), _translationThreshold(10), _quaternionThreshold(10), _dofThreshold(10), _tick(0) {
+        __description = "Streams the published body states over a socket as quantized deltas. main takes \"port [ticktime] [translationthreshold] [quaternionthreshold] [dofthreshold]\", the thresholds are in meters, quaternion units and dof units.";
+    }
+
+    virtual ~StateStreamer() {
+        Destroy();
+    }
+
+    virtual int main(const std::string& cmd)
+    {
+        Destroy();
+
+        int port = 4766;
+        dReal fTranslationThreshold = 0.001, fQuaternionThreshold = 0.0003, fDOFThreshold = 0.001;
+        std::stringstream ss(cmd);
+        ss >> port >> _fTickTime >> fTranslationThreshold >> fQuaternionThreshold >> fDOFThreshold;
+        _translationThreshold = (int32_t)(fTranslationThreshold/_fTranslationResolution);
+        _quaternionThreshold = (int32_t)(fQuaternionThreshold*32767);
+        _dofThreshold = (int32_t)(fDOFThreshold/_fDOFResolution);
+
+        struct sockaddr_in server_address;
+        memset(&server_address, 0, sizeof(server_address));
+        _server_sockfd = socket(AF_INET, SOCK_STREAM, 0);
+        server_address.sin_family = AF_INET;
+        server_address.sin_addr.s_addr = htonl(INADDR_ANY);
+        server_address.sin_port = htons(port);
+        int yes = 1;
+        setsockopt(_server_sockfd, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(int));
+        if( ::bind(_server_sockfd, (struct sockaddr *)&server_address, sizeof(server_address)) != 0 || ::listen(_server_sockfd, 16) != 0 ) {
+            RAVELOG_ERROR_FORMAT("failed to listen to state stream port %d", port);
+            CLOSESOCKET(_server_sockfd);
+            _server_sockfd = 0;
+            return -1;
+        }
+#ifdef _WIN32
+        u_long flags = 1;
+        ioctlsocket(_server_sockfd, FIONBIO, &flags);
+#else
+        fcntl(_server_sockfd, F_SETFL, fcntl(_server_sockfd, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+        RAVELOG_DEBUG_FORMAT("streaming body states on port %d", port);
+        _bStop = false;
+        _thread = std::thread(&StateStreamer::_StreamThread, this);
+        return 0;
+    }
+
+    virtual void Destroy()
+    {
+        if( _thread.joinable() ) {
+            _bStop = true;
+            _thread.join();
+        }
+        for (Client& client : _vclients) {
+            CLOSESOCKET(client.sockfd);
+        }
+        _vclients.clear();
+        if( _server_sockfd != 0 ) {
+            CLOSESOCKET(_server_sockfd);
+            _server_sockfd = 0;
+        }
+    }
+
+private:
+    void _StreamThread()
+    {
+        std::vector<KinBody::BodyState> vbodystates;
+        std::vector<int32_t> vlinkposes, vdofvalues;
+        std::string frame;
+        while(!_bStop) {
+            const std::chrono::steady_clock::time_point starttime = std::chrono::steady_clock::now();
+            _AcceptClients();
+            if( _vclients.size() > 0 ) {
+                GetEnv()->GetPublishedBodies(vbodystates);
+                ++_tick;
+                for(size_t iclient = 0; iclient < _vclients.size(); ) {
+                    _EncodeFrame(_vclients[iclient], vbodystates, vlinkposes, vdofvalues, frame);
+                    if( frame.size() > 0 && !_Send(_vclients[iclient].sockfd, frame) ) {
+                        RAVELOG_DEBUG("state stream client disconnected\n");
+                        CLOSESOCKET(_vclients[iclient].sockfd);
+                        _vclients.erase(_vclients.begin() + iclient);
+                        continue;
+                    }
+                    ++iclient;
+                }
+            }
+            std::this_thread::sleep_until(starttime + std::chrono::duration<double>(_fTickTime));
+        }
+    }
+
+    void _AcceptClients()
+    {
+        while(true) {
+            struct sockaddr_in client_address;
+            socklen_t client_len = sizeof(client_address);
+            int sockfd = accept(_server_sockfd, (struct sockaddr *)&client_address, &client_len);
+            if( sockfd == -1 ) {
+                return;
+            }
+            Client client;
+            client.sockfd = sockfd;
+            _vclients.push_back(client);
+        }
+    }
+
+    /// \brief encodes the bodies that moved beyond the thresholds since they were sent to the client, and updates the sent states
+    ///
+    /// \param frame set to the frame to send, empty if nothing changed
+    void _EncodeFrame(Client& client, const std::vector<KinBody::BodyState>& vbodystates, std::vector<int32_t>& vlinkposes, std::vector<int32_t>& vdofvalues, std::string& frame)
+    {
+        std::string removed, changed;
+        uint32_t numRemoved = 0, numChanged = 0;
+        std::set<int> setPresentIds;
+        for (const KinBody::BodyState& bodystate : vbodystates) {
+            setPresentIds.insert(bodystate.environmentid);
+            _Quantize(bodystate, vlinkposes, vdofvalues);
+
+            std::map<int, SentBodyState>::iterator itsent = client.mapSentBodies.find(bodystate.environmentid);
+            const bool bNew = itsent == client.mapSentBodies.end() || itsent->second.vlinkposes.size() != vlinkposes.size() || itsent->second.vdofvalues.size() != vdofvalues.size();
+            if( bNew ) {
+                SentBodyState& sent = client.mapSentBodies[bodystate.environmentid];
+                sent.vlinkposes.assign(vlinkposes.size(), 0);
+                sent.vdofvalues.assign(vdofvalues.size(), 0);
+                itsent = client.mapSentBodies.find(bodystate.environmentid);
+            }
+            SentBodyState& sent = itsent->second;
+            const bool bLinksChanged = bNew || _HasChanged(sent.vlinkposes, vlinkposes, true);
+            const bool bDOFsChanged = bNew || _HasChanged(sent.vdofvalues, vdofvalues, false);
+            if( !bLinksChanged && !bDOFsChanged ) {
+                continue;
+            }
+
+            ++numChanged;
+            _WriteVarint(changed, (uint32_t)bodystate.environmentid);
+            _WriteVarint(changed, (bNew ? 1 : 0)|(bLinksChanged ? 2 : 0)|(bDOFsChanged ? 4 : 0));
+            if( bNew ) {
+                _WriteVarint(changed, (uint32_t)bodystate.strname.size());
+                changed += bodystate.strname;
+                _WriteVarint(changed, (uint32_t)(vlinkposes.size()/7));
+                _WriteVarint(changed, (uint32_t)vdofvalues.size());
+            }
+            if( bLinksChanged ) {
+                _WriteDeltas(changed, sent.vlinkposes, vlinkposes);
+            }
+            if( bDOFsChanged ) {
+                _WriteDeltas(changed, sent.vdofvalues, vdofvalues);
+            }
+        }
+        for(std::map<int, SentBodyState>::iterator itsent = client.mapSentBodies.begin(); itsent != client.mapSentBodies.end(); ) {
+            if( setPresentIds.count(itsent->first) == 0 ) {
+                ++numRemoved;
+                _WriteVarint(removed, (uint32_t)itsent->first);
+                itsent = client.mapSentBodies.erase(itsent);
+            }
+            else {
+                ++itsent;
+            }
+        }
+
+        frame.resize(0);
+        if( numRemoved == 0 && numChanged == 0 ) {
+            return;
+        }
+        frame.resize(4);
+        _WriteVarint(frame, _tick);
+        _WriteVarint(frame, numRemoved);
+        frame += removed;
+        _WriteVarint(frame, numChanged);
+        frame += changed;
+        const uint32_t size = frame.size() - 4;
+        for(int i = 0; i < 4; ++i) {
+            frame[i] = (char)((size >> (8*i))&0xff);
+        }
+    }
+
+    void _Quantize(const KinBody::BodyState& bodystate, std::vector<int32_t>& vlinkposes, std::vector<int32_t>& vdofvalues) const
+    {
+        vlinkposes.resize(7*bodystate.vectrans.size());
+        for(size_t ilink = 0; ilink < bodystate.vectrans.size(); ++ilink) {
+            const Transform& t = bodystate.vectrans[ilink];
+            // q and -q are the same rotation, use the one with positive w so that the deltas stay small
+            const dReal fsign = t.rot[0] < 0 ? -1 : 1;
+            int32_t* pvalues = &vlinkposes[7*ilink];
+            for(int i = 0; i < 3; ++i) {
+                pvalues[i] = (int32_t)std::lround(t.trans[i]/_fTranslationResolution);
+            }
+            for(int i = 0; i < 4; ++i) {
+                pvalues[3+i] = (int32_t)std::lround(fsign*t.rot[i]*32767);
+            }
+        }
+        vdofvalues.resize(bodystate.jointvalues.size());
+        for(size_t idof = 0; idof < bodystate.jointvalues.size(); ++idof) {
+            vdofvalues[idof] = (int32_t)std::lround(bodystate.jointvalues[idof]/_fDOFResolution);
+        }
+    }
+
+    /// \brief true if any value moved more than its threshold from the sent one
+    bool _HasChanged(const std::vector<int32_t>& vsent, const std::vector<int32_t>& vvalues, bool bLinkPoses) const
+    {
+        for(size_t i = 0; i < vvalues.size(); ++i) {
+            const int32_t threshold = !bLinkPoses ? _dofThreshold : ((i%7) < 3 ? _translationThreshold : _quaternionThreshold);
+            if( std::abs(vvalues[i] - vsent[i]) > threshold ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// \brief writes the differences of vvalues from vsent and updates vsent
+    static void _WriteDeltas(std::string& output, std::vector<int32_t>& vsent, const std::vector<int32_t>& vvalues)
+    {
+        for(size_t i = 0; i < vvalues.size(); ++i) {
+            const int32_t delta = vvalues[i] - vsent[i];
+            _WriteVarint(output, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+            vsent[i] = vvalues[i];
+        }
+    }
+
+    static void _WriteVarint(std::string& output, uint32_t value)
+    {
+        while(value >= 0x80) {
+            output.push_back((char)((value&0x7f)|0x80));
+            value >>= 7;
+        }
+        output.push_back((char)value);
+    }
+
+    static bool _Send(int sockfd, const std::string& data)
+    {
+        const char* pdata = data.c_str();
+        size_t size = data.size();
+        while(size > 0) {
+            const int nBytesSent = send(sockfd, pdata, size, MSG_NOSIGNAL);
+            if( nBytesSent <= 0 ) {
+                return false;
+            }
+            pdata += nBytesSent;
+            size -= nBytesSent;
+        }
+        return true;
+    }
+
+    int _server_sockfd;
+    std::thread _thread;
+    std::atomic<bool> _bStop;
+    std::vector<Client> _vclients; ///< only used by _thread once started
+    dReal _fTickTime; ///< s
+    dReal _fTranslationResolution, _fDOFResolution; ///< quantization steps
+    int32_t _translationThreshold, _quaternionThreshold, _dofThreshold; ///< in quantization steps
+    uint32_t _tick;
+};
+
+#endif
@@ -16,10 +16,12 @@
 #include "textserverrave.h"
 #include "plugindefs.h"
 #include "textserver.h"
+#include "statestreamer.h"
 
 TextServerPlugin::TextServerPlugin()
 {
     _interfaces[OpenRAVE::PT_Module].push_back("textserver");
+    _interfaces[OpenRAVE::PT_Module].push_back("statestreamer");
 }
 
 TextServerPlugin::~TextServerPlugin() {}
@@ -30,6 +32,8 @@ OpenRAVE::InterfaceBasePtr TextServerPlugin::CreateInterface(OpenRAVE::Interface
     case OpenRAVE::PT_Module:
         if( interfacename == "textserver")
             return boost::make_shared<SimpleTextServer>(penv);
+        if( interfacename == "statestreamer")
+            return boost::make_shared<StateStreamer>(penv);
         break;
     default:
         break;
@@ -17,9 +17,11 @@
 #ifndef OPENRAVE_TEXTSERVER
 #define OPENRAVE_TEXTSERVER
 
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <openrave/planningutils.h>
+#include <openrave/openravemsgpack.h>
 #include <cstdlib>
 #include <boost/bind/bind.hpp>
 
@@ -106,8 +108,10 @@ public:
             return bInit;
         }
 
+        /// \brief sends the 4 byte size followed by the data. Can be called from multiple threads.
         void SendData(const void* pdata, int size_to_write)
         {
+            std::lock_guard<std::mutex> lock(_mutexSend);
             if( client_sockfd == 0 )
                 return;
 
@@ -239,12 +243,67 @@ public:
             return true;
         }
 
+        /// \brief reads a frame of the binary protocol, the 4 byte size followed by the data
+        ///
+        /// \return false if no frame is available or the connection failed
+        bool ReadFrame(string& s)
+        {
+            struct timeval tv;
+            fd_set readfds;
+            s.resize(0);
+
+            tv.tv_sec = 0;
+            tv.tv_usec = 0;
+            FD_ZERO(&readfds);
+            FD_SET(client_sockfd, &readfds);
+            int num = select(client_sockfd+1, &readfds, NULL, NULL, &tv);
+            if (( num == 0) || !FD_ISSET(client_sockfd, &readfds) ) {
+                return false;
+            }
+
+            uint32_t size = 0;
+            if( !_Receive((char*)&size, sizeof(size)) ) {
+                return false;
+            }
+            s.resize(size);
+            return size == 0 || _Receive(&s[0], size);
+        }
+
 private:
+        /// \brief blocks until size bytes are received
+        bool _Receive(char* pdata, int size)
+        {
+            int failed = 0;
+            while(size > 0) {
+                long nBytesReceived = recv(client_sockfd, pdata, size, 0);
+                if( nBytesReceived > 0 ) {
+                    pdata += nBytesReceived;
+                    size -= nBytesReceived;
+                }
+                else if( nBytesReceived == 0 ) {
+                    Close();
+                    return false;
+                }
+                else {
+                    if( failed < 10 ) {
+                        failed++;
+                        usleep(1000);
+                        continue;
+                    }
+                    perror("failed to read frame");
+                    Close();
+                    return false;
+                }
+            }
+            return true;
+        }
+
         int client_sockfd;
         int client_len;
 
         struct sockaddr_in client_address;
         bool bInit;
+        std::mutex _mutexSend; ///< serializes SendData of the threads answering binary requests
     };
     typedef boost::shared_ptr<Socket> SocketPtr;
     typedef boost::shared_ptr<Socket const> SocketConstPtr;
@@ -259,31 +318,46 @@ private:
     /// and one that is executed on the main worker thread to avoid multithreading data synchronization issues
     struct RAVENETWORKFN
     {
-        RAVENETWORKFN() : bReturnResult(false) {
+        RAVENETWORKFN() : bReturnResult(false), bReadOnly(false) {
         }
-        RAVENETWORKFN(const OpenRaveNetworkFn& socket, const OpenRaveWorkerFn& worker, bool bReturnResult_) : fnSocketThread(socket), fnWorker(worker), bReturnResult(bReturnResult_) {
+        RAVENETWORKFN(const OpenRaveNetworkFn& socket, const OpenRaveWorkerFn& worker, bool bReturnResult_, bool bReadOnly_=false) : fnSocketThread(socket), fnWorker(worker), bReturnResult(bReturnResult_), bReadOnly(bReadOnly_) {
         }
 
         OpenRaveNetworkFn fnSocketThread;
         OpenRaveWorkerFn fnWorker;
         bool bReturnResult;     // if true, function is expected to return a result
+        bool bReadOnly;     // if true, only queries the environment, so binary requests run it on the request threads
     };
 
+    /// \brief binary requests of a connection that are still running on the request threads
+    struct PendingRequests
+    {
+        int num = 0;
+        std::mutex mutex;
+        std::condition_variable cond;
+    };
+    typedef boost::shared_ptr<PendingRequests> PendingRequestsPtr;
+
 public:
     SimpleTextServer(EnvironmentBasePtr penv) : ModuleBase(penv) {
         _nIdIndex = 1;
         _nNextFigureId = 1;
         _bWorking = false;
         bDestroying = false;
-        __description=":Interface Author: Rosen Diankov\n\nSimple text-based server using sockets.";
-        mapNetworkFns["body_checkcollision"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvCheckCollision, this, _1, _2, _3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["body_getjoints"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetJointValues, this,_1, _2, _3), OpenRaveWorkerFn(), true);
+        _nRequestThreads = 4;
+        __description=":Interface Author: Rosen Diankov\n\nSimple text-based server using sockets.\n\n\
+Sending the line 'binary' switches the connection to the binary protocol. Every request is then a frame of a 4 byte size followed by a msgpack map \
+{\"id\": uint, \"command\": string, \"args\": string} with the same commands and arguments as the text protocol. Every request is answered with a frame \
+{\"id\": uint, \"success\": bool, \"result\": string}, so clients can pipeline requests. The read-only commands run concurrently on the request threads \
+and can be answered out of order, the other commands run in order after the earlier requests of the connection are answered.";
+        mapNetworkFns["body_checkcollision"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvCheckCollision, this, _1, _2, _3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["body_getjoints"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetJointValues, this,_1, _2, _3), OpenRaveWorkerFn(), true, true);
         mapNetworkFns["body_destroy"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyDestroy,this,_1,_2,_3), OpenRaveWorkerFn(), false);
         mapNetworkFns["body_enable"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyEnable,this,_1,_2,_3), OpenRaveWorkerFn(), false);
-        mapNetworkFns["body_getaabb"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetAABB,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["body_getaabbs"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetAABBs,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["body_getlinks"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetLinks,this,_1,_2,_3),OpenRaveWorkerFn(), true);
-        mapNetworkFns["body_getdof"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetDOF,this,_1,_2,_3),OpenRaveWorkerFn(), true);
+        mapNetworkFns["body_getaabb"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetAABB,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["body_getaabbs"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetAABBs,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["body_getlinks"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetLinks,this,_1,_2,_3),OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["body_getdof"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetDOF,this,_1,_2,_3),OpenRaveWorkerFn(), true, true);
         mapNetworkFns["body_settransform"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orKinBodySetTransform,this,_1,_2,_3),OpenRaveWorkerFn(), false);
         mapNetworkFns["body_setjoints"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodySetJointValues,this,_1,_2,_3), OpenRaveWorkerFn(), false);
         mapNetworkFns["body_setjointtorques"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodySetJointTorques,this,_1,_2,_3), OpenRaveWorkerFn(), false);
@@ -292,24 +366,25 @@ public:
         mapNetworkFns["createbody"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvCreateKinBody,this,_1,_2,_3), OpenRaveWorkerFn(), true);
         mapNetworkFns["createmodule"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvCreateModule,this,_1,_2,_3), boost::bind(&SimpleTextServer::worEnvCreateModule,this,_1,_2), true);
         mapNetworkFns["env_dstrprob"] = RAVENETWORKFN(OpenRaveNetworkFn(), boost::bind(&SimpleTextServer::worEnvDestroyProblem,this,_1,_2), false);
-        mapNetworkFns["env_getbodies"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvGetBodies,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["env_getrobots"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvGetRobots,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["env_getbody"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvGetBody,this,_1,_2,_3), OpenRaveWorkerFn(), true);
+        mapNetworkFns["env_getbodies"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvGetBodies,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["env_getrobots"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvGetRobots,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["env_getbody"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvGetBody,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["env_loaddata"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvLoadData,this,_1,_2,_3), OpenRaveWorkerFn(), true);
         mapNetworkFns["env_loadplugin"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvLoadPlugin,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["env_raycollision"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvRayCollision,this,_1,_2,_3), OpenRaveWorkerFn(), true);
+        mapNetworkFns["env_raycollision"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvRayCollision,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
         mapNetworkFns["env_stepsimulation"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvStepSimulation,this,_1,_2,_3), boost::bind(&SimpleTextServer::worEnvStepSimulation,this,_1,_2), false);
         mapNetworkFns["env_triangulate"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvTriangulate,this,_1,_2,_3), OpenRaveWorkerFn(), true);
         mapNetworkFns["loadscene"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvLoadScene,this,_1,_2,_3), OpenRaveWorkerFn(), true);
         mapNetworkFns["plot"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvPlot,this,_1,_2,_3), OpenRaveWorkerFn(), true);
         mapNetworkFns["problem_sendcmd"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orProblemSendCommand,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["robot_checkselfcollision"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotCheckSelfCollision,this,_1,_2,_3), OpenRaveWorkerFn(), true);
+        mapNetworkFns["robot_checkselfcollision"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotCheckSelfCollision,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
         mapNetworkFns["robot_controllersend"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotControllerSend,this,_1,_2,_3), OpenRaveWorkerFn(), true);
         mapNetworkFns["robot_controllerset"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotControllerSet,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["robot_getactivedof"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetActiveDOF,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["robot_getdofvalues"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetDOFValues,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["robot_getlimits"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetDOFLimits,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["robot_getmanipulators"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetManipulators,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["robot_getsensors"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetAttachedSensors,this,_1,_2,_3), OpenRaveWorkerFn(), true);
+        mapNetworkFns["robot_getactivedof"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetActiveDOF,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["robot_getdofvalues"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetDOFValues,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["robot_getlimits"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetDOFLimits,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["robot_getmanipulators"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetManipulators,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["robot_getsensors"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetAttachedSensors,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
         mapNetworkFns["robot_sensorsend"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotSensorSend,this,_1,_2,_3), OpenRaveWorkerFn(), true);
         mapNetworkFns["robot_sensorconfigure"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotSensorConfigure,this,_1,_2,_3), OpenRaveWorkerFn(), true);
         mapNetworkFns["robot_sensordata"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotSensorData,this,_1,_2,_3), OpenRaveWorkerFn(), true);
@@ -337,6 +412,11 @@ public:
         _nPort = 4765;
         stringstream ss(cmd);
         ss >> _nPort;
+        int nRequestThreads = 0;
+        ss >> nRequestThreads;
+        if( !!ss && nRequestThreads > 0 ) {
+            _nRequestThreads = nRequestThreads;
+        }
 
         Destroy();
 
@@ -408,6 +488,9 @@ public:
         RAVELOG_DEBUG("text server listening on port %d\n",_nPort);
         _servthread = boost::make_shared<std::thread>(std::bind(&SimpleTextServer::_listen_threadcb, this));
         _workerthread = boost::make_shared<std::thread>(std::bind(&SimpleTextServer::_worker_threadcb, this));
+        for(int ithread = 0; ithread < _nRequestThreads; ++ithread) {
+            _vRequestThreads.push_back(boost::make_shared<std::thread>(std::bind(&SimpleTextServer::_request_threadcb, this)));
+        }
         bInitThread = true;
         return 0;
     }
@@ -439,6 +522,15 @@ public:
                 (*it)->join();
             }
             _listReadThreads.clear();
+            {
+                std::lock_guard<std::mutex> lock(_mutexRequests);
+                _listRequests.clear();
+            }
+            _condRequests.notify_all();
+            FOREACH(it, _vRequestThreads) {
+                (*it)->join();
+            }
+            _vRequestThreads.clear();
             _condHasWork.notify_all();
             if( !!_workerthread ) {
                 _workerthread->join();
@@ -571,6 +663,12 @@ private:
                     flog << index++ << ": " << line << endl;
                 }
 
+                if( line == "binary" ) {
+                    psocket->SendData("1", 1);
+                    _ReadBinaryRequests(psocket);
+                    break;
+                }
+
                 boost::shared_ptr<istream> is(new stringstream(line));
                 *is >> cmd;
                 if( !*is ) {
@@ -579,57 +677,21 @@ private:
                     continue;
                 }
                 std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
-                stringstream::pos_type inputpos = is->tellg();
 
                 map<string, RAVENETWORKFN>::iterator itfn = mapNetworkFns.find(cmd);
                 if( itfn != mapNetworkFns.end() ) {
-                    bool bCallWorker = true;
-                    boost::shared_ptr<void> pdata;
-
-                    // need to set w.args before pcmdend is modified
                     sout.str(""); sout.clear();
-                    if( !!itfn->second.fnSocketThread ) {
-                        bool bSuccess = false;
-                        try {
-                            bSuccess = itfn->second.fnSocketThread(*is, sout, pdata);
-                        }
-                        catch(const std::exception& ex) {
-                            RAVELOG_FATAL("server caught exception: %s\n",ex.what());
-                        }
-                        catch(...) {
-                            RAVELOG_FATAL("unknown exception!!\n");
-                        }
-
+                    bool bSuccess = _RunCommand(itfn->second, is, sout);
+                    if( !bSuccess && !!flog  ) {
+                        flog << " error" << endl;
+                    }
+                    if( itfn->second.bReturnResult ) {
                         if( bSuccess ) {
-                            if( itfn->second.bReturnResult ) {
-                                psocket->SendData(sout.str().c_str(), sout.str().size());
-                            }
-                            if( !itfn->second.fnWorker ) {
-                                bCallWorker = false;
-                            }
+                            psocket->SendData(sout.str().c_str(), sout.str().size());
                         }
                         else {
-                            bCallWorker = false;
-                            if( !!flog  ) {
-                                flog << " error" << endl;
-                            }
-                            if( itfn->second.bReturnResult ) {
-                                psocket->SendData("error\n", 6);
-                            }
-                        }
-                    }
-                    else {
-                        if( itfn->second.bReturnResult ) {
-                            psocket->SendData(sout.str().c_str(), sout.str().size());     // return dummy
+                            psocket->SendData("error\n", 6);
                         }
-                        bCallWorker = !!itfn->second.fnWorker;
-                    }
-
-                    if( bCallWorker ) {
-                        BOOST_ASSERT(!!itfn->second.fnWorker);
-                        is->clear();
-                        is->seekg(inputpos);
-                        ScheduleWorker(boost::bind(itfn->second.fnWorker,is,pdata));
                     }
                 }
                 else {
@@ -646,6 +708,150 @@ private:
         RAVELOG_VERBOSE("Closing socket connection\n");
     }
 
+    /// \brief calls the socket function of the command and schedules its worker function
+    ///
+    /// \param is the arguments of the command
+    /// \param os receives the result
+    /// \return false if the socket function failed
+    bool _RunCommand(const RAVENETWORKFN& fn, boost::shared_ptr<istream> is, ostream& os)
+    {
+        stringstream::pos_type inputpos = is->tellg();
+        boost::shared_ptr<void> pdata;
+        if( !!fn.fnSocketThread ) {
+            bool bSuccess = false;
+            try {
+                bSuccess = fn.fnSocketThread(*is, os, pdata);
+            }
+            catch(const std::exception& ex) {
+                RAVELOG_FATAL("server caught exception: %s\n",ex.what());
+            }
+            catch(...) {
+                RAVELOG_FATAL("unknown exception!!\n");
+            }
+            if( !bSuccess ) {
+                return false;
+            }
+        }
+
+        if( !!fn.fnWorker ) {
+            is->clear();
+            is->seekg(inputpos);
+            ScheduleWorker(boost::bind(fn.fnWorker,is,pdata));
+        }
+        return true;
+    }
+
+    /// \brief reads the requests of a connection that switched to the binary protocol until it closes
+    void _ReadBinaryRequests(SocketPtr psocket)
+    {
+        PendingRequestsPtr pending(new PendingRequests());
+        string frame;
+        while(!bCloseThread) {
+            if( !psocket->ReadFrame(frame) ) {
+                if( !psocket->IsInit() ) {
+                    break;
+                }
+                usleep(1000);
+                continue;
+            }
+
+            uint64_t requestid = 0;
+            string cmd, args;
+            try {
+                rapidjson::Document rRequest;
+                MsgPack::ParseMsgPack(rRequest, frame);
+                orjson::LoadJsonValueByKey(rRequest, "id", requestid);
+                orjson::LoadJsonValueByKey(rRequest, "command", cmd);
+                // args can hold binary data like environment snapshots, so keep its full length
+                rapidjson::Value::ConstMemberIterator itargs = rRequest.FindMember("args");
+                if( itargs != rRequest.MemberEnd() && itargs->value.IsString() ) {
+                    args.assign(itargs->value.GetString(), itargs->value.GetStringLength());
+                }
+            }
+            catch(const std::exception& ex) {
+                RAVELOG_ERROR_FORMAT("failed to parse binary request: %s", ex.what());
+                _SendBinaryResponse(psocket, requestid, false, string());
+                continue;
+            }
+            std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+
+            map<string, RAVENETWORKFN>::iterator itfn = mapNetworkFns.find(cmd);
+            if( itfn == mapNetworkFns.end() ) {
+                RAVELOG_ERROR("Failed to recognize command: %s\n", cmd.c_str());
+                _SendBinaryResponse(psocket, requestid, false, string());
+                continue;
+            }
+
+            boost::shared_ptr<istream> is(new stringstream(args));
+            const RAVENETWORKFN& fn = itfn->second;
+            if( fn.bReadOnly ) {
+                {
+                    std::lock_guard<std::mutex> lock(pending->mutex);
+                    ++pending->num;
+                }
+                std::lock_guard<std::mutex> lock(_mutexRequests);
+                _listRequests.push_back(boost::bind(&SimpleTextServer::_RunBinaryRequest, this, psocket, pending, fn, is, requestid));
+                _condRequests.notify_one();
+            }
+            else {
+                // the commands modifying the environment have to see the effects of the earlier requests
+                {
+                    std::unique_lock<std::mutex> lock(pending->mutex);
+                    while( pending->num > 0 && !bCloseThread ) {
+                        pending->cond.wait_for(lock, std::chrono::milliseconds(100));
+                    }
+                }
+                stringstream sout;
+                bool bSuccess = _RunCommand(fn, is, sout);
+                _SendBinaryResponse(psocket, requestid, bSuccess, bSuccess ? sout.str() : string());
+            }
+        }
+    }
+
+    void _RunBinaryRequest(SocketPtr psocket, PendingRequestsPtr pending, const RAVENETWORKFN& fn, boost::shared_ptr<istream> is, uint64_t requestid)
+    {
+        stringstream sout;
+        bool bSuccess = _RunCommand(fn, is, sout);
+        _SendBinaryResponse(psocket, requestid, bSuccess, bSuccess ? sout.str() : string());
+        {
+            std::lock_guard<std::mutex> lock(pending->mutex);
+            --pending->num;
+        }
+        pending->cond.notify_all();
+    }
+
+    void _SendBinaryResponse(SocketPtr psocket, uint64_t requestid, bool bSuccess, const string& result)
+    {
+        rapidjson::Document rResponse;
+        rResponse.SetObject();
+        orjson::SetJsonValueByKey(rResponse, "id", requestid);
+        orjson::SetJsonValueByKey(rResponse, "success", bSuccess);
+        orjson::SetJsonValueByKey(rResponse, "result", result);
+        std::vector<char> output;
+        MsgPack::DumpMsgPack(rResponse, output);
+        psocket->SendData(output.data(), output.size());
+    }
+
+    /// \brief runs the read-only binary requests of all the connections
+    void _request_threadcb()
+    {
+        while(!bCloseThread) {
+            boost::function<void()> fn;
+            {
+                std::unique_lock<std::mutex> lock(_mutexRequests);
+                _condRequests.wait(lock, [this]() {
+                    return !_listRequests.empty() || bCloseThread;
+                });
+                if( bCloseThread ) {
+                    break;
+                }
+                fn = _listRequests.front();
+                _listRequests.pop_front();
+            }
+            fn();
+        }
+    }
+
     int _nPort;     ///< port used for listening to incoming connections
 
     boost::shared_ptr<std::thread> _servthread, _workerthread;
@@ -667,6 +873,12 @@ private:
     list<boost::function<void()> > listWorkers;
     map<string, RAVENETWORKFN> mapNetworkFns;
 
+    int _nRequestThreads; ///< number of threads running the read-only binary requests
+    vector<boost::shared_ptr<std::thread> > _vRequestThreads;
+    list<boost::function<void()> > _listRequests; ///< read-only binary requests waiting for a request thread
+    std::mutex _mutexRequests; ///< protects _listRequests
+    std::condition_variable _condRequests;
+
     int _nIdIndex;
     map<int, ModuleBasePtr > _mapModules;
     map<int, GraphHandlePtr> _mapFigureIds;
@@ -873,6 +1085,30 @@ protected:
         return true;
     }
 
+    /// orEnvLoadData(data) - replaces the scene with the environment serialized in data, for example a msgpack snapshot of another environment
+    ///
+    /// Used to turn the server into a replica of the environment of a client dispatching work to several servers. data is the rest of the arguments and can contain newlines and zero bytes, so it has to be sent with the binary protocol.
+    bool orEnvLoadData(istream& is, ostream& os, boost::shared_ptr<void>& pdata)
+    {
+        if( is.peek() == ' ' ) {
+            is.get();
+        }
+        string data((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+        if( data.size() == 0 ) {
+            return false;
+        }
+        EnvironmentLock lock(GetEnv()->GetMutex());
+        _mapModules.clear();
+        GetEnv()->Reset();
+        if( !GetEnv()->LoadData(data) ) {
+            return false;
+        }
+        std::vector<KinBodyPtr> vbodies;
+        GetEnv()->GetBodies(vbodies);
+        os << vbodies.size();
+        return true;
+    }
+
     /// robot = orEnvCreateRobot(name, xmlfile) - create a specific robot, return a robot handle (a robot is also a kinbody)
     bool orEnvCreateRobot(istream& is, ostream& os, boost::shared_ptr<void>& pdata)
     {
@@ -113,6 +113,25 @@ inline py::numeric::array toPyArray(const std::vector<T>& v, std::vector<npy_int
     return toPyArrayN(v.data(), dims);
 }
 
+/// \brief returns an array of the given shape that takes over the storage of v instead of copying it, v is left empty.
+///
+/// The array owns the data like any other array, so it can be modified and kept after the interface that filled v is gone.
+template <typename T>
+inline py::numeric::array toPyArrayMove(std::vector<T>& v, std::vector<npy_intp>& dims)
+{
+    if( v.empty() ) {
+        return static_cast<py::numeric::array>(py::handle<>(PyArray_SimpleNew(dims.size(), dims.data(), select_npy_type<T>::type)));
+    }
+    std::vector<T>* pvalues = new std::vector<T>();
+    pvalues->swap(v);
+    PyObject *pyowner = PyCapsule_New(pvalues, nullptr, [](PyObject* o) {
+        delete reinterpret_cast<std::vector<T>*>(PyCapsule_GetPointer(o, nullptr));
+    });
+    PyObject *pyvalues = PyArray_SimpleNewFromData(dims.size(), dims.data(), select_npy_type<T>::type, pvalues->data());
+    PyArray_SetBaseObject((PyArrayObject*)pyvalues, pyowner); // steals pyowner
+    return static_cast<py::numeric::array>(py::handle<>(pyvalues));
+}
+
 template <typename T, long unsigned int N>
 inline py::numeric::array toPyArray(const std::array<T, N>& v)
 {
@@ -177,6 +177,12 @@ public:
 
     object CheckCollisionRays(py::numeric::array rays, PyKinBodyPtr pbody,bool bFrontFacingOnly=false);
 
+    /// \brief checks the body against the environment at every row of the (N, dof) array of dof values, without holding the GIL
+    ///
+    /// The state of the body is restored afterwards.
+    /// \return (N,) bool array, true where the body is in collision
+    object CheckCollisionConfigurations(PyKinBodyPtr pbody, object oconfigs, bool bCheckSelfCollision=true);
+
     bool CheckCollision(OPENRAVE_SHARED_PTR<PyRay> pyray);
 
     bool CheckCollision(OPENRAVE_SHARED_PTR<PyRay> pyray, PyCollisionReportPtr pReport);
@@ -324,6 +330,9 @@ public:
     object GetBodies();
     int GetNumBodies();
 
+    /// \brief returns the memory usage of the environment as the dictionary of MemoryUsage::SerializeJSON
+    object GetMemoryUsage();
+
     object GetRobots();
 
     object GetSensors();
@@ -96,6 +96,8 @@ public:
 
     object SolveAll(object oparam, object oFreeParameters, int filteroptions);
 
+    object SolveBatch(object oparams, object oq0, int filteroptions, int numThreads);
+
     PyIkReturnPtr CallFilters(object oparam);
 
     bool Supports(IkParameterizationType type);
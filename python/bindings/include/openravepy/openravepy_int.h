@@ -239,6 +239,42 @@ private:
 
 typedef OPENRAVE_SHARED_PTR<PythonThreadSaver> PythonThreadSaverPtr;
 
+/// \brief copies a two dimensional array of reals with numcols columns into values in row-major order, converting the element type if needed
+///
+/// Used by the batched functions to read all their inputs before releasing the GIL.
+/// \return the number of rows
+inline size_t ExtractArray2D(const py::object& o, size_t numcols, std::vector<dReal>& values)
+{
+    PyArrayObject* pyarray = reinterpret_cast<PyArrayObject*>(PyArray_ContiguousFromAny(o.ptr(), select_npy_type<dReal>::type, 2, 2));
+    if( !pyarray ) {
+        PyErr_Clear();
+        throw OPENRAVE_EXCEPTION_FORMAT0(_("expected a two dimensional array of reals"), ORE_InvalidArguments);
+    }
+    AutoPyArrayObjectDereferencer pyderef(pyarray);
+    if( (size_t)PyArray_DIM(pyarray, 1) != numcols ) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("expected an array with %d columns, but it has %d"), numcols%PyArray_DIM(pyarray, 1), ORE_InvalidArguments);
+    }
+    const size_t numrows = PyArray_DIM(pyarray, 0);
+    const dReal* pdata = reinterpret_cast<const dReal*>(PyArray_DATA(pyarray));
+    values.assign(pdata, pdata + numrows*numcols);
+    return numrows;
+}
+
+/// \brief returns the flags as a numpy bool array
+inline py::object toPyBoolArray(const std::vector<uint8_t>& vflags)
+{
+    npy_intp dims[] = { npy_intp(vflags.size()) };
+    PyObject *pyflags = PyArray_SimpleNew(1, dims, NPY_BOOL);
+    if( !vflags.empty() ) {
+        memcpy(PyArray_DATA(pyflags), vflags.data(), vflags.size());
+    }
+#ifdef USE_PYBIND11_PYTHON_BINDINGS
+    return py::reinterpret_steal<py::object>(pyflags);
+#else
+    return py::to_array_astype<bool>(pyflags);
+#endif
+}
+
 inline RaveVector<float> ExtractFloat3(const py::object& o)
 {
     return RaveVector<float>(py::extract<float>(o[py::to_object(0)]), py::extract<float>(o[py::to_object(1)]), py::extract<float>(o[py::to_object(2)]));
@@ -699,6 +735,9 @@ public:
     bool SupportsJSONCommand(const string& cmd);
     py::object SendJSONCommand(const string& cmd, py::object input, bool releasegil=false, bool lockenv=false);
 
+    /// \brief returns the memory usage of the interface as the dictionary of MemoryUsage::SerializeJSON
+    py::object GetMemoryUsage();
+
     virtual string __repr__() {
         return boost::str(boost::format("RaveCreateInterface(RaveGetEnvironment(%d),InterfaceType.%s,'%s')")%RaveGetEnvironmentId(_pbase->GetEnv())%RaveGetInterfaceName(_pbase->GetInterfaceType())%_pbase->GetXMLId());
     }
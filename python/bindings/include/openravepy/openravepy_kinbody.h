@@ -245,6 +245,10 @@ public:
     py::object GetTransform() const;
     py::object GetTransformPose() const;
     py::object GetLinkTransformations(bool returndoflastvlaues=false) const;
+    /// \brief poses of all the links at every row of the (N, dof) array of dof values, computed without holding the GIL
+    ///
+    /// \return (N, numlinks, 7) array of [qw, qx, qy, qz, x, y, z] poses. The state of the body is restored afterwards.
+    py::object ComputeForwardKinematicsBatch(py::object oconfigs) const;
     void SetLinkTransformations(py::object transforms, py::object odoflastvalues=py::none_());
     void SetLinkVelocities(py::object ovelocities);
     py::object GetLinkEnableStates() const;
@@ -297,6 +301,9 @@ public:
     py::object ComputeHessianTranslation(int index, py::object oposition, py::object oindices=py::none_());
     py::object ComputeHessianAxisAngle(int index, py::object oindices=py::none_());
     py::object ComputeInverseDynamics(py::object odofaccelerations, py::object oexternalforcetorque=py::none_(), bool returncomponents=false);
+    py::object ComputeMassMatrix() const;
+    py::object ComputeGravityTorques() const;
+    py::object ComputeCoriolisMatrix() const;
     py::object GetDOFDynamicAccelerationJerkLimits(py::object oDOFPositions, py::object oDOFVelocities) const;
     void SetSelfCollisionChecker(PyCollisionCheckerBasePtr pycollisionchecker);
     PyInterfaceBasePtr GetSelfCollisionChecker();
@@ -335,6 +342,9 @@ public:
     py::object GetNonAdjacentLinks(int adjacentoptions) const;
     void SetAdjacentLinks(int linkindex0, int linkindex1);
     void SetAdjacentLinksCombinations(py::object olinkIndices);
+    void ComputeNeverCollidingLinkPairs(int numSamples=10000, bool bForceRecompute=false, dReal fMargin=0.01);
+    void ResetNeverCollidingLinkPairs();
+    bool HasNeverCollidingLinkPairs() const;
     py::object GetAdjacentLinks() const;
     py::object GetManageData() const;
     int GetUpdateStamp() const;
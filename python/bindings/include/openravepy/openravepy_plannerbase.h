@@ -48,6 +48,24 @@ public:
     uint32_t statusCode = 0;
 };
 
+/// \brief wraps PlannerBase::PlanPathHandle, waiting with the GIL released
+class PyPlanPathHandle
+{
+public:
+    PyPlanPathHandle(PlannerBase::PlanPathHandlePtr phandle);
+    virtual ~PyPlanPathHandle();
+
+    void Cancel();
+    bool IsDone();
+    bool Wait(double timeout=-1);
+    object GetStatus();
+    OPENRAVE_SHARED_PTR<PyPlannerProgress> GetProgress();
+
+protected:
+    PlannerBase::PlanPathHandlePtr _phandle;
+};
+typedef OPENRAVE_SHARED_PTR<PyPlanPathHandle> PyPlanPathHandlePtr;
+
 class PyPlannerBase : public PyInterfaceBase
 {
 protected:
@@ -96,6 +114,10 @@ public:
 
         void SetMaxIterations(int nMaxIterations);
 
+        void SetParallelCollisionCheckingWorkers(int numworkers);
+
+        void SetBatchCollisionChecking(bool bBatchCollisionChecking);
+
         object CheckPathAllConstraints(object oq0, object oq1, object odq0, object odq1, dReal timeelapsed, IntervalType interval, uint32_t options=0xffff, bool filterreturn=false);
 
         void SetPostProcessing(const std::string& plannername, const std::string& plannerparameters);
@@ -137,6 +159,8 @@ public:
 
     object PlanPath(PyTrajectoryBasePtr pytraj,bool releasegil=true);
 
+    PyPlanPathHandlePtr PlanPathAsync(PyTrajectoryBasePtr pytraj);
+
     PyPlannerParametersPtr GetParameters() const;
 
     static PlannerAction _PlanCallback(object fncallback, PyEnvironmentBasePtr pyenv, const PlannerBase::PlannerProgress& progress);
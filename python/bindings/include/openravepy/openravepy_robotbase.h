@@ -144,6 +144,11 @@ public:
         object FindIKSolutions(object oparam, int filteroptions, bool ikreturn=false, bool releasegil=false, PyIkFailureAccumulatorBasePtr=nullptr) const;
         object FindIKSolutions(object oparam, object freeparams, int filteroptions, bool ikreturn=false, bool releasegil=false, PyIkFailureAccumulatorBasePtr=nullptr) const;
 
+        /// \brief finds one ik solution for every row of the (N, 7) array of [qw, qx, qy, qz, x, y, z] end effector poses, without holding the GIL
+        ///
+        /// \return tuple of the (N, armdof) solutions and the (N,) bool array telling which poses have a solution. Rows without a solution are zeros.
+        object FindIKSolutionBatch(object oposes, int filteroptions) const;
+
         object GetIkParameterization(object oparam, bool inworld=true);
 
         object GetChildJoints();
@@ -243,6 +248,8 @@ public:
         bool SetActive(int active);
 
         int IsActive();
+
+        bool CanSetActiveWithoutReinitialize(int active) const;
         object GetTransform() const;
         object GetTransformPose() const;
 
@@ -343,6 +350,10 @@ public:
 
     void SetConnectedBodyActiveStates(object oactivestates);
 
+    void SetPreinstantiateConnectedBodies(bool bPreinstantiate);
+
+    bool IsPreinstantiateConnectedBodies() const;
+
     bool AddGripperInfo(object oGripperInfo, bool removeduplicate=false);
     bool RemoveGripperInfo(const std::string& name);
 
@@ -91,6 +91,8 @@ public:
 
     dReal GetDuration() const;
 
+    uint64_t GetDataHash() const;
+
     void deserialize(const string& s);
 
     object serialize(object options=py::none_());
@@ -98,6 +100,7 @@ public:
     void SaveToFile(const std::string& filename, object options=py::none_());
 
     void LoadFromFile(const std::string& filename);
+    void LoadFromMappedFile(const std::string& filename);
     
     TrajectoryBasePtr GetTrajectory();
 
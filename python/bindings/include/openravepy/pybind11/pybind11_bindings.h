@@ -167,6 +167,20 @@ inline py::array_t<T> toPyArray(const std::vector<T>& v, std::vector<npy_intp>&
     return toPyArrayN(v.data(), dims);
 }
 
+/// \brief returns an array of the given shape that takes over the storage of v instead of copying it, v is left empty.
+///
+/// The array owns the data like any other array, so it can be modified and kept after the interface that filled v is gone.
+template <typename T>
+inline py::array_t<T> toPyArrayMove(std::vector<T>& v, std::vector<npy_intp>& dims)
+{
+    std::vector<T>* pvalues = new std::vector<T>();
+    pvalues->swap(v);
+    py::capsule owner(pvalues, [](void* p) {
+        delete reinterpret_cast<std::vector<T>*>(p);
+    });
+    return py::array_t<T>(dims, pvalues->data(), owner);
+}
+
 template <typename T, long unsigned int N>
 inline py::array_t<T> toPyArray(const std::array<T, N>& v)
 {
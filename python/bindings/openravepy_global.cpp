@@ -138,6 +138,8 @@ ReadablePtr ExtractReadable(object o) {
 }
 
 object toPyReadable(ReadablePtr p) {
+    // python code casts to the concrete readable, so lazily loaded readables are deserialized here
+    p = OpenRAVE::LazyJSONReadable::Resolve(p);
     if( !p ) {
         return py::none_();
     }
@@ -1610,6 +1612,7 @@ void init_openravepy_global()
     .value("Modules",Clone_Modules)
     .value("PassOnMissingBodyReferences",Clone_PassOnMissingBodyReferences)
     .value("IgnoreGrabbedBodies",Clone_IgnoreGrabbedBodies)
+    .value("ShareGeometry",Clone_ShareGeometry)
 #ifdef USE_PYBIND11_PYTHON_BINDINGS
     // Cannot export because openravepy_viewer already has "Viewer"
     // .export_values()
@@ -290,6 +290,30 @@ object PyIkSolverBase::SolveAll(object oparam, object oFreeParameters, int filte
     return pyreturns;
 }
 
+object PyIkSolverBase::SolveBatch(object oparams, object oq0, int filteroptions, int numThreads)
+{
+    std::vector<IkParameterization> vparams(len(oparams));
+    for(size_t iparam = 0; iparam < vparams.size(); ++iparam) {
+        if( !ExtractIkParameterization(oparams[iparam],vparams[iparam]) ) {
+            throw openrave_exception(_("first argument to IkSolver.SolveBatch needs to be a list of IkParameterization"),ORE_InvalidArguments);
+        }
+    }
+    std::vector<dReal> q0;
+    if( !IS_PYTHONOBJECT_NONE(oq0) ) {
+        q0 = ExtractArray<dReal>(oq0);
+    }
+    std::vector<IkReturnPtr> vikreturns;
+    {
+        openravepy::PythonThreadSaver threadsaver;
+        _pIkSolver->SolveBatch(vparams, q0, filteroptions, vikreturns, numThreads);
+    }
+    py::list pyreturns;
+    FOREACH(itikreturn,vikreturns) {
+        pyreturns.append(py::to_object(PyIkReturnPtr(new PyIkReturn(*itikreturn))));
+    }
+    return pyreturns;
+}
+
 PyIkReturnPtr PyIkSolverBase::CallFilters(object oparam)
 {
     PyIkReturnPtr pyreturn(new PyIkReturn(IKRA_Reject));
@@ -470,6 +494,7 @@ void init_openravepy_iksolver()
         .def("Solve",SolveFree, PY_ARGS("ikparam","q0","freeparameters", "filteroptions") DOXY_FN(IkSolverBase, Solve "const IkParameterization&; const std::vector; const std::vector; int; IkReturnPtr"))
         .def("SolveAll",SolveAll, PY_ARGS("ikparam","filteroptions") DOXY_FN(IkSolverBase, SolveAll "const IkParameterization&; int; std::vector<IkReturnPtr>"))
         .def("SolveAll",SolveAllFree, PY_ARGS("ikparam","freeparameters","filteroptions") DOXY_FN(IkSolverBase, SolveAll "const IkParameterization&; const std::vector; int; std::vector<IkReturnPtr>"))
+        .def("SolveBatch",&PyIkSolverBase::SolveBatch, PY_ARGS("ikparams","q0","filteroptions","numThreads") DOXY_FN(IkSolverBase, SolveBatch))
         .def("GetNumFreeParameters",&PyIkSolverBase::GetNumFreeParameters, DOXY_FN(IkSolverBase,GetNumFreeParameters))
         .def("GetFreeParameters",&PyIkSolverBase::GetFreeParameters, DOXY_FN(IkSolverBase,GetFreeParameters))
         .def("Supports",&PyIkSolverBase::Supports, PY_ARGS("iktype") DOXY_FN(IkSolverBase,Supports))
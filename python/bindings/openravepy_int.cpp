@@ -1032,6 +1032,15 @@ object PyInterfaceBase::SendJSONCommand(const string& cmd, object input, bool re
     return toPyObject(out);
 }
 
+object PyInterfaceBase::GetMemoryUsage()
+{
+    MemoryUsage memoryusage(_pbase->GetXMLId(), RaveGetInterfaceName(_pbase->GetInterfaceType()));
+    _pbase->GetMemoryUsage(memoryusage);
+    rapidjson::Document doc;
+    memoryusage.SerializeJSON(doc, doc.GetAllocator());
+    return toPyObject(doc);
+}
+
 object PyReadablesContainer::GetReadableInterfaces()
 {
     py::dict ointerfaces;
@@ -1846,6 +1855,27 @@ object PyEnvironmentBase::CheckCollisionRays(py::numeric::array rays, PyKinBodyP
 #endif // USE_PYBIND11_PYTHON_BINDINGS
 }
 
+object PyEnvironmentBase::CheckCollisionConfigurations(PyKinBodyPtr pybody, object oconfigs, bool bCheckSelfCollision)
+{
+    KinBodyPtr pbody = openravepy::GetKinBody(pybody);
+    const int dof = pbody->GetDOF();
+    std::vector<dReal> vconfigs;
+    const size_t numconfigs = ExtractArray2D(oconfigs, dof, vconfigs);
+    std::vector<uint8_t> vcollisions(numconfigs, 0);
+    {
+        openravepy::PythonThreadSaver threadsaver;
+        EnvironmentLock lock(_penv->GetMutex());
+        KinBody::KinBodyStateSaver saver(pbody);
+        std::vector<dReal> vvalues(dof);
+        for(size_t iconfig = 0; iconfig < numconfigs; ++iconfig) {
+            std::copy(vconfigs.begin() + iconfig*dof, vconfigs.begin() + (iconfig+1)*dof, vvalues.begin());
+            pbody->SetDOFValues(vvalues, KinBody::CLA_CheckLimits);
+            vcollisions[iconfig] = _penv->CheckCollision(KinBodyConstPtr(pbody)) || (bCheckSelfCollision && pbody->CheckSelfCollision());
+        }
+    }
+    return toPyBoolArray(vcollisions);
+}
+
 bool PyEnvironmentBase::CheckCollision(OPENRAVE_SHARED_PTR<PyRay> pyray)
 {
     return _penv->CheckCollision(pyray->r);
@@ -2850,6 +2880,18 @@ object PyEnvironmentBase::GetBodies()
     return bodies;
 }
 
+object PyEnvironmentBase::GetMemoryUsage()
+{
+    MemoryUsage memoryusage;
+    {
+        openravepy::PythonThreadSaver threadsaver;
+        _penv->GetMemoryUsage(memoryusage);
+    }
+    rapidjson::Document doc;
+    memoryusage.SerializeJSON(doc, doc.GetAllocator());
+    return toPyObject(doc);
+}
+
 int PyEnvironmentBase::GetNumBodies()
 {
     return _penv->GetNumBodies();
@@ -3270,6 +3312,7 @@ BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(StopSimulation_overloads, StopSimulation,
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(SetViewer_overloads, SetViewer, 1, 2)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(SetDefaultViewer_overloads, SetDefaultViewer, 0, 1)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(CheckCollisionRays_overloads, CheckCollisionRays, 2, 3)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(CheckCollisionConfigurations_overloads, CheckCollisionConfigurations, 2, 3)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(plot3_overloads, plot3, 2, 4)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(drawlinestrip_overloads, drawlinestrip, 2, 4)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(drawlinelist_overloads, drawlinelist, 2, 4)
@@ -3523,6 +3566,7 @@ Because race conditions can pop up when trying to lock the openrave environment
 #else
         .def("SendCommand",&PyInterfaceBase::SendCommand, SendCommand_overloads(PY_ARGS("cmd","releasegil","lockenv") sSendCommandDoc.c_str()))
 #endif
+        .def("GetMemoryUsage",&PyInterfaceBase::GetMemoryUsage, DOXY_FN(InterfaceBase,GetMemoryUsage))
         .def("SupportsJSONCommand",&PyInterfaceBase::SupportsJSONCommand, PY_ARGS("cmd") DOXY_FN(InterfaceBase,SupportsJSONCommand))
 #ifdef USE_PYBIND11_PYTHON_BINDINGS
         .def("SendJSONCommand",&PyInterfaceBase::SendJSONCommand,
@@ -3683,6 +3727,18 @@ Because race conditions can pop up when trying to lock the openrave environment
                           CheckCollisionRays_overloads(PY_ARGS("rays","body","front_facing_only")
                                                        "Check if any rays hit the body and returns their contact points along with a vector specifying if a collision occured or not. Rays is a Nx6 array, first 3 columsn are position, last 3 are direction*range."))
 #endif
+#ifdef USE_PYBIND11_PYTHON_BINDINGS
+                     .def("CheckCollisionConfigurations",&PyEnvironmentBase::CheckCollisionConfigurations,
+                          "body"_a,
+                          "configs"_a,
+                          "checkSelfCollision"_a = true,
+                          "Sets the body to every row of the Nx(dof) configs array and checks it against the environment (and itself), without holding the GIL. Returns an N bool array, true where in collision. The body state is restored afterwards."
+                          )
+#else
+                     .def("CheckCollisionConfigurations",&PyEnvironmentBase::CheckCollisionConfigurations,
+                          CheckCollisionConfigurations_overloads(PY_ARGS("body","configs","checkSelfCollision")
+                                                                 "Sets the body to every row of the Nx(dof) configs array and checks it against the environment (and itself), without holding the GIL. Returns an N bool array, true where in collision. The body state is restored afterwards."))
+#endif
 #ifdef USE_PYBIND11_PYTHON_BINDINGS
                      .def("LoadURI", &PyEnvironmentBase::LoadURI,
                           "filename"_a,
@@ -3962,6 +4018,7 @@ Because race conditions can pop up when trying to lock the openrave environment
 #endif
                      .def("GetRobots",&PyEnvironmentBase::GetRobots, DOXY_FN(EnvironmentBase,GetRobots))
                      .def("GetBodies",&PyEnvironmentBase::GetBodies, DOXY_FN(EnvironmentBase,GetBodies))
+                     .def("GetMemoryUsage",&PyEnvironmentBase::GetMemoryUsage, DOXY_FN(EnvironmentBase,GetMemoryUsage))
                      .def("GetNumBodies",&PyEnvironmentBase::GetNumBodies, DOXY_FN(EnvironmentBase,GetNumBodies))
                      .def("GetSensors",&PyEnvironmentBase::GetSensors, DOXY_FN(EnvironmentBase,GetSensors))
                      .def("UpdatePublishedBodies",&PyEnvironmentBase::UpdatePublishedBodies, DOXY_FN(EnvironmentBase,UpdatePublishedBodies))
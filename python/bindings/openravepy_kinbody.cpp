@@ -3388,6 +3388,39 @@ object PyKinBody::GetLinkTransformations(bool returndoflastvlaues) const
     return otransforms;
 }
 
+object PyKinBody::ComputeForwardKinematicsBatch(object oconfigs) const
+{
+    const int dof = _pbody->GetDOF();
+    std::vector<dReal> vconfigs;
+    const size_t numconfigs = ExtractArray2D(oconfigs, dof, vconfigs);
+    const size_t numlinks = _pbody->GetLinks().size();
+    std::vector<dReal> vposes(numconfigs*numlinks*7);
+    {
+        openravepy::PythonThreadSaver threadsaver;
+        EnvironmentLock lock(_pbody->GetEnv()->GetMutex());
+        KinBody::KinBodyStateSaver saver(_pbody, KinBody::Save_LinkTransformation);
+        std::vector<dReal> vvalues(dof);
+        dReal* ppose = vposes.data();
+        for(size_t iconfig = 0; iconfig < numconfigs; ++iconfig) {
+            std::copy(vconfigs.begin() + iconfig*dof, vconfigs.begin() + (iconfig+1)*dof, vvalues.begin());
+            _pbody->SetDOFValues(vvalues, KinBody::CLA_CheckLimits);
+            for (const KinBody::LinkPtr& plink : _pbody->GetLinks()) {
+                const Transform& t = plink->GetTransform();
+                ppose[0] = t.rot.x;
+                ppose[1] = t.rot.y;
+                ppose[2] = t.rot.z;
+                ppose[3] = t.rot.w;
+                ppose[4] = t.trans.x;
+                ppose[5] = t.trans.y;
+                ppose[6] = t.trans.z;
+                ppose += 7;
+            }
+        }
+    }
+    std::vector<npy_intp> dims = { npy_intp(numconfigs), npy_intp(numlinks), 7 };
+    return toPyArrayMove(vposes, dims);
+}
+
 void PyKinBody::SetLinkTransformations(object transforms, object odoflastvalues)
 {
     size_t numtransforms = len(transforms);
@@ -3973,6 +4006,29 @@ object PyKinBody::ComputeInverseDynamics(object odofaccelerations, object oexter
     }
 }
 
+object PyKinBody::ComputeMassMatrix() const
+{
+    std::vector<dReal> vmassmatrix;
+    _pbody->ComputeMassMatrix(vmassmatrix);
+    std::vector<npy_intp> dims(2); dims[0] = _pbody->GetDOF(); dims[1] = _pbody->GetDOF();
+    return toPyArray(vmassmatrix,dims);
+}
+
+object PyKinBody::ComputeGravityTorques() const
+{
+    std::vector<dReal> vdoftorques;
+    _pbody->ComputeGravityTorques(vdoftorques);
+    return toPyArray(vdoftorques);
+}
+
+object PyKinBody::ComputeCoriolisMatrix() const
+{
+    std::vector<dReal> vcoriolismatrix;
+    _pbody->ComputeCoriolisMatrix(vcoriolismatrix);
+    std::vector<npy_intp> dims(2); dims[0] = _pbody->GetDOF(); dims[1] = _pbody->GetDOF();
+    return toPyArray(vcoriolismatrix,dims);
+}
+
 object PyKinBody::GetDOFDynamicAccelerationJerkLimits(py::object oDOFPositions, py::object oDOFVelocities) const
 {
     if( IS_PYTHONOBJECT_NONE(oDOFPositions) || IS_PYTHONOBJECT_NONE(oDOFVelocities) ) {
@@ -4267,6 +4323,21 @@ void PyKinBody::SetAdjacentLinksCombinations(object olinkIndices)
     _pbody->SetAdjacentLinksCombinations(linkIndices);
 }
 
+void PyKinBody::ComputeNeverCollidingLinkPairs(int numSamples, bool bForceRecompute, dReal fMargin)
+{
+    _pbody->ComputeNeverCollidingLinkPairs(numSamples, bForceRecompute, fMargin);
+}
+
+void PyKinBody::ResetNeverCollidingLinkPairs()
+{
+    _pbody->ResetNeverCollidingLinkPairs();
+}
+
+bool PyKinBody::HasNeverCollidingLinkPairs() const
+{
+    return _pbody->HasNeverCollidingLinkPairs();
+}
+
 object PyKinBody::GetAdjacentLinks() const
 {
     py::list adjacent;
@@ -4865,6 +4936,7 @@ BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(GetMaxInertia_overloads, GetMaxInertia, 0
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(GetLinkTransformations_overloads, GetLinkTransformations, 0, 1)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(SetLinkTransformations_overloads, SetLinkTransformations, 1, 2)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(SetDOFLimits_overloads, SetDOFLimits, 2, 3)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(ComputeNeverCollidingLinkPairs_overloads, ComputeNeverCollidingLinkPairs, 0, 3)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(SubtractDOFValues_overloads, SubtractDOFValues, 2, 3)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(ComputeJacobianTranslation_overloads, ComputeJacobianTranslation, 2, 3)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(ComputeJacobianAxisAngle_overloads, ComputeJacobianAxisAngle, 1, 2)
@@ -5820,6 +5892,7 @@ void init_openravepy_kinbody()
                          .def("GetLinkTransformations",&PyKinBody::GetLinkTransformations, GetLinkTransformations_overloads(PY_ARGS("returndoflastvlaues") DOXY_FN(KinBody,GetLinkTransformations)))
 #endif
                          .def("GetBodyTransformations",&PyKinBody::GetLinkTransformations, DOXY_FN(KinBody,GetLinkTransformations))
+                         .def("ComputeForwardKinematicsBatch",&PyKinBody::ComputeForwardKinematicsBatch, PY_ARGS("configs") "Sets the body to every row of the Nx(dof) configs array without holding the GIL and returns the Nx(numlinks)x7 array of link poses [qw, qx, qy, qz, x, y, z]. The body state is restored afterwards.")
 #ifdef USE_PYBIND11_PYTHON_BINDINGS
                          .def("SetLinkTransformations",&PyKinBody::SetLinkTransformations,
                               "transforms"_a,
@@ -6019,6 +6092,9 @@ void init_openravepy_kinbody()
 #else
                          .def("ComputeInverseDynamics",&PyKinBody::ComputeInverseDynamics, ComputeInverseDynamics_overloads(PY_ARGS("dofaccelerations","externalforcetorque","returncomponents") sComputeInverseDynamicsDoc.c_str()))
 #endif
+                         .def("ComputeMassMatrix",&PyKinBody::ComputeMassMatrix, DOXY_FN(KinBody,ComputeMassMatrix))
+                         .def("ComputeGravityTorques",&PyKinBody::ComputeGravityTorques, DOXY_FN(KinBody,ComputeGravityTorques))
+                         .def("ComputeCoriolisMatrix",&PyKinBody::ComputeCoriolisMatrix, DOXY_FN(KinBody,ComputeCoriolisMatrix))
                          .def("GetDOFDynamicAccelerationJerkLimits",&PyKinBody::GetDOFDynamicAccelerationJerkLimits, PY_ARGS("dofPositions","dofVelocities") DOXY_FN(KinBody,ComputeDynamicLimits))
                          .def("SetSelfCollisionChecker",&PyKinBody::SetSelfCollisionChecker,PY_ARGS("collisionchecker") DOXY_FN(KinBody,SetSelfCollisionChecker))
                          .def("GetSelfCollisionChecker", &PyKinBody::GetSelfCollisionChecker, /*PY_ARGS("collisionchecker")*/ DOXY_FN(KinBody,GetSelfCollisionChecker))
@@ -6076,6 +6152,18 @@ void init_openravepy_kinbody()
                          .def("GetNonAdjacentLinks",GetNonAdjacentLinks2, PY_ARGS("adjacentoptions") DOXY_FN(KinBody,GetNonAdjacentLinks))
                          .def("SetAdjacentLinks",&PyKinBody::SetAdjacentLinks, PY_ARGS("linkindex0", "linkindex1") DOXY_FN(KinBody,SetAdjacentLinks))
                          .def("SetAdjacentLinksCombinations",&PyKinBody::SetAdjacentLinksCombinations, PY_ARGS("linkIndices") DOXY_FN(KinBody,SetAdjacentLinksCombinations))
+#ifdef USE_PYBIND11_PYTHON_BINDINGS
+                         .def("ComputeNeverCollidingLinkPairs", &PyKinBody::ComputeNeverCollidingLinkPairs,
+                              "numSamples"_a = 10000,
+                              "forceRecompute"_a = false,
+                              "margin"_a = 0.01,
+                              DOXY_FN(KinBody, ComputeNeverCollidingLinkPairs)
+                              )
+#else
+                         .def("ComputeNeverCollidingLinkPairs",&PyKinBody::ComputeNeverCollidingLinkPairs, ComputeNeverCollidingLinkPairs_overloads(PY_ARGS("numSamples","forceRecompute","margin") DOXY_FN(KinBody,ComputeNeverCollidingLinkPairs)))
+#endif
+                         .def("ResetNeverCollidingLinkPairs",&PyKinBody::ResetNeverCollidingLinkPairs, DOXY_FN(KinBody,ResetNeverCollidingLinkPairs))
+                         .def("HasNeverCollidingLinkPairs",&PyKinBody::HasNeverCollidingLinkPairs, DOXY_FN(KinBody,HasNeverCollidingLinkPairs))
                          .def("GetAdjacentLinks",&PyKinBody::GetAdjacentLinks, DOXY_FN(KinBody,GetAdjacentLinks))
                          .def("GetManageData",&PyKinBody::GetManageData, DOXY_FN(KinBody,GetManageData))
                          .def("GetUpdateStamp",&PyKinBody::GetUpdateStamp, DOXY_FN(KinBody,GetUpdateStamp))
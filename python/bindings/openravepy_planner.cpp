@@ -59,6 +59,44 @@ std::string PyPlannerProgress::__str__() {
     return boost::str(boost::format("<PlannerProgress: iter=%d>")%_iteration);
 }
 
+PyPlanPathHandle::PyPlanPathHandle(PlannerBase::PlanPathHandlePtr phandle) : _phandle(phandle) {
+}
+PyPlanPathHandle::~PyPlanPathHandle() {
+    // destroying the handle waits for the planner, which can call python callbacks
+    openravepy::PythonThreadSaver statesaver;
+    _phandle.reset();
+}
+
+void PyPlanPathHandle::Cancel()
+{
+    _phandle->Cancel();
+}
+
+bool PyPlanPathHandle::IsDone()
+{
+    return _phandle->IsDone();
+}
+
+bool PyPlanPathHandle::Wait(double timeout)
+{
+    openravepy::PythonThreadSaver statesaver;
+    return _phandle->Wait(timeout);
+}
+
+object PyPlanPathHandle::GetStatus()
+{
+    {
+        openravepy::PythonThreadSaver statesaver;
+        _phandle->Wait(-1);
+    }
+    return openravepy::toPyPlannerStatus(_phandle->GetStatus());
+}
+
+OPENRAVE_SHARED_PTR<PyPlannerProgress> PyPlanPathHandle::GetProgress()
+{
+    return OPENRAVE_SHARED_PTR<PyPlannerProgress>(new PyPlannerProgress(_phandle->GetProgress()));
+}
+
 PyPlannerStatus::PyPlannerStatus() {
 }
 
@@ -182,6 +220,16 @@ void PyPlannerBase::PyPlannerParameters::SetMaxIterations(int nMaxIterations)
     _paramswrite->_nMaxIterations = nMaxIterations;
 }
 
+void PyPlannerBase::PyPlannerParameters::SetParallelCollisionCheckingWorkers(int numworkers)
+{
+    _paramswrite->_nParallelCollisionCheckingWorkers = numworkers;
+}
+
+void PyPlannerBase::PyPlannerParameters::SetBatchCollisionChecking(bool bBatchCollisionChecking)
+{
+    _paramswrite->_bBatchCollisionChecking = bBatchCollisionChecking;
+}
+
 object PyPlannerBase::PyPlannerParameters::CheckPathAllConstraints(object oq0, object oq1, object odq0, object odq1, dReal timeelapsed, IntervalType interval, uint32_t options, bool filterreturn)
 {
     const std::vector<dReal> q0, q1, dq0, dq1;
@@ -324,6 +372,11 @@ object PyPlannerBase::PlanPath(PyTrajectoryBasePtr pytraj, bool releasegil)
     return openravepy::toPyPlannerStatus(status);
 }
 
+PyPlanPathHandlePtr PyPlannerBase::PlanPathAsync(PyTrajectoryBasePtr pytraj)
+{
+    return PyPlanPathHandlePtr(new PyPlanPathHandle(_pplanner->PlanPathAsync(openravepy::GetTrajectory(pytraj))));
+}
+
 PyPlannerParametersPtr PyPlannerBase::GetParameters() const
 {
     PlannerBase::PlannerParametersConstPtr params = _pplanner->GetParameters();
@@ -429,6 +482,7 @@ PyPlannerBasePtr RaveCreatePlanner(PyEnvironmentBasePtr pyenv, const std::string
 #ifndef USE_PYBIND11_PYTHON_BINDINGS
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(InitPlan_overloads, InitPlan, 2, 3)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(PlanPath_overloads, PlanPath, 1, 2)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(Wait_overloads, Wait, 0, 1)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(CheckPathAllConstraints_overloads, CheckPathAllConstraints, 6, 8)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(SetStateValues_overloads, SetStateValues, 1, 2)
 #endif // USE_PYBIND11_PYTHON_BINDINGS
@@ -480,6 +534,25 @@ void init_openravepy_planner()
     .def_readwrite("_iteration",&PyPlannerProgress::_iteration)
     ;
 
+#ifdef USE_PYBIND11_PYTHON_BINDINGS
+    class_<PyPlanPathHandle, PyPlanPathHandlePtr >(m, "PlanPathHandle", DOXY_CLASS(PlannerBase::PlanPathHandle))
+#else
+    class_<PyPlanPathHandle, PyPlanPathHandlePtr >("PlanPathHandle", DOXY_CLASS(PlannerBase::PlanPathHandle), no_init)
+#endif
+    .def("Cancel",&PyPlanPathHandle::Cancel, DOXY_FN(PlannerBase::PlanPathHandle,Cancel))
+    .def("IsDone",&PyPlanPathHandle::IsDone, DOXY_FN(PlannerBase::PlanPathHandle,IsDone))
+#ifdef USE_PYBIND11_PYTHON_BINDINGS
+    .def("Wait", &PyPlanPathHandle::Wait,
+         "timeout"_a = -1,
+         DOXY_FN(PlannerBase::PlanPathHandle, Wait)
+         )
+#else
+    .def("Wait",&PyPlanPathHandle::Wait,Wait_overloads(PY_ARGS("timeout") DOXY_FN(PlannerBase::PlanPathHandle,Wait)))
+#endif
+    .def("GetStatus",&PyPlanPathHandle::GetStatus, DOXY_FN(PlannerBase::PlanPathHandle,GetStatus))
+    .def("GetProgress",&PyPlanPathHandle::GetProgress, DOXY_FN(PlannerBase::PlanPathHandle,GetProgress))
+    ;
+
     {
         bool (PyPlannerBase::*InitPlan1)(PyRobotBasePtr, PyPlannerBase::PyPlannerParametersPtr,bool) = &PyPlannerBase::InitPlan;
         bool (PyPlannerBase::*InitPlan2)(PyRobotBasePtr, const string &) = &PyPlannerBase::InitPlan;
@@ -508,6 +581,7 @@ void init_openravepy_planner()
 #else
                          .def("PlanPath",&PyPlannerBase::PlanPath,PlanPath_overloads(PY_ARGS("traj","releasegil") DOXY_FN(PlannerBase,PlanPath)))
 #endif
+                         .def("PlanPathAsync",&PyPlannerBase::PlanPathAsync, PY_ARGS("traj") DOXY_FN(PlannerBase,PlanPathAsync))
                          .def("GetParameters",&PyPlannerBase::GetParameters, DOXY_FN(PlannerBase,GetParameters))
                          .def("RegisterPlanCallback",&PyPlannerBase::RegisterPlanCallback, DOXY_FN(PlannerBase,RegisterPlanCallback))
         ;
@@ -537,6 +611,8 @@ void init_openravepy_planner()
         .def("SetConfigJerkLimit",&PyPlannerBase::PyPlannerParameters::SetConfigJerkLimit, PY_ARGS("jerks") "sets PlannerParameters::_vConfigJerkLimit")
         .def("SetConfigResolution",&PyPlannerBase::PyPlannerParameters::SetConfigResolution, PY_ARGS("resolutions") "sets PlannerParameters::_vConfigResolution")
         .def("SetMaxIterations",&PyPlannerBase::PyPlannerParameters::SetMaxIterations, PY_ARGS("maxiterations") "sets PlannerParameters::_nMaxIterations")
+        .def("SetParallelCollisionCheckingWorkers",&PyPlannerBase::PyPlannerParameters::SetParallelCollisionCheckingWorkers, PY_ARGS("numworkers") "sets PlannerParameters::_nParallelCollisionCheckingWorkers")
+        .def("SetBatchCollisionChecking",&PyPlannerBase::PyPlannerParameters::SetBatchCollisionChecking, PY_ARGS("batchcollisionchecking") "sets PlannerParameters::_bBatchCollisionChecking")
 #ifdef USE_PYBIND11_PYTHON_BINDINGS
         .def("CheckPathAllConstraints", &PyPlannerBase::PyPlannerParameters::CheckPathAllConstraints,
              "q0"_a,
@@ -346,9 +346,9 @@ size_t pyInsertActiveDOFWaypointWithRetiming(int index, object odofvalues, objec
     return OpenRAVE::planningutils::InsertActiveDOFWaypointWithRetiming(index, ExtractArray<dReal>(odofvalues), ExtractArray<dReal>(odofvelocities), openravepy::GetTrajectory(pytraj), openravepy::GetRobot(pyrobot), fmaxvelmult, fmaxaccelmult, plannername, plannerparameters);
 }
 
-size_t pyInsertWaypointWithSmoothing(int index, object odofvalues, object odofvelocities, PyTrajectoryBasePtr pytraj, dReal fmaxvelmult=1, dReal fmaxaccelmult=1, const std::string& plannername="")
+size_t pyInsertWaypointWithSmoothing(int index, object odofvalues, object odofvelocities, PyTrajectoryBasePtr pytraj, dReal fmaxvelmult=1, dReal fmaxaccelmult=1, const std::string& plannername="", int maxwindowwaypoints=0)
 {
-    return OpenRAVE::planningutils::InsertWaypointWithSmoothing(index,ExtractArray<dReal>(odofvalues),ExtractArray<dReal>(odofvelocities),openravepy::GetTrajectory(pytraj),fmaxvelmult,fmaxaccelmult,plannername);
+    return OpenRAVE::planningutils::InsertWaypointWithSmoothing(index,ExtractArray<dReal>(odofvalues),ExtractArray<dReal>(odofvelocities),openravepy::GetTrajectory(pytraj),fmaxvelmult,fmaxaccelmult,plannername,maxwindowwaypoints);
 }
 
 void pySegmentTrajectory(PyTrajectoryBasePtr pytraj, dReal starttime, dReal endtime)
@@ -524,7 +524,7 @@ BOOST_PYTHON_FUNCTION_OVERLOADS(RetimeAffineTrajectory_overloads, planningutils:
 BOOST_PYTHON_FUNCTION_OVERLOADS(RetimeTrajectory_overloads, planningutils::pyRetimeTrajectory, 1, 6)
 BOOST_PYTHON_FUNCTION_OVERLOADS(ExtendActiveDOFWaypoint_overloads, planningutils::pyExtendActiveDOFWaypoint, 5, 8)
 BOOST_PYTHON_FUNCTION_OVERLOADS(InsertActiveDOFWaypointWithRetiming_overloads, planningutils::pyInsertActiveDOFWaypointWithRetiming, 5, 9)
-BOOST_PYTHON_FUNCTION_OVERLOADS(InsertWaypointWithSmoothing_overloads, planningutils::pyInsertWaypointWithSmoothing, 4, 7)
+BOOST_PYTHON_FUNCTION_OVERLOADS(InsertWaypointWithSmoothing_overloads, planningutils::pyInsertWaypointWithSmoothing, 4, 8)
 BOOST_PYTHON_FUNCTION_OVERLOADS(VerifyTrajectory_overloads, planningutils::pyVerifyTrajectory, 3, 4)
 
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(Check_overloads, Check, 5, 8)
@@ -732,10 +732,11 @@ void InitPlanningUtils()
                                            "maxvelmult"_a = 1.0,
                                            "maxaccelmult"_a = 1.0,
                                            "plannername"_a = "",
+                                           "maxwindowwaypoints"_a = 0,
                                            DOXY_FN1(InsertWaypointWithSmoothing)
                                            )
 #else
-                               .def("InsertWaypointWithSmoothing",planningutils::pyInsertWaypointWithSmoothing, InsertWaypointWithSmoothing_overloads(PY_ARGS("index","dofvalues","dofvelocities","trajectory","maxvelmult","maxaccelmult","plannername") DOXY_FN1(InsertWaypointWithSmoothing)))
+                               .def("InsertWaypointWithSmoothing",planningutils::pyInsertWaypointWithSmoothing, InsertWaypointWithSmoothing_overloads(PY_ARGS("index","dofvalues","dofvelocities","trajectory","maxvelmult","maxaccelmult","plannername","maxwindowwaypoints") DOXY_FN1(InsertWaypointWithSmoothing)))
                                .staticmethod("InsertWaypointWithSmoothing")
 #endif
 #ifdef USE_PYBIND11_PYTHON_BINDINGS
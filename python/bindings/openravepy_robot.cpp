@@ -1135,6 +1135,30 @@ object PyRobotBase::PyManipulator::FindIKSolutions(object oparam, object freepar
     }
 }
 
+object PyRobotBase::PyManipulator::FindIKSolutionBatch(object oposes, int filteroptions) const
+{
+    std::vector<dReal> vposes;
+    const size_t numposes = ExtractArray2D(oposes, 7, vposes);
+    const int armdof = _pmanip->GetArmDOF();
+    std::vector<dReal> vsolutions(numposes*armdof, 0);
+    std::vector<uint8_t> vfound(numposes, 0);
+    {
+        openravepy::PythonThreadSaver threadsaver;
+        EnvironmentLock lock(openravepy::GetEnvironment(_pyenv)->GetMutex());
+        std::vector<dReal> vsolution;
+        for(size_t ipose = 0; ipose < numposes; ++ipose) {
+            const dReal* ppose = &vposes[7*ipose];
+            const Transform t(Vector(ppose[0], ppose[1], ppose[2], ppose[3]), Vector(ppose[4], ppose[5], ppose[6]));
+            if( _pmanip->FindIKSolution(IkParameterization(t), vsolution, filteroptions) && (int)vsolution.size() == armdof ) {
+                std::copy(vsolution.begin(), vsolution.end(), vsolutions.begin() + ipose*armdof);
+                vfound[ipose] = 1;
+            }
+        }
+    }
+    std::vector<npy_intp> dims = { npy_intp(numposes), npy_intp(armdof) };
+    return py::make_tuple(toPyArrayMove(vsolutions, dims), toPyBoolArray(vfound));
+}
+
 object PyRobotBase::PyManipulator::GetIkParameterization(object oparam, bool inworld)
 {
     IkParameterization ikparam;
@@ -1465,6 +1489,10 @@ bool PyRobotBase::PyConnectedBody::SetActive(int active) {
 int PyRobotBase::PyConnectedBody::IsActive() {
     return _pconnected->IsActive();
 }
+
+bool PyRobotBase::PyConnectedBody::CanSetActiveWithoutReinitialize(int active) const {
+    return _pconnected->CanSetActiveWithoutReinitialize(active);
+}
 object PyRobotBase::PyConnectedBody::GetTransform() const {
     return ReturnTransform(_pconnected->GetTransform());
 }
@@ -1793,6 +1821,16 @@ void PyRobotBase::SetConnectedBodyActiveStates(object oactivestates)
     _probot->SetConnectedBodyActiveStates(activestates);
 }
 
+void PyRobotBase::SetPreinstantiateConnectedBodies(bool bPreinstantiate)
+{
+    _probot->SetPreinstantiateConnectedBodies(bPreinstantiate);
+}
+
+bool PyRobotBase::IsPreinstantiateConnectedBodies() const
+{
+    return _probot->IsPreinstantiateConnectedBodies();
+}
+
 bool PyRobotBase::AddGripperInfo(object oGripperInfo, bool removeduplicate)
 {
     RobotBase::GripperInfoPtr pGripperInfo(new RobotBase::GripperInfo());
@@ -2701,6 +2739,8 @@ void init_openravepy_robot()
                        .def("GetConnectedBody",&PyRobotBase::GetConnectedBody, PY_ARGS("bodyname") DOXY_FN(RobotBase,GetConnectedBody))
                        .def("GetConnectedBodyActiveStates",&PyRobotBase::GetConnectedBodyActiveStates, DOXY_FN(RobotBase,GetConnectedBodyActiveStates))
                        .def("SetConnectedBodyActiveStates",&PyRobotBase::SetConnectedBodyActiveStates, DOXY_FN(RobotBase,SetConnectedBodyActiveStates))
+                       .def("SetPreinstantiateConnectedBodies",&PyRobotBase::SetPreinstantiateConnectedBodies, PY_ARGS("preinstantiate") DOXY_FN(RobotBase,SetPreinstantiateConnectedBodies))
+                       .def("IsPreinstantiateConnectedBodies",&PyRobotBase::IsPreinstantiateConnectedBodies, DOXY_FN(RobotBase,IsPreinstantiateConnectedBodies))
 #ifdef USE_PYBIND11_PYTHON_BINDINGS
                        .def("AddGripperInfo",&PyRobotBase::AddGripperInfo,
                             "gripperInfo"_a,
@@ -2913,6 +2953,7 @@ void init_openravepy_robot()
 #else
         .def("FindIKSolutions",pmanipiksf,FindIKSolutionsFree_overloads(PY_ARGS("param","freevalues","filteroptions","ikreturn","releasegil","ikFailureAccumulator") DOXY_FN(RobotBase::Manipulator,FindIKSolutions "const IkParameterization; const std::vector; std::vector; int; IkFailureAccumulatorBase")))
 #endif
+        .def("FindIKSolutionBatch",&PyRobotBase::PyManipulator::FindIKSolutionBatch, PY_ARGS("poses","filteroptions") "Finds one ik solution for every row of the Nx7 array of [qw, qx, qy, qz, x, y, z] end effector poses without holding the GIL. Returns the Nx(armdof) solutions and an N bool array telling which poses have a solution.")
 #ifdef USE_PYBIND11_PYTHON_BINDINGS
         .def("GetIkParameterization", &PyRobotBase::PyManipulator::GetIkParameterization,
              "iktype"_a,
@@ -3057,6 +3098,7 @@ void init_openravepy_robot()
         .def("GetInfo",&PyRobotBase::PyConnectedBody::GetInfo, DOXY_FN(RobotBase::ConnectedBody,GetInfo))
         .def("SetActive", &PyRobotBase::PyConnectedBody::SetActive, DOXY_FN(RobotBase::ConnectedBody,SetActive))
         .def("IsActive", &PyRobotBase::PyConnectedBody::IsActive, DOXY_FN(RobotBase::ConnectedBody,IsActive))
+        .def("CanSetActiveWithoutReinitialize", &PyRobotBase::PyConnectedBody::CanSetActiveWithoutReinitialize, PY_ARGS("active") DOXY_FN(RobotBase::ConnectedBody,CanSetActiveWithoutReinitialize))
         .def("SetLinkEnable", &PyRobotBase::PyConnectedBody::SetLinkEnable, DOXY_FN(RobotBase::ConnectedBody,SetLinkEnable))
         .def("SetLinkVisible", &PyRobotBase::PyConnectedBody::SetLinkVisible, DOXY_FN(RobotBase::ConnectedBody,SetLinkVisible))
         .def("GetTransform",&PyRobotBase::PyConnectedBody::GetTransform, DOXY_FN(RobotBase::ConnectedBody,GetTransform))
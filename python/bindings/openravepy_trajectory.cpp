@@ -252,28 +252,24 @@ object PyTrajectoryBase::SampleFromPrevious(object odata, dReal time, OPENRAVE_S
     return this->SampleFromPrevious(odata, time, pyspec);
 }
 
+/// \brief returns values as a 2D array with numdof columns, taking over the storage of values instead of copying it
+static object _ConvertToObject(std::vector<dReal>& values, int numdof)
+{
+    std::vector<npy_intp> dims = { npy_intp(values.size()/numdof), npy_intp(numdof) };
+    return toPyArrayMove(values, dims);
+}
+
 object PyTrajectoryBase::SamplePoints2D(object otimes) const
 {
     std::vector<dReal>& vtimes = _vtimesCache;
     if (!ExtractContiguousArrayToVector(otimes, vtimes)) {
         vtimes = ExtractArray<dReal>(otimes);
     }
-    std::vector<dReal>& values = _vdataCache;
+    std::vector<dReal> values; // handed over to the returned array
     _ptrajectory->SamplePoints(values,vtimes);
 
     const int numdof = _ptrajectory->GetConfigurationSpecification().GetDOF();
-#ifdef USE_PYBIND11_PYTHON_BINDINGS
-    py::array_t<dReal> pypos = toPyArray(values);
-    pypos.resize({(int) values.size()/numdof, numdof});
-    return pypos;
-#else // USE_PYBIND11_PYTHON_BINDINGS
-    npy_intp dims[] = { npy_intp(values.size()/numdof), npy_intp(numdof) };
-    PyObject *pypos = PyArray_SimpleNew(2,dims, sizeof(dReal)==8 ? PyArray_DOUBLE : PyArray_FLOAT);
-    if( !values.empty() ) {
-        memcpy(PyArray_DATA(pypos), values.data(), values.size()*sizeof(values[0]));
-    }
-    return py::to_array_astype<dReal>(pypos);
-#endif // USE_PYBIND11_PYTHON_BINDINGS
+    return _ConvertToObject(values, numdof);
 }
 
 object PyTrajectoryBase::SamplePoints2D(object otimes, PyConfigurationSpecificationPtr pyspec) const
@@ -283,45 +279,18 @@ object PyTrajectoryBase::SamplePoints2D(object otimes, PyConfigurationSpecificat
     if (!ExtractContiguousArrayToVector(otimes, vtimes)) {
         vtimes = ExtractArray<dReal>(otimes);
     }
-    std::vector<dReal>& values = _vdataCache;
+    std::vector<dReal> values; // handed over to the returned array
     _ptrajectory->SamplePoints(values, vtimes, spec);
 
     const int numdof = spec.GetDOF();
-#ifdef USE_PYBIND11_PYTHON_BINDINGS
-    py::array_t<dReal> pypos = toPyArray(values);
-    pypos.resize({(int) values.size()/numdof, numdof});
-    return pypos;
-#else // USE_PYBIND11_PYTHON_BINDINGS
-    npy_intp dims[] = { npy_intp(values.size()/numdof), npy_intp(numdof) };
-    PyObject *pypos = PyArray_SimpleNew(2,dims, sizeof(dReal)==8 ? PyArray_DOUBLE : PyArray_FLOAT);
-    if( !values.empty() ) {
-        memcpy(PyArray_DATA(pypos), values.data(), values.size()*sizeof(values[0]));
-    }
-    return py::to_array_astype<dReal>(pypos);
-#endif // USE_PYBIND11_PYTHON_BINDINGS
+    return _ConvertToObject(values, numdof);
 }
 
 
-object _ConvertToObject(const std::vector<dReal>& values, int numdof)
-{
-#ifdef USE_PYBIND11_PYTHON_BINDINGS
-    py::array_t<dReal> pypos = toPyArray(values);
-    pypos.resize({(int) values.size()/numdof, numdof});
-    return pypos;
-#else // USE_PYBIND11_PYTHON_BINDINGS
-    npy_intp dims[] = { npy_intp(values.size()/numdof), npy_intp(numdof) };
-    PyObject *pypos = PyArray_SimpleNew(2,dims, sizeof(dReal)==8 ? PyArray_DOUBLE : PyArray_FLOAT);
-    if( !values.empty() ) {
-        memcpy(PyArray_DATA(pypos), values.data(), values.size()*sizeof(values[0]));
-    }
-    return py::to_array_astype<dReal>(pypos);
-#endif // USE_PYBIND11_PYTHON_BINDINGS
-}
-
 object PyTrajectoryBase::SamplePointsSameDeltaTime2D(dReal deltatime,
                                                      bool ensureLastPoint) const
 {
-    std::vector<dReal>& values = _vdataCache;
+    std::vector<dReal> values; // handed over to the returned array
     _ptrajectory->SamplePointsSameDeltaTime(values, deltatime, ensureLastPoint);
     const int numdof = _ptrajectory->GetConfigurationSpecification().GetDOF();
     return _ConvertToObject(values, numdof);
@@ -332,7 +301,7 @@ object PyTrajectoryBase::SamplePointsSameDeltaTime2D(dReal deltatime,
                                                      bool ensureLastPoint,
                                                      PyConfigurationSpecificationPtr pyspec) const
 {
-    std::vector<dReal>& values = _vdataCache;
+    std::vector<dReal> values; // handed over to the returned array
     ConfigurationSpecification spec = openravepy::GetConfigurationSpecification(pyspec);
     _ptrajectory->SamplePointsSameDeltaTime(values, deltatime, ensureLastPoint, spec);
 
@@ -353,7 +322,7 @@ object PyTrajectoryBase::SampleRangeSameDeltaTime2D(dReal deltatime,
                                                     dReal stopTime,
                                                     bool ensureLastPoint) const
 {
-    std::vector<dReal>& values = _vdataCache;
+    std::vector<dReal> values; // handed over to the returned array
     _ptrajectory->SampleRangeSameDeltaTime(values, deltatime, startTime, stopTime, ensureLastPoint);
     const int numdof = _ptrajectory->GetConfigurationSpecification().GetDOF();
     return _ConvertToObject(values, numdof);
@@ -366,7 +335,7 @@ object PyTrajectoryBase::SampleRangeSameDeltaTime2D(dReal deltatime,
                                                     bool ensureLastPoint,
                                                     PyConfigurationSpecificationPtr pyspec) const
 {
-    std::vector<dReal>& values = _vdataCache;
+    std::vector<dReal> values; // handed over to the returned array
     ConfigurationSpecification spec = openravepy::GetConfigurationSpecification(pyspec);
     _ptrajectory->SampleRangeSameDeltaTime(values, deltatime, startTime, stopTime, ensureLastPoint, spec);
 
@@ -400,16 +369,18 @@ size_t PyTrajectoryBase::GetNumWaypoints() const {
 
 object PyTrajectoryBase::GetWaypoints(size_t startindex, size_t endindex) const
 {
-    std::vector<dReal>& values = _vdataCache;
+    std::vector<dReal> values; // handed over to the returned array
     _ptrajectory->GetWaypoints(startindex,endindex,values);
-    return toPyArray(values);
+    std::vector<npy_intp> dims = { npy_intp(values.size()) };
+    return toPyArrayMove(values, dims);
 }
 
 object PyTrajectoryBase::GetWaypoints(size_t startindex, size_t endindex, PyConfigurationSpecificationPtr pyspec) const
 {
-    std::vector<dReal>& values = _vdataCache;
+    std::vector<dReal> values; // handed over to the returned array
     _ptrajectory->GetWaypoints(startindex,endindex,values,openravepy::GetConfigurationSpecification(pyspec));
-    return toPyArray(values);
+    std::vector<npy_intp> dims = { npy_intp(values.size()) };
+    return toPyArrayMove(values, dims);
 }
 
 object PyTrajectoryBase::GetWaypoints(size_t startindex, size_t endindex, OPENRAVE_SHARED_PTR<ConfigurationSpecification::Group> pygroup) const
@@ -421,22 +392,11 @@ object PyTrajectoryBase::GetWaypoints(size_t startindex, size_t endindex, OPENRA
 // similar to GetWaypoints except returns a 2D array, one row for every waypoint
 object PyTrajectoryBase::GetWaypoints2D(size_t startindex, size_t endindex) const
 {
-    std::vector<dReal>& values = _vdataCache;
+    std::vector<dReal> values; // handed over to the returned array
     _ptrajectory->GetWaypoints(startindex,endindex,values);
     const int numdof = _ptrajectory->GetConfigurationSpecification().GetDOF();
 
-#ifdef USE_PYBIND11_PYTHON_BINDINGS
-    py::array_t<dReal> pypos = toPyArray(values);
-    pypos.resize({(int) values.size()/numdof, numdof});
-    return pypos;
-#else // USE_PYBIND11_PYTHON_BINDINGS
-    npy_intp dims[] = { npy_intp(values.size()/numdof), npy_intp(numdof) };
-    PyObject *pypos = PyArray_SimpleNew(2,dims, sizeof(dReal)==8 ? PyArray_DOUBLE : PyArray_FLOAT);
-    if( !values.empty() ) {
-        memcpy(PyArray_DATA(pypos), values.data(), values.size()*sizeof(values[0]));
-    }
-    return py::to_array_astype<dReal>(pypos);
-#endif // USE_PYBIND11_PYTHON_BINDINGS
+    return _ConvertToObject(values, numdof);
 }
 
 object PyTrajectoryBase::__getitem__(int index) const
@@ -512,23 +472,11 @@ object PyTrajectoryBase::GetAllWaypoints2D() const
 
 object PyTrajectoryBase::GetWaypoints2D(size_t startindex, size_t endindex, PyConfigurationSpecificationPtr pyspec) const
 {
-    std::vector<dReal>& values = _vdataCache;
+    std::vector<dReal> values; // handed over to the returned array
     ConfigurationSpecification spec = openravepy::GetConfigurationSpecification(pyspec);
     _ptrajectory->GetWaypoints(startindex,endindex,values,spec);
     const int numdof = spec.GetDOF();
-    const int nvalues = values.size();
-#ifdef USE_PYBIND11_PYTHON_BINDINGS
-    py::array_t<dReal> pypos = toPyArray(values);
-    pypos.resize({nvalues/numdof, numdof});
-    return pypos;
-#else // USE_PYBIND11_PYTHON_BINDINGS
-    npy_intp dims[] = { npy_intp(nvalues/numdof), npy_intp(numdof) };
-    PyObject *pypos = PyArray_SimpleNew(2,dims, sizeof(dReal)==8 ? PyArray_DOUBLE : PyArray_FLOAT);
-    if( !values.empty() ) {
-        memcpy(PyArray_DATA(pypos), values.data(), nvalues*sizeof(values[0]));
-    }
-    return py::to_array_astype<dReal>(pypos);
-#endif // USE_PYBIND11_PYTHON_BINDINGS
+    return _ConvertToObject(values, numdof);
 }
 
 object PyTrajectoryBase::GetWaypoints2D(size_t startindex, size_t endindex, OPENRAVE_SHARED_PTR<ConfigurationSpecification::Group> pygroup) const
@@ -577,6 +525,10 @@ dReal PyTrajectoryBase::GetDuration() const {
     return _ptrajectory->GetDuration();
 }
 
+uint64_t PyTrajectoryBase::GetDataHash() const {
+    return _ptrajectory->GetDataHash();
+}
+
 void PyTrajectoryBase::deserialize(const string& s)
 {
     std::stringstream ss(s);
@@ -606,6 +558,11 @@ void PyTrajectoryBase::LoadFromFile(const std::string& filename)
     f.close(); // necessary?
 }
 
+void PyTrajectoryBase::LoadFromMappedFile(const std::string& filename)
+{
+    _ptrajectory->DeserializeFromMappedFile(filename);
+}
+
 TrajectoryBasePtr PyTrajectoryBase::GetTrajectory() {
     return _ptrajectory;
 }
@@ -753,6 +710,7 @@ void init_openravepy_trajectory()
     .def("GetWaypoint",GetWaypoint3, PY_ARGS("index","group") DOXY_FN(TrajectoryBase, GetWaypoint "int; std::vector; const ConfigurationSpecification::Group"))
     .def("GetFirstWaypointIndexAfterTime",&PyTrajectoryBase::GetFirstWaypointIndexAfterTime, DOXY_FN(TrajectoryBase, GetFirstWaypointIndexAfterTime))
     .def("GetDuration",&PyTrajectoryBase::GetDuration,DOXY_FN(TrajectoryBase, GetDuration))
+    .def("GetDataHash",&PyTrajectoryBase::GetDataHash,DOXY_FN(TrajectoryBase, GetDataHash))
 #ifdef USE_PYBIND11_PYTHON_BINDINGS
     .def("serialize", &PyTrajectoryBase::serialize,
          "options"_a = py::none_(),
@@ -769,6 +727,7 @@ void init_openravepy_trajectory()
 #endif
     .def("deserialize",&PyTrajectoryBase::deserialize, PY_ARGS("data") DOXY_FN(TrajectoryBase,deserialize))
     .def("LoadFromFile",&PyTrajectoryBase::LoadFromFile, PY_ARGS("filename") DOXY_FN(TrajectoryBase,deserialize))
+    .def("LoadFromMappedFile",&PyTrajectoryBase::LoadFromMappedFile, PY_ARGS("filename") DOXY_FN(TrajectoryBase,DeserializeFromMappedFile))
     .def("__len__",&PyTrajectoryBase::GetNumWaypoints,DOXY_FN(TrajectoryBase,__len__))
     .def("__getitem__",__getitem__1, PY_ARGS("index") DOXY_FN(TrajectoryBase, __getitem__ "int"))
     .def("__getitem__",__getitem__2, PY_ARGS("indices") DOXY_FN(TrajectoryBase, __getitem__ "slice"))
@@ -57,7 +57,7 @@ if not __openravepy_build_doc__:
 else:
     from numpy import array
 
-from ..openravepy_int import RaveFindDatabaseFile, IkParameterization, rotationMatrixFromQArray, poseFromMatrix
+from ..openravepy_int import RaveFindDatabaseFile, RaveCreateModule, IkParameterization, rotationMatrixFromQArray, poseFromMatrix, quatFromRotationMatrix
 from ..openravepy_ext import transformPoints, quatArrayTDist
 from .. import metaclass, pyANN
 from ..misc import SpaceSamplerExtra
@@ -268,6 +268,42 @@ class ReachabilityModel(DatabaseGenerator):
                     links.append(newlink)
         return links
 
+    def _SampleSpace(self,maxradius,translationonly,xyzdelta,quatdelta,usefreespace):
+        """moves the manipulator base to the origin, only enables the manipulator links and samples the translations and rotations of the tool. Has to be called with the robot state saved.
+        """
+        Tbase = self.manip.GetBase().GetTransform()
+        Tbaseinv = linalg.inv(Tbase)
+        Trobot=dot(Tbaseinv,self.robot.GetTransform())
+        self.robot.SetTransform(Trobot) # set base link to global origin
+        maniplinks = self.getManipulatorLinks(self.manip)
+        for link in self.robot.GetLinks():
+            link.Enable(link in maniplinks)
+        # the axes' anchors are the best way to find the max radius
+        # the best estimate of arm length is to sum up the distances of the anchors of all the points in between the chain
+        armjoints = self.getOrderedArmJoints()
+        baseanchor = armjoints[0].GetAnchor()
+        eetrans = self.manip.GetTransform()[0:3,3]
+        armlength = 0
+        for j in armjoints[::-1]:
+            armlength += sqrt(sum((eetrans-j.GetAnchor())**2))
+            eetrans = j.GetAnchor()    
+        if maxradius is None:
+            maxradius = armlength+xyzdelta*sqrt(3.0)*1.05
+
+        allpoints,insideinds,shape,self.pointscale = self.UniformlySampleSpace(maxradius,delta=xyzdelta)
+        qarray = SpaceSamplerExtra().sampleSO3(quatdelta=quatdelta)
+        rotations = [eye(3)] if translationonly else rotationMatrixFromQArray(qarray)
+        self.xyzdelta = xyzdelta
+        self.quatdelta = 0
+        if not translationonly:
+            # for rotations, get the average distance to the nearest rotation
+            neighdists = []
+            for q in qarray:
+                neighdists.append(nsmallest(2,quatArrayTDist(q,qarray))[1])
+            self.quatdelta = mean(neighdists)
+        log.info('radius: %f, xyzsamples: %d, quatdelta: %f, rot samples: %d, freespace: %d',maxradius,len(insideinds),self.quatdelta,len(rotations),usefreespace)
+        return Trobot,baseanchor,allpoints,insideinds,shape,rotations
+
     def generatepcg(self,maxradius=None,translationonly=False,xyzdelta=None,quatdelta=None,usefreespace=False):
         """Generate producer, consumer, and gatherer functions allowing parallelization
         """
@@ -280,37 +316,7 @@ class ReachabilityModel(DatabaseGenerator):
             quatdelta=0.5
         self.kdtree3d = self.kdtree6d = None
         with self.robot:
-            Tbase = self.manip.GetBase().GetTransform()
-            Tbaseinv = linalg.inv(Tbase)
-            Trobot=dot(Tbaseinv,self.robot.GetTransform())
-            self.robot.SetTransform(Trobot) # set base link to global origin
-            maniplinks = self.getManipulatorLinks(self.manip)
-            for link in self.robot.GetLinks():
-                link.Enable(link in maniplinks)
-            # the axes' anchors are the best way to find the max radius
-            # the best estimate of arm length is to sum up the distances of the anchors of all the points in between the chain
-            armjoints = self.getOrderedArmJoints()
-            baseanchor = armjoints[0].GetAnchor()
-            eetrans = self.manip.GetTransform()[0:3,3]
-            armlength = 0
-            for j in armjoints[::-1]:
-                armlength += sqrt(sum((eetrans-j.GetAnchor())**2))
-                eetrans = j.GetAnchor()    
-            if maxradius is None:
-                maxradius = armlength+xyzdelta*sqrt(3.0)*1.05
-
-            allpoints,insideinds,shape,self.pointscale = self.UniformlySampleSpace(maxradius,delta=xyzdelta)
-            qarray = SpaceSamplerExtra().sampleSO3(quatdelta=quatdelta)
-            rotations = [eye(3)] if translationonly else rotationMatrixFromQArray(qarray)
-            self.xyzdelta = xyzdelta
-            self.quatdelta = 0
-            if not translationonly:
-                # for rotations, get the average distance to the nearest rotation
-                neighdists = []
-                for q in qarray:
-                    neighdists.append(nsmallest(2,quatArrayTDist(q,qarray))[1])
-                self.quatdelta = mean(neighdists)
-            log.info('radius: %f, xyzsamples: %d, quatdelta: %f, rot samples: %d, freespace: %d',maxradius,len(insideinds),self.quatdelta,len(rotations),usefreespace)
+            Trobot,baseanchor,allpoints,insideinds,shape,rotations = self._SampleSpace(maxradius,translationonly,xyzdelta,quatdelta,usefreespace)
             
         self.reachabilitydensity3d = zeros(prod(shape))
         self.reachability3d = zeros(prod(shape))
@@ -358,6 +364,65 @@ class ReachabilityModel(DatabaseGenerator):
 
         return producer, consumer, gatherer, len(insideinds)
 
+    def generatenative(self,maxradius=None,translationonly=False,xyzdelta=None,quatdelta=None,usefreespace=False,numthreads=0,countsfilename=None):
+        """Computes the same database as generate with the ReachabilityDatabase module of the rmanipulation plugin, which solves the ik of the poses on numthreads clones of the environment.
+
+        The ik solution counts are written into countsfilename while they are computed, so calling it again with the same parameters after an interruption only computes the remaining poses. The file is removed once the database is computed.
+        :param numthreads: number of threads, 0 uses all the cores
+        :param countsfilename: file keeping the counts, by default next to the database file
+        """
+        if not self.ikmodel.load():
+            self.ikmodel.autogenerate()
+        if xyzdelta is None:
+            xyzdelta=0.04
+        if quatdelta is None:
+            quatdelta=0.5
+        self.kdtree3d = self.kdtree6d = None
+        if countsfilename is None:
+            countsfilename = self.getfilename(False)+'.ikcounts'
+        try:
+            makedirs(os.path.split(countsfilename)[0])
+        except OSError:
+            pass
+        posesfilename = countsfilename+'.poses'
+        module = RaveCreateModule(self.env,'ReachabilityDatabase')
+        if module is None:
+            raise ValueError('failed to create the ReachabilityDatabase module')
+        
+        starttime = time.time()
+        with self.robot:
+            Trobot,baseanchor,allpoints,insideinds,shape,rotations = self._SampleSpace(maxradius,translationonly,xyzdelta,quatdelta,usefreespace)
+            numrotations = len(rotations)
+            poses = zeros((len(insideinds),numrotations,7))
+            poses[:,:,0:4] = array([quatFromRotationMatrix(rotation) for rotation in rotations])
+            poses[:,:,4:7] = (allpoints[insideinds]+baseanchor)[:,newaxis,:]
+            poses.tofile(posesfilename)
+            # the module clones the environment with the manipulator base at the origin and the other links disabled
+            result = module.SendCommand('ComputeIkSolutionCounts robot %s manip %s poses %s counts %s allsolutions %d numthreads %d'%(self.robot.GetName(),self.manip.GetName(),posesfilename,countsfilename,usefreespace,numthreads))
+        if result is None:
+            raise ValueError('failed to compute the ik solution counts into %s, call again to resume'%countsfilename)
+        
+        counts = numpy.memmap(countsfilename,dtype=numpy.int32,mode='r',offset=int(result.split()[0]),shape=(len(insideinds),numrotations))
+        self.reachabilitydensity3d = zeros(prod(shape))
+        self.reachability3d = zeros(prod(shape))
+        self.reachabilitydensity3d[insideinds] = sum(counts,1)/float(numrotations)
+        self.reachability3d[insideinds] = sum(counts>0,1)/float(numrotations)
+        validinds = flatnonzero(counts>0)
+        self.reachabilitystats = c_[poses.reshape((-1,7))[validinds],array(counts).flat[validinds]]
+        self.reachability3d = reshape(self.reachability3d,shape)
+        self.reachabilitydensity3d = reshape(self.reachabilitydensity3d,shape)
+        del counts
+        os.remove(posesfilename)
+        os.remove(countsfilename)
+        log.info('database %s finished natively in %fs',self.__class__.__name__,time.time()-starttime)
+
+    def autogenerate(self,options=None):
+        if options is not None and options.native:
+            self.generatenative(*self.autogenerateparams(options),numthreads=options.numthreads)
+            self.save()
+        else:
+            DatabaseGenerator.autogenerate(self,options)
+
 
     def show(self,showrobot=True,contours=[0.01,0.1,0.2,0.5,0.8,0.9,0.99],opacity=None,figureid=1, xrange=None,options=None):
         try:
@@ -423,6 +488,8 @@ class ReachabilityModel(DatabaseGenerator):
                           help='The max radius of the arm to perform the computation (default=0.5)')
         parser.add_option('--usefreespace',action='store_true',dest='usefreespace',default=False,
                           help='If set, will record the number of IK solutions that exist for every transform rather than just finding one. More useful map, but much slower to produce')
+        parser.add_option('--native',action='store_true',dest='native',default=False,
+                          help='If set, solves the ik natively with the ReachabilityDatabase module on --numthreads threads. The ik solution counts are kept next to the database file, so an interrupted generation resumes')
         parser.add_option('--showscale',action='store',type='float',dest='showscale',default=1.0,
                           help='Scales the reachability by this much in order to show colors better (default=%default)')
         return parser
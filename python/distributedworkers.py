@@ -0,0 +1,183 @@
+# -*- coding: utf-8 -*-
+# Copyright (C) 2026 Rosen Diankov <rosen.diankov@gmail.com>
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Distributes batches of environment commands to textserver workers on other machines.
+
+Every worker is an openrave process running the textserver module, for example::
+
+  openrave.py --module textserver "4765 8"
+
+The coordinator sends a msgpack snapshot of its environment to every worker once with env_loaddata, then dispatches small commands like problem_sendcmd or body_checkcollision over the binary protocol of the textserver and collects the results. The workers pull tasks from a shared queue and keep several requests in flight each, so faster workers end up with more of the batch. The tasks of a worker whose connection fails are given to the other workers.
+
+Usage::
+
+  pool = WorkerPool([('host1',4765),('host2',4765)])
+  pool.LoadEnvironment(env)
+  results = pool.Map([('problem_sendcmd', '1 MoveToHandPosition ...'), ...])
+  pool.Close()
+"""
+
+import collections
+import socket
+import struct
+import threading
+
+import msgpack
+
+import logging
+log = logging.getLogger('openravepy.'+__name__.split('.',2)[-1])
+
+class WorkerError(Exception):
+    pass
+
+class WorkerConnection(object):
+    """Connection to one textserver using the binary protocol
+    """
+    def __init__(self, host, port, timeout=None):
+        self.host = host
+        self.port = port
+        self._socket = socket.create_connection((host, port), timeout=timeout)
+        self._socket.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self._socket.sendall(b'binary\n')
+        if self._ReadFrame() != b'1':
+            raise WorkerError('%s:%d did not switch to the binary protocol'%(host, port))
+
+    def __repr__(self):
+        return '<WorkerConnection %s:%d>'%(self.host, self.port)
+
+    def Close(self):
+        if self._socket is not None:
+            self._socket.close()
+            self._socket = None
+
+    def SendRequest(self, requestid, command, args):
+        """sends a request without waiting for its response
+        """
+        if not isinstance(args, bytes):
+            args = args.encode('utf-8')
+        frame = msgpack.packb({'id': requestid, 'command': command, 'args': args}, use_bin_type=True)
+        self._socket.sendall(struct.pack('<I', len(frame)) + frame)
+
+    def ReceiveResponse(self):
+        """blocks until the next response is received
+
+        :return: (requestid, success, result)
+        """
+        response = msgpack.unpackb(self._ReadFrame(), raw=False)
+        return response['id'], response['success'], response['result']
+
+    def _ReadFrame(self):
+        size = struct.unpack('<i', self._Receive(4))[0]
+        return self._Receive(size)
+
+    def _Receive(self, size):
+        chunks = []
+        while size > 0:
+            chunk = self._socket.recv(size)
+            if len(chunk) == 0:
+                raise WorkerError('connection to %s:%d closed'%(self.host, self.port))
+            chunks.append(chunk)
+            size -= len(chunk)
+        return b''.join(chunks)
+
+class WorkerPool(object):
+    """Dispatches commands to several textserver workers holding replicas of the same environment
+    """
+    def __init__(self, addresses, numinflight=4, timeout=None):
+        """
+        :param addresses: list of (host, port) of the workers
+        :param numinflight: number of requests every worker has in flight, should be at least the number of request threads of the worker
+        """
+        self._numinflight = max(1, numinflight)
+        self._workers = [WorkerConnection(host, port, timeout) for host, port in addresses]
+        if len(self._workers) == 0:
+            raise WorkerError('no workers')
+
+    def Close(self):
+        for worker in self._workers:
+            worker.Close()
+        self._workers = []
+
+    def GetNumWorkers(self):
+        return len(self._workers)
+
+    def LoadEnvironment(self, env, atts=None):
+        """replaces the environment of every worker with a snapshot of env
+
+        :return: number of bodies loaded by every worker
+        """
+        data = env.WriteToMemory('msgpack', 0, atts or {})
+        return [int(result) for result in self._Broadcast('env_loaddata', data)]
+
+    def Broadcast(self, command, args=''):
+        """runs the command on every worker, for example to load a plugin or create a module
+
+        :return: list of the results of every worker
+        """
+        return self._Broadcast(command, args)
+
+    def Map(self, tasks):
+        """runs every task on one of the workers
+
+        :param tasks: list of (command, args)
+        :return: list of the results in the order of tasks. The result of a task that failed on the worker is None.
+        """
+        queue = collections.deque(enumerate(tasks))
+        results = [None]*len(tasks)
+        mutex = threading.Lock()
+        errors = []
+        def RunWorker(worker):
+            inflight = {}
+            try:
+                while True:
+                    with mutex:
+                        while len(inflight) < self._numinflight and len(queue) > 0:
+                            itask, task = queue.popleft()
+                            inflight[itask] = task
+                            worker.SendRequest(itask, task[0], task[1])
+                    if len(inflight) == 0:
+                        break
+                    itask, success, result = worker.ReceiveResponse()
+                    task = inflight.pop(itask, None)
+                    if task is not None and success:
+                        results[itask] = result
+            except (socket.error, WorkerError) as e:
+                log.warn('worker %r failed, giving its %d tasks to the other workers: %s', worker, len(inflight), e)
+                with mutex:
+                    queue.extendleft(inflight.items())
+                    errors.append(worker)
+
+        while len(queue) > 0:
+            threads = [threading.Thread(target=RunWorker, args=(worker,)) for worker in self._workers]
+            for thread in threads:
+                thread.start()
+            for thread in threads:
+                thread.join()
+            for worker in errors:
+                worker.Close()
+                self._workers.remove(worker)
+            del errors[:]
+            if len(queue) > 0 and len(self._workers) == 0:
+                raise WorkerError('all workers failed with %d tasks left'%len(queue))
+        return results
+
+    def _Broadcast(self, command, args):
+        for worker in self._workers:
+            worker.SendRequest(0, command, args)
+        results = []
+        for worker in self._workers:
+            requestid, success, result = worker.ReceiveResponse()
+            if not success:
+                raise WorkerError('%s failed on %r'%(command, worker))
+            results.append(result)
+        return results
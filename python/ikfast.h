@@ -138,7 +138,7 @@ template <typename T>
 class IkFastFunctions
 {
 public:
-    IkFastFunctions() : _ComputeIk(NULL), _ComputeIk2(NULL), _ComputeFk(NULL), _GetNumFreeParameters(NULL), _GetFreeIndices(NULL), _GetNumJoints(NULL), _GetIkRealSize(NULL), _GetIkFastVersion(NULL), _GetIkType(NULL), _GetKinematicsHash(NULL) {
+    IkFastFunctions() : _ComputeIk(NULL), _ComputeIk2(NULL), _ComputeIkBatch(NULL), _ComputeFk(NULL), _GetNumFreeParameters(NULL), _GetFreeIndices(NULL), _GetNumJoints(NULL), _GetIkRealSize(NULL), _GetIkFastVersion(NULL), _GetIkType(NULL), _GetKinematicsHash(NULL) {
     }
     virtual ~IkFastFunctions() {
     }
@@ -146,6 +146,8 @@ public:
     ComputeIkFn _ComputeIk;
     typedef bool (*ComputeIk2Fn)(const T*, const T*, const T*, IkSolutionListBase<T>&, void*);
     ComputeIk2Fn _ComputeIk2;
+    typedef int (*ComputeIkBatchFn)(int, const T*, const T*, const T*, IkSolutionListBase<T>* const*);
+    ComputeIkBatchFn _ComputeIkBatch; ///< optional, NULL for libraries generated before it was added
     typedef void (*ComputeFkFn)(const T*, T*, T*);
     ComputeFkFn _ComputeFk;
     typedef int (*GetNumFreeParametersFn)();
@@ -569,6 +571,13 @@ IKFAST_API bool ComputeIk(const IkReal* eetrans, const IkReal* eerot, const IkRe
  */
 IKFAST_API bool ComputeIk2(const IkReal* eetrans, const IkReal* eerot, const IkReal* pfree, ikfast::IkSolutionListBase<IkReal>& solutions, void* pOpenRAVEManip);
 
+/** \brief Computes the IK solutions of numposes end effector coordinates with the same solver, see \ref ComputeIk.
+
+   ``eetrans``, ``eerot`` and ``pfree`` hold 3, 9 and GetNumFreeParameters() values for every pose, ``solutions`` holds numposes lists.
+   Returns the number of poses with at least one solution.
+ */
+IKFAST_API int ComputeIkBatch(int numposes, const IkReal* eetrans, const IkReal* eerot, const IkReal* pfree, ikfast::IkSolutionListBase<IkReal>* const* solutions);
+
 /// \brief Computes the end effector coordinates given the joint values. This function is used to double check ik.
 IKFAST_API void ComputeFk(const IkReal* joints, IkReal* eetrans, IkReal* eerot);
 
@@ -548,6 +548,22 @@ IKSolver solver;
 return solver.ComputeIk(eetrans,eerot,pfree,solutions);
 }
 
+/// solves the inverse kinematics equations of numposes poses with one solver.
+/// \param eetrans, eerot, pfree hold 3, 9 and GetNumFreeParameters() values for every pose
+/// \param solutions numposes solution lists
+/// \return the number of poses with at least one solution
+IKFAST_API int ComputeIkBatch(int numposes, const IkReal* eetrans, const IkReal* eerot, const IkReal* pfree, IkSolutionListBase<IkReal>* const* solutions) {
+IKSolver solver;
+const int numfree = GetNumFreeParameters();
+int numsolved = 0;
+for(int ipose = 0; ipose < numposes; ++ipose) {
+    if( solver.ComputeIk(eetrans+3*ipose,eerot+9*ipose,numfree > 0 ? pfree+numfree*ipose : NULL,*solutions[ipose]) ) {
+        ++numsolved;
+    }
+}
+return numsolved;
+}
+
 IKFAST_API const char* GetKinematicsHash() { return "%s"; }
 
 IKFAST_API const char* GetIkFastVersion() { return "%s"; }
@@ -92,8 +92,116 @@ def _registerEnumPicklers():
 
 _registerEnumPicklers()
 
+def _PlanPathHandleAwait(self, pollperiod=0.005):
+    """awaits the status of Planner.PlanPathAsync from an asyncio event loop.
+
+    The handle is polled from the loop, so no thread is used per plan. Cancelling the awaiting task cancels the planner.
+    """
+    import asyncio
+    loop = asyncio.get_event_loop()
+    future = loop.create_future()
+    def poll():
+        if future.cancelled():
+            self.Cancel()
+        elif self.IsDone():
+            try:
+                future.set_result(self.GetStatus())
+            except Exception as e:
+                future.set_exception(e)
+        else:
+            loop.call_later(pollperiod, poll)
+    poll()
+    return future.__await__()
+
+openravepy_int.PlanPathHandle.__await__ = _PlanPathHandleAwait
+
+# environment snapshots at least this big are passed through shared memory instead of the pickled bytes
+_environmentSharedMemoryMinSize = 1<<20
+_environmentSharedSnapshots = {} # RaveGetEnvironmentId of the environment -> (state key, SharedMemory, snapshot size)
+_environmentStaleSharedSnapshots = {} # RaveGetEnvironmentId of the environment -> blocks of older states, pickles of them can still be waiting to be unpickled
+
+def _GetEnvironmentSnapshotKey(env):
+    """the snapshot of an environment can be reused as long as its revision and the update stamps of its bodies do not change"""
+    return (env.GetRevision(), tuple((body.GetName(), body.GetUpdateStamp()) for body in env.GetBodies()))
+
+def _AttachSharedMemory(name):
+    from multiprocessing import shared_memory
+    try:
+        return shared_memory.SharedMemory(name=name, track=False) # python 3.13+
+    except TypeError:
+        shm = shared_memory.SharedMemory(name=name)
+        # otherwise the resource tracker of the worker unlinks the block when the worker exits
+        from multiprocessing import resource_tracker
+        resource_tracker.unregister(shm._name, 'shared_memory')
+        return shm
+
+def _EnvironmentFromSnapshot(name, options, snapshot, sharedname=None, sharedsize=0):
+    """creates the environment unpickled by _EnvironmentReduce"""
+    env = openravepy_int.Environment(name, options)
+    if sharedname is not None:
+        shm = _AttachSharedMemory(sharedname)
+        try:
+            snapshot = bytes(shm.buf[:sharedsize])
+        finally:
+            shm.close()
+    if not env.LoadData(snapshot):
+        env.Destroy()
+        raise ValueError('failed to load environment snapshot of %s'%name)
+    return env
+
+def _EnvironmentReduce(self):
+    """pickles the environment as its msgpack snapshot, so multiprocessing workers do not reload the scene from files.
+
+    The trimeshes are written as binary blobs. Large snapshots are placed in a shared memory block and only the name of the block is pickled, so a worker pool shares one copy of the scene.
+    The blocks stay alive until ReleaseEnvironmentSnapshots is called or the process exits, since the pickles of older states of the environment can still be waiting to be unpickled.
+    Only the bodies and their states are transferred, the environments of the workers are created without the simulation thread.
+    """
+    envid = openravepy_int.RaveGetEnvironmentId(self)
+    key = _GetEnvironmentSnapshotKey(self)
+    cached = _environmentSharedSnapshots.pop(envid, None)
+    if cached is not None:
+        if cached[0] == key:
+            _environmentSharedSnapshots[envid] = cached
+            return (_EnvironmentFromSnapshot, (self.GetName(), 0, b'', cached[1].name, cached[2]))
+        _environmentStaleSharedSnapshots.setdefault(envid, []).append(cached[1])
+
+    snapshot = self.WriteToMemory('msgpack', 0, {'meshBlobs':'1'})
+    if snapshot is None:
+        snapshot = b''
+    if len(snapshot) >= _environmentSharedMemoryMinSize:
+        try:
+            from multiprocessing import shared_memory
+        except ImportError:
+            shared_memory = None # python < 3.8, pickle the bytes
+        if shared_memory is not None:
+            shm = shared_memory.SharedMemory(create=True, size=len(snapshot))
+            shm.buf[:len(snapshot)] = snapshot
+            _environmentSharedSnapshots[envid] = (key, shm, len(snapshot))
+            return (_EnvironmentFromSnapshot, (self.GetName(), 0, b'', shm.name, len(snapshot)))
+    return (_EnvironmentFromSnapshot, (self.GetName(), 0, snapshot))
+
+def ReleaseEnvironmentSnapshots(env=None, stale=False):
+    """unlinks the shared memory blocks of the pickled snapshots of env, or of all the environments if env is None.
+
+    Call it once the pickles of the environment have been unpickled, the environments that were not unpickled yet fail to load afterwards.
+    :param stale: if True, only unlinks the blocks of the older states, so the current state can still be pickled without copying it again.
+    """
+    envids = [openravepy_int.RaveGetEnvironmentId(env)] if env is not None else list(set(_environmentSharedSnapshots.keys()) | set(_environmentStaleSharedSnapshots.keys()))
+    for envid in envids:
+        vshms = _environmentStaleSharedSnapshots.pop(envid, [])
+        if not stale:
+            cached = _environmentSharedSnapshots.pop(envid, None)
+            if cached is not None:
+                vshms.append(cached[1])
+        for shm in vshms:
+            shm.close()
+            shm.unlink()
+
+openravepy_int.Environment.__reduce__ = _EnvironmentReduce
+
 import atexit
 atexit.register(openravepy_int.RaveDestroy)
+atexit.register(ReleaseEnvironmentSnapshots)
 
 def normalizeZRotation(qarray):
     """for each quaternion, find the rotation about z that minimizes the distance between the identify (1,0,0,0).
@@ -0,0 +1,356 @@
+/** \file openrave_benchmarks.cpp
+    \author Rosen Diankov
+
+    Microbenchmarks of the core operations, built with Google Benchmark when OPT_BENCHMARKS is ON.
+
+    The robots and scenes are loaded from the openrave data directories, so OPENRAVE_DATA has to point to src/ when running from the
+    build tree (the run_openrave_benchmarks target sets it). Use the Google Benchmark options to select and report, for example
+
+    \verbatim
+    openrave_benchmarks --benchmark_filter=CheckCollision --benchmark_out=results.json --benchmark_out_format=json
+    \endverbatim
+
+    The ik benchmark loads the ikfast library of the manipulator through the ikfast module and is skipped if it cannot be loaded or generated.
+ */
+#include <openrave-core.h>
+#include <benchmark/benchmark.h>
+
+#include <map>
+#include <vector>
+#include <string>
+#include <sstream>
+
+using namespace OpenRAVE;
+using namespace std;
+
+namespace {
+
+static const int s_nNumConfigurations = 64; ///< the benchmarks cycle through this many configurations so that no cache sees the same input twice in a row
+
+static std::map<std::string, EnvironmentBasePtr> s_mapscenes; ///< environments of GetScene indexed by file and collision checker
+
+/// \brief environments are loaded once per scene file and shared by all the benchmarks using them
+EnvironmentBasePtr GetScene(const std::string& filename, const std::string& checkername=std::string())
+{
+    const std::string key = filename + "#" + checkername;
+    std::map<std::string, EnvironmentBasePtr>::iterator it = s_mapscenes.find(key);
+    if( it != s_mapscenes.end() ) {
+        return it->second;
+    }
+    EnvironmentBasePtr penv = RaveCreateEnvironment();
+    if( checkername.size() > 0 ) {
+        CollisionCheckerBasePtr pchecker = RaveCreateCollisionChecker(penv, checkername);
+        if( !pchecker ) {
+            penv->Destroy();
+            return EnvironmentBasePtr();
+        }
+        penv->SetCollisionChecker(pchecker);
+    }
+    if( !penv->Load(filename) ) {
+        penv->Destroy();
+        return EnvironmentBasePtr();
+    }
+    s_mapscenes[key] = penv;
+    return penv;
+}
+
+void DestroyScenes()
+{
+    // destroying the environments releases the plugins before RaveDestroy
+    for(std::map<std::string, EnvironmentBasePtr>::iterator it = s_mapscenes.begin(); it != s_mapscenes.end(); ++it) {
+        it->second->Destroy();
+    }
+    s_mapscenes.clear();
+}
+
+RobotBasePtr GetFirstRobot(EnvironmentBasePtr penv)
+{
+    std::vector<RobotBasePtr> vrobots;
+    penv->GetRobots(vrobots);
+    return vrobots.size() > 0 ? vrobots.at(0) : RobotBasePtr();
+}
+
+/// \brief deterministic configurations inside the limits of the dofs
+void SampleConfigurations(RobotBasePtr probot, const std::vector<int>& vdofindices, std::vector< std::vector<dReal> >& vconfigs)
+{
+    std::vector<dReal> vlower, vupper;
+    probot->GetDOFLimits(vlower, vupper, vdofindices);
+    vconfigs.resize(s_nNumConfigurations);
+    for(int iconfig = 0; iconfig < s_nNumConfigurations; ++iconfig) {
+        vconfigs[iconfig].resize(vlower.size());
+        for(size_t idof = 0; idof < vlower.size(); ++idof) {
+            // spread over the range, same on every run and platform
+            dReal fraction = dReal(((iconfig+1)*(idof*7+3)) % 97)/dReal(97);
+            dReal lower = max(vlower[idof], dReal(-PI)), upper = min(vupper[idof], dReal(PI));
+            vconfigs[iconfig][idof] = lower + fraction*(upper-lower);
+        }
+    }
+}
+
+std::vector<int> GetAllDOFIndices(RobotBasePtr probot)
+{
+    std::vector<int> vdofindices(probot->GetDOF());
+    for(int i = 0; i < probot->GetDOF(); ++i) {
+        vdofindices[i] = i;
+    }
+    return vdofindices;
+}
+
+void BM_SetDOFValues(benchmark::State& state, const std::string& filename)
+{
+    EnvironmentBasePtr penv = GetScene(filename);
+    RobotBasePtr probot = !!penv ? GetFirstRobot(penv) : RobotBasePtr();
+    if( !probot ) {
+        state.SkipWithError("could not load the robot");
+        return;
+    }
+    EnvironmentLock lock(penv->GetMutex());
+    RobotBase::RobotStateSaver saver(probot);
+    std::vector< std::vector<dReal> > vconfigs;
+    SampleConfigurations(probot, GetAllDOFIndices(probot), vconfigs);
+    int iconfig = 0;
+    for(auto _ : state) {
+        probot->SetDOFValues(vconfigs[iconfig], KinBody::CLA_Nothing);
+        iconfig = (iconfig+1) % s_nNumConfigurations;
+    }
+    state.counters["dof"] = probot->GetDOF();
+    state.counters["links"] = probot->GetLinks().size();
+}
+
+void BM_ComputeJacobianTranslation(benchmark::State& state, const std::string& filename)
+{
+    EnvironmentBasePtr penv = GetScene(filename);
+    RobotBasePtr probot = !!penv ? GetFirstRobot(penv) : RobotBasePtr();
+    if( !probot || !probot->GetActiveManipulator() ) {
+        state.SkipWithError("could not load the robot or it has no manipulator");
+        return;
+    }
+    EnvironmentLock lock(penv->GetMutex());
+    RobotBase::RobotStateSaver saver(probot);
+    RobotBase::ManipulatorPtr pmanip = probot->GetActiveManipulator();
+    std::vector< std::vector<dReal> > vconfigs;
+    SampleConfigurations(probot, pmanip->GetArmIndices(), vconfigs);
+    const int linkindex = pmanip->GetEndEffector()->GetIndex();
+    std::vector<dReal> vjacobian;
+    int iconfig = 0;
+    for(auto _ : state) {
+        state.PauseTiming();
+        probot->SetDOFValues(vconfigs[iconfig], KinBody::CLA_Nothing, pmanip->GetArmIndices());
+        const Vector position = pmanip->GetTransform().trans;
+        state.ResumeTiming();
+        probot->ComputeJacobianTranslation(linkindex, position, vjacobian, pmanip->GetArmIndices());
+        benchmark::DoNotOptimize(vjacobian.data());
+        iconfig = (iconfig+1) % s_nNumConfigurations;
+    }
+}
+
+void BM_CheckCollision(benchmark::State& state, const std::string& filename)
+{
+    EnvironmentBasePtr penv = GetScene(filename, "fcl_");
+    RobotBasePtr probot = !!penv ? GetFirstRobot(penv) : RobotBasePtr();
+    if( !probot ) {
+        state.SkipWithError("could not load the scene with the fcl_ collision checker");
+        return;
+    }
+    EnvironmentLock lock(penv->GetMutex());
+    RobotBase::RobotStateSaver saver(probot);
+    std::vector< std::vector<dReal> > vconfigs;
+    SampleConfigurations(probot, GetAllDOFIndices(probot), vconfigs);
+    int iconfig = 0, numcollisions = 0;
+    for(auto _ : state) {
+        state.PauseTiming();
+        probot->SetDOFValues(vconfigs[iconfig], KinBody::CLA_Nothing);
+        state.ResumeTiming();
+        numcollisions += penv->CheckCollision(KinBodyConstPtr(probot));
+        iconfig = (iconfig+1) % s_nNumConfigurations;
+    }
+    state.counters["bodies"] = penv->GetNumBodies();
+    state.counters["collisionratio"] = benchmark::Counter(numcollisions, benchmark::Counter::kAvgIterations);
+}
+
+void BM_CheckSelfCollision(benchmark::State& state, const std::string& filename)
+{
+    EnvironmentBasePtr penv = GetScene(filename, "fcl_");
+    RobotBasePtr probot = !!penv ? GetFirstRobot(penv) : RobotBasePtr();
+    if( !probot ) {
+        state.SkipWithError("could not load the robot with the fcl_ collision checker");
+        return;
+    }
+    EnvironmentLock lock(penv->GetMutex());
+    RobotBase::RobotStateSaver saver(probot);
+    std::vector< std::vector<dReal> > vconfigs;
+    SampleConfigurations(probot, GetAllDOFIndices(probot), vconfigs);
+    int iconfig = 0, numcollisions = 0;
+    for(auto _ : state) {
+        state.PauseTiming();
+        probot->SetDOFValues(vconfigs[iconfig], KinBody::CLA_Nothing);
+        state.ResumeTiming();
+        numcollisions += probot->CheckSelfCollision();
+        iconfig = (iconfig+1) % s_nNumConfigurations;
+    }
+    state.counters["collisionratio"] = benchmark::Counter(numcollisions, benchmark::Counter::kAvgIterations);
+}
+
+void BM_IkSolveAll(benchmark::State& state, const std::string& filename)
+{
+    EnvironmentBasePtr penv = GetScene(filename);
+    RobotBasePtr probot = !!penv ? GetFirstRobot(penv) : RobotBasePtr();
+    if( !probot || !probot->GetActiveManipulator() ) {
+        state.SkipWithError("could not load the robot or it has no manipulator");
+        return;
+    }
+    EnvironmentLock lock(penv->GetMutex());
+    RobotBase::RobotStateSaver saver(probot);
+    RobotBase::ManipulatorPtr pmanip = probot->GetActiveManipulator();
+    if( !pmanip->GetIkSolver() || !pmanip->GetIkSolver()->Supports(IKP_Transform6D) ) {
+        ModuleBasePtr pikfast = RaveCreateModule(penv, "ikfast");
+        if( !pikfast ) {
+            state.SkipWithError("ikfast module is not available");
+            return;
+        }
+        penv->Add(pikfast, IAM_AllowRenaming);
+        std::stringstream sout, sinput;
+        sinput << "LoadIKFastSolver " << probot->GetName() << " Transform6D";
+        if( !pikfast->SendCommand(sout, sinput) ) {
+            state.SkipWithError("could not load the ikfast solver of the manipulator");
+            return;
+        }
+    }
+    IkSolverBasePtr psolver = pmanip->GetIkSolver();
+
+    // targets are poses reached by the arm so that every call has solutions
+    std::vector< std::vector<dReal> > vconfigs;
+    SampleConfigurations(probot, pmanip->GetArmIndices(), vconfigs);
+    std::vector<IkParameterization> vikparams(s_nNumConfigurations);
+    for(int iconfig = 0; iconfig < s_nNumConfigurations; ++iconfig) {
+        probot->SetDOFValues(vconfigs[iconfig], KinBody::CLA_Nothing, pmanip->GetArmIndices());
+        vikparams[iconfig] = pmanip->GetIkParameterization(IKP_Transform6D);
+    }
+    std::vector< std::vector<dReal> > vsolutions;
+    int iconfig = 0;
+    size_t numsolutions = 0;
+    for(auto _ : state) {
+        psolver->SolveAll(vikparams[iconfig], IKFO_IgnoreSelfCollisions|IKFO_IgnoreEndEffectorEnvCollisions|IKFO_IgnoreCustomFilters, vsolutions);
+        numsolutions += vsolutions.size();
+        iconfig = (iconfig+1) % s_nNumConfigurations;
+    }
+    state.counters["solutions"] = benchmark::Counter(numsolutions, benchmark::Counter::kAvgIterations);
+}
+
+void BM_TrajectorySample(benchmark::State& state, const std::string& filename, const std::string& interpolation)
+{
+    EnvironmentBasePtr penv = GetScene(filename);
+    RobotBasePtr probot = !!penv ? GetFirstRobot(penv) : RobotBasePtr();
+    if( !probot ) {
+        state.SkipWithError("could not load the robot");
+        return;
+    }
+    EnvironmentLock lock(penv->GetMutex());
+    RobotBase::RobotStateSaver saver(probot);
+    probot->SetActiveDOFs(GetAllDOFIndices(probot));
+    std::vector< std::vector<dReal> > vconfigs;
+    SampleConfigurations(probot, GetAllDOFIndices(probot), vconfigs);
+
+    TrajectoryBasePtr ptraj = RaveCreateTrajectory(penv, "");
+    ConfigurationSpecification spec = probot->GetActiveConfigurationSpecification(interpolation);
+    ConfigurationSpecification velspec = spec.ConvertToVelocitySpecification();
+    spec += velspec;
+    spec.AddDeltaTimeGroup();
+    ptraj->Init(spec);
+    std::vector<dReal> vwaypoint(spec.GetDOF(), 0);
+    for(int iconfig = 0; iconfig < s_nNumConfigurations; ++iconfig) {
+        std::fill(vwaypoint.begin(), vwaypoint.end(), dReal(0));
+        spec.InsertJointValues(vwaypoint.begin(), vconfigs[iconfig].begin(), probot, probot->GetActiveDOFIndices(), 0);
+        spec.InsertDeltaTime(vwaypoint.begin(), iconfig > 0 ? dReal(0.1) : dReal(0));
+        ptraj->Insert(ptraj->GetNumWaypoints(), vwaypoint);
+    }
+
+    // sample at times that do not fall on the waypoints
+    const dReal fduration = ptraj->GetDuration();
+    const dReal fstep = dReal(0.0137);
+    std::vector<dReal> vdata;
+    dReal ftime = 0;
+    for(auto _ : state) {
+        ptraj->Sample(vdata, ftime);
+        benchmark::DoNotOptimize(vdata.data());
+        ftime += fstep;
+        if( ftime > fduration ) {
+            ftime -= fduration;
+        }
+    }
+}
+
+void BM_LoadSerialized(benchmark::State& state, const std::string& filename, const std::string& filetype)
+{
+    EnvironmentBasePtr penv = GetScene(filename);
+    if( !penv ) {
+        state.SkipWithError("could not load the scene");
+        return;
+    }
+    std::vector<char> vdata;
+    {
+        EnvironmentLock lock(penv->GetMutex());
+        penv->WriteToMemory(filetype, vdata);
+    }
+    const std::string data(vdata.begin(), vdata.end());
+    EnvironmentBasePtr ploadenv = RaveCreateEnvironment();
+    for(auto _ : state) {
+        state.PauseTiming();
+        ploadenv->Reset();
+        state.ResumeTiming();
+        if( !ploadenv->LoadData(data) ) {
+            state.SkipWithError("failed to load the serialized scene");
+            break;
+        }
+    }
+    state.SetBytesProcessed(int64_t(state.iterations())*int64_t(data.size()));
+    ploadenv->Destroy();
+}
+
+void BM_CloneSelf(benchmark::State& state, const std::string& filename)
+{
+    EnvironmentBasePtr penv = GetScene(filename);
+    if( !penv ) {
+        state.SkipWithError("could not load the scene");
+        return;
+    }
+    for(auto _ : state) {
+        EnvironmentBasePtr pclone = penv->CloneSelf(Clone_Bodies);
+        state.PauseTiming();
+        pclone->Destroy();
+        pclone.reset();
+        state.ResumeTiming();
+    }
+    state.counters["bodies"] = penv->GetNumBodies();
+}
+
+} // end namespace
+
+BENCHMARK_CAPTURE(BM_SetDOFValues, barrettwam, std::string("robots/barrettwam.robot.xml"));
+BENCHMARK_CAPTURE(BM_SetDOFValues, pr2, std::string("robots/pr2-beta-static.zae"));
+BENCHMARK_CAPTURE(BM_ComputeJacobianTranslation, barrettwam, std::string("robots/barrettwam.robot.xml"));
+BENCHMARK_CAPTURE(BM_ComputeJacobianTranslation, pr2, std::string("robots/pr2-beta-static.zae"));
+BENCHMARK_CAPTURE(BM_CheckCollision, lab1, std::string("data/lab1.env.xml"));
+BENCHMARK_CAPTURE(BM_CheckCollision, pr2test2, std::string("data/pr2test2.env.xml"));
+BENCHMARK_CAPTURE(BM_CheckSelfCollision, barrettwam, std::string("robots/barrettwam.robot.xml"));
+BENCHMARK_CAPTURE(BM_CheckSelfCollision, pr2, std::string("robots/pr2-beta-static.zae"));
+BENCHMARK_CAPTURE(BM_IkSolveAll, barrettwam, std::string("robots/barrettwam.robot.xml"));
+BENCHMARK_CAPTURE(BM_TrajectorySample, barrettwam_linear, std::string("robots/barrettwam.robot.xml"), std::string("linear"));
+BENCHMARK_CAPTURE(BM_TrajectorySample, barrettwam_cubic, std::string("robots/barrettwam.robot.xml"), std::string("cubic"));
+BENCHMARK_CAPTURE(BM_LoadSerialized, lab1_json, std::string("data/lab1.env.xml"), std::string("json"));
+BENCHMARK_CAPTURE(BM_LoadSerialized, lab1_msgpack, std::string("data/lab1.env.xml"), std::string("msgpack"));
+BENCHMARK_CAPTURE(BM_CloneSelf, lab1, std::string("data/lab1.env.xml"));
+BENCHMARK_CAPTURE(BM_CloneSelf, pr2test2, std::string("data/pr2test2.env.xml"));
+
+int main(int argc, char** argv)
+{
+    benchmark::Initialize(&argc, argv);
+    if( benchmark::ReportUnrecognizedArguments(argc, argv) ) {
+        return 1;
+    }
+    RaveInitialize(true, Level_Warn);
+    benchmark::RunSpecifiedBenchmarks();
+    DestroyScenes();
+    RaveDestroy();
+    return 0;
+}
@@ -0,0 +1,451 @@
+/** \file openrave_planningbenchmarks.cpp
+    \author Rosen Diankov
+
+    End-to-end planning benchmark, built with the other benchmarks when OPT_BENCHMARKS is ON.
+
+    Every scene runs the planning pipeline (path planner, path smoother, retimer) a fixed number of times with fixed seeds, so two builds
+    given the same options plan for the same start and goal configurations. For each scene the success rate, the p50/p95/p99 of the total
+    and per-stage planning times, the path length and the trajectory duration are printed and optionally written as json.
+
+    \verbatim
+    openrave_planningbenchmarks --runs 50 --seed 0 --scene shelf --checker fcl_ --out planning.json
+    \endverbatim
+
+    The scenes are loaded from the openrave data directories, so OPENRAVE_DATA has to point to src/ when running from the build tree
+    (the run_openrave_planningbenchmarks target sets it).
+ */
+#include <openrave-core.h>
+#include <openrave/planningutils.h>
+#include <openrave/utils.h>
+#include <boost/format.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace OpenRAVE;
+using namespace std;
+
+namespace {
+
+/// \brief a canonical scene of the benchmark
+struct PlanningScene
+{
+    const char* name;
+    const char* filename;
+    bool bAllManipulators; ///< if true, plan for the arms of all the manipulators together, otherwise for the longest arm
+};
+
+static const PlanningScene s_vscenes[] = {
+    {"binpicking", "data/pa10grasp2.env.xml", false},
+    {"shelf", "data/wam_cabinet.env.xml", false},
+    {"dualarmhandover", "data/dualarmmanipulation.env.xml", true},
+};
+
+struct PlanningOptions
+{
+    PlanningOptions() : nruns(20), seed(0), nmaxiterations(4000), plannername("BiRRT"), smoothername("shortcut_linear"), retimername("ParabolicTrajectoryRetimer") {
+    }
+    int nruns;
+    uint32_t seed;
+    int nmaxiterations;
+    std::string plannername, smoothername, retimername, checkername, outputfilename;
+    std::vector<std::string> vscenenames; ///< if empty, run all the scenes
+};
+
+/// \brief the stages of one run, times are in seconds
+enum PlanningStage {
+    PST_Goal=0, ///< sampling a collision free goal
+    PST_Plan=1,
+    PST_Smooth=2,
+    PST_Retime=3,
+    PST_Total=4,
+    PST_Count=5,
+};
+
+static const char* s_stagenames[PST_Count] = {"goal", "plan", "smooth", "retime", "total"};
+
+struct PlanningRunResult
+{
+    PlanningRunResult() : bSuccess(false), rawpathlength(0), pathlength(0), duration(0) {
+        std::fill(vstagetimes, vstagetimes+PST_Count, dReal(0));
+    }
+    bool bSuccess;
+    std::string failedstage; ///< name of the stage that failed
+    dReal vstagetimes[PST_Count];
+    dReal rawpathlength; ///< configuration space length of the planner output
+    dReal pathlength; ///< configuration space length after smoothing
+    dReal duration; ///< duration of the retimed trajectory
+};
+
+struct PlanningSceneResult
+{
+    std::string name;
+    std::vector<PlanningRunResult> vruns;
+};
+
+inline dReal GetElapsedSeconds(uint64_t starttime)
+{
+    return dReal(utils::GetMicroTime()-starttime)*1e-6;
+}
+
+/// \brief nearest rank percentile of the values, sorts them
+dReal GetPercentile(std::vector<dReal>& vvalues, dReal percentile)
+{
+    if( vvalues.size() == 0 ) {
+        return 0;
+    }
+    std::sort(vvalues.begin(), vvalues.end());
+    size_t index = (size_t)RaveCeil(percentile*vvalues.size());
+    return vvalues.at(index > 0 ? index-1 : 0);
+}
+
+dReal GetMean(const std::vector<dReal>& vvalues)
+{
+    if( vvalues.size() == 0 ) {
+        return 0;
+    }
+    dReal sum = 0;
+    FOREACHC(itvalue, vvalues) {
+        sum += *itvalue;
+    }
+    return sum/vvalues.size();
+}
+
+/// \brief sum of the euclidean distances between consecutive waypoints in the active configuration space
+dReal ComputePathLength(TrajectoryBasePtr ptraj, RobotBasePtr probot)
+{
+    const ConfigurationSpecification& spec = probot->GetActiveConfigurationSpecification();
+    std::vector<dReal> vdata;
+    ptraj->GetWaypoints(0, ptraj->GetNumWaypoints(), vdata, spec);
+    int dof = spec.GetDOF();
+    dReal length = 0;
+    for(size_t ivalue = dof; ivalue+dof <= vdata.size(); ivalue += dof) {
+        dReal distsqr = 0;
+        for(int idof = 0; idof < dof; ++idof) {
+            dReal diff = vdata[ivalue+idof] - vdata[ivalue-dof+idof];
+            distsqr += diff*diff;
+        }
+        length += RaveSqrt(distsqr);
+    }
+    return length;
+}
+
+/// \brief sets the active dofs that the scene plans for
+void SetPlanningDOFs(RobotBasePtr probot, const PlanningScene& scene)
+{
+    const std::vector<RobotBase::ManipulatorPtr>& vmanips = probot->GetManipulators();
+    if( vmanips.size() == 0 ) {
+        throw OPENRAVE_EXCEPTION_FORMAT("robot %s in scene %s has no manipulators", probot->GetName()%scene.name, ORE_InvalidArguments);
+    }
+    std::vector<int> vdofindices;
+    if( scene.bAllManipulators ) {
+        FOREACHC(itmanip, vmanips) {
+            FOREACHC(itindex, (*itmanip)->GetArmIndices()) {
+                if( find(vdofindices.begin(), vdofindices.end(), *itindex) == vdofindices.end() ) {
+                    vdofindices.push_back(*itindex);
+                }
+            }
+        }
+        sort(vdofindices.begin(), vdofindices.end());
+    }
+    else {
+        RobotBase::ManipulatorPtr pmanip = vmanips.at(0);
+        FOREACHC(itmanip, vmanips) {
+            if( pmanip->GetArmIndices().size() < (*itmanip)->GetArmIndices().size() ) {
+                pmanip = *itmanip;
+            }
+        }
+        vdofindices = pmanip->GetArmIndices();
+    }
+    probot->SetActiveDOFs(vdofindices);
+}
+
+/// \brief samples a collision free configuration of the active dofs with the sampler, returns false if none is found
+bool SampleGoal(RobotBasePtr probot, SpaceSamplerBasePtr psampler, std::vector<dReal>& vgoal)
+{
+    EnvironmentBasePtr penv = probot->GetEnv();
+    RobotBase::RobotStateSaver saver(probot);
+    std::vector<dReal> vlower, vupper, vsample;
+    probot->GetActiveDOFLimits(vlower, vupper);
+    vgoal.resize(vlower.size());
+    for(int itry = 0; itry < 1000; ++itry) {
+        psampler->SampleSequence(vsample, vlower.size(), IT_Closed);
+        for(size_t idof = 0; idof < vlower.size(); ++idof) {
+            vgoal[idof] = vlower[idof] + vsample.at(idof)*(vupper[idof]-vlower[idof]);
+        }
+        probot->SetActiveDOFValues(vgoal);
+        if( !penv->CheckCollision(probot) && !probot->CheckSelfCollision() ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RunScene(const PlanningScene& scene, const PlanningOptions& options, PlanningSceneResult& sceneresult)
+{
+    sceneresult.name = scene.name;
+    EnvironmentBasePtr penv = RaveCreateEnvironment();
+    try {
+        if( options.checkername.size() > 0 ) {
+            CollisionCheckerBasePtr pchecker = RaveCreateCollisionChecker(penv, options.checkername);
+            if( !pchecker ) {
+                throw OPENRAVE_EXCEPTION_FORMAT("failed to create collision checker %s", options.checkername, ORE_InvalidArguments);
+            }
+            penv->SetCollisionChecker(pchecker);
+        }
+        if( !penv->Load(scene.filename) ) {
+            throw OPENRAVE_EXCEPTION_FORMAT("failed to load scene %s", scene.filename, ORE_InvalidArguments);
+        }
+        std::vector<RobotBasePtr> vrobots;
+        penv->GetRobots(vrobots);
+        if( vrobots.size() == 0 ) {
+            throw OPENRAVE_EXCEPTION_FORMAT("scene %s has no robots", scene.filename, ORE_InvalidArguments);
+        }
+        RobotBasePtr probot = vrobots.at(0);
+
+        EnvironmentLock lock(penv->GetMutex());
+        SetPlanningDOFs(probot, scene);
+        PlannerBasePtr pplanner = RaveCreatePlanner(penv, options.plannername);
+        SpaceSamplerBasePtr psampler = RaveCreateSpaceSampler(penv, "mt19937");
+        if( !pplanner || !psampler ) {
+            throw OPENRAVE_EXCEPTION_FORMAT("failed to create planner %s", options.plannername, ORE_InvalidArguments);
+        }
+        psampler->SetSpaceDOF(1);
+        TrajectoryBasePtr ptraj = RaveCreateTrajectory(penv, "");
+
+        sceneresult.vruns.resize(options.nruns);
+        for(int irun = 0; irun < options.nruns; ++irun) {
+            PlanningRunResult& result = sceneresult.vruns[irun];
+            RobotBase::RobotStateSaver saver(probot);
+            // every run has its own seed so that a failed run does not change the inputs of the following ones
+            uint32_t runseed = options.seed + 7919*irun;
+            psampler->SetSeed(runseed);
+            std::string seedparameters = str(boost::format("<_nrandomgeneratorseed>%d</_nrandomgeneratorseed>")%runseed);
+
+            uint64_t starttime = utils::GetMicroTime(), stagetime = starttime;
+            PlannerBase::PlannerParametersPtr params(new PlannerBase::PlannerParameters());
+            params->SetRobotActiveJoints(probot);
+            probot->GetActiveDOFValues(params->vinitialconfig);
+            if( !SampleGoal(probot, psampler, params->vgoalconfig) ) {
+                result.failedstage = s_stagenames[PST_Goal];
+                continue;
+            }
+            params->_nMaxIterations = options.nmaxiterations;
+            params->_nRandomGeneratorSeed = runseed;
+            result.vstagetimes[PST_Goal] = GetElapsedSeconds(stagetime);
+
+            stagetime = utils::GetMicroTime();
+            ptraj->Init(probot->GetActiveConfigurationSpecification());
+            if( !pplanner->InitPlan(probot, params) || !(pplanner->PlanPath(ptraj).GetStatusCode() & PS_HasSolution) ) {
+                result.vstagetimes[PST_Plan] = GetElapsedSeconds(stagetime);
+                result.failedstage = s_stagenames[PST_Plan];
+                continue;
+            }
+            result.vstagetimes[PST_Plan] = GetElapsedSeconds(stagetime);
+            result.rawpathlength = ComputePathLength(ptraj, probot);
+
+            stagetime = utils::GetMicroTime();
+            if( options.smoothername.size() > 0 ) {
+                if( !(planningutils::SmoothActiveDOFTrajectory(ptraj, probot, 1, 1, options.smoothername, seedparameters).GetStatusCode() & PS_HasSolution) ) {
+                    result.vstagetimes[PST_Smooth] = GetElapsedSeconds(stagetime);
+                    result.failedstage = s_stagenames[PST_Smooth];
+                    continue;
+                }
+            }
+            result.vstagetimes[PST_Smooth] = GetElapsedSeconds(stagetime);
+            result.pathlength = ComputePathLength(ptraj, probot);
+
+            stagetime = utils::GetMicroTime();
+            if( !(planningutils::RetimeActiveDOFTrajectory(ptraj, probot, false, 1, 1, options.retimername).GetStatusCode() & PS_HasSolution) ) {
+                result.vstagetimes[PST_Retime] = GetElapsedSeconds(stagetime);
+                result.failedstage = s_stagenames[PST_Retime];
+                continue;
+            }
+            result.vstagetimes[PST_Retime] = GetElapsedSeconds(stagetime);
+            result.vstagetimes[PST_Total] = GetElapsedSeconds(starttime);
+            result.duration = ptraj->GetDuration();
+            result.bSuccess = true;
+        }
+    }
+    catch(...) {
+        penv->Destroy();
+        throw;
+    }
+    penv->Destroy();
+}
+
+/// \brief statistics of the successful runs of a scene
+struct PlanningSceneSummary
+{
+    int nsuccess;
+    dReal vpercentiles[PST_Count][3]; ///< p50, p95, p99 of every stage
+    dReal meanrawpathlength, meanpathlength, meanduration;
+};
+
+void Summarize(const PlanningSceneResult& sceneresult, PlanningSceneSummary& summary)
+{
+    std::vector<dReal> vstagetimes[PST_Count], vrawpathlengths, vpathlengths, vdurations;
+    summary.nsuccess = 0;
+    FOREACHC(itrun, sceneresult.vruns) {
+        if( !itrun->bSuccess ) {
+            continue;
+        }
+        ++summary.nsuccess;
+        for(int istage = 0; istage < PST_Count; ++istage) {
+            vstagetimes[istage].push_back(itrun->vstagetimes[istage]);
+        }
+        vrawpathlengths.push_back(itrun->rawpathlength);
+        vpathlengths.push_back(itrun->pathlength);
+        vdurations.push_back(itrun->duration);
+    }
+    for(int istage = 0; istage < PST_Count; ++istage) {
+        summary.vpercentiles[istage][0] = GetPercentile(vstagetimes[istage], 0.5);
+        summary.vpercentiles[istage][1] = GetPercentile(vstagetimes[istage], 0.95);
+        summary.vpercentiles[istage][2] = GetPercentile(vstagetimes[istage], 0.99);
+    }
+    summary.meanrawpathlength = GetMean(vrawpathlengths);
+    summary.meanpathlength = GetMean(vpathlengths);
+    summary.meanduration = GetMean(vdurations);
+}
+
+void PrintSummary(std::ostream& o, const PlanningSceneResult& sceneresult, const PlanningSceneSummary& summary)
+{
+    o << sceneresult.name << ": success " << summary.nsuccess << "/" << sceneresult.vruns.size()
+      << ", path length " << summary.meanrawpathlength << " -> " << summary.meanpathlength << ", duration " << summary.meanduration << "s" << endl;
+    for(int istage = 0; istage < PST_Count; ++istage) {
+        o << "  " << s_stagenames[istage] << ": p50=" << summary.vpercentiles[istage][0] << "s p95=" << summary.vpercentiles[istage][1]
+          << "s p99=" << summary.vpercentiles[istage][2] << "s" << endl;
+    }
+    std::map<std::string, int> mapfailures;
+    FOREACHC(itrun, sceneresult.vruns) {
+        if( !itrun->bSuccess ) {
+            mapfailures[itrun->failedstage] += 1;
+        }
+    }
+    FOREACHC(itfailure, mapfailures) {
+        o << "  failed in " << itfailure->first << ": " << itfailure->second << endl;
+    }
+}
+
+void WriteJSON(std::ostream& o, const PlanningOptions& options, const std::vector<PlanningSceneResult>& vsceneresults)
+{
+    o << "{\"planner\": \"" << options.plannername << "\", \"smoother\": \"" << options.smoothername << "\", \"retimer\": \"" << options.retimername
+      << "\", \"checker\": \"" << options.checkername << "\", \"runs\": " << options.nruns << ", \"seed\": " << options.seed << ", \"scenes\": [";
+    for(size_t iscene = 0; iscene < vsceneresults.size(); ++iscene) {
+        const PlanningSceneResult& sceneresult = vsceneresults[iscene];
+        PlanningSceneSummary summary;
+        Summarize(sceneresult, summary);
+        o << (iscene > 0 ? ", " : "") << "{\"name\": \"" << sceneresult.name << "\", \"success\": " << summary.nsuccess
+          << ", \"successrate\": " << (sceneresult.vruns.size() > 0 ? dReal(summary.nsuccess)/sceneresult.vruns.size() : dReal(0))
+          << ", \"rawpathlength\": " << summary.meanrawpathlength << ", \"pathlength\": " << summary.meanpathlength << ", \"duration\": " << summary.meanduration
+          << ", \"stages\": {";
+        for(int istage = 0; istage < PST_Count; ++istage) {
+            o << (istage > 0 ? ", " : "") << "\"" << s_stagenames[istage] << "\": {\"p50\": " << summary.vpercentiles[istage][0]
+              << ", \"p95\": " << summary.vpercentiles[istage][1] << ", \"p99\": " << summary.vpercentiles[istage][2] << "}";
+        }
+        o << "}, \"runs\": [";
+        for(size_t irun = 0; irun < sceneresult.vruns.size(); ++irun) {
+            const PlanningRunResult& result = sceneresult.vruns[irun];
+            o << (irun > 0 ? ", " : "") << "{\"success\": " << (result.bSuccess ? "true" : "false") << ", \"failedstage\": \"" << result.failedstage << "\"";
+            for(int istage = 0; istage < PST_Count; ++istage) {
+                o << ", \"" << s_stagenames[istage] << "\": " << result.vstagetimes[istage];
+            }
+            o << ", \"rawpathlength\": " << result.rawpathlength << ", \"pathlength\": " << result.pathlength << ", \"duration\": " << result.duration << "}";
+        }
+        o << "]}";
+    }
+    o << "]}" << endl;
+}
+
+void PrintHelp()
+{
+    cout << "openrave_planningbenchmarks [--runs N] [--seed S] [--scene name]* [--planner name] [--smoother name] [--retimer name]" << endl
+         << "                            [--maxiterations N] [--checker name] [--out file.json]" << endl
+         << "  scenes:";
+    for(size_t iscene = 0; iscene < sizeof(s_vscenes)/sizeof(s_vscenes[0]); ++iscene) {
+        cout << " " << s_vscenes[iscene].name;
+    }
+    cout << endl << "  an empty smoother name skips the smoothing stage" << endl;
+}
+
+} // end namespace
+
+int main(int argc, char ** argv)
+{
+    PlanningOptions options;
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if( arg == "-h" || arg == "--help" ) {
+            PrintHelp();
+            return 0;
+        }
+        if( i+1 >= argc ) {
+            PrintHelp();
+            return 1;
+        }
+        std::string value = argv[++i];
+        if( arg == "--runs" ) {
+            options.nruns = atoi(value.c_str());
+        }
+        else if( arg == "--seed" ) {
+            options.seed = (uint32_t)strtoul(value.c_str(), NULL, 10);
+        }
+        else if( arg == "--scene" ) {
+            options.vscenenames.push_back(value);
+        }
+        else if( arg == "--planner" ) {
+            options.plannername = value;
+        }
+        else if( arg == "--smoother" ) {
+            options.smoothername = value;
+        }
+        else if( arg == "--retimer" ) {
+            options.retimername = value;
+        }
+        else if( arg == "--maxiterations" ) {
+            options.nmaxiterations = atoi(value.c_str());
+        }
+        else if( arg == "--checker" ) {
+            options.checkername = value;
+        }
+        else if( arg == "--out" ) {
+            options.outputfilename = value;
+        }
+        else {
+            PrintHelp();
+            return 1;
+        }
+    }
+
+    RaveInitialize(true, Level_Warn);
+    std::vector<PlanningSceneResult> vsceneresults;
+    int ret = 0;
+    try {
+        for(size_t iscene = 0; iscene < sizeof(s_vscenes)/sizeof(s_vscenes[0]); ++iscene) {
+            const PlanningScene& scene = s_vscenes[iscene];
+            if( options.vscenenames.size() > 0 && find(options.vscenenames.begin(), options.vscenenames.end(), std::string(scene.name)) == options.vscenenames.end() ) {
+                continue;
+            }
+            vsceneresults.push_back(PlanningSceneResult());
+            RunScene(scene, options, vsceneresults.back());
+            PlanningSceneSummary summary;
+            Summarize(vsceneresults.back(), summary);
+            PrintSummary(cout, vsceneresults.back(), summary);
+        }
+        if( options.outputfilename.size() > 0 ) {
+            std::ofstream f(options.outputfilename.c_str());
+            WriteJSON(f, options, vsceneresults);
+        }
+    }
+    catch(const std::exception& ex) {
+        RAVELOG_ERROR_FORMAT("planning benchmark failed: %s", ex.what());
+        ret = 1;
+    }
+    RaveDestroy();
+    return ret;
+}
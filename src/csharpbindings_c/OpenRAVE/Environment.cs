@@ -60,6 +60,21 @@ public class Environment : Base
     [DllImport("libopenrave0.9_c", CharSet = CharSet.Ansi)]
     private static extern int ORCEnvironmentSetViewer(IntPtr env, string viewername);
 
+    [DllImport("libopenrave0.9_c")]
+    private static extern void ORCEnvironmentSetBodyTransforms(IntPtr env, IntPtr[] bodies, int numbodies, float[] poses);
+
+    [DllImport("libopenrave0.9_c")]
+    private static extern void ORCEnvironmentSetBodyTransforms(IntPtr env, IntPtr[] bodies, int numbodies, double[] poses);
+
+    [DllImport("libopenrave0.9_c")]
+    private static extern int ORCEnvironmentSetBodyDOFValues(IntPtr env, IntPtr[] bodies, int numbodies, float[] values);
+
+    [DllImport("libopenrave0.9_c")]
+    private static extern int ORCEnvironmentSetBodyDOFValues(IntPtr env, IntPtr[] bodies, int numbodies, double[] values);
+
+    [DllImport("libopenrave0.9_c")]
+    private static extern int ORCEnvironmentCheckCollisions(IntPtr env, IntPtr[] bodies, int numbodies, int[] collisions);
+
     internal Environment() : base(ORCEnvironmentCreate()) {
     }
 
@@ -174,6 +189,60 @@ public class Environment : Base
         else
             return false;
     }
+
+    /// <summary>
+    /// Sets the transforms of all bodies with one call, poses holds 7 values
+    /// (quaternion and translation) for every body.
+    /// </summary>
+    public void SetBodyTransforms(Body[] bodies, float[] poses)
+    {
+        if(poses.Length != 7*bodies.Length)
+            return;
+        ORCEnvironmentSetBodyTransforms(ptr, GetPtrs(bodies), bodies.Length, poses);
+    }
+
+    public void SetBodyTransforms(Body[] bodies, double[] poses)
+    {
+        if(poses.Length != 7*bodies.Length)
+            return;
+        ORCEnvironmentSetBodyTransforms(ptr, GetPtrs(bodies), bodies.Length, poses);
+    }
+
+    /// <summary>
+    /// Sets the DOF values of all bodies with one call, values holds the DOF
+    /// values of the bodies one after the other.
+    /// </summary>
+    public void SetBodyDOFValues(Body[] bodies, float[] values)
+    {
+        ORCEnvironmentSetBodyDOFValues(ptr, GetPtrs(bodies), bodies.Length, values);
+    }
+
+    public void SetBodyDOFValues(Body[] bodies, double[] values)
+    {
+        ORCEnvironmentSetBodyDOFValues(ptr, GetPtrs(bodies), bodies.Length, values);
+    }
+
+    /// <summary>
+    /// Checks every body for collision against the rest of the environment
+    /// with one call.
+    /// </summary>
+    public bool[] CheckCollisions(Body[] bodies)
+    {
+        int[] collisions = new int[bodies.Length];
+        ORCEnvironmentCheckCollisions(ptr, GetPtrs(bodies), bodies.Length, collisions);
+        bool[] result = new bool[bodies.Length];
+        for(int i = 0; i < bodies.Length; ++i)
+            result[i] = collisions[i] == 1;
+        return result;
+    }
+
+    private static IntPtr[] GetPtrs(Body[] bodies)
+    {
+        IntPtr[] ptrs = new IntPtr[bodies.Length];
+        for(int i = 0; i < bodies.Length; ++i)
+            ptrs[i] = bodies[i].Ptr;
+        return ptrs;
+    }
 }
 }
 
@@ -0,0 +1,309 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2012 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "bodystatesharedmemory.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace OpenRAVE {
+
+static const uint64_t s_magic = 0x534554415453524fULL; // "ORSTATES"
+static const uint32_t s_version = 2;
+static const uint64_t s_headerSize = 64; ///< bytes reserved for the header before the slots
+
+struct BodyStateSharedMemory::Header
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t numSlots;
+    uint64_t slotSize;
+    std::atomic<uint64_t> writecount; ///< number of written snapshots, the newest is in slot (writecount-1)%numSlots
+    uint32_t realSize; ///< sizeof(dReal) of the writer
+    uint32_t recordSize; ///< sizeof(BodyRecord) of the writer
+    std::atomic<uint32_t> unlinked; ///< set to 1 once the name refers to another shared memory or to none, so the readers reopen it
+};
+
+struct BodyStateSharedMemory::SlotHeader
+{
+    std::atomic<uint64_t> sequence; ///< odd while the slot is written
+    uint64_t size; ///< bytes of the snapshot following the header
+};
+
+/// \brief fixed part of a body in a snapshot, followed by the name padded to 8 bytes, 7*numlinks dReal (quaternion and translation) and numdofs dReal
+struct BodyRecord
+{
+    int32_t environmentid;
+    int32_t updatestamp;
+    uint32_t namelength;
+    uint32_t numlinks;
+    uint32_t numdofs;
+    uint32_t padding;
+};
+
+static inline uint64_t _AlignSize(uint64_t size)
+{
+    return (size + 7) & ~uint64_t(7);
+}
+
+static uint64_t _GetRecordSize(const KinBody::BodyState& state)
+{
+    return sizeof(BodyRecord) + _AlignSize(state.strname.size()) + sizeof(dReal)*(7*state.vectrans.size() + state.jointvalues.size());
+}
+
+BodyStateSharedMemory::BodyStateSharedMemory(const std::string& name, bool bWriter, uint32_t numSlots, uint64_t slotSize) : _name(name), _bWriter(bWriter), _pdata(nullptr), _mappedSize(0)
+{
+    BOOST_STATIC_ASSERT(sizeof(Header) <= s_headerSize);
+#ifdef _WIN32
+    throw OPENRAVE_EXCEPTION_FORMAT0(_("shared memory body states are not supported on windows"), ORE_NotImplemented);
+#else
+    const std::string shmname = name.size() > 0 && name[0] == '/' ? name : "/" + name;
+    int fd = -1;
+    if( bWriter ) {
+        // mark the previous memory so that the readers still mapping it reopen the new one
+        fd = shm_open(shmname.c_str(), O_RDWR, 0);
+        if( fd >= 0 ) {
+            struct stat filestat;
+            if( fstat(fd, &filestat) == 0 && (uint64_t)filestat.st_size >= s_headerSize ) {
+                void* pprevdata = mmap(nullptr, s_headerSize, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+                if( pprevdata != MAP_FAILED ) {
+                    Header* pprevheader = static_cast<Header*>(pprevdata);
+                    if( pprevheader->magic == s_magic && pprevheader->version == s_version ) {
+                        pprevheader->unlinked.store(1, std::memory_order_release);
+                    }
+                    munmap(pprevdata, s_headerSize);
+                }
+            }
+            close(fd);
+        }
+        shm_unlink(shmname.c_str());
+        fd = shm_open(shmname.c_str(), O_CREAT|O_RDWR, 0644);
+        _mappedSize = s_headerSize + (uint64_t)numSlots*(_AlignSize(sizeof(SlotHeader)) + _AlignSize(slotSize));
+        if( fd >= 0 && ftruncate(fd, _mappedSize) != 0 ) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    else {
+        fd = shm_open(shmname.c_str(), O_RDONLY, 0);
+        struct stat filestat;
+        if( fd >= 0 ) {
+            if( fstat(fd, &filestat) == 0 ) {
+                _mappedSize = filestat.st_size;
+            }
+            else {
+                close(fd);
+                fd = -1;
+            }
+        }
+    }
+    if( fd < 0 ) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("failed to open body state shared memory '%s': %s"), name%strerror(errno), ORE_InvalidArguments);
+    }
+    _pdata = mmap(nullptr, _mappedSize, bWriter ? PROT_READ|PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if( _pdata == MAP_FAILED ) {
+        _pdata = nullptr;
+        throw OPENRAVE_EXCEPTION_FORMAT(_("failed to map body state shared memory '%s': %s"), name%strerror(errno), ORE_InvalidArguments);
+    }
+
+    Header* pheader = static_cast<Header*>(_pdata);
+    if( bWriter ) {
+        // the memory is zeroed by ftruncate, so every sequence starts even
+        pheader->numSlots = numSlots;
+        pheader->slotSize = _AlignSize(slotSize);
+        pheader->version = s_version;
+        pheader->realSize = sizeof(dReal);
+        pheader->recordSize = sizeof(BodyRecord);
+        pheader->writecount.store(0, std::memory_order_relaxed);
+        pheader->unlinked.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        pheader->magic = s_magic;
+    }
+    else if( _mappedSize < s_headerSize || pheader->magic != s_magic || pheader->version != s_version || pheader->numSlots == 0 || pheader->slotSize != _AlignSize(pheader->slotSize) || _mappedSize < s_headerSize + (uint64_t)pheader->numSlots*(_AlignSize(sizeof(SlotHeader)) + pheader->slotSize) ) {
+        munmap(_pdata, _mappedSize);
+        _pdata = nullptr;
+        throw OPENRAVE_EXCEPTION_FORMAT(_("body state shared memory '%s' is not valid"), name, ORE_InvalidArguments);
+    }
+    else if( pheader->realSize != sizeof(dReal) || pheader->recordSize != sizeof(BodyRecord) ) {
+        const uint32_t realSize = pheader->realSize, recordSize = pheader->recordSize;
+        munmap(_pdata, _mappedSize);
+        _pdata = nullptr;
+        throw OPENRAVE_EXCEPTION_FORMAT(_("body state shared memory '%s' was written with sizeof(dReal)=%d and record size %d, but expected %d and %d"), name%realSize%recordSize%sizeof(dReal)%sizeof(BodyRecord), ORE_InvalidArguments);
+    }
+#endif
+}
+
+BodyStateSharedMemory::~BodyStateSharedMemory()
+{
+#ifndef _WIN32
+    if( !!_pdata ) {
+        if( _bWriter ) {
+            static_cast<Header*>(_pdata)->unlinked.store(1, std::memory_order_release);
+        }
+        munmap(_pdata, _mappedSize);
+    }
+    if( _bWriter ) {
+        shm_unlink((_name.size() > 0 && _name[0] == '/' ? _name : "/" + _name).c_str());
+    }
+#endif
+}
+
+bool BodyStateSharedMemory::IsUnlinked() const
+{
+    return static_cast<const Header*>(_pdata)->unlinked.load(std::memory_order_acquire) != 0;
+}
+
+BodyStateSharedMemory::SlotHeader* BodyStateSharedMemory::_GetSlot(uint64_t islot) const
+{
+    const Header* pheader = static_cast<const Header*>(_pdata);
+    return reinterpret_cast<SlotHeader*>(static_cast<uint8_t*>(_pdata) + s_headerSize + islot*(_AlignSize(sizeof(SlotHeader)) + pheader->slotSize));
+}
+
+void BodyStateSharedMemory::Write(const std::vector<KinBody::BodyState>& vbodies)
+{
+    Header* pheader = static_cast<Header*>(_pdata);
+    uint32_t numbodies = 0;
+    uint64_t size = sizeof(uint64_t);
+    for (const KinBody::BodyState& state : vbodies) {
+        const uint64_t recordsize = _GetRecordSize(state);
+        if( size + recordsize > pheader->slotSize ) {
+            RAVELOG_WARN_FORMAT("body state shared memory '%s' can only hold %d of the %d bodies", _name%numbodies%vbodies.size());
+            break;
+        }
+        size += recordsize;
+        ++numbodies;
+    }
+
+    const uint64_t writecount = pheader->writecount.load(std::memory_order_relaxed);
+    SlotHeader* pslot = _GetSlot(writecount%pheader->numSlots);
+    const uint64_t sequence = pslot->sequence.load(std::memory_order_relaxed);
+    pslot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    uint8_t* pdata = reinterpret_cast<uint8_t*>(pslot) + _AlignSize(sizeof(SlotHeader));
+    *reinterpret_cast<uint64_t*>(pdata) = numbodies;
+    pdata += sizeof(uint64_t);
+    for(uint32_t ibody = 0; ibody < numbodies; ++ibody) {
+        const KinBody::BodyState& state = vbodies[ibody];
+        BodyRecord* precord = reinterpret_cast<BodyRecord*>(pdata);
+        precord->environmentid = state.environmentid;
+        precord->updatestamp = state.updatestamp;
+        precord->namelength = state.strname.size();
+        precord->numlinks = state.vectrans.size();
+        precord->numdofs = state.jointvalues.size();
+        precord->padding = 0;
+        pdata += sizeof(BodyRecord);
+        std::memcpy(pdata, state.strname.c_str(), state.strname.size());
+        pdata += _AlignSize(state.strname.size());
+        dReal* pvalues = reinterpret_cast<dReal*>(pdata);
+        for (const Transform& t : state.vectrans) {
+            for(int i = 0; i < 4; ++i) {
+                *pvalues++ = t.rot[i];
+            }
+            for(int i = 0; i < 3; ++i) {
+                *pvalues++ = t.trans[i];
+            }
+        }
+        if( state.jointvalues.size() > 0 ) {
+            std::memcpy(pvalues, state.jointvalues.data(), sizeof(dReal)*state.jointvalues.size());
+        }
+        pdata = reinterpret_cast<uint8_t*>(pvalues + state.jointvalues.size());
+    }
+    pslot->size = size;
+
+    pslot->sequence.store(sequence + 2, std::memory_order_release);
+    pheader->writecount.store(writecount + 1, std::memory_order_release);
+}
+
+bool BodyStateSharedMemory::Read(std::vector<KinBody::BodyState>& vbodies, uint64_t& writecount)
+{
+    const Header* pheader = static_cast<const Header*>(_pdata);
+    // the writer can lap the reader, in which case the newest slot is read again
+    for(int itry = 0; itry < 100; ++itry) {
+        const uint64_t newwritecount = pheader->writecount.load(std::memory_order_acquire);
+        if( newwritecount == 0 || newwritecount == writecount ) {
+            return false;
+        }
+        const SlotHeader* pslot = _GetSlot((newwritecount - 1)%pheader->numSlots);
+        const uint64_t sequence = pslot->sequence.load(std::memory_order_acquire);
+        if( sequence & 1 ) {
+            continue;
+        }
+        const uint64_t size = std::min(pslot->size, pheader->slotSize);
+        _vbuffer.resize(size);
+        std::memcpy(_vbuffer.data(), reinterpret_cast<const uint8_t*>(pslot) + _AlignSize(sizeof(SlotHeader)), size);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if( pslot->sequence.load(std::memory_order_relaxed) != sequence || size < sizeof(uint64_t) ) {
+            continue;
+        }
+
+        // the copy is consistent, but the writer is another process, so check every length before using it
+        const uint8_t* pdata = _vbuffer.data();
+        uint64_t remaining = size - sizeof(uint64_t);
+        const uint64_t numbodies = *reinterpret_cast<const uint64_t*>(pdata);
+        pdata += sizeof(uint64_t);
+        if( numbodies > remaining/sizeof(BodyRecord) ) {
+            RAVELOG_WARN_FORMAT("body state shared memory '%s' snapshot %d has %d bodies, but only %d bytes", _name%newwritecount%numbodies%remaining);
+            writecount = newwritecount;
+            return false;
+        }
+        vbodies.resize(numbodies);
+        for(uint64_t ibody = 0; ibody < numbodies; ++ibody) {
+            const BodyRecord* precord = reinterpret_cast<const BodyRecord*>(pdata);
+            if( remaining < sizeof(BodyRecord) || remaining - sizeof(BodyRecord) < _AlignSize(precord->namelength) + sizeof(dReal)*(7*(uint64_t)precord->numlinks + precord->numdofs) ) {
+                RAVELOG_WARN_FORMAT("body state shared memory '%s' snapshot %d has a body record %d exceeding the %d bytes of the snapshot", _name%newwritecount%ibody%size);
+                vbodies.clear();
+                writecount = newwritecount;
+                return false;
+            }
+            remaining -= sizeof(BodyRecord) + _AlignSize(precord->namelength) + sizeof(dReal)*(7*(uint64_t)precord->numlinks + precord->numdofs);
+            KinBody::BodyState& state = vbodies[ibody];
+            state.Reset();
+            state.environmentid = precord->environmentid;
+            state.updatestamp = precord->updatestamp;
+            pdata += sizeof(BodyRecord);
+            state.strname.assign(reinterpret_cast<const char*>(pdata), precord->namelength);
+            pdata += _AlignSize(precord->namelength);
+            const dReal* pvalues = reinterpret_cast<const dReal*>(pdata);
+            state.vectrans.resize(precord->numlinks);
+            for (Transform& t : state.vectrans) {
+                for(int i = 0; i < 4; ++i) {
+                    t.rot[i] = *pvalues++;
+                }
+                for(int i = 0; i < 3; ++i) {
+                    t.trans[i] = *pvalues++;
+                }
+            }
+            state.jointvalues.assign(pvalues, pvalues + precord->numdofs);
+            pdata = reinterpret_cast<const uint8_t*>(pvalues + precord->numdofs);
+        }
+        writecount = newwritecount;
+        return true;
+    }
+    RAVELOG_DEBUG_FORMAT("failed to read a consistent snapshot from body state shared memory '%s'", _name);
+    return false;
+}
+
+} // end namespace OpenRAVE
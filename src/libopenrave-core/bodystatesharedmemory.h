@@ -0,0 +1,73 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2012 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef RAVE_BODYSTATESHAREDMEMORY
+#define RAVE_BODYSTATESHAREDMEMORY
+
+#include "ravep.h"
+
+namespace OpenRAVE {
+
+/// \brief named shared memory ring buffer of published body state snapshots, written by one process and read by any number of processes on the same host.
+///
+/// Every slot of the ring is protected by a sequence lock, so the writer never waits for the readers and a reader retries when the writer
+/// overwrote the slot it was copying. A snapshot only holds the name, environment body index, update stamp, link transformations and dof
+/// values of every body, stored as plain arrays so that they are copied without serialization.
+class BodyStateSharedMemory
+{
+public:
+    /// \brief creates the shared memory for writing, replacing any existing one with the same name, or opens it for reading
+    ///
+    /// \param numSlots number of snapshots kept in the ring, only used when writing
+    /// \param slotSize bytes of every snapshot, only used when writing
+    /// \throw openrave_exception if the shared memory cannot be created or opened
+    BodyStateSharedMemory(const std::string& name, bool bWriter, uint32_t numSlots=4, uint64_t slotSize=4<<20);
+    virtual ~BodyStateSharedMemory();
+
+    /// \brief writes the snapshot into the next slot. Bodies that do not fit into a slot are dropped with a warning.
+    void Write(const std::vector<KinBody::BodyState>& vbodies);
+
+    /// \brief reads the newest snapshot if it is newer than writecount. The pbody of the states is null. A snapshot with lengths exceeding its size is skipped with a warning.
+    ///
+    /// \param writecount the count of the last read snapshot, updated to the count of the read one
+    /// \return true if a newer snapshot was read
+    bool Read(std::vector<KinBody::BodyState>& vbodies, uint64_t& writecount);
+
+    /// \brief true if the writer was destroyed or another writer replaced the shared memory of the same name, in which case the reader has to be opened again
+    bool IsUnlinked() const;
+
+    inline const std::string& GetName() const {
+        return _name;
+    }
+
+private:
+    struct Header;
+    struct SlotHeader;
+
+    SlotHeader* _GetSlot(uint64_t islot) const;
+
+    std::string _name; ///< name of the shared memory object
+    bool _bWriter;
+    void* _pdata; ///< the mapped memory
+    uint64_t _mappedSize;
+    std::vector<uint8_t> _vbuffer; ///< cache
+};
+
+typedef boost::shared_ptr<BodyStateSharedMemory> BodyStateSharedMemoryPtr;
+
+} // end namespace OpenRAVE
+
+#endif
@@ -2989,10 +2989,8 @@ public:
                         if( name == "box" ) {
                             daeElementRef phalf_extents = children[i]->getChild("half_extents");
                             if( !!phalf_extents ) {
-                                stringstream ss(phalf_extents->getCharData());
                                 Vector vextents;
-                                ss >> vextents.x >> vextents.y >> vextents.z;
-                                if( ss.eof() || !!ss ) {
+                                if( _ParseCharDataReals(phalf_extents, &vextents.x, 3) ) {
                                     geominfo._type = GT_Box;
                                     geominfo._vGeomData = vextents;
                                     geominfo.SetTransform(tlocalgeom);
@@ -3004,9 +3002,7 @@ public:
                             daeElementRef pradius = children[i]->getChild("radius");
                             if( !!pradius ) {
                                 dReal fradius = 0;
-                                stringstream ss(pradius->getCharData());
-                                ss >> fradius;
-                                if( ss.eof() || !!ss ) {
+                                if( _ParseCharDataReals(pradius, &fradius, 1) ) {
                                     geominfo._type = GT_Sphere;
                                     geominfo._vGeomData.x = fradius;
                                     geominfo.SetTransform(tlocalgeom);
@@ -3019,11 +3015,7 @@ public:
                             daeElementRef pheight = children[i]->getChild("height");
                             if( !!pradius && !!pheight ) {
                                 Vector vGeomData;
-                                stringstream ss(pradius->getCharData());
-                                ss >> vGeomData.x;
-                                stringstream ss2(pheight->getCharData());
-                                ss2 >> vGeomData.y;
-                                if( (ss.eof() || !!ss) && (ss2.eof() || !!ss2) ) {
+                                if( _ParseCharDataReals(pradius, &vGeomData.x, 1) && _ParseCharDataReals(pheight, &vGeomData.y, 1) ) {
                                     Transform trot(quatRotateDirection(Vector(0,0,1),Vector(0,1,0)),Vector());
                                     tlocalgeom = tlocalgeom * trot;
                                     geominfo._type = GT_Cylinder;
@@ -3038,11 +3030,7 @@ public:
                             daeElementRef pheight = children[i]->getChild("height");
                             if( !!pradius && !!pheight ) {
                                 Vector vGeomData;
-                                stringstream ss(pradius->getCharData());
-                                ss >> vGeomData.x;
-                                stringstream ss2(pheight->getCharData());
-                                ss2 >> vGeomData.y;
-                                if( (ss.eof() || !!ss) && (ss2.eof() || !!ss2) ) {
+                                if( _ParseCharDataReals(pradius, &vGeomData.x, 1) && _ParseCharDataReals(pheight, &vGeomData.y, 1) ) {
                                     geominfo._type = GT_Cylinder;
                                     geominfo._vGeomData = vGeomData;
                                     geominfo.SetTransform(tlocalgeom);
@@ -3056,10 +3044,8 @@ public:
 
                             daeElementRef phalf_extents = children[i]->getChild("half_extents");
                             if( !!phalf_extents ) {
-                                stringstream ss(phalf_extents->getCharData());
                                 Vector vextents;
-                                ss >> vextents.x >> vextents.y >> vextents.z;
-                                if( ss.eof() || !!ss ) {
+                                if( _ParseCharDataReals(phalf_extents, &vextents.x, 3) ) {
                                     geominfo._vGeomData = vextents;
                                     bfoundgeom = true;
                                 }
@@ -3068,30 +3054,24 @@ public:
                             geominfo._vGeomData2 = Vector();
                             daeElementRef pInnerSizeX = children[i]->getChild("inner_size_x");
                             if( !!pInnerSizeX ) {
-                                stringstream ss(pInnerSizeX->getCharData());
                                 dReal fInnerSizeX=0;
-                                ss >> fInnerSizeX;
-                                if( ss.eof() || !!ss ) {
+                                if( _ParseCharDataReals(pInnerSizeX, &fInnerSizeX, 1) ) {
                                     geominfo._vGeomData2.x = fInnerSizeX;
                                     bfoundgeom = true;
                                 }
                             }
                             daeElementRef pInnerSizeY = children[i]->getChild("inner_size_y");
                             if( !!pInnerSizeY ) {
-                                stringstream ss(pInnerSizeY->getCharData());
                                 dReal fInnerSizeY=0;
-                                ss >> fInnerSizeY;
-                                if( ss.eof() || !!ss ) {
+                                if( _ParseCharDataReals(pInnerSizeY, &fInnerSizeY, 1) ) {
                                     geominfo._vGeomData2.y = fInnerSizeY;
                                     bfoundgeom = true;
                                 }
                             }
                             daeElementRef pInnerSizeZ = children[i]->getChild("inner_size_z");
                             if( !!pInnerSizeZ ) {
-                                stringstream ss(pInnerSizeZ->getCharData());
                                 dReal fInnerSizeZ=0;
-                                ss >> fInnerSizeZ;
-                                if( ss.eof() || !!ss ) {
+                                if( _ParseCharDataReals(pInnerSizeZ, &fInnerSizeZ, 1) ) {
                                     geominfo._vGeomData2.z = fInnerSizeZ;
                                     bfoundgeom = true;
                                 }
@@ -3135,10 +3115,8 @@ public:
                         else if( name == "container" ) {
                             daeElementRef pouter_extents = children[i]->getChild("outer_extents");
                             if( !!pouter_extents ) {
-                                stringstream ss(pouter_extents->getCharData());
                                 Vector vextents;
-                                ss >> vextents.x >> vextents.y >> vextents.z;
-                                if( ss.eof() || !!ss ) {
+                                if( _ParseCharDataReals(pouter_extents, &vextents.x, 3) ) {
                                     geominfo._type = GT_Container;
                                     geominfo._vGeomData = vextents;
                                     geominfo.SetTransform(tlocalgeom);
@@ -3147,10 +3125,8 @@ public:
                             }
                             daeElementRef pinner_extents = children[i]->getChild("inner_extents");
                             if( !!pinner_extents ) {
-                                stringstream ss(pinner_extents->getCharData());
                                 Vector vextents;
-                                ss >> vextents.x >> vextents.y >> vextents.z;
-                                if( ss.eof() || !!ss ) {
+                                if( _ParseCharDataReals(pinner_extents, &vextents.x, 3) ) {
                                     geominfo._type = GT_Container;
                                     geominfo._vGeomData2 = vextents;
                                     geominfo.SetTransform(tlocalgeom);
@@ -3159,10 +3135,8 @@ public:
                             }
                             daeElementRef pbottom_cross = children[i]->getChild("bottom_cross");
                             if( !!pbottom_cross ) {
-                                stringstream ss(pbottom_cross->getCharData());
                                 Vector vextents;
-                                ss >> vextents.x >> vextents.y >> vextents.z;
-                                if( ss.eof() || !!ss ) {
+                                if( _ParseCharDataReals(pbottom_cross, &vextents.x, 3) ) {
                                     geominfo._type = GT_Container;
                                     geominfo._vGeomData3 = vextents;
                                     geominfo.SetTransform(tlocalgeom);
@@ -3171,10 +3145,8 @@ public:
                             }
                             daeElementRef pbottom = children[i]->getChild("bottom");
                             if( !!pbottom ) {
-                                stringstream ss(pbottom->getCharData());
                                 Vector vextents;
-                                ss >> vextents.x >> vextents.y >> vextents.z;
-                                if( ss.eof() || !!ss ) {
+                                if( _ParseCharDataReals(pbottom, &vextents.x, 3) ) {
                                     geominfo._type = GT_Container;
                                     geominfo._vGeomData4 = vextents;
                                     geominfo.SetTransform(tlocalgeom);
@@ -3485,8 +3457,7 @@ public:
                         manipinfo._tLocalTool = _ExtractFullTransformFromChildren(pframe_tip);
                         daeElementRef pdirection = pframe_tip->getChild("direction");
                         if( !!pdirection ) {
-                            stringstream ss(pdirection->getCharData());
-                            ss >> manipinfo._vdirection.x >> manipinfo._vdirection.y >> manipinfo._vdirection.z;
+                            _ParseCharDataReals(pdirection, &manipinfo._vdirection.x, 3);
                             // have to normalize direction!
                             dReal dirlen2 = manipinfo._vdirection.lengthsqr3();
                             if( dirlen2 > g_fEpsilon ) {
@@ -4048,16 +4019,16 @@ public:
                 pinfo->viscous_friction = boost::lexical_cast<dReal>(pchild->getCharData());
             }
             else if( pchild->getElementName() == string("nominal_speed_torque_point") ) {
-                std::stringstream ss(pchild->getCharData());
-                std::vector<dReal> vpoints((istream_iterator<dReal>(ss)), istream_iterator<dReal>());
+                std::vector<dReal> vpoints;
+                _ParseCharDataReals(pchild, vpoints);
                 pinfo->nominal_speed_torque_points.resize(vpoints.size()/2);
                 for(size_t ipoint = 0; ipoint < vpoints.size(); ipoint += 2) {
                     pinfo->nominal_speed_torque_points[ipoint/2] = std::make_pair(vpoints[ipoint], vpoints[ipoint+1]);
                 }
             }
             else if( pchild->getElementName() == string("max_speed_torque_point") ) {
-                std::stringstream ss(pchild->getCharData());
-                std::vector<dReal> vpoints((istream_iterator<dReal>(ss)), istream_iterator<dReal>());
+                std::vector<dReal> vpoints;
+                _ParseCharDataReals(pchild, vpoints);
                 pinfo->max_speed_torque_points.resize(vpoints.size()/2);
                 for(size_t ipoint = 0; ipoint < vpoints.size(); ipoint += 2) {
                     pinfo->max_speed_torque_points[ipoint/2] = std::make_pair(vpoints[ipoint], vpoints[ipoint+1]);
@@ -4367,9 +4338,10 @@ public:
         }
         daeElement* pfloat = pcommon->getChild("float");
         if( !!pfloat ) {
-            stringstream sfloat(pfloat->getCharData());
-            sfloat >> f;
-            return !!sfloat;
+            const std::string chardata = pfloat->getCharData();
+            char* pend = NULL;
+            f = strtod(chardata.c_str(), &pend);
+            return pend != chardata.c_str();
         }
         daeElement* pint = pcommon->getChild("int");
         if( !!pint ) {
@@ -5225,6 +5197,29 @@ private:
         return std::make_pair(pjoint,pdomjoint);
     }
 
+    /// \brief parses up to maxvalues whitespace separated reals from the character data of pelt with strtod instead of a stringstream.
+    ///
+    /// The values that are not in the data are left untouched.
+    /// \return false if a token that is not a number is found before maxvalues are parsed
+    static bool _ParseCharDataReals(daeElementRef pelt, dReal* pvalues, size_t maxvalues)
+    {
+        const std::string chardata = pelt->getCharData();
+        const char* pend = NULL;
+        if( utils::ParseReals(chardata.c_str(), pvalues, maxvalues, &pend) == maxvalues ) {
+            return true;
+        }
+        while( *pend != 0 && isspace((unsigned char)*pend) ) {
+            ++pend;
+        }
+        return *pend == 0;
+    }
+
+    /// \brief parses all the whitespace separated reals of the character data of pelt, stops at the first token that is not a number
+    static void _ParseCharDataReals(daeElementRef pelt, std::vector<dReal>& vvalues)
+    {
+        utils::ParseReals(pelt->getCharData(), vvalues);
+    }
+
     /// \brief get the element name without the namespace
     std::string _getElementName(daeElementRef pelt) {
         std::string name = pelt->getElementName();
@@ -21,12 +21,18 @@
 #include "colladaparser/colladacommon.h"
 #include "jsonparser/jsoncommon.h"
 #include "stringutils.h"
+#include "lockprofiler.h"
+#include "workerpool.h"
+#include "trimeshcache.h"
+#include "physicsrecorder.h"
+#include "bodystatesharedmemory.h"
 
 #ifdef HAVE_BOOST_FILESYSTEM
 #include <boost/filesystem/operations.hpp>
 #endif
 
 #include <chrono>
+#include <exception>
 #include <mutex>
 #include <shared_mutex>
 #include <thread>
@@ -34,6 +40,11 @@
 
 #include <pcrecpp.h>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 #define CHECK_INTERFACE(pinterface) { \
         if( (pinterface)->GetEnv() != shared_from_this() ) { \
             throw openrave_exception(str(boost::format(_("env=%s, Interface %s:%s is from a different environment (env=%s) than the current one."))%GetNameId()%RaveGetInterfaceName((pinterface)->GetInterfaceType())%(pinterface)->GetXMLId()%(pinterface)->GetEnv()->GetNameId()),ORE_InvalidArguments); \
@@ -162,6 +173,9 @@ typedef boost::shared_ptr<KinBodyIdSaver> KinBodyIdSaverPtr;
 
 class Environment : public EnvironmentBase
 {
+    /// all the environment locks of the implementation report to LockProfiler, see SetLockProfiling
+    using EnvironmentLock = ProfiledEnvironmentLock;
+
     class GraphHandleMulti : public GraphHandle
     {
 public:
@@ -214,6 +228,33 @@ protected:
     friend class CollisionCallbackData;
     typedef boost::shared_ptr<CollisionCallbackData> CollisionCallbackDataPtr;
 
+    /// \brief immutable state of all the bodies at the last UpdatePublishedBodies
+    struct PublishedBodiesSnapshot
+    {
+        /// \brief index of the first body in vSortedNameIndices whose name is not less than name
+        std::vector<int>::const_iterator LowerBoundName(const std::string& name) const
+        {
+            return std::lower_bound(vSortedNameIndices.begin(), vSortedNameIndices.end(), name, [this](int ibody, const std::string& value) {
+                return vbodies[ibody].strname < value;
+            });
+        }
+
+        /// \return index of the body in vbodies or -1 if not found
+        int FindBody(const std::string& name) const
+        {
+            std::vector<int>::const_iterator it = LowerBoundName(name);
+            if( it != vSortedNameIndices.end() && vbodies[*it].strname == name ) {
+                return *it;
+            }
+            return -1;
+        }
+
+        std::vector<KinBody::BodyState> vbodies;
+        std::vector<int> vSortedNameIndices; ///< indices of vbodies sorted by name, for name and prefix lookups
+    };
+    typedef boost::shared_ptr<PublishedBodiesSnapshot> PublishedBodiesSnapshotPtr;
+    typedef boost::shared_ptr<PublishedBodiesSnapshot const> PublishedBodiesSnapshotConstPtr;
+
     class BodyCallbackData : public UserData
     {
 public:
@@ -258,6 +299,7 @@ public:
             RAVELOG_WARN("environment is already initialized, ignoring\n");
             return;
         }
+        utils::StartupTraceScope tracescope("environment", "Environment::Init " + GetNameId());
 
         _nBodiesModifiedStamp = 0;
 
@@ -279,6 +321,7 @@ public:
         _bInit = true;
 
         // set a collision checker, don't call EnvironmentBase::CreateCollisionChecker
+        utils::StartupTraceScope tracescopechecker("environment", "default collision checker");
         CollisionCheckerBasePtr localchecker;
 
         const char* pOPENRAVE_DEFAULT_COLLISIONCHECKER = std::getenv("OPENRAVE_DEFAULT_COLLISIONCHECKER");
@@ -386,7 +429,9 @@ public:
                 ExclusiveLock lock874(_mutexInterfaces);
                 vecbodies.swap(_vecbodies);
                 listSensors.swap(_listSensors);
-                _vPublishedBodies.clear();
+                _ResetPublishedBodies();
+                _pPublishedBodiesSharedMemory.reset();
+                _mapPublishedBodiesSharedMemoryReaders.clear();
                 _nBodiesModifiedStamp++;
                 _listModules.clear();
                 _listViewers.clear();
@@ -416,6 +461,7 @@ public:
 
         // release all other interfaces, not necessary to hold a mutex?
         _pCurrentChecker.reset();
+        _pPhysicsRecorder.reset();
         _pPhysicsEngine.reset();
         RAVELOG_VERBOSE("Environment destroyed\n");
     }
@@ -465,7 +511,7 @@ public:
             _mapBodyNameIndex.clear();
             _mapBodyIdIndex.clear();
 
-            _vPublishedBodies.clear();
+            _ResetPublishedBodies();
             _nBodiesModifiedStamp++;
 
             _environmentIndexRecyclePool.clear();
@@ -575,6 +621,44 @@ public:
         return ret;
     }
 
+    void GetMemoryUsage(MemoryUsage& memoryusage, uint64_t timeout) const override
+    {
+        TimedSharedLock lock(_mutexInterfaces, timeout);
+        if (!lock) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("timeout of %f s failed"),(1e-6*static_cast<double>(timeout)),ORE_Timeout);
+        }
+        memoryusage = MemoryUsage(GetName(), "environment");
+        uint64_t indexbytes = GetVectorMemoryUsage(_vecbodies);
+        // the string_map nodes hold the key and the index, besides the tree pointers
+        FOREACHC(it, _mapBodyNameIndex) {
+            indexbytes += 4*sizeof(void*) + sizeof(*it) + it->first.capacity();
+        }
+        FOREACHC(it, _mapBodyIdIndex) {
+            indexbytes += 4*sizeof(void*) + sizeof(*it) + it->first.capacity();
+        }
+        memoryusage.Add("bodyindex", indexbytes);
+        FOREACHC(itbody, _vecbodies) {
+            if( !!*itbody ) {
+                (*itbody)->GetMemoryUsage(memoryusage.AddChild((*itbody)->GetName(), (*itbody)->IsRobot() ? "robot" : "kinbody"));
+            }
+        }
+        if( !!_pCurrentChecker ) {
+            _pCurrentChecker->GetMemoryUsage(memoryusage.AddChild(_pCurrentChecker->GetXMLId(), "collisionchecker"));
+        }
+        if( !!_pPhysicsEngine ) {
+            _pPhysicsEngine->GetMemoryUsage(memoryusage.AddChild(_pPhysicsEngine->GetXMLId(), "physicsengine"));
+        }
+        FOREACHC(itmodule, _listModules) {
+            itmodule->first->GetMemoryUsage(memoryusage.AddChild(itmodule->first->GetXMLId(), "module"));
+        }
+        FOREACHC(itsensor, _listSensors) {
+            (*itsensor)->GetMemoryUsage(memoryusage.AddChild((*itsensor)->GetName(), "sensor"));
+        }
+        FOREACHC(itviewer, _listViewers) {
+            (*itviewer)->GetMemoryUsage(memoryusage.AddChild((*itviewer)->GetXMLId(), "viewer"));
+        }
+    }
+
     void GetModules(std::list<ModuleBasePtr>& listModules, uint64_t timeout) const override
     {
         TimedSharedLock lock145(_mutexInterfaces, timeout);
@@ -718,6 +802,10 @@ public:
     virtual void Save(const std::string& filename, SelectionOptions options, const AttributesList& atts) override
     {
         EnvironmentLock lockenv(GetMutex());
+        if( StringEndsWith(filename, ".zst") ) {
+            // zstd compressed documents are only read, compress them with the zstd tool
+            throw OPENRAVE_EXCEPTION_FORMAT(_("cannot save '%s', writing zstd compressed files is not supported"), filename, ORE_NotImplemented);
+        }
         std::list<KinBodyPtr> listbodies;
         switch(options) {
         case SO_Everything:
@@ -993,6 +1081,7 @@ public:
     virtual void _AddKinBody(KinBodyPtr pbody, InterfaceAddMode addMode)
     {
         EnvironmentLock lockenv(GetMutex());
+        EnvironmentWriteLock lockshared(_mutexEnvironmentShared);
         CHECK_INTERFACE(pbody);
         if( !utils::IsValidName(pbody->GetName()) ) {
             if( addMode & IAM_StrictNameChecking ) {
@@ -1031,6 +1120,7 @@ public:
     virtual void _AddRobot(RobotBasePtr robot, InterfaceAddMode addMode)
     {
         EnvironmentLock lockenv(GetMutex());
+        EnvironmentWriteLock lockshared(_mutexEnvironmentShared);
         CHECK_INTERFACE(robot);
         if( !robot->IsRobot() ) {
             throw openrave_exception(str(boost::format(_("kinbody '%s' is not a robot"))%robot->GetName()));
@@ -1069,6 +1159,77 @@ public:
         _CallBodyCallbacks(robot, 1);
     }
 
+    virtual void AddBodies(const std::vector<KinBodyPtr>& vbodies, InterfaceAddMode addMode) override
+    {
+        EnvironmentLock lockenv(GetMutex());
+        EnvironmentWriteLock lockshared(_mutexEnvironmentShared);
+        // validate everything that can be checked up front so that a bad body does not leave the others half added
+        for (const KinBodyPtr& pbody : vbodies) {
+            CHECK_INTERFACE(pbody);
+            if( pbody->GetInterfaceType() == PT_Robot && !pbody->IsRobot() ) {
+                throw openrave_exception(str(boost::format(_("kinbody '%s' is not a robot"))%pbody->GetName()));
+            }
+            if( !utils::IsValidName(pbody->GetName()) && (addMode & IAM_StrictNameChecking) ) {
+                throw openrave_exception(str(boost::format(_("Body name: '%s' is not valid"))%pbody->GetName()));
+            }
+            if( pbody->GetEnvironmentBodyIndex() > 0 ) {
+                throw OPENRAVE_EXCEPTION_FORMAT(_("env=%s, body '%s' is already added to an environment"), GetNameId()%pbody->GetName(), ORE_InvalidArguments);
+            }
+        }
+
+        std::vector<int> vaddedindices;
+        vaddedindices.reserve(vbodies.size());
+        try {
+            for (const KinBodyPtr& pbody : vbodies) {
+                if( !utils::IsValidName(pbody->GetName()) ) {
+                    pbody->SetName(utils::ConvertToOpenRAVEName(pbody->GetName()));
+                }
+                if( pbody->GetEnvironmentBodyIndex() > 0 ) {
+                    throw OPENRAVE_EXCEPTION_FORMAT(_("env=%s, body '%s' is listed more than once"), GetNameId()%pbody->GetName(), ORE_InvalidArguments);
+                }
+                // the bodies of the batch are indexed one by one so that the name and id checks see the previous ones
+                if( !_CheckUniqueName(KinBodyConstPtr(pbody), !!(addMode & IAM_StrictNameChecking)) ) {
+                    _EnsureUniqueName(pbody);
+                }
+                if( !_CheckUniqueId(KinBodyConstPtr(pbody), !!(addMode & IAM_StrictIdChecking)) ) {
+                    _EnsureUniqueId(pbody);
+                }
+                ExclusiveLock lock437(_mutexInterfaces);
+                const int newBodyIndex = _AssignEnvironmentBodyIndex(pbody);
+                _AddKinBodyInternal(pbody, newBodyIndex);
+                vaddedindices.push_back(newBodyIndex);
+            }
+        }
+        catch(const std::exception&) {
+            ExclusiveLock lock438(_mutexInterfaces);
+            for (int envBodyIndex : vaddedindices) {
+                _InvalidateKinBodyFromEnvBodyIndex(envBodyIndex);
+            }
+            throw;
+        }
+        {
+            ExclusiveLock lock439(_mutexInterfaces);
+            _nBodiesModifiedStamp++;
+        }
+
+        // the collision checkers only create the per body data here, their broadphase managers register all the new bodies at once on the next query
+        for (const KinBodyPtr& pbody : vbodies) {
+            pbody->_ComputeInternalInformation(); // after all the bodies are indexed since SensorBase::SetName can call EnvironmentBase::GetSensor
+            _pCurrentChecker->InitKinBody(pbody);
+            if( !!pbody->GetSelfCollisionChecker() && pbody->GetSelfCollisionChecker() != _pCurrentChecker ) {
+                pbody->GetSelfCollisionChecker()->InitKinBody(pbody);
+            }
+            _pPhysicsEngine->InitKinBody(pbody);
+        }
+        const uint32_t maskPotentialyChanged(0xffffffff&~KinBody::Prop_JointMimic& ~KinBody::Prop_LinkStatic& ~KinBody::Prop_BodyRemoved& ~KinBody::Prop_LinkGeometry& ~KinBody::Prop_LinkGeometryGroup& ~KinBody::Prop_LinkDynamics);
+        for (const KinBodyPtr& pbody : vbodies) {
+            pbody->_PostprocessChangedParameters(maskPotentialyChanged);
+        }
+        for (const KinBodyPtr& pbody : vbodies) {
+            _CallBodyCallbacks(pbody, 1);
+        }
+    }
+
     virtual void _AddSensor(SensorBasePtr psensor, InterfaceAddMode addMode)
     {
         EnvironmentLock lockenv(GetMutex());
@@ -1096,6 +1257,7 @@ public:
     virtual bool Remove(InterfaceBasePtr pinterface) override
     {
         EnvironmentLock lockenv(GetMutex());
+        EnvironmentWriteLock lockshared(_mutexEnvironmentShared);
         CHECK_INTERFACE(pinterface);
         switch(pinterface->GetInterfaceType()) {
         case PT_KinBody:
@@ -1151,9 +1313,35 @@ public:
         return false;
     }
 
+    virtual int RemoveBodies(const std::vector<KinBodyPtr>& vbodies) override
+    {
+        EnvironmentLock lockenv(GetMutex());
+        EnvironmentWriteLock lockshared(_mutexEnvironmentShared);
+        std::vector<KinBodyPtr> vremovedbodies;
+        vremovedbodies.reserve(vbodies.size());
+        {
+            ExclusiveLock lock536(_mutexInterfaces);
+            for (const KinBodyPtr& pbody : vbodies) {
+                if( !pbody ) {
+                    continue;
+                }
+                const int envBodyIndex = pbody->GetEnvironmentBodyIndex();
+                if ( envBodyIndex <= 0 || envBodyIndex > ((int) _vecbodies.size()) - 1 || _vecbodies.at(envBodyIndex) != pbody ) {
+                    continue;
+                }
+                vremovedbodies.push_back(_InvalidateKinBodyFromEnvBodyIndex(envBodyIndex));
+            }
+        }
+        for (const KinBodyPtr& pbody : vremovedbodies) {
+            _CallBodyCallbacks(pbody, 0);
+        }
+        return (int)vremovedbodies.size();
+    }
+
     virtual bool RemoveKinBodyByName(const std::string& name) override
     {
         EnvironmentLock lockenv(GetMutex());
+        EnvironmentWriteLock lockshared(_mutexEnvironmentShared);
         KinBodyPtr pbody;
         {
             ExclusiveLock lock101(_mutexInterfaces);
@@ -1414,6 +1602,10 @@ public:
     virtual bool SetPhysicsEngine(PhysicsEngineBasePtr pengine) override
     {
         EnvironmentLock lockenv(GetMutex());
+        if( !!_pPhysicsRecorder ) {
+            RAVELOG_INFO_FORMAT("env=%s, physics engine changed, stopping the physics recording after %d steps", GetNameId()%_pPhysicsRecorder->GetNumSteps());
+            _pPhysicsRecorder.reset();
+        }
         if( !!_pPhysicsEngine ) {
             _pPhysicsEngine->DestroyEnvironment();
         }
@@ -1431,6 +1623,9 @@ public:
     }
 
     virtual PhysicsEngineBasePtr GetPhysicsEngine() const override {
+        if( !!_pPhysicsRecorder ) {
+            return _pPhysicsRecorder;
+        }
         return _pPhysicsEngine;
     }
 
@@ -1460,6 +1655,7 @@ public:
     virtual bool SetCollisionChecker(CollisionCheckerBasePtr pchecker) override
     {
         EnvironmentLock lockenv(GetMutex());
+        EnvironmentWriteLock lockshared(_mutexEnvironmentShared);
         if( _pCurrentChecker == pchecker ) {
             return true;
         }
@@ -1557,6 +1753,11 @@ public:
         return _pCurrentChecker->CheckCollision(ray,report);
     }
 
+    virtual int CheckCollisionRays(const std::vector<RAY>& vrays, std::vector<CollisionReport>& vreports) override
+    {
+        return _pCurrentChecker->CheckCollisionRays(vrays,vreports);
+    }
+
     virtual bool CheckCollision(const TriMesh& trimesh, KinBodyConstPtr pbody, CollisionReportPtr report) override
     {
         EnvironmentLock lockenv(GetMutex());
@@ -1573,13 +1774,18 @@ public:
 
     virtual void StepSimulation(dReal fTimeStep) override
     {
+        OPENRAVE_TRACE_SCOPE("Environment::StepSimulation");
         EnvironmentLock lockenv(GetMutex());
 
         uint64_t step = (uint64_t)ceil(1000000.0 * (double)fTimeStep);
         fTimeStep = (dReal)((double)step * 0.000001);
 
+        uint64_t vStageUS[SimulationStatistics::Stage_Count] = {0};
+        uint64_t stagestarttime = utils::GetMicroTime();
+
         // call the physics first to get forces
-        _pPhysicsEngine->SimulateStep(fTimeStep);
+        _SimulatePhysicsStep(step);
+        _EndSimulationStage(vStageUS[SimulationStatistics::Stage_Physics], stagestarttime);
 
         // make a copy instead of locking the mutex pointer since will be calling into user functions
         vector<KinBodyPtr> vecbodies;
@@ -1600,35 +1806,215 @@ public:
                 pBody->SimulationStep(fTimeStep);
             }
         }
-        FOREACH(itmodule, listModules) {
-            itmodule->first->SimulationStep(fTimeStep);
+        _EndSimulationStage(vStageUS[SimulationStatistics::Stage_Bodies], stagestarttime);
+        if( !!_pSimulationWorkerPool ) {
+            _ParallelSimulationStep(fTimeStep, listModules, listSensors, vecbodies, vStageUS, stagestarttime);
         }
+        else {
+            FOREACH(itmodule, listModules) {
+                itmodule->first->SimulationStep(fTimeStep);
+            }
+            _EndSimulationStage(vStageUS[SimulationStatistics::Stage_Modules], stagestarttime);
 
-        // simulate the sensors last (ie, they always reflect the most recent bodies
-        FOREACH(itsensor, listSensors) {
-            (*itsensor)->SimulationStep(fTimeStep);
+            // simulate the sensors last (ie, they always reflect the most recent bodies
+            FOREACH(itsensor, listSensors) {
+                (*itsensor)->SimulationStep(fTimeStep);
+            }
+            for (const KinBodyPtr& pBody : vecbodies) {
+                if (!pBody) {
+                    continue;
+                }
+                if( !pBody->IsRobot() ) {
+                    continue;
+                }
+                const RobotBasePtr& probot = RaveInterfaceCast<RobotBase>(pBody);
+                FOREACHC(itsensor, probot->GetAttachedSensors()) {
+                    if( !!(*itsensor)->GetSensor() ) {
+                        (*itsensor)->GetSensor()->SimulationStep(fTimeStep);
+                    }
+                }
+            }
+        }
+        _EndSimulationStage(vStageUS[SimulationStatistics::Stage_Sensors], stagestarttime);
+        _nCurSimTime += step;
+
+        std::lock_guard<std::mutex> lockstatistics(_mutexSimulationStatistics);
+        ++_simulationStatistics.numSteps;
+        for(int istage = 0; istage < SimulationStatistics::Stage_Count; ++istage) {
+            _simulationStatistics.vStageTotalUS[istage] += vStageUS[istage];
+            _simulationStatistics.vStageMaxUS[istage] = std::max(_simulationStatistics.vStageMaxUS[istage], vStageUS[istage]);
+        }
+    }
+
+    /// \brief steps the physics engine, in fixed substeps if _nPhysicsFixedStepUS is set
+    void _SimulatePhysicsStep(uint64_t stepUS)
+    {
+        PhysicsEngineBasePtr pengine = !!_pPhysicsRecorder ? PhysicsEngineBasePtr(_pPhysicsRecorder) : _pPhysicsEngine;
+        if( _nPhysicsFixedStepUS == 0 ) {
+            pengine->SimulateStep((dReal)((double)stepUS * 0.000001));
+            return;
         }
+
+        _nPhysicsAccumulatedUS += stepUS;
+        const dReal fFixedTimeStep = (dReal)((double)_nPhysicsFixedStepUS * 0.000001);
+        int numSubSteps = 0;
+        while( _nPhysicsAccumulatedUS >= _nPhysicsFixedStepUS && numSubSteps < _nPhysicsMaxSubSteps ) {
+            pengine->SimulateStep(fFixedTimeStep);
+            _nPhysicsAccumulatedUS -= _nPhysicsFixedStepUS;
+            ++numSubSteps;
+        }
+        if( _nPhysicsAccumulatedUS >= _nPhysicsFixedStepUS ) {
+            RAVELOG_VERBOSE_FORMAT("env=%s, dropping %dus of physics after %d substeps", GetNameId()%_nPhysicsAccumulatedUS%numSubSteps);
+            _nPhysicsAccumulatedUS %= _nPhysicsFixedStepUS;
+        }
+    }
+
+    virtual void SetPhysicsFixedTimeStep(dReal fFixedTimeStep, int nMaxSubSteps) override
+    {
+        OPENRAVE_ASSERT_OP(fFixedTimeStep,>=,0);
+        OPENRAVE_ASSERT_OP(nMaxSubSteps,>,0);
+        EnvironmentLock lockenv(GetMutex());
+        _nPhysicsFixedStepUS = (uint64_t)ceil(1000000.0 * (double)fFixedTimeStep);
+        _nPhysicsMaxSubSteps = nMaxSubSteps;
+        _nPhysicsAccumulatedUS = 0;
+    }
+
+    virtual void StartPhysicsRecording(const std::string& filename) override
+    {
+        EnvironmentLock lockenv(GetMutex());
+        PhysicsRecorderPtr precorder(new PhysicsRecorder(shared_from_this(), _pPhysicsEngine, filename));
+        // users compare the id of the engine they get back, so the recorder takes the one of the engine it forwards to
+        precorder->__strxmlid = _pPhysicsEngine->GetXMLId();
+        _pPhysicsRecorder = precorder;
+    }
+
+    virtual uint64_t StopPhysicsRecording() override
+    {
+        EnvironmentLock lockenv(GetMutex());
+        if( !_pPhysicsRecorder ) {
+            return 0;
+        }
+        const uint64_t numSteps = _pPhysicsRecorder->GetNumSteps();
+        _pPhysicsRecorder.reset();
+        return numSteps;
+    }
+
+    virtual uint64_t ReplayPhysicsLog(const std::string& filename) override
+    {
+        EnvironmentLock lockenv(GetMutex());
+        uint64_t simulatedTimeUS = 0;
+        const uint64_t numSteps = OpenRAVE::ReplayPhysicsLog(shared_from_this(), _pPhysicsEngine, filename, simulatedTimeUS);
+        _nCurSimTime += simulatedTimeUS;
+        return numSteps;
+    }
+
+    /// \brief steps the modules and then the sensors in the same order as without _pSimulationWorkerPool
+    void _ParallelSimulationStep(dReal fTimeStep, const list< pair<ModuleBasePtr, std::string> >& listModules, const list<SensorBasePtr>& listSensors, const vector<KinBodyPtr>& vecbodies, uint64_t vStageUS[], uint64_t& stagestarttime)
+    {
+        std::vector<ModuleBasePtr> vmodules;
+        vmodules.reserve(listModules.size());
+        for (const pair<ModuleBasePtr, std::string>& module : listModules) {
+            vmodules.push_back(module.first);
+        }
+        _StepSimulationInterfaces(vmodules, fTimeStep);
+        _EndSimulationStage(vStageUS[SimulationStatistics::Stage_Modules], stagestarttime);
+
+        // simulate the sensors last (ie, they always reflect the most recent bodies
+        std::vector<SensorBasePtr> vsensors(listSensors.begin(), listSensors.end());
         for (const KinBodyPtr& pBody : vecbodies) {
-            if (!pBody) {
-                continue;
-            }
-            if( !pBody->IsRobot() ) {
+            if( !pBody || !pBody->IsRobot() ) {
                 continue;
             }
             const RobotBasePtr& probot = RaveInterfaceCast<RobotBase>(pBody);
             FOREACHC(itsensor, probot->GetAttachedSensors()) {
                 if( !!(*itsensor)->GetSensor() ) {
-                    (*itsensor)->GetSensor()->SimulationStep(fTimeStep);
+                    vsensors.push_back((*itsensor)->GetSensor());
                 }
             }
         }
-        _nCurSimTime += step;
+        _StepSimulationInterfaces(vsensors, fTimeStep);
+    }
+
+    /// \brief steps the interfaces in order on this thread, except that consecutive parallel-safe interfaces are stepped together on _pSimulationWorkerPool
+    template <typename T>
+    void _StepSimulationInterfaces(const std::vector<T>& vinterfaces, dReal fTimeStep)
+    {
+        size_t index = 0;
+        while( index < vinterfaces.size() ) {
+            if( !vinterfaces[index]->IsSimulationStepParallelSafe() ) {
+                vinterfaces[index]->SimulationStep(fTimeStep);
+                ++index;
+                continue;
+            }
+            size_t endindex = index + 1;
+            while( endindex < vinterfaces.size() && vinterfaces[endindex]->IsSimulationStepParallelSafe() ) {
+                ++endindex;
+            }
+            _pSimulationWorkerPool->ParallelFor(endindex - index, [&vinterfaces, index, fTimeStep](size_t i) {
+                vinterfaces[index + i]->SimulationStep(fTimeStep);
+            });
+            index = endindex;
+        }
+    }
+
+    virtual void SetParallelSimulationStep(int numThreads) override
+    {
+        EnvironmentLock lockenv(GetMutex());
+        if( numThreads <= 0 ) {
+            _pSimulationWorkerPool.reset();
+        }
+        else if( !_pSimulationWorkerPool || _pSimulationWorkerPool->GetNumThreads() != numThreads-1 ) {
+            // the thread calling StepSimulation is one of the workers
+            _pSimulationWorkerPool.reset(new WorkerPool(numThreads-1));
+        }
+    }
+
+    /// \brief sets the duration of the stage that started at stagestarttime and starts the next stage
+    static inline void _EndSimulationStage(uint64_t& stageduration, uint64_t& stagestarttime)
+    {
+        const uint64_t curtime = utils::GetMicroTime();
+        stageduration = curtime - stagestarttime;
+        stagestarttime = curtime;
+    }
+
+    virtual void SetSimulationThreadOptions(const SimulationThreadOptions& options) override
+    {
+        std::lock_guard<std::mutex> lockstatistics(_mutexSimulationStatistics);
+        _simulationThreadOptions = options;
+        _bSimulationThreadOptionsChanged = true;
+    }
+
+    virtual void GetSimulationStatistics(SimulationStatistics& statistics, bool bReset) override
+    {
+        std::lock_guard<std::mutex> lockstatistics(_mutexSimulationStatistics);
+        statistics = _simulationStatistics;
+        if( bReset ) {
+            _simulationStatistics.Reset();
+        }
     }
 
     virtual EnvironmentMutex& GetMutex() const override {
         return _mutexEnvironment;
     }
 
+    virtual EnvironmentSharedMutex& GetSharedMutex() const override {
+        return _mutexEnvironmentShared;
+    }
+
+    virtual void SetLockProfiling(bool bEnable, int samplingPeriod, bool bReset) override
+    {
+        LockProfiler& profiler = LockProfiler::GetInstance();
+        if( bReset ) {
+            profiler.Reset();
+        }
+        profiler.SetEnabled(bEnable, samplingPeriod);
+    }
+
+    virtual void GetLockProfilingReport(std::ostream& os, int numTopSites) const override
+    {
+        LockProfiler::GetInstance().WriteReport(os, numTopSites);
+    }
+
     virtual void GetBodies(std::vector<KinBodyPtr>& bodies, uint64_t timeout) const override
     {
         TimedSharedLock lock853(_mutexInterfaces, timeout);
@@ -1645,6 +2031,22 @@ public:
         }
     }
 
+    virtual void GetBodiesMatchingPrefix(const std::string& prefix, std::vector<KinBodyPtr>& bodies, uint64_t timeout) const override
+    {
+        TimedSharedLock lock853(_mutexInterfaces, timeout);
+        if (!lock853) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("timeout of %f s failed"),(1e-6*static_cast<double>(timeout)),ORE_Timeout);
+        }
+        bodies.clear();
+        // _mapBodyNameIndex is ordered, so the names with the prefix are contiguous from its lower bound
+        for (string_map<int>::const_iterator it = _mapBodyNameIndex.lower_bound(prefix); it != _mapBodyNameIndex.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+            const KinBodyPtr& pbody = _vecbodies.at(it->second);
+            if (!!pbody) {
+                bodies.push_back(pbody);
+            }
+        }
+    }
+
     virtual void GetRobots(std::vector<RobotBasePtr>& robots, uint64_t timeout) const override
     {
         TimedSharedLock lock186(_mutexInterfaces, timeout);
@@ -1697,49 +2099,70 @@ public:
     virtual void TriangulateScene(TriMesh& trimesh, SelectionOptions options,const std::string& selectname) override
     {
         EnvironmentLock lockenv(GetMutex());
-        ExclusiveLock lock830(_mutexInterfaces);
-        for (KinBodyPtr& pbody : _vecbodies) {
-            if (!pbody) {
-                continue;
+        SharedLock lock830(_mutexInterfaces);
+
+        // the links already cache their collision meshes, so only the transformed copies are made. size the output once for all of them
+        size_t numVertices = trimesh.vertices.size(), numIndices = trimesh.indices.size();
+        for (const KinBodyPtr& pbody : _vecbodies) {
+            if( !!pbody && _IsSelectedForTriangulation(*pbody, options, selectname) ) {
+                for (const KinBody::LinkPtr& plink : pbody->GetLinks()) {
+                    numVertices += plink->GetCollisionData().vertices.size();
+                    numIndices += plink->GetCollisionData().indices.size();
+                }
             }
-            const KinBody& body = *pbody;
-            RobotBasePtr robot;
-            if( body.IsRobot() ) {
-                robot = RaveInterfaceCast<RobotBase>(pbody);
+        }
+        trimesh.vertices.reserve(numVertices);
+        trimesh.indices.reserve(numIndices);
+
+        for (const KinBodyPtr& pbody : _vecbodies) {
+            if( !!pbody && _IsSelectedForTriangulation(*pbody, options, selectname) ) {
+                Triangulate(trimesh, *pbody);
             }
-            switch(options) {
-            case SO_NoRobots:
-                if( !robot ) {
-                    Triangulate(trimesh, body);
-                }
-                break;
+        }
+    }
 
-            case SO_Robots:
-                if( !!robot ) {
-                    Triangulate(trimesh, body);
-                }
-                break;
-            case SO_Everything:
-                Triangulate(trimesh, body);
-                break;
-            case SO_Body:
-                if( body.GetName() == selectname ) {
-                    Triangulate(trimesh, body);
-                }
-                break;
-            case SO_AllExceptBody:
-                if( body.GetName() != selectname ) {
-                    Triangulate(trimesh, body);
+    virtual void TriangulateSceneView(std::vector<TriMeshViewPart>& vparts, SelectionOptions options, const std::string& selectname) override
+    {
+        EnvironmentLock lockenv(GetMutex());
+        SharedLock lock830(_mutexInterfaces);
+        vparts.resize(0);
+        for (const KinBodyPtr& pbody : _vecbodies) {
+            if( !pbody || !_IsSelectedForTriangulation(*pbody, options, selectname) ) {
+                continue;
+            }
+            for (const KinBody::LinkPtr& plink : pbody->GetLinks()) {
+                if( plink->GetCollisionData().indices.empty() ) {
+                    continue;
                 }
-                break;
-//            case SO_BodyList:
-//                if( find(listnames.begin(),listnames.end(),(pbody)->GetName()) != listnames.end() ) {
-//                    Triangulate(trimesh,pbody);
-//                }
+                vparts.push_back(TriMeshViewPart());
+                TriMeshViewPart& part = vparts.back();
+                part.pmesh = boost::shared_ptr<TriMesh const>(plink, &plink->GetCollisionData()); // shares the ownership of the link
+                part.transform = plink->GetTransform();
+                part.bodyIndex = pbody->GetEnvironmentBodyIndex();
+                part.linkIndex = plink->GetIndex();
             }
         }
     }
 
+    /// \brief true if the body is triangulated by TriangulateScene with options and selectname
+    static bool _IsSelectedForTriangulation(const KinBody& body, SelectionOptions options, const std::string& selectname)
+    {
+        switch(options) {
+        case SO_NoRobots:
+            return !body.IsRobot();
+        case SO_Robots:
+            return body.IsRobot();
+        case SO_Everything:
+            return true;
+        case SO_Body:
+            return body.GetName() == selectname;
+        case SO_AllExceptBody:
+            return body.GetName() != selectname;
+        default:
+            return false;
+        }
+    }
+
     virtual void TriangulateScene(TriMesh& trimesh, TriangulateOptions options)
     {
         TriangulateScene(trimesh,options,"");
@@ -2371,6 +2794,7 @@ public:
         }
         Vector vScaleGeometry(1,1,1);
         float ftransparency;
+        bool bCacheMesh = true;
         FOREACHC(itatt,atts) {
             if( itatt->first == "scalegeometry" ) {
                 stringstream ss(itatt->second);
@@ -2379,13 +2803,26 @@ public:
                     vScaleGeometry.z = vScaleGeometry.y = vScaleGeometry.x;
                 }
             }
+            else if( itatt->first == "cachemesh" ) {
+                bCacheMesh = !(_stricmp(itatt->second.c_str(), "false") == 0 || itatt->second=="0");
+            }
         }
         if( !ptrimesh ) {
             ptrimesh.reset(new TriMesh());
         }
+        std::string cacheFilename;
+        if( bCacheMesh && !_homedirectory.empty() ) {
+            cacheFilename = TriMeshCache::GetCacheFilename(_homedirectory + "/meshcache", filedata, vScaleGeometry);
+            if( !cacheFilename.empty() && TriMeshCache::Read(cacheFilename, *ptrimesh, diffuseColor, ambientColor, ftransparency) ) {
+                return ptrimesh;
+            }
+        }
         if( !OpenRAVEXMLParser::CreateTriMeshFromFile(shared_from_this(),filedata, vScaleGeometry, *ptrimesh, diffuseColor, ambientColor, ftransparency) ) {
             ptrimesh.reset();
         }
+        else if( !cacheFilename.empty() ) {
+            TriMeshCache::Write(cacheFilename, *ptrimesh, diffuseColor, ambientColor, ftransparency);
+        }
         return ptrimesh;
     }
 
@@ -2725,81 +3162,97 @@ public:
         return RaveGetDebugLevel();
     }
 
+    /// the published bodies are read from an immutable snapshot without locking, so timeout is ignored
     virtual void GetPublishedBodies(std::vector<KinBody::BodyState>& vbodies, uint64_t timeout)
     {
-        TimedSharedLock lock452(_mutexInterfaces, timeout);
-        if (!lock452) {
-            throw OPENRAVE_EXCEPTION_FORMAT(_("timeout of %f s failed"),(1e-6*static_cast<double>(timeout)),ORE_Timeout);
+        PublishedBodiesSnapshotConstPtr psnapshot = _GetPublishedBodiesSnapshot();
+        if( !psnapshot ) {
+            vbodies.clear();
+            return;
         }
-        vbodies = _vPublishedBodies;
+        vbodies = psnapshot->vbodies;
     }
 
     virtual bool GetPublishedBody(const std::string &name, KinBody::BodyState& bodystate, uint64_t timeout=0)
     {
-        TimedSharedLock lock306(_mutexInterfaces, timeout);
-        if (!lock306) {
-            throw OPENRAVE_EXCEPTION_FORMAT(_("timeout of %f s failed"),(1e-6*static_cast<double>(timeout)),ORE_Timeout);
+        PublishedBodiesSnapshotConstPtr psnapshot = _GetPublishedBodiesSnapshot();
+        if( !psnapshot ) {
+            return false;
         }
-        for ( size_t ibody = 0; ibody < _vPublishedBodies.size(); ++ibody) {
-            if ( _vPublishedBodies[ibody].strname == name) {
-                bodystate = _vPublishedBodies[ibody];
-                return true;
-            }
+        const int ibody = psnapshot->FindBody(name);
+        if( ibody < 0 ) {
+            return false;
         }
-
-        return false;
+        bodystate = psnapshot->vbodies[ibody];
+        return true;
     }
 
     virtual bool GetPublishedBodyJointValues(const std::string& name, std::vector<dReal> &jointValues, uint64_t timeout=0)
     {
-        TimedSharedLock lock118(_mutexInterfaces, timeout);
-        if (!lock118) {
-            throw OPENRAVE_EXCEPTION_FORMAT(_("timeout of %f s failed"),(1e-6*static_cast<double>(timeout)),ORE_Timeout);
+        PublishedBodiesSnapshotConstPtr psnapshot = _GetPublishedBodiesSnapshot();
+        if( !psnapshot ) {
+            return false;
         }
-        for ( size_t ibody = 0; ibody < _vPublishedBodies.size(); ++ibody) {
-            if ( _vPublishedBodies[ibody].strname == name) {
-                jointValues = _vPublishedBodies[ibody].jointvalues;
-                return true;
-            }
+        const int ibody = psnapshot->FindBody(name);
+        if( ibody < 0 ) {
+            return false;
         }
-
-        return false;
+        jointValues = psnapshot->vbodies[ibody].jointvalues;
+        return true;
     }
 
     void GetPublishedBodyTransformsMatchingPrefix(const std::string& prefix, std::vector<std::pair<std::string, Transform> >& nameTransfPairs, uint64_t timeout = 0)
     {
-        TimedSharedLock lock079(_mutexInterfaces, timeout);
-        if (!lock079) {
-            throw OPENRAVE_EXCEPTION_FORMAT(_("timeout of %f s failed"),(1e-6*static_cast<double>(timeout)),ORE_Timeout);
+        nameTransfPairs.resize(0);
+        PublishedBodiesSnapshotConstPtr psnapshot = _GetPublishedBodiesSnapshot();
+        if( !psnapshot ) {
+            return;
         }
 
-        nameTransfPairs.resize(0);
-        if( nameTransfPairs.capacity() < _vPublishedBodies.size() ) {
-            nameTransfPairs.reserve(_vPublishedBodies.size());
+        // the names matching the prefix are contiguous in the sorted index, return them in body order like before
+        std::vector<int>::const_iterator itbegin = psnapshot->LowerBoundName(prefix);
+        std::vector<int>::const_iterator itend = itbegin;
+        while( itend != psnapshot->vSortedNameIndices.end() && psnapshot->vbodies[*itend].strname.compare(0, prefix.size(), prefix) == 0 ) {
+            ++itend;
         }
-        for ( size_t ibody = 0; ibody < _vPublishedBodies.size(); ++ibody) {
-            if ( strncmp(_vPublishedBodies[ibody].strname.c_str(), prefix.c_str(), prefix.size()) == 0 ) {
-                nameTransfPairs.emplace_back(_vPublishedBodies[ibody].strname,  _vPublishedBodies[ibody].vectrans.at(0));
-            }
+        std::vector<int> vMatchingIndices(itbegin, itend);
+        std::sort(vMatchingIndices.begin(), vMatchingIndices.end());
+        nameTransfPairs.reserve(vMatchingIndices.size());
+        for (int ibody : vMatchingIndices) {
+            const KinBody::BodyState& state = psnapshot->vbodies[ibody];
+            nameTransfPairs.emplace_back(state.strname, state.vectrans.at(0));
         }
     }
 
     virtual void UpdatePublishedBodies(uint64_t timeout=0)
     {
         EnvironmentLock lockenv(GetMutex());
-        TimedExclusiveLock lock152(_mutexInterfaces, timeout);
+        // only reading _vecbodies, the snapshot itself is swapped atomically
+        TimedSharedLock lock152(_mutexInterfaces, timeout);
         if (!lock152) {
             throw OPENRAVE_EXCEPTION_FORMAT(_("timeout of %f s failed"),(1e-6*static_cast<double>(timeout)),ORE_Timeout);
         }
         _UpdatePublishedBodies();
     }
 
-    /// assumes GetMutex() and _mutexInterfaces are both exclusively locked
+    /// assumes GetMutex() is exclusively locked and _mutexInterfaces is at least shared locked
     virtual void _UpdatePublishedBodies()
     {
-        // updated the published bodies, resize dynamically in case an exception occurs
-        // when creating an item and bad data is left inside _vPublishedBodies
-        _vPublishedBodies.resize(_GetNumBodies());
+        // fill the back buffer if no reader still holds it, otherwise a new snapshot. the states of the back buffer are two publishes old, they are reused if their body has not changed since
+        PublishedBodiesSnapshotPtr psnapshot;
+        if( !!_pPublishedBodiesBack && _pPublishedBodiesBack.unique() ) {
+            psnapshot.swap(_pPublishedBodiesBack);
+        }
+        else {
+            // start from the current snapshot so that the unchanged states are still reused
+            PublishedBodiesSnapshotConstPtr pcurrent = _GetPublishedBodiesSnapshot();
+            psnapshot.reset(!!pcurrent ? new PublishedBodiesSnapshot(*pcurrent) : new PublishedBodiesSnapshot());
+            _pPublishedBodiesBack.reset();
+        }
+
+        // resize dynamically in case an exception occurs when creating an item and bad data is left inside the snapshot
+        std::vector<KinBody::BodyState>& vbodies = psnapshot->vbodies;
+        vbodies.resize(_GetNumBodies());
         int iwritten = 0;
 
         std::vector<dReal> vdoflastsetvalues;
@@ -2812,7 +3265,7 @@ public:
                 continue;
             }
 
-            KinBody::BodyState& state = _vPublishedBodies.at(iwritten);
+            KinBody::BodyState& state = vbodies.at(iwritten);
 
             // If this state was already inititalized from this body, we might be able to skip updating it if the body itself hasn't changed.
             const bool canSkipUpdate = state.pbody == pbody && state.updatestamp == pbody->GetUpdateStamp();
@@ -2845,11 +3298,84 @@ public:
             ++iwritten;
         }
 
-        if( iwritten < (int)_vPublishedBodies.size() ) {
-            _vPublishedBodies.resize(iwritten);
+        if( iwritten < (int)vbodies.size() ) {
+            vbodies.resize(iwritten);
+        }
+
+        psnapshot->vSortedNameIndices.resize(vbodies.size());
+        for(int ibody = 0; ibody < (int)vbodies.size(); ++ibody) {
+            psnapshot->vSortedNameIndices[ibody] = ibody;
+        }
+        std::sort(psnapshot->vSortedNameIndices.begin(), psnapshot->vSortedNameIndices.end(), [&vbodies](int ibody0, int ibody1) {
+            return vbodies[ibody0].strname < vbodies[ibody1].strname;
+        });
+
+        if( !!_pPublishedBodiesSharedMemory ) {
+            _pPublishedBodiesSharedMemory->Write(psnapshot->vbodies);
+        }
+        _pPublishedBodiesBack = boost::atomic_exchange(&_pPublishedBodies, psnapshot);
+    }
+
+    virtual void SetPublishedBodiesSharedMemory(const std::string& name, uint32_t numSlots, uint64_t slotSize) override
+    {
+        EnvironmentLock lockenv(GetMutex());
+        _pPublishedBodiesSharedMemory.reset();
+        if( name.size() > 0 ) {
+            _pPublishedBodiesSharedMemory.reset(new BodyStateSharedMemory(name, true, numSlots, slotSize));
         }
     }
 
+    virtual int ApplyPublishedBodiesFromSharedMemory(const std::string& name) override
+    {
+        EnvironmentLock lockenv(GetMutex());
+        std::pair<BodyStateSharedMemoryPtr, uint64_t>& reader = _mapPublishedBodiesSharedMemoryReaders[name];
+        if( !!reader.first && reader.first->IsUnlinked() ) {
+            RAVELOG_DEBUG_FORMAT("env=%s, body state shared memory '%s' was replaced, reopening", GetNameId()%name);
+            reader.first.reset();
+            reader.second = 0;
+        }
+        if( !reader.first ) {
+            try {
+                reader.first.reset(new BodyStateSharedMemory(name, false));
+            }
+            catch(...) {
+                _mapPublishedBodiesSharedMemoryReaders.erase(name);
+                throw;
+            }
+        }
+        std::vector<KinBody::BodyState>& vbodies = _vPublishedBodiesSharedMemoryCache;
+        if( !reader.first->Read(vbodies, reader.second) ) {
+            return -1;
+        }
+
+        int numupdated = 0;
+        for (const KinBody::BodyState& state : vbodies) {
+            KinBodyPtr pbody = GetKinBody(state.strname);
+            if( !pbody ) {
+                continue;
+            }
+            if( pbody->GetLinks().size() != state.vectrans.size() ) {
+                RAVELOG_VERBOSE_FORMAT("env=%s, body '%s' has %d links, but shared memory '%s' has %d", GetNameId()%state.strname%pbody->GetLinks().size()%name%state.vectrans.size());
+                continue;
+            }
+            pbody->SetLinkTransformations(state.vectrans, state.jointvalues);
+            ++numupdated;
+        }
+        return numupdated;
+    }
+
+    /// \brief clears the published bodies, the readers holding a snapshot keep it
+    void _ResetPublishedBodies()
+    {
+        boost::atomic_store(&_pPublishedBodies, PublishedBodiesSnapshotPtr());
+        _pPublishedBodiesBack.reset();
+    }
+
+    inline PublishedBodiesSnapshotConstPtr _GetPublishedBodiesSnapshot() const
+    {
+        return boost::atomic_load(&_pPublishedBodies);
+    }
+
     virtual std::pair<std::string, dReal> GetUnit() const
     {
         return std::make_pair(std::string(GetLengthUnitString(_unitInfo.lengthUnit)), 1.0 / GetLengthUnitStandardValue<dReal>(_unitInfo.lengthUnit));
@@ -3449,6 +3975,7 @@ protected:
 
     void _Init()
     {
+        utils::StartupTraceScope tracescope("environment", "Environment::_Init");
         _homedirectory = RaveGetHomeDirectory();
         RAVELOG_DEBUG_FORMAT("env=%s, setting openrave home directory to '%s'", GetNameId()%_homedirectory);
 
@@ -3460,6 +3987,10 @@ protected:
         _nCurSimTime = 0;
         _nSimStartTime = utils::GetMicroTime();
         _bRealTime = true;
+        _nPhysicsFixedStepUS = 0;
+        _nPhysicsMaxSubSteps = 16;
+        _nPhysicsAccumulatedUS = 0;
+        _bSimulationThreadOptionsChanged = false;
         _bInit = false;
         _bEnableSimulation = true;     // need to start by default
         _unitInfo = UnitInfo();
@@ -3533,6 +4064,7 @@ protected:
         pbody.swap(pbodyref); // essentially resets _vecbodies[bodyIndex]
 
         _nBodiesModifiedStamp++;
+        IncrementBodiesUpdateStamp();
         return pbody;
     }
 
@@ -3577,6 +4109,9 @@ protected:
         _nCurSimTime = 0;
         _nSimStartTime = utils::GetMicroTime();
         _bRealTime = r->_bRealTime;
+        _nPhysicsFixedStepUS = r->_nPhysicsFixedStepUS;
+        _nPhysicsMaxSubSteps = r->_nPhysicsMaxSubSteps;
+        _nPhysicsAccumulatedUS = 0;
 
         _description = r->_description;
         _keywords = r->_keywords;
@@ -3609,7 +4144,7 @@ protected:
                 _mapBodyIdIndex.clear();
                 _environmentIndexRecyclePool.clear();
 
-                _vPublishedBodies.clear();
+                _ResetPublishedBodies();
             }
         }
 
@@ -3660,7 +4195,7 @@ protected:
             if( !bCheckSharedResources || (!!_pPhysicsEngine && _pPhysicsEngine->GetXMLId() != r->GetPhysicsEngine()->GetXMLId()) ) {
                 try {
                     PhysicsEngineBasePtr p = RaveCreatePhysicsEngine(shared_from_this(),r->GetPhysicsEngine()->GetXMLId());
-                    p->Clone(r->GetPhysicsEngine(),options);
+                    p->Clone(r->_pPhysicsEngine,options); // not the recorder of r
                     SetPhysicsEngine(p);
                     bPhysicsEngineChanged = true;
                 }
@@ -3807,10 +4342,24 @@ protected:
                 }
             }
 
-            // now clone
+            // now clone. plain bodies only copy their own data, so they are cloned and initialized in parallel and
+            // inserted into the collision checker and physics engine serially below. robots clone their sensors and
+            // controllers through the environment, and bodies with a self collision checker create it, so they stay on this thread.
+            std::vector<KinBodyPtr> vParallelToClone;
+            for (const KinBodyPtr& pbody : listToClone) {
+                if( !pbody->IsRobot() && !pbody->_selfcollisionchecker ) {
+                    vParallelToClone.push_back(pbody);
+                }
+            }
+            if( vParallelToClone.size() < 2 ) {
+                vParallelToClone.clear();
+            }
             for (const KinBodyPtr& pbody : listToClone) {
                 const KinBody& body = *pbody;
                 const int envBodyIndex = body.GetEnvironmentBodyIndex();
+                if( vParallelToClone.size() > 0 && !body.IsRobot() && !body._selfcollisionchecker ) {
+                    continue;
+                }
                 try {
                     KinBodyPtr pnewbody = _vecbodies.at(envBodyIndex);
                     if( !!pnewbody ) {
@@ -3822,12 +4371,40 @@ protected:
                     RAVELOG_ERROR_FORMAT("env=%s, failed to clone body '%s': %s", GetNameId()%body.GetName()%ex.what());
                 }
             }
+            if( vParallelToClone.size() > 0 ) {
+                std::vector<std::exception_ptr> vexceptions(vParallelToClone.size());
+                const int numThreads = std::min((int)vParallelToClone.size(), std::max(1, (int)std::thread::hardware_concurrency()));
+                WorkerPool pool(numThreads - 1);
+                pool.ParallelFor(vParallelToClone.size(), [&](size_t index) {
+                    const KinBody& body = *vParallelToClone[index];
+                    const KinBodyPtr& pnewbody = _vecbodies.at(body.GetEnvironmentBodyIndex());
+                    try {
+                        pnewbody->Clone(vParallelToClone[index], options|Clone_IgnoreGrabbedBodies);
+                    }
+                    catch(const std::exception &ex) {
+                        RAVELOG_ERROR_FORMAT("env=%s, failed to clone body '%s': %s", GetNameId()%body.GetName()%ex.what());
+                    }
+                    try {
+                        pnewbody->_ComputeInternalInformation();
+                    }
+                    catch(...) {
+                        vexceptions[index] = std::current_exception();
+                    }
+                });
+                for (const std::exception_ptr& pexception : vexceptions) {
+                    if( !!pexception ) {
+                        std::rethrow_exception(pexception);
+                    }
+                }
+            }
 
             for (const KinBodyPtr& pbody : listToClone) {
                 const KinBody& body = *pbody;
                 const int envBodyIndex = body.GetEnvironmentBodyIndex();
                 KinBodyPtr pnewbody = _vecbodies.at(envBodyIndex);
-                pnewbody->_ComputeInternalInformation();
+                if( vParallelToClone.empty() || body.IsRobot() || !!body._selfcollisionchecker ) {
+                    pnewbody->_ComputeInternalInformation();
+                }
                 GetCollisionChecker()->InitKinBody(pnewbody);
                 GetPhysicsEngine()->InitKinBody(pnewbody);
                 pnewbody->__hashKinematicsGeometryDynamics = body.__hashKinematicsGeometryDynamics;
@@ -3976,6 +4553,7 @@ protected:
     {
         EnsureVectorSize(_vecbodies, envBodyIndex+1);
         _vecbodies.at(envBodyIndex) = pbody;
+        IncrementBodiesUpdateStamp();
 
         {
             const std::string& name = pbody->GetName();
@@ -4229,37 +4807,47 @@ protected:
         while( _bInit && !_bShutdownSimulation ) {
             bool bNeedSleep = true;
             boost::shared_ptr<EnvironmentLock> lockenv;
+            {
+                std::lock_guard<std::mutex> lockstatistics(_mutexSimulationStatistics);
+                if( _bSimulationThreadOptionsChanged ) {
+                    _bSimulationThreadOptionsChanged = false;
+                    _ApplySimulationThreadOptions(_simulationThreadOptions);
+                }
+            }
             if( _bEnableSimulation ) {
                 bNeedSleep = false;
+                if( _bRealTime ) {
+                    // sleep until the absolute deadline of the next step without holding the environment lock, the deadlines are computed from the start time so the steps do not drift
+                    const int64_t untildeadline = (int64_t)(_nSimStartTime + _nCurSimTime) - (int64_t)utils::GetMicroTime();
+                    if( untildeadline > 0 ) {
+                        std::this_thread::sleep_until(std::chrono::steady_clock::now() + std::chrono::microseconds(untildeadline));
+                        nLastSleptTime = utils::GetMicroTime();
+                    }
+                }
                 lockenv = _LockEnvironmentWithTimeout(100000);
                 if( !!lockenv ) {
                     //Get deltasimtime in microseconds
-                    int64_t deltasimtime = (int64_t)(_fDeltaSimTime*1000000.0f);
+                    const int64_t deltasimtime = (int64_t)(_fDeltaSimTime*1000000.0f);
+                    const int64_t deadline = _nSimStartTime + _nCurSimTime;
+                    const int64_t starttime = utils::GetMicroTime();
                     try {
                         StepSimulation(_fDeltaSimTime);
                     }
                     catch(const std::exception &ex) {
                         RAVELOG_ERROR("simulation thread exception: %s\n",ex.what());
                     }
-                    uint64_t passedtime = utils::GetMicroTime()-_nSimStartTime;
-                    int64_t sleeptime = _nCurSimTime-passedtime;
-                    //Hardcoded tolerance for now
-                    const int tol=2;
                     if( _bRealTime ) {
-                        if(( sleeptime > deltasimtime/tol) &&( sleeptime > 1000) ) {
-                            lockenv.reset();
-                            // sleep for less time since sleep isn't accurate at all and we have a 7ms buffer
-                            int actual_sleep=max((int)sleeptime*6/8,1000);
-                            std::this_thread::sleep_for(std::chrono::microseconds(actual_sleep));
-                            //RAVELOG_INFO("sleeptime ideal %d, actually slept: %d\n",(int)sleeptime,(int)actual_sleep);
-                            nLastSleptTime = utils::GetMicroTime();
-                            //Since already slept this cycle, wait till next time to sleep.
-                            bNeedSleep = false;
-                        }
-                        else if( sleeptime < -deltasimtime/tol && ( sleeptime < -1000) ) {
-                            // simulation is getting late, so catch up (doesn't happen often in light loads)
-                            //RAVELOG_INFO("sim catching up: %d\n",-(int)sleeptime);
-                            _nSimStartTime += -sleeptime;     //deltasimtime;
+                        const int64_t endtime = utils::GetMicroTime();
+                        std::lock_guard<std::mutex> lockstatistics(_mutexSimulationStatistics);
+                        _simulationStatistics.maxLatenessUS = std::max(_simulationStatistics.maxLatenessUS, (uint64_t)std::max(int64_t(0), starttime - deadline));
+                        if( endtime > deadline + deltasimtime ) {
+                            ++_simulationStatistics.numOverruns;
+                            // if more than a full step behind, drop the missed deadlines instead of stepping in a burst
+                            const int64_t behind = endtime - (int64_t)(_nSimStartTime + _nCurSimTime);
+                            if( deltasimtime > 0 && behind > deltasimtime ) {
+                                _simulationStatistics.numSkippedSteps += behind/deltasimtime;
+                                _nSimStartTime += behind;
+                            }
                         }
                     }
                     else {
@@ -4290,6 +4878,10 @@ protected:
                     catch(const std::exception& ex) {
                         RAVELOG_WARN("timeout of UpdatePublishedBodies\n");
                     }
+                    const uint64_t publishtime = utils::GetMicroTime() - nLastUpdateTime;
+                    std::lock_guard<std::mutex> lockstatistics(_mutexSimulationStatistics);
+                    _simulationStatistics.vStageTotalUS[SimulationStatistics::Stage_Publish] += publishtime;
+                    _simulationStatistics.vStageMaxUS[SimulationStatistics::Stage_Publish] = std::max(_simulationStatistics.vStageMaxUS[SimulationStatistics::Stage_Publish], publishtime);
                 }
             }
 
@@ -4301,6 +4893,38 @@ protected:
         }
     }
 
+    /// \brief applies the scheduling options to the calling thread
+    void _ApplySimulationThreadOptions(const SimulationThreadOptions& options)
+    {
+#ifdef __linux__
+        sched_param param;
+        param.sched_priority = options.fifoPriority > 0 ? options.fifoPriority : 0;
+        int ret = pthread_setschedparam(pthread_self(), options.fifoPriority > 0 ? SCHED_FIFO : SCHED_OTHER, &param);
+        if( ret != 0 ) {
+            RAVELOG_WARN_FORMAT("env=%s, failed to set the scheduling of the simulation thread to priority %d: %s", GetNameId()%options.fifoPriority%strerror(ret));
+        }
+
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        if( options.cpu >= 0 ) {
+            CPU_SET(options.cpu, &cpuset);
+        }
+        else {
+            for(int icpu = 0; icpu < (int)std::thread::hardware_concurrency() && icpu < CPU_SETSIZE; ++icpu) {
+                CPU_SET(icpu, &cpuset);
+            }
+        }
+        ret = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+        if( ret != 0 ) {
+            RAVELOG_WARN_FORMAT("env=%s, failed to pin the simulation thread to cpu %d: %s", GetNameId()%options.cpu%strerror(ret));
+        }
+#else
+        if( options.fifoPriority > 0 || options.cpu >= 0 ) {
+            RAVELOG_WARN_FORMAT("env=%s, simulation thread priority and cpu pinning are only supported on linux", GetNameId());
+        }
+#endif
+    }
+
     /// _mutexInterfaces should not be locked
     void _CallBodyCallbacks(KinBodyPtr pbody, int action)
     {
@@ -4390,7 +5014,7 @@ protected:
 
     static bool _IsJSONFile(const std::string& filename)
     {
-        return StringEndsWith(filename, ".json");
+        return StringEndsWith(filename, ".json") || StringEndsWith(filename, ".json.zst");
     }
 
     static bool _IsJSONData(const std::string& data)
@@ -4400,8 +5024,8 @@ protected:
 
     static bool _IsMsgPackFile(const std::string& filename)
     {
-        // .msgpack
-        return StringEndsWith(filename, ".msgpack");
+        // .msgpack, .msgpack.zst
+        return StringEndsWith(filename, ".msgpack") || StringEndsWith(filename, ".msgpack.zst");
     }
 
     static bool _IsMsgPackData(const std::string& data)
@@ -4423,7 +5047,7 @@ protected:
 
     std::vector<KinBodyPtr> _vecbodies;     ///< all objects that are collidable (includes robots) sorted by env body index ascending order. Note that some element can be nullptr, and size of _vecbodies should be kept unchanged when body is removed from env. protected by _mutexInterfaces. [0] should always be kept null since 0 means no assignment.
 
-    string_map<int> _mapBodyNameIndex; /// maps body name to env body index of bodies stored in _vecbodies sorted by name. used to lookup kin body by name. protected by _mutexInterfaces.
+    string_map<int> _mapBodyNameIndex; /// maps body name to env body index of bodies stored in _vecbodies sorted by name. used to lookup kin body by name and name prefix. protected by _mutexInterfaces.
     string_map<int> _mapBodyIdIndex; /// maps body id to env body index of bodies stored in _vecbodies sorted by name. used to lookup kin body by name. protected by _mutexInterfaces
 
     std::set<int> _environmentIndexRecyclePool; ///< body indices which can be reused later, because kin bodies who had these id's previously are already removed from the environment. This is to prevent env id's from growing without bound when kin bodies are removed and added repeatedly. protected by _mutexInterfaces
@@ -4435,24 +5059,38 @@ protected:
     list<ViewerBasePtr> _listViewers;     ///< viewers loaded in the environment. protectred by _mutexInterfaces
 
     dReal _fDeltaSimTime;                    ///< delta time for simulate step
+    SimulationStatistics _simulationStatistics; ///< protected by _mutexSimulationStatistics
+    SimulationThreadOptions _simulationThreadOptions; ///< protected by _mutexSimulationStatistics
+    bool _bSimulationThreadOptionsChanged; ///< if true, the simulation thread has to apply _simulationThreadOptions. protected by _mutexSimulationStatistics
+    std::mutex _mutexSimulationStatistics; ///< only held for short updates, so that the statistics can be read while the environment is locked
+    boost::shared_ptr<WorkerPool> _pSimulationWorkerPool; ///< if set, steps the parallel-safe modules and sensors in StepSimulation. protected by _mutexEnvironment
     uint64_t _nCurSimTime;                        ///< simulation time since the start of the environment
     uint64_t _nSimStartTime;
     int _nBodiesModifiedStamp;     ///< incremented every tiem bodies vector is modified
 
     CollisionCheckerBasePtr _pCurrentChecker;
     PhysicsEngineBasePtr _pPhysicsEngine;
+    PhysicsRecorderPtr _pPhysicsRecorder; ///< if set, forwards to _pPhysicsEngine and logs its inputs, see StartPhysicsRecording
+    uint64_t _nPhysicsFixedStepUS; ///< if > 0, the physics engine is stepped with this step, see SetPhysicsFixedTimeStep
+    int _nPhysicsMaxSubSteps;
+    uint64_t _nPhysicsAccumulatedUS; ///< time requested by StepSimulation not simulated yet by the fixed steps
 
     boost::shared_ptr<std::thread> _threadSimulation;                      ///< main loop for environment simulation
 
     mutable EnvironmentMutex _mutexEnvironment;          ///< protects internal data from multithreading issues
+    mutable EnvironmentSharedMutex _mutexEnvironmentShared; ///< held shared by concurrent read-only users and exclusively when the bodies or the collision checker change, see GetSharedMutex
     mutable std::shared_timed_mutex _mutexInterfaces;     ///< lock when managing interfaces like _listOwnedInterfaces, _listModules as well as _vecbodies and supporting data such as _mapBodyNameIndex, _mapBodyIdIndex and _environmentIndexRecyclePool
 
-    using ExclusiveLock = std::lock_guard< std::shared_timed_mutex >;
-    using SharedLock = std::shared_lock< std::shared_timed_mutex >;
+    using ExclusiveLock = ProfiledExclusiveLock;
+    using SharedLock = ProfiledSharedLock;
 
     mutable std::mutex _mutexInit;     ///< lock for destroying the environment
 
-    vector<KinBody::BodyState> _vPublishedBodies; ///< protected by _mutexInterfaces
+    PublishedBodiesSnapshotPtr _pPublishedBodies; ///< published snapshot, never modified once published. only accessed with boost::atomic_load/atomic_store/atomic_exchange so readers never wait for the publishing thread
+    PublishedBodiesSnapshotPtr _pPublishedBodiesBack; ///< previously published snapshot, reused as the next snapshot when no reader holds it anymore. only accessed by the publishing thread
+    BodyStateSharedMemoryPtr _pPublishedBodiesSharedMemory; ///< if set, every published snapshot is also written into it. protected by GetMutex()
+    std::map<std::string, std::pair<BodyStateSharedMemoryPtr, uint64_t> > _mapPublishedBodiesSharedMemoryReaders; ///< opened shared memories and the count of their last applied snapshot. protected by GetMutex()
+    std::vector<KinBody::BodyState> _vPublishedBodiesSharedMemoryCache; ///< cache
     string _homedirectory;
     std::pair<std::string, dReal> _unit; ///< unit name mm, cm, inches, m and the conversion for meters
     UnitInfo _unitInfo; ///< unitInfo that describes length unit, mass unit, time unit and angle unit
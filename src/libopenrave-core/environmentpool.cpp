@@ -0,0 +1,331 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2012 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "ravep.h"
+#include "openrave-core.h"
+#include "workerpool.h"
+
+#include <chrono>
+#include <set>
+
+namespace OpenRAVE {
+
+EnvironmentPool::EnvironmentPool(EnvironmentBasePtr pmaster, int numEnvironments, int cloningoptions, ThreadAffinityPolicy placement) : _pmaster(pmaster)
+{
+    if( !(cloningoptions & Clone_Bodies) ) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("env=%s, the clones of an environment pool have to be cloned with Clone_Bodies"), pmaster->GetNameId(), ORE_InvalidArguments);
+    }
+    if( placement != TAP_None && NumaTopology::Get().GetNumNodes() > 1 ) {
+        _CreateNodeLocalClones(numEnvironments, cloningoptions, placement);
+        return;
+    }
+
+    // hold the master so that the clones and the first snapshot see the same state
+    EnvironmentLock lockmaster(_pmaster->GetMutex());
+    SnapshotConstPtr snapshot = _UpdateSnapshot();
+    _vpooled.resize(numEnvironments);
+    for(int ienv = 0; ienv < numEnvironments; ++ienv) {
+        PooledEnvironmentPtr pooled(new PooledEnvironment());
+        pooled->penv = _pmaster->CloneSelf(str(boost::format("%s_pool%d")%_pmaster->GetName()%ienv), cloningoptions);
+        pooled->generation = snapshot->generation;
+        _GetBodyStamps(pooled->penv, pooled->vbodystamps);
+        _vpooled[ienv] = pooled;
+        _listIdle.push_back(pooled);
+    }
+    _statistics.numEnvironments = numEnvironments;
+    _statistics.vNodeStatistics.resize(1);
+    _statistics.vNodeStatistics[0].numEnvironments = numEnvironments;
+}
+
+void EnvironmentPool::_CreateNodeLocalClones(int numEnvironments, int cloningoptions, ThreadAffinityPolicy placement)
+{
+    const NumaTopology& topology = NumaTopology::Get();
+    _bNodeLocal = true;
+    _statistics.numEnvironments = numEnvironments;
+    _statistics.vNodeStatistics.resize(topology.GetNumNodes());
+    _vpooled.resize(numEnvironments);
+    for(int ienv = 0; ienv < numEnvironments; ++ienv) {
+        _vpooled[ienv].reset(new PooledEnvironment());
+        _vpooled[ienv]->node = topology.GetPlacementNode(placement, ienv, numEnvironments);
+        ++_statistics.vNodeStatistics[_vpooled[ienv]->node].numEnvironments;
+    }
+
+    // CloneSelf locks the master, so it is not held here and the clones may see different states of the master.
+    // generation 0 is older than any snapshot, so every clone is synchronized at its first lease.
+    std::vector<std::exception_ptr> vexceptions(numEnvironments);
+    std::vector<std::thread> vthreads;
+    vthreads.reserve(numEnvironments);
+    for(int ienv = 0; ienv < numEnvironments; ++ienv) {
+        vthreads.emplace_back([this, &topology, &vexceptions, ienv, cloningoptions]() {
+            PooledEnvironment& pooled = *_vpooled[ienv];
+            if( !topology.BindCurrentThread(pooled.node) ) {
+                RAVELOG_WARN_FORMAT("env=%s, failed to bind the thread creating clone %d to numa node %d", _pmaster->GetNameId()%ienv%pooled.node);
+            }
+            try {
+                pooled.penv = _pmaster->CloneSelf(str(boost::format("%s_pool%d")%_pmaster->GetName()%ienv), cloningoptions);
+                _GetBodyStamps(pooled.penv, pooled.vbodystamps);
+            }
+            catch(...) {
+                vexceptions[ienv] = std::current_exception();
+            }
+        });
+    }
+    for (std::thread& thread : vthreads) {
+        thread.join();
+    }
+    for(int ienv = 0; ienv < numEnvironments; ++ienv) {
+        if( !!vexceptions[ienv] ) {
+            for (PooledEnvironmentPtr& pooled : _vpooled) {
+                if( !!pooled->penv ) {
+                    pooled->penv->Destroy();
+                }
+            }
+            std::rethrow_exception(vexceptions[ienv]);
+        }
+    }
+    _listIdle.assign(_vpooled.begin(), _vpooled.end());
+}
+
+EnvironmentPool::~EnvironmentPool()
+{
+    // the leased clones are destroyed when they are released
+    for (PooledEnvironmentPtr& pooled : _listIdle) {
+        pooled->penv->Destroy();
+    }
+}
+
+EnvironmentBasePtr EnvironmentPool::Lease(double timeout)
+{
+    PooledEnvironmentPtr pooled;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if( _listIdle.empty() ) {
+            ++_statistics.numWaits;
+            if( timeout < 0 ) {
+                _condReturned.wait(lock, [this]() {
+                    return !_listIdle.empty();
+                });
+            }
+            else if( !_condReturned.wait_for(lock, std::chrono::duration<double>(timeout), [this]() {
+                return !_listIdle.empty();
+            }) ) {
+                return EnvironmentBasePtr();
+            }
+        }
+        std::list<PooledEnvironmentPtr>::iterator itidle = _listIdle.begin();
+        if( _bNodeLocal ) {
+            const int node = NumaTopology::Get().GetCurrentNode();
+            itidle = std::find_if(_listIdle.begin(), _listIdle.end(), [node](const PooledEnvironmentPtr& pidle) {
+                return pidle->node == node;
+            });
+            if( itidle == _listIdle.end() ) {
+                itidle = _listIdle.begin();
+                ++_statistics.vNodeStatistics.at((*itidle)->node).numRemoteLeases;
+            }
+        }
+        pooled = *itidle;
+        _listIdle.erase(itidle);
+        ++_statistics.numLeases;
+        ++_statistics.numLeased;
+        ++_statistics.vNodeStatistics.at(pooled->node).numLeases;
+        ++_statistics.vNodeStatistics.at(pooled->node).numLeased;
+    }
+
+    try {
+        SnapshotConstPtr snapshot = _UpdateSnapshot();
+        _SyncEnvironment(*pooled, *snapshot);
+    }
+    catch(...) {
+        _Return(pooled);
+        throw;
+    }
+
+    // the returned pointer shares the clone, the deleter only gives it back to the pool
+    boost::weak_ptr<EnvironmentPool> poolweak = shared_from_this();
+    return EnvironmentBasePtr(pooled->penv.get(), [poolweak, pooled](EnvironmentBase*) {
+        EnvironmentPoolPtr pool = poolweak.lock();
+        if( !!pool ) {
+            pool->_Return(pooled);
+        }
+        else {
+            pooled->penv->Destroy();
+        }
+    });
+}
+
+void EnvironmentPool::Invalidate()
+{
+    std::lock_guard<std::mutex> lock(_mutexSnapshot);
+    _bInvalidated = true;
+}
+
+EnvironmentPool::Statistics EnvironmentPool::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _statistics;
+}
+
+void EnvironmentPool::ResetStatistics()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Statistics statistics;
+    statistics.numEnvironments = _statistics.numEnvironments;
+    statistics.numLeased = _statistics.numLeased;
+    statistics.vNodeStatistics.resize(_statistics.vNodeStatistics.size());
+    for(size_t node = 0; node < statistics.vNodeStatistics.size(); ++node) {
+        statistics.vNodeStatistics[node].numEnvironments = _statistics.vNodeStatistics[node].numEnvironments;
+        statistics.vNodeStatistics[node].numLeased = _statistics.vNodeStatistics[node].numLeased;
+    }
+    _statistics = statistics;
+}
+
+EnvironmentPool::SnapshotConstPtr EnvironmentPool::_UpdateSnapshot()
+{
+    std::lock_guard<std::mutex> lock(_mutexSnapshot);
+    const uint64_t starttime = utils::GetMicroTime();
+    EnvironmentLock lockmaster(_pmaster->GetMutex());
+    std::vector<KinBodyPtr> vbodies;
+    _pmaster->GetBodies(vbodies);
+
+    // bodies are matched to the previous snapshot by pointer, the infos of the ones with the same update stamp are reused
+    std::map<KinBody*, int> mapPreviousIndices;
+    if( !!_snapshot && !_bInvalidated ) {
+        for(int ibody = 0; ibody < (int)_snapshot->vbodies.size(); ++ibody) {
+            KinBodyPtr pbody = _snapshot->vbodies[ibody].lock();
+            if( !!pbody ) {
+                mapPreviousIndices[pbody.get()] = ibody;
+            }
+        }
+    }
+
+    boost::shared_ptr<Snapshot> snapshot(new Snapshot());
+    bool bChanged = !_snapshot || _bInvalidated || vbodies.size() != _snapshot->vbodies.size();
+    snapshot->info._vBodyInfos.resize(vbodies.size());
+    snapshot->vbodies.resize(vbodies.size());
+    snapshot->vbodystamps.resize(vbodies.size());
+    for(size_t ibody = 0; ibody < vbodies.size(); ++ibody) {
+        const KinBodyPtr& pbody = vbodies[ibody];
+        snapshot->vbodies[ibody] = pbody;
+        snapshot->vbodystamps[ibody] = pbody->GetUpdateStamp();
+        std::map<KinBody*, int>::const_iterator itprevious = mapPreviousIndices.find(pbody.get());
+        if( itprevious != mapPreviousIndices.end() && _snapshot->vbodystamps[itprevious->second] == pbody->GetUpdateStamp() ) {
+            snapshot->info._vBodyInfos[ibody] = _snapshot->info._vBodyInfos[itprevious->second];
+            bChanged |= itprevious->second != (int)ibody;
+            continue;
+        }
+        KinBody::KinBodyInfoPtr& pinfo = snapshot->info._vBodyInfos[ibody];
+        if( pbody->IsRobot() ) {
+            RobotBase::RobotBaseInfoPtr probotinfo(new RobotBase::RobotBaseInfo());
+            RaveInterfaceCast<RobotBase>(pbody)->ExtractInfo(*probotinfo, EIO_Everything);
+            pinfo = probotinfo;
+        }
+        else {
+            pinfo.reset(new KinBody::KinBodyInfo());
+            pbody->ExtractInfo(*pinfo, EIO_Everything);
+        }
+        bChanged = true;
+    }
+    snapshot->info._keywords = _pmaster->GetKeywords();
+    snapshot->info._description = _pmaster->GetDescription();
+    if( !!_pmaster->GetPhysicsEngine() ) {
+        snapshot->info._gravity = _pmaster->GetPhysicsEngine()->GetGravity();
+    }
+    if( !bChanged ) {
+        const EnvironmentBase::EnvironmentBaseInfo& previousinfo = _snapshot->info;
+        bChanged = snapshot->info._keywords != previousinfo._keywords || snapshot->info._description != previousinfo._description || snapshot->info._gravity != previousinfo._gravity;
+    }
+    if( !bChanged ) {
+        return _snapshot;
+    }
+
+    snapshot->generation = !_snapshot ? 1 : _snapshot->generation + 1;
+    _snapshot = snapshot;
+    _bInvalidated = false;
+
+    const uint64_t elapsedus = utils::GetMicroTime() - starttime;
+    std::lock_guard<std::mutex> lockstatistics(_mutex);
+    ++_statistics.numSnapshots;
+    _statistics.snapshotus += elapsedus;
+    _statistics.maxsnapshotus = std::max(_statistics.maxsnapshotus, elapsedus);
+    return _snapshot;
+}
+
+void EnvironmentPool::_SyncEnvironment(PooledEnvironment& pooled, const Snapshot& snapshot)
+{
+    std::vector<int> vbodystamps;
+    _GetBodyStamps(pooled.penv, vbodystamps);
+    if( pooled.generation == snapshot.generation && vbodystamps == pooled.vbodystamps ) {
+        return;
+    }
+
+    const uint64_t starttime = utils::GetMicroTime();
+    {
+        EnvironmentLock lockenv(pooled.penv->GetMutex());
+        // UFIM_OnlySpecifiedBodiesExact does not remove the bodies that are not in the info
+        std::set<std::string> setBodyIds;
+        for (const KinBody::KinBodyInfoPtr& pinfo : snapshot.info._vBodyInfos) {
+            setBodyIds.insert(pinfo->_id);
+        }
+        std::vector<KinBodyPtr> vbodies;
+        pooled.penv->GetBodies(vbodies);
+        for (KinBodyPtr& pbody : vbodies) {
+            if( setBodyIds.count(pbody->GetId()) == 0 ) {
+                pooled.penv->Remove(pbody);
+            }
+        }
+
+        // the environment fields are set one by one so that the uint64 parameters of the clone are kept
+        pooled.penv->SetKeywords(snapshot.info._keywords);
+        pooled.penv->SetDescription(snapshot.info._description);
+        if( !!pooled.penv->GetPhysicsEngine() ) {
+            pooled.penv->GetPhysicsEngine()->SetGravity(snapshot.info._gravity);
+        }
+        std::vector<KinBodyPtr> vCreatedBodies, vModifiedBodies, vRemovedBodies;
+        pooled.penv->UpdateFromInfo(snapshot.info, vCreatedBodies, vModifiedBodies, vRemovedBodies, UFIM_OnlySpecifiedBodiesExact);
+        pooled.generation = snapshot.generation;
+        _GetBodyStamps(pooled.penv, pooled.vbodystamps);
+    }
+
+    const uint64_t elapsedus = utils::GetMicroTime() - starttime;
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_statistics.numSyncs;
+    _statistics.syncus += elapsedus;
+    _statistics.maxsyncus = std::max(_statistics.maxsyncus, elapsedus);
+}
+
+void EnvironmentPool::_Return(PooledEnvironmentPtr pooled)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _listIdle.push_back(pooled);
+        --_statistics.numLeased;
+        --_statistics.vNodeStatistics.at(pooled->node).numLeased;
+    }
+    _condReturned.notify_one();
+}
+
+void EnvironmentPool::_GetBodyStamps(EnvironmentBasePtr penv, std::vector<int>& vbodystamps)
+{
+    std::vector<KinBodyPtr> vbodies;
+    penv->GetBodies(vbodies);
+    vbodystamps.resize(2*vbodies.size());
+    for(size_t ibody = 0; ibody < vbodies.size(); ++ibody) {
+        vbodystamps[2*ibody] = vbodies[ibody]->GetEnvironmentBodyIndex();
+        vbodystamps[2*ibody+1] = vbodies[ibody]->GetUpdateStamp();
+    }
+}
+
+} // end namespace OpenRAVE
@@ -20,6 +20,13 @@
 #include <boost/lexical_cast.hpp>
 #include <openrave/xmlreaders.h>
 
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#ifdef OPENRAVE_HAS_ZLIB
+#include <zlib.h>
+#endif
+
 using namespace boost::placeholders;
 
 namespace OpenRAVE {
@@ -27,6 +34,22 @@ namespace OpenRAVE {
 // To distinguish between binary and XML trajectory files
 static const uint16_t BINARY_TRAJECTORY_MAGIC_NUMBER = 0x62ff;
 static const uint16_t BINARY_TRAJECTORY_VERSION_NUMBER = 0x0003;  // Version number for serialization
+static const uint16_t BINARY_TRAJECTORY_MAPPABLE_VERSION_NUMBER = 0x0004;  // Version number written with TSO_SerializeMappable
+static const uint16_t BINARY_TRAJECTORY_COMPRESSED_VERSION_NUMBER = 0x0005;  // Version number written with TSO_SerializeCompressed
+
+/// \brief how the waypoints of a version 0x0005 binary trajectory are compressed
+enum TrajectoryCompressionMethod
+{
+    TCM_None = 0,
+    TCM_Zlib = 1,
+};
+
+/// \brief how a single dof of the waypoints of a version 0x0005 binary trajectory is encoded
+enum TrajectoryColumnEncoding
+{
+    TCE_Raw = 0, ///< the dReal values
+    TCE_Quantized = 1, ///< zigzag varint deltas between the values rounded to multiples of the tolerance
+};
 
 static const dReal g_fEpsilonLinear = RavePow(g_fEpsilon,0.9);
 static const dReal g_fEpsilonQuadratic = RavePow(g_fEpsilon,0.45); // should be 0.6...perhaps this is related to parabolic smoother epsilons?
@@ -47,6 +70,11 @@ inline void WriteBinaryInt(std::ostream& f, int value)
     f.write((const char*) &value, sizeof(value));
 }
 
+inline void WriteBinaryUInt64(std::ostream& f, uint64_t value)
+{
+    f.write((const char*) &value, sizeof(value));
+}
+
 inline void WriteBinaryString(std::ostream& f, const std::string& s)
 {
     BOOST_ASSERT(s.length() <= std::numeric_limits<uint16_t>::max());
@@ -58,15 +86,23 @@ inline void WriteBinaryString(std::ostream& f, const std::string& s)
     }
 }
 
-inline void WriteBinaryVector(std::ostream&f, const std::vector<dReal>& v)
+inline void WriteBinaryData(std::ostream&f, const dReal* pdata, size_t numDataPoints)
 {
-    // Indicate number of data points
-    const uint32_t numDataPoints = v.size();
-    WriteBinaryUInt32(f, numDataPoints);
+    f.write((const char*) pdata, numDataPoints*sizeof(dReal));
+}
 
-    // Write vector memory block to binary file
-    const uint64_t vectorLengthBytes = numDataPoints*sizeof(dReal);
-    f.write((const char*) &v[0], vectorLengthBytes);
+inline void WriteBinaryDouble(std::ostream& f, double value)
+{
+    f.write((const char*) &value, sizeof(value));
+}
+
+inline void WriteVarUInt64(std::vector<uint8_t>& v, uint64_t value)
+{
+    while( value >= 0x80 ) {
+        v.push_back((uint8_t)(value|0x80));
+        value >>= 7;
+    }
+    v.push_back((uint8_t)value);
 }
 
 /* Helper functions for binary trajectory file reading */
@@ -84,12 +120,24 @@ inline bool ReadBinaryUInt32(std::istream& f, uint32_t& value)
     return !!f;
 }
 
+inline bool ReadBinaryUInt64(std::istream& f, uint64_t& value)
+{
+    f.read((char*) &value, sizeof(value));
+    return !!f;
+}
+
 inline bool ReadBinaryInt(std::istream& f, int& value)
 {
     f.read((char*) &value, sizeof(value));
     return !!f;
 }
 
+inline bool ReadBinaryDouble(std::istream& f, double& value)
+{
+    f.read((char*) &value, sizeof(value));
+    return !!f;
+}
+
 inline bool ReadBinaryString(std::istream& f, std::string& s)
 {
     uint16_t length = 0;
@@ -133,12 +181,38 @@ inline void ReadBinaryUInt32(const uint8_t*& f, uint32_t& value)
     f += sizeof(uint32_t);
 }
 
+inline void ReadBinaryUInt64(const uint8_t*& f, uint64_t& value)
+{
+    value = *(uint64_t*)f;
+    f += sizeof(uint64_t);
+}
+
 inline void ReadBinaryInt(const uint8_t*& f, int& value)
 {
     value = *(int*)f;
     f += sizeof(int);
 }
 
+inline void ReadBinaryDouble(const uint8_t*& f, double& value)
+{
+    std::memcpy(&value, f, sizeof(value));
+    f += sizeof(value);
+}
+
+/// \return false if the value does not end before pend
+inline bool ReadVarUInt64(const uint8_t*& f, const uint8_t* pend, uint64_t& value)
+{
+    value = 0;
+    for(int shift = 0; shift < 64 && f < pend; shift += 7) {
+        const uint8_t byte = *f++;
+        value |= (uint64_t)(byte&0x7f) << shift;
+        if( !(byte&0x80) ) {
+            return true;
+        }
+    }
+    return false;
+}
+
 inline void ReadBinaryString(const uint8_t*& f, std::string& s)
 {
     uint16_t length = 0;
@@ -167,12 +241,96 @@ inline void ReadBinaryVector(const uint8_t*& f, std::vector<dReal>& v)
     f += vectorLengthBytes;
 }
 
+/// \brief read-only view of contiguous dReal values that are either owned by a std::vector or live inside a memory-mapped trajectory file
+class TrajectoryDataView
+{
+public:
+    typedef const dReal* const_iterator;
+
+    TrajectoryDataView() : _pdata(NULL), _size(0) {
+    }
+
+    void Set(const std::vector<dReal>& v) {
+        _pdata = v.size() > 0 ? &v[0] : NULL;
+        _size = v.size();
+    }
+    void Set(const dReal* pdata, size_t size) {
+        _pdata = pdata;
+        _size = size;
+    }
+
+    inline size_t size() const {
+        return _size;
+    }
+    inline bool empty() const {
+        return _size == 0;
+    }
+    inline const_iterator begin() const {
+        return _pdata;
+    }
+    inline const_iterator end() const {
+        return _pdata+_size;
+    }
+    inline const_iterator cbegin() const {
+        return _pdata;
+    }
+    inline const_iterator cend() const {
+        return _pdata+_size;
+    }
+    inline const dReal& operator[](size_t i) const {
+        return _pdata[i];
+    }
+    inline const dReal& at(size_t i) const {
+        if( i >= _size ) {
+            throw std::out_of_range("TrajectoryDataView::at");
+        }
+        return _pdata[i];
+    }
+    inline const dReal& back() const {
+        return _pdata[_size-1];
+    }
+
+private:
+    const dReal* _pdata;
+    size_t _size;
+};
+
+/// \brief read-only memory mapping of a trajectory file
+class MappedTrajectoryFile
+{
+public:
+    MappedTrajectoryFile(const std::string& filename)
+    {
+        try {
+            boost::interprocess::file_mapping mapping(filename.c_str(), boost::interprocess::read_only);
+            boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+            _region.swap(region);
+        }
+        catch(const boost::interprocess::interprocess_exception& ex) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("failed to memory map trajectory file %s: %s"), filename%ex.what(), ORE_InvalidArguments);
+        }
+    }
+
+    const uint8_t* GetData() const {
+        return static_cast<const uint8_t*>(_region.get_address());
+    }
+    size_t GetSize() const {
+        return _region.get_size();
+    }
+
+private:
+    boost::interprocess::mapped_region _region; ///< the region stays valid after the file_mapping is closed
+};
+typedef boost::shared_ptr<MappedTrajectoryFile> MappedTrajectoryFilePtr;
+
 class GenericTrajectory : public TrajectoryBase
 {
     std::map<string,int> _maporder;
 public:
-    GenericTrajectory(EnvironmentBasePtr penv, std::istream& sinput) : TrajectoryBase(penv), _timeoffset(-1)
+    GenericTrajectory(EnvironmentBasePtr penv, std::istream& sinput) : TrajectoryBase(penv), _timeoffset(-1), _ptrajdata(new std::vector<dReal>()), _fCompressionTolerance(0)
     {
+        RegisterCommand("SetCompressionTolerance",boost::bind(&GenericTrajectory::_SetCompressionToleranceCommand,this,_1,_2),
+                        "Sets the tolerance the waypoints are quantized to when serializing with TSO_SerializeCompressed. 0 (default) keeps the values exact. The deltatime group is always kept exact.");
         _maporder["deltatime"] = 0;
         _maporder["joint_snaps"] = 1;
         _maporder["affine_snaps"] = 2;
@@ -187,6 +345,7 @@ public:
         _maporder["joint_torques"] = 11;
         _bInit = false;
         _bSamplingVerified = false;
+        _bDataHashValid = false;
     }
 
     bool SortGroups(const ConfigurationSpecification::Group& g1, const ConfigurationSpecification::Group& g2)
@@ -226,6 +385,7 @@ public:
             //BOOST_ASSERT(spec.GetDOF()>0 && spec.IsValid()); // when deserializing, can sometimes get invalid spec, but that's ok
             _bInit = false;
             _vgroupinterpolators.resize(0);
+            _vgrouppolynomials.resize(0);
             _vgroupvalidators.resize(0);
             _vderivoffsets.resize(0);
             _vddoffsets.resize(0);
@@ -243,19 +403,22 @@ public:
             }
             _InitializeGroupFunctions();
         }
-        _vtrajdata.clear();
+        _pmappedfile.reset();
+        _ClearTrajData();
         _vaccumtime.clear();
         _vdeltainvtime.clear();
         _bChanged = true;
         _bSamplingVerified = false;
+        _bDataHashValid = false;
         // reserve
         if( nWayPointsToReserve > 0 ) {
-            _vtrajdata.reserve(nWayPointsToReserve*_spec.GetDOF()); // see also GetNumWaypoints API.
+            _ptrajdata->reserve(nWayPointsToReserve*_spec.GetDOF()); // see also GetNumWaypoints API.
             if( options & TIO_ReserveTimeBasedVectors ) { // only if this option is specified, reserve the time-related vectors, since these are only necessary when the Sample-related APIs are called. If such APIs are not called, the user might want to skip the unnecessary memory allocation.
                 _vaccumtime.reserve(nWayPointsToReserve);
                 _vdeltainvtime.reserve(nWayPointsToReserve);
             }
         }
+        _UpdateDataViews();
         // finally set init flag
         _bInit = true;
     }
@@ -263,10 +426,13 @@ public:
     void ClearWaypoints() override
     {
         if( _bInit ) {
-            if( _vtrajdata.size() > 0 ) {
+            if( _trajdata.size() > 0 ) {
+                _pmappedfile.reset();
                 _bSamplingVerified = false;
                 _bChanged = true;
-                _vtrajdata.clear();
+                _bDataHashValid = false;
+                _ClearTrajData();
+                _UpdateDataViews();
             }
         }
     }
@@ -285,18 +451,21 @@ public:
         }
         BOOST_ASSERT(_spec.GetDOF()>0);
         OPENRAVE_ASSERT_FORMAT((nDataElements%_spec.GetDOF()) == 0, "%d does not divide dof %d", nDataElements%_spec.GetDOF(), ORE_InvalidArguments);
-        OPENRAVE_ASSERT_OP(index*_spec.GetDOF(),<=,_vtrajdata.size());
-        if( bOverwrite && index*_spec.GetDOF() < _vtrajdata.size() ) {
-            const size_t copysize = min(nDataElements, _vtrajdata.size()-index*_spec.GetDOF());
-            std::copy(pdata, pdata+copysize, _vtrajdata.begin()+index*_spec.GetDOF());
+        std::vector<dReal>& vtrajdata = _GetWritableTrajData();
+        OPENRAVE_ASSERT_OP(index*_spec.GetDOF(),<=,vtrajdata.size());
+        if( bOverwrite && index*_spec.GetDOF() < vtrajdata.size() ) {
+            const size_t copysize = min(nDataElements, vtrajdata.size()-index*_spec.GetDOF());
+            std::copy(pdata, pdata+copysize, vtrajdata.begin()+index*_spec.GetDOF());
             if( copysize < nDataElements ) {
-                _vtrajdata.insert(_vtrajdata.end(), pdata+copysize, pdata+nDataElements);
+                vtrajdata.insert(vtrajdata.end(), pdata+copysize, pdata+nDataElements);
             }
         }
         else {
-            _vtrajdata.insert(_vtrajdata.begin()+index*_spec.GetDOF(), pdata, pdata+nDataElements);
+            vtrajdata.insert(vtrajdata.begin()+index*_spec.GetDOF(), pdata, pdata+nDataElements);
         }
         _bChanged = true;
+        _bDataHashValid = false;
+        _UpdateDataViews();
     }
 
     void Insert(size_t index, const std::vector<dReal>& data, const ConfigurationSpecification& spec, bool bOverwrite) override
@@ -312,7 +481,8 @@ public:
         }
         BOOST_ASSERT(spec.GetDOF()>0);
         OPENRAVE_ASSERT_FORMAT((nDataElements%spec.GetDOF()) == 0, "%d does not divide dof %d", nDataElements%spec.GetDOF(), ORE_InvalidArguments);
-        OPENRAVE_ASSERT_OP(index*_spec.GetDOF(),<=,_vtrajdata.size());
+        std::vector<dReal>& vtrajdata = _GetWritableTrajData();
+        OPENRAVE_ASSERT_OP(index*_spec.GetDOF(),<=,vtrajdata.size());
         if( _spec == spec ) {
             Insert(index, pdata, nDataElements, bOverwrite);
         }
@@ -324,9 +494,9 @@ public:
             size_t numpoints = nDataElements/spec.GetDOF();
             size_t sourceindex = 0;
             std::vector<dReal>::iterator ittargetdata;
-            if( bOverwrite && index*_spec.GetDOF() < _vtrajdata.size() ) {
-                size_t copyelements = min(numpoints,_vtrajdata.size()/_spec.GetDOF()-index);
-                ittargetdata = _vtrajdata.begin()+index*_spec.GetDOF();
+            if( bOverwrite && index*_spec.GetDOF() < vtrajdata.size() ) {
+                size_t copyelements = min(numpoints,vtrajdata.size()/_spec.GetDOF()-index);
+                ittargetdata = vtrajdata.begin()+index*_spec.GetDOF();
                 _ConvertData(ittargetdata, pdata, vconvertgroups, spec, copyelements, false);
                 sourceindex = copyelements*spec.GetDOF();
                 index += copyelements;
@@ -336,9 +506,11 @@ public:
                 std::vector<dReal> vtemp(numelements*_spec.GetDOF());
                 ittargetdata = vtemp.begin();
                 _ConvertData(ittargetdata, pdata+sourceindex, vconvertgroups, spec, numelements, true);
-                _vtrajdata.insert(_vtrajdata.begin()+index*_spec.GetDOF(),vtemp.begin(),vtemp.end());
+                vtrajdata.insert(vtrajdata.begin()+index*_spec.GetDOF(),vtemp.begin(),vtemp.end());
             }
             _bChanged = true;
+            _bDataHashValid = false;
+            _UpdateDataViews();
         }
     }
 
@@ -348,10 +520,13 @@ public:
         if( startindex == endindex ) {
             return;
         }
-        BOOST_ASSERT(startindex*_spec.GetDOF() <= _vtrajdata.size() && endindex*_spec.GetDOF() <= _vtrajdata.size());
+        std::vector<dReal>& vtrajdata = _GetWritableTrajData();
+        BOOST_ASSERT(startindex*_spec.GetDOF() <= vtrajdata.size() && endindex*_spec.GetDOF() <= vtrajdata.size());
         OPENRAVE_ASSERT_OP(startindex,<,endindex);
-        _vtrajdata.erase(_vtrajdata.begin()+startindex*_spec.GetDOF(),_vtrajdata.begin()+endindex*_spec.GetDOF());
+        vtrajdata.erase(vtrajdata.begin()+startindex*_spec.GetDOF(),vtrajdata.begin()+endindex*_spec.GetDOF());
         _bChanged = true;
+        _bDataHashValid = false;
+        _UpdateDataViews();
     }
 
     void Sample(std::vector<dReal>& data, dReal time) const override
@@ -360,42 +535,13 @@ public:
         BOOST_ASSERT(_timeoffset>=0);
         BOOST_ASSERT(time >= 0);
         _ComputeInternal();
-        OPENRAVE_ASSERT_OP_FORMAT0((int)_vtrajdata.size(),>=,_spec.GetDOF(), "trajectory needs at least one point to sample from", ORE_InvalidArguments);
+        OPENRAVE_ASSERT_OP_FORMAT0((int)_trajdata.size(),>=,_spec.GetDOF(), "trajectory needs at least one point to sample from", ORE_InvalidArguments);
         if( IS_DEBUGLEVEL(Level_Verbose) || (RaveGetDebugLevel() & Level_VerifyPlans) ) {
             _VerifySampling();
         }
         data.resize(0);
         data.resize(_spec.GetDOF(),0);
-        if( time >= GetDuration() ) {
-            std::copy(_vtrajdata.end()-_spec.GetDOF(),_vtrajdata.end(),data.begin());
-        }
-        else {
-            std::vector<dReal>::iterator it = std::lower_bound(_vaccumtime.begin(),_vaccumtime.end(),time);
-            if( it == _vaccumtime.begin() ) {
-                std::copy(_vtrajdata.begin(),_vtrajdata.begin()+_spec.GetDOF(),data.begin());
-                data.at(_timeoffset) = time;
-            }
-            else {
-                size_t index = it-_vaccumtime.begin();
-                dReal deltatime = time-_vaccumtime.at(index-1);
-                dReal waypointdeltatime = _vtrajdata.at(_spec.GetDOF()*index + _timeoffset);
-                // unfortunately due to floating-point error deltatime might not be in the range [0, waypointdeltatime], so double check!
-                if( deltatime < 0 ) {
-                    // most likely small epsilon
-                    deltatime = 0;
-                }
-                else if( deltatime > waypointdeltatime ) {
-                    deltatime = waypointdeltatime;
-                }
-                for(size_t i = 0; i < _vgroupinterpolators.size(); ++i) {
-                    if( !!_vgroupinterpolators[i] ) {
-                        _vgroupinterpolators[i](index-1,deltatime,data.begin());
-                    }
-                }
-                // should return the sample time relative to the last endpoint so it is easier to re-insert in the trajectory
-                data.at(_timeoffset) = deltatime;
-            }
-        }
+        _SampleInternal(time, data.begin());
     }
 
     void Sample(std::vector<dReal>& data, dReal time, const ConfigurationSpecification& spec, bool reintializeData) const override
@@ -404,7 +550,7 @@ public:
         OPENRAVE_ASSERT_OP(_timeoffset,>=,0);
         OPENRAVE_ASSERT_OP(time, >=, -g_fEpsilon);
         _ComputeInternal();
-        OPENRAVE_ASSERT_OP_FORMAT0((int)_vtrajdata.size(),>=,_spec.GetDOF(), "trajectory needs at least one point to sample from", ORE_InvalidArguments);
+        OPENRAVE_ASSERT_OP_FORMAT0((int)_trajdata.size(),>=,_spec.GetDOF(), "trajectory needs at least one point to sample from", ORE_InvalidArguments);
         if( IS_DEBUGLEVEL(Level_Verbose) || (RaveGetDebugLevel() & Level_VerifyPlans) ) {
             _VerifySampling();
         }
@@ -412,38 +558,57 @@ public:
             data.resize(0);
         }
         data.resize(spec.GetDOF(),0);
-        if( time >= GetDuration() ) {
-            ConfigurationSpecification::ConvertData(data.begin(),spec,_vtrajdata.end()-_spec.GetDOF(),_spec,1,GetEnv());
+        if( spec == _spec ) {
+            // no conversion necessary
+            _SampleInternal(time, data.begin());
         }
         else {
-            std::vector<dReal>::iterator it = std::lower_bound(_vaccumtime.begin(),_vaccumtime.end(),time);
-            if( it == _vaccumtime.begin() ) {
-                ConfigurationSpecification::ConvertData(data.begin(),spec,_vtrajdata.begin(),_spec,1,GetEnv());
-            }
-            else {
-                // could be faster
-                vector<dReal> vinternaldata(_spec.GetDOF(),0);
-                size_t index = it-_vaccumtime.begin();
-                dReal deltatime = time-_vaccumtime.at(index-1);
-                dReal waypointdeltatime = _vtrajdata.at(_spec.GetDOF()*index + _timeoffset);
-                // unfortunately due to floating-point error deltatime might not be in the range [0, waypointdeltatime], so double check!
-                if( deltatime < 0 ) {
-                    // most likely small epsilon
-                    deltatime = 0;
-                }
-                else if( deltatime > waypointdeltatime ) {
-                    deltatime = waypointdeltatime;
-                }
-                for(size_t i = 0; i < _vgroupinterpolators.size(); ++i) {
-                    if( !!_vgroupinterpolators[i] ) {
-                        _vgroupinterpolators[i](index-1,deltatime,vinternaldata.begin());
-                    }
-                }
-                // should return the sample time relative to the last endpoint so it is easier to re-insert in the trajectory
-                vinternaldata.at(_timeoffset) = deltatime;
+            // thread local so that a trajectory can be sampled from several threads
+            static thread_local std::vector<dReal> s_vsampledata;
+            s_vsampledata.resize(0);
+            s_vsampledata.resize(_spec.GetDOF(),0);
+            _SampleInternal(time, s_vsampledata.begin());
+            // the plan is cached per thread rather than in the trajectory so that const sampling does not write to it.
+            // plans with default values from the environment have to be recompiled every time to get the current state
+            static thread_local ConfigurationSpecification s_samplesourcespec, s_sampletargetspec;
+            static thread_local ConfigurationSpecification::ConversionPlan s_sampleplan;
+            static thread_local const EnvironmentBase* s_psampleenv = nullptr;
+            if( s_psampleenv != GetEnv().get() || s_sampleplan.HasEnvironmentDefaultValues() || s_sampletargetspec != spec || s_samplesourcespec != _spec ) {
+                s_psampleenv = nullptr; // in case Compile throws
+                s_sampleplan.Compile(spec, _spec, GetEnv());
+                s_sampletargetspec = spec;
+                s_samplesourcespec = _spec;
+                s_psampleenv = GetEnv().get();
+            }
+            s_sampleplan.Apply(data.begin(), s_vsampledata.data(), 1);
+        }
+    }
 
-                ConfigurationSpecification::ConvertData(data.begin(),spec,vinternaldata.begin(),_spec,1,GetEnv());
-            }
+    void SamplePoints(std::vector<dReal>& data, const std::vector<dReal>& times) const override
+    {
+        BOOST_ASSERT(_bInit);
+        BOOST_ASSERT(_timeoffset>=0);
+        _ComputeInternal();
+        OPENRAVE_ASSERT_OP_FORMAT0((int)_trajdata.size(),>=,_spec.GetDOF(), "trajectory needs at least one point to sample from", ORE_InvalidArguments);
+        if( IS_DEBUGLEVEL(Level_Verbose) || (RaveGetDebugLevel() & Level_VerifyPlans) ) {
+            _VerifySampling();
+        }
+        data.resize(0);
+        data.resize(_spec.GetDOF()*times.size(),0);
+        _SampleBulk(times.data(), times.size(), data.begin());
+    }
+
+    void SamplePoints(std::vector<dReal>& data, const std::vector<dReal>& times, const ConfigurationSpecification& spec) const override
+    {
+        // avoid unnecessary computation if spec is same as this->_spec
+        if (spec == _spec) {
+            return SamplePoints(data, times);
+        }
+        std::vector<dReal> dataInSourceSpec;
+        SamplePoints(dataInSourceSpec, times);
+        data.resize(spec.GetDOF()*times.size());
+        if( times.size() > 0 ) {
+            ConfigurationSpecification::ConvertData(data.begin(), spec, dataInSourceSpec.begin(), _spec, times.size(), GetEnv());
         }
     }
 
@@ -512,24 +677,24 @@ public:
     size_t GetNumWaypoints() const override
     {
         BOOST_ASSERT(_bInit);
-        return _vtrajdata.size()/_spec.GetDOF();
+        return _trajdata.size()/_spec.GetDOF();
     }
 
     void GetWaypoints(size_t startindex, size_t endindex, std::vector<dReal>& data) const override
     {
         BOOST_ASSERT(_bInit);
-        BOOST_ASSERT(startindex<=endindex && startindex*_spec.GetDOF() <= _vtrajdata.size() && endindex*_spec.GetDOF() <= _vtrajdata.size());
+        BOOST_ASSERT(startindex<=endindex && startindex*_spec.GetDOF() <= _trajdata.size() && endindex*_spec.GetDOF() <= _trajdata.size());
         data.resize((endindex-startindex)*_spec.GetDOF(),0);
-        std::copy(_vtrajdata.begin()+startindex*_spec.GetDOF(),_vtrajdata.begin()+endindex*_spec.GetDOF(),data.begin());
+        std::copy(_trajdata.begin()+startindex*_spec.GetDOF(),_trajdata.begin()+endindex*_spec.GetDOF(),data.begin());
     }
 
     void GetWaypoints(size_t startindex, size_t endindex, std::vector<dReal>& data, const ConfigurationSpecification& spec) const override
     {
         BOOST_ASSERT(_bInit);
-        BOOST_ASSERT(startindex<=endindex && startindex*_spec.GetDOF() <= _vtrajdata.size() && endindex*_spec.GetDOF() <= _vtrajdata.size());
+        BOOST_ASSERT(startindex<=endindex && startindex*_spec.GetDOF() <= _trajdata.size() && endindex*_spec.GetDOF() <= _trajdata.size());
         data.resize(spec.GetDOF()*(endindex-startindex),0);
         if( startindex < endindex ) {
-            ConfigurationSpecification::ConvertData(data.begin(),spec,_vtrajdata.begin()+startindex*_spec.GetDOF(),_spec,endindex-startindex,GetEnv());
+            ConfigurationSpecification::ConvertData(data.begin(),spec,_trajdata.begin()+startindex*_spec.GetDOF(),_spec,endindex-startindex,GetEnv());
         }
     }
 
@@ -538,33 +703,75 @@ public:
         BOOST_ASSERT(_bInit);
         BOOST_ASSERT(_timeoffset>=0);
         _ComputeInternal();
-        if( _vaccumtime.size() == 0 ) {
+        if( _accumtime.size() == 0 ) {
             return 0;
         }
-        if( time < _vaccumtime.at(0) ) {
+        if( time < _accumtime.at(0) ) {
             return 0;
         }
-        if( time >= _vaccumtime.at(_vaccumtime.size()-1) ) {
+        if( time >= _accumtime.at(_accumtime.size()-1) ) {
             return GetNumWaypoints();
         }
-        std::vector<dReal>::const_iterator itaccum = std::lower_bound(_vaccumtime.begin(), _vaccumtime.end(), time);
-        return itaccum-_vaccumtime.begin();
+        TrajectoryDataView::const_iterator itaccum = std::lower_bound(_accumtime.begin(), _accumtime.end(), time);
+        return itaccum-_accumtime.begin();
     }
 
     dReal GetDuration() const override
     {
         BOOST_ASSERT(_bInit);
         _ComputeInternal();
-        return _vaccumtime.size() > 0 ? _vaccumtime.back() : 0;
+        return _accumtime.size() > 0 ? _accumtime.back() : 0;
+    }
+
+    /// The hash is computed from the raw waypoints and cached until the waypoints or the specification change.
+    uint64_t GetDataHash() const override
+    {
+        if( !_bDataHashValid ) {
+            _datahash = _ComputeDataHash(_spec, _trajdata.size() > 0 ? &_trajdata[0] : NULL, _trajdata.size());
+            _bDataHashValid = true;
+        }
+        return _datahash;
     }
 
     // New feature: Store trajectory file in binary
     void serialize(std::ostream& O, int options) const override
     {
-        dReal fUnitScale = 1.0;
         if( options & TSO_SerializeAsXML ) {
             TrajectoryBase::serialize(O, options);
         }
+        else if( options & TSO_SerializeMappable ) {
+            // the waypoint data has to be aligned relative to the start of the trajectory, so write the header first
+            std::stringstream sheader;
+            WriteBinaryUInt16(sheader, BINARY_TRAJECTORY_MAGIC_NUMBER);
+            WriteBinaryUInt16(sheader, BINARY_TRAJECTORY_MAPPABLE_VERSION_NUMBER);
+            _SerializeGroups(sheader);
+            WriteBinaryString(sheader, GetDescription());
+            _SerializeReadableInterfaces(sheader, options);
+
+            _ComputeInternal();
+            WriteBinaryUInt16(sheader, sizeof(dReal));
+            WriteBinaryUInt64(sheader, _trajdata.size());
+            WriteBinaryUInt64(sheader, _accumtime.size());
+            const size_t headersize = (size_t)sheader.tellp() + sizeof(uint16_t);
+            const uint16_t numPaddingBytes = (sizeof(dReal) - headersize%sizeof(dReal))%sizeof(dReal);
+            WriteBinaryUInt16(sheader, numPaddingBytes);
+            for(uint16_t ipadding = 0; ipadding < numPaddingBytes; ++ipadding) {
+                sheader.put(0);
+            }
+            O << sheader.rdbuf();
+
+            WriteBinaryData(O, _trajdata.begin(), _trajdata.size());
+            WriteBinaryData(O, _accumtime.begin(), _accumtime.size());
+            WriteBinaryData(O, _deltainvtime.begin(), _deltainvtime.size());
+        }
+        else if( options & TSO_SerializeCompressed ) {
+            WriteBinaryUInt16(O, BINARY_TRAJECTORY_MAGIC_NUMBER);
+            WriteBinaryUInt16(O, BINARY_TRAJECTORY_COMPRESSED_VERSION_NUMBER);
+            _SerializeGroups(O);
+            WriteBinaryString(O, GetDescription());
+            _SerializeReadableInterfaces(O, options);
+            _SerializeCompressedData(O);
+        }
         else {
             // NOTE: Ignore 'options' argument for now
 
@@ -573,77 +780,15 @@ public:
             WriteBinaryUInt16(O, BINARY_TRAJECTORY_VERSION_NUMBER);
 
             /* Store meta-data */
-
-            // Indicate size of meta data
-            const ConfigurationSpecification& spec = this->GetConfigurationSpecification();
-            const uint16_t numGroups = spec._vgroups.size();
-            WriteBinaryUInt16(O, numGroups);
-
-            FOREACHC(itgroup, spec._vgroups)
-            {
-                WriteBinaryString(O, itgroup->name);   // Writes group name
-                WriteBinaryInt(O, itgroup->offset);    // Writes offset
-                WriteBinaryInt(O, itgroup->dof);       // Writes dof
-                WriteBinaryString(O, itgroup->interpolation);  // Writes interpolation
-            }
+            _SerializeGroups(O);
 
             /* Store data waypoints */
-            WriteBinaryVector(O, this->_vtrajdata);
+            WriteBinaryUInt32(O, _trajdata.size());
+            WriteBinaryData(O, _trajdata.begin(), _trajdata.size());
 
             WriteBinaryString(O, GetDescription());
 
-            // Readable interfaces, added on BINARY_TRAJECTORY_VERSION_NUMBER=0x0002
-            std::stringstream ss;
-            const uint16_t numReadableInterfaces = GetReadableInterfaces().size();
-            WriteBinaryUInt16(O, numReadableInterfaces);
-
-            rapidjson::Document document;
-            int zerooptions = 0;
-            FOREACHC(itReadableInterface, GetReadableInterfaces()) {
-                WriteBinaryString(O, itReadableInterface->first);  // readable interface id
-
-                // try to serialize to json first
-                if (!!itReadableInterface->second) {
-                    rapidjson::Value rReadable;
-                    if( itReadableInterface->second->SerializeJSON(rReadable, document.GetAllocator(), fUnitScale, zerooptions) ) {
-                        WriteBinaryString(O, rReadable.GetString());
-                        WriteBinaryString(O, "StringReadable");
-                        continue;
-                    }
-                    else {
-                        // perhaps XML?
-                        ss.str(std::string());
-                        xmlreaders::StreamXMLWriterPtr writer;
-
-                        // try to serialize to HierarchicalXML
-                        xmlreaders::HierarchicalXMLReadablePtr pHierarchical = OPENRAVE_DYNAMIC_POINTER_CAST<xmlreaders::HierarchicalXMLReadable>(itReadableInterface->second);
-                        if( !!pHierarchical ) {
-                            writer.reset(new xmlreaders::StreamXMLWriter("root")); // need to parse with xml, so need a root
-                            pHierarchical->SerializeXML(writer, options);
-                            writer->Serialize(ss);
-
-                            WriteBinaryString(O, ss.str());
-                            WriteBinaryString(O, "HierarchicalXMLReadable");
-                            continue;
-                        }
-                        else {
-                            writer.reset(new xmlreaders::StreamXMLWriter(std::string()));
-                            if( itReadableInterface->second->SerializeXML(writer, zerooptions) ) {
-                                ss.clear();
-                                ss.str(std::string());
-                                writer->Serialize(ss);
-                                WriteBinaryString(O, ss.str());
-                                WriteBinaryString(O, "StringReadable");
-                                continue;
-                            }
-                        }
-                    }
-                }
-
-                // if neither json or xml serializable, write an empty string
-                WriteBinaryString(O, "");
-                WriteBinaryString(O, "StringReadable");
-            }
+            _SerializeReadableInterfaces(O, options);
         }
     }
 
@@ -662,8 +807,8 @@ public:
             uint16_t versionNumber = 0;
             ReadBinaryUInt16(I, versionNumber);
 
-            // currently supported versions: 0x0001, 0x0002
-            if (versionNumber > BINARY_TRAJECTORY_VERSION_NUMBER || versionNumber < 0x0001)
+            // currently supported versions: 0x0001, 0x0002, 0x0003, 0x0004, 0x0005
+            if (versionNumber > BINARY_TRAJECTORY_COMPRESSED_VERSION_NUMBER || versionNumber < 0x0001)
             {
                 throw OPENRAVE_EXCEPTION_FORMAT(_("unsupported trajectory format version %d "),versionNumber,ORE_InvalidArguments);
             }
@@ -685,8 +830,10 @@ public:
             }
             this->Init(_spec);
 
-            /* Read trajectory data */
-            ReadBinaryVector(I, this->_vtrajdata);
+            /* Read trajectory data, versions 0x0004 and 0x0005 store it at the end */
+            if (versionNumber < BINARY_TRAJECTORY_MAPPABLE_VERSION_NUMBER) {
+                ReadBinaryVector(I, *this->_ptrajdata);
+            }
             ReadBinaryString(I, __description);
 
             // clear out existing readable interfaces
@@ -733,6 +880,14 @@ public:
                     SetReadableInterface(xmlid, readableInterface);
                 }
             }
+
+            if (versionNumber == BINARY_TRAJECTORY_MAPPABLE_VERSION_NUMBER) {
+                _DeserializeMappableData(I);
+            }
+            else if (versionNumber == BINARY_TRAJECTORY_COMPRESSED_VERSION_NUMBER) {
+                _DeserializeCompressedData(I);
+            }
+            _UpdateDataViews();
         }
         else {
             // try XML deserialization
@@ -742,6 +897,18 @@ public:
     }
 
     void DeserializeFromRawData(const uint8_t* pdata, size_t nDataSize) override
+    {
+        _DeserializeFromRawData(pdata, nDataSize, MappedTrajectoryFilePtr());
+    }
+
+    void DeserializeFromMappedFile(const std::string& filename) override
+    {
+        MappedTrajectoryFilePtr pmappedfile(new MappedTrajectoryFile(filename));
+        _DeserializeFromRawData(pmappedfile->GetData(), pmappedfile->GetSize(), pmappedfile);
+    }
+
+    /// \param pmappedfile if set, pdata is inside this file and the waypoints of version 0x0004 can be referenced instead of copied
+    void _DeserializeFromRawData(const uint8_t* pdata, size_t nDataSize, const MappedTrajectoryFilePtr& pmappedfile)
     {
         // Check whether binary or XML file
         const uint8_t* I = pdata;
@@ -754,8 +921,8 @@ public:
             uint16_t versionNumber = 0;
             ReadBinaryUInt16(I, versionNumber);
 
-            // currently supported versions: 0x0001, 0x0002
-            if (versionNumber > BINARY_TRAJECTORY_VERSION_NUMBER || versionNumber < 0x0001)
+            // currently supported versions: 0x0001, 0x0002, 0x0003, 0x0004, 0x0005
+            if (versionNumber > BINARY_TRAJECTORY_COMPRESSED_VERSION_NUMBER || versionNumber < 0x0001)
             {
                 throw OPENRAVE_EXCEPTION_FORMAT(_("unsupported trajectory format version %d "),versionNumber,ORE_InvalidArguments);
             }
@@ -777,8 +944,10 @@ public:
             }
             this->Init(_spec);
 
-            /* Read trajectory data */
-            ReadBinaryVector(I, this->_vtrajdata);
+            /* Read trajectory data, versions 0x0004 and 0x0005 store it at the end */
+            if (versionNumber < BINARY_TRAJECTORY_MAPPABLE_VERSION_NUMBER) {
+                ReadBinaryVector(I, *this->_ptrajdata);
+            }
             ReadBinaryString(I, __description);
 
             // clear out existing readable interfaces
@@ -825,6 +994,16 @@ public:
                     SetReadableInterface(xmlid, readableInterface);
                 }
             }
+
+            if (versionNumber == BINARY_TRAJECTORY_MAPPABLE_VERSION_NUMBER) {
+                _DeserializeMappableData(I, pdata+nDataSize, pmappedfile);
+            }
+            else {
+                if (versionNumber == BINARY_TRAJECTORY_COMPRESSED_VERSION_NUMBER) {
+                    _DeserializeCompressedData(I, pdata+nDataSize);
+                }
+                _UpdateDataViews();
+            }
         }
         else {
             // try XML deserialization
@@ -832,19 +1011,55 @@ public:
         }
     }
 
+    /// When cloning a GenericTrajectory, the waypoints are shared with it until either trajectory is modified.
     void Clone(InterfaceBaseConstPtr preference, int cloningoptions) override
     {
         InterfaceBase::Clone(preference,cloningoptions);
         TrajectoryBaseConstPtr r = RaveInterfaceConstCast<TrajectoryBase>(preference);
         Init(r->GetConfigurationSpecification());
-        r->GetWaypoints(0,r->GetNumWaypoints(),_vtrajdata);
+        boost::shared_ptr<GenericTrajectory const> pgeneric = boost::dynamic_pointer_cast<GenericTrajectory const>(r);
+        if( !!pgeneric && !!pgeneric->_pmappedfile ) {
+            // a mapped trajectory always has its time index, so share everything
+            _pmappedfile = pgeneric->_pmappedfile;
+            _trajdata = pgeneric->_trajdata;
+            _accumtime = pgeneric->_accumtime;
+            _deltainvtime = pgeneric->_deltainvtime;
+            _bChanged = false;
+            _datahash = pgeneric->_datahash;
+            _bDataHashValid = pgeneric->_bDataHashValid;
+            return;
+        }
+        if( !!pgeneric ) {
+            // only reads pgeneric, the waypoints are copied by whichever trajectory is modified first, see _GetWritableTrajData
+            _ptrajdata = pgeneric->_ptrajdata;
+            _datahash = pgeneric->_datahash;
+            _bDataHashValid = pgeneric->_bDataHashValid;
+        }
+        else {
+            r->GetWaypoints(0,r->GetNumWaypoints(),*_ptrajdata);
+        }
         _bChanged = true;
+        _UpdateDataViews();
+    }
+
+    /// Categories: "waypoints", "timing" (accumulated and inverse delta times), "sharedmappedfile" (the mapped waypoints, shared with the page cache) and "sharedwaypoints" (the waypoints shared with cloned trajectories).
+    void GetMemoryUsage(MemoryUsage& memoryusage) const override
+    {
+        TrajectoryBase::GetMemoryUsage(memoryusage);
+        memoryusage.Add(_ptrajdata.use_count() > 1 ? "sharedwaypoints" : "waypoints", GetVectorMemoryUsage(*_ptrajdata));
+        memoryusage.Add("timing", GetVectorMemoryUsage(_vaccumtime) + GetVectorMemoryUsage(_vdeltainvtime));
+        if( !!_pmappedfile ) {
+            memoryusage.Add("sharedmappedfile", _pmappedfile->GetSize());
+        }
     }
 
     void Swap(TrajectoryBasePtr rawtraj) override
     {
-        OPENRAVE_ASSERT_OP(GetXMLId(),==,rawtraj->GetXMLId());
         boost::shared_ptr<GenericTrajectory> traj = boost::dynamic_pointer_cast<GenericTrajectory>(rawtraj);
+        if( !traj ) {
+            TrajectoryBase::Swap(rawtraj);
+            return;
+        }
         _spec.Swap(traj->_spec);
         _vderivoffsets.swap(traj->_vderivoffsets);
         _vddoffsets.swap(traj->_vddoffsets);
@@ -853,15 +1068,336 @@ public:
         _viioffsets.swap(traj->_viioffsets);
         std::swap(_timeoffset, traj->_timeoffset);
         std::swap(_bInit, traj->_bInit);
-        std::swap(_vtrajdata, traj->_vtrajdata);
+        std::swap(_ptrajdata, traj->_ptrajdata);
         std::swap(_vaccumtime, traj->_vaccumtime);
         std::swap(_vdeltainvtime, traj->_vdeltainvtime);
+        std::swap(_trajdata, traj->_trajdata); // the views point into the swapped buffers, so they stay valid
+        std::swap(_accumtime, traj->_accumtime);
+        std::swap(_deltainvtime, traj->_deltainvtime);
+        std::swap(_pmappedfile, traj->_pmappedfile);
         std::swap(_bChanged, traj->_bChanged);
         std::swap(_bSamplingVerified, traj->_bSamplingVerified);
+        std::swap(_datahash, traj->_datahash);
+        std::swap(_bDataHashValid, traj->_bDataHashValid);
         _InitializeGroupFunctions();
     }
 
 protected:
+    void _SerializeGroups(std::ostream& O) const
+    {
+        // Indicate size of meta data
+        const ConfigurationSpecification& spec = this->GetConfigurationSpecification();
+        const uint16_t numGroups = spec._vgroups.size();
+        WriteBinaryUInt16(O, numGroups);
+
+        FOREACHC(itgroup, spec._vgroups)
+        {
+            WriteBinaryString(O, itgroup->name);   // Writes group name
+            WriteBinaryInt(O, itgroup->offset);    // Writes offset
+            WriteBinaryInt(O, itgroup->dof);       // Writes dof
+            WriteBinaryString(O, itgroup->interpolation);  // Writes interpolation
+        }
+    }
+
+    void _SerializeReadableInterfaces(std::ostream& O, int options) const
+    {
+        dReal fUnitScale = 1.0;
+        // Readable interfaces, added on BINARY_TRAJECTORY_VERSION_NUMBER=0x0002
+        std::stringstream ss;
+        const uint16_t numReadableInterfaces = GetReadableInterfaces().size();
+        WriteBinaryUInt16(O, numReadableInterfaces);
+
+        rapidjson::Document document;
+        int zerooptions = 0;
+        FOREACHC(itReadableInterface, GetReadableInterfaces()) {
+            WriteBinaryString(O, itReadableInterface->first);  // readable interface id
+
+            // try to serialize to json first
+            if (!!itReadableInterface->second) {
+                rapidjson::Value rReadable;
+                if( itReadableInterface->second->SerializeJSON(rReadable, document.GetAllocator(), fUnitScale, zerooptions) ) {
+                    WriteBinaryString(O, rReadable.GetString());
+                    WriteBinaryString(O, "StringReadable");
+                    continue;
+                }
+                else {
+                    // perhaps XML?
+                    ss.str(std::string());
+                    xmlreaders::StreamXMLWriterPtr writer;
+
+                    // try to serialize to HierarchicalXML
+                    xmlreaders::HierarchicalXMLReadablePtr pHierarchical = OPENRAVE_DYNAMIC_POINTER_CAST<xmlreaders::HierarchicalXMLReadable>(itReadableInterface->second);
+                    if( !!pHierarchical ) {
+                        writer.reset(new xmlreaders::StreamXMLWriter("root")); // need to parse with xml, so need a root
+                        pHierarchical->SerializeXML(writer, options);
+                        writer->Serialize(ss);
+
+                        WriteBinaryString(O, ss.str());
+                        WriteBinaryString(O, "HierarchicalXMLReadable");
+                        continue;
+                    }
+                    else {
+                        writer.reset(new xmlreaders::StreamXMLWriter(std::string()));
+                        if( itReadableInterface->second->SerializeXML(writer, zerooptions) ) {
+                            ss.clear();
+                            ss.str(std::string());
+                            writer->Serialize(ss);
+                            WriteBinaryString(O, ss.str());
+                            WriteBinaryString(O, "StringReadable");
+                            continue;
+                        }
+                    }
+                }
+            }
+
+            // if neither json or xml serializable, write an empty string
+            WriteBinaryString(O, "");
+            WriteBinaryString(O, "StringReadable");
+        }
+    }
+
+    /// \brief returns true if numTimes time index entries are consistent with numDataPoints waypoint values
+    bool _IsTimeIndexConsistent(uint64_t numDataPoints, uint64_t numTimes) const
+    {
+        if( _timeoffset < 0 || _spec.GetDOF() == 0 ) {
+            return numTimes == 0;
+        }
+        return numTimes == numDataPoints/_spec.GetDOF();
+    }
+
+    /// \brief reads the aligned waypoints and time index at the end of a version 0x0004 binary trajectory
+    void _DeserializeMappableData(std::istream& I)
+    {
+        uint16_t realSize = 0, numPaddingBytes = 0;
+        uint64_t numDataPoints = 0, numTimes = 0;
+        ReadBinaryUInt16(I, realSize);
+        OPENRAVE_ASSERT_OP_FORMAT((size_t)realSize,==,sizeof(dReal), "trajectory was written with %d-byte reals", realSize, ORE_InvalidArguments);
+        ReadBinaryUInt64(I, numDataPoints);
+        ReadBinaryUInt64(I, numTimes);
+        ReadBinaryUInt16(I, numPaddingBytes);
+        I.ignore(numPaddingBytes);
+        _ptrajdata->resize(numDataPoints);
+        I.read((char*)_ptrajdata->data(), numDataPoints*sizeof(dReal));
+        _vaccumtime.resize(numTimes);
+        I.read((char*)_vaccumtime.data(), numTimes*sizeof(dReal));
+        _vdeltainvtime.resize(numTimes);
+        I.read((char*)_vdeltainvtime.data(), numTimes*sizeof(dReal));
+        if( !I ) {
+            throw OPENRAVE_EXCEPTION_FORMAT0(_("failed to read the waypoints of the binary trajectory"), ORE_InvalidArguments);
+        }
+        _bChanged = !_IsTimeIndexConsistent(numDataPoints, numTimes);
+    }
+
+    /// \brief reads the aligned waypoints and time index at the end of a version 0x0004 binary trajectory
+    ///
+    /// \param pend end of the raw data
+    /// \param pmappedfile if set, the views are pointed into the file instead of copying the data
+    void _DeserializeMappableData(const uint8_t*& I, const uint8_t* pend, const MappedTrajectoryFilePtr& pmappedfile)
+    {
+        const size_t headerSize = 2*sizeof(uint16_t)+2*sizeof(uint64_t);
+        OPENRAVE_ASSERT_OP_FORMAT0(headerSize,<=,(size_t)(pend-I), "binary trajectory is truncated", ORE_InvalidArguments);
+        uint16_t realSize = 0, numPaddingBytes = 0;
+        uint64_t numDataPoints = 0, numTimes = 0;
+        ReadBinaryUInt16(I, realSize);
+        OPENRAVE_ASSERT_OP_FORMAT((size_t)realSize,==,sizeof(dReal), "trajectory was written with %d-byte reals", realSize, ORE_InvalidArguments);
+        ReadBinaryUInt64(I, numDataPoints);
+        ReadBinaryUInt64(I, numTimes);
+        ReadBinaryUInt16(I, numPaddingBytes);
+        const size_t dataSize = numPaddingBytes + (numDataPoints+2*numTimes)*sizeof(dReal);
+        OPENRAVE_ASSERT_OP_FORMAT0(dataSize,<=,(size_t)(pend-I), "binary trajectory is truncated", ORE_InvalidArguments);
+        I += numPaddingBytes;
+
+        const bool bTimeIndexConsistent = _IsTimeIndexConsistent(numDataPoints, numTimes);
+        if( !!pmappedfile && bTimeIndexConsistent && ((uintptr_t)I % sizeof(dReal)) == 0 ) {
+            const dReal* pdata = reinterpret_cast<const dReal*>(I);
+            _pmappedfile = pmappedfile;
+            _trajdata.Set(pdata, numDataPoints);
+            _accumtime.Set(pdata+numDataPoints, numTimes);
+            _deltainvtime.Set(pdata+numDataPoints+numTimes, numTimes);
+        }
+        else {
+            _ptrajdata->resize(numDataPoints);
+            std::memcpy(_ptrajdata->data(), I, numDataPoints*sizeof(dReal));
+            _vaccumtime.resize(numTimes);
+            std::memcpy(_vaccumtime.data(), I+numDataPoints*sizeof(dReal), numTimes*sizeof(dReal));
+            _vdeltainvtime.resize(numTimes);
+            std::memcpy(_vdeltainvtime.data(), I+(numDataPoints+numTimes)*sizeof(dReal), numTimes*sizeof(dReal));
+            _UpdateDataViews();
+        }
+        I += (numDataPoints+2*numTimes)*sizeof(dReal);
+        _bChanged = !bTimeIndexConsistent;
+    }
+
+    bool _SetCompressionToleranceCommand(std::ostream& sout, std::istream& sinput)
+    {
+        dReal fTolerance = 0;
+        sinput >> fTolerance;
+        if( !sinput || fTolerance < 0 ) {
+            return false;
+        }
+        _fCompressionTolerance = fTolerance;
+        return true;
+    }
+
+    /// \brief writes the waypoints of a version 0x0005 binary trajectory
+    ///
+    /// Every dof is stored as a column. When _fCompressionTolerance is positive, the values of a column are rounded to multiples of it and the differences between consecutive waypoints are written as varints, which are mostly one or two bytes for smooth trajectories. The deltatime column and columns with values too large to quantize are written as is. The columns are then compressed with zlib when available.
+    void _SerializeCompressedData(std::ostream& O) const
+    {
+        const int dof = _spec.GetDOF();
+        const size_t numWaypoints = dof > 0 ? _trajdata.size()/dof : 0;
+        std::vector<uint8_t> vencoded;
+        vencoded.reserve(dof + 2*_trajdata.size());
+        vencoded.resize(dof, TCE_Raw);
+        for(int idof = 0; idof < dof; ++idof) {
+            bool bQuantize = _fCompressionTolerance > 0 && idof != _timeoffset;
+            for(size_t ipoint = 0; ipoint < numWaypoints && bQuantize; ++ipoint) {
+                bQuantize = RaveFabs(_trajdata[ipoint*dof+idof]/_fCompressionTolerance) < (dReal)(INT64_C(1)<<52); // also false for nan
+            }
+            if( bQuantize ) {
+                vencoded[idof] = TCE_Quantized;
+                int64_t prevquantized = 0;
+                for(size_t ipoint = 0; ipoint < numWaypoints; ++ipoint) {
+                    const int64_t quantized = llround(_trajdata[ipoint*dof+idof]/_fCompressionTolerance);
+                    const int64_t delta = quantized - prevquantized;
+                    WriteVarUInt64(vencoded, ((uint64_t)delta<<1)^(uint64_t)(delta>>63));
+                    prevquantized = quantized;
+                }
+            }
+            else {
+                for(size_t ipoint = 0; ipoint < numWaypoints; ++ipoint) {
+                    const uint8_t* pvalue = reinterpret_cast<const uint8_t*>(&_trajdata[ipoint*dof+idof]);
+                    vencoded.insert(vencoded.end(), pvalue, pvalue+sizeof(dReal));
+                }
+            }
+        }
+
+        uint16_t compression = TCM_None;
+        const uint8_t* pstored = vencoded.data();
+        uint64_t storedSize = vencoded.size();
+#ifdef OPENRAVE_HAS_ZLIB
+        std::vector<uint8_t> vcompressed(compressBound(vencoded.size()));
+        uLongf compressedSize = vcompressed.size();
+        if( compress2(vcompressed.data(), &compressedSize, vencoded.data(), vencoded.size(), Z_DEFAULT_COMPRESSION) == Z_OK ) {
+            compression = TCM_Zlib;
+            pstored = vcompressed.data();
+            storedSize = compressedSize;
+        }
+#endif
+        WriteBinaryUInt16(O, sizeof(dReal));
+        WriteBinaryUInt64(O, _trajdata.size());
+        WriteBinaryDouble(O, _fCompressionTolerance);
+        WriteBinaryUInt16(O, compression);
+        WriteBinaryUInt64(O, vencoded.size());
+        WriteBinaryUInt64(O, storedSize);
+        O.write((const char*)pstored, storedSize);
+    }
+
+    /// \brief reads the waypoints at the end of a version 0x0005 binary trajectory
+    void _DeserializeCompressedData(std::istream& I)
+    {
+        uint16_t realSize = 0, compression = 0;
+        uint64_t numDataPoints = 0, encodedSize = 0, storedSize = 0;
+        double fTolerance = 0;
+        ReadBinaryUInt16(I, realSize);
+        OPENRAVE_ASSERT_OP_FORMAT((size_t)realSize,==,sizeof(dReal), "trajectory was written with %d-byte reals", realSize, ORE_InvalidArguments);
+        ReadBinaryUInt64(I, numDataPoints);
+        ReadBinaryDouble(I, fTolerance);
+        ReadBinaryUInt16(I, compression);
+        ReadBinaryUInt64(I, encodedSize);
+        ReadBinaryUInt64(I, storedSize);
+        if( !I ) {
+            throw OPENRAVE_EXCEPTION_FORMAT0(_("failed to read the waypoints of the binary trajectory"), ORE_InvalidArguments);
+        }
+        std::vector<uint8_t> vstored(storedSize);
+        I.read((char*)vstored.data(), storedSize);
+        if( !I ) {
+            throw OPENRAVE_EXCEPTION_FORMAT0(_("failed to read the waypoints of the binary trajectory"), ORE_InvalidArguments);
+        }
+        _DecodeCompressedData(vstored.data(), storedSize, compression, encodedSize, numDataPoints, fTolerance);
+    }
+
+    /// \brief reads the waypoints at the end of a version 0x0005 binary trajectory
+    ///
+    /// \param pend end of the raw data
+    void _DeserializeCompressedData(const uint8_t*& I, const uint8_t* pend)
+    {
+        const size_t headerSize = 2*sizeof(uint16_t)+3*sizeof(uint64_t)+sizeof(double);
+        OPENRAVE_ASSERT_OP_FORMAT0(headerSize,<=,(size_t)(pend-I), "binary trajectory is truncated", ORE_InvalidArguments);
+        uint16_t realSize = 0, compression = 0;
+        uint64_t numDataPoints = 0, encodedSize = 0, storedSize = 0;
+        double fTolerance = 0;
+        ReadBinaryUInt16(I, realSize);
+        OPENRAVE_ASSERT_OP_FORMAT((size_t)realSize,==,sizeof(dReal), "trajectory was written with %d-byte reals", realSize, ORE_InvalidArguments);
+        ReadBinaryUInt64(I, numDataPoints);
+        ReadBinaryDouble(I, fTolerance);
+        ReadBinaryUInt16(I, compression);
+        ReadBinaryUInt64(I, encodedSize);
+        ReadBinaryUInt64(I, storedSize);
+        OPENRAVE_ASSERT_OP_FORMAT0(storedSize,<=,(uint64_t)(pend-I), "binary trajectory is truncated", ORE_InvalidArguments);
+        _DecodeCompressedData(I, storedSize, compression, encodedSize, numDataPoints, fTolerance);
+        I += storedSize;
+    }
+
+    /// \brief fills _ptrajdata from the stored columns written by _SerializeCompressedData
+    void _DecodeCompressedData(const uint8_t* pstored, uint64_t storedSize, uint16_t compression, uint64_t encodedSize, uint64_t numDataPoints, double fTolerance)
+    {
+        std::vector<uint8_t> vencoded;
+        const uint8_t* pencoded = pstored;
+        if( compression == TCM_Zlib ) {
+#ifdef OPENRAVE_HAS_ZLIB
+            vencoded.resize(encodedSize);
+            uLongf uncompressedSize = encodedSize;
+            if( uncompress(vencoded.data(), &uncompressedSize, pstored, storedSize) != Z_OK || uncompressedSize != encodedSize ) {
+                throw OPENRAVE_EXCEPTION_FORMAT0(_("failed to uncompress the waypoints of the binary trajectory"), ORE_InvalidArguments);
+            }
+            pencoded = vencoded.data();
+#else
+            throw OPENRAVE_EXCEPTION_FORMAT0(_("binary trajectory is compressed with zlib, but openrave was built without zlib"), ORE_NotImplemented);
+#endif
+        }
+        else if( compression != TCM_None || encodedSize != storedSize ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("unsupported trajectory compression %d"), compression, ORE_InvalidArguments);
+        }
+        const uint8_t* pend = pencoded + encodedSize;
+
+        const int dof = _spec.GetDOF();
+        if( (dof == 0 && numDataPoints > 0) || (dof > 0 && numDataPoints % dof != 0) ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("binary trajectory has %d values, which is not a multiple of its dof %d"), numDataPoints%dof, ORE_InvalidArguments);
+        }
+        _bChanged = true;
+        std::vector<dReal>& vtrajdata = _GetWritableTrajData();
+        if( dof == 0 ) {
+            vtrajdata.clear();
+            return;
+        }
+        const size_t numWaypoints = numDataPoints/dof;
+        OPENRAVE_ASSERT_OP_FORMAT0((uint64_t)dof,<=,encodedSize, "binary trajectory is truncated", ORE_InvalidArguments);
+        const uint8_t* pencodings = pencoded;
+        pencoded += dof;
+        vtrajdata.resize(numDataPoints);
+        for(int idof = 0; idof < dof; ++idof) {
+            if( pencodings[idof] == TCE_Quantized ) {
+                int64_t quantized = 0;
+                for(size_t ipoint = 0; ipoint < numWaypoints; ++ipoint) {
+                    uint64_t zigzag = 0;
+                    if( !ReadVarUInt64(pencoded, pend, zigzag) ) {
+                        throw OPENRAVE_EXCEPTION_FORMAT0(_("binary trajectory is truncated"), ORE_InvalidArguments);
+                    }
+                    quantized += (int64_t)(zigzag>>1)^-(int64_t)(zigzag&1);
+                    vtrajdata[ipoint*dof+idof] = quantized*fTolerance;
+                }
+            }
+            else {
+                OPENRAVE_ASSERT_OP_FORMAT0(numWaypoints*sizeof(dReal),<=,(size_t)(pend-pencoded), "binary trajectory is truncated", ORE_InvalidArguments);
+                for(size_t ipoint = 0; ipoint < numWaypoints; ++ipoint) {
+                    std::memcpy(&vtrajdata[ipoint*dof+idof], pencoded, sizeof(dReal));
+                    pencoded += sizeof(dReal);
+                }
+            }
+        }
+    }
+
     void _ConvertData(std::vector<dReal>::iterator ittargetdata, const dReal* psourcedata, const std::vector< std::vector<ConfigurationSpecification::Group>::const_iterator >& vconvertgroups, const ConfigurationSpecification& spec, size_t numelements, bool filluninitialized)
     {
         for(size_t igroup = 0; igroup < vconvertgroups.size(); ++igroup) {
@@ -899,6 +1435,8 @@ protected:
         if( !_bChanged ) {
             return;
         }
+        // a mapped trajectory comes with its time index and is never in the changed state
+        BOOST_ASSERT(!_pmappedfile);
         if( _timeoffset < 0 ) {
             _vaccumtime.resize(0);
             _vdeltainvtime.resize(0);
@@ -906,13 +1444,14 @@ protected:
         else {
             _vaccumtime.resize(GetNumWaypoints());
             _vdeltainvtime.resize(_vaccumtime.size());
+            _UpdateDataViews();
             if( _vaccumtime.size() == 0 ) {
                 return;
             }
-            _vaccumtime.at(0) = _vtrajdata.at(_timeoffset);
-            _vdeltainvtime.at(0) = 1/_vtrajdata.at(_timeoffset);
+            _vaccumtime.at(0) = _trajdata.at(_timeoffset);
+            _vdeltainvtime.at(0) = 1/_trajdata.at(_timeoffset);
             for(size_t i = 1; i < _vaccumtime.size(); ++i) {
-                dReal deltatime = _vtrajdata[_spec.GetDOF()*i+_timeoffset];
+                dReal deltatime = _trajdata[_spec.GetDOF()*i+_timeoffset];
                 if( deltatime < 0 ) {
                     throw OPENRAVE_EXCEPTION_FORMAT("deltatime (%.15e) is < 0 at point %d/%d", deltatime%i%_vaccumtime.size(), ORE_InvalidState);
                 }
@@ -920,10 +1459,53 @@ protected:
                 _vaccumtime[i] = _vaccumtime[i-1] + deltatime;
             }
         }
+        _UpdateDataViews();
         _bChanged = false;
         _bSamplingVerified = false;
     }
 
+    /// \brief points the data views to the owned vectors. Has to be called every time the vectors change while no file is mapped.
+    void _UpdateDataViews() const
+    {
+        if( !!_pmappedfile ) {
+            return;
+        }
+        _trajdata.Set(*_ptrajdata);
+        _accumtime.Set(_vaccumtime);
+        _deltainvtime.Set(_vdeltainvtime);
+    }
+
+    /// \brief empties the waypoints, keeping the buffer if it is not shared with clones
+    void _ClearTrajData()
+    {
+        if( _ptrajdata.use_count() > 1 ) {
+            _ptrajdata.reset(new std::vector<dReal>());
+        }
+        else {
+            _ptrajdata->clear();
+        }
+    }
+
+    /// \brief returns the waypoints for modification, copying them first if they are shared with clones or mapped from a file.
+    ///
+    /// Owners of _ptrajdata are only added by cloning from one of its owners, which is a read of that trajectory and cannot happen concurrently
+    /// with modifying it, so a use count of 1 cannot grow while this trajectory is modified. A concurrent release by a clone only makes the copy unnecessary.
+    std::vector<dReal>& _GetWritableTrajData()
+    {
+        if( !!_pmappedfile ) {
+            _ptrajdata.reset(new std::vector<dReal>(_trajdata.begin(), _trajdata.end()));
+            _vaccumtime.assign(_accumtime.begin(), _accumtime.end());
+            _vdeltainvtime.assign(_deltainvtime.begin(), _deltainvtime.end());
+            _pmappedfile.reset();
+            _UpdateDataViews();
+        }
+        else if( _ptrajdata.use_count() > 1 ) {
+            _ptrajdata.reset(new std::vector<dReal>(*_ptrajdata));
+            _UpdateDataViews();
+        }
+        return *_ptrajdata;
+    }
+
     /// \brief assumes _ComputeInternal has finished
     void _VerifySampling() const
     {
@@ -952,8 +1534,8 @@ protected:
 
         if( IS_DEBUGLEVEL(Level_Debug) || (RaveGetDebugLevel() & Level_VerifyPlans) ) {
             // go through all the points
-            for(size_t ipoint = 0; ipoint+1 < _vaccumtime.size(); ++ipoint) {
-                dReal deltatime = _vaccumtime[ipoint+1] - _vaccumtime[ipoint];
+            for(size_t ipoint = 0; ipoint+1 < _accumtime.size(); ++ipoint) {
+                dReal deltatime = _accumtime[ipoint+1] - _accumtime[ipoint];
                 for(size_t i = 0; i < _vgroupvalidators.size(); ++i) {
                     if( !!_vgroupvalidators[i] ) {
                         _vgroupvalidators[i](ipoint,deltatime);
@@ -969,6 +1551,7 @@ protected:
     {
         // first set sizes to 0
         _vgroupinterpolators.resize(0);
+        _vgrouppolynomials.resize(0);
         _vgroupvalidators.resize(0);
         _vderivoffsets.resize(0);
         _vddoffsets.resize(0);
@@ -976,6 +1559,7 @@ protected:
         _vintegraloffsets.resize(0);
         _viioffsets.resize(0);
         _vgroupinterpolators.resize(_spec._vgroups.size());
+        _vgrouppolynomials.resize(_spec._vgroups.size());
         _vgroupvalidators.resize(_spec._vgroups.size());
         _vderivoffsets.resize(_spec.GetDOF(),-1);
         _vddoffsets.resize(_spec.GetDOF(),-1);
@@ -1020,6 +1604,7 @@ protected:
                 }
                 else {
                     _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateQuadratic,this,boost::ref(_spec._vgroups[i]),_1,_2,_3);
+                    _vgrouppolynomials[i] = boost::bind(&GenericTrajectory::_ComputeQuadraticCoefficients,this,boost::ref(_spec._vgroups[i]),_1,_2);
                     _vgroupvalidators[i] = boost::bind(&GenericTrajectory::_ValidateQuadratic,this,boost::ref(_spec._vgroups[i]),_1,_2);
                 }
                 nNeedNeighboringInfo = 3;
@@ -1034,6 +1619,7 @@ protected:
                 }
                 else {
                     _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateCubic,this,boost::ref(_spec._vgroups[i]),_1,_2,_3);
+                    _vgrouppolynomials[i] = boost::bind(&GenericTrajectory::_ComputeCubicCoefficients,this,boost::ref(_spec._vgroups[i]),_1,_2);
                     _vgroupvalidators[i] = boost::bind(&GenericTrajectory::_ValidateCubic,this,boost::ref(_spec._vgroups[i]),_1,_2);
                 }
                 nNeedNeighboringInfo = 3;
@@ -1045,6 +1631,7 @@ protected:
             }
             else if( interpolation == "quintic" ) {
                 _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateQuintic,this,boost::ref(_spec._vgroups[i]),_1,_2,_3);
+                _vgrouppolynomials[i] = boost::bind(&GenericTrajectory::_ComputeQuinticCoefficients,this,boost::ref(_spec._vgroups[i]),_1,_2);
                 _vgroupvalidators[i] = boost::bind(&GenericTrajectory::_ValidateQuintic,this,boost::ref(_spec._vgroups[i]),_1,_2);
                 nNeedNeighboringInfo = 3;
             }
@@ -1169,19 +1756,19 @@ protected:
     void _InterpolatePrevious(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime, const std::vector<dReal>::iterator& itdata)
     {
         size_t offset = ipoint*_spec.GetDOF()+g.offset;
-        if( (ipoint+1)*_spec.GetDOF() < _vtrajdata.size() ) {
+        if( (ipoint+1)*_spec.GetDOF() < _trajdata.size() ) {
             // if point is so close the previous, then choose the next
-            dReal f = _vdeltainvtime.at(ipoint+1)*deltatime;
+            dReal f = _deltainvtime.at(ipoint+1)*deltatime;
             if( f > 1-g_fEpsilon ) {
                 offset += _spec.GetDOF();
             }
         }
-        std::copy(_vtrajdata.begin()+offset,_vtrajdata.begin()+offset+g.dof,itdata+g.offset);
+        std::copy(_trajdata.begin()+offset,_trajdata.begin()+offset+g.dof,itdata+g.offset);
     }
 
     void _InterpolateNext(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime, const std::vector<dReal>::iterator& itdata)
     {
-        if( (ipoint+1)*_spec.GetDOF() < _vtrajdata.size() ) {
+        if( (ipoint+1)*_spec.GetDOF() < _trajdata.size() ) {
             ipoint += 1;
         }
         size_t offset = ipoint*_spec.GetDOF() + g.offset;
@@ -1189,7 +1776,7 @@ protected:
             // if point is so close the previous, then choose the previous
             offset -= _spec.GetDOF();
         }
-        std::copy(_vtrajdata.begin()+offset,_vtrajdata.begin()+offset+g.dof,itdata+g.offset);
+        std::copy(_trajdata.begin()+offset,_trajdata.begin()+offset+g.dof,itdata+g.offset);
     }
 
     void _InterpolateLinear(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime, const std::vector<dReal>::iterator& itdata)
@@ -1198,15 +1785,15 @@ protected:
         int derivoffset = _vderivoffsets[g.offset];
         if( derivoffset < 0 ) {
             // expected derivative offset, interpolation can be wrong for circular joints
-            dReal f = _vdeltainvtime.at(ipoint+1)*deltatime;
+            dReal f = _deltainvtime.at(ipoint+1)*deltatime;
             for(int i = 0; i < g.dof; ++i) {
-                *(itdata + g.offset+i) = _vtrajdata[offset+g.offset+i]*(1-f) + f*_vtrajdata[_spec.GetDOF()+offset+g.offset+i];
+                *(itdata + g.offset+i) = _trajdata[offset+g.offset+i]*(1-f) + f*_trajdata[_spec.GetDOF()+offset+g.offset+i];
             }
         }
         else {
             for(int i = 0; i < g.dof; ++i) {
-                dReal deriv0 = _vtrajdata[_spec.GetDOF()+offset+derivoffset+i];
-                *(itdata + g.offset+i) = _vtrajdata[offset+g.offset+i] + deltatime*deriv0;
+                dReal deriv0 = _trajdata[_spec.GetDOF()+offset+derivoffset+i];
+                *(itdata + g.offset+i) = _trajdata[offset+g.offset+i] + deltatime*deriv0;
             }
         }
     }
@@ -1216,13 +1803,13 @@ protected:
         _InterpolateLinear(g,ipoint,deltatime,itdata);
         if( deltatime > g_fEpsilon ) {
             size_t offset = ipoint*_spec.GetDOF();
-            dReal f = _vdeltainvtime.at(ipoint+1)*deltatime;
+            dReal f = _deltainvtime.at(ipoint+1)*deltatime;
             switch(iktype) {
             case IKP_Rotation3D:
             case IKP_Transform6D: {
                 Vector q0, q1;
-                q0.Set4(&_vtrajdata[offset+g.offset]);
-                q1.Set4(&_vtrajdata[_spec.GetDOF()+offset+g.offset]);
+                q0.Set4(&_trajdata[offset+g.offset]);
+                q1.Set4(&_trajdata[_spec.GetDOF()+offset+g.offset]);
                 Vector q = quatSlerp(q0,q1,f);
                 *(itdata + g.offset+0) = q[0];
                 *(itdata + g.offset+1) = q[1];
@@ -1231,8 +1818,8 @@ protected:
                 break;
             }
             case IKP_TranslationDirection5D: {
-                Vector dir0(_vtrajdata[offset+g.offset+0],_vtrajdata[offset+g.offset+1],_vtrajdata[offset+g.offset+2]);
-                Vector dir1(_vtrajdata[_spec.GetDOF()+offset+g.offset+0],_vtrajdata[_spec.GetDOF()+offset+g.offset+1],_vtrajdata[_spec.GetDOF()+offset+g.offset+2]);
+                Vector dir0(_trajdata[offset+g.offset+0],_trajdata[offset+g.offset+1],_trajdata[offset+g.offset+2]);
+                Vector dir1(_trajdata[_spec.GetDOF()+offset+g.offset+0],_trajdata[_spec.GetDOF()+offset+g.offset+1],_trajdata[_spec.GetDOF()+offset+g.offset+2]);
                 Vector axisangle = dir0.cross(dir1);
                 dReal fsinangle = RaveSqrt(axisangle.lengthsqr3());
                 if( fsinangle > g_fEpsilon ) {
@@ -1250,6 +1837,96 @@ protected:
         }
     }
 
+    /// \brief computes the coefficients of the quadratic polynomials of the segment ending at ipoint+1, same as _InterpolateQuadratic
+    ///
+    /// \param pcoeffs filled with the coefficients of t^j for dof i at pcoeffs[j*g.dof+i]
+    /// \return the order of the polynomials, or -1 if the group has to be sampled with _InterpolateQuadratic
+    int _ComputeQuadraticCoefficients(const ConfigurationSpecification::Group& g, size_t ipoint, dReal* pcoeffs) const
+    {
+        size_t offset = ipoint*_spec.GetDOF();
+        int derivoffset = _vderivoffsets[g.offset];
+        if( derivoffset >= 0 ) {
+            for(int i = 0; i < g.dof; ++i) {
+                dReal deriv0 = _trajdata[offset+derivoffset+i];
+                dReal deriv1 = _trajdata[_spec.GetDOF()+offset+derivoffset+i];
+                pcoeffs[i] = _trajdata[offset+g.offset+i];
+                pcoeffs[g.dof+i] = deriv0;
+                pcoeffs[2*g.dof+i] = 0.5*_deltainvtime.at(ipoint+1)*(deriv1-deriv0);
+            }
+        }
+        else {
+            dReal ideltatime = _deltainvtime.at(ipoint+1);
+            dReal ideltatime2 = ideltatime*ideltatime;
+            int integraloffset = _vintegraloffsets[g.offset];
+            for(int i = 0; i < g.dof; ++i) {
+                dReal integral0 = _trajdata[offset+integraloffset+i];
+                dReal integral1 = _trajdata[_spec.GetDOF()+offset+integraloffset+i];
+                dReal value0 = _trajdata[offset+g.offset+i];
+                dReal value1 = _trajdata[_spec.GetDOF()+offset+g.offset+i];
+                dReal c1TimesDelta = 6*(integral1-integral0)*ideltatime - 4*value0 - 2*value1;
+                pcoeffs[i] = value0;
+                pcoeffs[g.dof+i] = c1TimesDelta*ideltatime;
+                pcoeffs[2*g.dof+i] = (value1 - value0 - c1TimesDelta)*ideltatime2;
+            }
+        }
+        return 2;
+    }
+
+    /// \brief computes the coefficients of the cubic polynomials of the segment ending at ipoint+1, see _ComputeQuadraticCoefficients
+    int _ComputeCubicCoefficients(const ConfigurationSpecification::Group& g, size_t ipoint, dReal* pcoeffs) const
+    {
+        size_t offset = ipoint*_spec.GetDOF();
+        int derivoffset = _vderivoffsets[g.offset];
+        if( derivoffset < 0 ) {
+            // the coefficients computed from the integrals depend on the sample time
+            return -1;
+        }
+        dReal ideltatime = _deltainvtime.at(ipoint+1);
+        dReal ideltatime2 = ideltatime*ideltatime;
+        dReal ideltatime3 = ideltatime2*ideltatime;
+        for(int i = 0; i < g.dof; ++i) {
+            dReal deriv0 = _trajdata[offset+derivoffset+i];
+            dReal deriv1 = _trajdata[_spec.GetDOF()+offset+derivoffset+i];
+            dReal px = _trajdata.at(_spec.GetDOF()+offset+g.offset+i) - _trajdata[offset+g.offset+i];
+            pcoeffs[i] = _trajdata[offset+g.offset+i];
+            pcoeffs[g.dof+i] = deriv0;
+            pcoeffs[2*g.dof+i] = 3*px*ideltatime2 - (2*deriv0+deriv1)*ideltatime;
+            pcoeffs[3*g.dof+i] = (deriv1+deriv0)*ideltatime2 - 2*px*ideltatime3;
+        }
+        return 3;
+    }
+
+    /// \brief computes the coefficients of the quintic polynomials of the segment ending at ipoint+1, see _ComputeQuadraticCoefficients
+    int _ComputeQuinticCoefficients(const ConfigurationSpecification::Group& g, size_t ipoint, dReal* pcoeffs) const
+    {
+        size_t offset = ipoint*_spec.GetDOF();
+        int derivoffset = _vderivoffsets[g.offset];
+        int ddoffset = _vddoffsets[g.offset];
+        if( derivoffset < 0 || ddoffset < 0 ) {
+            return -1;
+        }
+        dReal ideltatime = _deltainvtime.at(ipoint+1);
+        dReal ideltatime2 = ideltatime*ideltatime;
+        dReal ideltatime3 = ideltatime2*ideltatime;
+        dReal ideltatime4 = ideltatime2*ideltatime2;
+        dReal ideltatime5 = ideltatime4*ideltatime;
+        for(int i = 0; i < g.dof; ++i) {
+            dReal p0 = _trajdata[offset+g.offset+i];
+            dReal px = _trajdata[_spec.GetDOF()+offset+g.offset+i] - p0;
+            dReal deriv0 = _trajdata[offset+derivoffset+i];
+            dReal deriv1 = _trajdata[_spec.GetDOF()+offset+derivoffset+i];
+            dReal dd0 = _trajdata[offset+ddoffset+i];
+            dReal dd1 = _trajdata[_spec.GetDOF()+offset+ddoffset+i];
+            pcoeffs[i] = p0;
+            pcoeffs[g.dof+i] = deriv0;
+            pcoeffs[2*g.dof+i] = 0.5*dd0;
+            pcoeffs[3*g.dof+i] = (-1.5*dd0 + dd1*0.5)*ideltatime + (-6*deriv0 - 4*deriv1)*ideltatime2 + px*10*ideltatime3;
+            pcoeffs[4*g.dof+i] = (1.5*dd0 - dd1)*ideltatime2 + (8*deriv0 + 7*deriv1)*ideltatime3 - px*15*ideltatime4;
+            pcoeffs[5*g.dof+i] = (-0.5*dd0 + dd1*0.5)*ideltatime3 - (3*deriv0 + 3*deriv1)*ideltatime4 + px*6*ideltatime5;
+        }
+        return 5;
+    }
+
     void _InterpolateQuadratic(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime, const std::vector<dReal>::iterator& itdata)
     {
         size_t offset = ipoint*_spec.GetDOF();
@@ -1258,14 +1935,14 @@ protected:
             if( derivoffset >= 0 ) {
                 for(int i = 0; i < g.dof; ++i) {
                     // coeff*t^2 + deriv0*t + pos0
-                    dReal deriv0 = _vtrajdata[offset+derivoffset+i];
-                    dReal deriv1 = _vtrajdata[_spec.GetDOF()+offset+derivoffset+i];
-                    dReal coeff = 0.5*_vdeltainvtime.at(ipoint+1)*(deriv1-deriv0);
-                    *(itdata + g.offset+i) = _vtrajdata[offset+g.offset+i] + deltatime*(deriv0 + deltatime*coeff);
+                    dReal deriv0 = _trajdata[offset+derivoffset+i];
+                    dReal deriv1 = _trajdata[_spec.GetDOF()+offset+derivoffset+i];
+                    dReal coeff = 0.5*_deltainvtime.at(ipoint+1)*(deriv1-deriv0);
+                    *(itdata + g.offset+i) = _trajdata[offset+g.offset+i] + deltatime*(deriv0 + deltatime*coeff);
                 }
             }
             else {
-                dReal ideltatime = _vdeltainvtime.at(ipoint+1);
+                dReal ideltatime = _deltainvtime.at(ipoint+1);
                 dReal ideltatime2 = ideltatime*ideltatime;
                 int integraloffset = _vintegraloffsets[g.offset];
                 for(int i = 0; i < g.dof; ++i) {
@@ -1275,10 +1952,10 @@ protected:
                     // mult by (3/deltatime): c2*deltatime**2 + 3/2*c1*deltatime + 3*v0 = 3*(p1-p0)/deltatime
                     // subtract by original: 0.5*c1*deltatime + 2*v0 - 3*(p1-p0)/deltatime + v1 = 0
                     // c1*deltatime = 6*(p1-p0)/deltatime - 4*v0 - 2*v1
-                    dReal integral0 = _vtrajdata[offset+integraloffset+i];
-                    dReal integral1 = _vtrajdata[_spec.GetDOF()+offset+integraloffset+i];
-                    dReal value0 = _vtrajdata[offset+g.offset+i];
-                    dReal value1 = _vtrajdata[_spec.GetDOF()+offset+g.offset+i];
+                    dReal integral0 = _trajdata[offset+integraloffset+i];
+                    dReal integral1 = _trajdata[_spec.GetDOF()+offset+integraloffset+i];
+                    dReal value0 = _trajdata[offset+g.offset+i];
+                    dReal value1 = _trajdata[_spec.GetDOF()+offset+g.offset+i];
                     dReal c1TimesDelta = 6*(integral1-integral0)*ideltatime - 4*value0 - 2*value1;
                     dReal c1 = c1TimesDelta*ideltatime;
                     dReal c2 = (value1 - value0 - c1TimesDelta)*ideltatime2;
@@ -1288,7 +1965,7 @@ protected:
         }
         else {
             for(int i = 0; i < g.dof; ++i) {
-                *(itdata + g.offset+i) = _vtrajdata[offset+g.offset+i];
+                *(itdata + g.offset+i) = _trajdata[offset+g.offset+i];
             }
         }
     }
@@ -1303,13 +1980,13 @@ protected:
             switch(iktype) {
             case IKP_Rotation3D:
             case IKP_Transform6D: {
-                q0.Set4(&_vtrajdata[offset+g.offset]);
-                q0vel.Set4(&_vtrajdata[offset+derivoffset]);
-                q1.Set4(&_vtrajdata[_spec.GetDOF()+offset+g.offset]);
-                q1vel.Set4(&_vtrajdata[_spec.GetDOF()+offset+derivoffset]);
+                q0.Set4(&_trajdata[offset+g.offset]);
+                q0vel.Set4(&_trajdata[offset+derivoffset]);
+                q1.Set4(&_trajdata[_spec.GetDOF()+offset+g.offset]);
+                q1vel.Set4(&_trajdata[_spec.GetDOF()+offset+derivoffset]);
                 Vector angularvelocity0 = quatMultiply(q0vel,quatInverse(q0))*2;
                 Vector angularvelocity1 = quatMultiply(q1vel,quatInverse(q1))*2;
-                Vector coeff = (angularvelocity1-angularvelocity0)*(0.5*_vdeltainvtime.at(ipoint+1));
+                Vector coeff = (angularvelocity1-angularvelocity0)*(0.5*_deltainvtime.at(ipoint+1));
                 Vector vtotaldelta = angularvelocity0*deltatime + coeff*(deltatime*deltatime);
                 Vector q = quatMultiply(quatFromAxisAngle(Vector(vtotaldelta.y,vtotaldelta.z,vtotaldelta.w)),q0);
                 *(itdata + g.offset+0) = q[0];
@@ -1320,13 +1997,13 @@ protected:
             }
             case IKP_TranslationDirection5D: {
                 Vector dir0, dir1, angularvelocity0, angularvelocity1;
-                dir0.Set3(&_vtrajdata[offset+g.offset]);
-                dir1.Set3(&_vtrajdata[_spec.GetDOF()+offset+g.offset]);
+                dir0.Set3(&_trajdata[offset+g.offset]);
+                dir1.Set3(&_trajdata[_spec.GetDOF()+offset+g.offset]);
                 Vector axisangle = dir0.cross(dir1);
                 if( axisangle.lengthsqr3() > g_fEpsilon ) {
-                    angularvelocity0.Set3(&_vtrajdata[offset+derivoffset]);
-                    angularvelocity1.Set3(&_vtrajdata[_spec.GetDOF()+offset+derivoffset]);
-                    Vector coeff = (angularvelocity1-angularvelocity0)*(0.5*_vdeltainvtime.at(ipoint+1));
+                    angularvelocity0.Set3(&_trajdata[offset+derivoffset]);
+                    angularvelocity1.Set3(&_trajdata[_spec.GetDOF()+offset+derivoffset]);
+                    Vector coeff = (angularvelocity1-angularvelocity0)*(0.5*_deltainvtime.at(ipoint+1));
                     Vector vtotaldelta = angularvelocity0*deltatime + coeff*(deltatime*deltatime);
                     Vector newdir = quatRotate(quatFromAxisAngle(vtotaldelta),dir0);
                     *(itdata + g.offset+0) = newdir[0];
@@ -1358,17 +2035,17 @@ protected:
                 // c2 = (3*(x1 - x0) - 2*v0*dt - v1*dt)/(dt**2)
                 // c1 = v0
                 // c0 = p0
-                dReal ideltatime = _vdeltainvtime.at(ipoint+1);
+                dReal ideltatime = _deltainvtime.at(ipoint+1);
                 dReal ideltatime2 = ideltatime*ideltatime;
                 dReal ideltatime3 = ideltatime2*ideltatime;
                 for(int i = 0; i < g.dof; ++i) {
                     // coeff*t^2 + deriv0*t + pos0
-                    dReal deriv0 = _vtrajdata[offset+derivoffset+i];
-                    dReal deriv1 = _vtrajdata[_spec.GetDOF()+offset+derivoffset+i];
-                    dReal px = _vtrajdata.at(_spec.GetDOF()+offset+g.offset+i) - _vtrajdata[offset+g.offset+i];
+                    dReal deriv0 = _trajdata[offset+derivoffset+i];
+                    dReal deriv1 = _trajdata[_spec.GetDOF()+offset+derivoffset+i];
+                    dReal px = _trajdata.at(_spec.GetDOF()+offset+g.offset+i) - _trajdata[offset+g.offset+i];
                     dReal c3 = (deriv1+deriv0)*ideltatime2 - 2*px*ideltatime3;
                     dReal c2 = 3*px*ideltatime2 - (2*deriv0+deriv1)*ideltatime;
-                    *(itdata + g.offset+i) = _vtrajdata[offset+g.offset+i] + deltatime*(deriv0 + deltatime*(c2 + deltatime*c3));
+                    *(itdata + g.offset+i) = _trajdata[offset+g.offset+i] + deltatime*(deriv0 + deltatime*(c2 + deltatime*c3));
                 }
             }
             else if( integoffset >= 0 && iioffset >= 0 ) {
@@ -1387,19 +2064,19 @@ protected:
                 // c2 = ((18*x0 - 12*x1)*dt**2 + 84*(i1 - i0)*dt - 180*(ii1 - ii0 - i0*dt))/(dt**4)
                 // c1 = ((3*x1 - 9*x0)*dt**2 - 24*(i1 - i0)*dt + 60*(ii1 - ii0 - i0*dt))/(dt**3)
                 // c0 = x0
-                dReal ideltatime = _vdeltainvtime.at(ipoint + 1);
+                dReal ideltatime = _deltainvtime.at(ipoint + 1);
                 dReal ideltatime2 = ideltatime*ideltatime;
                 dReal ideltatime3 = ideltatime2*ideltatime;
                 dReal ideltatime4 = ideltatime3*ideltatime;
                 dReal ideltatime5 = ideltatime4*ideltatime;
                 for(int i = 0; i < g.dof; ++i) {
-                    dReal integ0 = _vtrajdata[offset + integoffset + i];
-                    dReal idiff = _vtrajdata[_spec.GetDOF() + offset + integoffset + i] - integ0; // i1 - i0
-                    dReal temp = _vtrajdata[_spec.GetDOF() + offset + iioffset + i] - _vtrajdata[offset + iioffset + i] - integ0*deltatime; // ii1 - ii0 - i0*dt
-                    dReal c3 =    10*(_vtrajdata.at(_spec.GetDOF() + offset + g.offset + i) - _vtrajdata[offset + g.offset + i])*ideltatime3 - 60*idiff*ideltatime4 + 120*temp*ideltatime5;
-                    dReal c2 = (18*_vtrajdata[offset + g.offset + i] - 12*_vtrajdata.at(_spec.GetDOF() + offset + g.offset + i))*ideltatime2 + 84*idiff*ideltatime3 - 180*temp*ideltatime4;
-                    dReal c1 = ( -9*_vtrajdata[offset + g.offset + i] + 3*_vtrajdata.at(_spec.GetDOF() + offset + g.offset + i))*ideltatime  - 24*idiff*ideltatime2 +  60*temp*ideltatime3;
-                    *(itdata + g.offset+i) = _vtrajdata[offset+g.offset+i] + deltatime*(c1 + deltatime*(c2 + deltatime*c3));
+                    dReal integ0 = _trajdata[offset + integoffset + i];
+                    dReal idiff = _trajdata[_spec.GetDOF() + offset + integoffset + i] - integ0; // i1 - i0
+                    dReal temp = _trajdata[_spec.GetDOF() + offset + iioffset + i] - _trajdata[offset + iioffset + i] - integ0*deltatime; // ii1 - ii0 - i0*dt
+                    dReal c3 =    10*(_trajdata.at(_spec.GetDOF() + offset + g.offset + i) - _trajdata[offset + g.offset + i])*ideltatime3 - 60*idiff*ideltatime4 + 120*temp*ideltatime5;
+                    dReal c2 = (18*_trajdata[offset + g.offset + i] - 12*_trajdata.at(_spec.GetDOF() + offset + g.offset + i))*ideltatime2 + 84*idiff*ideltatime3 - 180*temp*ideltatime4;
+                    dReal c1 = ( -9*_trajdata[offset + g.offset + i] + 3*_trajdata.at(_spec.GetDOF() + offset + g.offset + i))*ideltatime  - 24*idiff*ideltatime2 +  60*temp*ideltatime3;
+                    *(itdata + g.offset+i) = _trajdata[offset+g.offset+i] + deltatime*(c1 + deltatime*(c2 + deltatime*c3));
                 }
             }
             else {
@@ -1408,7 +2085,7 @@ protected:
         }
         else {
             for(int i = 0; i < g.dof; ++i) {
-                *(itdata + g.offset+i) = _vtrajdata[offset+g.offset+i];
+                *(itdata + g.offset+i) = _trajdata[offset+g.offset+i];
             }
         }
     }
@@ -1429,20 +2106,20 @@ protected:
                 switch( iktype ) {
                 case IKP_Rotation3D:
                 case IKP_Transform6D: {
-                    q0.Set4(&_vtrajdata[offset + g.offset]);
-                    q0vel.Set4(&_vtrajdata[offset + derivoffset]);
-                    q0acc.Set4(&_vtrajdata[offset + ddoffset]);
+                    q0.Set4(&_trajdata[offset + g.offset]);
+                    q0vel.Set4(&_trajdata[offset + derivoffset]);
+                    q0acc.Set4(&_trajdata[offset + ddoffset]);
 
-                    q1.Set4(&_vtrajdata[nextoffset + g.offset]);
-                    q1vel.Set4(&_vtrajdata[nextoffset + derivoffset]);
-                    q1acc.Set4(&_vtrajdata[nextoffset + ddoffset]);
+                    q1.Set4(&_trajdata[nextoffset + g.offset]);
+                    q1vel.Set4(&_trajdata[nextoffset + derivoffset]);
+                    q1acc.Set4(&_trajdata[nextoffset + ddoffset]);
 
                     const Vector angularVelocityPrev = 2.0*quatMultiply(q0vel, quatInverse(q0));
                     // const Vector angularVelocity = 2.0*quatMultiply(q1vel, quatInverse(q1)); // not used
                     const Vector angularAccelerationPrev = 2.0*quatMultiply(q0acc, quatInverse(q0));
                     const Vector angularAcceleration = 2.0*quatMultiply(q1acc, quatInverse(q1));
 
-                    const Vector j = (angularAcceleration - angularAccelerationPrev)*_vdeltainvtime.at(ipoint + 1);
+                    const Vector j = (angularAcceleration - angularAccelerationPrev)*_deltainvtime.at(ipoint + 1);
                     const Vector totalDelta = deltatime*(angularVelocityPrev + deltatime*(0.5*angularAccelerationPrev + (deltatime/6.0)*j));
                     const Vector q = quatMultiply(quatFromAxisAngle(Vector(totalDelta.y, totalDelta.z, totalDelta.w)), q0);
 
@@ -1489,17 +2166,17 @@ protected:
                 // c2 = a0/2
                 // c1 = v0
                 // c0 = p0
-                dReal ideltatime = _vdeltainvtime.at(ipoint+1);
+                dReal ideltatime = _deltainvtime.at(ipoint+1);
                 dReal ideltatime2 = ideltatime*ideltatime;
                 dReal ideltatime3 = ideltatime2*ideltatime;
                 for(int i = 0; i < g.dof; ++i) {
-                    dReal deriv0 = _vtrajdata[offset+derivoffset+i];
-                    dReal deriv1 = _vtrajdata[_spec.GetDOF()+offset+derivoffset+i];
-                    dReal dd0 = _vtrajdata[offset+ddoffset+i];
-                    dReal dd1 = _vtrajdata[_spec.GetDOF()+offset+ddoffset+i];
+                    dReal deriv0 = _trajdata[offset+derivoffset+i];
+                    dReal deriv1 = _trajdata[_spec.GetDOF()+offset+derivoffset+i];
+                    dReal dd0 = _trajdata[offset+ddoffset+i];
+                    dReal dd1 = _trajdata[_spec.GetDOF()+offset+ddoffset+i];
                     dReal c4 = -0.5*(deriv1-deriv0)*ideltatime3 + (dd0 + dd1)*ideltatime2*0.25;
                     dReal c3 = (deriv1-deriv0)*ideltatime2 - (2*dd0+dd1)*ideltatime/3.0;
-                    *(itdata + g.offset+i) = _vtrajdata[offset+g.offset+i] + deltatime*(deriv0 + deltatime*(0.5*dd0 + deltatime*(c3 + deltatime*c4)));
+                    *(itdata + g.offset+i) = _trajdata[offset+g.offset+i] + deltatime*(deriv0 + deltatime*(0.5*dd0 + deltatime*(c3 + deltatime*c4)));
                 }
             }
             else if( derivoffset >= 0 && integoffset >= 0 ) {
@@ -1518,17 +2195,17 @@ protected:
                 // c2 = (-4.5*v0 + 1.5*v1)/(dt) - (18*x0 + 12*x1)/(dt**2) + 30*(i1 - i0)/(dt**3)
                 // c1 = v0
                 // c0 = x0
-                dReal ideltatime = _vdeltainvtime.at(ipoint + 1);
+                dReal ideltatime = _deltainvtime.at(ipoint + 1);
                 dReal ideltatime2 = ideltatime*ideltatime;
                 dReal ideltatime3 = ideltatime2*ideltatime;
                 dReal ideltatime4 = ideltatime3*ideltatime;
                 dReal ideltatime5 = ideltatime4*ideltatime;
                 for(int i = 0; i < g.dof; ++i) {
-                    dReal deriv0 = _vtrajdata[offset + derivoffset + i];
-                    dReal deriv1 = _vtrajdata[_spec.GetDOF() + offset + derivoffset + i];
-                    dReal pos0 = _vtrajdata[offset + g.offset + i];
-                    dReal pos1 = _vtrajdata[_spec.GetDOF() + offset + g.offset + i];
-                    dReal idiff = _vtrajdata[_spec.GetDOF() + offset + integoffset + i] - _vtrajdata[offset + integoffset + i];
+                    dReal deriv0 = _trajdata[offset + derivoffset + i];
+                    dReal deriv1 = _trajdata[_spec.GetDOF() + offset + derivoffset + i];
+                    dReal pos0 = _trajdata[offset + g.offset + i];
+                    dReal pos1 = _trajdata[_spec.GetDOF() + offset + g.offset + i];
+                    dReal idiff = _trajdata[_spec.GetDOF() + offset + integoffset + i] - _trajdata[offset + integoffset + i];
                     dReal c4 = 2.5*(deriv1 - deriv0)*ideltatime3     - 15*(pos0 + pos1)*ideltatime4    + 30*idiff*ideltatime5;
                     dReal c3 = (6*deriv0 - 4*deriv1)*ideltatime2     + (32*pos0 + 28*pos1)*ideltatime3 - 60*idiff*ideltatime4;
                     dReal c2 = (-4.5*deriv0 + 1.5*deriv1)*ideltatime - (18*pos0 + 12*pos1)*ideltatime2 + 30*idiff*ideltatime3;
@@ -1541,7 +2218,7 @@ protected:
         }
         else {
             for(int i = 0; i < g.dof; ++i) {
-                *(itdata + g.offset+i) = _vtrajdata[offset+g.offset+i];
+                *(itdata + g.offset+i) = _trajdata[offset+g.offset+i];
             }
         }
     }
@@ -1568,18 +2245,18 @@ protected:
             int derivoffset = _vderivoffsets[g.offset];
             int ddoffset = _vddoffsets[g.offset];
             if( derivoffset >= 0 && ddoffset >= 0 ) {
-                dReal ideltatime = _vdeltainvtime.at(ipoint+1);
+                dReal ideltatime = _deltainvtime.at(ipoint+1);
                 dReal ideltatime2 = ideltatime*ideltatime;
                 dReal ideltatime3 = ideltatime2*ideltatime;
                 dReal ideltatime4 = ideltatime2*ideltatime2;
                 dReal ideltatime5 = ideltatime4*ideltatime;
                 for(int i = 0; i < g.dof; ++i) {
-                    dReal p0 = _vtrajdata[offset+g.offset+i];
-                    dReal px = _vtrajdata[_spec.GetDOF()+offset+g.offset+i] - p0;
-                    dReal deriv0 = _vtrajdata[offset+derivoffset+i];
-                    dReal deriv1 = _vtrajdata[_spec.GetDOF()+offset+derivoffset+i];
-                    dReal dd0 = _vtrajdata[offset+ddoffset+i];
-                    dReal dd1 = _vtrajdata[_spec.GetDOF()+offset+ddoffset+i];
+                    dReal p0 = _trajdata[offset+g.offset+i];
+                    dReal px = _trajdata[_spec.GetDOF()+offset+g.offset+i] - p0;
+                    dReal deriv0 = _trajdata[offset+derivoffset+i];
+                    dReal deriv1 = _trajdata[_spec.GetDOF()+offset+derivoffset+i];
+                    dReal dd0 = _trajdata[offset+ddoffset+i];
+                    dReal dd1 = _trajdata[_spec.GetDOF()+offset+ddoffset+i];
                     dReal c5 = (-0.5*dd0 + dd1*0.5)*ideltatime3 - (3*deriv0 + 3*deriv1)*ideltatime4 + px*6*ideltatime5;
                     dReal c4 = (1.5*dd0 - dd1)*ideltatime2 + (8*deriv0 + 7*deriv1)*ideltatime3 - px*15*ideltatime4;
                     dReal c3 = (-1.5*dd0 + dd1*0.5)*ideltatime + (-6*deriv0 - 4*deriv1)*ideltatime2 + px*10*ideltatime3;
@@ -1592,7 +2269,7 @@ protected:
         }
         else {
             for(int i = 0; i < g.dof; ++i) {
-                *(itdata + g.offset+i) = _vtrajdata[offset+g.offset+i];
+                *(itdata + g.offset+i) = _trajdata[offset+g.offset+i];
             }
         }
     }
@@ -1618,7 +2295,7 @@ protected:
             int ddoffset = _vddoffsets[g.offset];
             int dddoffset = _vdddoffsets[g.offset];
             if( derivoffset >= 0 && ddoffset >= 0 && dddoffset >= 0 ) {
-                dReal ideltatime = _vdeltainvtime.at(ipoint+1);
+                dReal ideltatime = _deltainvtime.at(ipoint+1);
                 dReal ideltatime2 = ideltatime*ideltatime;
                 dReal ideltatime3 = ideltatime2*ideltatime;
                 dReal ideltatime4 = ideltatime2*ideltatime2;
@@ -1628,14 +2305,14 @@ protected:
                 //dReal deltatime4 = deltatime2*deltatime2;
                 //dReal deltatime5 = deltatime4*deltatime;
                 for(int i = 0; i < g.dof; ++i) {
-                    dReal p0 = _vtrajdata[offset+g.offset+i];
-                    //dReal px = _vtrajdata[_spec.GetDOF()+offset+g.offset+i] - p0;
-                    dReal deriv0 = _vtrajdata[offset+derivoffset+i];
-                    dReal deriv1 = _vtrajdata[_spec.GetDOF()+offset+derivoffset+i];
-                    dReal dd0 = _vtrajdata[offset+ddoffset+i];
-                    dReal dd1 = _vtrajdata[_spec.GetDOF()+offset+ddoffset+i];
-                    dReal ddd0 = _vtrajdata[offset+dddoffset+i];
-                    dReal ddd1 = _vtrajdata[_spec.GetDOF()+offset+dddoffset+i];
+                    dReal p0 = _trajdata[offset+g.offset+i];
+                    //dReal px = _trajdata[_spec.GetDOF()+offset+g.offset+i] - p0;
+                    dReal deriv0 = _trajdata[offset+derivoffset+i];
+                    dReal deriv1 = _trajdata[_spec.GetDOF()+offset+derivoffset+i];
+                    dReal dd0 = _trajdata[offset+ddoffset+i];
+                    dReal dd1 = _trajdata[_spec.GetDOF()+offset+ddoffset+i];
+                    dReal ddd0 = _trajdata[offset+dddoffset+i];
+                    dReal ddd1 = _trajdata[_spec.GetDOF()+offset+dddoffset+i];
                     // matrix inverse is slow but at least it will work for now
                     // A=Matrix(3,3,[6*dt**5, 5*dt**4, 4*dt**3, 30*dt**4, 20*dt**3, 12*dt**2, 120*dt**3, 60*dt**2, 24*dt])
                     // A.inv() = [   dt**(-5), -1/(2*dt**4), 1/(12*dt**3)]
@@ -1662,7 +2339,7 @@ protected:
         }
         else {
             for(int i = 0; i < g.dof; ++i) {
-                *(itdata + g.offset+i) = _vtrajdata[offset+g.offset+i];
+                *(itdata + g.offset+i) = _trajdata[offset+g.offset+i];
             }
         }
     }
@@ -1671,7 +2348,7 @@ protected:
     {
         size_t offset = ipoint*_spec.GetDOF()+g.offset;
         for(int i = 0; i < g.dof; ++i) {
-            *(itdata + g.offset+i) = std::max(_vtrajdata[offset+i], _vtrajdata[_spec.GetDOF()+offset+i]);
+            *(itdata + g.offset+i) = std::max(_trajdata[offset+i], _trajdata[_spec.GetDOF()+offset+i]);
         }
     }
 
@@ -1681,9 +2358,9 @@ protected:
         int derivoffset = _vderivoffsets[g.offset];
         if( derivoffset >= 0 ) {
             for(int i = 0; i < g.dof; ++i) {
-                dReal deriv0 = _vtrajdata[_spec.GetDOF()+offset+derivoffset+i];
-                dReal expected = _vtrajdata[offset+g.offset+i] + deltatime*deriv0;
-                dReal error = RaveFabs(_vtrajdata[_spec.GetDOF()+offset+g.offset+i] - expected);
+                dReal deriv0 = _trajdata[_spec.GetDOF()+offset+derivoffset+i];
+                dReal expected = _trajdata[offset+g.offset+i] + deltatime*deriv0;
+                dReal error = RaveFabs(_trajdata[_spec.GetDOF()+offset+g.offset+i] - expected);
                 if( RaveFabs(error-2*PI) > g_fEpsilonLinear ) { // TODO, officially track circular joints
                     OPENRAVE_ASSERT_OP_FORMAT(error,<=,g_fEpsilonLinear, "trajectory segment for group %s interpolation %s points %d-%d dof %d is invalid", g.name%g.interpolation%ipoint%(ipoint+1)%i, ORE_InvalidState);
                 }
@@ -1699,10 +2376,10 @@ protected:
             if( derivoffset >= 0 ) {
                 for(int i = 0; i < g.dof; ++i) {
                     // coeff*t^2 + deriv0*t + pos0
-                    dReal deriv0 = _vtrajdata[offset+derivoffset+i];
-                    dReal coeff = 0.5*_vdeltainvtime.at(ipoint+1)*(_vtrajdata[_spec.GetDOF()+offset+derivoffset+i]-deriv0);
-                    dReal expected = _vtrajdata[offset+g.offset+i] + deltatime*(deriv0 + deltatime*coeff);
-                    dReal error = RaveFabs(_vtrajdata.at(_spec.GetDOF()+offset+g.offset+i)-expected);
+                    dReal deriv0 = _trajdata[offset+derivoffset+i];
+                    dReal coeff = 0.5*_deltainvtime.at(ipoint+1)*(_trajdata[_spec.GetDOF()+offset+derivoffset+i]-deriv0);
+                    dReal expected = _trajdata[offset+g.offset+i] + deltatime*(deriv0 + deltatime*coeff);
+                    dReal error = RaveFabs(_trajdata.at(_spec.GetDOF()+offset+g.offset+i)-expected);
                     if( RaveFabs(error-2*PI) > 1e-5 ) { // TODO, officially track circular joints
                         OPENRAVE_ASSERT_OP_FORMAT(error,<=,1e-4, "trajectory segment for group %s interpolation %s time %f points %d-%d dof %d is invalid", g.name%g.interpolation%deltatime%ipoint%(ipoint+1)%i, ORE_InvalidState);
                     }
@@ -1733,6 +2410,147 @@ protected:
     {
     }
 
+    /// \brief returns the index of the first accumulated time that is not less than time, same as std::lower_bound.
+    ///
+    /// The search starts from the segment found by the previous call of the same thread, so sampling at increasing times is amortized constant time.
+    /// The cursor is only a hint that is validated against _accumtime, so it does not matter which trajectory the thread sampled before.
+    size_t _FindSegmentIndex(dReal time) const
+    {
+        static thread_local size_t s_nsamplecursor = 0;
+        const size_t numtimes = _accumtime.size();
+        size_t index = s_nsamplecursor;
+        if( index < numtimes && (index == 0 || _accumtime[index-1] < time) ) {
+            // time is after the previous segment, so look at the next few segments before falling back to a binary search
+            for(const size_t endindex = std::min(numtimes, index+4); index < endindex; ++index) {
+                if( _accumtime[index] >= time ) {
+                    s_nsamplecursor = index;
+                    return index;
+                }
+            }
+        }
+        index = std::lower_bound(_accumtime.begin(),_accumtime.end(),time)-_accumtime.begin();
+        s_nsamplecursor = index;
+        return index;
+    }
+
+    /// \brief samples the trajectory at time into the _spec.GetDOF() values at itdata. _ComputeInternal has to be called before.
+    void _SampleInternal(dReal time, std::vector<dReal>::iterator itdata) const
+    {
+        if( time >= GetDuration() ) {
+            std::copy(_trajdata.end()-_spec.GetDOF(),_trajdata.end(),itdata);
+            return;
+        }
+        const size_t index = _FindSegmentIndex(time);
+        if( index == 0 ) {
+            std::copy(_trajdata.begin(),_trajdata.begin()+_spec.GetDOF(),itdata);
+            *(itdata + _timeoffset) = time;
+            return;
+        }
+        dReal deltatime = time-_accumtime.at(index-1);
+        dReal waypointdeltatime = _trajdata.at(_spec.GetDOF()*index + _timeoffset);
+        // unfortunately due to floating-point error deltatime might not be in the range [0, waypointdeltatime], so double check!
+        if( deltatime < 0 ) {
+            // most likely small epsilon
+            deltatime = 0;
+        }
+        else if( deltatime > waypointdeltatime ) {
+            deltatime = waypointdeltatime;
+        }
+        for(size_t i = 0; i < _vgroupinterpolators.size(); ++i) {
+            if( !!_vgroupinterpolators[i] ) {
+                _vgroupinterpolators[i](index-1,deltatime,itdata);
+            }
+        }
+        // should return the sample time relative to the last endpoint so it is easier to re-insert in the trajectory
+        *(itdata + _timeoffset) = deltatime;
+    }
+
+    /// \brief samples the trajectory at numtimes times into itdata, which has to hold numtimes*_spec.GetDOF() values. _ComputeInternal has to be called before.
+    ///
+    /// Consecutive times inside the same segment are evaluated together: the polynomial coefficients of every group are computed once per segment and
+    /// evaluated for all dofs at every time. Groups without _vgrouppolynomials are sampled with their interpolator.
+    void _SampleBulk(const dReal* ptimes, size_t numtimes, std::vector<dReal>::iterator itdata) const
+    {
+        // thread local so that a trajectory can be sampled from several threads
+        static thread_local std::vector<dReal> s_vbulkdeltatimes, s_vbulkcoeffs;
+        const int dof = _spec.GetDOF();
+        const dReal duration = GetDuration();
+        size_t itime = 0;
+        while( itime < numtimes ) {
+            const dReal time = ptimes[itime];
+            if( time >= duration ) {
+                std::copy(_trajdata.end()-dof,_trajdata.end(),itdata+itime*dof);
+                ++itime;
+                continue;
+            }
+            const size_t index = _FindSegmentIndex(time);
+            if( index == 0 ) {
+                _SampleInternal(time, itdata+itime*dof);
+                ++itime;
+                continue;
+            }
+
+            // gather all the following times inside the same segment
+            const dReal starttime = _accumtime[index-1], endtime = std::min(_accumtime[index], duration);
+            const dReal waypointdeltatime = _trajdata[dof*index + _timeoffset];
+            s_vbulkdeltatimes.resize(0);
+            for(size_t inext = itime; inext < numtimes && ptimes[inext] > starttime && ptimes[inext] <= endtime && ptimes[inext] < duration; ++inext) {
+                // unfortunately due to floating-point error deltatime might not be in the range [0, waypointdeltatime], so double check!
+                s_vbulkdeltatimes.push_back(std::max(dReal(0), std::min(ptimes[inext]-starttime, waypointdeltatime)));
+            }
+            const size_t numsegmenttimes = s_vbulkdeltatimes.size();
+            BOOST_ASSERT(numsegmenttimes > 0);
+            std::vector<dReal>::iterator itsegmentdata = itdata+itime*dof;
+            for(size_t igroup = 0; igroup < _vgroupinterpolators.size(); ++igroup) {
+                if( !_vgroupinterpolators[igroup] ) {
+                    continue;
+                }
+                const ConfigurationSpecification::Group& g = _spec._vgroups[igroup];
+                int order = -1;
+                if( !!_vgrouppolynomials[igroup] ) {
+                    s_vbulkcoeffs.resize(6*g.dof);
+                    order = _vgrouppolynomials[igroup](index-1, s_vbulkcoeffs.data());
+                }
+                if( order >= 0 ) {
+                    _EvaluatePolynomials(s_vbulkcoeffs.data(), order, g.dof, s_vbulkdeltatimes.data(), numsegmenttimes, itsegmentdata+g.offset);
+                }
+                else {
+                    for(size_t i = 0; i < numsegmenttimes; ++i) {
+                        _vgroupinterpolators[igroup](index-1, s_vbulkdeltatimes[i], itsegmentdata+i*dof);
+                    }
+                }
+            }
+            for(size_t i = 0; i < numsegmenttimes; ++i) {
+                // should return the sample time relative to the last endpoint so it is easier to re-insert in the trajectory
+                *(itsegmentdata+i*dof+_timeoffset) = s_vbulkdeltatimes[i];
+            }
+            itime += numsegmenttimes;
+        }
+    }
+
+    /// \brief evaluates the polynomials computed by _vgrouppolynomials at the numtimes delta times of pdeltatimes into the successive points at itdata
+    void _EvaluatePolynomials(const dReal* pcoeffs, int order, int groupdof, const dReal* pdeltatimes, size_t numtimes, std::vector<dReal>::iterator itdata) const
+    {
+        const int dof = _spec.GetDOF();
+        for(size_t itime = 0; itime < numtimes; ++itime) {
+            dReal* pvalues = &(*(itdata+itime*dof));
+            const dReal deltatime = pdeltatimes[itime];
+            if( deltatime <= g_fEpsilon ) {
+                std::copy(pcoeffs, pcoeffs+groupdof, pvalues);
+                continue;
+            }
+            // horner's method with the dofs in the inner loop so that it can be vectorized
+            const dReal* pcoeffsorder = pcoeffs+order*groupdof;
+            std::copy(pcoeffsorder, pcoeffsorder+groupdof, pvalues);
+            for(int j = order-1; j >= 0; --j) {
+                const dReal* pcoeffsj = pcoeffs+j*groupdof;
+                for(int i = 0; i < groupdof; ++i) {
+                    pvalues[i] = pcoeffsj[i] + deltatime*pvalues[i];
+                }
+            }
+        }
+    }
+
     void _SampleRangeSameDeltaTime(std::vector<dReal>& data, dReal deltatime, dReal startTime, dReal stopTime, bool ensureLastPoint) const
     {
         BOOST_ASSERT(_bInit);
@@ -1741,12 +2559,11 @@ protected:
         OPENRAVE_ASSERT_OP_FORMAT0(stopTime,>=,startTime, "stop time needs to be at least start time", ORE_InvalidArguments);
 
         _ComputeInternal();
-        OPENRAVE_ASSERT_OP_FORMAT0((int)_vtrajdata.size(),>=,_spec.GetDOF(), "trajectory needs at least one point to sample from", ORE_InvalidArguments);
+        OPENRAVE_ASSERT_OP_FORMAT0((int)_trajdata.size(),>=,_spec.GetDOF(), "trajectory needs at least one point to sample from", ORE_InvalidArguments);
         if( IS_DEBUGLEVEL(Level_Verbose) || (RaveGetDebugLevel() & Level_VerifyPlans) ) {
             _VerifySampling();
         }
 
-        const dReal trajDuration = GetDuration();
         int numPoints = 0;
         {
             const dReal duration = stopTime - startTime;
@@ -1759,65 +2576,37 @@ protected:
         //std::vector<dReal> dataPerTimestep(dof,0);
         data.resize(dof*numPoints);
 
-        const std::vector<dReal>::const_iterator begin = _vaccumtime.begin();
-        std::vector<dReal>::const_iterator it = begin;
-
-        std::vector<dReal>::iterator itdata = data.begin();
-
-        for(int i = 0; i < (ensureLastPoint ? numPoints-1 : numPoints); ++i, itdata += dof) {
-            const dReal sampletime = startTime + i * deltatime;
-            if( sampletime >= trajDuration ) {
-                std::copy(_vtrajdata.end() - _spec.GetDOF(), _vtrajdata.end(), itdata);
-            }
-            else {
-                // knowing time always increases, it is safe to search in [it, end] instead of [begin, end]
-                it = std::lower_bound(it, _vaccumtime.cend(), sampletime);
-
-                if( it == begin ) {
-                    std::copy(_vtrajdata.begin(),_vtrajdata.begin()+_spec.GetDOF(),itdata);
-                    *(itdata + _timeoffset) = sampletime;
-                }
-                else {
-                    size_t index = it - begin;
-                    dReal timeFromLowerWaypoint = sampletime - _vaccumtime.at(index-1);
-                    dReal waypointdeltatime = _vtrajdata.at(_spec.GetDOF()*index + _timeoffset);
-                    // unfortunately due to floating-point error timeFromLowerWaypoint might not be in the range [0, waypointdeltatime], so double check!
-                    if( timeFromLowerWaypoint < 0 ) {
-                        // most likely small epsilon
-                        timeFromLowerWaypoint = 0;
-                    }
-                    else if( timeFromLowerWaypoint > waypointdeltatime ) {
-                        timeFromLowerWaypoint = waypointdeltatime;
-                    }
-                    for(size_t j = 0; j < _vgroupinterpolators.size(); ++j) {
-                        if( !!_vgroupinterpolators[j] ) {
-                            _vgroupinterpolators[j](index-1, timeFromLowerWaypoint, itdata);
-                        }
-                    }
-                    // should return the sample time relative to the last endpoint so it is easier to re-insert in the trajectory
-                    *(itdata + _timeoffset) = timeFromLowerWaypoint;
-                }
-            }
+        const int numSampledPoints = ensureLastPoint ? numPoints-1 : numPoints;
+        std::vector<dReal> vtimes(numSampledPoints);
+        for(int i = 0; i < numSampledPoints; ++i) {
+            vtimes[i] = startTime + i * deltatime;
         }
+        _SampleBulk(vtimes.data(), vtimes.size(), data.begin());
 
         if (ensureLastPoint) {
-            // copy the last point, itdata should point to that
-            std::copy(_vtrajdata.end() - _spec.GetDOF(), _vtrajdata.end(), itdata);
+            // copy the last point
+            std::copy(_trajdata.end() - _spec.GetDOF(), _trajdata.end(), data.begin() + numSampledPoints*dof);
         }
     }
 
     ConfigurationSpecification _spec;
     std::vector< boost::function<void(size_t,dReal,const std::vector<dReal>::iterator&)> > _vgroupinterpolators;
+    std::vector< boost::function<int(size_t,dReal*)> > _vgrouppolynomials; ///< for every group, computes the polynomial coefficients of a segment for bulk sampling, see _ComputeQuadraticCoefficients. Empty if the group is always sampled with _vgroupinterpolators
     std::vector< boost::function<void(size_t,dReal)> > _vgroupvalidators;
     std::vector<int> _vderivoffsets, _vddoffsets, _vdddoffsets; ///< for every group that relies on other info to compute its position, this will point to the derivative offset. -1 if invalid and not needed, -2 if invalid and needed
     std::vector<int> _vintegraloffsets, _viioffsets; ///< for every group that relies on other info to compute its position, this will point to the integral offset (ie the position for a velocity group). -1 if invalid and not needed, -2 if invalid and needed
     int _timeoffset;
 
-    std::vector<dReal> _vtrajdata;
-    mutable std::vector<dReal> _vaccumtime, _vdeltainvtime;
+    mutable std::vector<dReal> _vaccumtime, _vdeltainvtime; ///< always read through _accumtime and _deltainvtime
+    mutable TrajectoryDataView _trajdata, _accumtime, _deltainvtime; ///< views of the waypoints and time index, pointing either into _ptrajdata and the vectors above or into _pmappedfile
+    MappedTrajectoryFilePtr _pmappedfile; ///< if set, the file the data views point into
+    boost::shared_ptr< std::vector<dReal> > _ptrajdata; ///< the waypoints, never null and empty when _pmappedfile is set. Shared with the trajectories cloned from or into this one and only modified through _GetWritableTrajData. Always read through _trajdata.
+    dReal _fCompressionTolerance; ///< the waypoints written with TSO_SerializeCompressed are quantized to this, 0 if exact
     bool _bInit;
     mutable bool _bChanged; ///< if true, then _ComputeInternal() has to be called in order to compute _vaccumtime and _vdeltainvtime
     mutable bool _bSamplingVerified; ///< if false, then _VerifySampling() has not be called yet to verify that all points can be sampled.
+    mutable uint64_t _datahash; ///< cached result of GetDataHash, only valid if _bDataHashValid is true
+    mutable bool _bDataHashValid; ///< if false, _datahash has to be recomputed since the waypoints or _spec changed
 };
 
 TrajectoryBasePtr CreateGenericTrajectory(EnvironmentBasePtr penv, std::istream& sinput)
@@ -0,0 +1,106 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2022 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "jsondocumentcache.h"
+#include "stringutils.h"
+
+#include <openrave/openravemsgpack.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sys/stat.h>
+
+namespace OpenRAVE {
+
+JSONDocumentCache& JSONDocumentCache::GetInstance()
+{
+    static JSONDocumentCache s_cache;
+    return s_cache;
+}
+
+boost::shared_ptr<const rapidjson::Document> JSONDocumentCache::GetDocument(const std::string& fullFilename, const std::string& cacheDir, const LoadDocumentFn& loadfn)
+{
+    struct stat filestat;
+    if( ::stat(fullFilename.c_str(), &filestat) != 0 ) {
+        return boost::shared_ptr<const rapidjson::Document>();
+    }
+    const uint64_t size = filestat.st_size;
+    const int64_t modifiedTime = filestat.st_mtime;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::map<std::string, DocumentEntry>::const_iterator it = _mapDocuments.find(fullFilename);
+        if( it != _mapDocuments.end() && it->second.size == size && it->second.modifiedTime == modifiedTime ) {
+            return it->second.pDoc;
+        }
+    }
+
+    // the documents own their allocator since they outlive the reader that loaded them
+    boost::shared_ptr<rapidjson::Document> pNewDoc(new rapidjson::Document());
+    std::string cacheFilename;
+    if( !cacheDir.empty() && !StringEndsWith(fullFilename, ".gpg") ) {
+        cacheFilename = cacheDir + "/" + utils::GetMD5HashString(str(boost::format("%s:%d:%d")%fullFilename%size%modifiedTime)) + ".msgpack";
+    }
+
+    bool bLoaded = false;
+    if( !cacheFilename.empty() ) {
+        std::ifstream ifs(cacheFilename.c_str(), std::ios::binary);
+        if( ifs.good() ) {
+            try {
+                MsgPack::ParseMsgPack(*pNewDoc, ifs);
+                bLoaded = true;
+                RAVELOG_VERBOSE_FORMAT("loaded '%s' from document cache '%s'", fullFilename%cacheFilename);
+            }
+            catch(const std::exception& ex) {
+                RAVELOG_WARN_FORMAT("failed to read document cache '%s' of '%s', parsing the file instead: %s", cacheFilename%fullFilename%ex.what());
+            }
+        }
+    }
+    if( !bLoaded ) {
+        loadfn(*pNewDoc);
+        if( !cacheFilename.empty() ) {
+            // write to a temporary file first so that other processes never read a partial entry
+            const std::string tempFilename = str(boost::format("%s.%d.tmp")%cacheFilename%utils::GetMicroTime());
+            try {
+                {
+                    std::ofstream ofs(tempFilename.c_str(), std::ios::binary);
+                    MsgPack::DumpMsgPack(*pNewDoc, ofs);
+                }
+                if( std::rename(tempFilename.c_str(), cacheFilename.c_str()) != 0 ) {
+                    std::remove(tempFilename.c_str());
+                }
+            }
+            catch(const std::exception& ex) {
+                RAVELOG_DEBUG_FORMAT("failed to write document cache '%s' of '%s': %s", cacheFilename%fullFilename%ex.what());
+                std::remove(tempFilename.c_str());
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    DocumentEntry& entry = _mapDocuments[fullFilename];
+    entry.size = size;
+    entry.modifiedTime = modifiedTime;
+    entry.pDoc = pNewDoc;
+    return entry.pDoc;
+}
+
+void JSONDocumentCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _mapDocuments.clear();
+}
+
+} // end namespace OpenRAVE
@@ -0,0 +1,66 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2022 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+/** \file jsondocumentcache.h
+    \brief Process-wide and on-disk cache of the parsed documents of jsonreader
+ */
+
+#ifndef OPENRAVE_JSON_DOCUMENT_CACHE_H
+#define OPENRAVE_JSON_DOCUMENT_CACHE_H
+
+#include "jsoncommon.h"
+
+#include <mutex>
+
+namespace OpenRAVE {
+
+/// \brief caches the parsed documents of local files across all the readers of the process, and optionally on disk across processes.
+///
+/// An entry is valid as long as the size and the modification time of its file do not change. On disk, the documents are stored as msgpack
+/// in files named after the md5 of the filename, size and modification time, so a changed file never reads a stale entry. Documents of
+/// encrypted files are only cached in memory.
+class JSONDocumentCache
+{
+public:
+    /// \brief fills the passed in document by parsing the file
+    typedef boost::function<void (rapidjson::Document&)> LoadDocumentFn;
+
+    static JSONDocumentCache& GetInstance();
+
+    /// \brief returns the cached document of fullFilename, or loads it with loadfn and caches it
+    ///
+    /// \param cacheDir directory of the on-disk cache, empty to only cache in memory
+    /// \return the document, which owns its allocator. null if the file does not exist
+    boost::shared_ptr<const rapidjson::Document> GetDocument(const std::string& fullFilename, const std::string& cacheDir, const LoadDocumentFn& loadfn);
+
+    /// \brief removes all the documents cached in memory
+    void Clear();
+
+private:
+    struct DocumentEntry
+    {
+        uint64_t size = 0;
+        int64_t modifiedTime = 0;
+        boost::shared_ptr<const rapidjson::Document> pDoc;
+    };
+
+    std::mutex _mutex; ///< protects _mapDocuments
+    std::map<std::string, DocumentEntry> _mapDocuments; ///< full filename -> document
+};
+
+} // end namespace OpenRAVE
+
+#endif
@@ -87,6 +87,12 @@ JSONDownloader::JSONDownloader(std::map<std::string, boost::shared_ptr<const rap
         throw OPENRAVE_EXCEPTION_FORMAT0("failed to create curl handle", ORE_CurlInvalidHandle);
     }
 
+    // let the downloads to the same server share one HTTP/2 connection
+    const CURLMcode pipeliningCode = curl_multi_setopt(_curlm, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    if (pipeliningCode) {
+        RAVELOG_DEBUG_FORMAT("failed to enable HTTP/2 multiplexing, curl_multi_setopt() failed with code %d", (int)pipeliningCode);
+    }
+
     _userAgent = boost::str(boost::format("OpenRAVE/%s")%OPENRAVE_VERSION_STRING);
 }
 
@@ -117,13 +123,20 @@ void JSONDownloaderScope::Download(const char* pUri, rapidjson::Document& doc, u
 
 void JSONDownloaderScope::WaitForDownloads(uint64_t timeoutUS)
 {
-    if (_mapDownloadContexts.empty()) {
+    if (_mapDownloadContexts.empty() && !_pParsingContext) {
         return;
     }
 
     const uint64_t startTimestampUS = utils::GetMonotonicTime();
-    int numDownloads = 0;
-    while (!_mapDownloadContexts.empty()) {
+    const size_t numTimingsBefore = _vDownloadTimings.size();
+    std::vector<std::string> vDiscoveredUris;
+    while (!_mapDownloadContexts.empty() || !!_pParsingContext) {
+        if (_mapDownloadContexts.empty()) {
+            // nothing is transferring, so only the parse can queue more downloads
+            _FinishParse();
+            continue;
+        }
+
         // check if any handle still running
         int numRunningHandles = 0;
         const CURLMcode performCode = curl_multi_perform(_downloader._curlm, &numRunningHandles);
@@ -131,7 +144,21 @@ void JSONDownloaderScope::WaitForDownloads(uint64_t timeoutUS)
             throw OPENRAVE_EXCEPTION_FORMAT("failed to download, curl_multi_perform() failed with code %d", (int)performCode, ORE_CurlInvalidHandle);
         }
         RAVELOG_VERBOSE_FORMAT("curl_multi_perform(): numRunningHandles = %d", numRunningHandles);
-        if (numRunningHandles > 0) {
+
+        // prefetch the references found in the data received so far. handles cannot be added from the curl callbacks
+        vDiscoveredUris.clear();
+        for (std::map<CURL*, JSONDownloadContextPtr>::value_type& contextPair : _mapDownloadContexts) {
+            std::vector<std::string>& vContextDiscoveredUris = contextPair.second->vDiscoveredUris;
+            vDiscoveredUris.insert(vDiscoveredUris.end(), vContextDiscoveredUris.begin(), vContextDiscoveredUris.end());
+            vContextDiscoveredUris.clear();
+        }
+        for (const std::string& discoveredUri : vDiscoveredUris) {
+            if (_IsExpandableReferenceUri(discoveredUri.c_str())) {
+                _QueueDownloadURI(discoveredUri.c_str(), nullptr, true);
+            }
+        }
+
+        if (numRunningHandles > 0 && vDiscoveredUris.empty()) {
             // poll for 100ms
             const CURLMcode pollCode = curl_multi_poll(_downloader._curlm, NULL, 0, 100, NULL);
             if (pollCode) {
@@ -190,38 +217,165 @@ void JSONDownloaderScope::WaitForDownloads(uint64_t timeoutUS)
                 throw OPENRAVE_EXCEPTION_FORMAT("failed to download uri \"%s\", received http %d response", pContext->uri%responseCode, ORE_CurlInvalidResponse);
             }
 
-            // parse data
-            _ParseDocument(pContext);
-
-            RAVELOG_DEBUG_FORMAT("successfully downloaded \"%s\", took %d[us]", pContext->uri%(currentTimestampUS-pContext->startTimestampUS));
-            ++numDownloads;
+            // the references left in the data are queued before parsing since the parse can take a while
+            for (const std::string& discoveredUri : pContext->vDiscoveredUris) {
+                if (_IsExpandableReferenceUri(discoveredUri.c_str())) {
+                    _QueueDownloadURI(discoveredUri.c_str(), nullptr, true);
+                }
+            }
+            pContext->vDiscoveredUris.clear();
 
-            // reuse the context object later
-            const rapidjson::Document& doc = *pContext->pDoc;
-            pContext->pDoc = nullptr;
-            pContext->buffer.clear();
-            _downloader._vDownloadContextPool.emplace_back();
-            _downloader._vDownloadContextPool.back().swap(pContext);
+            pContext->downloadedTimestampUS = utils::GetMonotonicTime();
+            _StartParse(pContext);
+        }
 
-            // queue other resources to be downloaded
-            if (_downloadRecursively) {
-                QueueDownloadReferenceURIs(doc);
-            }
+        if (!!_pParsingContext && _parseFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            _FinishParse();
         }
     }
 
     const uint64_t stopTimestampUS = utils::GetMonotonicTime();
-    RAVELOG_DEBUG_FORMAT("downloaded %d files, took %d[us]", numDownloads%(stopTimestampUS-startTimestampUS));
+    RAVELOG_DEBUG_FORMAT("downloaded %d files, took %d[us]", (_vDownloadTimings.size() - numTimingsBefore)%(stopTimestampUS-startTimestampUS));
+}
+
+void JSONDownloaderScope::_StartParse(JSONDownloadContextPtr pContext)
+{
+    if (!!_pParsingContext) {
+        _FinishParse();
+    }
+    // documents share _alloc, so only one of them is parsed at a time
+    _pParsingContext = pContext;
+    _parseFuture = std::async(std::launch::async, [pContext]() {
+        _ParseDocument(pContext);
+    });
+}
+
+void JSONDownloaderScope::_FinishParse()
+{
+    JSONDownloadContextPtr pContext;
+    pContext.swap(_pParsingContext);
+    _parseFuture.get(); // rethrows the parse errors
+
+    const uint64_t parsedTimestampUS = utils::GetMonotonicTime();
+    JSONDownloadTiming timing;
+    timing.uri = pContext->uri;
+    timing.numBytes = pContext->buffer.size();
+    timing.downloadDurationUS = pContext->downloadedTimestampUS - pContext->startTimestampUS;
+    timing.parseDurationUS = parsedTimestampUS - pContext->downloadedTimestampUS;
+    timing.bPrefetched = pContext->bPrefetched;
+    RAVELOG_DEBUG_FORMAT("successfully downloaded \"%s\" (%d bytes, prefetched=%d), download took %d[us], parse took %d[us]", timing.uri%timing.numBytes%timing.bPrefetched%timing.downloadDurationUS%timing.parseDurationUS);
+    _vDownloadTimings.push_back(timing);
+
+    // reuse the context object later
+    const rapidjson::Document& doc = *pContext->pDoc;
+    pContext->pDoc = nullptr;
+    pContext->buffer.clear();
+    _downloader._vDownloadContextPool.emplace_back();
+    _downloader._vDownloadContextPool.back().swap(pContext);
+
+    // queue other resources to be downloaded, most of them are already queued by the scan
+    if (_downloadRecursively) {
+        QueueDownloadReferenceURIs(doc);
+    }
+}
+
+static const char s_referenceUriKey[] = "referenceUri";
+
+/// \brief finds the referenceUri values in the part of the buffer received since the last scan
+///
+/// Only matches the values that are plain strings, anything else is left to QueueDownloadReferenceURIs once the document is parsed.
+static void _ScanReferenceUris(JSONDownloadContext& context)
+{
+    const std::string& buffer = context.buffer;
+    const size_t keyLength = sizeof(s_referenceUriKey) - 1;
+    while (true) {
+        const size_t keyPos = buffer.find(s_referenceUriKey, context.scanOffset, keyLength);
+        if (keyPos == std::string::npos) {
+            // the key can be split across two chunks
+            if (buffer.size() > keyLength) {
+                context.scanOffset = std::max(context.scanOffset, buffer.size() - keyLength);
+            }
+            return;
+        }
+
+        size_t pos = keyPos + keyLength;
+        size_t valuePos = 0, valueLength = 0;
+        bool bValue = false;
+        if (context.bMsgPack) {
+            // the key is a fixstr of 12 characters, the value a str8, str16 or fixstr
+            if (keyPos > 0 && (uint8_t)buffer[keyPos-1] == (0xa0|keyLength)) {
+                if (pos >= buffer.size()) {
+                    context.scanOffset = keyPos;
+                    return;
+                }
+                const uint8_t header = buffer[pos];
+                size_t headerLength = 1;
+                if ((header & 0xe0) == 0xa0) {
+                    valueLength = header & 0x1f;
+                    bValue = true;
+                }
+                else if (header == 0xd9 || header == 0xda) {
+                    headerLength = header == 0xd9 ? 2 : 3;
+                    if (pos + headerLength > buffer.size()) {
+                        context.scanOffset = keyPos;
+                        return;
+                    }
+                    valueLength = header == 0xd9 ? (uint8_t)buffer[pos+1] : (((size_t)(uint8_t)buffer[pos+1]) << 8)|(uint8_t)buffer[pos+2];
+                    bValue = true;
+                }
+                valuePos = pos + headerLength;
+            }
+        }
+        else if (keyPos > 0 && buffer[keyPos-1] == '"') {
+            // "referenceUri" : "value"
+            size_t quotePos = buffer.find_first_not_of(" \t\r\n", pos);
+            if (quotePos != std::string::npos && buffer[quotePos] == '"') {
+                quotePos = buffer.find_first_not_of(" \t\r\n", quotePos+1);
+                if (quotePos != std::string::npos && buffer[quotePos] == ':') {
+                    quotePos = buffer.find_first_not_of(" \t\r\n", quotePos+1);
+                    if (quotePos != std::string::npos && buffer[quotePos] == '"') {
+                        valuePos = quotePos + 1;
+                        const size_t endQuotePos = buffer.find('"', valuePos);
+                        if (endQuotePos == std::string::npos) {
+                            context.scanOffset = keyPos;
+                            return;
+                        }
+                        valueLength = endQuotePos - valuePos;
+                        bValue = buffer.find('\\', valuePos) >= endQuotePos; // escaped values are left to the parse
+                    }
+                }
+            }
+            if (quotePos == std::string::npos) {
+                context.scanOffset = keyPos;
+                return;
+            }
+        }
+
+        if (bValue) {
+            if (valuePos + valueLength > buffer.size()) {
+                context.scanOffset = keyPos;
+                return;
+            }
+            if (valueLength > 0) {
+                context.vDiscoveredUris.emplace_back(buffer, valuePos, valueLength);
+            }
+            pos = valuePos + valueLength;
+        }
+        context.scanOffset = pos;
+    }
 }
 
 static size_t _WriteBackDataFromCurl(const char *data, size_t size, size_t dataSize, JSONDownloadContext* pContext)
 {
     const size_t numBytes = size * dataSize;
     pContext->buffer.append(data, numBytes);
+    if (pContext->bScanReferenceUris) {
+        _ScanReferenceUris(*pContext);
+    }
     return numBytes;
 }
 
-void JSONDownloaderScope::_QueueDownloadURI(const char* pUri, rapidjson::Document* pDoc)
+void JSONDownloaderScope::_QueueDownloadURI(const char* pUri, rapidjson::Document* pDoc, bool bPrefetched)
 {
     if( !pUri[0] ) {
         return;
@@ -276,6 +430,12 @@ void JSONDownloaderScope::_QueueDownloadURI(const char* pUri, rapidjson::Documen
     pContext->uri = canonicalUri;
     pContext->pDoc = pDoc;
     pContext->startTimestampUS = utils::GetMonotonicTime();
+    pContext->downloadedTimestampUS = 0;
+    pContext->bMsgPack = StringEndsWith(canonicalUri, ".msgpack");
+    pContext->bScanReferenceUris = _downloadRecursively && (pContext->bMsgPack || StringEndsWith(canonicalUri, ".json"));
+    pContext->bPrefetched = bPrefetched;
+    pContext->scanOffset = 0;
+    pContext->vDiscoveredUris.clear();
 
     // set curl options
     CURLcode curlCode;
@@ -299,6 +459,15 @@ void JSONDownloaderScope::_QueueDownloadURI(const char* pUri, rapidjson::Documen
     if (curlCode != CURLE_OK) {
         throw OPENRAVE_EXCEPTION_FORMAT("failed to curl_easy_setopt(CURLOPT_URL) for uri \"%s\": %s", canonicalUri%curl_easy_strerror(curlCode), ORE_CurlInvalidHandle);
     }
+    curlCode = curl_easy_setopt(pContext->curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    if (curlCode != CURLE_OK) {
+        // older curl without HTTP/2 support, stay on HTTP/1.1
+        RAVELOG_VERBOSE_FORMAT("failed to curl_easy_setopt(CURLOPT_HTTP_VERSION) for uri \"%s\": %s", canonicalUri%curl_easy_strerror(curlCode));
+    }
+    curlCode = curl_easy_setopt(pContext->curl, CURLOPT_PIPEWAIT, 1);
+    if (curlCode != CURLE_OK) {
+        RAVELOG_VERBOSE_FORMAT("failed to curl_easy_setopt(CURLOPT_PIPEWAIT) for uri \"%s\": %s", canonicalUri%curl_easy_strerror(curlCode));
+    }
     curlCode = curl_easy_setopt(pContext->curl, CURLOPT_HTTPGET, 1);
     if (curlCode != CURLE_OK) {
         throw OPENRAVE_EXCEPTION_FORMAT("failed to curl_easy_setopt(CURLOPT_HTTPGET) for uri \"%s\": %s", canonicalUri%curl_easy_strerror(curlCode), ORE_CurlInvalidHandle);
@@ -26,6 +26,7 @@
 #if OPENRAVE_CURL
 
 #include <curl/curl.h>
+#include <future>
 
 namespace OpenRAVE {
 
@@ -41,9 +42,26 @@ public:
     std::string buffer; ///< buffer used to receive downloaded data
     rapidjson::Document* pDoc = nullptr; ///< if non-null, the caller-supplied document to put results into
     uint64_t startTimestampUS = 0; ///< start timestamp in microseconds
+    uint64_t downloadedTimestampUS = 0; ///< timestamp in microseconds when the download finished
+
+    bool bScanReferenceUris = false; ///< if true, the buffer is scanned for referenceUri values while it is received so that they can be prefetched
+    bool bMsgPack = false; ///< if true, the buffer is msgpack, otherwise json
+    bool bPrefetched = false; ///< true if the download was started from a referenceUri discovered while receiving another document
+    size_t scanOffset = 0; ///< offset into buffer where the scan for referenceUri resumes
+    std::vector<std::string> vDiscoveredUris; ///< referenceUri values found by the scan that are not queued yet
 };
 typedef boost::shared_ptr<JSONDownloadContext> JSONDownloadContextPtr;
 
+/// \brief Timing of one downloaded uri
+struct JSONDownloadTiming
+{
+    std::string uri; ///< canonicalized uri of the download
+    size_t numBytes = 0; ///< size of the downloaded data
+    uint64_t downloadDurationUS = 0; ///< from queueing the download until all the data is received
+    uint64_t parseDurationUS = 0; ///< from receiving all the data until the document is parsed, includes waiting for the previous document to be parsed
+    bool bPrefetched = false; ///< true if the uri was discovered while receiving another document
+};
+
 /// \brief Downloader to download one or multiple uris and their references, used by JSONDownloaderScope to share keep-alive connections and other resources
 class JSONDownloader {
 public:
@@ -90,13 +108,28 @@ public:
     void QueueDownloadReferenceURIs(const rapidjson::Value& rEnvInfo);
 
     /// \brief Wait for queued downloads to finish, downloaded documents are inserted into rapidJSONDocuments passed in constructor
+    ///
+    /// When downloading recursively, the referenceUri values of the json and msgpack documents are queued as soon as they are received, and every
+    /// document is parsed on another thread while the network transfers continue.
     /// \param timeoutUS timeout in microseconds to wait for download to finish
     void WaitForDownloads(uint64_t timeoutUS = 10000000);
 
+    /// \brief Timings of all the uris downloaded in this scope, in the order they finished
+    const std::vector<JSONDownloadTiming>& GetDownloadTimings() const {
+        return _vDownloadTimings;
+    }
+
 protected: 
 
     /// \brief Queue uri to be downloaded, optionally supply a rapidjson document to be used to store result
-    void _QueueDownloadURI(const char* pUri, rapidjson::Document* pDoc);
+    /// \param bPrefetched true if the uri was discovered while receiving another document
+    void _QueueDownloadURI(const char* pUri, rapidjson::Document* pDoc, bool bPrefetched = false);
+
+    /// \brief starts parsing the downloaded document of pContext on another thread, after finishing the previous one
+    void _StartParse(JSONDownloadContextPtr pContext);
+
+    /// \brief waits for the document being parsed, records its timing, recycles its context and queues its references
+    void _FinishParse();
 
     /// \brief Returns true if the referenceUri is a valid URI that can be loaded
     bool _IsExpandableReferenceUri(const char* pReferenceUri) const;
@@ -108,6 +141,10 @@ protected:
     bool _downloadRecursively = true; ///< whether to recurse all referenced uris
 
     std::map<CURL*, JSONDownloadContextPtr> _mapDownloadContexts; ///< map from curl handle to download context
+
+    JSONDownloadContextPtr _pParsingContext; ///< context of the document being parsed by _parseFuture, null if none
+    std::future<void> _parseFuture; ///< parse of the document of _pParsingContext
+    std::vector<JSONDownloadTiming> _vDownloadTimings; ///< timings of the downloads done in this scope
 };
 
 }
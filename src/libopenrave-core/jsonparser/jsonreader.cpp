@@ -17,6 +17,8 @@
 #define RAPIDJSON_HAS_STDSTRING 1
 #include "jsoncommon.h"
 #include "stringutils.h"
+#include "jsondocumentcache.h"
+#include "../workerpool.h"
 
 #if OPENRAVE_CURL
 #include "jsondownloader.h"
@@ -29,8 +31,16 @@
 #include <rapidjson/istreamwrapper.h>
 #include <string>
 #include <fstream>
+#include <thread>
 #include <unordered_set>
 
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#ifdef OPENRAVE_HAS_ZSTD
+#include <zstd.h>
+#endif
+
 #ifdef HAVE_BOOST_FILESYSTEM
 #include <boost/filesystem/operations.hpp>
 #endif
@@ -52,24 +62,155 @@ static bool _ReplaceFilenameSuffix(std::string& filename, const std::string& old
     return false;
 }
 
-/// \brief open and cache a msgpack document
+#ifdef OPENRAVE_HAS_ZSTD
+/// \brief decompresses all the frames of a zstd file into vOutput
+///
+/// When every frame records its content size (zstd -T writes independent frames for large inputs), each frame is decompressed directly into its slice of the output in parallel. Otherwise the frames are streamed sequentially.
+static void _DecompressZstd(const std::string& filename, const uint8_t* pdata, size_t size, std::vector<uint8_t>& vOutput)
+{
+    OPENRAVE_TRACE_SCOPE("JSONReader::DecompressZstd");
+    struct ZstdFrame
+    {
+        size_t inputOffset, inputSize, outputOffset, outputSize;
+    };
+    std::vector<ZstdFrame> vFrames;
+    size_t inputOffset = 0, outputSize = 0;
+    bool bKnownContentSizes = true;
+    while( inputOffset < size ) {
+        const size_t frameSize = ZSTD_findFrameCompressedSize(pdata + inputOffset, size - inputOffset);
+        if( ZSTD_isError(frameSize) ) {
+            throw OPENRAVE_EXCEPTION_FORMAT("failed to read zstd frame at offset %d of '%s': %s", inputOffset%filename%ZSTD_getErrorName(frameSize), ORE_InvalidArguments);
+        }
+        const unsigned long long contentSize = ZSTD_getFrameContentSize(pdata + inputOffset, frameSize);
+        if( contentSize == ZSTD_CONTENTSIZE_ERROR ) {
+            throw OPENRAVE_EXCEPTION_FORMAT("invalid zstd frame header at offset %d of '%s'", inputOffset%filename, ORE_InvalidArguments);
+        }
+        if( contentSize == ZSTD_CONTENTSIZE_UNKNOWN ) {
+            bKnownContentSizes = false;
+            break;
+        }
+        vFrames.push_back({inputOffset, frameSize, outputSize, (size_t)contentSize});
+        inputOffset += frameSize;
+        outputSize += contentSize;
+    }
+
+    if( bKnownContentSizes ) {
+        vOutput.resize(outputSize);
+        std::vector<size_t> vResults(vFrames.size(), 0);
+        const std::function<void(size_t)> decompressFrame = [&](size_t iframe) {
+            const ZstdFrame& frame = vFrames[iframe];
+            vResults[iframe] = ZSTD_decompress(vOutput.data() + frame.outputOffset, frame.outputSize, pdata + frame.inputOffset, frame.inputSize);
+        };
+        const int numThreads = std::min((int)vFrames.size(), std::max(1, (int)std::thread::hardware_concurrency()));
+        if( numThreads > 1 ) {
+            WorkerPool pool(numThreads - 1);
+            pool.ParallelFor(vFrames.size(), decompressFrame);
+        }
+        else {
+            for(size_t iframe = 0; iframe < vFrames.size(); ++iframe) {
+                decompressFrame(iframe);
+            }
+        }
+        for(size_t iframe = 0; iframe < vFrames.size(); ++iframe) {
+            if( ZSTD_isError(vResults[iframe]) ) {
+                throw OPENRAVE_EXCEPTION_FORMAT("failed to decompress zstd frame %d of '%s': %s", iframe%filename%ZSTD_getErrorName(vResults[iframe]), ORE_InvalidArguments);
+            }
+            if( vResults[iframe] != vFrames[iframe].outputSize ) {
+                throw OPENRAVE_EXCEPTION_FORMAT("zstd frame %d of '%s' decompressed to %d bytes, expected %d", iframe%filename%vResults[iframe]%vFrames[iframe].outputSize, ORE_InvalidArguments);
+            }
+        }
+        return;
+    }
+
+    ZSTD_DCtx* pdctx = ZSTD_createDCtx();
+    if( !pdctx ) {
+        throw OPENRAVE_EXCEPTION_FORMAT("failed to create zstd context for '%s'", filename, ORE_Failed);
+    }
+    vOutput.clear();
+    const size_t chunkSize = ZSTD_DStreamOutSize();
+    ZSTD_inBuffer input = { pdata, size, 0 };
+    size_t ret = 0;
+    while(1) {
+        const size_t outputOffset = vOutput.size();
+        vOutput.resize(outputOffset + chunkSize);
+        ZSTD_outBuffer output = { vOutput.data() + outputOffset, chunkSize, 0 };
+        ret = ZSTD_decompressStream(pdctx, &output, &input);
+        vOutput.resize(outputOffset + output.pos);
+        if( ZSTD_isError(ret) ) {
+            ZSTD_freeDCtx(pdctx);
+            throw OPENRAVE_EXCEPTION_FORMAT("failed to decompress '%s': %s", filename%ZSTD_getErrorName(ret), ORE_InvalidArguments);
+        }
+        // a full output buffer means the decoder may still hold data even if all the input is consumed
+        if( input.pos == input.size && output.pos < output.size ) {
+            break;
+        }
+    }
+    ZSTD_freeDCtx(pdctx);
+    if( ret != 0 ) {
+        throw OPENRAVE_EXCEPTION_FORMAT("zstd file '%s' is truncated", filename, ORE_InvalidArguments);
+    }
+}
+#endif
+
+/// \brief read-only memory map of a document file. Files ending with .zst are decompressed into memory.
+///
+/// Mapping avoids the per-character reads of std::ifstream, which dominate the load time on network-mounted model directories.
+class DocumentFileBuffer
+{
+public:
+    DocumentFileBuffer(const std::string& filename)
+    {
+        try {
+            boost::interprocess::file_mapping mapping(filename.c_str(), boost::interprocess::read_only);
+            boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+            _region.swap(region);
+        }
+        catch(const boost::interprocess::interprocess_exception& ex) {
+            throw OPENRAVE_EXCEPTION_FORMAT("failed to open document file '%s': %s", filename%ex.what(), ORE_InvalidArguments);
+        }
+        if( StringEndsWith(filename, ".zst") ) {
+#ifdef OPENRAVE_HAS_ZSTD
+            _DecompressZstd(filename, static_cast<const uint8_t*>(_region.get_address()), _region.get_size(), _vDecompressed);
+            _bDecompressed = true;
+            boost::interprocess::mapped_region().swap(_region); // compressed data is not needed anymore
+#else
+            throw OPENRAVE_EXCEPTION_FORMAT("cannot open '%s' since openrave was compiled without zstd support", filename, ORE_NotImplemented);
+#endif
+        }
+    }
+
+    const char* GetData() const {
+        return _bDecompressed ? reinterpret_cast<const char*>(_vDecompressed.data()) : static_cast<const char*>(_region.get_address());
+    }
+    size_t GetSize() const {
+        return _bDecompressed ? _vDecompressed.size() : _region.get_size();
+    }
+
+private:
+    boost::interprocess::mapped_region _region; ///< the region stays valid after the file_mapping is closed
+    std::vector<uint8_t> _vDecompressed; ///< decompressed content of .zst files
+    bool _bDecompressed = false;
+};
+
+/// \brief open and cache a msgpack document, optionally zstd compressed (.msgpack.zst)
 static void OpenMsgPackDocument(const std::string& filename, rapidjson::Document& doc)
 {
-    std::ifstream ifs(filename.c_str());
+    OPENRAVE_TRACE_SCOPE("JSONReader::OpenMsgPackDocument");
+    DocumentFileBuffer buffer(filename);
     try {
-        MsgPack::ParseMsgPack(doc, ifs);
+        MsgPack::ParseMsgPack(doc, buffer.GetData(), buffer.GetSize());
     }
     catch(const std::exception& ex) {
         throw OPENRAVE_EXCEPTION_FORMAT("Failed to parse msgpack format for file '%s': %s", filename%ex.what(), ORE_Failed);
     }
 }
 
-/// \brief open and cache a json document
+/// \brief open and cache a json document, optionally zstd compressed (.json.zst)
 static void OpenRapidJsonDocument(const std::string& filename, rapidjson::Document& doc)
 {
-    std::ifstream ifs(filename.c_str());
-    rapidjson::IStreamWrapper isw(ifs);
-    rapidjson::ParseResult ok = doc.ParseStream<rapidjson::kParseFullPrecisionFlag>(isw);
+    OPENRAVE_TRACE_SCOPE("JSONReader::OpenRapidJsonDocument");
+    DocumentFileBuffer buffer(filename);
+    rapidjson::ParseResult ok = doc.Parse<rapidjson::kParseFullPrecisionFlag>(buffer.GetData(), buffer.GetSize());
     if (!ok) {
         throw OPENRAVE_EXCEPTION_FORMAT("failed to parse json document \"%s\"", filename, ORE_InvalidArguments);
     }
@@ -78,6 +219,7 @@ static void OpenRapidJsonDocument(const std::string& filename, rapidjson::Docume
 /// \brief open and cache an encrypted msgpack document
 static void OpenEncryptedMsgPackDocument(const std::string& filename, rapidjson::Document& doc)
 {
+    OPENRAVE_TRACE_SCOPE("JSONReader::OpenEncryptedMsgPackDocument");
     std::ifstream ifs(filename);
     std::stringstream ss;
     if (GpgDecrypt(ifs, ss)) {
@@ -93,6 +235,7 @@ static void OpenEncryptedMsgPackDocument(const std::string& filename, rapidjson:
 /// \brief open and cache an encrypted json document
 static void OpenEncryptedJSONDocument(const std::string& filename, rapidjson::Document& doc)
 {
+    OPENRAVE_TRACE_SCOPE("JSONReader::OpenEncryptedJSONDocument");
     std::ifstream ifs(filename);
     std::stringstream ss;
     if (GpgDecrypt(ifs, ss)) {
@@ -186,6 +329,13 @@ public:
             else if (itatt->first == "excludeBodyId") {
                 _excludeBodyIds.emplace(itatt->second);
             }
+            else if (itatt->first == "cachedocuments") {
+                _bCacheDocuments = _stricmp(itatt->second.c_str(), "true") == 0 || itatt->second=="1";
+            }
+            else if (itatt->first == "documentcachedir") {
+                _documentCacheDir = itatt->second;
+                _bCacheDocuments = !_documentCacheDir.empty();
+            }
         }
         if (_vOpenRAVESchemeAliases.size() == 0) {
             _vOpenRAVESchemeAliases.push_back("openrave");
@@ -216,6 +366,7 @@ public:
     /// \brief Extract all bodies and add them into environment
     bool ExtractAll(const rapidjson::Value& rEnvInfo, UpdateFromInfoMode updateMode, std::vector<KinBodyPtr>& vCreatedBodies, std::vector<KinBodyPtr>& vModifiedBodies, std::vector<KinBodyPtr>& vRemovedBodies, rapidjson::Document::AllocatorType& alloc)
     {
+        OPENRAVE_TRACE_SCOPE("JSONReader::ExtractAll");
         uint64_t starttimeus = utils::GetMonotonicTime();
         vCreatedBodies.clear();
         vModifiedBodies.clear();
@@ -393,6 +544,7 @@ public:
 
     bool ExtractFirst(const rapidjson::Value& rEnvInfo, KinBodyPtr& ppbody, rapidjson::Document::AllocatorType& alloc)
     {
+        OPENRAVE_TRACE_SCOPE("JSONReader::ExtractFirst");
         // If remote URL is provided, start the process to download everything and load it into the json map
         if (IsDownloadingFromRemote()) {
 #if OPENRAVE_CURL
@@ -415,6 +567,7 @@ public:
 
     bool ExtractOne(const rapidjson::Value& rEnvInfo, KinBodyPtr& ppbody, const string& uri, rapidjson::Document::AllocatorType& alloc)
     {
+        OPENRAVE_TRACE_SCOPE("JSONReader::ExtractOne");
         std::string scheme, path, fragment;
         ParseURI(uri.c_str(), scheme, path, fragment);
         if (fragment == "") {
@@ -525,32 +678,46 @@ protected:
         if (_rapidJSONDocuments.find(fullFilename) != _rapidJSONDocuments.end()) {
             doc = _rapidJSONDocuments[fullFilename];
         }
-        else if (!IsDownloadingFromRemote()) {
-            boost::shared_ptr<rapidjson::Document> newDoc;
-            if (StringEndsWith(fullFilename, ".json")) {
-                newDoc.reset(new rapidjson::Document(&alloc));
-                OpenRapidJsonDocument(fullFilename, *newDoc);
-            }
-            else if (StringEndsWith(fullFilename, ".msgpack")) {
-                newDoc.reset(new rapidjson::Document(&alloc));
-                OpenMsgPackDocument(fullFilename, *newDoc);
-            }
-            else if (StringEndsWith(fullFilename, ".json.gpg")) {
-                newDoc.reset(new rapidjson::Document(&alloc));
-                OpenEncryptedJSONDocument(fullFilename, *newDoc);
+        else if (!IsDownloadingFromRemote() && _IsDocumentFilename(fullFilename)) {
+            if (_bCacheDocuments) {
+                doc = JSONDocumentCache::GetInstance().GetDocument(fullFilename, _documentCacheDir, [&fullFilename](rapidjson::Document& newDoc) {
+                    _OpenDocument(fullFilename, newDoc);
+                });
             }
-            else if (StringEndsWith(fullFilename, ".msgpack.gpg")) {
-                newDoc.reset(new rapidjson::Document(&alloc));
-                OpenEncryptedMsgPackDocument(fullFilename, *newDoc);
-            }
-            if (!!newDoc) {
+            else {
+                boost::shared_ptr<rapidjson::Document> newDoc(new rapidjson::Document(&alloc));
+                _OpenDocument(fullFilename, *newDoc);
                 doc = newDoc;
+            }
+            if (!!doc) {
                 _rapidJSONDocuments[fullFilename] = doc;
             }
         }
         return doc;
     }
 
+    static bool _IsDocumentFilename(const std::string& fullFilename)
+    {
+        return StringEndsWith(fullFilename, ".json") || StringEndsWith(fullFilename, ".msgpack") || StringEndsWith(fullFilename, ".json.zst") || StringEndsWith(fullFilename, ".msgpack.zst") || StringEndsWith(fullFilename, ".json.gpg") || StringEndsWith(fullFilename, ".msgpack.gpg");
+    }
+
+    /// \brief parses the file depending on its suffix, which has to pass _IsDocumentFilename
+    static void _OpenDocument(const std::string& fullFilename, rapidjson::Document& doc)
+    {
+        if (StringEndsWith(fullFilename, ".json") || StringEndsWith(fullFilename, ".json.zst")) {
+            OpenRapidJsonDocument(fullFilename, doc);
+        }
+        else if (StringEndsWith(fullFilename, ".msgpack") || StringEndsWith(fullFilename, ".msgpack.zst")) {
+            OpenMsgPackDocument(fullFilename, doc);
+        }
+        else if (StringEndsWith(fullFilename, ".json.gpg")) {
+            OpenEncryptedJSONDocument(fullFilename, doc);
+        }
+        else if (StringEndsWith(fullFilename, ".msgpack.gpg")) {
+            OpenEncryptedMsgPackDocument(fullFilename, doc);
+        }
+    }
+
     void _ProcessEnvInfoBodies(EnvironmentBase::EnvironmentBaseInfo& envInfo, const rapidjson::Value& rEnvInfo, rapidjson::Document::AllocatorType& alloc, const char* pCurrentUri, const std::string& currentFilename, std::map<RobotBase::ConnectedBodyInfoPtr, std::string>& mapProcessedConnectedBodyUris)
     {
         dReal fUnitScale = _GetUnitScale(rEnvInfo, 1.0);
@@ -588,7 +755,9 @@ protected:
             }
         }
 
-        envInfo.DeserializeJSONWithMapping(rEnvInfo, fUnitScale, _deserializeOptions, vInputToBodyInfoMapping);
+        std::vector<KinBody::KinBodyInfoPtr> vPreparedBodyInfos;
+        _PrepareNewBodyInfos(envInfo, rEnvInfo, fUnitScale, vInputToBodyInfoMapping, vPreparedBodyInfos);
+        envInfo.DeserializeJSONWithMapping(rEnvInfo, fUnitScale, _deserializeOptions, vInputToBodyInfoMapping, vPreparedBodyInfos);
         FOREACH(itBodyInfo, envInfo._vBodyInfos) {
             KinBody::KinBodyInfoPtr& pKinBodyInfo = *itBodyInfo;
             // ensure uri is set
@@ -606,6 +775,71 @@ protected:
         }
     }
 
+    /// \brief deserializes concurrently the inputs of rEnvInfo["bodies"] that create new body infos in envInfo
+    ///
+    /// The bodies are independent until they are added to envInfo, which DeserializeJSONWithMapping then does in the input order.
+    /// An input that turns out to update an existing info is deserialized again there, so the guess here only has to be conservative for the performance.
+    void _PrepareNewBodyInfos(const EnvironmentBase::EnvironmentBaseInfo& envInfo, const rapidjson::Value& rEnvInfo, dReal fUnitScale, const std::vector<int>& vInputToBodyInfoMapping, std::vector<KinBody::KinBodyInfoPtr>& vPreparedBodyInfos)
+    {
+        rapidjson::Value::ConstMemberIterator itBodies = rEnvInfo.FindMember("bodies");
+        if( itBodies == rEnvInfo.MemberEnd() || !itBodies->value.IsArray() ) {
+            return;
+        }
+        const rapidjson::Value& rBodies = itBodies->value;
+
+        // same matching as DeserializeJSONWithMapping: by id, or by name if the id is empty
+        std::unordered_set<std::string> setUsedIds, setUsedNames;
+        for (const KinBody::KinBodyInfoPtr& pKinBodyInfo : envInfo._vBodyInfos) {
+            setUsedIds.insert(pKinBodyInfo->_id);
+            setUsedNames.insert(pKinBodyInfo->_name);
+        }
+        std::vector<int> vNewInputIndices;
+        for(int iInputBodyIndex = 0; iInputBodyIndex < (int)rBodies.Size(); ++iInputBodyIndex) {
+            const rapidjson::Value& rBodyInfo = rBodies[iInputBodyIndex];
+            if( (iInputBodyIndex < (int)vInputToBodyInfoMapping.size() && vInputToBodyInfoMapping[iInputBodyIndex] >= 0) || !rBodyInfo.IsObject() ) {
+                continue;
+            }
+            if( orjson::GetJsonValueByKey<bool>(rBodyInfo, "__deleted__", false) ) {
+                continue;
+            }
+            const std::string id = orjson::GetStringJsonValueByKey(rBodyInfo, "id");
+            const std::string name = orjson::GetJsonValueByKey<std::string>(rBodyInfo, "name", "");
+            // later inputs with the same id or name update the info created by this one, so only the first one can be prepared
+            const bool bNew = !id.empty() ? setUsedIds.insert(id).second : setUsedNames.count(name) == 0;
+            setUsedNames.insert(name);
+            if( bNew ) {
+                vNewInputIndices.push_back(iInputBodyIndex);
+            }
+        }
+        if( vNewInputIndices.size() < 2 ) {
+            return;
+        }
+
+        vPreparedBodyInfos.resize(rBodies.Size());
+        const int numThreads = std::min((int)vNewInputIndices.size(), std::max(1, (int)std::thread::hardware_concurrency()));
+        WorkerPool pool(numThreads - 1);
+        pool.ParallelFor(vNewInputIndices.size(), [&](size_t index) {
+            const int iInputBodyIndex = vNewInputIndices[index];
+            const rapidjson::Value& rBodyInfo = rBodies[iInputBodyIndex];
+            KinBody::KinBodyInfoPtr pKinBodyInfo;
+            if( orjson::GetJsonValueByKey<bool>(rBodyInfo, "isRobot", false) ) {
+                pKinBodyInfo.reset(new RobotBase::RobotBaseInfo());
+            }
+            else {
+                pKinBodyInfo.reset(new KinBody::KinBodyInfo());
+            }
+            try {
+                pKinBodyInfo->DeserializeJSON(rBodyInfo, fUnitScale, _deserializeOptions);
+            }
+            catch(const std::exception& ex) {
+                // the info is left empty and DeserializeJSONWithMapping reports the error
+                RAVELOG_VERBOSE_FORMAT("failed to prepare body %d: %s", iInputBodyIndex%ex.what());
+                return;
+            }
+            vPreparedBodyInfos[iInputBodyIndex] = pKinBodyInfo;
+        });
+    }
+
     /// \param originBodyId optional parameter to search into the current envInfo. If empty, then always create a new object
     /// \param rEnvInfo[in] used for resolving references pointing to the current environment
     ///
@@ -1125,6 +1359,8 @@ protected:
     bool _bMustResolveURI = false; ///< if true, throw exception if object uri does not resolve
     bool _bMustResolveEnvironmentURI = false; ///< if true, throw exception if environment uri does not resolve
     bool _bIgnoreInvalidBodies = false; ///< if true, ignores any invalid bodies
+    bool _bCacheDocuments = false; ///< if true, the referenced documents are shared with the other readers through JSONDocumentCache
+    std::string _documentCacheDir; ///< if not empty, JSONDocumentCache also stores the referenced documents in this directory so that other processes can skip parsing them
 
     std::map<std::string, boost::shared_ptr<const rapidjson::Document> > _rapidJSONDocuments; ///< cache for opened rapidjson Documents
 
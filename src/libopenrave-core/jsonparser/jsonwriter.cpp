@@ -71,7 +71,6 @@ protected:
         if (listbodies.size() > 0) {
             EnvironmentBaseConstPtr penv = listbodies.front()->GetEnv();
             OpenRAVE::orjson::SetJsonValueByKey(_rEnvironment, "unitInfo", penv->GetUnitInfo(), _allocator);
-            dReal fUnitScale = 1.0;
 
             FOREACHC(itbody, listbodies) {
                 BOOST_ASSERT((*itbody)->GetEnv() == penv);
@@ -81,67 +80,8 @@ protected:
             bodiesValue.SetArray();
 
             FOREACHC(itBody, listbodies) {
-                KinBodyPtr pBody = *itBody;
                 rapidjson::Value bodyValue;
-
-                // set dofvalues before serializing body info
-                {
-                    KinBody::KinBodyStateSaver saver(pBody);
-                    vector<dReal> vZeros(pBody->GetDOF(), 0);
-                    pBody->SetDOFValues(vZeros, KinBody::CLA_Nothing);
-                    pBody->SetTransform(Transform()); // TODO: is this necessary
-
-                    if (!pBody->IsRobot()) {
-                        KinBody::KinBodyInfo info;
-                        pBody->ExtractInfo(info, EIO_Everything);
-                        info._referenceUri = _CanonicalizeURI(info._referenceUri);
-                        info.SerializeJSON(bodyValue, _allocator, fUnitScale);
-                    } else {
-                        RobotBasePtr pRobot = RaveInterfaceCast<RobotBase>(pBody);
-                        RobotBase::RobotBaseInfo info;
-                        pRobot->ExtractInfo(info, EIO_Everything);
-                        info._referenceUri = _CanonicalizeURI(info._referenceUri);
-                        FOREACH(itConnectedBodyInfo, info._vConnectedBodyInfos) {
-                            (*itConnectedBodyInfo)->_uri = _CanonicalizeURI((*itConnectedBodyInfo)->_uri);
-                        }
-                        info.SerializeJSON(bodyValue, _allocator, fUnitScale, _serializeOptions);
-                    }
-                }
-                // dof value
-                std::vector<dReal> vDOFValues;
-                pBody->GetDOFValues(vDOFValues);
-                if (vDOFValues.size() > 0) {
-                    rapidjson::Value dofValues;
-                    dofValues.SetArray();
-                    dofValues.Reserve(vDOFValues.size(), _allocator);
-                    for(size_t iDOF=0; iDOF<vDOFValues.size(); iDOF++) {
-                        rapidjson::Value jointDOFValue;
-                        KinBody::JointPtr pJoint = pBody->GetJointFromDOFIndex(iDOF);
-                        std::string jointName = pJoint->GetName();
-                        int jointAxis = iDOF - pJoint->GetDOFIndex();
-                        OpenRAVE::orjson::SetJsonValueByKey(jointDOFValue, "jointName", jointName, _allocator);
-                        OpenRAVE::orjson::SetJsonValueByKey(jointDOFValue, "jointAxis", jointAxis, _allocator);
-                        OpenRAVE::orjson::SetJsonValueByKey(jointDOFValue, "value", vDOFValues[iDOF], _allocator);
-                        dofValues.PushBack(jointDOFValue, _allocator);
-                    }
-                    OpenRAVE::orjson::SetJsonValueByKey(bodyValue, "dofValues", dofValues, _allocator);
-                }
-
-                OpenRAVE::orjson::SetJsonValueByKey(bodyValue, "transform", pBody->GetTransform(), _allocator);
-
-                // grabbed info
-                std::vector<KinBody::GrabbedInfoPtr> vGrabbedInfo;
-                pBody->GetGrabbedInfo(vGrabbedInfo);
-                if (vGrabbedInfo.size() > 0) {
-                    rapidjson::Value grabbedsValue;
-                    grabbedsValue.SetArray();
-                    FOREACHC(itgrabbedinfo, vGrabbedInfo) {
-                        rapidjson::Value grabbedValue;
-                        (*itgrabbedinfo)->SerializeJSON(grabbedValue, _allocator, fUnitScale, _serializeOptions);
-                        grabbedsValue.PushBack(grabbedValue, _allocator);
-                    }
-                    bodyValue.AddMember("grabbed", grabbedsValue, _allocator);
-                }
+                _SerializeBody(*itBody, bodyValue, _allocator);
 
                 // finally push to the bodiesValue array if bodyValue is not empty
                 if (bodyValue.MemberCount() > 0) {
@@ -155,6 +95,92 @@ protected:
         }
     }
 
+    /// \brief serializes the info of the body at its zero configuration, followed by its dof values, transform and grabbed bodies
+    ///
+    /// \param pvStrippedMeshes if not null, the trimeshes of the geometries of the links are moved there instead of being serialized, in the order they appear in the links, see _StripMeshes
+    void _SerializeBody(KinBodyPtr pBody, rapidjson::Value& bodyValue, rapidjson::Document::AllocatorType& allocator, std::vector<TriMesh>* pvStrippedMeshes=NULL)
+    {
+        dReal fUnitScale = 1.0;
+        // set dofvalues before serializing body info
+        {
+            KinBody::KinBodyStateSaver saver(pBody);
+            vector<dReal> vZeros(pBody->GetDOF(), 0);
+            pBody->SetDOFValues(vZeros, KinBody::CLA_Nothing);
+            pBody->SetTransform(Transform()); // TODO: is this necessary
+
+            if (!pBody->IsRobot()) {
+                KinBody::KinBodyInfo info;
+                pBody->ExtractInfo(info, EIO_Everything);
+                info._referenceUri = _CanonicalizeURI(info._referenceUri);
+                if( !!pvStrippedMeshes ) {
+                    _StripMeshes(info, *pvStrippedMeshes);
+                }
+                info.SerializeJSON(bodyValue, allocator, fUnitScale);
+            } else {
+                RobotBasePtr pRobot = RaveInterfaceCast<RobotBase>(pBody);
+                RobotBase::RobotBaseInfo info;
+                pRobot->ExtractInfo(info, EIO_Everything);
+                info._referenceUri = _CanonicalizeURI(info._referenceUri);
+                FOREACH(itConnectedBodyInfo, info._vConnectedBodyInfos) {
+                    (*itConnectedBodyInfo)->_uri = _CanonicalizeURI((*itConnectedBodyInfo)->_uri);
+                }
+                if( !!pvStrippedMeshes ) {
+                    _StripMeshes(info, *pvStrippedMeshes);
+                }
+                info.SerializeJSON(bodyValue, allocator, fUnitScale, _serializeOptions);
+            }
+        }
+        // dof value
+        std::vector<dReal> vDOFValues;
+        pBody->GetDOFValues(vDOFValues);
+        if (vDOFValues.size() > 0) {
+            rapidjson::Value dofValues;
+            dofValues.SetArray();
+            dofValues.Reserve(vDOFValues.size(), allocator);
+            for(size_t iDOF=0; iDOF<vDOFValues.size(); iDOF++) {
+                rapidjson::Value jointDOFValue;
+                KinBody::JointPtr pJoint = pBody->GetJointFromDOFIndex(iDOF);
+                std::string jointName = pJoint->GetName();
+                int jointAxis = iDOF - pJoint->GetDOFIndex();
+                OpenRAVE::orjson::SetJsonValueByKey(jointDOFValue, "jointName", jointName, allocator);
+                OpenRAVE::orjson::SetJsonValueByKey(jointDOFValue, "jointAxis", jointAxis, allocator);
+                OpenRAVE::orjson::SetJsonValueByKey(jointDOFValue, "value", vDOFValues[iDOF], allocator);
+                dofValues.PushBack(jointDOFValue, allocator);
+            }
+            OpenRAVE::orjson::SetJsonValueByKey(bodyValue, "dofValues", dofValues, allocator);
+        }
+
+        OpenRAVE::orjson::SetJsonValueByKey(bodyValue, "transform", pBody->GetTransform(), allocator);
+
+        // grabbed info
+        std::vector<KinBody::GrabbedInfoPtr> vGrabbedInfo;
+        pBody->GetGrabbedInfo(vGrabbedInfo);
+        if (vGrabbedInfo.size() > 0) {
+            rapidjson::Value grabbedsValue;
+            grabbedsValue.SetArray();
+            FOREACHC(itgrabbedinfo, vGrabbedInfo) {
+                rapidjson::Value grabbedValue;
+                (*itgrabbedinfo)->SerializeJSON(grabbedValue, allocator, fUnitScale, _serializeOptions);
+                grabbedsValue.PushBack(grabbedValue, allocator);
+            }
+            bodyValue.AddMember("grabbed", grabbedsValue, allocator);
+        }
+    }
+
+    /// \brief moves the trimeshes of the trimesh geometries of the links to vStrippedMeshes, in the order they are serialized. The geometries keep an empty mesh.
+    static void _StripMeshes(KinBody::KinBodyInfo& info, std::vector<TriMesh>& vStrippedMeshes)
+    {
+        FOREACH(itlinkinfo, info._vLinkInfos) {
+            FOREACH(itgeominfo, (*itlinkinfo)->_vgeometryinfos) {
+                if( (*itgeominfo)->_type == GT_TriMesh ) {
+                    vStrippedMeshes.push_back(TriMesh());
+                    vStrippedMeshes.back().vertices.swap((*itgeominfo)->_meshcollision.vertices);
+                    vStrippedMeshes.back().indices.swap((*itgeominfo)->_meshcollision.indices);
+                }
+            }
+        }
+    }
+
     std::string _CanonicalizeURI(const std::string& uri)
     {
         if (uri.empty()) {
@@ -195,6 +221,257 @@ protected:
     rapidjson::Document::AllocatorType& _allocator;
 };
 
+/// \brief writes msgpack one body at a time, so only the json of a single body exists at any time instead of the json of the whole environment.
+///
+/// The output is the same as converting the document of EnvironmentJSONWriter, except for these attributes:
+/// - meshBlobs: if "1", the vertices and indices of the trimesh geometries of the links are written as MsgPack::MPET_Float64Array and MsgPack::MPET_Int32Array extension blobs. MsgPack::ParseMsgPack expands them back to arrays.
+/// - baseline: name of a baseline of the environment. Bodies without DOF that did not change since the last write with the same baseline are not written, their names are listed in "unchangedBodies" instead, so the reader has to keep its previous version of them. A body is unchanged if its update stamp, link enable states and geometry shape stamps are the same.
+class EnvironmentMsgPackStreamWriter : public EnvironmentJSONWriter
+{
+public:
+    EnvironmentMsgPackStreamWriter(const AttributesList& atts, rapidjson::Document& doc, MsgPack::MsgPackStreamWriter& writer) : EnvironmentJSONWriter(atts, doc, doc.GetAllocator()), _writer(writer), _bMeshBlobs(false) {
+        FOREACHC(itatt,atts) {
+            if( itatt->first == "meshBlobs" ) {
+                _bMeshBlobs = itatt->second == "1";
+            }
+            else if( itatt->first == "baseline" ) {
+                _baseline = itatt->second;
+            }
+        }
+    }
+
+    using EnvironmentJSONWriter::Write;
+
+    void Write(EnvironmentBasePtr penv) override {
+        dReal fUnitScale = 1.0;
+        EnvironmentBase::EnvironmentBaseInfo info;
+        penv->ExtractInfo(info);
+        std::vector<KinBody::KinBodyInfoPtr> vBodyInfos;
+        vBodyInfos.swap(info._vBodyInfos);
+        info.SerializeJSON(_rEnvironment, _allocator, fUnitScale, _serializeOptions);
+
+        std::vector<KinBodyPtr> vbodies(vBodyInfos.size());
+        for(size_t ibody = 0; ibody < vBodyInfos.size(); ++ibody) {
+            if( !!vBodyInfos[ibody] ) {
+                vbodies[ibody] = penv->GetKinBody(vBodyInfos[ibody]->_name);
+            }
+        }
+        std::vector<uint8_t> vskip;
+        std::vector<std::string> vUnchangedBodyNames;
+        _UpdateBaseline(penv, vbodies, vskip, vUnchangedBodyNames);
+
+        uint32_t numBodies = 0;
+        for(size_t ibody = 0; ibody < vBodyInfos.size(); ++ibody) {
+            if( !!vBodyInfos[ibody] && !vskip[ibody] ) {
+                ++numBodies;
+            }
+        }
+        _writer.StartMap(_rEnvironment.MemberCount() + (numBodies > 0) + (vUnchangedBodyNames.size() > 0));
+        for(rapidjson::Value::ConstMemberIterator it = _rEnvironment.MemberBegin(); it != _rEnvironment.MemberEnd(); ++it) {
+            _writer.WriteString(it->name.GetString(), it->name.GetStringLength());
+            _writer.WriteValue(it->value);
+        }
+        if( numBodies > 0 ) {
+            _writer.WriteString("bodies");
+            _writer.StartArray(numBodies);
+            rapidjson::Document::AllocatorType bodyAllocator;
+            std::vector<TriMesh> vStrippedMeshes;
+            for(size_t ibody = 0; ibody < vBodyInfos.size(); ++ibody) {
+                if( !vBodyInfos[ibody] || vskip[ibody] ) {
+                    continue;
+                }
+                vStrippedMeshes.clear();
+                if( _bMeshBlobs ) {
+                    _StripMeshes(*vBodyInfos[ibody], vStrippedMeshes);
+                }
+                rapidjson::Value bodyValue;
+                vBodyInfos[ibody]->SerializeJSON(bodyValue, bodyAllocator, fUnitScale, _serializeOptions);
+                vBodyInfos[ibody].reset(); // release the info as soon as it is written
+                _WriteBody(bodyValue, vStrippedMeshes);
+                bodyAllocator.Clear();
+            }
+        }
+        _WriteUnchangedBodyNames(vUnchangedBodyNames);
+    }
+
+protected:
+    void _Write(const std::list<KinBodyPtr>& listbodies) override {
+        if( listbodies.empty() ) {
+            _writer.StartMap(0);
+            return;
+        }
+
+        EnvironmentBasePtr penv = listbodies.front()->GetEnv();
+        std::vector<KinBodyPtr> vbodies(listbodies.begin(), listbodies.end());
+        FOREACHC(itbody, vbodies) {
+            BOOST_ASSERT((*itbody)->GetEnv() == penv);
+        }
+        std::vector<uint8_t> vskip;
+        std::vector<std::string> vUnchangedBodyNames;
+        _UpdateBaseline(penv, vbodies, vskip, vUnchangedBodyNames);
+        const uint32_t numBodies = std::count(vskip.begin(), vskip.end(), 0);
+
+        _writer.StartMap(1 + (numBodies > 0) + (vUnchangedBodyNames.size() > 0));
+        _writer.WriteString("unitInfo");
+        {
+            rapidjson::Value unitInfoValue;
+            OpenRAVE::orjson::SaveJsonValue(unitInfoValue, penv->GetUnitInfo(), _allocator);
+            _writer.WriteValue(unitInfoValue);
+        }
+        if( numBodies > 0 ) {
+            _writer.WriteString("bodies");
+            _writer.StartArray(numBodies);
+            rapidjson::Document::AllocatorType bodyAllocator;
+            std::vector<TriMesh> vStrippedMeshes;
+            for(size_t ibody = 0; ibody < vbodies.size(); ++ibody) {
+                if( vskip[ibody] ) {
+                    continue;
+                }
+                vStrippedMeshes.clear();
+                rapidjson::Value bodyValue;
+                _SerializeBody(vbodies[ibody], bodyValue, bodyAllocator, _bMeshBlobs ? &vStrippedMeshes : NULL);
+                _WriteBody(bodyValue, vStrippedMeshes); // always has a transform, so never empty
+                bodyAllocator.Clear();
+            }
+        }
+        _WriteUnchangedBodyNames(vUnchangedBodyNames);
+    }
+
+    /// \brief writes the json of a body, replacing the meshes of the trimesh geometries of the links by the blobs of vStrippedMeshes
+    void _WriteBody(const rapidjson::Value& bodyValue, const std::vector<TriMesh>& vStrippedMeshes)
+    {
+        size_t imesh = 0;
+        _writer.StartMap(bodyValue.MemberCount());
+        for(rapidjson::Value::ConstMemberIterator itbody = bodyValue.MemberBegin(); itbody != bodyValue.MemberEnd(); ++itbody) {
+            _writer.WriteString(itbody->name.GetString(), itbody->name.GetStringLength());
+            if( vStrippedMeshes.empty() || strcmp(itbody->name.GetString(), "links") != 0 || !itbody->value.IsArray() ) {
+                _writer.WriteValue(itbody->value);
+                continue;
+            }
+
+            _writer.StartArray(itbody->value.Size());
+            for(rapidjson::Value::ConstValueIterator itlink = itbody->value.Begin(); itlink != itbody->value.End(); ++itlink) {
+                _writer.StartMap(itlink->MemberCount());
+                for(rapidjson::Value::ConstMemberIterator itlinkmember = itlink->MemberBegin(); itlinkmember != itlink->MemberEnd(); ++itlinkmember) {
+                    _writer.WriteString(itlinkmember->name.GetString(), itlinkmember->name.GetStringLength());
+                    if( strcmp(itlinkmember->name.GetString(), "geometries") != 0 || !itlinkmember->value.IsArray() ) {
+                        _writer.WriteValue(itlinkmember->value);
+                        continue;
+                    }
+
+                    _writer.StartArray(itlinkmember->value.Size());
+                    for(rapidjson::Value::ConstValueIterator itgeom = itlinkmember->value.Begin(); itgeom != itlinkmember->value.End(); ++itgeom) {
+                        _writer.StartMap(itgeom->MemberCount());
+                        for(rapidjson::Value::ConstMemberIterator itgeommember = itgeom->MemberBegin(); itgeommember != itgeom->MemberEnd(); ++itgeommember) {
+                            _writer.WriteString(itgeommember->name.GetString(), itgeommember->name.GetStringLength());
+                            if( strcmp(itgeommember->name.GetString(), "mesh") != 0 || imesh >= vStrippedMeshes.size() ) {
+                                _writer.WriteValue(itgeommember->value);
+                                continue;
+                            }
+                            _WriteMeshBlobs(vStrippedMeshes[imesh++]);
+                        }
+                    }
+                }
+            }
+        }
+        if( imesh != vStrippedMeshes.size() ) {
+            throw OPENRAVE_EXCEPTION_FORMAT("only wrote %d/%d meshes of body, the serialized links do not match their infos", imesh%vStrippedMeshes.size(), ORE_Assert);
+        }
+    }
+
+    void _WriteMeshBlobs(const TriMesh& trimesh)
+    {
+        _vVerticesCache.resize(trimesh.vertices.size()*3);
+        for(size_t ivertex = 0; ivertex < trimesh.vertices.size(); ++ivertex) {
+            _vVerticesCache[3*ivertex+0] = trimesh.vertices[ivertex].x;
+            _vVerticesCache[3*ivertex+1] = trimesh.vertices[ivertex].y;
+            _vVerticesCache[3*ivertex+2] = trimesh.vertices[ivertex].z;
+        }
+        _writer.StartMap(2);
+        _writer.WriteString("vertices");
+        _writer.WriteFloat64Array(_vVerticesCache.data(), _vVerticesCache.size());
+        _writer.WriteString("indices");
+        _writer.WriteInt32Array(trimesh.indices.data(), trimesh.indices.size());
+    }
+
+    void _WriteUnchangedBodyNames(const std::vector<std::string>& vUnchangedBodyNames)
+    {
+        if( vUnchangedBodyNames.empty() ) {
+            return;
+        }
+        _writer.WriteString("unchangedBodies");
+        _writer.StartArray(vUnchangedBodyNames.size());
+        FOREACHC(itname, vUnchangedBodyNames) {
+            _writer.WriteString(*itname);
+        }
+    }
+
+    /// \brief state of a body without DOF when it was last written for a baseline
+    struct BaselineBodyState
+    {
+        KinBodyWeakPtr pbody;
+        int updatestamp = 0;
+        std::vector<uint64_t> vLinkEnableStatesMask;
+        std::vector<int> vGeometryShapeStamps;
+    };
+    typedef std::map<std::string, BaselineBodyState> BaselineBodyStates; ///< body name to state
+
+    static void _GetBaselineBodyState(const KinBodyPtr& pbody, BaselineBodyState& state)
+    {
+        state.pbody = pbody;
+        state.updatestamp = pbody->GetUpdateStamp();
+        state.vLinkEnableStatesMask = pbody->GetLinkEnableStatesMasks();
+        state.vGeometryShapeStamps.resize(pbody->GetLinks().size());
+        for(size_t ilink = 0; ilink < pbody->GetLinks().size(); ++ilink) {
+            state.vGeometryShapeStamps[ilink] = pbody->GetLinks()[ilink]->GetGeometryShapeStamp();
+        }
+    }
+
+    /// \brief sets vskip for the bodies without DOF that did not change since the last write of the baseline, and records the written ones as the new baseline
+    void _UpdateBaseline(const EnvironmentBasePtr& penv, const std::vector<KinBodyPtr>& vbodies, std::vector<uint8_t>& vskip, std::vector<std::string>& vUnchangedBodyNames)
+    {
+        vskip.resize(vbodies.size());
+        std::fill(vskip.begin(), vskip.end(), 0);
+        if( _baseline.empty() ) {
+            return;
+        }
+
+        static boost::mutex s_mutexBaselines;
+        static std::map<std::string, BaselineBodyStates> s_mapBaselines; ///< environment id and baseline name to the states of the written bodies
+        boost::mutex::scoped_lock lock(s_mutexBaselines);
+        BaselineBodyStates& mapStates = s_mapBaselines[str(boost::format("%d:%s")%penv->GetId()%_baseline)];
+        BaselineBodyState state;
+        for(size_t ibody = 0; ibody < vbodies.size(); ++ibody) {
+            const KinBodyPtr& pbody = vbodies[ibody];
+            if( !pbody || pbody->GetDOF() > 0 ) {
+                continue;
+            }
+            _GetBaselineBodyState(pbody, state);
+            BaselineBodyStates::iterator itstate = mapStates.find(pbody->GetName());
+            if( itstate != mapStates.end() && itstate->second.pbody.lock() == pbody && itstate->second.updatestamp == state.updatestamp && itstate->second.vLinkEnableStatesMask == state.vLinkEnableStatesMask && itstate->second.vGeometryShapeStamps == state.vGeometryShapeStamps ) {
+                vskip[ibody] = 1;
+                vUnchangedBodyNames.push_back(pbody->GetName());
+            }
+            else {
+                mapStates[pbody->GetName()] = state;
+            }
+        }
+        for(BaselineBodyStates::iterator itstate = mapStates.begin(); itstate != mapStates.end(); ) {
+            if( !itstate->second.pbody.lock() ) {
+                itstate = mapStates.erase(itstate);
+            }
+            else {
+                ++itstate;
+            }
+        }
+    }
+
+    MsgPack::MsgPackStreamWriter& _writer;
+    std::string _baseline; ///< \see EnvironmentMsgPackStreamWriter
+    bool _bMeshBlobs; ///< \see EnvironmentMsgPackStreamWriter
+    std::vector<double> _vVerticesCache;
+};
+
 void RaveWriteJSONFile(EnvironmentBasePtr penv, const std::string& filename, const AttributesList& atts, rapidjson::Document::AllocatorType& alloc)
 {
     std::ofstream ofstream(filename.c_str());
@@ -266,36 +543,33 @@ void RaveWriteMsgPackFile(const std::list<KinBodyPtr>& listbodies, const std::st
 void RaveWriteMsgPackStream(EnvironmentBasePtr penv, ostream& os, const AttributesList& atts, rapidjson::Document::AllocatorType& alloc)
 {
     rapidjson::Document doc(&alloc);
-
-    EnvironmentJSONWriter jsonwriter(atts, doc, doc.GetAllocator());
-    jsonwriter.Write(penv);
-    OpenRAVE::MsgPack::DumpMsgPack(doc, os);
+    MsgPack::MsgPackStreamWriter writer(os);
+    EnvironmentMsgPackStreamWriter msgpackwriter(atts, doc, writer);
+    msgpackwriter.Write(penv);
 }
 
 void RaveWriteMsgPackStream(const std::list<KinBodyPtr>& listbodies, ostream& os, const AttributesList& atts, rapidjson::Document::AllocatorType& alloc)
 {
     rapidjson::Document doc(&alloc);
-
-    EnvironmentJSONWriter jsonwriter(atts, doc, doc.GetAllocator());
-    jsonwriter.Write(listbodies);
-    OpenRAVE::MsgPack::DumpMsgPack(doc, os);
+    MsgPack::MsgPackStreamWriter writer(os);
+    EnvironmentMsgPackStreamWriter msgpackwriter(atts, doc, writer);
+    msgpackwriter.Write(listbodies);
 }
 
 void RaveWriteMsgPackMemory(EnvironmentBasePtr penv, std::vector<char>& output, const AttributesList& atts, rapidjson::Document::AllocatorType& alloc)
 {
     rapidjson::Document doc(&alloc);
-    EnvironmentJSONWriter jsonwriter(atts, doc, doc.GetAllocator());
-    jsonwriter.Write(penv);
-    OpenRAVE::MsgPack::DumpMsgPack(doc, output);
+    MsgPack::MsgPackStreamWriter writer(output);
+    EnvironmentMsgPackStreamWriter msgpackwriter(atts, doc, writer);
+    msgpackwriter.Write(penv);
 }
 
 void RaveWriteMsgPackMemory(const std::list<KinBodyPtr>& listbodies, std::vector<char>& output, const AttributesList& atts, rapidjson::Document::AllocatorType& alloc)
 {
     rapidjson::Document doc(&alloc);
-
-    EnvironmentJSONWriter jsonwriter(atts, doc, doc.GetAllocator());
-    jsonwriter.Write(listbodies);
-    OpenRAVE::MsgPack::DumpMsgPack(doc, output);
+    MsgPack::MsgPackStreamWriter writer(output);
+    EnvironmentMsgPackStreamWriter msgpackwriter(atts, doc, writer);
+    msgpackwriter.Write(listbodies);
 }
 
 void RaveWriteEncryptedJSONFile(EnvironmentBasePtr penv, const std::string& filename, const AttributesList& atts, rapidjson::Document::AllocatorType& alloc)
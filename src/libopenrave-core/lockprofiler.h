@@ -0,0 +1,276 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2012 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef RAVE_LOCKPROFILER
+#define RAVE_LOCKPROFILER
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
+#include <tuple>
+#include <unordered_map>
+
+// the call site of a lock is captured with default arguments evaluated where the lock is constructed
+#if defined(__GNUC__) || defined(__clang__)
+#define RAVE_LOCK_CALLSITE_FUNCTION __builtin_FUNCTION()
+#define RAVE_LOCK_CALLSITE_LINE __builtin_LINE()
+#else
+#define RAVE_LOCK_CALLSITE_FUNCTION ""
+#define RAVE_LOCK_CALLSITE_LINE 0
+#endif
+
+namespace OpenRAVE {
+
+/// \brief process-wide statistics of the environment locks per acquiring call site.
+///
+/// Disabled by default. When enabled, every acquisition first tries to lock in order to count the contended acquisitions exactly,
+/// and one out of samplingPeriod acquisitions per thread measures its wait and hold times.
+class LockProfiler
+{
+public:
+    struct CallSiteStatistics
+    {
+        CallSiteStatistics() : numSampled(0), numContended(0), waitns(0), holdns(0), maxwaitns(0), maxholdns(0) {
+        }
+        uint64_t numSampled; ///< number of timed acquisitions
+        uint64_t numContended; ///< number of acquisitions that had to wait, counted for every acquisition
+        uint64_t waitns, holdns; ///< total wait and hold times of the timed acquisitions
+        uint64_t maxwaitns, maxholdns;
+    };
+
+    static LockProfiler& GetInstance()
+    {
+        static LockProfiler s_profiler;
+        return s_profiler;
+    }
+
+    inline bool IsEnabled() const {
+        return _bEnabled.load(std::memory_order_relaxed);
+    }
+
+    void SetEnabled(bool bEnabled, int samplingPeriod)
+    {
+        _samplingPeriod.store(std::max(1, samplingPeriod), std::memory_order_relaxed);
+        _bEnabled.store(bEnabled, std::memory_order_relaxed);
+    }
+
+    /// \brief true if the current acquisition of this thread should be timed
+    inline bool ShouldSample() const
+    {
+        thread_local uint32_t s_numAcquisitions = 0;
+        return (++s_numAcquisitions % (uint32_t)_samplingPeriod.load(std::memory_order_relaxed)) == 0;
+    }
+
+    void Record(const char* mutexname, const char* function, int line, bool bContended, bool bSampled, uint64_t waitns, uint64_t holdns)
+    {
+        std::lock_guard<std::mutex> lock(_mutexStatistics);
+        CallSiteStatistics& statistics = _mapStatistics[CallSite(mutexname, function, line)];
+        if( bContended ) {
+            ++statistics.numContended;
+        }
+        if( bSampled ) {
+            ++statistics.numSampled;
+            statistics.waitns += waitns;
+            statistics.holdns += holdns;
+            statistics.maxwaitns = std::max(statistics.maxwaitns, waitns);
+            statistics.maxholdns = std::max(statistics.maxholdns, holdns);
+        }
+    }
+
+    void Reset()
+    {
+        std::lock_guard<std::mutex> lock(_mutexStatistics);
+        _mapStatistics.clear();
+    }
+
+    /// \brief writes the numTopSites call sites with the largest estimated total wait, one per line
+    void WriteReport(std::ostream& os, int numTopSites) const
+    {
+        std::vector< std::pair<CallSite, CallSiteStatistics> > vstatistics;
+        {
+            std::lock_guard<std::mutex> lock(_mutexStatistics);
+            vstatistics.assign(_mapStatistics.begin(), _mapStatistics.end());
+        }
+        std::sort(vstatistics.begin(), vstatistics.end(), [](const std::pair<CallSite, CallSiteStatistics>& a, const std::pair<CallSite, CallSiteStatistics>& b) {
+            return a.second.waitns > b.second.waitns || (a.second.waitns == b.second.waitns && a.second.numContended > b.second.numContended);
+        });
+        if( numTopSites >= 0 && (int)vstatistics.size() > numTopSites ) {
+            vstatistics.resize(numTopSites);
+        }
+
+        const int samplingPeriod = _samplingPeriod.load(std::memory_order_relaxed);
+        os << "mutex function:line acquisitions(estimated) contended waitavg(us) waitmax(us) holdavg(us) holdmax(us)" << std::endl;
+        for (const std::pair<CallSite, CallSiteStatistics>& statistics : vstatistics) {
+            const CallSiteStatistics& s = statistics.second;
+            const double fSampled = std::max(uint64_t(1), s.numSampled);
+            os << std::get<0>(statistics.first) << " " << std::get<1>(statistics.first) << ":" << std::get<2>(statistics.first) << " " << s.numSampled*samplingPeriod << " " << s.numContended << " " << 1e-3*s.waitns/fSampled << " " << 1e-3*s.maxwaitns << " " << 1e-3*s.holdns/fSampled << " " << 1e-3*s.maxholdns << std::endl;
+        }
+    }
+
+private:
+    typedef std::tuple<const char*, const char*, int> CallSite; ///< mutex name, function, line. the strings are literals so they are compared by address
+
+    struct CallSiteHash
+    {
+        size_t operator()(const CallSite& callsite) const {
+            return std::hash<const char*>()(std::get<1>(callsite)) ^ (std::hash<const char*>()(std::get<0>(callsite)) << 1) ^ ((size_t)std::get<2>(callsite) << 3);
+        }
+    };
+
+    LockProfiler() : _bEnabled(false), _samplingPeriod(64) {
+    }
+
+    std::atomic<bool> _bEnabled;
+    std::atomic<int> _samplingPeriod;
+    mutable std::mutex _mutexStatistics; ///< protects _mapStatistics
+    std::unordered_map<CallSite, CallSiteStatistics, CallSiteHash> _mapStatistics;
+};
+
+/// \brief profiles one acquisition of a mutex for LockProfiler
+class LockProfileScope
+{
+public:
+    LockProfileScope(const char* mutexname, const char* function, int line) : _mutexname(mutexname), _function(function), _line(line), _bContended(false), _bSampled(false), _bProfiled(false), _waitns(0), _holdns(0) {
+    }
+
+    /// \brief acquires the mutex with lockfn, first trying with trylockfn to detect the contention if profiling
+    template <typename TryLockFn, typename LockFn>
+    void Acquire(TryLockFn trylockfn, LockFn lockfn)
+    {
+        LockProfiler& profiler = LockProfiler::GetInstance();
+        if( !profiler.IsEnabled() ) {
+            lockfn();
+            return;
+        }
+        _bProfiled = true;
+        _bSampled = profiler.ShouldSample();
+        std::chrono::steady_clock::time_point starttime;
+        if( _bSampled ) {
+            starttime = std::chrono::steady_clock::now();
+        }
+        if( !trylockfn() ) {
+            _bContended = true;
+            lockfn();
+        }
+        if( _bSampled ) {
+            _acquiretime = std::chrono::steady_clock::now();
+            _waitns = std::chrono::duration_cast<std::chrono::nanoseconds>(_acquiretime - starttime).count();
+        }
+    }
+
+    /// \brief ends the hold time, has to be called right before the mutex is released
+    void Release()
+    {
+        if( _bProfiled && _bSampled ) {
+            _holdns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _acquiretime).count();
+        }
+    }
+
+    /// \brief records the acquisition in LockProfiler, called after the mutex is released so that other threads do not wait on the statistics mutex
+    void Record()
+    {
+        if( _bProfiled && (_bContended || _bSampled) ) {
+            LockProfiler::GetInstance().Record(_mutexname, _function, _line, _bContended, _bSampled, _waitns, _holdns);
+        }
+        _bProfiled = false;
+    }
+
+private:
+    const char* _mutexname;
+    const char* _function;
+    int _line;
+    bool _bContended, _bSampled, _bProfiled;
+    uint64_t _waitns, _holdns;
+    std::chrono::steady_clock::time_point _acquiretime;
+};
+
+/// \brief exclusive lock of a std::shared_timed_mutex reporting to LockProfiler, used like std::lock_guard
+class ProfiledExclusiveLock
+{
+public:
+    ProfiledExclusiveLock(std::shared_timed_mutex& mutex, const char* function = RAVE_LOCK_CALLSITE_FUNCTION, int line = RAVE_LOCK_CALLSITE_LINE) : _mutex(mutex), _scope("interfaces", function, line) {
+        _scope.Acquire([&mutex]() {
+            return mutex.try_lock();
+        }, [&mutex]() {
+            mutex.lock();
+        });
+    }
+    ~ProfiledExclusiveLock() {
+        _scope.Release();
+        _mutex.unlock();
+        _scope.Record();
+    }
+    ProfiledExclusiveLock(const ProfiledExclusiveLock&) = delete;
+    ProfiledExclusiveLock& operator=(const ProfiledExclusiveLock&) = delete;
+
+private:
+    std::shared_timed_mutex& _mutex;
+    LockProfileScope _scope;
+};
+
+/// \brief shared lock of a std::shared_timed_mutex reporting to LockProfiler, used like std::shared_lock
+class ProfiledSharedLock
+{
+public:
+    ProfiledSharedLock(std::shared_timed_mutex& mutex, const char* function = RAVE_LOCK_CALLSITE_FUNCTION, int line = RAVE_LOCK_CALLSITE_LINE) : _mutex(mutex), _scope("interfaces(shared)", function, line) {
+        _scope.Acquire([&mutex]() {
+            return mutex.try_lock_shared();
+        }, [&mutex]() {
+            mutex.lock_shared();
+        });
+    }
+    ~ProfiledSharedLock() {
+        _scope.Release();
+        _mutex.unlock_shared();
+        _scope.Record();
+    }
+    ProfiledSharedLock(const ProfiledSharedLock&) = delete;
+    ProfiledSharedLock& operator=(const ProfiledSharedLock&) = delete;
+
+private:
+    std::shared_timed_mutex& _mutex;
+    LockProfileScope _scope;
+};
+
+/// \brief EnvironmentLock reporting to LockProfiler when constructed locking. Deferred locks are not profiled.
+class ProfiledEnvironmentLock : public EnvironmentLock
+{
+public:
+    ProfiledEnvironmentLock(EnvironmentMutex& mutex, const char* function = RAVE_LOCK_CALLSITE_FUNCTION, int line = RAVE_LOCK_CALLSITE_LINE) : EnvironmentLock(mutex, OpenRAVE::defer_lock_t()), _scope("environment", function, line) {
+        _scope.Acquire([this]() {
+            return this->try_lock();
+        }, [this]() {
+            this->lock();
+        });
+    }
+    ProfiledEnvironmentLock(EnvironmentMutex& mutex, OpenRAVE::defer_lock_t tag) : EnvironmentLock(mutex, tag), _scope("environment", "", 0) {
+    }
+    ~ProfiledEnvironmentLock() {
+        if( this->owns_lock() ) {
+            _scope.Release();
+            this->unlock();
+            _scope.Record();
+        }
+    }
+
+private:
+    LockProfileScope _scope;
+};
+
+} // end namespace OpenRAVE
+
+#endif
@@ -20,7 +20,10 @@ namespace OpenRAVE {
 class MultiController : public MultiControllerBase
 {
 public:
-    MultiController(EnvironmentBasePtr penv) : MultiControllerBase(penv), _nControlTransformation(0) {
+    MultiController(EnvironmentBasePtr penv) : MultiControllerBase(penv), _nControlTransformation(0), _bParallelStep(false) {
+        __description = "Dispatches the commands of a robot to the controllers attached to subsets of its dofs.";
+        RegisterCommand("SetParallelStep",boost::bind(&MultiController::_SetParallelStepCommand,this,_1,_2),
+                        "If 1, the controllers attached to dofs and not to the transformation step concurrently on the shared task scheduler. Only enable it when the SimulationStep of these controllers does not modify the robot, for example when they sample their trajectories and send the commands to hardware.");
     }
 
     virtual ~MultiController() {
@@ -33,7 +36,8 @@ public:
         if( !_probot ) {
             return false;
         }
-        _listcontrollers.clear();
+        _vchildren.clear();
+        _vparallelchildren.clear();
         _dofindices=dofindices;
         // reverse the mapping
         _dofreverseindices.resize(_probot->GetDOF());
@@ -66,10 +70,17 @@ public:
         if( nControlTransformation && !!_ptransformcontroller ) {
             throw openrave_exception(_("controller already attached for transformation"),ORE_InvalidArguments);
         }
+        ChildController child;
+        child.pcontroller = controller;
+        child.vvalueindices.reserve(dofindices.size());
         FOREACHC(it,dofindices) {
-            if( !!_vcontrollersbydofs.at(*it) ) {
+            if( *it < 0 || *it >= (int)_dofreverseindices.size() || _dofreverseindices[*it] < 0 ) {
+                throw OPENRAVE_EXCEPTION_FORMAT(_("dof %d is not controlled by the multi-controller"),*it,ORE_InvalidArguments);
+            }
+            if( !!_vcontrollersbydofs.at(_dofreverseindices[*it]) ) {
                 throw openrave_exception(str(boost::format(_("controller already attached to dof %d"))%*it));
             }
+            child.vvalueindices.push_back(_dofreverseindices[*it]);
         }
         if( !controller->Init(_probot,dofindices,nControlTransformation) ) {
             return false;
@@ -77,17 +88,25 @@ public:
         if( nControlTransformation ) {
             _ptransformcontroller = controller;
         }
-        FOREACHC(it,dofindices) {
+        FOREACHC(it,child.vvalueindices) {
             _vcontrollersbydofs.at(*it) = controller;
         }
-        _listcontrollers.push_back(controller);
+        _vchildren.push_back(child);
+        _UpdateParallelChildren();
         return true;
     }
 
     virtual void RemoveController(ControllerBasePtr controller)
     {
         std::lock_guard<std::mutex> lock(_mutex);
-        _listcontrollers.remove(controller);
+        for(std::vector<ChildController>::iterator it = _vchildren.begin(); it != _vchildren.end(); ) {
+            if( it->pcontroller == controller ) {
+                it = _vchildren.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
         if( _ptransformcontroller == controller ) {
             _ptransformcontroller.reset();
         }
@@ -96,6 +115,7 @@ public:
                 it->reset();
             }
         }
+        _UpdateParallelChildren();
     }
 
     virtual ControllerBasePtr GetController(int dof) const
@@ -117,22 +137,24 @@ public:
     virtual void Reset(int options=0)
     {
         std::lock_guard<std::mutex> lock(_mutex);
-        FOREACH(itcontroller,_listcontrollers) {
-            (*itcontroller)->Reset(options);
+        FOREACH(itchild,_vchildren) {
+            itchild->pcontroller->Reset(options);
         }
     }
 
     virtual bool SetDesired(const std::vector<dReal>& values, TransformConstPtr trans=TransformConstPtr())
     {
         std::lock_guard<std::mutex> lock(_mutex);
-        vector<dReal> v;
+        if( values.size() < _dofindices.size() ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("expected %d desired values, got %d"),_dofindices.size()%values.size(),ORE_InvalidArguments);
+        }
         bool bsuccess = true;
-        FOREACH(itcontroller,_listcontrollers) {
-            v.resize(0);
-            FOREACHC(it, (*itcontroller)->GetControlDOFIndices()) {
-                v.push_back(values.at(_dofreverseindices.at(*it)));
+        FOREACH(itchild,_vchildren) {
+            itchild->vvalues.resize(itchild->vvalueindices.size());
+            for(size_t i = 0; i < itchild->vvalueindices.size(); ++i) {
+                itchild->vvalues[i] = values[itchild->vvalueindices[i]];
             }
-            bsuccess &= (*itcontroller)->SetDesired(v,trans);
+            bsuccess &= itchild->pcontroller->SetDesired(itchild->vvalues,trans);
         }
         return bsuccess;
     }
@@ -141,16 +163,28 @@ public:
     {
         std::lock_guard<std::mutex> lock(_mutex);
         bool bsuccess = true;
-        FOREACH(itcontroller,_listcontrollers) {
-            bsuccess &= (*itcontroller)->SetPath(ptraj);
+        FOREACH(itchild,_vchildren) {
+            bsuccess &= itchild->pcontroller->SetPath(ptraj);
         }
         return bsuccess;
     }
 
     virtual void SimulationStep(dReal fTimeElapsed) {
         std::lock_guard<std::mutex> lock(_mutex);
-        FOREACH(it,_listcontrollers) {
-            (*it)->SimulationStep(fTimeElapsed);
+        if( _vparallelchildren.size() > 1 ) {
+            RaveParallelFor(_vparallelchildren.size(), [this, fTimeElapsed](size_t index) {
+                _vchildren[_vparallelchildren[index]].pcontroller->SimulationStep(fTimeElapsed);
+            });
+            FOREACH(itchild,_vchildren) {
+                if( !itchild->bParallel ) {
+                    itchild->pcontroller->SimulationStep(fTimeElapsed);
+                }
+            }
+        }
+        else {
+            FOREACH(itchild,_vchildren) {
+                itchild->pcontroller->SimulationStep(fTimeElapsed);
+            }
         }
     }
 
@@ -158,8 +192,8 @@ public:
     {
         std::lock_guard<std::mutex> lock(_mutex);
         bool bdone=true;
-        FOREACH(it,_listcontrollers) {
-            bdone &= (*it)->IsDone();
+        FOREACH(itchild,_vchildren) {
+            bdone &= itchild->pcontroller->IsDone();
         }
         return bdone;
     }
@@ -168,12 +202,12 @@ public:
     {
         std::lock_guard<std::mutex> lock(_mutex);
         dReal t = 0;
-        FOREACHC(it,_listcontrollers) {
-            if( it == _listcontrollers.begin() ) {
-                t = (*it)->GetTime();
+        FOREACHC(itchild,_vchildren) {
+            if( itchild == _vchildren.begin() ) {
+                t = itchild->pcontroller->GetTime();
             }
             else {
-                dReal tnew = (*it)->GetTime();
+                dReal tnew = itchild->pcontroller->GetTime();
                 if( RaveFabs(t-tnew) > 0.000001 ) {
                     RAVELOG_WARN(str(boost::format("multi-controller time is different! %f!=%f\n")%t%tnew));
                 }
@@ -191,11 +225,10 @@ public:
             *it = 0;
         }
         vector<dReal> v;
-        FOREACHC(itcontroller,_listcontrollers) {
-            (*itcontroller)->GetVelocity(v);
-            int index=0;
-            FOREACH(it,v) {
-                vel.at(_dofreverseindices.at((*itcontroller)->GetControlDOFIndices().at(index++))) = *it;
+        FOREACHC(itchild,_vchildren) {
+            itchild->pcontroller->GetVelocity(v);
+            for(size_t i = 0; i < v.size() && i < itchild->vvalueindices.size(); ++i) {
+                vel[itchild->vvalueindices[i]] = v[i];
             }
         }
     }
@@ -211,20 +244,57 @@ public:
             *it = 0;
         }
         vector<dReal> v;
-        FOREACHC(itcontroller,_listcontrollers) {
-            (*itcontroller)->GetTorque(v);
-            int index=0;
-            FOREACH(it,v) {
-                torque.at(_dofreverseindices.at((*itcontroller)->GetControlDOFIndices().at(index++))) = *it;
+        FOREACHC(itchild,_vchildren) {
+            itchild->pcontroller->GetTorque(v);
+            for(size_t i = 0; i < v.size() && i < itchild->vvalueindices.size(); ++i) {
+                torque[itchild->vvalueindices[i]] = v[i];
             }
         }
     }
 
 protected:
+    struct ChildController
+    {
+        ChildController() : bParallel(false) {
+        }
+        ControllerBasePtr pcontroller;
+        std::vector<int> vvalueindices; ///< for every dof of the child, its index in the values of the multi-controller. Computed when attached.
+        std::vector<dReal> vvalues; ///< cache of the desired values sent to the child
+        bool bParallel; ///< if true, stepped concurrently with the other parallel children
+    };
+
+    bool _SetParallelStepCommand(std::ostream& os, std::istream& is)
+    {
+        bool bParallelStep = false;
+        is >> bParallelStep;
+        if( !is ) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        _bParallelStep = bParallelStep;
+        _UpdateParallelChildren();
+        return true;
+    }
+
+    /// \brief selects the children that can step concurrently. The dof sets of the children are disjoint, the transformation controller always steps on the calling thread.
+    void _UpdateParallelChildren()
+    {
+        _vparallelchildren.resize(0);
+        for(size_t ichild = 0; ichild < _vchildren.size(); ++ichild) {
+            ChildController& child = _vchildren[ichild];
+            child.bParallel = _bParallelStep && child.pcontroller != _ptransformcontroller && child.vvalueindices.size() > 0;
+            if( child.bParallel ) {
+                _vparallelchildren.push_back(ichild);
+            }
+        }
+    }
+
     RobotBasePtr _probot;
     std::vector<int> _dofindices, _dofreverseindices;
     int _nControlTransformation;
-    std::list<ControllerBasePtr> _listcontrollers;
+    std::vector<ChildController> _vchildren; ///< in the order they were attached
+    std::vector<size_t> _vparallelchildren; ///< indices of the children in _vchildren with bParallel set
+    bool _bParallelStep; ///< set with the SetParallelStep command
     std::vector<ControllerBasePtr> _vcontrollersbydofs;
     ControllerBasePtr _ptransformcontroller;
     TrajectoryBasePtr _ptraj;
@@ -21,6 +21,9 @@
 // public OpenRAVE header
 #include <openrave/openrave.h>
 
+#include <condition_variable>
+#include <mutex>
+
 #if defined(OPENRAVE_CORE_DLL)
   #ifdef OPENRAVE_CORE_DLL_EXPORTS
     #define OPENRAVE_CORE_API OPENRAVE_HELPER_DLL_EXPORT
@@ -55,6 +58,123 @@ OPENRAVE_CORE_API EnvironmentBasePtr RaveCreateEnvironment(int options=ECO_Start
 /// \deprecated (10/09/23) see \ref RaveCreateEnvironment
 OPENRAVE_CORE_API EnvironmentBasePtr CreateEnvironment(bool bLoadAllPlugins=true) RAVE_DEPRECATED;
 
+/// \brief how the threads of a pool and the environments of an EnvironmentPool are placed on the NUMA nodes of the machine
+enum ThreadAffinityPolicy
+{
+    TAP_None=0, ///< threads are not bound, the memory is allocated wherever the creating thread runs
+    TAP_Compact=1, ///< fill the nodes in order, proportionally to their number of cpus
+    TAP_Scatter=2, ///< distribute round-robin over the nodes
+};
+
+/// \brief Keeps clones of a master environment and leases them to concurrent users, like the requests of a planning service. Thread safe.
+///
+/// A clone is synchronized with the master when it is leased. The bodies of the master whose update stamp did not change since the last
+/// lease reuse their extracted info, and the clone is updated with UpdateFromInfo so only the bodies that differ are modified. A clone
+/// returned with the same body update stamps as it was leased with is not updated at all when the master did not change either.
+/// Changes that do not increment the update stamps, like changing the geometries of a body, are only picked up after \ref Invalidate.
+/// The uint64 parameters of the master are only copied when cloning.
+///
+/// With a ThreadAffinityPolicy other than TAP_None on a machine with several NUMA nodes, every clone is assigned to a node and created by a
+/// thread bound to that node, so its memory is first touched there. Leases prefer the idle clones of the node the calling thread runs on.
+///
+/// Has to be held by a shared pointer since the leased environments refer to it.
+class OPENRAVE_CORE_API EnvironmentPool : public boost::enable_shared_from_this<EnvironmentPool>
+{
+public:
+    /// \brief utilization of the clones of one NUMA node
+    struct NodeStatistics
+    {
+        int numEnvironments = 0; ///< number of clones placed on the node
+        int numLeased = 0; ///< number of clones of the node currently leased
+        uint64_t numLeases = 0; ///< total number of leases of the clones of the node
+        uint64_t numRemoteLeases = 0; ///< leases from a thread running on another node, because no clone of its node was idle
+    };
+
+    /// \brief utilization and synchronization statistics of the pool
+    struct Statistics
+    {
+        int numEnvironments = 0; ///< number of clones of the pool
+        int numLeased = 0; ///< number of clones currently leased
+        uint64_t numLeases = 0; ///< total number of leases
+        uint64_t numWaits = 0; ///< number of leases that had to wait for a clone to be returned
+        uint64_t numSnapshots = 0; ///< number of times the changed bodies of the master were extracted
+        uint64_t snapshotus = 0, maxsnapshotus = 0; ///< total and maximum time of extracting the master in us
+        uint64_t numSyncs = 0; ///< number of times a clone was updated from the master
+        uint64_t syncus = 0, maxsyncus = 0; ///< total and maximum time of updating a clone in us
+        std::vector<NodeStatistics> vNodeStatistics; ///< one entry per NUMA node, a single entry when the clones are not placed on nodes
+    };
+
+    /// \param pmaster the environment to clone
+    /// \param numEnvironments number of clones
+    /// \param cloningoptions the CloningOptions of the clones, has to contain Clone_Bodies
+    /// \param placement how the clones are distributed over the NUMA nodes. When set, the clones are created concurrently and synchronized with the master at their first lease.
+    EnvironmentPool(EnvironmentBasePtr pmaster, int numEnvironments, int cloningoptions=Clone_Bodies, ThreadAffinityPolicy placement=TAP_None);
+    virtual ~EnvironmentPool();
+
+    /// \brief leases a clone synchronized with the master. The clone returns to the pool when the returned pointer and all its copies are released.
+    ///
+    /// \param timeout in seconds to wait for a clone to be returned, negative to wait forever
+    /// \return the clone, or null if the timeout passed
+    EnvironmentBasePtr Lease(double timeout=-1);
+
+    /// \brief extracts all the bodies of the master again at the next lease, has to be called after changes not tracked by the update stamps
+    void Invalidate();
+
+    Statistics GetStatistics() const;
+
+    /// \brief resets the counters and times of the statistics
+    void ResetStatistics();
+
+protected:
+    /// \brief state of the master that the clones are synchronized with
+    struct Snapshot
+    {
+        uint64_t generation = 0; ///< incremented every time the master changes
+        EnvironmentBase::EnvironmentBaseInfo info; ///< environment fields and the infos of all the bodies
+        std::vector<KinBodyWeakPtr> vbodies; ///< the master body of every info
+        std::vector<int> vbodystamps; ///< the update stamp of every body when its info was extracted
+    };
+    typedef boost::shared_ptr<Snapshot const> SnapshotConstPtr;
+
+    /// \brief clone of the pool
+    struct PooledEnvironment
+    {
+        EnvironmentBasePtr penv;
+        int node = 0; ///< NUMA node the clone was created on, index into Statistics::vNodeStatistics
+        uint64_t generation = 0; ///< generation of the snapshot the clone was last synchronized with
+        std::vector<int> vbodystamps; ///< environment body index and update stamp of every body right after the last synchronization
+    };
+    typedef boost::shared_ptr<PooledEnvironment> PooledEnvironmentPtr;
+
+    /// \brief returns the snapshot of the current state of the master, extracting only the bodies that changed
+    SnapshotConstPtr _UpdateSnapshot();
+
+    /// \brief updates the clone from the snapshot unless it is already synchronized with it
+    void _SyncEnvironment(PooledEnvironment& pooled, const Snapshot& snapshot);
+
+    /// \brief creates the clones concurrently, each from a thread bound to the node the placement assigns it to
+    void _CreateNodeLocalClones(int numEnvironments, int cloningoptions, ThreadAffinityPolicy placement);
+
+    void _Return(PooledEnvironmentPtr pooled);
+
+    static void _GetBodyStamps(EnvironmentBasePtr penv, std::vector<int>& vbodystamps);
+
+    EnvironmentBasePtr _pmaster;
+    std::vector<PooledEnvironmentPtr> _vpooled; ///< all the clones
+
+    mutable std::mutex _mutex; ///< protects _listIdle and _statistics
+    std::condition_variable _condReturned;
+    std::list<PooledEnvironmentPtr> _listIdle; ///< clones that are not leased
+    Statistics _statistics;
+    bool _bNodeLocal = false; ///< true if the clones are placed on NUMA nodes
+
+    std::mutex _mutexSnapshot; ///< protects _snapshot and _bInvalidated
+    SnapshotConstPtr _snapshot;
+    bool _bInvalidated = false;
+};
+
+typedef boost::shared_ptr<EnvironmentPool> EnvironmentPoolPtr;
+
 } // end namespace OpenRAVE
 
 #endif
@@ -0,0 +1,412 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2012 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "physicsrecorder.h"
+
+namespace OpenRAVE {
+
+static const char s_magic[8] = { 'O', 'R', 'P', 'H', 'Y', 'S', 'L', 'G' };
+static const uint32_t s_version = 1;
+
+/// \brief fixed size header of a physics log
+struct PhysicsLogHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t realSize; ///< sizeof(dReal) of the writer, replaying with another precision is not bit-exact
+};
+
+/// \brief the records of a physics log, every one is followed by its values
+enum PhysicsRecordType
+{
+    PRT_Step = 0, ///< dReal time step
+    PRT_JointTorque = 1, ///< int32 body, int32 joint, int32 count, count dReal
+    PRT_BodyForce = 2, ///< int32 body, int32 link, 3 dReal force, 3 dReal position, int32 add
+    PRT_BodyTorque = 3, ///< int32 body, int32 link, 3 dReal torque, int32 add
+    PRT_LinkVelocity = 4, ///< int32 body, int32 link, 3 dReal linear, 3 dReal angular
+    PRT_LinkVelocities = 5, ///< int32 body, int32 count, count times 3 dReal linear and 3 dReal angular
+    PRT_Gravity = 6, ///< 3 dReal
+    PRT_PhysicsOptions = 7, ///< int32 options
+};
+
+/// \brief index of the joint in its body, passive joints are stored as -1-index in GetPassiveJoints
+static int32_t _GetRecordedJointIndex(const KinBody::Joint& joint)
+{
+    if( joint.GetJointIndex() >= 0 ) {
+        return joint.GetJointIndex();
+    }
+    const std::vector<KinBody::JointPtr>& vpassivejoints = joint.GetParent()->GetPassiveJoints();
+    for(size_t ijoint = 0; ijoint < vpassivejoints.size(); ++ijoint) {
+        if( vpassivejoints[ijoint].get() == &joint ) {
+            return -1-(int32_t)ijoint;
+        }
+    }
+    throw OPENRAVE_EXCEPTION_FORMAT(_("joint '%s' is not in body '%s'"), joint.GetName()%joint.GetParent()->GetName(), ORE_InvalidArguments);
+}
+
+PhysicsRecorder::PhysicsRecorder(EnvironmentBasePtr penv, PhysicsEngineBasePtr pengine, const std::string& filename) : PhysicsEngineBase(penv), _pengine(pengine), _filename(filename), _numSteps(0), _bWriteFailed(false)
+{
+    _ofs.open(filename.c_str(), std::ios::binary|std::ios::trunc);
+    if( !_ofs.good() ) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("failed to open physics log '%s'"), filename, ORE_InvalidArguments);
+    }
+    PhysicsLogHeader header;
+    memcpy(header.magic, s_magic, sizeof(s_magic));
+    header.version = s_version;
+    header.realSize = sizeof(dReal);
+    _ofs.write((const char*)&header, sizeof(header));
+}
+
+PhysicsRecorder::~PhysicsRecorder()
+{
+    _ofs.close();
+    RAVELOG_DEBUG_FORMAT("wrote %d physics steps to '%s'", _numSteps%_filename);
+}
+
+bool PhysicsRecorder::SendCommand(std::ostream& os, std::istream& is)
+{
+    return _pengine->SendCommand(os, is);
+}
+
+bool PhysicsRecorder::SetPhysicsOptions(int physicsoptions)
+{
+    _WriteRecordType(PRT_PhysicsOptions);
+    _WriteInt(physicsoptions);
+    return _pengine->SetPhysicsOptions(physicsoptions);
+}
+
+int PhysicsRecorder::GetPhysicsOptions() const
+{
+    return _pengine->GetPhysicsOptions();
+}
+
+bool PhysicsRecorder::SetPhysicsOptions(std::ostream& sout, std::istream& sinput)
+{
+    return _pengine->SendCommand(sout, sinput);
+}
+
+bool PhysicsRecorder::InitEnvironment()
+{
+    return _pengine->InitEnvironment();
+}
+
+void PhysicsRecorder::DestroyEnvironment()
+{
+    _pengine->DestroyEnvironment();
+}
+
+bool PhysicsRecorder::InitKinBody(KinBodyPtr body)
+{
+    return _pengine->InitKinBody(body);
+}
+
+void PhysicsRecorder::RemoveKinBody(KinBodyPtr body)
+{
+    _pengine->RemoveKinBody(body);
+}
+
+bool PhysicsRecorder::SetLinkVelocity(KinBody::LinkPtr link, const Vector& linearvel, const Vector& angularvel)
+{
+    _WriteRecordType(PRT_LinkVelocity);
+    _WriteInt(link->GetParent()->GetEnvironmentBodyIndex());
+    _WriteInt(link->GetIndex());
+    _WriteVector(linearvel);
+    _WriteVector(angularvel);
+    return _pengine->SetLinkVelocity(link, linearvel, angularvel);
+}
+
+bool PhysicsRecorder::SetLinkVelocities(KinBodyPtr body, const std::vector<std::pair<Vector,Vector> >& velocities)
+{
+    _WriteRecordType(PRT_LinkVelocities);
+    _WriteInt(body->GetEnvironmentBodyIndex());
+    _WriteInt((int32_t)velocities.size());
+    FOREACHC(itvelocity, velocities) {
+        _WriteVector(itvelocity->first);
+        _WriteVector(itvelocity->second);
+    }
+    return _pengine->SetLinkVelocities(body, velocities);
+}
+
+bool PhysicsRecorder::GetLinkVelocity(KinBody::LinkConstPtr link, Vector& linearvel, Vector& angularvel)
+{
+    return _pengine->GetLinkVelocity(link, linearvel, angularvel);
+}
+
+bool PhysicsRecorder::GetLinkVelocities(KinBodyConstPtr body, std::vector<std::pair<Vector,Vector> >& velocities)
+{
+    return _pengine->GetLinkVelocities(body, velocities);
+}
+
+bool PhysicsRecorder::SetBodyForce(KinBody::LinkPtr link, const Vector& force, const Vector& position, bool bAdd)
+{
+    _WriteRecordType(PRT_BodyForce);
+    _WriteInt(link->GetParent()->GetEnvironmentBodyIndex());
+    _WriteInt(link->GetIndex());
+    _WriteVector(force);
+    _WriteVector(position);
+    _WriteInt(bAdd);
+    return _pengine->SetBodyForce(link, force, position, bAdd);
+}
+
+bool PhysicsRecorder::SetBodyTorque(KinBody::LinkPtr link, const Vector& torque, bool bAdd)
+{
+    _WriteRecordType(PRT_BodyTorque);
+    _WriteInt(link->GetParent()->GetEnvironmentBodyIndex());
+    _WriteInt(link->GetIndex());
+    _WriteVector(torque);
+    _WriteInt(bAdd);
+    return _pengine->SetBodyTorque(link, torque, bAdd);
+}
+
+bool PhysicsRecorder::AddJointTorque(KinBody::JointPtr pjoint, const std::vector<dReal>& pTorques)
+{
+    _WriteRecordType(PRT_JointTorque);
+    _WriteInt(pjoint->GetParent()->GetEnvironmentBodyIndex());
+    _WriteInt(_GetRecordedJointIndex(*pjoint));
+    _WriteInt((int32_t)pTorques.size());
+    _WriteReals(pTorques.data(), pTorques.size());
+    return _pengine->AddJointTorque(pjoint, pTorques);
+}
+
+bool PhysicsRecorder::GetLinkForceTorque(KinBody::LinkConstPtr link, Vector& force, Vector& torque)
+{
+    return _pengine->GetLinkForceTorque(link, force, torque);
+}
+
+bool PhysicsRecorder::GetJointForceTorque(KinBody::JointConstPtr joint, Vector& force, Vector& torque)
+{
+    return _pengine->GetJointForceTorque(joint, force, torque);
+}
+
+void PhysicsRecorder::SetGravity(const Vector& gravity)
+{
+    _WriteRecordType(PRT_Gravity);
+    _WriteVector(gravity);
+    _pengine->SetGravity(gravity);
+}
+
+const Vector& PhysicsRecorder::GetGravity()
+{
+    return _pengine->GetGravity();
+}
+
+void PhysicsRecorder::SimulateStep(dReal fTimeElapsed)
+{
+    _WriteRecordType(PRT_Step);
+    _WriteReals(&fTimeElapsed, 1);
+    ++_numSteps;
+    _pengine->SimulateStep(fTimeElapsed);
+}
+
+void PhysicsRecorder::_WriteRecordType(uint8_t type)
+{
+    if( !_ofs.good() && !_bWriteFailed ) {
+        // checked once per record to catch the failed writes of the previous one
+        RAVELOG_WARN_FORMAT("failed to write physics log '%s', the log is truncated", _filename);
+        _bWriteFailed = true;
+    }
+    _ofs.put((char)type);
+}
+
+void PhysicsRecorder::_WriteInt(int32_t value)
+{
+    _ofs.write((const char*)&value, sizeof(value));
+}
+
+void PhysicsRecorder::_WriteReals(const dReal* pvalues, size_t num)
+{
+    _ofs.write((const char*)pvalues, num*sizeof(dReal));
+}
+
+void PhysicsRecorder::_WriteVector(const Vector& v)
+{
+    const dReal values[3] = { v.x, v.y, v.z };
+    _WriteReals(values, 3);
+}
+
+namespace {
+
+/// \brief reads the values of the records of a physics log
+class PhysicsLogReader
+{
+public:
+    PhysicsLogReader(EnvironmentBasePtr penv, const std::string& filename) : _penv(penv), _filename(filename), _ifs(filename.c_str(), std::ios::binary)
+    {
+        PhysicsLogHeader header;
+        if( !_ifs.good() || !_ifs.read((char*)&header, sizeof(header)) || memcmp(header.magic, s_magic, sizeof(s_magic)) != 0 ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("'%s' is not a physics log"), filename, ORE_InvalidArguments);
+        }
+        if( header.version != s_version || header.realSize != sizeof(dReal) ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("physics log '%s' has version %d and real size %d, expected %d and %d"), filename%header.version%header.realSize%s_version%sizeof(dReal), ORE_InvalidArguments);
+        }
+    }
+
+    /// \brief returns false at the end of the log
+    bool ReadRecordType(uint8_t& type)
+    {
+        const int c = _ifs.get();
+        if( c == std::char_traits<char>::eof() ) {
+            return false;
+        }
+        type = (uint8_t)c;
+        return true;
+    }
+
+    int32_t ReadInt()
+    {
+        int32_t value = 0;
+        _Read(&value, sizeof(value));
+        return value;
+    }
+
+    void ReadReals(dReal* pvalues, size_t num)
+    {
+        _Read(pvalues, num*sizeof(dReal));
+    }
+
+    /// \brief reads the number of values that follow
+    size_t ReadCount()
+    {
+        const int32_t count = ReadInt();
+        if( count < 0 ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("physics log '%s' has a negative count"), _filename, ORE_InvalidArguments);
+        }
+        return (size_t)count;
+    }
+
+    Vector ReadVector()
+    {
+        dReal values[3];
+        ReadReals(values, 3);
+        return Vector(values[0], values[1], values[2]);
+    }
+
+    KinBodyPtr ReadBody()
+    {
+        const int32_t bodyIndex = ReadInt();
+        KinBodyPtr pbody = _penv->GetBodyFromEnvironmentBodyIndex(bodyIndex);
+        if( !pbody ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("physics log '%s' references body index %d, which is not in the environment"), _filename%bodyIndex, ORE_InvalidArguments);
+        }
+        return pbody;
+    }
+
+    KinBody::LinkPtr ReadLink()
+    {
+        KinBodyPtr pbody = ReadBody();
+        const int32_t linkIndex = ReadInt();
+        if( linkIndex < 0 || linkIndex >= (int32_t)pbody->GetLinks().size() ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("physics log '%s' references link %d of body '%s', which has %d links"), _filename%linkIndex%pbody->GetName()%pbody->GetLinks().size(), ORE_InvalidArguments);
+        }
+        return pbody->GetLinks()[linkIndex];
+    }
+
+    KinBody::JointPtr ReadJoint()
+    {
+        KinBodyPtr pbody = ReadBody();
+        const int32_t jointIndex = ReadInt();
+        const std::vector<KinBody::JointPtr>& vjoints = jointIndex >= 0 ? pbody->GetJoints() : pbody->GetPassiveJoints();
+        const int32_t index = jointIndex >= 0 ? jointIndex : -1-jointIndex;
+        if( index >= (int32_t)vjoints.size() ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("physics log '%s' references joint %d of body '%s', which does not exist"), _filename%jointIndex%pbody->GetName(), ORE_InvalidArguments);
+        }
+        return vjoints[index];
+    }
+
+private:
+    void _Read(void* pdata, size_t size)
+    {
+        if( !_ifs.read((char*)pdata, size) ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("physics log '%s' is truncated"), _filename, ORE_InvalidArguments);
+        }
+    }
+
+    EnvironmentBasePtr _penv;
+    std::string _filename;
+    std::ifstream _ifs;
+};
+
+} // end namespace
+
+uint64_t ReplayPhysicsLog(EnvironmentBasePtr penv, PhysicsEngineBasePtr pengine, const std::string& filename, uint64_t& simulatedTimeUS)
+{
+    PhysicsLogReader reader(penv, filename);
+    uint64_t numSteps = 0;
+    simulatedTimeUS = 0;
+    std::vector<dReal> vtorques;
+    std::vector<std::pair<Vector,Vector> > vvelocities;
+    uint8_t type = 0;
+    while( reader.ReadRecordType(type) ) {
+        switch(type) {
+        case PRT_Step: {
+            dReal fTimeElapsed = 0;
+            reader.ReadReals(&fTimeElapsed, 1);
+            pengine->SimulateStep(fTimeElapsed);
+            simulatedTimeUS += (uint64_t)(1000000.0*(double)fTimeElapsed + 0.5);
+            ++numSteps;
+            break;
+        }
+        case PRT_JointTorque: {
+            KinBody::JointPtr pjoint = reader.ReadJoint();
+            vtorques.resize(reader.ReadCount());
+            reader.ReadReals(vtorques.data(), vtorques.size());
+            pengine->AddJointTorque(pjoint, vtorques);
+            break;
+        }
+        case PRT_BodyForce: {
+            KinBody::LinkPtr plink = reader.ReadLink();
+            const Vector force = reader.ReadVector();
+            const Vector position = reader.ReadVector();
+            pengine->SetBodyForce(plink, force, position, reader.ReadInt() != 0);
+            break;
+        }
+        case PRT_BodyTorque: {
+            KinBody::LinkPtr plink = reader.ReadLink();
+            const Vector torque = reader.ReadVector();
+            pengine->SetBodyTorque(plink, torque, reader.ReadInt() != 0);
+            break;
+        }
+        case PRT_LinkVelocity: {
+            KinBody::LinkPtr plink = reader.ReadLink();
+            const Vector linearvel = reader.ReadVector();
+            const Vector angularvel = reader.ReadVector();
+            pengine->SetLinkVelocity(plink, linearvel, angularvel);
+            break;
+        }
+        case PRT_LinkVelocities: {
+            KinBodyPtr pbody = reader.ReadBody();
+            vvelocities.resize(reader.ReadCount());
+            FOREACH(itvelocity, vvelocities) {
+                itvelocity->first = reader.ReadVector();
+                itvelocity->second = reader.ReadVector();
+            }
+            pengine->SetLinkVelocities(pbody, vvelocities);
+            break;
+        }
+        case PRT_Gravity:
+            pengine->SetGravity(reader.ReadVector());
+            break;
+        case PRT_PhysicsOptions:
+            pengine->SetPhysicsOptions(reader.ReadInt());
+            break;
+        default:
+            throw OPENRAVE_EXCEPTION_FORMAT(_("physics log '%s' has unknown record type %d after %d steps"), filename%(int)type%numSteps, ORE_InvalidArguments);
+        }
+    }
+    return numSteps;
+}
+
+} // end namespace OpenRAVE
@@ -0,0 +1,100 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2012 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef RAVE_PHYSICSRECORDER
+#define RAVE_PHYSICSRECORDER
+
+#include "ravep.h"
+
+#include <fstream>
+
+namespace OpenRAVE {
+
+/// \brief physics engine forwarding every call to another engine and writing the inputs it receives into a binary log
+///
+/// The log is a fixed header followed by records made of a one byte type and the raw values: the torques, forces, velocities
+/// and gravity set between two steps, then the step itself. Bodies are referenced by their environment body index, so a log
+/// can only be replayed by \ref ReplayPhysicsLog in an environment holding the same bodies in the same state.
+class PhysicsRecorder : public PhysicsEngineBase
+{
+public:
+    /// \throw openrave_exception if filename cannot be opened
+    PhysicsRecorder(EnvironmentBasePtr penv, PhysicsEngineBasePtr pengine, const std::string& filename);
+    virtual ~PhysicsRecorder();
+
+    inline const PhysicsEngineBasePtr& GetRecordedEngine() const {
+        return _pengine;
+    }
+
+    /// \brief number of SimulateStep calls written so far
+    inline uint64_t GetNumSteps() const {
+        return _numSteps;
+    }
+
+    virtual bool SendCommand(std::ostream& os, std::istream& is);
+
+    virtual bool SetPhysicsOptions(int physicsoptions);
+    virtual int GetPhysicsOptions() const;
+    virtual bool SetPhysicsOptions(std::ostream& sout, std::istream& sinput);
+
+    virtual bool InitEnvironment();
+    virtual void DestroyEnvironment();
+    virtual bool InitKinBody(KinBodyPtr body);
+    virtual void RemoveKinBody(KinBodyPtr body);
+
+    virtual bool SetLinkVelocity(KinBody::LinkPtr link, const Vector& linearvel, const Vector& angularvel);
+    virtual bool SetLinkVelocities(KinBodyPtr body, const std::vector<std::pair<Vector,Vector> >& velocities);
+    virtual bool GetLinkVelocity(KinBody::LinkConstPtr link, Vector& linearvel, Vector& angularvel);
+    virtual bool GetLinkVelocities(KinBodyConstPtr body, std::vector<std::pair<Vector,Vector> >& velocities);
+
+    virtual bool SetBodyForce(KinBody::LinkPtr link, const Vector& force, const Vector& position, bool bAdd);
+    virtual bool SetBodyTorque(KinBody::LinkPtr link, const Vector& torque, bool bAdd);
+    virtual bool AddJointTorque(KinBody::JointPtr pjoint, const std::vector<dReal>& pTorques);
+    virtual bool GetLinkForceTorque(KinBody::LinkConstPtr link, Vector& force, Vector& torque);
+    virtual bool GetJointForceTorque(KinBody::JointConstPtr joint, Vector& force, Vector& torque);
+
+    virtual void SetGravity(const Vector& gravity);
+    virtual const Vector& GetGravity();
+
+    virtual void SimulateStep(dReal fTimeElapsed);
+
+private:
+    void _WriteRecordType(uint8_t type);
+    void _WriteInt(int32_t value);
+    void _WriteReals(const dReal* pvalues, size_t num);
+    void _WriteVector(const Vector& v);
+
+    PhysicsEngineBasePtr _pengine;
+    std::string _filename;
+    std::ofstream _ofs;
+    uint64_t _numSteps;
+    bool _bWriteFailed; ///< true once a write failed, so the error is only logged once
+};
+
+typedef boost::shared_ptr<PhysicsRecorder> PhysicsRecorderPtr;
+
+/// \brief applies the inputs of a log written by \ref PhysicsRecorder to pengine and calls its SimulateStep for every recorded step
+///
+/// Only the physics engine runs, the controllers, modules and sensors are skipped, so the replay is as fast as the engine.
+/// The environment has to be locked.
+/// \param[out] simulatedTimeUS sum of the recorded steps in microseconds
+/// \return the number of steps replayed
+/// \throw openrave_exception if the log cannot be read or references bodies that do not exist
+uint64_t ReplayPhysicsLog(EnvironmentBasePtr penv, PhysicsEngineBasePtr pengine, const std::string& filename, uint64_t& simulatedTimeUS);
+
+} // end namespace OpenRAVE
+
+#endif
@@ -0,0 +1,131 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2012 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "trimeshcache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sys/stat.h>
+
+namespace OpenRAVE {
+
+namespace TriMeshCache {
+
+static const char s_magic[8] = { 'O', 'R', 'T', 'R', 'I', 'M', 'S', 'H' };
+static const uint32_t s_version = 1;
+
+/// \brief fixed size header of a cache entry, followed by numVertices*3 dReal and numIndices int32_t
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t realSize; ///< sizeof(dReal) of the writer
+    uint64_t numVertices;
+    uint64_t numIndices;
+    float diffuseColor[4];
+    float ambientColor[4];
+    float transparency;
+    uint32_t padding;
+};
+
+std::string GetCacheFilename(const std::string& cacheDirectory, const std::string& fullFilename, const Vector& vscale)
+{
+    struct stat filestat;
+    if( ::stat(fullFilename.c_str(), &filestat) != 0 ) {
+        return std::string();
+    }
+    const std::string key = str(boost::format("%s:%d:%d:%.15e:%.15e:%.15e")%fullFilename%filestat.st_size%filestat.st_mtime%vscale.x%vscale.y%vscale.z);
+    return cacheDirectory + "/" + utils::GetMD5HashString(key) + ".trimesh";
+}
+
+bool Read(const std::string& cacheFilename, TriMesh& trimesh, RaveVector<float>& diffuseColor, RaveVector<float>& ambientColor, float& ftransparency)
+{
+    std::ifstream ifs(cacheFilename.c_str(), std::ios::binary);
+    if( !ifs.good() ) {
+        return false;
+    }
+    FileHeader header;
+    if( !ifs.read((char*)&header, sizeof(header)) || memcmp(header.magic, s_magic, sizeof(s_magic)) != 0 || header.version != s_version || header.realSize != sizeof(dReal) ) {
+        RAVELOG_DEBUG_FORMAT("ignoring invalid mesh cache '%s'", cacheFilename);
+        return false;
+    }
+
+    std::vector<dReal> vrealvertices(header.numVertices*3);
+    trimesh.indices.resize(header.numIndices);
+    if( !ifs.read((char*)vrealvertices.data(), vrealvertices.size()*sizeof(dReal)) || !ifs.read((char*)trimesh.indices.data(), trimesh.indices.size()*sizeof(int32_t)) ) {
+        RAVELOG_DEBUG_FORMAT("ignoring truncated mesh cache '%s'", cacheFilename);
+        trimesh.indices.clear();
+        return false;
+    }
+    trimesh.vertices.resize(header.numVertices);
+    for(size_t ivertex = 0; ivertex < trimesh.vertices.size(); ++ivertex) {
+        trimesh.vertices[ivertex] = Vector(vrealvertices[3*ivertex], vrealvertices[3*ivertex+1], vrealvertices[3*ivertex+2]);
+    }
+    diffuseColor = RaveVector<float>(header.diffuseColor[0], header.diffuseColor[1], header.diffuseColor[2], header.diffuseColor[3]);
+    ambientColor = RaveVector<float>(header.ambientColor[0], header.ambientColor[1], header.ambientColor[2], header.ambientColor[3]);
+    ftransparency = header.transparency;
+    return true;
+}
+
+void Write(const std::string& cacheFilename, const TriMesh& trimesh, const RaveVector<float>& diffuseColor, const RaveVector<float>& ambientColor, float ftransparency)
+{
+    const size_t directoryEnd = cacheFilename.find_last_of('/');
+    if( directoryEnd != std::string::npos ) {
+        ::mkdir(cacheFilename.substr(0, directoryEnd).c_str(), 0755); // fails if it already exists
+    }
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, s_magic, sizeof(s_magic));
+    header.version = s_version;
+    header.realSize = sizeof(dReal);
+    header.numVertices = trimesh.vertices.size();
+    header.numIndices = trimesh.indices.size();
+    for(int i = 0; i < 4; ++i) {
+        header.diffuseColor[i] = diffuseColor[i];
+        header.ambientColor[i] = ambientColor[i];
+    }
+    header.transparency = ftransparency;
+
+    std::vector<dReal> vrealvertices(trimesh.vertices.size()*3);
+    for(size_t ivertex = 0; ivertex < trimesh.vertices.size(); ++ivertex) {
+        vrealvertices[3*ivertex] = trimesh.vertices[ivertex].x;
+        vrealvertices[3*ivertex+1] = trimesh.vertices[ivertex].y;
+        vrealvertices[3*ivertex+2] = trimesh.vertices[ivertex].z;
+    }
+
+    // write to a temporary file first so that concurrent loads never read a partial entry
+    const std::string tempFilename = str(boost::format("%s.%d.tmp")%cacheFilename%utils::GetMicroTime());
+    {
+        std::ofstream ofs(tempFilename.c_str(), std::ios::binary);
+        ofs.write((const char*)&header, sizeof(header));
+        ofs.write((const char*)vrealvertices.data(), vrealvertices.size()*sizeof(dReal));
+        ofs.write((const char*)trimesh.indices.data(), trimesh.indices.size()*sizeof(int32_t));
+        if( !ofs ) {
+            RAVELOG_DEBUG_FORMAT("failed to write mesh cache '%s'", cacheFilename);
+            ofs.close();
+            std::remove(tempFilename.c_str());
+            return;
+        }
+    }
+    if( std::rename(tempFilename.c_str(), cacheFilename.c_str()) != 0 ) {
+        std::remove(tempFilename.c_str());
+    }
+}
+
+} // end namespace TriMeshCache
+
+} // end namespace OpenRAVE
@@ -0,0 +1,43 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2012 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef RAVE_TRIMESHCACHE
+#define RAVE_TRIMESHCACHE
+
+#include "ravep.h"
+
+namespace OpenRAVE {
+
+/// \brief on-disk cache of the meshes imported from files by ReadTrimeshURI, so that the importers and their vertex welding are skipped on the next loads.
+///
+/// Every entry is one file holding a fixed header followed by the raw vertex and index arrays. Its name is the md5 of the source filename,
+/// size, modification time and scale, so a changed source file never reads a stale entry.
+namespace TriMeshCache {
+
+/// \brief returns the cache file of the mesh imported from fullFilename with vscale, empty if the source file cannot be found
+std::string GetCacheFilename(const std::string& cacheDirectory, const std::string& fullFilename, const Vector& vscale);
+
+/// \brief reads a cache entry, returns false if it does not exist or is not valid
+bool Read(const std::string& cacheFilename, TriMesh& trimesh, RaveVector<float>& diffuseColor, RaveVector<float>& ambientColor, float& ftransparency);
+
+/// \brief writes a cache entry atomically, the errors are only logged
+void Write(const std::string& cacheFilename, const TriMesh& trimesh, const RaveVector<float>& diffuseColor, const RaveVector<float>& ambientColor, float ftransparency);
+
+} // end namespace TriMeshCache
+
+} // end namespace OpenRAVE
+
+#endif
@@ -0,0 +1,369 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2012 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef RAVE_WORKERPOOL
+#define RAVE_WORKERPOOL
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace OpenRAVE {
+
+/// \brief cpus of the NUMA nodes of the machine, read from /sys/devices/system/node on linux. Other systems are one node without binding.
+class NumaTopology
+{
+public:
+    static const NumaTopology& Get()
+    {
+        static NumaTopology s_topology;
+        return s_topology;
+    }
+
+    inline int GetNumNodes() const {
+        return (int)_vnodecpus.size();
+    }
+
+    inline const std::vector<int>& GetNodeCpus(int node) const {
+        return _vnodecpus.at(node);
+    }
+
+    /// \brief the node of the cpu the calling thread currently runs on
+    int GetCurrentNode() const
+    {
+#ifdef __linux__
+        const int cpu = sched_getcpu();
+        if( cpu >= 0 && cpu < (int)_vcpunodes.size() ) {
+            return _vcpunodes[cpu];
+        }
+#endif
+        return 0;
+    }
+
+    /// \brief restricts the calling thread to the cpus of the node. Its later allocations are first touched on that node.
+    ///
+    /// \return false if the thread could not be bound
+    bool BindCurrentThread(int node) const
+    {
+#ifdef __linux__
+        if( node < 0 || node >= (int)_vnodecpus.size() || _vnodecpus[node].empty() ) {
+            return false;
+        }
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        for (int cpu : _vnodecpus[node]) {
+            CPU_SET(cpu, &cpuset);
+        }
+        return pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) == 0;
+#else
+        return false;
+#endif
+    }
+
+    /// \brief the node that the policy assigns to the index-th of num threads or environments, -1 for TAP_None
+    int GetPlacementNode(ThreadAffinityPolicy policy, int index, int num) const
+    {
+        if( policy == TAP_Scatter ) {
+            return index % GetNumNodes();
+        }
+        if( policy == TAP_Compact ) {
+            // the first nodes get their share of num proportionally to their number of cpus
+            int numTotalCpus = 0;
+            for (const std::vector<int>& vcpus : _vnodecpus) {
+                numTotalCpus += (int)vcpus.size();
+            }
+            if( numTotalCpus > 0 && num > 0 ) {
+                const int64_t position = (int64_t)index*numTotalCpus/num;
+                int64_t cumulative = 0;
+                for(int node = 0; node < GetNumNodes(); ++node) {
+                    cumulative += _vnodecpus[node].size();
+                    if( position < cumulative ) {
+                        return node;
+                    }
+                }
+            }
+            return 0;
+        }
+        return -1;
+    }
+
+private:
+    NumaTopology()
+    {
+#ifdef __linux__
+        for(int node = 0;; ++node) {
+            std::ifstream ifs(("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist").c_str());
+            if( !ifs ) {
+                break;
+            }
+            std::string cpulist;
+            std::getline(ifs, cpulist);
+            _vnodecpus.push_back(_ParseCpuList(cpulist));
+            for (int cpu : _vnodecpus.back()) {
+                if( cpu >= (int)_vcpunodes.size() ) {
+                    _vcpunodes.resize(cpu+1, 0);
+                }
+                _vcpunodes[cpu] = node;
+            }
+        }
+#endif
+        if( _vnodecpus.empty() ) {
+            _vnodecpus.resize(1);
+        }
+    }
+
+    /// \brief parses the kernel cpu list format, like "0-15,32-47"
+    static std::vector<int> _ParseCpuList(const std::string& cpulist)
+    {
+        std::vector<int> vcpus;
+        size_t pos = 0;
+        while( pos < cpulist.size() ) {
+            size_t end = cpulist.find(',', pos);
+            if( end == std::string::npos ) {
+                end = cpulist.size();
+            }
+            const std::string range = cpulist.substr(pos, end-pos);
+            const size_t dash = range.find('-');
+            if( !range.empty() ) {
+                const int first = std::atoi(range.c_str());
+                const int last = dash != std::string::npos ? std::atoi(range.c_str()+dash+1) : first;
+                for(int cpu = first; cpu <= last; ++cpu) {
+                    vcpus.push_back(cpu);
+                }
+            }
+            pos = end+1;
+        }
+        return vcpus;
+    }
+
+    std::vector< std::vector<int> > _vnodecpus; ///< cpus of every node
+    std::vector<int> _vcpunodes; ///< node of every cpu
+};
+
+/// \brief the policy of the pools that do not specify one, set with the OPENRAVE_THREAD_AFFINITY environment variable to "compact" or "scatter"
+inline ThreadAffinityPolicy GetDefaultThreadAffinityPolicy()
+{
+    static const ThreadAffinityPolicy s_policy = []() {
+        const char* pOPENRAVE_THREAD_AFFINITY = std::getenv("OPENRAVE_THREAD_AFFINITY");
+        if( !!pOPENRAVE_THREAD_AFFINITY ) {
+            const std::string policy = pOPENRAVE_THREAD_AFFINITY;
+            if( policy == "compact" ) {
+                return TAP_Compact;
+            }
+            if( policy == "scatter" ) {
+                return TAP_Scatter;
+            }
+        }
+        return TAP_None;
+    }();
+    return s_policy;
+}
+
+/// \brief runs the iterations of ParallelFor concurrently, used to step the simulation of independent interfaces and to load independent bodies concurrently
+///
+/// Without a NUMA policy, or on a machine with one node, the iterations run on the shared task scheduler (see \ref RaveParallelFor) so that
+/// the pools do not oversubscribe the cores with their own threads. Only pools binding their workers to the NUMA nodes own a fixed set of threads.
+class WorkerPool
+{
+public:
+    /// \brief iterations run by the threads of one NUMA node
+    struct NodeStatistics
+    {
+        int numThreads = 0; ///< workers bound to the node
+        uint64_t numIterations = 0; ///< iterations run on the node, including the ones of the calling thread
+    };
+
+    /// \param numThreads number of threads in addition to the thread calling ParallelFor, 0 to run the iterations on the calling thread. Bounds the number of threads only when the pool owns them.
+    /// \param policy how the workers are bound to the NUMA nodes. The thread calling ParallelFor is never bound.
+    WorkerPool(int numThreads, ThreadAffinityPolicy policy=GetDefaultThreadAffinityPolicy()) : _numThreads(std::max(numThreads, 0)), _fn(nullptr), _num(0), _generation(0), _numBusyWorkers(0), _bShutdown(false)
+    {
+        const NumaTopology& topology = NumaTopology::Get();
+        _vNodeStatistics.resize(topology.GetNumNodes());
+        if( policy == TAP_None || topology.GetNumNodes() <= 1 ) {
+            return;
+        }
+        _vthreads.reserve(numThreads);
+        for(int ithread = 0; ithread < numThreads; ++ithread) {
+            const int node = topology.GetNumNodes() > 1 ? topology.GetPlacementNode(policy, ithread, numThreads) : -1;
+            if( node >= 0 ) {
+                ++_vNodeStatistics[node].numThreads;
+            }
+            _vthreads.emplace_back(&WorkerPool::_WorkerThread, this, node);
+        }
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _bShutdown = true;
+        }
+        _condWork.notify_all();
+        for (std::thread& thread : _vthreads) {
+            thread.join();
+        }
+    }
+
+    inline int GetNumThreads() const {
+        return _numThreads;
+    }
+
+    /// \brief one entry per NUMA node. Unbound workers count their iterations on the node they ran on.
+    void GetNodeStatistics(std::vector<NodeStatistics>& vNodeStatistics) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        vNodeStatistics = _vNodeStatistics;
+    }
+
+    /// \brief calls fn(i) for every i in [0, num) from the workers and the calling thread, returns when all the calls are done (the barrier).
+    ///
+    /// The first exception thrown by fn is rethrown once the calls that started are done, the iterations that did not start yet can be skipped. Not reentrant.
+    void ParallelFor(size_t num, const std::function<void(size_t)>& fn)
+    {
+        if( num == 0 ) {
+            return;
+        }
+        if( _vthreads.empty() ) {
+            if( _numThreads == 0 ) {
+                for(size_t index = 0; index < num; ++index) {
+                    fn(index);
+                }
+                _AddNodeIterations(NumaTopology::Get().GetCurrentNode(), num);
+                return;
+            }
+            RaveParallelFor(num, [this, &fn](size_t index) {
+                fn(index);
+                _AddNodeIterations(NumaTopology::Get().GetCurrentNode(), 1);
+            });
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _fn = &fn;
+            _num = num;
+            _nextIndex = 0;
+            _numBusyWorkers = (int)_vthreads.size();
+            _pexception = nullptr;
+            ++_generation;
+        }
+        _condWork.notify_all();
+        const uint64_t numIterations = _RunIterations();
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _vNodeStatistics.at(NumaTopology::Get().GetCurrentNode()).numIterations += numIterations;
+        _condDone.wait(lock, [this]() {
+            return _numBusyWorkers == 0;
+        });
+        _fn = nullptr;
+        if( !!_pexception ) {
+            std::exception_ptr pexception;
+            std::swap(pexception, _pexception);
+            lock.unlock();
+            std::rethrow_exception(pexception);
+        }
+    }
+
+private:
+    /// \brief calls the current function, the first exception is kept for ParallelFor and the remaining iterations are skipped
+    void _RunIteration(size_t index)
+    {
+        try {
+            (*_fn)(index);
+        }
+        catch(...) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if( !_pexception ) {
+                _pexception = std::current_exception();
+            }
+            _nextIndex = _num;
+        }
+    }
+
+    void _AddNodeIterations(int node, uint64_t numIterations)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _vNodeStatistics.at(node).numIterations += numIterations;
+    }
+
+    /// \return the number of iterations run by the calling thread
+    uint64_t _RunIterations()
+    {
+        uint64_t numIterations = 0;
+        for(size_t index = _nextIndex.fetch_add(1); index < _num; index = _nextIndex.fetch_add(1)) {
+            _RunIteration(index);
+            ++numIterations;
+        }
+        return numIterations;
+    }
+
+    /// \param node the NUMA node to bind the worker to, -1 to leave it unbound
+    void _WorkerThread(int node)
+    {
+        if( node >= 0 && !NumaTopology::Get().BindCurrentThread(node) ) {
+            RAVELOG_WARN_FORMAT("failed to bind worker thread to numa node %d", node);
+            node = -1;
+        }
+        uint64_t lastgeneration = 0;
+        while(true) {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _condWork.wait(lock, [this, lastgeneration]() {
+                    return _bShutdown || _generation != lastgeneration;
+                });
+                if( _bShutdown ) {
+                    return;
+                }
+                lastgeneration = _generation;
+            }
+            const uint64_t numIterations = _RunIterations();
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _vNodeStatistics.at(node >= 0 ? node : NumaTopology::Get().GetCurrentNode()).numIterations += numIterations;
+                --_numBusyWorkers;
+            }
+            _condDone.notify_one();
+        }
+    }
+
+    int _numThreads; ///< number of threads requested in addition to the calling thread
+    std::vector<std::thread> _vthreads; ///< only set when the workers are bound to NUMA nodes
+    mutable std::mutex _mutex; ///< protects the members below except _nextIndex
+    std::condition_variable _condWork, _condDone;
+    const std::function<void(size_t)>* _fn; ///< function of the current ParallelFor
+    size_t _num; ///< number of iterations of the current ParallelFor
+    std::atomic<size_t> _nextIndex; ///< next iteration to run
+    uint64_t _generation; ///< incremented for every ParallelFor so that the workers run it once
+    int _numBusyWorkers; ///< workers that have not finished the current ParallelFor
+    std::exception_ptr _pexception; ///< first exception thrown by an iteration of the current ParallelFor
+    bool _bShutdown;
+    std::vector<NodeStatistics> _vNodeStatistics; ///< one entry per NUMA node
+};
+
+} // end namespace OpenRAVE
+
+#endif
@@ -1554,7 +1554,7 @@ public:
             }
         }
         else if( xmlname == "initial" ) {
-            _vinitialvalues = std::vector<dReal>((istream_iterator<dReal>(_ss)), istream_iterator<dReal>());
+            utils::ParseReals(_ss.str(), _vinitialvalues);
         }
         else if( xmlname == "body" ) {
             // figure out which body
@@ -1581,7 +1581,8 @@ public:
                 throw openrave_exception(_("cannot specify <limits> with <lostop> and <histop>, choose one"));
             }
             dReal fmult = xmlname == "limitsdeg" ? fRatio : dReal(1.0);
-            vector<dReal> values = vector<dReal>((istream_iterator<dReal>(_ss)), istream_iterator<dReal>());
+            vector<dReal> values;
+            utils::ParseReals(_ss.str(), values);
             if( (int)values.size() == 2*_pjoint->GetDOF() ) {
                 for(int i = 0; i < _pjoint->GetDOF(); ++i ) {
                     _pjoint->_info._vlowerlimit.at(i) = fmult*min(values[2*i+0],values[2*i+1]);
@@ -2330,7 +2331,8 @@ public:
                 _bOverwriteTransparency = true;
             }
             else if( xmlname == "jointvalues" ) {
-                _vjointvalues.reset(new std::vector<dReal>((istream_iterator<dReal>(_ss)), istream_iterator<dReal>()));
+                _vjointvalues.reset(new std::vector<dReal>());
+                utils::ParseReals(_ss.str(), *_vjointvalues);
             }
 
             if( xmlname !=_processingtag ) {
@@ -2671,7 +2673,8 @@ public:
             }
         }
         else if( xmlname == "closingdirection" || xmlname == "closingdir" || xmlname == "chuckingdirection" ) {
-            vector<dReal> vChuckingDirectionReal = vector<dReal>((istream_iterator<dReal>(_ss)), istream_iterator<dReal>());
+            vector<dReal> vChuckingDirectionReal;
+            utils::ParseReals(_ss.str(), vChuckingDirectionReal);
             _manipinfo._vChuckingDirection.resize(vChuckingDirectionReal.size());
             for (size_t index = 0; index < vChuckingDirectionReal.size(); ++index) {
                 const dReal realVal = vChuckingDirectionReal[index];
@@ -3017,7 +3020,8 @@ public:
             else if( xmlname == "controller" ) {
             }
             else if( xmlname == "jointvalues" ) {
-                _vjointvalues.reset(new std::vector<dReal>((istream_iterator<dReal>(_ss)), istream_iterator<dReal>()));
+                _vjointvalues.reset(new std::vector<dReal>());
+                utils::ParseReals(_ss.str(), *_vjointvalues);
             }
 
             if( xmlname !=_processingtag ) {
@@ -67,33 +67,61 @@ void CollisionPairInfo::Swap(CollisionPairInfo& rhs)
     bodyLinkGeom1Name.swap(rhs.bodyLinkGeom1Name);
     bodyLinkGeom2Name.swap(rhs.bodyLinkGeom2Name);
     contacts.swap(rhs.contacts);
+    std::swap(environmentBodyIndex1, rhs.environmentBodyIndex1);
+    std::swap(environmentBodyIndex2, rhs.environmentBodyIndex2);
+    std::swap(linkIndex1, rhs.linkIndex1);
+    std::swap(linkIndex2, rhs.linkIndex2);
 }
 
 void CollisionPairInfo::SwapFirstSecond()
 {
     std::swap(bodyLinkGeom1Name, bodyLinkGeom2Name);
+    std::swap(environmentBodyIndex1, environmentBodyIndex2);
+    std::swap(linkIndex1, linkIndex2);
     for(CONTACT& c : contacts) {
         c.norm = -c.norm;
         c.depth = -c.depth;
     }
 }
 
+/// \brief writes "bodyname linkname geomname", reusing the memory of bodyLinkGeomName
+static void _SetBodyLinkGeomName(std::string& bodyLinkGeomName, const std::string& bodyname, const std::string& linkname, const std::string& geomname)
+{
+    bodyLinkGeomName = bodyname;
+    bodyLinkGeomName.push_back(' ');
+    bodyLinkGeomName += linkname;
+    bodyLinkGeomName.push_back(' ');
+    bodyLinkGeomName += geomname;
+}
+
 void CollisionPairInfo::SetFirstCollision(const std::string& bodyname, const std::string& linkname, const std::string& geomname)
 {
-    bodyLinkGeom1Name = bodyname;
-    bodyLinkGeom1Name.push_back(' ');
-    bodyLinkGeom1Name += linkname;
-    bodyLinkGeom1Name.push_back(' ');
-    bodyLinkGeom1Name += geomname;
+    _SetBodyLinkGeomName(bodyLinkGeom1Name, bodyname, linkname, geomname);
+    environmentBodyIndex1 = 0;
+    linkIndex1 = -1;
 }
 
 void CollisionPairInfo::SetSecondCollision(const std::string& bodyname, const std::string& linkname, const std::string& geomname)
 {
-    bodyLinkGeom2Name = bodyname;
-    bodyLinkGeom2Name.push_back(' ');
-    bodyLinkGeom2Name += linkname;
-    bodyLinkGeom2Name.push_back(' ');
-    bodyLinkGeom2Name += geomname;
+    _SetBodyLinkGeomName(bodyLinkGeom2Name, bodyname, linkname, geomname);
+    environmentBodyIndex2 = 0;
+    linkIndex2 = -1;
+}
+
+void CollisionPairInfo::SetFirstCollision(const KinBody::Link& link, const std::string& geomname)
+{
+    const KinBodyPtr pbody = link.GetParent();
+    _SetBodyLinkGeomName(bodyLinkGeom1Name, pbody->GetName(), link.GetName(), geomname);
+    environmentBodyIndex1 = pbody->GetEnvironmentBodyIndex();
+    linkIndex1 = link.GetIndex();
+}
+
+void CollisionPairInfo::SetSecondCollision(const KinBody::Link& link, const std::string& geomname)
+{
+    const KinBodyPtr pbody = link.GetParent();
+    _SetBodyLinkGeomName(bodyLinkGeom2Name, pbody->GetName(), link.GetName(), geomname);
+    environmentBodyIndex2 = pbody->GetEnvironmentBodyIndex();
+    linkIndex2 = link.GetIndex();
 }
 
 void CollisionPairInfo::ExtractFirstBodyName(string_view& bodyname) const
@@ -553,71 +581,77 @@ int CollisionReport::AddCollision()
     return nNumValidCollisions++;
 }
 
-int CollisionReport::AddLinkCollision(const KinBody::Link& link1)
+/// \brief returns true if one side of a collision pair is the geometry geomname of plink. The indices are compared first, the names only when the indices of the pair are unknown.
+///
+/// \param pbody parent of plink
+static bool _IsSameCollisionSide(const std::string& bodyLinkGeomName, int environmentBodyIndex, int linkIndex, const KinBody::Link* plink, const KinBody* pbody, const std::string& geomname)
 {
-    // first write the collision as if it was unique
-    if( nNumValidCollisions+1 >= (int)vCollisionInfos.size() ) {
-        vCollisionInfos.resize(nNumValidCollisions+1);
+    if( !plink ) {
+        return bodyLinkGeomName.empty();
     }
-    CollisionPairInfo& addcpinfo = vCollisionInfos[nNumValidCollisions];
-    addcpinfo.Reset(); // might be old data
-    addcpinfo.SetFirstCollision(link1.GetParent()->GetName(), link1.GetName(), std::string());
-    // now check if there exists one like it already
-    for(int icollision = 0; icollision < nNumValidCollisions; ++icollision) {
-        const CollisionPairInfo& checkcpinfo = vCollisionInfos[icollision];
-        if( checkcpinfo.bodyLinkGeom1Name == addcpinfo.bodyLinkGeom1Name && checkcpinfo.bodyLinkGeom2Name.empty() ) {
-            return icollision;
+    string_view bodyname, linkname, geomnameview;
+    if( environmentBodyIndex > 0 && linkIndex >= 0 ) {
+        // bodies in the environment have unique indices, so only the geometries can differ
+        if( environmentBodyIndex != pbody->GetEnvironmentBodyIndex() || linkIndex != plink->GetIndex() ) {
+            return false;
         }
+        _ExtractBodyLinkGeomNames(bodyLinkGeomName, bodyname, linkname, geomnameview);
+        return geomnameview.compare(geomname) == 0;
     }
-    // return the new index
-    return nNumValidCollisions++;
+    _ExtractBodyLinkGeomNames(bodyLinkGeomName, bodyname, linkname, geomnameview);
+    return geomnameview.compare(geomname) == 0 && linkname.compare(plink->GetName()) == 0 && bodyname.compare(pbody->GetName()) == 0;
 }
 
-int CollisionReport::AddLinkCollision(const KinBody::Link& link1, const KinBody::Link& link2)
+/// \brief adds the collision to the report unless it is already there, reusing the memory of the infos past the valid ones
+static int _AddLinkGeomCollision(CollisionReport& report, const KinBody::Link* plink1, const std::string& geomname1, const KinBody::Link* plink2, const std::string& geomname2)
 {
-    // first write the collision as if it was unique
-    if( nNumValidCollisions+1 >= (int)vCollisionInfos.size() ) {
-        vCollisionInfos.resize(nNumValidCollisions+1);
-    }
-    CollisionPairInfo& addcpinfo = vCollisionInfos[nNumValidCollisions];
-    addcpinfo.Reset(); // might be old data
-    addcpinfo.SetFirstCollision(link1.GetParent()->GetName(), link1.GetName(), std::string());
-    addcpinfo.SetSecondCollision(link2.GetParent()->GetName(), link2.GetName(), std::string());
-    // now check if there exists one like it already
-    for(int icollision = 0; icollision < nNumValidCollisions; ++icollision) {
-        const CollisionPairInfo& checkcpinfo = vCollisionInfos[icollision];
-        if( checkcpinfo.bodyLinkGeom1Name == addcpinfo.bodyLinkGeom1Name && checkcpinfo.bodyLinkGeom2Name == addcpinfo.bodyLinkGeom2Name ) {
+    const KinBodyPtr pbody1 = !!plink1 ? plink1->GetParent() : KinBodyPtr();
+    const KinBodyPtr pbody2 = !!plink2 ? plink2->GetParent() : KinBodyPtr();
+    // check if there exists one like it already, before writing any name
+    for(int icollision = 0; icollision < report.nNumValidCollisions; ++icollision) {
+        const CollisionPairInfo& checkcpinfo = report.vCollisionInfos[icollision];
+        if( _IsSameCollisionSide(checkcpinfo.bodyLinkGeom1Name, checkcpinfo.environmentBodyIndex1, checkcpinfo.linkIndex1, plink1, pbody1.get(), geomname1)
+            && _IsSameCollisionSide(checkcpinfo.bodyLinkGeom2Name, checkcpinfo.environmentBodyIndex2, checkcpinfo.linkIndex2, plink2, pbody2.get(), geomname2) ) {
             return icollision;
         }
     }
-    // return the new index
-    return nNumValidCollisions++;
-}
 
-int CollisionReport::AddLinkGeomCollision(const KinBody::LinkConstPtr& plink1, const KinBody::GeometryConstPtr& pgeom1, const KinBody::LinkConstPtr& plink2, const KinBody::GeometryConstPtr& pgeom2)
-{
-    // first write the collision as if it was unique
-    if( nNumValidCollisions+1 >= (int)vCollisionInfos.size() ) {
-        vCollisionInfos.resize(nNumValidCollisions+1);
+    if( report.nNumValidCollisions >= (int)report.vCollisionInfos.size() ) {
+        report.vCollisionInfos.resize(report.nNumValidCollisions+1);
     }
-    CollisionPairInfo& addcpinfo = vCollisionInfos[nNumValidCollisions];
+    CollisionPairInfo& addcpinfo = report.vCollisionInfos[report.nNumValidCollisions];
     addcpinfo.Reset(); // might be old data
     if( !!plink1 ) {
-        addcpinfo.SetFirstCollision(plink1->GetParent()->GetName(), plink1->GetName(), !!pgeom1 ? pgeom1->GetName() : std::string());
+        addcpinfo.SetFirstCollision(*plink1, geomname1);
     }
     if( !!plink2 ) {
-        addcpinfo.SetSecondCollision(plink2->GetParent()->GetName(), plink2->GetName(), !!pgeom2 ? pgeom2->GetName() : std::string());
-    }
-
-    // now check if there exists one like it already
-    for(int icollision = 0; icollision < nNumValidCollisions; ++icollision) {
-        const CollisionPairInfo& checkcpinfo = vCollisionInfos[icollision];
-        if( checkcpinfo.bodyLinkGeom1Name == addcpinfo.bodyLinkGeom1Name && checkcpinfo.bodyLinkGeom2Name == addcpinfo.bodyLinkGeom2Name ) {
-            return icollision;
-        }
+        addcpinfo.SetSecondCollision(*plink2, geomname2);
     }
     // return the new index
-    return nNumValidCollisions++;
+    return report.nNumValidCollisions++;
+}
+
+static const std::string s_emptyGeomName;
+
+/// \brief name of the geometry, without copying it
+static inline const std::string& _GetGeomName(const KinBody::GeometryConstPtr& pgeom)
+{
+    return !!pgeom ? pgeom->GetName() : s_emptyGeomName;
+}
+
+int CollisionReport::AddLinkCollision(const KinBody::Link& link1)
+{
+    return _AddLinkGeomCollision(*this, &link1, s_emptyGeomName, nullptr, s_emptyGeomName);
+}
+
+int CollisionReport::AddLinkCollision(const KinBody::Link& link1, const KinBody::Link& link2)
+{
+    return _AddLinkGeomCollision(*this, &link1, s_emptyGeomName, &link2, s_emptyGeomName);
+}
+
+int CollisionReport::AddLinkGeomCollision(const KinBody::LinkConstPtr& plink1, const KinBody::GeometryConstPtr& pgeom1, const KinBody::LinkConstPtr& plink2, const KinBody::GeometryConstPtr& pgeom2)
+{
+    return _AddLinkGeomCollision(*this, plink1.get(), _GetGeomName(pgeom1), plink2.get(), _GetGeomName(pgeom2));
 }
 
 int CollisionReport::SetLinkGeomCollision(const KinBody::LinkConstPtr& plink1, const KinBody::GeometryConstPtr& pgeom1, const KinBody::LinkConstPtr& plink2, const KinBody::GeometryConstPtr& pgeom2)
@@ -628,15 +662,136 @@ int CollisionReport::SetLinkGeomCollision(const KinBody::LinkConstPtr& plink1, c
     CollisionPairInfo& addcpinfo = vCollisionInfos[0];
     addcpinfo.Reset(); // might be old data
     if( !!plink1 ) {
-        addcpinfo.SetFirstCollision(plink1->GetParent()->GetName(), plink1->GetName(), !!pgeom1 ? pgeom1->GetName() : std::string());
+        addcpinfo.SetFirstCollision(*plink1, _GetGeomName(pgeom1));
     }
     if( !!plink2 ) {
-        addcpinfo.SetSecondCollision(plink2->GetParent()->GetName(), plink2->GetName(), !!pgeom2 ? pgeom2->GetName() : std::string());
+        addcpinfo.SetSecondCollision(*plink2, _GetGeomName(pgeom2));
     }
     nNumValidCollisions = 1;
     return 0;
 }
 
+int CollisionReport::ValidateContactNormals(EnvironmentBase& env)
+{
+    int numflipped = 0;
+    string_view bodyname, linkname, geomname;
+    for(int icollision = 0; icollision < nNumValidCollisions; ++icollision) {
+        CollisionPairInfo& cpinfo = vCollisionInfos.at(icollision);
+        if( cpinfo.contacts.empty() ) {
+            continue;
+        }
+        cpinfo.ExtractFirstBodyLinkGeomNames(bodyname, linkname, geomname);
+        KinBodyPtr pbody = cpinfo.environmentBodyIndex1 > 0 ? env.GetBodyFromEnvironmentBodyIndex(cpinfo.environmentBodyIndex1) : env.GetKinBody(bodyname);
+        if( !pbody ) {
+            continue;
+        }
+        KinBody::LinkPtr plink;
+        if( cpinfo.linkIndex1 >= 0 && cpinfo.linkIndex1 < (int)pbody->GetLinks().size() ) {
+            plink = pbody->GetLinks()[cpinfo.linkIndex1];
+        }
+        else {
+            plink = pbody->GetLink(linkname);
+        }
+        if( !plink ) {
+            continue;
+        }
+        KinBody::GeometryPtr pgeom = plink->GetGeometry(geomname);
+        if( !pgeom && geomname.empty() && plink->GetGeometries().size() == 1 ) {
+            pgeom = plink->GetGeometries().front();
+        }
+        if( !!pgeom ) {
+            numflipped += pgeom->ValidateContactNormals(cpinfo.contacts, plink->GetTransform());
+        }
+    }
+    return numflipped;
+}
+
+bool CollisionCheckerBase::CheckCollisionBatch(KinBodyPtr pbody, const dReal* pConfigurations, size_t nConfigurations, int dofstride, std::vector<uint8_t>& vresults, CollisionReportPtr report)
+{
+    const int dof = pbody->GetDOF();
+    OPENRAVE_ASSERT_OP_FORMAT(dofstride, >=, dof, "body %s has %d dofs, so the configuration stride is too small", pbody->GetName()%dof, ORE_InvalidArguments);
+    vresults.resize(nConfigurations);
+    std::fill(vresults.begin(), vresults.end(), 0);
+    if( !!report ) {
+        report->Reset(GetCollisionOptions());
+    }
+    if( nConfigurations == 0 ) {
+        return false;
+    }
+
+    KinBody::KinBodyStateSaverRef saver(*pbody, KinBody::Save_LinkTransformation);
+    bool bAnyCollision = false;
+    for(size_t iconfig = 0; iconfig < nConfigurations; ++iconfig) {
+        pbody->SetDOFValues(pConfigurations + iconfig*dofstride, dof, KinBody::CLA_Nothing);
+        // only the first colliding configuration fills the report
+        if( CheckCollision(KinBodyConstPtr(pbody), bAnyCollision ? CollisionReportPtr() : report) ) {
+            vresults[iconfig] = 1;
+            bAnyCollision = true;
+        }
+    }
+    return bAnyCollision;
+}
+
+int CollisionCheckerBase::CheckCollisionRays(const std::vector<RAY>& vrays, std::vector<CollisionReport>& vreports)
+{
+    vreports.resize(vrays.size());
+    CollisionReportPtr report(new CollisionReport());
+    int numHits = 0;
+    for(size_t iray = 0; iray < vrays.size(); ++iray) {
+        if( CheckCollision(vrays[iray], report) ) {
+            ++numHits;
+            if( !report->IsValid() ) {
+                // so that callers can tell the hits from the reports
+                report->SetLinkGeomCollision(KinBody::LinkConstPtr(), KinBody::GeometryConstPtr(), KinBody::LinkConstPtr(), KinBody::GeometryConstPtr());
+            }
+        }
+        vreports[iray] = *report;
+    }
+    return numHits;
+}
+
+bool CollisionCheckerBase::CheckContinuousCollision(KinBodyPtr pbody, const std::vector<dReal>& vStartConfig, const std::vector<dReal>& vEndConfig, IntervalType interval, CollisionReportPtr report)
+{
+    const int dof = pbody->GetDOF();
+    OPENRAVE_ASSERT_OP((int)vStartConfig.size(), ==, dof);
+    OPENRAVE_ASSERT_OP((int)vEndConfig.size(), ==, dof);
+    if( !!report ) {
+        report->Reset(GetCollisionOptions());
+    }
+
+    std::vector<dReal> vdelta = vEndConfig, vresolutions;
+    pbody->SubtractDOFValues(vdelta, vStartConfig);
+    pbody->GetDOFResolutions(vresolutions);
+    int numSteps = 0;
+    for(int idof = 0; idof < dof; ++idof) {
+        if( vresolutions[idof] > 0 ) {
+            numSteps = std::max(numSteps, (int)ceil(RaveFabs(vdelta[idof])/vresolutions[idof]));
+        }
+    }
+
+    const int intervalmask = interval & IT_IntervalMask;
+    int istart = (intervalmask == IT_Open || intervalmask == IT_OpenStart) ? 1 : 0;
+    int iend = (intervalmask == IT_Open || intervalmask == IT_OpenEnd) ? numSteps - 1 : numSteps;
+    if( numSteps == 0 && intervalmask != IT_Open ) {
+        // same convention as PlannerParameters::CheckPathAllConstraints, a half-open interval of equal configurations is checked once
+        istart = iend = 0;
+    }
+
+    KinBody::KinBodyStateSaverRef saver(*pbody, KinBody::Save_LinkTransformation);
+    std::vector<dReal> vconfig(dof);
+    for(int istep = istart; istep <= iend; ++istep) {
+        const dReal t = numSteps > 0 ? dReal(istep)/dReal(numSteps) : dReal(0);
+        for(int idof = 0; idof < dof; ++idof) {
+            vconfig[idof] = vStartConfig[idof] + t*vdelta[idof];
+        }
+        pbody->SetDOFValues(vconfig, KinBody::CLA_Nothing);
+        if( CheckCollision(KinBodyConstPtr(pbody), report) ) {
+            return true;
+        }
+    }
+    return false;
+}
+
 CollisionOptionsStateSaver::CollisionOptionsStateSaver(CollisionCheckerBasePtr p, int newoptions, bool required)
 {
     _oldoptions = p->GetCollisionOptions();
@@ -1467,394 +1467,467 @@ void ConfigurationSpecification::ConvertGroupData(std::vector<dReal>::iterator i
     if( numpoints > 1 ) {
         BOOST_ASSERT(targetstride != 0 && sourcestride != 0 );
     }
+    ConversionPlan plan;
+    plan._targetdof = gtarget.dof;
+    plan._sourcedof = gsource.dof;
+    plan._AddGroupConversion(0, gtarget, 0, gsource, penv, filluninitialized);
+    plan._Apply(ittargetdata, targetstride, psourcedata, sourcestride, numpoints);
+}
+
+void ConfigurationSpecification::ConvertData(std::vector<dReal>::iterator ittargetdata, const ConfigurationSpecification &targetspec, std::vector<dReal>::const_iterator itsourcedata, const ConfigurationSpecification &sourcespec, size_t numpoints, EnvironmentBaseConstPtr penv, bool filluninitialized)
+{
+    ConvertData(ittargetdata, targetspec, &(*itsourcedata), sourcespec, numpoints, penv, filluninitialized);
+}
+
+void ConfigurationSpecification::ConvertData(std::vector<dReal>::iterator ittargetdata, const ConfigurationSpecification &targetspec, const dReal* psourcedata, const ConfigurationSpecification &sourcespec, size_t numpoints, EnvironmentBaseConstPtr penv, bool filluninitialized)
+{
+    ConversionPlan(targetspec, sourcespec, penv, filluninitialized).Apply(ittargetdata, psourcedata, numpoints);
+}
+
+ConfigurationSpecification::ConversionPlan::ConversionPlan() : _targetdof(0), _sourcedof(0), _bEnvironmentDefaultValues(false)
+{
+}
+
+ConfigurationSpecification::ConversionPlan::ConversionPlan(const ConfigurationSpecification& targetspec, const ConfigurationSpecification& sourcespec, EnvironmentBaseConstPtr penv, bool filluninitialized) : _targetdof(0), _sourcedof(0), _bEnvironmentDefaultValues(false)
+{
+    Compile(targetspec, sourcespec, penv, filluninitialized);
+}
+
+void ConfigurationSpecification::ConversionPlan::Compile(const ConfigurationSpecification& targetspec, const ConfigurationSpecification& sourcespec, EnvironmentBaseConstPtr penv, bool filluninitialized)
+{
+    _vcopyblocks.resize(0);
+    _vdefaultvalues.resize(0);
+    _vrotationconversions.resize(0);
+    _targetdof = targetspec.GetDOF();
+    _sourcedof = sourcespec.GetDOF();
+    _bEnvironmentDefaultValues = false;
+    for(size_t igroup = 0; igroup < targetspec._vgroups.size(); ++igroup) {
+        const Group& gtarget = targetspec._vgroups[igroup];
+        std::vector<ConfigurationSpecification::Group>::const_iterator itcompatgroup = sourcespec.FindCompatibleGroup(gtarget);
+        if( itcompatgroup != sourcespec._vgroups.end() ) {
+            _AddGroupConversion(gtarget.offset, gtarget, itcompatgroup->offset, *itcompatgroup, penv, filluninitialized);
+        }
+        else if( filluninitialized ) {
+            _AddGroupDefaultValues(gtarget.offset, gtarget, penv);
+        }
+    }
+}
+
+void ConfigurationSpecification::ConversionPlan::Apply(std::vector<dReal>::iterator ittargetdata, const dReal* psourcedata, size_t numpoints) const
+{
+    _Apply(ittargetdata, _targetdof, psourcedata, _sourcedof, numpoints);
+}
+
+void ConfigurationSpecification::ConversionPlan::_Apply(std::vector<dReal>::iterator ittargetdata, size_t targetstride, const dReal* psourcedata, size_t sourcestride, size_t numpoints) const
+{
+    for(size_t i = 0; i < numpoints; ++i, psourcedata += sourcestride, ittargetdata += targetstride) {
+        for(const CopyBlock& block : _vcopyblocks) {
+            std::copy(psourcedata+block.sourceindex, psourcedata+block.sourceindex+block.count, ittargetdata+block.targetindex);
+        }
+        for(const std::pair<int, dReal>& defaultvalue : _vdefaultvalues) {
+            *(ittargetdata+defaultvalue.first) = defaultvalue.second;
+        }
+        for(const RotationConversion& rotationconversion : _vrotationconversions) {
+            rotationconversion.converterfn(ittargetdata+rotationconversion.targetindex, psourcedata+rotationconversion.sourceindex);
+        }
+    }
+}
+
+void ConfigurationSpecification::ConversionPlan::_AddCopy(int targetindex, int sourceindex)
+{
+    if( _vcopyblocks.size() > 0 ) {
+        CopyBlock& block = _vcopyblocks.back();
+        if( block.targetindex+block.count == targetindex && block.sourceindex+block.count == sourceindex ) {
+            block.count++;
+            return;
+        }
+    }
+    CopyBlock block;
+    block.targetindex = targetindex;
+    block.sourceindex = sourceindex;
+    block.count = 1;
+    _vcopyblocks.push_back(block);
+}
+
+void ConfigurationSpecification::ConversionPlan::_AddGroupConversion(int targetoffset, const Group& gtarget, int sourceoffset, const Group& gsource, EnvironmentBaseConstPtr penv, bool filluninitialized)
+{
     if( gsource.name == gtarget.name ) {
         BOOST_ASSERT(gsource.dof==gtarget.dof);
-        for(size_t i = 0; i < numpoints; ++i) {
-            if( i != 0 ) {
-                psourcedata += sourcestride;
-                ittargetdata += targetstride;
-            }
-            std::copy(psourcedata,psourcedata+gsource.dof,ittargetdata);
+        for(int i = 0; i < gsource.dof; ++i) {
+            _AddCopy(targetoffset+i, sourceoffset+i);
         }
+        return;
     }
-    else {
-        stringstream ss(gtarget.name);
-        std::vector<std::string> targettokens((istream_iterator<std::string>(ss)), istream_iterator<std::string>());
-        ss.clear();
-        ss.str(gsource.name);
-        std::vector<std::string> sourcetokens((istream_iterator<std::string>(ss)), istream_iterator<std::string>());
-
-        BOOST_ASSERT(targettokens.at(0) == sourcetokens.at(0));
-        vector<int> vtransferindices; vtransferindices.reserve(gtarget.dof);
-        std::vector<dReal> vdefaultvalues;
-        if( targettokens.at(0).size() >= 6 && targettokens.at(0).substr(0,6) == "joint_") {
-            std::vector<int> vsourceindices(gsource.dof), vtargetindices(gtarget.dof);
-            if( (int)sourcetokens.size() < gsource.dof+2 ) {
-                RAVELOG_DEBUG(str(boost::format("source tokens '%s' do not have %d dof indices, guessing....")%gsource.name%gsource.dof));
-                for(int i = 0; i < gsource.dof; ++i) {
-                    vsourceindices[i] = i;
-                }
+
+    stringstream ss(gtarget.name);
+    std::vector<std::string> targettokens((istream_iterator<std::string>(ss)), istream_iterator<std::string>());
+    ss.clear();
+    ss.str(gsource.name);
+    std::vector<std::string> sourcetokens((istream_iterator<std::string>(ss)), istream_iterator<std::string>());
+
+    BOOST_ASSERT(targettokens.at(0) == sourcetokens.at(0));
+    vector<int> vtransferindices; vtransferindices.reserve(gtarget.dof);
+    std::vector<dReal> vdefaultvalues;
+    if( targettokens.at(0).size() >= 6 && targettokens.at(0).substr(0,6) == "joint_") {
+        std::vector<int> vsourceindices(gsource.dof), vtargetindices(gtarget.dof);
+        if( (int)sourcetokens.size() < gsource.dof+2 ) {
+            RAVELOG_DEBUG(str(boost::format("source tokens '%s' do not have %d dof indices, guessing....")%gsource.name%gsource.dof));
+            for(int i = 0; i < gsource.dof; ++i) {
+                vsourceindices[i] = i;
             }
-            else {
-                for(int i = 0; i < gsource.dof; ++i) {
-                    vsourceindices[i] = boost::lexical_cast<int>(sourcetokens.at(i+2));
-                }
+        }
+        else {
+            for(int i = 0; i < gsource.dof; ++i) {
+                vsourceindices[i] = boost::lexical_cast<int>(sourcetokens.at(i+2));
             }
-            if( (int)targettokens.size() < gtarget.dof+2 ) {
-                RAVELOG_WARN(str(boost::format("target tokens '%s' do not match dof '%d', guessing....")%gtarget.name%gtarget.dof));
-                for(int i = 0; i < gtarget.dof; ++i) {
-                    vtargetindices[i] = i;
-                }
+        }
+        if( (int)targettokens.size() < gtarget.dof+2 ) {
+            RAVELOG_WARN(str(boost::format("target tokens '%s' do not match dof '%d', guessing....")%gtarget.name%gtarget.dof));
+            for(int i = 0; i < gtarget.dof; ++i) {
+                vtargetindices[i] = i;
             }
-            else {
-                for(int i = 0; i < gtarget.dof; ++i) {
-                    vtargetindices[i] = boost::lexical_cast<int>(targettokens.at(i+2));
-                }
+        }
+        else {
+            for(int i = 0; i < gtarget.dof; ++i) {
+                vtargetindices[i] = boost::lexical_cast<int>(targettokens.at(i+2));
             }
+        }
 
-            bool bUninitializedData=false;
-            FOREACH(ittargetindex,vtargetindices) {
-                std::vector<int>::iterator it = find(vsourceindices.begin(),vsourceindices.end(),*ittargetindex);
-                if( it == vsourceindices.end() ) {
-                    bUninitializedData = true;
-                    vtransferindices.push_back(-1);
-                }
-                else {
-                    vtransferindices.push_back(static_cast<int>(it-vsourceindices.begin()));
-                }
+        bool bUninitializedData=false;
+        FOREACH(ittargetindex,vtargetindices) {
+            std::vector<int>::iterator it = find(vsourceindices.begin(),vsourceindices.end(),*ittargetindex);
+            if( it == vsourceindices.end() ) {
+                bUninitializedData = true;
+                vtransferindices.push_back(-1);
             }
+            else {
+                vtransferindices.push_back(static_cast<int>(it-vsourceindices.begin()));
+            }
+        }
 
-            if( bUninitializedData && filluninitialized ) {
-                KinBodyPtr pbody;
-                if( targettokens.size() > 1 ) {
-                    pbody = penv->GetKinBody(targettokens.at(1));
-                }
-                if( !pbody && sourcetokens.size() > 1 ) {
-                    pbody = penv->GetKinBody(sourcetokens.at(1));
+        if( bUninitializedData && filluninitialized ) {
+            KinBodyPtr pbody;
+            if( !!penv && targettokens.size() > 1 ) {
+                pbody = penv->GetKinBody(targettokens.at(1));
+            }
+            if( !!penv && !pbody && sourcetokens.size() > 1 ) {
+                pbody = penv->GetKinBody(sourcetokens.at(1));
+            }
+            if( !pbody ) {
+                RAVELOG_WARN(str(boost::format("could not find body '%s' or '%s'")%gtarget.name%gsource.name));
+                vdefaultvalues.resize(vtargetindices.size(),0);
+            }
+            else {
+                std::vector<dReal> vbodyvalues;
+                _bEnvironmentDefaultValues = true;
+                vdefaultvalues.resize(vtargetindices.size(),0);
+                if( targettokens[0] == "joint_values" ) {
+                    pbody->GetDOFValues(vbodyvalues);
                 }
-                if( !pbody ) {
-                    RAVELOG_WARN(str(boost::format("could not find body '%s' or '%s'")%gtarget.name%gsource.name));
-                    vdefaultvalues.resize(vtargetindices.size(),0);
+                else if( targettokens[0] == "joint_velocities" ) {
+                    pbody->GetDOFVelocities(vbodyvalues);
                 }
-                else {
-                    std::vector<dReal> vbodyvalues;
-                    vdefaultvalues.resize(vtargetindices.size(),0);
-                    if( targettokens[0] == "joint_values" ) {
-                        pbody->GetDOFValues(vbodyvalues);
-                    }
-                    else if( targettokens[0] == "joint_velocities" ) {
-                        pbody->GetDOFVelocities(vbodyvalues);
-                    }
-                    if( vbodyvalues.size() > 0 ) {
-                        for(size_t i = 0; i < vdefaultvalues.size(); ++i) {
-                            if( vtargetindices[i] >= 0 ) { // sometimes index can be -1 to indicate that no robot value is mapped. This is used when trying to preserve an output order of values
-                                vdefaultvalues[i] = vbodyvalues.at(vtargetindices[i]);
-                            }
+                if( vbodyvalues.size() > 0 ) {
+                    for(size_t i = 0; i < vdefaultvalues.size(); ++i) {
+                        if( vtargetindices[i] >= 0 ) { // sometimes index can be -1 to indicate that no robot value is mapped. This is used when trying to preserve an output order of values
+                            vdefaultvalues[i] = vbodyvalues.at(vtargetindices[i]);
                         }
                     }
                 }
             }
         }
-        else if( targettokens.at(0).size() >= 13 && targettokens.at(0).substr(0,13) == "outputSignals") {
-            std::vector<std::string> vSourceSignalNames(gsource.dof), vTargetSignalNames(gtarget.dof);
-            if( (int)sourcetokens.size() < gsource.dof+1 ) {
-                throw OPENRAVE_EXCEPTION_FORMAT("source tokens '%s' do not have %d dof indices, guessing....", gsource.name%gsource.dof, ORE_InvalidArguments);
+    }
+    else if( targettokens.at(0).size() >= 13 && targettokens.at(0).substr(0,13) == "outputSignals") {
+        std::vector<std::string> vSourceSignalNames(gsource.dof), vTargetSignalNames(gtarget.dof);
+        if( (int)sourcetokens.size() < gsource.dof+1 ) {
+            throw OPENRAVE_EXCEPTION_FORMAT("source tokens '%s' do not have %d dof indices, guessing....", gsource.name%gsource.dof, ORE_InvalidArguments);
+        }
+        else {
+            for(int i = 0; i < gsource.dof; ++i) {
+                vSourceSignalNames[i] = sourcetokens.at(i+1);
             }
-            else {
-                for(int i = 0; i < gsource.dof; ++i) {
-                    vSourceSignalNames[i] = sourcetokens.at(i+1);
-                }
+        }
+        if( (int)targettokens.size() < gtarget.dof+1 ) {
+            throw OPENRAVE_EXCEPTION_FORMAT("target tokens '%s' do not match dof '%d', guessing....", gtarget.name%gtarget.dof, ORE_InvalidArguments);
+        }
+        else {
+            for(int i = 0; i < gtarget.dof; ++i) {
+                vTargetSignalNames[i] = targettokens.at(i+1);
             }
-            if( (int)targettokens.size() < gtarget.dof+1 ) {
-                throw OPENRAVE_EXCEPTION_FORMAT("target tokens '%s' do not match dof '%d', guessing....", gtarget.name%gtarget.dof, ORE_InvalidArguments);
+        }
+
+        bool bUninitializedData=false;
+        FOREACH(itTargetSignalName,vTargetSignalNames) {
+            std::vector<std::string>::iterator itSourceSignalName = find(vSourceSignalNames.begin(),vSourceSignalNames.end(),*itTargetSignalName);
+            if( itSourceSignalName == vSourceSignalNames.end() ) {
+                bUninitializedData = true;
+                vtransferindices.push_back(-1); // nothing mapped
             }
             else {
-                for(int i = 0; i < gtarget.dof; ++i) {
-                    vTargetSignalNames[i] = targettokens.at(i+1);
-                }
+                vtransferindices.push_back(static_cast<int>(itSourceSignalName-vSourceSignalNames.begin()));
             }
+        }
 
-            bool bUninitializedData=false;
-            FOREACH(itTargetSignalName,vTargetSignalNames) {
-                std::vector<std::string>::iterator itSourceSignalName = find(vSourceSignalNames.begin(),vSourceSignalNames.end(),*itTargetSignalName);
-                if( itSourceSignalName == vSourceSignalNames.end() ) {
-                    bUninitializedData = true;
-                    vtransferindices.push_back(-1); // nothing mapped
-                }
-                else {
-                    vtransferindices.push_back(static_cast<int>(itSourceSignalName-vSourceSignalNames.begin()));
+        if( bUninitializedData && filluninitialized ) {
+            vdefaultvalues.resize(vTargetSignalNames.size(),-1);
+        }
+    }
+    else if( targettokens.at(0).size() >= 7 && targettokens.at(0).substr(0,7) == "affine_") {
+        int affinesource = 0, affinetarget = 0;
+        Vector sourceaxis(0,0,1), targetaxis(0,0,1);
+        if( sourcetokens.size() < 3 ) {
+            if( targettokens.size() < 3 && gsource.dof == gtarget.dof ) {
+                for(int i = 0; i < gtarget.dof; ++i) {
+                    vtransferindices.push_back(i);
                 }
             }
-
-            if( bUninitializedData && filluninitialized ) {
-                vdefaultvalues.resize(vTargetSignalNames.size(),-1);
+            else {
+                throw OPENRAVE_EXCEPTION_FORMAT(_("source affine information not present '%s'\n"),gsource.name,ORE_InvalidArguments);
             }
         }
-        else if( targettokens.at(0).size() >= 7 && targettokens.at(0).substr(0,7) == "affine_") {
-            int affinesource = 0, affinetarget = 0;
-            Vector sourceaxis(0,0,1), targetaxis(0,0,1);
-            if( sourcetokens.size() < 3 ) {
-                if( targettokens.size() < 3 && gsource.dof == gtarget.dof ) {
-                    for(size_t i = 0; i < targettokens.size(); ++i) {
-                        vtransferindices[i] = i;
-                    }
-                }
-                else {
-                    throw OPENRAVE_EXCEPTION_FORMAT(_("source affine information not present '%s'\n"),gsource.name,ORE_InvalidArguments);
-                }
+        else {
+            affinesource = boost::lexical_cast<int>(sourcetokens.at(2));
+            BOOST_ASSERT(RaveGetAffineDOF(affinesource) == gsource.dof);
+            if( (affinesource & DOF_RotationAxis) && sourcetokens.size() >= 6 ) {
+                sourceaxis.x = boost::lexical_cast<dReal>(sourcetokens.at(3));
+                sourceaxis.y = boost::lexical_cast<dReal>(sourcetokens.at(4));
+                sourceaxis.z = boost::lexical_cast<dReal>(sourcetokens.at(5));
             }
-            else {
-                affinesource = boost::lexical_cast<int>(sourcetokens.at(2));
-                BOOST_ASSERT(RaveGetAffineDOF(affinesource) == gsource.dof);
-                if( (affinesource & DOF_RotationAxis) && sourcetokens.size() >= 6 ) {
-                    sourceaxis.x = boost::lexical_cast<dReal>(sourcetokens.at(3));
-                    sourceaxis.y = boost::lexical_cast<dReal>(sourcetokens.at(4));
-                    sourceaxis.z = boost::lexical_cast<dReal>(sourcetokens.at(5));
-                }
+        }
+        if( vtransferindices.size() == 0 ) {
+            if( targettokens.size() < 3 ) {
+                throw OPENRAVE_EXCEPTION_FORMAT(_("target affine information not present '%s'\n"),gtarget.name,ORE_InvalidArguments);
             }
-            if( vtransferindices.size() == 0 ) {
-                if( targettokens.size() < 3 ) {
-                    throw OPENRAVE_EXCEPTION_FORMAT(_("target affine information not present '%s'\n"),gtarget.name,ORE_InvalidArguments);
-                }
-                else {
-                    affinetarget = boost::lexical_cast<int>(targettokens.at(2));
-                    BOOST_ASSERT(RaveGetAffineDOF(affinetarget) == gtarget.dof);
-                    if( (affinetarget & DOF_RotationAxis) && targettokens.size() >= 6 ) {
-                        targetaxis.x = boost::lexical_cast<dReal>(targettokens.at(3));
-                        targetaxis.y = boost::lexical_cast<dReal>(targettokens.at(4));
-                        targetaxis.z = boost::lexical_cast<dReal>(targettokens.at(5));
-                    }
-                }
-
-                int commondata = affinesource&affinetarget;
-                int uninitdata = affinetarget&(~commondata);
-                int sourcerotationstart = -1, targetrotationstart = -1, targetrotationend = -1;
-                boost::function< void(std::vector<dReal>::iterator, const dReal*) > rotconverterfn;
-                if( (uninitdata & DOF_RotationMask) && (affinetarget & DOF_RotationMask) && (affinesource & DOF_RotationMask) ) {
-                    // both hold rotations, but need to convert
-                    uninitdata &= ~DOF_RotationMask;
-                    sourcerotationstart = RaveGetIndexFromAffineDOF(affinesource,DOF_RotationMask);
-                    targetrotationstart = RaveGetIndexFromAffineDOF(affinetarget,DOF_RotationMask);
-                    targetrotationend = targetrotationstart+RaveGetAffineDOF(affinetarget&DOF_RotationMask);
-                    if( affinetarget & DOF_RotationAxis ) {
-                        if( affinesource & DOF_Rotation3D ) {
-                            rotconverterfn = boost::bind(ConvertDOFRotation_AxisFrom3D,_1,_2,targetaxis);
-                        }
-                        else if( affinesource & DOF_RotationQuat ) {
-                            rotconverterfn = boost::bind(ConvertDOFRotation_AxisFromQuat,_1,_2,targetaxis);
-                        }
-                    }
-                    else if( affinetarget & DOF_Rotation3D ) {
-                        if( affinesource & DOF_RotationAxis ) {
-                            rotconverterfn = boost::bind(ConvertDOFRotation_3DFromAxis,_1,_2,sourceaxis);
-                        }
-                        else if( affinesource & DOF_RotationQuat ) {
-                            rotconverterfn = ConvertDOFRotation_3DFromQuat;
-                        }
+            else {
+                affinetarget = boost::lexical_cast<int>(targettokens.at(2));
+                BOOST_ASSERT(RaveGetAffineDOF(affinetarget) == gtarget.dof);
+                if( (affinetarget & DOF_RotationAxis) && targettokens.size() >= 6 ) {
+                    targetaxis.x = boost::lexical_cast<dReal>(targettokens.at(3));
+                    targetaxis.y = boost::lexical_cast<dReal>(targettokens.at(4));
+                    targetaxis.z = boost::lexical_cast<dReal>(targettokens.at(5));
+                }
+            }
+
+            int commondata = affinesource&affinetarget;
+            int uninitdata = affinetarget&(~commondata);
+            int sourcerotationstart = -1, targetrotationstart = -1, targetrotationend = -1;
+            boost::function< void(std::vector<dReal>::iterator, const dReal*) > rotconverterfn;
+            if( (uninitdata & DOF_RotationMask) && (affinetarget & DOF_RotationMask) && (affinesource & DOF_RotationMask) ) {
+                // both hold rotations, but need to convert
+                uninitdata &= ~DOF_RotationMask;
+                sourcerotationstart = RaveGetIndexFromAffineDOF(affinesource,DOF_RotationMask);
+                targetrotationstart = RaveGetIndexFromAffineDOF(affinetarget,DOF_RotationMask);
+                targetrotationend = targetrotationstart+RaveGetAffineDOF(affinetarget&DOF_RotationMask);
+                if( affinetarget & DOF_RotationAxis ) {
+                    if( affinesource & DOF_Rotation3D ) {
+                        rotconverterfn = boost::bind(ConvertDOFRotation_AxisFrom3D,_1,_2,targetaxis);
                     }
-                    else if( affinetarget & DOF_RotationQuat ) {
-                        if( affinesource & DOF_RotationAxis ) {
-                            rotconverterfn = boost::bind(ConvertDOFRotation_QuatFromAxis,_1,_2,sourceaxis);
-                        }
-                        else if( affinesource & DOF_Rotation3D ) {
-                            rotconverterfn = ConvertDOFRotation_QuatFrom3D;
-                        }
+                    else if( affinesource & DOF_RotationQuat ) {
+                        rotconverterfn = boost::bind(ConvertDOFRotation_AxisFromQuat,_1,_2,targetaxis);
                     }
-                    BOOST_ASSERT(!!rotconverterfn);
                 }
-                if( uninitdata && filluninitialized ) {
-                    // initialize with the current body values
-                    KinBodyPtr pbody;
-                    if( targettokens.size() > 1 ) {
-                        pbody = penv->GetKinBody(targettokens.at(1));
+                else if( affinetarget & DOF_Rotation3D ) {
+                    if( affinesource & DOF_RotationAxis ) {
+                        rotconverterfn = boost::bind(ConvertDOFRotation_3DFromAxis,_1,_2,sourceaxis);
                     }
-                    if( !pbody && sourcetokens.size() > 1 ) {
-                        pbody = penv->GetKinBody(sourcetokens.at(1));
-                    }
-                    if( !pbody ) {
-                        RAVELOG_WARN(str(boost::format("could not find body '%s' or '%s'")%gtarget.name%gsource.name));
-                        vdefaultvalues.resize(gtarget.dof,0);
-                    }
-                    else {
-                        vdefaultvalues.resize(gtarget.dof);
-                        RaveGetAffineDOFValuesFromTransform(vdefaultvalues.begin(),pbody->GetTransform(),affinetarget);
+                    else if( affinesource & DOF_RotationQuat ) {
+                        rotconverterfn = ConvertDOFRotation_3DFromQuat;
                     }
                 }
-
-                for(int index = 0; index < gtarget.dof; ++index) {
-                    DOFAffine dof = RaveGetAffineDOFFromIndex(affinetarget,index);
-                    int startindex = RaveGetIndexFromAffineDOF(affinetarget,dof);
-                    if( affinesource & dof ) {
-                        int sourceindex = RaveGetIndexFromAffineDOF(affinesource,dof);
-                        vtransferindices.push_back(sourceindex + (index-startindex));
-                    }
-                    else {
-                        vtransferindices.push_back(-1);
+                else if( affinetarget & DOF_RotationQuat ) {
+                    if( affinesource & DOF_RotationAxis ) {
+                        rotconverterfn = boost::bind(ConvertDOFRotation_QuatFromAxis,_1,_2,sourceaxis);
                     }
-                }
-
-                for(size_t i = 0; i < numpoints; ++i, psourcedata += sourcestride, ittargetdata += targetstride) {
-                    for(int j = 0; j < (int)vtransferindices.size(); ++j) {
-                        if( vtransferindices[j] >= 0 ) {
-                            *(ittargetdata+j) = *(psourcedata+vtransferindices[j]);
-                        }
-                        else {
-                            if( j >= targetrotationstart && j < targetrotationend ) {
-                                if( j == targetrotationstart ) {
-                                    // only convert when at first index
-                                    rotconverterfn(ittargetdata+targetrotationstart,psourcedata+sourcerotationstart);
-                                }
-                            }
-                            else if( filluninitialized ) {
-                                *(ittargetdata+j) = vdefaultvalues.at(j);
-                            }
-                        }
+                    else if( affinesource & DOF_Rotation3D ) {
+                        rotconverterfn = ConvertDOFRotation_QuatFrom3D;
                     }
                 }
-                return;
-            }
-        }
-        else if( targettokens.at(0).size() >= 8 && targettokens.at(0).substr(0,8) == "ikparam_") {
-            IkParameterizationType iktypesource, iktypetarget;
-            if( sourcetokens.size() >= 2 ) {
-                iktypesource = static_cast<IkParameterizationType>(boost::lexical_cast<int>(sourcetokens[1]));
-            }
-            else {
-                throw OPENRAVE_EXCEPTION_FORMAT(_("ikparam type not present '%s'\n"),gsource.name,ORE_InvalidArguments);
-            }
-            if( targettokens.size() >= 2 ) {
-                iktypetarget = static_cast<IkParameterizationType>(boost::lexical_cast<int>(targettokens[1]));
+                BOOST_ASSERT(!!rotconverterfn);
             }
-            else {
-                throw OPENRAVE_EXCEPTION_FORMAT(_("ikparam type not present '%s'\n"),gtarget.name,ORE_InvalidArguments);
-            }
-
-            if( iktypetarget == iktypesource ) {
-                vtransferindices.resize(IkParameterization::GetDOF(iktypetarget));
-                for(size_t i = 0; i < vtransferindices.size(); ++i) {
-                    vtransferindices[i] = i;
+            if( uninitdata && filluninitialized ) {
+                // initialize with the current body values
+                KinBodyPtr pbody;
+                if( !!penv && targettokens.size() > 1 ) {
+                    pbody = penv->GetKinBody(targettokens.at(1));
                 }
-            }
-            else {
-                RAVELOG_WARN("ikparam types do not match");
-            }
-        }
-        // need a space since grabbody is also a group
-        else if( targettokens.at(0) == std::string("grab") ) {
-            std::vector<int> vsourceindices(gsource.dof), vtargetindices(gtarget.dof);
-            if( (int)sourcetokens.size() < gsource.dof+2 ) {
-                throw OPENRAVE_EXCEPTION_FORMAT(_("source tokens '%s' do not have %d dof indices, guessing...."), gsource.name%gsource.dof, ORE_InvalidArguments);
-            }
-            else {
-                for(int i = 0; i < gsource.dof; ++i) {
-                    vsourceindices[i] = boost::lexical_cast<int>(sourcetokens.at(i+2));
+                if( !!penv && !pbody && sourcetokens.size() > 1 ) {
+                    pbody = penv->GetKinBody(sourcetokens.at(1));
                 }
-            }
-            if( (int)targettokens.size() < gtarget.dof+2 ) {
-                throw OPENRAVE_EXCEPTION_FORMAT(_("target tokens '%s' do not match dof '%d', guessing...."), gtarget.name%gtarget.dof, ORE_InvalidArguments);
-            }
-            else {
-                for(int i = 0; i < gtarget.dof; ++i) {
-                    vtargetindices[i] = boost::lexical_cast<int>(targettokens.at(i+2));
+                if( !pbody ) {
+                    RAVELOG_WARN(str(boost::format("could not find body '%s' or '%s'")%gtarget.name%gsource.name));
+                    vdefaultvalues.resize(gtarget.dof,0);
+                }
+                else {
+                    vdefaultvalues.resize(gtarget.dof);
+                    _bEnvironmentDefaultValues = true;
+                    RaveGetAffineDOFValuesFromTransform(vdefaultvalues.begin(),pbody->GetTransform(),affinetarget);
                 }
             }
 
-            bool bUninitializedData=false;
-            FOREACH(ittargetindex,vtargetindices) {
-                std::vector<int>::iterator it = find(vsourceindices.begin(),vsourceindices.end(),*ittargetindex);
-                if( it == vsourceindices.end() ) {
-                    bUninitializedData = true;
+            for(int index = 0; index < gtarget.dof; ++index) {
+                DOFAffine dof = RaveGetAffineDOFFromIndex(affinetarget,index);
+                int startindex = RaveGetIndexFromAffineDOF(affinetarget,dof);
+                if( affinesource & dof ) {
+                    int sourceindex = RaveGetIndexFromAffineDOF(affinesource,dof);
+                    vtransferindices.push_back(sourceindex + (index-startindex));
+                }
+                else {
                     vtransferindices.push_back(-1);
                 }
+            }
+
+            for(int j = 0; j < (int)vtransferindices.size(); ++j) {
+                if( vtransferindices[j] >= 0 ) {
+                    _AddCopy(targetoffset+j, sourceoffset+vtransferindices[j]);
+                }
                 else {
-                    vtransferindices.push_back(static_cast<int>(it-vsourceindices.begin()));
+                    if( j >= targetrotationstart && j < targetrotationend ) {
+                        if( j == targetrotationstart ) {
+                            // only convert when at first index
+                            RotationConversion rotationconversion;
+                            rotationconversion.targetindex = targetoffset+targetrotationstart;
+                            rotationconversion.sourceindex = sourceoffset+sourcerotationstart;
+                            rotationconversion.converterfn = rotconverterfn;
+                            _vrotationconversions.push_back(rotationconversion);
+                        }
+                    }
+                    else if( filluninitialized ) {
+                        _vdefaultvalues.emplace_back(targetoffset+j, vdefaultvalues.at(j));
+                    }
                 }
             }
+            return;
+        }
+    }
+    else if( targettokens.at(0).size() >= 8 && targettokens.at(0).substr(0,8) == "ikparam_") {
+        IkParameterizationType iktypesource, iktypetarget;
+        if( sourcetokens.size() >= 2 ) {
+            iktypesource = static_cast<IkParameterizationType>(boost::lexical_cast<int>(sourcetokens[1]));
+        }
+        else {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("ikparam type not present '%s'\n"),gsource.name,ORE_InvalidArguments);
+        }
+        if( targettokens.size() >= 2 ) {
+            iktypetarget = static_cast<IkParameterizationType>(boost::lexical_cast<int>(targettokens[1]));
+        }
+        else {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("ikparam type not present '%s'\n"),gtarget.name,ORE_InvalidArguments);
+        }
 
-            if( bUninitializedData && filluninitialized ) {
-                vdefaultvalues.resize(vtargetindices.size(),0);
+        if( iktypetarget == iktypesource ) {
+            vtransferindices.resize(IkParameterization::GetDOF(iktypetarget));
+            for(size_t i = 0; i < vtransferindices.size(); ++i) {
+                vtransferindices[i] = i;
+            }
+        }
+        else {
+            RAVELOG_WARN("ikparam types do not match");
+        }
+    }
+    // need a space since grabbody is also a group
+    else if( targettokens.at(0) == std::string("grab") ) {
+        std::vector<int> vsourceindices(gsource.dof), vtargetindices(gtarget.dof);
+        if( (int)sourcetokens.size() < gsource.dof+2 ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("source tokens '%s' do not have %d dof indices, guessing...."), gsource.name%gsource.dof, ORE_InvalidArguments);
+        }
+        else {
+            for(int i = 0; i < gsource.dof; ++i) {
+                vsourceindices[i] = boost::lexical_cast<int>(sourcetokens.at(i+2));
             }
         }
-        else if( targettokens.at(0) == std::string("grabbody") ) {
-            // TODO
+        if( (int)targettokens.size() < gtarget.dof+2 ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("target tokens '%s' do not match dof '%d', guessing...."), gtarget.name%gtarget.dof, ORE_InvalidArguments);
         }
         else {
-            throw OPENRAVE_EXCEPTION_FORMAT(_("unsupported token conversion: %s"),gtarget.name,ORE_InvalidArguments);
+            for(int i = 0; i < gtarget.dof; ++i) {
+                vtargetindices[i] = boost::lexical_cast<int>(targettokens.at(i+2));
+            }
         }
 
-        for(size_t i = 0; i < numpoints; ++i, psourcedata += sourcestride, ittargetdata += targetstride) {
-            for(size_t j = 0; j < vtransferindices.size(); ++j) {
-                if( vtransferindices[j] >= 0 ) {
-                    *(ittargetdata+j) = *(psourcedata+vtransferindices[j]);
-                }
-                else if( filluninitialized ) {
-                    *(ittargetdata+j) = vdefaultvalues.at(j);
-                }
+        bool bUninitializedData=false;
+        FOREACH(ittargetindex,vtargetindices) {
+            std::vector<int>::iterator it = find(vsourceindices.begin(),vsourceindices.end(),*ittargetindex);
+            if( it == vsourceindices.end() ) {
+                bUninitializedData = true;
+                vtransferindices.push_back(-1);
             }
+            else {
+                vtransferindices.push_back(static_cast<int>(it-vsourceindices.begin()));
+            }
+        }
+
+        if( bUninitializedData && filluninitialized ) {
+            vdefaultvalues.resize(vtargetindices.size(),0);
         }
     }
-}
+    else if( targettokens.at(0) == std::string("grabbody") ) {
+        // TODO
+    }
+    else {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("unsupported token conversion: %s"),gtarget.name,ORE_InvalidArguments);
+    }
 
-void ConfigurationSpecification::ConvertData(std::vector<dReal>::iterator ittargetdata, const ConfigurationSpecification &targetspec, std::vector<dReal>::const_iterator itsourcedata, const ConfigurationSpecification &sourcespec, size_t numpoints, EnvironmentBaseConstPtr penv, bool filluninitialized)
-{
-    for(size_t igroup = 0; igroup < targetspec._vgroups.size(); ++igroup) {
-        std::vector<ConfigurationSpecification::Group>::const_iterator itcompatgroup = sourcespec.FindCompatibleGroup(targetspec._vgroups[igroup]);
-        if( itcompatgroup != sourcespec._vgroups.end() ) {
-            ConfigurationSpecification::ConvertGroupData(ittargetdata+targetspec._vgroups[igroup].offset, targetspec.GetDOF(), targetspec._vgroups[igroup], itsourcedata+itcompatgroup->offset, sourcespec.GetDOF(), *itcompatgroup,numpoints,penv,filluninitialized);
+    for(int j = 0; j < (int)vtransferindices.size(); ++j) {
+        if( vtransferindices[j] >= 0 ) {
+            _AddCopy(targetoffset+j, sourceoffset+vtransferindices[j]);
         }
         else if( filluninitialized ) {
-            vector<dReal> vdefaultvalues(targetspec._vgroups[igroup].dof,0);
-            const string& name = targetspec._vgroups[igroup].name;
-            if( name.size() >= 12 && name.substr(0,12) == "joint_values" ) {
-                string bodyname;
-                stringstream ss(name.substr(12));
-                ss >> bodyname;
-                if( !!ss ) {
-                    if( !!penv ) {
-                        KinBodyPtr body = penv->GetKinBody(bodyname);
-                        if( !!body ) {
-                            vector<dReal> values;
-                            body->GetDOFValues(values);
-                            std::vector<int> indices((istream_iterator<int>(ss)), istream_iterator<int>());
-                            for(size_t i = 0; i < indices.size(); ++i) {
-                                vdefaultvalues.at(i) = values.at(indices[i]);
-                            }
-                        }
-                    }
-                }
-            }
-            else if( name.size() >= 16 && name.substr(0,16) == "affine_transform" ) {
-                string bodyname;
-                int affinedofs;
-                stringstream ss(name.substr(16));
-                ss >> bodyname >> affinedofs;
-                if( !!ss ) {
-                    Transform tdefault;
-                    if( !!penv ) {
-                        KinBodyPtr body = penv->GetKinBody(bodyname);
-                        if( !!body ) {
-                            tdefault = body->GetTransform();
-                        }
+            _vdefaultvalues.emplace_back(targetoffset+j, vdefaultvalues.at(j));
+        }
+    }
+}
+
+void ConfigurationSpecification::ConversionPlan::_AddGroupDefaultValues(int targetoffset, const Group& gtarget, EnvironmentBaseConstPtr penv)
+{
+    vector<dReal> vdefaultvalues(gtarget.dof,0);
+    const string& name = gtarget.name;
+    if( name.size() >= 12 && name.substr(0,12) == "joint_values" ) {
+        string bodyname;
+        stringstream ss(name.substr(12));
+        ss >> bodyname;
+        if( !!ss ) {
+            if( !!penv ) {
+                KinBodyPtr body = penv->GetKinBody(bodyname);
+                if( !!body ) {
+                    _bEnvironmentDefaultValues = true;
+                    vector<dReal> values;
+                    body->GetDOFValues(values);
+                    std::vector<int> indices((istream_iterator<int>(ss)), istream_iterator<int>());
+                    for(size_t i = 0; i < indices.size(); ++i) {
+                        vdefaultvalues.at(i) = values.at(indices[i]);
                     }
-                    BOOST_ASSERT((int)vdefaultvalues.size() == RaveGetAffineDOF(affinedofs));
-                    RaveGetAffineDOFValuesFromTransform(vdefaultvalues.begin(),tdefault,affinedofs);
                 }
             }
-            else if( name.size() >= 13 && name.substr(0,13) == "outputSignals") {
-                std::fill(vdefaultvalues.begin(), vdefaultvalues.end(), -1);
-            }
-            else if( name != "deltatime" ) {
-                // messages are too frequent
-                //RAVELOG_VERBOSE(str(boost::format("cannot initialize unknown group '%s'")%name));
-            }
-            int offset = targetspec._vgroups[igroup].offset;
-            for(size_t i = 0; i < numpoints; ++i, offset += targetspec.GetDOF()) {
-                for(size_t j = 0; j < vdefaultvalues.size(); ++j) {
-                    *(ittargetdata+offset+j) = vdefaultvalues[j];
+        }
+    }
+    else if( name.size() >= 16 && name.substr(0,16) == "affine_transform" ) {
+        string bodyname;
+        int affinedofs;
+        stringstream ss(name.substr(16));
+        ss >> bodyname >> affinedofs;
+        if( !!ss ) {
+            Transform tdefault;
+            if( !!penv ) {
+                KinBodyPtr body = penv->GetKinBody(bodyname);
+                if( !!body ) {
+                    _bEnvironmentDefaultValues = true;
+                    tdefault = body->GetTransform();
                 }
             }
+            BOOST_ASSERT((int)vdefaultvalues.size() == RaveGetAffineDOF(affinedofs));
+            RaveGetAffineDOFValuesFromTransform(vdefaultvalues.begin(),tdefault,affinedofs);
         }
     }
+    else if( name.size() >= 13 && name.substr(0,13) == "outputSignals") {
+        std::fill(vdefaultvalues.begin(), vdefaultvalues.end(), -1);
+    }
+    else if( name != "deltatime" ) {
+        // messages are too frequent
+        //RAVELOG_VERBOSE(str(boost::format("cannot initialize unknown group '%s'")%name));
+    }
+    for(size_t j = 0; j < vdefaultvalues.size(); ++j) {
+        _vdefaultvalues.emplace_back(targetoffset+j, vdefaultvalues[j]);
+    }
 }
 
 std::string ConfigurationSpecification::GetInterpolationDerivative(const std::string& interpolation, int deriv)
@@ -1944,11 +2017,8 @@ bool ConfigurationSpecification::Reader::endElement(const std::string& name)
 
 void ConfigurationSpecification::Reader::characters(const std::string& ch)
 {
-    if( !_preader ) {
-        _ss.clear();
-        _ss << ch;
-    }
-    else {
+    // the groups are fully described by their attributes, so the character data is not buffered
+    if( !!_preader ) {
         _preader->characters(ch);
     }
 }
@@ -1989,7 +2059,7 @@ std::istream& operator>>(std::istream& I, ConfigurationSpecification& spec)
             throw OPENRAVE_EXCEPTION_FORMAT(_("error, failed to find </configuration> in %s"),buf.str(),ORE_InvalidArguments);
         }
         ConfigurationSpecification::Reader reader(spec);
-        xmlreaders::ParseXMLData(reader, pbuf.c_str(), ppsize);
+        xmlreaders::ParseCachedXMLData(reader, pbuf.c_str(), ppsize);
         BOOST_ASSERT(spec.IsValid());
     }
 
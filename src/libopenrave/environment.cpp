@@ -109,7 +109,7 @@ void EnvironmentBase::EnvironmentBaseInfo::DeserializeJSON(const rapidjson::Valu
     DeserializeJSONWithMapping(rEnvInfo, fUnitScale, options, vInputToBodyInfoMapping);
 }
 
-void EnvironmentBase::EnvironmentBaseInfo::DeserializeJSONWithMapping(const rapidjson::Value& rEnvInfo, dReal fUnitScale, int options, const std::vector<int>& vInputToBodyInfoMapping)
+void EnvironmentBase::EnvironmentBaseInfo::DeserializeJSONWithMapping(const rapidjson::Value& rEnvInfo, dReal fUnitScale, int options, const std::vector<int>& vInputToBodyInfoMapping, const std::vector<KinBody::KinBodyInfoPtr>& vPreparedBodyInfos)
 {
     if( !rEnvInfo.IsObject() ) {
         throw OPENRAVE_EXCEPTION_FORMAT("Passed in JSON '%s' is not a valid EnvironmentInfo object", orjson::DumpJson(rEnvInfo), ORE_InvalidArguments);
@@ -234,8 +234,14 @@ void EnvironmentBase::EnvironmentBaseInfo::DeserializeJSONWithMapping(const rapi
                 if (itExistingBodyInfo == _vBodyInfos.end()) {
                     // in case no such id
                     if (!isDeleted) {
-                        RobotBase::RobotBaseInfoPtr pRobotBaseInfo(new RobotBase::RobotBaseInfo());
-                        pRobotBaseInfo->DeserializeJSON(rKinBodyInfo, fUnitScale, options);
+                        RobotBase::RobotBaseInfoPtr pRobotBaseInfo;
+                        if( iInputBodyIndex < (int)vPreparedBodyInfos.size() ) {
+                            pRobotBaseInfo = OPENRAVE_DYNAMIC_POINTER_CAST<RobotBase::RobotBaseInfo>(vPreparedBodyInfos[iInputBodyIndex]);
+                        }
+                        if( !pRobotBaseInfo ) {
+                            pRobotBaseInfo.reset(new RobotBase::RobotBaseInfo());
+                            pRobotBaseInfo->DeserializeJSON(rKinBodyInfo, fUnitScale, options);
+                        }
                         if (!pRobotBaseInfo->_name.empty()) {
                             pRobotBaseInfo->_id = id;
                             _vBodyInfos.push_back(pRobotBaseInfo);
@@ -270,8 +276,14 @@ void EnvironmentBase::EnvironmentBaseInfo::DeserializeJSONWithMapping(const rapi
                 if (itExistingBodyInfo == _vBodyInfos.end()) {
                     // in case no such id
                     if (!isDeleted) {
-                        KinBody::KinBodyInfoPtr pKinBodyInfo(new KinBody::KinBodyInfo());
-                        pKinBodyInfo->DeserializeJSON(rKinBodyInfo, fUnitScale, options);
+                        KinBody::KinBodyInfoPtr pKinBodyInfo;
+                        if( iInputBodyIndex < (int)vPreparedBodyInfos.size() && !!vPreparedBodyInfos[iInputBodyIndex] && !OPENRAVE_DYNAMIC_POINTER_CAST<RobotBase::RobotBaseInfo>(vPreparedBodyInfos[iInputBodyIndex]) ) {
+                            pKinBodyInfo = vPreparedBodyInfos[iInputBodyIndex];
+                        }
+                        if( !pKinBodyInfo ) {
+                            pKinBodyInfo.reset(new KinBody::KinBodyInfo());
+                            pKinBodyInfo->DeserializeJSON(rKinBodyInfo, fUnitScale, options);
+                        }
                         if (!pKinBodyInfo->_name.empty()) {
                             pKinBodyInfo->_id = id;
                             _vBodyInfos.push_back(pKinBodyInfo);
@@ -291,6 +291,19 @@ bool IkSolverBase::SolveAll(const IkParameterization& param, const std::vector<d
     return SolveAll(param, vFreeParameters, filteroptions, ikreturns);
 }
 
+int IkSolverBase::SolveBatch(const std::vector<IkParameterization>& vparams, const std::vector<dReal>& q0, int filteroptions, std::vector<IkReturnPtr>& vikreturns, int numThreads)
+{
+    int numsolved = 0;
+    vikreturns.resize(vparams.size());
+    for(size_t iparam = 0; iparam < vparams.size(); ++iparam) {
+        vikreturns[iparam].reset(new IkReturn(IKRA_Reject));
+        if( Solve(vparams[iparam], q0, filteroptions, vikreturns[iparam]) ) {
+            ++numsolved;
+        }
+    }
+    return numsolved;
+}
+
 UserDataPtr IkSolverBase::RegisterCustomFilter(int32_t priority, const IkSolverBase::IkFilterCallbackFn &filterfn)
 {
     CustomIkSolverFilterDataPtr pdata(new CustomIkSolverFilterData(priority,filterfn,shared_iksolver()));
@@ -35,6 +35,7 @@ InterfaceBase::~InterfaceBase()
     __mapUserData.clear();
     __penv.reset();
     __mapJSONCommands.clear();
+    __mapTypedCommands.clear();
 }
 
 void InterfaceBase::SetUserData(const std::string& key, UserDataPtr data) const
@@ -251,6 +252,62 @@ void InterfaceBase::SendJSONCommand(const std::string& cmdname, const rapidjson:
     interfacecmd->fn(input, output, allocator);
 }
 
+bool InterfaceBase::SupportsTypedCommand(const std::string& cmd)
+{
+    boost::shared_lock< boost::shared_mutex > lock(_mutexInterface);
+    return __mapTypedCommands.find(cmd) != __mapTypedCommands.end();
+}
+
+void InterfaceBase::RegisterTypedCommand(const std::string& cmdname, InterfaceBase::InterfaceTypedCommandFn fncmd, const std::string& strhelp)
+{
+    std::unique_lock<boost::shared_mutex> lock(_mutexInterface);
+    if((cmdname.size() == 0)|| !utils::IsValidName(cmdname) || !fncmd ) {
+        throw openrave_exception(str(boost::format(_("command '%s' invalid"))%cmdname),ORE_InvalidArguments);
+    }
+    if( __mapTypedCommands.find(cmdname) != __mapTypedCommands.end() ) {
+        throw openrave_exception(str(boost::format(_("command '%s' already registered"))%cmdname),ORE_InvalidArguments);
+    }
+    __mapTypedCommands[cmdname] = std::make_pair(fncmd, strhelp);
+}
+
+void InterfaceBase::UnregisterTypedCommand(const std::string& cmdname)
+{
+    std::unique_lock<boost::shared_mutex> lock(_mutexInterface);
+    TYPEDCMDMAP::iterator it = __mapTypedCommands.find(cmdname);
+    if( it != __mapTypedCommands.end() ) {
+        __mapTypedCommands.erase(it);
+    }
+}
+
+InterfaceBase::InterfaceTypedCommandFn InterfaceBase::GetTypedCommand(const std::string& cmd)
+{
+    boost::shared_lock< boost::shared_mutex > lock(_mutexInterface);
+    TYPEDCMDMAP::const_iterator it = __mapTypedCommands.find(cmd);
+    if( it == __mapTypedCommands.end() ) {
+        return NULL;
+    }
+    return it->second.first;
+}
+
+bool InterfaceBase::SendTypedCommand(const std::string& cmd, const TypedCommandData& input, TypedCommandData& output)
+{
+    InterfaceTypedCommandFn fncmd = GetTypedCommand(cmd);
+    if( !fncmd ) {
+        throw openrave_exception(str(boost::format(_("failed to find typed command '%s' in interface %s\n"))%cmd.c_str()%GetXMLId()),ORE_CommandNotSupported);
+    }
+    output.Clear();
+    if( !fncmd(*this, input, output) ) {
+        RAVELOG_VERBOSE(str(boost::format("typed command failed in interface %s: %s\n")%GetXMLId()%cmd));
+        return false;
+    }
+    return true;
+}
+
+void InterfaceBase::GetMemoryUsage(MemoryUsage& memoryusage) const
+{
+    memoryusage.Add("readables", GetReadablesMemoryUsage());
+}
+
 void InterfaceBase::_GetJSONCommandHelp(const rapidjson::Value& input, rapidjson::Value& output, rapidjson::Document::AllocatorType& allocator) const {
     output.SetObject();
 
@@ -263,7 +320,29 @@ ReadablePtr ReadablesContainer::GetReadableInterface(const std::string& id) cons
 {
     boost::shared_lock< boost::shared_mutex > lock(_mutexInterface);
     READERSMAP::const_iterator it = __mapReadableInterfaces.find(id);
-    return it != __mapReadableInterfaces.end() ? it->second : ReadablePtr();
+    return it != __mapReadableInterfaces.end() ? LazyJSONReadable::Resolve(it->second) : ReadablePtr();
+}
+
+uint64_t ReadablesContainer::GetReadablesMemoryUsage() const
+{
+    boost::shared_lock< boost::shared_mutex > lock(_mutexInterface);
+    uint64_t bytes = 0;
+    FOREACHC(it, __mapReadableInterfaces) {
+        bytes += sizeof(READERSMAP::value_type) + it->first.capacity();
+        const LazyJSONReadable* plazy = dynamic_cast<const LazyJSONReadable*>(it->second.get());
+        if( !!plazy && !plazy->IsDeserialized() ) {
+            // do not deserialize just for the estimate
+            bytes += plazy->GetJSONSize();
+            continue;
+        }
+        if( !!it->second ) {
+            rapidjson::Document rReadable;
+            if( it->second->SerializeJSON(rReadable, rReadable.GetAllocator(), 1.0, 0) ) {
+                bytes += rReadable.GetAllocator().Size();
+            }
+        }
+    }
+    return bytes;
 }
 
 ReadablePtr ReadablesContainer::SetReadableInterface(const std::string& id, ReadablePtr readable)
@@ -16,7 +16,10 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "libopenrave.h"
 #include <algorithm>
+#include <deque>
 #include <unordered_set>
+#include <mutex>
+#include <random>
 
 // used for functions that are also used internally
 #define CHECK_NO_INTERNAL_COMPUTATION OPENRAVE_ASSERT_FORMAT(_nHierarchyComputed == 0, "env=%s, body %s cannot be added to environment when doing this operation, current value is %d", GetEnv()->GetNameId()%GetName()%_nHierarchyComputed, ORE_InvalidState);
@@ -68,21 +71,38 @@ inline void _ResizeVectorFor2DTable(std::vector<int8_t>& vec, size_t vectorSize)
 class ChangeCallbackData : public UserData
 {
 public:
-    ChangeCallbackData(int properties, const boost::function<void()>& callback, KinBodyConstPtr pbody) : _properties(properties), _callback(callback), _pweakbody(pbody) {
+    ChangeCallbackData(uint32_t properties, const boost::function<void()>& callback, KinBodyConstPtr pbody) : _properties(properties), _pcallback(new boost::function<void()>(callback)), _pweakbody(pbody) {
     }
     virtual ~ChangeCallbackData() {
         KinBodyConstPtr pbody = _pweakbody.lock();
         if( !!pbody ) {
             std::unique_lock<boost::shared_mutex> lock(pbody->GetInterfaceMutex());
-            FOREACH(itinfo, _iterators) {
-                pbody->_vlistRegisteredCallbacks.at(itinfo->first).erase(itinfo->second);
+            uint32_t properties = _properties;
+            for(uint32_t index = 0; properties; ++index, properties >>= 1) {
+                if( properties & 1 ) {
+                    KinBody::ChangeCallbackVectorConstPtr pcallbacks = pbody->_vRegisteredCallbacks[index];
+                    if( !!pcallbacks ) {
+                        boost::shared_ptr<KinBody::ChangeCallbackVector> pnewcallbacks(new KinBody::ChangeCallbackVector());
+                        pnewcallbacks->reserve(pcallbacks->size());
+                        FOREACHC(itcallback, *pcallbacks) {
+                            if( *itcallback != _pcallback ) {
+                                pnewcallbacks->push_back(*itcallback);
+                            }
+                        }
+                        if( pnewcallbacks->size() > 0 ) {
+                            boost::atomic_store(&pbody->_vRegisteredCallbacks[index], KinBody::ChangeCallbackVectorConstPtr(pnewcallbacks));
+                        }
+                        else {
+                            boost::atomic_store(&pbody->_vRegisteredCallbacks[index], KinBody::ChangeCallbackVectorConstPtr());
+                        }
+                    }
+                }
             }
         }
     }
 
-    list< std::pair<uint32_t, list<UserDataWeakPtr>::iterator> > _iterators;
-    int _properties;
-    boost::function<void()> _callback;
+    uint32_t _properties;
+    boost::shared_ptr<const boost::function<void()> > _pcallback; ///< shared with the callback vectors of the body so that a callback being called stays valid even if it is unregistered at the same time
 protected:
     boost::weak_ptr<KinBody const> _pweakbody;
 };
@@ -414,10 +434,13 @@ void KinBody::KinBodyInfo::DeserializeJSON(const rapidjson::Value& value, dReal
 void KinBody::KinBodyInfo::_DeserializeReadableInterface(const std::string& id, const rapidjson::Value& rReadable, dReal fUnitScale)
 {
     std::map<std::string, ReadablePtr>::iterator itReadable = _mReadableInterfaces.find(id);
-    ReadablePtr pReadable;
-    if(itReadable != _mReadableInterfaces.end()) {
-        pReadable = itReadable->second;
+    if(itReadable == _mReadableInterfaces.end()) {
+        // most readables are never accessed, so only deserialize them when they are
+        _mReadableInterfaces[id].reset(new LazyJSONReadable(PT_KinBody, id, rReadable, fUnitScale));
+        return;
     }
+    // updating an existing readable, so the reader has to merge into it
+    ReadablePtr pReadable = LazyJSONReadable::Resolve(itReadable->second);
     BaseJSONReaderPtr pReader = RaveCallJSONReader(PT_KinBody, id, pReadable, AttributesList());
     if (!!pReader) {
         pReader->DeserializeJSON(rReadable, fUnitScale);
@@ -436,10 +459,14 @@ KinBody::KinBody(InterfaceType type, EnvironmentBasePtr penv) : InterfaceBase(ty
 {
     _nHierarchyComputed = 0;
     _nParametersChanged = 0;
+    _nCoalescedParametersChanged = 0;
+    _nChangeCallbackCoalescers = 0;
     _bMakeJoinedLinksAdjacent = true;
     _environmentBodyIndex = 0;
     _nNonAdjacentLinkCache = 0x80000000;
     _nUpdateStampId = 0;
+    _nMassMatrixCacheStamp = -1;
+    _nGravityTorquesCacheStamp = -1;
     _bAreAllJoints1DOFAndNonCircular = false;
     _lastModifiedAtUS = 0;
     _revisionId = 0;
@@ -1401,9 +1428,12 @@ void KinBody::SetTransform(const Transform& bodyTransform)
     Transform baseLinkTransform = bodyTransform * _baseLinkInBodyTransform;
     Transform tbaseinv = _veclinks.front()->GetTransform().inverse();
     Transform tapply = baseLinkTransform * tbaseinv;
+    // moving all the links rigidly keeps them consistent with the dof values
+    const bool bForceFullKinematicsUpdate = _bForceFullKinematicsUpdate;
     FOREACH(itlink, _veclinks) {
         (*itlink)->SetTransform(tapply * (*itlink)->GetTransform());
     }
+    _bForceFullKinematicsUpdate = bForceFullKinematicsUpdate;
     _UpdateGrabbedBodies();
     _PostprocessChangedParameters(Prop_LinkTransforms);
 }
@@ -1735,6 +1765,26 @@ void KinBody::GetLinkTransformations(std::vector<Transform>& transforms, std::ve
     }
 }
 
+void KinBody::GetLinkPoses(LinkPoses& poses) const
+{
+    if( poses.updatestamp == _nUpdateStampId && poses.vTranslations.size() == 3*_veclinks.size() ) {
+        return;
+    }
+    const size_t nlinks = _veclinks.size();
+    poses.vQuaternions.resize(4*nlinks);
+    poses.vTranslations.resize(3*nlinks);
+    dReal* pquat = poses.vQuaternions.data();
+    dReal* ptrans = poses.vTranslations.data();
+    for(const LinkPtr& plink : _veclinks) {
+        const Transform& t = plink->GetTransform();
+        pquat[0] = t.rot.x; pquat[1] = t.rot.y; pquat[2] = t.rot.z; pquat[3] = t.rot.w;
+        ptrans[0] = t.trans.x; ptrans[1] = t.trans.y; ptrans[2] = t.trans.z;
+        pquat += 4;
+        ptrans += 3;
+    }
+    poses.updatestamp = _nUpdateStampId;
+}
+
 void KinBody::GetLinkEnableStates(std::vector<uint8_t>& enablestates) const
 {
     enablestates.resize(_veclinks.size());
@@ -2106,6 +2156,8 @@ void KinBody::SetDOFValues(const std::vector<dReal>& vJointValues, const Transfo
     for(size_t i = 1; i < _veclinks.size(); ++i) {
         _veclinks[i]->SetTransform(tbase*_veclinks[i]->GetTransform());
     }
+    // all links moved, so cannot skip any of them even if the joint values do not change
+    _bForceFullKinematicsUpdate = true;
     SetDOFValues(vJointValues,checklimits);
 }
 
@@ -2127,6 +2179,7 @@ void KinBody::SetDOFValues(const dReal* pJointValues, int dof, uint32_t checklim
     OPENRAVE_ASSERT_OP_FORMAT((int)dof,>=,expecteddof, "env=%s, not enough values %d<%d", GetEnv()->GetNameId()%dof%GetDOF(),ORE_InvalidArguments);
 
     GetDOFValues(_vTempJoints);
+    _vPreviousDOFValuesCache = _vTempJoints;
     if( dofindices.size() > 0 ) {
         // user only set a certain number of indices, so have to fill the temporary array with the full set of values first
         // and then overwrite with the user set values
@@ -2232,12 +2285,49 @@ void KinBody::SetDOFValues(const dReal* pJointValues, int dof, uint32_t checklim
                     joint._doflastsetvalues[iaxis] = pJointValues[dofindex+iaxis];
                 }
             }
+            _bForceFullKinematicsUpdate = false;
             _UpdateGrabbedBodies();
             _PostprocessChangedParameters(Prop_LinkTransforms);
             return;
         }
     }
 
+    // find the links downstream of the dofs that changed so that only they are recomputed.
+    // passive mimic joints get their values while traversing the hierarchy and can be referenced by later joints, so they require a full update
+    bool bIncremental = !_bForceFullKinematicsUpdate;
+    _bForceFullKinematicsUpdate = false;
+    for(const JointPtr& pjoint : _vPassiveJoints) {
+        if( pjoint->IsMimic() ) {
+            bIncremental = false;
+            break;
+        }
+    }
+    std::vector<uint8_t>& vlinksmoved = _vLinksMovedCache;
+    if( bIncremental ) {
+        const size_t nlinks = _veclinks.size();
+        vlinksmoved.resize(nlinks);
+        std::fill(vlinksmoved.begin(), vlinksmoved.end(), 0);
+        bool bAnyLinkMoved = false;
+        for(int idof = 0; idof < (int)_vPreviousDOFValuesCache.size(); ++idof) {
+            if( pJointValues[idof] == _vPreviousDOFValuesCache[idof] ) {
+                continue;
+            }
+            const int8_t* pjointaffectinglinks = &_vJointsAffectingLinks[_vDOFIndices[idof]*nlinks];
+            for(size_t ilink = 0; ilink < nlinks; ++ilink) {
+                // -1 marks the links moved by the joint in the negative direction
+                if( pjointaffectinglinks[ilink] != 0 ) {
+                    vlinksmoved[ilink] = 1;
+                    bAnyLinkMoved = true;
+                }
+            }
+        }
+        if( !bAnyLinkMoved ) {
+            // nothing moved, so no need to update grabbed bodies, but the callbacks and stamps are the same as for a full update
+            _PostprocessChangedParameters(Prop_LinkTransforms);
+            return;
+        }
+    }
+
     // have to compute the angles ahead of time since they are dependent on the link
     const int nActiveJoints = _vecjoints.size();
     const int nPassiveJoints = _vPassiveJoints.size();
@@ -2288,6 +2378,12 @@ void KinBody::SetDOFValues(const dReal* pJointValues, int dof, uint32_t checklim
         const LinkPtr& parentlink = joint._attachedbodies[0];
         const LinkPtr& childlink = joint._attachedbodies[1];
 
+        if( bIncremental && !vlinksmoved[childlink->GetIndex()] ) {
+            // keep the current transform, but mark as computed so that other joints in a closed loop do not overwrite it
+            vlinkscomputed[childlink->GetIndex()] = 1;
+            continue;
+        }
+
         if( joint.IsStatic() ) {
             // if joint.IsStatic(), then joint._info._tRightNoOffset and tjoint are assigned identities
             const Transform t = (!!parentlink ? parentlink->GetTransform() : _veclinks.at(0)->GetTransform()) * joint.GetInternalHierarchyLeftTransform();
@@ -2479,10 +2575,110 @@ void KinBody::SetDOFValues(const dReal* pJointValues, int dof, uint32_t checklim
         vlinkscomputed[childlink->GetIndex()] = 1;
     }
 
-    _UpdateGrabbedBodies();
+    // the link transforms set above are consistent with the dof values
+    _bForceFullKinematicsUpdate = false;
+    if( bIncremental ) {
+        _UpdateGrabbedBodies(vlinksmoved);
+    }
+    else {
+        _UpdateGrabbedBodies();
+    }
     _PostprocessChangedParameters(Prop_LinkTransforms);
 }
 
+template <typename T>
+void KinBody::ComputeLinkTransformations(const T* pdofvalues, std::vector< RaveTransform<T> >& vlinktransforms) const
+{
+    CHECK_INTERNAL_COMPUTATION;
+    const int nActiveJoints = _vecjoints.size();
+    // links that are not reached by any joint keep their current transform
+    vlinktransforms.resize(_veclinks.size());
+    for(size_t ilink = 0; ilink < _veclinks.size(); ++ilink) {
+        vlinktransforms[ilink] = _veclinks[ilink]->GetTransform();
+    }
+
+    std::vector<uint8_t> vlinkscomputed(_veclinks.size(), 0);
+    if( vlinkscomputed.size() > 0 ) {
+        vlinkscomputed[0] = 1;
+    }
+    // passive mimic joints can be referenced by later joints, so keep their new values
+    std::vector< boost::array<dReal,3> > vPassiveJointValues(_vPassiveJoints.size());
+    for(size_t ipassive = 0; ipassive < _vPassiveJoints.size(); ++ipassive) {
+        _vPassiveJoints[ipassive]->GetValues(vPassiveJointValues[ipassive]);
+    }
+    std::vector<dReal> vtempvalues, veval;
+    boost::array<T,3> vjointvalues;
+    for(size_t ijoint = 0; ijoint < _vTopologicallySortedJointsAll.size(); ++ijoint) {
+        const Joint& joint = *_vTopologicallySortedJointsAll[ijoint];
+        const LinkPtr& parentlink = joint._attachedbodies[0];
+        const int childindex = joint._attachedbodies[1]->GetIndex();
+        const RaveTransform<T>& tparent = vlinktransforms[!!parentlink ? parentlink->GetIndex() : 0];
+        if( joint.IsStatic() ) {
+            if( !vlinkscomputed[childindex] ) {
+                vlinktransforms[childindex] = tparent * RaveTransform<T>(joint.GetInternalHierarchyLeftTransform());
+                vlinkscomputed[childindex] = 1;
+            }
+            continue;
+        }
+
+        if( joint.GetType() & JointSpecialBit ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("env=%s, body %s joint %s has type 0x%x, which ComputeLinkTransformations does not support"), GetEnv()->GetNameId()%GetName()%joint.GetName()%joint.GetType(), ORE_NotImplemented);
+        }
+
+        const int jointindex = _vTopologicallySortedJointIndicesAll[ijoint];
+        const int dofindex = joint.GetDOFIndex();
+        for(int iaxis = 0; iaxis < joint.GetDOF(); ++iaxis) {
+            if( joint.IsMimic(iaxis) ) {
+                // the mimic equations are only available in dReal
+                vtempvalues.clear();
+                FOREACHC(itdofformat, joint._vmimic[iaxis]->_vdofformat) {
+                    if( itdofformat->dofindex >= 0 ) {
+                        vtempvalues.push_back(pdofvalues[itdofformat->dofindex]);
+                    }
+                    else {
+                        vtempvalues.push_back(vPassiveJointValues.at(itdofformat->jointindex-nActiveJoints).at(itdofformat->axis));
+                    }
+                }
+                if( joint._Eval(iaxis, 0, vtempvalues, veval) != 0 || veval.empty() ) {
+                    throw OPENRAVE_EXCEPTION_FORMAT(_("env=%s, body %s failed to evaluate mimic joint %s"), GetEnv()->GetNameId()%GetName()%joint.GetName(), ORE_InvalidState);
+                }
+                vjointvalues[iaxis] = veval[0];
+                if( dofindex < 0 ) {
+                    vPassiveJointValues.at(jointindex-nActiveJoints)[iaxis] = veval[0];
+                }
+            }
+            else if( dofindex >= 0 ) {
+                vjointvalues[iaxis] = pdofvalues[dofindex+iaxis];
+            }
+            else {
+                vjointvalues[iaxis] = vPassiveJointValues.at(jointindex-nActiveJoints)[iaxis];
+            }
+        }
+
+        // do the test after the mimic values are updated since later joints can reference them
+        if( vlinkscomputed[childindex] ) {
+            continue;
+        }
+        RaveTransform<T> tjoint;
+        for(int iaxis = 0; iaxis < joint.GetDOF(); ++iaxis) {
+            RaveTransform<T> tdelta;
+            const RaveVector<T> vaxis = joint.GetInternalHierarchyAxis(iaxis);
+            if( joint.IsRevolute(iaxis) ) {
+                tdelta.rot = quatFromAxisAngle(vaxis, vjointvalues[iaxis]);
+            }
+            else {
+                tdelta.trans = vaxis * vjointvalues[iaxis];
+            }
+            tjoint = iaxis == 0 ? tdelta : tjoint * tdelta;
+        }
+        vlinktransforms[childindex] = tparent * (RaveTransform<T>(joint.GetInternalHierarchyLeftTransform()) * tjoint * RaveTransform<T>(joint.GetInternalHierarchyRightTransform()));
+        vlinkscomputed[childindex] = 1;
+    }
+}
+
+template void KinBody::ComputeLinkTransformations<float>(const float*, std::vector< RaveTransform<float> >&) const;
+template void KinBody::ComputeLinkTransformations<double>(const double*, std::vector< RaveTransform<double> >&) const;
+
 bool KinBody::IsDOFRevolute(int dofindex) const
 {
     int jointindex = _vDOFIndices.at(dofindex);
@@ -2758,6 +2954,111 @@ void KinBody::ComputeJacobianTranslation(const int linkindex,
     }
 }
 
+template <typename T>
+void KinBody::ComputeJacobianTranslations(const std::vector< std::pair<int, Vector> >& vLinkPositions,
+                                          T* pjacobians,
+                                          const std::vector<int>& dofindices) const
+{
+    CHECK_INTERNAL_COMPUTATION;
+    const int nlinks = _veclinks.size();
+    const int nActiveJoints = _vecjoints.size();
+    const size_t dofstride = dofindices.empty() ? this->GetDOF() : dofindices.size();
+    const size_t jacobianstride = 3 * dofstride;
+    if( dofstride == 0 || vLinkPositions.empty() ) {
+        return;
+    }
+    std::fill(pjacobians, pjacobians + jacobianstride * vLinkPositions.size(), T(0));
+
+    std::vector<std::pair<int, dReal> > vDofindexDerivativePairs; ///< vector of (dof index, total derivative) pairs, only used for passive mimic joints
+    std::map< std::pair<Mimic::DOFFormat, int>, dReal > mTotalderivativepairValue; ///< map a joint pair (z, x) to the total derivative dz/dx
+
+    size_t igroupstart = 0;
+    while( igroupstart < vLinkPositions.size() ) {
+        // consecutive positions attached to the same link share the traversal
+        const int linkindex = vLinkPositions[igroupstart].first;
+        OPENRAVE_ASSERT_FORMAT(linkindex >= 0 && linkindex < nlinks, "body %s bad link index %d (num links %d)", this->GetName() % linkindex % nlinks, ORE_InvalidArguments);
+        size_t igroupend = igroupstart + 1;
+        while( igroupend < vLinkPositions.size() && vLinkPositions[igroupend].first == linkindex ) {
+            ++igroupend;
+        }
+
+        const int offset = linkindex * nlinks;
+        for(int curlink = 0;
+            _vAllPairsShortestPaths[offset + curlink].first >= 0;     // parent link is still available
+            curlink = _vAllPairsShortestPaths[offset + curlink].first // get index of parent link
+            ) {
+            const int jointindex = _vAllPairsShortestPaths[offset + curlink].second; ///< generalized joint index, which counts in [_vecjoints, _vPassiveJoints]
+            const bool bActive = jointindex < nActiveJoints;
+            const Joint& joint = bActive ? *_vecjoints[jointindex] : *_vPassiveJoints.at(jointindex - nActiveJoints);
+            if( bActive && !this->DoesAffect(jointindex, linkindex) ) {
+                continue;
+            }
+            const Vector vanchor = joint.GetAnchor();
+            for(int idof = 0; idof < joint.GetDOF(); ++idof) {
+                if( !bActive && !joint.IsMimic(idof) ) {
+                    continue;
+                }
+                const bool bPrismatic = joint.IsPrismatic(idof);
+                if( !bPrismatic && !joint.IsRevolute(idof) ) {
+                    RAVELOG_WARN("ComputeJacobianTranslations only supports revolute and prismatic joints, but not this joint type %d", joint.GetType());
+                    continue;
+                }
+                const Vector vaxis = joint.GetAxis(idof);
+
+                // columns and their weights that this axis contributes to. Active joints contribute to exactly one column
+                const std::pair<int, dReal>* pDerivativePairs = NULL;
+                size_t nDerivativePairs = 1;
+                std::pair<int, dReal> activeDerivativePair(joint.GetDOFIndex() + idof, 1.0);
+                if( bActive ) {
+                    pDerivativePairs = &activeDerivativePair;
+                }
+                else {
+                    joint._ComputePartialVelocities(vDofindexDerivativePairs, idof, mTotalderivativepairValue);
+                    pDerivativePairs = vDofindexDerivativePairs.data();
+                    nDerivativePairs = vDofindexDerivativePairs.size();
+                }
+
+                for(size_t ipair = 0; ipair < nDerivativePairs; ++ipair) {
+                    int index = pDerivativePairs[ipair].first;
+                    if( !dofindices.empty() ) {
+                        const std::vector<int>::const_iterator itindex = std::find(dofindices.begin(), dofindices.end(), index);
+                        if( itindex == dofindices.end() ) {
+                            continue;
+                        }
+                        index = itindex - dofindices.begin();
+                    }
+                    const dReal fderiv = pDerivativePairs[ipair].second;
+                    if( bPrismatic ) {
+                        const T fx = vaxis.x * fderiv, fy = vaxis.y * fderiv, fz = vaxis.z * fderiv;
+                        for(size_t ipos = igroupstart; ipos < igroupend; ++ipos) {
+                            T* pjacobian = pjacobians + jacobianstride * ipos + index;
+                            pjacobian[0] += fx;
+                            pjacobian[dofstride] += fy;
+                            pjacobian[2*dofstride] += fz;
+                        }
+                    }
+                    else {
+                        // axis x (position - anchor), scaled by the derivative
+                        const T ax = vaxis.x * fderiv, ay = vaxis.y * fderiv, az = vaxis.z * fderiv;
+                        for(size_t ipos = igroupstart; ipos < igroupend; ++ipos) {
+                            const Vector& position = vLinkPositions[ipos].second;
+                            const T dx = position.x - vanchor.x, dy = position.y - vanchor.y, dz = position.z - vanchor.z;
+                            T* pjacobian = pjacobians + jacobianstride * ipos + index;
+                            pjacobian[0] += ay * dz - az * dy;
+                            pjacobian[dofstride] += az * dx - ax * dz;
+                            pjacobian[2*dofstride] += ax * dy - ay * dx;
+                        }
+                    }
+                }
+            }
+        }
+        igroupstart = igroupend;
+    }
+}
+
+template void KinBody::ComputeJacobianTranslations<float>(const std::vector< std::pair<int, Vector> >&, float*, const std::vector<int>&) const;
+template void KinBody::ComputeJacobianTranslations<double>(const std::vector< std::pair<int, Vector> >&, double*, const std::vector<int>&) const;
+
 void KinBody::CalculateJacobian(const int linkindex,
                                 const Vector& position,
                                 std::vector<dReal>& jacobian) const {
@@ -3464,6 +3765,12 @@ void KinBody::ComputeHessianAxisAngle(int linkindex, std::vector<dReal>& hessian
 }
 
 void KinBody::ComputeInverseDynamics(std::vector<dReal>& doftorques, const std::vector<dReal>& vDOFAccelerations, const KinBody::ForceTorqueMap& mapExternalForceTorque) const
+{
+    InverseDynamicsWorkspace workspace;
+    ComputeInverseDynamics(doftorques, vDOFAccelerations, mapExternalForceTorque, workspace);
+}
+
+void KinBody::ComputeInverseDynamics(std::vector<dReal>& doftorques, const std::vector<dReal>& vDOFAccelerations, const KinBody::ForceTorqueMap& mapExternalForceTorque, InverseDynamicsWorkspace& workspace) const
 {
     CHECK_INTERNAL_COMPUTATION;
     doftorques.resize(GetDOF());
@@ -3472,8 +3779,9 @@ void KinBody::ComputeInverseDynamics(std::vector<dReal>& doftorques, const std::
     }
 
     Vector vgravity = GetEnv()->GetPhysicsEngine()->GetGravity();
-    std::vector<dReal> vDOFVelocities;
-    std::vector<pair<Vector, Vector> > vLinkVelocities, vLinkAccelerations; // linear, angular
+    std::vector<dReal>& vDOFVelocities = workspace.vDOFVelocities;
+    std::vector<pair<Vector, Vector> >& vLinkVelocities = workspace.vLinkVelocities; // linear, angular
+    std::vector<pair<Vector, Vector> >& vLinkAccelerations = workspace.vLinkAccelerations;
     _ComputeDOFLinkVelocities(vDOFVelocities, vLinkVelocities);
     // check if all velocities are 0, if yes, then can simplify some computations since only have contributions from dofacell and external forces
     bool bHasVelocity = false;
@@ -3486,9 +3794,12 @@ void KinBody::ComputeInverseDynamics(std::vector<dReal>& doftorques, const std::
     if( !bHasVelocity ) {
         vDOFVelocities.resize(0);
     }
-    AccelerationMap externalaccelerations;
+    AccelerationMap& externalaccelerations = workspace.mapExternalAccelerations;
+    externalaccelerations.clear();
     externalaccelerations[0] = make_pair(-vgravity, Vector());
     AccelerationMapPtr pexternalaccelerations(&externalaccelerations, utils::null_deleter());
+    // _ComputeLinkAccelerations accumulates into the link accelerations, so the reused buffer has to start from zero
+    vLinkAccelerations.assign(_veclinks.size(), pair<Vector, Vector>());
     _ComputeLinkAccelerations(vDOFVelocities, vDOFAccelerations, vLinkVelocities, vLinkAccelerations, pexternalaccelerations);
 
     // all valuess are in the global coordinate system
@@ -3496,7 +3807,10 @@ void KinBody::ComputeInverseDynamics(std::vector<dReal>& doftorques, const std::
     // v_B = v_A + angularvel x (B-A)
     // a_B = a_A + angularaccel x (B-A) + angularvel x (angularvel x (B-A))
     // forward recursion
-    std::vector<Vector> vLinkCOMLinearAccelerations(_veclinks.size()), vLinkCOMMomentOfInertia(_veclinks.size());
+    std::vector<Vector>& vLinkCOMLinearAccelerations = workspace.vLinkCOMLinearAccelerations;
+    std::vector<Vector>& vLinkCOMMomentOfInertia = workspace.vLinkCOMMomentOfInertia;
+    vLinkCOMLinearAccelerations.resize(_veclinks.size());
+    vLinkCOMMomentOfInertia.resize(_veclinks.size());
     for(size_t i = 0; i < vLinkVelocities.size(); ++i) {
         Vector vglobalcomfromlink = _veclinks.at(i)->GetGlobalCOM() - _veclinks.at(i)->_info._t.trans;
         Vector vangularaccel = vLinkAccelerations.at(i).second;
@@ -3507,14 +3821,16 @@ void KinBody::ComputeInverseDynamics(std::vector<dReal>& doftorques, const std::
     }
 
     // backward recursion
-    std::vector< std::pair<Vector, Vector> > vLinkForceTorques(_veclinks.size());
+    std::vector< std::pair<Vector, Vector> >& vLinkForceTorques = workspace.vLinkForceTorques;
+    vLinkForceTorques.assign(_veclinks.size(), std::pair<Vector, Vector>());
     FOREACHC(it,mapExternalForceTorque) {
         vLinkForceTorques.at(it->first) = it->second;
     }
     std::fill(doftorques.begin(),doftorques.end(),0);
 
-    std::vector<std::pair<int,dReal> > vDofindexDerivativePairs;
-    std::map< std::pair<Mimic::DOFFormat, int>, dReal > mapcachedpartials;
+    std::vector<std::pair<int,dReal> >& vDofindexDerivativePairs = workspace.vDofindexDerivativePairs;
+    std::map< std::pair<Mimic::DOFFormat, int>, dReal >& mapcachedpartials = workspace.mapCachedPartials;
+    mapcachedpartials.clear(); // the partials depend on the dof values
 
     // go backwards
     for(size_t ijoint = 0; ijoint < _vTopologicallySortedJointsAll.size(); ++ijoint) {
@@ -3596,6 +3912,41 @@ void KinBody::ComputeInverseDynamics(std::vector<dReal>& doftorques, const std::
     }
 }
 
+void KinBody::ComputeInverseDynamicsBatch(std::vector<dReal>& doftorques, const std::vector<dReal>& vDOFValues, const std::vector<dReal>& vDOFVelocities, const std::vector<dReal>& vDOFAccelerations, InverseDynamicsWorkspace& workspace)
+{
+    CHECK_INTERNAL_COMPUTATION;
+    const int dof = GetDOF();
+    if( dof == 0 ) {
+        doftorques.resize(0);
+        return;
+    }
+    OPENRAVE_ASSERT_FORMAT(vDOFValues.size()%dof == 0, "body %s dof values size %d is not a multiple of the dof %d", GetName()%vDOFValues.size()%dof, ORE_InvalidArguments);
+    const size_t numstates = vDOFValues.size()/dof;
+    OPENRAVE_ASSERT_FORMAT(vDOFVelocities.size() == 0 || vDOFVelocities.size() == vDOFValues.size(), "body %s dof velocities size %d does not match %d states", GetName()%vDOFVelocities.size()%numstates, ORE_InvalidArguments);
+    OPENRAVE_ASSERT_FORMAT(vDOFAccelerations.size() == 0 || vDOFAccelerations.size() == vDOFValues.size(), "body %s dof accelerations size %d does not match %d states", GetName()%vDOFAccelerations.size()%numstates, ORE_InvalidArguments);
+    doftorques.resize(numstates*dof);
+
+    KinBodyStateSaver saver(shared_kinbody(), Save_LinkTransformation|Save_LinkVelocities);
+    std::vector<dReal>& vstatevelocities = workspace.vStateDOFVelocities;
+    std::vector<dReal>& vstateaccelerations = workspace.vStateDOFAccelerations;
+    std::vector<dReal>& vstatetorques = workspace.vStateDOFTorques;
+    // missing velocities and accelerations are zero for all the states
+    vstatevelocities.assign(dof, 0);
+    vstateaccelerations.assign(dof, 0);
+    for(size_t istate = 0; istate < numstates; ++istate) {
+        SetDOFValues(&vDOFValues[istate*dof], dof, CLA_Nothing);
+        if( vDOFVelocities.size() > 0 ) {
+            vstatevelocities.assign(vDOFVelocities.begin() + istate*dof, vDOFVelocities.begin() + (istate+1)*dof);
+        }
+        SetDOFVelocities(vstatevelocities, CLA_Nothing);
+        if( vDOFAccelerations.size() > 0 ) {
+            vstateaccelerations.assign(vDOFAccelerations.begin() + istate*dof, vDOFAccelerations.begin() + (istate+1)*dof);
+        }
+        ComputeInverseDynamics(vstatetorques, vstateaccelerations, ForceTorqueMap(), workspace);
+        std::copy(vstatetorques.begin(), vstatetorques.end(), doftorques.begin() + istate*dof);
+    }
+}
+
 void KinBody::ComputeInverseDynamics(boost::array< std::vector<dReal>, 3>& vDOFTorqueComponents, const std::vector<dReal>& vDOFAccelerations, const KinBody::ForceTorqueMap& mapExternalForceTorque) const
 {
     CHECK_INTERNAL_COMPUTATION;
@@ -3794,6 +4145,320 @@ void KinBody::ComputeInverseDynamics(boost::array< std::vector<dReal>, 3>& vDOFT
     }
 }
 
+/// \brief joint moving one link of the kinematic tree
+struct KinBody::DynamicsJoint
+{
+    /// \brief the velocity of the global origin moving with the child link for a unit joint velocity
+    void GetTwist(Vector& vangular, Vector& vlinear) const
+    {
+        if( bPrismatic ) {
+            vangular = Vector();
+            vlinear = vaxis;
+        }
+        else {
+            vangular = vaxis;
+            vlinear = vanchor.cross(vaxis);
+        }
+    }
+
+    /// \brief projects a force and a torque about the global origin onto the joint
+    dReal Project(const Vector& vforce, const Vector& vtorque) const
+    {
+        if( bPrismatic ) {
+            return vaxis.dot3(vforce);
+        }
+        return vaxis.dot3(vtorque - vanchor.cross(vforce));
+    }
+
+    int childindex = -1; ///< index of the link moved by the joint
+    int parentlinkindex = -1; ///< index of the parent link, -1 if none
+    int parentindex = -1; ///< index of the joint moving the parent link, -1 if the parent is a root link
+    bool bPrismatic = false;
+    Vector vaxis, vanchor; ///< in the global frame
+    dReal fTorqueScale = 1; ///< prismatic joints are scaled like in ComputeInverseDynamics
+    std::vector<std::pair<int, dReal> > vDofindexDerivativePairs; ///< the dofs moving the joint and the derivatives of the joint value with respect to them. empty for static joints
+};
+
+/// \brief mass, first moment of mass and rotational inertia about the global origin of a set of links
+struct KinBody::CompositeInertia
+{
+    void AddLink(const Link& link)
+    {
+        const dReal fmass = link.GetMass();
+        const Vector vcom = link.GetGlobalCOM();
+        const TransformMatrix tinertia = link.GetGlobalInertia();
+        // parallel axis theorem, I_origin = I_com + m*(|c|^2*E - c*c^T)
+        const dReal fcom2 = vcom.lengthsqr3();
+        for(int i = 0; i < 3; ++i) {
+            for(int j = 0; j < 3; ++j) {
+                inertia[3*i+j] += tinertia.m[4*i+j] + fmass*((i == j ? fcom2 : 0) - vcom[i]*vcom[j]);
+            }
+        }
+        mass += fmass;
+        vfirstmoment += vcom*fmass;
+    }
+
+    void Add(const CompositeInertia& other)
+    {
+        mass += other.mass;
+        vfirstmoment += other.vfirstmoment;
+        for(int i = 0; i < 9; ++i) {
+            inertia[i] += other.inertia[i];
+        }
+    }
+
+    /// \brief computes the linear momentum and the angular momentum about the global origin when the links move with the twist
+    void GetMomentum(const Vector& vangular, const Vector& vlinear, Vector& vforce, Vector& vtorque) const
+    {
+        vforce = vlinear*mass + vangular.cross(vfirstmoment);
+        vtorque = Vector(inertia[0]*vangular.x + inertia[1]*vangular.y + inertia[2]*vangular.z,
+                         inertia[3]*vangular.x + inertia[4]*vangular.y + inertia[5]*vangular.z,
+                         inertia[6]*vangular.x + inertia[7]*vangular.y + inertia[8]*vangular.z) + vfirstmoment.cross(vlinear);
+    }
+
+    dReal mass = 0;
+    Vector vfirstmoment; ///< mass times the center of mass
+    boost::array<dReal, 9> inertia = {{0, 0, 0, 0, 0, 0, 0, 0, 0}}; ///< row-major rotational inertia about the global origin
+};
+
+void KinBody::_GetDynamicsJoints(std::vector<DynamicsJoint>& vjoints, std::vector<int>& vlinkjoints) const
+{
+    vjoints.resize(0);
+    vjoints.reserve(_vTopologicallySortedJointsAll.size());
+    vlinkjoints.assign(_veclinks.size(), -1);
+    std::map< std::pair<Mimic::DOFFormat, int>, dReal > mapcachedpartials;
+    for(const JointPtr& pjoint : _vTopologicallySortedJointsAll) {
+        const int childindex = pjoint->GetHierarchyChildLink()->GetIndex();
+        if( vlinkjoints.at(childindex) >= 0 ) {
+            continue; // closed chain, the link is already moved by a previous joint
+        }
+        DynamicsJoint joint;
+        joint.childindex = childindex;
+        if( !!pjoint->GetHierarchyParentLink() ) {
+            joint.parentlinkindex = pjoint->GetHierarchyParentLink()->GetIndex();
+            joint.parentindex = vlinkjoints.at(joint.parentlinkindex);
+        }
+        if( !pjoint->IsStatic() ) {
+            if( pjoint->GetType() != JointHinge && pjoint->GetType() != JointSlider ) {
+                throw OPENRAVE_EXCEPTION_FORMAT(_("joint 0x%x not supported"), pjoint->GetType(), ORE_Assert);
+            }
+            joint.bPrismatic = pjoint->GetType() == JointSlider;
+            joint.fTorqueScale = joint.bPrismatic ? 1/(2*PI) : 1;
+            joint.vaxis = pjoint->GetAxis(0);
+            joint.vanchor = pjoint->GetAnchor();
+            if( pjoint->GetDOFIndex() >= 0 ) {
+                joint.vDofindexDerivativePairs.emplace_back(pjoint->GetDOFIndex(), 1.0);
+            }
+            else if( pjoint->IsMimic(0) ) {
+                pjoint->_ComputePartialVelocities(joint.vDofindexDerivativePairs, 0, mapcachedpartials);
+            }
+        }
+        vlinkjoints[childindex] = vjoints.size();
+        vjoints.push_back(joint);
+    }
+}
+
+void KinBody::_ComputeCompositeInertias(const std::vector<DynamicsJoint>& vjoints, std::vector<CompositeInertia>& vcomposites) const
+{
+    vcomposites.resize(_veclinks.size());
+    for(size_t ilink = 0; ilink < _veclinks.size(); ++ilink) {
+        vcomposites[ilink] = CompositeInertia();
+        vcomposites[ilink].AddLink(*_veclinks[ilink]);
+    }
+    // children come after their parents in the topological order
+    for(std::vector<DynamicsJoint>::const_reverse_iterator itjoint = vjoints.rbegin(); itjoint != vjoints.rend(); ++itjoint) {
+        if( itjoint->parentlinkindex >= 0 ) {
+            vcomposites.at(itjoint->parentlinkindex).Add(vcomposites.at(itjoint->childindex));
+        }
+    }
+}
+
+void KinBody::ComputeMassMatrix(std::vector<dReal>& vmassmatrix) const
+{
+    CHECK_INTERNAL_COMPUTATION;
+    const int dof = GetDOF();
+    {
+        std::lock_guard<std::mutex> lock(_mutexDynamicsCaches);
+        if( _nMassMatrixCacheStamp == _nUpdateStampId && (int)_vMassMatrixCache.size() == dof*dof ) {
+            vmassmatrix = _vMassMatrixCache;
+            return;
+        }
+    }
+
+    vmassmatrix.resize(dof*dof);
+    std::fill(vmassmatrix.begin(), vmassmatrix.end(), 0);
+    std::vector<DynamicsJoint> vjoints;
+    std::vector<int> vlinkjoints;
+    std::vector<CompositeInertia> vcomposites;
+    _GetDynamicsJoints(vjoints, vlinkjoints);
+    _ComputeCompositeInertias(vjoints, vcomposites);
+
+    Vector vangular, vlinear, vforce, vtorque;
+    for(int ijoint = 0; ijoint < (int)vjoints.size(); ++ijoint) {
+        const DynamicsJoint& joint = vjoints[ijoint];
+        if( joint.vDofindexDerivativePairs.empty() ) {
+            continue;
+        }
+        // moving the joint moves all the links below it as one rigid body
+        joint.GetTwist(vangular, vlinear);
+        vcomposites.at(joint.childindex).GetMomentum(vangular, vlinear, vforce, vtorque);
+        // the momentum is the same about the global origin for every joint above, so M[ancestor][joint] is its projection
+        for(int iancestor = ijoint; iancestor >= 0; iancestor = vjoints[iancestor].parentindex) {
+            const DynamicsJoint& ancestor = vjoints[iancestor];
+            if( ancestor.vDofindexDerivativePairs.empty() ) {
+                continue;
+            }
+            const dReal fvalue = ancestor.Project(vforce, vtorque);
+            for(const std::pair<int, dReal>& jointpartial : joint.vDofindexDerivativePairs) {
+                for(const std::pair<int, dReal>& ancestorpartial : ancestor.vDofindexDerivativePairs) {
+                    vmassmatrix[ancestorpartial.first*dof + jointpartial.first] += ancestorpartial.second*ancestor.fTorqueScale*fvalue*jointpartial.second;
+                    if( iancestor != ijoint ) {
+                        vmassmatrix[jointpartial.first*dof + ancestorpartial.first] += jointpartial.second*joint.fTorqueScale*fvalue*ancestorpartial.second;
+                    }
+                }
+            }
+        }
+    }
+
+    for(const JointPtr& pjoint : _vecjoints) {
+        if( pjoint->GetDOFIndex() >= 0 && !!pjoint->_info._infoElectricMotor && pjoint->_info._infoElectricMotor->rotor_inertia > 0 ) {
+            // converting inertia on motor side to load side requires multiplying by gear ratio squared
+            const ElectricMotorActuatorInfo& actuatorinfo = *pjoint->_info._infoElectricMotor;
+            vmassmatrix[pjoint->GetDOFIndex()*(dof+1)] += actuatorinfo.rotor_inertia*actuatorinfo.gear_ratio*actuatorinfo.gear_ratio;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_mutexDynamicsCaches);
+    _vMassMatrixCache = vmassmatrix;
+    _nMassMatrixCacheStamp = _nUpdateStampId;
+}
+
+void KinBody::ComputeGravityTorques(std::vector<dReal>& vdoftorques) const
+{
+    CHECK_INTERNAL_COMPUTATION;
+    const int dof = GetDOF();
+    const Vector vgravity = GetEnv()->GetPhysicsEngine()->GetGravity();
+    {
+        std::lock_guard<std::mutex> lock(_mutexDynamicsCaches);
+        if( _nGravityTorquesCacheStamp == _nUpdateStampId && _vGravityTorquesCacheGravity == vgravity && (int)_vGravityTorquesCache.size() == dof ) {
+            vdoftorques = _vGravityTorquesCache;
+            return;
+        }
+    }
+
+    vdoftorques.resize(dof);
+    std::fill(vdoftorques.begin(), vdoftorques.end(), 0);
+    std::vector<DynamicsJoint> vjoints;
+    std::vector<int> vlinkjoints;
+    std::vector<CompositeInertia> vcomposites;
+    _GetDynamicsJoints(vjoints, vlinkjoints);
+    _ComputeCompositeInertias(vjoints, vcomposites);
+
+    for(const DynamicsJoint& joint : vjoints) {
+        if( joint.vDofindexDerivativePairs.empty() ) {
+            continue;
+        }
+        // the links below the joint are held by accelerating them with -gravity
+        const CompositeInertia& composite = vcomposites.at(joint.childindex);
+        const Vector vforce = -vgravity*composite.mass;
+        const dReal ftorque = joint.fTorqueScale*joint.Project(vforce, composite.vfirstmoment.cross(-vgravity));
+        for(const std::pair<int, dReal>& partial : joint.vDofindexDerivativePairs) {
+            vdoftorques[partial.first] += partial.second*ftorque;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_mutexDynamicsCaches);
+    _vGravityTorquesCache = vdoftorques;
+    _vGravityTorquesCacheGravity = vgravity;
+    _nGravityTorquesCacheStamp = _nUpdateStampId;
+}
+
+void KinBody::ComputeCoriolisMatrix(std::vector<dReal>& vcoriolismatrix) const
+{
+    CHECK_INTERNAL_COMPUTATION;
+    const int dof = GetDOF();
+    vcoriolismatrix.resize(dof*dof);
+    std::fill(vcoriolismatrix.begin(), vcoriolismatrix.end(), 0);
+    if( dof == 0 ) {
+        return;
+    }
+
+    std::vector<dReal> vDOFVelocities;
+    std::vector<std::pair<Vector, Vector> > vLinkVelocities; // linear, angular
+    _ComputeDOFLinkVelocities(vDOFVelocities, vLinkVelocities, false);
+    std::vector<DynamicsJoint> vjoints;
+    std::vector<int> vlinkjoints;
+    _GetDynamicsJoints(vjoints, vlinkjoints);
+
+    // the axis and anchor of a joint move with its parent link
+    std::vector<Vector> vAxisVelocities(vjoints.size()), vAnchorVelocities(vjoints.size());
+    for(size_t ijoint = 0; ijoint < vjoints.size(); ++ijoint) {
+        const DynamicsJoint& joint = vjoints[ijoint];
+        if( joint.parentlinkindex >= 0 ) {
+            const std::pair<Vector, Vector>& vparentvelocity = vLinkVelocities.at(joint.parentlinkindex);
+            vAxisVelocities[ijoint] = vparentvelocity.second.cross(joint.vaxis);
+            vAnchorVelocities[ijoint] = vparentvelocity.first + vparentvelocity.second.cross(joint.vanchor - _veclinks.at(joint.parentlinkindex)->GetTransform().trans);
+        }
+    }
+
+    // C = sum over links of m*Jv^T*dJv + Jw^T*(I*dJw + w x (I*Jw)) using the columns of the joints above the link
+    std::vector<int> vpath;
+    std::vector<Vector> vJv, vJw, vdJv, vIw;
+    for(size_t ilink = 0; ilink < _veclinks.size(); ++ilink) {
+        const Link& link = *_veclinks[ilink];
+        const dReal fmass = link.GetMass();
+        vpath.resize(0);
+        for(int ijoint = vlinkjoints[ilink]; ijoint >= 0; ijoint = vjoints[ijoint].parentindex) {
+            if( !vjoints[ijoint].vDofindexDerivativePairs.empty() ) {
+                vpath.push_back(ijoint);
+            }
+        }
+        if( vpath.empty() ) {
+            continue;
+        }
+
+        const Vector vcom = link.GetGlobalCOM();
+        const TransformMatrix tinertia = link.GetGlobalInertia();
+        const Vector& vangularvelocity = vLinkVelocities.at(ilink).second;
+        const Vector vcomvelocity = vLinkVelocities.at(ilink).first + vangularvelocity.cross(vcom - link.GetTransform().trans);
+        vJv.resize(vpath.size());
+        vJw.resize(vpath.size());
+        vdJv.resize(vpath.size());
+        vIw.resize(vpath.size());
+        for(size_t ipath = 0; ipath < vpath.size(); ++ipath) {
+            const DynamicsJoint& joint = vjoints[vpath[ipath]];
+            const Vector& vaxisvelocity = vAxisVelocities[vpath[ipath]];
+            Vector vdJw;
+            if( joint.bPrismatic ) {
+                vJv[ipath] = joint.vaxis;
+                vJw[ipath] = Vector();
+                vdJv[ipath] = vaxisvelocity;
+            }
+            else {
+                const Vector vcomfromanchor = vcom - joint.vanchor;
+                vJv[ipath] = joint.vaxis.cross(vcomfromanchor);
+                vJw[ipath] = joint.vaxis;
+                vdJv[ipath] = vaxisvelocity.cross(vcomfromanchor) + joint.vaxis.cross(vcomvelocity - vAnchorVelocities[vpath[ipath]]);
+                vdJw = vaxisvelocity;
+            }
+            vIw[ipath] = tinertia.rotate(vdJw) + vangularvelocity.cross(tinertia.rotate(vJw[ipath]));
+        }
+
+        for(size_t ipath = 0; ipath < vpath.size(); ++ipath) {
+            const DynamicsJoint& joint = vjoints[vpath[ipath]];
+            for(size_t jpath = 0; jpath < vpath.size(); ++jpath) {
+                const DynamicsJoint& otherjoint = vjoints[vpath[jpath]];
+                const dReal fvalue = joint.fTorqueScale*(fmass*vJv[ipath].dot3(vdJv[jpath]) + vJw[ipath].dot3(vIw[jpath]));
+                for(const std::pair<int, dReal>& partial : joint.vDofindexDerivativePairs) {
+                    for(const std::pair<int, dReal>& otherpartial : otherjoint.vDofindexDerivativePairs) {
+                        vcoriolismatrix[partial.first*dof + otherpartial.first] += partial.second*fvalue*otherpartial.second;
+                    }
+                }
+            }
+        }
+    }
+}
+
 bool KinBody::GetDOFDynamicAccelerationJerkLimits(std::vector<dReal>& vDynamicAccelerationLimits, std::vector<dReal>& vDynamicJerkLimits,
                                                   const std::vector<dReal>& vDOFPositions, const std::vector<dReal>& vDOFVelocities) const
 {
@@ -4109,6 +4774,78 @@ CollisionCheckerBasePtr KinBody::GetSelfCollisionChecker() const
 }
 
 
+/// \brief process-wide kinematics hierarchies indexed by structure key, kept as long as a body uses them
+static std::mutex s_mutexKinematicsHierarchies;
+static std::map<std::vector<int>, boost::weak_ptr<const KinBody::KinematicsHierarchy> > s_mapKinematicsHierarchies;
+
+static boost::shared_ptr<const KinBody::KinematicsHierarchy> _FindKinematicsHierarchy(const std::vector<int>& vstructurekey)
+{
+    std::lock_guard<std::mutex> lock(s_mutexKinematicsHierarchies);
+    std::map<std::vector<int>, boost::weak_ptr<const KinBody::KinematicsHierarchy> >::iterator it = s_mapKinematicsHierarchies.find(vstructurekey);
+    if( it == s_mapKinematicsHierarchies.end() ) {
+        return boost::shared_ptr<const KinBody::KinematicsHierarchy>();
+    }
+    boost::shared_ptr<const KinBody::KinematicsHierarchy> phierarchy = it->second.lock();
+    if( !phierarchy ) {
+        s_mapKinematicsHierarchies.erase(it);
+    }
+    return phierarchy;
+}
+
+static boost::shared_ptr<const KinBody::KinematicsHierarchy> _RegisterKinematicsHierarchy(const boost::shared_ptr<const KinBody::KinematicsHierarchy>& phierarchy)
+{
+    std::lock_guard<std::mutex> lock(s_mutexKinematicsHierarchies);
+    // remove the hierarchies that are not used anymore
+    std::map<std::vector<int>, boost::weak_ptr<const KinBody::KinematicsHierarchy> >::iterator it = s_mapKinematicsHierarchies.begin();
+    while(it != s_mapKinematicsHierarchies.end()) {
+        if( it->second.expired() ) {
+            it = s_mapKinematicsHierarchies.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    s_mapKinematicsHierarchies[phierarchy->vstructurekey] = phierarchy;
+    return phierarchy;
+}
+
+void KinBody::_GetKinematicsStructureKey(std::vector<int>& vkey) const
+{
+    vkey.resize(0);
+    vkey.push_back(_veclinks.size());
+    vkey.push_back(_vecjoints.size());
+    vkey.push_back(_vPassiveJoints.size());
+    FOREACHC(itlink, _veclinks) {
+        vkey.push_back((*itlink)->IsStatic());
+    }
+    for(int bPassiveJoints = 0; bPassiveJoints < 2; ++bPassiveJoints) { // simulate false/true
+        const std::vector<JointPtr>& vjoints = bPassiveJoints ? _vPassiveJoints : _vecjoints;
+        for(const JointPtr& pjoint : vjoints) {
+            vkey.push_back(!pjoint->GetFirstAttached() ? -1 : pjoint->GetFirstAttached()->GetIndex());
+            vkey.push_back(!pjoint->GetSecondAttached() ? -1 : pjoint->GetSecondAttached()->GetIndex());
+            vkey.push_back(pjoint->GetDOF());
+            for(int idof = 0; idof < pjoint->GetDOF(); ++idof) {
+                const MimicPtr& pmimic = pjoint->_vmimic[idof];
+                if( !pmimic ) {
+                    vkey.push_back(-1);
+                    continue;
+                }
+                vkey.push_back(pmimic->_vdofformat.size());
+                FOREACHC(itdofformat, pmimic->_vdofformat) {
+                    vkey.push_back(itdofformat->jointindex);
+                    vkey.push_back(itdofformat->dofindex);
+                    vkey.push_back(itdofformat->axis);
+                }
+                vkey.push_back(pmimic->_vmimicdofs.size());
+                FOREACHC(itmimicdof, pmimic->_vmimicdofs) {
+                    vkey.push_back(itmimicdof->dofformatindex);
+                    vkey.push_back(itmimicdof->dofindex);
+                }
+            }
+        }
+    }
+}
+
 void KinBody::_ComputeInternalInformation()
 {
     uint64_t starttime = utils::GetMicroTime();
@@ -4316,8 +5053,17 @@ void KinBody::_ComputeInternalInformation()
     _vTopologicallySortedJointIndicesAll.resize(0);
     _vJointsAffectingLinks.resize(_vecjoints.size()*_veclinks.size());
 
+    // the hierarchy only depends on how the links and joints are connected, so reuse it when this body, the body it was
+    // cloned from or another body with the same structure already computed it
+    std::vector<int> vstructurekey;
+    _GetKinematicsStructureKey(vstructurekey);
+    if( !_pKinematicsHierarchy || _pKinematicsHierarchy->vstructurekey != vstructurekey ) {
+        _pKinematicsHierarchy = _FindKinematicsHierarchy(vstructurekey);
+    }
+    const bool bReuseHierarchy = !!_pKinematicsHierarchy && _pKinematicsHierarchy->vstructurekey == vstructurekey && _veclinks.size() > 0 && _vecjoints.size() > 0;
+
     // compute the all-pairs shortest paths
-    {
+    if( !bReuseHierarchy ) {
         // Preallocate to fit our NxN joint map
         _vAllPairsShortestPaths.resize(_veclinks.size() * _veclinks.size());
 
@@ -4411,16 +5157,18 @@ void KinBody::_ComputeInternalInformation()
         }
 
         // Now that we have the base costs set for all joints, iterate the links we know to be jointed and calculate the total cost between each pair
-        for (size_t k : usedLinkIndices) {
-            for (size_t i : usedLinkIndices) {
-                // Skip comparisons of a link with itself
-                if (i == k) {
+        // The pairs of one k do not depend on each other, so j is iterated before i to skip the links that cannot reach k and to access the costs row by row
+        const std::vector<size_t> vUsedLinkIndices(usedLinkIndices.begin(), usedLinkIndices.end());
+        for (size_t k : vUsedLinkIndices) {
+            for (size_t j : vUsedLinkIndices) {
+                // Skip comparisons of a link with itself and links that have no path to k yet
+                if ((j == k) || vcosts[MAKE_INDEX(j, k)] >= 0x3fffffff) {
                     continue;
                 }
 
-                for (size_t j : usedLinkIndices) {
+                for (size_t i : vUsedLinkIndices) {
                     // Skip comparisons of a link with itself
-                    if ((j == i) || (j == k)) {
+                    if ((i == j) || (i == k)) {
                         continue;
                     }
 
@@ -4443,7 +5191,7 @@ void KinBody::_ComputeInternalInformation()
 
     // Use the APAC algorithm to initialize the kinematics hierarchy: _vTopologicallySortedJoints, _vJointsAffectingLinks, Link::_vParentLinks.
     // SIMOES, Ricardo. APAC: An exact algorithm for retrieving cycles and paths in all kinds of graphs. Tékhne, Dec. 2009, no.12, p.39-55. ISSN 1654-9911.
-    if((_veclinks.size() > 0)&&(_vecjoints.size() > 0)) {
+    if( !bReuseHierarchy && (_veclinks.size() > 0)&&(_vecjoints.size() > 0) ) {
         std::vector< std::vector<int> > vlinkadjacency(_veclinks.size());
         // joints with only one attachment are attached to a static link, which is attached to link 0
         for( const JointPtr& joint :_vecjoints) {
@@ -4458,45 +5206,56 @@ void KinBody::_ComputeInternalInformation()
             sort(adj.begin(), adj.end());
         }
 
-        // all unique paths starting at the root link or static links
-        std::vector< std::list< std::list<int> > > vuniquepaths(_veclinks.size());
+        // all unique paths starting at the root link or static links. instead of keeping the paths, only the number of
+        // paths ending at every link, the links on them and the parent links (the link before the last) are recorded
+        const size_t numlinks = _veclinks.size();
+        std::vector<int> vnumuniquepaths(numlinks, 0);
+        std::vector<uint8_t> vlinksonpaths(numlinks*numlinks, 0); ///< vlinksonpaths[i*numlinks+j] is 1 if link j is on a path to link i
         std::list< std::list<int> > closedloops;
         int s = 0;
-        std::list< std::list<int> > S;
+        std::deque< std::vector<int> > S;
+        const auto addpath = [&](const std::vector<int>& P) {
+            const int ilink = P.back();
+            ++vnumuniquepaths[ilink];
+            FOREACHC(itlink, P) {
+                vlinksonpaths[ilink*numlinks+*itlink] = 1;
+            }
+            const int parentindex = P[P.size()-2];
+            std::vector<int>& vparentlinks = _veclinks[ilink]->_vParentLinks;
+            if( find(vparentlinks.begin(),vparentlinks.end(),parentindex) == vparentlinks.end() ) {
+                vparentlinks.push_back(parentindex);
+            }
+        };
         FOREACH(itv,vlinkadjacency[s]) {
-            std::list<int> P;
-            P.push_back(s);
-            P.push_back(*itv);
+            std::vector<int> P(2);
+            P[0] = s;
+            P[1] = *itv;
             S.push_back(P);
-            vuniquepaths[*itv].push_back(P);
+            addpath(P);
         }
         while(!S.empty()) {
-            std::list<int>& P = S.front();
+            std::vector<int>& P = S.front();
             int u = P.back();
             FOREACH(itv,vlinkadjacency[u]) {
-                std::list<int>::iterator itfound = find(P.begin(),P.end(),*itv);
+                std::vector<int>::iterator itfound = find(P.begin(),P.end(),*itv);
                 if( itfound == P.end() ) {
-                    S.push_back(P);
+                    S.push_back(P); // deque does not move P
                     S.back().push_back(*itv);
-                    vuniquepaths[*itv].push_back(S.back());
+                    addpath(S.back());
                 }
                 else {
                     // found a cycle
-                    std::list<int> cycle;
-                    while(itfound != P.end()) {
-                        cycle.push_back(*itfound);
-                        ++itfound;
-                    }
+                    std::list<int> cycle(itfound, P.end());
                     if( cycle.size() > 2 ) {
                         // sort the cycle so that it starts with the lowest link index and the direction is the next lowest index
                         // this way the cycle becomes unique and can be compared for duplicates
-                        itfound = cycle.begin();
-                        std::list<int>::iterator itmin = itfound++;
-                        while(itfound != cycle.end()) {
-                            if( *itmin > *itfound ) {
-                                itmin = itfound;
+                        std::list<int>::iterator itcycle = cycle.begin();
+                        std::list<int>::iterator itmin = itcycle++;
+                        while(itcycle != cycle.end()) {
+                            if( *itmin > *itcycle ) {
+                                itmin = itcycle;
                             }
-                            itfound++;
+                            itcycle++;
                         }
                         if( itmin != cycle.begin() ) {
                             cycle.splice(cycle.end(),cycle,cycle.begin(),itmin);
@@ -4515,18 +5274,11 @@ void KinBody::_ComputeInternalInformation()
             }
             S.pop_front();
         }
-        // fill each link's parent links
+        // each link's parent links were filled with the paths
         FOREACH(itlink,_veclinks) {
-            if( (*itlink)->GetIndex() > 0 && vuniquepaths.at((*itlink)->GetIndex()).size() == 0 ) {
+            if( (*itlink)->GetIndex() > 0 && vnumuniquepaths.at((*itlink)->GetIndex()) == 0 ) {
                 RAVELOG_WARN(str(boost::format("_ComputeInternalInformation: %s has incomplete kinematics! link %s not connected to root %s")%GetName()%(*itlink)->GetName()%_veclinks.at(0)->GetName()));
             }
-            FOREACH(itpath, vuniquepaths.at((*itlink)->GetIndex())) {
-                OPENRAVE_ASSERT_OP(itpath->back(),==,(*itlink)->GetIndex());
-                int parentindex = *---- itpath->end();
-                if( find((*itlink)->_vParentLinks.begin(),(*itlink)->_vParentLinks.end(),parentindex) == (*itlink)->_vParentLinks.end() ) {
-                    (*itlink)->_vParentLinks.push_back(parentindex);
-                }
-            }
         }
         // find the link depths (minimum path length to the root)
         vector<int> vlinkdepths(_veclinks.size(),-1);
@@ -4631,18 +5383,19 @@ void KinBody::_ComputeInternalInformation()
                 }
             }
         }
-        // topologically sort the joints
+        // topologically sort the joints, keeping the number of incoming edges of every joint
         _vTopologicallySortedJointIndicesAll.resize(0); _vTopologicallySortedJointIndicesAll.reserve(numjoints);
-        std::list<int> noincomingedges;
-        for(int i = 0; i < numjoints; ++i) {
-            bool hasincoming = false;
-            for(int j = 0; j < numjoints; ++j) {
+        std::vector<int> vnumincomingedges(numjoints, 0);
+        for(int j = 0; j < numjoints; ++j) {
+            for(int i = 0; i < numjoints; ++i) {
                 if( vjointadjacency[j*numjoints+i] ) {
-                    hasincoming = true;
-                    break;
+                    ++vnumincomingedges[i];
                 }
             }
-            if( !hasincoming ) {
+        }
+        std::list<int> noincomingedges;
+        for(int i = 0; i < numjoints; ++i) {
+            if( vnumincomingedges[i] == 0 ) {
                 noincomingedges.push_back(i);
             }
         }
@@ -4656,14 +5409,7 @@ void KinBody::_ComputeInternalInformation()
                 for(int i = 0; i < numjoints; ++i) {
                     if( vjointadjacency[n*numjoints+i] ) {
                         vjointadjacency[n*numjoints+i] = 0;
-                        bool hasincoming = false;
-                        for(int j = 0; j < numjoints; ++j) {
-                            if( vjointadjacency[j*numjoints+i] ) {
-                                hasincoming = true;
-                                break;
-                            }
-                        }
-                        if( !hasincoming ) {
+                        if( --vnumincomingedges[i] == 0 ) {
                             noincomingedges.push_back(i);
                         }
                     }
@@ -4688,14 +5434,7 @@ void KinBody::_ComputeInternalInformation()
                 }
                 // remove this edge
                 vjointadjacency[imaxadjind] = 0;
-                bool hasincoming = false;
-                for(int j = 0; j < numjoints; ++j) {
-                    if( vjointadjacency[j*numjoints+isecond] ) {
-                        hasincoming = true;
-                        break;
-                    }
-                }
-                if( !hasincoming ) {
+                if( --vnumincomingedges[isecond] == 0 ) {
                     noincomingedges.push_back(isecond);
                 }
             }
@@ -4787,14 +5526,8 @@ void KinBody::_ComputeInternalInformation()
         // find out what links are affected by what joints.
         _vJointsAffectingLinks.assign( _vJointsAffectingLinks.size(), 0);
 
-        vector<int8_t> vusedlinks;
         for(int i = 0; i < (int)_veclinks.size(); ++i) {
-            vusedlinks.resize(0); vusedlinks.resize(_veclinks.size());
-            FOREACH(itpath,vuniquepaths[i]) {
-                FOREACH(itlink,*itpath) {
-                    vusedlinks[*itlink] = 1;
-                }
-            }
+            const uint8_t* vusedlinks = &vlinksonpaths[i*numlinks];
             for(int j = 0; j < (int)_veclinks.size(); ++j) {
                 if( vusedlinks[j] &&(i != j)) {
                     int jointindex = _vAllPairsShortestPaths[i*_veclinks.size()+j].second;
@@ -4853,6 +5586,46 @@ void KinBody::_ComputeInternalInformation()
                 RAVELOG_VERBOSE(ss.str());
             }
         }
+
+        // the joints were swapped to their parent link order, so compute the key again for the next time
+        boost::shared_ptr<KinematicsHierarchy> phierarchy(new KinematicsHierarchy());
+        _GetKinematicsStructureKey(phierarchy->vstructurekey);
+        phierarchy->vAllPairsShortestPaths = _vAllPairsShortestPaths;
+        phierarchy->vTopologicallySortedJointIndicesAll = _vTopologicallySortedJointIndicesAll;
+        phierarchy->vJointsAffectingLinks = _vJointsAffectingLinks;
+        phierarchy->vParentLinks.resize(_veclinks.size());
+        for(size_t ilink = 0; ilink < _veclinks.size(); ++ilink) {
+            phierarchy->vParentLinks[ilink] = _veclinks[ilink]->_vParentLinks;
+        }
+        phierarchy->vClosedLoopIndices = _vClosedLoopIndices;
+        _pKinematicsHierarchy = _RegisterKinematicsHierarchy(phierarchy);
+    }
+    else if( bReuseHierarchy ) {
+        const KinematicsHierarchy& hierarchy = *_pKinematicsHierarchy;
+        _vAllPairsShortestPaths = hierarchy.vAllPairsShortestPaths;
+        _vJointsAffectingLinks = hierarchy.vJointsAffectingLinks;
+        for(size_t ilink = 0; ilink < _veclinks.size(); ++ilink) {
+            _veclinks[ilink]->_vParentLinks = hierarchy.vParentLinks.at(ilink);
+        }
+        _vTopologicallySortedJointIndicesAll = hierarchy.vTopologicallySortedJointIndicesAll;
+        FOREACH(itindex,_vTopologicallySortedJointIndicesAll) {
+            JointPtr pj = *itindex < (int)_vecjoints.size() ? _vecjoints[*itindex] : _vPassiveJoints.at(*itindex-_vecjoints.size());
+            if( *itindex < (int)_vecjoints.size() ) {
+                _vTopologicallySortedJoints.push_back(pj);
+            }
+            _vTopologicallySortedJointsAll.push_back(pj);
+            // the joints already have their parent link first since the structure key is computed after swapping them
+            pj->_ComputeInternalStaticInformation();
+        }
+        _vClosedLoopIndices = hierarchy.vClosedLoopIndices;
+        _vClosedLoops.resize(_vClosedLoopIndices.size());
+        for(size_t iloop = 0; iloop < _vClosedLoopIndices.size(); ++iloop) {
+            _vClosedLoops[iloop].resize(0);
+            _vClosedLoops[iloop].reserve(_vClosedLoopIndices[iloop].size());
+            FOREACHC(it, _vClosedLoopIndices[iloop]) {
+                _vClosedLoops[iloop].emplace_back(_veclinks.at(it->first), it->second < (int)_vecjoints.size() ? _vecjoints.at(it->second) : _vPassiveJoints.at(it->second-_vecjoints.size()));
+            }
+        }
     }
 
     // compute the rigidly attached links
@@ -5031,6 +5804,7 @@ void KinBody::_ComputeInternalInformation()
         // unfortunately if SetDOFValues is overloaded by the robot, it could call the robot's _UpdateGrabbedBodies, which is a problem during environment cloning since the grabbed bodies might not be initialized. Therefore, call KinBody::SetDOFValues
         GetDOFValues(vcurrentvalues);
         std::vector<GrabbedPtr> vGrabbedBodies; vGrabbedBodies.swap(_vGrabbedBodies); // swap to get rid of _vGrabbedBodies
+        _bForceFullKinematicsUpdate = true; // values do not change, but the links have to be made consistent with them
         KinBody::SetDOFValues(vcurrentvalues,CLA_CheckLimits, std::vector<int>());
         vGrabbedBodies.swap(_vGrabbedBodies); // swap back
         GetLinkTransformations(vnewtrans, vnewdoflastsetvalues);
@@ -5093,26 +5867,9 @@ void KinBody::_ComputeInternalInformation()
     }
 
     // notify any callbacks of the changes
-    std::list<UserDataWeakPtr> listRegisteredCallbacks;
-    uint32_t index = 0;
     uint32_t parameters = _nParametersChanged;
-    while(parameters && index < _vlistRegisteredCallbacks.size()) {
-        if( (parameters & 1) &&  _vlistRegisteredCallbacks.at(index).size() > 0 ) {
-            {
-                boost::shared_lock< boost::shared_mutex > lock(GetInterfaceMutex());
-                listRegisteredCallbacks = _vlistRegisteredCallbacks.at(index); // copy since it can be changed
-            }
-            FOREACH(it,listRegisteredCallbacks) {
-                ChangeCallbackDataPtr pdata = boost::dynamic_pointer_cast<ChangeCallbackData>(it->lock());
-                if( !!pdata ) {
-                    pdata->_callback();
-                }
-            }
-        }
-        parameters >>= 1;
-        index += 1;
-    }
     _nParametersChanged = 0;
+    _CallChangeCallbacks(parameters);
 
     if( !!_pKinematicsGenerator ) {
         _pCurrentKinematicsFunctions = _pKinematicsGenerator->GenerateKinematicsFunctions(*this);
@@ -5554,6 +6311,15 @@ private:
 
     CHECK_INTERNAL_COMPUTATION;
     if( _nNonAdjacentLinkCache & 0x80000000 ) {
+        // pairs sampled by ComputeNeverCollidingLinkPairs are only valid as long as the geometry and the limits did not change
+        const NeverCollidingLinkPairs* pNeverColliding = nullptr;
+        if( !!_pNeverCollidingLinkPairs && _pNeverCollidingLinkPairs->kinematicsGeometryHash == GetKinematicsGeometryHash() ) {
+            std::vector<dReal> vlower, vupper;
+            GetDOFLimits(vlower, vupper);
+            if( vlower == _pNeverCollidingLinkPairs->vLowerLimits && vupper == _pNeverCollidingLinkPairs->vUpperLimits ) {
+                pNeverColliding = _pNeverCollidingLinkPairs.get();
+            }
+        }
         // Check for colliding link pairs given the initial pose _vInitialLinkTransformations
         // this is actually weird, we need to call the individual link collisions on a const body. in order to pull this off, we need to be very careful with the body state.
         TransformsSaver saver(shared_kinbody_const());
@@ -5562,19 +6328,25 @@ private:
         for(size_t i = 0; i < _veclinks.size(); ++i) {
             boost::static_pointer_cast<Link>(_veclinks[i])->_info._t = _vInitialLinkTransformations.at(i);
         }
-        _nUpdateStampId++; // because transforms were modified
+        _IncrementUpdateStamp(); // because transforms were modified
         _vNonAdjacentLinks[0].resize(0);
 
         for(size_t ind0 = 0; ind0 < _veclinks.size(); ++ind0) {
             for(size_t ind1 = ind0+1; ind1 < _veclinks.size(); ++ind1) {
                 const bool bAdjacent = AreAdjacentLinks(ind0, ind1);
+                if( !bAdjacent && !!pNeverColliding ) {
+                    const size_t index1d = _GetIndex1d(ind0, ind1);
+                    if( (index1d>>6) < pNeverColliding->vPairsMask.size() && (pNeverColliding->vPairsMask[index1d>>6] & (uint64_t(1)<<(index1d&63))) ) {
+                        continue;
+                    }
+                }
                 if(!bAdjacent && !collisionchecker->CheckCollision(LinkConstPtr(_veclinks[ind0]), LinkConstPtr(_veclinks[ind1])) ) {
                     _vNonAdjacentLinks[0].push_back(ind0|(ind1<<16));
                 }
             }
         }
         std::sort(_vNonAdjacentLinks[0].begin(), _vNonAdjacentLinks[0].end(), CompareNonAdjacentFarthest);
-        _nUpdateStampId++; // because transforms were modified
+        _IncrementUpdateStamp(); // because transforms were modified
         _nNonAdjacentLinkCache = 0;
     }
     if( (_nNonAdjacentLinkCache&adjacentoptions) != adjacentoptions ) {
@@ -5598,6 +6370,141 @@ private:
     return _vNonAdjacentLinks.at(adjacentoptions);
 }
 
+/// \brief process-wide results of ComputeNeverCollidingLinkPairs indexed by kinematics geometry hash, one for every set of DOF limits, number of samples and margin
+static std::mutex s_mutexNeverCollidingLinkPairs;
+static std::map<std::string, std::vector< boost::shared_ptr<const KinBody::NeverCollidingLinkPairs> > > s_mapNeverCollidingLinkPairs;
+
+/// \brief returns true if the link pairs of a body with the same kinematics geometry hash were sampled with the same limits, number of samples and margin
+static bool _IsSampledWith(const KinBody::NeverCollidingLinkPairs& pairs, const std::vector<dReal>& vlower, const std::vector<dReal>& vupper, int numSamples, dReal fMargin)
+{
+    return pairs.numSamples == numSamples && pairs.fMargin == fMargin && pairs.vLowerLimits == vlower && pairs.vUpperLimits == vupper;
+}
+
+void KinBody::ComputeNeverCollidingLinkPairs(int numSamples, bool bForceRecompute, dReal fMargin)
+{
+    CHECK_INTERNAL_COMPUTATION;
+    const std::string& hash = GetKinematicsGeometryHash();
+    std::vector<dReal> vlimitslower, vlimitsupper;
+    GetDOFLimits(vlimitslower, vlimitsupper);
+    if( !bForceRecompute ) {
+        std::lock_guard<std::mutex> lock(s_mutexNeverCollidingLinkPairs);
+        std::map<std::string, std::vector< boost::shared_ptr<const NeverCollidingLinkPairs> > >::const_iterator it = s_mapNeverCollidingLinkPairs.find(hash);
+        if( it != s_mapNeverCollidingLinkPairs.end() ) {
+            FOREACHC(itpairs, it->second) {
+                if( _IsSampledWith(**itpairs, vlimitslower, vlimitsupper, numSamples, fMargin) ) {
+                    _pNeverCollidingLinkPairs = *itpairs;
+                    _ResetInternalCollisionCache();
+                    return;
+                }
+            }
+        }
+    }
+
+    // sample the pairs that are left after the initial pose check
+    _pNeverCollidingLinkPairs.reset();
+    _ResetInternalCollisionCache();
+    const std::vector<int> vNonAdjacentLinks = GetNonAdjacentLinks(0);
+
+    const size_t numLinks = _veclinks.size();
+    boost::shared_ptr<NeverCollidingLinkPairs> pNeverColliding(new NeverCollidingLinkPairs());
+    pNeverColliding->kinematicsGeometryHash = hash;
+    pNeverColliding->vLowerLimits = vlimitslower;
+    pNeverColliding->vUpperLimits = vlimitsupper;
+    pNeverColliding->numSamples = numSamples;
+    pNeverColliding->fMargin = fMargin;
+    pNeverColliding->vPairsMask.resize(((numLinks*(numLinks-1)/2)+63)/64, 0);
+    std::vector<uint8_t> vCollided(vNonAdjacentLinks.size(), 0);
+    if( GetDOF() > 0 && numSamples > 0 ) {
+        KinBodyStateSaver saver(shared_kinbody(), Save_LinkTransformation);
+        CollisionCheckerBasePtr collisionchecker = !!_selfcollisionchecker ? _selfcollisionchecker : GetEnv()->GetCollisionChecker();
+        CollisionOptionsStateSaver colsaver(collisionchecker, fMargin > 0 ? CO_IgnoreCallbacks|CO_Distance : CO_IgnoreCallbacks, false);
+        const bool bDistance = fMargin > 0 && (collisionchecker->GetCollisionOptions() & CO_Distance);
+        CollisionReportPtr report(new CollisionReport());
+        std::vector<dReal> vlower = vlimitslower, vupper = vlimitsupper, vsample;
+        for(int idof = 0; idof < GetDOF(); ++idof) {
+            // circular joints have infinite limits
+            vlower[idof] = std::max(vlower[idof], dReal(-PI));
+            vupper[idof] = std::min(vupper[idof], dReal(PI));
+        }
+        // the current configuration is checked first so that a pair colliding in it is always kept
+        GetDOFValues(vsample);
+        std::vector<AABB> vlinkaabbs(numLinks);
+        // local generator seeded with the hash so that the samples are reproducible and do not disturb the global random sequence of the planners
+        std::mt19937 rng(std::hash<std::string>()(hash));
+        std::uniform_real_distribution<dReal> distribution(0, 1);
+        for(int isample = 0; isample <= numSamples; ++isample) {
+            if( isample > 0 ) {
+                for(int idof = 0; idof < GetDOF(); ++idof) {
+                    vsample[idof] = vlower[idof] + (vupper[idof] - vlower[idof])*distribution(rng);
+                }
+                SetDOFValues(vsample, CLA_Nothing);
+            }
+            if( fMargin > 0 ) {
+                for(size_t ilink = 0; ilink < numLinks; ++ilink) {
+                    vlinkaabbs[ilink] = _veclinks[ilink]->ComputeAABB();
+                }
+            }
+            for(size_t ipair = 0; ipair < vNonAdjacentLinks.size(); ++ipair) {
+                if( vCollided[ipair] ) {
+                    continue;
+                }
+                const int ilink0 = vNonAdjacentLinks[ipair]&0xffff, ilink1 = vNonAdjacentLinks[ipair]>>16;
+                if( fMargin > 0 ) {
+                    // links whose boxes are farther apart than the margin cannot touch
+                    const Vector vdist = vlinkaabbs[ilink0].pos - vlinkaabbs[ilink1].pos;
+                    const Vector vextents = vlinkaabbs[ilink0].extents + vlinkaabbs[ilink1].extents;
+                    if( RaveFabs(vdist.x) > vextents.x + fMargin || RaveFabs(vdist.y) > vextents.y + fMargin || RaveFabs(vdist.z) > vextents.z + fMargin ) {
+                        continue;
+                    }
+                    if( !bDistance ) {
+                        vCollided[ipair] = 1;
+                        continue;
+                    }
+                }
+                report->Reset();
+                if( collisionchecker->CheckCollision(LinkConstPtr(_veclinks.at(ilink0)), LinkConstPtr(_veclinks.at(ilink1)), report) || (bDistance && report->minDistance < fMargin) ) {
+                    vCollided[ipair] = 1;
+                }
+            }
+        }
+    }
+
+    int numNeverColliding = 0;
+    for(size_t ipair = 0; ipair < vNonAdjacentLinks.size(); ++ipair) {
+        if( !vCollided[ipair] ) {
+            const size_t index1d = _GetIndex1d(vNonAdjacentLinks[ipair]&0xffff, vNonAdjacentLinks[ipair]>>16);
+            pNeverColliding->vPairsMask[index1d>>6] |= uint64_t(1)<<(index1d&63);
+            ++numNeverColliding;
+        }
+    }
+    RAVELOG_DEBUG_FORMAT("env=%s, body %s has %d/%d non-adjacent link pairs that never came closer than %f in %d samples", GetEnv()->GetNameId()%GetName()%numNeverColliding%vNonAdjacentLinks.size()%fMargin%numSamples);
+
+    {
+        std::lock_guard<std::mutex> lock(s_mutexNeverCollidingLinkPairs);
+        std::vector< boost::shared_ptr<const NeverCollidingLinkPairs> >& vpairs = s_mapNeverCollidingLinkPairs[hash];
+        std::vector< boost::shared_ptr<const NeverCollidingLinkPairs> >::iterator itpairs = vpairs.begin();
+        while( itpairs != vpairs.end() && !_IsSampledWith(**itpairs, vlimitslower, vlimitsupper, numSamples, fMargin) ) {
+            ++itpairs;
+        }
+        if( itpairs != vpairs.end() ) {
+            *itpairs = pNeverColliding;
+        }
+        else {
+            vpairs.push_back(pNeverColliding);
+        }
+    }
+    _pNeverCollidingLinkPairs = pNeverColliding;
+    _ResetInternalCollisionCache();
+}
+
+void KinBody::ResetNeverCollidingLinkPairs()
+{
+    if( !!_pNeverCollidingLinkPairs ) {
+        _pNeverCollidingLinkPairs.reset();
+        _ResetInternalCollisionCache();
+    }
+}
+
 bool KinBody::AreAdjacentLinks(int linkindex0, int linkindex1) const
 {
     CHECK_INTERNAL_COMPUTATION;
@@ -5655,6 +6562,42 @@ void KinBody::_SetAdjacentLinksInternal(int linkindex0, int linkindex1)
     _vForcedAdjacentLinks.at(index) = 1;
 }
 
+void KinBody::GetMemoryUsage(MemoryUsage& memoryusage) const
+{
+    InterfaceBase::GetMemoryUsage(memoryusage);
+    uint64_t meshbytes = 0, linkbytes = 0, jointbytes = 0, readablebytes = 0, compactmeshbytes = 0;
+    FOREACHC(itlink, _veclinks) {
+        const Link& link = **itlink;
+        linkbytes += sizeof(Link) + link._info._name.capacity() + link._info._id.capacity() + GetVectorMemoryUsage(link._vGeometries);
+        meshbytes += GetVectorMemoryUsage(link._collision.vertices) + GetVectorMemoryUsage(link._collision.indices);
+        readablebytes += link.GetReadablesMemoryUsage();
+        FOREACHC(itgeom, link._vGeometries) {
+            const Geometry& geom = **itgeom;
+            linkbytes += sizeof(Geometry);
+            meshbytes += GetVectorMemoryUsage(geom._info._meshcollision.vertices) + GetVectorMemoryUsage(geom._info._meshcollision.indices);
+            if( !!geom._pCompactCollisionMesh ) {
+                compactmeshbytes += geom._pCompactCollisionMesh->GetMemoryUsage();
+            }
+        }
+    }
+    FOREACHC(itjoint, _vecjoints) {
+        jointbytes += sizeof(Joint);
+        readablebytes += (*itjoint)->GetReadablesMemoryUsage();
+    }
+    FOREACHC(itjoint, _vPassiveJoints) {
+        jointbytes += sizeof(Joint);
+        readablebytes += (*itjoint)->GetReadablesMemoryUsage();
+    }
+    memoryusage.Add("meshes", meshbytes);
+    memoryusage.Add("links", linkbytes);
+    memoryusage.Add("joints", jointbytes);
+    memoryusage.Add("readables", readablebytes);
+    memoryusage.Add("kinematics", GetVectorMemoryUsage(_vAllPairsShortestPaths) + GetVectorMemoryUsage(_vJointsAffectingLinks) + GetVectorMemoryUsage(_vLinkTransformPointers));
+    if( compactmeshbytes > 0 ) {
+        memoryusage.Add("sharedcompactmeshes", compactmeshbytes);
+    }
+}
+
 void KinBody::Clone(InterfaceBaseConstPtr preference, int cloningoptions)
 {
     InterfaceBase::Clone(preference,cloningoptions);
@@ -5682,12 +6625,21 @@ void KinBody::Clone(InterfaceBaseConstPtr preference, int cloningoptions)
             // have to copy all the geometries too!
             std::vector<Link::GeometryPtr> vnewgeometries(newlink._vGeometries.size());
             for(size_t igeom = 0; igeom < vnewgeometries.size(); ++igeom) {
-                vnewgeometries[igeom].reset(new Link::Geometry(pnewlink, newlink._vGeometries[igeom]->_info));
+                const Link::Geometry& origgeom = *newlink._vGeometries[igeom];
+                vnewgeometries[igeom].reset(new Link::Geometry(pnewlink, origgeom._info));
+                if( (cloningoptions & Clone_ShareGeometry) && !!origgeom._pCompactCollisionMesh && origgeom._pCompactCollisionMeshLink == origLinkPtr.get() && origgeom._nCompactCollisionMeshShapeStamp == origLinkPtr->GetGeometryShapeStamp() ) {
+                    // the compact mesh is immutable and still matches the copied shape, so share it instead of building it again
+                    Link::Geometry& newgeom = *vnewgeometries[igeom];
+                    newgeom._pCompactCollisionMesh = origgeom._pCompactCollisionMesh;
+                    newgeom._pCompactCollisionMeshLink = pnewlink.get();
+                    newgeom._nCompactCollisionMeshShapeStamp = newlink.GetGeometryShapeStamp();
+                }
             }
             newlink._vGeometries = vnewgeometries;
         }
-        {
+        if( !(cloningoptions & Clone_ShareGeometry) ) {
             // deep copy extra geometries as well, otherwise changing value of map in original map affects value of cloned map
+            // when sharing, the map itself is already a copy and the GeometryInfo objects are never modified in place, so it is safe to keep the pointers
             std::map< std::string, std::vector<GeometryInfoPtr> > newMapExtraGeometries;
             for (const std::pair<const std::string, std::vector<GeometryInfoPtr> >& keyValue : newlink._info._mapExtraGeometries) {
                 std::vector<GeometryInfoPtr> newvalues;
@@ -5725,11 +6677,11 @@ void KinBody::Clone(InterfaceBaseConstPtr preference, int cloningoptions)
         _vPassiveJoints.push_back(pnewjoint);
     }
 
-    _vTopologicallySortedJoints.resize(0); _vTopologicallySortedJoints.resize(r->_vTopologicallySortedJoints.size());
+    _vTopologicallySortedJoints.resize(0); _vTopologicallySortedJoints.reserve(r->_vTopologicallySortedJoints.size());
     FOREACHC(itjoint, r->_vTopologicallySortedJoints) {
         _vTopologicallySortedJoints.push_back(_vecjoints.at((*itjoint)->GetJointIndex()));
     }
-    _vTopologicallySortedJointsAll.resize(0); _vTopologicallySortedJointsAll.resize(r->_vTopologicallySortedJointsAll.size());
+    _vTopologicallySortedJointsAll.resize(0); _vTopologicallySortedJointsAll.reserve(r->_vTopologicallySortedJointsAll.size());
     FOREACHC(itjoint, r->_vTopologicallySortedJointsAll) {
         std::vector<JointPtr>::const_iterator it = find(r->_vecjoints.begin(),r->_vecjoints.end(),*itjoint);
         if( it != r->_vecjoints.end() ) {
@@ -5753,6 +6705,7 @@ void KinBody::Clone(InterfaceBaseConstPtr preference, int cloningoptions)
     _vInitialLinkTransformations = r->_vInitialLinkTransformations;
     _vForcedAdjacentLinks = r->_vForcedAdjacentLinks;
     _vAllPairsShortestPaths = r->_vAllPairsShortestPaths;
+    _pKinematicsHierarchy = r->_pKinematicsHierarchy; // so _ComputeInternalInformation of the clone does not recompute the hierarchy
     _vClosedLoopIndices = r->_vClosedLoopIndices;
     _vClosedLoops.resize(0); _vClosedLoops.reserve(r->_vClosedLoops.size());
     FOREACHC(itloop,_vClosedLoops) {
@@ -5786,6 +6739,12 @@ void KinBody::Clone(InterfaceBaseConstPtr preference, int cloningoptions)
 
     // cache
     _ResetInternalCollisionCache();
+    // the clone has the same links and geometries, so it can reuse the link pairs instead of checking them again
+    _pNeverCollidingLinkPairs = r->_pNeverCollidingLinkPairs;
+    if( !(r->_nNonAdjacentLinkCache & 0x80000000) ) {
+        _vNonAdjacentLinks[0] = r->_vNonAdjacentLinks[0];
+        _nNonAdjacentLinkCache = 0;
+    }
 
     // clone the grabbed bodies, note that this can fail if the new cloned environment hasn't added the bodies yet (check out Environment::Clone)
     _listAttachedBodies.clear(); // will be set in the environment
@@ -5881,12 +6840,12 @@ void KinBody::Clone(InterfaceBaseConstPtr preference, int cloningoptions)
     _lastModifiedAtUS = r->_lastModifiedAtUS;
     _revisionId = r->_revisionId;
 
-    _nUpdateStampId++; // update the stamp instead of copying
+    _IncrementUpdateStamp(); // update the stamp instead of copying
 }
 
 void KinBody::_PostprocessChangedParameters(uint32_t parameters)
 {
-    _nUpdateStampId++;
+    _IncrementUpdateStamp();
     if( _nHierarchyComputed == 1 ) {
         _nParametersChanged |= parameters;
         return;
@@ -5903,26 +6862,52 @@ void KinBody::_PostprocessChangedParameters(uint32_t parameters)
         __hashKinematicsGeometryDynamics.resize(0);
     }
 
+    if( (parameters&Prop_JointLimits) == Prop_JointLimits && !!_pNeverCollidingLinkPairs ) {
+        // the pairs sampled by ComputeNeverCollidingLinkPairs do not apply to the new limits
+        _ResetInternalCollisionCache();
+    }
+
     if( (parameters&Prop_LinkEnable) == Prop_LinkEnable ) {
     }
 
-    std::list<UserDataWeakPtr> listRegisteredCallbacks;
-    uint32_t index = 0;
-    while(parameters && index < _vlistRegisteredCallbacks.size()) {
-        if( (parameters & 1) &&  _vlistRegisteredCallbacks.at(index).size() > 0 ) {
-            {
-                boost::shared_lock< boost::shared_mutex > lock(GetInterfaceMutex());
-                listRegisteredCallbacks = _vlistRegisteredCallbacks.at(index); // copy since it can be changed
-            }
-            FOREACH(it,listRegisteredCallbacks) {
-                ChangeCallbackDataPtr pdata = boost::dynamic_pointer_cast<ChangeCallbackData>(it->lock());
-                if( !!pdata ) {
-                    pdata->_callback();
+    if( _nChangeCallbackCoalescers > 0 ) {
+        _nCoalescedParametersChanged |= parameters;
+        return;
+    }
+    _CallChangeCallbacks(parameters);
+}
+
+void KinBody::_CallChangeCallbacks(uint32_t parameters)
+{
+    for(uint32_t index = 0; parameters; ++index, parameters >>= 1) {
+        if( parameters & 1 ) {
+            // hold the vector since it can be swapped by a callback registering or unregistering
+            ChangeCallbackVectorConstPtr pcallbacks = boost::atomic_load(&_vRegisteredCallbacks[index]);
+            if( !!pcallbacks ) {
+                FOREACHC(itcallback, *pcallbacks) {
+                    (**itcallback)();
                 }
             }
         }
-        parameters >>= 1;
-        index += 1;
+    }
+}
+
+KinBody::ChangeCallbackCoalescer::ChangeCallbackCoalescer(KinBody& body) : _body(body)
+{
+    _body._nChangeCallbackCoalescers++;
+}
+
+KinBody::ChangeCallbackCoalescer::~ChangeCallbackCoalescer()
+{
+    if( --_body._nChangeCallbackCoalescers == 0 && _body._nCoalescedParametersChanged != 0 ) {
+        uint32_t parameters = _body._nCoalescedParametersChanged;
+        _body._nCoalescedParametersChanged = 0;
+        try {
+            _body._CallChangeCallbacks(parameters);
+        }
+        catch(const std::exception& ex) {
+            RAVELOG_WARN_FORMAT("env=%s, body %s change callbacks failed: %s", _body.GetEnv()->GetNameId()%_body.GetName()%ex.what());
+        }
     }
 }
 
@@ -5963,11 +6948,13 @@ const std::string& KinBody::GetKinematicsGeometryHash() const
 {
     CHECK_INTERNAL_COMPUTATION;
     if( __hashKinematicsGeometryDynamics.size() == 0 ) {
-        ostringstream ss;
+        // hash while serializing since the serialization of the meshes can be large
+        MD5HashStreamBuffer md5buffer;
+        std::ostream ss(&md5buffer);
         ss << std::fixed << std::setprecision(SERIALIZATION_PRECISION);
         // should add dynamics since that affects a lot how part is treated.
         serialize(ss,SO_Kinematics|SO_Geometry|SO_Dynamics);
-        __hashKinematicsGeometryDynamics = utils::GetMD5HashString(ss.str());
+        __hashKinematicsGeometryDynamics = md5buffer.GetHashString();
     }
     return __hashKinematicsGeometryDynamics;
 }
@@ -6027,21 +7014,17 @@ UserDataPtr KinBody::RegisterChangeCallback(uint32_t properties, const boost::fu
     ChangeCallbackDataPtr pdata(new ChangeCallbackData(properties,callback,shared_kinbody_const()));
     std::unique_lock<boost::shared_mutex> lock(GetInterfaceMutex());
 
-    uint32_t index = 0;
-    while(properties) {
+    for(uint32_t index = 0; properties; ++index, properties >>= 1) {
         if( properties & 1 ) {
-            if( index >= _vlistRegisteredCallbacks.size() ) {
-                // have to resize _vlistRegisteredCallbacks, but have to preserve the internal lists since ChangeCallbackData keep track of the list iterators
-                std::vector<std::list<UserDataWeakPtr> > vlistRegisteredCallbacks(index+1);
-                for(size_t i = 0; i < _vlistRegisteredCallbacks.size(); ++i) {
-                    vlistRegisteredCallbacks[i].swap(_vlistRegisteredCallbacks[i]);
-                }
-                _vlistRegisteredCallbacks.swap(vlistRegisteredCallbacks);
+            // copy-on-write so that callbacks being called from other threads keep on using the previous vector
+            boost::shared_ptr<ChangeCallbackVector> pnewcallbacks(new ChangeCallbackVector());
+            if( !!_vRegisteredCallbacks[index] ) {
+                pnewcallbacks->reserve(_vRegisteredCallbacks[index]->size()+1);
+                *pnewcallbacks = *_vRegisteredCallbacks[index];
             }
-            pdata->_iterators.emplace_back(index, _vlistRegisteredCallbacks.at(index).insert(_vlistRegisteredCallbacks.at(index).end(), pdata));
+            pnewcallbacks->push_back(pdata->_pcallback);
+            boost::atomic_store(&_vRegisteredCallbacks[index], ChangeCallbackVectorConstPtr(pnewcallbacks));
         }
-        properties >>= 1;
-        index += 1;
     }
     return pdata;
 }
@@ -713,6 +713,16 @@ bool KinBody::GeometryInfo::InitCollisionMesh(float fTessellation)
 }
 
 bool KinBody::GeometryInfo::ComputeInnerEmptyVolume(Transform& tInnerEmptyVolume, Vector& abInnerEmptyExtents) const
+{
+    Transform tlocal;
+    if( !_ComputeInnerEmptyVolumeInGeometryFrame(tlocal, abInnerEmptyExtents) ) {
+        return false;
+    }
+    tInnerEmptyVolume = _t*tlocal;
+    return true;
+}
+
+bool KinBody::GeometryInfo::_ComputeInnerEmptyVolumeInGeometryFrame(Transform& tInnerEmptyVolume, Vector& abInnerEmptyExtents) const
 {
     switch(_type) {
     case GT_Cage: {
@@ -811,8 +821,8 @@ bool KinBody::GeometryInfo::ComputeInnerEmptyVolume(Transform& tInnerEmptyVolume
         }
 
         abInnerEmptyExtents = 0.5*(vwallmax - vwallmin);
-        tInnerEmptyVolume = _t;
-        tInnerEmptyVolume.trans += tInnerEmptyVolume.rotate(0.5*(vwallmax + vwallmin));
+        tInnerEmptyVolume = Transform();
+        tInnerEmptyVolume.trans = 0.5*(vwallmax + vwallmin);
         return true;
     }
     case GT_Container: {
@@ -823,7 +833,7 @@ bool KinBody::GeometryInfo::ComputeInnerEmptyVolume(Transform& tInnerEmptyVolume
             // if _vGeomData4 is valid, need to shift the empty region up.
             tempty.trans.z += _vGeomData4.z;
         }
-        tInnerEmptyVolume = _t*tempty;
+        tInnerEmptyVolume = tempty;
         abInnerEmptyExtents = 0.5*_vGeomData2;
         return true;
     }
@@ -1770,7 +1780,19 @@ bool KinBody::Geometry::InitCollisionMesh(float fTessellation)
 
 bool KinBody::Geometry::ComputeInnerEmptyVolume(Transform& tInnerEmptyVolume, Vector& abInnerEmptyExtents) const
 {
-    return _info.ComputeInnerEmptyVolume(tInnerEmptyVolume, abInnerEmptyExtents);
+    // the shape only changes with the shape stamp, the transform is applied on every call since changing it keeps the stamp
+    LinkPtr parent = _parent.lock();
+    if( !_pInnerEmptyVolumeLink || _pInnerEmptyVolumeLink != parent.get() || _nInnerEmptyVolumeShapeStamp != parent->GetGeometryShapeStamp() ) {
+        _bHasInnerEmptyVolume = _info._ComputeInnerEmptyVolumeInGeometryFrame(_tInnerEmptyVolumeInGeometry, _vInnerEmptyExtents);
+        _pInnerEmptyVolumeLink = parent.get();
+        _nInnerEmptyVolumeShapeStamp = !!parent ? parent->GetGeometryShapeStamp() : 0;
+    }
+    if( !_bHasInnerEmptyVolume ) {
+        return false;
+    }
+    tInnerEmptyVolume = _info._t*_tInnerEmptyVolumeInGeometry;
+    abInnerEmptyExtents = _vInnerEmptyExtents;
+    return true;
 }
 
 AABB KinBody::Geometry::ComputeAABB(const Transform& t) const
@@ -1805,6 +1827,18 @@ void KinBody::Geometry::serialize(std::ostream& o, int options) const
     }
 }
 
+TriMeshCompactConstPtr KinBody::Geometry::GetCompactCollisionMesh() const
+{
+    LinkPtr parent = _parent.lock();
+    if( !!_pCompactCollisionMesh && !!parent && _pCompactCollisionMeshLink == parent.get() && _nCompactCollisionMeshShapeStamp == parent->GetGeometryShapeStamp() ) {
+        return _pCompactCollisionMesh;
+    }
+    _pCompactCollisionMesh = TriMeshCompact::Create(_info._meshcollision);
+    _pCompactCollisionMeshLink = parent.get();
+    _nCompactCollisionMeshShapeStamp = !!parent ? parent->GetGeometryShapeStamp() : 0;
+    return _pCompactCollisionMesh;
+}
+
 void KinBody::Geometry::SetCollisionMesh(const TriMesh& mesh)
 {
     OPENRAVE_ASSERT_FORMAT0(_info._bModifiable, "geometry cannot be modified", ORE_Failed);
@@ -1910,8 +1944,32 @@ void KinBody::Geometry::SetPositiveCropContainerEmptyMargins(const Vector& posit
 bool KinBody::Geometry::ValidateContactNormal(const Vector& _position, Vector& _normal) const
 {
     Transform tinv = _info._t.inverse();
-    Vector position = tinv*_position;
-    Vector normal = tinv.rotate(_normal);
+    if( _IsContactNormalInside(tinv*_position, tinv.rotate(_normal)) ) {
+        _normal = -_normal;
+        return true;
+    }
+    return false;
+}
+
+int KinBody::Geometry::ValidateContactNormals(std::vector<CONTACT>& vcontacts, const Transform& tLink) const
+{
+    if( _info._type != GT_Box && _info._type != GT_Cylinder && _info._type != GT_Sphere ) {
+        // the other shapes never flip the normals
+        return 0;
+    }
+    const Transform tinv = (tLink*_info._t).inverse();
+    int numflipped = 0;
+    for(CONTACT& contact : vcontacts) {
+        if( _IsContactNormalInside(tinv*contact.pos, tinv.rotate(contact.norm)) ) {
+            contact.norm = -contact.norm;
+            ++numflipped;
+        }
+    }
+    return numflipped;
+}
+
+bool KinBody::Geometry::_IsContactNormalInside(const Vector& position, const Vector& normal) const
+{
     const dReal feps=0.00005f;
     switch(_info._type) {
     case GT_Box: {
@@ -1950,7 +2008,6 @@ bool KinBody::Geometry::ValidateContactNormal(const Vector& _position, Vector& _
             }
         }
         if( penetration < -feps ) {
-            _normal = -_normal;
             return true;
         }
         break;
@@ -1959,18 +2016,15 @@ bool KinBody::Geometry::ValidateContactNormal(const Vector& _position, Vector& _
         dReal fInsideCircle = position.x*position.x+position.y*position.y-_info._vGeomData.x*_info._vGeomData.x;
         dReal fInsideHeight = 2.0f*RaveFabs(position.z)-_info._vGeomData.y;
         if((fInsideCircle < -feps)&&(fInsideHeight > -feps)&&(normal.z*position.z<0)) {
-            _normal = -_normal;
             return true;
         }
         if((fInsideCircle > -feps)&&(fInsideHeight < -feps)&&(normal.x*position.x+normal.y*position.y < 0)) {
-            _normal = -_normal;
             return true;
         }
         break;
     }
     case GT_Sphere:
         if( normal.dot3(position) < 0 ) {
-            _normal = -_normal;
             return true;
         }
         break;
@@ -2023,10 +2077,8 @@ UpdateFromInfoResult KinBody::Geometry::UpdateFromInfo(const KinBody::GeometryIn
         return UFIR_RequireReinitialize;
     }
 
-    if( info.IsModifiedField(KinBody::GeometryInfo::GIF_Transform) && GetTransform().CompareTransform(info._t, g_fEpsilon) ) {
-        RAVELOG_VERBOSE_FORMAT("geometry %s transform changed", _info._id);
-        return UFIR_RequireReinitialize;
-    }
+    // the collision mesh is in the geometry frame, so a new transform is applied after all the shape checks without reinitializing
+    const bool bTransformChanged = info.IsModifiedField(KinBody::GeometryInfo::GIF_Transform) && GetTransform().CompareTransform(info._t, g_fEpsilon);
 
     if (GetType() == GT_Box) {
         if (GetBoxExtents() != info._vGeomData) {
@@ -2084,6 +2136,14 @@ UpdateFromInfoResult KinBody::Geometry::UpdateFromInfo(const KinBody::GeometryIn
         }
     }
 
+    if( bTransformChanged ) {
+        _info.SetTransform(info._t);
+        LinkPtr parent(_parent);
+        parent->_UpdateGeometryTransforms();
+        RAVELOG_VERBOSE_FORMAT("geometry %s transform changed", _info._id);
+        updateFromInfoResult = UFIR_Success;
+    }
+
     // transparency
     if (GetTransparency() != info._fTransparency) {
         SetTransparency(info._fTransparency);
@@ -60,6 +60,19 @@ void Grabbed::AddMoreIgnoreLinks(const std::set<int>& setAdditionalGrabberLinksT
     }
 }
 
+void Grabbed::RecordUpdateStamps()
+{
+    KinBodyPtr pGrabbedBody = _pGrabbedBody.lock();
+    _nGrabberUpdateStamp = _pGrabbingLink->GetParent()->GetUpdateStamp();
+    _nGrabbedUpdateStamp = !!pGrabbedBody ? pGrabbedBody->GetUpdateStamp() : -1;
+}
+
+bool Grabbed::IsStateUnchanged() const
+{
+    KinBodyPtr pGrabbedBody = _pGrabbedBody.lock();
+    return !!pGrabbedBody && _nGrabbedUpdateStamp == pGrabbedBody->GetUpdateStamp() && _nGrabberUpdateStamp == _pGrabbingLink->GetParent()->GetUpdateStamp();
+}
+
 void Grabbed::ComputeListNonCollidingLinks()
 {
     if( _listNonCollidingIsValid ) {
@@ -319,6 +332,7 @@ bool KinBody::Grab(KinBodyPtr pGrabbedBody, LinkPtr pGrabbingLink, const std::se
         RAVELOG_ERROR_FORMAT("env=%s, failed to post-process changed parameters: %s", GetEnv()->GetNameId()%ex.what());
         throw;
     }
+    pGrabbed->RecordUpdateStamps();
 
     return true;
 }
@@ -401,6 +415,12 @@ void KinBody::RegrabAll()
     CollisionOptionsStateSaver colsaver(collisionchecker,0); // have to reset the collision options
 
     size_t numGrabbed = _vGrabbedBodies.size();
+    // detaching the bodies increments their update stamps, so check beforehand which grabs can keep their non-colliding links
+    std::vector<uint8_t> vKeepNonCollidingLinks(numGrabbed);
+    for( size_t iGrabbed = 0; iGrabbed < numGrabbed; ++iGrabbed ) {
+        vKeepNonCollidingLinks[iGrabbed] = _vGrabbedBodies[iGrabbed]->IsListNonCollidingLinksValid() && _vGrabbedBodies[iGrabbed]->IsStateUnchanged();
+    }
+
     // Remove bodies from _listAttachedBodies first and then will add them back later. Maybe this is for triggering
     // postprocessing with Prop_BodyAttached?
     FOREACH(itGrabbed, _vGrabbedBodies) {
@@ -427,6 +447,11 @@ void KinBody::RegrabAll()
         GrabbedPtr pNewGrabbed(new Grabbed(pBody, pGrabbed->_pGrabbingLink));
         pNewGrabbed->_tRelative = pGrabbed->_tRelative;
         pNewGrabbed->_setGrabberLinkIndicesToIgnore = pGrabbed->_setGrabberLinkIndicesToIgnore;
+        if( vKeepNonCollidingLinks[iGrabbed] ) {
+            // neither body changed since the original grab, so recomputing the list would give the same links
+            pNewGrabbed->_listNonCollidingLinksWhenGrabbed = pGrabbed->_listNonCollidingLinksWhenGrabbed;
+            pNewGrabbed->_SetLinkNonCollidingIsValid(true);
+        }
         CopyRapidJsonDoc(pGrabbed->_rGrabbedUserData, pNewGrabbed->_rGrabbedUserData);
 
         std::pair<Vector, Vector> velocity = pNewGrabbed->_pGrabbingLink->GetVelocity();
@@ -444,6 +469,9 @@ void KinBody::RegrabAll()
             throw;
         }
     }
+    FOREACH(itGrabbed, _vGrabbedBodies) {
+        (*itGrabbed)->RecordUpdateStamps();
+    }
 }
 
 KinBody::LinkPtr KinBody::IsGrabbing(const KinBody &body) const
@@ -856,19 +884,11 @@ void KinBody::GetIgnoredLinksOfGrabbed(KinBodyConstPtr body, std::list<KinBody::
 void KinBody::_UpdateGrabbedBodies()
 {
     std::vector<GrabbedPtr>::iterator itgrabbed = _vGrabbedBodies.begin();
-    std::pair<Vector, Vector> velocity;
-    Transform tGrabbedBody; // cache
     while(itgrabbed != _vGrabbedBodies.end() ) {
         GrabbedPtr pgrabbed = *itgrabbed;
         KinBodyPtr pGrabbedBody = pgrabbed->_pGrabbedBody.lock();
         if( !!pGrabbedBody ) {
-            const Transform& tGrabbingLink = pgrabbed->_pGrabbingLink->GetTransform();
-            tGrabbedBody = tGrabbingLink * pgrabbed->_tRelative;
-            pGrabbedBody->SetTransform(tGrabbedBody);
-            // set the correct velocity
-            pgrabbed->_pGrabbingLink->GetVelocity(velocity.first, velocity.second);
-            velocity.first += velocity.second.cross(tGrabbedBody.trans - tGrabbingLink.trans);
-            pGrabbedBody->SetVelocity(velocity.first, velocity.second);
+            _UpdateGrabbedBody(*pgrabbed, *pGrabbedBody);
             ++itgrabbed;
         }
         else {
@@ -878,6 +898,40 @@ void KinBody::_UpdateGrabbedBodies()
     }
 }
 
+void KinBody::_UpdateGrabbedBodies(const std::vector<uint8_t>& vLinksMoved)
+{
+    std::vector<GrabbedPtr>::iterator itgrabbed = _vGrabbedBodies.begin();
+    while(itgrabbed != _vGrabbedBodies.end() ) {
+        GrabbedPtr pgrabbed = *itgrabbed;
+        KinBodyPtr pGrabbedBody = pgrabbed->_pGrabbedBody.lock();
+        if( !!pGrabbedBody ) {
+            if( vLinksMoved.at(pgrabbed->_pGrabbingLink->GetIndex()) ) {
+                _UpdateGrabbedBody(*pgrabbed, *pGrabbedBody);
+            }
+            ++itgrabbed;
+        }
+        else {
+            RAVELOG_DEBUG_FORMAT("env=%s, erasing invalid grabbed body from grabbing body '%s'", GetEnv()->GetNameId()%GetName());
+            itgrabbed = _RemoveGrabbedBody(itgrabbed);
+        }
+    }
+}
+
+void KinBody::_UpdateGrabbedBody(const Grabbed& grabbed, KinBody& grabbedBody)
+{
+    const Transform& tGrabbingLink = grabbed._pGrabbingLink->GetTransform();
+    const Transform tGrabbedBody = tGrabbingLink * grabbed._tRelative;
+    // when the grabbing link did not move, SetTransform would only trigger the callbacks and the collision checker updates of the grabbed body
+    if( grabbedBody.GetLinks().empty() || grabbedBody.GetTransform() != tGrabbedBody ) {
+        grabbedBody.SetTransform(tGrabbedBody);
+    }
+    // set the correct velocity
+    std::pair<Vector, Vector> velocity;
+    grabbed._pGrabbingLink->GetVelocity(velocity.first, velocity.second);
+    velocity.first += velocity.second.cross(tGrabbedBody.trans - tGrabbingLink.trans);
+    grabbedBody.SetVelocity(velocity.first, velocity.second);
+}
+
 std::vector<GrabbedPtr>::iterator KinBody::_RemoveGrabbedBody(std::vector<GrabbedPtr>::iterator itGrabbed)
 {
     KinBodyConstPtr pgrabbedbody = (*itGrabbed)->_pGrabbedBody.lock();
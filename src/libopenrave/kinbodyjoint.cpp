@@ -645,10 +645,13 @@ void KinBody::JointInfo::DeserializeJSON(const rapidjson::Value& value, dReal fU
 
 void KinBody::JointInfo::_DeserializeReadableInterface(const std::string& id, const rapidjson::Value& rReadable, dReal fUnitScale) {
     std::map<std::string, ReadablePtr>::iterator itReadable = _mReadableInterfaces.find(id);
-    ReadablePtr pReadable;
-    if(itReadable != _mReadableInterfaces.end()) {
-        pReadable = itReadable->second;
+    if(itReadable == _mReadableInterfaces.end()) {
+        // most readables are never accessed, so only deserialize them when they are
+        _mReadableInterfaces[id].reset(new LazyJSONReadable(PT_KinBody, id, rReadable, fUnitScale));
+        return;
     }
+    // updating an existing readable, so the reader has to merge into it
+    ReadablePtr pReadable = LazyJSONReadable::Resolve(itReadable->second);
     BaseJSONReaderPtr pReader = RaveCallJSONReader(PT_KinBody, id, pReadable, AttributesList());
     if (!!pReader) {
         pReader->DeserializeJSON(rReadable, fUnitScale);
@@ -765,6 +768,184 @@ OpenRAVEFunctionParserRealPtr CreateJointFunctionParser()
     return parser;
 }
 
+/// \brief recognizes equations that are affine in their variables, like "0.5*joint1 - (joint2 + 0.1)/2", so that they are evaluated in closed form.
+///
+/// Only numbers, the variables, +, -, parentheses and multiplication or division by constants are accepted, anything else is left to the function parser.
+class AffineEquationParser
+{
+public:
+    AffineEquationParser(const std::string& eq, const std::vector<std::string>& vvars) : _eq(eq), _vvars(vvars), _pos(0) {
+    }
+
+    /// \param[out] vcoeffs the coefficients of the variables followed by the constant term
+    /// \return true if the equation is affine
+    bool Parse(std::vector<dReal>& vcoeffs)
+    {
+        _pos = 0;
+        if( !_ParseSum(vcoeffs) ) {
+            return false;
+        }
+        _SkipSpaces();
+        return _pos == _eq.size();
+    }
+
+private:
+    void _SkipSpaces() {
+        while( _pos < _eq.size() && isspace(_eq[_pos]) ) {
+            ++_pos;
+        }
+    }
+
+    bool _IsConstant(const std::vector<dReal>& vcoeffs) const {
+        for(size_t i = 0; i+1 < vcoeffs.size(); ++i) {
+            if( vcoeffs[i] != 0 ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool _ParseSum(std::vector<dReal>& vcoeffs)
+    {
+        if( !_ParseProduct(vcoeffs) ) {
+            return false;
+        }
+        std::vector<dReal> vterm;
+        while(true) {
+            _SkipSpaces();
+            if( _pos >= _eq.size() || (_eq[_pos] != '+' && _eq[_pos] != '-') ) {
+                return true;
+            }
+            const dReal fsign = _eq[_pos] == '-' ? -1 : 1;
+            ++_pos;
+            if( !_ParseProduct(vterm) ) {
+                return false;
+            }
+            for(size_t i = 0; i < vcoeffs.size(); ++i) {
+                vcoeffs[i] += fsign*vterm[i];
+            }
+        }
+    }
+
+    bool _ParseProduct(std::vector<dReal>& vcoeffs)
+    {
+        if( !_ParseUnary(vcoeffs) ) {
+            return false;
+        }
+        std::vector<dReal> vfactor;
+        while(true) {
+            _SkipSpaces();
+            if( _pos >= _eq.size() || (_eq[_pos] != '*' && _eq[_pos] != '/') ) {
+                return true;
+            }
+            const bool bDivide = _eq[_pos] == '/';
+            ++_pos;
+            if( !_ParseUnary(vfactor) ) {
+                return false;
+            }
+            if( bDivide ) {
+                if( !_IsConstant(vfactor) || vfactor.back() == 0 ) {
+                    return false;
+                }
+                for(dReal& f : vcoeffs) {
+                    f /= vfactor.back();
+                }
+            }
+            else if( _IsConstant(vfactor) ) {
+                for(dReal& f : vcoeffs) {
+                    f *= vfactor.back();
+                }
+            }
+            else if( _IsConstant(vcoeffs) ) {
+                const dReal fscale = vcoeffs.back();
+                for(size_t i = 0; i < vcoeffs.size(); ++i) {
+                    vcoeffs[i] = fscale*vfactor[i];
+                }
+            }
+            else {
+                return false;
+            }
+        }
+    }
+
+    bool _ParseUnary(std::vector<dReal>& vcoeffs)
+    {
+        _SkipSpaces();
+        if( _pos < _eq.size() && (_eq[_pos] == '-' || _eq[_pos] == '+') ) {
+            const dReal fsign = _eq[_pos] == '-' ? -1 : 1;
+            ++_pos;
+            if( !_ParseUnary(vcoeffs) ) {
+                return false;
+            }
+            for(dReal& f : vcoeffs) {
+                f *= fsign;
+            }
+            return true;
+        }
+        return _ParsePrimary(vcoeffs);
+    }
+
+    bool _ParsePrimary(std::vector<dReal>& vcoeffs)
+    {
+        _SkipSpaces();
+        if( _pos >= _eq.size() ) {
+            return false;
+        }
+        vcoeffs.assign(_vvars.size()+1, 0);
+        const char c = _eq[_pos];
+        if( c == '(' ) {
+            ++_pos;
+            if( !_ParseSum(vcoeffs) ) {
+                return false;
+            }
+            _SkipSpaces();
+            if( _pos >= _eq.size() || _eq[_pos] != ')' ) {
+                return false;
+            }
+            ++_pos;
+            return true;
+        }
+        if( isdigit(c) || c == '.' ) {
+            const char* pstart = _eq.c_str() + _pos;
+            char* pend = NULL;
+            vcoeffs.back() = strtod(pstart, &pend);
+            if( pend == pstart ) {
+                return false;
+            }
+            _pos += pend - pstart;
+            return true;
+        }
+        if( isalpha(c) || c == '_' ) {
+            size_t endpos = _pos;
+            while( endpos < _eq.size() && (isalnum(_eq[endpos]) || _eq[endpos] == '_') ) {
+                ++endpos;
+            }
+            std::vector<std::string>::const_iterator itvar = std::find(_vvars.begin(), _vvars.end(), _eq.substr(_pos, endpos-_pos));
+            if( itvar == _vvars.end() ) {
+                return false; // a function or an unknown constant
+            }
+            vcoeffs[itvar-_vvars.begin()] = 1;
+            _pos = endpos;
+            return true;
+        }
+        return false;
+    }
+
+    const std::string& _eq;
+    const std::vector<std::string>& _vvars;
+    size_t _pos;
+};
+
+/// \brief evaluates the coefficients computed by AffineEquationParser
+static inline dReal EvalAffineEquation(const std::vector<dReal>& vcoeffs, const std::vector<dReal>& vvalues)
+{
+    dReal f = vcoeffs.back();
+    for(size_t i = 0; i+1 < vcoeffs.size(); ++i) {
+        f += vcoeffs[i]*vvalues[i];
+    }
+    return f;
+}
+
 KinBody::Joint::Joint(KinBodyPtr parent, KinBody::JointType type)
 {
     _parent = parent;
@@ -2247,6 +2428,9 @@ void KinBody::Joint::SetMimicEquations(int iaxis, const std::string& poseq, cons
     if( ret >= 0 ) {
         throw OPENRAVE_EXCEPTION_FORMAT(_("failed to set equation '%s' on %s:%s, at %d. Error is %s\n"), poseq % parent->GetName() % GetName() % ret % pmimic->_posfn->ErrorMsg(), ORE_InvalidArguments);
     }
+    if( !AffineEquationParser(eq, resultVars).Parse(pmimic->_vposcoeffs) ) {
+        pmimic->_vposcoeffs.clear();
+    }
 
     // process the depended joint variables
     for(const std::string& var : resultVars) {
@@ -2289,6 +2473,7 @@ void KinBody::Joint::SetMimicEquations(int iaxis, const std::string& poseq, cons
         }
 
         std::vector<OpenRAVEFunctionParserRealPtr> vfns(nVars);
+        std::vector< std::vector<dReal> > vcoeffs(nVars);
         /*
             extract from `eq` the partial derivative formulas ∂z/∂xi for joint z:=z(x1,x2,...xn) defined in `poseq`.
             `eq` takes form
@@ -2340,6 +2525,10 @@ void KinBody::Joint::SetMimicEquations(int iaxis, const std::string& poseq, cons
                 throw OPENRAVE_EXCEPTION_FORMAT(_("failed to set equation '%s' on %s:%s, at %d. Error is %s"), sequation%parent->GetName()%GetName()%ret%fn->ErrorMsg(),ORE_InvalidArguments);
             }
             vfns.at(itnameindex-resultVars.begin()) = fn;
+            std::vector<dReal>& vfncoeffs = vcoeffs.at(itnameindex-resultVars.begin());
+            if( !AffineEquationParser(sequation, resultVars).Parse(vfncoeffs) ) {
+                vfncoeffs.clear();
+            }
         }
         // check if anything is missing
         for(size_t j = 0; j < nVars; ++j) {
@@ -2348,14 +2537,17 @@ void KinBody::Joint::SetMimicEquations(int iaxis, const std::string& poseq, cons
                 RAVELOG_WARN(str(boost::format("SetMimicEquations: missing variable %s from partial derivatives of joint %s!")%mapinvnames[resultVars[j]]%_info._name));
                 vfns[j] = CreateJointFunctionParser();
                 vfns[j]->Parse("0","");
+                vcoeffs[j].assign(nVars+1, 0);
             }
         }
 
         if( itype == 1 ) {
             pmimic->_velfns.swap(vfns);
+            pmimic->_vvelcoeffs.swap(vcoeffs);
         }
         else {
             pmimic->_accelfns.swap(vfns);
+            pmimic->_vaccelcoeffs.swap(vcoeffs);
         }
     }
     _vmimic.at(iaxis) = pmimic;
@@ -2434,8 +2626,13 @@ void KinBody::Joint::_ComputePartialVelocities(std::vector<std::pair<int, dReal>
         const int jointIndex = dofformat.jointindex; ///< index of this depended joint
         dReal fvel = 0;
         if(ivar < nvelfns) {
-            const OpenRAVEFunctionParserRealPtr velfn = pmimic->_velfns.at(ivar); ///< function that evaluates the partial derivative ∂z/∂x
-            fvel = velfn->Eval(vDependedJointValues.empty() ? NULL : &vDependedJointValues[0]); ///< value of ∂z/∂x
+            if( !pmimic->_vvelcoeffs.at(ivar).empty() ) {
+                fvel = EvalAffineEquation(pmimic->_vvelcoeffs[ivar], vDependedJointValues); ///< value of ∂z/∂x
+            }
+            else {
+                const OpenRAVEFunctionParserRealPtr velfn = pmimic->_velfns.at(ivar); ///< function that evaluates the partial derivative ∂z/∂x
+                fvel = velfn->Eval(vDependedJointValues.empty() ? NULL : &vDependedJointValues[0]); ///< value of ∂z/∂x
+            }
         }
         else {
             RAVELOG_WARN_FORMAT("This mimic joint %s depends on joint %s, but the user did not provide the mimic velocity formula. Now treat the first-order partial derivative as 0", this->GetName() % dependedjoint->GetName());
@@ -2491,25 +2688,27 @@ void KinBody::Joint::_ComputePartialVelocities(std::vector<std::pair<int, dReal>
 
 int KinBody::Joint::_Eval(int axis, uint32_t timederiv, const std::vector<dReal>& vdependentvalues, std::vector<dReal>& voutput) const
 {
+    const Mimic& mimic = *_vmimic.at(axis);
     if( timederiv == 0 ) {
-        _vmimic.at(axis)->_posfn->EvalMulti(voutput, vdependentvalues.empty() ? NULL : &vdependentvalues[0]);
-        return _vmimic.at(axis)->_posfn->EvalError();
-    }
-    else if( timederiv == 1 ) {
-        voutput.resize(_vmimic.at(axis)->_velfns.size());
+        if( !mimic._vposcoeffs.empty() ) {
+            voutput.resize(1);
+            voutput[0] = EvalAffineEquation(mimic._vposcoeffs, vdependentvalues);
+            return 0;
+        }
+        mimic._posfn->EvalMulti(voutput, vdependentvalues.empty() ? NULL : &vdependentvalues[0]);
+        return mimic._posfn->EvalError();
+    }
+    else if( timederiv == 1 || timederiv == 2 ) {
+        const std::vector<OpenRAVEFunctionParserRealPtr>& vfns = timederiv == 1 ? mimic._velfns : mimic._accelfns;
+        const std::vector< std::vector<dReal> >& vcoeffs = timederiv == 1 ? mimic._vvelcoeffs : mimic._vaccelcoeffs;
+        voutput.resize(vfns.size());
         for(size_t i = 0; i < voutput.size(); ++i) {
-            voutput[i] = _vmimic.at(axis)->_velfns.at(i)->Eval(vdependentvalues.empty() ? NULL : &vdependentvalues[0]);
-            int err = _vmimic.at(axis)->_velfns.at(i)->EvalError();
-            if( err ) {
-                return err;
+            if( !vcoeffs.at(i).empty() ) {
+                voutput[i] = EvalAffineEquation(vcoeffs[i], vdependentvalues);
+                continue;
             }
-        }
-    }
-    else if( timederiv == 2 ) {
-        voutput.resize(_vmimic.at(axis)->_accelfns.size());
-        for(size_t i = 0; i < voutput.size(); ++i) {
-            voutput[i] = _vmimic.at(axis)->_accelfns.at(i)->Eval(vdependentvalues.empty() ? NULL : &vdependentvalues[0]);
-            int err = _vmimic.at(axis)->_accelfns.at(i)->EvalError();
+            voutput[i] = vfns[i]->Eval(vdependentvalues.empty() ? NULL : &vdependentvalues[0]);
+            int err = vfns[i]->EvalError();
             if( err ) {
                 return err;
             }
@@ -360,10 +360,13 @@ void KinBody::LinkInfo::DeserializeJSON(const rapidjson::Value &value, dReal fUn
 
 void KinBody::LinkInfo::_DeserializeReadableInterface(const std::string& id, const rapidjson::Value& rReadable, dReal fUnitScale) {
     std::map<std::string, ReadablePtr>::iterator itReadable = _mReadableInterfaces.find(id);
-    ReadablePtr pReadable;
-    if(itReadable != _mReadableInterfaces.end()) {
-        pReadable = itReadable->second;
+    if(itReadable == _mReadableInterfaces.end()) {
+        // most readables are never accessed, so only deserialize them when they are
+        _mReadableInterfaces[id].reset(new LazyJSONReadable(PT_KinBody, id, rReadable, fUnitScale));
+        return;
     }
+    // updating an existing readable, so the reader has to merge into it
+    ReadablePtr pReadable = LazyJSONReadable::Resolve(itReadable->second);
     // NOTE: we use PT_KinBody (for now) for the following reasons:
     // 1. Link shares the same set of readable plugins as KinBody
     // 2. It might be confusing to add PT_Link since it is not an interface type
@@ -697,7 +700,9 @@ void KinBody::Link::SetStatic(bool bStatic)
 void KinBody::Link::SetTransform(const Transform& t)
 {
     _info._t = t;
-    GetParent()->_nUpdateStampId++;
+    GetParent()->_IncrementUpdateStamp();
+    // the link might not be consistent with the dof values anymore, so the next SetDOFValues has to recompute all the links
+    GetParent()->_bForceFullKinematicsUpdate = true;
 }
 
 void KinBody::Link::SetForce(const Vector& force, const Vector& pos, bool bAdd)
@@ -1200,6 +1205,21 @@ UpdateFromInfoResult KinBody::Link::UpdateFromInfo(const KinBody::LinkInfo& info
 }
 
 void KinBody::Link::_Update(bool parameterschanged, uint32_t extraParametersChanged)
+{
+    ++_nGeometryShapeStamp;
+    _UpdateCollisionData();
+    if( parameterschanged || extraParametersChanged ) {
+        GetParent()->_PostprocessChangedParameters(Prop_LinkGeometry|extraParametersChanged);
+    }
+}
+
+void KinBody::Link::_UpdateGeometryTransforms()
+{
+    _UpdateCollisionData();
+    GetParent()->_PostprocessChangedParameters(Prop_LinkGeometry);
+}
+
+void KinBody::Link::_UpdateCollisionData()
 {
     // if there's only one trimesh geometry and it has identity offset, then copy it directly
     if( _vGeometries.size() == 1 && _vGeometries.at(0)->GetType() == GT_TriMesh && TransformDistanceFast(Transform(), _vGeometries.at(0)->GetTransform()) <= g_fEpsilonLinear ) {
@@ -1226,9 +1246,6 @@ void KinBody::Link::_Update(bool parameterschanged, uint32_t extraParametersChan
             _collision.Append((*itgeom)->GetCollisionMesh(),(*itgeom)->GetTransform());
         }
     }
-    if( parameterschanged || extraParametersChanged ) {
-        GetParent()->_PostprocessChangedParameters(Prop_LinkGeometry|extraParametersChanged);
-    }
 }
 
 }
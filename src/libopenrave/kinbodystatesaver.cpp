@@ -382,4 +382,143 @@ void KinBody::KinBodyStateSaverRef::_RestoreKinBody(KinBody& body)
     }
 }
 
+KinBody::ReusableKinBodyStateSaver::ReusableKinBodyStateSaver() : _pbody(nullptr), _options(0)
+{
+}
+
+KinBody::ReusableKinBodyStateSaver::~ReusableKinBodyStateSaver()
+{
+}
+
+void KinBody::ReusableKinBodyStateSaver::Save(KinBody& body, int options)
+{
+    // all the getters resize the buffers, so the memory of the previous save is reused
+    _pbody = &body;
+    _options = options;
+    if( _options & Save_LinkTransformation ) {
+        body.GetLinkTransformations(_vLinkTransforms, _vdoflastsetvalues);
+    }
+    if( _options & Save_LinkEnable ) {
+        _vEnabledLinks.resize(body._veclinks.size());
+        for(size_t i = 0; i < _vEnabledLinks.size(); ++i) {
+            _vEnabledLinks[i] = body._veclinks[i]->_info._bIsEnabled;
+        }
+    }
+    if( _options & Save_LinkVelocities ) {
+        body.GetLinkVelocities(_vLinkVelocities);
+    }
+    if( _options & Save_JointMaxVelocityAndAcceleration ) {
+        body.GetDOFVelocityLimits(_vMaxVelocities);
+        body.GetDOFAccelerationLimits(_vMaxAccelerations);
+        body.GetDOFJerkLimits(_vMaxJerks);
+    }
+    if( _options & Save_JointWeights ) {
+        body.GetDOFWeights(_vDOFWeights);
+    }
+    if( _options & Save_JointLimits ) {
+        body.GetDOFLimits(_vDOFLimits[0], _vDOFLimits[1]);
+    }
+    if( _options & Save_JointResolutions ) {
+        body.GetDOFResolutions(_vDOFResolutions);
+    }
+    if( _options & Save_GrabbedBodies ) {
+        _vGrabbedBodies = body._vGrabbedBodies;
+    }
+    else {
+        // do not keep the grabbed bodies alive
+        _vGrabbedBodies.clear();
+    }
+}
+
+void KinBody::ReusableKinBodyStateSaver::Restore()
+{
+    if( !_pbody ) {
+        return;
+    }
+    KinBody& body = *_pbody;
+    if( body.GetEnvironmentBodyIndex() == 0 ) {
+        RAVELOG_WARN_FORMAT("env=%s, body %s not added to environment, skipping restore", body.GetEnv()->GetNameId()%body.GetName());
+        return;
+    }
+    if( _options & Save_JointLimits ) {
+        body.SetDOFLimits(_vDOFLimits[0], _vDOFLimits[1]);
+    }
+    // restoring grabbed bodies has to happen first before link transforms can be restored since _UpdateGrabbedBodies can be called with the old grabbed bodies.
+    if( (_options & Save_GrabbedBodies) && body._vGrabbedBodies != _vGrabbedBodies ) {
+        body.ReleaseAllGrabbed();
+        OPENRAVE_ASSERT_OP(body._vGrabbedBodies.size(),==,0);
+        for (const GrabbedPtr& pGrabbed : _vGrabbedBodies) {
+            KinBodyPtr pGrabbedBody = pGrabbed->_pGrabbedBody.lock();
+            if( !!pGrabbedBody ) {
+                body._AttachBody(pGrabbedBody);
+                body._vGrabbedBodies.push_back(pGrabbed);
+                // grabbed bodies could have been removed from env and self collision checker.
+                CollisionCheckerBasePtr collisionchecker = body.GetSelfCollisionChecker();
+                if (!!collisionchecker) {
+                    collisionchecker->InitKinBody(pGrabbedBody);
+                }
+            }
+        }
+    }
+    if( _options & Save_LinkTransformation ) {
+        OPENRAVE_ASSERT_OP_FORMAT(_vLinkTransforms.size(), ==, body._veclinks.size(), "env=%s, body %s changed its links since the state was saved", body.GetEnv()->GetNameId()%body.GetName(), ORE_InvalidState);
+        // copy the poses directly into the links, the transforms are plain arrays of dReal so comparing the bytes is enough to detect a change
+        bool bchanged = false;
+        for(size_t ilink = 0; ilink < _vLinkTransforms.size(); ++ilink) {
+            Transform& tlink = body._veclinks[ilink]->_info._t;
+            if( memcmp(&tlink, &_vLinkTransforms[ilink], sizeof(Transform)) != 0 ) {
+                tlink = _vLinkTransforms[ilink];
+                bchanged = true;
+            }
+        }
+        FOREACHC(itjoint, body._vecjoints) {
+            for(int i = 0; i < (*itjoint)->GetDOF(); ++i) {
+                (*itjoint)->_doflastsetvalues[i] = _vdoflastsetvalues.at((*itjoint)->GetDOFIndex()+i);
+            }
+        }
+        // the grabbed bodies could have been moved even if the links were not
+        body._UpdateGrabbedBodies();
+        if( bchanged ) {
+            body._PostprocessChangedParameters(Prop_LinkTransforms);
+        }
+    }
+    else if( _options & Save_GrabbedBodies ) {
+        body._UpdateGrabbedBodies();
+    }
+    if( _options & Save_LinkEnable ) {
+        // should first enable before calling the parameter callbacks
+        bool bchanged = false;
+        for(size_t i = 0; i < _vEnabledLinks.size(); ++i) {
+            if( body._veclinks.at(i)->_info._bIsEnabled != !!_vEnabledLinks[i] ) {
+                body._veclinks.at(i)->_Enable(!!_vEnabledLinks[i]);
+                bchanged = true;
+            }
+        }
+        if( bchanged ) {
+            body._nNonAdjacentLinkCache &= ~AO_Enabled;
+            body._PostprocessChangedParameters(Prop_LinkEnable);
+        }
+    }
+    if( _options & Save_JointMaxVelocityAndAcceleration ) {
+        body.SetDOFVelocityLimits(_vMaxVelocities);
+        body.SetDOFAccelerationLimits(_vMaxAccelerations);
+        body.SetDOFJerkLimits(_vMaxJerks);
+    }
+    if( _options & Save_LinkVelocities ) {
+        body.SetLinkVelocities(_vLinkVelocities);
+    }
+    if( _options & Save_JointWeights ) {
+        body.SetDOFWeights(_vDOFWeights);
+    }
+    if( _options & Save_JointResolutions ) {
+        body.SetDOFResolutions(_vDOFResolutions);
+    }
+}
+
+void KinBody::ReusableKinBodyStateSaver::Release()
+{
+    _pbody = nullptr;
+    _vGrabbedBodies.clear();
+}
+
 } // end namespace OpenRAVE
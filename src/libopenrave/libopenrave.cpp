@@ -16,11 +16,15 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "libopenrave.h"
 
+#include <boost/functional/hash.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/utility.hpp>
 
+#include <atomic>
 #include <mutex>
+#include <memory>
 #include <streambuf>
+#include <unordered_map>
 
 #ifndef _WIN32
 #include <sys/stat.h>
@@ -344,6 +348,7 @@ dReal RaveCeil(dReal f) {
 
 static std::set<std::string> _gettextDomainsInitialized;
 static std::once_flag _onceRaveInitialize;
+static std::atomic<uint64_t> s_nReaderRegistrationStamp(0); ///< incremented every time an xml or json reader is registered
 
 /// there is only once global openrave state. It is created when openrave
 /// is first used, and destroyed when the program quits or RaveDestroy is called.
@@ -424,7 +429,11 @@ public:
             return 0;     // already initialized
         }
 
-        _InitializeLogging(level);
+        utils::StartupTraceScope tracescope("startup", "RaveInitialize");
+        {
+            utils::StartupTraceScope tracescopelogging("startup", "logging");
+            _InitializeLogging(level);
+        }
 
 #ifdef USE_CRLIBM
         if( !_bcrlibmInit ) {
@@ -432,26 +441,21 @@ public:
             _bcrlibmInit = true;
         }
 #endif
-        try {
-            // TODO: eventually we should remove this call to set global locale for the process
-            // and imbue each stringstream with the correct locale.
-
-            // set to the classic locale so that number serialization/hashing works correctly
-            // std::locale::global(std::locale::classic());
-            std::locale::global(std::locale(std::locale(""), std::locale::classic(), std::locale::numeric));
-        }
-        catch(const std::runtime_error& e) {
-            RAVELOG_WARN("failed to set to C locale: %s\n",e.what());
+        {
+            utils::StartupTraceScope tracescopelocale("startup", "locale");
+            try {
+                // TODO: eventually we should remove this call to set global locale for the process
+                // and imbue each stringstream with the correct locale.
+
+                // set to the classic locale so that number serialization/hashing works correctly
+                // std::locale::global(std::locale::classic());
+                std::locale::global(std::locale(std::locale(""), std::locale::classic(), std::locale::numeric));
+            }
+            catch(const std::runtime_error& e) {
+                RAVELOG_WARN("failed to set to C locale: %s\n",e.what());
+            }
         }
 
-        // since initialization depends on _pdatabase, have pdatabase be local until it is complete
-#if OPENRAVE_STATIC_PLUGINS
-        boost::shared_ptr<RaveDatabase> pdatabase = boost::make_shared<StaticRaveDatabase>();
-#else
-        boost::shared_ptr<RaveDatabase> pdatabase = boost::make_shared<DynamicRaveDatabase>();
-#endif // OPENRAVE_STATIC_PLUGINS
-        pdatabase->Init();
-
         char* phomedir = getenv("OPENRAVE_HOME"); // getenv not thread-safe?
         if( phomedir == NULL ) {
 #ifndef _WIN32
@@ -469,6 +473,17 @@ public:
         CreateDirectory(_homedirectory.c_str(),NULL);
 #endif
 
+        // since initialization depends on _pdatabase, have pdatabase be local until it is complete
+#if OPENRAVE_STATIC_PLUGINS
+        boost::shared_ptr<RaveDatabase> pdatabase = boost::make_shared<StaticRaveDatabase>();
+#else
+        boost::shared_ptr<RaveDatabase> pdatabase = boost::make_shared<DynamicRaveDatabase>(_homedirectory + s_filesep + "pluginmanifest.txt");
+#endif // OPENRAVE_STATIC_PLUGINS
+        {
+            utils::StartupTraceScope tracescopeplugins("startup", "plugin database");
+            pdatabase->Init();
+        }
+
 #ifdef _WIN32
         const char* delim = ";";
 #else
@@ -487,7 +502,22 @@ public:
             _defaultviewertype = std::string(pOPENRAVE_DEFAULT_VIEWER);
         }
 
-        _UpdateDataDirs();
+        _tracefilename.clear();
+        const char* pOPENRAVE_TRACE = std::getenv("OPENRAVE_TRACE");
+        if( !!pOPENRAVE_TRACE && strlen(pOPENRAVE_TRACE) > 0 ) {
+            _tracefilename = std::string(pOPENRAVE_TRACE);
+            RaveSetTracing(true);
+        }
+
+        const char* pOPENRAVE_LOG_HISTORY = std::getenv("OPENRAVE_LOG_HISTORY");
+        if( !!pOPENRAVE_LOG_HISTORY && strlen(pOPENRAVE_LOG_HISTORY) > 0 ) {
+            RaveSetLogHistory(strtoul(pOPENRAVE_LOG_HISTORY, NULL, 10));
+        }
+
+        {
+            utils::StartupTraceScope tracescopedata("startup", "data directories");
+            _UpdateDataDirs();
+        }
         _pdatabase = pdatabase; // finally initialize!
         return 0;
     }
@@ -514,6 +544,16 @@ public:
         mapenvironments.clear();
         _mapenvironments.clear();
         _pdefaultsampler.reset();
+
+        // the queued tasks can still use the plugins, so finish them before the plugins are unloaded
+        TaskSchedulerPtr ptaskscheduler;
+        {
+            std::lock_guard<std::mutex> lock(_mutexinternal);
+            ptaskscheduler.swap(_ptaskscheduler);
+        }
+        if( !!ptaskscheduler ) {
+            ShutdownTaskScheduler(ptaskscheduler);
+        }
         _mapxmlreaders.clear();
         _mapjsonreaders.clear();
 
@@ -533,6 +573,16 @@ public:
             _pdatabase->Destroy();
             _pdatabase.reset();
         }
+
+        WriteStartupTrace();
+        if( _tracefilename.size() > 0 ) {
+            RaveSetTracing(false);
+            std::ofstream ftrace(_tracefilename.c_str());
+            if( !!ftrace ) {
+                RaveWriteTrace(ftrace);
+            }
+            _tracefilename.clear();
+        }
 #ifdef USE_CRLIBM
 
 #ifdef HAS_FENV_H
@@ -560,6 +610,38 @@ public:
         return _homedirectory;
     }
 
+    TaskSchedulerPtr GetTaskScheduler()
+    {
+        std::lock_guard<std::mutex> lock(_mutexinternal);
+        if( !_ptaskscheduler ) {
+            int numThreads = -1;
+            const char* pOPENRAVE_TASK_THREADS = std::getenv("OPENRAVE_TASK_THREADS");
+            if( !!pOPENRAVE_TASK_THREADS && *pOPENRAVE_TASK_THREADS != 0 ) {
+                numThreads = std::atoi(pOPENRAVE_TASK_THREADS);
+            }
+            if( _bTaskThreadsSet ) {
+                numThreads = _numTaskThreads;
+            }
+            _ptaskscheduler = CreateTaskScheduler(numThreads);
+        }
+        return _ptaskscheduler;
+    }
+
+    void SetTaskSchedulerNumThreads(int numThreads)
+    {
+        TaskSchedulerPtr pprevious;
+        {
+            std::lock_guard<std::mutex> lock(_mutexinternal);
+            _numTaskThreads = numThreads;
+            _bTaskThreadsSet = true;
+            pprevious.swap(_ptaskscheduler);
+        }
+        // the next GetTaskScheduler creates the new workers, the groups holding the previous scheduler run their remaining tasks themselves
+        if( !!pprevious ) {
+            ShutdownTaskScheduler(pprevious);
+        }
+    }
+
     std::string FindDatabaseFile(const std::string& filename, bool bRead)
     {
         FOREACH(itdirectory,_vdbdirectories) {
@@ -643,6 +725,7 @@ public:
             std::lock_guard<std::mutex> lock(global->_mutexinternal);
             _oldfn = global->_mapxmlreaders[_type][_xmltag];
             global->_mapxmlreaders[_type][_xmltag] = fn;
+            ++s_nReaderRegistrationStamp;
         }
         virtual ~XMLReaderFunctionData()
         {
@@ -682,6 +765,7 @@ public:
             std::lock_guard<std::mutex> lock(global->_mutexinternal);
             _oldfn = global->_mapjsonreaders[_type][_id];
             global->_mapjsonreaders[_type][_id] = fn;
+            ++s_nReaderRegistrationStamp;
         }
         virtual ~JSONReaderFunctionData()
         {
@@ -1101,8 +1185,12 @@ private:
     std::map<IkParameterizationType,string> _mapikparameterization, _mapikparameterizationlower;
     std::map<int, EnvironmentBase*> _mapenvironments;
     std::list<boost::function<void()> > _listDestroyCallbacks;
+    TaskSchedulerPtr _ptaskscheduler; ///< shared by all the parallel features, created at the first use. protected by _mutexinternal
+    int _numTaskThreads = -1; ///< workers of the scheduler set with RaveSetTaskSchedulerNumThreads
+    bool _bTaskThreadsSet = false; ///< true if _numTaskThreads overrides the OPENRAVE_TASK_THREADS environment variable
     std::string _homedirectory;
     std::string _defaultviewertype; ///< the default viewer type from the environment variable OPENRAVE_DEFAULT_VIEWER
+    std::string _tracefilename; ///< file to write the trace to on Destroy, from the environment variable OPENRAVE_TRACE
     std::vector<std::string> _vdbdirectories;
     int _nGlobalEnvironmentId;
     SpaceSamplerBasePtr _pdefaultsampler;
@@ -1228,6 +1316,21 @@ void RaveAddCallbackForDestroy(const boost::function<void()>& fn)
     RaveGlobal::instance()->AddCallbackForDestroy(fn);
 }
 
+TaskSchedulerPtr RaveGetTaskScheduler()
+{
+    return RaveGlobal::instance()->GetTaskScheduler();
+}
+
+void RaveSetTaskSchedulerNumThreads(int numThreads)
+{
+    RaveGlobal::instance()->SetTaskSchedulerNumThreads(numThreads);
+}
+
+int RaveGetTaskSchedulerNumThreads()
+{
+    return GetTaskSchedulerNumThreads(RaveGlobal::instance()->GetTaskScheduler());
+}
+
 int RaveGetEnvironmentId(EnvironmentBaseConstPtr penv)
 {
     return RaveGlobal::instance()->GetEnvironmentId(penv);
@@ -1387,6 +1490,11 @@ UserDataPtr RaveRegisterJSONReader(InterfaceType type, const std::string& id, co
     return RaveGlobal::instance()->RegisterJSONReader(type,id,fn);
 }
 
+uint64_t RaveGetReaderRegistrationStamp()
+{
+    return s_nReaderRegistrationStamp;
+}
+
 BaseXMLReaderPtr RaveCallXMLReader(InterfaceType type, const std::string& xmltag, InterfaceBasePtr pinterface, const AttributesList& atts)
 {
     return RaveGlobal::instance()->CallXMLReader(type,xmltag,pinterface,atts);
@@ -2095,16 +2203,141 @@ AABB TriMesh::ComputeAABB() const
     return ab;
 }
 
+/// \brief true if the stream formats numbers exactly like _FormatSerializationValue and _FormatSerializationIndex
+static bool _HasSerializationNumberFormat(const std::ostream& o)
+{
+    const std::ios_base::fmtflags numberflags = std::ios_base::floatfield|std::ios_base::basefield|std::ios_base::showpos|std::ios_base::showpoint|std::ios_base::uppercase;
+    if( (o.flags() & numberflags) != (std::ios_base::fixed|std::ios_base::dec) || o.precision() != SERIALIZATION_PRECISION || o.width() != 0 ) {
+        return false;
+    }
+    const std::numpunct<char>& punct = std::use_facet< std::numpunct<char> >(o.getloc());
+    return punct.decimal_point() == '.' && punct.grouping().empty();
+}
+
+/// \brief writes f followed by a space to pbuffer like a stream with std::fixed and precision SERIALIZATION_PRECISION would, including round half to even
+///
+/// \param f the value returned by SerializationValue
+/// \return the number of characters written, or 0 if f should be written through the stream
+static int _FormatSerializationValue(double f, char* pbuffer)
+{
+#if defined(__SIZEOF_INT128__) && SERIALIZATION_PRECISION == 4
+    if( !(RaveFabs(f) < 1e14) ) {
+        return 0; // large, inf or nan
+    }
+    // f = m*2^exponent exactly with m integer
+    int exponent = 0;
+    const uint64_t m = static_cast<uint64_t>(ldexp(frexp(RaveFabs(f), &exponent), 53));
+    exponent -= 53;
+    const unsigned __int128 scaled = static_cast<unsigned __int128>(m)*10000;
+    uint64_t q = 0; // round(|f|*10000)
+    if( exponent >= 0 ) {
+        q = static_cast<uint64_t>(scaled << exponent);
+    }
+    else if( exponent > -120 ) {
+        const int shift = -exponent;
+        q = static_cast<uint64_t>(scaled >> shift);
+        const unsigned __int128 remainder = scaled - (static_cast<unsigned __int128>(q) << shift);
+        const unsigned __int128 half = static_cast<unsigned __int128>(1) << (shift-1);
+        if( remainder > half || (remainder == half && (q & 1)) ) {
+            ++q;
+        }
+    }
+    if( q == 0 && f < 0 ) {
+        return 0; // the stream would write -0.0000
+    }
+
+    char digits[24];
+    int numdigits = 0;
+    for(uint64_t integerpart = q/10000; numdigits == 0 || integerpart > 0; integerpart /= 10) {
+        digits[numdigits++] = '0' + static_cast<char>(integerpart%10);
+    }
+    char* p = pbuffer;
+    if( f < 0 ) {
+        *p++ = '-';
+    }
+    while( numdigits > 0 ) {
+        *p++ = digits[--numdigits];
+    }
+    const uint32_t fraction = static_cast<uint32_t>(q%10000);
+    *p++ = '.';
+    *p++ = '0' + fraction/1000;
+    *p++ = '0' + (fraction/100)%10;
+    *p++ = '0' + (fraction/10)%10;
+    *p++ = '0' + fraction%10;
+    *p++ = ' ';
+    return p - pbuffer;
+#else
+    return 0;
+#endif
+}
+
+/// \brief writes index followed by a space to pbuffer, returns the number of characters written
+static int _FormatSerializationIndex(int32_t index, char* pbuffer)
+{
+    char digits[12];
+    int numdigits = 0;
+    uint32_t value = index < 0 ? 0u - static_cast<uint32_t>(index) : static_cast<uint32_t>(index);
+    do {
+        digits[numdigits++] = '0' + static_cast<char>(value%10);
+        value /= 10;
+    } while( value > 0 );
+    char* p = pbuffer;
+    if( index < 0 ) {
+        *p++ = '-';
+    }
+    while( numdigits > 0 ) {
+        *p++ = digits[--numdigits];
+    }
+    *p++ = ' ';
+    return p - pbuffer;
+}
+
 void TriMesh::serialize(std::ostream& o, int options) const
 {
     o << vertices.size() << " ";
+    if( !_HasSerializationNumberFormat(o) ) {
+        FOREACHC(it,vertices) {
+            SerializeRound3(o, *it);
+        }
+        o << indices.size() << " ";
+        FOREACHC(it,indices) {
+            o << *it << " ";
+        }
+        return;
+    }
+
+    // formatting every number through the stream dominates the hashes of bodies with large meshes, so format them in blocks with the same output
+    char buffer[4096];
+    size_t buffersize = 0;
     FOREACHC(it,vertices) {
-        SerializeRound3(o, *it);
+        if( buffersize + 3*64 > sizeof(buffer) ) {
+            o.write(buffer, buffersize);
+            buffersize = 0;
+        }
+        for(int i = 0; i < 3; ++i) {
+            const dReal f = SerializationValue((*it)[i]);
+            const int numchars = _FormatSerializationValue(f, buffer + buffersize);
+            if( numchars > 0 ) {
+                buffersize += numchars;
+            }
+            else {
+                o.write(buffer, buffersize);
+                buffersize = 0;
+                o << f << " ";
+            }
+        }
     }
+    o.write(buffer, buffersize);
+    buffersize = 0;
     o << indices.size() << " ";
     FOREACHC(it,indices) {
-        o << *it << " ";
+        if( buffersize + 16 > sizeof(buffer) ) {
+            o.write(buffer, buffersize);
+            buffersize = 0;
+        }
+        buffersize += _FormatSerializationIndex(*it, buffer + buffersize);
     }
+    o.write(buffer, buffersize);
 }
 
 void TriMesh::SerializeJSON(rapidjson::Value& rTriMesh, rapidjson::Document::AllocatorType& allocator, dReal fUnitScale, int options) const
@@ -2152,6 +2385,204 @@ std::istream& operator>>(std::istream& I, TriMesh& trimesh)
     return I;
 }
 
+namespace {
+
+/// \brief weak references to all the alive TriMeshCompact instances, by hash
+class TriMeshCompactPool
+{
+public:
+    TriMeshCompactConstPtr Find(const TriMeshCompact& mesh)
+    {
+        std::pair<MeshMap::iterator, MeshMap::iterator> range = _mapMeshes.equal_range(mesh.GetHash());
+        for(MeshMap::iterator it = range.first; it != range.second; ) {
+            TriMeshCompactConstPtr pmesh = it->second.lock();
+            if( !pmesh ) {
+                it = _mapMeshes.erase(it);
+                continue;
+            }
+            if( *pmesh == mesh ) {
+                return pmesh;
+            }
+            ++it;
+        }
+        return TriMeshCompactConstPtr();
+    }
+
+    void Insert(const TriMeshCompactConstPtr& pmesh)
+    {
+        // the buckets of meshes that are never created again are not visited by Find, so sweep all the expired entries once in a while
+        if( _mapMeshes.size() >= _nextsweepsize ) {
+            for(MeshMap::iterator it = _mapMeshes.begin(); it != _mapMeshes.end(); ) {
+                if( it->second.expired() ) {
+                    it = _mapMeshes.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+            _nextsweepsize = std::max((size_t)256, 2*_mapMeshes.size());
+        }
+        _mapMeshes.insert(std::make_pair(pmesh->GetHash(), boost::weak_ptr<TriMeshCompact const>(pmesh)));
+    }
+
+    size_t GetNumMeshes() const
+    {
+        size_t nummeshes = 0;
+        FOREACHC(it, _mapMeshes) {
+            if( !it->second.expired() ) {
+                ++nummeshes;
+            }
+        }
+        return nummeshes;
+    }
+
+    std::mutex _mutex;
+
+private:
+    typedef std::unordered_multimap<size_t, boost::weak_ptr<TriMeshCompact const> > MeshMap;
+    MeshMap _mapMeshes;
+    size_t _nextsweepsize = 256;
+};
+
+static TriMeshCompactPool& _GetTriMeshCompactPool()
+{
+    static TriMeshCompactPool s_pool;
+    return s_pool;
+}
+
+} // end namespace
+
+TriMeshCompact::TriMeshCompact() : _hash(0)
+{
+}
+
+TriMeshCompactConstPtr TriMeshCompact::Create(const TriMesh& mesh)
+{
+    boost::shared_ptr<TriMeshCompact> pnewmesh(new TriMeshCompact());
+    pnewmesh->_vertices.resize(3*mesh.vertices.size());
+    float* pvertex = pnewmesh->_vertices.empty() ? NULL : &pnewmesh->_vertices[0];
+    FOREACHC(itvertex, mesh.vertices) {
+        *pvertex++ = (float)itvertex->x;
+        *pvertex++ = (float)itvertex->y;
+        *pvertex++ = (float)itvertex->z;
+    }
+    bool bIndices16 = true;
+    FOREACHC(itindex, mesh.indices) {
+        if( *itindex < 0 || *itindex > 0xffff ) {
+            bIndices16 = false;
+            break;
+        }
+    }
+    size_t hash = boost::hash_range(pnewmesh->_vertices.begin(), pnewmesh->_vertices.end());
+    if( bIndices16 ) {
+        pnewmesh->_indices16.assign(mesh.indices.begin(), mesh.indices.end());
+        boost::hash_combine(hash, boost::hash_range(pnewmesh->_indices16.begin(), pnewmesh->_indices16.end()));
+    }
+    else {
+        pnewmesh->_indices32.assign(mesh.indices.begin(), mesh.indices.end());
+        boost::hash_combine(hash, boost::hash_range(pnewmesh->_indices32.begin(), pnewmesh->_indices32.end()));
+    }
+    pnewmesh->_hash = hash;
+
+    TriMeshCompactPool& pool = _GetTriMeshCompactPool();
+    std::lock_guard<std::mutex> lock(pool._mutex);
+    TriMeshCompactConstPtr pmesh = pool.Find(*pnewmesh);
+    if( !pmesh ) {
+        pmesh = pnewmesh;
+        pool.Insert(pmesh);
+    }
+    return pmesh;
+}
+
+size_t TriMeshCompact::GetNumSharedMeshes()
+{
+    TriMeshCompactPool& pool = _GetTriMeshCompactPool();
+    std::lock_guard<std::mutex> lock(pool._mutex);
+    return pool.GetNumMeshes();
+}
+
+void TriMeshCompact::GetTriMesh(TriMesh& mesh) const
+{
+    mesh.vertices.resize(GetNumVertices());
+    const float* pvertex = GetVertices();
+    FOREACH(itvertex, mesh.vertices) {
+        itvertex->x = pvertex[0];
+        itvertex->y = pvertex[1];
+        itvertex->z = pvertex[2];
+        itvertex->w = 0;
+        pvertex += 3;
+    }
+    if( _indices32.empty() ) {
+        mesh.indices.assign(_indices16.begin(), _indices16.end());
+    }
+    else {
+        mesh.indices.assign(_indices32.begin(), _indices32.end());
+    }
+}
+
+AABB TriMeshCompact::ComputeAABB() const
+{
+    AABB ab;
+    if( _vertices.empty() ) {
+        return ab;
+    }
+    float vmin[3] = { _vertices[0], _vertices[1], _vertices[2] }, vmax[3] = { _vertices[0], _vertices[1], _vertices[2] };
+    for(size_t i = 3; i < _vertices.size(); i += 3) {
+        for(int idim = 0; idim < 3; ++idim) {
+            vmin[idim] = std::min(vmin[idim], _vertices[i+idim]);
+            vmax[idim] = std::max(vmax[idim], _vertices[i+idim]);
+        }
+    }
+    ab.pos = Vector(0.5*((dReal)vmin[0]+vmax[0]), 0.5*((dReal)vmin[1]+vmax[1]), 0.5*((dReal)vmin[2]+vmax[2]));
+    ab.extents = Vector(0.5*((dReal)vmax[0]-vmin[0]), 0.5*((dReal)vmax[1]-vmin[1]), 0.5*((dReal)vmax[2]-vmin[2]));
+    return ab;
+}
+
+size_t TriMeshCompact::GetMemoryUsage() const
+{
+    return sizeof(TriMeshCompact) + _vertices.capacity()*sizeof(float) + _indices16.capacity()*sizeof(uint16_t) + _indices32.capacity()*sizeof(uint32_t);
+}
+
+MemoryUsage& MemoryUsage::AddChild(const std::string& name, const std::string& type)
+{
+    listChildren.push_back(MemoryUsage(name, type));
+    return listChildren.back();
+}
+
+uint64_t MemoryUsage::GetTotal(bool bIncludeShared) const
+{
+    uint64_t total = 0;
+    FOREACHC(itcategory, mapCategoryBytes) {
+        if( bIncludeShared || itcategory->first.compare(0, 6, "shared") != 0 ) {
+            total += itcategory->second;
+        }
+    }
+    FOREACHC(itchild, listChildren) {
+        total += itchild->GetTotal(bIncludeShared);
+    }
+    return total;
+}
+
+void MemoryUsage::SerializeJSON(rapidjson::Value& rMemoryUsage, rapidjson::Document::AllocatorType& allocator, int options) const
+{
+    rMemoryUsage.SetObject();
+    orjson::SetJsonValueByKey(rMemoryUsage, "name", name, allocator);
+    orjson::SetJsonValueByKey(rMemoryUsage, "type", type, allocator);
+    orjson::SetJsonValueByKey(rMemoryUsage, "total", GetTotal(), allocator);
+    orjson::SetJsonValueByKey(rMemoryUsage, "categories", mapCategoryBytes, allocator);
+    if( !listChildren.empty() ) {
+        rapidjson::Value rChildren;
+        rChildren.SetArray();
+        rChildren.Reserve(listChildren.size(), allocator);
+        FOREACHC(itchild, listChildren) {
+            rapidjson::Value rChild;
+            itchild->SerializeJSON(rChild, allocator, options);
+            rChildren.PushBack(rChild, allocator);
+        }
+        rMemoryUsage.AddMember("children", rChildren, allocator);
+    }
+}
+
 
 // Dummy Reader
 DummyXMLReader::DummyXMLReader(const std::string& fieldname, const std::string& pparentname, boost::shared_ptr<std::ostream> osrecord) : _fieldname(fieldname), _osrecord(osrecord)
@@ -2256,6 +2687,50 @@ void EnvironmentBase::Add(InterfaceBasePtr pinterface, bool bAnonymous, const st
     Add(pinterface, bAnonymous ? IAM_AllowRenaming : IAM_StrictNameChecking, cmdargs);
 }
 
+namespace {
+
+/// \brief coalescer that keeps its body alive until the coalescer is destroyed
+class BodyChangeCallbackCoalescer
+{
+public:
+    BodyChangeCallbackCoalescer(KinBodyPtr pbody) : _pbody(pbody), _pcoalescer(new KinBody::ChangeCallbackCoalescer(*pbody)) {
+    }
+    ~BodyChangeCallbackCoalescer() {
+        // the coalescer calls the callbacks of the body when destroyed, so the body cannot be released before it
+        _pcoalescer.reset();
+        _pbody.reset();
+    }
+protected:
+    KinBodyPtr _pbody;
+    std::unique_ptr<KinBody::ChangeCallbackCoalescer> _pcoalescer;
+};
+
+}
+
+EnvironmentBase::BatchUpdateScope::BatchUpdateScope(EnvironmentBasePtr penv)
+{
+    std::vector<KinBodyPtr> vbodies;
+    penv->GetBodies(vbodies);
+    _vcoalescers.reserve(vbodies.size());
+    FOREACH(itbody, vbodies) {
+        _vcoalescers.push_back(boost::shared_ptr<void>(new BodyChangeCallbackCoalescer(*itbody)));
+    }
+}
+
+EnvironmentBase::BatchUpdateScope::~BatchUpdateScope()
+{
+    _vcoalescers.clear();
+}
+
+SensorBase::SensorDataConstPtr SensorBase::GetLatestSensorData(SensorType type)
+{
+    SensorDataPtr pdata = CreateSensorData(type);
+    if( !pdata || !GetSensorData(pdata) ) {
+        return SensorDataConstPtr();
+    }
+    return pdata;
+}
+
 bool SensorBase::SensorData::serialize(std::ostream& O) const
 {
     RAVELOG_WARN("SensorData XML serialization not implemented\n");
@@ -2763,6 +3238,120 @@ bool StringReadable::DeserializeJSON(const rapidjson::Value& value, dReal fUnitS
     return true;
 }
 
+LazyJSONReadable::LazyJSONReadable(InterfaceType type, const std::string& id, const rapidjson::Value& rReadable, dReal fUnitScale) : Readable(id), _type(type), _fUnitScale(fUnitScale), _bFailedToDeserialize(false)
+{
+    // a compact string is much smaller than a rapidjson document
+    _json = orjson::DumpJson(rReadable);
+}
+
+LazyJSONReadable::LazyJSONReadable(InterfaceType type, const std::string& id, const std::string& json, dReal fUnitScale) : Readable(id), _type(type), _fUnitScale(fUnitScale), _json(json), _bFailedToDeserialize(false)
+{
+}
+
+LazyJSONReadable::~LazyJSONReadable()
+{
+}
+
+ReadablePtr LazyJSONReadable::GetReadable() const
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    if( !!_pReadable || _bFailedToDeserialize ) {
+        return _pReadable;
+    }
+    rapidjson::Document rReadable;
+    orjson::ParseJson(rReadable, _json);
+    BaseJSONReaderPtr pReader = RaveCallJSONReader(_type, GetXMLId(), ReadablePtr(), AttributesList());
+    if( !!pReader ) {
+        pReader->DeserializeJSON(rReadable, _fUnitScale);
+        _pReadable = pReader->GetReadable();
+    }
+    else if( rReadable.IsString() ) {
+        _pReadable.reset(new StringReadable(GetXMLId(), rReadable.GetString()));
+    }
+    if( !_pReadable ) {
+        RAVELOG_WARN_FORMAT("deserialize readable interface '%s' failed, perhaps need to call 'RaveRegisterJSONReader' with the appropriate reader.", GetXMLId());
+        _bFailedToDeserialize = true;
+        return _pReadable;
+    }
+    std::string().swap(_json);
+    return _pReadable;
+}
+
+bool LazyJSONReadable::IsDeserialized() const
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    return !!_pReadable;
+}
+
+size_t LazyJSONReadable::GetJSONSize() const
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    return _json.capacity();
+}
+
+ReadablePtr LazyJSONReadable::Resolve(const ReadablePtr& readable)
+{
+    const LazyJSONReadable* plazy = dynamic_cast<const LazyJSONReadable*>(readable.get());
+    return !plazy ? readable : plazy->GetReadable();
+}
+
+bool LazyJSONReadable::SerializeXML(BaseXMLWriterPtr writer, int options) const
+{
+    ReadablePtr pReadable = GetReadable();
+    return !!pReadable && pReadable->SerializeXML(writer, options);
+}
+
+bool LazyJSONReadable::SerializeJSON(rapidjson::Value& value, rapidjson::Document::AllocatorType& allocator, dReal fUnitScale, int options) const
+{
+    ReadablePtr pReadable = GetReadable();
+    if( !!pReadable ) {
+        return pReadable->SerializeJSON(value, allocator, fUnitScale, options);
+    }
+    // nothing can interpret the readable, so keep it as it was loaded
+    boost::mutex::scoped_lock lock(_mutex);
+    rapidjson::Document rReadable;
+    orjson::ParseJson(rReadable, _json);
+    value.CopyFrom(rReadable, allocator);
+    return true;
+}
+
+bool LazyJSONReadable::operator==(const Readable& other) const
+{
+    if( GetXMLId() != other.GetXMLId() ) {
+        return false;
+    }
+    const LazyJSONReadable* pOther = dynamic_cast<const LazyJSONReadable*>(&other);
+    if( pOther == this ) {
+        return true;
+    }
+    if( !!pOther ) {
+        boost::unique_lock<boost::mutex> lock(_mutex, boost::defer_lock), lockother(pOther->_mutex, boost::defer_lock);
+        boost::lock(lock, lockother);
+        if( !_pReadable && !pOther->_pReadable ) {
+            // neither is deserialized, so compare what they were loaded from
+            return _type == pOther->_type && _fUnitScale == pOther->_fUnitScale && _json == pOther->_json;
+        }
+    }
+    ReadablePtr pReadable = GetReadable();
+    if( !pReadable ) {
+        return false;
+    }
+    if( !!pOther ) {
+        ReadablePtr pOtherReadable = pOther->GetReadable();
+        return !!pOtherReadable && *pReadable == *pOtherReadable;
+    }
+    return *pReadable == other;
+}
+
+ReadablePtr LazyJSONReadable::CloneSelf() const
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    if( !!_pReadable ) {
+        return _pReadable->CloneSelf();
+    }
+    return ReadablePtr(new LazyJSONReadable(_type, GetXMLId(), _json, _fUnitScale));
+}
+
 int64_t ConvertIsoFormatDateTimeToLinuxTimeUS(const char* pIsoFormatDateTime)
 {
     if (pIsoFormatDateTime == nullptr) {
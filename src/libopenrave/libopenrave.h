@@ -135,6 +135,8 @@ inline path absolute(const path& p, const path& base)
 
 #endif
 
+struct md5_state_s; // defined in md5.h
+
 namespace OpenRAVE {
 
 static const dReal g_fEpsilonLinear = RavePow(g_fEpsilon,0.9);
@@ -187,6 +189,31 @@ private:
     boost::function<void()> _fn;
 };
 
+/// \brief stream buffer that md5-hashes the characters written to it instead of storing them
+///
+/// Used to hash the serialization of bodies without building the serialized string, which can be large for bodies with meshes.
+class MD5HashStreamBuffer : public std::streambuf
+{
+public:
+    MD5HashStreamBuffer();
+    virtual ~MD5HashStreamBuffer();
+
+    /// \brief returns the same string as utils::GetMD5HashString on all the characters written so far, empty if nothing was written
+    std::string GetHashString();
+
+protected:
+    int_type overflow(int_type c) override;
+    int sync() override;
+
+private:
+    /// \brief appends the buffered characters to the hash
+    void _Flush();
+
+    boost::shared_ptr< ::md5_state_s > _pstate;
+    uint64_t _numhashed; ///< number of characters appended to _pstate
+    char _buffer[4096];
+};
+
 #define SERIALIZATION_PRECISION 4
 template<typename T>
 inline T SerializationValue(T f)
@@ -327,6 +354,22 @@ inline int CompareRealVectors(const std::vector<dReal> & v1, const std::vector<d
     return 0;
 }
 
+class TaskScheduler;
+typedef boost::shared_ptr<TaskScheduler> TaskSchedulerPtr;
+
+/// \brief creates a work-stealing scheduler, see taskscheduler.cpp
+///
+/// \param numThreads number of workers, negative for the number of cores minus one
+TaskSchedulerPtr CreateTaskScheduler(int numThreads);
+
+/// \brief runs the queued tasks and joins the workers, cannot be called from a task of the scheduler
+void ShutdownTaskScheduler(TaskSchedulerPtr pscheduler);
+
+int GetTaskSchedulerNumThreads(TaskSchedulerPtr pscheduler);
+
+/// \brief the scheduler of the global state, created at the first call
+TaskSchedulerPtr RaveGetTaskScheduler();
+
 template <typename IKReal>
 inline void polyroots2(const IKReal* rawcoeffs, IKReal* rawroots, int& numroots)
 {
@@ -673,6 +716,12 @@ inline void CopyRapidJsonDoc(const rapidjson::Value& source, rapidjson::Document
 
 OPENRAVE_API int64_t ConvertIsoFormatDateTimeToLinuxTimeUS(const char* pIsoFormatDateTime);
 
+/// \brief returns a stamp that changes every time an xml or json reader is registered. Used to detect the plugins that register readers when constructed.
+uint64_t RaveGetReaderRegistrationStamp();
+
+/// \brief writes the scopes recorded so far to the file named by OPENRAVE_STARTUP_TRACE if it is set, called by RaveDestroy
+void WriteStartupTrace();
+
 } // end OpenRAVE namespace
 
 // need the prototypes in order to keep them free of the OpenRAVE namespace
@@ -63,6 +63,12 @@ inline ModuleBasePtr GetModule(void* module)
     return RaveInterfaceCast<ModuleBase>(*static_cast<InterfaceBasePtr*>(module));
 }
 
+inline TrajectoryBasePtr GetTrajectory(void* traj)
+{
+    BOOST_ASSERT(!!traj);
+    return RaveInterfaceCast<TrajectoryBase>(*static_cast<InterfaceBasePtr*>(traj));
+}
+
 }
 
 extern "C" {
@@ -271,6 +277,94 @@ int ORCEnvironmentSetViewer(void* env, const char* viewername)
     return 1;
 }
 
+void ORCEnvironmentSetBodyTransforms(void* env, void** bodies, int numbodies, const dReal* poses)
+{
+    EnvironmentBasePtr penv = GetEnvironment(env);
+    EnvironmentLock lock(penv->GetMutex());
+    Transform t;
+    for(int ibody = 0; ibody < numbodies; ++ibody) {
+        const dReal* pose = poses + 7*ibody;
+        for(int i = 0; i < 4; ++i) {
+            t.rot[i] = pose[i];
+        }
+        for(int i = 0; i < 3; ++i) {
+            t.trans[i] = pose[4+i];
+        }
+        t.rot.normalize4();
+        GetBody(bodies[ibody])->SetTransform(t);
+    }
+}
+
+void ORCEnvironmentGetBodyTransforms(void* env, void** bodies, int numbodies, dReal* poses)
+{
+    EnvironmentBasePtr penv = GetEnvironment(env);
+    EnvironmentLock lock(penv->GetMutex());
+    for(int ibody = 0; ibody < numbodies; ++ibody) {
+        Transform t = GetBody(bodies[ibody])->GetTransform();
+        dReal* pose = poses + 7*ibody;
+        for(int i = 0; i < 4; ++i) {
+            pose[i] = t.rot[i];
+        }
+        for(int i = 0; i < 3; ++i) {
+            pose[4+i] = t.trans[i];
+        }
+    }
+}
+
+int ORCEnvironmentSetBodyDOFValues(void* env, void** bodies, int numbodies, const dReal* values)
+{
+    EnvironmentBasePtr penv = GetEnvironment(env);
+    EnvironmentLock lock(penv->GetMutex());
+    std::vector<dReal> tempvalues;
+    int offset = 0;
+    for(int ibody = 0; ibody < numbodies; ++ibody) {
+        KinBodyPtr pbody = GetBody(bodies[ibody]);
+        tempvalues.resize(pbody->GetDOF());
+        if( tempvalues.size() > 0 ) {
+            std::copy(values+offset, values+offset+tempvalues.size(), tempvalues.begin());
+            pbody->SetDOFValues(tempvalues);
+            offset += tempvalues.size();
+        }
+    }
+    return offset;
+}
+
+int ORCEnvironmentGetBodyDOFValues(void* env, void** bodies, int numbodies, dReal* values)
+{
+    EnvironmentBasePtr penv = GetEnvironment(env);
+    EnvironmentLock lock(penv->GetMutex());
+    std::vector<dReal> tempvalues;
+    int offset = 0;
+    for(int ibody = 0; ibody < numbodies; ++ibody) {
+        KinBodyPtr pbody = GetBody(bodies[ibody]);
+        if( !values ) {
+            offset += pbody->GetDOF();
+            continue;
+        }
+        pbody->GetDOFValues(tempvalues);
+        std::copy(tempvalues.begin(), tempvalues.end(), values+offset);
+        offset += tempvalues.size();
+    }
+    return offset;
+}
+
+int ORCEnvironmentCheckCollisions(void* env, void** bodies, int numbodies, int* collisions)
+{
+    EnvironmentBasePtr penv = GetEnvironment(env);
+    EnvironmentLock lock(penv->GetMutex());
+    int numcolliding = 0;
+    for(int ibody = 0; ibody < numbodies; ++ibody) {
+        bool bCollision = penv->CheckCollision(KinBodyConstPtr(GetBody(bodies[ibody])));
+        if( !!collisions ) {
+            collisions[ibody] = bCollision ? 1 : 0;
+        }
+        if( bCollision ) {
+            ++numcolliding;
+        }
+    }
+    return numcolliding;
+}
+
 char* ORCInterfaceSendCommand(void* pinterface, const char* command)
 {
     std::stringstream sout, sinput;
@@ -441,4 +535,58 @@ void* ORCModuleCreate(void* env, const char* modulename)
     return new InterfaceBasePtr(module);
 }
 
+void* ORCTrajectoryCreate(void* env, const char* trajectorytype)
+{
+    TrajectoryBasePtr traj = RaveCreateTrajectory(GetEnvironment(env), !trajectorytype ? std::string() : std::string(trajectorytype));
+    if( !traj ) {
+        return NULL;
+    }
+    return new InterfaceBasePtr(traj);
+}
+
+int ORCTrajectoryDeserialize(void* traj, const char* data, int size)
+{
+    try {
+        GetTrajectory(traj)->DeserializeFromRawData(reinterpret_cast<const uint8_t*>(data), size);
+    }
+    catch(const std::exception& ex) {
+        RAVELOG_WARN_FORMAT("failed to deserialize trajectory: %s", ex.what());
+        return 0;
+    }
+    return 1;
+}
+
+int ORCTrajectoryGetDOF(void* traj)
+{
+    return GetTrajectory(traj)->GetConfigurationSpecification().GetDOF();
+}
+
+dReal ORCTrajectoryGetDuration(void* traj)
+{
+    return GetTrajectory(traj)->GetDuration();
+}
+
+int ORCTrajectorySamplePoints(void* traj, const dReal* times, int numtimes, dReal* data)
+{
+    if( numtimes <= 0 ) {
+        return 0;
+    }
+    std::vector<dReal> vtimes(times, times+numtimes), tempdata;
+    GetTrajectory(traj)->SamplePoints(tempdata, vtimes);
+    std::copy(tempdata.begin(), tempdata.end(), data);
+    return static_cast<int>(tempdata.size());
+}
+
+int ORCTrajectoriesSample(void** trajs, int numtrajs, dReal time, dReal* data)
+{
+    std::vector<dReal> tempdata;
+    int offset = 0;
+    for(int itraj = 0; itraj < numtrajs; ++itraj) {
+        GetTrajectory(trajs[itraj])->Sample(tempdata, time);
+        std::copy(tempdata.begin(), tempdata.end(), data+offset);
+        offset += tempdata.size();
+    }
+    return offset;
+}
+
 }
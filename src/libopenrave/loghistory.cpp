@@ -0,0 +1,145 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2016 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "libopenrave.h"
+
+#include <atomic>
+#include <mutex>
+
+namespace OpenRAVE {
+
+namespace {
+
+/// \brief a message that was filtered out by the debug level and is kept unformatted
+struct LogHistoryEntry
+{
+    LogHistoryEntry() : level(0), filename(""), line(0), function(""), timestamp(0) {
+    }
+    int level;
+    const char* filename;
+    int line;
+    const char* function;
+    uint64_t timestamp; ///< us
+    RaveLogFormatFn formatfn;
+};
+
+/// \brief ring of the last deferred messages of all threads
+class LogHistory
+{
+public:
+    static LogHistory& GetInstance()
+    {
+        static LogHistory s_history;
+        return s_history;
+    }
+
+    inline bool IsEnabled() const {
+        return _bEnabled.load(std::memory_order_relaxed);
+    }
+
+    void SetSize(size_t numMessages)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _ventries.clear();
+        _ventries.resize(numMessages);
+        _numadded = 0;
+        _bEnabled.store(numMessages > 0, std::memory_order_relaxed);
+    }
+
+    void Add(int level, const char* filename, int line, const char* function, const RaveLogFormatFn& formatfn)
+    {
+        const uint64_t timestamp = utils::GetMicroTime();
+        std::lock_guard<std::mutex> lock(_mutex);
+        if( _ventries.size() == 0 ) {
+            return; // disabled after the caller checked
+        }
+        LogHistoryEntry& entry = _ventries[_numadded % _ventries.size()];
+        entry.level = level;
+        entry.filename = filename;
+        entry.line = line;
+        entry.function = function;
+        entry.timestamp = timestamp;
+        entry.formatfn = formatfn;
+        ++_numadded;
+    }
+
+    /// \param bClear if true, removes the written messages
+    void Write(std::ostream& o, bool bClear)
+    {
+        std::vector<LogHistoryEntry> ventries;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            const uint64_t capacity = _ventries.size();
+            for(uint64_t index = _numadded > capacity ? _numadded - capacity : 0; index < _numadded; ++index) {
+                ventries.push_back(_ventries[index % capacity]);
+            }
+            if( bClear ) {
+                _numadded = 0;
+                FOREACH(itentry, _ventries) {
+                    itentry->formatfn.clear();
+                }
+            }
+        }
+        // format outside of the lock since it can be slow
+        FOREACHC(itentry, ventries) {
+            o << "[" << itentry->timestamp << " " << itentry->filename << ":" << itentry->line << " " << itentry->function << "] ";
+            itentry->formatfn(o);
+            o << "\n";
+        }
+    }
+
+private:
+    LogHistory() : _bEnabled(false), _numadded(0) {
+    }
+
+    std::atomic<bool> _bEnabled;
+    std::mutex _mutex; ///< protects _ventries and _numadded
+    std::vector<LogHistoryEntry> _ventries;
+    uint64_t _numadded; ///< total number of messages added, message i is at _ventries[i%_ventries.size()]
+};
+
+} // end namespace
+
+void RaveSetLogHistory(size_t numMessages)
+{
+    LogHistory::GetInstance().SetSize(numMessages);
+}
+
+bool RaveIsLogHistoryEnabled()
+{
+    return LogHistory::GetInstance().IsEnabled();
+}
+
+void RaveAddLogHistory(int level, const char* filename, int line, const char* function, const RaveLogFormatFn& formatfn)
+{
+    LogHistory::GetInstance().Add(level, filename, line, function, formatfn);
+}
+
+void RaveWriteLogHistory(std::ostream& o)
+{
+    LogHistory::GetInstance().Write(o, false);
+}
+
+void RaveDumpLogHistory(int level)
+{
+    std::stringstream ss;
+    LogHistory::GetInstance().Write(ss, true);
+    if( ss.tellp() > 0 ) {
+        RavePrintfA(std::string("log history:\n") + ss.str(), level);
+    }
+}
+
+} // end namespace OpenRAVE
@@ -28,100 +28,6 @@ MSGPACK_API_VERSION_NAMESPACE(MSGPACK_DEFAULT_API_NS) {
 
 namespace adaptor {
 
-template <typename Encoding, typename Allocator, typename StackAllocator>
-struct convert< rapidjson::GenericDocument<Encoding, Allocator, StackAllocator> > {
-    msgpack::object const& operator()(msgpack::object const& o, rapidjson::GenericDocument<Encoding, Allocator, StackAllocator>& v) const {
-        switch (o.type)
-        {
-            case msgpack::type::BOOLEAN: v.SetBool(o.via.boolean); break;;
-            case msgpack::type::POSITIVE_INTEGER: v.SetUint64(o.via.u64); break;
-            case msgpack::type::NEGATIVE_INTEGER: v.SetInt64(o.via.i64); break;
-            case msgpack::type::FLOAT: v.SetDouble(o.via.f64); break;
-            case msgpack::type::BIN: // fall through
-            case msgpack::type::STR: v.SetString(o.via.str.ptr, o.via.str.size, v.GetAllocator()); break;
-            case msgpack::type::ARRAY:{
-                v.SetArray();
-                v.Reserve(o.via.array.size, v.GetAllocator());
-                msgpack::object* ptr = o.via.array.ptr;
-                msgpack::object* END = ptr + o.via.array.size;
-                for (; ptr < END; ++ptr)
-                {
-                    rapidjson::GenericDocument<Encoding, Allocator, StackAllocator> element(&v.GetAllocator());
-                    ptr->convert(element);
-                    v.PushBack(static_cast<rapidjson::GenericValue<Encoding, Allocator>&>(element), v.GetAllocator());
-                }
-            }
-                break;
-            case msgpack::type::MAP: {
-                v.SetObject();
-                msgpack::object_kv* ptr = o.via.map.ptr;
-                msgpack::object_kv* END = ptr + o.via.map.size;
-                for (; ptr < END; ++ptr)
-                {
-                    rapidjson::GenericValue<Encoding, Allocator> key(ptr->key.via.str.ptr, ptr->key.via.str.size, v.GetAllocator());
-                    rapidjson::GenericDocument<Encoding, Allocator, StackAllocator> val(&v.GetAllocator());
-                    ptr->val.convert(val);
-
-                    v.AddMember(key, val, v.GetAllocator());
-                }
-            }
-                break;
-            case msgpack::type::EXT: {
-                if (o.via.ext.type() == -1) {
-                    const std::chrono::system_clock::time_point tp = o.as<std::chrono::system_clock::time_point>();
-                    const std::time_t parsedTime = std::chrono::system_clock::to_time_t(tp);
-
-                    // RFC 3339 Nano format
-                    char formatted[sizeof("2006-01-02T15:04:05.999999999Z07:00")];
-
-                    // The extension does not include timezone information. By convention, we format to local time.
-                    struct tm datetime = {0};
-                    std::size_t size = std::strftime(formatted, sizeof(formatted), "%FT%T", localtime_r(&parsedTime, &datetime));
-
-                    // Add nanoseconds portion if present
-                    const long nanoseconds = (std::chrono::duration_cast<chrono::nanoseconds>(tp.time_since_epoch()).count() % 1000000000 + 1000000000) % 1000000000;
-                    if (nanoseconds != 0) {
-                        size += sprintf(formatted + size, ".%09lu", nanoseconds);
-                        // remove trailing zeros
-                        while (formatted[size - 1] == '0') {
-                            --size;
-                        }
-                    }
-                    if (datetime.tm_gmtoff == 0) {
-                        formatted[size] = 'Z';
-                    } else {
-                        size += std::strftime(formatted + size, sizeof(formatted) - size, "%z", &datetime);
-                        // fix timezone format (0000 -> 00:00)
-                        formatted[size] = formatted[size - 1];
-                        formatted[size - 1] = formatted[size - 2];
-                        formatted[size - 2] = ':';
-                    }
-                    formatted[++size] = '\0';
-
-                    v.SetString(formatted, size, v.GetAllocator());
-                } else {
-                    RAVELOG_WARN("Unrecognized msgpack extension type.");
-                }
-                break;
-            }
-            case msgpack::type::NIL:
-            default:
-                v.SetNull(); break;
-
-        }
-        return o;
-    }
-};
-
-template <typename Encoding, typename Allocator>
-struct convert< rapidjson::GenericValue<Encoding, Allocator> > {
-    msgpack::object const& operator()(msgpack::object const& o, rapidjson::GenericValue<Encoding, Allocator>& v) const {
-        rapidjson::GenericDocument<Encoding, Allocator> d;
-        o >> d;
-        return v = d;
-    }
-};
-
 template <typename Encoding, typename Allocator>
 struct pack< rapidjson::GenericValue<Encoding, Allocator> > {
     template <typename Stream>
@@ -319,6 +225,264 @@ private:
 
 } // namespace msgpack
 
+namespace {
+
+// RFC 3339 Nano format
+static const size_t s_timestampFormattedSize = sizeof("2006-01-02T15:04:05.999999999Z07:00");
+
+/// \brief formats the msgpack timestamp extension, formatted has to hold s_timestampFormattedSize characters. returns the length of the string
+size_t _FormatMsgPackTimestamp(const msgpack::object& o, char* formatted)
+{
+    const std::chrono::system_clock::time_point tp = o.as<std::chrono::system_clock::time_point>();
+    const std::time_t parsedTime = std::chrono::system_clock::to_time_t(tp);
+
+    // The extension does not include timezone information. By convention, we format to local time.
+    struct tm datetime = {0};
+    std::size_t size = std::strftime(formatted, s_timestampFormattedSize, "%FT%T", localtime_r(&parsedTime, &datetime));
+
+    // Add nanoseconds portion if present
+    const long nanoseconds = (std::chrono::duration_cast<chrono::nanoseconds>(tp.time_since_epoch()).count() % 1000000000 + 1000000000) % 1000000000;
+    if (nanoseconds != 0) {
+        size += sprintf(formatted + size, ".%09lu", nanoseconds);
+        // remove trailing zeros
+        while (formatted[size - 1] == '0') {
+            --size;
+        }
+    }
+    if (datetime.tm_gmtoff == 0) {
+        formatted[size] = 'Z';
+    } else {
+        size += std::strftime(formatted + size, s_timestampFormattedSize - size, "%z", &datetime);
+        // fix timezone format (0000 -> 00:00)
+        formatted[size] = formatted[size - 1];
+        formatted[size - 1] = formatted[size - 2];
+        formatted[size - 2] = ':';
+    }
+    formatted[++size] = '\0';
+    return size;
+}
+
+inline bool _IsLittleEndian()
+{
+    const uint16_t test = 1;
+    return *reinterpret_cast<const uint8_t*>(&test) == 1;
+}
+
+/// \brief reads a little endian number from unaligned memory
+template <typename T>
+inline T _ReadLittleEndian(const char* p)
+{
+    char bytes[sizeof(T)];
+    if( _IsLittleEndian() ) {
+        std::copy(p, p + sizeof(T), bytes);
+    }
+    else {
+        std::reverse_copy(p, p + sizeof(T), bytes);
+    }
+    T value;
+    memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+/// \brief packs the numbers as the little endian body of an extension
+template <typename Packer, typename T>
+inline void _PackLittleEndianBody(Packer& packer, const T* values, size_t numValues)
+{
+    if( _IsLittleEndian() ) {
+        packer.pack_ext_body(reinterpret_cast<const char*>(values), numValues*sizeof(T));
+        return;
+    }
+    std::vector<char> bytes(numValues*sizeof(T));
+    for(size_t i = 0; i < numValues; ++i) {
+        const char* p = reinterpret_cast<const char*>(values + i);
+        std::reverse_copy(p, p + sizeof(T), bytes.begin() + i*sizeof(T));
+    }
+    packer.pack_ext_body(bytes.data(), bytes.size());
+}
+
+/// \brief msgpack parser visitor building the rapidjson document through its SAX handler interface.
+///
+/// The values go directly from the msgpack buffer to the document, so there is no intermediate msgpack object tree and the
+/// numeric arrays like the mesh vertices are pushed on the document stack without any temporary value per element.
+class RapidJSONMsgPackVisitor : public msgpack::v2::null_visitor
+{
+public:
+    RapidJSONMsgPackVisitor(rapidjson::Document& d) : _d(d), _bInKey(false) {
+    }
+
+    bool visit_nil() {
+        return !_bInKey && _d.Null();
+    }
+    bool visit_boolean(bool v) {
+        return !_bInKey && _d.Bool(v);
+    }
+    bool visit_positive_integer(uint64_t v) {
+        return !_bInKey && _d.Uint64(v);
+    }
+    bool visit_negative_integer(int64_t v) {
+        return !_bInKey && _d.Int64(v);
+    }
+    bool visit_float32(float v) {
+        return !_bInKey && _d.Double(v);
+    }
+    bool visit_float64(double v) {
+        return !_bInKey && _d.Double(v);
+    }
+    bool visit_str(const char* v, uint32_t size) {
+        return _bInKey ? _d.Key(v, size, true) : _d.String(v, size, true);
+    }
+    bool visit_bin(const char* v, uint32_t size) {
+        return visit_str(v, size);
+    }
+    bool visit_ext(const char* v, uint32_t size) {
+        if( _bInKey ) {
+            return false;
+        }
+        // v starts with the extension type
+        if( size > 0 && (int8_t)v[0] == OpenRAVE::MsgPack::MPET_Float64Array ) {
+            const uint32_t num = (size - 1)/sizeof(double);
+            if( !_d.StartArray() ) {
+                return false;
+            }
+            for(uint32_t i = 0; i < num; ++i) {
+                if( !_d.Double(_ReadLittleEndian<double>(v + 1 + i*sizeof(double))) ) {
+                    return false;
+                }
+            }
+            return _d.EndArray(num);
+        }
+        if( size > 0 && (int8_t)v[0] == OpenRAVE::MsgPack::MPET_Int32Array ) {
+            const uint32_t num = (size - 1)/sizeof(int32_t);
+            if( !_d.StartArray() ) {
+                return false;
+            }
+            for(uint32_t i = 0; i < num; ++i) {
+                if( !_d.Int(_ReadLittleEndian<int32_t>(v + 1 + i*sizeof(int32_t))) ) {
+                    return false;
+                }
+            }
+            return _d.EndArray(num);
+        }
+        if( size > 0 && (int8_t)v[0] == -1 ) {
+            msgpack::object o;
+            o.type = msgpack::type::EXT;
+            o.via.ext.ptr = v;
+            o.via.ext.size = size - 1;
+            char formatted[s_timestampFormattedSize];
+            const size_t formattedsize = _FormatMsgPackTimestamp(o, formatted);
+            return _d.String(formatted, formattedsize, true);
+        }
+        RAVELOG_WARN("Unrecognized msgpack extension type.");
+        return _d.Null();
+    }
+    bool start_array(uint32_t num) {
+        _vcounts.push_back(num);
+        return !_bInKey && _d.StartArray();
+    }
+    bool end_array() {
+        const uint32_t num = _vcounts.back();
+        _vcounts.pop_back();
+        return _d.EndArray(num);
+    }
+    bool start_map(uint32_t num) {
+        _vcounts.push_back(num);
+        return !_bInKey && _d.StartObject();
+    }
+    bool start_map_key() {
+        _bInKey = true;
+        return true;
+    }
+    bool end_map_key() {
+        _bInKey = false;
+        return true;
+    }
+    bool end_map() {
+        const uint32_t num = _vcounts.back();
+        _vcounts.pop_back();
+        return _d.EndObject(num);
+    }
+    void parse_error(size_t parsed_offset, size_t error_offset) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("failed to parse msgpack at offset %d"), error_offset, ORE_InvalidArguments);
+    }
+    void insufficient_bytes(size_t parsed_offset, size_t error_offset) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("msgpack data is truncated at offset %d"), error_offset, ORE_InvalidArguments);
+    }
+
+private:
+    rapidjson::Document& _d;
+    std::vector<uint32_t> _vcounts; ///< number of elements of the arrays and maps being parsed
+    bool _bInKey; ///< true if parsing the key of a map, which has to be a string
+};
+
+} // namespace
+
+OpenRAVE::MsgPack::MsgPackStreamWriter::MsgPackStreamWriter(std::ostream& os) : _pos(&os), _poutput(NULL)
+{
+}
+
+OpenRAVE::MsgPack::MsgPackStreamWriter::MsgPackStreamWriter(std::vector<char>& output) : _pos(NULL), _poutput(&output)
+{
+}
+
+template <typename F>
+void OpenRAVE::MsgPack::MsgPackStreamWriter::_Pack(F fn)
+{
+    if( !!_pos ) {
+        msgpack::osbuffer buf(*_pos);
+        msgpack::packer<msgpack::osbuffer> packer(buf);
+        fn(packer);
+    }
+    else {
+        msgpack::vbuffer buf(*_poutput);
+        msgpack::packer<msgpack::vbuffer> packer(buf);
+        fn(packer);
+    }
+}
+
+void OpenRAVE::MsgPack::MsgPackStreamWriter::StartMap(uint32_t numMembers)
+{
+    _Pack([numMembers](auto& packer) {
+        packer.pack_map(numMembers);
+    });
+}
+
+void OpenRAVE::MsgPack::MsgPackStreamWriter::StartArray(uint32_t numElements)
+{
+    _Pack([numElements](auto& packer) {
+        packer.pack_array(numElements);
+    });
+}
+
+void OpenRAVE::MsgPack::MsgPackStreamWriter::WriteString(const char* str, size_t length)
+{
+    _Pack([str, length](auto& packer) {
+        packer.pack_str(length).pack_str_body(str, length);
+    });
+}
+
+void OpenRAVE::MsgPack::MsgPackStreamWriter::WriteValue(const rapidjson::Value& value)
+{
+    _Pack([&value](auto& packer) {
+        packer.pack(value);
+    });
+}
+
+void OpenRAVE::MsgPack::MsgPackStreamWriter::WriteFloat64Array(const double* values, size_t numValues)
+{
+    _Pack([values, numValues](auto& packer) {
+        packer.pack_ext(numValues*sizeof(double), MPET_Float64Array);
+        _PackLittleEndianBody(packer, values, numValues);
+    });
+}
+
+void OpenRAVE::MsgPack::MsgPackStreamWriter::WriteInt32Array(const int32_t* values, size_t numValues)
+{
+    _Pack([values, numValues](auto& packer) {
+        packer.pack_ext(numValues*sizeof(int32_t), MPET_Int32Array);
+        _PackLittleEndianBody(packer, values, numValues);
+    });
+}
+
 void OpenRAVE::MsgPack::DumpMsgPack(const rapidjson::Value& value, std::ostream& os)
 {
     msgpack::osbuffer buf(os);
@@ -333,16 +497,22 @@ void OpenRAVE::MsgPack::DumpMsgPack(const rapidjson::Value& value, std::vector<c
 
 void OpenRAVE::MsgPack::ParseMsgPack(rapidjson::Document& d, const std::string& str)
 {
-    msgpack::unpacked unpacked;
-    msgpack::unpack(unpacked, str.data(), str.size());
-    unpacked.get().convert(d);
+    OpenRAVE::MsgPack::ParseMsgPack(d, str.data(), str.size());
 }
 
 void OpenRAVE::MsgPack::ParseMsgPack(rapidjson::Document& d, const void* data, size_t size)
 {
-    msgpack::unpacked unpacked;
-    msgpack::unpack(unpacked, (const char*) data, size);
-    unpacked.get().convert(d);
+    bool bSuccess = false;
+    auto generator = [data, size, &bSuccess](rapidjson::Document& handler) {
+        RapidJSONMsgPackVisitor visitor(handler);
+        size_t offset = 0;
+        bSuccess = msgpack::v2::parse((const char*)data, size, offset, visitor);
+        return bSuccess;
+    };
+    d.Populate(generator);
+    if( !bSuccess ) {
+        throw OPENRAVE_EXCEPTION_FORMAT0(_("msgpack data cannot be represented as json, map keys have to be strings"), ORE_InvalidArguments);
+    }
 }
 
 void OpenRAVE::MsgPack::ParseMsgPack(rapidjson::Document& d, std::istream& is)
@@ -381,4 +551,38 @@ void OpenRAVE::MsgPack::ParseMsgPack(rapidjson::Document& d, std::istream& is)
     throw OPENRAVE_EXCEPTION_FORMAT0("MsgPack support is not enabled", ORE_NotImplemented);
 }
 
+OpenRAVE::MsgPack::MsgPackStreamWriter::MsgPackStreamWriter(std::ostream& os) : _pos(&os), _poutput(NULL)
+{
+    throw OPENRAVE_EXCEPTION_FORMAT0("MsgPack support is not enabled", ORE_NotImplemented);
+}
+
+OpenRAVE::MsgPack::MsgPackStreamWriter::MsgPackStreamWriter(std::vector<char>& output) : _pos(NULL), _poutput(&output)
+{
+    throw OPENRAVE_EXCEPTION_FORMAT0("MsgPack support is not enabled", ORE_NotImplemented);
+}
+
+void OpenRAVE::MsgPack::MsgPackStreamWriter::StartMap(uint32_t numMembers)
+{
+}
+
+void OpenRAVE::MsgPack::MsgPackStreamWriter::StartArray(uint32_t numElements)
+{
+}
+
+void OpenRAVE::MsgPack::MsgPackStreamWriter::WriteString(const char* str, size_t length)
+{
+}
+
+void OpenRAVE::MsgPack::MsgPackStreamWriter::WriteValue(const rapidjson::Value& value)
+{
+}
+
+void OpenRAVE::MsgPack::MsgPackStreamWriter::WriteFloat64Array(const double* values, size_t numValues)
+{
+}
+
+void OpenRAVE::MsgPack::MsgPackStreamWriter::WriteInt32Array(const int32_t* values, size_t numValues)
+{
+}
+
 #endif
@@ -21,6 +21,12 @@
 
 #include <boost/bind/bind.hpp>
 
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
 using namespace boost::placeholders;
 
 namespace OpenRAVE {
@@ -62,7 +68,8 @@ std::istream& operator>>(std::istream& I, PlannerParameters& pp)
         }
 
         pp._plannerparametersdepth = 0;
-        xmlreaders::ParseXMLData(pp, &vstrbuf[0], vstrbuf.size());
+        // planners copy the same parameters through xml on every InitPlan, so reuse the parsed events
+        xmlreaders::ParseCachedXMLData(pp, &vstrbuf[0], vstrbuf.size());
     }
 
     return I;
@@ -111,6 +118,61 @@ int AddStatesWithLimitCheck(std::vector<dReal>& q, const std::vector<dReal>& qde
     return status;
 }
 
+PlannerProfile::StageTimer::StageTimer(PlannerProfile* profile, ProfileStage stage) : _profile(profile), _stage(stage), _starttime(0)
+{
+    if( !!_profile ) {
+        _starttime = utils::GetMicroTime();
+    }
+}
+
+PlannerProfile::StageTimer::~StageTimer()
+{
+    if( !!_profile ) {
+        _profile->vStageTimeUS[_stage] += utils::GetMicroTime() - _starttime;
+        _profile->vStageCalls[_stage] += 1;
+    }
+}
+
+PlannerProfile::PlannerProfile()
+{
+    Reset();
+}
+
+void PlannerProfile::Reset()
+{
+    std::fill(vStageTimeUS, vStageTimeUS+PPS_Count, 0);
+    std::fill(vStageCalls, vStageCalls+PPS_Count, 0);
+    numCollisionCalls = 0;
+}
+
+void PlannerProfile::Add(const PlannerProfile& r)
+{
+    for(int istage = 0; istage < PPS_Count; ++istage) {
+        vStageTimeUS[istage] += r.vStageTimeUS[istage];
+        vStageCalls[istage] += r.vStageCalls[istage];
+    }
+    numCollisionCalls += r.numCollisionCalls;
+}
+
+const char* PlannerProfile::GetStageName(ProfileStage stage)
+{
+    static const char* s_stagenames[PPS_Count] = {"sampling", "nearestNeighbor", "constraintChecking", "ik", "smoothing", "retiming"};
+    return stage >= 0 && stage < PPS_Count ? s_stagenames[stage] : "";
+}
+
+void PlannerProfile::SaveToJson(rapidjson::Value& rProfile, rapidjson::Document::AllocatorType& alloc) const
+{
+    rProfile.SetObject();
+    for(int istage = 0; istage < PPS_Count; ++istage) {
+        rapidjson::Value rStage;
+        rStage.SetObject();
+        orjson::SetJsonValueByKey(rStage, "timeUS", vStageTimeUS[istage], alloc);
+        orjson::SetJsonValueByKey(rStage, "calls", vStageCalls[istage], alloc);
+        orjson::SetJsonValueByKey(rProfile, GetStageName((ProfileStage)istage), rStage, alloc);
+    }
+    orjson::SetJsonValueByKey(rProfile, "numCollisionCalls", numCollisionCalls, alloc);
+}
+
 PlannerStatus::PlannerStatus()
 {
     statusCode = 0;
@@ -225,6 +287,9 @@ PlannerStatus& PlannerStatus::SetErrorOrigin(const std::string& errorOrigin_)
 PlannerStatus& PlannerStatus::SetPlannerParameters(PlannerParametersConstPtr parameters_)
 {
     this->parameters = parameters_;
+    if( !!parameters_ ) {
+        this->profile = parameters_->_profile;
+    }
     return *this;
 }
 
@@ -288,6 +353,12 @@ void PlannerStatus::SaveToJson(rapidjson::Value& rPlannerStatus, rapidjson::Docu
     if( ikparam.GetType() != IKP_None ) {
         orjson::SetJsonValueByKey(rPlannerStatus, "ikparam", ikparam, alloc);
     }
+
+    if( !!profile ) {
+        rapidjson::Value rProfile;
+        profile->SaveToJson(rProfile, alloc);
+        orjson::SetJsonValueByKey(rPlannerStatus, "profile", rProfile, alloc);
+    }
 }
 
 PlannerParameters::StateSaver::StateSaver(PlannerParametersPtr params) : _params(params)
@@ -312,7 +383,7 @@ void PlannerParameters::StateSaver::_Restore()
     BOOST_ASSERT(ret==0);
 }
 
-PlannerParameters::PlannerParameters() : Readable("plannerparameters"), _fStepLength(0.04f), _nMaxIterations(0), _nMaxPlanningTime(0), _sPostProcessingPlanner(s_linearsmoother), _nRandomGeneratorSeed(0)
+PlannerParameters::PlannerParameters() : Readable("plannerparameters"), _fStepLength(0.04f), _nMaxIterations(0), _nMaxPlanningTime(0), _sPostProcessingPlanner(s_linearsmoother), _nRandomGeneratorSeed(0), _nParallelCollisionCheckingWorkers(0), _bBatchCollisionChecking(false)
 {
     _diffstatefn = SubtractStates;
     _neighstatefn = AddStates;
@@ -337,6 +408,9 @@ PlannerParameters::PlannerParameters() : Readable("plannerparameters"), _fStepLe
     _vXMLParameters.push_back("_fsteplength");
     _vXMLParameters.push_back("_postprocessing");
     _vXMLParameters.push_back("_nrandomgeneratorseed");
+    _vXMLParameters.push_back("_profile");
+    _vXMLParameters.push_back("_nparallelcollisioncheckingworkers");
+    _vXMLParameters.push_back("_bbatchcollisionchecking");
 }
 
 PlannerParameters::~PlannerParameters()
@@ -364,6 +438,8 @@ PlannerParameters& PlannerParameters::operator=(const PlannerParameters& r)
     _diffstatefn = r._diffstatefn;
     _neighstatefn = r._neighstatefn;
     _listInternalSamplers = r._listInternalSamplers;
+    _collisioncache = r._collisioncache;
+    _profile = r._profile;
 
     vinitialconfig.resize(0);
     _vInitialConfigVelocities.resize(0);
@@ -383,6 +459,8 @@ PlannerParameters& PlannerParameters::operator=(const PlannerParameters& r)
     _nMaxPlanningTime = 0;
     _fStepLength = 0.04f;
     _nRandomGeneratorSeed = 0;
+    _nParallelCollisionCheckingWorkers = 0;
+    _bBatchCollisionChecking = false;
     _plannerparametersdepth = 0;
 
     // transfer data
@@ -464,6 +542,9 @@ bool PlannerParameters::serialize(std::ostream& O, int options) const
     O << "<_nmaxplanningtime>" << _nMaxPlanningTime << "</_nmaxplanningtime>" << endl;
     O << "<_fsteplength>" << _fStepLength << "</_fsteplength>" << endl;
     O << "<_nrandomgeneratorseed>" << _nRandomGeneratorSeed << "</_nrandomgeneratorseed>" << endl;
+    O << "<_profile>" << (!!_profile ? 1 : 0) << "</_profile>" << endl;
+    O << "<_nparallelcollisioncheckingworkers>" << _nParallelCollisionCheckingWorkers << "</_nparallelcollisioncheckingworkers>" << endl;
+    O << "<_bbatchcollisionchecking>" << (int)_bBatchCollisionChecking << "</_bbatchcollisionchecking>" << endl;
     O << "<_postprocessing planner=\"" << _sPostProcessingPlanner << "\">" << _sPostProcessingParameters << "</_postprocessing>" << endl;
     if( !(options & 1) ) {
         O << _sExtraParameters << endl;
@@ -518,7 +599,7 @@ BaseXMLReader::ProcessElement PlannerParameters::startElement(const std::string&
         return PE_Support;
     }
 
-    static const boost::array<std::string,15> names = {{"_vinitialconfig","_vgoalconfig","_vconfiglowerlimit","_vconfigupperlimit","_vconfigvelocitylimit","_vconfigaccelerationlimit","_vconfigjerklimit","_vconfigresolution","_nmaxiterations","_nmaxplanningtime","_fsteplength","_postprocessing", "_nrandomgeneratorseed", "_vinitialconfigvelocities", "_vgoalconfigvelocities"}};
+    static const boost::array<std::string,18> names = {{"_vinitialconfig","_vgoalconfig","_vconfiglowerlimit","_vconfigupperlimit","_vconfigvelocitylimit","_vconfigaccelerationlimit","_vconfigjerklimit","_vconfigresolution","_nmaxiterations","_nmaxplanningtime","_fsteplength","_postprocessing", "_nrandomgeneratorseed", "_vinitialconfigvelocities", "_vgoalconfigvelocities", "_profile", "_nparallelcollisioncheckingworkers", "_bbatchcollisionchecking"}};
     if( find(names.begin(),names.end(),name) != names.end() ) {
         __processingtag = name;
         return PE_Support;
@@ -591,6 +672,24 @@ bool PlannerParameters::endElement(const std::string& name)
         else if( name == "_nrandomgeneratorseed") {
             _ss >> _nRandomGeneratorSeed;
         }
+        else if( name == "_nparallelcollisioncheckingworkers") {
+            _ss >> _nParallelCollisionCheckingWorkers;
+        }
+        else if( name == "_bbatchcollisionchecking") {
+            int bbatch = 0;
+            _ss >> bbatch;
+            _bBatchCollisionChecking = bbatch != 0;
+        }
+        else if( name == "_profile") {
+            int bprofile = 0;
+            _ss >> bprofile;
+            if( !bprofile ) {
+                _profile.reset();
+            }
+            else if( !_profile ) {
+                _profile.reset(new PlannerProfile());
+            }
+        }
         if( name !=__processingtag ) {
             RAVELOG_WARN(str(boost::format("invalid tag %s!=%s\n")%name%__processingtag));
         }
@@ -743,6 +842,37 @@ void PlannerParameters::SetRobotDOFIndices(RobotBasePtr& probot, const std::vect
     _checkpathvelocityaccelerationconstraintsfn = std::bind(CheckWithAccelerations, pcollision, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5, std::placeholders::_6, std::placeholders::_7, std::placeholders::_8, std::placeholders::_9, std::placeholders::_10);
 }
 
+/// \brief two scratch vectors for splitting states into groups without allocating on every call
+///
+/// Uses vectors kept by the thread, or local vectors when a group function calls back into the group dispatchers on the same thread.
+class GroupScratchVectors
+{
+public:
+    GroupScratchVectors(int nMaxDOFForGroup) : vtemp0(_GetDepth() == 0 ? _GetThreadVector(0) : _vlocal0), vtemp1(_GetDepth() == 0 ? _GetThreadVector(1) : _vlocal1) {
+        ++_GetDepth();
+        vtemp0.reserve(nMaxDOFForGroup);
+        vtemp1.reserve(nMaxDOFForGroup);
+    }
+    ~GroupScratchVectors() {
+        --_GetDepth();
+    }
+
+    std::vector<dReal>& vtemp0;
+    std::vector<dReal>& vtemp1;
+
+private:
+    static int& _GetDepth() {
+        static thread_local int s_depth = 0;
+        return s_depth;
+    }
+    static std::vector<dReal>& _GetThreadVector(int index) {
+        static thread_local std::vector<dReal> s_vtemp[2];
+        return s_vtemp[index];
+    }
+
+    std::vector<dReal> _vlocal0, _vlocal1;
+};
+
 void _CallDiffStateFns(const std::vector< std::pair<PlannerParameters::DiffStateFn, int> >& vfunctions, int nDOF, int nMaxDOFForGroup, std::vector<dReal>& v0, const std::vector<dReal>& v1)
 {
     if( vfunctions.size() == 1 ) {
@@ -751,7 +881,8 @@ void _CallDiffStateFns(const std::vector< std::pair<PlannerParameters::DiffState
     else {
         OPENRAVE_ASSERT_OP((int)v0.size(),==,nDOF);
         OPENRAVE_ASSERT_OP((int)v1.size(),==,nDOF);
-        std::vector<dReal> vtemp0, vtemp1; vtemp0.reserve(nMaxDOFForGroup); vtemp1.reserve(nMaxDOFForGroup);
+        GroupScratchVectors scratch(nMaxDOFForGroup);
+        std::vector<dReal>& vtemp0 = scratch.vtemp0, &vtemp1 = scratch.vtemp1;
         std::vector<dReal>::iterator itsource0 = v0.begin();
         std::vector<dReal>::const_iterator itsource1 = v1.begin();
         FOREACHC(itfn, vfunctions) {
@@ -772,11 +903,15 @@ void _CallDiffStateFns(const std::vector< std::pair<PlannerParameters::DiffState
 /// \param vweights2 squared weights
 dReal _EvalJointDOFDistanceMetric(const PlannerParameters::DiffStateFn& difffn, const std::vector<dReal>&c0, const std::vector<dReal>&c1, const std::vector<dReal>& vweights2)
 {
-    std::vector<dReal> c = c0;
+    // the difference functions of the bodies do not compute distances, so the scratch cannot be reentered
+    static thread_local std::vector<dReal> s_c;
+    std::vector<dReal>& c = s_c;
+    c = c0;
     difffn(c,c1);
+    OPENRAVE_ASSERT_OP(c.size(),<=,vweights2.size());
     dReal dist = 0;
     for(size_t i=0; i < c.size(); i++) {
-        dist += vweights2.at(i)*c.at(i)*c.at(i);
+        dist += vweights2[i]*c[i]*c[i];
     }
     return RaveSqrt(dist);
 }
@@ -789,7 +924,8 @@ dReal _CallDistMetricFns(const std::vector< std::pair<PlannerParameters::DistMet
     else {
         OPENRAVE_ASSERT_OP((int)v0.size(),==,nDOF);
         OPENRAVE_ASSERT_OP((int)v1.size(),==,nDOF);
-        std::vector<dReal> vtemp0, vtemp1; vtemp0.reserve(nMaxDOFForGroup); vtemp1.reserve(nMaxDOFForGroup);
+        GroupScratchVectors scratch(nMaxDOFForGroup);
+        std::vector<dReal>& vtemp0 = scratch.vtemp0, &vtemp1 = scratch.vtemp1;
         std::vector<dReal>::const_iterator itsource0 = v0.begin(), itsource1 = v1.begin();
         dReal f = 0;
         FOREACHC(itfn, vfunctions) {
@@ -905,7 +1041,8 @@ int _CallNeighStateFns(const std::vector< std::pair<PlannerParameters::NeighStat
     else {
         OPENRAVE_ASSERT_OP((int)vdelta.size(),==,nDOF);
         OPENRAVE_ASSERT_OP((int)v.size(),==,nDOF);
-        std::vector<dReal> vtemp0, vtemp1; vtemp0.reserve(nMaxDOFForGroup); vtemp1.reserve(nMaxDOFForGroup);
+        GroupScratchVectors scratch(nMaxDOFForGroup);
+        std::vector<dReal>& vtemp0 = scratch.vtemp0, &vtemp1 = scratch.vtemp1;
         std::vector<dReal>::const_iterator itdelta = vdelta.begin();
         std::vector<dReal>::iterator itdest = v.begin();
         int ret = NSS_Failed;
@@ -1140,6 +1277,7 @@ public:
         PlannerBasePtr planner = _plannerweak.lock();
         if( !!planner ) {
             planner->__listRegisteredCallbacks.erase(_iterator);
+            --planner->__nNumRegisteredCallbacks;
         }
     }
 
@@ -1150,10 +1288,135 @@ public:
 
 typedef boost::shared_ptr<CustomPlannerCallbackData> CustomPlannerCallbackDataPtr;
 
-PlannerBase::PlannerBase(EnvironmentBasePtr penv) : InterfaceBase(PT_Planner, penv)
+PlannerBase::PlannerBase(EnvironmentBasePtr penv) : InterfaceBase(PT_Planner, penv), __nNumRegisteredCallbacks(0), __nCallbackPeriodUs(0), __nLastCallbackTimeUs(0)
 {
 }
 
+/// \brief runs PlanPath of a planner on its own thread for PlannerBase::PlanPathAsync
+class PlanPathAsyncHandle : public PlannerBase::PlanPathHandle
+{
+public:
+    PlanPathAsyncHandle() : _ptoken(new TaskCancellationToken()), _bDone(false) {
+    }
+    virtual ~PlanPathAsyncHandle() {
+        Cancel();
+        if( _thread.joinable() ) {
+            _thread.join();
+        }
+    }
+
+    void Start(PlannerBasePtr planner, TrajectoryBasePtr traj, int planningoptions)
+    {
+        _thread = std::thread(&PlanPathAsyncHandle::_Run, this, planner, traj, planningoptions);
+    }
+
+    virtual void Cancel()
+    {
+        _ptoken->Cancel();
+    }
+
+    virtual bool IsDone() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _bDone;
+    }
+
+    virtual bool Wait(double timeout)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if( timeout < 0 ) {
+            _condDone.wait(lock, [this]() {
+                return _bDone;
+            });
+            return true;
+        }
+        return _condDone.wait_for(lock, std::chrono::duration<double>(timeout), [this]() {
+            return _bDone;
+        });
+    }
+
+    virtual PlannerStatus GetStatus()
+    {
+        Wait(-1);
+        std::lock_guard<std::mutex> lock(_mutex);
+        if( !!_exception ) {
+            std::rethrow_exception(_exception);
+        }
+        return _status;
+    }
+
+    virtual PlannerBase::PlannerProgress GetProgress() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _progress;
+    }
+
+private:
+    void _Run(PlannerBasePtr planner, TrajectoryBasePtr traj, int planningoptions)
+    {
+        PlannerStatus status;
+        std::exception_ptr exception;
+        try {
+            // the thread destroying the handle can hold the environment lock, so keep checking the token while waiting for it
+            EnvironmentLock lockenv(planner->GetEnv()->GetMutex(), OpenRAVE::defer_lock_t());
+            while( !lockenv.try_lock() ) {
+                if( _ptoken->IsCancelled() ) {
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            if( !lockenv ) {
+                status = PlannerStatus(str(boost::format("env=%s, planning was cancelled before the environment lock was acquired")%planner->GetEnv()->GetNameId()), PS_Interrupted);
+                _SetDone(status, exception);
+                return;
+            }
+            TaskCancellationTokenPtr poldtoken = planner->GetCancellationToken();
+            planner->SetCancellationToken(_ptoken);
+            try {
+                UserDataPtr callbackhandle = planner->RegisterPlanCallback(boost::bind(&PlanPathAsyncHandle::_PlanCallback, this, _1));
+                status = planner->PlanPath(traj, planningoptions);
+            }
+            catch(...) {
+                planner->SetCancellationToken(poldtoken);
+                throw;
+            }
+            planner->SetCancellationToken(poldtoken);
+        }
+        catch(...) {
+            exception = std::current_exception();
+        }
+        _SetDone(status, exception);
+    }
+
+    void _SetDone(const PlannerStatus& status, std::exception_ptr exception)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _status = status;
+            _exception = exception;
+            _bDone = true;
+        }
+        _condDone.notify_all();
+    }
+
+    PlannerAction _PlanCallback(const PlannerBase::PlannerProgress& progress)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _progress = progress;
+        // the planners wrapping others without passing their token still interrupt through the callbacks
+        return _ptoken->IsCancelled() ? PA_Interrupt : PA_None;
+    }
+
+    std::thread _thread;
+    TaskCancellationTokenPtr _ptoken; ///< set on the planner while planning
+    mutable std::mutex _mutex; ///< protects the members below
+    std::condition_variable _condDone;
+    bool _bDone;
+    PlannerBase::PlannerProgress _progress;
+    PlannerStatus _status;
+    std::exception_ptr _exception; ///< set if PlanPath threw
+};
+
 PlannerStatus PlannerBase::InitPlan(RobotBasePtr pbase, std::istream& isParameters)
 {
     RAVELOG_WARN(str(boost::format("using default planner parameters structure to de-serialize parameters data inside %s, information might be lost!! Please define a InitPlan(robot,stream) function!\n")%GetXMLId()));
@@ -1167,18 +1430,45 @@ UserDataPtr PlannerBase::RegisterPlanCallback(const PlanCallbackFn& callbackfn)
 {
     CustomPlannerCallbackDataPtr pdata(new CustomPlannerCallbackData(callbackfn,shared_planner()));
     pdata->_iterator = __listRegisteredCallbacks.insert(__listRegisteredCallbacks.end(),pdata);
+    ++__nNumRegisteredCallbacks;
     return pdata;
 }
 
+void PlannerBase::SetPlanCallbackPeriod(dReal period)
+{
+    __nCallbackPeriodUs = period > 0 ? (uint64_t)(period*1e6) : 0;
+    __nLastCallbackTimeUs = 0;
+}
+
+void PlannerBase::SetCancellationToken(TaskCancellationTokenPtr ptoken)
+{
+    __pCancellationToken = ptoken;
+}
+
+TaskCancellationTokenPtr PlannerBase::GetCancellationToken() const
+{
+    return __pCancellationToken;
+}
+
+PlannerBase::PlanPathHandlePtr PlannerBase::PlanPathAsync(TrajectoryBasePtr traj, int planningoptions)
+{
+    boost::shared_ptr<PlanPathAsyncHandle> handle(new PlanPathAsyncHandle());
+    handle->Start(shared_planner(), traj, planningoptions);
+    return handle;
+}
+
 void PlannerBase::SetIkFailureAccumulator(IkFailureAccumulatorBasePtr& pIkFailureAccumulator)
 {
 }
 
 PlannerStatus PlannerBase::_ProcessPostPlanners(RobotBasePtr probot, TrajectoryBasePtr ptraj)
 {
+    OPENRAVE_TRACE_SCOPE("PlannerBase::_ProcessPostPlanners");
     if( GetParameters()->_sPostProcessingPlanner.size() == 0 ) {
         __cachePostProcessPlanner.reset();
-        return PlannerStatus(PS_HasSolution);
+        PlannerStatus status(PS_HasSolution);
+        status.profile = GetParameters()->_profile;
+        return status;
     }
     if( !__cachePostProcessPlanner || __cachePostProcessPlanner->GetXMLId() != GetParameters()->_sPostProcessingPlanner ) {
         __cachePostProcessPlanner = RaveCreatePlanner(GetEnv(), GetParameters()->_sPostProcessingPlanner);
@@ -1198,6 +1488,7 @@ PlannerStatus PlannerBase::_ProcessPostPlanners(RobotBasePtr probot, TrajectoryB
             listhandles.push_back(__cachePostProcessPlanner->RegisterPlanCallback(pitdata->_callbackfn));
         }
     }
+    __cachePostProcessPlanner->SetCancellationToken(__pCancellationToken);
 
     PlannerParametersPtr params(new PlannerParameters());
     params->copy(GetParameters());
@@ -1209,8 +1500,10 @@ PlannerStatus PlannerBase::_ProcessPostPlanners(RobotBasePtr probot, TrajectoryB
 
     PlannerStatus status =  __cachePostProcessPlanner->InitPlan(probot, params);
    if( (status.GetStatusCode() & PS_HasSolution)) {
-        return __cachePostProcessPlanner->PlanPath(ptraj);
+        status = __cachePostProcessPlanner->PlanPath(ptraj);
     }
+    // the post-processing planner shares the profile of the parameters
+    status.profile = GetParameters()->_profile;
 
     // do not fall back to a default linear smoother like in the past! that makes behavior unpredictable
     return status;
@@ -1218,6 +1511,19 @@ PlannerStatus PlannerBase::_ProcessPostPlanners(RobotBasePtr probot, TrajectoryB
 
 PlannerAction PlannerBase::_CallCallbacks(const PlannerProgress& progress)
 {
+    if( _IsCancelled() ) {
+        return PA_Interrupt;
+    }
+    if( !_HasCallbacks() ) {
+        return PA_None;
+    }
+    if( __nCallbackPeriodUs > 0 ) {
+        uint64_t curtime = utils::GetMicroTime();
+        if( __nLastCallbackTimeUs > 0 && curtime - __nLastCallbackTimeUs < __nCallbackPeriodUs ) {
+            return PA_None;
+        }
+        __nLastCallbackTimeUs = curtime;
+    }
     FOREACHC(it,__listRegisteredCallbacks) {
         CustomPlannerCallbackDataPtr pitdata = boost::dynamic_pointer_cast<CustomPlannerCallbackData>(it->lock());
         if( !!pitdata) {
@@ -587,23 +587,9 @@ void VerifyTrajectory(PlannerBase::PlannerParametersConstPtr parameters, Traject
     v.VerifyTrajectory(trajectory,samplingstep);
 }
 
-PlannerStatus _PlanActiveDOFTrajectory(TrajectoryBasePtr traj, RobotBasePtr probot, bool hastimestamps, dReal fmaxvelmult, dReal fmaxaccelmult, const std::string& plannername, bool bsmooth, const std::string& plannerparameters)
+/// \brief parameters to retime or smooth a trajectory of the active dofs of probot
+static TrajectoryTimingParametersPtr _CreateActiveDOFTimingParameters(RobotBasePtr probot, bool hastimestamps, dReal fmaxvelmult, dReal fmaxaccelmult, bool bsmooth, const std::string& plannerparameters)
 {
-    if( traj->GetNumWaypoints() == 1 ) {
-        // don't need velocities, but should at least add a time group
-        ConfigurationSpecification spec = traj->GetConfigurationSpecification();
-        spec.AddDeltaTimeGroup();
-        vector<dReal> data;
-        traj->GetWaypoints(0,traj->GetNumWaypoints(),data,spec);
-        traj->Init(spec);
-        traj->Insert(0,data);
-        return PlannerStatus(PS_HasSolution);
-    }
-
-    EnvironmentBasePtr env = traj->GetEnv();
-    EnvironmentLock lockenv(env->GetMutex());
-    CollisionOptionsStateSaver optionstate(env->GetCollisionChecker(),env->GetCollisionChecker()->GetCollisionOptions()|CO_ActiveDOFs,false);
-    PlannerBasePtr planner = RaveCreatePlanner(env,plannername.size() > 0 ? plannername : string("parabolicsmoother"));
     TrajectoryTimingParametersPtr params(new TrajectoryTimingParameters());
     params->SetRobotActiveJoints(probot);
     FOREACH(it,params->_vConfigVelocityLimit) {
@@ -620,6 +606,27 @@ PlannerStatus _PlanActiveDOFTrajectory(TrajectoryBasePtr traj, RobotBasePtr prob
     params->_sPostProcessingPlanner = ""; // have to turn off the second post processing stage
     params->_hastimestamps = hastimestamps;
     params->_sExtraParameters += plannerparameters;
+    return params;
+}
+
+PlannerStatus _PlanActiveDOFTrajectory(TrajectoryBasePtr traj, RobotBasePtr probot, bool hastimestamps, dReal fmaxvelmult, dReal fmaxaccelmult, const std::string& plannername, bool bsmooth, const std::string& plannerparameters)
+{
+    if( traj->GetNumWaypoints() == 1 ) {
+        // don't need velocities, but should at least add a time group
+        ConfigurationSpecification spec = traj->GetConfigurationSpecification();
+        spec.AddDeltaTimeGroup();
+        vector<dReal> data;
+        traj->GetWaypoints(0,traj->GetNumWaypoints(),data,spec);
+        traj->Init(spec);
+        traj->Insert(0,data);
+        return PlannerStatus(PS_HasSolution);
+    }
+
+    EnvironmentBasePtr env = traj->GetEnv();
+    EnvironmentLock lockenv(env->GetMutex());
+    CollisionOptionsStateSaver optionstate(env->GetCollisionChecker(),env->GetCollisionChecker()->GetCollisionOptions()|CO_ActiveDOFs,false);
+    PlannerBasePtr planner = RaveCreatePlanner(env,plannername.size() > 0 ? plannername : string("parabolicsmoother"));
+    TrajectoryTimingParametersPtr params = _CreateActiveDOFTimingParameters(probot, hastimestamps, fmaxvelmult, fmaxaccelmult, bsmooth, plannerparameters);
 
     PlannerStatus statusFromInit = planner->InitPlan(probot,params);
     if( !(statusFromInit.GetStatusCode() & PS_HasSolution) ) {
@@ -1371,6 +1378,133 @@ PlannerStatus RetimeRobotDOFTrajectory(TrajectoryBasePtr traj, RobotBasePtr robo
     return _PlanActiveDOFTrajectory(traj, robot, hastimestamps, fmaxvelmult, fmaxaccelmult, GetPlannerFromInterpolation(traj, plannername), /*bsmooth*/ false, plannerparameters);
 }
 
+ActiveDOFTrajectoryPlannerCache::ActiveDOFTrajectoryPlannerCache(size_t maxplanners) : _nMaxPlanners(std::max(maxplanners, (size_t)1))
+{
+}
+
+PlannerStatus ActiveDOFTrajectoryPlannerCache::RetimeActiveDOFTrajectory(TrajectoryBasePtr traj, RobotBasePtr robot, bool hastimestamps, dReal fmaxvelmult, dReal fmaxaccelmult, const std::string& plannername, const std::string& plannerparameters)
+{
+    return _PlanPath(traj, robot, hastimestamps, fmaxvelmult, fmaxaccelmult, GetPlannerFromInterpolation(traj, plannername), /*bsmooth*/ false, plannerparameters);
+}
+
+PlannerStatus ActiveDOFTrajectoryPlannerCache::SmoothActiveDOFTrajectory(TrajectoryBasePtr traj, RobotBasePtr robot, dReal fmaxvelmult, dReal fmaxaccelmult, const std::string& plannername, const std::string& plannerparameters)
+{
+    return _PlanPath(traj, robot, false, fmaxvelmult, fmaxaccelmult, plannername.size() > 0 ? plannername : "parabolicsmoother", /*bsmooth*/ true, plannerparameters);
+}
+
+void ActiveDOFTrajectoryPlannerCache::Clear()
+{
+    std::list<PlannerEntry> listPlanners;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        listPlanners.swap(_listPlanners);
+    }
+    // planners are released outside of _mutex
+}
+
+size_t ActiveDOFTrajectoryPlannerCache::GetNumPlanners() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _listPlanners.size();
+}
+
+void ActiveDOFTrajectoryPlannerCache::_GetActiveDOFLimits(RobotBasePtr robot)
+{
+    robot->GetActiveDOFLimits(_vlimitscache, _vtempcache);
+    _vlimitscache.insert(_vlimitscache.end(), _vtempcache.begin(), _vtempcache.end());
+    robot->GetActiveDOFVelocityLimits(_vtempcache);
+    _vlimitscache.insert(_vlimitscache.end(), _vtempcache.begin(), _vtempcache.end());
+    robot->GetActiveDOFAccelerationLimits(_vtempcache);
+    _vlimitscache.insert(_vlimitscache.end(), _vtempcache.begin(), _vtempcache.end());
+    robot->GetActiveDOFJerkLimits(_vtempcache);
+    _vlimitscache.insert(_vlimitscache.end(), _vtempcache.begin(), _vtempcache.end());
+}
+
+PlannerStatus ActiveDOFTrajectoryPlannerCache::_PlanPath(TrajectoryBasePtr traj, RobotBasePtr robot, bool hastimestamps, dReal fmaxvelmult, dReal fmaxaccelmult, const std::string& plannername, bool bsmooth, const std::string& plannerparameters)
+{
+    if( traj->GetNumWaypoints() == 1 ) {
+        // don't need velocities, but should at least add a time group
+        ConfigurationSpecification spec = traj->GetConfigurationSpecification();
+        spec.AddDeltaTimeGroup();
+        vector<dReal> data;
+        traj->GetWaypoints(0,traj->GetNumWaypoints(),data,spec);
+        traj->Init(spec);
+        traj->Insert(0,data);
+        return PlannerStatus(PS_HasSolution);
+    }
+
+    EnvironmentBasePtr env = traj->GetEnv();
+    EnvironmentLock lockenv(env->GetMutex());
+    CollisionOptionsStateSaver optionstate(env->GetCollisionChecker(),env->GetCollisionChecker()->GetCollisionOptions()|CO_ActiveDOFs,false);
+
+    // the environment lock prevents two threads from using the same planner, the robot of every planner being in its environment
+    PlannerBasePtr planner;
+    PlannerBase::PlannerParametersPtr parameters;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _GetActiveDOFLimits(robot);
+        const std::vector<int>& vActiveDOFIndices = robot->GetActiveDOFIndices();
+        std::list<PlannerEntry>::iterator itentry = _listPlanners.begin();
+        for(; itentry != _listPlanners.end(); ++itentry) {
+            if( itentry->robot == robot && itentry->bsmooth == bsmooth && itentry->hastimestamps == hastimestamps && itentry->fmaxvelmult == fmaxvelmult && itentry->fmaxaccelmult == fmaxaccelmult
+                && itentry->nAffineDOF == robot->GetAffineDOF() && (itentry->nAffineDOF == 0 || itentry->vAffineRotationAxis == robot->GetAffineRotationAxis())
+                && itentry->vActiveDOFIndices == vActiveDOFIndices && itentry->plannername == plannername && itentry->plannerparameters == plannerparameters ) {
+                break;
+            }
+        }
+        if( itentry != _listPlanners.end() && itentry->vlimits != _vlimitscache ) {
+            // the limits of the robot changed, so have to initialize a new planner
+            _listPlanners.erase(itentry);
+            itentry = _listPlanners.end();
+        }
+
+        if( itentry == _listPlanners.end() ) {
+            PlannerEntry entry;
+            entry.robot = robot;
+            entry.vActiveDOFIndices = vActiveDOFIndices;
+            entry.nAffineDOF = robot->GetAffineDOF();
+            entry.vAffineRotationAxis = robot->GetAffineRotationAxis();
+            entry.plannername = plannername;
+            entry.plannerparameters = plannerparameters;
+            entry.fmaxvelmult = fmaxvelmult;
+            entry.fmaxaccelmult = fmaxaccelmult;
+            entry.hastimestamps = hastimestamps;
+            entry.bsmooth = bsmooth;
+            entry.vlimits = _vlimitscache;
+            entry.planner = RaveCreatePlanner(env, plannername);
+            if( !entry.planner ) {
+                throw OPENRAVE_EXCEPTION_FORMAT(_("env=%s, failed to create planner %s"), env->GetNameId()%plannername, ORE_InvalidArguments);
+            }
+            TrajectoryTimingParametersPtr params = _CreateActiveDOFTimingParameters(robot, hastimestamps, fmaxvelmult, fmaxaccelmult, bsmooth, plannerparameters);
+            PlannerStatus statusFromInit = entry.planner->InitPlan(robot,params);
+            if( !(statusFromInit.GetStatusCode() & PS_HasSolution) ) {
+                return statusFromInit;
+            }
+            entry.parameters = params; // necessary because SetRobotActiveJoints builds functions that hold weak_ptr to the parameters
+            _listPlanners.push_front(entry);
+            if( _listPlanners.size() > _nMaxPlanners ) {
+                _listPlanners.pop_back();
+            }
+        }
+        else if( itentry != _listPlanners.begin() ) {
+            _listPlanners.splice(_listPlanners.begin(), _listPlanners, itentry);
+        }
+        planner = _listPlanners.front().planner;
+        parameters = _listPlanners.front().parameters;
+    }
+
+    PlannerStatus plannerStatus = planner->PlanPath(traj);
+    if( plannerStatus.GetStatusCode() != PS_HasSolution ) {
+        return plannerStatus;
+    }
+
+    if( bsmooth && (RaveGetDebugLevel() & Level_VerifyPlans) ) {
+        RobotBase::RobotStateSaver saver(robot);
+        planningutils::VerifyTrajectory(parameters,traj);
+    }
+    return PlannerStatus(PS_HasSolution);
+}
+
 PlannerStatus RetimeAffineTrajectory(TrajectoryBasePtr traj, const std::vector<dReal>& maxvelocities, const std::vector<dReal>& maxaccelerations, bool hastimestamps, const std::string& plannername, const std::string& plannerparameters)
 {
     return _PlanAffineTrajectory(traj, maxvelocities, maxaccelerations, hastimestamps, GetPlannerFromInterpolation(traj, plannername), /*bsmooth*/ false, plannerparameters);
@@ -1638,7 +1772,7 @@ size_t InsertWaypointWithRetiming(int waypointindex, const std::vector<dReal>& d
     return waypointindex+nInitialNumWaypoints-1;
 }
 
-size_t InsertWaypointWithSmoothing(int index, const std::vector<dReal>& dofvalues, const std::vector<dReal>& dofvelocities, TrajectoryBasePtr traj, dReal fmaxvelmult, dReal fmaxaccelmult, const std::string& plannername)
+size_t InsertWaypointWithSmoothing(int index, const std::vector<dReal>& dofvalues, const std::vector<dReal>& dofvelocities, TrajectoryBasePtr traj, dReal fmaxvelmult, dReal fmaxaccelmult, const std::string& plannername, int maxwindowwaypoints)
 {
     TrajectoryTimingParametersPtr params(new TrajectoryTimingParameters());
     ConfigurationSpecification specpos = traj->GetConfigurationSpecification().GetTimeDerivativeSpecification(0);
@@ -1663,10 +1797,10 @@ size_t InsertWaypointWithSmoothing(int index, const std::vector<dReal>& dofvalue
         throw OPENRAVE_EXCEPTION_FORMAT(_("failed to init planner %s:%s"), plannername%(orjson::DumpJson(rStatus)), ORE_InvalidArguments);
     }
 
-    return InsertWaypointWithSmoothing(index, dofvalues, dofvelocities, traj, planner);
+    return InsertWaypointWithSmoothing(index, dofvalues, dofvelocities, traj, planner, maxwindowwaypoints);
 }
 
-size_t InsertWaypointWithSmoothing(int index, const std::vector<dReal>& dofvalues, const std::vector<dReal>& dofvelocities, TrajectoryBasePtr traj, PlannerBasePtr planner)
+size_t InsertWaypointWithSmoothing(int index, const std::vector<dReal>& dofvalues, const std::vector<dReal>& dofvelocities, TrajectoryBasePtr traj, PlannerBasePtr planner, int maxwindowwaypoints)
 {
     if( index != (int)traj->GetNumWaypoints() ) {
         throw OPENRAVE_EXCEPTION_FORMAT0(_("InsertWaypointWithSmoothing only supports adding waypoints at the end"),ORE_InvalidArguments);
@@ -1693,6 +1827,8 @@ size_t InsertWaypointWithSmoothing(int index, const std::vector<dReal>& dofvalue
     std::copy(dofvelocities.begin(),dofvelocities.end(),vstartdata.begin()+dofvalues.size());
     // look for the waypoints in reverse
     int N = (int)traj->GetNumWaypoints();
+    // only the waypoints of the window can start the new segment, the rest of the trajectory is never re-smoothed
+    int numwindowwaypoints = maxwindowwaypoints > 0 ? min(N, maxwindowwaypoints) : N;
     dReal fOriginalTime = traj->GetDuration();
     dReal fRemainingDuration=traj->GetDuration();
     int iTimeIndex = -1;
@@ -1703,7 +1839,7 @@ size_t InsertWaypointWithSmoothing(int index, const std::vector<dReal>& dofvalue
 
     // since inserting from the back, go through each of the waypoints from reverse and record collision free segments
     // perhaps a faster method would be to delay the collision checking until all the possible segments are already checked...?
-    for(int iwaypoint = 0; iwaypoint < N; ++iwaypoint) {
+    for(int iwaypoint = 0; iwaypoint < numwindowwaypoints; ++iwaypoint) {
         traj->GetWaypoint(N-1-iwaypoint,vwaypoint);
         dReal deltatime = 0;
         if( iTimeIndex >= 0 ) {
@@ -1764,8 +1900,7 @@ size_t InsertWaypointWithSmoothing(int index, const std::vector<dReal>& dofvalue
     if( fBestDuration > fOriginalTime+fTimeBuffer ) {
         RAVELOG_WARN(str(boost::format("new trajectory is greater than expected time %f > %f \n")%fBestDuration%fOriginalTime));
     }
-    // splice in the new trajectory. pBestTrajectory's first waypoint matches traj's iBestInsertionWaypoint
-    traj->Remove(iBestInsertionWaypoint+1,traj->GetNumWaypoints());
+    // splice in the new trajectory. pBestTrajectory's first waypoint matches traj's iBestInsertionWaypoint, so overwrite the waypoints after it and only remove or add the difference
     //    traj->GetWaypoint(iBestInsertionWaypoint,vprevpoint);
     //    pBestTrajectory->GetWaypoint(0,vwaypoint,traj->GetConfigurationSpecification());
     //    for(size_t i = 0; i < vprevpoint.size(); ++i) {
@@ -1774,7 +1909,12 @@ size_t InsertWaypointWithSmoothing(int index, const std::vector<dReal>& dofvalue
     //        }
     //    }
     pBestTrajectory->GetWaypoints(1,pBestTrajectory->GetNumWaypoints(),vwaypoint,traj->GetConfigurationSpecification());
-    traj->Insert(iBestInsertionWaypoint+1,vwaypoint);
+    int numnewwaypoints = (int)pBestTrajectory->GetNumWaypoints()-1;
+    int numoldwaypoints = N-1-iBestInsertionWaypoint;
+    if( numoldwaypoints > numnewwaypoints ) {
+        traj->Remove(iBestInsertionWaypoint+1+numnewwaypoints,N);
+    }
+    traj->Insert(iBestInsertionWaypoint+1,vwaypoint,true);
     dReal fNewDuration = traj->GetDuration();
     OPENRAVE_ASSERT_OP( RaveFabs(fNewDuration-fBestDuration), <=, 0.001 );
     return iBestInsertionWaypoint+pBestTrajectory->GetNumWaypoints();
@@ -2094,7 +2234,12 @@ TrajectoryBasePtr MergeTrajectories(const std::list<TrajectoryBaseConstPtr>& lis
 
     ConfigurationSpecification spec;
     vector<dReal> vpointdata;
-    vector<dReal> vtimes; vtimes.reserve(listtrajectories.front()->GetNumWaypoints());
+    vector<dReal> vtimes;
+    size_t numtotalwaypoints = 0;
+    FOREACHC(ittraj,listtrajectories) {
+        numtotalwaypoints += (*ittraj)->GetNumWaypoints();
+    }
+    vtimes.reserve(numtotalwaypoints);
     // int totaldof = 1; // for delta time
     FOREACHC(ittraj,listtrajectories) {
         const ConfigurationSpecification& trajspec = (*ittraj)->GetConfigurationSpecification();
@@ -2104,16 +2249,21 @@ TrajectoryBasePtr MergeTrajectories(const std::list<TrajectoryBaseConstPtr>& lis
         // if( trajspec.FindCompatibleGroup("iswaypoint",true) != trajspec._vgroups.end() ) {
         //     totaldof -= 1;
         // }
+        size_t numwaypoints = (*ittraj)->GetNumWaypoints();
+        if( numwaypoints == 0 ) {
+            continue;
+        }
+        (*ittraj)->GetWaypoints(0,numwaypoints,vpointdata);
+        int trajdof = trajspec.GetDOF();
         dReal curtime = 0;
-        for(size_t ipoint = 0; ipoint < (*ittraj)->GetNumWaypoints(); ++ipoint) {
-            (*ittraj)->GetWaypoint(ipoint,vpointdata);
-            curtime += vpointdata.at(gtime.offset);
-            vector<dReal>::iterator it = lower_bound(vtimes.begin(),vtimes.end(),curtime);
-            if( *it != curtime ) {
-                vtimes.insert(it,curtime);
-            }
+        for(size_t ipoint = 0; ipoint < numwaypoints; ++ipoint) {
+            curtime += vpointdata.at(ipoint*trajdof+gtime.offset);
+            vtimes.push_back(curtime);
         }
     }
+    // merge the time grids of all the trajectories
+    sort(vtimes.begin(),vtimes.end());
+    vtimes.erase(unique(vtimes.begin(),vtimes.end()),vtimes.end());
 
     vector<ConfigurationSpecification::Group>::const_iterator itwaypointgroup = spec.FindCompatibleGroup("iswaypoint",true);
     vector<dReal> vwaypoints;
@@ -2132,37 +2282,30 @@ TrajectoryBasePtr MergeTrajectories(const std::list<TrajectoryBaseConstPtr>& lis
         return presulttraj;
     }
 
-    // need to find all waypoints
-    vector<dReal> vtemp, vnewdata;
+    // sample every trajectory on the merged grid in its own specification, then convert all the points at once with a plan compiled for the trajectory
+    vector<dReal> vnewdata(vtimes.size()*spec.GetDOF(),0);
+    ConfigurationSpecification::ConversionPlan conversionplan;
     stringstream sdesc;
     int deltatimeoffset = spec.GetGroupFromName("deltatime").offset;
+    bool bfirsttraj = true;
     FOREACHC(ittraj,listtrajectories) {
-        vector<ConfigurationSpecification::Group>::const_iterator itwaypointgrouptraj = (*ittraj)->GetConfigurationSpecification().FindCompatibleGroup("iswaypoint",true);
+        const ConfigurationSpecification& trajspec = (*ittraj)->GetConfigurationSpecification();
+        vector<ConfigurationSpecification::Group>::const_iterator itwaypointgrouptraj = trajspec.FindCompatibleGroup("iswaypoint",true);
         int waypointoffset = -1;
-        if( itwaypointgrouptraj != (*ittraj)->GetConfigurationSpecification()._vgroups.end() ) {
+        if( itwaypointgrouptraj != trajspec._vgroups.end() ) {
             waypointoffset = itwaypointgrouptraj->offset;
         }
-        if( vnewdata.size() == 0 ) {
-            vnewdata.reserve(vtimes.size()*spec.GetDOF());
-            for(size_t i = 0; i < vtimes.size(); ++i) {
-                (*ittraj)->Sample(vtemp,vtimes[i],spec);
-                vnewdata.insert(vnewdata.end(),vtemp.begin(),vtemp.end());
-                if( waypointoffset >= 0 ) {
-                    vwaypoints[i] += vtemp[itwaypointgroup->offset]; // have to use the final spec's offset
-                }
-            }
-        }
-        else {
-            vpointdata.resize(0);
+        int trajdof = trajspec.GetDOF();
+        (*ittraj)->SamplePoints(vpointdata,vtimes);
+        if( waypointoffset >= 0 && itwaypointgroup != spec._vgroups.end() ) {
             for(size_t i = 0; i < vtimes.size(); ++i) {
-                (*ittraj)->Sample(vtemp,vtimes[i]);
-                vpointdata.insert(vpointdata.end(),vtemp.begin(),vtemp.end());
-                if( waypointoffset >= 0 ) {
-                    vwaypoints[i] += vtemp[itwaypointgroup->offset]; // have to use the final spec's offset
-                }
+                vwaypoints[i] += vpointdata[i*trajdof+waypointoffset];
             }
-            ConfigurationSpecification::ConvertData(vnewdata.begin(),spec,vpointdata.begin(),(*ittraj)->GetConfigurationSpecification(),vtimes.size(),presulttraj->GetEnv(),false);
         }
+        // the first trajectory also fills the groups that no trajectory has
+        conversionplan.Compile(spec,trajspec,presulttraj->GetEnv(),bfirsttraj);
+        conversionplan.Apply(vnewdata.begin(),vpointdata.begin(),vtimes.size());
+        bfirsttraj = false;
 
         sdesc << (*ittraj)->GetDescription() << endl;
     }
@@ -2182,6 +2325,257 @@ TrajectoryBasePtr MergeTrajectories(const std::list<TrajectoryBaseConstPtr>& lis
     return presulttraj;
 }
 
+/// \brief plans the path of the robot of task in the environment of ptraj and retimes it if the planner did not
+static PlannerStatus _PlanPrioritizedRobotPath(const PrioritizedRobotPlanningTask& task, PlannerBase::PlannerParametersConstPtr parameters, TrajectoryBasePtr ptraj)
+{
+    EnvironmentBasePtr penv = ptraj->GetEnv();
+    const std::string plannername = task.plannername.size() > 0 ? task.plannername : string("birrt");
+    PlannerBasePtr planner = RaveCreatePlanner(penv, plannername);
+    if( !planner ) {
+        return PlannerStatus(str(boost::format("env=%s, failed to create planner %s")%penv->GetNameId()%plannername), PS_Failed);
+    }
+    PlannerStatus status = planner->InitPlan(RobotBasePtr(), parameters);
+    if( !(status.GetStatusCode() & PS_HasSolution) ) {
+        return status;
+    }
+    status = planner->PlanPath(ptraj);
+    if( !(status.GetStatusCode() & PS_HasSolution) ) {
+        return status;
+    }
+    const ConfigurationSpecification& spec = ptraj->GetConfigurationSpecification();
+    if( spec.FindCompatibleGroup("deltatime", true) == spec._vgroups.end() ) {
+        status = RetimeTrajectory(ptraj, false, task.fmaxvelmult, task.fmaxaccelmult, task.retimername);
+    }
+    return status;
+}
+
+/// \brief plans the robot of vtasks[itask] on a cloned environment ignoring the robots before it
+static PlannerStatus _PlanPrioritizedRobotOnClone(EnvironmentBasePtr pcloneenv, const std::vector<PrioritizedRobotPlanningTask>& vtasks, size_t itask, TrajectoryBasePtr& ptraj)
+{
+    EnvironmentLock lock(pcloneenv->GetMutex());
+    const PrioritizedRobotPlanningTask& task = vtasks[itask];
+    for(size_t iprevious = 0; iprevious < itask; ++iprevious) {
+        KinBodyPtr pclonedbody = pcloneenv->GetKinBody(vtasks[iprevious].probot->GetName());
+        if( !!pclonedbody ) {
+            pclonedbody->Enable(false);
+        }
+    }
+    // bind the state functions to the cloned bodies, SetConfigurationSpecification resets the initial configuration
+    PlannerBase::PlannerParametersPtr pclonedparameters(new PlannerBase::PlannerParameters());
+    pclonedparameters->copy(task.parameters);
+    pclonedparameters->SetConfigurationSpecification(pcloneenv, task.parameters->_configurationspecification);
+    pclonedparameters->vinitialconfig = task.parameters->vinitialconfig;
+    pclonedparameters->vgoalconfig = task.parameters->vgoalconfig;
+    ptraj = RaveCreateTrajectory(pcloneenv, "");
+    return _PlanPrioritizedRobotPath(task, pclonedparameters, ptraj);
+}
+
+/// \brief sets the robot of task to its configuration at time from its start, it waits at its initial configuration before and at its final configuration after
+static void _SetPrioritizedRobotState(const PrioritizedRobotPlanningTask& task, dReal time, std::vector<dReal>& vvalues)
+{
+    task.ptraj->Sample(vvalues, max(dReal(0), min(time, task.ptraj->GetDuration())), task.parameters->_configurationspecification);
+    task.parameters->SetStateValues(vvalues, 0);
+}
+
+/// \brief bounds of the robot of task sampled along its trajectory
+static void _ComputePrioritizedRobotSweptAABB(const PrioritizedRobotPlanningTask& task, dReal fTimeStep, Vector& vmin, Vector& vmax, std::vector<dReal>& vvalues)
+{
+    const dReal fDuration = task.ptraj->GetDuration();
+    const int numsteps = (int)ceil(fDuration/fTimeStep);
+    for(int istep = 0; istep <= numsteps; ++istep) {
+        _SetPrioritizedRobotState(task, istep*fTimeStep, vvalues);
+        const AABB ab = task.probot->ComputeAABB();
+        if( istep == 0 ) {
+            vmin = ab.pos - ab.extents;
+            vmax = ab.pos + ab.extents;
+        }
+        else {
+            for(int j = 0; j < 3; ++j) {
+                vmin[j] = min(vmin[j], ab.pos[j] - ab.extents[j]);
+                vmax[j] = max(vmax[j], ab.pos[j] + ab.extents[j]);
+            }
+        }
+    }
+}
+
+/// \brief checks the robot of vtasks[itask] started at fStartDelay against the robots of voverlapping at every time step until all of them stop
+///
+/// \return true if it does not collide with them
+static bool _CheckPrioritizedRobotThroughTime(const std::vector<PrioritizedRobotPlanningTask>& vtasks, size_t itask, const std::vector<size_t>& voverlapping, dReal fStartDelay, dReal fTimeStep, std::vector<dReal>& vvalues)
+{
+    const PrioritizedRobotPlanningTask& task = vtasks[itask];
+    EnvironmentBasePtr penv = task.probot->GetEnv();
+    dReal fEndTime = fStartDelay + task.ptraj->GetDuration();
+    FOREACHC(itother, voverlapping) {
+        fEndTime = max(fEndTime, vtasks[*itother].fStartDelay + vtasks[*itother].ptraj->GetDuration());
+    }
+    const int numsteps = (int)ceil(fEndTime/fTimeStep);
+    for(int istep = 0; istep <= numsteps; ++istep) {
+        const dReal time = min(istep*fTimeStep, fEndTime);
+        _SetPrioritizedRobotState(task, time - fStartDelay, vvalues);
+        FOREACHC(itother, voverlapping) {
+            const PrioritizedRobotPlanningTask& othertask = vtasks[*itother];
+            _SetPrioritizedRobotState(othertask, time - othertask.fStartDelay, vvalues);
+            if( penv->CheckCollision(KinBodyConstPtr(task.probot), KinBodyConstPtr(othertask.probot)) ) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/// \brief the robots before itask whose swept bounds overlap the swept bounds of itask
+static void _GetPrioritizedOverlappingRobots(const std::vector<Vector>& vsweptmin, const std::vector<Vector>& vsweptmax, size_t itask, std::vector<size_t>& voverlapping)
+{
+    voverlapping.resize(0);
+    for(size_t iprevious = 0; iprevious < itask; ++iprevious) {
+        bool bDisjoint = false;
+        for(int j = 0; j < 3; ++j) {
+            if( vsweptmin[itask][j] > vsweptmax[iprevious][j] || vsweptmax[itask][j] < vsweptmin[iprevious][j] ) {
+                bDisjoint = true;
+                break;
+            }
+        }
+        if( !bDisjoint ) {
+            voverlapping.push_back(iprevious);
+        }
+    }
+}
+
+/// \brief makes the trajectory wait at its first waypoint for fStartDelay
+static void _DelayTrajectoryStart(TrajectoryBasePtr ptraj, dReal fStartDelay)
+{
+    if( fStartDelay <= 0 || ptraj->GetNumWaypoints() == 0 ) {
+        return;
+    }
+    const int deltatimeoffset = ptraj->GetConfigurationSpecification().GetGroupFromName("deltatime").offset;
+    std::vector<dReal> vfirstwaypoint, vstartwaypoint;
+    ptraj->GetWaypoint(0, vfirstwaypoint);
+    vstartwaypoint = vfirstwaypoint;
+    vfirstwaypoint.at(deltatimeoffset) += fStartDelay;
+    ptraj->Insert(0, vfirstwaypoint, true);
+    vstartwaypoint.at(deltatimeoffset) = 0;
+    ptraj->Insert(0, vstartwaypoint);
+}
+
+PlannerStatus PlanPrioritizedMultiRobotTrajectory(TrajectoryBasePtr ptraj, std::vector<PrioritizedRobotPlanningTask>& vtasks, dReal fTimeStep, dReal fMaxStartDelay, bool bParallel)
+{
+    EnvironmentBasePtr penv = ptraj->GetEnv();
+    OPENRAVE_ASSERT_OP(fTimeStep,>,0);
+    std::vector<KinBody::KinBodyStateSaverPtr> vsavers;
+    vsavers.reserve(vtasks.size());
+    FOREACHC(ittask, vtasks) {
+        if( !ittask->probot || !ittask->parameters ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("env=%s, task %d of the prioritized planning needs a robot and planner parameters"), penv->GetNameId()%(ittask-vtasks.begin()), ORE_InvalidArguments);
+        }
+        if( ittask->probot->GetEnv() != penv ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("env=%s, robot %s of the prioritized planning is not in the environment of the trajectory"), penv->GetNameId()%ittask->probot->GetName(), ORE_InvalidArguments);
+        }
+        vsavers.push_back(KinBody::KinBodyStateSaverPtr(new KinBody::KinBodyStateSaver(ittask->probot, KinBody::Save_LinkTransformation|KinBody::Save_LinkEnable)));
+    }
+
+    // first pass: every robot ignores the robots before it, so all of them can be planned at once
+    std::vector<PlannerStatus> vstatuses(vtasks.size());
+    std::vector<TrajectoryBasePtr> vtrajs(vtasks.size());
+    if( bParallel && vtasks.size() > 1 ) {
+        std::vector<EnvironmentBasePtr> vcloneenvs(vtasks.size());
+        for(size_t itask = 0; itask < vtasks.size(); ++itask) {
+            vcloneenvs[itask] = penv->CloneSelf(str(boost::format("%s_prioritized%d")%penv->GetName()%itask), Clone_Bodies);
+        }
+        RaveParallelFor(vtasks.size(), [&](size_t itask) {
+            vstatuses[itask] = _PlanPrioritizedRobotOnClone(vcloneenvs[itask], vtasks, itask, vtrajs[itask]);
+        });
+        for(size_t itask = 0; itask < vtasks.size(); ++itask) {
+            if( !!vtrajs[itask] ) {
+                TrajectoryBasePtr ptrajcloned = vtrajs[itask];
+                vtrajs[itask] = RaveCreateTrajectory(penv, ptrajcloned->GetXMLId());
+                vtrajs[itask]->Clone(ptrajcloned, 0);
+            }
+            vcloneenvs[itask]->Destroy();
+        }
+    }
+    else {
+        for(size_t itask = 0; itask < vtasks.size(); ++itask) {
+            for(size_t iother = 0; iother < vtasks.size(); ++iother) {
+                vtasks[iother].probot->Enable(iother >= itask);
+            }
+            vtrajs[itask] = RaveCreateTrajectory(penv, "");
+            vstatuses[itask] = _PlanPrioritizedRobotPath(vtasks[itask], vtasks[itask].parameters, vtrajs[itask]);
+        }
+        FOREACH(itsaver, vsavers) {
+            (*itsaver)->Restore();
+        }
+    }
+    for(size_t itask = 0; itask < vtasks.size(); ++itask) {
+        if( !(vstatuses[itask].GetStatusCode() & PS_HasSolution) ) {
+            RAVELOG_WARN_FORMAT("env=%s, failed to plan robot %s: %s", penv->GetNameId()%vtasks[itask].probot->GetName()%vstatuses[itask].description);
+            return vstatuses[itask];
+        }
+        vtasks[itask].ptraj = vtrajs[itask];
+        vtasks[itask].fStartDelay = 0;
+    }
+
+    // second pass in priority order: delay every robot until it does not hit the robots before it whose swept volumes overlap its own
+    std::vector<dReal> vvalues;
+    std::vector<Vector> vsweptmin(vtasks.size()), vsweptmax(vtasks.size());
+    std::vector<size_t> voverlapping;
+    for(size_t itask = 0; itask < vtasks.size(); ++itask) {
+        PrioritizedRobotPlanningTask& task = vtasks[itask];
+        _ComputePrioritizedRobotSweptAABB(task, fTimeStep, vsweptmin[itask], vsweptmax[itask], vvalues);
+        _GetPrioritizedOverlappingRobots(vsweptmin, vsweptmax, itask, voverlapping);
+        if( voverlapping.size() == 0 ) {
+            continue;
+        }
+
+        bool bSuccess = false;
+        for(dReal fStartDelay = 0; fStartDelay <= fMaxStartDelay; fStartDelay += fTimeStep) {
+            if( _CheckPrioritizedRobotThroughTime(vtasks, itask, voverlapping, fStartDelay, fTimeStep, vvalues) ) {
+                task.fStartDelay = fStartDelay;
+                bSuccess = true;
+                break;
+            }
+        }
+        if( !bSuccess ) {
+            // replan around all the robots before it at their final configurations and start once all of them are done, since the new path
+            // can sweep through robots that did not overlap the old one. The robot waits at its initial configuration that they were planned around.
+            RAVELOG_DEBUG_FORMAT("env=%s, robot %s collides with the robots before it for all the start delays, replanning after them", penv->GetNameId()%task.probot->GetName());
+            dReal fStartDelay = 0;
+            for(size_t iprevious = 0; iprevious < itask; ++iprevious) {
+                const PrioritizedRobotPlanningTask& othertask = vtasks[iprevious];
+                othertask.probot->Enable(true);
+                _SetPrioritizedRobotState(othertask, othertask.ptraj->GetDuration(), vvalues);
+                fStartDelay = max(fStartDelay, othertask.fStartDelay + othertask.ptraj->GetDuration());
+            }
+            task.parameters->SetStateValues(task.parameters->vinitialconfig, 0);
+            TrajectoryBasePtr preplannedtraj = RaveCreateTrajectory(penv, "");
+            PlannerStatus status = _PlanPrioritizedRobotPath(task, task.parameters, preplannedtraj);
+            FOREACH(itsaver, vsavers) {
+                (*itsaver)->Restore();
+            }
+            if( !(status.GetStatusCode() & PS_HasSolution) ) {
+                RAVELOG_WARN_FORMAT("env=%s, failed to replan robot %s after the robots before it: %s", penv->GetNameId()%task.probot->GetName()%status.description);
+                return status;
+            }
+            task.ptraj = preplannedtraj;
+            _ComputePrioritizedRobotSweptAABB(task, fTimeStep, vsweptmin[itask], vsweptmax[itask], vvalues);
+            _GetPrioritizedOverlappingRobots(vsweptmin, vsweptmax, itask, voverlapping);
+            if( !_CheckPrioritizedRobotThroughTime(vtasks, itask, voverlapping, fStartDelay, fTimeStep, vvalues) ) {
+                return PlannerStatus(str(boost::format("env=%s, robot %s collides with the robots before it")%penv->GetNameId()%task.probot->GetName()), PS_Failed);
+            }
+            task.fStartDelay = fStartDelay;
+        }
+        RAVELOG_VERBOSE_FORMAT("env=%s, robot %s starts after %fs", penv->GetNameId()%task.probot->GetName()%task.fStartDelay);
+    }
+
+    std::list<TrajectoryBaseConstPtr> listtrajectories;
+    FOREACH(ittask, vtasks) {
+        _DelayTrajectoryStart(ittask->ptraj, ittask->fStartDelay);
+        listtrajectories.push_back(ittask->ptraj);
+    }
+    ptraj->Clone(MergeTrajectories(listtrajectories), 0);
+    return PlannerStatus(PS_HasSolution);
+}
+
 void GetDHParameters(std::vector<DHParameter>& vparameters, KinBodyConstPtr pbody)
 {
     EnvironmentLock lockenv(pbody->GetEnv()->GetMutex());
@@ -2274,7 +2668,178 @@ void GetDHParameters(std::vector<DHParameter>& vparameters, KinBodyConstPtr pbod
     }
 }
 
-DynamicsCollisionConstraint::DynamicsCollisionConstraint(PlannerBase::PlannerParametersConstPtr parameters, const std::list<KinBodyPtr>& listCheckBodies, int filtermask) : _listCheckBodies(listCheckBodies), _filtermask(filtermask), _torquelimitmode(DC_NominalTorque), _perturbation(0.1)
+ConfigurationCollisionCache::ConfigurationCollisionCache(const std::list<KinBodyPtr>& listCheckBodies, const std::vector<dReal>& vConfigResolution, size_t nMaxEntries) : _listCheckBodies(listCheckBodies), _nMaxEntries(nMaxEntries), _nBodiesUpdateStamp(0)
+{
+    BOOST_ASSERT(listCheckBodies.size()>0);
+    _penv = listCheckBodies.front()->GetEnv();
+    _vInvResolution.resize(vConfigResolution.size());
+    for(size_t i = 0; i < vConfigResolution.size(); ++i) {
+        if( vConfigResolution[i] <= 0 ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("env=%s, resolution of dof %d is %f, has to be positive"), _penv->GetNameId()%i%vConfigResolution[i], ORE_InvalidArguments);
+        }
+        _vInvResolution[i] = 1/vConfigResolution[i];
+    }
+    if( _nMaxEntries == 0 ) {
+        _nMaxEntries = 1;
+    }
+    _vkeycache.reserve(_vInvResolution.size()+1);
+    Synchronize();
+}
+
+bool ConfigurationCollisionCache::Synchronize()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    // the checked bodies and their grabbed bodies move with the configurations, so the results only depend on which bodies they are
+    _vMovingBodiesCache.resize(0);
+    FOREACHC(itcheckbody, _listCheckBodies) {
+        _vMovingBodiesCache.push_back(*itcheckbody);
+        (*itcheckbody)->GetGrabbed(_vbodiescache);
+        _vMovingBodiesCache.insert(_vMovingBodiesCache.end(), _vbodiescache.begin(), _vbodiescache.end());
+    }
+    _vbodiescache.resize(0);
+    const uint64_t nBodiesUpdateStamp = _penv->GetBodiesUpdateStamp();
+    if( _vMovingBodiesCache == _vMovingBodies ) {
+        // the bodies update stamp of the environment is incremented with the stamp of every body and when bodies are added or removed,
+        // so if the moving bodies account for all its increments, the other bodies did not change
+        uint64_t nMovingBodiesIncrements = 0;
+        for(size_t ibody = 0; ibody < _vMovingBodies.size(); ++ibody) {
+            nMovingBodiesIncrements += (uint32_t)_vMovingBodies[ibody]->GetUpdateStamp() - (uint32_t)_vMovingBodyStamps[ibody];
+        }
+        if( nBodiesUpdateStamp - _nBodiesUpdateStamp == nMovingBodiesIncrements ) {
+            for(size_t ibody = 0; ibody < _vMovingBodies.size(); ++ibody) {
+                _vMovingBodyStamps[ibody] = _vMovingBodies[ibody]->GetUpdateStamp();
+            }
+            _nBodiesUpdateStamp = nBodiesUpdateStamp;
+            return false;
+        }
+    }
+    else {
+        _vMovingBodies.swap(_vMovingBodiesCache);
+    }
+    _vMovingBodyStamps.resize(_vMovingBodies.size());
+    for(size_t ibody = 0; ibody < _vMovingBodies.size(); ++ibody) {
+        _vMovingBodyStamps[ibody] = _vMovingBodies[ibody]->GetUpdateStamp();
+    }
+    _nBodiesUpdateStamp = nBodiesUpdateStamp;
+
+    _penv->GetBodies(_vbodiescache);
+    _vEnvironmentStampsCache.resize(0);
+    FOREACHC(itbody, _vbodiescache) {
+        const KinBody& body = **itbody;
+        bool bIsCheckBody = false;
+        FOREACHC(itcheckbody, _listCheckBodies) {
+            if( itcheckbody->get() == &body ) {
+                bIsCheckBody = true;
+                break;
+            }
+        }
+        if( bIsCheckBody ) {
+            continue;
+        }
+        // grabbed bodies move with the checked bodies, so only record that they are grabbed
+        const bool bIsGrabbed = std::find(_vMovingBodies.begin(), _vMovingBodies.end(), *itbody) != _vMovingBodies.end();
+        _vEnvironmentStampsCache.emplace_back(body.GetEnvironmentBodyIndex(), bIsGrabbed ? -1 : (body.IsEnabled() ? body.GetUpdateStamp() : -2));
+    }
+    _vbodiescache.resize(0);
+    if( _vEnvironmentStampsCache == _vEnvironmentStamps ) {
+        return false;
+    }
+    _vEnvironmentStamps.swap(_vEnvironmentStampsCache);
+    if( _listEntries.size() > 0 ) {
+        _listEntries.clear();
+        _mapEntries.clear();
+        _stats.numinvalidations++;
+    }
+    return true;
+}
+
+size_t ConfigurationCollisionCache::KeyHash::operator()(const Key& key) const
+{
+    size_t hash = 0;
+    FOREACHC(it, key) {
+        hash ^= std::hash<int32_t>()(*it) + 0x9e3779b9 + (hash<<6) + (hash>>2);
+    }
+    return hash;
+}
+
+void ConfigurationCollisionCache::_ComputeKey(const std::vector<dReal>& vconfig, int collisionoptions)
+{
+    OPENRAVE_ASSERT_OP(vconfig.size(),==,_vInvResolution.size());
+    _vkeycache.resize(vconfig.size()+1);
+    for(size_t i = 0; i < vconfig.size(); ++i) {
+        _vkeycache[i] = (int32_t)std::floor(vconfig[i]*_vInvResolution[i]+0.5);
+    }
+    _vkeycache.back() = collisionoptions;
+}
+
+bool ConfigurationCollisionCache::Find(const std::vector<dReal>& vconfig, int collisionoptions, int& result)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _ComputeKey(vconfig, collisionoptions);
+    std::unordered_map<Key, EntryList::iterator, KeyHash>::iterator it = _mapEntries.find(_vkeycache);
+    if( it == _mapEntries.end() ) {
+        _stats.nummisses++;
+        return false;
+    }
+    // move to the front of the least-recently-used list
+    _listEntries.splice(_listEntries.begin(), _listEntries, it->second);
+    result = it->second->second;
+    _stats.numhits++;
+    return true;
+}
+
+void ConfigurationCollisionCache::Insert(const std::vector<dReal>& vconfig, int collisionoptions, int result)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _ComputeKey(vconfig, collisionoptions);
+    std::unordered_map<Key, EntryList::iterator, KeyHash>::iterator it = _mapEntries.find(_vkeycache);
+    if( it != _mapEntries.end() ) {
+        it->second->second = result;
+        _listEntries.splice(_listEntries.begin(), _listEntries, it->second);
+        return;
+    }
+    if( _listEntries.size() >= _nMaxEntries ) {
+        // reuse the least recently used entry
+        EntryList::iterator itlast = --_listEntries.end();
+        _mapEntries.erase(itlast->first);
+        itlast->first = _vkeycache;
+        itlast->second = result;
+        _listEntries.splice(_listEntries.begin(), _listEntries, itlast);
+        _stats.numevictions++;
+    }
+    else {
+        _listEntries.emplace_front(_vkeycache, result);
+    }
+    _mapEntries[_vkeycache] = _listEntries.begin();
+    _stats.numinsertions++;
+}
+
+void ConfigurationCollisionCache::Reset()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _listEntries.clear();
+    _mapEntries.clear();
+}
+
+size_t ConfigurationCollisionCache::GetNumEntries() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _listEntries.size();
+}
+
+ConfigurationCollisionCache::Statistics ConfigurationCollisionCache::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+void ConfigurationCollisionCache::ResetStatistics()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stats = Statistics();
+}
+
+DynamicsCollisionConstraint::DynamicsCollisionConstraint(PlannerBase::PlannerParametersConstPtr parameters, const std::list<KinBodyPtr>& listCheckBodies, int filtermask) : _listCheckBodies(listCheckBodies), _filtermask(filtermask), _torquelimitmode(DC_NominalTorque), _perturbation(0.1), _nParallelWorkers(0), _nParametersParallelWorkers(0), _bParametersBatchCollisionChecking(false), _nParallelBodiesUpdateStamp(0), _bBatchCollisionChecking(false), _deferredCollisionMode(DCM_None), _nDeferredStateIndex(0), _nDeferredSkipStates(0), _nDeferredStateStride(0)
 {
     BOOST_ASSERT(listCheckBodies.size()>0);
     _report.reset(new CollisionReport());
@@ -2282,6 +2847,7 @@ DynamicsCollisionConstraint::DynamicsCollisionConstraint(PlannerBase::PlannerPar
     if( !!parameters ) {
         _specvel = parameters->_configurationspecification.ConvertToVelocitySpecification();
         _setvelstatefn = _specvel.GetSetFn(_listCheckBodies.front()->GetEnv());
+        _UpdateCollisionCheckingModes(*parameters);
     }
 }
 
@@ -2291,6 +2857,7 @@ void DynamicsCollisionConstraint::SetPlannerParameters(PlannerBase::PlannerParam
     if( !!parameters ) {
         _specvel = parameters->_configurationspecification.ConvertToVelocitySpecification();
         _setvelstatefn = _specvel.GetSetFn(_listCheckBodies.front()->GetEnv());
+        _UpdateCollisionCheckingModes(*parameters);
     }
 }
 
@@ -2314,6 +2881,299 @@ void DynamicsCollisionConstraint::SetPerturbation(dReal perturbation)
     _perturbation = perturbation;
 }
 
+void DynamicsCollisionConstraint::SetParallelCollisionChecking(int numworkers)
+{
+    if( numworkers != _nParallelWorkers ) {
+        _vParallelEnvs.clear();
+        _vParallelBodies.clear();
+        _vParallelDOFValues.clear();
+    }
+    _nParallelWorkers = numworkers > 1 ? numworkers : 0;
+}
+
+void DynamicsCollisionConstraint::SetBatchCollisionChecking(bool bBatchCollisionChecking)
+{
+    _bBatchCollisionChecking = bBatchCollisionChecking;
+}
+
+void DynamicsCollisionConstraint::_UpdateCollisionCheckingModes(const PlannerBase::PlannerParameters& parameters)
+{
+    if( parameters._nParallelCollisionCheckingWorkers != _nParametersParallelWorkers ) {
+        _nParametersParallelWorkers = parameters._nParallelCollisionCheckingWorkers;
+        SetParallelCollisionChecking(_nParametersParallelWorkers);
+    }
+    if( parameters._bBatchCollisionChecking != _bParametersBatchCollisionChecking ) {
+        _bParametersBatchCollisionChecking = parameters._bBatchCollisionChecking;
+        SetBatchCollisionChecking(_bParametersBatchCollisionChecking);
+    }
+}
+
+void DynamicsCollisionConstraint::SynchronizeParallelEnvironments()
+{
+    if( _vParallelEnvs.size() == 0 ) {
+        return;
+    }
+    EnvironmentBasePtr penv = _listCheckBodies.front()->GetEnv();
+    for(size_t iworker = 0; iworker < _vParallelEnvs.size(); ++iworker) {
+        _vParallelEnvs[iworker]->Clone(penv, Clone_Bodies);
+        _vParallelBodies[iworker].resize(0);
+        FOREACHC(itbody, _listCheckBodies) {
+            KinBodyPtr pclonedbody = _vParallelEnvs[iworker]->GetKinBody((*itbody)->GetName());
+            if( !pclonedbody ) {
+                throw OPENRAVE_EXCEPTION_FORMAT(_("env=%s, could not find body %s in the cloned environment for parallel collision checking"), penv->GetNameId()%(*itbody)->GetName(), ORE_InvalidState);
+            }
+            _vParallelBodies[iworker].push_back(pclonedbody);
+        }
+    }
+    _HaveParallelEnvironmentsChanged();
+}
+
+bool DynamicsCollisionConstraint::_HaveParallelEnvironmentsChanged()
+{
+    EnvironmentBasePtr penv = _listCheckBodies.front()->GetEnv();
+    // the checked bodies and their grabbed bodies are set to every state by the workers, so only their other properties have to match
+    _vParallelMovingBodiesCache.resize(0);
+    FOREACHC(itcheckbody, _listCheckBodies) {
+        _vParallelMovingBodiesCache.push_back(*itcheckbody);
+        (*itcheckbody)->GetGrabbed(_vParallelGrabbedCache);
+        _vParallelMovingBodiesCache.insert(_vParallelMovingBodiesCache.end(), _vParallelGrabbedCache.begin(), _vParallelGrabbedCache.end());
+    }
+    _vParallelGrabbedCache.resize(0);
+    _vParallelMovingShapesCache.resize(0);
+    FOREACHC(itbody, _vParallelMovingBodiesCache) {
+        const std::vector<uint64_t>& vLinkEnableStatesMask = (*itbody)->GetLinkEnableStatesMasks();
+        _vParallelMovingShapesCache.insert(_vParallelMovingShapesCache.end(), vLinkEnableStatesMask.begin(), vLinkEnableStatesMask.end());
+        FOREACHC(itlink, (*itbody)->GetLinks()) {
+            _vParallelMovingShapesCache.push_back((uint32_t)(*itlink)->GetGeometryShapeStamp());
+        }
+    }
+
+    const uint64_t nBodiesUpdateStamp = penv->GetBodiesUpdateStamp();
+    bool bChanged = true;
+    if( _vParallelMovingBodiesCache == _vParallelMovingBodies && _vParallelMovingShapesCache == _vParallelMovingShapes ) {
+        // the bodies update stamp of the environment is incremented with the stamp of every body and when bodies are added or removed,
+        // so if the moving bodies account for all its increments, the other bodies did not change
+        uint64_t nMovingBodiesIncrements = 0;
+        for(size_t ibody = 0; ibody < _vParallelMovingBodies.size(); ++ibody) {
+            nMovingBodiesIncrements += (uint32_t)_vParallelMovingBodies[ibody]->GetUpdateStamp() - (uint32_t)_vParallelMovingBodyStamps[ibody];
+        }
+        bChanged = nBodiesUpdateStamp - _nParallelBodiesUpdateStamp != nMovingBodiesIncrements;
+    }
+    else {
+        _vParallelMovingBodies.swap(_vParallelMovingBodiesCache);
+        _vParallelMovingShapes.swap(_vParallelMovingShapesCache);
+    }
+    _vParallelMovingBodyStamps.resize(_vParallelMovingBodies.size());
+    for(size_t ibody = 0; ibody < _vParallelMovingBodies.size(); ++ibody) {
+        _vParallelMovingBodyStamps[ibody] = _vParallelMovingBodies[ibody]->GetUpdateStamp();
+    }
+    _nParallelBodiesUpdateStamp = nBodiesUpdateStamp;
+    return bChanged;
+}
+
+void DynamicsCollisionConstraint::_InitParallelEnvironments()
+{
+    if( (int)_vParallelEnvs.size() == _nParallelWorkers ) {
+        if( _HaveParallelEnvironmentsChanged() ) {
+            RAVELOG_VERBOSE_FORMAT("env=%s, scene changed, re-cloning the %d environments for parallel collision checking", _listCheckBodies.front()->GetEnv()->GetNameId()%_nParallelWorkers);
+            SynchronizeParallelEnvironments();
+        }
+        return;
+    }
+    EnvironmentBasePtr penv = _listCheckBodies.front()->GetEnv();
+    _vParallelEnvs.resize(_nParallelWorkers);
+    _vParallelBodies.resize(_nParallelWorkers);
+    _vParallelDOFValues.resize(_nParallelWorkers);
+    for(int iworker = 0; iworker < _nParallelWorkers; ++iworker) {
+        _vParallelEnvs[iworker] = penv->CloneSelf(str(boost::format("%s_collisionworker%d")%penv->GetName()%iworker), Clone_Bodies);
+    }
+    SynchronizeParallelEnvironments();
+    RAVELOG_DEBUG_FORMAT("env=%s, created %d environments for parallel collision checking", penv->GetNameId()%_nParallelWorkers);
+}
+
+int DynamicsCollisionConstraint::_CheckParallel(const std::function<int()>& checkfn)
+{
+    if( _nParallelWorkers > 1 ) {
+        _InitParallelEnvironments();
+    }
+    _nDeferredStateStride = 0;
+    FOREACHC(itbody, _listCheckBodies) {
+        _nDeferredStateStride += 7 + (*itbody)->GetDOF();
+    }
+    _vDeferredStates.resize(0);
+    _vDeferredOptions.resize(0);
+
+    // first pass sets all the states and checks everything except for the collisions
+    _deferredCollisionMode = DCM_Collect;
+    int ret;
+    try {
+        ret = checkfn();
+    }
+    catch(...) {
+        _deferredCollisionMode = DCM_None;
+        throw;
+    }
+    _deferredCollisionMode = DCM_None;
+
+    size_t nFirstCollision = _nParallelWorkers > 1 ? _CheckDeferredStates() : _CheckDeferredStatesBatch();
+    if( !!_profile ) {
+        // the states after the first collision are mostly not checked
+        _profile->numCollisionCalls += std::min(nFirstCollision+1, _vDeferredOptions.size())*_listCheckBodies.size();
+    }
+    if( nFirstCollision >= _vDeferredOptions.size() ) {
+        // all the states before the one that failed (if any) are collision free, so the first pass result is final
+        return ret;
+    }
+
+    // re-check serially from the first colliding state so that filterreturn is filled in the same way as in the serial mode
+    _deferredCollisionMode = DCM_SkipUntil;
+    _nDeferredStateIndex = 0;
+    _nDeferredSkipStates = nFirstCollision;
+    try {
+        ret = checkfn();
+    }
+    catch(...) {
+        _deferredCollisionMode = DCM_None;
+        throw;
+    }
+    _deferredCollisionMode = DCM_None;
+    return ret;
+}
+
+size_t DynamicsCollisionConstraint::_CheckDeferredStates()
+{
+    const size_t numstates = _vDeferredOptions.size();
+    std::atomic<size_t> nNextState(0), nFirstCollision(numstates);
+    if( numstates == 0 ) {
+        return numstates;
+    }
+
+    const size_t numthreads = std::min(numstates, _vParallelEnvs.size());
+    if( numthreads <= 1 ) {
+        _DeferredStatesWorker(0, nNextState, nFirstCollision);
+        return nFirstCollision;
+    }
+
+    // every worker index has its own environment, so they can run on any thread of the shared task scheduler.
+    // the calling thread helps while waiting, and workers that start late find no states left.
+    RaveParallelFor(numthreads, [this, &nNextState, &nFirstCollision](size_t iworker) {
+        _DeferredStatesWorker(iworker, nNextState, nFirstCollision);
+    });
+    return nFirstCollision;
+}
+
+void DynamicsCollisionConstraint::_DeferredStatesWorker(size_t iworker, std::atomic<size_t>& nNextState, std::atomic<size_t>& nFirstCollision)
+{
+    EnvironmentBasePtr penv = _vParallelEnvs.at(iworker);
+    const std::vector<KinBodyPtr>& vbodies = _vParallelBodies.at(iworker);
+    std::vector<dReal>& vdofvalues = _vParallelDOFValues.at(iworker);
+    EnvironmentLock lock(penv->GetMutex());
+    while(true) {
+        // states are taken in increasing order, so once a collision is found all the states before it are already being checked
+        const size_t istate = nNextState.fetch_add(1);
+        if( istate >= nFirstCollision.load() ) {
+            break;
+        }
+
+        const int options = _vDeferredOptions[istate];
+        std::vector<dReal>::const_iterator itvalue = _vDeferredStates.begin() + istate*_nDeferredStateStride;
+        bool bCollision = false;
+        try {
+            FOREACHC(itbody, vbodies) {
+                Transform t;
+                t.rot.x = *itvalue++; t.rot.y = *itvalue++; t.rot.z = *itvalue++; t.rot.w = *itvalue++;
+                t.trans.x = *itvalue++; t.trans.y = *itvalue++; t.trans.z = *itvalue++;
+                vdofvalues.resize((*itbody)->GetDOF());
+                std::copy(itvalue, itvalue+vdofvalues.size(), vdofvalues.begin());
+                itvalue += vdofvalues.size();
+                (*itbody)->SetDOFValues(vdofvalues, t, KinBody::CLA_Nothing);
+            }
+            FOREACHC(itbody, vbodies) {
+                if( ((options&CFO_CheckEnvCollisions) && penv->CheckCollision(KinBodyConstPtr(*itbody))) || ((options&CFO_CheckSelfCollisions) && (*itbody)->CheckSelfCollision()) ) {
+                    bCollision = true;
+                    break;
+                }
+            }
+        }
+        catch(const std::exception& ex) {
+            // the serial re-check will raise the error again in the original environment
+            RAVELOG_WARN_FORMAT("env=%s, worker %d failed to check state %d: %s", penv->GetNameId()%iworker%istate%ex.what());
+            bCollision = true;
+        }
+
+        if( bCollision ) {
+            size_t nprev = nFirstCollision.load();
+            while( istate < nprev && !nFirstCollision.compare_exchange_weak(nprev, istate) ) {
+            }
+        }
+    }
+}
+
+size_t DynamicsCollisionConstraint::_CheckDeferredStatesBatch()
+{
+    const size_t numstates = _vDeferredOptions.size();
+    if( numstates == 0 ) {
+        return numstates;
+    }
+
+    KinBodyPtr pbody = _listCheckBodies.front();
+    EnvironmentBasePtr penv = pbody->GetEnv();
+    CollisionCheckerBasePtr pchecker = penv->GetCollisionChecker();
+    // CheckCollisionBatch only sets the dof values, so the body has to be alone and keep the same transform
+    bool bUseBatch = _listCheckBodies.size() == 1 && !!pchecker;
+    for(size_t istate = 1; bUseBatch && istate < numstates; ++istate) {
+        bUseBatch = std::equal(_vDeferredStates.begin(), _vDeferredStates.begin()+7, _vDeferredStates.begin()+istate*_nDeferredStateStride);
+    }
+
+    std::vector<KinBody::KinBodyStateSaverRefPtr> vsavers;
+    vsavers.reserve(_listCheckBodies.size());
+    FOREACHC(itbody, _listCheckBodies) {
+        vsavers.push_back(KinBody::KinBodyStateSaverRefPtr(new KinBody::KinBodyStateSaverRef(**itbody, KinBody::Save_LinkTransformation)));
+    }
+
+    // check in chunks so that the states after a collision are mostly not checked
+    const size_t nChunkSize = 16;
+    for(size_t ichunkstart = 0; ichunkstart < numstates; ichunkstart += nChunkSize) {
+        const size_t ichunkend = std::min(numstates, ichunkstart+nChunkSize);
+        if( bUseBatch ) {
+            pchecker->CheckCollisionBatch(pbody, &_vDeferredStates[ichunkstart*_nDeferredStateStride+7], ichunkend-ichunkstart, _nDeferredStateStride, _vDeferredCollisions);
+        }
+        for(size_t istate = ichunkstart; istate < ichunkend; ++istate) {
+            const int options = _vDeferredOptions[istate];
+            std::vector<dReal>::const_iterator itvalue = _vDeferredStates.begin() + istate*_nDeferredStateStride;
+            bool bCollision = false;
+            if( bUseBatch ) {
+                bCollision = (options&CFO_CheckEnvCollisions) && _vDeferredCollisions[istate-ichunkstart];
+                if( !bCollision && (options&CFO_CheckSelfCollisions) ) {
+                    pbody->SetDOFValues(&itvalue[7], pbody->GetDOF(), KinBody::CLA_Nothing);
+                    bCollision = pbody->CheckSelfCollision();
+                }
+            }
+            else {
+                FOREACHC(itbody, _listCheckBodies) {
+                    Transform t;
+                    t.rot.x = *itvalue++; t.rot.y = *itvalue++; t.rot.z = *itvalue++; t.rot.w = *itvalue++;
+                    t.trans.x = *itvalue++; t.trans.y = *itvalue++; t.trans.z = *itvalue++;
+                    _vfulldofvalues.resize((*itbody)->GetDOF());
+                    std::copy(itvalue, itvalue+_vfulldofvalues.size(), _vfulldofvalues.begin());
+                    itvalue += _vfulldofvalues.size();
+                    (*itbody)->SetDOFValues(_vfulldofvalues, t, KinBody::CLA_Nothing);
+                }
+                FOREACHC(itbody, _listCheckBodies) {
+                    if( ((options&CFO_CheckEnvCollisions) && penv->CheckCollision(KinBodyConstPtr(*itbody))) || ((options&CFO_CheckSelfCollisions) && (*itbody)->CheckSelfCollision()) ) {
+                        bCollision = true;
+                        break;
+                    }
+                }
+            }
+            if( bCollision ) {
+                return istate;
+            }
+        }
+    }
+    return numstates;
+}
+
 int DynamicsCollisionConstraint::_SetAndCheckState(PlannerBase::PlannerParametersConstPtr params, const std::vector<dReal>& vdofvalues, const std::vector<dReal>& vdofvelocities, const std::vector<dReal>& vdofaccels, int options, ConstraintFilterReturnPtr filterreturn)
 {
 //    if( IS_DEBUGLEVEL(Level_Verbose) ) {
@@ -2337,7 +3197,7 @@ int DynamicsCollisionConstraint::_SetAndCheckState(PlannerBase::PlannerParameter
     if( (options & CFO_CheckTimeBasedConstraints) && !!_setvelstatefn && vdofvelocities.size() == vdofvalues.size() ) {
         (*_setvelstatefn)(vdofvelocities);
     }
-    int nstateret = _CheckState(vdofvelocities, vdofaccels, options, filterreturn);
+    int nstateret = _CheckStateCached(params, vdofvalues, vdofvelocities, vdofaccels, options, filterreturn);
     if( nstateret != 0 ) {
         return nstateret;
     }
@@ -2358,7 +3218,7 @@ int DynamicsCollisionConstraint::_SetAndCheckState(PlannerBase::PlannerParameter
             if( params->SetStateValues(_vperturbedvalues, 0) != 0 ) {
                 return CFO_StateSettingError|CFO_CheckWithPerturbation;
             }
-            nstateret = _CheckState(vdofvelocities, vdofaccels, options, filterreturn);
+            nstateret = _CheckStateCached(params, _vperturbedvalues, vdofvelocities, vdofaccels, options, filterreturn);
             if( nstateret != 0 ) {
                 return nstateret;
             }
@@ -2367,12 +3227,41 @@ int DynamicsCollisionConstraint::_SetAndCheckState(PlannerBase::PlannerParameter
     return 0;
 }
 
+int DynamicsCollisionConstraint::_CheckStateCached(PlannerBase::PlannerParametersConstPtr params, const std::vector<dReal>& vdofvalues, const std::vector<dReal>& vdofvelocities, const std::vector<dReal>& vdofaccels, int options, ConstraintFilterReturnPtr filterreturn)
+{
+    const int collisionoptions = options & _filtermask & (CFO_CheckEnvCollisions|CFO_CheckSelfCollisions);
+    const ConfigurationCollisionCachePtr& cache = params->_collisioncache;
+    // the deferred states of the parallel mode are checked by the workers, so do not use the cache for them
+    if( !cache || collisionoptions == 0 || _deferredCollisionMode != DCM_None || cache->GetEnv() != _listCheckBodies.front()->GetEnv() ) {
+        return _CheckState(vdofvelocities, vdofaccels, options, filterreturn);
+    }
+
+    int cachedret = 0;
+    if( cache->Find(vdofvalues, collisionoptions, cachedret) ) {
+        if( cachedret == 0 ) {
+            // known to be collision-free, only check the other constraints
+            return _CheckState(vdofvelocities, vdofaccels, options & ~(CFO_CheckEnvCollisions|CFO_CheckSelfCollisions), filterreturn);
+        }
+        // a cached collision has no report, and the post user check function is never reached on collision
+        if( !(options & CFO_FillCollisionReport) && !((options & _filtermask & CFO_CheckUserConstraints) && !!_usercheckfns[1]) ) {
+            int nstateret = _CheckState(vdofvelocities, vdofaccels, options & ~(CFO_CheckEnvCollisions|CFO_CheckSelfCollisions), filterreturn);
+            return nstateret != 0 ? nstateret : cachedret;
+        }
+    }
+
+    int nstateret = _CheckState(vdofvelocities, vdofaccels, options, filterreturn);
+    if( nstateret == 0 || (nstateret & (CFO_CheckEnvCollisions|CFO_CheckSelfCollisions)) ) {
+        cache->Insert(vdofvalues, collisionoptions, nstateret);
+    }
+    return nstateret;
+}
+
 int DynamicsCollisionConstraint::_CheckState(const std::vector<dReal>& vdofvelocities, const std::vector<dReal>& vdofaccels, int options, ConstraintFilterReturnPtr filterreturn)
 {
     options &= _filtermask;
     if( (options&CFO_CheckUserConstraints) && !!_usercheckfns[0] ) {
         if( !_usercheckfns[0]() ) {
-            if( IS_DEBUGLEVEL(Level_Verbose) ) {
+            if( _IsPrintingOnFailure() ) {
                 _PrintOnFailure("pre usercheckfn failed");
             }
             return CFO_CheckUserConstraints;
@@ -2489,7 +3378,7 @@ int DynamicsCollisionConstraint::_CheckState(const std::vector<dReal>& vdofveloc
                     _specvel.ExtractJointValues(_dofaccelerations.begin(), vdofaccels.begin(), pbody, _vdofindices, 1);
 
                     // compute inverse dynamics and check
-                    pbody->ComputeInverseDynamics(_doftorques, _dofaccelerations);
+                    pbody->ComputeInverseDynamics(_doftorques, _dofaccelerations, KinBody::ForceTorqueMap(), _inversedynamicsworkspace);
                     FOREACH(it, _vtorquevalues) {
                         int index = it->first;
                         const std::pair<dReal, dReal>& torquelimits = it->second;
@@ -2516,12 +3405,35 @@ int DynamicsCollisionConstraint::_CheckState(const std::vector<dReal>& vdofveloc
             }
         }
     }
+    if( _deferredCollisionMode != DCM_None && (options&(CFO_CheckEnvCollisions|CFO_CheckSelfCollisions)) ) {
+        if( _deferredCollisionMode == DCM_Collect ) {
+            // record the state for the parallel workers instead of checking it
+            size_t offset = _vDeferredStates.size();
+            _vDeferredStates.resize(offset + _nDeferredStateStride);
+            std::vector<dReal>::iterator itvalue = _vDeferredStates.begin() + offset;
+            FOREACHC(itbody, _listCheckBodies) {
+                const Transform t = (*itbody)->GetTransform();
+                *itvalue++ = t.rot.x; *itvalue++ = t.rot.y; *itvalue++ = t.rot.z; *itvalue++ = t.rot.w;
+                *itvalue++ = t.trans.x; *itvalue++ = t.trans.y; *itvalue++ = t.trans.z;
+                (*itbody)->GetDOFValues(_vfulldofvalues);
+                itvalue = std::copy(_vfulldofvalues.begin(), _vfulldofvalues.end(), itvalue);
+            }
+            _vDeferredOptions.push_back(options);
+            options &= ~(CFO_CheckEnvCollisions|CFO_CheckSelfCollisions);
+        }
+        else if( _nDeferredStateIndex++ < _nDeferredSkipStates ) {
+            options &= ~(CFO_CheckEnvCollisions|CFO_CheckSelfCollisions);
+        }
+    }
+    if( !!_profile && (options&(CFO_CheckEnvCollisions|CFO_CheckSelfCollisions)) ) {
+        _profile->numCollisionCalls += _listCheckBodies.size();
+    }
     FOREACHC(itbody, _listCheckBodies) {
         if( (options&CFO_CheckEnvCollisions) && (*itbody)->GetEnv()->CheckCollision(KinBodyConstPtr(*itbody),_report) ) {
             if( (options & CFO_FillCollisionReport) && !!filterreturn ) {
                 filterreturn->_report = *_report;
             }
-            if( IS_DEBUGLEVEL(Level_Verbose) ) {
+            if( _IsPrintingOnFailure() ) {
                 _PrintOnFailure(std::string("collision failed ")+_report->__str__());
             }
             return CFO_CheckEnvCollisions;
@@ -2530,7 +3442,7 @@ int DynamicsCollisionConstraint::_CheckState(const std::vector<dReal>& vdofveloc
             if( (options & CFO_FillCollisionReport) && !!filterreturn ) {
                 filterreturn->_report = *_report;
             }
-            if( IS_DEBUGLEVEL(Level_Verbose) ) {
+            if( _IsPrintingOnFailure() ) {
                 _PrintOnFailure(std::string("self-collision failed ")+_report->__str__());
             }
             return CFO_CheckSelfCollisions;
@@ -2538,7 +3450,7 @@ int DynamicsCollisionConstraint::_CheckState(const std::vector<dReal>& vdofveloc
     }
     if( (options&CFO_CheckUserConstraints) && !!_usercheckfns[1] ) {
         if( !_usercheckfns[1]() ) {
-            if( IS_DEBUGLEVEL(Level_Verbose) ) {
+            if( _IsPrintingOnFailure() ) {
                 _PrintOnFailure("post usercheckfn failed");
             }
             return CFO_CheckUserConstraints;
@@ -2547,22 +3459,36 @@ int DynamicsCollisionConstraint::_CheckState(const std::vector<dReal>& vdofveloc
     return 0;
 }
 
+static void _WriteConstraintFailure(std::ostream& o, int envid, const std::string& prefix, const std::vector<dReal>& vcurrentvalues)
+{
+    o << std::setprecision(std::numeric_limits<dReal>::digits10+1);
+    if( envid >= 0 ) {
+        o << "env=" << envid << ", ";
+    }
+    o << prefix << "; colvalues=[";
+    FOREACHC(itval, vcurrentvalues) {
+        o << *itval << ",";
+    }
+    o << "]";
+}
+
 void DynamicsCollisionConstraint::_PrintOnFailure(const std::string& prefix)
 {
-    if( IS_DEBUGLEVEL(Level_Verbose) ) {
+    const bool bVerbose = IS_DEBUGLEVEL(Level_Verbose);
+    if( bVerbose || RaveIsLogHistoryEnabled() ) {
         PlannerBase::PlannerParametersConstPtr params = _parameters.lock();
         std::vector<dReal> vcurrentvalues;
         params->_getstatefn(vcurrentvalues);
-        stringstream ss; ss << std::setprecision(std::numeric_limits<dReal>::digits10+1);
-        if( _listCheckBodies.size() > 0 ) {
-            ss << "env=" << _listCheckBodies.front()->GetEnv()->GetId() << ", ";
+        const int envid = _listCheckBodies.size() > 0 ? _listCheckBodies.front()->GetEnv()->GetId() : -1;
+        if( bVerbose ) {
+            stringstream ss;
+            _WriteConstraintFailure(ss, envid, prefix, vcurrentvalues);
+            RAVELOG_VERBOSE(ss.str());
         }
-        ss << prefix << "; colvalues=[";
-        FOREACHC(itval, vcurrentvalues) {
-            ss << *itval << ",";
+        else {
+            // only copy the values, they are formatted if the history is dumped
+            RaveAddLogHistory(Level_Verbose, RaveGetSourceFilename(__FILE__), __LINE__, __FUNCTION__, boost::bind(_WriteConstraintFailure, _1, envid, prefix, vcurrentvalues));
         }
-        ss << "]";
-        RAVELOG_VERBOSE(ss.str());
     }
 }
 
@@ -2585,6 +3511,17 @@ inline std::ostream& RaveSerializeValues(std::ostream& O, const std::vector<dRea
 
 int DynamicsCollisionConstraint::Check(const std::vector<dReal>& q0, const std::vector<dReal>& q1, const std::vector<dReal>& dq0, const std::vector<dReal>& dq1, dReal timeelapsed, IntervalType interval, int options, ConstraintFilterReturnPtr filterreturn)
 {
+    if( _deferredCollisionMode == DCM_None ) {
+        PlannerBase::PlannerParametersConstPtr params = _parameters.lock();
+        if( !!params ) {
+            _UpdateCollisionCheckingModes(*params);
+        }
+    }
+    if( (_nParallelWorkers > 1 || _bBatchCollisionChecking) && _deferredCollisionMode == DCM_None && (options&_filtermask&(CFO_CheckEnvCollisions|CFO_CheckSelfCollisions)) ) {
+        int (DynamicsCollisionConstraint::*checkfn)(const std::vector<dReal>&, const std::vector<dReal>&, const std::vector<dReal>&, const std::vector<dReal>&, dReal, IntervalType, int, ConstraintFilterReturnPtr) = &DynamicsCollisionConstraint::Check;
+        return _CheckParallel(std::bind(checkfn, this, std::cref(q0), std::cref(q1), std::cref(dq0), std::cref(dq1), timeelapsed, interval, options, filterreturn));
+    }
+
     int maskoptions = options&_filtermask;
     int maskinterval = interval & IT_IntervalMask;
     int maskinterpolation = interval & IT_InterpolationMask;
@@ -2632,6 +3569,10 @@ int DynamicsCollisionConstraint::Check(const std::vector<dReal>& q0, const std::
         return CFO_StateSettingError;
     }
     BOOST_ASSERT(_listCheckBodies.size()>0);
+    if( !!params->_collisioncache && params->_collisioncache->GetEnv() == _listCheckBodies.front()->GetEnv() ) {
+        params->_collisioncache->Synchronize();
+    }
+    _profile = params->_profile;
     int start=0; // 0 if should check the first configuration, 1 if should skip the first configuration
     bool bCheckEnd=false;
     switch (maskinterval) {
@@ -3633,6 +4574,17 @@ int DynamicsCollisionConstraint::Check(const std::vector<dReal>& q0, const std::
                                        const std::vector<dReal>& ddq0, const std::vector<dReal>& ddq1,
                                        dReal timeelapsed, IntervalType interval, int options, ConstraintFilterReturnPtr filterreturn)
 {
+    if( _deferredCollisionMode == DCM_None ) {
+        PlannerBase::PlannerParametersConstPtr params = _parameters.lock();
+        if( !!params ) {
+            _UpdateCollisionCheckingModes(*params);
+        }
+    }
+    if( (_nParallelWorkers > 1 || _bBatchCollisionChecking) && _deferredCollisionMode == DCM_None && (options&_filtermask&(CFO_CheckEnvCollisions|CFO_CheckSelfCollisions)) ) {
+        int (DynamicsCollisionConstraint::*checkfn)(const std::vector<dReal>&, const std::vector<dReal>&, const std::vector<dReal>&, const std::vector<dReal>&, const std::vector<dReal>&, const std::vector<dReal>&, dReal, IntervalType, int, ConstraintFilterReturnPtr) = &DynamicsCollisionConstraint::Check;
+        return _CheckParallel(std::bind(checkfn, this, std::cref(q0), std::cref(q1), std::cref(dq0), std::cref(dq1), std::cref(ddq0), std::cref(ddq1), timeelapsed, interval, options, filterreturn));
+    }
+
     if( !!filterreturn ) {
         filterreturn->Clear();
     }
@@ -3648,6 +4600,10 @@ int DynamicsCollisionConstraint::Check(const std::vector<dReal>& q0, const std::
     }
 
     BOOST_ASSERT(_listCheckBodies.size()>0);
+    if( !!params->_collisioncache && params->_collisioncache->GetEnv() == _listCheckBodies.front()->GetEnv() ) {
+        params->_collisioncache->Synchronize();
+    }
+    _profile = params->_profile;
     const int _environmentid = _listCheckBodies.front()->GetEnv()->GetId();
     const int maskoptions = options & _filtermask;
     const int maskinterval = interval & IT_IntervalMask;
@@ -4713,11 +5669,16 @@ SimpleDistanceMetric::SimpleDistanceMetric(RobotBasePtr robot) : _robot(robot)
 
 dReal SimpleDistanceMetric::Eval(const std::vector<dReal>& c0, const std::vector<dReal>& c1)
 {
-    std::vector<dReal> c = c0;
+    static thread_local std::vector<dReal> s_c;
+    std::vector<dReal>& c = s_c;
+    c = c0;
     _robot->SubtractActiveDOFValues(c,c1);
+    const int dof = _robot->GetActiveDOF();
+    OPENRAVE_ASSERT_OP((int)c.size(),>=,dof);
+    OPENRAVE_ASSERT_OP((int)weights2.size(),>=,dof);
     dReal dist = 0;
-    for(int i=0; i < _robot->GetActiveDOF(); i++) {
-        dist += weights2.at(i)*c.at(i)*c.at(i);
+    for(int i=0; i < dof; i++) {
+        dist += weights2[i]*c[i]*c[i];
     }
     return RaveSqrt(dist);
 }
@@ -4762,6 +5723,12 @@ ManipulatorIKGoalSampler::ManipulatorIKGoalSampler(RobotBase::ManipulatorConstPt
     _pindexsampler = RaveCreateSpaceSampler(_probot->GetEnv(),"mt19937");
     int orgindex = 0;
     for(std::list<IkParameterization>::const_iterator it = listparameterizations.begin(); it != listparameterizations.end(); ++it) {
+        if( !pmanip->IsReachable(*it) ) {
+            // the reachability map shows that the ik solver cannot succeed
+            RAVELOG_VERBOSE_FORMAT("env=%s, skipping unreachable goal %d of manipulator %s", _probot->GetEnv()->GetNameId()%orgindex%pmanip->GetName());
+            ++orgindex;
+            continue;
+        }
         SampleInfo s;
         s._orgindex = orgindex++;
         s._ikparam = *it;
@@ -17,9 +17,13 @@
 #if !OPENRAVE_STATIC_PLUGINS
 
 #include <cstdarg>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
 #include <functional>
+#include <iterator>
 #include <mutex>
+#include <sys/stat.h>
 
 #include <openrave/openraveexception.h>
 #include <openrave/logging.h>
@@ -28,6 +32,7 @@
 #include <boost/filesystem.hpp>
 namespace fs = boost::filesystem;
 #endif
+#include <boost/lexical_cast.hpp>
 #include <boost/version.hpp>
 
 #ifdef _WIN32
@@ -121,7 +126,62 @@ void* DynamicRaveDatabase::DynamicLibrary::LoadSymbol(const std::string& name, s
 #endif
 }
 
-DynamicRaveDatabase::DynamicRaveDatabase()
+static const std::string s_manifestheader = std::string("openrave-plugin-manifest ") + OPENRAVE_PLUGININFO_HASH;
+
+LazyPlugin::LazyPlugin(const std::string& path, std::string pluginname, InterfaceMap interfaces, std::function<PluginPtr(const std::string&)> loadfn)
+    : _pluginname(std::move(pluginname))
+    , _interfaces(std::move(interfaces))
+    , _loadfn(std::move(loadfn))
+{
+    SetPluginPath(path);
+}
+
+void LazyPlugin::OnRavePreDestroy()
+{
+    std::lock_guard<std::mutex> lock(_mutexLoad);
+    if( !!_plugin ) {
+        _plugin->OnRavePreDestroy();
+    }
+}
+
+void LazyPlugin::Destroy()
+{
+    std::lock_guard<std::mutex> lock(_mutexLoad);
+    if( !!_plugin ) {
+        _plugin->Destroy();
+        _plugin.reset();
+    }
+}
+
+InterfaceBasePtr LazyPlugin::CreateInterface(InterfaceType type, const std::string& interfacename, std::istream& sinput, EnvironmentBasePtr penv)
+{
+    PluginPtr plugin = _GetPlugin();
+    if( !plugin ) {
+        return InterfaceBasePtr();
+    }
+    // pass the creation parameters following the name as they are
+    std::string name = interfacename;
+    name.append(std::istreambuf_iterator<char>(sinput), std::istreambuf_iterator<char>());
+    return plugin->OpenRAVECreateInterface(type, name, RaveGetInterfaceHash(type), OPENRAVE_ENVIRONMENT_HASH, penv);
+}
+
+PluginPtr LazyPlugin::_GetPlugin()
+{
+    std::lock_guard<std::mutex> lock(_mutexLoad);
+    if( !_plugin && !_bLoadFailed ) {
+        _plugin = _loadfn(_pluginpath);
+        if( !_plugin ) {
+            RAVELOG_WARN_FORMAT("failed to load plugin %s from %s, the plugin manifest is out of date", _pluginname%_pluginpath);
+            _bLoadFailed = true;
+        }
+        else {
+            RAVELOG_DEBUG_FORMAT("loaded %s from %s on first use", _pluginname%_pluginpath);
+        }
+    }
+    return _plugin;
+}
+
+DynamicRaveDatabase::DynamicRaveDatabase(const std::string& manifestfilename) : _manifestfilename(manifestfilename)
 {
 }
 
@@ -198,10 +258,32 @@ void DynamicRaveDatabase::Init()
         }
         _vPluginDirs.emplace_back(std::move(entry));
     }
+    _ReadManifest();
     for (const std::string& entry : _vPluginDirs) {
         RAVELOG_DEBUG_FORMAT("Looking for plugins in %s", entry);
+        utils::StartupTraceScope tracescope("plugin", "scan " + entry);
         _LoadPluginsFromPath(entry);
     }
+
+    // remove the entries of the shared objects that are not in the plugin directories anymore
+    for (std::map<std::string, ManifestEntry>::iterator it = _mapManifest.begin(); it != _mapManifest.end(); ) {
+        bool bFound = false;
+        for (const PluginPtr& plugin : _vPlugins) {
+            if (plugin->GetPluginPath() == it->first) {
+                bFound = true;
+                break;
+            }
+        }
+        if (bFound) {
+            ++it;
+        } else {
+            it = _mapManifest.erase(it);
+            _bManifestChanged = true;
+        }
+    }
+    if (_bManifestChanged) {
+        _WriteManifest();
+    }
 }
 
 void DynamicRaveDatabase::ReloadPlugins()
@@ -258,7 +340,7 @@ void DynamicRaveDatabase::_LoadPluginsFromPath(const std::string& strpath, bool
     } else if (fs::is_regular_file(path)) {
         // Check that the file has a platform-appropriate extension
         if (0 == strpath.compare(strpath.size() - PLUGIN_EXT.size(), PLUGIN_EXT.size(), PLUGIN_EXT)) {
-            _LoadPlugin(path.string());
+            _AddPluginFile(path.string());
         }
     } else {
         RAVELOG_WARN_FORMAT("Path is not a valid directory or file: %s", strpath);
@@ -296,7 +378,7 @@ void DynamicRaveDatabase::_LoadPluginsFromPath(const std::string& strpath, bool
         }
         ::closedir(dirptr);
     } else if (S_ISREG(sb.st_mode)) {
-        _LoadPlugin(strpath);
+        _AddPluginFile(strpath);
     } else {
         // Not a directory or file, ignore it
     }
@@ -309,16 +391,29 @@ void DynamicRaveDatabase::_LoadPluginsFromPath(const std::string& strpath, bool
 
 bool DynamicRaveDatabase::_LoadPlugin(const std::string& strpath)
 {
+    PluginPtr plugin = _OpenPlugin(strpath);
+    if (!plugin) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    _vPlugins.emplace_back(plugin);
+    RAVELOG_DEBUG_FORMAT("Found %s at %s.", plugin->GetPluginName() % strpath);
+    return true;
+}
+
+PluginPtr DynamicRaveDatabase::_OpenPlugin(const std::string& strpath)
+{
+    utils::StartupTraceScope tracescope("plugin", "load " + strpath);
     DynamicLibrary dylib(strpath);
     if (!dylib) {
         RAVELOG_DEBUG_FORMAT("Failed to load shared object %s", strpath);
-        return false;
+        return PluginPtr();
     }
     std::string errstr;
     void* psym = dylib.LoadSymbol("CreatePlugin", errstr);
     if (!psym) {
         RAVELOG_DEBUG_FORMAT("%s, might not be an OpenRAVE plugin.", errstr);
-        return false;
+        return PluginPtr();
     }
     RavePlugin* plugin = nullptr;
     try {
@@ -327,14 +422,134 @@ bool DynamicRaveDatabase::_LoadPlugin(const std::string& strpath)
         RAVELOG_WARN_FORMAT("Failed to construct a RavePlugin from %s: %s", strpath % e.what());
     }
     if (!plugin) {
-        return false;
+        return PluginPtr();
     }
+    PluginPtr pluginptr(plugin); // Ownership passed to the shared_ptr
+    pluginptr->SetPluginPath(strpath);
     std::lock_guard<std::mutex> lock(_mutex);
     _mapLibraryHandles.emplace(strpath, std::move(dylib)); // Keep the library handle around in case we need it
-    _vPlugins.emplace_back(PluginPtr(plugin)); // Ownership passed to the shared_ptr
-    _vPlugins.back()->SetPluginPath(strpath);
-    RAVELOG_DEBUG_FORMAT("Found %s at %s.", _vPlugins.back()->GetPluginName() % strpath);
-    return true;
+    return pluginptr;
+}
+
+void DynamicRaveDatabase::_AddPluginFile(const std::string& strpath)
+{
+    if (_manifestfilename.empty()) {
+        _LoadPlugin(strpath);
+        return;
+    }
+    struct stat filestat;
+    if (::stat(strpath.c_str(), &filestat) != 0) {
+        return;
+    }
+    std::map<std::string, ManifestEntry>::iterator itentry = _mapManifest.find(strpath);
+    if (itentry != _mapManifest.end()) {
+        if (itentry->second.size == (uint64_t)filestat.st_size && itentry->second.modifiedTime == (int64_t)filestat.st_mtime) {
+            boost::weak_ptr<DynamicRaveDatabase> pdatabaseweak = shared_from_this();
+            PluginPtr plugin = boost::make_shared<LazyPlugin>(strpath, itentry->second.pluginname, itentry->second.interfaces, [pdatabaseweak](const std::string& path) {
+                boost::shared_ptr<DynamicRaveDatabase> pdatabase = pdatabaseweak.lock();
+                return !!pdatabase ? pdatabase->_OpenPlugin(path) : PluginPtr();
+            });
+            std::lock_guard<std::mutex> lock(_mutex);
+            _vPlugins.emplace_back(plugin);
+            RAVELOG_VERBOSE_FORMAT("Found %s at %s in the plugin manifest.", itentry->second.pluginname % strpath);
+            return;
+        }
+        _mapManifest.erase(itentry);
+        _bManifestChanged = true;
+    }
+
+    // plugins registering readers when constructed have to be loaded now so that their readers are available before any of their interfaces is created
+    const uint64_t readerstamp = RaveGetReaderRegistrationStamp();
+    PluginPtr plugin = _OpenPlugin(strpath);
+    if (!plugin) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _vPlugins.emplace_back(plugin);
+    }
+    RAVELOG_DEBUG_FORMAT("Found %s at %s.", plugin->GetPluginName() % strpath);
+    if (readerstamp == RaveGetReaderRegistrationStamp() && strpath.find_first_of("\t\n") == std::string::npos) {
+        ManifestEntry& entry = _mapManifest[strpath];
+        entry.size = filestat.st_size;
+        entry.modifiedTime = filestat.st_mtime;
+        entry.pluginname = plugin->GetPluginName();
+        entry.interfaces = plugin->GetInterfaces();
+        _bManifestChanged = true;
+    }
+}
+
+void DynamicRaveDatabase::_ReadManifest()
+{
+    _mapManifest.clear();
+    _bManifestChanged = false;
+    if (_manifestfilename.empty()) {
+        return;
+    }
+    std::ifstream ifs(_manifestfilename.c_str());
+    std::string line;
+    if (!std::getline(ifs, line) || line != s_manifestheader) {
+        // missing or written by a different version, rewrite it
+        _bManifestChanged = true;
+        return;
+    }
+    // every line is: path, size, modification time, plugin name, and the space separated type:name interfaces, separated by tabs
+    std::vector<std::string> vfields;
+    while (std::getline(ifs, line)) {
+        vfields.resize(0);
+        utils::TokenizeString(line, "\t", vfields);
+        if (vfields.size() < 4) {
+            continue;
+        }
+        ManifestEntry entry;
+        try {
+            entry.size = boost::lexical_cast<uint64_t>(vfields[1]);
+            entry.modifiedTime = boost::lexical_cast<int64_t>(vfields[2]);
+        }
+        catch (const boost::bad_lexical_cast&) {
+            continue;
+        }
+        entry.pluginname = vfields[3];
+        if (vfields.size() > 4) {
+            std::stringstream ss(vfields[4]);
+            std::string interfacestr;
+            while (ss >> interfacestr) {
+                const size_t pos = interfacestr.find(':');
+                if (pos != std::string::npos) {
+                    entry.interfaces[(InterfaceType)atoi(interfacestr.c_str())].push_back(interfacestr.substr(pos + 1));
+                }
+            }
+        }
+        _mapManifest[vfields[0]] = std::move(entry);
+    }
+}
+
+void DynamicRaveDatabase::_WriteManifest() const
+{
+    // write to a temporary file first so that other processes never read a partial manifest
+    const std::string tempfilename = str(boost::format("%s.%d.tmp")%_manifestfilename%utils::GetMicroTime());
+    {
+        std::ofstream ofs(tempfilename.c_str());
+        ofs << s_manifestheader << std::endl;
+        for (const std::pair<const std::string, ManifestEntry>& entry : _mapManifest) {
+            ofs << entry.first << '\t' << entry.second.size << '\t' << entry.second.modifiedTime << '\t' << entry.second.pluginname << '\t';
+            for (const std::pair<const InterfaceType, std::vector<std::string> >& interfaces : entry.second.interfaces) {
+                for (const std::string& name : interfaces.second) {
+                    ofs << (int)interfaces.first << ':' << name << ' ';
+                }
+            }
+            ofs << std::endl;
+        }
+        if (!ofs) {
+            RAVELOG_DEBUG_FORMAT("failed to write plugin manifest %s", tempfilename);
+            ofs.close();
+            std::remove(tempfilename.c_str());
+            return;
+        }
+    }
+    if (std::rename(tempfilename.c_str(), _manifestfilename.c_str()) != 0) {
+        std::remove(tempfilename.c_str());
+    }
 }
 
 } // namespace OpenRAVE
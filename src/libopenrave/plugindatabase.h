@@ -24,15 +24,51 @@
 #include "openrave/plugininfo.h"
 #include "plugindatabase_virtual.h"
 
+#include <functional>
 #include <mutex>
 #include <boost/shared_ptr.hpp>
 #include <unordered_map>
 
 namespace OpenRAVE {
 
+/// \brief plugin whose interfaces are read from the manifest, loads its shared object the first time one of its interfaces is created
+struct LazyPlugin final : public RavePlugin
+{
+    /// \param loadfn opens the shared object and returns its plugin, null if it failed
+    LazyPlugin(const std::string& path, std::string pluginname, InterfaceMap interfaces, std::function<PluginPtr(const std::string&)> loadfn);
+
+    void OnRavePreDestroy() override;
+    void Destroy() override;
+
+    const InterfaceMap& GetInterfaces() const override
+    {
+        return _interfaces;
+    }
+
+    const std::string& GetPluginName() const override
+    {
+        return _pluginname;
+    }
+
+protected:
+    InterfaceBasePtr CreateInterface(InterfaceType type, const std::string& interfacename, std::istream& sinput, EnvironmentBasePtr penv) override;
+
+private:
+    /// \brief returns the loaded plugin, loading it if it is the first call
+    PluginPtr _GetPlugin();
+
+    std::string _pluginname;
+    InterfaceMap _interfaces;
+    std::function<PluginPtr(const std::string&)> _loadfn;
+    std::mutex _mutexLoad; ///< protects the members below
+    PluginPtr _plugin; ///< the plugin of the shared object once loaded
+    bool _bLoadFailed = false;
+};
+
 class DynamicRaveDatabase final : public RaveDatabase, public boost::enable_shared_from_this<DynamicRaveDatabase> {
 public:
-    DynamicRaveDatabase();
+    /// \param manifestfilename file caching the interfaces of the plugins so that their shared objects are only loaded when used. If empty, all the plugins are loaded in Init.
+    DynamicRaveDatabase(const std::string& manifestfilename=std::string());
     DynamicRaveDatabase(const DynamicRaveDatabase&) = delete; // Copying not allowed
     DynamicRaveDatabase(DynamicRaveDatabase&&) = default;
     ~DynamicRaveDatabase() override;
@@ -58,11 +94,31 @@ private:
         void* _handle;
     };
 
+    /// \brief entry of the manifest, the interfaces of a plugin shared object
+    struct ManifestEntry
+    {
+        uint64_t size = 0;
+        int64_t modifiedTime = 0;
+        std::string pluginname;
+        RavePlugin::InterfaceMap interfaces;
+    };
+
     void _LoadPluginsFromPath(const std::string&, bool recurse = false);
     bool _LoadPlugin(const std::string&); ///< Attempts to load a RavePlugin from a shared object, fails liberally if the right symbols cannot be found. Locks _mutex.
+    PluginPtr _OpenPlugin(const std::string& strpath); ///< Opens the shared object and creates its RavePlugin without adding it to _vPlugins. Locks _mutex.
+
+    /// \brief adds the plugin of a shared object found in the plugin directories, lazily if the manifest has an up-to-date entry of it
+    void _AddPluginFile(const std::string& strpath);
+
+    void _ReadManifest();
+    void _WriteManifest() const;
 
     std::vector<std::string> _vPluginDirs; ///< List of plugin directories
     std::unordered_map<std::string, DynamicLibrary> _mapLibraryHandles; ///< A map of paths to *open* shared object handles.
+
+    std::string _manifestfilename;
+    std::map<std::string, ManifestEntry> _mapManifest; ///< path of the shared object -> entry, only the plugins that can be loaded lazily
+    bool _bManifestChanged = false; ///< true if _mapManifest differs from the file
 };
 
 } // end namespace OpenRAVE
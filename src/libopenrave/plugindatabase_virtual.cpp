@@ -16,6 +16,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "plugindatabase_virtual.h"
+#include <openrave/utils.h>
 
 namespace OpenRAVE {
 
@@ -109,6 +110,7 @@ InterfaceBasePtr RaveDatabase::Create(EnvironmentBasePtr penv, InterfaceType typ
             return InterfaceBasePtr();
         }
         std::string interfacename = name.substr(0, position);
+        utils::StartupTraceScope tracescope("interface", utils::StartupTraceScope::IsEnabled() ? RaveGetInterfaceName(type) + " " + interfacename : std::string());
         for (const PluginPtr& plugin : _vPlugins) {
             if (plugin->HasInterface(type, interfacename)) {
                 try {
@@ -563,10 +563,22 @@ void RobotBase::RobotStateSaver::_RestoreRobot(boost::shared_ptr<RobotBase> prob
             }
 
             if( bchanged ) {
-                EnvironmentBodyRemover robotremover(probot);
-                // need to restore active connected bodies
-                // but first check whether anything changed
-                probot->SetConnectedBodyActiveStates(_vConnectedBodyActiveStates);
+                // preinstantiated connected bodies can be toggled in place, otherwise the robot has to be removed while restoring
+                bool bRequireRemove = false;
+                for(size_t iconnectedbody = 0; iconnectedbody < probot->_vecConnectedBodies.size(); ++iconnectedbody) {
+                    const ConnectedBody& connectedBody = *probot->_vecConnectedBodies[iconnectedbody];
+                    if( connectedBody.GetInfo()._bIsActive != _vConnectedBodyActiveStates[iconnectedbody] && !connectedBody.CanSetActiveWithoutReinitialize(_vConnectedBodyActiveStates[iconnectedbody]) ) {
+                        bRequireRemove = true;
+                        break;
+                    }
+                }
+                if( bRequireRemove ) {
+                    EnvironmentBodyRemover robotremover(probot);
+                    probot->SetConnectedBodyActiveStates(_vConnectedBodyActiveStates);
+                }
+                else {
+                    probot->SetConnectedBodyActiveStates(_vConnectedBodyActiveStates);
+                }
             }
         }
         else {
@@ -778,10 +790,13 @@ void RobotBase::RobotBaseInfo::DeserializeJSON(const rapidjson::Value& value, dR
 
 void RobotBase::RobotBaseInfo::_DeserializeReadableInterface(const std::string& id, const rapidjson::Value& rReadable, dReal fUnitScale) {
     std::map<std::string, ReadablePtr>::iterator itReadable = _mReadableInterfaces.find(id);
-    ReadablePtr pReadable;
-    if(itReadable != _mReadableInterfaces.end()) {
-        pReadable = itReadable->second;
+    if(itReadable == _mReadableInterfaces.end()) {
+        // most readables are never accessed, so only deserialize them when they are
+        _mReadableInterfaces[id].reset(new LazyJSONReadable(PT_Robot, id, rReadable, fUnitScale));
+        return;
     }
+    // updating an existing readable, so the reader has to merge into it
+    ReadablePtr pReadable = LazyJSONReadable::Resolve(itReadable->second);
     BaseJSONReaderPtr pReader = RaveCallJSONReader(PT_Robot, id, pReadable, AttributesList());
     if (!!pReader) {
         pReader->DeserializeJSON(rReadable, fUnitScale);
@@ -1162,30 +1177,13 @@ void RobotBase::SetActiveDOFs(const std::vector<int>& vJointIndices, int nAffine
     _nActiveDOF = vJointIndices.size() + RaveGetAffineDOF(_nAffineDOFs);
 
     if( bactivedofchanged ) {
-        // do not initialize interpolation, since it implies a motion sampling strategy
-        int offset = 0;
-        _activespec._vgroups.resize(0);
-        if( GetActiveDOFIndices().size() > 0 ) {
-            ConfigurationSpecification::Group group;
-            stringstream ss;
-            ss << "joint_values " << GetName();
-            FOREACHC(it,GetActiveDOFIndices()) {
-                ss << " " << *it;
-            }
-            group.name = ss.str();
-            group.dof = (int)GetActiveDOFIndices().size();
-            group.offset = offset;
-            offset += group.dof;
-            _activespec._vgroups.push_back(group);
+        const boost::shared_ptr<ActiveDOFProfile> pprofile = _GetActiveDOFProfile(_vActiveDOFIndices, _nAffineDOFs);
+        if( !!pprofile ) {
+            _activespec = pprofile->spec;
         }
-        if( GetAffineDOF() > 0 ) {
-            ConfigurationSpecification::Group group;
-            group.name = str(boost::format("affine_transform %s %d")%GetName()%GetAffineDOF());
-            group.offset = offset;
-            group.dof = RaveGetAffineDOF(GetAffineDOF());
-            _activespec._vgroups.push_back(group);
+        else {
+            _ComputeActiveConfigurationSpecification(_vActiveDOFIndices, _nAffineDOFs, _activespec);
         }
-
         _PostprocessChangedParameters(Prop_RobotActiveDOFs);
     }
 }
@@ -1353,30 +1351,19 @@ void RobotBase::GetActiveDOFLimits(std::vector<dReal>& lower, std::vector<dReal>
     }
     dReal* pLowerLimit = &lower[0];
     dReal* pUpperLimit = &upper[0];
-    vector<dReal> alllower,allupper;
 
-    if( _nAffineDOFs == 0 ) {
-        if( _nActiveDOF < 0 ) {
-            GetDOFLimits(lower,upper);
-            return;
-        }
-        else {
-            GetDOFLimits(alllower,allupper);
-            FOREACHC(it, _vActiveDOFIndices) {
-                *pLowerLimit++ = alllower.at(*it);
-                *pUpperLimit++ = allupper.at(*it);
-            }
-        }
+    if( _nActiveDOF < 0 ) {
+        GetDOFLimits(lower,upper);
+        return;
     }
-    else {
-        if( _vActiveDOFIndices.size() > 0 ) {
-            GetDOFLimits(alllower,allupper);
-            FOREACHC(it, _vActiveDOFIndices) {
-                *pLowerLimit++ = alllower.at(*it);
-                *pUpperLimit++ = allupper.at(*it);
-            }
-        }
-
+    // only read the active joints instead of gathering the limits of all the DOFs
+    FOREACHC(it, _vActiveDOFIndices) {
+        const Joint& joint = _GetJointFromDOFIndex(*it);
+        const std::pair<dReal, dReal> limit = joint.GetLimit(*it - joint.GetDOFIndex());
+        *pLowerLimit++ = limit.first;
+        *pUpperLimit++ = limit.second;
+    }
+    if( _nAffineDOFs != 0 ) {
         if( _nAffineDOFs & DOF_X ) {
             *pLowerLimit++ = _vTranslationLowerLimits.x;
             *pUpperLimit++ = _vTranslationUpperLimits.x;
@@ -1430,9 +1417,9 @@ void RobotBase::GetActiveDOFResolutions(std::vector<dReal>& resolution) const
     }
     dReal* pResolution = &resolution[0];
 
-    GetDOFResolutions(_vTempRobotJoints);
     FOREACHC(it, _vActiveDOFIndices) {
-        *pResolution++ = _vTempRobotJoints[*it];
+        const Joint& joint = _GetJointFromDOFIndex(*it);
+        *pResolution++ = joint.GetResolution(*it - joint.GetDOFIndex());
     }
     // set some default limits
     if( _nAffineDOFs & DOF_X ) {
@@ -1472,9 +1459,9 @@ void RobotBase::GetActiveDOFWeights(std::vector<dReal>& weights) const
     }
     dReal* pweight = &weights[0];
 
-    GetDOFWeights(_vTempRobotJoints);
     FOREACHC(it, _vActiveDOFIndices) {
-        *pweight++ = _vTempRobotJoints[*it];
+        const Joint& joint = _GetJointFromDOFIndex(*it);
+        *pweight++ = joint.GetWeight(*it - joint.GetDOFIndex());
     }
     // set some default limits
     if( _nAffineDOFs & DOF_X ) { *pweight++ = _vTranslationWeights.x; }
@@ -1696,6 +1683,91 @@ void RobotBase::SubtractActiveDOFValues(std::vector<dReal>& q1, const std::vecto
     }
 }
 
+void RobotBase::_ComputeActiveConfigurationSpecification(const std::vector<int>& vDOFIndices, int nAffineDOFs, ConfigurationSpecification& spec) const
+{
+    // do not initialize interpolation, since it implies a motion sampling strategy
+    int offset = 0;
+    spec._vgroups.resize(0);
+    if( vDOFIndices.size() > 0 ) {
+        ConfigurationSpecification::Group group;
+        stringstream ss;
+        ss << "joint_values " << GetName();
+        FOREACHC(it,vDOFIndices) {
+            ss << " " << *it;
+        }
+        group.name = ss.str();
+        group.dof = (int)vDOFIndices.size();
+        group.offset = offset;
+        offset += group.dof;
+        spec._vgroups.push_back(group);
+    }
+    if( nAffineDOFs > 0 ) {
+        ConfigurationSpecification::Group group;
+        group.name = str(boost::format("affine_transform %s %d")%GetName()%nAffineDOFs);
+        group.offset = offset;
+        group.dof = RaveGetAffineDOF(nAffineDOFs);
+        spec._vgroups.push_back(group);
+    }
+}
+
+boost::shared_ptr<RobotBase::ActiveDOFProfile> RobotBase::_GetActiveDOFProfile(const std::vector<int>& vDOFIndices, int nAffineDOFs) const
+{
+    if( _nHierarchyComputed != 2 ) {
+        return boost::shared_ptr<ActiveDOFProfile>();
+    }
+    boost::shared_ptr<ActiveDOFProfile> pprofile;
+    if( !!_pActiveDOFProfile && _pActiveDOFProfile->nAffineDOFs == nAffineDOFs && _pActiveDOFProfile->vDOFIndices == vDOFIndices ) {
+        pprofile = _pActiveDOFProfile;
+    }
+    else {
+        for(int iprofile = (int)_vActiveDOFProfiles.size()-1; iprofile >= 0; --iprofile) {
+            if( _vActiveDOFProfiles[iprofile]->nAffineDOFs == nAffineDOFs && _vActiveDOFProfiles[iprofile]->vDOFIndices == vDOFIndices ) {
+                pprofile = _vActiveDOFProfiles[iprofile];
+                // keep the most recently used last, so the least recently used is dropped first
+                _vActiveDOFProfiles.erase(_vActiveDOFProfiles.begin() + iprofile);
+                _vActiveDOFProfiles.push_back(pprofile);
+                break;
+            }
+        }
+    }
+
+    if( !pprofile ) {
+        // planners usually switch between a handful of sets, so keep a bounded number of them
+        static const size_t s_nMaxActiveDOFProfiles = 32;
+        if( _vActiveDOFProfiles.size() >= s_nMaxActiveDOFProfiles ) {
+            _vActiveDOFProfiles.erase(_vActiveDOFProfiles.begin());
+        }
+        pprofile.reset(new ActiveDOFProfile());
+        pprofile->vDOFIndices = vDOFIndices;
+        pprofile->nAffineDOFs = nAffineDOFs;
+        pprofile->nId = ++_nActiveDOFProfileIdCounter;
+        pprofile->vActiveLinks.resize(_veclinks.size(), 0);
+        FOREACHC(itindex, vDOFIndices) {
+            const int jointindex = _GetJointFromDOFIndex(*itindex).GetJointIndex();
+            for(size_t ilink = 0; ilink < _veclinks.size(); ++ilink) {
+                if( DoesAffect(jointindex, ilink) ) {
+                    pprofile->vActiveLinks[ilink] = 1;
+                }
+            }
+        }
+        _vActiveDOFProfiles.push_back(pprofile);
+    }
+    if( pprofile->robotname != GetName() ) {
+        _ComputeActiveConfigurationSpecification(pprofile->vDOFIndices, pprofile->nAffineDOFs, pprofile->spec);
+        pprofile->robotname = GetName();
+    }
+    _pActiveDOFProfile = pprofile;
+    return pprofile;
+}
+
+RobotBase::ActiveDOFProfileConstPtr RobotBase::GetActiveDOFProfile() const
+{
+    if( _nActiveDOF < 0 ) {
+        return ActiveDOFProfileConstPtr();
+    }
+    return _GetActiveDOFProfile(_vActiveDOFIndices, _nAffineDOFs);
+}
+
 ConfigurationSpecification RobotBase::GetActiveConfigurationSpecification(const std::string& interpolation) const
 {
     if( interpolation.size() == 0 ) {
@@ -2328,6 +2400,9 @@ void RobotBase::SimulationStep(dReal fElapsedTime)
 
 void RobotBase::_ComputeInternalInformation()
 {
+    // the profiles hold link masks of the previous kinematics
+    _vActiveDOFProfiles.clear();
+    _pActiveDOFProfile.reset();
     _ComputeConnectedBodiesInformation(); // should process the connected bodies in order to get the real resolved links, joints, etc
 
     KinBody::_ComputeInternalInformation();
@@ -2464,6 +2539,8 @@ void RobotBase::_ComputeInternalInformation()
 void RobotBase::_DeinitializeInternalInformation()
 {
     KinBody::_DeinitializeInternalInformation();
+    _vActiveDOFProfiles.clear();
+    _pActiveDOFProfile.reset();
     _DeinitializeConnectedBodiesInformation();
 }
 
@@ -2516,6 +2593,7 @@ void RobotBase::Clone(InterfaceBaseConstPtr preference, int cloningoptions)
         }
     }
 
+    _bPreinstantiateConnectedBodies = r->_bPreinstantiateConnectedBodies;
     _vecConnectedBodies.clear();
     FOREACHC(itConnectedBody, r->_vecConnectedBodies) {
         ConnectedBodyPtr pConnectedBody(new ConnectedBody(shared_robot(),**itConnectedBody,cloningoptions));
@@ -2535,6 +2613,8 @@ void RobotBase::Clone(InterfaceBaseConstPtr preference, int cloningoptions)
 
     _vActiveDOFIndices = r->_vActiveDOFIndices;
     _activespec = r->_activespec;
+    _vActiveDOFProfiles.clear();
+    _pActiveDOFProfile.reset();
     _vAllDOFIndices = r->_vAllDOFIndices;
     vActvAffineRotationAxis = r->vActvAffineRotationAxis;
     _nActiveDOF = r->_nActiveDOF;
@@ -2595,10 +2675,11 @@ const std::string& RobotBase::GetRobotStructureHash() const
 {
     CHECK_INTERNAL_COMPUTATION;
     if( __hashrobotstructure.size() == 0 ) {
-        ostringstream ss;
+        MD5HashStreamBuffer md5buffer;
+        std::ostream ss(&md5buffer);
         ss << std::fixed << std::setprecision(SERIALIZATION_PRECISION);
         serialize(ss,SO_Kinematics|SO_Geometry|SO_RobotManipulators|SO_RobotSensors);
-        __hashrobotstructure = utils::GetMD5HashString(ss.str());
+        __hashrobotstructure = md5buffer.GetHashString();
     }
     return __hashrobotstructure;
 }
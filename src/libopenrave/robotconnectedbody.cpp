@@ -281,7 +281,13 @@ bool RobotBase::ConnectedBody::SetActive(int8_t active)
         if( pattachedrobot->_nHierarchyComputed != 0 ) {
             // robot is already added, check to see if its state is getting in the way of changing the active state. right now -1 and 1 both enable the robot
             if( (_info._bIsActive == 0) != (active == 0) ) {
-                throw OPENRAVE_EXCEPTION_FORMAT("Cannot set ConnectedBody %s active to %s since robot %s is still in the environment", _info._name%(int)active%pattachedrobot->GetName(), ORE_InvalidState);
+                if( !CanSetActiveWithoutReinitialize(active) ) {
+                    throw OPENRAVE_EXCEPTION_FORMAT("Cannot set ConnectedBody %s active to %s since robot %s is still in the environment", _info._name%(int)active%pattachedrobot->GetName(), ORE_InvalidState);
+                }
+                // already instantiated, so only have to toggle the links
+                _info._bIsActive = active;
+                _UpdateInstantiatedLinkStates(*pattachedrobot);
+                return true;
             }
         }
     }
@@ -289,6 +295,46 @@ bool RobotBase::ConnectedBody::SetActive(int8_t active)
     return true; // changed
 }
 
+bool RobotBase::ConnectedBody::CanSetActiveWithoutReinitialize(int8_t active) const
+{
+    return IsInstantiated() && _info._bIsActive != -1 && active != -1;
+}
+
+void RobotBase::ConnectedBody::_UpdateInstantiatedLinkStates(RobotBase& robot)
+{
+    // active links get back the enable and visible states of their infos, inactive ones are disabled and hidden
+    const bool bActive = _info._bIsActive != 0;
+    std::vector<uint8_t> enablestates;
+    robot.GetLinkEnableStates(enablestates);
+    bool bEnableChanged = false, bVisibleChanged = false;
+    for(size_t ilink = 0; ilink < _vResolvedLinkNames.size() && ilink < _info._vLinkInfos.size(); ++ilink) {
+        KinBody::LinkPtr plink = _GetResolvedLink(robot, _vResolvedLinkNames[ilink]);
+        if( !plink ) {
+            continue;
+        }
+        const KinBody::LinkInfo& linkinfo = *_info._vLinkInfos[ilink];
+        const uint8_t benable = bActive && linkinfo._bIsEnabled;
+        if( enablestates.at(plink->GetIndex()) != benable ) {
+            enablestates.at(plink->GetIndex()) = benable;
+            bEnableChanged = true;
+        }
+
+        for(size_t igeom = 0; igeom < plink->_vGeometries.size() && igeom < linkinfo._vgeometryinfos.size(); ++igeom) {
+            const bool bvisible = bActive && linkinfo._vgeometryinfos[igeom]->_bVisible;
+            if( plink->_vGeometries[igeom]->_info._bVisible != bvisible ) {
+                plink->_vGeometries[igeom]->_info._bVisible = bvisible;
+                bVisibleChanged = true;
+            }
+        }
+    }
+    if( bVisibleChanged ) {
+        robot._PostprocessChangedParameters(Prop_LinkDraw);
+    }
+    if( bEnableChanged ) {
+        robot.SetLinkEnableStates(enablestates);
+    }
+}
+
 int8_t RobotBase::ConnectedBody::IsActive()
 {
     return _info._bIsActive;
@@ -303,7 +349,7 @@ void RobotBase::ConnectedBody::SetLinkEnable(bool benable)
         bool bchanged = false;
 
         FOREACH(itlinkname, _vResolvedLinkNames) {
-            KinBody::LinkPtr plink = pattachedrobot->GetLink(itlinkname->first);
+            KinBody::LinkPtr plink = _GetResolvedLink(*pattachedrobot, *itlinkname);
             if( !!plink ) {
                 if( enablestates.at(plink->GetIndex()) != benable ) {
                     enablestates.at(plink->GetIndex()) = benable;
@@ -323,7 +369,7 @@ void RobotBase::ConnectedBody::SetLinkVisible(bool bvisible)
     RobotBasePtr pattachedrobot = _pattachedrobot.lock();
     if( !!pattachedrobot ) {
         FOREACH(itlinkname, _vResolvedLinkNames) {
-            KinBody::LinkPtr plink = pattachedrobot->GetLink(itlinkname->first);
+            KinBody::LinkPtr plink = _GetResolvedLink(*pattachedrobot, *itlinkname);
             if( !!plink ) {
                 plink->SetVisible(bvisible);
             }
@@ -331,6 +377,16 @@ void RobotBase::ConnectedBody::SetLinkVisible(bool bvisible)
     }
 }
 
+KinBody::LinkPtr RobotBase::ConnectedBody::_GetResolvedLink(const RobotBase& robot, const std::pair<std::string, RobotBase::LinkPtr>& resolvedLinkName)
+{
+    // the cached pointer is reused across initializations, so only trust it if it is still the link of the robot with that name
+    const RobotBase::LinkPtr& plink = resolvedLinkName.second;
+    if( !!plink && plink->GetIndex() >= 0 && plink->GetIndex() < (int)robot.GetLinks().size() && robot.GetLinks()[plink->GetIndex()] == plink && plink->GetName() == resolvedLinkName.first ) {
+        return plink;
+    }
+    return robot.GetLink(resolvedLinkName.first);
+}
+
 void RobotBase::ConnectedBody::GetResolvedLinks(std::vector<KinBody::LinkPtr>& links)
 {
     links.resize(_vResolvedLinkNames.size());
@@ -511,6 +567,10 @@ UpdateFromInfoResult RobotBase::ConnectedBody::UpdateFromInfo(const RobotBase::C
             _info._bIsActive = info._bIsActive;
             RAVELOG_VERBOSE_FORMAT("connected body %s is active changed", _info._id);
             updateFromInfoResult = UFIR_Success;
+        } else if (!!pattachedrobot && CanSetActiveWithoutReinitialize(info._bIsActive)) {
+            SetActive(info._bIsActive);
+            RAVELOG_VERBOSE_FORMAT("connected body %s is active changed in place", _info._id);
+            updateFromInfoResult = UFIR_Success;
         } else {
             RAVELOG_VERBOSE_FORMAT("connected body %s is active changed", _info._id);
             return UFIR_RequireRemoveFromEnvironment;
@@ -708,7 +768,7 @@ void RobotBase::_ComputeConnectedBodiesInformation()
         }
 
         connectedBody._nameprefix = connectedBody.GetName() + "_";
-        if( connectedBody.IsActive() == 0 ) {
+        if( connectedBody.IsActive() == 0 && !_bPreinstantiateConnectedBodies ) {
             // skip
             continue;
         }
@@ -746,6 +806,13 @@ void RobotBase::_ComputeConnectedBodiesInformation()
 
             _InitAndAddLink(plink);
             connectedBody._vResolvedLinkNames[ilink].first = plink->_info._name;
+            if( connectedBody.IsActive() == 0 ) {
+                // preinstantiated, so keep it out of collision checking and rendering until activated. ConnectedBody::_UpdateInstantiatedLinkStates restores the states of the infos.
+                plink->_info._bIsEnabled = false;
+                FOREACH(itgeom, plink->_vGeometries) {
+                    (*itgeom)->_info._bVisible = false;
+                }
+            }
 
             // Set all links from connected bodies with -1 to be adjacent, otherwise, we can detect self collision when in indeterminable state.
             if (connectedBody.IsActive() == -1) {
@@ -1157,4 +1224,15 @@ bool RobotBase::SetConnectedBodyActiveStates(const std::vector<int8_t>& activest
     return bChanged;
 }
 
+void RobotBase::SetPreinstantiateConnectedBodies(bool bPreinstantiate)
+{
+    if( _bPreinstantiateConnectedBodies == bPreinstantiate ) {
+        return;
+    }
+    if( _nHierarchyComputed != 0 ) {
+        throw OPENRAVE_EXCEPTION_FORMAT("Cannot change the preinstantiation of connected bodies of robot %s since it is still in the environment", GetName(), ORE_InvalidState);
+    }
+    _bPreinstantiateConnectedBodies = bPreinstantiate;
+}
+
 } // end namespace OpenRAVE
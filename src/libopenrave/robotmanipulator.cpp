@@ -1026,6 +1026,117 @@ bool RobotBase::Manipulator::_CheckEndEffectorCollision(const Transform& tEE, Ki
     return bincollision;
 }
 
+bool RobotBase::Manipulator::CheckEndEffectorCollisionBatch(const std::vector<Transform>& vtEE, std::vector<uint8_t>& vresults, KinBodyConstPtr pbody, CollisionReportPtr report) const
+{
+    RobotBasePtr probot(__probot);
+    vresults.resize(vtEE.size());
+    std::fill(vresults.begin(), vresults.end(), 0);
+    if( vtEE.size() == 0 ) {
+        return false;
+    }
+
+    // gripper links are affected by all the arm joints, see _CheckEndEffectorCollision
+    std::vector<LinkPtr> vgripperlinks;
+    std::vector<Transform> vgrippertransforms;
+    FOREACHC(itlink, probot->GetLinks()) {
+        int ilink = (*itlink)->GetIndex();
+        bool bGripperLink = true;
+        FOREACHC(itarmdof,__varmdofindices) {
+            if( !probot->DoesAffect(probot->GetJointFromDOFIndex(*itarmdof)->GetJointIndex(),ilink) ) {
+                bGripperLink = false;
+                break;
+            }
+        }
+        if( bGripperLink ) {
+            vgripperlinks.push_back(*itlink);
+            vgrippertransforms.push_back((*itlink)->GetTransform());
+        }
+    }
+
+    // bodies grabbed by the gripper links move with them. When checked with the environment, they ignore the robot and the other grabbed bodies like in KinBody::CheckLinkCollision
+    struct GripperGrabbed
+    {
+        KinBodyPtr pbody;
+        size_t igripperlink;
+        Transform tRelative;
+        std::vector<KinBodyConstPtr> vbodyexcluded;
+    };
+    std::vector<GripperGrabbed> vgrippergrabbed;
+    std::vector< boost::shared_ptr<KinBody::KinBodyStateSaver> > vgrabbedsavers;
+    for (const GrabbedPtr& pgrabbed : probot->_vGrabbedBodies) {
+        std::vector<LinkPtr>::const_iterator itgripperlink = std::find(vgripperlinks.begin(), vgripperlinks.end(), pgrabbed->_pGrabbingLink);
+        KinBodyPtr pgrabbedbody = pgrabbed->_pGrabbedBody.lock();
+        if( itgripperlink == vgripperlinks.end() || !pgrabbedbody ) {
+            continue;
+        }
+        GripperGrabbed grippergrabbed;
+        grippergrabbed.pbody = pgrabbedbody;
+        grippergrabbed.igripperlink = itgripperlink - vgripperlinks.begin();
+        grippergrabbed.tRelative = pgrabbed->_tRelative;
+        grippergrabbed.vbodyexcluded.push_back(probot);
+        for (const GrabbedPtr& pgrabbed2 : probot->_vGrabbedBodies) {
+            KinBodyPtr pgrabbedbody2 = pgrabbed2->_pGrabbedBody.lock();
+            if( pgrabbed2 != pgrabbed && !!pgrabbedbody2 ) {
+                grippergrabbed.vbodyexcluded.push_back(pgrabbedbody2);
+            }
+        }
+        vgrippergrabbed.push_back(grippergrabbed);
+        vgrabbedsavers.push_back(boost::shared_ptr<KinBody::KinBodyStateSaver>(new KinBody::KinBodyStateSaver(pgrabbedbody, Save_LinkTransformation)));
+    }
+
+    KinBody::KinBodyStateSaver robotsaver(probot, Save_LinkTransformation);
+    CollisionCheckerBasePtr pchecker = probot->GetEnv()->GetCollisionChecker();
+    bool bAllLinkCollisions = !!(pchecker->GetCollisionOptions()&CO_AllLinkCollisions);
+    CollisionReportKeepSaver reportsaver(report);
+    if( !!report && bAllLinkCollisions && report->nKeepPrevious == 0 ) {
+        report->Reset();
+        report->nKeepPrevious = 1; // have to keep the previous since aggregating results
+    }
+
+    const Transform tinvoldEE = GetTransform().inverse();
+    const std::vector<KinBody::LinkConstPtr> vlinkexcluded;
+    CollisionReportPtr preport = report; // only filled for the first transform in collision
+    bool bincollision = false;
+    for(size_t itrans = 0; itrans < vtEE.size(); ++itrans) {
+        const Transform tdelta = vtEE[itrans]*tinvoldEE;
+        for(size_t ilink = 0; ilink < vgripperlinks.size(); ++ilink) {
+            vgripperlinks[ilink]->SetTransform(tdelta*vgrippertransforms[ilink]);
+        }
+        FOREACHC(itgrabbed, vgrippergrabbed) {
+            itgrabbed->pbody->SetTransform(vgripperlinks[itgrabbed->igripperlink]->GetTransform()*itgrabbed->tRelative);
+        }
+
+        bool bposecollision = false;
+        FOREACHC(itlink, vgripperlinks) {
+            if( !(*itlink)->IsEnabled() ) {
+                continue;
+            }
+            if( !!pbody ? pchecker->CheckCollision(KinBody::LinkConstPtr(*itlink), pbody, preport) : pchecker->CheckCollision(KinBody::LinkConstPtr(*itlink), preport) ) {
+                bposecollision = true;
+                if( !bAllLinkCollisions ) {
+                    break;
+                }
+            }
+        }
+        if( !bposecollision || bAllLinkCollisions ) {
+            FOREACHC(itgrabbed, vgrippergrabbed) {
+                if( !!pbody ? pchecker->CheckCollision(KinBodyConstPtr(itgrabbed->pbody), pbody, preport) : pchecker->CheckCollision(KinBodyConstPtr(itgrabbed->pbody), itgrabbed->vbodyexcluded, vlinkexcluded, preport) ) {
+                    bposecollision = true;
+                    if( !bAllLinkCollisions ) {
+                        break;
+                    }
+                }
+            }
+        }
+        if( bposecollision ) {
+            vresults[itrans] = 1;
+            bincollision = true;
+            preport.reset();
+        }
+    }
+    return bincollision;
+}
+
 bool RobotBase::Manipulator::CheckEndEffectorSelfCollision(CollisionReportPtr report, bool bIgnoreManipulatorLinks) const
 {
     RobotBasePtr probot(__probot);
@@ -1639,6 +1750,36 @@ const std::string& RobotBase::Manipulator::GetInverseKinematicsStructureHash(IkP
     }
 }
 
+void RobotBase::Manipulator::SetReachabilityMap(ManipulatorReachabilityMapConstPtr pmap)
+{
+    if( !!pmap && pmap->GetKinematicsStructureHash() != GetKinematicsStructureHash() ) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("env=%s, reachability map of kinematics %s cannot be used for manipulator %s:%s with kinematics %s"), GetRobot()->GetEnv()->GetNameId()%pmap->GetKinematicsStructureHash()%GetRobot()->GetName()%GetName()%GetKinematicsStructureHash(), ORE_InvalidArguments);
+    }
+    __pReachabilityMap = pmap;
+}
+
+bool RobotBase::Manipulator::IsReachable(const IkParameterization& ikparam, bool inworld) const
+{
+    // the kinematics could have changed since the map was set, for example by changing the local tool transform
+    if( !__pReachabilityMap || __pReachabilityMap->GetKinematicsStructureHash() != GetKinematicsStructureHash() ) {
+        return true;
+    }
+    Transform tbaseinv;
+    if( inworld ) {
+        tbaseinv = __pBase->GetTransform().inverse();
+    }
+    switch(ikparam.GetType()) {
+    case IKP_Transform6D:
+        return __pReachabilityMap->IsReachable(tbaseinv*ikparam.GetTransform6D());
+    case IKP_Translation3D:
+        return __pReachabilityMap->IsReachable(tbaseinv*ikparam.GetTranslation3D());
+    case IKP_TranslationDirection5D:
+        return __pReachabilityMap->IsReachable(tbaseinv*ikparam.GetTranslationDirection5D().pos);
+    default:
+        return true;
+    }
+}
+
 void RobotBase::Manipulator::_ComputeInternalInformation()
 {
     if( !utils::IsValidName(_info._name) ) {
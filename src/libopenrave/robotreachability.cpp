@@ -0,0 +1,411 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2019 Rosen Diankov (rosen.diankov@gmail.com)
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "libopenrave.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace OpenRAVE {
+
+static const uint64_t s_reachabilityMagic = 0x314843414552524fULL; // "ORREACH1"
+static const uint32_t s_reachabilityVersion = 1;
+
+/// \brief header of the reachability files, followed by 4*numrotations doubles and the voxels
+struct ReachabilityFileHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t numrotations;
+    int32_t dims[3];
+    uint32_t padding;
+    double voxelsize;
+    double maxmanipulability;
+    double rotationradius;
+    double origin[3];
+    char kinematicshash[64];
+};
+
+/// \brief returns an upper bound of the distance of the tool from the base link origin
+static dReal _ComputeManipulatorReach(const RobotBase::Manipulator& manip)
+{
+    RobotBasePtr probot = manip.GetRobot();
+    const Transform tbaseinv = manip.GetBase()->GetTransform().inverse();
+    std::vector<KinBody::JointPtr> vjoints;
+    probot->GetChain(manip.GetBase()->GetIndex(), manip.GetEndEffector()->GetIndex(), vjoints);
+    std::vector<dReal> vlower, vupper;
+    dReal freach = 0;
+    Vector vprev;
+    FOREACHC(itjoint, vjoints) {
+        const Vector vanchor = tbaseinv * (*itjoint)->GetAnchor();
+        freach += RaveSqrt((vanchor - vprev).lengthsqr3());
+        if( (*itjoint)->IsPrismatic(0) ) {
+            (*itjoint)->GetLimits(vlower, vupper);
+            freach += std::max(RaveFabs(vlower.at(0)), RaveFabs(vupper.at(0)));
+        }
+        vprev = vanchor;
+    }
+    freach += RaveSqrt((tbaseinv * manip.GetTransform().trans - vprev).lengthsqr3());
+    return freach;
+}
+
+/// \brief deterministic low discrepancy samples of the unit quaternions using Shoemake's uniform mapping
+static void _SampleRotations(int numrotations, std::vector<Vector>& vrotations)
+{
+    vrotations.resize(numrotations);
+    for(int irot = 0; irot < numrotations; ++irot) {
+        const dReal u1 = (irot + 0.5)/numrotations;
+        const dReal u2 = std::fmod(irot*0.6180339887498949, 1.0);
+        const dReal u3 = std::fmod(irot*0.7548776662466927, 1.0);
+        const dReal r1 = RaveSqrt(1 - u1), r2 = RaveSqrt(u1);
+        vrotations[irot] = Vector(r1*RaveSin(2*PI*u2), r1*RaveCos(2*PI*u2), r2*RaveSin(2*PI*u3), r2*RaveCos(2*PI*u3));
+    }
+}
+
+/// \brief returns sqrt(det(J*J^T)) of the 3xN translation jacobian
+static dReal _ComputeManipulability(const std::vector<dReal>& vjacobian, size_t numdofs)
+{
+    dReal a[3][3];
+    for(int i = 0; i < 3; ++i) {
+        for(int j = 0; j < 3; ++j) {
+            dReal f = 0;
+            for(size_t k = 0; k < numdofs; ++k) {
+                f += vjacobian[i*numdofs+k]*vjacobian[j*numdofs+k];
+            }
+            a[i][j] = f;
+        }
+    }
+    const dReal fdet = a[0][0]*(a[1][1]*a[2][2]-a[1][2]*a[2][1]) - a[0][1]*(a[1][0]*a[2][2]-a[1][2]*a[2][0]) + a[0][2]*(a[1][0]*a[2][1]-a[1][1]*a[2][0]);
+    return fdet > 0 ? RaveSqrt(fdet) : dReal(0);
+}
+
+RobotBase::ManipulatorReachabilityMap::ManipulatorReachabilityMap() : _fVoxelSize(0), _fMaxManipulability(0), _fRotationRadius(0), _pVoxels(nullptr), _pMappedData(nullptr), _mappedSize(0)
+{
+    _dims[0] = _dims[1] = _dims[2] = 0;
+}
+
+RobotBase::ManipulatorReachabilityMap::~ManipulatorReachabilityMap()
+{
+#ifndef _WIN32
+    if( !!_pMappedData ) {
+        munmap(_pMappedData, _mappedSize);
+    }
+#endif
+}
+
+void RobotBase::ManipulatorReachabilityMap::_ComputeRotationRadius()
+{
+    // every rotation is close to one of the samples, so the smallest similarity of a sample to its nearest sample bounds how far a query can be
+    _fRotationRadius = _vRotations.size() > 1 ? 1 : 0;
+    for(size_t irot = 0; irot < _vRotations.size(); ++irot) {
+        dReal fnearest = 0;
+        for(size_t jrot = 0; jrot < _vRotations.size(); ++jrot) {
+            if( irot != jrot ) {
+                fnearest = std::max(fnearest, RaveFabs(_vRotations[irot].dot(_vRotations[jrot])));
+            }
+        }
+        if( _vRotations.size() > 1 ) {
+            _fRotationRadius = std::min(_fRotationRadius, fnearest);
+        }
+    }
+}
+
+RobotBase::ManipulatorReachabilityMapPtr RobotBase::ManipulatorReachabilityMap::Generate(ManipulatorConstPtr pmanip, dReal voxelsize, int numrotations, int numthreads)
+{
+    OPENRAVE_ASSERT_OP(voxelsize,>,0);
+    OPENRAVE_ASSERT_OP(numrotations,>,0);
+    OPENRAVE_ASSERT_OP(numrotations,<=,64);
+    RobotBasePtr probot = pmanip->GetRobot();
+    EnvironmentBasePtr penv = probot->GetEnv();
+    if( numthreads <= 0 ) {
+        numthreads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+
+    ManipulatorReachabilityMapPtr pmap(new ManipulatorReachabilityMap());
+    pmap->_fVoxelSize = voxelsize;
+    _SampleRotations(numrotations, pmap->_vRotations);
+    pmap->_ComputeRotationRadius();
+
+    std::vector<EnvironmentBasePtr> vclonedenvs(numthreads);
+    dReal freach = 0;
+    {
+        EnvironmentLock lock(penv->GetMutex());
+        IkSolverBasePtr piksolver = pmanip->GetIkSolver();
+        if( !piksolver || !piksolver->Supports(IKP_Transform6D) ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("env=%s, manipulator %s:%s does not have an ik solver supporting Transform6D"), penv->GetNameId()%probot->GetName()%pmanip->GetName(), ORE_InvalidState);
+        }
+        pmap->_kinematicshash = pmanip->GetKinematicsStructureHash();
+        freach = _ComputeManipulatorReach(*pmanip);
+        for(int ithread = 0; ithread < numthreads; ++ithread) {
+            vclonedenvs[ithread] = penv->CloneSelf(str(boost::format("%s_reachability%d")%penv->GetName()%ithread), Clone_Bodies);
+        }
+    }
+
+    const int halfdim = (int)RaveCeil(freach/voxelsize);
+    for(int i = 0; i < 3; ++i) {
+        pmap->_dims[i] = 2*halfdim+1;
+        pmap->_vOrigin[i] = -halfdim*voxelsize;
+    }
+    const int numvoxels = pmap->_dims[0]*pmap->_dims[1]*pmap->_dims[2];
+    const dReal fmaxdist = freach + voxelsize;
+    RAVELOG_DEBUG_FORMAT("env=%s, generating reachability of manipulator %s:%s with reach %f, %d voxels and %d rotations on %d threads", penv->GetNameId()%probot->GetName()%pmanip->GetName()%freach%numvoxels%numrotations%numthreads);
+
+    std::vector<uint64_t> vmasks(numvoxels, 0);
+    std::vector<dReal> vmanipulabilities(numvoxels, 0);
+    std::vector<std::exception_ptr> vexceptions(numthreads);
+    std::atomic<int> nNextVoxel(0);
+    const std::string robotname = probot->GetName(), manipname = pmanip->GetName();
+    auto worker = [&](int ithread) {
+        try {
+            EnvironmentBasePtr pclonedenv = vclonedenvs[ithread];
+            EnvironmentLock lock(pclonedenv->GetMutex());
+            RobotBasePtr pclonedrobot = pclonedenv->GetRobot(robotname);
+            ManipulatorPtr pclonedmanip = !pclonedrobot ? ManipulatorPtr() : pclonedrobot->GetManipulator(manipname);
+            if( !pclonedmanip ) {
+                throw OPENRAVE_EXCEPTION_FORMAT(_("env=%s, could not find manipulator %s:%s in the cloned environment"), pclonedenv->GetNameId()%robotname%manipname, ORE_InvalidState);
+            }
+            const Transform tbase = pclonedmanip->GetBase()->GetTransform();
+            const std::vector<int>& varmindices = pclonedmanip->GetArmIndices();
+            std::vector<dReal> vsolution, vjacobian;
+            while(true) {
+                const int ivoxel = nNextVoxel.fetch_add(1);
+                if( ivoxel >= numvoxels ) {
+                    break;
+                }
+                const Vector vtrans = pmap->_vOrigin + voxelsize*Vector(ivoxel%pmap->_dims[0], (ivoxel/pmap->_dims[0])%pmap->_dims[1], ivoxel/(pmap->_dims[0]*pmap->_dims[1]));
+                if( vtrans.lengthsqr3() > fmaxdist*fmaxdist ) {
+                    continue;
+                }
+                uint64_t mask = 0;
+                dReal fmanipulability = 0;
+                for(int irot = 0; irot < numrotations; ++irot) {
+                    if( pclonedmanip->FindIKSolution(IkParameterization(tbase*Transform(pmap->_vRotations[irot], vtrans)), vsolution, 0) ) {
+                        mask |= uint64_t(1) << irot;
+                        pclonedrobot->SetDOFValues(vsolution, KinBody::CLA_Nothing, varmindices);
+                        pclonedmanip->CalculateJacobian(vjacobian);
+                        fmanipulability = std::max(fmanipulability, _ComputeManipulability(vjacobian, varmindices.size()));
+                    }
+                }
+                vmasks[ivoxel] = mask;
+                vmanipulabilities[ivoxel] = fmanipulability;
+            }
+        }
+        catch(...) {
+            vexceptions[ithread] = std::current_exception();
+            nNextVoxel = numvoxels;
+        }
+    };
+
+    std::vector<std::thread> vthreads;
+    vthreads.reserve(numthreads-1);
+    for(int ithread = 1; ithread < numthreads; ++ithread) {
+        vthreads.emplace_back(worker, ithread);
+    }
+    worker(0);
+    FOREACH(itthread, vthreads) {
+        itthread->join();
+    }
+    vclonedenvs.clear();
+    FOREACHC(itexception, vexceptions) {
+        if( !!*itexception ) {
+            std::rethrow_exception(*itexception);
+        }
+    }
+
+    pmap->_fMaxManipulability = *std::max_element(vmanipulabilities.begin(), vmanipulabilities.end());
+    pmap->_vVoxels.resize(numvoxels);
+    const int* dims = pmap->_dims;
+    for(int iz = 0; iz < dims[2]; ++iz) {
+        for(int iy = 0; iy < dims[1]; ++iy) {
+            for(int ix = 0; ix < dims[0]; ++ix) {
+                const int ivoxel = ix + dims[0]*(iy + dims[1]*iz);
+                Voxel& voxel = pmap->_vVoxels[ivoxel];
+                memset(&voxel, 0, sizeof(voxel));
+                int numreachable = 0;
+                for(uint64_t mask = vmasks[ivoxel]; mask != 0; mask &= mask - 1) {
+                    ++numreachable;
+                }
+                voxel.score = (uint8_t)(255*numreachable/numrotations);
+                if( pmap->_fMaxManipulability > 0 ) {
+                    voxel.manipulability = (uint8_t)(255*vmanipulabilities[ivoxel]/pmap->_fMaxManipulability + 0.5);
+                }
+                // dilate so that poses near the border of a reached voxel are not rejected
+                for(int jz = std::max(0, iz-1); jz <= std::min(dims[2]-1, iz+1); ++jz) {
+                    for(int jy = std::max(0, iy-1); jy <= std::min(dims[1]-1, iy+1); ++jy) {
+                        for(int jx = std::max(0, ix-1); jx <= std::min(dims[0]-1, ix+1); ++jx) {
+                            voxel.rotationmask |= vmasks[jx + dims[0]*(jy + dims[1]*jz)];
+                        }
+                    }
+                }
+            }
+        }
+    }
+    pmap->_pVoxels = pmap->_vVoxels.data();
+    return pmap;
+}
+
+RobotBase::ManipulatorReachabilityMapPtr RobotBase::ManipulatorReachabilityMap::Load(const std::string& filename)
+{
+    ManipulatorReachabilityMapPtr pmap(new ManipulatorReachabilityMap());
+    const uint8_t* pdata = nullptr;
+    uint64_t size = 0;
+    std::vector<uint8_t> vdata;
+#ifdef _WIN32
+    std::ifstream f(filename.c_str(), std::ios::binary);
+    if( !f ) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("failed to open reachability map '%s'"), filename, ORE_InvalidArguments);
+    }
+    vdata.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    pdata = vdata.data();
+    size = vdata.size();
+#else
+    const int fd = open(filename.c_str(), O_RDONLY);
+    struct stat filestat;
+    if( fd < 0 || fstat(fd, &filestat) != 0 || filestat.st_size == 0 ) {
+        if( fd >= 0 ) {
+            close(fd);
+        }
+        throw OPENRAVE_EXCEPTION_FORMAT(_("failed to open reachability map '%s': %s"), filename%strerror(errno), ORE_InvalidArguments);
+    }
+    size = filestat.st_size;
+    void* pmapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if( pmapped == MAP_FAILED ) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("failed to map reachability map '%s': %s"), filename%strerror(errno), ORE_InvalidArguments);
+    }
+    pmap->_pMappedData = pmapped;
+    pmap->_mappedSize = size;
+    pdata = static_cast<const uint8_t*>(pmapped);
+#endif
+
+    const ReachabilityFileHeader* pheader = reinterpret_cast<const ReachabilityFileHeader*>(pdata);
+    if( size < sizeof(ReachabilityFileHeader) || pheader->magic != s_reachabilityMagic || pheader->version != s_reachabilityVersion || pheader->numrotations == 0 || pheader->numrotations > 64 ) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("'%s' is not a reachability map"), filename, ORE_InvalidArguments);
+    }
+    const uint64_t numvoxels = (uint64_t)pheader->dims[0]*pheader->dims[1]*pheader->dims[2];
+    const uint64_t voxeloffset = sizeof(ReachabilityFileHeader) + 4*sizeof(double)*pheader->numrotations;
+    if( pheader->dims[0] <= 0 || pheader->dims[1] <= 0 || pheader->dims[2] <= 0 || size < voxeloffset + numvoxels*sizeof(Voxel) ) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("reachability map '%s' is truncated"), filename, ORE_InvalidArguments);
+    }
+    pmap->_kinematicshash.assign(pheader->kinematicshash, strnlen(pheader->kinematicshash, sizeof(pheader->kinematicshash)));
+    pmap->_fVoxelSize = pheader->voxelsize;
+    pmap->_fMaxManipulability = pheader->maxmanipulability;
+    pmap->_fRotationRadius = pheader->rotationradius;
+    for(int i = 0; i < 3; ++i) {
+        pmap->_dims[i] = pheader->dims[i];
+        pmap->_vOrigin[i] = pheader->origin[i];
+    }
+    const double* protations = reinterpret_cast<const double*>(pdata + sizeof(ReachabilityFileHeader));
+    pmap->_vRotations.resize(pheader->numrotations);
+    FOREACH(itrot, pmap->_vRotations) {
+        *itrot = Vector(protations[0], protations[1], protations[2], protations[3]);
+        protations += 4;
+    }
+    if( vdata.size() > 0 ) {
+        const Voxel* pvoxels = reinterpret_cast<const Voxel*>(pdata + voxeloffset);
+        pmap->_vVoxels.assign(pvoxels, pvoxels + numvoxels);
+        pmap->_pVoxels = pmap->_vVoxels.data();
+    }
+    else {
+        pmap->_pVoxels = reinterpret_cast<const Voxel*>(pdata + voxeloffset);
+    }
+    return pmap;
+}
+
+std::string RobotBase::ManipulatorReachabilityMap::GetDatabaseFilename(const Manipulator& manip)
+{
+    return str(boost::format("kinematicreachability/%s.map")%manip.GetKinematicsStructureHash());
+}
+
+void RobotBase::ManipulatorReachabilityMap::Save(const std::string& filename) const
+{
+    ReachabilityFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = s_reachabilityMagic;
+    header.version = s_reachabilityVersion;
+    header.numrotations = _vRotations.size();
+    header.voxelsize = _fVoxelSize;
+    header.maxmanipulability = _fMaxManipulability;
+    header.rotationradius = _fRotationRadius;
+    for(int i = 0; i < 3; ++i) {
+        header.dims[i] = _dims[i];
+        header.origin[i] = _vOrigin[i];
+    }
+    strncpy(header.kinematicshash, _kinematicshash.c_str(), sizeof(header.kinematicshash)-1);
+
+    std::ofstream f(filename.c_str(), std::ios::binary|std::ios::trunc);
+    if( !f ) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("failed to open '%s' for writing the reachability map"), filename, ORE_InvalidArguments);
+    }
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    FOREACHC(itrot, _vRotations) {
+        const double q[4] = { itrot->x, itrot->y, itrot->z, itrot->w };
+        f.write(reinterpret_cast<const char*>(q), sizeof(q));
+    }
+    f.write(reinterpret_cast<const char*>(_pVoxels), sizeof(Voxel)*_dims[0]*_dims[1]*_dims[2]);
+    if( !f ) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("failed to write the reachability map '%s'"), filename, ORE_Failed);
+    }
+}
+
+const RobotBase::ManipulatorReachabilityMap::Voxel* RobotBase::ManipulatorReachabilityMap::GetVoxel(const Vector& translation) const
+{
+    int index[3];
+    for(int i = 0; i < 3; ++i) {
+        index[i] = (int)std::floor((translation[i] - _vOrigin[i])/_fVoxelSize + 0.5);
+        if( index[i] < 0 || index[i] >= _dims[i] ) {
+            return nullptr;
+        }
+    }
+    return _pVoxels + index[0] + _dims[0]*(index[1] + _dims[1]*index[2]);
+}
+
+bool RobotBase::ManipulatorReachabilityMap::IsReachable(const Vector& translation) const
+{
+    const Voxel* pvoxel = GetVoxel(translation);
+    return !!pvoxel && pvoxel->rotationmask != 0;
+}
+
+bool RobotBase::ManipulatorReachabilityMap::IsReachable(const Transform& tool) const
+{
+    const Voxel* pvoxel = GetVoxel(tool.trans);
+    if( !pvoxel ) {
+        return false;
+    }
+    // accept if any reached rotation is as close to the query as the samples are to each other
+    for(uint64_t mask = pvoxel->rotationmask; mask != 0; mask &= mask - 1) {
+        int irot = 0;
+        while( !((mask >> irot) & 1) ) {
+            ++irot;
+        }
+        if( RaveFabs(tool.rot.dot(_vRotations[irot])) >= _fRotationRadius ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // end namespace OpenRAVE
@@ -103,7 +103,7 @@ UserDataPtr SimpleSensorSystem::RegisterXMLReaderId(EnvironmentBasePtr penv, con
     return RaveRegisterXMLReader(PT_KinBody,xmlid, boost::bind(&SimpleSensorSystem::CreateXMLReaderId,xmlid, _1,_2));
 }
 
-SimpleSensorSystem::SimpleSensorSystem(const std::string& xmlid, EnvironmentBasePtr penv) : SensorSystemBase(penv), _expirationtime(2000000), _bShutdown(false), _threadUpdate(boost::bind(&SimpleSensorSystem::_UpdateBodiesThread,this))
+SimpleSensorSystem::SimpleSensorSystem(const std::string& xmlid, EnvironmentBasePtr penv) : SensorSystemBase(penv), _expirationtime(2000000), _pQueuedPoses(nullptr), _bShutdown(false), _threadUpdate(boost::bind(&SimpleSensorSystem::_UpdateBodiesThread,this))
 {
     _xmlid = xmlid;
     std::transform(_xmlid.begin(), _xmlid.end(), _xmlid.begin(), ::tolower);
@@ -114,12 +114,14 @@ SimpleSensorSystem::~SimpleSensorSystem()
     Reset();
     _bShutdown = true;
     _threadUpdate.join();
+    _DeleteQueuedPoses(_pQueuedPoses.exchange(nullptr));
 }
 
 void SimpleSensorSystem::Reset()
 {
     std::lock_guard<std::mutex> lock(_mutex);
     _mapbodies.clear();
+    _DeleteQueuedPoses(_pQueuedPoses.exchange(nullptr, std::memory_order_acquire));
 }
 
 void SimpleSensorSystem::AddRegisteredBodies(const std::vector<KinBodyPtr>& vbodies)
@@ -213,6 +215,26 @@ bool SimpleSensorSystem::SwitchBody(KinBodyPtr pbody1, KinBodyPtr pbody2)
     return true;
 }
 
+void SimpleSensorSystem::QueuePose(int bodyindex, const Transform& t)
+{
+    QueuedPose* ppose = new QueuedPose();
+    ppose->bodyindex = bodyindex;
+    ppose->t = t;
+    ppose->pnext = _pQueuedPoses.load(std::memory_order_relaxed);
+    while(!_pQueuedPoses.compare_exchange_weak(ppose->pnext, ppose, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+int SimpleSensorSystem::ApplyQueuedPoses()
+{
+    list<SNAPSHOT> listbodies;
+    _CollectQueuedPoses(listbodies);
+    if( listbodies.size() > 0 ) {
+        _SetBodyPoses(listbodies, utils::GetMicroTime());
+    }
+    return (int)listbodies.size();
+}
+
 boost::shared_ptr<SimpleSensorSystem::BodyData> SimpleSensorSystem::CreateBodyData(KinBodyPtr pbody, boost::shared_ptr<XMLData const> pdata)
 {
     boost::shared_ptr<XMLData> pnewdata(new XMLData(_xmlid));
@@ -225,29 +247,7 @@ void SimpleSensorSystem::_UpdateBodies(list<SimpleSensorSystem::SNAPSHOT>& listb
     EnvironmentLock lockenv(GetEnv()->GetMutex()); // always lock environment to preserve mutex order
     uint64_t curtime = utils::GetMicroTime();
     if( listbodies.size() > 0 ) {
-
-        FOREACH(it, listbodies) {
-            BOOST_ASSERT( it->first->IsEnabled() );
-
-            KinBody::LinkPtr plink = it->first->GetOffsetLink();
-            if( !plink ) {
-                continue;
-            }
-            // transform with respect to offset link
-            TransformMatrix tlink = plink->GetTransform();
-            TransformMatrix tbase = plink->GetParent()->GetTransform();
-            TransformMatrix toffset = tbase * tlink.inverse() * it->first->_initdata->transOffset;
-            TransformMatrix tfinal = toffset * it->second*it->first->_initdata->transPreOffset;
-
-            plink->GetParent()->SetTransform(tfinal);
-            it->first->lastupdated = curtime;
-            it->first->tnew = it->second;
-
-            if( !it->first->IsPresent() ) {
-                RAVELOG_VERBOSE(str(boost::format("updating body %s\n")%plink->GetParent()->GetName()));
-            }
-            it->first->bPresent = true;
-        }
+        _SetBodyPoses(listbodies, curtime);
     }
 
     std::lock_guard<std::mutex> lock(_mutex);
@@ -278,13 +278,74 @@ void SimpleSensorSystem::_UpdateBodies(list<SimpleSensorSystem::SNAPSHOT>& listb
     }
 }
 
+void SimpleSensorSystem::_SetBodyPoses(list<SimpleSensorSystem::SNAPSHOT>& listbodies, uint64_t curtime)
+{
+    FOREACH(it, listbodies) {
+        BOOST_ASSERT( it->first->IsEnabled() );
+
+        KinBody::LinkPtr plink = it->first->GetOffsetLink();
+        if( !plink ) {
+            continue;
+        }
+        // transform with respect to offset link
+        TransformMatrix tlink = plink->GetTransform();
+        TransformMatrix tbase = plink->GetParent()->GetTransform();
+        TransformMatrix toffset = tbase * tlink.inverse() * it->first->_initdata->transOffset;
+        TransformMatrix tfinal = toffset * it->second*it->first->_initdata->transPreOffset;
+
+        plink->GetParent()->SetTransform(tfinal);
+        it->first->lastupdated = curtime;
+        it->first->tnew = it->second;
+
+        if( !it->first->IsPresent() ) {
+            RAVELOG_VERBOSE(str(boost::format("updating body %s\n")%plink->GetParent()->GetName()));
+        }
+        it->first->bPresent = true;
+    }
+}
+
+void SimpleSensorSystem::_CollectQueuedPoses(list<SimpleSensorSystem::SNAPSHOT>& listbodies)
+{
+    QueuedPose* pposes = _pQueuedPoses.exchange(nullptr, std::memory_order_acquire);
+    if( !pposes ) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        // the stack holds the newest pose first, so the older poses of a body already collected are dropped
+        std::set<int> setcollected;
+        for(QueuedPose* ppose = pposes; !!ppose; ppose = ppose->pnext) {
+            if( !setcollected.insert(ppose->bodyindex).second ) {
+                continue;
+            }
+            BODIES::iterator itbody = _mapbodies.find(ppose->bodyindex);
+            if( itbody != _mapbodies.end() && itbody->second->IsEnabled() ) {
+                listbodies.push_back(SNAPSHOT(itbody->second, ppose->t));
+            }
+        }
+    }
+    _DeleteQueuedPoses(pposes);
+}
+
+void SimpleSensorSystem::_DeleteQueuedPoses(QueuedPose* ppose)
+{
+    while(!!ppose) {
+        QueuedPose* pnext = ppose->pnext;
+        delete ppose;
+        ppose = pnext;
+    }
+}
+
 void SimpleSensorSystem::_UpdateBodiesThread()
 {
     list< SNAPSHOT > listbodies;
 
     while(!_bShutdown) {
         {
+            // collect before locking the environment, _UpdateBodies locks the environment before the system
+            _CollectQueuedPoses(listbodies);
             _UpdateBodies(listbodies);
+            listbodies.clear();
         }
         usleep(10000); // 10ms
     }
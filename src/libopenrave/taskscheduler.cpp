@@ -0,0 +1,331 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2016 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "libopenrave.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace OpenRAVE {
+
+/// \brief shared state of a TaskGroup and its queued tasks
+class TaskGroupState
+{
+public:
+    TaskCancellationTokenPtr ptoken;
+    TaskSchedulerPtr pscheduler; ///< the scheduler the tasks are submitted to, the groups keep running on it if the global scheduler is replaced
+    std::atomic<int> numPending{0}; ///< tasks queued or running
+    std::mutex mutex; ///< protects pexception and is used with condDone
+    std::condition_variable condDone; ///< notified when numPending reaches 0
+    std::exception_ptr pexception; ///< the first exception thrown by a task
+};
+
+/// \brief work-stealing scheduler of the global state.
+///
+/// Every worker has a deque of tasks. Tasks submitted from a worker go to the back of its own deque and are popped from the back (LIFO, the
+/// data of the parent task is still in cache). Tasks submitted from other threads go to the injection queue. Idle workers take from the
+/// injection queue and then steal from the front of the deques of the other workers, which holds the oldest and usually largest tasks.
+class TaskScheduler
+{
+public:
+    struct Task
+    {
+        std::function<void()> fn;
+        TaskGroupStatePtr pgroup;
+    };
+
+    TaskScheduler(int numThreads) : _numWorkers(numThreads), _numQueued(0), _bShutdown(false)
+    {
+        // the last queue is the injection queue of the threads that are not workers
+        _vqueues.resize(numThreads+1);
+        for (std::unique_ptr<TaskQueue>& pqueue : _vqueues) {
+            pqueue.reset(new TaskQueue());
+        }
+        _vthreads.reserve(numThreads);
+        for(int iworker = 0; iworker < numThreads; ++iworker) {
+            _vthreads.emplace_back(&TaskScheduler::_WorkerThread, this, iworker);
+        }
+    }
+
+    ~TaskScheduler()
+    {
+        Shutdown();
+    }
+
+    inline int GetNumThreads() const {
+        return _numWorkers;
+    }
+
+    void Submit(Task&& task)
+    {
+        const int iworker = s_pcurrentscheduler == this ? s_iworker : -1;
+        TaskQueue& queue = *_vqueues[iworker >= 0 ? iworker : _vqueues.size()-1];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.deque.push_back(std::move(task));
+        }
+        {
+            // the lock orders the increment with the predicate check of the sleeping workers
+            std::lock_guard<std::mutex> lock(_mutexSleep);
+            ++_numQueued;
+        }
+        _condWork.notify_one();
+    }
+
+    /// \brief runs one queued task on the calling thread
+    ///
+    /// \return false if no task was queued
+    bool TryRunOne()
+    {
+        Task task;
+        if( !_Pop(s_pcurrentscheduler == this ? s_iworker : -1, task) ) {
+            return false;
+        }
+        _Run(task);
+        return true;
+    }
+
+    /// \brief runs the queued tasks and joins the workers. The tasks submitted afterwards are run by the threads waiting on their groups.
+    void Shutdown()
+    {
+        if( s_pcurrentscheduler == this ) {
+            throw OPENRAVE_EXCEPTION_FORMAT0(_("cannot shut down the task scheduler from one of its tasks"), ORE_InvalidState);
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutexSleep);
+            _bShutdown = true;
+        }
+        _condWork.notify_all();
+        for (std::thread& thread : _vthreads) {
+            if( thread.joinable() ) {
+                thread.join();
+            }
+        }
+    }
+
+private:
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> deque;
+    };
+
+    /// \param iworker the worker popping, -1 if not a worker
+    bool _Pop(int iworker, Task& task)
+    {
+        const int numWorkers = _numWorkers;
+        if( iworker >= 0 && _PopQueue(*_vqueues[iworker], true, task) ) {
+            return true;
+        }
+        if( _PopQueue(*_vqueues.back(), false, task) ) {
+            return true;
+        }
+        // start at the next worker so that the thieves do not all contend on the first deque
+        for(int ioffset = 1; ioffset <= numWorkers; ++ioffset) {
+            const int ivictim = (iworker + ioffset + numWorkers) % numWorkers;
+            if( ivictim != iworker && _PopQueue(*_vqueues[ivictim], false, task) ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool _PopQueue(TaskQueue& queue, bool bBack, Task& task)
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if( queue.deque.empty() ) {
+            return false;
+        }
+        if( bBack ) {
+            task = std::move(queue.deque.back());
+            queue.deque.pop_back();
+        }
+        else {
+            task = std::move(queue.deque.front());
+            queue.deque.pop_front();
+        }
+        --_numQueued;
+        return true;
+    }
+
+    void _Run(Task& task)
+    {
+        TaskGroupState& group = *task.pgroup;
+        if( !group.ptoken->IsCancelled() ) {
+            try {
+                task.fn();
+            }
+            catch(...) {
+                std::lock_guard<std::mutex> lock(group.mutex);
+                if( !group.pexception ) {
+                    group.pexception = std::current_exception();
+                }
+                group.ptoken->Cancel();
+            }
+        }
+        task.fn = nullptr;
+        if( --group.numPending == 0 ) {
+            std::lock_guard<std::mutex> lock(group.mutex);
+            group.condDone.notify_all();
+        }
+    }
+
+    void _WorkerThread(int iworker)
+    {
+        s_pcurrentscheduler = this;
+        s_iworker = iworker;
+        Task task;
+        while(true) {
+            if( _Pop(iworker, task) ) {
+                _Run(task);
+                task.pgroup.reset();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(_mutexSleep);
+            _condWork.wait(lock, [this]() {
+                return _bShutdown || _numQueued > 0;
+            });
+            if( _bShutdown && _numQueued == 0 ) {
+                break;
+            }
+        }
+        s_pcurrentscheduler = nullptr;
+        s_iworker = -1;
+    }
+
+    std::vector< std::unique_ptr<TaskQueue> > _vqueues; ///< the deque of every worker followed by the injection queue
+    std::vector<std::thread> _vthreads;
+    const int _numWorkers; ///< set before the workers start, they read it while _vthreads is filled
+    std::mutex _mutexSleep; ///< protects _bShutdown and the increments of _numQueued for _condWork
+    std::condition_variable _condWork;
+    std::atomic<int> _numQueued; ///< tasks in all the queues
+    bool _bShutdown;
+
+    static thread_local TaskScheduler* s_pcurrentscheduler; ///< the scheduler the calling thread is a worker of
+    static thread_local int s_iworker; ///< the index of the calling worker in s_pcurrentscheduler
+};
+
+thread_local TaskScheduler* TaskScheduler::s_pcurrentscheduler = nullptr;
+thread_local int TaskScheduler::s_iworker = -1;
+
+TaskSchedulerPtr CreateTaskScheduler(int numThreads)
+{
+    if( numThreads < 0 ) {
+        numThreads = std::max(0, (int)std::thread::hardware_concurrency() - 1);
+    }
+    return TaskSchedulerPtr(new TaskScheduler(numThreads));
+}
+
+void ShutdownTaskScheduler(TaskSchedulerPtr pscheduler)
+{
+    pscheduler->Shutdown();
+}
+
+int GetTaskSchedulerNumThreads(TaskSchedulerPtr pscheduler)
+{
+    return pscheduler->GetNumThreads();
+}
+
+TaskGroup::TaskGroup(TaskCancellationTokenPtr ptoken) : _pstate(new TaskGroupState())
+{
+    _pstate->ptoken = !!ptoken ? ptoken : TaskCancellationTokenPtr(new TaskCancellationToken());
+    _pstate->pscheduler = RaveGetTaskScheduler();
+}
+
+TaskGroup::~TaskGroup()
+{
+    if( _pstate->numPending > 0 ) {
+        Cancel();
+        try {
+            Wait();
+        }
+        catch(...) {
+        }
+    }
+}
+
+void TaskGroup::Run(const std::function<void()>& fn)
+{
+    ++_pstate->numPending;
+    TaskScheduler::Task task;
+    task.fn = fn;
+    task.pgroup = _pstate;
+    _pstate->pscheduler->Submit(std::move(task));
+}
+
+void TaskGroup::Wait()
+{
+    TaskGroupState& group = *_pstate;
+    while( group.numPending > 0 ) {
+        if( group.pscheduler->TryRunOne() ) {
+            continue;
+        }
+        // the remaining tasks are running on other threads, they can still fork tasks that this thread could help with
+        std::unique_lock<std::mutex> lock(group.mutex);
+        group.condDone.wait_for(lock, std::chrono::milliseconds(1), [&group]() {
+            return group.numPending == 0;
+        });
+    }
+    std::exception_ptr pexception;
+    {
+        std::lock_guard<std::mutex> lock(group.mutex);
+        pexception.swap(group.pexception);
+    }
+    if( !!pexception ) {
+        std::rethrow_exception(pexception);
+    }
+}
+
+void TaskGroup::Cancel()
+{
+    _pstate->ptoken->Cancel();
+}
+
+bool TaskGroup::IsCancelled() const
+{
+    return _pstate->ptoken->IsCancelled();
+}
+
+const TaskCancellationTokenPtr& TaskGroup::GetCancellationToken() const
+{
+    return _pstate->ptoken;
+}
+
+void RaveParallelFor(size_t num, const std::function<void(size_t)>& fn, TaskCancellationTokenPtr ptoken)
+{
+    if( num == 0 ) {
+        return;
+    }
+    TaskGroup group(ptoken);
+    // a few chunks per thread so that the threads that finish early steal the rest
+    const size_t numChunks = std::min(num, (size_t)4*(GetTaskSchedulerNumThreads(RaveGetTaskScheduler())+1));
+    const TaskCancellationToken& token = *group.GetCancellationToken();
+    for(size_t ichunk = 0; ichunk < numChunks; ++ichunk) {
+        const size_t start = num*ichunk/numChunks, end = num*(ichunk+1)/numChunks;
+        group.Run([&fn, &token, start, end]() {
+            for(size_t index = start; index < end && !token.IsCancelled(); ++index) {
+                fn(index);
+            }
+        });
+    }
+    group.Wait();
+}
+
+} // end namespace OpenRAVE
@@ -0,0 +1,259 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2016 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "libopenrave.h"
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <set>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace OpenRAVE {
+
+namespace {
+
+/// \brief one scope recorded by RaveTraceScope or utils::StartupTraceScope
+struct TraceEvent
+{
+    const char* category;
+    const char* name;
+    uint64_t starttime; ///< ns
+    uint64_t duration; ///< ns
+};
+
+/// \brief ring buffer of the scopes of one thread. Only the thread writes into it, so recording does not need any lock.
+struct TraceThreadBuffer
+{
+    TraceThreadBuffer(int threadid_, size_t capacity) : threadid(threadid_), vevents(capacity), numwritten(0) {
+    }
+    int threadid;
+    std::vector<TraceEvent> vevents;
+    std::atomic<uint64_t> numwritten; ///< total number of events written, the event i is at vevents[i%vevents.size()]
+};
+
+typedef boost::shared_ptr<TraceThreadBuffer> TraceThreadBufferPtr;
+
+/// \brief keeps the buffers of all the threads that recorded a scope, so that they can be written after the threads exit
+class TraceRecorder
+{
+public:
+    static TraceRecorder& GetInstance()
+    {
+        static TraceRecorder s_recorder;
+        return s_recorder;
+    }
+
+    inline bool IsEnabled() const {
+        return _bEnabled.load(std::memory_order_relaxed);
+    }
+
+    void SetEnabled(bool bEnable, size_t numEventsPerThread)
+    {
+        _numEventsPerThread.store(std::max(numEventsPerThread, (size_t)1), std::memory_order_relaxed);
+        _bEnabled.store(bEnable, std::memory_order_relaxed);
+    }
+
+    /// \brief true if OPENRAVE_STARTUP_TRACE was set when the recorder was created
+    inline bool IsStartupTraceEnabled() const {
+        return _startuptracefilename.size() > 0;
+    }
+
+    inline void Record(const char* category, const char* name, uint64_t starttime, uint64_t duration)
+    {
+        TraceThreadBuffer& buffer = _GetThreadBuffer();
+        const uint64_t index = buffer.numwritten.load(std::memory_order_relaxed);
+        // Write copies the slots without a lock and drops the ones whose index has been reached by numwritten, so the previous
+        // increment of numwritten has to be visible before the slot is overwritten
+        std::atomic_thread_fence(std::memory_order_release);
+        TraceEvent& event = buffer.vevents[index % buffer.vevents.size()];
+        event.category = category;
+        event.name = name;
+        event.starttime = starttime;
+        event.duration = duration;
+        buffer.numwritten.store(index+1, std::memory_order_release);
+    }
+
+    /// \brief returns a copy of name that lives as long as the recorder, for the names that are not string literals
+    const char* InternName(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _setnames.insert(name).first->c_str();
+    }
+
+    void Write(std::ostream& o)
+    {
+#ifdef _WIN32
+        const int pid = (int)GetCurrentProcessId();
+#else
+        const int pid = (int)getpid();
+#endif
+        std::vector<TraceThreadBufferPtr> vbuffers;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            vbuffers = _vbuffers;
+        }
+        o << "{\"traceEvents\":[";
+        bool bFirst = true;
+        FOREACHC(itbuffer, vbuffers) {
+            const TraceThreadBuffer& buffer = **itbuffer;
+            const uint64_t numwritten = buffer.numwritten.load(std::memory_order_acquire);
+            const uint64_t capacity = buffer.vevents.size();
+            for(uint64_t index = numwritten > capacity ? numwritten - capacity : 0; index < numwritten; ++index) {
+                const TraceEvent event = buffer.vevents[index % capacity];
+                // the thread could have overwritten the slot while it was copied
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if( buffer.numwritten.load(std::memory_order_relaxed) >= index + capacity ) {
+                    continue;
+                }
+                o << (bFirst ? "\n" : ",\n") << "{\"name\":\"";
+                _WriteEscaped(o, event.name);
+                o << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"ts\":" << (event.starttime/1000) << "." << std::setw(3) << std::setfill('0') << (event.starttime%1000)
+                  << ",\"dur\":" << (event.duration/1000) << "." << std::setw(3) << std::setfill('0') << (event.duration%1000) << std::setfill(' ') << ",\"pid\":" << pid << ",\"tid\":" << buffer.threadid << "}";
+                bFirst = false;
+            }
+        }
+        o << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    }
+
+    void WriteStartupTrace()
+    {
+        if( !IsStartupTraceEnabled() ) {
+            return;
+        }
+        std::ofstream ftrace(_startuptracefilename.c_str());
+        if( !ftrace ) {
+            RAVELOG_WARN_FORMAT("failed to open startup trace file %s", _startuptracefilename);
+            return;
+        }
+        Write(ftrace);
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        FOREACH(itbuffer, _vbuffers) {
+            (*itbuffer)->numwritten.store(0, std::memory_order_release);
+        }
+    }
+
+private:
+    TraceRecorder() : _bEnabled(false), _numEventsPerThread(65536), _nextthreadid(0) {
+        const char* pOPENRAVE_STARTUP_TRACE = std::getenv("OPENRAVE_STARTUP_TRACE");
+        if( !!pOPENRAVE_STARTUP_TRACE ) {
+            _startuptracefilename = pOPENRAVE_STARTUP_TRACE;
+        }
+    }
+
+    TraceThreadBuffer& _GetThreadBuffer()
+    {
+        thread_local TraceThreadBufferPtr s_pbuffer;
+        if( !s_pbuffer ) {
+            // only happens the first time the thread records a scope
+            std::lock_guard<std::mutex> lock(_mutex);
+            s_pbuffer.reset(new TraceThreadBuffer(++_nextthreadid, _numEventsPerThread.load(std::memory_order_relaxed)));
+            _vbuffers.push_back(s_pbuffer);
+        }
+        return *s_pbuffer;
+    }
+
+    static void _WriteEscaped(std::ostream& o, const char* name)
+    {
+        for(const char* pc = name; *pc != 0; ++pc) {
+            if( *pc == '"' || *pc == '\\' ) {
+                o << '\\' << *pc;
+            }
+            else if( (unsigned char)*pc >= 0x20 ) {
+                o << *pc;
+            }
+        }
+    }
+
+    std::atomic<bool> _bEnabled;
+    std::atomic<size_t> _numEventsPerThread;
+    std::mutex _mutex; ///< protects _vbuffers, _nextthreadid and _setnames
+    std::vector<TraceThreadBufferPtr> _vbuffers;
+    int _nextthreadid;
+    std::set<std::string> _setnames; ///< names of the startup phases, std::set does not move its strings
+    std::string _startuptracefilename; ///< value of OPENRAVE_STARTUP_TRACE
+};
+
+} // end namespace
+
+void RaveSetTracing(bool bEnable, size_t numEventsPerThread)
+{
+    TraceRecorder::GetInstance().SetEnabled(bEnable, numEventsPerThread);
+}
+
+bool RaveIsTracingEnabled()
+{
+    return TraceRecorder::GetInstance().IsEnabled();
+}
+
+void RaveWriteTrace(std::ostream& o)
+{
+    TraceRecorder::GetInstance().Write(o);
+}
+
+void RaveClearTrace()
+{
+    TraceRecorder::GetInstance().Clear();
+}
+
+void RaveTraceScope::_Begin(const char* name)
+{
+    _name = name;
+    _starttime = utils::GetNanoPerformanceTime();
+}
+
+void RaveTraceScope::_End()
+{
+    TraceRecorder::GetInstance().Record("openrave", _name, _starttime, utils::GetNanoPerformanceTime() - _starttime);
+}
+
+void WriteStartupTrace()
+{
+    TraceRecorder::GetInstance().WriteStartupTrace();
+}
+
+namespace utils {
+
+StartupTraceScope::StartupTraceScope(const char* category, const std::string& name) : _category(category), _starttime(0)
+{
+    if( TraceRecorder::GetInstance().IsStartupTraceEnabled() ) {
+        _name = name;
+        _starttime = GetNanoPerformanceTime();
+    }
+}
+
+StartupTraceScope::~StartupTraceScope()
+{
+    if( _starttime != 0 ) {
+        TraceRecorder& recorder = TraceRecorder::GetInstance();
+        recorder.Record(_category, recorder.InternName(_name), _starttime, GetNanoPerformanceTime() - _starttime);
+    }
+}
+
+bool StartupTraceScope::IsEnabled()
+{
+    return TraceRecorder::GetInstance().IsStartupTraceEnabled();
+}
+
+} // end namespace utils
+
+} // end namespace OpenRAVE
@@ -80,6 +80,15 @@ void TrajectoryBase::DeserializeFromRawData(const uint8_t* pdata, size_t nDataSi
     xmlreaders::ParseXMLData(readerdata, (const char*)pdata, nDataSize);
 }
     
+void TrajectoryBase::DeserializeFromMappedFile(const std::string& filename)
+{
+    std::ifstream f(filename.c_str(), std::ios::binary);
+    if( !f ) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("failed to open trajectory file %s"), filename, ORE_InvalidArguments);
+    }
+    deserialize(f);
+}
+
 void TrajectoryBase::Clone(InterfaceBaseConstPtr preference, int cloningoptions)
 {
     InterfaceBase::Clone(preference,cloningoptions);
@@ -90,6 +99,21 @@ void TrajectoryBase::Clone(InterfaceBaseConstPtr preference, int cloningoptions)
     Insert(0,data);
 }
 
+void TrajectoryBase::Swap(TrajectoryBasePtr traj)
+{
+    if( traj.get() == this ) {
+        return;
+    }
+    ConfigurationSpecification spec = GetConfigurationSpecification();
+    std::vector<dReal> vdata, votherdata;
+    GetWaypoints(0,GetNumWaypoints(),vdata);
+    traj->GetWaypoints(0,traj->GetNumWaypoints(),votherdata);
+    Init(traj->GetConfigurationSpecification());
+    Insert(0,votherdata);
+    traj->Init(spec);
+    traj->Insert(0,vdata);
+}
+
 void TrajectoryBase::Sample(std::vector<dReal>& data, dReal time, const ConfigurationSpecification& spec, bool reintializeData) const
 {
     RAVELOG_VERBOSE(str(boost::format("TrajectoryBase::Sample: calling slow implementation %s")%GetXMLId()));
@@ -243,4 +267,54 @@ void TrajectoryBase::GetWaypoints(size_t startindex, size_t endindex, std::vecto
     }
 }
 
+uint64_t TrajectoryBase::GetDataHash() const
+{
+    std::vector<dReal> vdata;
+    GetWaypoints(0, GetNumWaypoints(), vdata);
+    return _ComputeDataHash(GetConfigurationSpecification(), vdata.size() > 0 ? &vdata[0] : NULL, vdata.size());
+}
+
+namespace {
+
+// 64-bit FNV-1a, the waypoint data is mixed in a word at a time since it is usually much larger than the specification
+const uint64_t s_nFNVOffsetBasis = 14695981039346656037ULL;
+const uint64_t s_nFNVPrime = 1099511628211ULL;
+
+inline uint64_t _HashBytes(uint64_t hash, const void* pdata, size_t nbytes)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(pdata);
+    for(size_t i = 0; i < nbytes; ++i) {
+        hash = (hash ^ p[i]) * s_nFNVPrime;
+    }
+    return hash;
+}
+
+inline uint64_t _HashInt(uint64_t hash, uint64_t value)
+{
+    return (hash ^ value) * s_nFNVPrime;
+}
+
+}
+
+uint64_t TrajectoryBase::_ComputeDataHash(const ConfigurationSpecification& spec, const dReal* pdata, size_t nDataElements)
+{
+    uint64_t hash = s_nFNVOffsetBasis;
+    hash = _HashInt(hash, spec._vgroups.size());
+    FOREACHC(itgroup, spec._vgroups) {
+        hash = _HashInt(hash, itgroup->name.size());
+        hash = _HashBytes(hash, itgroup->name.c_str(), itgroup->name.size());
+        hash = _HashInt(hash, itgroup->offset);
+        hash = _HashInt(hash, itgroup->dof);
+        hash = _HashInt(hash, itgroup->interpolation.size());
+        hash = _HashBytes(hash, itgroup->interpolation.c_str(), itgroup->interpolation.size());
+    }
+    hash = _HashInt(hash, nDataElements);
+    for(size_t i = 0; i < nDataElements; ++i) {
+        uint64_t word = 0;
+        memcpy(&word, &pdata[i], sizeof(dReal));
+        hash = _HashInt(hash, word);
+    }
+    return hash;
+}
+
 } // end namespace OpenRAVE
@@ -22,6 +22,20 @@
 namespace OpenRAVE {
 namespace utils {
 
+/// \brief converts an md5 digest to a lowercase hex string
+static std::string _GetMD5DigestString(const md5_byte_t digest[16])
+{
+    string hex_output;
+    hex_output.resize(32);
+    for (int di = 0; di < 16; ++di) {
+        int n = (digest[di]&0xf);
+        hex_output[2*di+1] = n > 9 ? ('a'+n-10) : ('0'+n);
+        n = (digest[di]&0xf0)>>4;
+        hex_output[2*di+0] = n > 9 ? ('a'+n-10) : ('0'+n);
+    }
+    return hex_output;
+}
+
 std::string GetMD5HashString(const std::string& s)
 {
     if( s.size() == 0 )
@@ -33,15 +47,7 @@ std::string GetMD5HashString(const std::string& s)
     md5_init(&state);
     md5_append(&state, (const md5_byte_t *)s.c_str(), s.size());
     md5_finish(&state, digest);
-    string hex_output;
-    hex_output.resize(32);
-    for (int di = 0; di < 16; ++di) {
-        int n = (digest[di]&0xf);
-        hex_output[2*di+1] = n > 9 ? ('a'+n-10) : ('0'+n);
-        n = (digest[di]&0xf0)>>4;
-        hex_output[2*di+0] = n > 9 ? ('a'+n-10) : ('0'+n);
-    }
-    return hex_output;
+    return _GetMD5DigestString(digest);
 }
 
 std::string GetMD5HashString(const std::vector<uint8_t>&v)
@@ -102,6 +108,39 @@ std::string& SearchAndReplace(std::string& out, const std::string& in, const std
     return out;
 }
 
+size_t ParseReals(const char* pstr, dReal* pvalues, size_t maxvalues, const char** ppend)
+{
+    size_t numvalues = 0;
+    while( numvalues < maxvalues ) {
+        char* pnumberend = NULL;
+        const double f = strtod(pstr, &pnumberend);
+        if( pnumberend == pstr ) {
+            break;
+        }
+        pvalues[numvalues++] = f;
+        pstr = pnumberend;
+    }
+    if( !!ppend ) {
+        *ppend = pstr;
+    }
+    return numvalues;
+}
+
+void ParseReals(const std::string& s, std::vector<dReal>& vvalues)
+{
+    vvalues.resize(0);
+    const char* pstr = s.c_str();
+    while(true) {
+        char* pnumberend = NULL;
+        const double f = strtod(pstr, &pnumberend);
+        if( pnumberend == pstr ) {
+            break;
+        }
+        vvalues.push_back(f);
+        pstr = pnumberend;
+    }
+}
+
 std::string GetFilenameUntilSeparator(std::istream& sinput, char separator)
 {
     std::string filename;
@@ -122,4 +161,54 @@ std::string GetFilenameUntilSeparator(std::istream& sinput, char separator)
 }
 
 } // utils
+
+MD5HashStreamBuffer::MD5HashStreamBuffer() : _pstate(new md5_state_t()), _numhashed(0)
+{
+    md5_init(_pstate.get());
+    setp(_buffer, _buffer + sizeof(_buffer));
+}
+
+MD5HashStreamBuffer::~MD5HashStreamBuffer()
+{
+}
+
+std::string MD5HashStreamBuffer::GetHashString()
+{
+    _Flush();
+    if( _numhashed == 0 ) {
+        return std::string();
+    }
+    // finish a copy so that more characters can be appended afterwards
+    md5_state_t state = *_pstate;
+    md5_byte_t digest[16];
+    md5_finish(&state, digest);
+    return utils::_GetMD5DigestString(digest);
+}
+
+MD5HashStreamBuffer::int_type MD5HashStreamBuffer::overflow(int_type c)
+{
+    _Flush();
+    if( !traits_type::eq_int_type(c, traits_type::eof()) ) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int MD5HashStreamBuffer::sync()
+{
+    _Flush();
+    return 0;
+}
+
+void MD5HashStreamBuffer::_Flush()
+{
+    const int numchars = pptr() - pbase();
+    if( numchars > 0 ) {
+        md5_append(_pstate.get(), (const md5_byte_t *)pbase(), numchars);
+        _numhashed += numchars;
+        setp(_buffer, _buffer + sizeof(_buffer));
+    }
+}
+
 } // OpenRAVE
@@ -17,6 +17,8 @@
 #include "libopenrave.h"
 #include <openrave/xmlreaders.h>
 #include <boost/lexical_cast.hpp>
+#include <boost/functional/hash.hpp>
+#include <mutex>
 
 #define LIBXML_SAX1_ENABLED
 #include <libxml/globals.h>
@@ -129,19 +131,11 @@ bool TrajectoryReader::endElement(const std::string& name)
         }
     }
     else if( name == "data" ) {
-        std::string tmpDataStr;
         _vdata.resize(_spec.GetDOF()*_datacount);
-        for(size_t i = 0; i < _vdata.size(); ++i) {
-            if( !(_ss >> _vdata[i]) ) {
-                _ss.clear(); // clear error state
-                _ss >> tmpDataStr;
-                if( tmpDataStr == "nan" ) {
-                    _vdata[i] = std::numeric_limits<dReal>::quiet_NaN();
-                }
-                else {
-                    throw OPENRAVE_EXCEPTION_FORMAT(_("failed reading %d numbers from trajectory <data> element"), _vdata.size(), ORE_Assert);
-                }
-            }
+        // strtod also reads the nan values
+        const std::string sdata = _ss.str();
+        if( !_vdata.empty() && utils::ParseReals(sdata.c_str(), &_vdata[0], _vdata.size()) != _vdata.size() ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("failed reading %d numbers from trajectory <data> element"), _vdata.size(), ORE_Assert);
         }
         _ptraj->Insert(_ptraj->GetNumWaypoints(),_vdata);
     }
@@ -439,7 +433,8 @@ bool GeometryInfoReader::endElement(const std::string& xmlname)
                 }
             }
             else if( xmlname == "vertices" ) {
-                vector<dReal> values((istream_iterator<dReal>(_ss)), istream_iterator<dReal>());
+                vector<dReal> values;
+                utils::ParseReals(_ss.str(), values);
                 if( (values.size()%9) ) {
                     RAVELOG_WARN(str(boost::format("number of points specified in the vertices field needs to be a multiple of 3 (it is %d), ignoring...\n")%values.size()));
                 }
@@ -893,5 +888,139 @@ bool ParseXMLData(BaseXMLReader& reader, const char* buffer, int size)
     return ret==0;
 }
 
+namespace {
+
+/// \brief supports every element so that all the events of the document are recorded
+class XMLEventRecorder : public BaseXMLReader
+{
+public:
+    XMLEventRecorder(XMLEventRecording& recording) : _recording(recording) {
+    }
+
+    virtual ProcessElement startElement(const std::string& name, const AttributesList& atts) {
+        _recording._vevents.push_back(XMLEventRecording::Event());
+        _recording._vevents.back().type = XMLEventRecording::ET_StartElement;
+        _recording._vevents.back().name = name;
+        _recording._vevents.back().atts = atts;
+        return PE_Support;
+    }
+
+    virtual bool endElement(const std::string& name) {
+        _recording._vevents.push_back(XMLEventRecording::Event());
+        _recording._vevents.back().type = XMLEventRecording::ET_EndElement;
+        _recording._vevents.back().name = name;
+        return false;
+    }
+
+    virtual void characters(const std::string& ch) {
+        _recording._vevents.push_back(XMLEventRecording::Event());
+        _recording._vevents.back().type = XMLEventRecording::ET_Characters;
+        _recording._vevents.back().name = ch;
+    }
+
+private:
+    XMLEventRecording& _recording;
+};
+
+struct XMLEventRecordingCacheEntry
+{
+    size_t hash;
+    std::string data;
+    XMLEventRecordingConstPtr precording;
+};
+
+static const size_t s_nMaxXMLEventRecordings = 32; ///< number of distinct documents kept by GetCachedXMLEventRecording
+static const size_t s_nMaxXMLEventRecordingDataSize = 1<<20; ///< larger documents are not kept
+
+} // end namespace
+
+bool XMLEventRecording::Record(const char* buffer, int size)
+{
+    _vevents.clear();
+    XMLEventRecorder recorder(*this);
+    return ParseXMLData(recorder, buffer, size);
+}
+
+void XMLEventRecording::Replay(BaseXMLReader& reader) const
+{
+    // same logic as the LocalXML SAX functions
+    BaseXMLReaderPtr pdummy;
+    FOREACHC(itevent, _vevents) {
+        switch(itevent->type) {
+        case ET_StartElement:
+            if( !!pdummy ) {
+                pdummy->startElement(itevent->name, itevent->atts);
+            }
+            else if( reader.startElement(itevent->name, itevent->atts) != BaseXMLReader::PE_Support ) {
+                pdummy.reset(new DummyXMLReader(itevent->name,"(libxml)"));
+            }
+            break;
+        case ET_EndElement:
+            if( !!pdummy ) {
+                if( pdummy->endElement(itevent->name) ) {
+                    pdummy.reset();
+                }
+            }
+            else if( reader.endElement(itevent->name) ) {
+                return;
+            }
+            break;
+        case ET_Characters:
+            if( !!pdummy ) {
+                pdummy->characters(itevent->name);
+            }
+            else {
+                reader.characters(itevent->name);
+            }
+            break;
+        }
+    }
+}
+
+XMLEventRecordingConstPtr GetCachedXMLEventRecording(const char* buffer, int size)
+{
+    if( size <= 0 ) {
+        size = strlen(buffer);
+    }
+    if( (size_t)size > s_nMaxXMLEventRecordingDataSize ) {
+        boost::shared_ptr<XMLEventRecording> precording(new XMLEventRecording());
+        precording->Record(buffer, size);
+        return precording;
+    }
+
+    static std::mutex s_mutex;
+    static std::list<XMLEventRecordingCacheEntry> s_listEntries; ///< most recently used first
+    const size_t hash = boost::hash_range(buffer, buffer + size);
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        for(std::list<XMLEventRecordingCacheEntry>::iterator itentry = s_listEntries.begin(); itentry != s_listEntries.end(); ++itentry) {
+            if( itentry->hash == hash && itentry->data.size() == (size_t)size && itentry->data.compare(0, size, buffer, size) == 0 ) {
+                s_listEntries.splice(s_listEntries.begin(), s_listEntries, itentry);
+                return itentry->precording;
+            }
+        }
+    }
+
+    // parse outside of the lock, two threads parsing the same new document at the same time only waste some work
+    boost::shared_ptr<XMLEventRecording> precording(new XMLEventRecording());
+    precording->Record(buffer, size);
+    XMLEventRecordingCacheEntry entry;
+    entry.hash = hash;
+    entry.data.assign(buffer, size);
+    entry.precording = precording;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_listEntries.push_front(entry);
+    if( s_listEntries.size() > s_nMaxXMLEventRecordings ) {
+        s_listEntries.pop_back();
+    }
+    return precording;
+}
+
+void ParseCachedXMLData(BaseXMLReader& reader, const char* buffer, int size)
+{
+    GetCachedXMLEventRecording(buffer, size)->Replay(reader);
+}
+
 } // xmlreaders
 } // OpenRAVE
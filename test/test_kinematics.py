@@ -528,6 +528,30 @@ class TestKinematics(EnvironmentSetup):
                         assert( transdist(-torquegravity, gravitypartials) < 0.1*deltastep*len(gravitypartials))
                         assert( transdist(torquegravity, testtorque_e-testtorque_e2) <= 1e-10 )
 
+    def test_massmatrix(self):
+        self.log.info('verify the mass matrix and gravity torques against inverse dynamics')
+        env=self.env
+        with env:
+            for envfile in ['robots/wam7.kinbody.xml', 'robots/barrettwam.robot.xml']:
+                env.Reset()
+                self.LoadEnv(envfile)
+                body = [body for body in env.GetBodies() if body.GetDOF() > 0][0]
+                lower,upper = body.GetDOFLimits()
+                for iter in range(10):
+                    env.GetPhysicsEngine().SetGravity(random.rand(3)*10-5)
+                    body.SetDOFValues(randlimits(lower, upper))
+                    body.SetDOFVelocities(zeros(body.GetDOF()), [0,0,0], [0,0,0])
+                    dofaccel = 10*random.rand(body.GetDOF())-5
+                    M = body.ComputeMassMatrix()
+                    g = body.ComputeGravityTorques()
+                    # with zero velocities the inverse dynamics is M(q)*qdd + g(q)
+                    torques = body.ComputeInverseDynamics(dofaccel)
+                    assert(transdist(dot(M,dofaccel)+g, torques) <= 1e-10*len(torques))
+                    # the cached results have to follow the state
+                    body.SetDOFValues(randlimits(lower, upper))
+                    torques = body.ComputeInverseDynamics(dofaccel)
+                    assert(transdist(dot(body.ComputeMassMatrix(),dofaccel)+body.ComputeGravityTorques(), torques) <= 1e-10*len(torques))
+
     def test_hessian(self):
         self.log.info('check the jacobian and hessian computation')
         env=self.env
@@ -995,6 +1019,30 @@ class TestKinematics(EnvironmentSetup):
             robot.SetNonCollidingConfiguration()
             assert(not robot.CheckSelfCollision())
             
+    def test_nevercollidinglinkpairs(self):
+        env=self.env
+        with env:
+            robot=self.LoadRobot('robots/barrettwam.robot.xml')
+            robot.SetDOFValues([3],[3])
+            report=CollisionReport()
+            assert(robot.CheckSelfCollision(report))
+            collidingpair = tuple(sorted([report.plink1.GetIndex(), report.plink2.GetIndex()]))
+            # one sample cannot find the collision, but the pair collides in the current configuration so it must not be pruned
+            robot.ComputeNeverCollidingLinkPairs(1, True)
+            assert(robot.HasNeverCollidingLinkPairs())
+            assert(collidingpair in robot.GetNonAdjacentLinks(0))
+            assert(robot.CheckSelfCollision())
+            # other limits are sampled again instead of reusing the cached pairs
+            lower,upper = robot.GetDOFLimits()
+            lower[0] *= 0.9
+            upper[0] *= 0.9
+            robot.SetDOFLimits(lower, upper)
+            robot.ComputeNeverCollidingLinkPairs(1)
+            assert(collidingpair in robot.GetNonAdjacentLinks(0))
+            assert(robot.CheckSelfCollision())
+            robot.ResetNeverCollidingLinkPairs()
+            assert(not robot.HasNeverCollidingLinkPairs())
+
     def test_closedlinkage(self):
         self.log.info('check a very complex closed linkage model')
         env=self.env
@@ -1120,3 +1168,69 @@ class TestKinematics(EnvironmentSetup):
         assert(robot.CheckSelfCollision())
         robot.SetNonCollidingConfiguration()
         assert(not robot.CheckSelfCollision())
+
+    def test_incrementalkinematics(self):
+        self.log.info('check that SetDOFValues updating only the links downstream of the changed dofs matches a full update')
+        env=self.env
+        with env:
+            linkinfos = []
+            for ilink in range(3):
+                infobox = KinBody.Link.GeometryInfo()
+                infobox._type = GeometryType.Box
+                infobox._vGeomData = [0.1,0.05,0.05]
+                linkinfo = KinBody.LinkInfo()
+                linkinfo._vgeometryinfos = [infobox]
+                linkinfo._name = 'link%d'%ilink
+                linkinfo._t[0,3] = 0.5*ilink
+                linkinfos.append(linkinfo)
+            jointinfos = []
+            # the second joint is defined from the outer link, so it moves the links in the negative direction
+            for ijoint, (linkname0, linkname1) in enumerate([('link0','link1'), ('link2','link1')]):
+                jointinfo = KinBody.JointInfo()
+                jointinfo._name = 'j%d'%ijoint
+                jointinfo._linkname0 = linkname0
+                jointinfo._linkname1 = linkname1
+                jointinfo._type = KinBody.JointType.Hinge
+                jointinfo._vanchor = [0.5*ijoint+0.25,0,0]
+                jointinfo._vlowerlimit = [-pi]
+                jointinfo._vupperlimit = [pi]
+                jointinfo._vaxes = [[0,0,1]]
+                jointinfos.append(jointinfo)
+            bodies = []
+            for name in ['incremental', 'full']:
+                body = RaveCreateKinBody(env,'')
+                body.Init(linkinfos,jointinfos)
+                body.SetName(name)
+                env.Add(body)
+                bodies.append(body)
+            body, bodyfull = bodies
+
+            def CheckFullUpdate(values):
+                body.SetDOFValues(values)
+                # changing every dof first forces all the links to be recomputed
+                bodyfull.SetDOFValues(array(values)+0.5)
+                bodyfull.SetDOFValues(values)
+                assert(transdist(body.GetLinkTransformations(), bodyfull.GetLinkTransformations()) <= 1e-12)
+
+            for values in [[0.3,0], [0.3,0.4], [0.3,-0.7], [-0.2,-0.7], [-0.2,-0.7+1e-9], [-0.2+1e-9,-0.7+1e-9]]:
+                CheckFullUpdate(values)
+
+            # a move smaller than the linear epsilon still moves the links
+            body.SetDOFValues([0.1,0.1])
+            Tprev = body.GetLinks()[2].GetTransform()
+            body.SetDOFValues([0.1,0.1+1e-9])
+            assert(transdist(body.GetLinks()[2].GetTransform(), Tprev) > 0)
+
+            # links moved by hand are snapped back to the dof values even if the values do not change
+            link = body.GetLinks()[2]
+            Tlink = link.GetTransform()
+            Tmoved = array(Tlink)
+            Tmoved[2,3] += 1
+            link.SetTransform(Tmoved)
+            body.SetDOFValues(body.GetDOFValues())
+            assert(transdist(link.GetTransform(), Tlink) <= g_epsilon)
+
+            # the change callbacks are called and the update stamp changes even if the values do not change
+            stamp = body.GetUpdateStamp()
+            body.SetDOFValues(body.GetDOFValues())
+            assert(body.GetUpdateStamp() != stamp)
@@ -415,6 +415,28 @@ class TestTrajectory(EnvironmentSetup):
         self.RunTrajectory(robot, traj)
         assert( abs(traj.GetDuration()-1.01688888888873) < g_epsilon)
 
+    def test_toppraretimingwaypoints(self):
+        env=self.env
+        robot=self.LoadRobot('robots/pumaarm.zae')
+        with env:
+            spec = robot.GetActiveConfigurationSpecification()
+            waypoints = [array([0.0, 0.0, 0.5, 0.0, 0.0, 0.0]), array([1.0, 0.5, 1.0, 0.5, 0.5, 1.0]), array([0.5, -0.5, 1.5, -0.5, 1.0, 0.0])]
+            for plannername in ['lineartrajectoryretimer', 'parabolictrajectoryretimer']:
+                traj = RaveCreateTrajectory(env,'')
+                traj.Init(spec)
+                for i, q in enumerate(waypoints):
+                    traj.Insert(i, q)
+                ret=planningutils.RetimeActiveDOFTrajectory(traj,robot,False,maxvelmult=1,maxaccelmult=1,plannername=plannername)
+                assert(ret.statusCode==PlannerStatusCode.HasSolution)
+                inputwaypoints = [traj.GetWaypoint(i, spec) for i in range(traj.GetNumWaypoints())]
+                # the timed path is kept, so the output has to go through every waypoint of the input instead of cutting the corners
+                ret=planningutils.RetimeActiveDOFTrajectory(traj,robot,True,maxvelmult=1,maxaccelmult=1,plannername='ToppraTrajectoryRetimer')
+                assert(ret.statusCode==PlannerStatusCode.HasSolution)
+                outputwaypoints = [traj.GetWaypoint(i, spec) for i in range(traj.GetNumWaypoints())]
+                for q in inputwaypoints:
+                    assert(min([sum(abs(qout-q)) for qout in outputwaypoints]) <= g_epsilon)
+                self.RunTrajectory(robot,traj)
+
     @expected_failure  # not running in testopenrave-legacy either
     def test_ikparamretiming(self):
         self.log.info('retime workspace ikparam')